@@ -33,6 +33,7 @@
 #include <linux/scatterlist.h>
 
 #include <asm/cacheflush.h>
+#include <asm/neon.h>
 
 #undef STATS
 
@@ -265,7 +266,7 @@ static inline dma_addr_t map_single(struct device *dev, void *ptr, size_t size,
 	if (dir == DMA_TO_DEVICE || dir == DMA_BIDIRECTIONAL) {
 		dev_dbg(dev, "%s: copy unsafe %p to safe %p, size %d\n",
 			__func__, ptr, buf->safe, size);
-		memcpy(buf->safe, ptr, size);
+		memcpy_neon(buf->safe, ptr, size);
 	}
 
 	return buf->safe_dma_addr;
@@ -288,7 +289,7 @@ static inline void unmap_single(struct device *dev, struct safe_buffer *buf,
 
 		dev_dbg(dev, "%s: copy back safe %p to unsafe %p size %d\n",
 			__func__, buf->safe, ptr, size);
-		memcpy(ptr, buf->safe, size);
+		memcpy_neon(ptr, buf->safe, size);
 
 		/*
 		 * Since we may have written to a page cache page,
@@ -386,7 +387,7 @@ static int __dmabounce_sync_for_cpu(struct device *dev, dma_addr_t addr,
 	if (dir == DMA_FROM_DEVICE || dir == DMA_BIDIRECTIONAL) {
 		dev_dbg(dev, "%s: copy back safe %p to unsafe %p size %d\n",
 			__func__, buf->safe + off, buf->ptr + off, sz);
-		memcpy(buf->ptr + off, buf->safe + off, sz);
+		memcpy_neon(buf->ptr + off, buf->safe + off, sz);
 	}
 	return 0;
 }
@@ -426,7 +427,7 @@ static int __dmabounce_sync_for_device(struct device *dev, dma_addr_t addr,
 	if (dir == DMA_TO_DEVICE || dir == DMA_BIDIRECTIONAL) {
 		dev_dbg(dev, "%s: copy out unsafe %p to safe %p, size %d\n",
 			__func__,buf->ptr + off, buf->safe + off, sz);
-		memcpy(buf->safe + off, buf->ptr + off, sz);
+		memcpy_neon(buf->safe + off, buf->ptr + off, sz);
 	}
 	return 0;
 }
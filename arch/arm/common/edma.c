@@ -25,6 +25,13 @@
 #include <linux/platform_device.h>
 #include <linux/io.h>
 #include <linux/slab.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/mutex.h>
+#include <linux/semaphore.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/ktime.h>
 #include <linux/edma.h>
 #include <linux/dma-mapping.h>
 #include <linux/of_address.h>
@@ -93,6 +100,10 @@
 #define EDMA_QWMTHRA	0x0620
 #define EDMA_QWMTHRB	0x0624
 #define EDMA_CCSTAT	0x0640
+#define EDMA_CCSTAT_ACTV	BIT(4)
+#define EDMA_QSTAT_NUMVAL(x)	(((x) >> 8) & 0x1f)
+#define EDMA_QSTAT_WM(x)	(((x) >> 16) & 0x1f)
+#define EDMA_CCERR_TCCERR	BIT(16)
 
 #define EDMA_M		0x1000	/* global channel registers */
 #define EDMA_ECR	0x1008
@@ -258,6 +269,48 @@ struct edma {
 	 */
 	DECLARE_BITMAP(edma_unused, EDMA_MAX_DMACH);
 
+	/* Freed link slots at the top of PaRAM are kept marked in
+	 * edma_inuse and handed out again LIFO by edma_alloc_slot(),
+	 * so per-transfer churn neither rescans the bitmap nor breaks
+	 * up the contiguous ranges near num_channels.
+	 */
+	spinlock_t	slot_lock;
+	u16		*slot_cache;
+	unsigned	slot_cache_base;
+	unsigned	slot_cache_len;
+	unsigned	slot_cache_max;
+
+	struct edma_slot_stats {
+		u32	hits;
+		u32	misses;
+		u32	frees_cached;
+		u32	frees;
+		u32	cont_allocs;
+		u32	flushes;
+		u32	failures;
+	} slot_stats;
+
+	/* Per channel usage, to check the queue and priority setup
+	 * against what the channels actually do.  Latency runs from
+	 * edma_start() to the first completion interrupt after it;
+	 * bytes are what the channel's own PaRAM set held at start.
+	 */
+	struct edma_chan_stats {
+		u32	starts;
+		u32	completions;
+		u32	missed;
+		u32	lat_count;
+		u32	lat_max_ns;
+		u64	lat_sum_ns;
+		u64	bytes;
+		u64	start_ns;
+	} chan_stats[EDMA_MAX_DMACH];
+
+	/* queue threshold exceeded, per event queue, from CCERR */
+	u32		qthrxcd[8];
+	u32		tc_errors;
+	u32		qdma_missed;
+
 	unsigned	irq_res_start;
 	unsigned	irq_res_end;
 
@@ -271,6 +324,9 @@ struct edma {
 static struct edma *edma_cc[EDMA_MAX_CC];
 static int arch_num_cc;
 
+/* default number of cached link slots per controller */
+#define EDMA_SLOT_CACHE_DEFAULT	32
+
 /* dummy param set used to (re)initialize parameter RAM slots */
 static const struct edmacc_param dummy_paramset = {
 	.link_bcntrld = 0xffff,
@@ -360,6 +416,34 @@ static int irq2ctlr(int irq)
 	return -1;
 }
 
+static void edma_account_start(unsigned ctlr, unsigned channel)
+{
+	struct edma_chan_stats *st = &edma_cc[ctlr]->chan_stats[channel];
+	u32 ab = edma_parm_read(ctlr, PARM_A_B_CNT, channel);
+	u32 c = edma_parm_read(ctlr, PARM_CCNT, channel);
+
+	st->starts++;
+	st->bytes += (u64)(ab & 0xffff) * (ab >> 16) * (c & 0xffff);
+	st->start_ns = ktime_get_ns();
+}
+
+static void edma_account_completion(struct edma *cc, unsigned channel)
+{
+	struct edma_chan_stats *st = &cc->chan_stats[channel];
+	u64 lat;
+
+	st->completions++;
+	if (!st->start_ns)
+		return;
+
+	lat = ktime_get_ns() - st->start_ns;
+	st->start_ns = 0;
+	st->lat_count++;
+	st->lat_sum_ns += lat;
+	if (lat > st->lat_max_ns)
+		st->lat_max_ns = min_t(u64, lat, U32_MAX);
+}
+
 /******************************************************************************
  *
  * DMA interrupt handler
@@ -404,6 +488,7 @@ static irqreturn_t dma_irq_handler(int irq, void *data)
 			/* Clear the corresponding IPR bits */
 			edma_shadow0_write_array(ctlr, SH_ICR, bank,
 					BIT(slot));
+			edma_account_completion(edma_cc[ctlr], channel);
 			if (edma_cc[ctlr]->intr_data[channel].callback)
 				edma_cc[ctlr]->intr_data[channel].callback(
 					channel, EDMA_DMA_COMPLETE,
@@ -460,6 +545,7 @@ static irqreturn_t dma_ccerr_handler(int irq, void *data)
 					/* Clear any SER */
 					edma_shadow0_write_array(ctlr, SH_SECR,
 								j, BIT(i));
+					edma_cc[ctlr]->chan_stats[k].missed++;
 					if (edma_cc[ctlr]->intr_data[k].
 								callback) {
 						edma_cc[ctlr]->intr_data[k].
@@ -479,6 +565,7 @@ static irqreturn_t dma_ccerr_handler(int irq, void *data)
 					edma_write(ctlr, EDMA_QEMCR, BIT(i));
 					edma_shadow0_write(ctlr, SH_QSECR,
 								BIT(i));
+					edma_cc[ctlr]->qdma_missed++;
 
 					/* NOTE:  not reported!! */
 				}
@@ -489,10 +576,13 @@ static irqreturn_t dma_ccerr_handler(int irq, void *data)
 			/* FIXME:  CCERR.BIT(16) ignored!  much better
 			 * to just write CCERRCLR with CCERR value...
 			 */
+			if (edma_read(ctlr, EDMA_CCERR) & EDMA_CCERR_TCCERR)
+				edma_cc[ctlr]->tc_errors++;
 			for (i = 0; i < 8; i++) {
 				if (edma_read(ctlr, EDMA_CCERR) & BIT(i)) {
 					/* Clear the corresponding IPR bits */
 					edma_write(ctlr, EDMA_CCERRCLR, BIT(i));
+					edma_cc[ctlr]->qthrxcd[i]++;
 
 					/* NOTE:  not reported!! */
 				}
@@ -511,6 +601,78 @@ static irqreturn_t dma_ccerr_handler(int irq, void *data)
 	return IRQ_HANDLED;
 }
 
+static int edma_slot_cache_get(struct edma *cc)
+{
+	unsigned long flags;
+	int slot = -1;
+
+	spin_lock_irqsave(&cc->slot_lock, flags);
+	if (cc->slot_cache_len) {
+		slot = cc->slot_cache[--cc->slot_cache_len];
+		cc->slot_stats.hits++;
+	} else {
+		cc->slot_stats.misses++;
+	}
+	spin_unlock_irqrestore(&cc->slot_lock, flags);
+
+	return slot;
+}
+
+static bool edma_slot_cache_put(struct edma *cc, unsigned slot)
+{
+	unsigned long flags;
+	bool cached = false;
+
+	if (slot < cc->slot_cache_base)
+		return false;
+
+	spin_lock_irqsave(&cc->slot_lock, flags);
+	if (cc->slot_cache_len < cc->slot_cache_max) {
+		cc->slot_cache[cc->slot_cache_len++] = slot;
+		cc->slot_stats.frees_cached++;
+		cached = true;
+	}
+	spin_unlock_irqrestore(&cc->slot_lock, flags);
+
+	return cached;
+}
+
+/* Pull one specific slot out of the cache, for fixed-slot requests */
+static bool edma_slot_cache_take(struct edma *cc, unsigned slot)
+{
+	unsigned long flags;
+	bool found = false;
+	unsigned i;
+
+	if (slot < cc->slot_cache_base)
+		return false;
+
+	spin_lock_irqsave(&cc->slot_lock, flags);
+	for (i = 0; i < cc->slot_cache_len; i++) {
+		if (cc->slot_cache[i] != slot)
+			continue;
+		cc->slot_cache[i] = cc->slot_cache[--cc->slot_cache_len];
+		found = true;
+		break;
+	}
+	spin_unlock_irqrestore(&cc->slot_lock, flags);
+
+	return found;
+}
+
+/* Give every cached slot back to the bitmap */
+static void edma_slot_cache_flush(struct edma *cc)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cc->slot_lock, flags);
+	while (cc->slot_cache_len)
+		clear_bit(cc->slot_cache[--cc->slot_cache_len],
+			  cc->edma_inuse);
+	cc->slot_stats.flushes++;
+	spin_unlock_irqrestore(&cc->slot_lock, flags);
+}
+
 static int reserve_contiguous_slots(int ctlr, unsigned int id,
 				     unsigned int num_slots,
 				     unsigned int start_slot)
@@ -771,22 +933,31 @@ int edma_alloc_slot(unsigned ctlr, int slot)
 		slot = EDMA_CHAN_SLOT(slot);
 
 	if (slot < 0) {
+		slot = edma_slot_cache_get(edma_cc[ctlr]);
+		if (slot >= 0)
+			goto found;
+
 		slot = edma_cc[ctlr]->num_channels;
 		for (;;) {
 			slot = find_next_zero_bit(edma_cc[ctlr]->edma_inuse,
 					edma_cc[ctlr]->num_slots, slot);
-			if (slot == edma_cc[ctlr]->num_slots)
+			if (slot == edma_cc[ctlr]->num_slots) {
+				edma_cc[ctlr]->slot_stats.failures++;
 				return -ENOMEM;
+			}
 			if (!test_and_set_bit(slot, edma_cc[ctlr]->edma_inuse))
 				break;
 		}
 	} else if (slot < edma_cc[ctlr]->num_channels ||
 			slot >= edma_cc[ctlr]->num_slots) {
 		return -EINVAL;
-	} else if (test_and_set_bit(slot, edma_cc[ctlr]->edma_inuse)) {
+	} else if (test_and_set_bit(slot, edma_cc[ctlr]->edma_inuse) &&
+		   !edma_slot_cache_take(edma_cc[ctlr], slot)) {
 		return -EBUSY;
 	}
 
+found:
+
 	memcpy_toio(edmacc_regs_base[ctlr] + PARM_OFFSET(slot),
 			&dummy_paramset, PARM_SIZE);
 
@@ -815,6 +986,10 @@ void edma_free_slot(unsigned slot)
 
 	memcpy_toio(edmacc_regs_base[ctlr] + PARM_OFFSET(slot),
 			&dummy_paramset, PARM_SIZE);
+	if (edma_slot_cache_put(edma_cc[ctlr], slot))
+		return;
+
+	edma_cc[ctlr]->slot_stats.frees++;
 	clear_bit(slot, edma_cc[ctlr]->edma_inuse);
 }
 EXPORT_SYMBOL(edma_free_slot);
@@ -847,6 +1022,8 @@ EXPORT_SYMBOL(edma_free_slot);
  */
 int edma_alloc_cont_slots(unsigned ctlr, unsigned int id, int slot, int count)
 {
+	int ret;
+
 	/*
 	 * The start slot requested should be greater than
 	 * the number of channels and lesser than the total number
@@ -866,17 +1043,25 @@ int edma_alloc_cont_slots(unsigned ctlr, unsigned int id, int slot, int count)
 		(edma_cc[ctlr]->num_slots - edma_cc[ctlr]->num_channels))
 		return -EINVAL;
 
-	switch (id) {
-	case EDMA_CONT_PARAMS_ANY:
-		return reserve_contiguous_slots(ctlr, id, count,
-						 edma_cc[ctlr]->num_channels);
-	case EDMA_CONT_PARAMS_FIXED_EXACT:
-	case EDMA_CONT_PARAMS_FIXED_NOT_EXACT:
-		return reserve_contiguous_slots(ctlr, id, count, slot);
-	default:
+	if (id == EDMA_CONT_PARAMS_ANY)
+		slot = edma_cc[ctlr]->num_channels;
+	else if (id != EDMA_CONT_PARAMS_FIXED_EXACT &&
+		 id != EDMA_CONT_PARAMS_FIXED_NOT_EXACT)
 		return -EINVAL;
+
+	ret = reserve_contiguous_slots(ctlr, id, count, slot);
+	if (ret == -EBUSY && edma_cc[ctlr]->slot_cache_len) {
+		/* cached link slots may be in the way; hand them back */
+		edma_slot_cache_flush(edma_cc[ctlr]);
+		ret = reserve_contiguous_slots(ctlr, id, count, slot);
 	}
 
+	if (ret < 0)
+		edma_cc[ctlr]->slot_stats.failures++;
+	else
+		edma_cc[ctlr]->slot_stats.cont_allocs++;
+
+	return ret;
 }
 EXPORT_SYMBOL(edma_alloc_cont_slots);
 
@@ -1017,6 +1202,50 @@ dma_addr_t edma_get_position(unsigned slot, bool dst)
 	return edma_read(ctlr, offs);
 }
 
+/* bound on the CCSTAT.ACTV polling in edma_get_cyclic_residue() */
+#define EDMA_RESIDUE_LOOPS	1000
+
+/**
+ * edma_get_cyclic_residue - bytes left before a cyclic buffer wraps
+ * @slot: active parameter RAM slot of the channel
+ * @dst: true selects the dest position, false the source
+ * @buf: bus address of the start of the cyclic buffer
+ * @len: length of the cyclic buffer in bytes
+ *
+ * The PaRAM address moves when the CC hands a transfer request to the
+ * TC, not when that request's data has landed. So a bare
+ * edma_get_position() can run up to one request ahead. It can also
+ * land outside the buffer while the slot is being reloaded from its
+ * link.
+ *
+ * This waits, with a bound, until either the CC goes idle or the next
+ * request is set up. It then uses the position from before that
+ * change. A position outside the buffer means it is about to wrap, so
+ * it reads as the start of the buffer.
+ *
+ * Returns a residue in the range 1..@len.
+ */
+size_t edma_get_cyclic_residue(unsigned slot, bool dst, dma_addr_t buf,
+			       size_t len)
+{
+	unsigned ctlr = EDMA_CTLR(slot);
+	int loop = EDMA_RESIDUE_LOOPS;
+	dma_addr_t pos;
+
+	pos = edma_get_position(slot, dst);
+	while (edma_read(ctlr, EDMA_CCSTAT) & EDMA_CCSTAT_ACTV) {
+		if (edma_get_position(slot, dst) != pos || !--loop)
+			break;
+		cpu_relax();
+	}
+
+	if (pos < buf || pos >= buf + len)
+		return len;
+
+	return len - (pos - buf);
+}
+EXPORT_SYMBOL(edma_get_cyclic_residue);
+
 /**
  * edma_set_src_index - configure DMA source address indexing
  * @slot: parameter RAM slot being configured
@@ -1302,6 +1531,8 @@ int edma_start(unsigned channel)
 		int j = channel >> 5;
 		unsigned int mask = BIT(channel & 0x1f);
 
+		edma_account_start(ctlr, channel);
+
 		/* EDMA channels without event association */
 		if (test_bit(channel, edma_cc[ctlr]->edma_unused)) {
 			pr_debug("EDMA: ESR%d %08x\n", j,
@@ -1451,6 +1682,222 @@ void edma_assign_channel_eventq(unsigned channel, enum dma_event_q eventq_no)
 }
 EXPORT_SYMBOL(edma_assign_channel_eventq);
 
+/******************************************************************************
+ *
+ * memory to memory copies
+ *
+ *****************************************************************************/
+
+#define EDMA_MEMCPY_NR_CHANNELS	2
+/* bytes per array, BIDX is a signed 16-bit field */
+#define EDMA_MEMCPY_ACNT	SZ_16K
+#define EDMA_MEMCPY_MAX		((size_t)EDMA_MEMCPY_ACNT * 0xffff)
+/* up to this size the caller spins on the completion instead of sleeping */
+#define EDMA_MEMCPY_POLL_MAX	SZ_64K
+#define EDMA_MEMCPY_TIMEOUT_MS	1000
+
+struct edma_memcpy_chan {
+	int ch;
+	int link;	/* slot for the tail that is not a multiple of ACNT */
+	struct completion done;
+	u16 status;
+	bool busy;
+};
+
+static struct edma_memcpy_chan edma_memcpy_chans[EDMA_MEMCPY_NR_CHANNELS];
+static int edma_memcpy_nr_chans;
+static DEFINE_MUTEX(edma_memcpy_mutex);
+static DEFINE_SPINLOCK(edma_memcpy_lock);
+static struct semaphore edma_memcpy_sem;
+
+static void edma_memcpy_callback(unsigned channel, u16 ch_status, void *data)
+{
+	struct edma_memcpy_chan *mc = data;
+
+	mc->status = ch_status;
+	complete(&mc->done);
+}
+
+static int edma_memcpy_setup(void)
+{
+	struct edma_memcpy_chan *mc;
+	int n = 0, ret = 0;
+
+	mutex_lock(&edma_memcpy_mutex);
+	if (edma_memcpy_nr_chans)
+		goto out;
+
+	for (n = 0; n < EDMA_MEMCPY_NR_CHANNELS; n++) {
+		mc = &edma_memcpy_chans[n];
+		init_completion(&mc->done);
+
+		mc->ch = edma_alloc_channel(EDMA_CHANNEL_ANY,
+					    edma_memcpy_callback, mc,
+					    EVENTQ_DEFAULT);
+		if (mc->ch < 0)
+			break;
+
+		mc->link = edma_alloc_slot(EDMA_CTLR(mc->ch), EDMA_SLOT_ANY);
+		if (mc->link < 0) {
+			edma_free_channel(mc->ch);
+			break;
+		}
+	}
+
+	if (!n) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	sema_init(&edma_memcpy_sem, n);
+	/* publish the pool only once the semaphore is usable */
+	smp_wmb();
+	edma_memcpy_nr_chans = n;
+out:
+	mutex_unlock(&edma_memcpy_mutex);
+	return ret;
+}
+
+static struct edma_memcpy_chan *edma_memcpy_get_chan(void)
+{
+	struct edma_memcpy_chan *mc = NULL;
+	unsigned long flags;
+	int i;
+
+	down(&edma_memcpy_sem);
+
+	spin_lock_irqsave(&edma_memcpy_lock, flags);
+	for (i = 0; i < edma_memcpy_nr_chans; i++) {
+		if (!edma_memcpy_chans[i].busy) {
+			mc = &edma_memcpy_chans[i];
+			mc->busy = true;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&edma_memcpy_lock, flags);
+
+	return mc;
+}
+
+static void edma_memcpy_put_chan(struct edma_memcpy_chan *mc)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&edma_memcpy_lock, flags);
+	mc->busy = false;
+	spin_unlock_irqrestore(&edma_memcpy_lock, flags);
+
+	up(&edma_memcpy_sem);
+}
+
+/*
+ * One AB-synchronized transfer moves the ACNT sized arrays, a linked PaRAM
+ * set chained from it moves the remaining tail.
+ */
+static int edma_memcpy_chunk(struct edma_memcpy_chan *mc, dma_addr_t dst,
+			     dma_addr_t src, size_t len)
+{
+	unsigned int acnt, bcnt, rem, tcc = EDMA_CHAN_SLOT(mc->ch);
+	struct edmacc_param p;
+	unsigned long timeout;
+
+	acnt = min_t(size_t, len, EDMA_MEMCPY_ACNT);
+	bcnt = len / acnt;
+	rem = len - acnt * bcnt;
+
+	p.opt = EDMA_TCC(tcc) | SYNCDIM | (rem ? TCCHEN : TCINTEN);
+	p.src = src;
+	p.dst = dst;
+	p.a_b_cnt = bcnt << 16 | acnt;
+	p.src_dst_bidx = acnt << 16 | acnt;
+	p.link_bcntrld = 0xffff;
+	p.src_dst_cidx = 0;
+	p.ccnt = 1;
+	edma_write_slot(mc->ch, &p);
+
+	if (rem) {
+		p.opt = EDMA_TCC(tcc) | SYNCDIM | TCINTEN;
+		p.src = src + acnt * bcnt;
+		p.dst = dst + acnt * bcnt;
+		p.a_b_cnt = 1 << 16 | rem;
+		p.src_dst_bidx = 0;
+		edma_write_slot(mc->link, &p);
+		edma_link(mc->ch, mc->link);
+	}
+
+	reinit_completion(&mc->done);
+	mc->status = 0;
+	edma_start(mc->ch);
+
+	timeout = jiffies + msecs_to_jiffies(EDMA_MEMCPY_TIMEOUT_MS);
+	if (len <= EDMA_MEMCPY_POLL_MAX) {
+		while (!try_wait_for_completion(&mc->done)) {
+			if (time_after(jiffies, timeout))
+				goto timedout;
+			cpu_relax();
+		}
+	} else if (!wait_for_completion_timeout(&mc->done,
+				msecs_to_jiffies(EDMA_MEMCPY_TIMEOUT_MS))) {
+		goto timedout;
+	}
+
+	return mc->status == EDMA_DMA_COMPLETE ? 0 : -EIO;
+
+timedout:
+	edma_stop(mc->ch);
+	edma_clean_channel(mc->ch);
+	return -ETIMEDOUT;
+}
+
+/**
+ * edma_memcpy - copy memory with an EDMA channel
+ * @dst: DMA address of the destination
+ * @src: DMA address of the source
+ * @len: number of bytes to copy
+ *
+ * Copies @len bytes using one of a small pool of EDMA channels without
+ * hardware event, so the CPU is free while large buffers are moved.
+ * Both buffers must already be mapped for DMA by the caller.  Copies of
+ * up to 64 KiB busy-wait for completion, larger ones sleep.
+ *
+ * Must be called from process context.  Returns zero on success, else
+ * negative errno.
+ */
+int edma_memcpy(dma_addr_t dst, dma_addr_t src, size_t len)
+{
+	struct edma_memcpy_chan *mc;
+	size_t chunk;
+	int ret;
+
+	might_sleep();
+
+	if (!len)
+		return 0;
+
+	if (!edma_memcpy_nr_chans) {
+		ret = edma_memcpy_setup();
+		if (ret)
+			return ret;
+	}
+
+	mc = edma_memcpy_get_chan();
+	if (WARN_ON(!mc))
+		return -EBUSY;
+
+	do {
+		chunk = min(len, EDMA_MEMCPY_MAX);
+		ret = edma_memcpy_chunk(mc, dst, src, chunk);
+		dst += chunk;
+		src += chunk;
+		len -= chunk;
+	} while (!ret && len);
+
+	edma_memcpy_put_chan(mc);
+
+	return ret;
+}
+EXPORT_SYMBOL(edma_memcpy);
+
 static int edma_setup_from_hw(struct device *dev, struct edma_soc_info *pdata,
 			      struct edma *edma_cc, int cc_id)
 {
@@ -1578,6 +2025,8 @@ static int edma_of_parse_dt(struct device *dev,
 	if (prop)
 		ret = edma_xbar_event_map(dev, node, pdata, sz);
 
+	of_property_read_u32(node, "ti,edma-slot-cache", &pdata->slot_cache);
+
 	return ret;
 }
 
@@ -1630,6 +2079,171 @@ static struct edma_soc_info *edma_setup_info_from_dt(struct device *dev,
 }
 #endif
 
+static int edma_setup_slot_cache(struct device *dev, struct edma *cc,
+				 unsigned int max)
+{
+	int i;
+
+	spin_lock_init(&cc->slot_lock);
+
+	if (!max)
+		max = EDMA_SLOT_CACHE_DEFAULT;
+	/* leave most of PaRAM to contiguous and fixed requests */
+	max = min(max, (cc->num_slots - cc->num_channels) / 4);
+	if (!max)
+		return 0;
+
+	cc->slot_cache = devm_kcalloc(dev, max, sizeof(*cc->slot_cache),
+				      GFP_KERNEL);
+	if (!cc->slot_cache)
+		return -ENOMEM;
+
+	cc->slot_cache_max = max;
+	cc->slot_cache_base = cc->num_slots - max;
+
+	/* Pre-fill from the top, skipping slots reserved for other cores */
+	for (i = cc->num_slots - 1; i >= (int)cc->slot_cache_base; i--)
+		if (!test_and_set_bit(i, cc->edma_inuse))
+			cc->slot_cache[cc->slot_cache_len++] = i;
+
+	return 0;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int edma_slots_show(struct seq_file *s, void *unused)
+{
+	int j;
+
+	for (j = 0; j < arch_num_cc; j++) {
+		struct edma *cc = edma_cc[j];
+		struct edma_slot_stats *st = &cc->slot_stats;
+
+		seq_printf(s, "cc%d: slots %u, cached %u/%u from %u\n", j,
+			   cc->num_slots - cc->num_channels,
+			   cc->slot_cache_len, cc->slot_cache_max,
+			   cc->slot_cache_base);
+		seq_printf(s, "  hits %u misses %u failures %u\n",
+			   st->hits, st->misses, st->failures);
+		seq_printf(s, "  frees %u (cached %u) cont %u flushes %u\n",
+			   st->frees + st->frees_cached, st->frees_cached,
+			   st->cont_allocs, st->flushes);
+	}
+
+	return 0;
+}
+
+static int edma_slots_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, edma_slots_show, inode->i_private);
+}
+
+static const struct file_operations edma_slots_fops = {
+	.open		= edma_slots_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int edma_channels_show(struct seq_file *s, void *unused)
+{
+	int j, ch;
+
+	for (j = 0; j < arch_num_cc; j++) {
+		struct edma *cc = edma_cc[j];
+
+		seq_printf(s, "cc%d:  ch q    starts     irqs missed"
+			   "        bytes  avg_us  max_us\n", j);
+		for (ch = 0; ch < cc->num_channels; ch++) {
+			struct edma_chan_stats *st = &cc->chan_stats[ch];
+			u32 q = edma_read_array(j, EDMA_DMAQNUM, ch >> 3);
+			u64 avg = 0;
+
+			if (!st->starts && !st->completions && !st->missed)
+				continue;
+
+			if (st->lat_count)
+				avg = div_u64(st->lat_sum_ns, st->lat_count);
+			q = (q >> ((ch & 7) * 4)) & 7;
+
+			seq_printf(s, "     %3d %u %9u %8u %6u %12llu %7llu"
+				   " %7u\n", ch, q, st->starts,
+				   st->completions, st->missed, st->bytes,
+				   div_u64(avg, NSEC_PER_USEC),
+				   st->lat_max_ns / NSEC_PER_USEC);
+		}
+	}
+
+	return 0;
+}
+
+static int edma_channels_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, edma_channels_show, inode->i_private);
+}
+
+static const struct file_operations edma_channels_fops = {
+	.open		= edma_channels_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int edma_queues_show(struct seq_file *s, void *unused)
+{
+	int j, q;
+
+	for (j = 0; j < arch_num_cc; j++) {
+		struct edma *cc = edma_cc[j];
+		u32 pri = edma_read(j, EDMA_QUEPRI);
+		u32 tcmap = edma_read(j, EDMA_QUETCMAP);
+
+		seq_printf(s, "cc%d: ccstat %08x tc errors %u qdma missed %u\n",
+			   j, edma_read(j, EDMA_CCSTAT), cc->tc_errors,
+			   cc->qdma_missed);
+		for (q = 0; q < cc->num_tc; q++) {
+			u32 qstat = edma_read_array(j, EDMA_QSTAT, q);
+
+			seq_printf(s, "  q%d: tc %u pri %u queued %u wm %u"
+				   " threshold exceeded %u\n", q,
+				   (tcmap >> (q * 4)) & 7,
+				   (pri >> (q * 4)) & 7,
+				   EDMA_QSTAT_NUMVAL(qstat),
+				   EDMA_QSTAT_WM(qstat), cc->qthrxcd[q]);
+		}
+	}
+
+	return 0;
+}
+
+static int edma_queues_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, edma_queues_show, inode->i_private);
+}
+
+static const struct file_operations edma_queues_fops = {
+	.open		= edma_queues_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void edma_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("edma", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_file("slots", S_IRUGO, dir, NULL, &edma_slots_fops);
+	debugfs_create_file("channels", S_IRUGO, dir, NULL,
+			    &edma_channels_fops);
+	debugfs_create_file("queues", S_IRUGO, dir, NULL, &edma_queues_fops);
+}
+#else
+static inline void edma_debugfs_init(void) { }
+#endif
+
 static int edma_probe(struct platform_device *pdev)
 {
 	struct edma_soc_info	**info = pdev->dev.platform_data;
@@ -1757,6 +2371,11 @@ static int edma_probe(struct platform_device *pdev)
 			}
 		}
 
+		ret = edma_setup_slot_cache(dev, edma_cc[j],
+					    info[j]->slot_cache);
+		if (ret)
+			return ret;
+
 		/* Clear the xbar mapped channels in unused list */
 		xbar_chans = info[j]->xbar_chans;
 		if (xbar_chans) {
@@ -1829,6 +2448,8 @@ static int edma_probe(struct platform_device *pdev)
 		platform_device_register_full(&edma_dev_info);
 	}
 
+	edma_debugfs_init();
+
 	return 0;
 }
 
@@ -0,0 +1,83 @@
+/*
+ * CRC32C folding using ARM NEON polynomial multiply intrinsics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * This is built with -mfpu=neon, so it includes nothing but arm_neon.h and
+ * leaves kernel_neon_begin()/kernel_neon_end() to the glue code.
+ *
+ * The input is folded 16 bytes at a time: with the bit reflected
+ * convention of CRC32C, the 128 bit value v = hi:lo of one block is
+ * replaced by
+ *
+ *	clmul(lo, K1) << 32  ^  clmul(hi, K2) << 32
+ *
+ * and xored into the next block, where K1 and K2 are the bit reflected
+ * x^191 mod P and x^127 mod P.  This keeps the running value congruent to
+ * the message mod P, so the CRC of the 16 bytes left at the end is the
+ * CRC of the whole input.  There is no 64 bit carry-less multiply before
+ * ARMv8, so each 64x32 product is built from four vmull.p8, one per byte
+ * of the constant.
+ */
+
+#include <arm_neon.h>
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+/* shift left by n bytes, towards the top of the vector */
+#define SHL(v, n)	vextq_u8(zero, (v), 16 - (n))
+
+#define FOLD_BYTE(j, k1, k2)						\
+	do {								\
+		p = veorq_u8(						\
+			vreinterpretq_u8_p16(vmull_p8(lo, vdup_n_p8(k1))), \
+			vreinterpretq_u8_p16(vmull_p8(hi, vdup_n_p8(k2)))); \
+		u = vuzp_u8(vget_low_u8(p), vget_high_u8(p));		\
+		next = veorq_u8(next,					\
+			SHL(vcombine_u8(u.val[0], zero8), 4 + (j)));	\
+		next = veorq_u8(next,					\
+			SHL(vcombine_u8(u.val[1], zero8), 5 + (j)));	\
+	} while (0)
+
+static inline uint8x16_t crc32c_fold(uint8x16_t v, uint8x16_t next)
+{
+	const uint8x16_t zero = vdupq_n_u8(0);
+	const uint8x8_t zero8 = vdup_n_u8(0);
+	poly8x8_t lo = vreinterpret_p8_u8(vget_low_u8(v));
+	poly8x8_t hi = vreinterpret_p8_u8(vget_high_u8(v));
+	uint8x8x2_t u;
+	uint8x16_t p;
+
+	/* K1 = 0x3743f7bd, K2 = 0x3171d430, least significant byte first */
+	FOLD_BYTE(0, 0xbd, 0x30);
+	FOLD_BYTE(1, 0xf7, 0xd4);
+	FOLD_BYTE(2, 0x43, 0x71);
+	FOLD_BYTE(3, 0x37, 0x31);
+
+	return next;
+}
+
+void crc32c_neon_fold_real(uint32_t crc, const uint8_t *p,
+			   unsigned long blocks, uint8_t *rem)
+{
+	uint8x16_t v = vld1q_u8(p);
+
+	/* the running crc goes into the first four message bytes */
+	v = vsetq_lane_u8(vgetq_lane_u8(v, 0) ^ (crc & 0xff), v, 0);
+	v = vsetq_lane_u8(vgetq_lane_u8(v, 1) ^ ((crc >> 8) & 0xff), v, 1);
+	v = vsetq_lane_u8(vgetq_lane_u8(v, 2) ^ ((crc >> 16) & 0xff), v, 2);
+	v = vsetq_lane_u8(vgetq_lane_u8(v, 3) ^ (crc >> 24), v, 3);
+
+	while (--blocks) {
+		p += 16;
+		v = crc32c_fold(v, vld1q_u8(p));
+	}
+
+	vst1q_u8(rem, v);
+}
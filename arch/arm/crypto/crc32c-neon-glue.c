@@ -0,0 +1,179 @@
+/*
+ * CRC32C (Castagnoli) checksum, ARM NEON glue code
+ *
+ * Based on the generic C implementation in crypto/crc32c_generic.c.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <crypto/internal/hash.h>
+#include <linux/crc32.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/sizes.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+#define CHKSUM_BLOCK_SIZE	1
+#define CHKSUM_DIGEST_SIZE	4
+
+/*
+ * Below this the cost of kernel_neon_begin() is not won back, and above
+ * the chunk size preemption would stay off for too long.
+ */
+#define CRC32C_NEON_MIN_LEN	256
+#define CRC32C_NEON_CHUNK	SZ_4K
+
+void crc32c_neon_fold_real(u32 crc, const u8 *p, unsigned long blocks,
+			   u8 *rem);
+
+struct chksum_ctx {
+	u32 key;
+};
+
+struct chksum_desc_ctx {
+	u32 crc;
+};
+
+static u32 crc32c_neon(u32 crc, const u8 *data, unsigned int len)
+{
+	unsigned int chunk;
+	u8 rem[16];
+
+	if (!may_use_simd())
+		return __crc32c_le(crc, data, len);
+
+	/*
+	 * The NEON code folds whole 16 byte blocks down to the last one,
+	 * which is then reduced by the table code like any other input.
+	 */
+	while (len >= CRC32C_NEON_MIN_LEN) {
+		chunk = min_t(unsigned int, len, CRC32C_NEON_CHUNK) & ~15;
+
+		kernel_neon_begin();
+		crc32c_neon_fold_real(crc, data, chunk / 16, rem);
+		kernel_neon_end();
+
+		crc = __crc32c_le(0, rem, sizeof(rem));
+		data += chunk;
+		len -= chunk;
+	}
+
+	return __crc32c_le(crc, data, len);
+}
+
+static int chksum_init(struct shash_desc *desc)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = mctx->key;
+
+	return 0;
+}
+
+/* the seed is handled as in crc32c-generic */
+static int chksum_setkey(struct crypto_shash *tfm, const u8 *key,
+			 unsigned int keylen)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(tfm);
+
+	if (keylen != sizeof(mctx->key)) {
+		crypto_shash_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+	mctx->key = le32_to_cpu(*(__le32 *)key);
+	return 0;
+}
+
+static int chksum_update(struct shash_desc *desc, const u8 *data,
+			 unsigned int length)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = crc32c_neon(ctx->crc, data, length);
+	return 0;
+}
+
+static int chksum_final(struct shash_desc *desc, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	*(__le32 *)out = ~cpu_to_le32p(&ctx->crc);
+	return 0;
+}
+
+static int __chksum_finup(u32 *crcp, const u8 *data, unsigned int len, u8 *out)
+{
+	*(__le32 *)out = ~cpu_to_le32(crc32c_neon(*crcp, data, len));
+	return 0;
+}
+
+static int chksum_finup(struct shash_desc *desc, const u8 *data,
+			unsigned int len, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	return __chksum_finup(&ctx->crc, data, len, out);
+}
+
+static int chksum_digest(struct shash_desc *desc, const u8 *data,
+			 unsigned int length, u8 *out)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+
+	return __chksum_finup(&mctx->key, data, length, out);
+}
+
+static int crc32c_neon_cra_init(struct crypto_tfm *tfm)
+{
+	struct chksum_ctx *mctx = crypto_tfm_ctx(tfm);
+
+	mctx->key = ~0;
+	return 0;
+}
+
+static struct shash_alg alg = {
+	.digestsize		= CHKSUM_DIGEST_SIZE,
+	.setkey			= chksum_setkey,
+	.init			= chksum_init,
+	.update			= chksum_update,
+	.final			= chksum_final,
+	.finup			= chksum_finup,
+	.digest			= chksum_digest,
+	.descsize		= sizeof(struct chksum_desc_ctx),
+	.base			= {
+		.cra_name		= "crc32c",
+		.cra_driver_name	= "crc32c-neon",
+		.cra_priority		= 200,
+		.cra_blocksize		= CHKSUM_BLOCK_SIZE,
+		.cra_alignmask		= 3,
+		.cra_ctxsize		= sizeof(struct chksum_ctx),
+		.cra_module		= THIS_MODULE,
+		.cra_init		= crc32c_neon_cra_init,
+	}
+};
+
+static int __init crc32c_neon_mod_init(void)
+{
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	return crypto_register_shash(&alg);
+}
+
+static void __exit crc32c_neon_mod_fini(void)
+{
+	crypto_unregister_shash(&alg);
+}
+
+module_init(crc32c_neon_mod_init);
+module_exit(crc32c_neon_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("CRC32c (Castagnoli) checksum, NEON accelerated");
+MODULE_ALIAS_CRYPTO("crc32c");
+MODULE_ALIAS_CRYPTO("crc32c-neon");
@@ -0,0 +1,76 @@
+/*
+ * CRC-T10DIF folding using ARM NEON polynomial multiply intrinsics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * This is built with -mfpu=neon, so it includes nothing but arm_neon.h and
+ * leaves kernel_neon_begin()/kernel_neon_end() to the glue code.
+ *
+ * Same scheme as crc32c-neon-core.c, for a CRC that is not bit reflected:
+ * each block is byte swapped so that v = hi:lo is a 128 bit polynomial,
+ * and is then replaced by clmul(hi, K1) ^ clmul(lo, K2), with K1 and K2
+ * being x^192 mod P and x^128 mod P.  Those are 16 bit, so each 64x16
+ * product takes two vmull.p8.
+ */
+
+#include <arm_neon.h>
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+/* shift left by n bytes, towards the top of the vector */
+#define SHL(v, n)	vextq_u8(zero, (v), 16 - (n))
+
+static inline uint8x16_t bswap128(uint8x16_t v)
+{
+	v = vrev64q_u8(v);
+	return vextq_u8(v, v, 8);
+}
+
+static inline uint8x16_t crct10dif_fold(uint8x16_t v, uint8x16_t next)
+{
+	const uint8x16_t zero = vdupq_n_u8(0);
+	const uint8x8_t zero8 = vdup_n_u8(0);
+	poly8x8_t lo = vreinterpret_p8_u8(vget_low_u8(v));
+	poly8x8_t hi = vreinterpret_p8_u8(vget_high_u8(v));
+	uint8x8x2_t u;
+	uint8x16_t p;
+
+	/* K1 = 0x1faa, K2 = 0xa010: low bytes first, then high bytes */
+	p = veorq_u8(vreinterpretq_u8_p16(vmull_p8(hi, vdup_n_p8(0xaa))),
+		     vreinterpretq_u8_p16(vmull_p8(lo, vdup_n_p8(0x10))));
+	u = vuzp_u8(vget_low_u8(p), vget_high_u8(p));
+	next = veorq_u8(next, vcombine_u8(u.val[0], zero8));
+	next = veorq_u8(next, SHL(vcombine_u8(u.val[1], zero8), 1));
+
+	p = veorq_u8(vreinterpretq_u8_p16(vmull_p8(hi, vdup_n_p8(0x1f))),
+		     vreinterpretq_u8_p16(vmull_p8(lo, vdup_n_p8(0xa0))));
+	u = vuzp_u8(vget_low_u8(p), vget_high_u8(p));
+	next = veorq_u8(next, SHL(vcombine_u8(u.val[0], zero8), 1));
+	next = veorq_u8(next, SHL(vcombine_u8(u.val[1], zero8), 2));
+
+	return next;
+}
+
+void crct10dif_neon_fold_real(uint16_t crc, const uint8_t *p,
+			      unsigned long blocks, uint8_t *rem)
+{
+	uint8x16_t v = vld1q_u8(p);
+
+	/* the running crc goes into the first two message bytes */
+	v = vsetq_lane_u8(vgetq_lane_u8(v, 0) ^ (crc >> 8), v, 0);
+	v = vsetq_lane_u8(vgetq_lane_u8(v, 1) ^ (crc & 0xff), v, 1);
+	v = bswap128(v);
+
+	while (--blocks) {
+		p += 16;
+		v = crct10dif_fold(v, bswap128(vld1q_u8(p)));
+	}
+
+	vst1q_u8(rem, bswap128(v));
+}
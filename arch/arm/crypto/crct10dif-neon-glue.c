@@ -0,0 +1,140 @@
+/*
+ * T10 DIF CRC checksum, ARM NEON glue code
+ *
+ * Based on the generic C implementation in crypto/crct10dif_generic.c.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <crypto/internal/hash.h>
+#include <linux/crc-t10dif.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/sizes.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/* see crc32c-neon-glue.c */
+#define CRCT10DIF_NEON_MIN_LEN	256
+#define CRCT10DIF_NEON_CHUNK	SZ_4K
+
+void crct10dif_neon_fold_real(u16 crc, const u8 *p, unsigned long blocks,
+			      u8 *rem);
+
+struct chksum_desc_ctx {
+	__u16 crc;
+};
+
+static __u16 crct10dif_neon(__u16 crc, const u8 *data, unsigned int len)
+{
+	unsigned int chunk;
+	u8 rem[16];
+
+	if (!may_use_simd())
+		return crc_t10dif_generic(crc, data, len);
+
+	while (len >= CRCT10DIF_NEON_MIN_LEN) {
+		chunk = min_t(unsigned int, len, CRCT10DIF_NEON_CHUNK) & ~15;
+
+		kernel_neon_begin();
+		crct10dif_neon_fold_real(crc, data, chunk / 16, rem);
+		kernel_neon_end();
+
+		crc = crc_t10dif_generic(0, rem, sizeof(rem));
+		data += chunk;
+		len -= chunk;
+	}
+
+	return crc_t10dif_generic(crc, data, len);
+}
+
+static int chksum_init(struct shash_desc *desc)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = 0;
+
+	return 0;
+}
+
+static int chksum_update(struct shash_desc *desc, const u8 *data,
+			 unsigned int length)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = crct10dif_neon(ctx->crc, data, length);
+	return 0;
+}
+
+static int chksum_final(struct shash_desc *desc, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	*(__u16 *)out = ctx->crc;
+	return 0;
+}
+
+static int __chksum_finup(__u16 *crcp, const u8 *data, unsigned int len,
+			  u8 *out)
+{
+	*(__u16 *)out = crct10dif_neon(*crcp, data, len);
+	return 0;
+}
+
+static int chksum_finup(struct shash_desc *desc, const u8 *data,
+			unsigned int len, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	return __chksum_finup(&ctx->crc, data, len, out);
+}
+
+static int chksum_digest(struct shash_desc *desc, const u8 *data,
+			 unsigned int length, u8 *out)
+{
+	__u16 crc = 0;
+
+	/* ->digest() is not preceded by ->init() */
+	return __chksum_finup(&crc, data, length, out);
+}
+
+static struct shash_alg alg = {
+	.digestsize		= CRC_T10DIF_DIGEST_SIZE,
+	.init			= chksum_init,
+	.update			= chksum_update,
+	.final			= chksum_final,
+	.finup			= chksum_finup,
+	.digest			= chksum_digest,
+	.descsize		= sizeof(struct chksum_desc_ctx),
+	.base			= {
+		.cra_name		= "crct10dif",
+		.cra_driver_name	= "crct10dif-neon",
+		.cra_priority		= 200,
+		.cra_blocksize		= CRC_T10DIF_BLOCK_SIZE,
+		.cra_module		= THIS_MODULE,
+	}
+};
+
+static int __init crct10dif_neon_mod_init(void)
+{
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	return crypto_register_shash(&alg);
+}
+
+static void __exit crct10dif_neon_mod_fini(void)
+{
+	crypto_unregister_shash(&alg);
+}
+
+module_init(crct10dif_neon_mod_init);
+module_exit(crct10dif_neon_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("T10 DIF CRC calculation, NEON accelerated");
+MODULE_ALIAS_CRYPTO("crct10dif");
+MODULE_ALIAS_CRYPTO("crct10dif-neon");
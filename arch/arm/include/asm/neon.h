@@ -8,6 +8,7 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/types.h>
 #include <asm/hwcap.h>
 
 #define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
@@ -34,3 +35,9 @@
 void kernel_neon_begin(void);
 #endif
 void kernel_neon_end(void);
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+void *memcpy_neon(void *dest, const void *src, size_t n);
+#else
+#define memcpy_neon(dest, src, n)	memcpy(dest, src, n)
+#endif
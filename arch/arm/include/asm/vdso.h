@@ -5,12 +5,17 @@
 
 #ifndef __ASSEMBLY__
 
+#include <linux/types.h>
+
+struct clocksource;
 struct mm_struct;
 
 #ifdef CONFIG_VDSO
 
 void arm_install_vdso(struct mm_struct *mm, unsigned long addr);
 
+void arm_vdso_set_mmio_counter(struct clocksource *cs, phys_addr_t pa);
+
 extern char vdso_start, vdso_end;
 
 extern unsigned int vdso_total_pages;
@@ -21,6 +26,11 @@ static inline void arm_install_vdso(struct mm_struct *mm, unsigned long addr)
 {
 }
 
+static inline void arm_vdso_set_mmio_counter(struct clocksource *cs,
+					     phys_addr_t pa)
+{
+}
+
 #define vdso_total_pages 0
 
 #endif /* CONFIG_VDSO */
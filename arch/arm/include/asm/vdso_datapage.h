@@ -30,7 +30,8 @@
  */
 struct vdso_data {
 	u32 seq_count;		/* sequence count - odd during updates */
-	u16 tk_is_cntvct;	/* fall back to syscall if false */
+	u8 tk_is_cntvct;	/* timekeeper uses the virtual counter */
+	u8 tk_is_mmio;		/* timekeeper uses the mapped counter */
 	u16 cs_shift;		/* clocksource shift */
 	u32 xtime_coarse_sec;	/* coarse time */
 	u32 xtime_coarse_nsec;
@@ -46,6 +47,7 @@ struct vdso_data {
 	u64 xtime_clock_snsec;	/* CLOCK_REALTIME sub-ns base */
 	u32 tz_minuteswest;	/* timezone info for gettimeofday(2) */
 	u32 tz_dsttime;
+	u32 cs_mmio_offset;	/* counter offset in the page below */
 };
 
 union vdso_data_store {
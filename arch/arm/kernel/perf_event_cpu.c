@@ -20,7 +20,9 @@
 
 #include <linux/bitmap.h>
 #include <linux/export.h>
+#include <linux/hrtimer.h>
 #include <linux/kernel.h>
+#include <linux/moduleparam.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
@@ -35,6 +37,20 @@
 /* Set at runtime when we know what CPU type we are. */
 static struct arm_pmu *cpu_pmu;
 
+/*
+ * Some boards have no usable PMU interrupt (AM335x for one). With poll_us
+ * set, a per-cpu hrtimer looks at the overflow flags instead, so sampling
+ * still works: a sample lands on the first timer tick after the counter
+ * overflowed, with the registers the tick interrupted.
+ */
+static unsigned int poll_us;
+module_param(poll_us, uint, 0444);
+MODULE_PARM_DESC(poll_us,
+	"Poll the counters every poll_us microseconds, 0 uses the interrupt");
+
+static DEFINE_PER_CPU(struct hrtimer, cpu_pmu_poll_timer);
+static irq_handler_t cpu_pmu_poll_handler;
+
 /*
  * Despite the names, these two functions are CPU-specific and are used
  * by the OProfile/perf code.
@@ -170,6 +186,41 @@ static int cpu_pmu_request_irq(struct arm_pmu *cpu_pmu, irq_handler_t handler)
 	return 0;
 }
 
+static enum hrtimer_restart cpu_pmu_poll(struct hrtimer *timer)
+{
+	struct pmu_hw_events __percpu *hw_events = cpu_pmu->hw_events;
+
+	/* hardirq context, get_irq_regs() is what the tick interrupted */
+	cpu_pmu_poll_handler(0, this_cpu_ptr(&hw_events->percpu_pmu));
+	hrtimer_forward_now(timer, ns_to_ktime((u64)poll_us * NSEC_PER_USEC));
+
+	return HRTIMER_RESTART;
+}
+
+static void cpu_pmu_start_poll(void *unused)
+{
+	hrtimer_start(this_cpu_ptr(&cpu_pmu_poll_timer),
+		      ns_to_ktime((u64)poll_us * NSEC_PER_USEC),
+		      HRTIMER_MODE_REL_PINNED);
+}
+
+static void cpu_pmu_free_poll(struct arm_pmu *cpu_pmu)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		hrtimer_cancel(per_cpu_ptr(&cpu_pmu_poll_timer, cpu));
+}
+
+static int cpu_pmu_request_poll(struct arm_pmu *cpu_pmu,
+				irq_handler_t handler)
+{
+	cpu_pmu_poll_handler = handler;
+	on_each_cpu(cpu_pmu_start_poll, NULL, 1);
+
+	return 0;
+}
+
 /*
  * PMU hardware loses all context when a CPU goes offline.
  * When a CPU is hotplugged back in, since some hardware registers are
@@ -217,12 +268,25 @@ static int cpu_pmu_init(struct arm_pmu *cpu_pmu)
 	cpu_pmu->request_irq	= cpu_pmu_request_irq;
 	cpu_pmu->free_irq	= cpu_pmu_free_irq;
 
+	if (poll_us) {
+		for_each_possible_cpu(cpu) {
+			struct hrtimer *timer = per_cpu_ptr(&cpu_pmu_poll_timer,
+							    cpu);
+
+			hrtimer_init(timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+			timer->function = cpu_pmu_poll;
+		}
+		cpu_pmu->request_irq	= cpu_pmu_request_poll;
+		cpu_pmu->free_irq	= cpu_pmu_free_poll;
+		pr_info("polling for counter overflow every %uus\n", poll_us);
+	}
+
 	/* Ensure the PMU has sane values out of reset. */
 	if (cpu_pmu->reset)
 		on_each_cpu(cpu_pmu->reset, cpu_pmu, 1);
 
 	/* If no interrupts available, set the corresponding capability flag */
-	if (!platform_get_irq(cpu_pmu->plat_device, 0))
+	if (!poll_us && !platform_get_irq(cpu_pmu->plat_device, 0))
 		cpu_pmu->pmu.capabilities |= PERF_PMU_CAP_NO_INTERRUPT;
 
 	return 0;
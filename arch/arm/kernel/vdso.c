@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/clocksource.h>
 #include <linux/elf.h>
 #include <linux/err.h>
 #include <linux/kernel.h>
@@ -57,6 +58,21 @@ static struct vm_special_mapping vdso_text_mapping = {
 	.name = "[vdso]",
 };
 
+/*
+ * Optional page of a memory-mapped, free-running counter, mapped
+ * read-only and uncached just below the data page, for systems that
+ * lack a usable architected timer.  It has no struct page, so the
+ * mapping is populated by io_remap_pfn_range() instead.
+ */
+static struct clocksource *vdso_mmio_cs __read_mostly;
+static phys_addr_t vdso_mmio_phys __read_mostly;
+
+static struct page *no_pages[] = { NULL };
+static struct vm_special_mapping vdso_mmio_mapping = {
+	.name = "[vvar]",
+	.pages = no_pages,
+};
+
 struct elfinfo {
 	Elf32_Ehdr	*hdr;		/* ptr to ELF */
 	Elf32_Sym	*dynsym;	/* ptr to .dynsym section */
@@ -163,11 +179,12 @@ static void __init patch_vdso(void *ehdr)
 	einfo.dynsym = find_section(einfo.hdr, ".dynsym", &einfo.dynsymsize);
 	einfo.dynstr = find_section(einfo.hdr, ".dynstr", NULL);
 
-	/* If the virtual counter is absent or non-functional we don't
-	 * want programs to incur the slight additional overhead of
-	 * dispatching through the VDSO only to fall back to syscalls.
+	/* If the virtual counter is absent or non-functional, and no
+	 * mapped counter was registered, we don't want programs to incur
+	 * the slight additional overhead of dispatching through the VDSO
+	 * only to fall back to syscalls.
 	 */
-	if (!cntvct_ok) {
+	if (!cntvct_ok && !vdso_mmio_cs) {
 		vdso_nullpatch_one(&einfo, "__vdso_gettimeofday");
 		vdso_nullpatch_one(&einfo, "__vdso_clock_gettime");
 	}
@@ -207,6 +224,8 @@ static int __init vdso_init(void)
 
 	vdso_total_pages = 1; /* for the data/vvar page */
 	vdso_total_pages += text_pages;
+	if (vdso_mmio_cs)
+		vdso_total_pages++; /* for the counter page */
 
 	cntvct_ok = cntvct_functional();
 
@@ -216,6 +235,41 @@ static int __init vdso_init(void)
 }
 arch_initcall(vdso_init);
 
+/**
+ * arm_vdso_set_mmio_counter - let the vDSO read a clocksource directly
+ * @cs: clocksource whose ->read() is a plain 32-bit load of @pa
+ * @pa: physical address of the counter register
+ *
+ * When @cs is the current timekeeping clocksource, clock_gettime() and
+ * gettimeofday() are served from the vDSO by reading the counter through
+ * a read-only user mapping of the page holding @pa.  That page must contain
+ * nothing that is unsafe for userspace to read.  Must be called before
+ * vdso_init(), i.e. from time_init().
+ */
+void __init arm_vdso_set_mmio_counter(struct clocksource *cs, phys_addr_t pa)
+{
+	if (WARN_ON(vdso_total_pages))
+		return;
+
+	vdso_mmio_cs = cs;
+	vdso_mmio_phys = pa & PAGE_MASK;
+	vdso_data->cs_mmio_offset = pa & ~PAGE_MASK;
+}
+
+static int install_mmio_counter(struct mm_struct *mm, unsigned long addr)
+{
+	struct vm_area_struct *vma;
+
+	vma = _install_special_mapping(mm, addr, PAGE_SIZE,
+				       VM_READ | VM_MAYREAD,
+				       &vdso_mmio_mapping);
+	if (IS_ERR(vma))
+		return PTR_ERR(vma);
+
+	return io_remap_pfn_range(vma, addr, vdso_mmio_phys >> PAGE_SHIFT,
+				  PAGE_SIZE, pgprot_noncached(PAGE_READONLY));
+}
+
 static int install_vvar(struct mm_struct *mm, unsigned long addr)
 {
 	struct vm_area_struct *vma;
@@ -238,12 +292,20 @@ void arm_install_vdso(struct mm_struct *mm, unsigned long addr)
 	if (vdso_text_pagelist == NULL)
 		return;
 
+	if (vdso_mmio_cs) {
+		if (install_mmio_counter(mm, addr))
+			return;
+		addr += PAGE_SIZE;
+	}
+
 	if (install_vvar(mm, addr))
 		return;
 
 	/* Account for vvar page. */
 	addr += PAGE_SIZE;
 	len = (vdso_total_pages - 1) << PAGE_SHIFT;
+	if (vdso_mmio_cs)
+		len -= PAGE_SIZE;
 
 	vma = _install_special_mapping(mm, addr, len,
 		VM_READ | VM_EXEC | VM_MAYREAD | VM_MAYWRITE | VM_MAYEXEC,
@@ -276,13 +338,19 @@ static bool tk_is_cntvct(const struct timekeeper *tk)
 	return true;
 }
 
+static bool tk_is_mmio(const struct timekeeper *tk)
+{
+	return vdso_mmio_cs && tk->tkr_mono.clock == vdso_mmio_cs;
+}
+
 /**
  * update_vsyscall - update the vdso data page
  *
  * Increment the sequence counter, making it odd, indicating to
  * userspace that an update is in progress.  Update the fields used
- * for coarse clocks and, if the architected system timer is in use,
- * the fields used for high precision clocks.  Increment the sequence
+ * for coarse clocks and, if the architected system timer or the
+ * mapped counter is in use, the fields used for high precision
+ * clocks.  Increment the sequence
  * counter again, making it even, indicating to userspace that the
  * update is finished.
  *
@@ -299,7 +367,7 @@ void update_vsyscall(struct timekeeper *tk)
 	struct timespec xtime_coarse;
 	struct timespec64 *wtm = &tk->wall_to_monotonic;
 
-	if (!cntvct_ok) {
+	if (!cntvct_ok && !vdso_mmio_cs) {
 		/* The entry points have been zeroed, so there is no
 		 * point in updating the data page.
 		 */
@@ -310,12 +378,13 @@ void update_vsyscall(struct timekeeper *tk)
 
 	xtime_coarse = __current_kernel_time();
 	vdso_data->tk_is_cntvct			= tk_is_cntvct(tk);
+	vdso_data->tk_is_mmio			= tk_is_mmio(tk);
 	vdso_data->xtime_coarse_sec		= xtime_coarse.tv_sec;
 	vdso_data->xtime_coarse_nsec		= xtime_coarse.tv_nsec;
 	vdso_data->wtm_clock_sec		= wtm->tv_sec;
 	vdso_data->wtm_clock_nsec		= wtm->tv_nsec;
 
-	if (vdso_data->tk_is_cntvct) {
+	if (vdso_data->tk_is_cntvct || vdso_data->tk_is_mmio) {
 		vdso_data->cs_cycle_last	= tk->tkr_mono.cycle_last;
 		vdso_data->xtime_clock_sec	= tk->xtime_sec;
 		vdso_data->xtime_clock_snsec	= tk->tkr_mono.xtime_nsec;
@@ -0,0 +1,71 @@
+/*
+ * linux/arch/arm/lib/memcpy-neon-glue.c
+ *
+ * Large copies with NEON loads and stores, which on Cortex-A8 move a
+ * lot more data per cycle than ldm/stm do.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/export.h>
+#include <linux/hardirq.h>
+#include <linux/string.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+/*
+ * Below this size, saving the user's VFP state in kernel_neon_begin()
+ * costs more than NEON saves on the copy itself.
+ */
+#define NEON_COPY_THRESHOLD	1024
+
+void __memcpy_neon(void *dest, const void *src, size_t n);
+void __copy_page_arm(void *to, const void *from);
+
+static inline bool neon_copy_allowed(void)
+{
+	return cpu_has_neon() && !in_interrupt();
+}
+
+/**
+ * memcpy_neon - memcpy() for callers that know their copies are large
+ * @dest: destination buffer
+ * @src: source buffer
+ * @n: number of bytes to copy
+ *
+ * Uses NEON for copies of NEON_COPY_THRESHOLD bytes or more, when the CPU
+ * has NEON and we are not in interrupt context, and falls back to plain
+ * memcpy() otherwise.
+ */
+void *memcpy_neon(void *dest, const void *src, size_t n)
+{
+	if (n < NEON_COPY_THRESHOLD || !neon_copy_allowed())
+		return memcpy(dest, src, n);
+
+	kernel_neon_begin();
+	__memcpy_neon(dest, src, n);
+	kernel_neon_end();
+
+	if (n & 63)
+		memcpy(dest + (n & ~63), src + (n & ~63), n & 63);
+
+	return dest;
+}
+EXPORT_SYMBOL(memcpy_neon);
+
+#ifdef CONFIG_MMU
+/* copy_page.S provides __copy_page_arm() instead when this is built */
+void copy_page(void *to, const void *from)
+{
+	if (!neon_copy_allowed()) {
+		__copy_page_arm(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__memcpy_neon(to, from, PAGE_SIZE);
+	kernel_neon_end();
+}
+#endif
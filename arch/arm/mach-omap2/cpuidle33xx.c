@@ -22,8 +22,10 @@
 #define AM33XX_FLAG_MPU_PLL		BIT(16)
 #define AM33XX_FLAG_SELF_REFRESH	BIT(17)
 #define AM33XX_FLAG_DISABLE_EMIF	BIT(18)
+#define AM33XX_FLAG_MPU_OFF		BIT(19)
 
 static void (*do_sram_idle)(u32 wfi_flags);
+static struct powerdomain *mpu_pd;
 
 static int am33xx_enter_idle(struct cpuidle_device *dev,
 			     struct cpuidle_driver *drv, int index)
@@ -42,11 +44,24 @@ static int am33xx_enter_idle(struct cpuidle_device *dev,
 	if (state->flags & AM33XX_FLAG_MPU_PLL)
 		wfi_flags |= WFI_FLAG_WAKE_M3;
 
+	/*
+	 * L1 and L2 are lost along with the MPU domain, so clean them on
+	 * the way down; resume comes back through the wkup_m3 resume
+	 * address like it does from suspend.
+	 */
+	if (state->flags & AM33XX_FLAG_MPU_OFF) {
+		wfi_flags |= WFI_FLAG_SAVE_EMIF;
+		pwrdm_set_next_pwrst(mpu_pd, PWRDM_POWER_OFF);
+	}
+
 	cpu_pm_enter();
 	if (do_sram_idle)
 		do_sram_idle(wfi_flags);
 	cpu_pm_exit();
 
+	if (state->flags & AM33XX_FLAG_MPU_OFF)
+		pwrdm_set_next_pwrst(mpu_pd, PWRDM_POWER_ON);
+
 	return index;
 }
 
@@ -71,6 +86,16 @@ struct cpuidle_state am33xx_ddr2_states[] = {
 		.name = "C1+SR",
 		.desc = "Bypass MPU PLL + DDR SR",
 	},
+	{
+		.exit_latency = 1800,
+		.target_residency = 5000,
+		.power_usage = 310,
+		.flags = AM33XX_FLAG_MPU_PLL | AM33XX_FLAG_SELF_REFRESH |
+			 AM33XX_FLAG_MPU_OFF,
+		.enter = am33xx_enter_idle,
+		.name = "C2",
+		.desc = "MPU OFF + DDR SR",
+	},
 };
 
 struct cpuidle_state am33xx_ddr3_states[] = {
@@ -84,6 +109,25 @@ struct cpuidle_state am33xx_ddr3_states[] = {
 		.name = "C1",
 		.desc = "Bypass MPU PLL",
 	},
+	{
+		.exit_latency = 450,
+		.target_residency = 900,
+		.power_usage = 441,
+		.flags = AM33XX_FLAG_MPU_PLL | AM33XX_FLAG_SELF_REFRESH,
+		.enter = am33xx_enter_idle,
+		.name = "C1+SR",
+		.desc = "Bypass MPU PLL + DDR SR",
+	},
+	{
+		.exit_latency = 1800,
+		.target_residency = 5000,
+		.power_usage = 290,
+		.flags = AM33XX_FLAG_MPU_PLL | AM33XX_FLAG_SELF_REFRESH |
+			 AM33XX_FLAG_MPU_OFF,
+		.enter = am33xx_enter_idle,
+		.name = "C2",
+		.desc = "MPU OFF + DDR SR",
+	},
 };
 
 static struct cpuidle_driver am33xx_idle_driver = {
@@ -101,6 +145,10 @@ int am33xx_idle_init(bool ddr3, void (*do_idle)(u32 wfi_flags))
 {
 	do_sram_idle = do_idle;
 
+	mpu_pd = pwrdm_lookup("mpu_pwrdm");
+	if (!mpu_pd)
+		return -ENODEV;
+
 	if (ddr3) {
 		BUILD_BUG_ON(ARRAY_SIZE(am33xx_ddr3_states) >
 					ARRAY_SIZE(am33xx_idle_driver.states));
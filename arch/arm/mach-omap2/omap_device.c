@@ -277,6 +277,9 @@ static int _omap_device_notifier_call(struct notifier_block *nb,
 		if (pdev->dev.of_node)
 			omap_device_build_from_dt(pdev);
 		omap_auxdata_legacy_init(dev);
+		if (IS_ENABLED(CONFIG_OMAP_DEVICE_ASYNC_PM) &&
+		    to_omap_device(pdev))
+			device_enable_async_suspend(dev);
 		/* fall through */
 	default:
 		od = to_omap_device(pdev);
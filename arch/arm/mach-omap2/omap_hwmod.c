@@ -133,6 +133,8 @@
 #include <linux/clk-provider.h>
 #include <linux/delay.h>
 #include <linux/err.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
@@ -208,6 +210,13 @@ static struct omap_hwmod_soc_ops soc_ops;
 /* omap_hwmod_list contains all registered struct omap_hwmods */
 static LIST_HEAD(omap_hwmod_list);
 
+/* omap_hwmod_hash indexes omap_hwmod_list by hwmod name, for _lookup() */
+#define OMAP_HWMOD_HASH_BITS	8
+static DEFINE_HASHTABLE(omap_hwmod_hash, OMAP_HWMOD_HASH_BITS);
+
+/* set once the DT nodes of all registered hwmods have been looked up */
+static bool omap_hwmod_dt_parsed;
+
 /* oh_reidle_list contains all omap_hwmods with HWMOD_NEEDS_REIDLE set */
 LIST_HEAD(oh_reidle_list);
 
@@ -1519,18 +1528,14 @@ static void _shutdown_sysc(struct omap_hwmod *oh)
  */
 static struct omap_hwmod *_lookup(const char *name)
 {
-	struct omap_hwmod *oh, *temp_oh;
-
-	oh = NULL;
+	struct omap_hwmod *oh;
 
-	list_for_each_entry(temp_oh, &omap_hwmod_list, node) {
-		if (!strcmp(name, temp_oh->name)) {
-			oh = temp_oh;
-			break;
-		}
-	}
+	hash_for_each_possible(omap_hwmod_hash, oh, _hash_node,
+			       jhash(name, strlen(name), 0))
+		if (!strcmp(name, oh->name))
+			return oh;
 
-	return oh;
+	return NULL;
 }
 
 /**
@@ -2325,73 +2330,70 @@ static int _shutdown(struct omap_hwmod *oh)
 	return 0;
 }
 
-static int of_dev_find_hwmod(struct device_node *np,
-			     struct omap_hwmod *oh)
+/**
+ * of_dev_hwmod_parse - record the dt node of the hwmods named under @np
+ * @np: struct device_node *
+ *
+ * Walk @np and its children depth first, and for each "ti,hwmods" entry
+ * naming a registered hwmod that has no node yet, record the node and
+ * the index of the entry in the hwmod.  The first node found wins, as
+ * it did when the tree was searched once per hwmod.
+ */
+static void __init of_dev_hwmod_parse(struct device_node *np)
 {
-	int count, i, res;
+	struct device_node *np0 = NULL;
+	struct omap_hwmod *oh;
+	int count, i;
 	const char *p;
 
 	count = of_property_count_strings(np, "ti,hwmods");
-	if (count < 1)
-		return -ENODEV;
-
 	for (i = 0; i < count; i++) {
-		res = of_property_read_string_index(np, "ti,hwmods",
-						    i, &p);
-		if (res)
+		if (of_property_read_string_index(np, "ti,hwmods", i, &p))
 			continue;
-		if (!strcmp(p, oh->name)) {
-			pr_debug("omap_hwmod: dt %s[%i] uses hwmod %s\n",
-				 np->name, i, oh->name);
-			return i;
-		}
+
+		oh = _lookup(p);
+		if (!oh || oh->_dt_node)
+			continue;
+
+		pr_debug("omap_hwmod: dt %s[%i] uses hwmod %s\n",
+			 np->name, i, oh->name);
+		oh->_dt_node = of_node_get(np);
+		oh->_dt_index = i;
 	}
 
-	return -ENODEV;
+	for_each_child_of_node(np, np0)
+		of_dev_hwmod_parse(np0);
 }
 
 /**
- * of_dev_hwmod_lookup - look up needed hwmod from dt blob
- * @np: struct device_node *
+ * of_dev_hwmod_lookup - look up the dt node of a hwmod
  * @oh: struct omap_hwmod *
  * @index: index of the entry found
  * @found: struct device_node * found or NULL
  *
- * Parse the dt blob and find out needed hwmod. Recursive function is
- * implemented to take care hierarchical dt blob parsing.
+ * The ocp bus is parsed once for all the hwmods registered so far, and
+ * again only if more hwmods are registered afterwards.
  * Return: Returns 0 on success, -ENODEV when not found.
  */
-static int of_dev_hwmod_lookup(struct device_node *np,
-			       struct omap_hwmod *oh,
-			       int *index,
-			       struct device_node **found)
+static int __init of_dev_hwmod_lookup(struct omap_hwmod *oh, int *index,
+				      struct device_node **found)
 {
-	struct device_node *np0 = NULL;
-	int res;
+	struct device_node *bus;
 
-	res = of_dev_find_hwmod(np, oh);
-	if (res >= 0) {
-		*found = np;
-		*index = res;
-		return 0;
-	}
-
-	for_each_child_of_node(np, np0) {
-		struct device_node *fc;
-		int i;
+	if (!omap_hwmod_dt_parsed) {
+		bus = of_find_node_by_name(NULL, "ocp");
+		if (!bus)
+			return -ENODEV;
 
-		res = of_dev_hwmod_lookup(np0, oh, &i, &fc);
-		if (res == 0) {
-			*found = fc;
-			*index = i;
-			return 0;
-		}
+		of_dev_hwmod_parse(bus);
+		of_node_put(bus);
+		omap_hwmod_dt_parsed = true;
 	}
 
-	*found = NULL;
-	*index = 0;
+	*found = oh->_dt_node;
+	*index = oh->_dt_index;
 
-	return -ENODEV;
+	return *found ? 0 : -ENODEV;
 }
 
 /**
@@ -2506,13 +2508,9 @@ static int __init _init(struct omap_hwmod *oh, void *data)
 		return 0;
 
 	if (of_have_populated_dt()) {
-		struct device_node *bus;
-
-		bus = of_find_node_by_name(NULL, "ocp");
-		if (!bus)
-			return -ENODEV;
-
-		r = of_dev_hwmod_lookup(bus, oh, &index, &np);
+		r = of_dev_hwmod_lookup(oh, &index, &np);
+		if (r == -ENODEV && !omap_hwmod_dt_parsed)
+			return r;
 		if (r)
 			pr_debug("omap_hwmod: %s missing dt data\n", oh->name);
 		else if (np && index)
@@ -2763,6 +2761,9 @@ static int __init _register(struct omap_hwmod *oh)
 		return -EEXIST;
 
 	list_add_tail(&oh->node, &omap_hwmod_list);
+	hash_add(omap_hwmod_hash, &oh->_hash_node,
+		 jhash(oh->name, strlen(oh->name), 0));
+	omap_hwmod_dt_parsed = false;
 
 	INIT_LIST_HEAD(&oh->master_ports);
 	INIT_LIST_HEAD(&oh->slave_ports);
@@ -37,6 +37,7 @@
 #include <linux/spinlock.h>
 
 struct omap_device;
+struct device_node;
 
 extern struct omap_hwmod_sysc_fields omap_hwmod_sysc_type1;
 extern struct omap_hwmod_sysc_fields omap_hwmod_sysc_type2;
@@ -653,6 +654,9 @@ struct omap_hwmod_link {
  * @flags: hwmod flags (documented below)
  * @_lock: spinlock serializing operations on this hwmod
  * @node: list node for hwmod list (internal use)
+ * @_hash_node: node in the hwmod name hash (internal use)
+ * @_dt_node: DT node whose ti,hwmods names this hwmod (internal use)
+ * @_dt_index: index of this hwmod in @_dt_node's ti,hwmods (internal use)
  * @parent_hwmod: (temporary) a pointer to the hierarchical parent of this hwmod
  *
  * @main_clk refers to this module's "main clock," which for our
@@ -696,6 +700,8 @@ struct omap_hwmod {
 	spinlock_t			_lock;
 	struct lock_class_key		hwmod_key; /* unique lock class */
 	struct list_head		node;
+	struct hlist_node		_hash_node;
+	struct device_node		*_dt_node;
 	struct omap_hwmod_ocp_if	*_mpu_port;
 	unsigned int			(*xlate_irq)(unsigned int);
 	u32				flags;
@@ -709,6 +715,7 @@ struct omap_hwmod {
 	u8				_int_flags;
 	u8				_state;
 	u8				_postsetup_state;
+	u8				_dt_index;
 	struct omap_hwmod		*parent_hwmod;
 };
 
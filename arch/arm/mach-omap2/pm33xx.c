@@ -15,6 +15,7 @@
  */
 
 #include <linux/cpu.h>
+#include <linux/debugfs.h>
 #include <linux/err.h>
 #include <linux/genalloc.h>
 #include <linux/kernel.h>
@@ -23,12 +24,15 @@
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
+#include <linux/seq_file.h>
 #include <linux/sizes.h>
 #include <linux/suspend.h>
 #include <linux/ti-emif-sram.h>
 #include <linux/wkup_m3_ipc.h>
 #include <linux/rtc.h>
 
+#include <trace/events/power.h>
+
 #include <asm/fncpy.h>
 #include <asm/proc-fns.h>
 #include <asm/suspend.h>
@@ -71,6 +75,66 @@ static struct wkup_m3_wakeup_src rtc_alarm_wakeup = {
 static struct wkup_m3_wakeup_src rtc_ext_wakeup = {
 	.irq_nr = 0, .src = "Ext wakeup",
 };
+
+/*
+ * Suspend/resume phases timed against the persistent (32k counter)
+ * clock, since timekeeping itself is suspended around ->enter(). The
+ * sleep phase includes the time spent asleep, as well as the wkup_m3
+ * wakeup, the ROM code and DDR leaving self-refresh in the resume code.
+ */
+enum am33xx_pm_phase {
+	AM33XX_PM_M3_PREPARE,
+	AM33XX_PM_SLEEP,
+	AM33XX_PM_M3_STATUS,
+	AM33XX_PM_DEVICES,
+	AM33XX_PM_M3_FINISH,
+	AM33XX_PM_NR_PHASES,
+};
+
+static const char * const am33xx_pm_phase_names[AM33XX_PM_NR_PHASES] = {
+	[AM33XX_PM_M3_PREPARE]	= "m3_prepare",
+	[AM33XX_PM_SLEEP]	= "sleep",
+	[AM33XX_PM_M3_STATUS]	= "m3_status",
+	[AM33XX_PM_DEVICES]	= "resume_devices",
+	[AM33XX_PM_M3_FINISH]	= "m3_finish",
+};
+
+static struct am33xx_pm_phase_time {
+	u64 last;
+	u64 max;
+} am33xx_pm_times[AM33XX_PM_NR_PHASES];
+
+static unsigned int am33xx_pm_cycles;
+static u64 am33xx_pm_wake_time;
+static struct dentry *am33xx_pm_debugfs;
+
+static u64 am33xx_pm_clock(void)
+{
+	struct timespec64 ts;
+
+	read_persistent_clock64(&ts);
+	return timespec64_to_ns(&ts);
+}
+
+static u64 am33xx_pm_phase_begin(enum am33xx_pm_phase phase, int val)
+{
+	trace_suspend_resume(am33xx_pm_phase_names[phase], val, true);
+	return am33xx_pm_clock();
+}
+
+static u64 am33xx_pm_phase_end(enum am33xx_pm_phase phase, int val,
+			       u64 start)
+{
+	struct am33xx_pm_phase_time *t = &am33xx_pm_times[phase];
+	u64 now = am33xx_pm_clock();
+
+	t->last = now - start;
+	if (t->last > t->max)
+		t->max = t->last;
+
+	trace_suspend_resume(am33xx_pm_phase_names[phase], val, false);
+	return now;
+}
 #endif
 
 /*
@@ -132,6 +196,7 @@ int am33xx_rtc_only_idle(unsigned long wfi_flags)
 static int am33xx_pm_suspend(suspend_state_t suspend_state)
 {
 	int i, ret = 0;
+	u64 start;
 
 	if (suspend_state == PM_SUSPEND_MEM &&
 	    pm_ops->check_off_mode_enable()) {
@@ -151,13 +216,17 @@ static int am33xx_pm_suspend(suspend_state_t suspend_state)
 			am33xx_push_sram_idle();
 		}
 	} else {
+		start = am33xx_pm_phase_begin(AM33XX_PM_SLEEP, suspend_state);
 		ret = pm_ops->soc_suspend(suspend_state, am33xx_do_wfi_sram,
 				  suspend_wfi_flags);
+		am33xx_pm_phase_end(AM33XX_PM_SLEEP, suspend_state, start);
 	}
 
 	if (ret) {
 		pr_err("PM: Kernel suspend failure\n");
 	} else {
+		start = am33xx_pm_phase_begin(AM33XX_PM_M3_STATUS,
+					      suspend_state);
 		i = wkup_m3_request_pm_status();
 
 		switch (i) {
@@ -181,6 +250,11 @@ static int am33xx_pm_suspend(suspend_state_t suspend_state)
 			pr_info("PM: Wakeup source %s\n",
 				wkup_m3_request_wake_src());
 		}
+		am33xx_pm_wake_time = am33xx_pm_phase_end(AM33XX_PM_M3_STATUS,
+							  suspend_state, start);
+		am33xx_pm_cycles++;
+		trace_suspend_resume(am33xx_pm_phase_names[AM33XX_PM_DEVICES],
+				     suspend_state, true);
 	}
 
 	return ret;
@@ -205,22 +279,34 @@ static int am33xx_pm_enter(suspend_state_t suspend_state)
 static int am33xx_pm_begin(suspend_state_t state)
 {
 	int ret = -EINVAL;
+	u64 start;
 
 	cpu_idle_poll_ctrl(true);
 
 	switch (state) {
 	case PM_SUSPEND_MEM:
 	case PM_SUSPEND_STANDBY:
+		start = am33xx_pm_phase_begin(AM33XX_PM_M3_PREPARE, state);
 		ret = wkup_m3_prepare_low_power(state);
+		am33xx_pm_phase_end(AM33XX_PM_M3_PREPARE, state, start);
 		break;
 	}
 
+	am33xx_pm_wake_time = 0;
 	return ret;
 }
 
 static void am33xx_pm_end(void)
 {
+	u64 start;
+
+	/* everything between ->enter() and here is device resume */
+	if (am33xx_pm_wake_time)
+		am33xx_pm_phase_end(AM33XX_PM_DEVICES, 0, am33xx_pm_wake_time);
+
+	start = am33xx_pm_phase_begin(AM33XX_PM_M3_FINISH, 0);
 	wkup_m3_finish_low_power();
+	am33xx_pm_phase_end(AM33XX_PM_M3_FINISH, 0, start);
 
 	if (rtc_only_idle) {
 		if (retrigger_irq)
@@ -353,6 +439,45 @@ static int am33xx_pm_rtc_setup(void)
 	return 0;
 }
 
+#ifdef CONFIG_SUSPEND
+static int am33xx_pm_times_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_printf(s, "cycles: %u\n", am33xx_pm_cycles);
+	seq_puts(s, "phase            last(us)    max(us)\n");
+	for (i = 0; i < AM33XX_PM_NR_PHASES; i++)
+		seq_printf(s, "%-14s %10llu %10llu\n",
+			   am33xx_pm_phase_names[i],
+			   div_u64(am33xx_pm_times[i].last, NSEC_PER_USEC),
+			   div_u64(am33xx_pm_times[i].max, NSEC_PER_USEC));
+
+	return 0;
+}
+
+static int am33xx_pm_times_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, am33xx_pm_times_show, inode->i_private);
+}
+
+static const struct file_operations am33xx_pm_times_fops = {
+	.open		= am33xx_pm_times_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void am33xx_pm_debugfs_init(void)
+{
+	am33xx_pm_debugfs = debugfs_create_dir("pm33xx", NULL);
+	if (IS_ERR_OR_NULL(am33xx_pm_debugfs))
+		return;
+
+	debugfs_create_file("times", S_IRUGO, am33xx_pm_debugfs, NULL,
+			    &am33xx_pm_times_fops);
+}
+#endif
+
 static int am33xx_pm_probe(struct platform_device *pdev)
 {
 	int ret;
@@ -393,6 +518,7 @@ static int am33xx_pm_probe(struct platform_device *pdev)
 
 #ifdef CONFIG_SUSPEND
 	suspend_set_ops(&am33xx_pm_ops);
+	am33xx_pm_debugfs_init();
 #endif /* CONFIG_SUSPEND */
 
 	suspend_wfi_flags = 0;
@@ -412,6 +538,9 @@ static int am33xx_pm_probe(struct platform_device *pdev)
 
 static int am33xx_pm_remove(struct platform_device *pdev)
 {
+#ifdef CONFIG_SUSPEND
+	debugfs_remove_recursive(am33xx_pm_debugfs);
+#endif
 	suspend_set_ops(NULL);
 	gen_pool_free(sram_pool, ocmcram_location, *pm_sram->do_wfi_sz);
 	return 0;
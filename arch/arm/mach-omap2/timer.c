@@ -45,6 +45,7 @@
 
 #include <asm/mach/time.h>
 #include <asm/smp_twd.h>
+#include <asm/vdso.h>
 
 #include "omap_hwmod.h"
 #include "omap_device.h"
@@ -71,6 +72,25 @@ static struct clock_event_device clockevent_gpt;
 /* Clockevent hwmod for am335x and am437x suspend */
 struct omap_hwmod *clockevent_gpt_hwmod;
 
+/*
+ * In match mode the oneshot counter is left running with compare enabled
+ * and autoreload from 0, and an event is programmed by restarting the
+ * count through the trigger register and setting the match value.  Both
+ * are posted writes to registers nothing else touches, so there is no
+ * counter reload and no control register rewrite per event, and the match
+ * write is skipped when the delta is the same as last time.  Boot with
+ * omap_clkevt_match=0 to go back to loading the counter on every event.
+ */
+static bool clkev_match_mode = true;
+static u32 clkev_match;
+static u32 clkev_int_mask = OMAP_TIMER_INT_OVERFLOW;
+
+static int __init omap2_clkevt_match_setup(char *str)
+{
+	return strtobool(str, &clkev_match_mode);
+}
+early_param("omap_clkevt_match", omap2_clkevt_match_setup);
+
 #ifdef CONFIG_SOC_HAS_REALTIME_COUNTER
 static unsigned long arch_timer_freq;
 
@@ -84,7 +104,7 @@ static irqreturn_t omap2_gp_timer_interrupt(int irq, void *dev_id)
 {
 	struct clock_event_device *evt = &clockevent_gpt;
 
-	__omap_dm_timer_write_status(&clkev, OMAP_TIMER_INT_OVERFLOW);
+	__omap_dm_timer_write_status(&clkev, clkev_int_mask);
 
 	evt->event_handler(evt);
 	return IRQ_HANDLED;
@@ -105,15 +125,59 @@ static int omap2_gp_timer_set_next_event(unsigned long cycles,
 	return 0;
 }
 
+static int omap2_gp_timer_set_next_match(unsigned long cycles,
+					 struct clock_event_device *evt)
+{
+	u32 pend = WP_TTGR;
+
+	/* a steady hrtimer rate keeps asking for the same delta */
+	if (cycles != clkev_match)
+		pend |= WP_TMAR;
+
+	/* one wait for both, the writes below then go straight out */
+	while (readl_relaxed(clkev.pend) & pend)
+		cpu_relax();
+
+	/*
+	 * Restart the count before moving the match value.  A counter
+	 * starting from 0 could only hit the old match, at least min_delta
+	 * away, before the new one lands, and an early event just gets
+	 * reprogrammed by the hrtimer code.
+	 */
+	__omap_dm_timer_write(&clkev, OMAP_TIMER_TRIGGER_REG, 0, 0);
+	if (cycles != clkev_match) {
+		__omap_dm_timer_write(&clkev, OMAP_TIMER_MATCH_REG, cycles, 0);
+		clkev_match = cycles;
+	}
+
+	return 0;
+}
+
+/* Move the clockevent between the overflow and the match interrupt */
+static void omap2_gp_timer_set_int(u32 mask)
+{
+	u32 old = clkev_int_mask & ~mask;
+
+	clkev_int_mask = mask;
+	/* v1 has a single enable register, written whole below */
+	if (old && clkev.revision != 1)
+		writel_relaxed(old, clkev.irq_dis);
+	__omap_dm_timer_int_enable(&clkev, mask);
+}
+
 static void omap2_gp_timer_set_mode(enum clock_event_mode mode,
 				    struct clock_event_device *evt)
 {
 	u32 period;
 
 	__omap_dm_timer_stop(&clkev, OMAP_TIMER_POSTED, clkev.rate);
+	if (clkev_match_mode)
+		__omap_dm_timer_write_status(&clkev, OMAP_TIMER_INT_MATCH);
 
 	switch (mode) {
 	case CLOCK_EVT_MODE_PERIODIC:
+		if (clkev_match_mode)
+			omap2_gp_timer_set_int(OMAP_TIMER_INT_OVERFLOW);
 		period = clkev.rate / HZ;
 		period -= 1;
 		/* Looks like we need to first set the load value separately */
@@ -124,6 +188,19 @@ static void omap2_gp_timer_set_mode(enum clock_event_mode mode,
 					0xffffffff - period, OMAP_TIMER_POSTED);
 		break;
 	case CLOCK_EVT_MODE_ONESHOT:
+		if (!clkev_match_mode)
+			break;
+		omap2_gp_timer_set_int(OMAP_TIMER_INT_MATCH);
+		/* nothing fires until set_next_event moves the match */
+		clkev_match = 0xffffffff;
+		__omap_dm_timer_write(&clkev, OMAP_TIMER_LOAD_REG, 0,
+				      OMAP_TIMER_POSTED);
+		__omap_dm_timer_write(&clkev, OMAP_TIMER_MATCH_REG, clkev_match,
+				      OMAP_TIMER_POSTED);
+		__omap_dm_timer_load_start(&clkev, OMAP_TIMER_CTRL_CE |
+					   OMAP_TIMER_CTRL_AR |
+					   OMAP_TIMER_CTRL_ST,
+					   0, OMAP_TIMER_POSTED);
 		break;
 	case CLOCK_EVT_MODE_UNUSED:
 	case CLOCK_EVT_MODE_SHUTDOWN:
@@ -146,7 +223,7 @@ static void omap_clkevt_unidle(struct clock_event_device *unused)
 		return;
 
 	omap_hwmod_enable(clockevent_gpt_hwmod);
-	__omap_dm_timer_int_enable(&clkev, OMAP_TIMER_INT_OVERFLOW);
+	__omap_dm_timer_int_enable(&clkev, clkev_int_mask);
 }
 
 static struct clock_event_device clockevent_gpt = {
@@ -274,6 +351,8 @@ static int __init omap_dm_timer_init_one(struct omap_dm_timer *timer,
 			return -ENXIO;
 
 		timer->io_base = of_iomap(np, 0);
+		if (!of_address_to_resource(np, 0, &mem))
+			timer->phys_base = mem.start;
 
 		of_node_put(np);
 	} else {
@@ -304,6 +383,7 @@ static int __init omap_dm_timer_init_one(struct omap_dm_timer *timer,
 
 		/* Static mapping, never released */
 		timer->io_base = ioremap(mem.start, mem.end - mem.start);
+		timer->phys_base = mem.start;
 	}
 
 	if (!timer->io_base)
@@ -369,6 +449,9 @@ static void __init omap2_gp_clockevent_init(int gptimer_id,
 
 	__omap_dm_timer_int_enable(&clkev, OMAP_TIMER_INT_OVERFLOW);
 
+	if (clkev_match_mode)
+		clockevent_gpt.set_next_event = omap2_gp_timer_set_next_match;
+
 	clockevent_gpt.cpumask = cpu_possible_mask;
 	clockevent_gpt.irq = omap_dm_timer_get_irq(&clkev);
 	clockevents_config_and_register(&clockevent_gpt, clkev.rate,
@@ -544,6 +627,15 @@ static void __init omap2_gptimer_clocksource_init(int gptimer_id,
 	else
 		pr_info("OMAP clocksource: %s at %lu Hz\n",
 			clocksource_gpt.name, clksrc.rate);
+
+	/*
+	 * The counter reads back without side effects and the timer has
+	 * its own page, so let the vDSO read it straight from userspace.
+	 */
+	if (clksrc.phys_base)
+		arm_vdso_set_mmio_counter(&clocksource_gpt, clksrc.phys_base +
+					  (clksrc.func_base - clksrc.io_base) +
+					  (OMAP_TIMER_COUNTER_REG & 0xff));
 }
 
 #ifdef CONFIG_SOC_HAS_REALTIME_COUNTER
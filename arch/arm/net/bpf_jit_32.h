@@ -52,12 +52,19 @@
 #define SRTYPE_ASR		2
 #define SRTYPE_ROR		3
 
+#define ARM_INST_ADC_R		0x00a00000
+#define ARM_INST_ADC_I		0x02a00000
+
 #define ARM_INST_ADD_R		0x00800000
 #define ARM_INST_ADD_I		0x02800000
+#define ARM_INST_ADDS_R		0x00900000
 
 #define ARM_INST_AND_R		0x00000000
 #define ARM_INST_AND_I		0x02000000
 
+#define ARM_INST_ASR_I		0x01a00040
+#define ARM_INST_ASR_R		0x01a00050
+
 #define ARM_INST_BIC_R		0x01c00000
 #define ARM_INST_BIC_I		0x03c00000
 
@@ -75,6 +82,10 @@
 #define ARM_INST_LDRB_R		0x07d00000
 #define ARM_INST_LDRH_I		0x01d000b0
 #define ARM_INST_LDR_I		0x05900000
+#define ARM_INST_LDRD_I		0x01c000d0
+
+#define ARM_INST_LDREX		0x01900f9f
+#define ARM_INST_LDREXD		0x01b00f9f
 
 #define ARM_INST_LDM		0x08900000
 
@@ -90,22 +101,43 @@
 #define ARM_INST_MOVT		0x03400000
 
 #define ARM_INST_MUL		0x00000090
+#define ARM_INST_MLA		0x00200090
+#define ARM_INST_MLS		0x00600090
+
+#define ARM_INST_MVN_R		0x01e00000
+#define ARM_INST_MVN_I		0x03e00000
 
 #define ARM_INST_POP		0x08bd0000
 #define ARM_INST_PUSH		0x092d0000
 
 #define ARM_INST_ORR_R		0x01800000
 #define ARM_INST_ORR_I		0x03800000
+#define ARM_INST_ORRS_R		0x01900000
 
 #define ARM_INST_REV		0x06bf0f30
 #define ARM_INST_REV16		0x06bf0fb0
 
 #define ARM_INST_RSB_I		0x02600000
+#define ARM_INST_RSBS_I		0x02700000
+#define ARM_INST_RSC_I		0x02e00000
+
+#define ARM_INST_SBC_R		0x00c00000
+#define ARM_INST_SBCS_R		0x00d00000
 
 #define ARM_INST_SUB_R		0x00400000
 #define ARM_INST_SUB_I		0x02400000
+#define ARM_INST_SUBS_R		0x00500000
+#define ARM_INST_SUBS_I		0x02500000
 
 #define ARM_INST_STR_I		0x05800000
+#define ARM_INST_STRB_I		0x05c00000
+#define ARM_INST_STRH_I		0x01c000b0
+#define ARM_INST_STRD_I		0x01c000f0
+
+#define ARM_INST_STREX		0x01800f90
+#define ARM_INST_STREXD		0x01a00f90
+
+#define ARM_INST_TEQ_I		0x03300000
 
 #define ARM_INST_TST_R		0x01100000
 #define ARM_INST_TST_I		0x03100000
@@ -114,6 +146,11 @@
 
 #define ARM_INST_UMULL		0x00800090
 
+#define ARM_INST_UXTH		0x06ff0070
+
+/* add to, rather than subtract, the offset of a load/store */
+#define ARM_INST_LDST_U		0x00800000
+
 /*
  * Use a suitable undefined instruction to use for ARM/Thumb2 faulting.
  * We need to be careful not to conflict with those used by other modules
@@ -133,12 +170,19 @@
 /* immediate */
 #define _AL3_I(op, rd, rn, imm)	((op ## _I) | (rd) << 12 | (rn) << 16 | (imm))
 
+#define ARM_ADC_R(rd, rn, rm)	_AL3_R(ARM_INST_ADC, rd, rn, rm)
+#define ARM_ADC_I(rd, rn, imm)	_AL3_I(ARM_INST_ADC, rd, rn, imm)
+
 #define ARM_ADD_R(rd, rn, rm)	_AL3_R(ARM_INST_ADD, rd, rn, rm)
 #define ARM_ADD_I(rd, rn, imm)	_AL3_I(ARM_INST_ADD, rd, rn, imm)
+#define ARM_ADDS_R(rd, rn, rm)	_AL3_R(ARM_INST_ADDS, rd, rn, rm)
 
 #define ARM_AND_R(rd, rn, rm)	_AL3_R(ARM_INST_AND, rd, rn, rm)
 #define ARM_AND_I(rd, rn, imm)	_AL3_I(ARM_INST_AND, rd, rn, imm)
 
+#define ARM_ASR_R(rd, rn, rm)	(_AL3_R(ARM_INST_ASR, rd, 0, rn) | (rm) << 8)
+#define ARM_ASR_I(rd, rn, imm)	(_AL3_I(ARM_INST_ASR, rd, 0, rn) | (imm) << 7)
+
 #define ARM_BIC_R(rd, rn, rm)	_AL3_R(ARM_INST_BIC, rd, rn, rm)
 #define ARM_BIC_I(rd, rn, imm)	_AL3_I(ARM_INST_BIC, rd, rn, imm)
 
@@ -161,6 +205,13 @@
 #define ARM_LDRH_I(rt, rn, off)	(ARM_INST_LDRH_I | (rt) << 12 | (rn) << 16 \
 				 | (((off) & 0xf0) << 4) | ((off) & 0xf))
 
+#define ARM_LDRD_I(rt, rn, off)	(ARM_INST_LDRD_I | (rt) << 12 \
+				 | (rn) << 16 | (((off) & 0xf0) << 4) \
+				 | ((off) & 0xf))
+
+#define ARM_LDREX(rt, rn)	(ARM_INST_LDREX | (rt) << 12 | (rn) << 16)
+#define ARM_LDREXD(rt, rn)	(ARM_INST_LDREXD | (rt) << 12 | (rn) << 16)
+
 #define ARM_LDM(rn, regs)	(ARM_INST_LDM | (rn) << 16 | (regs))
 
 #define ARM_LSL_R(rd, rn, rm)	(_AL3_R(ARM_INST_LSL, rd, 0, rn) | (rm) << 8)
@@ -179,6 +230,14 @@
 	(ARM_INST_MOVT | ((imm) >> 12) << 16 | (rd) << 12 | ((imm) & 0x0fff))
 
 #define ARM_MUL(rd, rm, rn)	(ARM_INST_MUL | (rd) << 16 | (rm) << 8 | (rn))
+/* rd = rn * rm + ra, and rd = ra - rn * rm */
+#define ARM_MLA(rd, rn, rm, ra)	(ARM_INST_MLA | (rd) << 16 | (ra) << 12 \
+				 | (rm) << 8 | (rn))
+#define ARM_MLS(rd, rn, rm, ra)	(ARM_INST_MLS | (rd) << 16 | (ra) << 12 \
+				 | (rm) << 8 | (rn))
+
+#define ARM_MVN_R(rd, rm)	_AL3_R(ARM_INST_MVN, rd, 0, rm)
+#define ARM_MVN_I(rd, imm)	_AL3_I(ARM_INST_MVN, rd, 0, imm)
 
 #define ARM_POP(regs)		(ARM_INST_POP | (regs))
 #define ARM_PUSH(regs)		(ARM_INST_PUSH | (regs))
@@ -187,17 +246,38 @@
 #define ARM_ORR_I(rd, rn, imm)	_AL3_I(ARM_INST_ORR, rd, rn, imm)
 #define ARM_ORR_S(rd, rn, rm, type, rs)	\
 	(ARM_ORR_R(rd, rn, rm) | (type) << 5 | (rs) << 7)
+/* orr with rm shifted by register rs */
+#define ARM_ORR_SR(rd, rn, rm, type, rs)	\
+	(ARM_ORR_R(rd, rn, rm) | (type) << 5 | (rs) << 8 | 1 << 4)
+#define ARM_ORRS_R(rd, rn, rm)	_AL3_R(ARM_INST_ORRS, rd, rn, rm)
 
 #define ARM_REV(rd, rm)		(ARM_INST_REV | (rd) << 12 | (rm))
 #define ARM_REV16(rd, rm)	(ARM_INST_REV16 | (rd) << 12 | (rm))
 
 #define ARM_RSB_I(rd, rn, imm)	_AL3_I(ARM_INST_RSB, rd, rn, imm)
+#define ARM_RSBS_I(rd, rn, imm)	_AL3_I(ARM_INST_RSBS, rd, rn, imm)
+#define ARM_RSC_I(rd, rn, imm)	_AL3_I(ARM_INST_RSC, rd, rn, imm)
+
+#define ARM_SBC_R(rd, rn, rm)	_AL3_R(ARM_INST_SBC, rd, rn, rm)
+#define ARM_SBCS_R(rd, rn, rm)	_AL3_R(ARM_INST_SBCS, rd, rn, rm)
 
 #define ARM_SUB_R(rd, rn, rm)	_AL3_R(ARM_INST_SUB, rd, rn, rm)
 #define ARM_SUB_I(rd, rn, imm)	_AL3_I(ARM_INST_SUB, rd, rn, imm)
+#define ARM_SUBS_R(rd, rn, rm)	_AL3_R(ARM_INST_SUBS, rd, rn, rm)
+#define ARM_SUBS_I(rd, rn, imm)	_AL3_I(ARM_INST_SUBS, rd, rn, imm)
 
 #define ARM_STR_I(rt, rn, off)	(ARM_INST_STR_I | (rt) << 12 | (rn) << 16 \
 				 | (off))
+#define ARM_STRD_I(rt, rn, off)	(ARM_INST_STRD_I | (rt) << 12 \
+				 | (rn) << 16 | (((off) & 0xf0) << 4) \
+				 | ((off) & 0xf))
+
+#define ARM_STREX(rd, rt, rn)	(ARM_INST_STREX | (rd) << 12 | (rn) << 16 \
+				 | (rt))
+#define ARM_STREXD(rd, rt, rn)	(ARM_INST_STREXD | (rd) << 12 | (rn) << 16 \
+				 | (rt))
+
+#define ARM_TEQ_I(rn, imm)	_AL3_I(ARM_INST_TEQ, 0, rn, imm)
 
 #define ARM_TST_R(rn, rm)	_AL3_R(ARM_INST_TST, 0, rn, rm)
 #define ARM_TST_I(rn, imm)	_AL3_I(ARM_INST_TST, 0, rn, imm)
@@ -207,4 +287,6 @@
 #define ARM_UMULL(rd_lo, rd_hi, rn, rm)	(ARM_INST_UMULL | (rd_hi) << 16 \
 					 | (rd_lo) << 12 | (rm) << 8 | rn)
 
+#define ARM_UXTH(rd, rm)	(ARM_INST_UXTH | (rd) << 12 | (rm))
+
 #endif /* PFILTER_OPCODES_ARM_H */
@@ -0,0 +1,1114 @@
+/*
+ * Just-In-Time compiler for eBPF programs on 32bit ARM
+ *
+ * Classic BPF filters are still handled by bpf_jit_32.c; this compiles
+ * the internal BPF programs loaded through bpf(2), including the ones
+ * for tc cls_bpf/act_bpf and kprobe tracing.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; version 2 of the License.
+ */
+
+#include <linux/bitops.h>
+#include <linux/compiler.h>
+#include <linux/errno.h>
+#include <linux/filter.h>
+#include <linux/math64.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include <asm/cacheflush.h>
+#include <asm/hwcap.h>
+#include <asm/opcodes.h>
+#include <asm/unaligned.h>
+
+#include "bpf_jit_32.h"
+
+/*
+ * eBPF registers are 64 bit wide, each one is a pair of ARM registers
+ * holding the low and the high word.
+ *
+ * BPF_REG_6 (the context), BPF_REG_7 and BPF_REG_8 live in the callee
+ * saved pairs r4:r5, r6:r7 and r8:r9.  The other registers are kept in
+ * the stack frame and loaded into r0:r1 (destination) and r2:r3 (source)
+ * around each instruction; ip, lr and r10 are scratch.
+ *
+ * Frame layout, from sp up:
+ *
+ *	  0	BPF_REG_3
+ *	  8	BPF_REG_4
+ *	 16	BPF_REG_5
+ *	 24	BPF_REG_0
+ *	 32	BPF_REG_1
+ *	 40	BPF_REG_2
+ *	 48	BPF_REG_9
+ *	 56	BPF_REG_FP
+ *	 64	BPF stack, BPF_REG_FP points just past its end
+ *	576	saved r4-r10, lr
+ *
+ * BPF_REG_3..5 sit where AAPCS wants the stack arguments of a call taking
+ * five u64, so a helper call only has to load BPF_REG_1 and BPF_REG_2.
+ */
+
+#define STACKED		-1
+
+#define SCRATCH_SIZE	64
+#define FRAME_SIZE	(SCRATCH_SIZE + MAX_BPF_STACK)
+
+#define SAVED_REGS	((1 << ARM_R4) | (1 << ARM_R5) | (1 << ARM_R6) | \
+			 (1 << ARM_R7) | (1 << ARM_R8) | (1 << ARM_R9) | \
+			 (1 << ARM_R10))
+
+static const s8 bpf2a32[MAX_BPF_REG][2] = {
+	[BPF_REG_0]	= { STACKED, STACKED },
+	[BPF_REG_1]	= { STACKED, STACKED },
+	[BPF_REG_2]	= { STACKED, STACKED },
+	[BPF_REG_3]	= { STACKED, STACKED },
+	[BPF_REG_4]	= { STACKED, STACKED },
+	[BPF_REG_5]	= { STACKED, STACKED },
+	[BPF_REG_6]	= { ARM_R4, ARM_R5 },
+	[BPF_REG_7]	= { ARM_R6, ARM_R7 },
+	[BPF_REG_8]	= { ARM_R8, ARM_R9 },
+	[BPF_REG_9]	= { STACKED, STACKED },
+	[BPF_REG_FP]	= { STACKED, STACKED },
+};
+
+static const u8 bpf2slot[MAX_BPF_REG] = {
+	[BPF_REG_3]	= 0,
+	[BPF_REG_4]	= 8,
+	[BPF_REG_5]	= 16,
+	[BPF_REG_0]	= 24,
+	[BPF_REG_1]	= 32,
+	[BPF_REG_2]	= 40,
+	[BPF_REG_9]	= 48,
+	[BPF_REG_FP]	= 56,
+};
+
+static const s8 tmp_dst[2] = { ARM_R0, ARM_R1 };
+static const s8 tmp_src[2] = { ARM_R2, ARM_R3 };
+
+struct jit_ctx {
+	const struct bpf_prog *prog;
+	unsigned int idx;
+	unsigned int epilogue_offset;
+	u32 *offsets;
+	u32 *target;
+};
+
+/*
+ * Wrappers for the operations the JITed code calls out for, so that it
+ * never has to deal with the EABI helper routines directly.
+ */
+static u32 jit_udiv32(u32 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+static u32 jit_mod32(u32 dividend, u32 divisor)
+{
+	return dividend % divisor;
+}
+
+static u64 jit_udiv64(u64 dividend, u64 divisor)
+{
+	return div64_u64(dividend, divisor);
+}
+
+static u64 jit_mod64(u64 dividend, u64 divisor)
+{
+	u64 rem;
+
+	div64_u64_rem(dividend, divisor, &rem);
+	return rem;
+}
+
+/*
+ * BPF_LD | BPF_ABS and BPF_LD | BPF_IND: the value in the low word, and
+ * a non-zero high word if the packet is too short.
+ */
+static u64 jit_load_skb(const struct sk_buff *skb, int off, unsigned int size)
+{
+	u32 buf;
+	void *ptr;
+
+	ptr = bpf_load_pointer(skb, off, size, &buf);
+	if (unlikely(!ptr))
+		return 1ULL << 32;
+
+	switch (size) {
+	case 1:
+		return *(u8 *)ptr;
+	case 2:
+		return get_unaligned_be16(ptr);
+	default:
+		return get_unaligned_be32(ptr);
+	}
+}
+
+static unsigned int ld_size(u8 size)
+{
+	switch (size) {
+	case BPF_B:
+		return 1;
+	case BPF_H:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+static inline void _emit(int cond, u32 inst, struct jit_ctx *ctx)
+{
+	inst |= (cond << 28);
+	inst = __opcode_to_mem_arm(inst);
+
+	if (ctx->target != NULL)
+		ctx->target[ctx->idx] = inst;
+
+	ctx->idx++;
+}
+
+static inline void emit(u32 inst, struct jit_ctx *ctx)
+{
+	_emit(ARM_COND_AL, inst, ctx);
+}
+
+static int16_t imm8m(u32 x)
+{
+	u32 rot;
+
+	for (rot = 0; rot < 16; rot++)
+		if ((x & ~ror32(0xff, 2 * rot)) == 0)
+			return rol32(x, 2 * rot) | (rot << 8);
+
+	return -1;
+}
+
+static void emit_mov_i(s8 rd, u32 val, struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(val);
+
+	if (imm12 >= 0) {
+		emit(ARM_MOV_I(rd, imm12), ctx);
+		return;
+	}
+
+	imm12 = imm8m(~val);
+	if (imm12 >= 0) {
+		emit(ARM_MVN_I(rd, imm12), ctx);
+		return;
+	}
+
+	emit(ARM_MOVW(rd, val & 0xffff), ctx);
+	if (val > 0xffff)
+		emit(ARM_MOVT(rd, val >> 16), ctx);
+}
+
+/* Load the sign extended 32-bit immediate of an instruction */
+static void emit_mov_i64(const s8 rd[2], s32 val, struct jit_ctx *ctx)
+{
+	emit_mov_i(rd[0], val, ctx);
+	emit_mov_i(rd[1], val < 0 ? ~0U : 0, ctx);
+}
+
+static void emit_call(u32 func, struct jit_ctx *ctx)
+{
+	emit_mov_i(ARM_IP, func, ctx);
+	emit(ARM_BLX_R(ARM_IP), ctx);
+}
+
+/* Offset of a branch at the current position to ARM instruction @tgt */
+static s32 b_imm(unsigned int tgt, struct jit_ctx *ctx)
+{
+	/* the targets are not known during the first pass */
+	if (ctx->target == NULL)
+		return 0;
+
+	/* the PC is two instructions ahead */
+	return tgt - (ctx->idx + 2);
+}
+
+/* Branch to BPF instruction @insn */
+static void emit_b_insn(int cond, unsigned int insn, struct jit_ctx *ctx)
+{
+	_emit(cond, ARM_B(b_imm(ctx->offsets[insn], ctx)), ctx);
+}
+
+/* Make the program return 0, as it does on division by zero */
+static void emit_ret0(int cond, struct jit_ctx *ctx)
+{
+	_emit(cond, ARM_MOV_I(ARM_R0, 0), ctx);
+	_emit(cond, ARM_B(b_imm(ctx->epilogue_offset + 1, ctx)), ctx);
+}
+
+static inline bool is_stacked(u8 reg)
+{
+	return bpf2a32[reg][0] == STACKED;
+}
+
+/* The ARM registers holding @reg, loaded into @tmp if it is stacked */
+static const s8 *get_reg64(u8 reg, const s8 *tmp, struct jit_ctx *ctx)
+{
+	if (!is_stacked(reg))
+		return bpf2a32[reg];
+
+	emit(ARM_LDRD_I(tmp[0], ARM_SP, bpf2slot[reg]), ctx);
+	return tmp;
+}
+
+static s8 get_reg32(u8 reg, s8 tmp, struct jit_ctx *ctx)
+{
+	if (!is_stacked(reg))
+		return bpf2a32[reg][0];
+
+	emit(ARM_LDR_I(tmp, ARM_SP, bpf2slot[reg]), ctx);
+	return tmp;
+}
+
+/* Where to compute a new value of @reg without loading the old one */
+static const s8 *dst_reg64(u8 reg, const s8 *tmp)
+{
+	return is_stacked(reg) ? tmp : bpf2a32[reg];
+}
+
+static void put_reg64(u8 reg, const s8 *src, struct jit_ctx *ctx)
+{
+	const s8 *rd = bpf2a32[reg];
+
+	if (is_stacked(reg)) {
+		emit(ARM_STRD_I(src[0], ARM_SP, bpf2slot[reg]), ctx);
+		return;
+	}
+
+	if (rd[0] != src[0])
+		emit(ARM_MOV_R(rd[0], src[0]), ctx);
+	if (rd[1] != src[1])
+		emit(ARM_MOV_R(rd[1], src[1]), ctx);
+}
+
+/* Store a 32-bit result, zero extended as all 32-bit ALU operations are */
+static void put_reg32(u8 reg, s8 src, struct jit_ctx *ctx)
+{
+	const s8 *rd = bpf2a32[reg];
+
+	if (is_stacked(reg)) {
+		emit(ARM_MOV_I(ARM_IP, 0), ctx);
+		emit(ARM_STR_I(src, ARM_SP, bpf2slot[reg]), ctx);
+		emit(ARM_STR_I(ARM_IP, ARM_SP, bpf2slot[reg] + 4), ctx);
+		return;
+	}
+
+	if (rd[0] != src)
+		emit(ARM_MOV_R(rd[0], src), ctx);
+	emit(ARM_MOV_I(rd[1], 0), ctx);
+}
+
+/* Immediate offset forms of the loads and stores, either sign */
+static u32 ldst_imm12(u32 inst, s8 rt, s8 rn, s16 off)
+{
+	if (off < 0) {
+		inst &= ~ARM_INST_LDST_U;
+		off = -off;
+	}
+	return inst | rt << 12 | rn << 16 | off;
+}
+
+static u32 ldst_imm8(u32 inst, s8 rt, s8 rn, s16 off)
+{
+	if (off < 0) {
+		inst &= ~ARM_INST_LDST_U;
+		off = -off;
+	}
+	return inst | rt << 12 | rn << 16 | (off & 0xf0) << 4 | (off & 0xf);
+}
+
+/*
+ * Returns the base register to use with offset @*off for an access of
+ * @size, computing the address into ip if the offset does not fit.
+ */
+static s8 ldst_base(u8 size, s8 base, s16 *off, struct jit_ctx *ctx)
+{
+	int max;
+
+	switch (size) {
+	case BPF_H:
+		max = 0xff;
+		break;
+	case BPF_DW:
+		max = 0xfff - 4;
+		break;
+	default:
+		max = 0xfff;
+		break;
+	}
+
+	if (-max <= *off && *off <= max)
+		return base;
+
+	emit_mov_i(ARM_IP, (s32)*off, ctx);
+	emit(ARM_ADD_R(ARM_IP, base, ARM_IP), ctx);
+	*off = 0;
+	return ARM_IP;
+}
+
+static void emit_ldx(u8 size, const s8 *rd, s8 base, s16 off,
+		     struct jit_ctx *ctx)
+{
+	base = ldst_base(size, base, &off, ctx);
+
+	switch (size) {
+	case BPF_B:
+		emit(ldst_imm12(ARM_INST_LDRB_I, rd[0], base, off), ctx);
+		break;
+	case BPF_H:
+		emit(ldst_imm8(ARM_INST_LDRH_I, rd[0], base, off), ctx);
+		break;
+	case BPF_W:
+		emit(ldst_imm12(ARM_INST_LDR_I, rd[0], base, off), ctx);
+		break;
+	case BPF_DW:
+		/* the memory may be unaligned, so no ldrd; mind rd == base */
+		if (rd[0] == base) {
+			emit(ldst_imm12(ARM_INST_LDR_I, rd[1], base, off + 4),
+			     ctx);
+			emit(ldst_imm12(ARM_INST_LDR_I, rd[0], base, off), ctx);
+		} else {
+			emit(ldst_imm12(ARM_INST_LDR_I, rd[0], base, off), ctx);
+			emit(ldst_imm12(ARM_INST_LDR_I, rd[1], base, off + 4),
+			     ctx);
+		}
+		return;
+	}
+
+	emit(ARM_MOV_I(rd[1], 0), ctx);
+}
+
+static void emit_stx(u8 size, const s8 *rs, s8 base, s16 off,
+		     struct jit_ctx *ctx)
+{
+	base = ldst_base(size, base, &off, ctx);
+
+	switch (size) {
+	case BPF_B:
+		emit(ldst_imm12(ARM_INST_STRB_I, rs[0], base, off), ctx);
+		break;
+	case BPF_H:
+		emit(ldst_imm8(ARM_INST_STRH_I, rs[0], base, off), ctx);
+		break;
+	case BPF_W:
+		emit(ldst_imm12(ARM_INST_STR_I, rs[0], base, off), ctx);
+		break;
+	case BPF_DW:
+		emit(ldst_imm12(ARM_INST_STR_I, rs[0], base, off), ctx);
+		emit(ldst_imm12(ARM_INST_STR_I, rs[1], base, off + 4), ctx);
+		break;
+	}
+}
+
+/* *(u32/u64 *)(dst + off) += src, like atomic_add()/atomic64_add() */
+static void emit_xadd(u8 size, u8 dst, const s8 *rs, s16 off,
+		      struct jit_ctx *ctx)
+{
+	s8 base = get_reg32(dst, ARM_IP, ctx);
+
+	if (off) {
+		emit_mov_i(ARM_LR, (s32)off, ctx);
+		emit(ARM_ADD_R(ARM_IP, base, ARM_LR), ctx);
+	} else if (base != ARM_IP) {
+		emit(ARM_MOV_R(ARM_IP, base), ctx);
+	}
+
+	if (size == BPF_W) {
+		emit(ARM_LDREX(ARM_R0, ARM_IP), ctx);
+		emit(ARM_ADD_R(ARM_R0, ARM_R0, rs[0]), ctx);
+		emit(ARM_STREX(ARM_LR, ARM_R0, ARM_IP), ctx);
+		emit(ARM_TEQ_I(ARM_LR, 0), ctx);
+		_emit(ARM_COND_NE, ARM_B(-6), ctx);
+	} else {
+		emit(ARM_LDREXD(ARM_R0, ARM_IP), ctx);
+		emit(ARM_ADDS_R(ARM_R0, ARM_R0, rs[0]), ctx);
+		emit(ARM_ADC_R(ARM_R1, ARM_R1, rs[1]), ctx);
+		emit(ARM_STREXD(ARM_LR, ARM_R0, ARM_IP), ctx);
+		emit(ARM_TEQ_I(ARM_LR, 0), ctx);
+		_emit(ARM_COND_NE, ARM_B(-7), ctx);
+	}
+}
+
+static void emit_alu32(u8 op, s8 rd, s8 rs, struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_ADD:
+		emit(ARM_ADD_R(rd, rd, rs), ctx);
+		break;
+	case BPF_SUB:
+		emit(ARM_SUB_R(rd, rd, rs), ctx);
+		break;
+	case BPF_AND:
+		emit(ARM_AND_R(rd, rd, rs), ctx);
+		break;
+	case BPF_OR:
+		emit(ARM_ORR_R(rd, rd, rs), ctx);
+		break;
+	case BPF_XOR:
+		emit(ARM_EOR_R(rd, rd, rs), ctx);
+		break;
+	case BPF_MUL:
+		emit(ARM_MUL(rd, rd, rs), ctx);
+		break;
+	case BPF_LSH:
+		emit(ARM_LSL_R(rd, rd, rs), ctx);
+		break;
+	case BPF_RSH:
+		emit(ARM_LSR_R(rd, rd, rs), ctx);
+		break;
+	}
+}
+
+static void emit_alu64(u8 op, const s8 *rd, const s8 *rs, struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_ADD:
+		emit(ARM_ADDS_R(rd[0], rd[0], rs[0]), ctx);
+		emit(ARM_ADC_R(rd[1], rd[1], rs[1]), ctx);
+		break;
+	case BPF_SUB:
+		emit(ARM_SUBS_R(rd[0], rd[0], rs[0]), ctx);
+		emit(ARM_SBC_R(rd[1], rd[1], rs[1]), ctx);
+		break;
+	case BPF_AND:
+		emit(ARM_AND_R(rd[0], rd[0], rs[0]), ctx);
+		emit(ARM_AND_R(rd[1], rd[1], rs[1]), ctx);
+		break;
+	case BPF_OR:
+		emit(ARM_ORR_R(rd[0], rd[0], rs[0]), ctx);
+		emit(ARM_ORR_R(rd[1], rd[1], rs[1]), ctx);
+		break;
+	case BPF_XOR:
+		emit(ARM_EOR_R(rd[0], rd[0], rs[0]), ctx);
+		emit(ARM_EOR_R(rd[1], rd[1], rs[1]), ctx);
+		break;
+	case BPF_MUL:
+		/* hi = lo * rs_hi + hi * rs_lo + carry of lo * rs_lo */
+		emit(ARM_MUL(ARM_IP, rs[1], rd[0]), ctx);
+		emit(ARM_MLA(ARM_IP, rd[1], rs[0], ARM_IP), ctx);
+		emit(ARM_UMULL(rd[0], ARM_LR, rd[0], rs[0]), ctx);
+		emit(ARM_ADD_R(rd[1], ARM_IP, ARM_LR), ctx);
+		break;
+	}
+}
+
+/*
+ * 64-bit shifts by a register.  ARM register shifts use the bottom byte
+ * of the amount and produce 0 (or the sign) for 32 and more, so the
+ * cross terms vanish on their own for the half they do not apply to.
+ */
+static void emit_shift64_r(u8 op, const s8 *rd, s8 rs, struct jit_ctx *ctx)
+{
+	emit(ARM_AND_I(ARM_R10, rs, 63), ctx);
+
+	switch (op) {
+	case BPF_LSH:
+		emit(ARM_SUB_I(ARM_IP, ARM_R10, 32), ctx);
+		emit(ARM_RSB_I(ARM_LR, ARM_R10, 32), ctx);
+		emit(ARM_LSL_R(rd[1], rd[1], ARM_R10), ctx);
+		emit(ARM_ORR_SR(rd[1], rd[1], rd[0], SRTYPE_LSL, ARM_IP), ctx);
+		emit(ARM_ORR_SR(rd[1], rd[1], rd[0], SRTYPE_LSR, ARM_LR), ctx);
+		emit(ARM_LSL_R(rd[0], rd[0], ARM_R10), ctx);
+		break;
+	case BPF_RSH:
+		emit(ARM_SUB_I(ARM_IP, ARM_R10, 32), ctx);
+		emit(ARM_RSB_I(ARM_LR, ARM_R10, 32), ctx);
+		emit(ARM_LSR_R(rd[0], rd[0], ARM_R10), ctx);
+		emit(ARM_ORR_SR(rd[0], rd[0], rd[1], SRTYPE_LSL, ARM_LR), ctx);
+		emit(ARM_ORR_SR(rd[0], rd[0], rd[1], SRTYPE_LSR, ARM_IP), ctx);
+		emit(ARM_LSR_R(rd[1], rd[1], ARM_R10), ctx);
+		break;
+	case BPF_ARSH:
+		/* an arithmetic shift by a "negative" amount is not 0 */
+		emit(ARM_RSB_I(ARM_LR, ARM_R10, 32), ctx);
+		emit(ARM_SUBS_I(ARM_IP, ARM_R10, 32), ctx);
+		emit(ARM_LSR_R(rd[0], rd[0], ARM_R10), ctx);
+		emit(ARM_ORR_SR(rd[0], rd[0], rd[1], SRTYPE_LSL, ARM_LR), ctx);
+		_emit(ARM_COND_PL,
+		      ARM_ORR_SR(rd[0], rd[0], rd[1], SRTYPE_ASR, ARM_IP), ctx);
+		emit(ARM_ASR_R(rd[1], rd[1], ARM_R10), ctx);
+		break;
+	}
+}
+
+static void emit_shift64_i(u8 op, const s8 *rd, u32 k, struct jit_ctx *ctx)
+{
+	k &= 63;
+	if (!k)
+		return;
+
+	switch (op) {
+	case BPF_LSH:
+		if (k < 32) {
+			emit(ARM_LSL_I(rd[1], rd[1], k), ctx);
+			emit(ARM_ORR_S(rd[1], rd[1], rd[0], SRTYPE_LSR, 32 - k),
+			     ctx);
+			emit(ARM_LSL_I(rd[0], rd[0], k), ctx);
+		} else {
+			emit(ARM_LSL_I(rd[1], rd[0], k - 32), ctx);
+			emit(ARM_MOV_I(rd[0], 0), ctx);
+		}
+		break;
+	case BPF_RSH:
+		if (k < 32) {
+			emit(ARM_LSR_I(rd[0], rd[0], k), ctx);
+			emit(ARM_ORR_S(rd[0], rd[0], rd[1], SRTYPE_LSL, 32 - k),
+			     ctx);
+			emit(ARM_LSR_I(rd[1], rd[1], k), ctx);
+		} else {
+			/* an immediate LSR #0 would mean LSR #32 */
+			if (k == 32)
+				emit(ARM_MOV_R(rd[0], rd[1]), ctx);
+			else
+				emit(ARM_LSR_I(rd[0], rd[1], k - 32), ctx);
+			emit(ARM_MOV_I(rd[1], 0), ctx);
+		}
+		break;
+	case BPF_ARSH:
+		if (k < 32) {
+			emit(ARM_LSR_I(rd[0], rd[0], k), ctx);
+			emit(ARM_ORR_S(rd[0], rd[0], rd[1], SRTYPE_LSL, 32 - k),
+			     ctx);
+			emit(ARM_ASR_I(rd[1], rd[1], k), ctx);
+		} else {
+			if (k == 32)
+				emit(ARM_MOV_R(rd[0], rd[1]), ctx);
+			else
+				emit(ARM_ASR_I(rd[0], rd[1], k - 32), ctx);
+			emit(ARM_ASR_I(rd[1], rd[1], 31), ctx);
+		}
+		break;
+	}
+}
+
+/* 32-bit division and modulo, @rd = @rd op @rs */
+static void emit_udiv32(u8 op, s8 rd, s8 rs, struct jit_ctx *ctx)
+{
+	if (elf_hwcap & HWCAP_IDIVA) {
+		if (op == BPF_DIV) {
+			emit(ARM_UDIV(rd, rd, rs), ctx);
+		} else {
+			emit(ARM_UDIV(ARM_IP, rd, rs), ctx);
+			emit(ARM_MLS(rd, ARM_IP, rs, rd), ctx);
+		}
+		return;
+	}
+
+	/* rs is never r0, see the callers */
+	if (rs != ARM_R1)
+		emit(ARM_MOV_R(ARM_R1, rs), ctx);
+	if (rd != ARM_R0)
+		emit(ARM_MOV_R(ARM_R0, rd), ctx);
+	emit_call((u32)(op == BPF_DIV ? jit_udiv32 : jit_mod32), ctx);
+	if (rd != ARM_R0)
+		emit(ARM_MOV_R(rd, ARM_R0), ctx);
+}
+
+/* 64-bit division and modulo, r0:r1 = @rd op @rs */
+static void emit_udiv64(u8 op, const s8 *rd, const s8 *rs,
+			struct jit_ctx *ctx)
+{
+	if (rs[0] != ARM_R2) {
+		emit(ARM_MOV_R(ARM_R2, rs[0]), ctx);
+		emit(ARM_MOV_R(ARM_R3, rs[1]), ctx);
+	}
+	if (rd[0] != ARM_R0) {
+		emit(ARM_MOV_R(ARM_R0, rd[0]), ctx);
+		emit(ARM_MOV_R(ARM_R1, rd[1]), ctx);
+	}
+	emit_call((u32)(op == BPF_DIV ? jit_udiv64 : jit_mod64), ctx);
+}
+
+static void emit_cond_jmp(u8 op, const s8 *rd, const s8 *rs,
+			  unsigned int tgt, struct jit_ctx *ctx)
+{
+	int cond;
+
+	switch (op) {
+	case BPF_JEQ:
+	case BPF_JNE:
+	case BPF_JGT:
+	case BPF_JGE:
+		emit(ARM_CMP_R(rd[1], rs[1]), ctx);
+		_emit(ARM_COND_EQ, ARM_CMP_R(rd[0], rs[0]), ctx);
+		break;
+	case BPF_JSET:
+		emit(ARM_TST_R(rd[1], rs[1]), ctx);
+		_emit(ARM_COND_EQ, ARM_TST_R(rd[0], rs[0]), ctx);
+		break;
+	case BPF_JSGT:
+		/* rd > rs is rs < rd */
+		emit(ARM_SUBS_R(ARM_IP, rs[0], rd[0]), ctx);
+		emit(ARM_SBCS_R(ARM_IP, rs[1], rd[1]), ctx);
+		break;
+	case BPF_JSGE:
+		emit(ARM_SUBS_R(ARM_IP, rd[0], rs[0]), ctx);
+		emit(ARM_SBCS_R(ARM_IP, rd[1], rs[1]), ctx);
+		break;
+	}
+
+	switch (op) {
+	case BPF_JEQ:
+		cond = ARM_COND_EQ;
+		break;
+	case BPF_JNE:
+	case BPF_JSET:
+		cond = ARM_COND_NE;
+		break;
+	case BPF_JGT:
+		cond = ARM_COND_HI;
+		break;
+	case BPF_JGE:
+		cond = ARM_COND_HS;
+		break;
+	case BPF_JSGT:
+		cond = ARM_COND_LT;
+		break;
+	default: /* BPF_JSGE */
+		cond = ARM_COND_GE;
+		break;
+	}
+
+	emit_b_insn(cond, tgt, ctx);
+}
+
+static void build_prologue(struct jit_ctx *ctx)
+{
+	emit(ARM_PUSH(SAVED_REGS | (1 << ARM_LR)), ctx);
+	emit(ARM_SUB_I(ARM_SP, ARM_SP, imm8m(FRAME_SIZE)), ctx);
+
+	/* BPF_REG_1 = ctx */
+	emit(ARM_MOV_I(ARM_R1, 0), ctx);
+	emit(ARM_STRD_I(ARM_R0, ARM_SP, bpf2slot[BPF_REG_1]), ctx);
+
+	/* BPF_REG_FP = top of the BPF stack */
+	emit(ARM_ADD_I(ARM_R2, ARM_SP, imm8m(FRAME_SIZE)), ctx);
+	emit(ARM_MOV_I(ARM_R3, 0), ctx);
+	emit(ARM_STRD_I(ARM_R2, ARM_SP, bpf2slot[BPF_REG_FP]), ctx);
+
+	/* converted classic filters expect A and X to start out as 0 */
+	emit(ARM_MOV_I(ARM_R2, 0), ctx);
+	emit(ARM_STRD_I(ARM_R2, ARM_SP, bpf2slot[BPF_REG_A]), ctx);
+	emit(ARM_MOV_I(bpf2a32[BPF_REG_X][0], 0), ctx);
+	emit(ARM_MOV_I(bpf2a32[BPF_REG_X][1], 0), ctx);
+}
+
+static void build_epilogue(struct jit_ctx *ctx)
+{
+	/* the program returns the low word of BPF_REG_0 */
+	emit(ARM_LDR_I(ARM_R0, ARM_SP, bpf2slot[BPF_REG_0]), ctx);
+
+	/* emit_ret0() jumps here */
+	emit(ARM_ADD_I(ARM_SP, ARM_SP, imm8m(FRAME_SIZE)), ctx);
+	emit(ARM_POP(SAVED_REGS | (1 << ARM_PC)), ctx);
+}
+
+/*
+ * Returns 1 if the next instruction was consumed as well (BPF_LD_IMM64),
+ * 0 on success and a negative error for anything we cannot JIT.
+ */
+static int build_insn(const struct bpf_insn *insn, int i, struct jit_ctx *ctx)
+{
+	const u8 code = insn->code;
+	const u8 dst = insn->dst_reg;
+	const u8 src = insn->src_reg;
+	const s16 off = insn->off;
+	const s32 imm = insn->imm;
+	const s8 *rd, *rs;
+	s8 rd32, rs32;
+
+	switch (code) {
+	/* dst = src, dst = imm */
+	case BPF_ALU | BPF_MOV | BPF_X:
+		rs32 = get_reg32(src, ARM_R2, ctx);
+		put_reg32(dst, rs32, ctx);
+		break;
+	case BPF_ALU | BPF_MOV | BPF_K:
+		rd = dst_reg64(dst, tmp_dst);
+		emit_mov_i(rd[0], imm, ctx);
+		put_reg32(dst, rd[0], ctx);
+		break;
+	case BPF_ALU64 | BPF_MOV | BPF_X:
+		rs = get_reg64(src, tmp_src, ctx);
+		put_reg64(dst, rs, ctx);
+		break;
+	case BPF_ALU64 | BPF_MOV | BPF_K:
+		rd = dst_reg64(dst, tmp_dst);
+		emit_mov_i64(rd, imm, ctx);
+		put_reg64(dst, rd, ctx);
+		break;
+
+	/* dst = dst op src, dst = dst op imm */
+	case BPF_ALU | BPF_ADD | BPF_X:
+	case BPF_ALU | BPF_SUB | BPF_X:
+	case BPF_ALU | BPF_AND | BPF_X:
+	case BPF_ALU | BPF_OR | BPF_X:
+	case BPF_ALU | BPF_XOR | BPF_X:
+	case BPF_ALU | BPF_MUL | BPF_X:
+	case BPF_ALU | BPF_LSH | BPF_X:
+	case BPF_ALU | BPF_RSH | BPF_X:
+		rd32 = get_reg32(dst, ARM_R0, ctx);
+		rs32 = get_reg32(src, ARM_R2, ctx);
+		emit_alu32(BPF_OP(code), rd32, rs32, ctx);
+		put_reg32(dst, rd32, ctx);
+		break;
+	case BPF_ALU | BPF_ADD | BPF_K:
+	case BPF_ALU | BPF_SUB | BPF_K:
+	case BPF_ALU | BPF_AND | BPF_K:
+	case BPF_ALU | BPF_OR | BPF_K:
+	case BPF_ALU | BPF_XOR | BPF_K:
+	case BPF_ALU | BPF_MUL | BPF_K:
+		rd32 = get_reg32(dst, ARM_R0, ctx);
+		emit_mov_i(ARM_R2, imm, ctx);
+		emit_alu32(BPF_OP(code), rd32, ARM_R2, ctx);
+		put_reg32(dst, rd32, ctx);
+		break;
+	case BPF_ALU | BPF_LSH | BPF_K:
+	case BPF_ALU | BPF_RSH | BPF_K:
+		rd32 = get_reg32(dst, ARM_R0, ctx);
+		/* an immediate LSR #0 would mean LSR #32 */
+		if (imm & 31) {
+			if (BPF_OP(code) == BPF_LSH)
+				emit(ARM_LSL_I(rd32, rd32, imm & 31), ctx);
+			else
+				emit(ARM_LSR_I(rd32, rd32, imm & 31), ctx);
+		}
+		put_reg32(dst, rd32, ctx);
+		break;
+	case BPF_ALU64 | BPF_ADD | BPF_X:
+	case BPF_ALU64 | BPF_SUB | BPF_X:
+	case BPF_ALU64 | BPF_AND | BPF_X:
+	case BPF_ALU64 | BPF_OR | BPF_X:
+	case BPF_ALU64 | BPF_XOR | BPF_X:
+	case BPF_ALU64 | BPF_MUL | BPF_X:
+		rd = get_reg64(dst, tmp_dst, ctx);
+		rs = get_reg64(src, tmp_src, ctx);
+		emit_alu64(BPF_OP(code), rd, rs, ctx);
+		put_reg64(dst, rd, ctx);
+		break;
+	case BPF_ALU64 | BPF_ADD | BPF_K:
+	case BPF_ALU64 | BPF_SUB | BPF_K:
+	case BPF_ALU64 | BPF_AND | BPF_K:
+	case BPF_ALU64 | BPF_OR | BPF_K:
+	case BPF_ALU64 | BPF_XOR | BPF_K:
+	case BPF_ALU64 | BPF_MUL | BPF_K:
+		rd = get_reg64(dst, tmp_dst, ctx);
+		emit_mov_i64(tmp_src, imm, ctx);
+		emit_alu64(BPF_OP(code), rd, tmp_src, ctx);
+		put_reg64(dst, rd, ctx);
+		break;
+	case BPF_ALU64 | BPF_LSH | BPF_X:
+	case BPF_ALU64 | BPF_RSH | BPF_X:
+	case BPF_ALU64 | BPF_ARSH | BPF_X:
+		rd = get_reg64(dst, tmp_dst, ctx);
+		rs32 = get_reg32(src, ARM_R2, ctx);
+		emit_shift64_r(BPF_OP(code), rd, rs32, ctx);
+		put_reg64(dst, rd, ctx);
+		break;
+	case BPF_ALU64 | BPF_LSH | BPF_K:
+	case BPF_ALU64 | BPF_RSH | BPF_K:
+	case BPF_ALU64 | BPF_ARSH | BPF_K:
+		rd = get_reg64(dst, tmp_dst, ctx);
+		emit_shift64_i(BPF_OP(code), rd, imm, ctx);
+		put_reg64(dst, rd, ctx);
+		break;
+
+	/* dst = -dst */
+	case BPF_ALU | BPF_NEG:
+		rd32 = get_reg32(dst, ARM_R0, ctx);
+		emit(ARM_RSB_I(rd32, rd32, 0), ctx);
+		put_reg32(dst, rd32, ctx);
+		break;
+	case BPF_ALU64 | BPF_NEG:
+		rd = get_reg64(dst, tmp_dst, ctx);
+		emit(ARM_RSBS_I(rd[0], rd[0], 0), ctx);
+		emit(ARM_RSC_I(rd[1], rd[1], 0), ctx);
+		put_reg64(dst, rd, ctx);
+		break;
+
+	/* dst = dst / src, dst = dst % src; division by zero returns 0 */
+	case BPF_ALU | BPF_DIV | BPF_X:
+	case BPF_ALU | BPF_MOD | BPF_X:
+		rd32 = get_reg32(dst, ARM_R0, ctx);
+		rs32 = get_reg32(src, ARM_R2, ctx);
+		emit(ARM_CMP_I(rs32, 0), ctx);
+		emit_ret0(ARM_COND_EQ, ctx);
+		emit_udiv32(BPF_OP(code), rd32, rs32, ctx);
+		put_reg32(dst, rd32, ctx);
+		break;
+	case BPF_ALU | BPF_DIV | BPF_K:
+	case BPF_ALU | BPF_MOD | BPF_K:
+		/* the verifier rejects a zero immediate */
+		rd32 = get_reg32(dst, ARM_R0, ctx);
+		emit_mov_i(ARM_R2, imm, ctx);
+		emit_udiv32(BPF_OP(code), rd32, ARM_R2, ctx);
+		put_reg32(dst, rd32, ctx);
+		break;
+	case BPF_ALU64 | BPF_DIV | BPF_X:
+	case BPF_ALU64 | BPF_MOD | BPF_X:
+		rs = get_reg64(src, tmp_src, ctx);
+		emit(ARM_ORRS_R(ARM_IP, rs[0], rs[1]), ctx);
+		emit_ret0(ARM_COND_EQ, ctx);
+		rd = get_reg64(dst, tmp_dst, ctx);
+		emit_udiv64(BPF_OP(code), rd, rs, ctx);
+		put_reg64(dst, tmp_dst, ctx);
+		break;
+	case BPF_ALU64 | BPF_DIV | BPF_K:
+	case BPF_ALU64 | BPF_MOD | BPF_K:
+		emit_mov_i64(tmp_src, imm, ctx);
+		rd = get_reg64(dst, tmp_dst, ctx);
+		emit_udiv64(BPF_OP(code), rd, tmp_src, ctx);
+		put_reg64(dst, tmp_dst, ctx);
+		break;
+
+	/* dst = htole(dst), dst = htobe(dst); little endian only */
+	case BPF_ALU | BPF_END | BPF_TO_LE:
+		if (imm == 64)
+			break;
+		rd32 = get_reg32(dst, ARM_R0, ctx);
+		if (imm == 16)
+			emit(ARM_UXTH(rd32, rd32), ctx);
+		put_reg32(dst, rd32, ctx);
+		break;
+	case BPF_ALU | BPF_END | BPF_TO_BE:
+		if (imm == 64) {
+			rd = get_reg64(dst, tmp_dst, ctx);
+			emit(ARM_REV(ARM_IP, rd[0]), ctx);
+			emit(ARM_REV(rd[0], rd[1]), ctx);
+			emit(ARM_MOV_R(rd[1], ARM_IP), ctx);
+			put_reg64(dst, rd, ctx);
+			break;
+		}
+		rd32 = get_reg32(dst, ARM_R0, ctx);
+		if (imm == 16) {
+			emit(ARM_REV16(rd32, rd32), ctx);
+			emit(ARM_UXTH(rd32, rd32), ctx);
+		} else {
+			emit(ARM_REV(rd32, rd32), ctx);
+		}
+		put_reg32(dst, rd32, ctx);
+		break;
+
+	/* dst = imm64 */
+	case BPF_LD | BPF_IMM | BPF_DW:
+		rd = dst_reg64(dst, tmp_dst);
+		emit_mov_i(rd[0], imm, ctx);
+		emit_mov_i(rd[1], insn[1].imm, ctx);
+		put_reg64(dst, rd, ctx);
+		return 1;
+
+	/* dst = *(size *)(src + off) */
+	case BPF_LDX | BPF_MEM | BPF_B:
+	case BPF_LDX | BPF_MEM | BPF_H:
+	case BPF_LDX | BPF_MEM | BPF_W:
+	case BPF_LDX | BPF_MEM | BPF_DW:
+		rs32 = get_reg32(src, ARM_R2, ctx);
+		rd = dst_reg64(dst, tmp_dst);
+		emit_ldx(BPF_SIZE(code), rd, rs32, off, ctx);
+		put_reg64(dst, rd, ctx);
+		break;
+
+	/* *(size *)(dst + off) = src, *(size *)(dst + off) = imm */
+	case BPF_STX | BPF_MEM | BPF_B:
+	case BPF_STX | BPF_MEM | BPF_H:
+	case BPF_STX | BPF_MEM | BPF_W:
+	case BPF_STX | BPF_MEM | BPF_DW:
+		rd32 = get_reg32(dst, ARM_R0, ctx);
+		rs = get_reg64(src, tmp_src, ctx);
+		emit_stx(BPF_SIZE(code), rs, rd32, off, ctx);
+		break;
+	case BPF_ST | BPF_MEM | BPF_B:
+	case BPF_ST | BPF_MEM | BPF_H:
+	case BPF_ST | BPF_MEM | BPF_W:
+	case BPF_ST | BPF_MEM | BPF_DW:
+		rd32 = get_reg32(dst, ARM_R0, ctx);
+		emit_mov_i64(tmp_src, imm, ctx);
+		emit_stx(BPF_SIZE(code), tmp_src, rd32, off, ctx);
+		break;
+
+	/* lock xadd *(u32 *)(dst + off) += src, and the u64 variant */
+	case BPF_STX | BPF_XADD | BPF_W:
+	case BPF_STX | BPF_XADD | BPF_DW:
+		rs = get_reg64(src, tmp_src, ctx);
+		emit_xadd(BPF_SIZE(code), dst, rs, off, ctx);
+		break;
+
+	/* R0 = ntohx(*(size *)(skb->data + imm)), or + src + imm */
+	case BPF_LD | BPF_ABS | BPF_B:
+	case BPF_LD | BPF_ABS | BPF_H:
+	case BPF_LD | BPF_ABS | BPF_W:
+	case BPF_LD | BPF_IND | BPF_B:
+	case BPF_LD | BPF_IND | BPF_H:
+	case BPF_LD | BPF_IND | BPF_W:
+		if (BPF_MODE(code) == BPF_IND) {
+			rs32 = get_reg32(src, ARM_R1, ctx);
+			emit_mov_i(ARM_IP, imm, ctx);
+			emit(ARM_ADD_R(ARM_R1, rs32, ARM_IP), ctx);
+		} else {
+			emit_mov_i(ARM_R1, imm, ctx);
+		}
+		emit(ARM_MOV_R(ARM_R0, bpf2a32[BPF_REG_CTX][0]), ctx);
+		emit_mov_i(ARM_R2, ld_size(BPF_SIZE(code)), ctx);
+		emit_call((u32)jit_load_skb, ctx);
+		/* a packet too short for the load returns 0 */
+		emit(ARM_CMP_I(ARM_R1, 0), ctx);
+		emit_ret0(ARM_COND_NE, ctx);
+		emit(ARM_STRD_I(ARM_R0, ARM_SP, bpf2slot[BPF_REG_0]), ctx);
+		break;
+
+	/* R0 = func(R1, R2, R3, R4, R5) */
+	case BPF_JMP | BPF_CALL:
+		emit(ARM_LDRD_I(ARM_R0, ARM_SP, bpf2slot[BPF_REG_1]), ctx);
+		emit(ARM_LDRD_I(ARM_R2, ARM_SP, bpf2slot[BPF_REG_2]), ctx);
+		emit_call((u32)__bpf_call_base + imm, ctx);
+		emit(ARM_STRD_I(ARM_R0, ARM_SP, bpf2slot[BPF_REG_0]), ctx);
+		break;
+
+	/* pc += off */
+	case BPF_JMP | BPF_JA:
+		emit_b_insn(ARM_COND_AL, i + off + 1, ctx);
+		break;
+
+	/* if (dst op src) pc += off, if (dst op imm) pc += off */
+	case BPF_JMP | BPF_JEQ | BPF_X:
+	case BPF_JMP | BPF_JNE | BPF_X:
+	case BPF_JMP | BPF_JGT | BPF_X:
+	case BPF_JMP | BPF_JGE | BPF_X:
+	case BPF_JMP | BPF_JSGT | BPF_X:
+	case BPF_JMP | BPF_JSGE | BPF_X:
+	case BPF_JMP | BPF_JSET | BPF_X:
+		rd = get_reg64(dst, tmp_dst, ctx);
+		rs = get_reg64(src, tmp_src, ctx);
+		emit_cond_jmp(BPF_OP(code), rd, rs, i + off + 1, ctx);
+		break;
+	case BPF_JMP | BPF_JEQ | BPF_K:
+	case BPF_JMP | BPF_JNE | BPF_K:
+	case BPF_JMP | BPF_JGT | BPF_K:
+	case BPF_JMP | BPF_JGE | BPF_K:
+	case BPF_JMP | BPF_JSGT | BPF_K:
+	case BPF_JMP | BPF_JSGE | BPF_K:
+	case BPF_JMP | BPF_JSET | BPF_K:
+		rd = get_reg64(dst, tmp_dst, ctx);
+		emit_mov_i64(tmp_src, imm, ctx);
+		emit_cond_jmp(BPF_OP(code), rd, tmp_src, i + off + 1, ctx);
+		break;
+
+	/* return R0 */
+	case BPF_JMP | BPF_EXIT:
+		/* the epilogue follows the last instruction */
+		if (i != ctx->prog->len - 1)
+			_emit(ARM_COND_AL,
+			      ARM_B(b_imm(ctx->epilogue_offset, ctx)), ctx);
+		break;
+
+	default:
+		pr_err_once("unknown opcode %02x\n", code);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int build_body(struct jit_ctx *ctx)
+{
+	const struct bpf_prog *prog = ctx->prog;
+	int i;
+
+	for (i = 0; i < prog->len; i++) {
+		int ret;
+
+		if (ctx->target == NULL)
+			ctx->offsets[i] = ctx->idx;
+
+		ret = build_insn(&prog->insnsi[i], i, ctx);
+		if (ret < 0)
+			return ret;
+
+		/* the second half of BPF_LD_IMM64 is never a jump target */
+		if (ret > 0) {
+			i++;
+			if (ctx->target == NULL)
+				ctx->offsets[i] = ctx->idx;
+		}
+	}
+
+	return 0;
+}
+
+static void jit_fill_hole(void *area, unsigned int size)
+{
+	u32 *ptr;
+	/* We are guaranteed to have aligned memory. */
+	for (ptr = area; size >= sizeof(u32); size -= sizeof(u32))
+		*ptr++ = __opcode_to_mem_arm(ARM_INST_UDF);
+}
+
+void bpf_int_jit_compile(struct bpf_prog *prog)
+{
+	struct bpf_binary_header *header;
+	struct jit_ctx ctx;
+	unsigned int image_size;
+	u8 *image_ptr;
+
+	if (!bpf_jit_enable)
+		return;
+
+	/*
+	 * movw/movt, ldrexd and friends need ARMv7, and the register pairs
+	 * and helper call arguments assume little endian word order.
+	 */
+	if (__LINUX_ARM_ARCH__ < 7 || IS_ENABLED(CONFIG_CPU_BIG_ENDIAN))
+		return;
+
+	if (!prog || !prog->len)
+		return;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.prog = prog;
+
+	ctx.offsets = kcalloc(prog->len, sizeof(u32), GFP_KERNEL);
+	if (ctx.offsets == NULL)
+		return;
+
+	/* fake pass to fill in ctx.offsets and find the image size */
+	build_prologue(&ctx);
+	if (build_body(&ctx))
+		goto out;
+	ctx.epilogue_offset = ctx.idx;
+	build_epilogue(&ctx);
+
+	image_size = sizeof(u32) * ctx.idx;
+	header = bpf_jit_binary_alloc(image_size, &image_ptr,
+				      sizeof(u32), jit_fill_hole);
+	if (header == NULL)
+		goto out;
+
+	ctx.target = (u32 *)image_ptr;
+	ctx.idx = 0;
+
+	build_prologue(&ctx);
+	if (build_body(&ctx)) {
+		bpf_jit_binary_free(header);
+		goto out;
+	}
+	build_epilogue(&ctx);
+
+	flush_icache_range((u32)ctx.target, (u32)(ctx.target + ctx.idx));
+
+	if (bpf_jit_enable > 1)
+		/* there are 2 passes here */
+		bpf_jit_dump(prog->len, image_size, 2, ctx.target);
+
+	set_memory_ro((unsigned long)header, header->pages);
+	prog->bpf_func = (void *)ctx.target;
+	prog->jited = true;
+out:
+	kfree(ctx.offsets);
+}
@@ -105,6 +105,7 @@ struct omap_dm_timer {
 	struct clk *fclk;
 
 	void __iomem	*io_base;
+	phys_addr_t	phys_base;	/* physical address of io_base */
 	void __iomem	*irq_stat;	/* TISR/IRQSTATUS interrupt status */
 	void __iomem	*irq_ena;	/* irq enable */
 	void __iomem	*irq_dis;	/* irq disable, only on v2 ip */
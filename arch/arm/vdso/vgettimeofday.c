@@ -115,7 +115,19 @@ static notrace int do_monotonic_coarse(struct timespec *ts,
 	return 0;
 }
 
+static notrace u64 get_cycles(struct vdso_data *vdata)
+{
+	const u32 *counter;
+
 #ifdef CONFIG_ARM_ARCH_TIMER
+	if (vdata->tk_is_cntvct)
+		return arch_counter_get_cntvct();
+#endif
+
+	/* The counter page is mapped just below the data page */
+	counter = (const void *)vdata - PAGE_SIZE + vdata->cs_mmio_offset;
+	return ACCESS_ONCE(*counter);
+}
 
 static notrace u64 get_ns(struct vdso_data *vdata)
 {
@@ -123,7 +135,7 @@ static notrace u64 get_ns(struct vdso_data *vdata)
 	u64 cycle_now;
 	u64 nsec;
 
-	cycle_now = arch_counter_get_cntvct();
+	cycle_now = get_cycles(vdata);
 
 	cycle_delta = (cycle_now - vdata->cs_cycle_last) & vdata->cs_mask;
 
@@ -141,7 +153,7 @@ static notrace int do_realtime(struct timespec *ts, struct vdso_data *vdata)
 	do {
 		seq = vdso_read_begin(vdata);
 
-		if (!vdata->tk_is_cntvct)
+		if (!vdata->tk_is_cntvct && !vdata->tk_is_mmio)
 			return -1;
 
 		ts->tv_sec = vdata->xtime_clock_sec;
@@ -164,7 +176,7 @@ static notrace int do_monotonic(struct timespec *ts, struct vdso_data *vdata)
 	do {
 		seq = vdso_read_begin(vdata);
 
-		if (!vdata->tk_is_cntvct)
+		if (!vdata->tk_is_cntvct && !vdata->tk_is_mmio)
 			return -1;
 
 		ts->tv_sec = vdata->xtime_clock_sec;
@@ -182,20 +194,6 @@ static notrace int do_monotonic(struct timespec *ts, struct vdso_data *vdata)
 	return 0;
 }
 
-#else /* CONFIG_ARM_ARCH_TIMER */
-
-static notrace int do_realtime(struct timespec *ts, struct vdso_data *vdata)
-{
-	return -1;
-}
-
-static notrace int do_monotonic(struct timespec *ts, struct vdso_data *vdata)
-{
-	return -1;
-}
-
-#endif /* CONFIG_ARM_ARCH_TIMER */
-
 notrace int __vdso_clock_gettime(clockid_t clkid, struct timespec *ts)
 {
 	struct vdso_data *vdata;
@@ -0,0 +1,1741 @@
+/*
+ *  BFQ, or budget fair queueing, disk scheduler.
+ *
+ *  Each process gets its own queue, and queues are granted exclusive
+ *  access to the device in turn.  Instead of a time slice, the queue in
+ *  service is given a budget, measured in sectors, and is scheduled
+ *  among the other busy queues of its class in order of virtual finish
+ *  time (a simplified B-WF2Q+).  The budget of each sync queue is
+ *  tuned on the fly from its past behaviour, and a timeout bounds how
+ *  long a slow (e.g. random) queue may hold the device.
+ *
+ *  With low_latency set, the weight of queues that look interactive
+ *  (newly created, or back after a long idle period) or soft real-time
+ *  (issuing I/O at a low, regular rate) is raised for a while, so that
+ *  application start-up and playback are not starved by background
+ *  streaming writers.  This matters most on SD cards and eMMC, which
+ *  serve one request at a time and where a single sequential writer
+ *  can otherwise hold the device for seconds.
+ */
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/jiffies.h>
+#include <linux/rbtree.h>
+#include <linux/ioprio.h>
+#include <linux/blktrace_api.h>
+#include "blk.h"
+
+/*
+ * tunables
+ */
+/* max requests in the driver from the queue in service */
+static const int bfq_quantum = 4;
+static const int bfq_fifo_expire[2] = { HZ / 4, HZ / 8 };
+static int bfq_slice_idle = HZ / 125;
+/* default maximum budget, in sectors */
+static const int bfq_default_max_budget = 16 * 1024;
+static int bfq_timeout[2] = { HZ / 25, HZ / 8 };
+/* async sectors are charged this many times their size */
+static const int bfq_async_charge_factor = 3;
+
+/* weight-raising defaults */
+static const int bfq_wr_coeff = 30;
+static const int bfq_wr_max_time = 3 * HZ;
+static const int bfq_wr_rt_max_time = HZ * 3 / 10;	/* 300 ms */
+static const int bfq_wr_min_idle_time = 2 * HZ;
+/* sectors per second */
+static const int bfq_wr_max_softrt_rate = 7000;
+
+#define BFQ_IOPRIO_CLASSES	3
+#define BFQ_WEIGHT_COEFF	10
+#define BFQ_SERVICE_SHIFT	22
+#define BFQ_HW_QUEUE_THRESHOLD	4
+#define BFQ_HW_QUEUE_SAMPLES	32
+
+#define RQ_BIC(rq)		icq_to_bic((rq)->elv.icq)
+#define RQ_BFQQ(rq)		(struct bfq_queue *) ((rq)->elv.priv[0])
+
+static struct kmem_cache *bfq_pool;
+
+#define bfq_class_idle(bfqq)	((bfqq)->ioprio_class == IOPRIO_CLASS_IDLE)
+#define sample_valid(samples)	((samples) > 80)
+
+struct bfq_ttime {
+	unsigned long last_end_request;
+
+	unsigned long ttime_total;
+	unsigned long ttime_samples;
+	unsigned long ttime_mean;
+};
+
+/*
+ * Busy queues of one ioprio class, sorted by virtual finish time.  The
+ * queue in service is not on the tree.
+ */
+struct bfq_service_tree {
+	struct rb_root active;
+	u64 vtime;
+};
+
+struct bfq_data;
+
+/*
+ * Per process-grouping structure
+ */
+struct bfq_queue {
+	/* reference count */
+	int ref;
+	/* various state flags, see below */
+	unsigned int flags;
+	/* parent bfq_data */
+	struct bfq_data *bfqd;
+	/* node on the service tree of its class */
+	struct rb_node rb_node;
+	/* tree the queue was inserted in */
+	struct bfq_service_tree *st;
+	/* sorted list of pending requests */
+	struct rb_root sort_list;
+	/* next request to serve */
+	struct request *next_rq;
+	/* requests queued in sort_list */
+	int queued[2];
+	/* currently allocated requests */
+	int allocated[2];
+	/* fifo list of requests in sort_list */
+	struct list_head fifo;
+	/* requests dispatched and not yet completed */
+	int dispatched;
+
+	/* virtual start and finish time */
+	u64 start, finish;
+	/* sectors served and allowed in the current service round */
+	unsigned long service, budget;
+	/* budget the next service round will get */
+	unsigned long max_budget;
+	/* jiffies after which the service round ends */
+	unsigned long budget_timeout;
+
+	unsigned int weight, orig_weight;
+	unsigned short ioprio, ioprio_class;
+
+	/* weight-raising state */
+	unsigned int wr_coeff;
+	unsigned long wr_start;
+	unsigned long wr_cur_max_time;
+	unsigned long last_empty;
+	unsigned long last_idle_backlogged;
+	unsigned long service_from_backlogged;
+	unsigned long soft_rt_next_start;
+
+	struct bfq_ttime ttime;
+
+	pid_t pid;
+};
+
+struct bfq_io_cq {
+	struct io_cq icq;		/* must be the first member */
+	struct bfq_queue *bfqq[2];
+	int ioprio;
+};
+
+/*
+ * Per block device queue structure
+ */
+struct bfq_data {
+	struct request_queue *queue;
+
+	/* RT, BE and IDLE service trees, served in strict order */
+	struct bfq_service_tree st[BFQ_IOPRIO_CLASSES];
+
+	unsigned int busy_queues;
+
+	int rq_in_driver;
+	int rq_queued;
+	int hw_tag;
+	/*
+	 * hw_tag can be
+	 * -1 => indeterminate, (bfq will behave as if NCQ is not present)
+	 *  1 => NCQ is present (hw_tag_samples are ignored)
+	 *  0 => no NCQ
+	 */
+	int hw_tag_samples;
+	int max_rq_in_driver;
+
+	/* idle timer and dispatch kick */
+	struct timer_list idle_slice_timer;
+	struct work_struct unplug_work;
+
+	struct bfq_queue *in_service_queue;
+
+	sector_t last_position;
+
+	/* async queues, shared by all processes of one priority */
+	struct bfq_queue *async_bfqq[2][IOPRIO_BE_NR];
+	struct bfq_queue *async_idle_bfqq;
+
+	/*
+	 * tunables, see top of file
+	 */
+	unsigned int bfq_quantum;
+	unsigned int bfq_fifo_expire[2];
+	unsigned int bfq_slice_idle;
+	unsigned int bfq_max_budget;
+	unsigned int bfq_timeout[2];
+	unsigned int bfq_low_latency;
+	unsigned int bfq_wr_coeff;
+	unsigned int bfq_wr_max_time;
+	unsigned int bfq_wr_rt_max_time;
+	unsigned int bfq_wr_min_idle_time;
+	unsigned int bfq_wr_max_softrt_rate;
+
+	/*
+	 * Fallback dummy bfqq for extreme OOM conditions
+	 */
+	struct bfq_queue oom_bfqq;
+};
+
+enum bfqq_state_flags {
+	BFQ_BFQQ_FLAG_busy = 0,		/* has requests or is in service */
+	BFQ_BFQQ_FLAG_wait_request,	/* idling, waiting for a request */
+	BFQ_BFQQ_FLAG_idle_window,	/* slice idling enabled */
+	BFQ_BFQQ_FLAG_prio_changed,	/* task priority has changed */
+	BFQ_BFQQ_FLAG_sync,		/* synchronous queue */
+	BFQ_BFQQ_FLAG_just_created,	/* not yet activated */
+};
+
+#define BFQ_BFQQ_FNS(name)						\
+static inline void bfq_mark_bfqq_##name(struct bfq_queue *bfqq)	\
+{									\
+	(bfqq)->flags |= (1 << BFQ_BFQQ_FLAG_##name);			\
+}									\
+static inline void bfq_clear_bfqq_##name(struct bfq_queue *bfqq)	\
+{									\
+	(bfqq)->flags &= ~(1 << BFQ_BFQQ_FLAG_##name);			\
+}									\
+static inline int bfq_bfqq_##name(const struct bfq_queue *bfqq)	\
+{									\
+	return ((bfqq)->flags & (1 << BFQ_BFQQ_FLAG_##name)) != 0;	\
+}
+
+BFQ_BFQQ_FNS(busy);
+BFQ_BFQQ_FNS(wait_request);
+BFQ_BFQQ_FNS(idle_window);
+BFQ_BFQQ_FNS(prio_changed);
+BFQ_BFQQ_FNS(sync);
+BFQ_BFQQ_FNS(just_created);
+#undef BFQ_BFQQ_FNS
+
+/* reasons for ending the service round of the queue in service */
+enum bfqq_expiration {
+	BFQ_BFQQ_TOO_IDLE = 0,		/* idled for too long */
+	BFQ_BFQQ_BUDGET_TIMEOUT,	/* held the device for too long */
+	BFQ_BFQQ_BUDGET_EXHAUSTED,	/* used up its budget */
+	BFQ_BFQQ_NO_MORE_REQUESTS,	/* emptied and idling is pointless */
+	BFQ_BFQQ_PREEMPTED,		/* a raised queue wants the device */
+};
+
+#define bfq_log_bfqq(bfqd, bfqq, fmt, args...)	\
+	blk_add_trace_msg((bfqd)->queue, "bfq%d%c " fmt, (bfqq)->pid,	\
+			bfq_bfqq_sync((bfqq)) ? 'S' : 'A', ##args)
+#define bfq_log(bfqd, fmt, args...)	\
+	blk_add_trace_msg((bfqd)->queue, "bfq " fmt, ##args)
+
+static void bfq_dispatch_insert(struct request_queue *, struct request *);
+
+static inline struct bfq_io_cq *icq_to_bic(struct io_cq *icq)
+{
+	/* bic->icq is the first member, %NULL will convert to %NULL */
+	return container_of(icq, struct bfq_io_cq, icq);
+}
+
+static inline struct bfq_io_cq *bfq_bic_lookup(struct bfq_data *bfqd,
+					       struct io_context *ioc)
+{
+	if (ioc)
+		return icq_to_bic(ioc_lookup_icq(ioc, bfqd->queue));
+	return NULL;
+}
+
+static inline struct bfq_data *bic_to_bfqd(struct bfq_io_cq *bic)
+{
+	return bic->icq.q->elevator->elevator_data;
+}
+
+/*
+ * We regard a request as SYNC, if it's either a read or has the SYNC bit
+ * set (in which case it could also be direct WRITE).
+ */
+static inline bool bfq_bio_sync(struct bio *bio)
+{
+	return bio_data_dir(bio) == READ || (bio->bi_rw & REQ_SYNC);
+}
+
+/*
+ * scheduler run of queue, if there are requests pending and no one in the
+ * driver that will restart queueing
+ */
+static inline void bfq_schedule_dispatch(struct bfq_data *bfqd)
+{
+	if (bfqd->busy_queues) {
+		bfq_log(bfqd, "schedule dispatch");
+		kblockd_schedule_work(&bfqd->unplug_work);
+	}
+}
+
+static inline bool bfq_gt(u64 a, u64 b)
+{
+	return (s64)(a - b) > 0;
+}
+
+/* virtual time a queue of the given weight needs to receive service */
+static inline u64 bfq_delta(unsigned long service, unsigned int weight)
+{
+	return div_u64((u64)service << BFQ_SERVICE_SHIFT, weight);
+}
+
+static inline unsigned int bfq_ioprio_to_weight(int ioprio)
+{
+	return (IOPRIO_BE_NR - ioprio) * BFQ_WEIGHT_COEFF;
+}
+
+static inline struct bfq_service_tree *
+bfq_class_st(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	return &bfqd->st[bfqq->ioprio_class - IOPRIO_CLASS_RT];
+}
+
+static unsigned long bfq_serv_to_charge(struct request *rq,
+					struct bfq_queue *bfqq)
+{
+	if (bfq_bfqq_sync(bfqq))
+		return blk_rq_sectors(rq);
+	return blk_rq_sectors(rq) * bfq_async_charge_factor;
+}
+
+static inline unsigned long bfq_bfqq_budget_left(struct bfq_queue *bfqq)
+{
+	return bfqq->budget > bfqq->service ? bfqq->budget - bfqq->service : 0;
+}
+
+static inline bool bfq_bfqq_budget_timeout(struct bfq_queue *bfqq)
+{
+	return time_after(jiffies, bfqq->budget_timeout);
+}
+
+/*
+ * Lifted from cfq: pick the request that is best served next, preferring
+ * sync and meta requests, then the closest one ahead of the head.
+ */
+static struct request *
+bfq_choose_req(struct bfq_data *bfqd, struct request *rq1, struct request *rq2)
+{
+	sector_t s1, s2, last = bfqd->last_position;
+
+	if (!rq1 || rq1 == rq2)
+		return rq2;
+	if (!rq2)
+		return rq1;
+
+	if (rq_is_sync(rq1) != rq_is_sync(rq2))
+		return rq_is_sync(rq1) ? rq1 : rq2;
+
+	if ((rq1->cmd_flags ^ rq2->cmd_flags) & REQ_PRIO)
+		return rq1->cmd_flags & REQ_PRIO ? rq1 : rq2;
+
+	s1 = blk_rq_pos(rq1);
+	s2 = blk_rq_pos(rq2);
+
+	if (s1 >= last && s2 >= last)
+		return s1 <= s2 ? rq1 : rq2;
+	if (s1 >= last)
+		return rq1;
+	if (s2 >= last)
+		return rq2;
+
+	/* both behind the head, wrap around to the lowest one */
+	return s1 <= s2 ? rq1 : rq2;
+}
+
+/*
+ * would be nice to take fifo expire time into account as well
+ */
+static struct request *
+bfq_find_next_rq(struct bfq_data *bfqd, struct bfq_queue *bfqq,
+		 struct request *last)
+{
+	struct rb_node *rbnext = rb_next(&last->rb_node);
+	struct rb_node *rbprev = rb_prev(&last->rb_node);
+	struct request *next = NULL, *prev = NULL;
+
+	if (rbprev)
+		prev = rb_entry_rq(rbprev);
+
+	if (rbnext)
+		next = rb_entry_rq(rbnext);
+	else {
+		rbnext = rb_first(&bfqq->sort_list);
+		if (rbnext && rbnext != &last->rb_node)
+			next = rb_entry_rq(rbnext);
+	}
+
+	return bfq_choose_req(bfqd, next, prev);
+}
+
+static void bfq_st_insert(struct bfq_service_tree *st, struct bfq_queue *bfqq)
+{
+	struct rb_node **p = &st->active.rb_node, *parent = NULL;
+	struct bfq_queue *entry;
+
+	while (*p) {
+		parent = *p;
+		entry = rb_entry(parent, struct bfq_queue, rb_node);
+
+		if (bfq_gt(entry->finish, bfqq->finish))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+
+	rb_link_node(&bfqq->rb_node, parent, p);
+	rb_insert_color(&bfqq->rb_node, &st->active);
+	bfqq->st = st;
+}
+
+static void bfq_st_remove(struct bfq_queue *bfqq)
+{
+	if (!RB_EMPTY_NODE(&bfqq->rb_node)) {
+		rb_erase(&bfqq->rb_node, &bfqq->st->active);
+		RB_CLEAR_NODE(&bfqq->rb_node);
+	}
+}
+
+/*
+ * Compute the timestamps of a queue that is (again) waiting for service
+ * and put it on its service tree.  A queue that comes back before the
+ * virtual time has caught up with its last finish time keeps its place,
+ * one that was idle for longer restarts from the current virtual time
+ * and cannot claim the service it missed.
+ */
+static void bfq_activate_bfqq(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	struct bfq_service_tree *st = bfq_class_st(bfqd, bfqq);
+	unsigned long budget = bfqq->max_budget;
+
+	if (bfqq->next_rq)
+		budget = max(budget, bfq_serv_to_charge(bfqq->next_rq, bfqq));
+	bfqq->budget = budget;
+
+	bfqq->start = bfq_gt(bfqq->finish, st->vtime) ? bfqq->finish :
+							 st->vtime;
+	bfqq->finish = bfqq->start + bfq_delta(budget, bfqq->weight);
+	bfq_st_insert(st, bfqq);
+}
+
+static void bfq_end_wr(struct bfq_queue *bfqq)
+{
+	bfqq->wr_coeff = 1;
+	bfqq->weight = bfqq->orig_weight;
+}
+
+/*
+ * Stop raising the weight of a queue once its raising period is over, or
+ * as soon as low_latency is switched off.
+ */
+static void bfq_update_wr_data(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	if (bfqq->wr_coeff == 1)
+		return;
+
+	if (!bfqd->bfq_low_latency ||
+	    time_after(jiffies, bfqq->wr_start + bfqq->wr_cur_max_time)) {
+		bfq_log_bfqq(bfqd, bfqq, "wr end");
+		bfq_end_wr(bfqq);
+	}
+}
+
+/*
+ * A queue becoming busy is interactive if it is new or was idle for a
+ * while, and soft real-time if it stayed idle long enough for its past
+ * bandwidth to be below bfq_wr_max_softrt_rate.
+ */
+static void bfq_start_wr(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	bool interactive, soft_rt;
+
+	if (!bfqd->bfq_low_latency || !bfq_bfqq_sync(bfqq) ||
+	    bfq_class_idle(bfqq))
+		return;
+
+	interactive = bfq_bfqq_just_created(bfqq) ||
+		time_after(jiffies, bfqq->last_empty +
+				    bfqd->bfq_wr_min_idle_time);
+	soft_rt = !interactive && bfqd->bfq_wr_max_softrt_rate &&
+		time_is_before_jiffies(bfqq->soft_rt_next_start);
+
+	if (interactive) {
+		bfqq->wr_coeff = bfqd->bfq_wr_coeff;
+		bfqq->wr_start = jiffies;
+		bfqq->wr_cur_max_time = bfqd->bfq_wr_max_time;
+	} else if (soft_rt) {
+		/* do not cut short a longer interactive raising period */
+		if (bfqq->wr_coeff == 1 ||
+		    time_after(jiffies + bfqd->bfq_wr_rt_max_time,
+			       bfqq->wr_start + bfqq->wr_cur_max_time)) {
+			bfqq->wr_coeff = bfqd->bfq_wr_coeff;
+			bfqq->wr_start = jiffies;
+			bfqq->wr_cur_max_time = bfqd->bfq_wr_rt_max_time;
+		}
+	}
+
+	bfqq->weight = bfqq->orig_weight * bfqq->wr_coeff;
+	if (interactive || soft_rt)
+		bfq_log_bfqq(bfqd, bfqq, "wr start %s coeff %u",
+			     interactive ? "interactive" : "soft_rt",
+			     bfqq->wr_coeff);
+}
+
+/*
+ * Earliest time at which a queue going idle now may be deemed soft
+ * real-time again: it must stay idle long enough that the service it
+ * got since it last became busy fits in bfq_wr_max_softrt_rate.
+ */
+static unsigned long bfq_softrt_next_start(struct bfq_data *bfqd,
+					   struct bfq_queue *bfqq)
+{
+	unsigned long next_start = jiffies + bfqd->bfq_slice_idle + 4;
+	unsigned long rate_start;
+
+	if (!bfqd->bfq_wr_max_softrt_rate)
+		return jiffies;
+
+	rate_start = bfqq->last_idle_backlogged +
+		div_u64((u64)HZ * bfqq->service_from_backlogged,
+			bfqd->bfq_wr_max_softrt_rate);
+
+	return time_after(rate_start, next_start) ? rate_start : next_start;
+}
+
+static void bfq_add_bfqq_busy(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	BUG_ON(bfq_bfqq_busy(bfqq));
+	bfq_log_bfqq(bfqd, bfqq, "add_to_busy");
+	bfq_mark_bfqq_busy(bfqq);
+	bfqd->busy_queues++;
+
+	bfq_update_wr_data(bfqd, bfqq);
+	bfq_start_wr(bfqd, bfqq);
+	bfq_clear_bfqq_just_created(bfqq);
+
+	bfqq->last_idle_backlogged = jiffies;
+	bfqq->service_from_backlogged = 0;
+
+	bfq_activate_bfqq(bfqd, bfqq);
+}
+
+static void bfq_del_bfqq_busy(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	BUG_ON(!bfq_bfqq_busy(bfqq));
+	bfq_log_bfqq(bfqd, bfqq, "del_from_busy");
+	bfq_st_remove(bfqq);
+	bfq_clear_bfqq_busy(bfqq);
+	BUG_ON(!bfqd->busy_queues);
+	bfqd->busy_queues--;
+
+	bfqq->last_empty = jiffies;
+	if (bfq_bfqq_sync(bfqq))
+		bfqq->soft_rt_next_start = bfq_softrt_next_start(bfqd, bfqq);
+}
+
+/*
+ * Adjust the budget of the next service round of a sync queue from how
+ * the current one ended: grow it when the queue used it up, and shrink
+ * it to what was used when the queue ran dry while we idled for it.
+ */
+static void bfq_update_budget(struct bfq_data *bfqd, struct bfq_queue *bfqq,
+			      enum bfqq_expiration reason)
+{
+	unsigned long min_budget = max(bfqd->bfq_max_budget / 32, 1U);
+	unsigned long budget = bfqq->max_budget;
+
+	switch (reason) {
+	case BFQ_BFQQ_TOO_IDLE:
+		budget = bfqq->service;
+		break;
+	case BFQ_BFQQ_BUDGET_EXHAUSTED:
+		budget *= 2;
+		break;
+	default:
+		break;
+	}
+
+	bfqq->max_budget = clamp_t(unsigned long, budget, min_budget,
+				   bfqd->bfq_max_budget);
+}
+
+/*
+ * End the service round of the queue in service without charging it.
+ */
+static void __bfq_bfqq_expire(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	bfq_log_bfqq(bfqd, bfqq, "expire service %lu budget %lu",
+		     bfqq->service, bfqq->budget);
+
+	if (bfq_bfqq_wait_request(bfqq)) {
+		del_timer(&bfqd->idle_slice_timer);
+		bfq_clear_bfqq_wait_request(bfqq);
+	}
+
+	if (bfqq == bfqd->in_service_queue)
+		bfqd->in_service_queue = NULL;
+
+	if (RB_EMPTY_ROOT(&bfqq->sort_list))
+		bfq_del_bfqq_busy(bfqd, bfqq);
+	else
+		bfq_activate_bfqq(bfqd, bfqq);
+}
+
+static void bfq_bfqq_expire(struct bfq_data *bfqd, struct bfq_queue *bfqq,
+			    enum bfqq_expiration reason)
+{
+	unsigned long charge = bfqq->service;
+
+	/*
+	 * A queue that timed out was slow to serve, random I/O typically.
+	 * Charge it for the device time it took, its full budget, rather
+	 * than for the few sectors it moved.
+	 */
+	if (reason == BFQ_BFQQ_BUDGET_TIMEOUT)
+		charge = max(charge, bfqq->budget);
+	charge = max(charge, 1UL);
+
+	bfq_log_bfqq(bfqd, bfqq, "expire reason %d charge %lu", reason,
+		     charge);
+
+	if (bfq_bfqq_sync(bfqq))
+		bfq_update_budget(bfqd, bfqq, reason);
+
+	bfqq->finish = bfqq->start + bfq_delta(charge, bfqq->weight);
+	__bfq_bfqq_expire(bfqd, bfqq);
+}
+
+/*
+ * Pick the busy queue with the smallest virtual finish time from the
+ * highest non-empty class, and take it off its tree.
+ */
+static struct bfq_queue *bfq_set_in_service_queue(struct bfq_data *bfqd)
+{
+	struct bfq_service_tree *st;
+	struct bfq_queue *bfqq;
+	struct rb_node *n;
+	int i;
+
+	for (i = 0; i < BFQ_IOPRIO_CLASSES; i++) {
+		st = &bfqd->st[i];
+		n = rb_first(&st->active);
+		if (n)
+			break;
+	}
+	if (!n)
+		return NULL;
+
+	bfqq = rb_entry(n, struct bfq_queue, rb_node);
+	bfq_st_remove(bfqq);
+	if (bfq_gt(bfqq->start, st->vtime))
+		st->vtime = bfqq->start;
+
+	bfqq->service = 0;
+	bfqq->budget_timeout = jiffies +
+		bfqd->bfq_timeout[bfq_bfqq_sync(bfqq)];
+	bfqd->in_service_queue = bfqq;
+
+	bfq_log_bfqq(bfqd, bfqq, "set_in_service budget %lu weight %u",
+		     bfqq->budget, bfqq->weight);
+	return bfqq;
+}
+
+/*
+ * Whether the device should be kept reserved for the queue in service
+ * when it has no requests left.  Idling pays off on devices that cannot
+ * queue requests internally, rotational or not, since a process issuing
+ * its next sync request shortly after is then served without seeking
+ * or splitting the device with other processes.
+ */
+static bool bfq_bfqq_must_idle(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	if (!bfqd->bfq_slice_idle || !bfq_bfqq_sync(bfqq) ||
+	    bfq_class_idle(bfqq))
+		return false;
+
+	/* always protect the throughput of raised queues */
+	if (bfqq->wr_coeff > 1)
+		return true;
+
+	if (blk_queue_nonrot(bfqd->queue) && bfqd->hw_tag == 1)
+		return false;
+
+	return bfq_bfqq_idle_window(bfqq);
+}
+
+static void bfq_arm_slice_timer(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	bfq_mark_bfqq_wait_request(bfqq);
+	mod_timer(&bfqd->idle_slice_timer, jiffies + bfqd->bfq_slice_idle);
+	bfq_log_bfqq(bfqd, bfqq, "arm_idle: %u", bfqd->bfq_slice_idle);
+}
+
+/*
+ * Select a queue for service. If we have a current queue in service,
+ * check whether to continue servicing it, or retrieve and set a new one.
+ */
+static struct bfq_queue *bfq_select_queue(struct bfq_data *bfqd)
+{
+	struct bfq_queue *bfqq = bfqd->in_service_queue;
+	struct request *next_rq;
+
+	if (!bfqq)
+		goto new_queue;
+
+	if (bfq_bfqq_budget_timeout(bfqq) && !bfq_bfqq_wait_request(bfqq)) {
+		bfq_bfqq_expire(bfqd, bfqq, BFQ_BFQQ_BUDGET_TIMEOUT);
+		goto new_queue;
+	}
+
+	next_rq = bfqq->next_rq;
+	if (next_rq) {
+		if (bfq_serv_to_charge(next_rq, bfqq) >
+		    bfq_bfqq_budget_left(bfqq)) {
+			bfq_bfqq_expire(bfqd, bfqq, BFQ_BFQQ_BUDGET_EXHAUSTED);
+			goto new_queue;
+		}
+		if (bfq_bfqq_wait_request(bfqq)) {
+			del_timer(&bfqd->idle_slice_timer);
+			bfq_clear_bfqq_wait_request(bfqq);
+		}
+		return bfqq;
+	}
+
+	/*
+	 * No requests pending: keep the device reserved while idling, or
+	 * until the requests in flight complete and we can start idling.
+	 */
+	if (bfq_bfqq_wait_request(bfqq))
+		return NULL;
+	if (bfq_bfqq_must_idle(bfqd, bfqq)) {
+		if (!bfqq->dispatched)
+			bfq_arm_slice_timer(bfqd, bfqq);
+		return NULL;
+	}
+
+	bfq_bfqq_expire(bfqd, bfqq, BFQ_BFQQ_NO_MORE_REQUESTS);
+new_queue:
+	return bfq_set_in_service_queue(bfqd);
+}
+
+/*
+ * Drain our current requests.  Used for barriers and when switching io
+ * schedulers on-the-fly.
+ */
+static int bfq_forced_dispatch(struct bfq_data *bfqd)
+{
+	struct bfq_queue *bfqq;
+	struct rb_node *n;
+	int i, dispatched = 0;
+
+	if (bfqd->in_service_queue)
+		__bfq_bfqq_expire(bfqd, bfqd->in_service_queue);
+
+	for (i = 0; i < BFQ_IOPRIO_CLASSES; i++) {
+		while ((n = rb_first(&bfqd->st[i].active)) != NULL) {
+			bfqq = rb_entry(n, struct bfq_queue, rb_node);
+			while (bfqq->next_rq) {
+				bfq_dispatch_insert(bfqd->queue,
+						    bfqq->next_rq);
+				dispatched++;
+			}
+			bfq_del_bfqq_busy(bfqd, bfqq);
+		}
+	}
+
+	BUG_ON(bfqd->busy_queues);
+
+	bfq_log(bfqd, "forced_dispatch=%d", dispatched);
+	return dispatched;
+}
+
+/*
+ * Return the request whose fifo deadline has passed, if any.
+ */
+static struct request *bfq_check_fifo(struct bfq_queue *bfqq)
+{
+	struct request *rq;
+
+	if (list_empty(&bfqq->fifo))
+		return NULL;
+
+	rq = rq_entry_fifo(bfqq->fifo.next);
+	if (time_before(jiffies, rq->fifo_time))
+		return NULL;
+
+	return rq;
+}
+
+/*
+ * Dispatch one request from the queue in service.
+ */
+static int bfq_dispatch_requests(struct request_queue *q, int force)
+{
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+	struct bfq_queue *bfqq;
+	struct request *rq;
+	unsigned long charge;
+
+	if (!bfqd->busy_queues)
+		return 0;
+
+	if (unlikely(force))
+		return bfq_forced_dispatch(bfqd);
+
+	bfqq = bfq_select_queue(bfqd);
+	if (!bfqq)
+		return 0;
+
+	/*
+	 * Let completions drive the dispatching once the queue has
+	 * enough requests in flight.
+	 */
+	if (bfqq->dispatched >= bfqd->bfq_quantum)
+		return 0;
+
+	rq = bfq_check_fifo(bfqq);
+	if (!rq)
+		rq = bfqq->next_rq;
+
+	charge = bfq_serv_to_charge(rq, bfqq);
+	bfqq->service += charge;
+	bfqq->service_from_backlogged += charge;
+	bfq_update_wr_data(bfqd, bfqq);
+
+	bfq_dispatch_insert(q, rq);
+
+	bfq_log_bfqq(bfqd, bfqq, "dispatched a request");
+	return 1;
+}
+
+/*
+ * task holds one reference to the queue, dropped when task exits. each rq
+ * in-flight on this queue also holds a reference, dropped when rq is freed.
+ *
+ * queue lock must be held here.
+ */
+static void bfq_put_queue(struct bfq_queue *bfqq)
+{
+	struct bfq_data *bfqd = bfqq->bfqd;
+
+	BUG_ON(bfqq->ref <= 0);
+
+	bfqq->ref--;
+	if (bfqq->ref)
+		return;
+
+	bfq_log_bfqq(bfqd, bfqq, "put_queue");
+	BUG_ON(rb_first(&bfqq->sort_list));
+	BUG_ON(bfqq->allocated[READ] + bfqq->allocated[WRITE]);
+	BUG_ON(bfq_bfqq_busy(bfqq));
+	BUG_ON(bfqd->in_service_queue == bfqq);
+
+	kmem_cache_free(bfq_pool, bfqq);
+}
+
+static void bfq_exit_bfqq(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	if (bfqq == bfqd->in_service_queue) {
+		__bfq_bfqq_expire(bfqd, bfqq);
+		bfq_schedule_dispatch(bfqd);
+	}
+
+	bfq_put_queue(bfqq);
+}
+
+static void bfq_exit_icq(struct io_cq *icq)
+{
+	struct bfq_io_cq *bic = icq_to_bic(icq);
+	struct bfq_data *bfqd = bic_to_bfqd(bic);
+
+	if (bic->bfqq[BLK_RW_ASYNC]) {
+		bfq_exit_bfqq(bfqd, bic->bfqq[BLK_RW_ASYNC]);
+		bic->bfqq[BLK_RW_ASYNC] = NULL;
+	}
+
+	if (bic->bfqq[BLK_RW_SYNC]) {
+		bfq_exit_bfqq(bfqd, bic->bfqq[BLK_RW_SYNC]);
+		bic->bfqq[BLK_RW_SYNC] = NULL;
+	}
+}
+
+static void bfq_init_prio_data(struct bfq_queue *bfqq, struct bfq_io_cq *bic)
+{
+	struct task_struct *tsk = current;
+	int ioprio_class;
+
+	if (!bfq_bfqq_prio_changed(bfqq))
+		return;
+
+	ioprio_class = IOPRIO_PRIO_CLASS(bic->ioprio);
+	switch (ioprio_class) {
+	default:
+		printk(KERN_ERR "bfq: bad prio %x\n", ioprio_class);
+	case IOPRIO_CLASS_NONE:
+		/*
+		 * no prio set, inherit CPU scheduling settings
+		 */
+		bfqq->ioprio = task_nice_ioprio(tsk);
+		bfqq->ioprio_class = task_nice_ioclass(tsk);
+		break;
+	case IOPRIO_CLASS_RT:
+		bfqq->ioprio = IOPRIO_PRIO_DATA(bic->ioprio);
+		bfqq->ioprio_class = IOPRIO_CLASS_RT;
+		break;
+	case IOPRIO_CLASS_BE:
+		bfqq->ioprio = IOPRIO_PRIO_DATA(bic->ioprio);
+		bfqq->ioprio_class = IOPRIO_CLASS_BE;
+		break;
+	case IOPRIO_CLASS_IDLE:
+		bfqq->ioprio_class = IOPRIO_CLASS_IDLE;
+		bfqq->ioprio = 7;
+		bfq_clear_bfqq_idle_window(bfqq);
+		bfq_end_wr(bfqq);
+		break;
+	}
+
+	/*
+	 * The new weight and class take effect the next time the queue
+	 * is put on a service tree.
+	 */
+	bfqq->orig_weight = bfq_ioprio_to_weight(bfqq->ioprio);
+	bfqq->weight = bfqq->orig_weight * bfqq->wr_coeff;
+	bfq_clear_bfqq_prio_changed(bfqq);
+}
+
+static struct bfq_queue *bfq_get_queue(struct bfq_data *bfqd, bool is_sync,
+				       struct bfq_io_cq *bic, struct bio *bio);
+
+static void bfq_check_ioprio_changed(struct bfq_io_cq *bic, struct bio *bio)
+{
+	int ioprio = bic->icq.ioc->ioprio;
+	struct bfq_data *bfqd = bic_to_bfqd(bic);
+	struct bfq_queue *bfqq;
+
+	/*
+	 * Check whether ioprio has changed.  The condition may trigger
+	 * spuriously on a newly created bic but there's no harm.
+	 */
+	if (unlikely(!bfqd) || likely(bic->ioprio == ioprio))
+		return;
+
+	bic->ioprio = ioprio;
+
+	bfqq = bic->bfqq[BLK_RW_ASYNC];
+	if (bfqq) {
+		bic->bfqq[BLK_RW_ASYNC] = bfq_get_queue(bfqd, BLK_RW_ASYNC,
+							bic, bio);
+		bfq_put_queue(bfqq);
+	}
+
+	bfqq = bic->bfqq[BLK_RW_SYNC];
+	if (bfqq)
+		bfq_mark_bfqq_prio_changed(bfqq);
+}
+
+static void bfq_init_bfqq(struct bfq_data *bfqd, struct bfq_queue *bfqq,
+			  pid_t pid, bool is_sync)
+{
+	RB_CLEAR_NODE(&bfqq->rb_node);
+	INIT_LIST_HEAD(&bfqq->fifo);
+
+	bfqq->ref = 0;
+	bfqq->bfqd = bfqd;
+	bfqq->pid = pid;
+
+	bfqq->max_budget = bfqd->bfq_max_budget;
+	bfqq->wr_coeff = 1;
+	bfqq->soft_rt_next_start = jiffies;
+	bfqq->ttime.last_end_request = jiffies;
+
+	bfq_mark_bfqq_prio_changed(bfqq);
+	bfq_mark_bfqq_just_created(bfqq);
+
+	if (is_sync) {
+		bfq_mark_bfqq_idle_window(bfqq);
+		bfq_mark_bfqq_sync(bfqq);
+	}
+}
+
+static struct bfq_queue **
+bfq_async_queue_prio(struct bfq_data *bfqd, int ioprio_class, int ioprio)
+{
+	switch (ioprio_class) {
+	case IOPRIO_CLASS_RT:
+		return &bfqd->async_bfqq[0][ioprio];
+	case IOPRIO_CLASS_NONE:
+		ioprio = IOPRIO_NORM;
+		/* fall through */
+	case IOPRIO_CLASS_BE:
+		return &bfqd->async_bfqq[1][ioprio];
+	case IOPRIO_CLASS_IDLE:
+		return &bfqd->async_idle_bfqq;
+	default:
+		BUG();
+	}
+}
+
+/*
+ * Called with the queue lock held, so the allocation may not sleep; we
+ * fall back to the oom queue when it fails.
+ */
+static struct bfq_queue *bfq_get_queue(struct bfq_data *bfqd, bool is_sync,
+				       struct bfq_io_cq *bic, struct bio *bio)
+{
+	int ioprio_class = IOPRIO_PRIO_CLASS(bic->ioprio);
+	int ioprio = IOPRIO_PRIO_DATA(bic->ioprio);
+	struct bfq_queue **async_bfqq = NULL;
+	struct bfq_queue *bfqq;
+
+	if (!is_sync) {
+		if (!ioprio_valid(bic->ioprio)) {
+			struct task_struct *tsk = current;
+
+			ioprio = task_nice_ioprio(tsk);
+			ioprio_class = task_nice_ioclass(tsk);
+		}
+		async_bfqq = bfq_async_queue_prio(bfqd, ioprio_class, ioprio);
+		bfqq = *async_bfqq;
+		if (bfqq)
+			goto out;
+	}
+
+	bfqq = kmem_cache_alloc_node(bfq_pool,
+				     GFP_NOWAIT | __GFP_ZERO | __GFP_NOWARN,
+				     bfqd->queue->node);
+	if (!bfqq) {
+		bfqq = &bfqd->oom_bfqq;
+		goto out;
+	}
+
+	bfq_init_bfqq(bfqd, bfqq, current->pid, is_sync);
+	bfq_init_prio_data(bfqq, bic);
+	bfq_log_bfqq(bfqd, bfqq, "allocated");
+
+	if (async_bfqq) {
+		/* an extra reference to pin the shared async queue */
+		bfqq->ref++;
+		*async_bfqq = bfqq;
+	}
+out:
+	bfqq->ref++;
+	return bfqq;
+}
+
+static void bfq_update_io_thinktime(struct bfq_data *bfqd,
+				    struct bfq_queue *bfqq)
+{
+	struct bfq_ttime *ttime = &bfqq->ttime;
+	unsigned long elapsed = jiffies - ttime->last_end_request;
+
+	elapsed = min(elapsed, 2UL * bfqd->bfq_slice_idle);
+
+	ttime->ttime_samples = (7 * ttime->ttime_samples + 256) / 8;
+	ttime->ttime_total = (7 * ttime->ttime_total + 256 * elapsed) / 8;
+	ttime->ttime_mean = (ttime->ttime_total + 128) / ttime->ttime_samples;
+}
+
+/*
+ * Disable idle window if the process thinks too long or the task has
+ * exited.
+ */
+static void bfq_update_idle_window(struct bfq_data *bfqd,
+				   struct bfq_queue *bfqq,
+				   struct bfq_io_cq *bic)
+{
+	int enable_idle;
+
+	if (!bfq_bfqq_sync(bfqq) || bfq_class_idle(bfqq))
+		return;
+
+	enable_idle = bfq_bfqq_idle_window(bfqq);
+
+	if (atomic_read(&bic->icq.ioc->active_ref) == 0 ||
+	    !bfqd->bfq_slice_idle)
+		enable_idle = 0;
+	else if (sample_valid(bfqq->ttime.ttime_samples))
+		enable_idle = bfqq->ttime.ttime_mean <= bfqd->bfq_slice_idle;
+
+	if (enable_idle)
+		bfq_mark_bfqq_idle_window(bfqq);
+	else
+		bfq_clear_bfqq_idle_window(bfqq);
+}
+
+/*
+ * Called when a new fs request (rq) is added to bfqq.  Stop idling if the
+ * queue in service was waiting for it, and end the idling of another
+ * queue early if this one has a raised weight and that one has not.
+ */
+static void bfq_rq_enqueued(struct bfq_data *bfqd, struct bfq_queue *bfqq,
+			    struct request *rq)
+{
+	struct bfq_queue *in_service = bfqd->in_service_queue;
+
+	if (bfq_bfqq_sync(bfqq)) {
+		bfq_update_io_thinktime(bfqd, bfqq);
+		bfq_update_idle_window(bfqd, bfqq, RQ_BIC(rq));
+	}
+
+	if (!in_service || !bfq_bfqq_wait_request(in_service))
+		return;
+
+	if (bfqq == in_service) {
+		del_timer(&bfqd->idle_slice_timer);
+		bfq_clear_bfqq_wait_request(bfqq);
+		__blk_run_queue(bfqd->queue);
+	} else if (bfqq->wr_coeff > in_service->wr_coeff &&
+		   bfqq->ioprio_class <= in_service->ioprio_class) {
+		bfq_bfqq_expire(bfqd, in_service, BFQ_BFQQ_PREEMPTED);
+		__blk_run_queue(bfqd->queue);
+	}
+}
+
+static void bfq_add_rq_rb(struct request *rq)
+{
+	struct bfq_queue *bfqq = RQ_BFQQ(rq);
+	struct bfq_data *bfqd = bfqq->bfqd;
+
+	bfqq->queued[rq_is_sync(rq)]++;
+	bfqd->rq_queued++;
+
+	elv_rb_add(&bfqq->sort_list, rq);
+
+	bfqq->next_rq = bfq_choose_req(bfqd, bfqq->next_rq, rq);
+
+	if (!bfq_bfqq_busy(bfqq))
+		bfq_add_bfqq_busy(bfqd, bfqq);
+}
+
+static void bfq_remove_request(struct request *rq)
+{
+	struct bfq_queue *bfqq = RQ_BFQQ(rq);
+	struct bfq_data *bfqd = bfqq->bfqd;
+
+	if (bfqq->next_rq == rq)
+		bfqq->next_rq = bfq_find_next_rq(bfqd, bfqq, rq);
+
+	list_del_init(&rq->queuelist);
+	elv_rb_del(&bfqq->sort_list, rq);
+
+	BUG_ON(!bfqq->queued[rq_is_sync(rq)]);
+	bfqq->queued[rq_is_sync(rq)]--;
+	bfqd->rq_queued--;
+}
+
+static void bfq_insert_request(struct request_queue *q, struct request *rq)
+{
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+	struct bfq_queue *bfqq = RQ_BFQQ(rq);
+
+	bfq_log_bfqq(bfqd, bfqq, "insert_request");
+
+	rq->fifo_time = jiffies + bfqd->bfq_fifo_expire[rq_is_sync(rq)];
+	list_add_tail(&rq->queuelist, &bfqq->fifo);
+	bfq_add_rq_rb(rq);
+
+	bfq_rq_enqueued(bfqd, bfqq, rq);
+}
+
+/*
+ * Move request from internal lists to the request queue dispatch list.
+ */
+static void bfq_dispatch_insert(struct request_queue *q, struct request *rq)
+{
+	struct bfq_queue *bfqq = RQ_BFQQ(rq);
+
+	bfq_remove_request(rq);
+	bfqq->dispatched++;
+	elv_dispatch_sort(q, rq);
+}
+
+static struct request *
+bfq_find_rq_fmerge(struct bfq_data *bfqd, struct bio *bio)
+{
+	struct task_struct *tsk = current;
+	struct bfq_io_cq *bic;
+	struct bfq_queue *bfqq;
+
+	bic = bfq_bic_lookup(bfqd, tsk->io_context);
+	if (!bic)
+		return NULL;
+
+	bfqq = bic->bfqq[bfq_bio_sync(bio)];
+	if (bfqq)
+		return elv_rb_find(&bfqq->sort_list, bio_end_sector(bio));
+
+	return NULL;
+}
+
+static int bfq_merge(struct request_queue *q, struct request **req,
+		     struct bio *bio)
+{
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	__rq = bfq_find_rq_fmerge(bfqd, bio);
+	if (__rq && elv_rq_merge_ok(__rq, bio)) {
+		*req = __rq;
+		return ELEVATOR_FRONT_MERGE;
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void bfq_merged_request(struct request_queue *q, struct request *req,
+			       int type)
+{
+	if (type == ELEVATOR_FRONT_MERGE) {
+		struct bfq_queue *bfqq = RQ_BFQQ(req);
+
+		elv_rb_del(&bfqq->sort_list, req);
+		bfqq->queued[rq_is_sync(req)]--;
+		bfqq->bfqd->rq_queued--;
+		bfq_add_rq_rb(req);
+	}
+}
+
+static void
+bfq_merged_requests(struct request_queue *q, struct request *rq,
+		    struct request *next)
+{
+	struct bfq_queue *bfqq = RQ_BFQQ(next);
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+
+	/*
+	 * reposition in fifo if next is older than rq
+	 */
+	if (!list_empty(&rq->queuelist) && !list_empty(&next->queuelist) &&
+	    time_before(next->fifo_time, rq->fifo_time) &&
+	    bfqq == RQ_BFQQ(rq)) {
+		list_move(&rq->queuelist, &next->queuelist);
+		rq->fifo_time = next->fifo_time;
+	}
+
+	if (bfqq->next_rq == next && bfqq == RQ_BFQQ(rq))
+		bfqq->next_rq = rq;
+	bfq_remove_request(next);
+
+	if (bfq_bfqq_busy(bfqq) && RB_EMPTY_ROOT(&bfqq->sort_list) &&
+	    bfqq != bfqd->in_service_queue)
+		bfq_del_bfqq_busy(bfqd, bfqq);
+}
+
+static int bfq_allow_merge(struct request_queue *q, struct request *rq,
+			   struct bio *bio)
+{
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+	struct bfq_io_cq *bic;
+
+	/*
+	 * Disallow merge of a sync bio into an async request.
+	 */
+	if (bfq_bio_sync(bio) && !rq_is_sync(rq))
+		return false;
+
+	/*
+	 * Lookup the bfqq that this bio will be queued with and allow
+	 * merge only if rq is queued there.
+	 */
+	bic = bfq_bic_lookup(bfqd, current->io_context);
+	if (!bic)
+		return false;
+
+	return bic->bfqq[bfq_bio_sync(bio)] == RQ_BFQQ(rq);
+}
+
+static void bfq_activate_request(struct request_queue *q, struct request *rq)
+{
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+
+	bfqd->rq_in_driver++;
+	bfq_log_bfqq(bfqd, RQ_BFQQ(rq), "activate rq, drv=%d",
+		     bfqd->rq_in_driver);
+
+	bfqd->last_position = blk_rq_pos(rq) + blk_rq_sectors(rq);
+}
+
+static void bfq_deactivate_request(struct request_queue *q,
+				   struct request *rq)
+{
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+
+	WARN_ON(!bfqd->rq_in_driver);
+	bfqd->rq_in_driver--;
+	bfq_log_bfqq(bfqd, RQ_BFQQ(rq), "deactivate rq, drv=%d",
+		     bfqd->rq_in_driver);
+}
+
+/*
+ * Work out whether the device queues requests internally (NCQ), from the
+ * peak number of requests it accepted while we had plenty to give it.
+ */
+static void bfq_update_hw_tag(struct bfq_data *bfqd)
+{
+	if (bfqd->rq_in_driver > bfqd->max_rq_in_driver)
+		bfqd->max_rq_in_driver = bfqd->rq_in_driver;
+
+	if (bfqd->hw_tag == 1)
+		return;
+
+	/*
+	 * This sample is valid if the number of outstanding requests
+	 * is large enough to allow a queueing behavior.  Note that the
+	 * sum is not exact, as it's not taking into account deactivated
+	 * requests.
+	 */
+	if (bfqd->rq_in_driver + bfqd->rq_queued < BFQ_HW_QUEUE_THRESHOLD)
+		return;
+
+	if (bfqd->hw_tag_samples++ < BFQ_HW_QUEUE_SAMPLES)
+		return;
+
+	bfqd->hw_tag = bfqd->max_rq_in_driver >= BFQ_HW_QUEUE_THRESHOLD;
+	bfqd->max_rq_in_driver = 0;
+	bfqd->hw_tag_samples = 0;
+}
+
+static void bfq_completed_request(struct request_queue *q, struct request *rq)
+{
+	struct bfq_queue *bfqq = RQ_BFQQ(rq);
+	struct bfq_data *bfqd = bfqq->bfqd;
+
+	bfq_log_bfqq(bfqd, bfqq, "complete rqnoidle %d",
+		     !!(rq->cmd_flags & REQ_NOIDLE));
+
+	bfq_update_hw_tag(bfqd);
+
+	WARN_ON(!bfqd->rq_in_driver);
+	WARN_ON(!bfqq->dispatched);
+	bfqd->rq_in_driver--;
+	bfqq->dispatched--;
+
+	if (rq_is_sync(rq))
+		bfqq->ttime.last_end_request = jiffies;
+
+	/*
+	 * The queue in service ran out of requests: idle for it if the
+	 * process is likely to issue another one soon, else move on.
+	 */
+	if (bfqq == bfqd->in_service_queue && !bfqq->dispatched &&
+	    RB_EMPTY_ROOT(&bfqq->sort_list) &&
+	    !bfq_bfqq_wait_request(bfqq)) {
+		if (bfq_bfqq_budget_timeout(bfqq))
+			bfq_bfqq_expire(bfqd, bfqq, BFQ_BFQQ_BUDGET_TIMEOUT);
+		else if (bfq_bfqq_must_idle(bfqd, bfqq) &&
+			 !(rq->cmd_flags & REQ_NOIDLE))
+			bfq_arm_slice_timer(bfqd, bfqq);
+		else
+			bfq_bfqq_expire(bfqd, bfqq,
+					BFQ_BFQQ_NO_MORE_REQUESTS);
+	}
+
+	if (!bfqd->rq_in_driver)
+		bfq_schedule_dispatch(bfqd);
+}
+
+static int bfq_may_queue(struct request_queue *q, int rw)
+{
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+	struct task_struct *tsk = current;
+	struct bfq_io_cq *bic;
+	struct bfq_queue *bfqq;
+
+	/*
+	 * don't force setup of a queue from here, as a call to may_queue
+	 * does not necessarily imply that a request actually will be queued.
+	 * so just lookup a possibly existing queue, or return 'may queue'
+	 * if that fails
+	 */
+	bic = bfq_bic_lookup(bfqd, tsk->io_context);
+	if (!bic)
+		return ELV_MQUEUE_MAY;
+
+	bfqq = bic->bfqq[rw_is_sync(rw)];
+	if (bfqq && bfq_bfqq_wait_request(bfqq) &&
+	    bfqq == bfqd->in_service_queue)
+		return ELV_MQUEUE_MUST;
+
+	return ELV_MQUEUE_MAY;
+}
+
+/*
+ * queue lock held here
+ */
+static void bfq_put_request(struct request *rq)
+{
+	struct bfq_queue *bfqq = RQ_BFQQ(rq);
+
+	if (bfqq) {
+		const int rw = rq_data_dir(rq);
+
+		BUG_ON(!bfqq->allocated[rw]);
+		bfqq->allocated[rw]--;
+
+		rq->elv.priv[0] = NULL;
+
+		bfq_put_queue(bfqq);
+	}
+}
+
+/*
+ * Allocate bfq data structures associated with this request.
+ */
+static int
+bfq_set_request(struct request_queue *q, struct request *rq, struct bio *bio,
+		gfp_t gfp_mask)
+{
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+	struct bfq_io_cq *bic = icq_to_bic(rq->elv.icq);
+	const int rw = rq_data_dir(rq);
+	const bool is_sync = rq_is_sync(rq);
+	struct bfq_queue *bfqq;
+
+	spin_lock_irq(q->queue_lock);
+
+	bfq_check_ioprio_changed(bic, bio);
+
+	bfqq = bic->bfqq[is_sync];
+	if (!bfqq || bfqq == &bfqd->oom_bfqq) {
+		if (bfqq)
+			bfq_put_queue(bfqq);
+		bfqq = bfq_get_queue(bfqd, is_sync, bic, bio);
+		bic->bfqq[is_sync] = bfqq;
+	}
+
+	bfq_init_prio_data(bfqq, bic);
+
+	bfqq->allocated[rw]++;
+	bfqq->ref++;
+	rq->elv.priv[0] = bfqq;
+
+	spin_unlock_irq(q->queue_lock);
+	return 0;
+}
+
+static void bfq_kick_queue(struct work_struct *work)
+{
+	struct bfq_data *bfqd =
+		container_of(work, struct bfq_data, unplug_work);
+	struct request_queue *q = bfqd->queue;
+
+	spin_lock_irq(q->queue_lock);
+	__blk_run_queue(bfqd->queue);
+	spin_unlock_irq(q->queue_lock);
+}
+
+/*
+ * Timer running if the queue in service is idling, waiting for its next
+ * request.
+ */
+static void bfq_idle_slice_timer(unsigned long data)
+{
+	struct bfq_data *bfqd = (struct bfq_data *) data;
+	struct bfq_queue *bfqq;
+	unsigned long flags;
+
+	bfq_log(bfqd, "idle timer fired");
+
+	spin_lock_irqsave(bfqd->queue->queue_lock, flags);
+
+	bfqq = bfqd->in_service_queue;
+	if (bfqq && bfq_bfqq_wait_request(bfqq)) {
+		bfq_clear_bfqq_wait_request(bfqq);
+
+		/*
+		 * a request raced with the timer, let dispatch handle it
+		 */
+		if (RB_EMPTY_ROOT(&bfqq->sort_list))
+			bfq_bfqq_expire(bfqd, bfqq,
+					bfq_bfqq_budget_timeout(bfqq) ?
+					BFQ_BFQQ_BUDGET_TIMEOUT :
+					BFQ_BFQQ_TOO_IDLE);
+	}
+
+	bfq_schedule_dispatch(bfqd);
+
+	spin_unlock_irqrestore(bfqd->queue->queue_lock, flags);
+}
+
+static void bfq_shutdown_timer_wq(struct bfq_data *bfqd)
+{
+	del_timer_sync(&bfqd->idle_slice_timer);
+	cancel_work_sync(&bfqd->unplug_work);
+}
+
+static void bfq_put_async_queues(struct bfq_data *bfqd)
+{
+	int i;
+
+	for (i = 0; i < IOPRIO_BE_NR; i++) {
+		if (bfqd->async_bfqq[0][i])
+			bfq_put_queue(bfqd->async_bfqq[0][i]);
+		if (bfqd->async_bfqq[1][i])
+			bfq_put_queue(bfqd->async_bfqq[1][i]);
+	}
+
+	if (bfqd->async_idle_bfqq)
+		bfq_put_queue(bfqd->async_idle_bfqq);
+}
+
+static void bfq_exit_queue(struct elevator_queue *e)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+	struct request_queue *q = bfqd->queue;
+
+	bfq_shutdown_timer_wq(bfqd);
+
+	spin_lock_irq(q->queue_lock);
+
+	if (bfqd->in_service_queue)
+		__bfq_bfqq_expire(bfqd, bfqd->in_service_queue);
+
+	bfq_put_async_queues(bfqd);
+
+	spin_unlock_irq(q->queue_lock);
+
+	bfq_shutdown_timer_wq(bfqd);
+
+	kfree(bfqd);
+}
+
+static int bfq_init_queue(struct request_queue *q, struct elevator_type *e)
+{
+	struct bfq_data *bfqd;
+	struct elevator_queue *eq;
+	int i;
+
+	eq = elevator_alloc(q, e);
+	if (!eq)
+		return -ENOMEM;
+
+	bfqd = kzalloc_node(sizeof(*bfqd), GFP_KERNEL, q->node);
+	if (!bfqd) {
+		kobject_put(&eq->kobj);
+		return -ENOMEM;
+	}
+	eq->elevator_data = bfqd;
+
+	bfqd->queue = q;
+	spin_lock_irq(q->queue_lock);
+	q->elevator = eq;
+	spin_unlock_irq(q->queue_lock);
+
+	for (i = 0; i < BFQ_IOPRIO_CLASSES; i++)
+		bfqd->st[i].active = RB_ROOT;
+
+	bfqd->bfq_quantum = bfq_quantum;
+	bfqd->bfq_fifo_expire[0] = bfq_fifo_expire[0];
+	bfqd->bfq_fifo_expire[1] = bfq_fifo_expire[1];
+	bfqd->bfq_slice_idle = bfq_slice_idle;
+	bfqd->bfq_max_budget = bfq_default_max_budget;
+	bfqd->bfq_timeout[0] = bfq_timeout[0];
+	bfqd->bfq_timeout[1] = bfq_timeout[1];
+	bfqd->bfq_low_latency = 1;
+	bfqd->bfq_wr_coeff = bfq_wr_coeff;
+	bfqd->bfq_wr_max_time = bfq_wr_max_time;
+	bfqd->bfq_wr_rt_max_time = bfq_wr_rt_max_time;
+	bfqd->bfq_wr_min_idle_time = bfq_wr_min_idle_time;
+	bfqd->bfq_wr_max_softrt_rate = bfq_wr_max_softrt_rate;
+	bfqd->hw_tag = -1;
+
+	/*
+	 * Our fallback bfqq if bfq_get_queue() runs into OOM issues.
+	 * Grab a permanent reference to it, so that the normal code flow
+	 * will not attempt to free it.
+	 */
+	bfq_init_bfqq(bfqd, &bfqd->oom_bfqq, 0, 1);
+	bfqd->oom_bfqq.ref++;
+	bfqd->oom_bfqq.ioprio = IOPRIO_NORM;
+	bfqd->oom_bfqq.ioprio_class = IOPRIO_CLASS_BE;
+	bfqd->oom_bfqq.orig_weight = bfq_ioprio_to_weight(IOPRIO_NORM);
+	bfqd->oom_bfqq.weight = bfqd->oom_bfqq.orig_weight;
+	bfq_clear_bfqq_prio_changed(&bfqd->oom_bfqq);
+
+	init_timer(&bfqd->idle_slice_timer);
+	bfqd->idle_slice_timer.function = bfq_idle_slice_timer;
+	bfqd->idle_slice_timer.data = (unsigned long) bfqd;
+
+	INIT_WORK(&bfqd->unplug_work, bfq_kick_queue);
+
+	return 0;
+}
+
+/*
+ * sysfs parts below -->
+ */
+static ssize_t
+bfq_var_show(unsigned int var, char *page)
+{
+	return sprintf(page, "%u\n", var);
+}
+
+static ssize_t
+bfq_var_store(unsigned int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtoul(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct bfq_data *bfqd = e->elevator_data;			\
+	unsigned int __data = __VAR;					\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return bfq_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(bfq_quantum_show, bfqd->bfq_quantum, 0);
+SHOW_FUNCTION(bfq_fifo_expire_sync_show, bfqd->bfq_fifo_expire[1], 1);
+SHOW_FUNCTION(bfq_fifo_expire_async_show, bfqd->bfq_fifo_expire[0], 1);
+SHOW_FUNCTION(bfq_slice_idle_show, bfqd->bfq_slice_idle, 1);
+SHOW_FUNCTION(bfq_max_budget_show, bfqd->bfq_max_budget, 0);
+SHOW_FUNCTION(bfq_timeout_sync_show, bfqd->bfq_timeout[1], 1);
+SHOW_FUNCTION(bfq_timeout_async_show, bfqd->bfq_timeout[0], 1);
+SHOW_FUNCTION(bfq_low_latency_show, bfqd->bfq_low_latency, 0);
+SHOW_FUNCTION(bfq_wr_coeff_show, bfqd->bfq_wr_coeff, 0);
+SHOW_FUNCTION(bfq_wr_max_time_show, bfqd->bfq_wr_max_time, 1);
+SHOW_FUNCTION(bfq_wr_rt_max_time_show, bfqd->bfq_wr_rt_max_time, 1);
+SHOW_FUNCTION(bfq_wr_min_idle_time_show, bfqd->bfq_wr_min_idle_time, 1);
+SHOW_FUNCTION(bfq_wr_max_softrt_rate_show, bfqd->bfq_wr_max_softrt_rate, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct bfq_data *bfqd = e->elevator_data;			\
+	unsigned int __data;						\
+	int ret = bfq_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(bfq_quantum_store, &bfqd->bfq_quantum, 1, UINT_MAX, 0);
+STORE_FUNCTION(bfq_fifo_expire_sync_store, &bfqd->bfq_fifo_expire[1], 1,
+		UINT_MAX, 1);
+STORE_FUNCTION(bfq_fifo_expire_async_store, &bfqd->bfq_fifo_expire[0], 1,
+		UINT_MAX, 1);
+STORE_FUNCTION(bfq_slice_idle_store, &bfqd->bfq_slice_idle, 0, UINT_MAX, 1);
+STORE_FUNCTION(bfq_max_budget_store, &bfqd->bfq_max_budget, 32, INT_MAX, 0);
+STORE_FUNCTION(bfq_timeout_sync_store, &bfqd->bfq_timeout[1], 1, UINT_MAX, 1);
+STORE_FUNCTION(bfq_timeout_async_store, &bfqd->bfq_timeout[0], 1,
+		UINT_MAX, 1);
+STORE_FUNCTION(bfq_low_latency_store, &bfqd->bfq_low_latency, 0, 1, 0);
+STORE_FUNCTION(bfq_wr_coeff_store, &bfqd->bfq_wr_coeff, 1, INT_MAX, 0);
+STORE_FUNCTION(bfq_wr_max_time_store, &bfqd->bfq_wr_max_time, 0,
+		UINT_MAX, 1);
+STORE_FUNCTION(bfq_wr_rt_max_time_store, &bfqd->bfq_wr_rt_max_time, 0,
+		UINT_MAX, 1);
+STORE_FUNCTION(bfq_wr_min_idle_time_store, &bfqd->bfq_wr_min_idle_time, 0,
+		UINT_MAX, 1);
+STORE_FUNCTION(bfq_wr_max_softrt_rate_store, &bfqd->bfq_wr_max_softrt_rate,
+		0, INT_MAX, 0);
+#undef STORE_FUNCTION
+
+#define BFQ_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, bfq_##name##_show, bfq_##name##_store)
+
+static struct elv_fs_entry bfq_attrs[] = {
+	BFQ_ATTR(quantum),
+	BFQ_ATTR(fifo_expire_sync),
+	BFQ_ATTR(fifo_expire_async),
+	BFQ_ATTR(slice_idle),
+	BFQ_ATTR(max_budget),
+	BFQ_ATTR(timeout_sync),
+	BFQ_ATTR(timeout_async),
+	BFQ_ATTR(low_latency),
+	BFQ_ATTR(wr_coeff),
+	BFQ_ATTR(wr_max_time),
+	BFQ_ATTR(wr_rt_max_time),
+	BFQ_ATTR(wr_min_idle_time),
+	BFQ_ATTR(wr_max_softrt_rate),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_bfq = {
+	.ops = {
+		.elevator_merge_fn = 		bfq_merge,
+		.elevator_merged_fn =		bfq_merged_request,
+		.elevator_merge_req_fn =	bfq_merged_requests,
+		.elevator_allow_merge_fn =	bfq_allow_merge,
+		.elevator_dispatch_fn =		bfq_dispatch_requests,
+		.elevator_add_req_fn =		bfq_insert_request,
+		.elevator_activate_req_fn =	bfq_activate_request,
+		.elevator_deactivate_req_fn =	bfq_deactivate_request,
+		.elevator_completed_req_fn =	bfq_completed_request,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_exit_icq_fn =		bfq_exit_icq,
+		.elevator_set_req_fn =		bfq_set_request,
+		.elevator_put_req_fn =		bfq_put_request,
+		.elevator_may_queue_fn =	bfq_may_queue,
+		.elevator_init_fn =		bfq_init_queue,
+		.elevator_exit_fn =		bfq_exit_queue,
+	},
+	.icq_size	=	sizeof(struct bfq_io_cq),
+	.icq_align	=	__alignof__(struct bfq_io_cq),
+	.elevator_attrs =	bfq_attrs,
+	.elevator_name	=	"bfq",
+	.elevator_owner =	THIS_MODULE,
+};
+
+static int __init bfq_init(void)
+{
+	int ret;
+
+	/*
+	 * could be 0 on HZ < 1000 setups
+	 */
+	if (!bfq_slice_idle)
+		bfq_slice_idle = 1;
+	if (!bfq_timeout[0])
+		bfq_timeout[0] = 1;
+
+	bfq_pool = KMEM_CACHE(bfq_queue, 0);
+	if (!bfq_pool)
+		return -ENOMEM;
+
+	ret = elv_register(&iosched_bfq);
+	if (ret) {
+		kmem_cache_destroy(bfq_pool);
+		return ret;
+	}
+
+	return 0;
+}
+
+static void __exit bfq_exit(void)
+{
+	elv_unregister(&iosched_bfq);
+	kmem_cache_destroy(bfq_pool);
+}
+
+module_init(bfq_init);
+module_exit(bfq_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Budget Fair Queueing IO scheduler");
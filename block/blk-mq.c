@@ -904,7 +904,7 @@ void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async)
 	    !blk_mq_hw_queue_mapped(hctx)))
 		return;
 
-	if (!async) {
+	if (!async && !(hctx->flags & BLK_MQ_F_BLOCKING)) {
 		int cpu = get_cpu();
 		if (cpumask_test_cpu(cpu, hctx->cpumask)) {
 			__blk_mq_run_hw_queue(hctx);
@@ -1271,7 +1271,8 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	 * queue it up like normal since we can potentially save some
 	 * CPU this way.
 	 */
-	if (is_sync && !(data.hctx->flags & BLK_MQ_F_DEFER_ISSUE)) {
+	if (is_sync && !(data.hctx->flags &
+			 (BLK_MQ_F_DEFER_ISSUE | BLK_MQ_F_BLOCKING))) {
 		struct blk_mq_queue_data bd = {
 			.rq = rq,
 			.list = NULL,
@@ -1314,6 +1315,37 @@ done:
 	blk_mq_put_ctx(data.ctx);
 }
 
+/*
+ * Issue a request to a driver that may sleep in ->queue_rq(), from the
+ * submitting task rather than from kblockd.  The software queue must not
+ * be held.
+ */
+static void blk_mq_issue_blocking(struct blk_mq_hw_ctx *hctx,
+				  struct request *rq)
+{
+	struct blk_mq_queue_data bd = {
+		.rq = rq,
+		.list = NULL,
+		.last = 1
+	};
+	int ret;
+
+	if (!test_bit(BLK_MQ_S_STOPPED, &hctx->state)) {
+		ret = rq->q->mq_ops->queue_rq(hctx, &bd);
+		if (ret == BLK_MQ_RQ_QUEUE_OK)
+			return;
+
+		__blk_mq_requeue_request(rq);
+		if (ret == BLK_MQ_RQ_QUEUE_ERROR) {
+			rq->errors = -EIO;
+			blk_mq_end_request(rq, rq->errors);
+			return;
+		}
+	}
+
+	blk_mq_insert_request(rq, false, true, true);
+}
+
 /*
  * Single hardware queue variant. This will attempt to use any per-process
  * plug for merging and IO deferral.
@@ -1375,6 +1407,17 @@ static void blk_sq_make_request(struct request_queue *q, struct bio *bio)
 		}
 	}
 
+	/*
+	 * Running a blocking queue always goes through kblockd, so hand
+	 * SYNC requests to the driver right here instead.
+	 */
+	if (is_sync && (data.hctx->flags & BLK_MQ_F_BLOCKING)) {
+		blk_mq_bio_to_request(rq, bio);
+		blk_mq_put_ctx(data.ctx);
+		blk_mq_issue_blocking(data.hctx, rq);
+		return;
+	}
+
 	if (!blk_mq_merge_queue_io(data.hctx, data.ctx, rq, bio)) {
 		/*
 		 * For a SYNC request, send it to the hardware immediately. For
@@ -389,6 +389,7 @@ void af_alg_free_sg(struct af_alg_sgl *sgl)
 
 	for (i = 0; i < sgl->npages; i++)
 		put_page(sgl->pages[i]);
+	sgl->npages = 0;
 }
 EXPORT_SYMBOL_GPL(af_alg_free_sg);
 
@@ -31,9 +31,51 @@ struct hash_ctx {
 	unsigned int len;
 	bool more;
 
+	/* bytes in the pages queued on sgl by hash_sendpage() */
+	unsigned int queued;
+
 	struct ahash_request req;
 };
 
+/*
+ * splice() hands us one page per sendpage() call.  Updating the hash for
+ * each of them costs a request round trip per page, which for offload
+ * engines means one DMA transfer per page, so the pages are queued on
+ * ctx->sgl instead and hashed ALG_MAX_PAGES at a time.
+ */
+static int hash_flush_pages(struct hash_ctx *ctx)
+{
+	int err;
+
+	if (!ctx->sgl.npages)
+		return 0;
+
+	sg_mark_end(ctx->sgl.sg + ctx->sgl.npages - 1);
+	ahash_request_set_crypt(&ctx->req, ctx->sgl.sg, NULL, ctx->queued);
+
+	err = af_alg_wait_for_completion(crypto_ahash_update(&ctx->req),
+					 &ctx->completion);
+	af_alg_free_sg(&ctx->sgl);
+	ctx->queued = 0;
+
+	return err;
+}
+
+static void hash_queue_page(struct hash_ctx *ctx, struct page *page,
+			    int offset, size_t size)
+{
+	unsigned int n = ctx->sgl.npages;
+
+	if (!n)
+		sg_init_table(ctx->sgl.sg, ALG_MAX_PAGES);
+
+	get_page(page);
+	ctx->sgl.pages[n] = page;
+	sg_set_page(ctx->sgl.sg + n, page, size, offset);
+	ctx->sgl.npages++;
+	ctx->queued += size;
+}
+
 static int hash_sendmsg(struct socket *sock, struct msghdr *msg,
 			size_t ignored)
 {
@@ -54,6 +96,10 @@ static int hash_sendmsg(struct socket *sock, struct msghdr *msg,
 			goto unlock;
 	}
 
+	err = hash_flush_pages(ctx);
+	if (err)
+		goto unlock;
+
 	ctx->more = 0;
 
 	while (msg_data_left(msg)) {
@@ -107,27 +153,40 @@ static ssize_t hash_sendpage(struct socket *sock, struct page *page,
 		flags |= MSG_MORE;
 
 	lock_sock(sk);
-	sg_init_table(ctx->sgl.sg, 1);
-	sg_set_page(ctx->sgl.sg, page, size, offset);
-
-	ahash_request_set_crypt(&ctx->req, ctx->sgl.sg, ctx->result, size);
 
-	if (!(flags & MSG_MORE)) {
-		if (ctx->more)
-			err = crypto_ahash_finup(&ctx->req);
-		else
-			err = crypto_ahash_digest(&ctx->req);
-	} else {
+	if (flags & MSG_MORE) {
 		if (!ctx->more) {
 			err = crypto_ahash_init(&ctx->req);
 			if (err)
 				goto unlock;
+			ctx->more = 1;
 		}
 
-		err = crypto_ahash_update(&ctx->req);
+		hash_queue_page(ctx, page, offset, size);
+		err = 0;
+		if (ctx->sgl.npages == ALG_MAX_PAGES)
+			err = hash_flush_pages(ctx);
+		goto unlock;
 	}
 
-	err = af_alg_wait_for_completion(err, &ctx->completion);
+	/* the last page goes out with whatever is still queued */
+	if (ctx->sgl.npages == ALG_MAX_PAGES) {
+		err = hash_flush_pages(ctx);
+		if (err)
+			goto unlock;
+	}
+
+	hash_queue_page(ctx, page, offset, size);
+	sg_mark_end(ctx->sgl.sg + ctx->sgl.npages - 1);
+	ahash_request_set_crypt(&ctx->req, ctx->sgl.sg, ctx->result,
+				ctx->queued);
+
+	err = af_alg_wait_for_completion(ctx->more ?
+					 crypto_ahash_finup(&ctx->req) :
+					 crypto_ahash_digest(&ctx->req),
+					 &ctx->completion);
+	af_alg_free_sg(&ctx->sgl);
+	ctx->queued = 0;
 	if (err)
 		goto unlock;
 
@@ -156,6 +215,9 @@ static int hash_recvmsg(struct socket *sock, struct msghdr *msg, size_t len,
 	lock_sock(sk);
 	if (ctx->more) {
 		ctx->more = 0;
+		err = hash_flush_pages(ctx);
+		if (err)
+			goto unlock;
 		ahash_request_set_crypt(&ctx->req, NULL, ctx->result, 0);
 		err = af_alg_wait_for_completion(crypto_ahash_final(&ctx->req),
 						 &ctx->completion);
@@ -183,7 +245,11 @@ static int hash_accept(struct socket *sock, struct socket *newsock, int flags)
 	struct hash_ctx *ctx2;
 	int err;
 
-	err = crypto_ahash_export(req, state);
+	lock_sock(sk);
+	err = hash_flush_pages(ctx);
+	if (!err)
+		err = crypto_ahash_export(req, state);
+	release_sock(sk);
 	if (err)
 		return err;
 
@@ -247,6 +313,7 @@ static void hash_sock_destruct(struct sock *sk)
 	struct alg_sock *ask = alg_sk(sk);
 	struct hash_ctx *ctx = ask->private;
 
+	af_alg_free_sg(&ctx->sgl);
 	sock_kzfree_s(sk, ctx->result,
 		      crypto_ahash_digestsize(crypto_ahash_reqtfm(&ctx->req)));
 	sock_kfree_s(sk, ctx, ctx->len);
@@ -274,6 +341,8 @@ static int hash_accept_parent(void *private, struct sock *sk)
 
 	ctx->len = len;
 	ctx->more = 0;
+	ctx->sgl.npages = 0;
+	ctx->queued = 0;
 	af_alg_init_completion(&ctx->completion);
 
 	ask->private = ctx;
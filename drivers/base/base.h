@@ -52,6 +52,8 @@ struct driver_private {
 };
 #define to_driver(obj) container_of(obj, struct driver_private, kobj)
 
+#define DEFERRED_MAX_SUPPLIERS	8
+
 /**
  * struct device_private - structure to hold the private to the driver core portions of the device structure.
  *
@@ -63,6 +65,16 @@ struct driver_private {
  *	binding of drivers which were unable to get all the resources needed by
  *	the device; typically because it depends on another driver getting
  *	probed first.
+ * @deferred_suppliers - device tree nodes the device referenced when it last
+ *	deferred; its probe is only retried when one of them (or an ancestor)
+ *	gets bound.  No entries means any bind retries it.
+ * @num_deferred_suppliers - number of valid @deferred_suppliers entries
+ * @probe_stats - entry in the list of devices with probe statistics
+ * @probe_attempts - number of calls into the driver's probe
+ * @probe_deferrals - number of those that returned -EPROBE_DEFER
+ * @probe_result - return value of the last probe
+ * @probe_time_ns - time spent in probe over all attempts
+ * @probe_last_ns - time spent in the last probe
  * @device - pointer back to the struct class that this structure is
  * associated with.
  *
@@ -74,6 +86,14 @@ struct device_private {
 	struct klist_node knode_driver;
 	struct klist_node knode_bus;
 	struct list_head deferred_probe;
+	struct device_node *deferred_suppliers[DEFERRED_MAX_SUPPLIERS];
+	unsigned int num_deferred_suppliers;
+	struct list_head probe_stats;
+	unsigned int probe_attempts;
+	unsigned int probe_deferrals;
+	int probe_result;
+	u64 probe_time_ns;
+	u64 probe_last_ns;
 	struct device *device;
 };
 #define to_device_private_parent(obj)	\
@@ -110,7 +130,10 @@ extern void bus_remove_driver(struct device_driver *drv);
 
 extern void driver_detach(struct device_driver *drv);
 extern int driver_probe_device(struct device_driver *drv, struct device *dev);
+extern bool driver_allows_async_probing(struct device_driver *drv);
+extern void device_initial_probe(struct device *dev);
 extern void driver_deferred_probe_del(struct device *dev);
+extern void driver_probe_stats_del(struct device *dev);
 static inline int driver_match_device(struct device_driver *drv,
 				      struct device *dev)
 {
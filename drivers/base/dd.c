@@ -23,7 +23,12 @@
 #include <linux/kthread.h>
 #include <linux/wait.h>
 #include <linux/async.h>
+#include <linux/ctype.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/of.h>
 #include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
 #include <linux/pinctrl/devinfo.h>
 
 #include "base.h"
@@ -41,9 +46,17 @@
  *
  * Deferred probe maintains two lists of devices, a pending list and an active
  * list.  A driver returning -EPROBE_DEFER causes the device to be added to the
- * pending list.  A successful driver probe will trigger moving all devices
- * from the pending to the active list so that the workqueue will eventually
- * retry them.
+ * pending list.  A successful driver probe will trigger moving devices from
+ * the pending to the active list so that the workqueue will eventually retry
+ * them.
+ *
+ * When a device defers, the device tree nodes it references (clocks, gpios,
+ * regulators, pinctrl states, ...) are recorded as its suppliers, and a bind
+ * only moves the devices that reference the bound device's node or one of
+ * its children.  Devices without such information are moved on every bind.
+ * Drivers may also defer for reasons the device tree does not show, so once
+ * binding has been quiet for DEFERRED_PROBE_SWEEP_DELAY all pending devices
+ * are retried regardless.
  *
  * The deferred_probe_mutex must be held any time the deferred_probe_*_list
  * of the (struct device*)->p->deferred_probe pointers are manipulated
@@ -53,6 +66,13 @@ static LIST_HEAD(deferred_probe_pending_list);
 static LIST_HEAD(deferred_probe_active_list);
 static struct workqueue_struct *deferred_wq;
 static atomic_t deferred_trigger_count = ATOMIC_INIT(0);
+static atomic_t deferred_bound_count = ATOMIC_INIT(0);
+
+#define DEFERRED_PROBE_SWEEP_DELAY	(HZ / 10)
+
+/* Devices that have been probed at least once, for debugfs */
+static DEFINE_MUTEX(probe_stats_mutex);
+static LIST_HEAD(probe_stats_list);
 
 /*
  * deferred_probe_work_func() - Retry probing devices in the active list.
@@ -109,11 +129,153 @@ static void deferred_probe_work_func(struct work_struct *work)
 }
 static DECLARE_WORK(deferred_probe_work, deferred_probe_work_func);
 
+struct deferred_suppliers {
+	struct device_node *np[DEFERRED_MAX_SUPPLIERS];
+	unsigned int num;
+	bool overflow;
+};
+
+#ifdef CONFIG_OF
+/* phandle lists with arguments that name a supplier */
+static const struct {
+	const char *list;
+	const char *cells;
+} deferred_supplier_lists[] = {
+	{ "clocks",		"#clock-cells" },
+	{ "dmas",		"#dma-cells" },
+	{ "gpios",		"#gpio-cells" },
+	{ "io-channels",	"#io-channel-cells" },
+	{ "mboxes",		"#mbox-cells" },
+	{ "phys",		"#phy-cells" },
+	{ "pwms",		"#pwm-cells" },
+	{ "resets",		"#reset-cells" },
+};
+
+/* Takes over the reference on @np */
+static void deferred_supplier_add(struct deferred_suppliers *s,
+				  struct device_node *np)
+{
+	unsigned int i;
+
+	if (!np)
+		return;
+
+	for (i = 0; i < s->num; i++)
+		if (s->np[i] == np)
+			goto put;
+
+	if (s->num < DEFERRED_MAX_SUPPLIERS) {
+		s->np[s->num++] = np;
+		return;
+	}
+	s->overflow = true;
+put:
+	of_node_put(np);
+}
+
+static void deferred_supplier_add_list(struct deferred_suppliers *s,
+				       struct device_node *np,
+				       const char *list, const char *cells)
+{
+	struct of_phandle_args args;
+	int i, count;
+
+	count = of_count_phandle_with_args(np, list, cells);
+	for (i = 0; i < count; i++)
+		if (!of_parse_phandle_with_args(np, list, cells, i, &args))
+			deferred_supplier_add(s, args.np);
+}
+
+static bool deferred_prop_has_suffix(const char *name, const char *suffix)
+{
+	size_t len = strlen(name), slen = strlen(suffix);
+
+	return len > slen && !strcmp(name + len - slen, suffix);
+}
+
+static void deferred_probe_find_suppliers(struct device *dev,
+					  struct deferred_suppliers *s)
+{
+	struct device_node *np = dev->of_node;
+	struct property *prop;
+	unsigned int i;
+
+	if (!np)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(deferred_supplier_lists); i++)
+		deferred_supplier_add_list(s, np,
+					   deferred_supplier_lists[i].list,
+					   deferred_supplier_lists[i].cells);
+
+	for_each_property_of_node(np, prop) {
+		const char *name = prop->name;
+
+		if (deferred_prop_has_suffix(name, "-gpios") ||
+		    deferred_prop_has_suffix(name, "-gpio"))
+			deferred_supplier_add_list(s, np, name, "#gpio-cells");
+		else if (!strncmp(name, "pinctrl-", 8) && isdigit(name[8]))
+			deferred_supplier_add_list(s, np, name, NULL);
+		else if (deferred_prop_has_suffix(name, "-supply") ||
+			 !strcmp(name, "interrupt-parent") ||
+			 !strcmp(name, "phy-handle"))
+			deferred_supplier_add(s, of_parse_phandle(np, name, 0));
+	}
+
+	/* Too many to track: fall back to retrying on every bind */
+	if (s->overflow) {
+		while (s->num)
+			of_node_put(s->np[--s->num]);
+	}
+}
+
+/* Is @sup the node of @supplier, or one of its descendants? */
+static bool deferred_supplier_match(struct device_node *sup,
+				    struct device *supplier)
+{
+	struct device_node *np = supplier->of_node;
+
+	if (!np)
+		return false;
+
+	for (; sup; sup = sup->parent)
+		if (sup == np)
+			return true;
+	return false;
+}
+#else
+static inline void deferred_probe_find_suppliers(struct device *dev,
+						 struct deferred_suppliers *s)
+{
+}
+
+static inline bool deferred_supplier_match(struct device_node *sup,
+					   struct device *supplier)
+{
+	return false;
+}
+#endif
+
+/* Must be called with deferred_probe_mutex held */
+static void deferred_probe_put_suppliers(struct device_private *p)
+{
+	while (p->num_deferred_suppliers)
+		of_node_put(p->deferred_suppliers[--p->num_deferred_suppliers]);
+}
+
 static void driver_deferred_probe_add(struct device *dev)
 {
+	struct deferred_suppliers s = { .num = 0 };
+
+	deferred_probe_find_suppliers(dev, &s);
+
 	mutex_lock(&deferred_probe_mutex);
+	deferred_probe_put_suppliers(dev->p);
+	memcpy(dev->p->deferred_suppliers, s.np, s.num * sizeof(s.np[0]));
+	dev->p->num_deferred_suppliers = s.num;
 	if (list_empty(&dev->p->deferred_probe)) {
-		dev_dbg(dev, "Added to deferred list\n");
+		dev_dbg(dev, "Added to deferred list, %u supplier(s)\n",
+			s.num);
 		list_add_tail(&dev->p->deferred_probe, &deferred_probe_pending_list);
 	}
 	mutex_unlock(&deferred_probe_mutex);
@@ -126,6 +288,7 @@ void driver_deferred_probe_del(struct device *dev)
 		dev_dbg(dev, "Removed from deferred list\n");
 		list_del_init(&dev->p->deferred_probe);
 	}
+	deferred_probe_put_suppliers(dev->p);
 	mutex_unlock(&deferred_probe_mutex);
 }
 
@@ -171,6 +334,214 @@ static void driver_deferred_probe_trigger(void)
 	queue_work(deferred_wq, &deferred_probe_work);
 }
 
+static void deferred_probe_sweep_func(struct work_struct *work)
+{
+	driver_deferred_probe_trigger();
+}
+static DECLARE_DELAYED_WORK(deferred_probe_sweep_work,
+			    deferred_probe_sweep_func);
+
+/**
+ * driver_deferred_probe_trigger_for() - Re-probe the consumers of a device
+ * @supplier: device that was just bound to a driver
+ *
+ * Moves only the pending devices that reference @supplier, or that have no
+ * supplier information, to the active list; everything else waits for the
+ * sweep scheduled once binding goes quiet.
+ */
+static void driver_deferred_probe_trigger_for(struct device *supplier)
+{
+	struct device_private *p, *n;
+	unsigned int i;
+	bool kick = false;
+
+	if (!driver_deferred_probe_enable)
+		return;
+
+	mutex_lock(&deferred_probe_mutex);
+	atomic_inc(&deferred_trigger_count);
+	list_for_each_entry_safe(p, n, &deferred_probe_pending_list,
+				 deferred_probe) {
+		bool match = !p->num_deferred_suppliers;
+
+		for (i = 0; !match && i < p->num_deferred_suppliers; i++)
+			match = deferred_supplier_match(p->deferred_suppliers[i],
+							supplier);
+		if (!match)
+			continue;
+
+		list_move_tail(&p->deferred_probe, &deferred_probe_active_list);
+		kick = true;
+	}
+	mutex_unlock(&deferred_probe_mutex);
+
+	if (kick)
+		queue_work(deferred_wq, &deferred_probe_work);
+	mod_delayed_work(deferred_wq, &deferred_probe_sweep_work,
+			 DEFERRED_PROBE_SWEEP_DELAY);
+}
+
+/*
+ * A bind happened while @dev was probing, possibly of what it was waiting
+ * for: retry just @dev rather than everything.
+ */
+static void driver_deferred_probe_requeue(struct device *dev)
+{
+	if (!driver_deferred_probe_enable)
+		return;
+
+	mutex_lock(&deferred_probe_mutex);
+	if (!list_empty(&dev->p->deferred_probe))
+		list_move_tail(&dev->p->deferred_probe,
+			       &deferred_probe_active_list);
+	mutex_unlock(&deferred_probe_mutex);
+
+	queue_work(deferred_wq, &deferred_probe_work);
+}
+
+/*
+ * While non-zero every probe attempt is parked on the deferred list, a count
+ * so that independent users can nest.
+ */
+static atomic_t defer_all_probes = ATOMIC_INIT(0);
+
+/**
+ * device_block_probing() - Defer all new probes
+ *
+ * Devices registered or probed until the matching device_unblock_probing()
+ * are put on the deferred probe list instead of being probed.  Used to add a
+ * batch of devices that depend on each other and probe them in one pass,
+ * rather than have each of them trigger a deferred probe retry of the rest.
+ * Probes already in progress are not waited for.
+ */
+void device_block_probing(void)
+{
+	atomic_inc(&defer_all_probes);
+}
+EXPORT_SYMBOL_GPL(device_block_probing);
+
+/**
+ * device_unblock_probing() - Undo device_block_probing()
+ *
+ * When the last block is dropped the deferred probe workqueue is kicked to
+ * probe everything that was parked, in registration order.
+ */
+void device_unblock_probing(void)
+{
+	if (atomic_dec_and_test(&defer_all_probes))
+		driver_deferred_probe_trigger();
+}
+EXPORT_SYMBOL_GPL(device_unblock_probing);
+
+static void driver_probe_stats_update(struct device *dev, ktime_t calltime,
+				      int result)
+{
+	struct device_private *p = dev->p;
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), calltime));
+
+	p->probe_attempts++;
+	if (result == -EPROBE_DEFER)
+		p->probe_deferrals++;
+	p->probe_result = result;
+	p->probe_time_ns += ns;
+	p->probe_last_ns = ns;
+
+	mutex_lock(&probe_stats_mutex);
+	if (list_empty(&p->probe_stats))
+		list_add_tail(&p->probe_stats, &probe_stats_list);
+	mutex_unlock(&probe_stats_mutex);
+}
+
+void driver_probe_stats_del(struct device *dev)
+{
+	mutex_lock(&probe_stats_mutex);
+	list_del_init(&dev->p->probe_stats);
+	mutex_unlock(&probe_stats_mutex);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static void deferred_devices_show_list(struct seq_file *s,
+				       struct list_head *list,
+				       const char *state)
+{
+	struct device_private *p;
+	unsigned int i;
+
+	list_for_each_entry(p, list, deferred_probe) {
+		seq_printf(s, "%s\t%s\t%u", dev_name(p->device), state,
+			   p->probe_deferrals);
+		if (!p->num_deferred_suppliers)
+			seq_puts(s, "\t*");
+		for (i = 0; i < p->num_deferred_suppliers; i++)
+			seq_printf(s, "\t%s",
+				   of_node_full_name(p->deferred_suppliers[i]));
+		seq_putc(s, '\n');
+	}
+}
+
+/* device, list, deferrals, then suppliers ("*" for any) */
+static int deferred_devices_show(struct seq_file *s, void *data)
+{
+	mutex_lock(&deferred_probe_mutex);
+	deferred_devices_show_list(s, &deferred_probe_pending_list,
+				   "pending");
+	deferred_devices_show_list(s, &deferred_probe_active_list,
+				   "active");
+	mutex_unlock(&deferred_probe_mutex);
+	return 0;
+}
+
+static int deferred_devices_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, deferred_devices_show, inode->i_private);
+}
+
+static const struct file_operations deferred_devices_fops = {
+	.open		= deferred_devices_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int probe_stats_show(struct seq_file *s, void *data)
+{
+	struct device_private *p;
+
+	seq_puts(s, "device\tattempts\tdeferrals\tresult\ttotal_us\tlast_us\n");
+	mutex_lock(&probe_stats_mutex);
+	list_for_each_entry(p, &probe_stats_list, probe_stats)
+		seq_printf(s, "%s\t%u\t%u\t%d\t%llu\t%llu\n",
+			   dev_name(p->device), p->probe_attempts,
+			   p->probe_deferrals, p->probe_result,
+			   div_u64(p->probe_time_ns, NSEC_PER_USEC),
+			   div_u64(p->probe_last_ns, NSEC_PER_USEC));
+	mutex_unlock(&probe_stats_mutex);
+	return 0;
+}
+
+static int probe_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, probe_stats_show, inode->i_private);
+}
+
+static const struct file_operations probe_stats_fops = {
+	.open		= probe_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void deferred_probe_debugfs_init(void)
+{
+	debugfs_create_file("devices_deferred", S_IRUGO, NULL, NULL,
+			    &deferred_devices_fops);
+	debugfs_create_file("devices_probe_stats", S_IRUGO, NULL, NULL,
+			    &probe_stats_fops);
+}
+#else
+static inline void deferred_probe_debugfs_init(void) { }
+#endif
+
 /**
  * deferred_probe_initcall() - Enable probing of deferred devices
  *
@@ -180,14 +551,25 @@ static void driver_deferred_probe_trigger(void)
  */
 static int deferred_probe_initcall(void)
 {
+	int bound;
+
 	deferred_wq = create_singlethread_workqueue("deferwq");
 	if (WARN_ON(!deferred_wq))
 		return -ENOMEM;
 
 	driver_deferred_probe_enable = true;
-	driver_deferred_probe_trigger();
-	/* Sort as many dependencies as possible before exiting initcalls */
-	flush_workqueue(deferred_wq);
+
+	/*
+	 * Sort as many dependencies as possible before exiting initcalls:
+	 * keep sweeping for as long as a pass still binds something.
+	 */
+	do {
+		bound = atomic_read(&deferred_bound_count);
+		driver_deferred_probe_trigger();
+		flush_workqueue(deferred_wq);
+	} while (bound != atomic_read(&deferred_bound_count));
+
+	deferred_probe_debugfs_init();
 	return 0;
 }
 late_initcall(deferred_probe_initcall);
@@ -207,10 +589,11 @@ static void driver_bound(struct device *dev)
 
 	/*
 	 * Make sure the device is no longer in one of the deferred lists and
-	 * kick off retrying all pending devices
+	 * kick off retrying the pending devices that wait for it
 	 */
 	driver_deferred_probe_del(dev);
-	driver_deferred_probe_trigger();
+	atomic_inc(&deferred_bound_count);
+	driver_deferred_probe_trigger_for(dev);
 
 	if (dev->bus)
 		blocking_notifier_call_chain(&dev->bus->p->bus_notifier,
@@ -279,8 +662,17 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 {
 	int ret = 0;
 	int local_trigger_count = atomic_read(&deferred_trigger_count);
+	ktime_t calltime;
+
+	if (atomic_read(&defer_all_probes)) {
+		dev_dbg(dev, "Driver %s probe deferred, probing blocked\n",
+			drv->name);
+		driver_deferred_probe_add(dev);
+		return 0;
+	}
 
 	atomic_inc(&probe_count);
+	calltime = ktime_get();
 	pr_debug("bus: '%s': %s: probing driver %s with device %s\n",
 		 drv->bus->name, __func__, drv->name, dev_name(dev));
 	WARN_ON(!list_empty(&dev->devres_head));
@@ -325,6 +717,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 	if (dev->pm_domain && dev->pm_domain->sync)
 		dev->pm_domain->sync(dev);
 
+	driver_probe_stats_update(dev, calltime, 0);
 	driver_bound(dev);
 	ret = 1;
 	pr_debug("bus: '%s': %s: bound device %s to driver %s\n",
@@ -332,6 +725,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 	goto done;
 
 probe_failed:
+	driver_probe_stats_update(dev, calltime, ret);
 	devres_release_all(dev);
 	driver_sysfs_remove(dev);
 	dev->driver = NULL;
@@ -346,7 +740,7 @@ probe_failed:
 		driver_deferred_probe_add(dev);
 		/* Did a trigger occur while probing? Need to re-trigger if yes */
 		if (local_trigger_count != atomic_read(&deferred_trigger_count))
-			driver_deferred_probe_trigger();
+			driver_deferred_probe_requeue(dev);
 		break;
 	case -ENODEV:
 	case -ENXIO:
@@ -425,31 +819,119 @@ int driver_probe_device(struct device_driver *drv, struct device *dev)
 	return ret;
 }
 
-static int __device_attach(struct device_driver *drv, void *data)
+#define ASYNC_DRV_NAMES_MAX_LEN	256
+static char async_probe_drv_names[ASYNC_DRV_NAMES_MAX_LEN];
+
+static int __init save_async_options(char *buf)
 {
-	struct device *dev = data;
+	if (strlen(buf) >= ASYNC_DRV_NAMES_MAX_LEN)
+		pr_warn("Too long list of driver names for 'driver_async_probe'!\n");
+
+	strlcpy(async_probe_drv_names, buf, ASYNC_DRV_NAMES_MAX_LEN);
+	return 1;
+}
+__setup("driver_async_probe=", save_async_options);
+
+/**
+ * driver_allows_async_probing - may @drv be probed asynchronously?
+ * @drv: driver to check
+ *
+ * Drivers opt in with %PROBE_PREFER_ASYNCHRONOUS; drivers left at the
+ * default strategy may also be switched over from the command line
+ * with "driver_async_probe=name1,name2".
+ */
+bool driver_allows_async_probing(struct device_driver *drv)
+{
+	switch (drv->probe_type) {
+	case PROBE_PREFER_ASYNCHRONOUS:
+		return true;
+
+	case PROBE_FORCE_SYNCHRONOUS:
+		return false;
+
+	default:
+		return parse_option_str(async_probe_drv_names, drv->name);
+	}
+}
+
+struct device_attach_data {
+	struct device *dev;
+
+	/*
+	 * Indicates whether we are are considering asynchronous probing or
+	 * not. Only initial binding after device or driver registration
+	 * (including deferral processing) may be done asynchronously, the
+	 * rest is always synchronous, as we expect it is being done by
+	 * request from userspace.
+	 */
+	bool check_async;
+
+	/*
+	 * Indicates if we are binding synchronous or asynchronous drivers.
+	 * When asynchronous probing is enabled we'll execute 2 passes
+	 * over drivers: first pass doing synchronous probing and second
+	 * doing asynchronous probing (if synchronous did not succeed -
+	 * most likely because there was no driver requiring synchronous
+	 * probing - and we found asynchronous driver during first pass).
+	 * The 2 passes are done because we can't shoot asynchronous
+	 * probe for given device and driver from bus_for_each_drv() since
+	 * driver pointer is not guaranteed to stay valid once
+	 * bus_for_each_drv() iterates to the next driver on the bus.
+	 */
+	bool want_async;
+
+	/*
+	 * We'll set have_async to 'true' if, while scanning for matching
+	 * driver, we'll encounter one that requests asynchronous probing.
+	 */
+	bool have_async;
+};
+
+static int __device_attach_driver(struct device_driver *drv, void *_data)
+{
+	struct device_attach_data *data = _data;
+	struct device *dev = data->dev;
+	bool async_allowed;
 
 	if (!driver_match_device(drv, dev))
 		return 0;
 
+	async_allowed = driver_allows_async_probing(drv);
+
+	if (async_allowed)
+		data->have_async = true;
+
+	if (data->check_async && async_allowed != data->want_async)
+		return 0;
+
 	return driver_probe_device(drv, dev);
 }
 
-/**
- * device_attach - try to attach device to a driver.
- * @dev: device.
- *
- * Walk the list of drivers that the bus has and call
- * driver_probe_device() for each pair. If a compatible
- * pair is found, break out and return.
- *
- * Returns 1 if the device was bound to a driver;
- * 0 if no matching driver was found;
- * -ENODEV if the device is not registered.
- *
- * When called for a USB interface, @dev->parent lock must be held.
- */
-int device_attach(struct device *dev)
+static void __device_attach_async_helper(void *_dev, async_cookie_t cookie)
+{
+	struct device *dev = _dev;
+	struct device_attach_data data = {
+		.dev		= dev,
+		.check_async	= true,
+		.want_async	= true,
+	};
+
+	device_lock(dev);
+
+	/* Somebody may have bound it while we were queued */
+	if (!dev->driver)
+		bus_for_each_drv(dev->bus, NULL, &data,
+				 __device_attach_driver);
+	dev_dbg(dev, "async probe completed\n");
+
+	pm_request_idle(dev);
+
+	device_unlock(dev);
+
+	put_device(dev);
+}
+
+static int __device_attach(struct device *dev, bool allow_async)
 {
 	int ret = 0;
 
@@ -467,15 +949,63 @@ int device_attach(struct device *dev)
 			ret = 0;
 		}
 	} else {
-		ret = bus_for_each_drv(dev->bus, NULL, dev, __device_attach);
-		pm_request_idle(dev);
+		struct device_attach_data data = {
+			.dev = dev,
+			.check_async = allow_async,
+			.want_async = false,
+		};
+
+		ret = bus_for_each_drv(dev->bus, NULL, &data,
+					__device_attach_driver);
+		if (!ret && allow_async && data.have_async) {
+			/*
+			 * If we could not find appropriate driver
+			 * synchronously and we are allowed to do
+			 * async probes and there are drivers that
+			 * want to probe asynchronously, we'll
+			 * try them.
+			 */
+			dev_dbg(dev, "scheduling asynchronous probe\n");
+			get_device(dev);
+			async_schedule(__device_attach_async_helper, dev);
+		} else {
+			pm_request_idle(dev);
+		}
 	}
 out_unlock:
 	device_unlock(dev);
 	return ret;
 }
+
+/**
+ * device_attach - try to attach device to a driver.
+ * @dev: device.
+ *
+ * Walk the list of drivers that the bus has and call
+ * driver_probe_device() for each pair. If a compatible
+ * pair is found, break out and return.
+ *
+ * Returns 1 if the device was bound to a driver;
+ * 0 if no matching driver was found;
+ * -ENODEV if the device is not registered.
+ *
+ * When called for a USB interface, @dev->parent lock must be held.
+ */
+int device_attach(struct device *dev)
+{
+	return __device_attach(dev, false);
+}
 EXPORT_SYMBOL_GPL(device_attach);
 
+/*
+ * device_initial_probe - first probe after device registration; drivers
+ * that allow it are probed from the async domain.
+ */
+void device_initial_probe(struct device *dev)
+{
+	__device_attach(dev, true);
+}
+
 static int __driver_attach(struct device *dev, void *data)
 {
 	struct device_driver *drv = data;
@@ -29,6 +29,10 @@
 #include <linux/syscore_ops.h>
 #include <linux/reboot.h>
 #include <linux/security.h>
+#include <linux/earlycpio.h>
+#include <linux/of_fdt.h>
+#include <linux/of_reserved_mem.h>
+#include <linux/initrd.h>
 
 #include <generated/utsrelease.h>
 
@@ -324,6 +328,9 @@ static int fw_get_filesystem_firmware(struct device *device,
 	int rc = -ENOENT;
 	char *path = __getname();
 
+	/* Firmware requested during boot may be in the initramfs */
+	wait_for_initramfs();
+
 	for (i = 0; i < ARRAY_SIZE(fw_path); i++) {
 		struct file *file;
 
@@ -1669,6 +1676,173 @@ static void __init fw_cache_init(void)
 #endif
 }
 
+#ifdef CONFIG_FW_LOADER
+/*
+ * Boot time preload: images are put in the firmware cache before devices
+ * probe, so that drivers probing before the root filesystem is mounted find
+ * them on their first request.  They come from two places:
+ *
+ *  - firmware_class.preload=<name>[,<name>...] names files that are read
+ *    from the initramfs, using the usual search path;
+ *  - a reserved-memory region compatible with "linux,firmware-preload"
+ *    holding an uncompressed newc cpio archive, as loaded by the bootloader.
+ *    Every regular file below lib/firmware/ in it is cached under its path
+ *    relative to that directory and the region is then given back.
+ *
+ * Preloaded images stay cached, taking precedence over the filesystem.
+ */
+static char fw_preload_para[512];
+module_param_string(preload, fw_preload_para, sizeof(fw_preload_para), 0444);
+MODULE_PARM_DESC(preload, "comma separated list of firmware images to cache at boot");
+
+#ifdef CONFIG_OF_RESERVED_MEM
+static struct reserved_mem *fw_preload_rmem;
+
+static int __init rmem_fw_preload_setup(struct reserved_mem *rmem)
+{
+	if (of_get_flat_dt_prop(rmem->fdt_node, "no-map", NULL)) {
+		pr_err("firmware preload region %s must be mapped\n",
+		       rmem->name);
+		return -EINVAL;
+	}
+
+	fw_preload_rmem = rmem;
+	return 0;
+}
+RESERVEDMEM_OF_DECLARE(fw_preload, "linux,firmware-preload",
+		       rmem_fw_preload_setup);
+#endif
+
+/*
+ * Returns a new, not yet loaded buffer for @name owned by the caller, or NULL
+ * if the image is already cached or on allocation failure.
+ */
+static struct firmware_buf * __init fw_preload_alloc(const char *name)
+{
+	struct firmware_buf *buf;
+	int ret;
+
+	ret = fw_lookup_and_allocate_buf(name, &fw_cache, &buf);
+	if (ret > 0)
+		fw_free_buf(buf);
+	return ret ? NULL : buf;
+}
+
+static void __init fw_preload_done(struct firmware_buf *buf)
+{
+	mutex_lock(&fw_lock);
+	set_bit(FW_STATUS_DONE, &buf->status);
+	complete_all(&buf->completion);
+	mutex_unlock(&fw_lock);
+}
+
+static int __init fw_preload_files(void)
+{
+	struct firmware_buf *buf;
+	char *names, *p, *name;
+	int count = 0;
+
+	names = kstrdup(fw_preload_para, GFP_KERNEL);
+	if (!names)
+		return 0;
+
+	p = names;
+	while ((name = strsep(&p, ",")) != NULL) {
+		if (!*name)
+			continue;
+		buf = fw_preload_alloc(name);
+		if (!buf)
+			continue;
+		/* fw_get_filesystem_firmware() marks the buffer done */
+		if (fw_get_filesystem_firmware(NULL, buf)) {
+			pr_warn("firmware: could not preload %s\n", name);
+			fw_free_buf(buf);
+			continue;
+		}
+		count++;
+	}
+
+	kfree(names);
+	return count;
+}
+
+#ifdef CONFIG_OF_RESERVED_MEM
+static int __init fw_preload_archive(void)
+{
+	unsigned long pfn_first, pfn_last;
+	struct firmware_buf *buf;
+	struct cpio_data cd;
+	void *start, *data;
+	size_t len;
+	long offset;
+	int count = 0;
+
+	if (!fw_preload_rmem)
+		return 0;
+
+	pfn_first = PFN_DOWN(fw_preload_rmem->base);
+	pfn_last = PFN_DOWN(fw_preload_rmem->base + fw_preload_rmem->size - 1);
+	if (!pfn_valid(pfn_first) || !pfn_valid(pfn_last) ||
+	    PageHighMem(pfn_to_page(pfn_last))) {
+		pr_err("firmware preload region %s is not in lowmem\n",
+		       fw_preload_rmem->name);
+		return 0;
+	}
+
+	start = data = phys_to_virt(fw_preload_rmem->base);
+	len = fw_preload_rmem->size;
+	for (;;) {
+		cd = find_cpio_data("lib/firmware/", data, len, &offset);
+		if (!cd.data)
+			break;
+		data += offset;
+		len -= offset;
+
+		/* skip names find_cpio_data() had to truncate */
+		if (!cd.name[0] || !cd.size ||
+		    strlen(cd.name) == MAX_CPIO_FILE_NAME - 1)
+			continue;
+		buf = fw_preload_alloc(cd.name);
+		if (!buf)
+			continue;
+		buf->data = vmalloc(cd.size);
+		if (!buf->data) {
+			fw_free_buf(buf);
+			break;
+		}
+		memcpy(buf->data, cd.data, cd.size);
+		buf->size = cd.size;
+		fw_preload_done(buf);
+		count++;
+	}
+
+	free_reserved_area(start, start + fw_preload_rmem->size, -1,
+			   "firmware preload");
+	fw_preload_rmem = NULL;
+
+	return count;
+}
+#else
+static inline int fw_preload_archive(void)
+{
+	return 0;
+}
+#endif
+
+/* after populate_rootfs(), which is linked first, and before device probe */
+static int __init fw_preload_init(void)
+{
+	int count;
+
+	count = fw_preload_archive() + fw_preload_files();
+	if (count)
+		pr_info("firmware: preloaded %d image(s)\n", count);
+
+	return 0;
+}
+rootfs_initcall(fw_preload_init);
+#endif /* CONFIG_FW_LOADER */
+
 static int __init firmware_class_init(void)
 {
 	fw_cache_init();
@@ -10,33 +10,73 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/bitops.h>
 #include <linux/device.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 
 #include "internal.h"
 
+/*
+ * The cache is a single block in device native format, indexed by register
+ * number over the stride, so that syncing it can hand whole runs of
+ * registers to regcache_sync_block() just like the rbtree cache does.
+ */
+struct regcache_flat_data {
+	void *block;
+	unsigned long *present;
+};
+
+static inline unsigned int regcache_flat_get_index(const struct regmap *map,
+						   unsigned int reg)
+{
+	return reg / map->reg_stride;
+}
+
 static int regcache_flat_init(struct regmap *map)
 {
+	struct regcache_flat_data *cache;
+	unsigned int count, idx;
 	int i;
-	unsigned int *cache;
 
-	map->cache = kzalloc(sizeof(unsigned int) * (map->max_register + 1),
-			     GFP_KERNEL);
-	if (!map->cache)
+	cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+	if (!cache)
+		return -ENOMEM;
+
+	count = regcache_flat_get_index(map, map->max_register) + 1;
+	cache->block = kcalloc(count, map->cache_word_size, GFP_KERNEL);
+	cache->present = kcalloc(BITS_TO_LONGS(count), sizeof(long),
+				 GFP_KERNEL);
+	if (!cache->block || !cache->present) {
+		kfree(cache->block);
+		kfree(cache->present);
+		kfree(cache);
 		return -ENOMEM;
+	}
 
-	cache = map->cache;
+	for (i = 0; i < map->num_reg_defaults; i++) {
+		if (map->reg_defaults[i].reg > map->max_register)
+			continue;
+		idx = regcache_flat_get_index(map, map->reg_defaults[i].reg);
+		regcache_set_val(map, cache->block, idx,
+				 map->reg_defaults[i].def);
+		set_bit(idx, cache->present);
+	}
 
-	for (i = 0; i < map->num_reg_defaults; i++)
-		cache[map->reg_defaults[i].reg] = map->reg_defaults[i].def;
+	map->cache = cache;
 
 	return 0;
 }
 
 static int regcache_flat_exit(struct regmap *map)
 {
-	kfree(map->cache);
+	struct regcache_flat_data *cache = map->cache;
+
+	if (cache) {
+		kfree(cache->block);
+		kfree(cache->present);
+	}
+	kfree(cache);
 	map->cache = NULL;
 
 	return 0;
@@ -45,9 +85,14 @@ static int regcache_flat_exit(struct regmap *map)
 static int regcache_flat_read(struct regmap *map,
 			      unsigned int reg, unsigned int *value)
 {
-	unsigned int *cache = map->cache;
+	struct regcache_flat_data *cache = map->cache;
+	unsigned int idx = regcache_flat_get_index(map, reg);
+
+	/* Not cached yet, let the caller read the hardware */
+	if (reg > map->max_register || !test_bit(idx, cache->present))
+		return -ENOENT;
 
-	*value = cache[reg];
+	*value = regcache_get_val(map, cache->block, idx);
 
 	return 0;
 }
@@ -55,9 +100,43 @@ static int regcache_flat_read(struct regmap *map,
 static int regcache_flat_write(struct regmap *map, unsigned int reg,
 			       unsigned int value)
 {
-	unsigned int *cache = map->cache;
+	struct regcache_flat_data *cache = map->cache;
+	unsigned int idx = regcache_flat_get_index(map, reg);
+
+	if (reg > map->max_register)
+		return -EINVAL;
+
+	regcache_set_val(map, cache->block, idx, value);
+	set_bit(idx, cache->present);
+
+	return 0;
+}
+
+static int regcache_flat_sync(struct regmap *map, unsigned int min,
+			      unsigned int max)
+{
+	struct regcache_flat_data *cache = map->cache;
+	unsigned int start, end;
+
+	start = regcache_flat_get_index(map, roundup(min, map->reg_stride));
+	end = regcache_flat_get_index(map, min(max, map->max_register)) + 1;
+	if (start >= end)
+		return 0;
+
+	return regcache_sync_block(map, cache->block, cache->present, 0,
+				   start, end);
+}
+
+static int regcache_flat_drop(struct regmap *map, unsigned int min,
+			      unsigned int max)
+{
+	struct regcache_flat_data *cache = map->cache;
+	unsigned int start, end;
 
-	cache[reg] = value;
+	start = regcache_flat_get_index(map, roundup(min, map->reg_stride));
+	end = regcache_flat_get_index(map, min(max, map->max_register)) + 1;
+	if (start < end)
+		bitmap_clear(cache->present, start, end - start);
 
 	return 0;
 }
@@ -69,4 +148,6 @@ struct regcache_ops regcache_flat_ops = {
 	.exit = regcache_flat_exit,
 	.read = regcache_flat_read,
 	.write = regcache_flat_write,
+	.sync = regcache_flat_sync,
+	.drop = regcache_flat_drop,
 };
@@ -19,6 +19,12 @@
 #include "trace.h"
 #include "internal.h"
 
+/*
+ * rbtree caches of maps with at most this many registers are switched to
+ * the flat cache, which looks up and syncs dense maps with less overhead.
+ */
+#define REGCACHE_FLAT_AUTO_REGS	512
+
 static const struct regcache_ops *cache_types[] = {
 	&regcache_rbtree_ops,
 	&regcache_lzo_ops,
@@ -160,6 +166,12 @@ int regcache_init(struct regmap *map, const struct regmap_config *config)
 	if (!map->max_register)
 		map->max_register = map->num_reg_defaults_raw;
 
+	if (map->cache_type == REGCACHE_RBTREE && map->max_register &&
+	    map->max_register / map->reg_stride < REGCACHE_FLAT_AUTO_REGS) {
+		map->cache_type = REGCACHE_FLAT;
+		map->cache_ops = &regcache_flat_ops;
+	}
+
 	if (map->cache_ops->init) {
 		dev_dbg(map->dev, "Initializing %s cache\n",
 			map->cache_ops->name);
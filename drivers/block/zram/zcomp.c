@@ -13,6 +13,8 @@
 #include <linux/slab.h>
 #include <linux/wait.h>
 #include <linux/sched.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
 
 #include "zcomp.h"
 #include "zcomp_lzo.h"
@@ -47,6 +49,7 @@ static struct zcomp_backend *backends[] = {
 	&zcomp_lzo,
 #ifdef CONFIG_ZRAM_LZ4_COMPRESS
 	&zcomp_lz4,
+	&zcomp_lz4hc,
 #endif
 	NULL
 };
@@ -218,6 +221,78 @@ static int zcomp_strm_multi_create(struct zcomp *comp, int max_strm)
 	return 0;
 }
 
+/*
+ * per-cpu zcomp_strm backend: every possible CPU owns one stream.
+ *
+ * The write path may sleep in zs_malloc() while it holds a stream, so we
+ * cannot pin the CPU with preemption disabled. Each stream carries its
+ * own mutex instead; it is only contended when the owner got preempted
+ * or migrated, never globally like the multi backend's idle list.
+ */
+static struct zcomp_strm *zcomp_strm_percpu_find(struct zcomp *comp)
+{
+	struct zcomp_strm * __percpu *streams = comp->stream;
+	struct zcomp_strm *zstrm;
+
+	zstrm = *per_cpu_ptr(streams, raw_smp_processor_id());
+	mutex_lock(&zstrm->lock);
+	return zstrm;
+}
+
+static void zcomp_strm_percpu_release(struct zcomp *comp,
+		struct zcomp_strm *zstrm)
+{
+	mutex_unlock(&zstrm->lock);
+}
+
+static bool zcomp_strm_percpu_set_max_streams(struct zcomp *comp,
+		int num_strm)
+{
+	/* there is always one stream per possible CPU */
+	return num_strm >= num_possible_cpus();
+}
+
+static void zcomp_strm_percpu_destroy(struct zcomp *comp)
+{
+	struct zcomp_strm * __percpu *streams = comp->stream;
+	struct zcomp_strm *zstrm;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		zstrm = *per_cpu_ptr(streams, cpu);
+		if (zstrm)
+			zcomp_strm_free(comp, zstrm);
+	}
+	free_percpu(streams);
+}
+
+static int zcomp_strm_percpu_create(struct zcomp *comp)
+{
+	struct zcomp_strm * __percpu *streams;
+	struct zcomp_strm *zstrm;
+	int cpu;
+
+	comp->destroy = zcomp_strm_percpu_destroy;
+	comp->strm_find = zcomp_strm_percpu_find;
+	comp->strm_release = zcomp_strm_percpu_release;
+	comp->set_max_streams = zcomp_strm_percpu_set_max_streams;
+	streams = alloc_percpu(struct zcomp_strm *);
+	if (!streams)
+		return -ENOMEM;
+
+	comp->stream = streams;
+	for_each_possible_cpu(cpu) {
+		zstrm = zcomp_strm_alloc(comp);
+		if (!zstrm) {
+			zcomp_strm_percpu_destroy(comp);
+			return -ENOMEM;
+		}
+		mutex_init(&zstrm->lock);
+		*per_cpu_ptr(streams, cpu) = zstrm;
+	}
+	return 0;
+}
+
 static struct zcomp_strm *zcomp_strm_single_find(struct zcomp *comp)
 {
 	struct zcomp_strm_single *zs = comp->stream;
@@ -326,7 +401,10 @@ void zcomp_destroy(struct zcomp *comp)
  * backend pointer or ERR_PTR if things went bad. ERR_PTR(-EINVAL)
  * if requested algorithm is not supported, ERR_PTR(-ENOMEM) in
  * case of allocation error, or any other error potentially
- * returned by functions zcomp_strm_{multi,single}_create.
+ * returned by functions zcomp_strm_{percpu,multi,single}_create.
+ *
+ * Asking for at least as many streams as there are possible CPUs
+ * selects the per-cpu backend.
  */
 struct zcomp *zcomp_create(const char *compress, int max_strm)
 {
@@ -343,7 +421,9 @@ struct zcomp *zcomp_create(const char *compress, int max_strm)
 		return ERR_PTR(-ENOMEM);
 
 	comp->backend = backend;
-	if (max_strm > 1)
+	if (max_strm > 1 && max_strm >= num_possible_cpus())
+		error = zcomp_strm_percpu_create(comp);
+	else if (max_strm > 1)
 		error = zcomp_strm_multi_create(comp, max_strm);
 	else
 		error = zcomp_strm_single_create(comp);
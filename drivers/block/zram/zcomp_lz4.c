@@ -9,6 +9,7 @@
 
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/lz4.h>
 
 #include "zcomp_lz4.h"
@@ -45,3 +46,30 @@ struct zcomp_backend zcomp_lz4 = {
 	.destroy = zcomp_lz4_destroy,
 	.name = "lz4",
 };
+
+/* the working memory of lz4hc is too large for kmalloc */
+static void *zcomp_lz4hc_create(void)
+{
+	return vzalloc(LZ4HC_MEM_COMPRESS);
+}
+
+static void zcomp_lz4hc_destroy(void *private)
+{
+	vfree(private);
+}
+
+static int zcomp_lz4hc_compress(const unsigned char *src, unsigned char *dst,
+		size_t *dst_len, void *private)
+{
+	/* return  : Success if return 0 */
+	return lz4hc_compress(src, PAGE_SIZE, dst, dst_len, private);
+}
+
+/* lz4hc produces a regular lz4 stream */
+struct zcomp_backend zcomp_lz4hc = {
+	.compress = zcomp_lz4hc_compress,
+	.decompress = zcomp_lz4_decompress,
+	.create = zcomp_lz4hc_create,
+	.destroy = zcomp_lz4hc_destroy,
+	.name = "lz4hc",
+};
@@ -343,6 +343,312 @@ static inline int valid_io_request(struct zram *zram,
 	return 1;
 }
 
+#ifdef CONFIG_ZRAM_ACCESS_TIME
+static inline void zram_touch(struct zram_meta *meta, u32 index)
+{
+	meta->table[index].ac_time = jiffies;
+}
+
+/* Has the page been left alone for more than @secs seconds? */
+static inline bool zram_page_idle(struct zram_meta *meta, u32 index,
+				  unsigned int secs)
+{
+	return time_after(jiffies, meta->table[index].ac_time + secs * HZ);
+}
+#else
+static inline void zram_touch(struct zram_meta *meta, u32 index) {}
+#endif
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static inline bool zram_wb_enabled(struct zram *zram)
+{
+	return zram->backing_dev;
+}
+
+static void reset_bdev(struct zram *zram)
+{
+	struct block_device *bdev;
+
+	if (!zram_wb_enabled(zram))
+		return;
+
+	bdev = zram->bdev;
+	set_blocksize(bdev, zram->old_block_size);
+	blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	/* hope filp_close flushes all of the I/O */
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->old_block_size = 0;
+	zram->bdev = NULL;
+
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char *p;
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	if (!zram_wb_enabled(zram)) {
+		up_read(&zram->init_lock);
+		return scnprintf(buf, PAGE_SIZE, "none\n");
+	}
+
+	p = d_path(&zram->backing_dev->f_path, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	char *file_name;
+	struct file *backing_dev = NULL;
+	struct inode *inode;
+	struct block_device *bdev = NULL;
+	unsigned long *bitmap = NULL;
+	unsigned long nr_pages;
+	unsigned int old_block_size;
+	struct zram *zram = dev_to_zram(dev);
+	int err;
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	if (strlen(file_name) && file_name[strlen(file_name) - 1] == '\n')
+		file_name[strlen(file_name) - 1] = '\0';
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	inode = backing_dev->f_mapping->host;
+	/* Support only block device in this moment */
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		/* blkdev_get drops the reference on failure */
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_pages = i_size_read(inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	old_block_size = block_size(bdev);
+	err = set_blocksize(bdev, PAGE_SIZE);
+	if (err)
+		goto out;
+
+	reset_bdev(zram);
+
+	zram->old_block_size = old_block_size;
+	zram->bdev = bdev;
+	zram->backing_dev = backing_dev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+
+	return len;
+out:
+	vfree(bitmap);
+
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+
+	up_write(&zram->init_lock);
+
+	kfree(file_name);
+
+	return err;
+}
+
+static unsigned long alloc_block_bdev(struct zram *zram)
+{
+	unsigned long blk_idx = 1;
+retry:
+	/* skip block 0 so that a zero handle still means "empty" */
+	blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk_idx);
+	if (blk_idx >= zram->nr_pages)
+		return 0;
+
+	if (test_and_set_bit(blk_idx, zram->bitmap))
+		goto retry;
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	int was_set;
+
+	was_set = test_and_clear_bit(blk_idx, zram->bitmap);
+	WARN_ON_ONCE(!was_set);
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+struct zram_bdev_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	unsigned long blk_idx;
+	int rw;
+	int ret;
+};
+
+static int __zram_bdev_rw(struct zram *zram, struct page *page,
+			  unsigned long blk_idx, int rw)
+{
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_bdev = zram->bdev;
+	bio->bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> SECTOR_SHIFT);
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	ret = submit_bio_wait(rw, bio);
+	bio_put(bio);
+
+	return ret;
+}
+
+static void zram_bdev_rw_work(struct work_struct *work)
+{
+	struct zram_bdev_work *zw = container_of(work, struct zram_bdev_work,
+						 work);
+
+	zw->ret = __zram_bdev_rw(zw->zram, zw->page, zw->blk_idx, zw->rw);
+}
+
+/*
+ * A bio submitted from within zram_make_request() sits on current->bio_list
+ * until we return to generic_make_request(), so waiting for it there would
+ * never finish. Hand such requests to a worker instead.
+ */
+static int zram_bdev_rw(struct zram *zram, struct page *page,
+			unsigned long blk_idx, int rw)
+{
+	struct zram_bdev_work zw;
+
+	if (!current->bio_list)
+		return __zram_bdev_rw(zram, page, blk_idx, rw);
+
+	zw.zram = zram;
+	zw.page = page;
+	zw.blk_idx = blk_idx;
+	zw.rw = rw;
+
+	INIT_WORK_ONSTACK(&zw.work, zram_bdev_rw_work);
+	queue_work(system_unbound_wq, &zw.work);
+	flush_work(&zw.work);
+	destroy_work_on_stack(&zw.work);
+
+	return zw.ret;
+}
+
+static int read_from_bdev(struct zram *zram, struct page *page,
+			  unsigned long blk_idx)
+{
+	int ret;
+
+	ret = zram_bdev_rw(zram, page, blk_idx, READ);
+	if (!ret)
+		atomic64_inc(&zram->stats.bd_reads);
+	return ret;
+}
+
+static int write_to_bdev(struct zram *zram, struct page *page,
+			 unsigned long blk_idx)
+{
+	int ret;
+
+	ret = zram_bdev_rw(zram, page, blk_idx, WRITE);
+	if (!ret)
+		atomic64_inc(&zram->stats.bd_writes);
+	return ret;
+}
+#else
+static inline bool zram_wb_enabled(struct zram *zram) { return false; }
+static inline void reset_bdev(struct zram *zram) {}
+static inline void free_block_bdev(struct zram *zram,
+				   unsigned long blk_idx) {}
+
+static inline int read_from_bdev(struct zram *zram, struct page *page,
+				 unsigned long blk_idx)
+{
+	return -EIO;
+}
+#endif
+
+/* Read a written back page into a linear, possibly kmalloc'ed, buffer */
+static int read_from_bdev_buf(struct zram *zram, char *mem,
+			      unsigned long blk_idx)
+{
+	struct page *page;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = read_from_bdev(zram, page, blk_idx);
+	if (!ret)
+		copy_page(mem, page_address(page));
+
+	__free_page(page);
+	return ret;
+}
+
 static void zram_meta_free(struct zram_meta *meta, u64 disksize)
 {
 	size_t num_pages = disksize >> PAGE_SHIFT;
@@ -352,7 +658,8 @@ static void zram_meta_free(struct zram_meta *meta, u64 disksize)
 	for (index = 0; index < num_pages; index++) {
 		unsigned long handle = meta->table[index].handle;
 
-		if (!handle)
+		/* written back pages go away with the backing dev bitmap */
+		if (!handle || zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
 		zs_free(meta->mem_pool, handle);
@@ -454,6 +761,21 @@ static void zram_free_page(struct zram *zram, size_t index)
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 
+	/* Tell a racing writeback that its copy of the page is stale */
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+	zram_clear_flag(meta, index, ZRAM_UNDER_RECOMP);
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+	zram_clear_flag(meta, index, ZRAM_RECOMP);
+	zram_clear_flag(meta, index, ZRAM_RECOMP_SKIP);
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, handle);
+		meta->table[index].handle = 0;
+		atomic64_dec(&zram->stats.pages_stored);
+		return;
+	}
+
 	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -494,11 +816,17 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 		return 0;
 	}
 
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return read_from_bdev_buf(zram, mem, handle);
+	}
+
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE)
 		copy_page(mem, cmem);
 	else
-		ret = zcomp_decompress(zram->comp, cmem, size, mem);
+		ret = zcomp_decompress(zram_page_comp(zram, index), cmem,
+				       size, mem);
 	zs_unmap_object(meta->mem_pool, handle);
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
@@ -511,6 +839,38 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+static int zram_bvec_read_bdev(struct zram *zram, struct bio_vec *bvec,
+			       unsigned long blk_idx, int offset)
+{
+	struct page *page = bvec->bv_page;
+	unsigned char *user_mem, *uncmem;
+	int ret;
+
+	if (!is_partial_io(bvec)) {
+		ret = read_from_bdev(zram, page, blk_idx);
+		if (!ret)
+			flush_dcache_page(page);
+		return ret;
+	}
+
+	/* Use a temporary buffer to read the page */
+	uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
+	if (!uncmem)
+		return -ENOMEM;
+
+	ret = read_from_bdev_buf(zram, uncmem, blk_idx);
+	if (!ret) {
+		user_mem = kmap_atomic(page);
+		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
+				bvec->bv_len);
+		kunmap_atomic(user_mem);
+		flush_dcache_page(page);
+	}
+
+	kfree(uncmem);
+	return ret;
+}
+
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset)
 {
@@ -527,6 +887,12 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		handle_zero_page(bvec);
 		return 0;
 	}
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		unsigned long blk_idx = meta->table[index].handle;
+
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return zram_bvec_read_bdev(zram, bvec, blk_idx, offset);
+	}
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	if (is_partial_io(bvec))
@@ -690,6 +1056,8 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	meta->table[index].handle = handle;
 	zram_set_obj_size(meta, index, clen);
+	if (clen == PAGE_SIZE)
+		zram_set_flag(meta, index, ZRAM_HUGE);
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	/* Update stats */
@@ -703,6 +1071,458 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+#define ZRAM_WB_HUGE	(1 << 0)	/* incompressible pages */
+#define ZRAM_WB_IDLE	(1 << 1)	/* pages idle for wb_idle_secs */
+
+/* Should be called with the entry's ZRAM_ACCESS bit lock held */
+static bool zram_wb_candidate(struct zram *zram, u32 index, int mode)
+{
+	struct zram_meta *meta = zram->meta;
+
+	if (!meta->table[index].handle ||
+			zram_test_flag(meta, index, ZRAM_ZERO) ||
+			zram_test_flag(meta, index, ZRAM_WB) ||
+			zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+			zram_test_flag(meta, index, ZRAM_UNDER_RECOMP))
+		return false;
+
+	if ((mode & ZRAM_WB_HUGE) && zram_test_flag(meta, index, ZRAM_HUGE))
+		return true;
+
+	if ((mode & ZRAM_WB_IDLE) &&
+			zram_page_idle(meta, index, zram->wb_idle_secs))
+		return true;
+
+	return false;
+}
+
+/*
+ * Move the pages selected by @mode to the backing device. Called with
+ * init_lock held for read, so the device cannot be reset under us.
+ */
+static int zram_writeback(struct zram *zram, int mode)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long blk_idx;
+	struct page *page;
+	u32 index;
+	int ret = 0;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	/*
+	 * One pass at a time: a second pass could otherwise set ZRAM_UNDER_WB
+	 * again on a page rewritten under the first one.
+	 */
+	mutex_lock(&zram->wb_lock);
+	for (index = 0; index < nr_pages; index++) {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!zram_wb_candidate(zram, index, mode)) {
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			continue;
+		}
+		/* Cleared by zram_free_page() if the page changes under us */
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+		blk_idx = alloc_block_bdev(zram);
+		if (!blk_idx) {
+			ret = -ENOSPC;
+		} else {
+			ret = zram_decompress_page(zram, page_address(page),
+						   index);
+			if (!ret)
+				ret = write_to_bdev(zram, page, blk_idx);
+		}
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (ret || !zram_test_flag(meta, index, ZRAM_UNDER_WB)) {
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			if (blk_idx)
+				free_block_bdev(zram, blk_idx);
+			if (ret)
+				break;
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		meta->table[index].handle = blk_idx;
+		zram_set_flag(meta, index, ZRAM_WB);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		atomic64_inc(&zram->stats.pages_stored);
+
+		cond_resched();
+	}
+	mutex_unlock(&zram->wb_lock);
+
+	__free_page(page);
+	return ret;
+}
+
+static void zram_wb_kick(struct zram *zram)
+{
+	if (zram_wb_enabled(zram) && zram->wb_idle_secs)
+		mod_delayed_work(system_unbound_wq, &zram->wb_work,
+				 zram->wb_idle_secs * HZ);
+}
+
+static void zram_wb_stop(struct zram *zram)
+{
+	cancel_delayed_work_sync(&zram->wb_work);
+}
+
+static void zram_wb_workfn(struct work_struct *work)
+{
+	struct zram *zram = container_of(to_delayed_work(work),
+					 struct zram, wb_work);
+
+	down_read(&zram->init_lock);
+	if (init_done(zram) && zram_wb_enabled(zram) && zram->wb_idle_secs) {
+		zram_writeback(zram, ZRAM_WB_HUGE | ZRAM_WB_IDLE);
+		zram_wb_kick(zram);
+	}
+	up_read(&zram->init_lock);
+}
+
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	int mode;
+	ssize_t ret;
+
+	if (sysfs_streq(buf, "huge"))
+		mode = ZRAM_WB_HUGE;
+	else if (sysfs_streq(buf, "idle"))
+		mode = ZRAM_WB_IDLE;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram_wb_enabled(zram)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = zram_writeback(zram, mode);
+	if (!ret)
+		ret = len;
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t writeback_idle_secs_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	unsigned int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->wb_idle_secs;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", val);
+}
+
+static ssize_t writeback_idle_secs_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	unsigned int val;
+	struct zram *zram = dev_to_zram(dev);
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	down_write(&zram->init_lock);
+	zram->wb_idle_secs = val;
+	if (init_done(zram))
+		zram_wb_kick(zram);
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+		"%8llu %8llu %8llu\n",
+		(u64)atomic64_read(&zram->stats.bd_count) << PAGE_SHIFT,
+		(u64)atomic64_read(&zram->stats.bd_reads) << PAGE_SHIFT,
+		(u64)atomic64_read(&zram->stats.bd_writes) << PAGE_SHIFT);
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#else
+static inline void zram_wb_kick(struct zram *zram) {}
+static inline void zram_wb_stop(struct zram *zram) {}
+#endif
+
+#ifdef CONFIG_ZRAM_MULTI_COMP
+/* Should be called with the entry's ZRAM_ACCESS bit lock held */
+static bool zram_recomp_candidate(struct zram *zram, u32 index)
+{
+	struct zram_meta *meta = zram->meta;
+
+	if (!meta->table[index].handle ||
+			zram_test_flag(meta, index, ZRAM_ZERO) ||
+			zram_test_flag(meta, index, ZRAM_WB) ||
+			zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+			zram_test_flag(meta, index, ZRAM_UNDER_RECOMP) ||
+			zram_test_flag(meta, index, ZRAM_RECOMP) ||
+			zram_test_flag(meta, index, ZRAM_RECOMP_SKIP))
+		return false;
+
+	return zram_page_idle(meta, index, zram->recomp_idle_secs);
+}
+
+/*
+ * Recompress idle pages with the secondary algorithm, keeping the new
+ * object only if it is smaller. Called with init_lock held for read.
+ */
+static void zram_recompress(struct zram *zram)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	struct zcomp_strm *zstrm;
+	unsigned long handle;
+	size_t old_size, clen;
+	unsigned char *cmem;
+	struct page *page;
+	u32 index;
+	int ret;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return;
+
+	for (index = 0; index < nr_pages; index++) {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!zram_recomp_candidate(zram, index)) {
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			continue;
+		}
+		/* Cleared by zram_free_page() if the page changes under us */
+		zram_set_flag(meta, index, ZRAM_UNDER_RECOMP);
+		old_size = zram_get_obj_size(meta, index);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+		handle = 0;
+		ret = zram_decompress_page(zram, page_address(page), index);
+		if (ret)
+			goto next;
+
+		zstrm = zcomp_strm_find(zram->recomp);
+		ret = zcomp_compress(zram->recomp, zstrm, page_address(page),
+				     &clen);
+		if (ret || clen >= old_size || clen > max_zpage_size) {
+			zcomp_strm_release(zram->recomp, zstrm);
+			goto next;
+		}
+
+		handle = zs_malloc(meta->mem_pool, clen);
+		if (!handle) {
+			zcomp_strm_release(zram->recomp, zstrm);
+			ret = -ENOMEM;
+			goto next;
+		}
+
+		cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_WO);
+		memcpy(cmem, zstrm->buffer, clen);
+		zcomp_strm_release(zram->recomp, zstrm);
+		zs_unmap_object(meta->mem_pool, handle);
+next:
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!zram_test_flag(meta, index, ZRAM_UNDER_RECOMP)) {
+			/* rewritten or freed meanwhile */
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			if (handle)
+				zs_free(meta->mem_pool, handle);
+			continue;
+		}
+
+		if (!handle) {
+			zram_clear_flag(meta, index, ZRAM_UNDER_RECOMP);
+			/* do not try again until the page is rewritten */
+			if (!ret)
+				zram_set_flag(meta, index, ZRAM_RECOMP_SKIP);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			if (ret == -ENOMEM)
+				break;
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		meta->table[index].handle = handle;
+		zram_set_obj_size(meta, index, clen);
+		zram_set_flag(meta, index, ZRAM_RECOMP);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+		atomic64_add(clen, &zram->stats.compr_data_size);
+		atomic64_inc(&zram->stats.pages_stored);
+		atomic64_inc(&zram->stats.num_recompressed);
+		atomic64_add(old_size - clen, &zram->stats.recomp_saved);
+
+		cond_resched();
+	}
+
+	__free_page(page);
+}
+
+static void zram_recomp_kick(struct zram *zram)
+{
+	if (zram->recomp && zram->recomp_idle_secs)
+		mod_delayed_work(system_unbound_wq, &zram->recomp_work,
+				 zram->recomp_idle_secs * HZ);
+}
+
+static void zram_recomp_stop(struct zram *zram)
+{
+	cancel_delayed_work_sync(&zram->recomp_work);
+}
+
+static void zram_recomp_workfn(struct work_struct *work)
+{
+	struct zram *zram = container_of(to_delayed_work(work),
+					 struct zram, recomp_work);
+
+	down_read(&zram->init_lock);
+	if (init_done(zram) && zram->recomp && zram->recomp_idle_secs) {
+		zram_recompress(zram);
+		zram_recomp_kick(zram);
+	}
+	up_read(&zram->init_lock);
+}
+
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_algorithm, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+	if (sysfs_streq(buf, "none"))
+		zram->recomp_algorithm[0] = '\0';
+	else
+		strlcpy(zram->recomp_algorithm, buf,
+			sizeof(zram->recomp_algorithm));
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static ssize_t recomp_idle_secs_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	unsigned int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->recomp_idle_secs;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", val);
+}
+
+static ssize_t recomp_idle_secs_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	unsigned int val;
+	struct zram *zram = dev_to_zram(dev);
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	down_write(&zram->init_lock);
+	zram->recomp_idle_secs = val;
+	if (init_done(zram))
+		zram_recomp_kick(zram);
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t recomp_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+		"%8llu %8llu\n",
+		(u64)atomic64_read(&zram->stats.num_recompressed),
+		(u64)atomic64_read(&zram->stats.recomp_saved));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+static struct zcomp *zram_recomp_create(struct zram *zram)
+{
+	struct zcomp *recomp;
+
+	if (!zram->recomp_algorithm[0])
+		return NULL;
+
+	recomp = zcomp_create(zram->recomp_algorithm, zram->max_comp_streams);
+	if (IS_ERR(recomp))
+		pr_info("Cannot initialise %s recompressing backend\n",
+				zram->recomp_algorithm);
+	return recomp;
+}
+
+static inline struct zcomp *zram_page_comp(struct zram *zram, u32 index)
+{
+	if (zram_test_flag(zram->meta, index, ZRAM_RECOMP))
+		return zram->recomp;
+	return zram->comp;
+}
+#else
+static inline void zram_recomp_kick(struct zram *zram) {}
+static inline void zram_recomp_stop(struct zram *zram) {}
+
+static inline struct zcomp *zram_recomp_create(struct zram *zram)
+{
+	return NULL;
+}
+
+static inline struct zcomp *zram_page_comp(struct zram *zram, u32 index)
+{
+	return zram->comp;
+}
+#endif
+
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, int rw)
 {
@@ -727,6 +1547,8 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			atomic64_inc(&zram->stats.failed_reads);
 		else
 			atomic64_inc(&zram->stats.failed_writes);
+	} else {
+		zram_touch(zram->meta, index);
 	}
 
 	return ret;
@@ -774,20 +1596,25 @@ static void zram_bio_discard(struct zram *zram, u32 index,
 static void zram_reset_device(struct zram *zram)
 {
 	struct zram_meta *meta;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp;
 	u64 disksize;
 
+	zram_wb_stop(zram);
+	zram_recomp_stop(zram);
+
 	down_write(&zram->init_lock);
 
 	zram->limit_pages = 0;
 
 	if (!init_done(zram)) {
+		reset_bdev(zram);
 		up_write(&zram->init_lock);
 		return;
 	}
 
 	meta = zram->meta;
 	comp = zram->comp;
+	recomp = zram->recomp;
 	disksize = zram->disksize;
 	/*
 	 * Refcount will go down to 0 eventually and r/w handler
@@ -800,6 +1627,7 @@ static void zram_reset_device(struct zram *zram)
 	 * deadlock between reclaim path and any other locks.
 	 */
 	wait_event(zram->io_done, atomic_read(&zram->refcount) == 0);
+	reset_bdev(zram);
 
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
@@ -813,13 +1641,15 @@ static void zram_reset_device(struct zram *zram)
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(meta, disksize);
 	zcomp_destroy(comp);
+	if (recomp)
+		zcomp_destroy(recomp);
 }
 
 static ssize_t disksize_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	u64 disksize;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp;
 	struct zram_meta *meta;
 	struct zram *zram = dev_to_zram(dev);
 	int err;
@@ -841,19 +1671,28 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	recomp = zram_recomp_create(zram);
+	if (IS_ERR(recomp)) {
+		err = PTR_ERR(recomp);
+		goto out_destroy_comp;
+	}
+
 	down_write(&zram->init_lock);
 	if (init_done(zram)) {
 		pr_info("Cannot change disksize for initialized device\n");
 		err = -EBUSY;
-		goto out_destroy_comp;
+		goto out_destroy_recomp;
 	}
 
 	init_waitqueue_head(&zram->io_done);
 	atomic_set(&zram->refcount, 1);
 	zram->meta = meta;
 	zram->comp = comp;
+	zram->recomp = recomp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
+	zram_wb_kick(zram);
+	zram_recomp_kick(zram);
 	up_write(&zram->init_lock);
 
 	/*
@@ -865,8 +1704,11 @@ static ssize_t disksize_store(struct device *dev,
 
 	return len;
 
-out_destroy_comp:
+out_destroy_recomp:
 	up_write(&zram->init_lock);
+	if (recomp)
+		zcomp_destroy(recomp);
+out_destroy_comp:
 	zcomp_destroy(comp);
 out_free_meta:
 	zram_meta_free(meta, disksize);
@@ -1071,6 +1913,17 @@ static DEVICE_ATTR_RW(mem_limit);
 static DEVICE_ATTR_RW(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_WO(writeback);
+static DEVICE_ATTR_RW(writeback_idle_secs);
+static DEVICE_ATTR_RO(bd_stat);
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_RW(recomp_idle_secs);
+static DEVICE_ATTR_RO(recomp_stat);
+#endif
 
 static ssize_t io_stat_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
@@ -1151,6 +2004,17 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_comp_algorithm.attr,
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_writeback_idle_secs.attr,
+	&dev_attr_bd_stat.attr,
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recomp_idle_secs.attr,
+	&dev_attr_recomp_stat.attr,
+#endif
 	NULL,
 };
 
@@ -1164,6 +2028,13 @@ static int create_device(struct zram *zram, int device_id)
 	int ret = -ENOMEM;
 
 	init_rwsem(&zram->init_lock);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	mutex_init(&zram->wb_lock);
+	INIT_DELAYED_WORK(&zram->wb_work, zram_wb_workfn);
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	INIT_DELAYED_WORK(&zram->recomp_work, zram_recomp_workfn);
+#endif
 
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
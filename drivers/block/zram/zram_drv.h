@@ -16,6 +16,7 @@
 #define _ZRAM_DRV_H_
 
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/zsmalloc.h>
 
 #include "zcomp.h"
@@ -68,6 +69,12 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO = ZRAM_FLAG_SHIFT,
 	ZRAM_ACCESS,	/* page is now accessed */
+	ZRAM_HUGE,	/* page is stored uncompressed */
+	ZRAM_WB,	/* page is stored on the backing device */
+	ZRAM_UNDER_WB,	/* page is being written back */
+	ZRAM_RECOMP,	/* page is compressed with the secondary algorithm */
+	ZRAM_UNDER_RECOMP,	/* page is being recompressed */
+	ZRAM_RECOMP_SKIP,	/* secondary algorithm did not help */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -76,8 +83,11 @@ enum zram_pageflags {
 
 /* Allocated for each disk page */
 struct zram_table_entry {
-	unsigned long handle;
+	unsigned long handle;	/* block index on backing dev for ZRAM_WB */
 	unsigned long value;
+#ifdef CONFIG_ZRAM_ACCESS_TIME
+	unsigned long ac_time;	/* jiffies of the last access */
+#endif
 };
 
 struct zram_stats {
@@ -92,6 +102,15 @@ struct zram_stats {
 	atomic64_t zero_pages;		/* no. of zero filled pages */
 	atomic64_t pages_stored;	/* no. of pages currently stored */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;		/* no. of pages in backing device */
+	atomic64_t bd_reads;		/* no. of reads from backing device */
+	atomic64_t bd_writes;		/* no. of writes to backing device */
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	atomic64_t num_recompressed;	/* no. of recompressed pages */
+	atomic64_t recomp_saved;	/* bytes saved by recompression */
+#endif
 };
 
 struct zram_meta {
@@ -101,7 +120,7 @@ struct zram_meta {
 
 struct zram {
 	struct zram_meta *meta;
-	struct zcomp *comp;
+	struct zcomp *comp;	/* streams of the primary algorithm */
 	struct gendisk *disk;
 	/* Prevent concurrent execution of device init */
 	struct rw_semaphore init_lock;
@@ -121,5 +140,21 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[10];
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct file *backing_dev;
+	struct block_device *bdev;
+	unsigned int old_block_size;
+	unsigned long *bitmap;		/* in-use blocks of the backing dev */
+	unsigned long nr_pages;		/* size of the backing dev in pages */
+	unsigned int wb_idle_secs;	/* idle age for background writeback */
+	struct mutex wb_lock;		/* serializes writeback passes */
+	struct delayed_work wb_work;
+#endif
+	struct zcomp *recomp;		/* secondary, higher ratio algorithm */
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	char recomp_algorithm[10];
+	unsigned int recomp_idle_secs;	/* idle age for recompression */
+	struct delayed_work recomp_work;
+#endif
 };
 #endif
@@ -28,12 +28,16 @@
 #include <linux/of_device.h>
 #include <linux/of_address.h>
 #include <linux/interrupt.h>
+#include <linux/kfifo.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 #include <asm/io.h>
 
 #define RNG_REG_STATUS_RDY			(1 << 0)
 
 #define RNG_REG_INTACK_RDY_MASK			(1 << 0)
+#define RNG_REG_INTMASK_RDY_MASK		(1 << 0)
 #define RNG_REG_INTACK_SHUTDOWN_OFLO_MASK	(1 << 1)
 #define RNG_SHUTDOWN_OFLO_MASK			(1 << 1)
 
@@ -64,6 +68,13 @@
 #define OMAP2_RNG_OUTPUT_SIZE			0x4
 #define OMAP4_RNG_OUTPUT_SIZE			0x8
 
+/*
+ * Words buffered from the ready interrupt on OMAP4 class devices, enough
+ * for several hwrng core reads.  Must be a power of two.
+ */
+#define OMAP4_RNG_FIFO_WORDS			128
+#define OMAP4_RNG_TIMEOUT_MS			100
+
 enum {
 	RNG_OUTPUT_L_REG = 0,
 	RNG_OUTPUT_H_REG,
@@ -127,6 +138,11 @@ struct omap_rng_dev {
 	void __iomem			*base;
 	struct device			*dev;
 	const struct omap_rng_pdata	*pdata;
+
+	/* OMAP4 only: output words collected by omap4_rng_irq() */
+	spinlock_t			lock;
+	wait_queue_head_t		wait;
+	DECLARE_KFIFO(fifo, u32, OMAP4_RNG_FIFO_WORDS);
 };
 
 static inline u32 omap_rng_read(struct omap_rng_dev *priv, u16 reg)
@@ -153,8 +169,8 @@ static int omap_rng_data_present(struct hwrng *rng, int wait)
 			break;
 		/* RNG produces data fast enough (2+ MBit/sec, even
 		 * during "rngtest" loads, that these delays don't
-		 * seem to trigger.  We *could* use the RNG IRQ, but
-		 * that'd be higher overhead ... so why bother?
+		 * seem to trigger.  Only OMAP2/3 get here, OMAP4 class
+		 * devices are read from the RNG IRQ, see omap4_rng_read().
 		 */
 		udelay(10);
 	}
@@ -265,10 +281,74 @@ static void omap4_rng_cleanup(struct omap_rng_dev *priv)
 	omap_rng_write(priv, RNG_CONTROL_REG, val);
 }
 
+static void omap4_rng_set_rdy_irq(struct omap_rng_dev *priv, bool enable)
+{
+	u32 mask = RNG_SHUTDOWN_OFLO_MASK;
+
+	if (enable)
+		mask |= RNG_REG_INTMASK_RDY_MASK;
+	omap_rng_write(priv, RNG_INTMASK_REG, mask);
+}
+
+/*
+ * Move the output register into the fifo.  Once the fifo is full the
+ * ready interrupt is masked, and the next sample simply waits in the
+ * output register until omap4_rng_read() has made room again.
+ */
+static void omap4_rng_fill(struct omap_rng_dev *priv)
+{
+	u32 data[OMAP4_RNG_OUTPUT_SIZE / sizeof(u32)];
+
+	spin_lock(&priv->lock);
+	if (kfifo_avail(&priv->fifo) >= ARRAY_SIZE(data)) {
+		data[0] = omap_rng_read(priv, RNG_OUTPUT_L_REG);
+		data[1] = omap_rng_read(priv, RNG_OUTPUT_H_REG);
+		omap_rng_write(priv, RNG_INTACK_REG, RNG_REG_INTACK_RDY_MASK);
+		kfifo_in(&priv->fifo, data, ARRAY_SIZE(data));
+	}
+	if (kfifo_avail(&priv->fifo) < ARRAY_SIZE(data))
+		omap4_rng_set_rdy_irq(priv, false);
+	spin_unlock(&priv->lock);
+
+	wake_up(&priv->wait);
+}
+
+static int omap4_rng_read(struct hwrng *rng, void *data, size_t max,
+			  bool wait)
+{
+	struct omap_rng_dev *priv = (struct omap_rng_dev *)rng->priv;
+	unsigned long flags;
+	unsigned int n;
+
+	if (wait)
+		wait_event_interruptible_timeout(priv->wait,
+				!kfifo_is_empty(&priv->fifo),
+				msecs_to_jiffies(OMAP4_RNG_TIMEOUT_MS));
+
+	n = kfifo_out(&priv->fifo, (u32 *)data, max / sizeof(u32));
+
+	spin_lock_irqsave(&priv->lock, flags);
+	omap4_rng_set_rdy_irq(priv, true);
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	return n * sizeof(u32);
+}
+
 static irqreturn_t omap4_rng_irq(int irq, void *dev_id)
 {
 	struct omap_rng_dev *priv = dev_id;
 	u32 fro_detune, fro_enable;
+	u32 status;
+
+	status = omap_rng_read(priv, RNG_STATUS_REG);
+	if (!(status & (RNG_REG_STATUS_RDY | RNG_SHUTDOWN_OFLO_MASK)))
+		return IRQ_NONE;
+
+	if (status & RNG_REG_STATUS_RDY)
+		omap4_rng_fill(priv);
+
+	if (!(status & RNG_SHUTDOWN_OFLO_MASK))
+		return IRQ_HANDLED;
 
 	/*
 	 * Interrupt raised by a fro shutdown threshold, do the following:
@@ -335,6 +415,10 @@ static int of_get_omap_rng_device_details(struct omap_rng_dev *priv,
 			return irq;
 		}
 
+		spin_lock_init(&priv->lock);
+		init_waitqueue_head(&priv->wait);
+		INIT_KFIFO(priv->fifo);
+
 		err = devm_request_irq(dev, irq, omap4_rng_irq,
 				       IRQF_TRIGGER_NONE, dev_name(dev), priv);
 		if (err) {
@@ -342,7 +426,10 @@ static int of_get_omap_rng_device_details(struct omap_rng_dev *priv,
 				irq, err);
 			return err;
 		}
-		omap_rng_write(priv, RNG_INTMASK_REG, RNG_SHUTDOWN_OFLO_MASK);
+
+		/* let the ready interrupt feed reads instead of polling */
+		omap_rng_ops.read = omap4_rng_read;
+		omap4_rng_set_rdy_irq(priv, true);
 	}
 	return 0;
 }
@@ -23,6 +23,7 @@
 #include <linux/device.h>
 #include <linux/init.h>
 #include <linux/kernel_stat.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
@@ -56,6 +57,24 @@ DEFINE_MUTEX(cpufreq_governor_lock);
 /* This one keeps track of the previously set governor of a removed CPU */
 static DEFINE_PER_CPU(char[CPUFREQ_NAME_LEN], cpufreq_cpu_governor);
 
+DEFINE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
+
+/**
+ * cpufreq_set_update_util_data - set the scheduler hook of a CPU
+ * @cpu: CPU to set the hook for
+ * @data: hook to install, or NULL to remove it
+ *
+ * The hook is called by the scheduler with the runqueue lock held and
+ * interrupts disabled, on the CPU it is installed for, so @data->func
+ * must not sleep. Callers removing a hook must synchronize_sched()
+ * before freeing it.
+ */
+void cpufreq_set_update_util_data(int cpu, struct update_util_data *data)
+{
+	rcu_assign_pointer(per_cpu(cpufreq_update_util_data, cpu), data);
+}
+EXPORT_SYMBOL_GPL(cpufreq_set_update_util_data);
+
 /* Flag to suspend/resume CPUFreq governors */
 static bool cpufreq_suspended;
 
@@ -384,6 +403,7 @@ wait:
 	spin_unlock(&policy->transition_lock);
 
 	cpufreq_notify_transition(policy, freqs, CPUFREQ_PRECHANGE);
+	policy->transition_start = ktime_get_ns();
 }
 EXPORT_SYMBOL_GPL(cpufreq_freq_transition_begin);
 
@@ -393,6 +413,9 @@ void cpufreq_freq_transition_end(struct cpufreq_policy *policy,
 	if (unlikely(WARN_ON(!policy->transition_ongoing)))
 		return;
 
+	/* time spent in the driver, for POSTCHANGE notifiers to pick up */
+	policy->transition_time = ktime_get_ns() - policy->transition_start;
+
 	cpufreq_notify_post_transition(policy, freqs, transition_failed);
 
 	policy->transition_ongoing = false;
@@ -25,6 +25,9 @@ struct cpufreq_stats {
 	unsigned int last_index;
 	u64 *time_in_state;
 	unsigned int *freq_table;
+	u64 trans_time_last;
+	u64 trans_time_max;
+	u64 trans_time_total;
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	unsigned int *trans_table;
 #endif
@@ -105,12 +108,32 @@ static ssize_t show_trans_table(struct cpufreq_policy *policy, char *buf)
 cpufreq_freq_attr_ro(trans_table);
 #endif
 
+/* last, average and worst transition time in the driver, in ns */
+static ssize_t show_transition_time(struct cpufreq_policy *policy, char *buf)
+{
+	struct cpufreq_stats *stats = policy->stats;
+	u64 last, max, total;
+	unsigned int trans;
+
+	spin_lock(&cpufreq_stats_lock);
+	last = stats->trans_time_last;
+	max = stats->trans_time_max;
+	total = stats->trans_time_total;
+	trans = stats->total_trans;
+	spin_unlock(&cpufreq_stats_lock);
+
+	return sprintf(buf, "%llu %llu %llu\n", last,
+		       trans ? div_u64(total, trans) : 0, max);
+}
+
 cpufreq_freq_attr_ro(total_trans);
 cpufreq_freq_attr_ro(time_in_state);
+cpufreq_freq_attr_ro(transition_time);
 
 static struct attribute *default_attrs[] = {
 	&total_trans.attr,
 	&time_in_state.attr,
+	&transition_time.attr,
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	&trans_table.attr,
 #endif
@@ -296,7 +319,14 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	stats->trans_table[old_index * stats->max_state + new_index]++;
 #endif
+
+	spin_lock(&cpufreq_stats_lock);
 	stats->total_trans++;
+	stats->trans_time_last = policy->transition_time;
+	stats->trans_time_total += policy->transition_time;
+	if (policy->transition_time > stats->trans_time_max)
+		stats->trans_time_max = policy->transition_time;
+	spin_unlock(&cpufreq_stats_lock);
 
 put_policy:
 	cpufreq_cpu_put(policy);
@@ -38,6 +38,8 @@ static struct cpufreq_frequency_table *freq_table;
 static atomic_t freq_table_users = ATOMIC_INIT(0);
 static struct device *mpu_dev;
 static struct regulator *mpu_reg;
+/* voltage last requested from mpu_reg, 0 until the first transition */
+static unsigned long mpu_volt;
 
 static int omap_target(struct cpufreq_policy *policy, unsigned int index)
 {
@@ -71,21 +73,27 @@ static int omap_target(struct cpufreq_policy *policy, unsigned int index)
 		volt = dev_pm_opp_get_voltage(opp);
 		rcu_read_unlock();
 		tol = volt * OPP_TOLERANCE / 100;
-		volt_old = regulator_get_voltage(mpu_reg);
+		volt_old = mpu_volt;
 	}
 
 	dev_dbg(mpu_dev, "cpufreq-omap: %u MHz, %ld mV --> %u MHz, %ld mV\n", 
 		old_freq / 1000, volt_old ? volt_old / 1000 : -1,
 		new_freq / 1000, volt ? volt / 1000 : -1);
 
+	/* OPPs within a voltage band only need the clock reprogrammed */
+	if (mpu_reg && volt == volt_old)
+		return clk_set_rate(policy->clk, new_freq * 1000);
+
 	/* scaling up?  scale voltage before frequency */
 	if (mpu_reg && (new_freq > old_freq)) {
 		r = regulator_set_voltage(mpu_reg, volt - tol, volt + tol);
 		if (r < 0) {
 			dev_warn(mpu_dev, "%s: unable to scale voltage up.\n",
 				 __func__);
+			mpu_volt = 0;
 			return r;
 		}
+		mpu_volt = volt;
 	}
 
 	ret = clk_set_rate(policy->clk, new_freq * 1000);
@@ -96,9 +104,11 @@ static int omap_target(struct cpufreq_policy *policy, unsigned int index)
 		if (r < 0) {
 			dev_warn(mpu_dev, "%s: unable to scale voltage down.\n",
 				 __func__);
+			mpu_volt = 0;
 			clk_set_rate(policy->clk, old_freq * 1000);
 			return r;
 		}
+		mpu_volt = volt;
 	}
 
 	return ret;
@@ -30,24 +30,22 @@
 #include <linux/interrupt.h>
 #include <crypto/scatterwalk.h>
 #include <crypto/aes.h>
+#include <crypto/engine.h>
 #include "omap-aes.h"
 
-static int omap_aes_gcm_handle_queue(struct omap_aes_dev *dd,
-				     struct aead_request *req);
-
 static void omap_aes_gcm_finish_req(struct omap_aes_dev *dd, int ret)
 {
 	struct aead_request *req = dd->aead_req;
 
-	dd->flags &= ~FLAGS_BUSY;
 	dd->in_sg = NULL;
 	dd->out_sg = NULL;
 
-	req->base.complete(&req->base, ret);
+	crypto_finalize_request(dd->engine, &req->base, ret);
 }
 
 static void omap_aes_gcm_done_task(struct omap_aes_dev *dd)
 {
+	struct omap_aes_reqctx *rctx = aead_request_ctx(dd->aead_req);
 	void *buf;
 	u8 *tag;
 	int pages, alen, clen, i, ret = 0, nsg;
@@ -75,7 +73,7 @@ static void omap_aes_gcm_done_task(struct omap_aes_dev *dd)
 	}
 
 	if (dd->flags & FLAGS_ENCRYPT)
-		scatterwalk_map_and_copy(dd->ctx->auth_tag, dd->aead_req->dst,
+		scatterwalk_map_and_copy(rctx->auth_tag, dd->aead_req->dst,
 					 dd->total, dd->authsize, 1);
 
 	if (dd->sgs_copied & AES_ASSOC_DATA_COPIED) {
@@ -90,7 +88,7 @@ static void omap_aes_gcm_done_task(struct omap_aes_dev *dd)
 	}
 
 	if (!(dd->flags & FLAGS_ENCRYPT)) {
-		tag = (u8 *)dd->ctx->auth_tag;
+		tag = (u8 *)rctx->auth_tag;
 		for (i = 0; i < dd->authsize; i++) {
 			if (tag[i]) {
 				dev_err(dd->dev, "GCM decryption: Tag Message is wrong\n");
@@ -100,7 +98,6 @@ static void omap_aes_gcm_done_task(struct omap_aes_dev *dd)
 	}
 
 	omap_aes_gcm_finish_req(dd, ret);
-	omap_aes_gcm_handle_queue(dd, NULL);
 }
 
 static int omap_aes_gcm_copy_buffers(struct omap_aes_dev *dd,
@@ -190,69 +187,20 @@ static int omap_aes_gcm_copy_buffers(struct omap_aes_dev *dd,
 	return 0;
 }
 
-static void tcrypt_complete(struct crypto_async_request *req, int err)
-{
-	struct tcrypt_result *res = req->data;
-
-	if (err == -EINPROGRESS)
-		return;
-
-	res->err = err;
-	complete(&res->completion);
-}
-
-static int do_encrypt_iv(struct aead_request *req, u32 *tag)
+/*
+ * E(K, J0), which masks the tag.  This runs in the caller's context,
+ * which is atomic for IPsec, so the single block is done inline with a
+ * cipher tfm keyed alongside the engine.
+ */
+static void do_encrypt_iv(struct omap_aes_ctx *ctx, u32 *tag, u8 *iv)
 {
-	struct scatterlist iv_sg;
-	struct ablkcipher_request *ablk_req;
-	struct crypto_ablkcipher *tfm;
-	struct tcrypt_result result;
-	struct omap_aes_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
-	int ret = 0;
-
-	tfm = crypto_alloc_ablkcipher("ctr(aes)", 0, 0);
-	ablk_req = ablkcipher_request_alloc(tfm, GFP_KERNEL);
-	if (!ablk_req) {
-		pr_err("skcipher: Failed to allocate request\n");
-		return -1;
-	}
-
-	init_completion(&result.completion);
-
-	sg_init_one(&iv_sg, tag, AES_BLOCK_SIZE);
-	ablkcipher_request_set_callback(ablk_req, CRYPTO_TFM_REQ_MAY_BACKLOG,
-					tcrypt_complete, &result);
-	ret = crypto_ablkcipher_setkey(tfm, (u8 *)ctx->key, ctx->keylen);
-	ablkcipher_request_set_crypt(ablk_req, &iv_sg, &iv_sg, AES_BLOCK_SIZE,
-				     ctx->iv);
-	ret = crypto_ablkcipher_encrypt(ablk_req);
-	switch (ret) {
-	case 0:
-		break;
-	case -EINPROGRESS:
-	case -EBUSY:
-		ret = wait_for_completion_interruptible(&result.completion);
-		if (!ret) {
-			ret = result.err;
-			if (!ret) {
-				reinit_completion(&result.completion);
-				break;
-			}
-		}
-		/* fall through */
-	default:
-		pr_err("Encryptio of IV failed for GCM mode");
-		break;
-	}
-
-	ablkcipher_request_free(ablk_req);
-	crypto_free_ablkcipher(tfm);
-	return ret;
+	crypto_cipher_encrypt_one(ctx->gcm_cipher, (u8 *)tag, iv);
 }
 
 void omap_aes_gcm_process_auth_tag(void *data)
 {
 	struct omap_aes_dev *dd = data;
+	struct omap_aes_reqctx *rctx = aead_request_ctx(dd->aead_req);
 	int i, val;
 	u32 *auth_tag, tag[4];
 
@@ -260,7 +208,7 @@ void omap_aes_gcm_process_auth_tag(void *data)
 		scatterwalk_map_and_copy(tag, dd->aead_req->src, dd->total_save,
 					 dd->authsize, 0);
 
-	auth_tag = dd->ctx->auth_tag;
+	auth_tag = rctx->auth_tag;
 	for (i = 0; i < 4; i++) {
 		val = omap_aes_read(dd, AES_REG_TAG_N(dd, i));
 		auth_tag[i] = val ^ auth_tag[i];
@@ -272,35 +220,11 @@ void omap_aes_gcm_process_auth_tag(void *data)
 	omap_aes_gcm_done_task(dd);
 }
 
-static int omap_aes_gcm_handle_queue(struct omap_aes_dev *dd,
-				     struct aead_request *req)
+int omap_aes_gcm_prepare_req(struct omap_aes_dev *dd, struct aead_request *req)
 {
 	struct omap_aes_ctx *ctx;
-	struct crypto_async_request *async_req, *backlog;
 	struct omap_aes_reqctx *rctx;
-	unsigned long flags;
-	int err, ret = 0;
-
-	spin_lock_irqsave(&dd->lock, flags);
-	if (req)
-		ret = crypto_enqueue_request(&dd->aead_queue, &req->base);
-	if (dd->flags & FLAGS_BUSY) {
-		spin_unlock_irqrestore(&dd->lock, flags);
-		return ret;
-	}
-	backlog = crypto_get_backlog(&dd->aead_queue);
-	async_req = crypto_dequeue_request(&dd->aead_queue);
-	if (async_req)
-		dd->flags |= FLAGS_BUSY;
-	spin_unlock_irqrestore(&dd->lock, flags);
-
-	if (!async_req)
-		return ret;
-
-	if (backlog)
-		backlog->complete(backlog, -EINPROGRESS);
-
-	req = aead_request_cast(async_req);
+	int err;
 
 	ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
 	rctx = aead_request_ctx(req);
@@ -316,16 +240,7 @@ static int omap_aes_gcm_handle_queue(struct omap_aes_dev *dd,
 	if (err)
 		return err;
 
-	err = omap_aes_write_ctrl(dd);
-	if (!err)
-		err = omap_aes_crypt_dma_start(dd);
-
-	if (err) {
-		omap_aes_gcm_finish_req(dd, err);
-		omap_aes_gcm_handle_queue(dd, NULL);
-	}
-
-	return ret;
+	return omap_aes_write_ctrl(dd);
 }
 
 static int omap_aes_gcm_crypt(struct aead_request *req, unsigned long mode)
@@ -336,18 +251,14 @@ static int omap_aes_gcm_crypt(struct aead_request *req, unsigned long mode)
 	unsigned int authlen = crypto_aead_authsize(aead);
 	struct omap_aes_dev *dd;
 	__be32 counter = cpu_to_be32(1);
-	int err;
 
-	memset(ctx->auth_tag, 0, sizeof(ctx->auth_tag));
-	memcpy(ctx->iv + 12, &counter, 4);
+	memcpy(rctx->iv + 12, &counter, 4);
 
 	/* Create E(K, IV) */
-	err = do_encrypt_iv(req, ctx->auth_tag);
-	if (err)
-		return err;
+	do_encrypt_iv(ctx, rctx->auth_tag, rctx->iv);
 
 	if (req->assoclen + req->cryptlen == 0) {
-		scatterwalk_map_and_copy(ctx->auth_tag, req->dst, 0, authlen,
+		scatterwalk_map_and_copy(rctx->auth_tag, req->dst, 0, authlen,
 					 1);
 		return 0;
 	}
@@ -357,38 +268,42 @@ static int omap_aes_gcm_crypt(struct aead_request *req, unsigned long mode)
 		return -ENODEV;
 	rctx->mode = mode;
 
-	return omap_aes_gcm_handle_queue(dd, req);
+	return crypto_transfer_request_to_engine(dd->engine, &req->base);
 }
 
 int omap_aes_gcm_encrypt(struct aead_request *req)
 {
-	struct omap_aes_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+	struct omap_aes_reqctx *rctx = aead_request_ctx(req);
 
-	memcpy(ctx->iv, req->iv, 12);
+	memcpy(rctx->iv, req->iv, 12);
 	return omap_aes_gcm_crypt(req, FLAGS_ENCRYPT | FLAGS_GCM);
 }
 
 int omap_aes_gcm_decrypt(struct aead_request *req)
 {
-	struct omap_aes_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+	struct omap_aes_reqctx *rctx = aead_request_ctx(req);
 
-	memcpy(ctx->iv, req->iv, 12);
+	memcpy(rctx->iv, req->iv, 12);
 	return omap_aes_gcm_crypt(req, FLAGS_GCM);
 }
 
 int omap_aes_4106gcm_encrypt(struct aead_request *req)
 {
 	struct omap_aes_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+	struct omap_aes_reqctx *rctx = aead_request_ctx(req);
 
-	memcpy(ctx->iv + 4, req->iv, 8);
+	memcpy(rctx->iv, ctx->iv, 4);
+	memcpy(rctx->iv + 4, req->iv, 8);
 	return omap_aes_gcm_crypt(req, FLAGS_ENCRYPT | FLAGS_GCM);
 }
 
 int omap_aes_4106gcm_decrypt(struct aead_request *req)
 {
 	struct omap_aes_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+	struct omap_aes_reqctx *rctx = aead_request_ctx(req);
 
-	memcpy(ctx->iv + 4, req->iv, 8);
+	memcpy(rctx->iv, ctx->iv, 4);
+	memcpy(rctx->iv + 4, req->iv, 8);
 	return omap_aes_gcm_crypt(req, FLAGS_GCM);
 }
 
@@ -396,11 +311,16 @@ int omap_aes_gcm_setkey(struct crypto_aead *tfm, const u8 *key,
 			unsigned int keylen)
 {
 	struct omap_aes_ctx *ctx = crypto_aead_ctx(tfm);
+	int ret;
 
 	if (keylen != AES_KEYSIZE_128 && keylen != AES_KEYSIZE_192 &&
 	    keylen != AES_KEYSIZE_256)
 		return -EINVAL;
 
+	ret = crypto_cipher_setkey(ctx->gcm_cipher, key, keylen);
+	if (ret)
+		return ret;
+
 	memcpy(ctx->key, key, keylen);
 	ctx->keylen = keylen;
 
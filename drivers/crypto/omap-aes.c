@@ -36,6 +36,8 @@
 #include <linux/interrupt.h>
 #include <crypto/scatterwalk.h>
 #include <crypto/aes.h>
+#include <crypto/engine.h>
+#include <crypto/gf128mul.h>
 #include <crypto/internal/aead.h>
 #include "omap-aes.h"
 
@@ -43,6 +45,27 @@
 static LIST_HEAD(dev_list);
 static DEFINE_SPINLOCK(list_lock);
 
+/*
+ * Requests shorter than this are run synchronously on the software
+ * fallback: below it, setting up the engine and the DMA transfer costs
+ * more than the CPU needs for the cipher itself.
+ */
+static unsigned int aes_fallback_sz = 200;
+module_param(aes_fallback_sz, uint, 0644);
+MODULE_PARM_DESC(aes_fallback_sz,
+		 "Requests below this size (bytes) use the software fallback");
+
+/*
+ * With more than this many requests waiting for the engine, further ones
+ * run on the software fallback in the submitter's context instead.  dm-crypt
+ * submits from an unbound workqueue, so the other cores then encrypt in
+ * parallel with the accelerator rather than queueing up behind it.
+ */
+static unsigned int aes_hw_depth;
+module_param(aes_hw_depth, uint, 0644);
+MODULE_PARM_DESC(aes_hw_depth,
+		 "Requests queued to the engine before spilling to the software fallback (0: never spill)");
+
 #ifdef DEBUG
 #define omap_aes_read(dd, offset)				\
 ({								\
@@ -104,6 +127,7 @@ static int omap_aes_hw_init(struct omap_aes_dev *dd)
 
 int omap_aes_write_ctrl(struct omap_aes_dev *dd)
 {
+	struct omap_aes_reqctx *rctx;
 	unsigned int key32;
 	int i, err;
 	u32 val;
@@ -127,9 +151,10 @@ int omap_aes_write_ctrl(struct omap_aes_dev *dd)
 	if ((dd->flags & (FLAGS_CBC | FLAGS_CTR)) && dd->req->info)
 		omap_aes_write_n(dd, AES_REG_IV(dd, 0), dd->req->info, 4);
 
-	if ((dd->flags & (FLAGS_GCM)) && dd->aead_req->iv)
-		omap_aes_write_n(dd, AES_REG_IV(dd, 0),
-				 (u32 *)dd->ctx->iv, 4);
+	if ((dd->flags & (FLAGS_GCM)) && dd->aead_req->iv) {
+		rctx = aead_request_ctx(dd->aead_req);
+		omap_aes_write_n(dd, AES_REG_IV(dd, 0), (u32 *)rctx->iv, 4);
+	}
 
 	val = FLD_VAL(((dd->ctx->keylen >> 3) - 1), 4, 3);
 	if (dd->flags & FLAGS_CBC)
@@ -389,9 +414,7 @@ static void omap_aes_finish_req(struct omap_aes_dev *dd, int err)
 
 	pr_debug("err: %d\n", err);
 
-	dd->flags &= ~FLAGS_BUSY;
-
-	req->base.complete(&req->base, err);
+	crypto_finalize_request(dd->engine, &req->base, err);
 }
 
 int omap_aes_crypt_dma_stop(struct omap_aes_dev *dd)
@@ -462,35 +485,50 @@ static int omap_aes_copy_sgs(struct omap_aes_dev *dd)
 	return 0;
 }
 
-static int omap_aes_handle_queue(struct omap_aes_dev *dd,
-			       struct ablkcipher_request *req)
+/*
+ * XTS runs on top of the engine's ECB mode.  Each block of src is xored
+ * with its tweak into dst, the engine then encrypts or decrypts dst in
+ * place, and the same tweaks are xored in once more on completion.
+ */
+static void omap_aes_xts_whiten(struct omap_aes_reqctx *rctx,
+				struct scatterlist *src,
+				struct scatterlist *dst, unsigned int nbytes)
 {
-	struct crypto_async_request *async_req, *backlog;
-	struct omap_aes_ctx *ctx;
-	struct omap_aes_reqctx *rctx;
-	unsigned long flags;
-	int err, ret = 0, len;
-
-	spin_lock_irqsave(&dd->lock, flags);
-	if (req)
-		ret = ablkcipher_enqueue_request(&dd->queue, req);
-	if (dd->flags & FLAGS_BUSY) {
-		spin_unlock_irqrestore(&dd->lock, flags);
-		return ret;
+	struct scatter_walk in, out;
+	be128 t, buf;
+
+	memcpy(&t, rctx->tweak, AES_BLOCK_SIZE);
+
+	scatterwalk_start(&in, src);
+	scatterwalk_start(&out, dst);
+
+	for (; nbytes; nbytes -= AES_BLOCK_SIZE) {
+		scatterwalk_copychunks(&buf, &in, AES_BLOCK_SIZE, 0);
+		be128_xor(&buf, &buf, &t);
+		scatterwalk_copychunks(&buf, &out, AES_BLOCK_SIZE, 1);
+		gf128mul_x_ble(&t, &t);
 	}
-	backlog = crypto_get_backlog(&dd->queue);
-	async_req = crypto_dequeue_request(&dd->queue);
-	if (async_req)
-		dd->flags |= FLAGS_BUSY;
-	spin_unlock_irqrestore(&dd->lock, flags);
 
-	if (!async_req)
-		return ret;
+	scatterwalk_done(&in, 0, 0);
+	scatterwalk_done(&out, 1, 0);
+}
 
-	if (backlog)
-		backlog->complete(backlog, -EINPROGRESS);
+static int omap_aes_prepare_req(struct crypto_engine *engine,
+				struct crypto_async_request *areq)
+{
+	struct omap_aes_dev *dd = dev_get_drvdata(engine->priv_data);
+	struct ablkcipher_request *req;
+	struct omap_aes_ctx *ctx;
+	struct omap_aes_reqctx *rctx;
+	int len;
 
-	req = ablkcipher_request_cast(async_req);
+	/* GCM and the block modes share the engine, and so its queue */
+	if (crypto_tfm_alg_type(areq->tfm) == CRYPTO_ALG_TYPE_AEAD)
+		return omap_aes_gcm_prepare_req(dd, aead_request_cast(areq));
+
+	req = ablkcipher_request_cast(areq);
+	rctx = ablkcipher_request_ctx(req);
+	ctx = crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
 
 	/* assign new request to device */
 	dd->req = req;
@@ -499,6 +537,17 @@ static int omap_aes_handle_queue(struct omap_aes_dev *dd,
 	dd->in_sg = req->src;
 	dd->out_sg = req->dst;
 
+	/*
+	 * Whiten only now that the request is ours: dst may be src, and a
+	 * request bounced back to the caller must stay untouched.
+	 */
+	if (rctx->mode & FLAGS_XTS) {
+		crypto_cipher_encrypt_one(ctx->xts_tweak, rctx->tweak,
+					  req->info);
+		omap_aes_xts_whiten(rctx, req->src, req->dst, req->nbytes);
+		dd->in_sg = req->dst;
+	}
+
 	if (omap_aes_check_aligned(dd->in_sg, dd->total) ||
 	    omap_aes_check_aligned(dd->out_sg, dd->total)) {
 		if (omap_aes_copy_sgs(dd))
@@ -513,25 +562,21 @@ static int omap_aes_handle_queue(struct omap_aes_dev *dd,
 	dd->out_sg_len = scatterwalk_bytes_sglen(dd->out_sg, len);
 	BUG_ON(dd->in_sg_len < 0 || dd->out_sg_len < 0);
 
-	rctx = ablkcipher_request_ctx(req);
-	ctx = crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
 	rctx->mode &= FLAGS_MODE_MASK;
 	dd->flags = (dd->flags & ~FLAGS_MODE_MASK) | rctx->mode;
 
 	dd->ctx = ctx;
 	ctx->dd = dd;
 
-	err = omap_aes_write_ctrl(dd);
+	return omap_aes_write_ctrl(dd);
+}
 
-	if (!err)
-		err = omap_aes_crypt_dma_start(dd);
-	if (err) {
-		/* aes_task will not finish it, so do it here */
-		omap_aes_finish_req(dd, err);
-		tasklet_schedule(&dd->queue_task);
-	}
+static int omap_aes_crypt_req(struct crypto_engine *engine,
+			      struct crypto_async_request *areq)
+{
+	struct omap_aes_dev *dd = dev_get_drvdata(engine->priv_data);
 
-	return ret; /* return ret, which is enqueue return value */
+	return omap_aes_crypt_dma_start(dd);
 }
 
 static void omap_aes_done_task(unsigned long data)
@@ -563,41 +608,73 @@ static void omap_aes_done_task(unsigned long data)
 		free_pages((unsigned long)buf_out, pages);
 	}
 
+	if (dd->flags & FLAGS_XTS)
+		omap_aes_xts_whiten(ablkcipher_request_ctx(dd->req),
+				    dd->req->dst, dd->req->dst, dd->total_save);
+
 	omap_aes_finish_req(dd, 0);
-	omap_aes_handle_queue(dd, NULL);
 
 	pr_debug("exit\n");
 }
 
-static void omap_aes_queue_task(unsigned long data)
-{
-	struct omap_aes_dev *dd = (struct omap_aes_dev *)data;
-
-	omap_aes_handle_queue(dd, NULL);
-}
-
 static int omap_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 {
 	struct omap_aes_ctx *ctx = crypto_ablkcipher_ctx(
 			crypto_ablkcipher_reqtfm(req));
 	struct omap_aes_reqctx *rctx = ablkcipher_request_ctx(req);
 	struct omap_aes_dev *dd;
+	int ret;
 
 	pr_debug("nbytes: %d, enc: %d, cbc: %d\n", req->nbytes,
 		  !!(mode & FLAGS_ENCRYPT),
 		  !!(mode & FLAGS_CBC));
 
 	dd = omap_aes_find_dev(ctx);
+
+	if (req->nbytes < aes_fallback_sz ||
+	    (dd && aes_hw_depth &&
+	     READ_ONCE(dd->engine->queue.qlen) >= aes_hw_depth)) {
+		struct crypto_tfm *tfm = req->base.tfm;
+
+		ablkcipher_request_set_tfm(req, ctx->fallback);
+		if (mode & FLAGS_ENCRYPT)
+			ret = crypto_ablkcipher_encrypt(req);
+		else
+			ret = crypto_ablkcipher_decrypt(req);
+		ablkcipher_request_set_tfm(req, __crypto_ablkcipher_cast(tfm));
+		return ret;
+	}
+
 	if (!dd)
 		return -ENODEV;
 
 	rctx->mode = mode;
 
-	return omap_aes_handle_queue(dd, req);
+	return crypto_transfer_request_to_engine(dd->engine, &req->base);
 }
 
 /* ********************** ALG API ************************************ */
 
+static int omap_aes_fallback_setkey(struct crypto_ablkcipher *tfm,
+				    const u8 *key, unsigned int keylen)
+{
+	struct omap_aes_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	int ret;
+
+	ctx->fallback->base.crt_flags &= ~CRYPTO_TFM_REQ_MASK;
+	ctx->fallback->base.crt_flags |=
+		(tfm->base.crt_flags & CRYPTO_TFM_REQ_MASK);
+
+	ret = crypto_ablkcipher_setkey(ctx->fallback, key, keylen);
+	if (ret) {
+		tfm->base.crt_flags &= ~CRYPTO_TFM_RES_MASK;
+		tfm->base.crt_flags |=
+			(ctx->fallback->base.crt_flags & CRYPTO_TFM_RES_MASK);
+	}
+
+	return ret;
+}
+
 static int omap_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 			   unsigned int keylen)
 {
@@ -612,7 +689,37 @@ static int omap_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 	memcpy(ctx->key, key, keylen);
 	ctx->keylen = keylen;
 
-	return 0;
+	return omap_aes_fallback_setkey(tfm, key, keylen);
+}
+
+/*
+ * The first half of an XTS key is the data key, loaded into the engine,
+ * the second half only encrypts the tweak.
+ */
+static int omap_aes_xts_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
+			       unsigned int keylen)
+{
+	struct omap_aes_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	unsigned int half = keylen / 2;
+	int ret;
+
+	if ((keylen & 1) || (half != AES_KEYSIZE_128 &&
+			     half != AES_KEYSIZE_192 &&
+			     half != AES_KEYSIZE_256)) {
+		crypto_ablkcipher_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+
+	pr_debug("enter, keylen: %d\n", keylen);
+
+	memcpy(ctx->key, key, half);
+	ctx->keylen = half;
+
+	ret = crypto_cipher_setkey(ctx->xts_tweak, key + half, half);
+	if (ret)
+		return ret;
+
+	return omap_aes_fallback_setkey(tfm, key, keylen);
 }
 
 static int omap_aes_ecb_encrypt(struct ablkcipher_request *req)
@@ -645,27 +752,57 @@ static int omap_aes_ctr_decrypt(struct ablkcipher_request *req)
 	return omap_aes_crypt(req, FLAGS_CTR);
 }
 
+static int omap_aes_xts_encrypt(struct ablkcipher_request *req)
+{
+	if (!IS_ALIGNED(req->nbytes, AES_BLOCK_SIZE))
+		return -EINVAL;
+	return omap_aes_crypt(req, FLAGS_ENCRYPT | FLAGS_XTS);
+}
+
+static int omap_aes_xts_decrypt(struct ablkcipher_request *req)
+{
+	if (!IS_ALIGNED(req->nbytes, AES_BLOCK_SIZE))
+		return -EINVAL;
+	return omap_aes_crypt(req, FLAGS_XTS);
+}
+
 static int omap_aes_cra_init(struct crypto_tfm *tfm)
 {
+	const char *name = crypto_tfm_alg_name(tfm);
+	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
 	struct omap_aes_dev *dd = NULL;
 	int err;
 
+	/* only synchronous implementations, so the fallback runs inline */
+	ctx->fallback = crypto_alloc_ablkcipher(name, 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		pr_err("Error allocating fallback algo %s\n", name);
+		return PTR_ERR(ctx->fallback);
+	}
+
 	list_for_each_entry(dd, &dev_list, list) {
 		err = pm_runtime_get_sync(dd->dev);
 		if (err < 0) {
 			dev_err(dd->dev, "%s: failed to get_sync(%d)\n",
 				__func__, err);
+			crypto_free_ablkcipher(ctx->fallback);
+			ctx->fallback = NULL;
 			return err;
 		}
 	}
 
-	tfm->crt_ablkcipher.reqsize = sizeof(struct omap_aes_reqctx);
+	tfm->crt_ablkcipher.reqsize = max(sizeof(struct omap_aes_reqctx),
+			(size_t)crypto_ablkcipher_reqsize(ctx->fallback));
 
 	return 0;
 }
 
+static void omap_aes_cra_exit(struct crypto_tfm *tfm);
+
 static int omap_aes_gcm_cra_init(struct crypto_tfm *tfm)
 {
+	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
 	struct omap_aes_dev *dd = NULL;
 	int err;
 
@@ -680,17 +817,58 @@ static int omap_aes_gcm_cra_init(struct crypto_tfm *tfm)
 
 	tfm->crt_aead.reqsize = sizeof(struct omap_aes_reqctx);
 
+	ctx->gcm_cipher = crypto_alloc_cipher("aes", 0, 0);
+	if (IS_ERR(ctx->gcm_cipher)) {
+		err = PTR_ERR(ctx->gcm_cipher);
+		ctx->gcm_cipher = NULL;
+		omap_aes_cra_exit(tfm);
+		return err;
+	}
+
+	return 0;
+}
+
+static int omap_aes_xts_cra_init(struct crypto_tfm *tfm)
+{
+	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+	int err;
+
+	err = omap_aes_cra_init(tfm);
+	if (err)
+		return err;
+
+	ctx->xts_tweak = crypto_alloc_cipher("aes", 0, 0);
+	if (IS_ERR(ctx->xts_tweak)) {
+		err = PTR_ERR(ctx->xts_tweak);
+		ctx->xts_tweak = NULL;
+		omap_aes_cra_exit(tfm);
+		return err;
+	}
+
 	return 0;
 }
 
 static void omap_aes_cra_exit(struct crypto_tfm *tfm)
 {
+	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
 	struct omap_aes_dev *dd = NULL;
 
 	list_for_each_entry(dd, &dev_list, list) {
 		pm_runtime_put_sync(dd->dev);
 	}
 
+	if (ctx->fallback)
+		crypto_free_ablkcipher(ctx->fallback);
+	ctx->fallback = NULL;
+
+	if (ctx->xts_tweak)
+		crypto_free_cipher(ctx->xts_tweak);
+	ctx->xts_tweak = NULL;
+
+	if (ctx->gcm_cipher)
+		crypto_free_cipher(ctx->gcm_cipher);
+	ctx->gcm_cipher = NULL;
+
 }
 
 /* ********************** ALGS ************************************ */
@@ -702,7 +880,8 @@ static struct crypto_alg algs_ecb_cbc[] = {
 	.cra_priority		= 100,
 	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
 				  CRYPTO_ALG_KERN_DRIVER_ONLY |
-				  CRYPTO_ALG_ASYNC,
+				  CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
 	.cra_blocksize		= AES_BLOCK_SIZE,
 	.cra_ctxsize		= sizeof(struct omap_aes_ctx),
 	.cra_alignmask		= 0,
@@ -724,7 +903,8 @@ static struct crypto_alg algs_ecb_cbc[] = {
 	.cra_priority		= 100,
 	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
 				  CRYPTO_ALG_KERN_DRIVER_ONLY |
-				  CRYPTO_ALG_ASYNC,
+				  CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
 	.cra_blocksize		= AES_BLOCK_SIZE,
 	.cra_ctxsize		= sizeof(struct omap_aes_ctx),
 	.cra_alignmask		= 0,
@@ -740,6 +920,31 @@ static struct crypto_alg algs_ecb_cbc[] = {
 		.encrypt	= omap_aes_cbc_encrypt,
 		.decrypt	= omap_aes_cbc_decrypt,
 	}
+},
+{
+	.cra_name		= "xts(aes)",
+	.cra_driver_name	= "xts-aes-omap",
+	/* above the NEON bit-sliced xts(aes), dm-crypt should pick us */
+	.cra_priority		= 400,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
+				  CRYPTO_ALG_KERN_DRIVER_ONLY |
+				  CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct omap_aes_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_ablkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= omap_aes_xts_cra_init,
+	.cra_exit		= omap_aes_cra_exit,
+	.cra_u.ablkcipher = {
+		.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+		.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+		.ivsize		= AES_BLOCK_SIZE,
+		.setkey		= omap_aes_xts_setkey,
+		.encrypt	= omap_aes_xts_encrypt,
+		.decrypt	= omap_aes_xts_decrypt,
+	}
 }
 };
 
@@ -750,7 +955,8 @@ static struct crypto_alg algs_ctr[] = {
 	.cra_priority		= 100,
 	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
 				  CRYPTO_ALG_KERN_DRIVER_ONLY |
-				  CRYPTO_ALG_ASYNC,
+				  CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
 	.cra_blocksize		= AES_BLOCK_SIZE,
 	.cra_ctxsize		= sizeof(struct omap_aes_ctx),
 	.cra_alignmask		= 0,
@@ -1101,10 +1307,6 @@ static int omap_aes_probe(struct platform_device *pdev)
 	dd->dev = dev;
 	platform_set_drvdata(pdev, dd);
 
-	spin_lock_init(&dd->lock);
-	crypto_init_queue(&dd->queue, OMAP_AES_QUEUE_LENGTH);
-	crypto_init_queue(&dd->aead_queue, OMAP_AES_QUEUE_LENGTH);
-
 	err = (dev->of_node) ? omap_aes_get_res_of(dd, dev, &res) :
 			       omap_aes_get_res_pdev(dd, pdev, &res);
 	if (err)
@@ -1135,8 +1337,19 @@ static int omap_aes_probe(struct platform_device *pdev)
 		 (reg & dd->pdata->major_mask) >> dd->pdata->major_shift,
 		 (reg & dd->pdata->minor_mask) >> dd->pdata->minor_shift);
 
+	dd->engine = crypto_engine_alloc_init(dev, 1);
+	if (!dd->engine) {
+		err = -ENOMEM;
+		goto err_engine;
+	}
+
+	dd->engine->prepare_request = omap_aes_prepare_req;
+	dd->engine->do_one_request = omap_aes_crypt_req;
+	err = crypto_engine_start(dd->engine);
+	if (err)
+		goto err_irq;
+
 	tasklet_init(&dd->done_task, omap_aes_done_task, (unsigned long)dd);
-	tasklet_init(&dd->queue_task, omap_aes_queue_task, (unsigned long)dd);
 
 	err = omap_aes_dma_init(dd);
 	if (err && AES_REG_IRQ_STATUS(dd) && AES_REG_IRQ_ENABLE(dd)) {
@@ -1189,7 +1402,8 @@ err_algs:
 		omap_aes_dma_cleanup(dd);
 err_irq:
 	tasklet_kill(&dd->done_task);
-	tasklet_kill(&dd->queue_task);
+	crypto_engine_exit(dd->engine);
+err_engine:
 	pm_runtime_disable(dev);
 err_res:
 	dd = NULL;
@@ -1215,8 +1429,8 @@ static int omap_aes_remove(struct platform_device *pdev)
 			crypto_unregister_alg(
 					&dd->pdata->algs_info[i].algs_list[j]);
 
+	crypto_engine_exit(dd->engine);
 	tasklet_kill(&dd->done_task);
-	tasklet_kill(&dd->queue_task);
 	omap_aes_dma_cleanup(dd);
 	pm_runtime_disable(dd->dev);
 	dd = NULL;
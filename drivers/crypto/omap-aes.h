@@ -68,7 +68,7 @@
 #define AES_REG_IRQ_DATA_OUT           BIT(2)
 #define DEFAULT_TIMEOUT		(5 * HZ)
 
-#define FLAGS_MODE_MASK		0x001f
+#define FLAGS_MODE_MASK		0x011f
 #define FLAGS_ENCRYPT		BIT(0)
 #define FLAGS_CBC		BIT(1)
 #define FLAGS_GIV		BIT(2)
@@ -77,7 +77,7 @@
 
 #define FLAGS_INIT		BIT(5)
 #define FLAGS_FAST		BIT(6)
-#define FLAGS_BUSY		BIT(7)
+#define FLAGS_XTS		BIT(8)
 
 #define AES_ASSOC_DATA_COPIED	BIT(0)
 #define AES_IN_DATA_COPIED	BIT(1)
@@ -85,26 +85,27 @@
 
 #define AES_BLOCK_WORDS		(AES_BLOCK_SIZE >> 2)
 
-struct tcrypt_result {
-	struct completion completion;
-	int err;
-};
-
 struct omap_aes_ctx {
 	struct omap_aes_dev *dd;
 
 	int		keylen;
 	u32		key[AES_KEYSIZE_256 / sizeof(u32)];
-	u32		auth_tag[AES_BLOCK_SIZE / sizeof(u32)];
+	/* rfc4106 salt, in the first four bytes */
 	u8		iv[AES_BLOCK_SIZE];
 	unsigned long	flags;
+	struct crypto_ablkcipher	*fallback;
+	struct crypto_cipher		*xts_tweak;
+	struct crypto_cipher		*gcm_cipher;
 };
 
 struct omap_aes_reqctx {
 	unsigned long mode;
+	u8 tweak[AES_BLOCK_SIZE];
+	/* GCM: per request, as several may be queued on one tfm */
+	u8 iv[AES_BLOCK_SIZE];
+	u32 auth_tag[AES_BLOCK_SIZE / sizeof(u32)];
 };
 
-#define OMAP_AES_QUEUE_LENGTH	1
 #define OMAP_AES_CACHE_SIZE	0
 
 struct omap_aes_algs_info {
@@ -147,13 +148,8 @@ struct omap_aes_dev {
 	unsigned long		flags;
 	int			err;
 
-	/* Lock to acquire omap_aes_dd */
-	spinlock_t		lock;
-	struct crypto_queue	queue;
-	struct crypto_queue	aead_queue;
-
 	struct tasklet_struct	done_task;
-	struct tasklet_struct	queue_task;
+	struct crypto_engine	*engine;
 
 	struct ablkcipher_request	*req;
 	struct aead_request		*aead_req;
@@ -202,6 +198,7 @@ int omap_aes_gcm_encrypt(struct aead_request *req);
 int omap_aes_gcm_decrypt(struct aead_request *req);
 int omap_aes_4106gcm_encrypt(struct aead_request *req);
 int omap_aes_4106gcm_decrypt(struct aead_request *req);
+int omap_aes_gcm_prepare_req(struct omap_aes_dev *dd, struct aead_request *req);
 int omap_aes_write_ctrl(struct omap_aes_dev *dd);
 int omap_aes_check_aligned(struct scatterlist *sg, int total);
 int omap_aes_crypt_dma_start(struct omap_aes_dev *dd);
@@ -39,6 +39,7 @@
 #include <linux/interrupt.h>
 #include <crypto/scatterwalk.h>
 #include <crypto/des.h>
+#include <crypto/engine.h>
 
 #define DST_MAXBURST			2
 
@@ -75,7 +76,6 @@
 #define FLAGS_ENCRYPT		BIT(0)
 #define FLAGS_CBC		BIT(1)
 #define FLAGS_INIT		BIT(4)
-#define FLAGS_BUSY		BIT(6)
 
 struct omap_des_ctx {
 	struct omap_des_dev *dd;
@@ -89,7 +89,6 @@ struct omap_des_reqctx {
 	unsigned long mode;
 };
 
-#define OMAP_DES_QUEUE_LENGTH	1
 #define OMAP_DES_CACHE_SIZE	0
 
 struct omap_des_algs_info {
@@ -123,6 +122,18 @@ struct omap_des_pdata {
 	u32		minor_shift;
 };
 
+/*
+ * One direction of a request as handed to the DMA, when the caller's
+ * scatterlist can't be used as is.  Word aligned runs of whole blocks
+ * still point at the caller's pages; only the blocks around misaligned
+ * entries go through @buf.
+ */
+struct omap_des_sgbuf {
+	struct scatterlist	*sg;
+	void			*buf;
+	size_t			buflen;
+};
+
 struct omap_des_dev {
 	struct list_head	list;
 	unsigned long		phys_base;
@@ -132,27 +143,19 @@ struct omap_des_dev {
 	unsigned long		flags;
 	int			err;
 
-	/* spinlock used for queues */
-	spinlock_t		lock;
-	struct crypto_queue	queue;
-
 	struct tasklet_struct	done_task;
-	struct tasklet_struct	queue_task;
+	struct crypto_engine	*engine;
 
 	struct ablkcipher_request	*req;
-	/*
-	 * total is used by PIO mode for book keeping so introduce
-	 * variable total_save as need it to calc page_order
-	 */
+	/* total is used by PIO mode for book keeping */
 	size_t                          total;
-	size_t                          total_save;
 
 	struct scatterlist		*in_sg;
 	struct scatterlist		*out_sg;
 
-	/* Buffers for copying for unaligned cases */
-	struct scatterlist		in_sgl;
-	struct scatterlist		out_sgl;
+	/* DMA views of the request for unaligned cases */
+	struct omap_des_sgbuf		in_sb;
+	struct omap_des_sgbuf		out_sb;
 	struct scatterlist		*orig_out;
 	int				sgs_copied;
 
@@ -223,20 +226,6 @@ static void omap_des_write_n(struct omap_des_dev *dd, u32 offset,
 
 static int omap_des_hw_init(struct omap_des_dev *dd)
 {
-	int err;
-
-	/*
-	 * clocks are enabled when request starts and disabled when finished.
-	 * It may be long delays between requests.
-	 * Device might go to off mode to save power.
-	 */
-	err = pm_runtime_get_sync(dd->dev);
-	if (err < 0) {
-		pm_runtime_put_noidle(dd->dev);
-		dev_err(dd->dev, "%s: failed to get_sync(%d)\n", __func__, err);
-		return err;
-	}
-
 	if (!(dd->flags & FLAGS_INIT)) {
 		dd->flags |= FLAGS_INIT;
 		dd->err = 0;
@@ -519,10 +508,7 @@ static void omap_des_finish_req(struct omap_des_dev *dd, int err)
 
 	pr_debug("err: %d\n", err);
 
-	pm_runtime_put(dd->dev);
-	dd->flags &= ~FLAGS_BUSY;
-
-	req->base.complete(&req->base, err);
+	crypto_finalize_request(dd->engine, &req->base, err);
 }
 
 static int omap_des_crypt_dma_stop(struct omap_des_dev *dd)
@@ -551,85 +537,199 @@ static int omap_des_copy_needed(struct scatterlist *sg)
 	return 0;
 }
 
-static int omap_des_copy_sgs(struct omap_des_dev *dd)
+/*
+ * Split the first @total bytes of @sg into DMA entries: word aligned runs
+ * of whole blocks are used in place, anything else is taken one block at
+ * a time into the bounce buffer @buf, merging neighbouring bounce blocks
+ * into one entry.  Since every entry is a multiple of the block size, a
+ * misaligned entry costs at most a block at either end of it, unless it
+ * is misaligned in its start address.
+ *
+ * With @tbl NULL only the entries and bounce bytes are counted.
+ */
+static int omap_des_split_sg(struct scatterlist *sg, size_t total,
+			     struct scatterlist *tbl, void *buf,
+			     size_t *buflen)
 {
-	void *buf_in, *buf_out;
-	int pages;
+	unsigned int off = 0, nents = 0;
+	bool bounce = false;
+	size_t len, nb = 0;
+
+	while (total) {
+		len = min_t(size_t, sg->length - off, total);
+
+		if (IS_ALIGNED(sg->offset + off, 4) && len >= DES_BLOCK_SIZE) {
+			len = round_down(len, DES_BLOCK_SIZE);
+			if (tbl)
+				sg_set_page(tbl + nents, sg_page(sg), len,
+					    sg->offset + off);
+			nents++;
+			bounce = false;
+		} else {
+			len = DES_BLOCK_SIZE;
+			if (bounce) {
+				if (tbl)
+					tbl[nents - 1].length += len;
+			} else {
+				if (tbl)
+					sg_set_buf(tbl + nents, buf + nb, len);
+				nents++;
+				bounce = true;
+			}
+			nb += len;
+		}
 
-	pages = dd->total >> PAGE_SHIFT;
+		total -= len;
+		off += len;
+		while (total && off >= sg->length) {
+			off -= sg->length;
+			sg = sg_next(sg);
+		}
+	}
 
-	if (dd->total & (PAGE_SIZE-1))
-		pages++;
+	*buflen = nb;
+	return nents;
+}
 
-	BUG_ON(!pages);
+static void omap_des_sgbuf_free(struct omap_des_sgbuf *sb)
+{
+	kfree(sb->buf);
+	kfree(sb->sg);
+	sb->buf = NULL;
+	sb->sg = NULL;
+}
 
-	buf_in = (void *)__get_free_pages(GFP_ATOMIC, pages);
-	buf_out = (void *)__get_free_pages(GFP_ATOMIC, pages);
+static int omap_des_sgbuf_init(struct omap_des_sgbuf *sb,
+			       struct scatterlist *sg, size_t total)
+{
+	int nents;
 
-	if (!buf_in || !buf_out) {
-		pr_err("Couldn't allocated pages for unaligned cases.\n");
-		return -1;
+	nents = omap_des_split_sg(sg, total, NULL, NULL, &sb->buflen);
+
+	sb->sg = kmalloc_array(nents, sizeof(*sb->sg), GFP_ATOMIC);
+	sb->buf = sb->buflen ? kmalloc(sb->buflen, GFP_ATOMIC) : NULL;
+	if (!sb->sg || (sb->buflen && !sb->buf)) {
+		omap_des_sgbuf_free(sb);
+		return -ENOMEM;
 	}
 
-	dd->orig_out = dd->out_sg;
+	sg_init_table(sb->sg, nents);
+	omap_des_split_sg(sg, total, sb->sg, sb->buf, &sb->buflen);
+
+	return 0;
+}
+
+/* copy the bounced blocks of @sb from (@out clear) or to @orig */
+static void omap_des_sgbuf_copy(struct omap_des_sgbuf *sb,
+				struct scatterlist *orig, int out)
+{
+	struct scatterlist *sg;
+	unsigned int pos = 0;
+	void *p;
+
+	if (!sb->buflen)
+		return;
+
+	for (sg = sb->sg; sg; sg = sg_next(sg)) {
+		p = sg_virt(sg);
+		if (p >= sb->buf && p < sb->buf + sb->buflen)
+			sg_copy_buf(p, orig, pos, sg->length, out);
+		pos += sg->length;
+	}
+}
+
+static int omap_des_copy_sgs(struct omap_des_dev *dd)
+{
+	int err;
+
+	err = omap_des_sgbuf_init(&dd->in_sb, dd->in_sg, dd->total);
+	if (err)
+		return err;
+
+	err = omap_des_sgbuf_init(&dd->out_sb, dd->out_sg, dd->total);
+	if (err) {
+		omap_des_sgbuf_free(&dd->in_sb);
+		return err;
+	}
 
-	sg_copy_buf(buf_in, dd->in_sg, 0, dd->total, 0);
+	dd->orig_out = dd->out_sg;
 
-	sg_init_table(&dd->in_sgl, 1);
-	sg_set_buf(&dd->in_sgl, buf_in, dd->total);
-	dd->in_sg = &dd->in_sgl;
+	omap_des_sgbuf_copy(&dd->in_sb, dd->in_sg, 0);
 
-	sg_init_table(&dd->out_sgl, 1);
-	sg_set_buf(&dd->out_sgl, buf_out, dd->total);
-	dd->out_sg = &dd->out_sgl;
+	dd->in_sg = dd->in_sb.sg;
+	dd->out_sg = dd->out_sb.sg;
 
 	return 0;
 }
 
-static int omap_des_handle_queue(struct omap_des_dev *dd,
-			       struct ablkcipher_request *req)
+/*
+ * Clocks are enabled when the engine starts on a run of requests and
+ * disabled once its queue drains, rather than around every request.
+ * There may be long delays between runs, and the device might go to
+ * off mode to save power in between.
+ */
+static int omap_des_prepare_hw(struct crypto_engine *engine)
 {
-	struct crypto_async_request *async_req, *backlog;
-	struct omap_des_ctx *ctx;
-	struct omap_des_reqctx *rctx;
-	unsigned long flags;
-	int err, ret = 0;
-
-	spin_lock_irqsave(&dd->lock, flags);
-	if (req)
-		ret = ablkcipher_enqueue_request(&dd->queue, req);
-	if (dd->flags & FLAGS_BUSY) {
-		spin_unlock_irqrestore(&dd->lock, flags);
-		return ret;
+	struct omap_des_dev *dd = dev_get_drvdata(engine->priv_data);
+	int err;
+
+	err = pm_runtime_get_sync(dd->dev);
+	if (err < 0) {
+		pm_runtime_put_noidle(dd->dev);
+		dev_err(dd->dev, "%s: failed to get_sync(%d)\n", __func__, err);
+		return err;
 	}
-	backlog = crypto_get_backlog(&dd->queue);
-	async_req = crypto_dequeue_request(&dd->queue);
-	if (async_req)
-		dd->flags |= FLAGS_BUSY;
-	spin_unlock_irqrestore(&dd->lock, flags);
 
-	if (!async_req)
-		return ret;
+	return 0;
+}
 
-	if (backlog)
-		backlog->complete(backlog, -EINPROGRESS);
+static int omap_des_unprepare_hw(struct crypto_engine *engine)
+{
+	struct omap_des_dev *dd = dev_get_drvdata(engine->priv_data);
 
-	req = ablkcipher_request_cast(async_req);
+	pm_runtime_put(dd->dev);
+
+	return 0;
+}
+
+static int omap_des_unprepare_req(struct crypto_engine *engine,
+				  struct crypto_async_request *areq)
+{
+	struct omap_des_dev *dd = dev_get_drvdata(engine->priv_data);
+
+	if (dd->sgs_copied) {
+		omap_des_sgbuf_free(&dd->in_sb);
+		omap_des_sgbuf_free(&dd->out_sb);
+		dd->sgs_copied = 0;
+	}
+
+	return 0;
+}
+
+static int omap_des_prepare_req(struct crypto_engine *engine,
+				struct crypto_async_request *areq)
+{
+	struct omap_des_dev *dd = dev_get_drvdata(engine->priv_data);
+	struct ablkcipher_request *req = ablkcipher_request_cast(areq);
+	struct omap_des_ctx *ctx;
+	struct omap_des_reqctx *rctx;
+	int err;
 
 	/* assign new request to device */
 	dd->req = req;
 	dd->total = req->nbytes;
-	dd->total_save = req->nbytes;
 	dd->in_sg = req->src;
 	dd->out_sg = req->dst;
 
+	dd->sgs_copied = 0;
 	if (omap_des_copy_needed(dd->in_sg) ||
 	    omap_des_copy_needed(dd->out_sg)) {
-		if (omap_des_copy_sgs(dd))
+		err = omap_des_copy_sgs(dd);
+		if (err) {
 			pr_err("Failed to copy SGs for unaligned cases\n");
+			return err;
+		}
 		dd->sgs_copied = 1;
-	} else {
-		dd->sgs_copied = 0;
 	}
 
 	dd->in_sg_len = scatterwalk_bytes_sglen(dd->in_sg, dd->total);
@@ -645,22 +745,23 @@ static int omap_des_handle_queue(struct omap_des_dev *dd,
 	ctx->dd = dd;
 
 	err = omap_des_write_ctrl(dd);
-	if (!err)
-		err = omap_des_crypt_dma_start(dd);
-	if (err) {
-		/* des_task will not finish it, so do it here */
-		omap_des_finish_req(dd, err);
-		tasklet_schedule(&dd->queue_task);
-	}
+	if (err)
+		omap_des_unprepare_req(engine, areq);
 
-	return ret; /* return ret, which is enqueue return value */
+	return err;
+}
+
+static int omap_des_crypt_req(struct crypto_engine *engine,
+			      struct crypto_async_request *areq)
+{
+	struct omap_des_dev *dd = dev_get_drvdata(engine->priv_data);
+
+	return omap_des_crypt_dma_start(dd);
 }
 
 static void omap_des_done_task(unsigned long data)
 {
 	struct omap_des_dev *dd = (struct omap_des_dev *)data;
-	void *buf_in, *buf_out;
-	int pages;
 
 	pr_debug("enter done_task\n");
 
@@ -673,30 +774,15 @@ static void omap_des_done_task(unsigned long data)
 		omap_des_crypt_dma_stop(dd);
 	}
 
-	if (dd->sgs_copied) {
-		buf_in = sg_virt(&dd->in_sgl);
-		buf_out = sg_virt(&dd->out_sgl);
-
-		sg_copy_buf(buf_out, dd->orig_out, 0, dd->total_save, 1);
-
-		pages = get_order(dd->total_save);
-		free_pages((unsigned long)buf_in, pages);
-		free_pages((unsigned long)buf_out, pages);
-	}
+	/* the bounce buffers themselves go in omap_des_unprepare_req() */
+	if (dd->sgs_copied)
+		omap_des_sgbuf_copy(&dd->out_sb, dd->orig_out, 1);
 
 	omap_des_finish_req(dd, 0);
-	omap_des_handle_queue(dd, NULL);
 
 	pr_debug("exit\n");
 }
 
-static void omap_des_queue_task(unsigned long data)
-{
-	struct omap_des_dev *dd = (struct omap_des_dev *)data;
-
-	omap_des_handle_queue(dd, NULL);
-}
-
 static int omap_des_crypt(struct ablkcipher_request *req, unsigned long mode)
 {
 	struct omap_des_ctx *ctx = crypto_ablkcipher_ctx(
@@ -719,7 +805,7 @@ static int omap_des_crypt(struct ablkcipher_request *req, unsigned long mode)
 
 	rctx->mode = mode;
 
-	return omap_des_handle_queue(dd, req);
+	return crypto_transfer_request_to_engine(dd->engine, &req->base);
 }
 
 /* ********************** ALG API ************************************ */
@@ -1064,9 +1150,6 @@ static int omap_des_probe(struct platform_device *pdev)
 	dd->dev = dev;
 	platform_set_drvdata(pdev, dd);
 
-	spin_lock_init(&dd->lock);
-	crypto_init_queue(&dd->queue, OMAP_DES_QUEUE_LENGTH);
-
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (!res) {
 		dev_err(dev, "no MEM resource info\n");
@@ -1103,8 +1186,22 @@ static int omap_des_probe(struct platform_device *pdev)
 		 (reg & dd->pdata->major_mask) >> dd->pdata->major_shift,
 		 (reg & dd->pdata->minor_mask) >> dd->pdata->minor_shift);
 
+	dd->engine = crypto_engine_alloc_init(dev, 1);
+	if (!dd->engine) {
+		err = -ENOMEM;
+		goto err_get;
+	}
+
+	dd->engine->prepare_crypt_hardware = omap_des_prepare_hw;
+	dd->engine->unprepare_crypt_hardware = omap_des_unprepare_hw;
+	dd->engine->prepare_request = omap_des_prepare_req;
+	dd->engine->unprepare_request = omap_des_unprepare_req;
+	dd->engine->do_one_request = omap_des_crypt_req;
+	err = crypto_engine_start(dd->engine);
+	if (err)
+		goto err_irq;
+
 	tasklet_init(&dd->done_task, omap_des_done_task, (unsigned long)dd);
-	tasklet_init(&dd->queue_task, omap_des_queue_task, (unsigned long)dd);
 
 	err = omap_des_dma_init(dd);
 	if (err && DES_REG_IRQ_STATUS(dd) && DES_REG_IRQ_ENABLE(dd)) {
@@ -1155,7 +1252,7 @@ err_algs:
 		omap_des_dma_cleanup(dd);
 err_irq:
 	tasklet_kill(&dd->done_task);
-	tasklet_kill(&dd->queue_task);
+	crypto_engine_exit(dd->engine);
 err_get:
 	pm_runtime_disable(dev);
 err_res:
@@ -1182,8 +1279,8 @@ static int omap_des_remove(struct platform_device *pdev)
 			crypto_unregister_alg(
 					&dd->pdata->algs_info[i].algs_list[j]);
 
+	crypto_engine_exit(dd->engine);
 	tasklet_kill(&dd->done_task);
-	tasklet_kill(&dd->queue_task);
 	omap_des_dma_cleanup(dd);
 	pm_runtime_disable(dd->dev);
 	dd = NULL;
@@ -40,6 +40,7 @@
 #include <linux/cryptohash.h>
 #include <crypto/scatterwalk.h>
 #include <crypto/algapi.h>
+#include <crypto/engine.h>
 #include <crypto/sha.h>
 #include <crypto/hash.h>
 #include <crypto/internal/hash.h>
@@ -135,6 +136,9 @@
 
 #define BUFLEN			PAGE_SIZE
 
+/* sg entries chained into one DMA transfer */
+#define OMAP_SHAM_DMA_SG_MAX	16
+
 struct omap_sham_dev;
 
 struct omap_sham_reqctx {
@@ -150,7 +154,6 @@ struct omap_sham_reqctx {
 
 	/* walk state */
 	struct scatterlist	*sg;
-	struct scatterlist	sgl;
 	unsigned int		offset;	/* offset in current sg */
 	unsigned int		total;	/* total request */
 
@@ -174,7 +177,6 @@ struct omap_sham_ctx {
 	struct omap_sham_hmac_ctx base[0];
 };
 
-#define OMAP_SHAM_QUEUE_LENGTH	1
 
 struct omap_sham_algs_info {
 	struct ahash_alg	*algs_list;
@@ -217,7 +219,6 @@ struct omap_sham_dev {
 	struct device		*dev;
 	void __iomem		*io_base;
 	int			irq;
-	spinlock_t		lock;
 	int			err;
 	unsigned int		dma;
 	struct dma_chan		*dma_lch;
@@ -225,9 +226,13 @@ struct omap_sham_dev {
 	u8			polling_mode;
 
 	unsigned long		flags;
-	struct crypto_queue	queue;
+	struct crypto_engine	*engine;
 	struct ahash_request	*req;
 
+	/* request data in flight, see omap_sham_update_dma_start() */
+	struct scatterlist	sgl[OMAP_SHAM_DMA_SG_MAX];
+	int			sg_nents;
+
 	const struct omap_sham_pdata	*pdata;
 };
 
@@ -362,8 +367,6 @@ static void omap_sham_copy_ready_hash(struct ahash_request *req)
 
 static int omap_sham_hw_init(struct omap_sham_dev *dd)
 {
-	pm_runtime_get_sync(dd->dev);
-
 	if (!test_bit(FLAGS_INIT, &dd->flags)) {
 		set_bit(FLAGS_INIT, &dd->flags);
 		dd->err = 0;
@@ -550,7 +553,7 @@ static void omap_sham_dma_callback(void *param)
 }
 
 static int omap_sham_xmit_dma(struct omap_sham_dev *dd, dma_addr_t dma_addr,
-			      size_t length, int final, int is_sg)
+			      size_t length, int final, int nents)
 {
 	struct omap_sham_reqctx *ctx = ahash_request_ctx(dd->req);
 	struct dma_async_tx_descriptor *tx;
@@ -572,24 +575,11 @@ static int omap_sham_xmit_dma(struct omap_sham_dev *dd, dma_addr_t dma_addr,
 		return ret;
 	}
 
-	len32 = DIV_ROUND_UP(length, dma_min) * dma_min;
-
-	if (is_sg) {
-		/*
-		 * The SG entry passed in may not have the 'length' member
-		 * set correctly so use a local SG entry (sgl) with the
-		 * proper value for 'length' instead.  If this is not done,
-		 * the dmaengine may try to DMA the incorrect amount of data.
-		 */
-		sg_init_table(&ctx->sgl, 1);
-		ctx->sgl.page_link = ctx->sg->page_link;
-		ctx->sgl.offset = ctx->sg->offset;
-		sg_dma_len(&ctx->sgl) = len32;
-		sg_dma_address(&ctx->sgl) = sg_dma_address(ctx->sg);
-
-		tx = dmaengine_prep_slave_sg(dd->dma_lch, &ctx->sgl, 1,
+	if (nents) {
+		tx = dmaengine_prep_slave_sg(dd->dma_lch, dd->sgl, nents,
 			DMA_MEM_TO_DEV, DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
 	} else {
+		len32 = DIV_ROUND_UP(length, dma_min) * dma_min;
 		tx = dmaengine_prep_slave_single(dd->dma_lch, dma_addr, len32,
 			DMA_MEM_TO_DEV, DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
 	}
@@ -709,23 +699,75 @@ static int omap_sham_update_dma_slow(struct omap_sham_dev *dd)
 	return 0;
 }
 
-/* Start address alignment */
-#define SG_AA(sg)	(IS_ALIGNED(sg->offset, sizeof(u32)))
-/* SHA1 block size alignment */
-#define SG_SA(sg, bs)	(IS_ALIGNED(sg->length, bs))
+/*
+ * Top the buffer up to the next block boundary from the sg list and send
+ * it.  This costs a CPU copy of at most one block, after which the data
+ * is block aligned again and can go out by DMA straight from the sg list.
+ */
+static int omap_sham_update_dma_head(struct omap_sham_dev *dd)
+{
+	struct omap_sham_reqctx *ctx = ahash_request_ctx(dd->req);
+	size_t buflen = ctx->buflen, count;
+	unsigned int final;
+	int bs = get_block_size(ctx);
+
+	ctx->buflen = min(buflen, round_down(ctx->bufcnt, bs) + bs);
+	omap_sham_append_sg(ctx);
+	count = ctx->bufcnt;
+
+	final = (ctx->flags & BIT(FLAGS_FINUP)) && !ctx->total;
+
+	dev_dbg(dd->dev, "head: bufcnt: %u, digcnt: %d, final: %d\n",
+					 ctx->bufcnt, ctx->digcnt, final);
+
+	if (final || (count == ctx->buflen && ctx->total)) {
+		ctx->buflen = buflen;
+		ctx->bufcnt = 0;
+		return omap_sham_xmit_dma_map(dd, ctx, count, final);
+	}
+
+	ctx->buflen = buflen;
+
+	return 0;
+}
+
+static void omap_sham_walk_advance(struct omap_sham_reqctx *ctx,
+				   size_t count)
+{
+	size_t len;
 
+	while (ctx->sg && count) {
+		len = min_t(size_t, count, ctx->sg->length - ctx->offset);
+		ctx->offset += len;
+		count -= len;
+		if (ctx->offset == ctx->sg->length) {
+			ctx->sg = sg_next(ctx->sg);
+			ctx->offset = 0;
+		}
+	}
+}
+
+/*
+ * Send as much of the request as possible in one DMA transfer, chaining
+ * consecutive sg entries so that the engine does not go idle between
+ * them.  Only the walk position must be word aligned: an entry that does
+ * not end on a block boundary closes the chain, and the partial block it
+ * leaves is sent through omap_sham_update_dma_head() on the next round.
+ * Data that is not even word aligned is still bounced through
+ * ctx->buffer by omap_sham_update_dma_slow().
+ */
 static int omap_sham_update_dma_start(struct omap_sham_dev *dd)
 {
 	struct omap_sham_reqctx *ctx = ahash_request_ctx(dd->req);
-	unsigned int length, final, tail;
-	struct scatterlist *sg;
-	int ret, bs;
+	struct scatterlist *sg = ctx->sg;
+	unsigned int offset = ctx->offset;
+	unsigned int length = 0, len, final, tail;
+	int ret, bs, nents = 0;
 
 	if (!ctx->total)
 		return 0;
 
-	if (ctx->bufcnt || ctx->offset)
-		return omap_sham_update_dma_slow(dd);
+	bs = get_block_size(ctx);
 
 	/*
 	 * Don't use the sg interface when the transfer size is less
@@ -733,50 +775,82 @@ static int omap_sham_update_dma_start(struct omap_sham_dev *dd)
 	 * the dmaengine infrastructure will calculate that it needs
 	 * to transfer 0 frames which ultimately fails.
 	 */
-	if (ctx->total < get_block_size(ctx))
+	if (ctx->total < bs)
 		return omap_sham_update_dma_slow(dd);
 
+	if (!IS_ALIGNED(sg->offset + offset, sizeof(u32)))
+		return omap_sham_update_dma_slow(dd);
+
+	if (ctx->bufcnt || sg->length - offset < bs)
+		return omap_sham_update_dma_head(dd);
+
 	dev_dbg(dd->dev, "fast: digcnt: %d, bufcnt: %u, total: %u\n",
 			ctx->digcnt, ctx->bufcnt, ctx->total);
 
-	sg = ctx->sg;
-	bs = get_block_size(ctx);
+	/*
+	 * The sg entries passed in may not have 'length' set to what is
+	 * left of the request, so DMA from local entries with the proper
+	 * lengths instead.
+	 */
+	sg_init_table(dd->sgl, OMAP_SHAM_DMA_SG_MAX);
 
-	if (!SG_AA(sg))
-		return omap_sham_update_dma_slow(dd);
+	while (sg && nents < OMAP_SHAM_DMA_SG_MAX && length < ctx->total) {
+		if (!IS_ALIGNED(sg->offset + offset, sizeof(u32)))
+			break;
 
-	if (!sg_is_last(sg) && !SG_SA(sg, bs))
-		/* size is not BLOCK_SIZE aligned */
-		return omap_sham_update_dma_slow(dd);
+		len = min(ctx->total - length, sg->length - offset);
+		/* only the end of the request may be a partial block */
+		if (length + len < ctx->total)
+			len = round_down(len, bs);
+		if (!len)
+			break;
 
-	length = min(ctx->total, sg->length);
+		sg_set_page(&dd->sgl[nents++], sg_page(sg), len,
+			    sg->offset + offset);
+		length += len;
 
-	if (sg_is_last(sg)) {
-		if (!(ctx->flags & BIT(FLAGS_FINUP))) {
-			/* not last sg must be BLOCK_SIZE aligned */
-			tail = length & (bs - 1);
-			/* without finup() we need one block to close hash */
-			if (!tail)
-				tail = bs;
-			length -= tail;
-		}
+		if (offset + len < sg->length)
+			break;
+		sg = sg_next(sg);
+		offset = 0;
+	}
+
+	if (length == ctx->total && !(ctx->flags & BIT(FLAGS_FINUP))) {
+		/* without finup() we need one block to close hash */
+		tail = length & (bs - 1);
+		if (!tail)
+			tail = bs;
+		length -= tail;
+		dd->sgl[nents - 1].length -= tail;
+		if (!dd->sgl[nents - 1].length)
+			nents--;
 	}
 
-	if (!dma_map_sg(dd->dev, ctx->sg, 1, DMA_TO_DEVICE)) {
+	if (!nents)
+		return omap_sham_update_dma_slow(dd);
+
+	sg_mark_end(&dd->sgl[nents - 1]);
+
+	if (!dma_map_sg(dd->dev, dd->sgl, nents, DMA_TO_DEVICE)) {
 		dev_err(dd->dev, "dma_map_sg  error\n");
 		return -EINVAL;
 	}
 
+	/* see the DMA frame comment above */
+	sg_dma_len(&dd->sgl[nents - 1]) =
+		round_up(sg_dma_len(&dd->sgl[nents - 1]), bs);
+
+	dd->sg_nents = nents;
 	ctx->flags |= BIT(FLAGS_SG);
 
+	omap_sham_walk_advance(ctx, length);
 	ctx->total -= length;
-	ctx->offset = length; /* offset where to start slow */
 
 	final = (ctx->flags & BIT(FLAGS_FINUP)) && !ctx->total;
 
-	ret = omap_sham_xmit_dma(dd, sg_dma_address(ctx->sg), length, final, 1);
+	ret = omap_sham_xmit_dma(dd, 0, length, final, nents);
 	if (ret != -EINPROGRESS)
-		dma_unmap_sg(dd->dev, ctx->sg, 1, DMA_TO_DEVICE);
+		dma_unmap_sg(dd->dev, dd->sgl, nents, DMA_TO_DEVICE);
 
 	return ret;
 }
@@ -812,12 +886,7 @@ static int omap_sham_update_dma_stop(struct omap_sham_dev *dd)
 	dmaengine_terminate_all(dd->dma_lch);
 
 	if (ctx->flags & BIT(FLAGS_SG)) {
-		dma_unmap_sg(dd->dev, ctx->sg, 1, DMA_TO_DEVICE);
-		if (ctx->sg->length == ctx->offset) {
-			ctx->sg = sg_next(ctx->sg);
-			if (ctx->sg)
-				ctx->offset = 0;
-		}
+		dma_unmap_sg(dd->dev, dd->sgl, dd->sg_nents, DMA_TO_DEVICE);
 	} else {
 		dma_unmap_single(dd->dev, ctx->dma_addr, ctx->buflen,
 				 DMA_TO_DEVICE);
@@ -995,44 +1064,42 @@ static void omap_sham_finish_req(struct ahash_request *req, int err)
 	dd->flags &= ~(BIT(FLAGS_BUSY) | BIT(FLAGS_FINAL) | BIT(FLAGS_CPU) |
 			BIT(FLAGS_DMA_READY) | BIT(FLAGS_OUTPUT_READY));
 
-	pm_runtime_put(dd->dev);
+	/* completes the request and kicks the engine for the next one */
+	crypto_finalize_request(dd->engine, &req->base, err);
+}
 
-	if (req->base.complete)
-		req->base.complete(&req->base, err);
+/*
+ * The engine keeps the clocks on across a run of back to back requests,
+ * which saves a runtime PM cycle per hash update.
+ */
+static int omap_sham_prepare_hw(struct crypto_engine *engine)
+{
+	struct omap_sham_dev *dd = dev_get_drvdata(engine->priv_data);
 
-	/* handle new request */
-	tasklet_schedule(&dd->done_task);
+	pm_runtime_get_sync(dd->dev);
+
+	return 0;
 }
 
-static int omap_sham_handle_queue(struct omap_sham_dev *dd,
-				  struct ahash_request *req)
+static int omap_sham_unprepare_hw(struct crypto_engine *engine)
 {
-	struct crypto_async_request *async_req, *backlog;
-	struct omap_sham_reqctx *ctx;
-	unsigned long flags;
-	int err = 0, ret = 0;
-
-	spin_lock_irqsave(&dd->lock, flags);
-	if (req)
-		ret = ahash_enqueue_request(&dd->queue, req);
-	if (test_bit(FLAGS_BUSY, &dd->flags)) {
-		spin_unlock_irqrestore(&dd->lock, flags);
-		return ret;
-	}
-	backlog = crypto_get_backlog(&dd->queue);
-	async_req = crypto_dequeue_request(&dd->queue);
-	if (async_req)
-		set_bit(FLAGS_BUSY, &dd->flags);
-	spin_unlock_irqrestore(&dd->lock, flags);
+	struct omap_sham_dev *dd = dev_get_drvdata(engine->priv_data);
 
-	if (!async_req)
-		return ret;
+	pm_runtime_put(dd->dev);
 
-	if (backlog)
-		backlog->complete(backlog, -EINPROGRESS);
+	return 0;
+}
+
+static int omap_sham_hash_one_req(struct crypto_engine *engine,
+				  struct crypto_async_request *areq)
+{
+	struct omap_sham_dev *dd = dev_get_drvdata(engine->priv_data);
+	struct ahash_request *req = ahash_request_cast(areq);
+	struct omap_sham_reqctx *ctx;
+	int err;
 
-	req = ahash_request_cast(async_req);
 	dd->req = req;
+	set_bit(FLAGS_BUSY, &dd->flags);
 	ctx = ahash_request_ctx(req);
 
 	dev_dbg(dd->dev, "handling new req, op: %lu, nbytes: %d\n",
@@ -1061,7 +1128,7 @@ err1:
 
 	dev_dbg(dd->dev, "exit, err: %d\n", err);
 
-	return ret;
+	return 0;
 }
 
 static int omap_sham_enqueue(struct ahash_request *req, unsigned int op)
@@ -1072,7 +1139,7 @@ static int omap_sham_enqueue(struct ahash_request *req, unsigned int op)
 
 	ctx->op = op;
 
-	return omap_sham_handle_queue(dd, req);
+	return crypto_transfer_request_to_engine(dd->engine, &req->base);
 }
 
 static int omap_sham_update(struct ahash_request *req)
@@ -1608,10 +1675,8 @@ static void omap_sham_done_task(unsigned long data)
 	struct omap_sham_dev *dd = (struct omap_sham_dev *)data;
 	int err = 0;
 
-	if (!test_bit(FLAGS_BUSY, &dd->flags)) {
-		omap_sham_handle_queue(dd, NULL);
+	if (!test_bit(FLAGS_BUSY, &dd->flags))
 		return;
-	}
 
 	if (test_bit(FLAGS_CPU, &dd->flags)) {
 		if (test_and_clear_bit(FLAGS_OUTPUT_READY, &dd->flags)) {
@@ -1909,9 +1974,7 @@ static int omap_sham_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, dd);
 
 	INIT_LIST_HEAD(&dd->list);
-	spin_lock_init(&dd->lock);
 	tasklet_init(&dd->done_task, omap_sham_done_task, (unsigned long)dd);
-	crypto_init_queue(&dd->queue, OMAP_SHAM_QUEUE_LENGTH);
 
 	err = (dev->of_node) ? omap_sham_get_res_of(dd, dev, &res) :
 			       omap_sham_get_res_pdev(dd, pdev, &res);
@@ -1955,6 +2018,19 @@ static int omap_sham_probe(struct platform_device *pdev)
 		(rev & dd->pdata->major_mask) >> dd->pdata->major_shift,
 		(rev & dd->pdata->minor_mask) >> dd->pdata->minor_shift);
 
+	dd->engine = crypto_engine_alloc_init(dev, 1);
+	if (!dd->engine) {
+		err = -ENOMEM;
+		goto err_engine;
+	}
+
+	dd->engine->prepare_crypt_hardware = omap_sham_prepare_hw;
+	dd->engine->unprepare_crypt_hardware = omap_sham_unprepare_hw;
+	dd->engine->do_one_request = omap_sham_hash_one_req;
+	err = crypto_engine_start(dd->engine);
+	if (err)
+		goto err_engine_start;
+
 	spin_lock(&sham.lock);
 	list_add_tail(&dd->list, &sham.dev_list);
 	spin_unlock(&sham.lock);
@@ -1977,6 +2053,9 @@ err_algs:
 		for (j = dd->pdata->algs_info[i].registered - 1; j >= 0; j--)
 			crypto_unregister_ahash(
 					&dd->pdata->algs_info[i].algs_list[j]);
+err_engine_start:
+	crypto_engine_exit(dd->engine);
+err_engine:
 	pm_runtime_disable(dev);
 	if (dd->dma_lch)
 		dma_release_channel(dd->dma_lch);
@@ -2001,6 +2080,7 @@ static int omap_sham_remove(struct platform_device *pdev)
 		for (j = dd->pdata->algs_info[i].registered - 1; j >= 0; j--)
 			crypto_unregister_ahash(
 					&dd->pdata->algs_info[i].algs_list[j]);
+	crypto_engine_exit(dd->engine);
 	tasklet_kill(&dd->done_task);
 	pm_runtime_disable(&pdev->dev);
 
@@ -21,6 +21,7 @@
 #include <linux/io.h>
 #include <linux/device.h>
 #include <linux/pm_runtime.h>
+#include <linux/debugfs.h>
 #include <linux/pm.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
@@ -29,6 +30,7 @@
 #include <linux/platform_data/gpio-omap.h>
 
 #define OFF_MODE	1
+#define OMAP_GPIO_OE_RESET	0xffffffff
 #define OMAP4_GPIO_DEBOUNCINGTIME_MASK 0xFF
 
 static LIST_HEAD(omap_gpio_list);
@@ -48,6 +50,14 @@ struct gpio_regs {
 	u32 debounce_en;
 };
 
+/* runtime PM statistics, in debugfs */
+struct gpio_pm_stats {
+	u32 resumes;
+	u32 context_restores;
+	u32 context_kept;
+	u32 restore_writes;
+};
+
 struct gpio_bank {
 	struct list_head node;
 	void __iomem *base;
@@ -76,8 +86,12 @@ struct gpio_bank {
 	int context_loss_count;
 	int power_mode;
 	bool workaround_enabled;
+	struct gpio_pm_stats pm_stats;
+	struct dentry *debugfs_dir;
 
 	void (*set_dataout)(struct gpio_bank *bank, unsigned gpio, int enable);
+	void (*set_dataout_multiple)(struct gpio_bank *bank,
+				     unsigned long *mask, unsigned long *bits);
 	int (*get_context_loss_count)(struct device *dev);
 
 	struct omap_gpio_reg_offs *regs;
@@ -148,6 +162,38 @@ static void omap_set_gpio_dataout_mask(struct gpio_bank *bank, unsigned offset,
 	bank->context.dataout = l;
 }
 
+/* set the lines of @mask to @bits with the set and clear registers */
+static void omap_set_gpio_dataout_reg_multiple(struct gpio_bank *bank,
+					       unsigned long *mask,
+					       unsigned long *bits)
+{
+	void __iomem *reg = bank->base;
+	u32 l;
+
+	l = *bits & *mask;
+	if (l)
+		writel_relaxed(l, reg + bank->regs->set_dataout);
+	bank->context.dataout |= l;
+
+	l = ~*bits & *mask;
+	if (l)
+		writel_relaxed(l, reg + bank->regs->clr_dataout);
+	bank->context.dataout &= ~l;
+}
+
+/* set the lines of @mask to @bits in a single read-modify-write */
+static void omap_set_gpio_dataout_mask_multiple(struct gpio_bank *bank,
+						unsigned long *mask,
+						unsigned long *bits)
+{
+	void __iomem *reg = bank->base + bank->regs->dataout;
+	u32 l;
+
+	l = (readl_relaxed(reg) & ~*mask) | (*bits & *mask);
+	writel_relaxed(l, reg);
+	bank->context.dataout = l;
+}
+
 static int omap_get_gpio_datain(struct gpio_bank *bank, int offset)
 {
 	void __iomem *reg = bank->base + bank->regs->datain;
@@ -697,8 +743,10 @@ static void omap_gpio_free(struct gpio_chip *chip, unsigned offset)
 	 * If this is the last gpio to be freed in the bank,
 	 * disable the bank module.
 	 */
-	if (!BANK_USED(bank))
-		pm_runtime_put(bank->dev);
+	if (!BANK_USED(bank)) {
+		pm_runtime_mark_last_busy(bank->dev);
+		pm_runtime_put_autosuspend(bank->dev);
+	}
 }
 
 /*
@@ -776,7 +824,8 @@ static irqreturn_t omap_gpio_irq_handler(int irq, void *gpiobank)
 		}
 	}
 exit:
-	pm_runtime_put(bank->dev);
+	pm_runtime_mark_last_busy(bank->dev);
+	pm_runtime_put_autosuspend(bank->dev);
 	return IRQ_HANDLED;
 }
 
@@ -837,8 +886,10 @@ static void gpio_irq_bus_sync_unlock(struct irq_data *data)
 	 * If this is the last IRQ to be freed in the bank,
 	 * disable the bank module.
 	 */
-	if (!BANK_USED(bank))
-		pm_runtime_put(bank->dev);
+	if (!BANK_USED(bank)) {
+		pm_runtime_mark_last_busy(bank->dev);
+		pm_runtime_put_autosuspend(bank->dev);
+	}
 }
 
 static void omap_gpio_ack_irq(struct irq_data *d)
@@ -986,6 +1037,31 @@ static int omap_gpio_get(struct gpio_chip *chip, unsigned offset)
 		return omap_get_gpio_dataout(bank, offset);
 }
 
+/* inputs read DATAIN and outputs DATAOUT, as in omap_gpio_get() */
+static int omap_gpio_get_multiple(struct gpio_chip *chip, unsigned long *mask,
+				  unsigned long *bits)
+{
+	struct gpio_bank *bank;
+	void __iomem *base;
+	u32 direction, m, val = 0;
+
+	bank = container_of(chip, struct gpio_bank, chip);
+	base = bank->base;
+
+	direction = readl_relaxed(base + bank->regs->direction);
+
+	m = direction & *mask;
+	if (m)
+		val |= readl_relaxed(base + bank->regs->datain) & m;
+
+	m = ~direction & *mask;
+	if (m)
+		val |= readl_relaxed(base + bank->regs->dataout) & m;
+
+	*bits = val;
+	return 0;
+}
+
 static int omap_gpio_output(struct gpio_chip *chip, unsigned offset, int value)
 {
 	struct gpio_bank *bank;
@@ -1025,6 +1101,18 @@ static void omap_gpio_set(struct gpio_chip *chip, unsigned offset, int value)
 	raw_spin_unlock_irqrestore(&bank->lock, flags);
 }
 
+static void omap_gpio_set_multiple(struct gpio_chip *chip, unsigned long *mask,
+				   unsigned long *bits)
+{
+	struct gpio_bank *bank;
+	unsigned long flags;
+
+	bank = container_of(chip, struct gpio_bank, chip);
+	raw_spin_lock_irqsave(&bank->lock, flags);
+	bank->set_dataout_multiple(bank, mask, bits);
+	raw_spin_unlock_irqrestore(&bank->lock, flags);
+}
+
 /*---------------------------------------------------------------------*/
 
 static void __init omap_gpio_show_rev(struct gpio_bank *bank)
@@ -1084,9 +1172,11 @@ static int omap_gpio_chip_init(struct gpio_bank *bank, struct irq_chip *irqc)
 	bank->chip.get_direction = omap_gpio_get_direction;
 	bank->chip.direction_input = omap_gpio_input;
 	bank->chip.get = omap_gpio_get;
+	bank->chip.get_multiple = omap_gpio_get_multiple;
 	bank->chip.direction_output = omap_gpio_output;
 	bank->chip.set_debounce = omap_gpio_debounce;
 	bank->chip.set = omap_gpio_set;
+	bank->chip.set_multiple = omap_gpio_set_multiple;
 	if (bank->is_mpuio) {
 		bank->chip.label = "mpuio";
 		if (bank->regs->wkup_en)
@@ -1148,6 +1238,35 @@ static int omap_gpio_chip_init(struct gpio_bank *bank, struct irq_chip *irqc)
 	return ret;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *omap_gpio_debugfs_root;
+
+static void omap_gpio_debugfs_init(struct gpio_bank *bank)
+{
+	struct gpio_pm_stats *st = &bank->pm_stats;
+	struct dentry *dir;
+
+	if (!omap_gpio_debugfs_root)
+		omap_gpio_debugfs_root = debugfs_create_dir("gpio-omap", NULL);
+	if (IS_ERR_OR_NULL(omap_gpio_debugfs_root))
+		return;
+
+	dir = debugfs_create_dir(dev_name(bank->dev), omap_gpio_debugfs_root);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_u32("resumes", S_IRUGO, dir, &st->resumes);
+	debugfs_create_u32("context_restores", S_IRUGO, dir,
+			   &st->context_restores);
+	debugfs_create_u32("context_kept", S_IRUGO, dir, &st->context_kept);
+	debugfs_create_u32("restore_writes", S_IRUGO, dir,
+			   &st->restore_writes);
+	bank->debugfs_dir = dir;
+}
+#else
+static inline void omap_gpio_debugfs_init(struct gpio_bank *bank) {}
+#endif
+
 static const struct of_device_id omap_gpio_match[];
 
 static int omap_gpio_probe(struct platform_device *pdev)
@@ -1159,6 +1278,7 @@ static int omap_gpio_probe(struct platform_device *pdev)
 	struct resource *res;
 	struct gpio_bank *bank;
 	struct irq_chip *irqc;
+	u32 autosuspend_delay;
 	int ret;
 
 	match = of_match_device(of_match_ptr(omap_gpio_match), dev);
@@ -1215,10 +1335,14 @@ static int omap_gpio_probe(struct platform_device *pdev)
 			pdata->get_context_loss_count;
 	}
 
-	if (bank->regs->set_dataout && bank->regs->clr_dataout)
+	if (bank->regs->set_dataout && bank->regs->clr_dataout) {
 		bank->set_dataout = omap_set_gpio_dataout_reg;
-	else
+		bank->set_dataout_multiple = omap_set_gpio_dataout_reg_multiple;
+	} else {
 		bank->set_dataout = omap_set_gpio_dataout_mask;
+		bank->set_dataout_multiple =
+				omap_set_gpio_dataout_mask_multiple;
+	}
 
 	raw_spin_lock_init(&bank->lock);
 	raw_spin_lock_init(&bank->wa_lock);
@@ -1243,6 +1367,16 @@ static int omap_gpio_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, bank);
 
+	/*
+	 * Banks toggled in bursts can stay powered for a while instead of
+	 * going through a suspend and context restore between two accesses.
+	 * The delay can also be changed in power/autosuspend_delay_ms.
+	 */
+	if (of_property_read_u32(node, "ti,autosuspend-delay-ms",
+				 &autosuspend_delay))
+		autosuspend_delay = 0;
+	pm_runtime_set_autosuspend_delay(bank->dev, autosuspend_delay);
+	pm_runtime_use_autosuspend(bank->dev);
 	pm_runtime_enable(bank->dev);
 	pm_runtime_irq_safe(bank->dev);
 	pm_runtime_get_sync(bank->dev);
@@ -1256,12 +1390,15 @@ static int omap_gpio_probe(struct platform_device *pdev)
 	if (ret) {
 		pm_runtime_put_sync(bank->dev);
 		pm_runtime_disable(bank->dev);
+		pm_runtime_dont_use_autosuspend(bank->dev);
 		return ret;
 	}
 
 	omap_gpio_show_rev(bank);
+	omap_gpio_debugfs_init(bank);
 
-	pm_runtime_put(bank->dev);
+	pm_runtime_mark_last_busy(bank->dev);
+	pm_runtime_put_autosuspend(bank->dev);
 
 	list_add_tail(&bank->node, &omap_gpio_list);
 
@@ -1273,8 +1410,10 @@ static int omap_gpio_remove(struct platform_device *pdev)
 	struct gpio_bank *bank = platform_get_drvdata(pdev);
 
 	list_del(&bank->node);
+	debugfs_remove_recursive(bank->debugfs_dir);
 	gpiochip_remove(&bank->chip);
 	pm_runtime_disable(bank->dev);
+	pm_runtime_dont_use_autosuspend(bank->dev);
 	if (bank->dbck_flag)
 		clk_unprepare(bank->dbck);
 
@@ -1285,6 +1424,7 @@ static int omap_gpio_remove(struct platform_device *pdev)
 
 #if defined(CONFIG_PM)
 static void omap_gpio_restore_context(struct gpio_bank *bank);
+static bool omap_gpio_context_lost(struct gpio_bank *bank);
 
 static int omap_gpio_runtime_suspend(struct device *dev)
 {
@@ -1363,6 +1503,7 @@ static int omap_gpio_runtime_resume(struct device *dev)
 	int c;
 
 	raw_spin_lock_irqsave(&bank->lock, flags);
+	bank->pm_stats.resumes++;
 
 	/*
 	 * On the first resume during the probe, the context has not
@@ -1391,12 +1532,18 @@ static int omap_gpio_runtime_resume(struct device *dev)
 		     bank->base + bank->regs->risingdetect);
 
 	if (!bank->get_context_loss_count) {
+		if (!omap_gpio_context_lost(bank)) {
+			bank->pm_stats.context_kept++;
+			raw_spin_unlock_irqrestore(&bank->lock, flags);
+			return 0;
+		}
 		omap_gpio_restore_context(bank);
 	} else {
 		c = bank->get_context_loss_count(bank->dev);
 		if (c != bank->context_loss_count) {
 			omap_gpio_restore_context(bank);
 		} else {
+			bank->pm_stats.context_kept++;
 			raw_spin_unlock_irqrestore(&bank->lock, flags);
 			return 0;
 		}
@@ -1516,38 +1663,75 @@ static void omap_gpio_init_context(struct gpio_bank *p)
 	p->context_valid = true;
 }
 
+/*
+ * Without a context loss counter, tell whether the bank lost its context by
+ * reading back a register whose saved value differs from its reset value.
+ * The detection registers were rewritten by ->runtime_resume() already and
+ * cannot be used.
+ */
+static bool omap_gpio_context_lost(struct gpio_bank *bank)
+{
+	void __iomem *base = bank->base;
+
+	if (bank->context.oe != OMAP_GPIO_OE_RESET)
+		return readl_relaxed(base + bank->regs->direction) !=
+			bank->context.oe;
+	if (bank->context.irqenable1)
+		return readl_relaxed(base + bank->regs->irqenable) !=
+			bank->context.irqenable1;
+	if (bank->context.dataout)
+		return readl_relaxed(base + bank->regs->dataout) !=
+			bank->context.dataout;
+
+	/* a bank still in its reset state has next to nothing to restore */
+	return true;
+}
+
+/* the bank just lost its context, skip registers left at their reset value */
+static void omap_gpio_restore_reg(struct gpio_bank *bank, u32 val, u32 reset,
+				  u16 reg)
+{
+	if (val == reset)
+		return;
+
+	writel_relaxed(val, bank->base + reg);
+	bank->pm_stats.restore_writes++;
+}
+
 static void omap_gpio_restore_context(struct gpio_bank *bank)
 {
-	writel_relaxed(bank->context.wake_en,
-				bank->base + bank->regs->wkup_en);
+	bank->pm_stats.context_restores++;
+
+	omap_gpio_restore_reg(bank, bank->context.wake_en, 0,
+			      bank->regs->wkup_en);
+	/* the reset value of CTRL differs between SoCs, always restore it */
 	writel_relaxed(bank->context.ctrl, bank->base + bank->regs->ctrl);
-	writel_relaxed(bank->context.leveldetect0,
-				bank->base + bank->regs->leveldetect0);
-	writel_relaxed(bank->context.leveldetect1,
-				bank->base + bank->regs->leveldetect1);
-	writel_relaxed(bank->context.risingdetect,
-				bank->base + bank->regs->risingdetect);
-	writel_relaxed(bank->context.fallingdetect,
-				bank->base + bank->regs->fallingdetect);
+	bank->pm_stats.restore_writes++;
+	omap_gpio_restore_reg(bank, bank->context.leveldetect0, 0,
+			      bank->regs->leveldetect0);
+	omap_gpio_restore_reg(bank, bank->context.leveldetect1, 0,
+			      bank->regs->leveldetect1);
+	/* the edge detection registers were rewritten by the caller */
 	if (bank->regs->set_dataout && bank->regs->clr_dataout)
-		writel_relaxed(bank->context.dataout,
-				bank->base + bank->regs->set_dataout);
+		omap_gpio_restore_reg(bank, bank->context.dataout, 0,
+				      bank->regs->set_dataout);
 	else
-		writel_relaxed(bank->context.dataout,
-				bank->base + bank->regs->dataout);
-	writel_relaxed(bank->context.oe, bank->base + bank->regs->direction);
+		omap_gpio_restore_reg(bank, bank->context.dataout, 0,
+				      bank->regs->dataout);
+	omap_gpio_restore_reg(bank, bank->context.oe, OMAP_GPIO_OE_RESET,
+			      bank->regs->direction);
 
 	if (bank->dbck_enable_mask) {
-		writel_relaxed(bank->context.debounce, bank->base +
-					bank->regs->debounce);
-		writel_relaxed(bank->context.debounce_en,
-					bank->base + bank->regs->debounce_en);
+		omap_gpio_restore_reg(bank, bank->context.debounce, 0,
+				      bank->regs->debounce);
+		omap_gpio_restore_reg(bank, bank->context.debounce_en, 0,
+				      bank->regs->debounce_en);
 	}
 
-	writel_relaxed(bank->context.irqenable1,
-				bank->base + bank->regs->irqenable);
-	writel_relaxed(bank->context.irqenable2,
-				bank->base + bank->regs->irqenable2);
+	omap_gpio_restore_reg(bank, bank->context.irqenable1, 0,
+			      bank->regs->irqenable);
+	omap_gpio_restore_reg(bank, bank->context.irqenable2, 0,
+			      bank->regs->irqenable2);
 }
 #endif /* CONFIG_PM */
 #else
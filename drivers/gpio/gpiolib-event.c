@@ -0,0 +1,253 @@
+/*
+ * GPIO edge event capture through /dev/gpio-event
+ *
+ * Each open file captures the edges of one GPIO line.  The edge interrupt
+ * stamps every event in hard IRQ context and queues it in a ring private to
+ * the file, read() then returns whole struct gpio_event_record entries, as
+ * many as are queued and fit.  Unlike poll() on the sysfs value attribute no
+ * edge is lost between two reads until the ring fills up.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/kfifo.h>
+#include <linux/interrupt.h>
+#include <linux/uaccess.h>
+#include <linux/timekeeping.h>
+#include <linux/gpio/consumer.h>
+#include <linux/gpio/driver.h>
+#include <uapi/linux/gpio_event.h>
+
+#include "gpiolib.h"
+
+struct gpio_event_file {
+	/* serializes the request against readers and release */
+	struct mutex lock;
+	struct gpio_desc *desc;
+	unsigned int irq;
+	u32 flags;
+
+	/* the IRQ handler is the only writer, readers hold @lock */
+	DECLARE_KFIFO_PTR(events, struct gpio_event_record);
+	wait_queue_head_t wait;
+	bool overflow;
+};
+
+static irqreturn_t gpio_event_irq(int irq, void *dev_id)
+{
+	struct gpio_event_file *ef = dev_id;
+	struct gpio_event_record rec;
+
+	rec.timestamp = ktime_get_ns();
+	rec.gpio = desc_to_gpio(ef->desc);
+
+	if (ef->flags == GPIO_EVENT_BOTH_EDGES)
+		rec.flags = gpiod_get_raw_value(ef->desc) ?
+			GPIO_EVENT_RISING_EDGE : GPIO_EVENT_FALLING_EDGE;
+	else
+		rec.flags = ef->flags;
+
+	if (ef->overflow)
+		rec.flags |= GPIO_EVENT_OVERFLOW;
+	ef->overflow = !kfifo_put(&ef->events, rec);
+
+	wake_up_poll(&ef->wait, POLLIN | POLLRDNORM);
+
+	return IRQ_HANDLED;
+}
+
+static int gpio_event_request(struct gpio_event_file *ef,
+			      struct gpio_event_request *req)
+{
+	unsigned long irqflags = 0;
+	struct gpio_desc *desc;
+	int irq, ret;
+
+	if (!req->flags || (req->flags & ~GPIO_EVENT_BOTH_EDGES) ||
+	    req->reserved || req->queue_size > GPIO_EVENT_MAX_QUEUE)
+		return -EINVAL;
+
+	desc = gpio_to_desc(req->gpio);
+	if (!desc)
+		return -EINVAL;
+
+	/* events are stamped and queued from the hard IRQ handler */
+	if (gpiod_cansleep(desc))
+		return -EOPNOTSUPP;
+
+	if (req->flags & GPIO_EVENT_RISING_EDGE)
+		irqflags |= IRQF_TRIGGER_RISING;
+	if (req->flags & GPIO_EVENT_FALLING_EDGE)
+		irqflags |= IRQF_TRIGGER_FALLING;
+
+	ret = kfifo_alloc(&ef->events,
+			  req->queue_size ? : GPIO_EVENT_DEFAULT_QUEUE,
+			  GFP_KERNEL);
+	if (ret)
+		return ret;
+
+	ret = gpiod_request(desc, "gpio-event");
+	if (ret)
+		goto err_free_fifo;
+
+	ret = gpiod_direction_input(desc);
+	if (ret)
+		goto err_free_gpio;
+
+	irq = gpiod_to_irq(desc);
+	if (irq < 0) {
+		ret = irq;
+		goto err_free_gpio;
+	}
+
+	ef->desc = desc;
+	ef->flags = req->flags;
+	ef->overflow = false;
+
+	ret = request_irq(irq, gpio_event_irq, irqflags, "gpio-event", ef);
+	if (ret)
+		goto err_free_gpio;
+	ef->irq = irq;
+
+	return 0;
+
+err_free_gpio:
+	ef->desc = NULL;
+	gpiod_free(desc);
+err_free_fifo:
+	kfifo_free(&ef->events);
+	return ret;
+}
+
+static long gpio_event_ioctl(struct file *filp, unsigned int cmd,
+			     unsigned long arg)
+{
+	struct gpio_event_file *ef = filp->private_data;
+	struct gpio_event_request req;
+	int ret;
+
+	if (cmd != GPIO_EVENT_IOC_REQUEST)
+		return -ENOTTY;
+
+	if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+		return -EFAULT;
+
+	mutex_lock(&ef->lock);
+	if (ef->desc)
+		ret = -EBUSY;
+	else
+		ret = gpio_event_request(ef, &req);
+	mutex_unlock(&ef->lock);
+
+	return ret;
+}
+
+static ssize_t gpio_event_read(struct file *filp, char __user *buf,
+			       size_t count, loff_t *f_ps)
+{
+	struct gpio_event_file *ef = filp->private_data;
+	unsigned int copied;
+	int ret;
+
+	if (count < sizeof(struct gpio_event_record))
+		return -EINVAL;
+
+	do {
+		if (mutex_lock_interruptible(&ef->lock))
+			return -ERESTARTSYS;
+
+		if (!ef->desc) {
+			mutex_unlock(&ef->lock);
+			return -EINVAL;
+		}
+
+		ret = kfifo_to_user(&ef->events, buf, count, &copied);
+		mutex_unlock(&ef->lock);
+		if (ret)
+			return ret;
+		if (copied)
+			return copied;
+
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(ef->wait,
+					       !kfifo_is_empty(&ef->events));
+	} while (ret == 0);
+
+	return ret;
+}
+
+static unsigned int gpio_event_poll(struct file *filp,
+				    struct poll_table_struct *wait)
+{
+	struct gpio_event_file *ef = filp->private_data;
+
+	poll_wait(filp, &ef->wait, wait);
+
+	if (ef->desc && !kfifo_is_empty(&ef->events))
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
+static int gpio_event_open(struct inode *inode, struct file *filp)
+{
+	struct gpio_event_file *ef;
+
+	ef = kzalloc(sizeof(*ef), GFP_KERNEL);
+	if (!ef)
+		return -ENOMEM;
+
+	mutex_init(&ef->lock);
+	init_waitqueue_head(&ef->wait);
+	filp->private_data = ef;
+
+	return nonseekable_open(inode, filp);
+}
+
+static int gpio_event_release(struct inode *inode, struct file *filp)
+{
+	struct gpio_event_file *ef = filp->private_data;
+
+	if (ef->desc) {
+		free_irq(ef->irq, ef);
+		gpiod_free(ef->desc);
+		kfifo_free(&ef->events);
+	}
+	mutex_destroy(&ef->lock);
+	kfree(ef);
+
+	return 0;
+}
+
+static const struct file_operations gpio_event_fops = {
+	.owner = THIS_MODULE,
+	.open = gpio_event_open,
+	.release = gpio_event_release,
+	.read = gpio_event_read,
+	.poll = gpio_event_poll,
+	.unlocked_ioctl = gpio_event_ioctl,
+	.compat_ioctl = gpio_event_ioctl,
+	.llseek = no_llseek,
+};
+
+static struct miscdevice gpio_event_misc = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "gpio-event",
+	.fops = &gpio_event_fops,
+};
+
+static int __init gpio_event_init(void)
+{
+	return misc_register(&gpio_event_misc);
+}
+device_initcall(gpio_event_init);
@@ -24,6 +24,12 @@
 #include <drm/drm_gem_cma_helper.h>
 #include <drm/drm_fb_cma_helper.h>
 #include <linux/module.h>
+#include <linux/uaccess.h>
+
+static unsigned int drm_fbdev_cma_buffers = 2;
+module_param_named(fbdev_buffers, drm_fbdev_cma_buffers, uint, 0444);
+MODULE_PARM_DESC(fbdev_buffers,
+	"Number of screen sized buffers in the CMA fbdev framebuffer, for panning (default: 2)");
 
 struct drm_fb_cma {
 	struct drm_framebuffer		fb;
@@ -232,6 +238,107 @@ int drm_fb_cma_debugfs_show(struct seq_file *m, void *arg)
 EXPORT_SYMBOL_GPL(drm_fb_cma_debugfs_show);
 #endif
 
+/*
+ * Wait for the next vblank on every CRTC scanning out the fbdev framebuffer,
+ * or only on the given one if crtc_id is not negative.
+ */
+static int drm_fbdev_cma_wait_vblank(struct drm_fb_helper *helper,
+				     int crtc_id)
+{
+	struct drm_mode_set *modeset;
+	struct drm_crtc *crtc;
+	int ret = -ENODEV;
+	int i;
+
+	if (oops_in_progress)
+		return 0;
+
+	for (i = 0; i < helper->crtc_count; i++) {
+		if (crtc_id >= 0 && i != crtc_id)
+			continue;
+
+		modeset = &helper->crtc_info[i].mode_set;
+		crtc = modeset->crtc;
+		if (!modeset->num_connectors || !crtc->enabled)
+			continue;
+
+		if (drm_crtc_vblank_get(crtc))
+			continue;
+		drm_wait_one_vblank(helper->dev, drm_crtc_index(crtc));
+		drm_crtc_vblank_put(crtc);
+		ret = 0;
+	}
+
+	return ret;
+}
+
+/*
+ * Panning between the buffers only changes the scanout base address, which
+ * the CRTC latches on the next vblank.  With FB_ACTIVATE_VBL the call only
+ * returns once that happened, so the previous buffer is free to be drawn.
+ */
+static int drm_fbdev_cma_pan_display(struct fb_var_screeninfo *var,
+				     struct fb_info *info)
+{
+	int ret;
+
+	ret = drm_fb_helper_pan_display(var, info);
+	if (ret || !(var->activate & FB_ACTIVATE_VBL))
+		return ret;
+
+	drm_fbdev_cma_wait_vblank(info->par, -1);
+
+	return 0;
+}
+
+static int drm_fbdev_cma_damage(struct fb_info *info,
+				struct fb_damage __user *argp)
+{
+	struct drm_fb_helper *helper = info->par;
+	struct drm_framebuffer *fb = helper->fb;
+	struct drm_clip_rect clip;
+	struct fb_damage damage;
+
+	if (copy_from_user(&damage, argp, sizeof(damage)))
+		return -EFAULT;
+
+	if (!damage.width || !damage.height ||
+	    damage.x >= fb->width || damage.width > fb->width - damage.x ||
+	    damage.y >= fb->height || damage.height > fb->height - damage.y)
+		return -EINVAL;
+
+	/* the buffer is scanned out directly, nothing to flush */
+	if (!fb->funcs->dirty)
+		return 0;
+
+	clip.x1 = damage.x;
+	clip.y1 = damage.y;
+	clip.x2 = damage.x + damage.width;
+	clip.y2 = damage.y + damage.height;
+
+	return fb->funcs->dirty(fb, NULL, 0, 0, &clip, 1);
+}
+
+static int drm_fbdev_cma_ioctl(struct fb_info *info, unsigned int cmd,
+			       unsigned long arg)
+{
+	void __user *argp = (void __user *)arg;
+	u32 crtc_id;
+
+	switch (cmd) {
+	case FBIO_WAITFORVSYNC:
+		if (get_user(crtc_id, (u32 __user *)argp))
+			return -EFAULT;
+		if (crtc_id >= INT_MAX)
+			return -EINVAL;
+		return drm_fbdev_cma_wait_vblank(info->par, crtc_id);
+	case FBIO_DAMAGE:
+		return drm_fbdev_cma_damage(info, argp);
+	default:
+		return -ENOTTY;
+	}
+}
+
 static struct fb_ops drm_fbdev_cma_ops = {
 	.owner		= THIS_MODULE,
 	.fb_fillrect	= sys_fillrect,
@@ -240,8 +347,9 @@ static struct fb_ops drm_fbdev_cma_ops = {
 	.fb_check_var	= drm_fb_helper_check_var,
 	.fb_set_par	= drm_fb_helper_set_par,
 	.fb_blank	= drm_fb_helper_blank,
-	.fb_pan_display	= drm_fb_helper_pan_display,
+	.fb_pan_display	= drm_fbdev_cma_pan_display,
 	.fb_setcmap	= drm_fb_helper_setcmap,
+	.fb_ioctl	= drm_fbdev_cma_ioctl,
 };
 
 static int drm_fbdev_cma_create(struct drm_fb_helper *helper,
@@ -265,7 +373,8 @@ static int drm_fbdev_cma_create(struct drm_fb_helper *helper,
 	bytes_per_pixel = DIV_ROUND_UP(sizes->surface_bpp, 8);
 
 	mode_cmd.width = sizes->surface_width;
-	mode_cmd.height = sizes->surface_height;
+	mode_cmd.height = sizes->surface_height *
+			  clamp(drm_fbdev_cma_buffers, 1U, 4U);
 	mode_cmd.pitches[0] = sizes->surface_width * bytes_per_pixel;
 	mode_cmd.pixel_format = drm_mode_legacy_fb_format(sizes->surface_bpp,
 		sizes->surface_depth);
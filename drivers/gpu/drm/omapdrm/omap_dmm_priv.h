@@ -59,12 +59,12 @@
 #define DMM_IRQSTAT_ERR_UPD_DATA	(1<<6)
 #define DMM_IRQSTAT_ERR_LUT_MISS	(1<<7)
 
-#define DMM_IRQSTAT_ERR_MASK	(DMM_IRQ_STAT_ERR_INV_DSC | \
-				DMM_IRQ_STAT_ERR_INV_DATA | \
-				DMM_IRQ_STAT_ERR_UPD_AREA | \
-				DMM_IRQ_STAT_ERR_UPD_CTRL | \
-				DMM_IRQ_STAT_ERR_UPD_DATA | \
-				DMM_IRQ_STAT_ERR_LUT_MISS)
+#define DMM_IRQSTAT_ERR_MASK	(DMM_IRQSTAT_ERR_INV_DSC | \
+				DMM_IRQSTAT_ERR_INV_DATA | \
+				DMM_IRQSTAT_ERR_UPD_AREA | \
+				DMM_IRQSTAT_ERR_UPD_CTRL | \
+				DMM_IRQSTAT_ERR_UPD_DATA | \
+				DMM_IRQSTAT_ERR_LUT_MISS)
 
 #define DMM_PATSTATUS_READY		(1<<0)
 #define DMM_PATSTATUS_VALID		(1<<1)
@@ -110,6 +110,9 @@ struct pat {
 
 #define DMM_FIXED_RETRY_COUNT 1000
 
+/* longest a refill may take before it is considered lost */
+#define DMM_REFILL_TIMEOUT_MS 100
+
 /* create refill buffer big enough to refill all slots, plus 3 descriptors..
  * 3 descriptors is probably the worst-case for # of 2d-slices in a 1d area,
  * but I guess you don't hit that worst case at the same time as full area
@@ -150,6 +153,13 @@ struct refill_engine {
 
 	struct completion compl;
 
+	/* completion of an async refill, from the irq or the timeout timer */
+	void (*done)(void *data, int status);
+	void *done_data;
+	atomic_t pending;
+	unsigned long deadline;
+	struct timer_list timer;
+
 	struct list_head idle_node;
 };
 
@@ -190,6 +200,12 @@ struct dmm {
 	/* allocation list and lock */
 	struct list_head alloc_head;
 
+	/* refill statistics for debugfs, not locked */
+	unsigned int refills;
+	unsigned int refill_areas;
+	unsigned int refills_async;
+	unsigned int refill_timeouts;
+
 	const struct dmm_platform_data *plat_data;
 
 	bool dmm_workaround;
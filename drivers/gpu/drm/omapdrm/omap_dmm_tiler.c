@@ -30,6 +30,7 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/timer.h>
 #include <linux/vmalloc.h>
 #include <linux/wait.h>
 
@@ -258,6 +259,38 @@ static void release_engine(struct refill_engine *engine)
 	wake_up_interruptible(&omap_dmm->engine_queue);
 }
 
+/*
+ * Finish an async refill.  Whichever of the irq and the timeout timer
+ * comes first reports it; the callback runs in atomic context.
+ */
+static void async_done(struct refill_engine *engine, int status)
+{
+	if (!atomic_xchg(&engine->pending, 0))
+		return;
+
+	del_timer(&engine->timer);
+
+	if (status == -ETIMEDOUT)
+		engine->dmm->refill_timeouts++;
+
+	if (engine->done)
+		engine->done(engine->done_data, status);
+
+	release_engine(engine);
+}
+
+static void async_timeout(unsigned long data)
+{
+	struct refill_engine *engine = (struct refill_engine *)data;
+
+	/* a leftover of a refill that already completed */
+	if (time_before(jiffies, engine->deadline))
+		return;
+
+	dev_err(engine->dmm->dev, "timed out waiting for async refill\n");
+	async_done(engine, -ETIMEDOUT);
+}
+
 static irqreturn_t omap_dmm_irq_handler(int irq, void *arg)
 {
 	struct dmm *dmm = arg;
@@ -270,7 +303,9 @@ static irqreturn_t omap_dmm_irq_handler(int irq, void *arg)
 	for (i = 0; i < dmm->num_engines; i++) {
 		if (status & DMM_IRQSTAT_LST) {
 			if (dmm->engines[i].async)
-				release_engine(&dmm->engines[i]);
+				async_done(&dmm->engines[i],
+					   (status & DMM_IRQSTAT_ERR_MASK) ?
+					   -EFAULT : 0);
 
 			complete(&dmm->engines[i].compl);
 		}
@@ -323,8 +358,9 @@ static struct dmm_txn *dmm_txn_init(struct dmm *dmm, struct tcm *tcm)
  * Add region to DMM transaction.  If pages or pages[i] is NULL, then the
  * corresponding slot is cleared (ie. dummy_pa is programmed)
  */
-static void dmm_txn_append(struct dmm_txn *txn, struct pat_area *area,
-		struct page **pages, uint32_t npages, uint32_t roll)
+static void dmm_txn_append(struct dmm_txn *txn, struct tcm *tcm,
+		struct pat_area *area, struct page **pages, uint32_t npages,
+		uint32_t roll)
 {
 	dma_addr_t pat_pa = 0, data_pa = 0;
 	uint32_t *data;
@@ -342,12 +378,12 @@ static void dmm_txn_append(struct dmm_txn *txn, struct pat_area *area,
 	pat->area = *area;
 
 	/* adjust Y coordinates based off of container parameters */
-	pat->area.y0 += engine->tcm->y_offset;
-	pat->area.y1 += engine->tcm->y_offset;
+	pat->area.y0 += tcm->y_offset;
+	pat->area.y1 += tcm->y_offset;
 
 	pat->ctrl = (struct pat_ctrl){
 			.start = 1,
-			.lut_id = engine->tcm->lut_id,
+			.lut_id = tcm->lut_id,
 		};
 
 	data = alloc_dma(txn, 4*i, &data_pa);
@@ -363,10 +399,41 @@ static void dmm_txn_append(struct dmm_txn *txn, struct pat_area *area,
 	}
 
 	txn->last_pat = pat;
+	engine->dmm->refill_areas++;
 
 	return;
 }
 
+/* Add all slices of a tcm area to the DMM transaction */
+static void dmm_txn_append_area(struct dmm_txn *txn, struct tcm_area *area,
+		struct page **pages, uint32_t npages, uint32_t roll)
+{
+	struct tcm_area slice, area_s;
+
+	tcm_for_each_slice(slice, *area, area_s) {
+		struct pat_area p_area = {
+				.x0 = slice.p0.x,  .y0 = slice.p0.y,
+				.x1 = slice.p1.x,  .y1 = slice.p1.y,
+		};
+
+		dmm_txn_append(txn, area->tcm, &p_area, pages, npages, roll);
+
+		roll += tcm_sizeof(slice);
+	}
+}
+
+/* Whether the refill buffer has room left for @area */
+static bool dmm_txn_fits(struct dmm_txn *txn, struct tcm_area *area)
+{
+	struct refill_engine *engine = txn->engine_handle;
+	/* a 1d area is at most three slices, each with 16 byte alignment */
+	size_t need = 3 * (ALIGN(sizeof(struct pat), 16) + 16) +
+		      4 * tcm_sizeof(*area);
+
+	return (txn->current_va - engine->refill_va) + need <=
+		REFILL_BUFFER_SIZE;
+}
+
 /**
  * Commit the DMM transaction.
  */
@@ -408,6 +475,14 @@ static int dmm_txn_commit(struct dmm_txn *txn, bool wait)
 	/* mark whether it is async to denote list management in IRQ handler */
 	engine->async = wait ? false : true;
 	reinit_completion(&engine->compl);
+	if (!wait) {
+		engine->deadline = jiffies +
+				   msecs_to_jiffies(DMM_REFILL_TIMEOUT_MS);
+		atomic_set(&engine->pending, 1);
+		mod_timer(&engine->timer, engine->deadline);
+		dmm->refills_async++;
+	}
+	dmm->refills++;
 	/* verify that the irq handler sees the 'async' and completion value */
 	smp_mb();
 
@@ -437,7 +512,6 @@ static int fill(struct tcm_area *area, struct page **pages,
 		uint32_t npages, uint32_t roll, bool wait)
 {
 	int ret = 0;
-	struct tcm_area slice, area_s;
 	struct dmm_txn *txn;
 
 	/*
@@ -450,20 +524,68 @@ static int fill(struct tcm_area *area, struct page **pages,
 	if (IS_ERR_OR_NULL(txn))
 		return -ENOMEM;
 
-	tcm_for_each_slice(slice, *area, area_s) {
-		struct pat_area p_area = {
-				.x0 = slice.p0.x,  .y0 = slice.p0.y,
-				.x1 = slice.p1.x,  .y1 = slice.p1.y,
-		};
+	dmm_txn_append_area(txn, area, pages, npages, roll);
+
+	ret = dmm_txn_commit(txn, wait);
 
-		dmm_txn_append(txn, &p_area, pages, npages, roll);
+	return ret;
+}
 
-		roll += tcm_sizeof(slice);
+/*
+ * Batched refill: the areas of several blocks go into one descriptor list
+ * and one refill engine run.  tiler_batch_begin() may sleep until an
+ * engine is free; the batch holds it until committed.
+ */
+struct dmm_txn *tiler_batch_begin(void)
+{
+	struct dmm_txn *txn = dmm_txn_init(omap_dmm, NULL);
+
+	return txn ? txn : ERR_PTR(-ENOMEM);
+}
+
+/*
+ * Returns -ENOSPC when the refill buffer is full, the caller then commits
+ * and carries on with a new batch.
+ */
+int tiler_batch_pin(struct dmm_txn *txn, struct tiler_block *block,
+		struct page **pages, uint32_t npages, uint32_t roll)
+{
+	if (!dmm_txn_fits(txn, &block->area))
+		return -ENOSPC;
+
+	dmm_txn_append_area(txn, &block->area, pages, npages, roll);
+
+	return 0;
+}
+
+/* only release the block after the refill has completed */
+int tiler_batch_unpin(struct dmm_txn *txn, struct tiler_block *block)
+{
+	return tiler_batch_pin(txn, block, NULL, 0, 0);
+}
+
+/*
+ * Without @done this waits for the refill.  With it, it returns as soon as
+ * the refill is started and @done is called, from the DMM irq or from the
+ * timeout timer, with 0 or a negative error.  @done is not called when
+ * the commit itself fails.
+ */
+int tiler_batch_commit(struct dmm_txn *txn,
+		void (*done)(void *data, int status), void *data)
+{
+	struct refill_engine *engine = txn->engine_handle;
+
+	if (!txn->last_pat) {
+		release_engine(engine);
+		if (done)
+			done(data, 0);
+		return 0;
 	}
 
-	ret = dmm_txn_commit(txn, wait);
+	engine->done = done;
+	engine->done_data = data;
 
-	return ret;
+	return dmm_txn_commit(txn, !done);
 }
 
 /*
@@ -708,6 +830,9 @@ static int omap_dmm_remove(struct platform_device *dev)
 				omap_dmm->tcm[i]->deinit(omap_dmm->tcm[i]);
 		kfree(omap_dmm->tcm);
 
+		if (omap_dmm->engines)
+			for (i = 0; i < omap_dmm->num_engines; i++)
+				del_timer_sync(&omap_dmm->engines[i].timer);
 		kfree(omap_dmm->engines);
 		if (omap_dmm->refill_va)
 			dma_free_writecombine(omap_dmm->dev,
@@ -879,6 +1004,8 @@ static int omap_dmm_probe(struct platform_device *dev)
 		omap_dmm->engines[i].refill_pa = omap_dmm->refill_pa +
 						(REFILL_BUFFER_SIZE * i);
 		init_completion(&omap_dmm->engines[i].compl);
+		setup_timer(&omap_dmm->engines[i].timer, async_timeout,
+			    (unsigned long)&omap_dmm->engines[i]);
 
 		list_add(&omap_dmm->engines[i].idle_node, &omap_dmm->idle_head);
 	}
@@ -1120,6 +1247,54 @@ error:
 
 	return 0;
 }
+
+int tiler_fill_show(struct seq_file *s, void *arg)
+{
+	struct tiler_block *block;
+	unsigned long flags;
+	int lut_idx;
+
+	if (!omap_dmm)
+		return 0;
+
+	for (lut_idx = 0; lut_idx < omap_dmm->num_lut; lut_idx++) {
+		struct tcm *tcm = omap_dmm->tcm[lut_idx];
+		unsigned int used_1d = 0, used_2d = 0;
+		unsigned int blocks_1d = 0, blocks_2d = 0;
+		unsigned int total = tcm->width * tcm->height;
+
+		spin_lock_irqsave(&list_lock, flags);
+		list_for_each_entry(block, &omap_dmm->alloc_head, alloc_node) {
+			if (block->area.tcm != tcm)
+				continue;
+			if (block->fmt == TILFMT_PAGE) {
+				used_1d += tcm_sizeof(block->area);
+				blocks_1d++;
+			} else {
+				used_2d += tcm_sizeof(block->area);
+				blocks_2d++;
+			}
+		}
+		spin_unlock_irqrestore(&list_lock, flags);
+
+		seq_printf(s, "container %d: %u/%u slots used (%u%%)\n",
+			   lut_idx, used_1d + used_2d, total,
+			   (used_1d + used_2d) * 100 / total);
+		seq_printf(s, "  1d: %u blocks, %u slots\n",
+			   blocks_1d, used_1d);
+		seq_printf(s, "  2d: %u blocks, %u slots\n",
+			   blocks_2d, used_2d);
+	}
+
+	seq_printf(s, "refills %u (async %u, timed out %u), areas %u\n",
+		   omap_dmm->refills, omap_dmm->refills_async,
+		   omap_dmm->refill_timeouts, omap_dmm->refill_areas);
+	seq_printf(s, "idle engines %d/%d\n",
+		   atomic_read(&omap_dmm->engine_counter),
+		   omap_dmm->num_engines);
+
+	return 0;
+}
 #endif
 
 #ifdef CONFIG_PM_SLEEP
@@ -85,6 +85,7 @@ S Y X	Description				Alternate description
 
 #ifdef CONFIG_DEBUG_FS
 int tiler_map_show(struct seq_file *s, void *arg);
+int tiler_fill_show(struct seq_file *s, void *arg);
 #endif
 
 /* pin/unpin */
@@ -92,6 +93,15 @@ int tiler_pin(struct tiler_block *block, struct page **pages,
 		uint32_t npages, uint32_t roll, bool wait);
 int tiler_unpin(struct tiler_block *block);
 
+/* several pins/unpins programmed with one refill */
+struct dmm_txn;
+struct dmm_txn *tiler_batch_begin(void);
+int tiler_batch_pin(struct dmm_txn *txn, struct tiler_block *block,
+		struct page **pages, uint32_t npages, uint32_t roll);
+int tiler_batch_unpin(struct dmm_txn *txn, struct tiler_block *block);
+int tiler_batch_commit(struct dmm_txn *txn,
+		void (*done)(void *data, int status), void *data);
+
 /* reserve/release */
 struct tiler_block *tiler_reserve_2d(enum tiler_fmt fmt, uint16_t w, uint16_t h,
 				uint16_t align);
@@ -41,6 +41,7 @@ int _drm_gem_create_mmap_offset_size(struct drm_gem_object *obj, size_t size);
 #define OMAP_BO_DMA			0x01000000	/* actually is physically contiguous */
 #define OMAP_BO_EXT_SYNC	0x02000000	/* externally allocated sync object */
 #define OMAP_BO_EXT_MEM		0x04000000	/* externally allocated memory */
+#define OMAP_BO_MEM_DMABUF	0x08000000	/* imported dma-buf */
 
 
 struct omap_gem_object {
@@ -90,6 +91,13 @@ struct omap_gem_object {
 	/** addresses corresponding to pages in above array */
 	dma_addr_t *addrs;
 
+	/**
+	 * sg table of an imported dma-buf.  A contiguous one gives paddr
+	 * directly (OMAP_BO_DMA), otherwise its pages are remapped in
+	 * TILER like those of a shmem buffer.
+	 */
+	struct sg_table *sgt;
+
 	/**
 	 * Virtual address, if mapped.
 	 */
@@ -215,6 +223,14 @@ static inline bool is_shmem(struct drm_gem_object *obj)
 	return obj->filp != NULL;
 }
 
+/* imported dma-buf that is not physically contiguous */
+static inline bool is_dmabuf_paged(struct drm_gem_object *obj)
+{
+	struct omap_gem_object *omap_obj = to_omap_bo(obj);
+	return (omap_obj->flags & OMAP_BO_MEM_DMABUF) &&
+		!(omap_obj->flags & OMAP_BO_DMA);
+}
+
 /**
  * shmem buffers that are mapped cached can simulate coherency via using
  * page faulting to keep track of dirty pages
@@ -757,7 +773,8 @@ int omap_gem_get_paddr(struct drm_gem_object *obj,
 
 	mutex_lock(&obj->dev->struct_mutex);
 
-	if (remap && is_shmem(obj) && priv->has_dmm) {
+	if (remap && (is_shmem(obj) || is_dmabuf_paged(obj)) &&
+			priv->has_dmm) {
 		if (omap_obj->paddr_cnt == 0) {
 			struct page **pages;
 			uint32_t npages = obj->size >> PAGE_SHIFT;
@@ -944,6 +961,9 @@ void *omap_gem_vaddr(struct drm_gem_object *obj)
 {
 	struct omap_gem_object *omap_obj = to_omap_bo(obj);
 	WARN_ON(!mutex_is_locked(&obj->dev->struct_mutex));
+	/* CPU access to an imported buffer goes through its exporter */
+	if (omap_obj->flags & OMAP_BO_MEM_DMABUF)
+		return ERR_PTR(-EINVAL);
 	if (!omap_obj->vaddr) {
 		struct page **pages;
 		int ret = get_pages(obj, &pages);
@@ -956,27 +976,108 @@ void *omap_gem_vaddr(struct drm_gem_object *obj)
 }
 
 #ifdef CONFIG_PM
-/* re-pin objects in DMM in resume path: */
+struct omap_gem_repin {
+	atomic_t pending;
+	int status;
+	struct completion done;
+};
+
+static void omap_gem_repin_done(void *data, int status)
+{
+	struct omap_gem_repin *repin = data;
+
+	if (status)
+		repin->status = status;
+	if (atomic_dec_and_test(&repin->pending))
+		complete(&repin->done);
+}
+
+static int omap_gem_repin_commit(struct dmm_txn *txn,
+		struct omap_gem_repin *repin)
+{
+	int ret;
+
+	atomic_inc(&repin->pending);
+	ret = tiler_batch_commit(txn, omap_gem_repin_done, repin);
+	if (ret)
+		atomic_dec(&repin->pending);
+
+	return ret;
+}
+
+/* re-pin objects in DMM in resume path, batched over the refill engines */
 int omap_gem_resume(struct device *dev)
 {
 	struct drm_device *drm_dev = dev_get_drvdata(dev);
 	struct omap_drm_private *priv = drm_dev->dev_private;
 	struct omap_gem_object *omap_obj;
+	struct omap_gem_repin repin;
+	struct dmm_txn *txn = NULL;
 	int ret = 0;
 
+	atomic_set(&repin.pending, 1);
+	repin.status = 0;
+	init_completion(&repin.done);
+
 	list_for_each_entry(omap_obj, &priv->obj_list, mm_list) {
-		if (omap_obj->block) {
-			struct drm_gem_object *obj = &omap_obj->base;
-			uint32_t npages = obj->size >> PAGE_SHIFT;
-			WARN_ON(!omap_obj->pages);  /* this can't happen */
-			ret = tiler_pin(omap_obj->block,
-					omap_obj->pages, npages,
-					omap_obj->roll, true);
-			if (ret) {
-				dev_err(dev, "could not repin: %d\n", ret);
-				return ret;
+		struct drm_gem_object *obj = &omap_obj->base;
+		uint32_t npages = obj->size >> PAGE_SHIFT;
+
+		if (!omap_obj->block)
+			continue;
+
+		WARN_ON(!omap_obj->pages);  /* this can't happen */
+
+		if (!txn) {
+			txn = tiler_batch_begin();
+			if (IS_ERR(txn)) {
+				ret = PTR_ERR(txn);
+				txn = NULL;
+				break;
 			}
 		}
+
+		ret = tiler_batch_pin(txn, omap_obj->block, omap_obj->pages,
+				npages, omap_obj->roll);
+		if (ret != -ENOSPC)
+			continue;
+
+		/* full, send it off and start over with a new batch */
+		ret = omap_gem_repin_commit(txn, &repin);
+		if (ret) {
+			txn = NULL;
+			break;
+		}
+
+		txn = tiler_batch_begin();
+		if (IS_ERR(txn)) {
+			ret = PTR_ERR(txn);
+			txn = NULL;
+			break;
+		}
+
+		ret = tiler_batch_pin(txn, omap_obj->block, omap_obj->pages,
+				npages, omap_obj->roll);
+		if (ret)
+			break;
+	}
+
+	if (txn) {
+		int err = omap_gem_repin_commit(txn, &repin);
+
+		if (!ret)
+			ret = err;
+	}
+
+	/* the refills of all engines run in parallel, wait for them all */
+	if (!atomic_dec_and_test(&repin.pending))
+		wait_for_completion(&repin.done);
+	if (!ret)
+		ret = repin.status;
+
+	if (ret) {
+		dev_err(dev, "could not repin: %d\n", ret);
+		return ret;
 	}
 
 	return 0;
@@ -1300,7 +1401,9 @@ void omap_gem_free_object(struct drm_gem_object *obj)
 	WARN_ON(omap_obj->paddr_cnt > 0);
 
 	/* don't free externally allocated backing memory */
-	if (!(omap_obj->flags & OMAP_BO_EXT_MEM)) {
+	if (omap_obj->flags & OMAP_BO_MEM_DMABUF) {
+		kfree(omap_obj->pages);
+	} else if (!(omap_obj->flags & OMAP_BO_EXT_MEM)) {
 		if (omap_obj->pages)
 			omap_gem_detach_pages(obj);
 
@@ -1316,6 +1419,9 @@ void omap_gem_free_object(struct drm_gem_object *obj)
 	if (!(omap_obj->flags & OMAP_BO_EXT_SYNC))
 		kfree(omap_obj->sync);
 
+	if (obj->import_attach)
+		drm_prime_gem_destroy(obj, omap_obj->sgt);
+
 	drm_gem_object_release(obj);
 
 	kfree(obj);
@@ -1416,7 +1522,7 @@ struct drm_gem_object *omap_gem_new(struct drm_device *dev,
 		omap_obj->height = gsize.tiled.height;
 	}
 
-	if (flags & (OMAP_BO_DMA|OMAP_BO_EXT_MEM)) {
+	if (flags & (OMAP_BO_DMA|OMAP_BO_EXT_MEM|OMAP_BO_MEM_DMABUF)) {
 		drm_gem_private_object_init(dev, obj, size);
 	} else {
 		ret = drm_gem_object_init(dev, obj, size);
@@ -1436,6 +1542,67 @@ fail:
 	return NULL;
 }
 
+/* GEM buffer object wrapping the mapped sg table of an imported dma-buf */
+struct drm_gem_object *omap_gem_new_dmabuf(struct drm_device *dev, size_t size,
+		struct sg_table *sgt)
+{
+	struct omap_drm_private *priv = dev->dev_private;
+	struct omap_gem_object *omap_obj;
+	struct drm_gem_object *obj;
+	union omap_gem_size gsize;
+
+	/* without DMM only physically contiguous buffers can be used */
+	if (sgt->orig_nents != 1 && !priv->has_dmm)
+		return ERR_PTR(-EINVAL);
+
+	mutex_lock(&dev->struct_mutex);
+
+	gsize.bytes = PAGE_ALIGN(size);
+	obj = omap_gem_new(dev, gsize, OMAP_BO_MEM_DMABUF | OMAP_BO_WC);
+	if (!obj) {
+		obj = ERR_PTR(-ENOMEM);
+		goto done;
+	}
+
+	omap_obj = to_omap_bo(obj);
+	omap_obj->sgt = sgt;
+
+	if (sgt->orig_nents == 1) {
+		omap_obj->paddr = sg_dma_address(sgt->sgl);
+		omap_obj->flags |= OMAP_BO_DMA;
+	} else {
+		unsigned int npages = obj->size >> PAGE_SHIFT;
+		struct sg_page_iter iter;
+		struct page **pages;
+		unsigned int i = 0;
+
+		pages = kcalloc(npages, sizeof(*pages), GFP_KERNEL);
+		if (!pages) {
+			omap_gem_free_object(obj);
+			obj = ERR_PTR(-ENOMEM);
+			goto done;
+		}
+
+		/* the pages are what tiler_pin() maps in DMM */
+		omap_obj->pages = pages;
+		for_each_sg_page(sgt->sgl, &iter, sgt->orig_nents, 0) {
+			if (i == npages)
+				break;
+			pages[i++] = sg_page_iter_page(&iter);
+		}
+
+		if (WARN_ON(i != npages)) {
+			omap_gem_free_object(obj);
+			obj = ERR_PTR(-ENOMEM);
+			goto done;
+		}
+	}
+
+done:
+	mutex_unlock(&dev->struct_mutex);
+	return obj;
+}
+
 /* init/cleanup.. if DMM is used, we need to set some stuff up.. */
 void omap_gem_init(struct drm_device *dev)
 {
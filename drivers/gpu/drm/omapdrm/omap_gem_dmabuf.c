@@ -203,7 +203,10 @@ struct dma_buf *omap_gem_prime_export(struct drm_device *dev,
 struct drm_gem_object *omap_gem_prime_import(struct drm_device *dev,
 		struct dma_buf *buffer)
 {
+	struct dma_buf_attachment *attach;
 	struct drm_gem_object *obj;
+	struct sg_table *sgt;
+	int ret;
 
 	/* is this one of own objects? */
 	if (buffer->ops == &omap_dmabuf_ops) {
@@ -220,8 +223,37 @@ struct drm_gem_object *omap_gem_prime_import(struct drm_device *dev,
 	}
 
 	/*
-	 * TODO add support for importing buffers from other devices..
-	 * for now we don't need this but would be nice to add eventually
+	 * a buffer of another device, e.g. a V4L2 capture or VPE buffer;
+	 * scanout reads it through its physical address or, when it is
+	 * not contiguous, through a TILER mapping of its pages
 	 */
-	return ERR_PTR(-EINVAL);
+	attach = dma_buf_attach(buffer, dev->dev);
+	if (IS_ERR(attach))
+		return ERR_CAST(attach);
+
+	get_dma_buf(buffer);
+
+	sgt = dma_buf_map_attachment(attach, DMA_BIDIRECTIONAL);
+	if (IS_ERR(sgt)) {
+		ret = PTR_ERR(sgt);
+		goto fail_detach;
+	}
+
+	obj = omap_gem_new_dmabuf(dev, buffer->size, sgt);
+	if (IS_ERR(obj)) {
+		ret = PTR_ERR(obj);
+		goto fail_unmap;
+	}
+
+	obj->import_attach = attach;
+
+	return obj;
+
+fail_unmap:
+	dma_buf_unmap_attachment(attach, sgt, DMA_BIDIRECTIONAL);
+fail_detach:
+	dma_buf_detach(buffer, attach);
+	dma_buf_put(buffer);
+
+	return ERR_PTR(ret);
 }
@@ -17,6 +17,9 @@
 
 #include "drm_flip_work.h"
 #include <drm/drm_plane_helper.h>
+#include <linux/dma-buf.h>
+#include <linux/fence.h>
+#include <linux/reservation.h>
 
 #include "tilcdc_drv.h"
 #include "tilcdc_regs.h"
@@ -34,11 +37,27 @@ struct tilcdc_crtc {
 	spinlock_t irq_lock;
 	int dma_completed_channel;
 
+	/* fb being latched into the scanout channels: */
+	struct drm_framebuffer *fb;
+
 	/* fb currently set to scanout 0/1: */
 	struct drm_framebuffer *scanout[2];
 
+	/* flip waiting for the exclusive fence of an imported fb: */
+	struct drm_framebuffer *next_fb;
+	struct fence_cb fence_cb;
+	struct work_struct flip_work;
+
 	/* for deferred fb unref's: */
 	struct drm_flip_work unref_work;
+
+	/* DMA burst size and FIFO threshold in use, raised on underflow: */
+	uint32_t dma_burst, fifo_th;
+
+	/* error counters, shown in debugfs: */
+	unsigned int fifo_underflows;
+	unsigned int sync_lost;
+	unsigned int recoveries;
 };
 #define to_tilcdc_crtc(x) container_of(x, struct tilcdc_crtc, base)
 
@@ -77,19 +96,20 @@ static void set_scanout(struct drm_crtc *crtc, int n)
 		drm_flip_work_queue(&tilcdc_crtc->unref_work, tilcdc_crtc->scanout[n]);
 		drm_flip_work_commit(&tilcdc_crtc->unref_work, priv->wq);
 	}
-	tilcdc_crtc->scanout[n] = crtc->primary->fb;
+	tilcdc_crtc->scanout[n] = tilcdc_crtc->fb;
 	drm_framebuffer_reference(tilcdc_crtc->scanout[n]);
 	tilcdc_crtc->dirty &= ~stat[n];
 	pm_runtime_put_sync(dev->dev);
 }
 
-static void update_scanout(struct drm_crtc *crtc)
+static void update_scanout(struct drm_crtc *crtc, struct drm_framebuffer *fb)
 {
 	struct tilcdc_crtc *tilcdc_crtc = to_tilcdc_crtc(crtc);
-	struct drm_framebuffer *fb = crtc->primary->fb;
 	struct drm_gem_cma_object *gem;
 	unsigned int depth, bpp;
 
+	tilcdc_crtc->fb = fb;
+
 	drm_fb_get_bpp_depth(fb->pixel_format, &depth, &bpp);
 	gem = drm_fb_cma_get_gem_obj(fb, 0);
 
@@ -143,6 +163,40 @@ static void start(struct drm_crtc *crtc)
 	tilcdc_set(dev, LCDC_RASTER_CTRL_REG, LCDC_RASTER_ENABLE);
 }
 
+static void set_dma_ctrl(struct drm_crtc *crtc)
+{
+	struct tilcdc_crtc *tilcdc_crtc = to_tilcdc_crtc(crtc);
+	struct drm_device *dev = crtc->dev;
+	uint32_t reg;
+
+	reg = tilcdc_read(dev, LCDC_DMA_CTRL_REG) & ~LCDC_DMA_BURST_FIFO_MASK;
+	reg |= LCDC_DMA_BURST_SIZE(tilcdc_crtc->dma_burst);
+	reg |= LCDC_DMA_FIFO_THRESHOLD(tilcdc_crtc->fifo_th);
+	tilcdc_write(dev, LCDC_DMA_CTRL_REG, reg);
+}
+
+/*
+ * After a FIFO underflow, give the DMA more slack against DDR contention:
+ * first longer bursts, then a higher FIFO threshold.  Must be called with
+ * the raster stopped.
+ */
+static void raise_dma_ctrl(struct drm_crtc *crtc)
+{
+	struct tilcdc_crtc *tilcdc_crtc = to_tilcdc_crtc(crtc);
+	struct drm_device *dev = crtc->dev;
+
+	if (tilcdc_crtc->dma_burst < LCDC_DMA_BURST_16)
+		tilcdc_crtc->dma_burst++;
+	else if (tilcdc_crtc->fifo_th < LCDC_DMA_FIFO_THRESHOLD_MAX)
+		tilcdc_crtc->fifo_th++;
+	else
+		return;
+
+	dev_info(dev->dev, "FIFO underflow: DMA burst %u, FIFO threshold %u\n",
+		 1 << tilcdc_crtc->dma_burst, 8 << tilcdc_crtc->fifo_th);
+	set_dma_ctrl(crtc);
+}
+
 static void stop(struct drm_crtc *crtc)
 {
 	struct drm_device *dev = crtc->dev;
@@ -156,6 +210,7 @@ static void tilcdc_crtc_destroy(struct drm_crtc *crtc)
 
 	WARN_ON(tilcdc_crtc->dpms == DRM_MODE_DPMS_ON);
 
+	flush_work(&tilcdc_crtc->flip_work);
 	drm_crtc_cleanup(crtc);
 	drm_flip_work_cleanup(&tilcdc_crtc->unref_work);
 
@@ -178,6 +233,58 @@ static int tilcdc_verify_fb(struct drm_crtc *crtc, struct drm_framebuffer *fb)
 	return 0;
 }
 
+/*
+ * Buffers imported from the GPU may still be rendered to when the flip is
+ * requested; return the exclusive fence to wait for, if it is pending.
+ */
+static struct fence *tilcdc_fb_get_fence(struct drm_framebuffer *fb)
+{
+	struct drm_gem_cma_object *gem = drm_fb_cma_get_gem_obj(fb, 0);
+	struct dma_buf_attachment *attach = gem->base.import_attach;
+	struct fence *fence;
+
+	if (!attach || !attach->dmabuf->resv)
+		return NULL;
+
+	rcu_read_lock();
+	fence = rcu_dereference(attach->dmabuf->resv->fence_excl);
+	if (fence)
+		fence = fence_get_rcu(fence);
+	rcu_read_unlock();
+
+	if (fence && fence_is_signaled(fence)) {
+		fence_put(fence);
+		fence = NULL;
+	}
+
+	return fence;
+}
+
+static void tilcdc_crtc_flip_worker(struct work_struct *work)
+{
+	struct tilcdc_crtc *tilcdc_crtc =
+		container_of(work, struct tilcdc_crtc, flip_work);
+	struct drm_crtc *crtc = &tilcdc_crtc->base;
+	struct tilcdc_drm_private *priv = crtc->dev->dev_private;
+	struct drm_framebuffer *fb = tilcdc_crtc->next_fb;
+
+	update_scanout(crtc, fb);
+	tilcdc_crtc->next_fb = NULL;
+
+	/* the scanout channels hold their own references now */
+	drm_flip_work_queue(&tilcdc_crtc->unref_work, fb);
+	drm_flip_work_commit(&tilcdc_crtc->unref_work, priv->wq);
+}
+
+static void tilcdc_crtc_fence_cb(struct fence *fence, struct fence_cb *cb)
+{
+	struct tilcdc_crtc *tilcdc_crtc =
+		container_of(cb, struct tilcdc_crtc, fence_cb);
+	struct tilcdc_drm_private *priv = tilcdc_crtc->base.dev->dev_private;
+
+	queue_work(priv->wq, &tilcdc_crtc->flip_work);
+}
+
 static int tilcdc_crtc_page_flip(struct drm_crtc *crtc,
 		struct drm_framebuffer *fb,
 		struct drm_pending_vblank_event *event,
@@ -185,20 +292,39 @@ static int tilcdc_crtc_page_flip(struct drm_crtc *crtc,
 {
 	struct tilcdc_crtc *tilcdc_crtc = to_tilcdc_crtc(crtc);
 	struct drm_device *dev = crtc->dev;
+	struct tilcdc_drm_private *priv = dev->dev_private;
+	struct fence *fence;
 	int r;
 
 	r = tilcdc_verify_fb(crtc, fb);
 	if (r)
 		return r;
 
-	if (tilcdc_crtc->event) {
+	if (tilcdc_crtc->event || tilcdc_crtc->next_fb) {
 		dev_err(dev->dev, "already pending page flip!\n");
 		return -EBUSY;
 	}
 
 	crtc->primary->fb = fb;
 	tilcdc_crtc->event = event;
-	update_scanout(crtc);
+
+	/*
+	 * Don't block the caller on the GPU: latch the new fb from the
+	 * fence callback once rendering to it is done.
+	 */
+	fence = tilcdc_fb_get_fence(fb);
+	if (fence) {
+		drm_framebuffer_reference(fb);
+		tilcdc_crtc->next_fb = fb;
+		r = fence_add_callback(fence, &tilcdc_crtc->fence_cb,
+				       tilcdc_crtc_fence_cb);
+		if (r == -ENOENT)
+			queue_work(priv->wq, &tilcdc_crtc->flip_work);
+		fence_put(fence);
+		return 0;
+	}
+
+	update_scanout(crtc, fb);
 
 	return 0;
 }
@@ -288,29 +414,32 @@ static int tilcdc_crtc_mode_set(struct drm_crtc *crtc,
 
 	pm_runtime_get_sync(dev->dev);
 
-	/* Configure the Burst Size and fifo threshold of DMA: */
-	reg = tilcdc_read(dev, LCDC_DMA_CTRL_REG) & ~0x00000770;
+	/*
+	 * Configure the Burst Size and fifo threshold of DMA.  Values
+	 * raised after FIFO underflows are kept across mode sets.
+	 */
 	switch (info->dma_burst_sz) {
 	case 1:
-		reg |= LCDC_DMA_BURST_SIZE(LCDC_DMA_BURST_1);
+		reg = LCDC_DMA_BURST_1;
 		break;
 	case 2:
-		reg |= LCDC_DMA_BURST_SIZE(LCDC_DMA_BURST_2);
+		reg = LCDC_DMA_BURST_2;
 		break;
 	case 4:
-		reg |= LCDC_DMA_BURST_SIZE(LCDC_DMA_BURST_4);
+		reg = LCDC_DMA_BURST_4;
 		break;
 	case 8:
-		reg |= LCDC_DMA_BURST_SIZE(LCDC_DMA_BURST_8);
+		reg = LCDC_DMA_BURST_8;
 		break;
 	case 16:
-		reg |= LCDC_DMA_BURST_SIZE(LCDC_DMA_BURST_16);
+		reg = LCDC_DMA_BURST_16;
 		break;
 	default:
 		return -EINVAL;
 	}
-	reg |= (info->fifo_th << 8);
-	tilcdc_write(dev, LCDC_DMA_CTRL_REG, reg);
+	tilcdc_crtc->dma_burst = max(tilcdc_crtc->dma_burst, reg);
+	tilcdc_crtc->fifo_th = max(tilcdc_crtc->fifo_th, info->fifo_th);
+	set_dma_ctrl(crtc);
 
 	/* Configure timings: */
 	hbp = mode->htotal - mode->hsync_end;
@@ -434,7 +563,7 @@ static int tilcdc_crtc_mode_set(struct drm_crtc *crtc,
 		tilcdc_clear(dev, LCDC_RASTER_CTRL_REG, LCDC_RASTER_ORDER);
 
 
-	update_scanout(crtc);
+	update_scanout(crtc, crtc->primary->fb);
 	tilcdc_crtc_update_clk(crtc);
 
 	pm_runtime_put_sync(dev->dev);
@@ -451,7 +580,7 @@ static int tilcdc_crtc_mode_set_base(struct drm_crtc *crtc, int x, int y,
 	if (r)
 		return r;
 
-	update_scanout(crtc);
+	update_scanout(crtc, crtc->primary->fb);
 	return 0;
 }
 
@@ -631,10 +760,17 @@ irqreturn_t tilcdc_crtc_irq(struct drm_crtc *crtc)
 	uint32_t stat = tilcdc_read_irqstatus(dev);
 	unsigned long irq_flags;
 
+	if (stat & LCDC_FIFO_UNDERFLOW)
+		tilcdc_crtc->fifo_underflows++;
+	if (stat & LCDC_SYNC_LOST)
+		tilcdc_crtc->sync_lost++;
+
 	if ((stat & LCDC_SYNC_LOST) && (stat & LCDC_FIFO_UNDERFLOW)) {
 		stop(crtc);
 		dev_err(dev->dev, "error: %08x\n", stat);
 		tilcdc_clear_irqstatus(dev, stat);
+		tilcdc_crtc->recoveries++;
+		raise_dma_ctrl(crtc);
 		start(crtc);
 	} else if (stat & LCDC_PL_LOAD_DONE) {
 		tilcdc_clear_irqstatus(dev, stat);
@@ -663,11 +799,13 @@ irqreturn_t tilcdc_crtc_irq(struct drm_crtc *crtc)
 
 		drm_handle_vblank(dev, 0);
 
+		/* a flip still waiting for its fence completes later */
 		spin_lock_irqsave(&dev->event_lock, flags);
 		event = tilcdc_crtc->event;
-		tilcdc_crtc->event = NULL;
-		if (event)
+		if (event && !tilcdc_crtc->next_fb) {
+			tilcdc_crtc->event = NULL;
 			drm_send_vblank_event(dev, 0, event);
+		}
 		spin_unlock_irqrestore(&dev->event_lock, flags);
 
 	}
@@ -683,6 +821,19 @@ irqreturn_t tilcdc_crtc_irq(struct drm_crtc *crtc)
 	return IRQ_HANDLED;
 }
 
+#ifdef CONFIG_DEBUG_FS
+void tilcdc_crtc_show_stats(struct drm_crtc *crtc, struct seq_file *m)
+{
+	struct tilcdc_crtc *tilcdc_crtc = to_tilcdc_crtc(crtc);
+
+	seq_printf(m, "fifo underflows:\t%u\n", tilcdc_crtc->fifo_underflows);
+	seq_printf(m, "sync lost:\t\t%u\n", tilcdc_crtc->sync_lost);
+	seq_printf(m, "recoveries:\t\t%u\n", tilcdc_crtc->recoveries);
+	seq_printf(m, "dma burst:\t\t%u\n", 1 << tilcdc_crtc->dma_burst);
+	seq_printf(m, "fifo threshold:\t\t%u\n", 8 << tilcdc_crtc->fifo_th);
+}
+#endif
+
 void tilcdc_crtc_cancel_page_flip(struct drm_crtc *crtc, struct drm_file *file)
 {
 	struct tilcdc_crtc *tilcdc_crtc = to_tilcdc_crtc(crtc);
@@ -721,6 +872,7 @@ struct drm_crtc *tilcdc_crtc_create(struct drm_device *dev)
 
 	drm_flip_work_init(&tilcdc_crtc->unref_work,
 			"unref", unref_worker);
+	INIT_WORK(&tilcdc_crtc->flip_work, tilcdc_crtc_flip_worker);
 
 	spin_lock_init(&tilcdc_crtc->irq_lock);
 
@@ -18,6 +18,8 @@
 /* LCDC DRM driver, based on da8xx-fb */
 
 #include <linux/pinctrl/consumer.h>
+#include <linux/mfd/syscon.h>
+#include <linux/regmap.h>
 #include <linux/suspend.h>
 #include "tilcdc_drv.h"
 #include "tilcdc_regs.h"
@@ -158,6 +160,45 @@ static int tilcdc_unload(struct drm_device *dev)
 
 static size_t tilcdc_num_regs(void);
 
+/*
+ * Optional "ti,init-priority = <&syscon offset mask value>": raise the
+ * LCDC's priority as an L3 initiator, so that heavy DMA from other
+ * masters cannot starve the display FIFO.
+ */
+static void tilcdc_get_init_priority(struct drm_device *dev)
+{
+	struct tilcdc_drm_private *priv = dev->dev_private;
+	struct device_node *node = dev->platformdev->dev.of_node;
+	struct regmap *syscon;
+	u32 args[3];
+
+	if (!of_find_property(node, "ti,init-priority", NULL))
+		return;
+
+	syscon = syscon_regmap_lookup_by_phandle(node, "ti,init-priority");
+	if (IS_ERR(syscon) ||
+	    of_property_read_u32_index(node, "ti,init-priority", 1, &args[0]) ||
+	    of_property_read_u32_index(node, "ti,init-priority", 2, &args[1]) ||
+	    of_property_read_u32_index(node, "ti,init-priority", 3, &args[2])) {
+		dev_warn(dev->dev, "invalid ti,init-priority\n");
+		return;
+	}
+
+	priv->prio_syscon = syscon;
+	priv->prio_reg = args[0];
+	priv->prio_mask = args[1];
+	priv->prio_val = args[2];
+}
+
+static void tilcdc_set_init_priority(struct drm_device *dev)
+{
+	struct tilcdc_drm_private *priv = dev->dev_private;
+
+	if (priv->prio_syscon)
+		regmap_update_bits(priv->prio_syscon, priv->prio_reg,
+				   priv->prio_mask, priv->prio_val);
+}
+
 static int tilcdc_load(struct drm_device *dev, unsigned long flags)
 {
 	struct platform_device *pdev = dev->platformdev;
@@ -234,6 +275,9 @@ static int tilcdc_load(struct drm_device *dev, unsigned long flags)
 
 	DBG("Maximum Pixel Clock Value %dKHz", priv->max_pixelclock);
 
+	tilcdc_get_init_priority(dev);
+	tilcdc_set_init_priority(dev);
+
 	pm_runtime_enable(dev->dev);
 	pm_runtime_irq_safe(dev->dev);
 
@@ -483,8 +527,20 @@ static int tilcdc_mm_show(struct seq_file *m, void *arg)
 	return drm_mm_dump_table(m, &dev->vma_offset_manager->vm_addr_space_mm);
 }
 
+static int tilcdc_stats_show(struct seq_file *m, void *arg)
+{
+	struct drm_info_node *node = (struct drm_info_node *) m->private;
+	struct drm_device *dev = node->minor->dev;
+	struct tilcdc_drm_private *priv = dev->dev_private;
+
+	tilcdc_crtc_show_stats(priv->crtc, m);
+
+	return 0;
+}
+
 static struct drm_info_list tilcdc_debugfs_list[] = {
 		{ "regs", tilcdc_regs_show, 0 },
+		{ "stats", tilcdc_stats_show, 0 },
 		{ "mm",   tilcdc_mm_show,   0 },
 		{ "fb",   drm_fb_cma_debugfs_show, 0 },
 };
@@ -622,6 +678,9 @@ static int tilcdc_pm_resume(struct device *dev)
 	/* Select default pin state */
 	pinctrl_pm_select_default_state(dev);
 
+	/* the control module may have lost it in deep sleep */
+	tilcdc_set_init_priority(ddev);
+
 	if (priv->ctx_valid == true) {
 		/* Restore register state: */
 		for (i = 0; i < ARRAY_SIZE(registers); i++)
@@ -65,6 +65,10 @@ struct tilcdc_drm_private {
 	 */
 	uint32_t max_width;
 
+	/* optional L3 initiator priority, set from "ti,init-priority": */
+	struct regmap *prio_syscon;
+	u32 prio_reg, prio_mask, prio_val;
+
 	/* register contents saved across suspend/resume: */
 	u32 *saved_register;
 	bool ctx_valid;
@@ -168,6 +172,9 @@ void tilcdc_crtc_set_panel_info(struct drm_crtc *crtc,
 		const struct tilcdc_panel_info *info);
 int tilcdc_crtc_mode_valid(struct drm_crtc *crtc, struct drm_display_mode *mode);
 int tilcdc_crtc_max_width(struct drm_crtc *crtc);
+#ifdef CONFIG_DEBUG_FS
+void tilcdc_crtc_show_stats(struct drm_crtc *crtc, struct seq_file *m);
+#endif
 void tilcdc_crtc_dpms(struct drm_crtc *crtc, int mode);
 
 #endif /* __TILCDC_DRV_H__ */
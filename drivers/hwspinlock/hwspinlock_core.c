@@ -28,6 +28,9 @@
 #include <linux/pm_runtime.h>
 #include <linux/mutex.h>
 #include <linux/of.h>
+#include <linux/delay.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "hwspinlock_internal.h"
 
@@ -60,6 +63,61 @@ static RADIX_TREE(hwspinlock_tree, GFP_KERNEL);
  */
 static DEFINE_MUTEX(hwspinlock_tree_lock);
 
+/*
+ * How long a waiter that may sleep polls a taken lock before it starts
+ * sleeping between attempts. Remote cores are expected to hold their
+ * locks for a few microseconds at most.
+ */
+static unsigned int spin_us = 10;
+module_param(spin_us, uint, 0644);
+MODULE_PARM_DESC(spin_us, "Time in us to poll a taken lock before sleeping");
+
+/* the sleeps between attempts double from the first to the last */
+#define HWSPINLOCK_MIN_SLEEP_US	10
+#define HWSPINLOCK_MAX_SLEEP_US	1000
+
+#ifdef CONFIG_HWSPINLOCK_STATS
+/* these are called with hwlock->lock held, but for the timeouts */
+static inline void hwspin_stat_acquired(struct hwspinlock *hwlock)
+{
+	hwlock->stats.acquired++;
+	hwlock->stats.lock_ts = local_clock();
+}
+
+static inline void hwspin_stat_contended(struct hwspinlock *hwlock, u64 start)
+{
+	struct hwspinlock_stats *st = &hwlock->stats;
+	s64 wait = st->lock_ts - start;
+
+	/* a sleeping waiter may have moved to a CPU whose clock is behind */
+	if (wait < 0)
+		wait = 0;
+
+	st->contended++;
+	st->total_wait_ns += wait;
+	st->max_wait_ns = max_t(u64, st->max_wait_ns, wait);
+}
+
+static inline void hwspin_stat_released(struct hwspinlock *hwlock)
+{
+	struct hwspinlock_stats *st = &hwlock->stats;
+
+	st->max_hold_ns = max_t(u64, st->max_hold_ns,
+				local_clock() - st->lock_ts);
+}
+
+static inline void hwspin_stat_timeout(struct hwspinlock *hwlock)
+{
+	atomic_inc(&hwlock->stats.timeouts);
+}
+#else
+static inline void hwspin_stat_acquired(struct hwspinlock *hwlock) { }
+static inline void hwspin_stat_contended(struct hwspinlock *hwlock,
+					 u64 start) { }
+static inline void hwspin_stat_released(struct hwspinlock *hwlock) { }
+static inline void hwspin_stat_timeout(struct hwspinlock *hwlock) { }
+#endif
+
 
 /**
  * __hwspin_trylock() - attempt to lock a specific hwspinlock
@@ -144,10 +202,64 @@ int __hwspin_trylock(struct hwspinlock *hwlock, int mode, unsigned long *flags)
 	 */
 	mb();
 
+	hwspin_stat_acquired(hwlock);
+
 	return 0;
 }
 EXPORT_SYMBOL_GPL(__hwspin_trylock);
 
+static int hwspin_lock_wait(struct hwspinlock *hwlock, unsigned int to,
+			    int mode, unsigned long *flags, bool can_sleep)
+{
+	unsigned int sleep_us = HWSPINLOCK_MIN_SLEEP_US;
+	u64 start = 0, spin_end = 0;
+	unsigned long expire;
+	int ret;
+
+	expire = msecs_to_jiffies(to) + jiffies;
+
+	for (;;) {
+		/* Try to take the hwspinlock */
+		ret = __hwspin_trylock(hwlock, mode, flags);
+		if (ret != -EBUSY)
+			break;
+
+		if (!start) {
+			start = local_clock();
+			spin_end = start + (u64)spin_us * NSEC_PER_USEC;
+		}
+
+		/*
+		 * The lock is already taken, let's check if the user wants
+		 * us to try again
+		 */
+		if (time_is_before_eq_jiffies(expire)) {
+			hwspin_stat_timeout(hwlock);
+			return -ETIMEDOUT;
+		}
+
+		/* the lock is held for long, stop hogging this CPU */
+		if (can_sleep && local_clock() >= spin_end) {
+			usleep_range(sleep_us, 2 * sleep_us);
+			sleep_us = min_t(unsigned int, 2 * sleep_us,
+					 HWSPINLOCK_MAX_SLEEP_US);
+			continue;
+		}
+
+		/*
+		 * Allow platform-specific relax handlers to prevent
+		 * hogging the interconnect (no sleeping, though)
+		 */
+		if (hwlock->bank->ops->relax)
+			hwlock->bank->ops->relax(hwlock);
+	}
+
+	if (!ret && start)
+		hwspin_stat_contended(hwlock, start);
+
+	return ret;
+}
+
 /**
  * __hwspin_lock_timeout() - lock an hwspinlock with timeout limit
  * @hwlock: the hwspinlock to be locked
@@ -178,35 +290,34 @@ EXPORT_SYMBOL_GPL(__hwspin_trylock);
 int __hwspin_lock_timeout(struct hwspinlock *hwlock, unsigned int to,
 					int mode, unsigned long *flags)
 {
-	int ret;
-	unsigned long expire;
-
-	expire = msecs_to_jiffies(to) + jiffies;
-
-	for (;;) {
-		/* Try to take the hwspinlock */
-		ret = __hwspin_trylock(hwlock, mode, flags);
-		if (ret != -EBUSY)
-			break;
-
-		/*
-		 * The lock is already taken, let's check if the user wants
-		 * us to try again
-		 */
-		if (time_is_before_eq_jiffies(expire))
-			return -ETIMEDOUT;
+	return hwspin_lock_wait(hwlock, to, mode, flags, false);
+}
+EXPORT_SYMBOL_GPL(__hwspin_lock_timeout);
 
-		/*
-		 * Allow platform-specific relax handlers to prevent
-		 * hogging the interconnect (no sleeping, though)
-		 */
-		if (hwlock->bank->ops->relax)
-			hwlock->bank->ops->relax(hwlock);
-	}
+/**
+ * __hwspin_lock_timeout_sleep() - lock an hwspinlock, sleeping while waiting
+ * @hwlock: the hwspinlock to be locked
+ * @timeout: timeout value in msecs
+ * @mode: mode which controls whether local interrupts are disabled or not
+ * @flags: a pointer to where the caller's interrupt state will be saved at (if
+ *         requested)
+ *
+ * Same as __hwspin_lock_timeout(), but if the @hwlock is still taken after
+ * polling it for spin_us microseconds, the caller sleeps between attempts,
+ * 10us at first and doubling up to 1ms. Only for callers that may sleep.
+ *
+ * Returns 0 when the @hwlock was successfully taken, and an appropriate
+ * error code otherwise (most notably -ETIMEDOUT if the @hwlock is still
+ * busy after @timeout msecs).
+ */
+int __hwspin_lock_timeout_sleep(struct hwspinlock *hwlock, unsigned int to,
+					int mode, unsigned long *flags)
+{
+	might_sleep();
 
-	return ret;
+	return hwspin_lock_wait(hwlock, to, mode, flags, true);
 }
-EXPORT_SYMBOL_GPL(__hwspin_lock_timeout);
+EXPORT_SYMBOL_GPL(__hwspin_lock_timeout_sleep);
 
 /**
  * __hwspin_unlock() - unlock a specific hwspinlock
@@ -246,6 +357,7 @@ void __hwspin_unlock(struct hwspinlock *hwlock, int mode, unsigned long *flags)
 	 */
 	mb();
 
+	hwspin_stat_released(hwlock);
 	hwlock->bank->ops->unlock(hwlock);
 
 	/* Undo the spin_trylock{_irq, _irqsave} called while locking */
@@ -675,6 +787,101 @@ out:
 }
 EXPORT_SYMBOL_GPL(hwspin_lock_free);
 
+#ifdef CONFIG_HWSPINLOCK_STATS
+static struct dentry *hwspinlock_debugfs_dir;
+
+static int hwspin_stats_show(struct seq_file *s, void *unused)
+{
+	struct radix_tree_iter iter;
+	void **slot;
+
+	seq_puts(s, "id       acquired    contended timeouts  wait_avg_ns  wait_max_ns  hold_max_ns\n");
+
+	mutex_lock(&hwspinlock_tree_lock);
+	radix_tree_for_each_slot(slot, &hwspinlock_tree, &iter, 0) {
+		struct hwspinlock *hwlock = radix_tree_deref_slot(slot);
+		struct hwspinlock_stats st;
+		unsigned long flags;
+		u64 avg = 0;
+
+		/* a consistent snapshot, the lock is held for short anyway */
+		spin_lock_irqsave(&hwlock->lock, flags);
+		st = hwlock->stats;
+		spin_unlock_irqrestore(&hwlock->lock, flags);
+
+		if (st.contended)
+			avg = div64_u64(st.total_wait_ns, st.contended);
+
+		seq_printf(s, "%-4d %12llu %12llu %8d %12llu %12llu %12llu\n",
+			   hwlock_to_id(hwlock), st.acquired, st.contended,
+			   atomic_read(&st.timeouts), avg, st.max_wait_ns,
+			   st.max_hold_ns);
+	}
+	mutex_unlock(&hwspinlock_tree_lock);
+
+	return 0;
+}
+
+static ssize_t hwspin_stats_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct radix_tree_iter iter;
+	void **slot;
+
+	mutex_lock(&hwspinlock_tree_lock);
+	radix_tree_for_each_slot(slot, &hwspinlock_tree, &iter, 0) {
+		struct hwspinlock *hwlock = radix_tree_deref_slot(slot);
+		struct hwspinlock_stats *st = &hwlock->stats;
+		unsigned long flags;
+
+		/* lock_ts still counts for a lock held right now */
+		spin_lock_irqsave(&hwlock->lock, flags);
+		st->acquired = 0;
+		st->contended = 0;
+		atomic_set(&st->timeouts, 0);
+		st->total_wait_ns = 0;
+		st->max_wait_ns = 0;
+		st->max_hold_ns = 0;
+		spin_unlock_irqrestore(&hwlock->lock, flags);
+	}
+	mutex_unlock(&hwspinlock_tree_lock);
+
+	return count;
+}
+
+static int hwspin_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hwspin_stats_show, inode->i_private);
+}
+
+static const struct file_operations hwspin_stats_fops = {
+	.open		= hwspin_stats_open,
+	.read		= seq_read,
+	.write		= hwspin_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init hwspinlock_debugfs_init(void)
+{
+	hwspinlock_debugfs_dir = debugfs_create_dir("hwspinlock", NULL);
+	if (!hwspinlock_debugfs_dir)
+		return 0;
+
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, hwspinlock_debugfs_dir,
+			    NULL, &hwspin_stats_fops);
+
+	return 0;
+}
+module_init(hwspinlock_debugfs_init);
+
+static void __exit hwspinlock_debugfs_exit(void)
+{
+	debugfs_remove_recursive(hwspinlock_debugfs_dir);
+}
+module_exit(hwspinlock_debugfs_exit);
+#endif
+
 MODULE_LICENSE("GPL v2");
 MODULE_DESCRIPTION("Hardware spinlock interface");
 MODULE_AUTHOR("Ohad Ben-Cohen <ohad@wizery.com>");
@@ -39,16 +39,42 @@ struct hwspinlock_ops {
 	void (*relax)(struct hwspinlock *lock);
 };
 
+/**
+ * struct hwspinlock_stats - usage statistics of a hwspinlock
+ * @acquired: number of times the lock was taken
+ * @contended: number of those that found it taken and had to wait
+ * @timeouts: number of waits that gave up
+ * @total_wait_ns: time spent waiting by the contended acquisitions
+ * @max_wait_ns: longest contended acquisition
+ * @max_hold_ns: longest time the lock was held by this host
+ * @lock_ts: when the lock was last taken
+ *
+ * All but @timeouts are only updated with the lock held.
+ */
+struct hwspinlock_stats {
+	u64 acquired;
+	u64 contended;
+	atomic_t timeouts;
+	u64 total_wait_ns;
+	u64 max_wait_ns;
+	u64 max_hold_ns;
+	u64 lock_ts;
+};
+
 /**
  * struct hwspinlock - this struct represents a single hwspinlock instance
  * @bank: the hwspinlock_device structure which owns this lock
  * @lock: initialized and used by hwspinlock core
  * @priv: private data, owned by the underlying platform-specific hwspinlock drv
+ * @stats: usage statistics, kept by hwspinlock core
  */
 struct hwspinlock {
 	struct hwspinlock_device *bank;
 	spinlock_t lock;
 	void *priv;
+#ifdef CONFIG_HWSPINLOCK_STATS
+	struct hwspinlock_stats stats;
+#endif
 };
 
 /**
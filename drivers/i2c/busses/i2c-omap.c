@@ -30,6 +30,9 @@
 #include <linux/err.h>
 #include <linux/interrupt.h>
 #include <linux/completion.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/sched.h>
 #include <linux/platform_device.h>
 #include <linux/clk.h>
 #include <linux/io.h>
@@ -58,6 +61,15 @@
 /* timeout for making decision on bus free status */
 #define OMAP_I2C_BUS_FREE_TIMEOUT (msecs_to_jiffies(10))
 
+/*
+ * Messages at least this long are moved by DMA when the controller has
+ * channels, shorter ones are cheaper through the FIFO threshold interrupts.
+ * The "ti,dma-min-bytes" property overrides the default per controller.
+ */
+static unsigned int dma_min_bytes = 64;
+module_param(dma_min_bytes, uint, 0444);
+MODULE_PARM_DESC(dma_min_bytes, "smallest message moved by DMA, in bytes");
+
 /* For OMAP3 I2C_IV has changed to I2C_WE (wakeup enable) */
 enum {
 	OMAP_I2C_REV_REG = 0,
@@ -84,6 +96,10 @@ enum {
 	OMAP_I2C_IP_V2_IRQSTATUS_RAW,
 	OMAP_I2C_IP_V2_IRQENABLE_SET,
 	OMAP_I2C_IP_V2_IRQENABLE_CLR,
+	OMAP_I2C_IP_V2_DMARXENABLE_SET,
+	OMAP_I2C_IP_V2_DMATXENABLE_SET,
+	OMAP_I2C_IP_V2_DMARXENABLE_CLR,
+	OMAP_I2C_IP_V2_DMATXENABLE_CLR,
 };
 
 /* I2C Interrupt Enable Register (OMAP_I2C_IE): */
@@ -95,6 +111,10 @@ enum {
 #define OMAP_I2C_IE_NACK	(1 << 1)	/* No ack interrupt enable */
 #define OMAP_I2C_IE_AL		(1 << 0)	/* Arbitration lost int ena */
 
+/* data interrupts, masked while DMA moves the data */
+#define OMAP_I2C_IE_DATA	(OMAP_I2C_IE_XDR | OMAP_I2C_IE_RDR | \
+				 OMAP_I2C_IE_XRDY | OMAP_I2C_IE_RRDY)
+
 /* I2C Status Register (OMAP_I2C_STAT): */
 #define OMAP_I2C_STAT_XDR	(1 << 14)	/* TX Buffer draining */
 #define OMAP_I2C_STAT_RDR	(1 << 13)	/* RX Buffer draining */
@@ -221,6 +241,17 @@ struct omap_i2c_dev {
 	u16			syscstate;
 	u16			westate;
 	u16			errata;
+
+	/* DMA, only on the IP v2 controllers */
+	struct dma_chan		*dma_rx;
+	struct dma_chan		*dma_tx;
+	struct dma_chan		*dma_chan;	/* active, NULL for PIO */
+	struct completion	dma_complete;
+	dma_addr_t		dma_addr;
+	size_t			dma_len;
+	enum dma_data_direction	dma_dir;
+	phys_addr_t		data_phys;	/* data register */
+	u32			dma_min_bytes;
 };
 
 static const u8 reg_map_ip_v1[] = {
@@ -268,6 +299,10 @@ static const u8 reg_map_ip_v2[] = {
 	[OMAP_I2C_IP_V2_IRQSTATUS_RAW] = 0x24,
 	[OMAP_I2C_IP_V2_IRQENABLE_SET] = 0x2c,
 	[OMAP_I2C_IP_V2_IRQENABLE_CLR] = 0x30,
+	[OMAP_I2C_IP_V2_DMARXENABLE_SET] = 0x38,
+	[OMAP_I2C_IP_V2_DMATXENABLE_SET] = 0x3c,
+	[OMAP_I2C_IP_V2_DMARXENABLE_CLR] = 0x40,
+	[OMAP_I2C_IP_V2_DMATXENABLE_CLR] = 0x44,
 };
 
 static inline void omap_i2c_write_reg(struct omap_i2c_dev *i2c_dev,
@@ -614,6 +649,120 @@ static void omap_i2c_resize_fifo(struct omap_i2c_dev *dev, u8 size, bool is_rx)
 			(1000 * dev->speed / 8);
 }
 
+static bool omap_i2c_use_dma(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	struct dma_chan *chan;
+
+	chan = (msg->flags & I2C_M_RD) ? dev->dma_rx : dev->dma_tx;
+
+	/* i2c_msg buffers are not guaranteed to be DMA safe */
+	return chan && msg->len >= dev->dma_min_bytes &&
+	       virt_addr_valid(msg->buf) && !object_is_on_stack(msg->buf);
+}
+
+static void omap_i2c_dma_callback(void *data)
+{
+	struct omap_i2c_dev *dev = data;
+
+	complete(&dev->dma_complete);
+}
+
+/*
+ * Queue the whole message on the DMA channel of its direction.  The FIFO
+ * threshold is one byte, so every byte raises a DMA request whatever the
+ * message length and the only interrupts left are the DMA completion and
+ * ARDY at the end of the message.
+ */
+static int omap_i2c_dma_start(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	struct dma_slave_config cfg = {
+		.src_addr = dev->data_phys,
+		.dst_addr = dev->data_phys,
+		.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE,
+		.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE,
+		.src_maxburst = 1,
+		.dst_maxburst = 1,
+	};
+	struct dma_async_tx_descriptor *desc;
+	struct dma_chan *chan;
+	int ret;
+
+	if (dev->receiver) {
+		chan = dev->dma_rx;
+		cfg.direction = DMA_DEV_TO_MEM;
+		dev->dma_dir = DMA_FROM_DEVICE;
+	} else {
+		chan = dev->dma_tx;
+		cfg.direction = DMA_MEM_TO_DEV;
+		dev->dma_dir = DMA_TO_DEVICE;
+	}
+
+	ret = dmaengine_slave_config(chan, &cfg);
+	if (ret)
+		return ret;
+
+	dev->dma_len = msg->len;
+	dev->dma_addr = dma_map_single(chan->device->dev, msg->buf,
+				       dev->dma_len, dev->dma_dir);
+	if (dma_mapping_error(chan->device->dev, dev->dma_addr))
+		return -ENOMEM;
+
+	desc = dmaengine_prep_slave_single(chan, dev->dma_addr, dev->dma_len,
+					   cfg.direction,
+					   DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc) {
+		dma_unmap_single(chan->device->dev, dev->dma_addr,
+				 dev->dma_len, dev->dma_dir);
+		return -EIO;
+	}
+
+	desc->callback = omap_i2c_dma_callback;
+	desc->callback_param = dev;
+	reinit_completion(&dev->dma_complete);
+	dmaengine_submit(desc);
+	dma_async_issue_pending(chan);
+
+	/* no data interrupts, the requests go to the DMA controller */
+	omap_i2c_write_reg(dev, OMAP_I2C_IP_V2_IRQENABLE_CLR, OMAP_I2C_IE_DATA);
+	omap_i2c_write_reg(dev, dev->receiver ?
+			   OMAP_I2C_IP_V2_DMARXENABLE_SET :
+			   OMAP_I2C_IP_V2_DMATXENABLE_SET, 1);
+
+	dev->dma_chan = chan;
+	return 0;
+}
+
+static int omap_i2c_dma_finish(struct omap_i2c_dev *dev, bool abort)
+{
+	struct dma_chan *chan = dev->dma_chan;
+	int ret = 0;
+	u16 w;
+
+	/* ARDY may beat the DMA completion of the last received bytes */
+	if (!abort && !wait_for_completion_timeout(&dev->dma_complete,
+						   OMAP_I2C_TIMEOUT)) {
+		dev_err(dev->dev, "DMA timed out\n");
+		ret = -ETIMEDOUT;
+		abort = true;
+	}
+	if (abort)
+		dmaengine_terminate_all(chan);
+
+	omap_i2c_write_reg(dev, dev->receiver ?
+			   OMAP_I2C_IP_V2_DMARXENABLE_CLR :
+			   OMAP_I2C_IP_V2_DMATXENABLE_CLR, 1);
+	w = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG);
+	w &= ~(OMAP_I2C_BUF_RDMA_EN | OMAP_I2C_BUF_XDMA_EN);
+	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, w);
+	omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, dev->iestate);
+
+	dma_unmap_single(chan->device->dev, dev->dma_addr, dev->dma_len,
+			 dev->dma_dir);
+	dev->dma_chan = NULL;
+
+	return ret;
+}
+
 /*
  * Low level master read/write transaction.
  */
@@ -622,6 +771,7 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 {
 	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
 	unsigned long timeout;
+	bool use_dma;
 	u16 w;
 
 	dev_dbg(dev->dev, "addr: 0x%04x, len: %d, flags: 0x%x, stop: %d\n",
@@ -631,7 +781,8 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 		return -EINVAL;
 
 	dev->receiver = !!(msg->flags & I2C_M_RD);
-	omap_i2c_resize_fifo(dev, msg->len, dev->receiver);
+	use_dma = omap_i2c_use_dma(dev, msg);
+	omap_i2c_resize_fifo(dev, use_dma ? 1 : msg->len, dev->receiver);
 
 	omap_i2c_write_reg(dev, OMAP_I2C_SA_REG, msg->addr);
 
@@ -652,6 +803,14 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	reinit_completion(&dev->cmd_complete);
 	dev->cmd_err = 0;
 
+	/* fall back to the interrupt driven path when DMA can't be set up */
+	if (use_dma && omap_i2c_dma_start(dev, msg) == 0) {
+		w = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG);
+		w |= dev->receiver ? OMAP_I2C_BUF_RDMA_EN :
+				     OMAP_I2C_BUF_XDMA_EN;
+		omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, w);
+	}
+
 	w = OMAP_I2C_CON_EN | OMAP_I2C_CON_MST | OMAP_I2C_CON_STT;
 
 	/* High speed configuration */
@@ -687,6 +846,8 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 			if (time_after(jiffies, delay)) {
 				dev_err(dev->dev, "controller timed out "
 				"waiting for start condition to finish\n");
+				if (dev->dma_chan)
+					omap_i2c_dma_finish(dev, true);
 				return -ETIMEDOUT;
 			}
 			cpu_relax();
@@ -703,6 +864,15 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	 */
 	timeout = wait_for_completion_timeout(&dev->cmd_complete,
 						OMAP_I2C_TIMEOUT);
+	if (dev->dma_chan) {
+		int r = omap_i2c_dma_finish(dev, !timeout || dev->cmd_err);
+
+		if (r && timeout) {
+			omap_i2c_reset(dev);
+			__omap_i2c_init(dev);
+			return r;
+		}
+	}
 	if (timeout == 0) {
 		dev_err(dev->dev, "controller timed out\n");
 		omap_i2c_reset(dev);
@@ -1281,6 +1451,30 @@ static struct i2c_bus_recovery_info omap_i2c_bus_recovery_info = {
 	.recover_bus		= i2c_generic_scl_recovery,
 };
 
+static void omap_i2c_request_dma(struct omap_i2c_dev *dev,
+				 struct resource *mem)
+{
+	dev->dma_rx = dma_request_slave_channel(dev->dev, "rx");
+	dev->dma_tx = dma_request_slave_channel(dev->dev, "tx");
+	dev->data_phys = mem->start +
+		(dev->regs[OMAP_I2C_DATA_REG] << dev->reg_shift);
+	init_completion(&dev->dma_complete);
+
+	if (dev->dma_rx || dev->dma_tx)
+		dev_dbg(dev->dev, "DMA for messages of %u bytes or more\n",
+			dev->dma_min_bytes);
+}
+
+static void omap_i2c_release_dma(struct omap_i2c_dev *dev)
+{
+	if (dev->dma_rx)
+		dma_release_channel(dev->dma_rx);
+	if (dev->dma_tx)
+		dma_release_channel(dev->dma_tx);
+	dev->dma_rx = NULL;
+	dev->dma_tx = NULL;
+}
+
 static int
 omap_i2c_probe(struct platform_device *pdev)
 {
@@ -1321,6 +1515,10 @@ omap_i2c_probe(struct platform_device *pdev)
 		of_property_read_u32(node, "clock-frequency", &freq);
 		/* convert DT freq value in Hz into kHz for speed */
 		dev->speed = freq / 1000;
+
+		dev->dma_min_bytes = dma_min_bytes;
+		of_property_read_u32(node, "ti,dma-min-bytes",
+				     &dev->dma_min_bytes);
 	} else if (pdata != NULL) {
 		dev->speed = pdata->clkrate;
 		dev->flags = pdata->flags;
@@ -1403,6 +1601,10 @@ omap_i2c_probe(struct platform_device *pdev)
 		if (dev->set_mpu_wkup_lat != NULL)
 			dev->latency = (1000000 * dev->fifo_size) /
 				       (1000 * dev->speed / 8);
+
+		/* the DMA request lines are described in DT only */
+		if (dev->scheme == OMAP_I2C_SCHEME_1 && node)
+			omap_i2c_request_dma(dev, mem);
 	}
 
 	/* reset ASAP, clearing any IRQs */
@@ -1449,6 +1651,7 @@ omap_i2c_probe(struct platform_device *pdev)
 	return 0;
 
 err_unuse_clocks:
+	omap_i2c_release_dma(dev);
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
 	pm_runtime_put(dev->dev);
 	pm_runtime_disable(&pdev->dev);
@@ -1470,6 +1673,7 @@ static int omap_i2c_remove(struct platform_device *pdev)
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
 	pm_runtime_put(&pdev->dev);
 	pm_runtime_disable(&pdev->dev);
+	omap_i2c_release_dma(dev);
 	return 0;
 }
 
@@ -15,28 +15,59 @@
 
 #include <linux/kernel.h>
 #include <linux/err.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/interrupt.h>
 #include <linux/platform_device.h>
 #include <linux/io.h>
 #include <linux/iio/iio.h>
+#include <linux/iio/sysfs.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
 #include <linux/iio/machine.h>
 #include <linux/iio/driver.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/sizes.h>
 
 #include <linux/mfd/ti_am335x_tscadc.h>
 #include <linux/iio/buffer.h>
 #include <linux/iio/kfifo_buf.h>
 
+#define DMA_BUFFER_SIZE		SZ_8K
+
+/* ADC clocks taken by the sampling and conversion of one sample */
+#define TIADC_CONV_CYCLES	(1 + 13)
+
+/*
+ * FIFO1 drained by a cyclic transfer into a two period buffer, used when the
+ * tscadc node has a "fifo1" DMA channel.
+ */
+struct tiadc_dma {
+	struct dma_slave_config	conf;
+	struct dma_chan		*chan;
+	dma_addr_t		addr;
+	dma_cookie_t		cookie;
+	u8			*buf;
+	int			current_period;
+	int			period_size;
+	u8			fifo_thresh;
+};
+
 struct tiadc_device {
 	struct ti_tscadc_dev *mfd_tscadc;
+	struct tiadc_dma dma;
 	int channels;
+	int total_ch_enabled;
 	u8 channel_line[8];
 	u8 channel_step[8];
 	int buffer_en_ch_steps;
-	u16 data[8];
+	/* up to 8 samples and the timestamp */
+	u16 data[8 + sizeof(s64) / sizeof(u16)] __aligned(sizeof(s64));
+	s64 irq_timestamp;
+	s64 scan_period_ns;
 	u32 open_delay[8], sample_delay[8], step_avg[8];
 };
 
@@ -83,6 +114,51 @@ static u32 get_adc_step_bit(struct tiadc_device *adc_dev, int chan)
 	return 1 << adc_dev->channel_step[chan];
 }
 
+/* averaged samples of a step, step_avg is rounded down to a power of two */
+static unsigned int tiadc_step_avg(struct tiadc_device *adc_dev, int i)
+{
+	if (!adc_dev->step_avg[i])
+		return 1;
+	return 1 << (ffs(adc_dev->step_avg[i]) - 1);
+}
+
+/*
+ * ADC clocks taken by a step: the open delay once, then the sample delay and
+ * the conversion for every averaged sample.
+ */
+static unsigned int tiadc_step_cycles(struct tiadc_device *adc_dev, int i)
+{
+	return adc_dev->open_delay[i] + tiadc_step_avg(adc_dev, i) *
+		(adc_dev->sample_delay[i] + TIADC_CONV_CYCLES);
+}
+
+/*
+ * Stretch or shrink the open delay so that a step takes 1/@freq seconds,
+ * dropping the sample delay when the open delay alone is not enough.
+ */
+static int tiadc_set_step_freq(struct tiadc_device *adc_dev, int i, int freq)
+{
+	unsigned int avg = tiadc_step_avg(adc_dev, i);
+	unsigned int cycles, conv;
+
+	if (freq <= 0)
+		return -EINVAL;
+
+	cycles = DIV_ROUND_CLOSEST(ADC_CLK, freq);
+	conv = avg * (adc_dev->sample_delay[i] + TIADC_CONV_CYCLES);
+	if (cycles < conv) {
+		conv = avg * TIADC_CONV_CYCLES;
+		if (cycles < conv)
+			return -EINVAL;
+		adc_dev->sample_delay[i] = 0;
+	}
+
+	adc_dev->open_delay[i] = min_t(unsigned int, cycles - conv,
+				       STEPDELAY_OPEN_MASK);
+
+	return 0;
+}
+
 static void tiadc_step_config(struct iio_dev *indio_dev)
 {
 	struct tiadc_device *adc_dev = iio_priv(indio_dev);
@@ -157,6 +233,9 @@ static irqreturn_t tiadc_irq_h(int irq, void *private)
 	 * ADC and touchscreen share the IRQ line.
 	 * FIFO0 interrupts are used by TSC. Handle FIFO1 IRQs here only
 	 */
+	if (status & IRQENB_FIFO1THRES)
+		adc_dev->irq_timestamp = iio_get_time_ns();
+
 	if (status & IRQENB_FIFO1OVRRUN) {
 		/* FIFO Overrun. Clear flag. Disable/Enable ADC to recover */
 		config = tiadc_readl(adc_dev, REG_CTRL);
@@ -179,16 +258,26 @@ static irqreturn_t tiadc_worker_h(int irq, void *private)
 {
 	struct iio_dev *indio_dev = private;
 	struct tiadc_device *adc_dev = iio_priv(indio_dev);
+	int nch = adc_dev->total_ch_enabled;
 	int i, k, fifo1count, read;
 	u16 *data = adc_dev->data;
+	s64 ts;
 
 	fifo1count = tiadc_readl(adc_dev, REG_FIFO1CNT);
 	for (k = 0; k < fifo1count; k = k + i) {
-		for (i = 0; i < (indio_dev->scan_bytes)/2; i++) {
+		for (i = 0; i < nch; i++) {
 			read = tiadc_readl(adc_dev, REG_FIFO1);
 			data[i] = read & FIFOREAD_DATA_MASK;
 		}
-		iio_push_to_buffers(indio_dev, (u8 *) data);
+		/*
+		 * The threshold interrupt stamped sample FIFO1_THRESHOLD of
+		 * the FIFO, each scan is stamped with the time its last
+		 * sample completed, counted from there in sample periods.
+		 */
+		ts = adc_dev->irq_timestamp +
+			div_s64(adc_dev->scan_period_ns *
+				(k + nch - 1 - FIFO1_THRESHOLD), nch);
+		iio_push_to_buffers_with_timestamp(indio_dev, data, ts);
 	}
 
 	tiadc_writel(adc_dev, REG_IRQSTATUS, IRQENB_FIFO1THRES);
@@ -197,11 +286,79 @@ static irqreturn_t tiadc_worker_h(int irq, void *private)
 	return IRQ_HANDLED;
 }
 
+static void tiadc_dma_rx_complete(void *param)
+{
+	struct iio_dev *indio_dev = param;
+	struct tiadc_device *adc_dev = iio_priv(indio_dev);
+	struct tiadc_dma *dma = &adc_dev->dma;
+	size_t scan_size = adc_dev->total_ch_enabled * sizeof(u16);
+	int i, scans = dma->period_size / scan_size;
+	s64 now = iio_get_time_ns();
+	u8 *data;
+
+	data = dma->buf + dma->current_period * dma->period_size;
+	dma->current_period = 1 - dma->current_period; /* swap the buffer ID */
+
+	/* the last scan of the period completed just before this callback */
+	for (i = 0; i < scans; i++) {
+		memcpy(adc_dev->data, data, scan_size);
+		iio_push_to_buffers_with_timestamp(indio_dev, adc_dev->data,
+				now - (scans - 1 - i) * adc_dev->scan_period_ns);
+		data += scan_size;
+	}
+}
+
+static int tiadc_start_dma(struct iio_dev *indio_dev)
+{
+	struct tiadc_device *adc_dev = iio_priv(indio_dev);
+	struct tiadc_dma *dma = &adc_dev->dma;
+	struct dma_async_tx_descriptor *desc;
+
+	dma->current_period = 0; /* We start to fill period 0 */
+	/*
+	 * Make the fifo thresh a multiple of the number of enabled channels
+	 * and the period a multiple of the fifo thresh, so that every period
+	 * holds whole scans and the samples reported through
+	 * iio_push_to_buffers() are never shifted.
+	 */
+	dma->fifo_thresh = rounddown(FIFO1_THRESHOLD + 1,
+				     adc_dev->total_ch_enabled) - 1;
+	dma->period_size = rounddown(DMA_BUFFER_SIZE / 2,
+				     (dma->fifo_thresh + 1) * sizeof(u16));
+
+	dma->conf.src_maxburst = dma->fifo_thresh + 1;
+	dmaengine_slave_config(dma->chan, &dma->conf);
+
+	desc = dmaengine_prep_dma_cyclic(dma->chan, dma->addr,
+					 dma->period_size * 2,
+					 dma->period_size, DMA_DEV_TO_MEM,
+					 DMA_PREP_INTERRUPT);
+	if (!desc)
+		return -EBUSY;
+
+	desc->callback = tiadc_dma_rx_complete;
+	desc->callback_param = indio_dev;
+
+	dma->cookie = dmaengine_submit(desc);
+
+	dma_async_issue_pending(dma->chan);
+
+	tiadc_writel(adc_dev, REG_FIFO1THR, dma->fifo_thresh);
+	tiadc_writel(adc_dev, REG_DMA1REQ, dma->fifo_thresh);
+	tiadc_writel(adc_dev, REG_DMAENABLE_SET, DMA_FIFO1);
+
+	return 0;
+}
+
 static int tiadc_buffer_preenable(struct iio_dev *indio_dev)
 {
 	struct tiadc_device *adc_dev = iio_priv(indio_dev);
 	int i, fifo1count, read;
 
+	/* a scan of only the timestamp has nothing to pace it */
+	if (bitmap_empty(indio_dev->active_scan_mask, adc_dev->channels))
+		return -EINVAL;
+
 	tiadc_writel(adc_dev, REG_IRQCLR, (IRQENB_FIFO1THRES |
 				IRQENB_FIFO1OVRRUN |
 				IRQENB_FIFO1UNDRFLW));
@@ -217,20 +374,40 @@ static int tiadc_buffer_preenable(struct iio_dev *indio_dev)
 static int tiadc_buffer_postenable(struct iio_dev *indio_dev)
 {
 	struct tiadc_device *adc_dev = iio_priv(indio_dev);
+	struct tiadc_dma *dma = &adc_dev->dma;
+	unsigned int irq_enable;
 	unsigned int enb = 0;
 	u8 bit;
+	int ret;
 
 	tiadc_step_config(indio_dev);
-	for_each_set_bit(bit, indio_dev->active_scan_mask, adc_dev->channels)
+	adc_dev->total_ch_enabled = 0;
+	adc_dev->scan_period_ns = 0;
+	for_each_set_bit(bit, indio_dev->active_scan_mask, adc_dev->channels) {
 		enb |= (get_adc_step_bit(adc_dev, bit) << 1);
+		adc_dev->total_ch_enabled++;
+		adc_dev->scan_period_ns += tiadc_step_cycles(adc_dev, bit);
+	}
 	adc_dev->buffer_en_ch_steps = enb;
+	adc_dev->scan_period_ns = div_u64(adc_dev->scan_period_ns *
+					  NSEC_PER_SEC, ADC_CLK);
+
+	if (dma->chan) {
+		ret = tiadc_start_dma(indio_dev);
+		if (ret)
+			return ret;
+	}
 
 	am335x_tsc_se_set_cache(adc_dev->mfd_tscadc, enb);
 
 	tiadc_writel(adc_dev,  REG_IRQSTATUS, IRQENB_FIFO1THRES
 				| IRQENB_FIFO1OVRRUN | IRQENB_FIFO1UNDRFLW);
-	tiadc_writel(adc_dev,  REG_IRQENABLE, IRQENB_FIFO1THRES
-				| IRQENB_FIFO1OVRRUN);
+
+	/* with DMA the threshold only raises the DMA request */
+	irq_enable = IRQENB_FIFO1OVRRUN;
+	if (!dma->chan)
+		irq_enable |= IRQENB_FIFO1THRES;
+	tiadc_writel(adc_dev,  REG_IRQENABLE, irq_enable);
 
 	return 0;
 }
@@ -238,12 +415,20 @@ static int tiadc_buffer_postenable(struct iio_dev *indio_dev)
 static int tiadc_buffer_predisable(struct iio_dev *indio_dev)
 {
 	struct tiadc_device *adc_dev = iio_priv(indio_dev);
+	struct tiadc_dma *dma = &adc_dev->dma;
 	int fifo1count, i, read;
 
 	tiadc_writel(adc_dev, REG_IRQCLR, (IRQENB_FIFO1THRES |
 				IRQENB_FIFO1OVRRUN | IRQENB_FIFO1UNDRFLW));
 	am335x_tsc_se_clr(adc_dev->mfd_tscadc, adc_dev->buffer_en_ch_steps);
 	adc_dev->buffer_en_ch_steps = 0;
+	adc_dev->total_ch_enabled = 0;
+
+	if (dma->chan) {
+		tiadc_writel(adc_dev, REG_DMAENABLE_CLEAR, DMA_FIFO1);
+		dmaengine_terminate_all(dma->chan);
+		tiadc_writel(adc_dev, REG_FIFO1THR, FIFO1_THRESHOLD);
+	}
 
 	/* Flush FIFO of leftover data in the time it takes to disable adc */
 	fifo1count = tiadc_readl(adc_dev, REG_FIFO1CNT);
@@ -325,8 +510,9 @@ static int tiadc_channel_init(struct iio_dev *indio_dev, int channels)
 	struct iio_chan_spec *chan;
 	int i;
 
-	indio_dev->num_channels = channels;
-	chan_array = kcalloc(channels,
+	/* plus the timestamp */
+	indio_dev->num_channels = channels + 1;
+	chan_array = kcalloc(channels + 1,
 			sizeof(struct iio_chan_spec), GFP_KERNEL);
 	if (chan_array == NULL)
 		return -ENOMEM;
@@ -337,7 +523,9 @@ static int tiadc_channel_init(struct iio_dev *indio_dev, int channels)
 		chan->type = IIO_VOLTAGE;
 		chan->indexed = 1;
 		chan->channel = adc_dev->channel_line[i];
-		chan->info_mask_separate = BIT(IIO_CHAN_INFO_RAW);
+		chan->info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |
+				BIT(IIO_CHAN_INFO_OVERSAMPLING_RATIO) |
+				BIT(IIO_CHAN_INFO_SAMP_FREQ);
 		chan->datasheet_name = chan_name_ain[chan->channel];
 		chan->scan_index = i;
 		chan->scan_type.sign = 'u';
@@ -345,6 +533,13 @@ static int tiadc_channel_init(struct iio_dev *indio_dev, int channels)
 		chan->scan_type.storagebits = 16;
 	}
 
+	chan->type = IIO_TIMESTAMP;
+	chan->channel = -1;
+	chan->scan_index = channels;
+	chan->scan_type.sign = 's';
+	chan->scan_type.realbits = 64;
+	chan->scan_type.storagebits = 64;
+
 	indio_dev->channels = chan_array;
 
 	return 0;
@@ -355,23 +550,35 @@ static void tiadc_channels_remove(struct iio_dev *indio_dev)
 	kfree(indio_dev->channels);
 }
 
-static int tiadc_read_raw(struct iio_dev *indio_dev,
-		struct iio_chan_spec const *chan,
-		int *val, int *val2, long mask)
+/*
+ * Convert the steps of @chans in one sequence, vals[i] receiving the sample
+ * of chans[i].
+ */
+static int tiadc_read_raw_channels(struct iio_dev *indio_dev,
+				   struct iio_chan_spec const * const *chans,
+				   int num, int *vals)
 {
 	struct tiadc_device *adc_dev = iio_priv(indio_dev);
-	int i, map_val;
-	unsigned int fifo1count, read, stepid;
-	bool found = false;
-	u32 step_en;
+	unsigned int fifo1count, read, stepid, usecs;
+	u32 step_en = 0, step_found = 0, mask;
 	unsigned long timeout;
+	int i, j, idx;
 
 	if (iio_buffer_enabled(indio_dev))
 		return -EBUSY;
 
-	step_en = get_adc_chan_step_mask(adc_dev, chan);
-	if (!step_en)
-		return -EINVAL;
+	/* long open delays or heavy averaging can outlast IDLE_TIMEOUT */
+	usecs = IDLE_TIMEOUT * adc_dev->channels;
+	for (j = 0; j < num; j++) {
+		mask = get_adc_chan_step_mask(adc_dev, chans[j]);
+		if (!mask)
+			return -EINVAL;
+		if (!(step_en & mask))
+			usecs += tiadc_step_cycles(adc_dev,
+						   chans[j]->scan_index) /
+				 (ADC_CLK / USEC_PER_SEC);
+		step_en |= mask;
+	}
 
 	fifo1count = tiadc_readl(adc_dev, REG_FIFO1CNT);
 	while (fifo1count--)
@@ -379,12 +586,11 @@ static int tiadc_read_raw(struct iio_dev *indio_dev,
 
 	am335x_tsc_se_set_once(adc_dev->mfd_tscadc, step_en);
 
-	timeout = jiffies + usecs_to_jiffies
-				(IDLE_TIMEOUT * adc_dev->channels);
-	/* Wait for Fifo threshold interrupt */
+	timeout = jiffies + usecs_to_jiffies(usecs);
+	/* Wait for a sample of every step */
 	while (1) {
 		fifo1count = tiadc_readl(adc_dev, REG_FIFO1CNT);
-		if (fifo1count)
+		if (fifo1count >= hweight32(step_en))
 			break;
 
 		if (time_after(jiffies, timeout)) {
@@ -392,38 +598,156 @@ static int tiadc_read_raw(struct iio_dev *indio_dev,
 			return -EAGAIN;
 		}
 	}
-	map_val = adc_dev->channel_step[chan->scan_index];
 
 	/*
-	 * We check the complete FIFO. We programmed just one entry but in case
-	 * something went wrong we left empty handed (-EAGAIN previously) and
-	 * then the value apeared somehow in the FIFO we would have two entries.
-	 * Therefore we read every item and keep only the latest version of the
-	 * requested channel.
+	 * We check the complete FIFO. We programmed one entry per step but in
+	 * case something went wrong we left empty handed (-EAGAIN previously)
+	 * and then the values apeared somehow in the FIFO we would have more
+	 * entries.  Therefore we read every item and keep only the latest
+	 * version of each requested channel.
 	 */
 	for (i = 0; i < fifo1count; i++) {
 		read = tiadc_readl(adc_dev, REG_FIFO1);
 		stepid = read & FIFOREAD_CHNLID_MASK;
 		stepid = stepid >> 0x10;
 
-		if (stepid == map_val) {
-			read = read & FIFOREAD_DATA_MASK;
-			found = true;
-			*val = (u16) read;
+		for (j = 0; j < num; j++) {
+			idx = chans[j]->scan_index;
+			if (stepid != adc_dev->channel_step[idx])
+				continue;
+			vals[j] = (u16) (read & FIFOREAD_DATA_MASK);
+			/* +1 for the charger, as in get_adc_chan_step_mask() */
+			step_found |= 1 << (stepid + 1);
 		}
 	}
 	am335x_tsc_se_adc_done(adc_dev->mfd_tscadc);
 
-	if (found == false)
+	if (step_found != step_en)
 		return -EBUSY;
+	return 0;
+}
+
+static int tiadc_read_raw(struct iio_dev *indio_dev,
+		struct iio_chan_spec const *chan,
+		int *val, int *val2, long mask)
+{
+	struct tiadc_device *adc_dev = iio_priv(indio_dev);
+	int ret;
+
+	switch (mask) {
+	case IIO_CHAN_INFO_OVERSAMPLING_RATIO:
+		*val = tiadc_step_avg(adc_dev, chan->scan_index);
+		return IIO_VAL_INT;
+	case IIO_CHAN_INFO_SAMP_FREQ:
+		*val = ADC_CLK / tiadc_step_cycles(adc_dev, chan->scan_index);
+		return IIO_VAL_INT;
+	}
+
+	ret = tiadc_read_raw_channels(indio_dev, &chan, 1, val);
+	if (ret)
+		return ret;
 	return IIO_VAL_INT;
 }
 
+static int tiadc_write_raw(struct iio_dev *indio_dev,
+		struct iio_chan_spec const *chan,
+		int val, int val2, long mask)
+{
+	struct tiadc_device *adc_dev = iio_priv(indio_dev);
+	int i = chan->scan_index;
+	int ret = 0;
+
+	/* the steps are only reprogrammed while the buffer is off */
+	mutex_lock(&indio_dev->mlock);
+	if (iio_buffer_enabled(indio_dev)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	switch (mask) {
+	case IIO_CHAN_INFO_OVERSAMPLING_RATIO:
+		if (val < 1 || val > 16 || !is_power_of_2(val)) {
+			ret = -EINVAL;
+			break;
+		}
+		adc_dev->step_avg[i] = val;
+		break;
+	case IIO_CHAN_INFO_SAMP_FREQ:
+		ret = tiadc_set_step_freq(adc_dev, i, val);
+		break;
+	default:
+		ret = -EINVAL;
+	}
+
+	if (ret == 0)
+		tiadc_step_config(indio_dev);
+out:
+	mutex_unlock(&indio_dev->mlock);
+	return ret;
+}
+
+static IIO_CONST_ATTR(in_voltage_oversampling_ratio_available, "1 2 4 8 16");
+
+static struct attribute *tiadc_attributes[] = {
+	&iio_const_attr_in_voltage_oversampling_ratio_available.dev_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group tiadc_attribute_group = {
+	.attrs = tiadc_attributes,
+};
+
 static const struct iio_info tiadc_info = {
 	.read_raw = &tiadc_read_raw,
+	.read_raw_channels = &tiadc_read_raw_channels,
+	.write_raw = &tiadc_write_raw,
+	.attrs = &tiadc_attribute_group,
 	.driver_module = THIS_MODULE,
 };
 
+static int tiadc_request_dma(struct platform_device *pdev,
+			     struct tiadc_device *adc_dev)
+{
+	struct tiadc_dma *dma = &adc_dev->dma;
+
+	/* the DMA requests are described on the parent tscadc node */
+	dma->chan = dma_request_slave_channel(adc_dev->mfd_tscadc->dev,
+					      "fifo1");
+	if (!dma->chan)
+		return 0;
+
+	/* RX buffer */
+	dma->buf = dma_alloc_coherent(dma->chan->device->dev, DMA_BUFFER_SIZE,
+				      &dma->addr, GFP_KERNEL);
+	if (!dma->buf) {
+		dma_release_channel(dma->chan);
+		dma->chan = NULL;
+		return -ENOMEM;
+	}
+
+	/* the sample is in the low half of each 32 bit FIFO word */
+	dma->conf.direction = DMA_DEV_TO_MEM;
+	dma->conf.src_addr_width = DMA_SLAVE_BUSWIDTH_2_BYTES;
+	dma->conf.src_addr = adc_dev->mfd_tscadc->tscadc_phys_base + REG_FIFO1;
+
+	dev_info(&pdev->dev, "using %s for FIFO1\n", dma_chan_name(dma->chan));
+
+	return 0;
+}
+
+static void tiadc_release_dma(struct tiadc_device *adc_dev)
+{
+	struct tiadc_dma *dma = &adc_dev->dma;
+
+	if (!dma->chan)
+		return;
+
+	dma_free_coherent(dma->chan->device->dev, DMA_BUFFER_SIZE,
+			  dma->buf, dma->addr);
+	dma_release_channel(dma->chan);
+	dma->chan = NULL;
+}
+
 static int tiadc_parse_dt(struct platform_device *pdev,
 			  struct tiadc_device *adc_dev)
 {
@@ -500,14 +824,20 @@ static int tiadc_probe(struct platform_device *pdev)
 	if (err)
 		goto err_free_channels;
 
-	err = iio_device_register(indio_dev);
+	err = tiadc_request_dma(pdev, adc_dev);
 	if (err)
 		goto err_buffer_unregister;
 
+	err = iio_device_register(indio_dev);
+	if (err)
+		goto err_release_dma;
+
 	platform_set_drvdata(pdev, indio_dev);
 
 	return 0;
 
+err_release_dma:
+	tiadc_release_dma(adc_dev);
 err_buffer_unregister:
 	tiadc_iio_buffered_hardware_remove(indio_dev);
 err_free_channels:
@@ -522,6 +852,7 @@ static int tiadc_remove(struct platform_device *pdev)
 	u32 step_en;
 
 	iio_device_unregister(indio_dev);
+	tiadc_release_dma(adc_dev);
 	tiadc_iio_buffered_hardware_remove(indio_dev);
 	tiadc_channels_remove(indio_dev);
 
@@ -0,0 +1,691 @@
+/* The industrial I/O - memory mapped, block based buffer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * The buffer is made of blocks of DMA coherent memory handed back and forth
+ * between user space and the device.  User space allocates the blocks with
+ * IIO_BUFFER_BLOCK_ALLOC_IOCTL, maps each of them and enqueues the ones it
+ * wants filled.  Filled blocks are dequeued with IIO_BUFFER_BLOCK_DEQUEUE_IOCTL
+ * and read in place, so the samples are never copied after they land in the
+ * block.
+ *
+ * A block is filled either by a DMA capable driver, which takes blocks with
+ * iio_block_buffer_get_block() and returns them with
+ * iio_block_buffer_block_done(), or by the iio_push_to_buffers() path, which
+ * appends scans to the current block until the next one would not fit.
+ *
+ * When user space does not allocate blocks the buffer allocates its own from
+ * the buffer length and only read() is available, as with the kfifo buffer.
+ */
+
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/mm.h>
+#include <linux/sizes.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/uaccess.h>
+#include <linux/timekeeping.h>
+#include <linux/iio/block_buf.h>
+
+#define IIO_BLOCK_BUFFER_MAX_BLOCKS	64
+#define IIO_BLOCK_BUFFER_MAX_SIZE	SZ_16M
+#define IIO_BLOCK_BUFFER_KERNEL_BLOCKS	4
+
+struct iio_block_buffer {
+	struct iio_buffer buffer;
+	struct device *dev;
+	const struct iio_block_buffer_ops *ops;
+	void *priv;
+
+	/* protects the block array against the ioctls and read() */
+	struct mutex lock;
+	struct iio_block **blocks;
+	unsigned int num_blocks;
+	bool user_blocks;
+	bool update_needed;
+	atomic_t mmap_count;
+
+	/* protects the queues and block states, taken in atomic context */
+	spinlock_t list_lock;
+	struct list_head incoming;
+	struct list_head outgoing;
+	struct iio_block *fill;
+	size_t fill_pos;
+	size_t read_pos;
+	bool driver_waiting;
+};
+
+#define iio_to_block_buffer(r) container_of(r, struct iio_block_buffer, buffer)
+
+static void iio_block_free_blocks(struct iio_block_buffer *bb)
+{
+	struct iio_block *block;
+	unsigned int i;
+
+	for (i = 0; i < bb->num_blocks; i++) {
+		block = bb->blocks[i];
+		dma_free_coherent(bb->dev, PAGE_ALIGN(block->block.size),
+				  block->vaddr, block->phys_addr);
+		kfree(block);
+	}
+	kfree(bb->blocks);
+
+	bb->blocks = NULL;
+	bb->num_blocks = 0;
+	INIT_LIST_HEAD(&bb->incoming);
+	INIT_LIST_HEAD(&bb->outgoing);
+	bb->fill = NULL;
+	bb->fill_pos = 0;
+	bb->read_pos = 0;
+}
+
+/* all blocks start owned by @state, queued if that is QUEUED */
+static int iio_block_alloc_blocks(struct iio_block_buffer *bb,
+				  unsigned int count, size_t size,
+				  enum iio_block_state state)
+{
+	struct iio_block *block;
+	unsigned int i;
+
+	bb->blocks = kcalloc(count, sizeof(*bb->blocks), GFP_KERNEL);
+	if (!bb->blocks)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		block = kzalloc(sizeof(*block), GFP_KERNEL);
+		if (!block)
+			goto err_free;
+
+		block->vaddr = dma_alloc_coherent(bb->dev, PAGE_ALIGN(size),
+						  &block->phys_addr,
+						  GFP_KERNEL);
+		if (!block->vaddr) {
+			kfree(block);
+			goto err_free;
+		}
+
+		block->block.id = i;
+		block->block.size = size;
+		block->block.data.offset = i * PAGE_ALIGN(size);
+		block->state = state;
+		if (state == IIO_BLOCK_STATE_QUEUED)
+			list_add_tail(&block->head, &bb->incoming);
+
+		bb->blocks[i] = block;
+		bb->num_blocks++;
+	}
+
+	return 0;
+
+err_free:
+	iio_block_free_blocks(bb);
+	return -ENOMEM;
+}
+
+static void iio_block_buffer_queued(struct iio_block_buffer *bb)
+{
+	bool notify = false;
+
+	if (bb->driver_waiting) {
+		bb->driver_waiting = false;
+		notify = true;
+	}
+
+	if (notify && bb->ops && bb->ops->block_queued)
+		bb->ops->block_queued(&bb->buffer, bb->priv);
+}
+
+static void __iio_block_done(struct iio_block_buffer *bb,
+			     struct iio_block *block, size_t bytes_used)
+{
+	block->block.bytes_used = bytes_used;
+	block->block.timestamp = ktime_get_ns();
+	block->block.flags = IIO_BUFFER_BLOCK_FLAG_TIMESTAMP_VALID;
+	block->state = IIO_BLOCK_STATE_DONE;
+	list_add_tail(&block->head, &bb->outgoing);
+}
+
+static struct iio_block *__iio_block_get(struct iio_block_buffer *bb)
+{
+	struct iio_block *block;
+
+	block = list_first_entry_or_null(&bb->incoming, struct iio_block,
+					 head);
+	if (!block) {
+		bb->driver_waiting = true;
+		return NULL;
+	}
+
+	list_del(&block->head);
+	block->state = IIO_BLOCK_STATE_ACTIVE;
+
+	return block;
+}
+
+/**
+ * iio_block_buffer_get_block() - take the next block to fill
+ * @buffer:	a buffer allocated with iio_block_buffer_allocate()
+ *
+ * Returns NULL if no block is queued, the block_queued hook is then called
+ * once one is.  May be called in atomic context.
+ */
+struct iio_block *iio_block_buffer_get_block(struct iio_buffer *buffer)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(buffer);
+	struct iio_block *block;
+	unsigned long flags;
+
+	spin_lock_irqsave(&bb->list_lock, flags);
+	block = __iio_block_get(bb);
+	spin_unlock_irqrestore(&bb->list_lock, flags);
+
+	return block;
+}
+EXPORT_SYMBOL_GPL(iio_block_buffer_get_block);
+
+/**
+ * iio_block_buffer_block_done() - hand a filled block to user space
+ * @buffer:	a buffer allocated with iio_block_buffer_allocate()
+ * @block:	block returned by iio_block_buffer_get_block()
+ * @bytes_used:	number of valid bytes, a multiple of the scan size
+ *
+ * May be called in atomic context.
+ */
+void iio_block_buffer_block_done(struct iio_buffer *buffer,
+				 struct iio_block *block, size_t bytes_used)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(buffer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&bb->list_lock, flags);
+	__iio_block_done(bb, block, min_t(size_t, bytes_used,
+					   block->block.size));
+	spin_unlock_irqrestore(&bb->list_lock, flags);
+
+	wake_up_interruptible_poll(&buffer->pollq, POLLIN | POLLRDNORM);
+}
+EXPORT_SYMBOL_GPL(iio_block_buffer_block_done);
+
+static int iio_block_buffer_store_to(struct iio_buffer *r, const void *data)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+	size_t bpd = r->bytes_per_datum;
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&bb->list_lock, flags);
+
+	if (!bb->fill) {
+		bb->fill = __iio_block_get(bb);
+		bb->fill_pos = 0;
+	}
+	if (!bb->fill || bpd > bb->fill->block.size) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	memcpy(bb->fill->vaddr + bb->fill_pos, data, bpd);
+	bb->fill_pos += bpd;
+
+	/* complete the block once the next scan does not fit */
+	if (bb->fill_pos + bpd > bb->fill->block.size) {
+		__iio_block_done(bb, bb->fill, bb->fill_pos);
+		bb->fill = NULL;
+	}
+
+out:
+	spin_unlock_irqrestore(&bb->list_lock, flags);
+	return ret;
+}
+
+static int iio_block_buffer_read_first_n(struct iio_buffer *r, size_t n,
+					 char __user *buf)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+	size_t bpd = r->bytes_per_datum;
+	struct iio_block *block;
+	size_t copied = 0, count;
+	unsigned long flags;
+	int ret = 0;
+
+	if (mutex_lock_interruptible(&bb->lock))
+		return -ERESTARTSYS;
+
+	/* with user space owned blocks the data goes through mmap() */
+	if (bb->user_blocks) {
+		ret = -EBUSY;
+		goto out;
+	}
+	if (n < bpd) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	while (copied + bpd <= n) {
+		spin_lock_irqsave(&bb->list_lock, flags);
+		block = list_first_entry_or_null(&bb->outgoing,
+						 struct iio_block, head);
+		spin_unlock_irqrestore(&bb->list_lock, flags);
+		if (!block)
+			break;
+
+		/* done blocks are only touched by the reader, under bb->lock */
+		count = min(block->block.bytes_used - bb->read_pos, n - copied);
+		count = rounddown(count, bpd);
+		if (copy_to_user(buf + copied, block->vaddr + bb->read_pos,
+				 count)) {
+			ret = -EFAULT;
+			goto out;
+		}
+		copied += count;
+		bb->read_pos += count;
+
+		if (bb->read_pos < block->block.bytes_used)
+			break;
+
+		bb->read_pos = 0;
+		spin_lock_irqsave(&bb->list_lock, flags);
+		list_del(&block->head);
+		block->block.bytes_used = 0;
+		block->state = IIO_BLOCK_STATE_QUEUED;
+		list_add_tail(&block->head, &bb->incoming);
+		iio_block_buffer_queued(bb);
+		spin_unlock_irqrestore(&bb->list_lock, flags);
+	}
+
+out:
+	mutex_unlock(&bb->lock);
+	return ret ? ret : copied;
+}
+
+static size_t iio_block_buffer_data_available(struct iio_buffer *r)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+	struct iio_block *block;
+	unsigned long flags;
+	size_t bytes = 0;
+
+	spin_lock_irqsave(&bb->list_lock, flags);
+	list_for_each_entry(block, &bb->outgoing, head)
+		bytes += block->block.bytes_used;
+	if (!bb->user_blocks && bytes)
+		bytes -= bb->read_pos;
+	spin_unlock_irqrestore(&bb->list_lock, flags);
+
+	if (!r->bytes_per_datum)
+		return 0;
+
+	/* a done block holding a partial scan is still worth waking for */
+	return DIV_ROUND_UP(bytes, r->bytes_per_datum);
+}
+
+static int iio_block_buffer_request_update(struct iio_buffer *r)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+	struct iio_block *block;
+	unsigned long flags;
+	unsigned int i;
+	size_t size;
+	int ret = 0;
+
+	mutex_lock(&bb->lock);
+
+	if (bb->user_blocks) {
+		/* whatever a previous run left half filled is handed out */
+		spin_lock_irqsave(&bb->list_lock, flags);
+		if (bb->fill) {
+			if (bb->fill_pos)
+				__iio_block_done(bb, bb->fill, bb->fill_pos);
+			else
+				list_add(&bb->fill->head, &bb->incoming);
+			bb->fill = NULL;
+		}
+		spin_unlock_irqrestore(&bb->list_lock, flags);
+		goto out;
+	}
+
+	if (bb->update_needed || !bb->num_blocks) {
+		iio_block_free_blocks(bb);
+		size = (size_t)r->length * r->bytes_per_datum;
+		size = DIV_ROUND_UP(size, IIO_BLOCK_BUFFER_KERNEL_BLOCKS);
+		size = PAGE_ALIGN(max_t(size_t, size, r->bytes_per_datum));
+		ret = iio_block_alloc_blocks(bb, IIO_BLOCK_BUFFER_KERNEL_BLOCKS,
+					     size, IIO_BLOCK_STATE_QUEUED);
+		if (ret == 0)
+			bb->update_needed = false;
+		goto out;
+	}
+
+	/* start over with all blocks empty */
+	spin_lock_irqsave(&bb->list_lock, flags);
+	INIT_LIST_HEAD(&bb->incoming);
+	INIT_LIST_HEAD(&bb->outgoing);
+	for (i = 0; i < bb->num_blocks; i++) {
+		block = bb->blocks[i];
+		block->block.bytes_used = 0;
+		block->state = IIO_BLOCK_STATE_QUEUED;
+		list_add_tail(&block->head, &bb->incoming);
+	}
+	bb->fill = NULL;
+	bb->read_pos = 0;
+	spin_unlock_irqrestore(&bb->list_lock, flags);
+
+out:
+	mutex_unlock(&bb->lock);
+	return ret;
+}
+
+static int iio_block_buffer_set_bytes_per_datum(struct iio_buffer *r,
+						size_t bpd)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+
+	if (r->bytes_per_datum != bpd) {
+		r->bytes_per_datum = bpd;
+		bb->update_needed = true;
+	}
+	return 0;
+}
+
+static int iio_block_buffer_set_length(struct iio_buffer *r, int length)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+
+	/* Avoid an invalid state */
+	if (length < 2)
+		length = 2;
+	if (r->length != length) {
+		r->length = length;
+		bb->update_needed = true;
+	}
+	return 0;
+}
+
+static int iio_block_buffer_alloc_blocks(struct iio_buffer *r,
+					 struct iio_buffer_block_alloc_req *req)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+	int ret;
+
+	if (req->count > IIO_BLOCK_BUFFER_MAX_BLOCKS ||
+	    req->size > IIO_BLOCK_BUFFER_MAX_SIZE)
+		return -EINVAL;
+	if (req->count && !req->size)
+		return -EINVAL;
+
+	mutex_lock(&bb->lock);
+
+	if (atomic_read(&bb->mmap_count)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	iio_block_free_blocks(bb);
+	bb->user_blocks = false;
+	bb->update_needed = true;
+
+	ret = 0;
+	if (req->count) {
+		ret = iio_block_alloc_blocks(bb, req->count, req->size,
+					     IIO_BLOCK_STATE_DEQUEUED);
+		if (ret == 0)
+			bb->user_blocks = true;
+	}
+	req->id = 0;
+
+out:
+	mutex_unlock(&bb->lock);
+	return ret;
+}
+
+static int iio_block_buffer_free_blocks(struct iio_buffer *r)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+	int ret = 0;
+
+	mutex_lock(&bb->lock);
+	if (atomic_read(&bb->mmap_count)) {
+		ret = -EBUSY;
+	} else {
+		iio_block_free_blocks(bb);
+		bb->user_blocks = false;
+		bb->update_needed = true;
+	}
+	mutex_unlock(&bb->lock);
+
+	return ret;
+}
+
+static struct iio_block *iio_block_buffer_find(struct iio_block_buffer *bb,
+					       u32 id)
+{
+	if (!bb->user_blocks || id >= bb->num_blocks)
+		return NULL;
+	return bb->blocks[id];
+}
+
+static int iio_block_buffer_query_block(struct iio_buffer *r,
+					struct iio_buffer_block *desc)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+	struct iio_block *block;
+	unsigned long flags;
+	int ret = 0;
+
+	mutex_lock(&bb->lock);
+	block = iio_block_buffer_find(bb, desc->id);
+	if (block) {
+		spin_lock_irqsave(&bb->list_lock, flags);
+		*desc = block->block;
+		spin_unlock_irqrestore(&bb->list_lock, flags);
+	} else {
+		ret = -EINVAL;
+	}
+	mutex_unlock(&bb->lock);
+
+	return ret;
+}
+
+static int iio_block_buffer_enqueue_block(struct iio_buffer *r,
+					  struct iio_buffer_block *desc)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+	struct iio_block *block;
+	unsigned long flags;
+	int ret = 0;
+
+	mutex_lock(&bb->lock);
+	block = iio_block_buffer_find(bb, desc->id);
+	if (!block) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	spin_lock_irqsave(&bb->list_lock, flags);
+	if (block->state != IIO_BLOCK_STATE_DEQUEUED) {
+		ret = -EBUSY;
+	} else {
+		block->block.bytes_used = 0;
+		block->block.flags = 0;
+		block->state = IIO_BLOCK_STATE_QUEUED;
+		list_add_tail(&block->head, &bb->incoming);
+		*desc = block->block;
+		iio_block_buffer_queued(bb);
+	}
+	spin_unlock_irqrestore(&bb->list_lock, flags);
+
+out:
+	mutex_unlock(&bb->lock);
+	return ret;
+}
+
+static int iio_block_buffer_dequeue_block(struct iio_buffer *r,
+					  struct iio_buffer_block *desc)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+	struct iio_block *block;
+	unsigned long flags;
+	int ret = 0;
+
+	mutex_lock(&bb->lock);
+	if (!bb->user_blocks) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	spin_lock_irqsave(&bb->list_lock, flags);
+	block = list_first_entry_or_null(&bb->outgoing, struct iio_block,
+					 head);
+	if (block) {
+		list_del(&block->head);
+		block->state = IIO_BLOCK_STATE_DEQUEUED;
+		*desc = block->block;
+	} else {
+		ret = -EAGAIN;
+	}
+	spin_unlock_irqrestore(&bb->list_lock, flags);
+
+out:
+	mutex_unlock(&bb->lock);
+	return ret;
+}
+
+static void iio_block_vm_open(struct vm_area_struct *vma)
+{
+	struct iio_block_buffer *bb = vma->vm_private_data;
+
+	atomic_inc(&bb->mmap_count);
+	iio_buffer_get(&bb->buffer);
+}
+
+static void iio_block_vm_close(struct vm_area_struct *vma)
+{
+	struct iio_block_buffer *bb = vma->vm_private_data;
+
+	atomic_dec(&bb->mmap_count);
+	iio_buffer_put(&bb->buffer);
+}
+
+static const struct vm_operations_struct iio_block_vm_ops = {
+	.open = iio_block_vm_open,
+	.close = iio_block_vm_close,
+};
+
+static int iio_block_buffer_mmap(struct iio_buffer *r,
+				 struct vm_area_struct *vma)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+	unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+	size_t size = vma->vm_end - vma->vm_start;
+	struct iio_block *block = NULL;
+	unsigned int i;
+	int ret;
+
+	mutex_lock(&bb->lock);
+
+	if (bb->user_blocks) {
+		for (i = 0; i < bb->num_blocks; i++) {
+			if (bb->blocks[i]->block.data.offset == offset) {
+				block = bb->blocks[i];
+				break;
+			}
+		}
+	}
+	if (!block || size > PAGE_ALIGN(block->block.size)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* the offset selected the block, the mapping starts at its beginning */
+	vma->vm_pgoff = 0;
+	ret = dma_mmap_coherent(bb->dev, vma, block->vaddr, block->phys_addr,
+				size);
+	if (ret)
+		goto out;
+
+	vma->vm_private_data = bb;
+	vma->vm_ops = &iio_block_vm_ops;
+	iio_block_vm_open(vma);
+
+out:
+	mutex_unlock(&bb->lock);
+	return ret;
+}
+
+static void iio_block_buffer_release(struct iio_buffer *r)
+{
+	struct iio_block_buffer *bb = iio_to_block_buffer(r);
+
+	iio_block_free_blocks(bb);
+	mutex_destroy(&bb->lock);
+	put_device(bb->dev);
+	kfree(bb);
+}
+
+static const struct iio_buffer_access_funcs iio_block_buffer_access_funcs = {
+	.store_to = &iio_block_buffer_store_to,
+	.read_first_n = &iio_block_buffer_read_first_n,
+	.data_available = &iio_block_buffer_data_available,
+	.request_update = &iio_block_buffer_request_update,
+	.set_bytes_per_datum = &iio_block_buffer_set_bytes_per_datum,
+	.set_length = &iio_block_buffer_set_length,
+	.release = &iio_block_buffer_release,
+
+	.alloc_blocks = &iio_block_buffer_alloc_blocks,
+	.free_blocks = &iio_block_buffer_free_blocks,
+	.query_block = &iio_block_buffer_query_block,
+	.enqueue_block = &iio_block_buffer_enqueue_block,
+	.dequeue_block = &iio_block_buffer_dequeue_block,
+	.mmap = &iio_block_buffer_mmap,
+};
+
+/**
+ * iio_block_buffer_allocate() - allocate a block based buffer
+ * @dma_dev:	device the block memory is allocated for, the DMA controller
+ *		for drivers filling blocks by DMA, else the IIO device's parent
+ * @ops:	optional driver hooks
+ * @priv:	passed to the hooks
+ *
+ * Returns the buffer or NULL, free it with iio_block_buffer_free().
+ */
+struct iio_buffer *iio_block_buffer_allocate(struct device *dma_dev,
+		const struct iio_block_buffer_ops *ops, void *priv)
+{
+	struct iio_block_buffer *bb;
+
+	bb = kzalloc(sizeof(*bb), GFP_KERNEL);
+	if (!bb)
+		return NULL;
+
+	iio_buffer_init(&bb->buffer);
+	bb->buffer.access = &iio_block_buffer_access_funcs;
+	bb->buffer.length = 2;
+	bb->dev = get_device(dma_dev);
+	bb->ops = ops;
+	bb->priv = priv;
+	bb->update_needed = true;
+	mutex_init(&bb->lock);
+	spin_lock_init(&bb->list_lock);
+	INIT_LIST_HEAD(&bb->incoming);
+	INIT_LIST_HEAD(&bb->outgoing);
+	atomic_set(&bb->mmap_count, 0);
+
+	return &bb->buffer;
+}
+EXPORT_SYMBOL_GPL(iio_block_buffer_allocate);
+
+void iio_block_buffer_free(struct iio_buffer *buffer)
+{
+	iio_buffer_put(buffer);
+}
+EXPORT_SYMBOL_GPL(iio_block_buffer_free);
+
+MODULE_LICENSE("GPL");
@@ -21,6 +21,7 @@
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
+#include <linux/mm.h>
 
 #include <linux/iio/iio.h>
 #include "iio_core.h"
@@ -159,6 +160,111 @@ unsigned int iio_buffer_poll(struct file *filp,
 	return 0;
 }
 
+static int iio_buffer_dequeue_block(struct iio_dev *indio_dev,
+				    struct file *filp,
+				    struct iio_buffer_block *block)
+{
+	struct iio_buffer *rb = indio_dev->buffer;
+	int ret;
+
+	for (;;) {
+		ret = rb->access->dequeue_block(rb, block);
+		if (ret != -EAGAIN || (filp->f_flags & O_NONBLOCK))
+			return ret;
+
+		ret = wait_event_interruptible(rb->pollq,
+				!indio_dev->info ||
+				iio_buffer_data_available(rb));
+		if (ret)
+			return ret;
+		if (!indio_dev->info)
+			return -ENODEV;
+	}
+}
+
+/**
+ * iio_buffer_ioctl() - chrdev ioctls of block based buffers
+ *
+ * Called by the core for every ioctl it does not handle itself.
+ **/
+long iio_buffer_ioctl(struct iio_dev *indio_dev, struct file *filp,
+		      unsigned int cmd, unsigned long arg)
+{
+	const struct iio_buffer_access_funcs *access;
+	struct iio_buffer *rb = indio_dev->buffer;
+	struct iio_buffer_block_alloc_req req;
+	struct iio_buffer_block block;
+	void __user *ubuf = (void __user *)arg;
+	int ret;
+
+	if (!rb || !rb->access->alloc_blocks)
+		return -EINVAL;
+	access = rb->access;
+
+	switch (cmd) {
+	case IIO_BUFFER_BLOCK_ALLOC_IOCTL:
+		if (copy_from_user(&req, ubuf, sizeof(req)))
+			return -EFAULT;
+		mutex_lock(&indio_dev->mlock);
+		if (iio_buffer_is_active(rb))
+			ret = -EBUSY;
+		else
+			ret = access->alloc_blocks(rb, &req);
+		mutex_unlock(&indio_dev->mlock);
+		if (ret)
+			return ret;
+		if (copy_to_user(ubuf, &req, sizeof(req)))
+			return -EFAULT;
+		return 0;
+	case IIO_BUFFER_BLOCK_FREE_IOCTL:
+		mutex_lock(&indio_dev->mlock);
+		if (iio_buffer_is_active(rb))
+			ret = -EBUSY;
+		else
+			ret = access->free_blocks(rb);
+		mutex_unlock(&indio_dev->mlock);
+		return ret;
+	case IIO_BUFFER_BLOCK_QUERY_IOCTL:
+	case IIO_BUFFER_BLOCK_ENQUEUE_IOCTL:
+	case IIO_BUFFER_BLOCK_DEQUEUE_IOCTL:
+		if (copy_from_user(&block, ubuf, sizeof(block)))
+			return -EFAULT;
+		if (cmd == IIO_BUFFER_BLOCK_QUERY_IOCTL)
+			ret = access->query_block(rb, &block);
+		else if (cmd == IIO_BUFFER_BLOCK_ENQUEUE_IOCTL)
+			ret = access->enqueue_block(rb, &block);
+		else
+			ret = iio_buffer_dequeue_block(indio_dev, filp, &block);
+		if (ret)
+			return ret;
+		if (copy_to_user(ubuf, &block, sizeof(block)))
+			return -EFAULT;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+/**
+ * iio_buffer_mmap() - chrdev mmap of a block of a block based buffer
+ **/
+int iio_buffer_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct iio_dev *indio_dev = filp->private_data;
+	struct iio_buffer *rb = indio_dev->buffer;
+
+	if (!indio_dev->info)
+		return -ENODEV;
+
+	if (!rb || !rb->access->mmap)
+		return -ENODEV;
+
+	if (!(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+
+	return rb->access->mmap(rb, vma);
+}
+
 /**
  * iio_buffer_wakeup_poll - Wakes up the buffer waitqueue
  * @indio_dev: The IIO device
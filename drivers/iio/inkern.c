@@ -486,6 +486,94 @@ err_unlock:
 }
 EXPORT_SYMBOL_GPL(iio_read_channel_raw);
 
+/* read the channels of @chans on @indio_dev whose index is in @idx */
+static int iio_read_device_channels_raw(struct iio_dev *indio_dev,
+					struct iio_channel *chans,
+					const int *idx, int n, int *vals)
+{
+	struct iio_chan_spec const **specs;
+	int *tmp;
+	int i, ret = 0;
+
+	if (n > 1 && indio_dev->info->read_raw_channels) {
+		specs = kcalloc(n, sizeof(*specs), GFP_KERNEL);
+		tmp = kcalloc(n, sizeof(*tmp), GFP_KERNEL);
+		if (!specs || !tmp) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+
+		for (i = 0; i < n; i++)
+			specs[i] = chans[idx[i]].channel;
+
+		ret = indio_dev->info->read_raw_channels(indio_dev, specs, n,
+							 tmp);
+		for (i = 0; ret == 0 && i < n; i++)
+			vals[idx[i]] = tmp[i];
+out_free:
+		kfree(tmp);
+		kfree(specs);
+		return ret;
+	}
+
+	for (i = 0; i < n; i++) {
+		ret = iio_channel_read(&chans[idx[i]], &vals[idx[i]], NULL,
+				       IIO_CHAN_INFO_RAW);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+int iio_read_channels_raw(struct iio_channel *chans, int num, int *vals)
+{
+	struct iio_dev *indio_dev;
+	bool *done;
+	int *idx;
+	int i, j, n, ret = 0;
+
+	done = kcalloc(num, sizeof(*done), GFP_KERNEL);
+	idx = kcalloc(num, sizeof(*idx), GFP_KERNEL);
+	if (!done || !idx) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/* one batch per device, in the order the devices first appear */
+	for (i = 0; i < num && ret >= 0; i++) {
+		if (done[i])
+			continue;
+
+		indio_dev = chans[i].indio_dev;
+		for (j = i, n = 0; j < num; j++) {
+			if (chans[j].indio_dev != indio_dev)
+				continue;
+			if (!iio_channel_has_info(chans[j].channel,
+						  IIO_CHAN_INFO_RAW)) {
+				ret = -EINVAL;
+				goto out;
+			}
+			idx[n++] = j;
+			done[j] = true;
+		}
+
+		mutex_lock(&indio_dev->info_exist_lock);
+		if (indio_dev->info == NULL)
+			ret = -ENODEV;
+		else
+			ret = iio_read_device_channels_raw(indio_dev, chans,
+							   idx, n, vals);
+		mutex_unlock(&indio_dev->info_exist_lock);
+	}
+
+out:
+	kfree(idx);
+	kfree(done);
+	return ret < 0 ? ret : 0;
+}
+EXPORT_SYMBOL_GPL(iio_read_channels_raw);
+
 int iio_read_channel_average_raw(struct iio_channel *chan, int *val)
 {
 	int ret;
@@ -0,0 +1,248 @@
+/*
+ * hrtimer based trigger for the iio subsystem
+ *
+ * Fires the pollfuncs of the attached devices from hrtimer context at
+ * sampling_frequency, so devices without a data ready line can be sampled
+ * periodically with nobody in userspace in the loop.
+ *
+ * Triggers are created and destroyed through configfs:
+ *
+ *	mkdir /config/iio/triggers/hrtimer/<name>
+ *	rmdir /config/iio/triggers/hrtimer/<name>
+ *
+ * and show up as iio triggers named <name>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+#include <linux/configfs.h>
+
+#include <linux/iio/iio.h>
+#include <linux/iio/trigger.h>
+
+#define IIO_HRTIMER_DEFAULT_FREQUENCY	100
+
+struct iio_hrtimer_trig {
+	struct config_item item;
+	struct iio_trigger *trig;
+	struct hrtimer timer;
+	unsigned long sampling_frequency;
+	ktime_t period;
+};
+
+static ssize_t iio_hrtimer_read_sampling_frequency(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct iio_trigger *trig = to_iio_trigger(dev);
+	struct iio_hrtimer_trig *info = iio_trigger_get_drvdata(trig);
+
+	return sprintf(buf, "%lu\n", info->sampling_frequency);
+}
+
+static ssize_t iio_hrtimer_store_sampling_frequency(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct iio_trigger *trig = to_iio_trigger(dev);
+	struct iio_hrtimer_trig *info = iio_trigger_get_drvdata(trig);
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	if (!val || val > NSEC_PER_SEC)
+		return -EINVAL;
+
+	/* a running timer picks the new period up at its next expiry */
+	info->sampling_frequency = val;
+	info->period = ktime_set(0, NSEC_PER_SEC / val);
+
+	return len;
+}
+
+static DEVICE_ATTR(sampling_frequency, S_IRUGO | S_IWUSR,
+		   iio_hrtimer_read_sampling_frequency,
+		   iio_hrtimer_store_sampling_frequency);
+
+static struct attribute *iio_hrtimer_attrs[] = {
+	&dev_attr_sampling_frequency.attr,
+	NULL
+};
+
+static const struct attribute_group iio_hrtimer_attr_group = {
+	.attrs = iio_hrtimer_attrs,
+};
+
+static const struct attribute_group *iio_hrtimer_attr_groups[] = {
+	&iio_hrtimer_attr_group,
+	NULL
+};
+
+static enum hrtimer_restart iio_hrtimer_trig_handler(struct hrtimer *timer)
+{
+	struct iio_hrtimer_trig *info;
+
+	info = container_of(timer, struct iio_hrtimer_trig, timer);
+
+	hrtimer_forward_now(timer, info->period);
+	iio_trigger_poll(info->trig);
+
+	return HRTIMER_RESTART;
+}
+
+static int iio_trig_hrtimer_set_state(struct iio_trigger *trig, bool state)
+{
+	struct iio_hrtimer_trig *info = iio_trigger_get_drvdata(trig);
+
+	if (state)
+		hrtimer_start(&info->timer, info->period, HRTIMER_MODE_REL);
+	else
+		hrtimer_cancel(&info->timer);
+
+	return 0;
+}
+
+static const struct iio_trigger_ops iio_hrtimer_trigger_ops = {
+	.owner = THIS_MODULE,
+	.set_trigger_state = iio_trig_hrtimer_set_state,
+};
+
+static inline struct iio_hrtimer_trig *to_iio_hrtimer_trig(
+		struct config_item *item)
+{
+	return item ? container_of(item, struct iio_hrtimer_trig, item) : NULL;
+}
+
+static void iio_hrtimer_trig_release(struct config_item *item)
+{
+	struct iio_hrtimer_trig *info = to_iio_hrtimer_trig(item);
+
+	iio_trigger_unregister(info->trig);
+	/* the trigger may have been running when it went away */
+	hrtimer_cancel(&info->timer);
+	iio_trigger_free(info->trig);
+	kfree(info);
+}
+
+static struct configfs_item_operations iio_hrtimer_trig_item_ops = {
+	.release	= iio_hrtimer_trig_release,
+};
+
+static struct config_item_type iio_hrtimer_trig_type = {
+	.ct_item_ops	= &iio_hrtimer_trig_item_ops,
+	.ct_owner	= THIS_MODULE,
+};
+
+static struct config_item *iio_hrtimer_make_item(struct config_group *group,
+						 const char *name)
+{
+	struct iio_hrtimer_trig *info;
+	int ret;
+
+	info = kzalloc(sizeof(*info), GFP_KERNEL);
+	if (!info)
+		return ERR_PTR(-ENOMEM);
+
+	info->trig = iio_trigger_alloc("%s", name);
+	if (!info->trig) {
+		ret = -ENOMEM;
+		goto err_free_info;
+	}
+
+	info->trig->dev.groups = iio_hrtimer_attr_groups;
+	info->trig->ops = &iio_hrtimer_trigger_ops;
+	iio_trigger_set_drvdata(info->trig, info);
+
+	hrtimer_init(&info->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	info->timer.function = iio_hrtimer_trig_handler;
+
+	info->sampling_frequency = IIO_HRTIMER_DEFAULT_FREQUENCY;
+	info->period = ktime_set(0, NSEC_PER_SEC / info->sampling_frequency);
+
+	ret = iio_trigger_register(info->trig);
+	if (ret)
+		goto err_free_trigger;
+
+	config_item_init_type_name(&info->item, name, &iio_hrtimer_trig_type);
+	return &info->item;
+
+err_free_trigger:
+	iio_trigger_free(info->trig);
+err_free_info:
+	kfree(info);
+	return ERR_PTR(ret);
+}
+
+static void iio_hrtimer_drop_item(struct config_group *group,
+				  struct config_item *item)
+{
+	config_item_put(item);
+}
+
+static struct configfs_group_operations iio_hrtimer_group_ops = {
+	.make_item	= iio_hrtimer_make_item,
+	.drop_item	= iio_hrtimer_drop_item,
+};
+
+static struct config_item_type iio_hrtimer_group_type = {
+	.ct_group_ops	= &iio_hrtimer_group_ops,
+	.ct_owner	= THIS_MODULE,
+};
+
+static struct config_item_type iio_cfs_type = {
+	/* nothing to create but the default groups */
+	.ct_owner	= THIS_MODULE,
+};
+
+static struct config_group iio_triggers_group;
+static struct config_group iio_hrtimer_group;
+
+static struct config_group *iio_triggers_def_groups[] = {
+	&iio_hrtimer_group,
+	NULL
+};
+
+static struct config_group *iio_cfs_def_groups[] = {
+	&iio_triggers_group,
+	NULL
+};
+
+static struct configfs_subsystem iio_cfs_subsys = {
+	.su_group = {
+		.cg_item = {
+			.ci_namebuf = "iio",
+			.ci_type = &iio_cfs_type,
+		},
+		.default_groups = iio_cfs_def_groups,
+	},
+	.su_mutex = __MUTEX_INITIALIZER(iio_cfs_subsys.su_mutex),
+};
+
+static int __init iio_hrtimer_trig_init(void)
+{
+	config_group_init(&iio_cfs_subsys.su_group);
+	config_group_init_type_name(&iio_triggers_group, "triggers",
+				    &iio_cfs_type);
+	iio_triggers_group.default_groups = iio_triggers_def_groups;
+	config_group_init_type_name(&iio_hrtimer_group, "hrtimer",
+				    &iio_hrtimer_group_type);
+
+	return configfs_register_subsystem(&iio_cfs_subsys);
+}
+module_init(iio_hrtimer_trig_init);
+
+static void __exit iio_hrtimer_trig_exit(void)
+{
+	configfs_unregister_subsystem(&iio_cfs_subsys);
+}
+module_exit(iio_hrtimer_trig_exit);
+
+MODULE_DESCRIPTION("Periodic hrtimer trigger for the IIO subsystem");
+MODULE_LICENSE("GPL v2");
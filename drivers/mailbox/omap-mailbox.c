@@ -133,6 +133,14 @@ static unsigned int mbox_kfifo_size = CONFIG_OMAP_MBOX_KFIFO_SIZE;
 module_param(mbox_kfifo_size, uint, S_IRUGO);
 MODULE_PARM_DESC(mbox_kfifo_size, "Size of omap's mailbox kfifo (bytes)");
 
+static bool mbox_rx_coalesce = true;
+module_param(mbox_rx_coalesce, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mbox_rx_coalesce,
+		 "Deliver repeated messages once per rx batch (default: Y)");
+
+/* messages taken out of the kfifo in one go by the rx work */
+#define MBOX_RX_BATCH	16
+
 static struct omap_mbox *mbox_chan_to_omap_mbox(struct mbox_chan *chan)
 {
 	if (!chan || !chan->con_priv)
@@ -301,21 +309,45 @@ void omap_mbox_disable_irq(struct mbox_chan *chan, omap_mbox_irq_t irq)
 }
 EXPORT_SYMBOL(omap_mbox_disable_irq);
 
+static bool mbox_rx_seen(const mbox_msg_t *msgs, int n, mbox_msg_t msg)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (msgs[i] == msg)
+			return true;
+
+	return false;
+}
+
 /*
  * Message receiver(workqueue)
+ *
+ * The queue is drained a batch at a time.  remoteproc kicks carry the
+ * vring index and a single callback processes everything queued on that
+ * vring, so with mbox_rx_coalesce a message that already went up earlier
+ * in the same batch is dropped instead of scanning the vring again.
  */
 static void mbox_rx_work(struct work_struct *work)
 {
 	struct omap_mbox_queue *mq =
 			container_of(work, struct omap_mbox_queue, work);
-	mbox_msg_t msg;
-	int len;
-
-	while (kfifo_len(&mq->fifo) >= sizeof(msg)) {
-		len = kfifo_out(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
-		WARN_ON(len != sizeof(msg));
+	mbox_msg_t msgs[MBOX_RX_BATCH], msg;
+	int len, n, i, sent;
+
+	while (kfifo_len(&mq->fifo) >= sizeof(msgs[0])) {
+		len = kfifo_out(&mq->fifo, (unsigned char *)msgs, sizeof(msgs));
+		WARN_ON(len % sizeof(msgs[0]));
+		n = len / sizeof(msgs[0]);
+
+		for (i = 0, sent = 0; i < n; i++) {
+			msg = msgs[i];
+			if (mbox_rx_coalesce && mbox_rx_seen(msgs, sent, msg))
+				continue;
+			msgs[sent++] = msg;
+			mbox_chan_received_data(mq->mbox->chan, (void *)msg);
+		}
 
-		mbox_chan_received_data(mq->mbox->chan, (void *)msg);
 		spin_lock_irq(&mq->lock);
 		if (mq->full) {
 			mq->full = false;
@@ -137,6 +137,14 @@ struct crypt_config {
 	wait_queue_head_t write_thread_wait;
 	struct rb_root write_tree;
 
+	/*
+	 * Optional limit on the requests handed to an asynchronous cipher
+	 * and not completed yet, to keep an offload engine's queue short.
+	 */
+	unsigned int max_inflight;
+	atomic_t inflight;
+	wait_queue_head_t inflight_wait;
+
 	char *cipher;
 	char *cipher_string;
 
@@ -932,6 +940,12 @@ static int crypt_convert(struct crypt_config *cc,
 		case -EINPROGRESS:
 			ctx->req = NULL;
 			ctx->cc_sector++;
+			if (cc->max_inflight) {
+				atomic_inc(&cc->inflight);
+				wait_event(cc->inflight_wait,
+					   atomic_read(&cc->inflight) <
+					   cc->max_inflight);
+			}
 			continue;
 
 		/* sync */
@@ -1360,6 +1374,10 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 
 	crypt_free_req(cc, req_of_dmreq(cc, dmreq), io->base_bio);
 
+	if (cc->max_inflight &&
+	    atomic_dec_return(&cc->inflight) < cc->max_inflight)
+		wake_up(&cc->inflight_wait);
+
 	if (!atomic_dec_and_test(&ctx->cc_pending))
 		return;
 
@@ -1714,6 +1732,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	struct crypt_config *cc;
 	unsigned int key_size, opt_params;
 	unsigned long long tmpll;
+	unsigned int val;
 	int ret;
 	size_t iv_size_padding;
 	struct dm_arg_set as;
@@ -1721,7 +1740,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	char dummy;
 
 	static struct dm_arg _args[] = {
-		{0, 3, "Invalid number of feature args"},
+		{0, 4, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1834,6 +1853,10 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 			else if (!strcasecmp(opt_string, "submit_from_crypt_cpus"))
 				set_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
 
+			else if (sscanf(opt_string, "max_inflight:%u%c",
+					&val, &dummy) == 1 && val)
+				cc->max_inflight = val;
+
 			else {
 				ti->error = "Invalid feature arguments";
 				goto bad;
@@ -1861,6 +1884,9 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	init_waitqueue_head(&cc->write_thread_wait);
 	cc->write_tree = RB_ROOT;
 
+	atomic_set(&cc->inflight, 0);
+	init_waitqueue_head(&cc->inflight_wait);
+
 	cc->write_thread = kthread_create(dmcrypt_write, cc, "dmcrypt_write");
 	if (IS_ERR(cc->write_thread)) {
 		ret = PTR_ERR(cc->write_thread);
@@ -1938,6 +1964,7 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		num_feature_args += !!ti->num_discard_bios;
 		num_feature_args += test_bit(DM_CRYPT_SAME_CPU, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
+		num_feature_args += !!cc->max_inflight;
 		if (num_feature_args) {
 			DMEMIT(" %d", num_feature_args);
 			if (ti->num_discard_bios)
@@ -1946,6 +1973,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 				DMEMIT(" same_cpu_crypt");
 			if (test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags))
 				DMEMIT(" submit_from_crypt_cpus");
+			if (cc->max_inflight)
+				DMEMIT(" max_inflight:%u", cc->max_inflight);
 		}
 
 		break;
@@ -2054,7 +2083,7 @@ static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 14, 1},
+	.version = {1, 15, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
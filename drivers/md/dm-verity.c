@@ -12,6 +12,12 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * The optional "check_at_most_once" feature argument keeps a bitmap of data
+ * blocks that were already verified and does not hash them again when they
+ * are re-read, e.g. after being evicted from the page cache. This trades the
+ * protection against later tampering with the data device (the hash device
+ * is still checked) for lower read latency.
  */
 
 #include "dm-bufio.h"
@@ -19,6 +25,7 @@
 #include <linux/module.h>
 #include <linux/device-mapper.h>
 #include <linux/reboot.h>
+#include <linux/vmalloc.h>
 #include <crypto/hash.h>
 
 #define DM_MSG_PREFIX			"verity"
@@ -35,6 +42,7 @@
 
 #define DM_VERITY_OPT_LOGGING		"ignore_corruption"
 #define DM_VERITY_OPT_RESTART		"restart_on_corruption"
+#define DM_VERITY_OPT_AT_MOST_ONCE	"check_at_most_once"
 
 static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
@@ -75,6 +83,7 @@ struct dm_verity {
 	int hash_failed;	/* set to 1 if hash of any block failed */
 	enum verity_mode mode;	/* mode for handling verification errors */
 	unsigned corrupted_errs;/* Number of errors for corrupted blocks */
+	unsigned long *validated_blocks; /* bitset of blocks validated once */
 
 	mempool_t *vec_mempool;	/* mempool of bio vector */
 
@@ -362,6 +371,13 @@ static int verity_verify_io(struct dm_verity_io *io)
 		int r;
 		unsigned todo;
 
+		if (v->validated_blocks &&
+		    likely(test_bit(io->block + b, v->validated_blocks))) {
+			bio_advance_iter(bio, &io->iter,
+					 1 << v->data_dev_block_bits);
+			continue;
+		}
+
 		if (likely(v->levels)) {
 			/*
 			 * First, we try to get the requested hash for
@@ -442,7 +458,8 @@ test_block_hash:
 			if (verity_handle_err(v, DM_VERITY_BLOCK_TYPE_DATA,
 					      io->block + b))
 				return -EIO;
-		}
+		} else if (v->validated_blocks)
+			set_bit(io->block + b, v->validated_blocks);
 	}
 
 	return 0;
@@ -525,6 +542,21 @@ no_prefetch_cluster:
 static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 {
 	struct dm_verity_prefetch_work *pw;
+	sector_t block = io->block;
+	unsigned n_blocks = io->n_blocks;
+
+	/* Only the hash blocks of not yet validated data blocks are needed */
+	if (v->validated_blocks) {
+		while (n_blocks && test_bit(block, v->validated_blocks)) {
+			block++;
+			n_blocks--;
+		}
+		while (n_blocks && test_bit(block + n_blocks - 1,
+					    v->validated_blocks))
+			n_blocks--;
+		if (!n_blocks)
+			return;
+	}
 
 	pw = kmalloc(sizeof(struct dm_verity_prefetch_work),
 		GFP_NOIO | __GFP_NORETRY | __GFP_NOMEMALLOC | __GFP_NOWARN);
@@ -534,8 +566,8 @@ static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 
 	INIT_WORK(&pw->work, verity_prefetch_io);
 	pw->v = v;
-	pw->block = io->block;
-	pw->n_blocks = io->n_blocks;
+	pw->block = block;
+	pw->n_blocks = n_blocks;
 	queue_work(v->verify_wq, &pw->work);
 }
 
@@ -592,7 +624,7 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 {
 	struct dm_verity *v = ti->private;
 	unsigned sz = 0;
-	unsigned x;
+	unsigned x, args;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
@@ -617,8 +649,12 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 		else
 			for (x = 0; x < v->salt_size; x++)
 				DMEMIT("%02x", v->salt[x]);
+		args = (v->mode != DM_VERITY_MODE_EIO) + !!v->validated_blocks;
+		if (!args)
+			break;
+		DMEMIT(" %u", args);
 		if (v->mode != DM_VERITY_MODE_EIO) {
-			DMEMIT(" 1 ");
+			DMEMIT(" ");
 			switch (v->mode) {
 			case DM_VERITY_MODE_LOGGING:
 				DMEMIT(DM_VERITY_OPT_LOGGING);
@@ -630,6 +666,8 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 				BUG();
 			}
 		}
+		if (v->validated_blocks)
+			DMEMIT(" " DM_VERITY_OPT_AT_MOST_ONCE);
 		break;
 	}
 }
@@ -697,6 +735,7 @@ static void verity_dtr(struct dm_target *ti)
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
+	vfree(v->validated_blocks);
 	kfree(v->salt);
 	kfree(v->root_digest);
 
@@ -741,7 +780,7 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	char dummy;
 
 	static struct dm_arg _args[] = {
-		{0, 1, "Invalid number of feature args"},
+		{0, 2, "Invalid number of feature args"},
 	};
 
 	v = kzalloc(sizeof(struct dm_verity), GFP_KERNEL);
@@ -905,7 +944,19 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 				v->mode = DM_VERITY_MODE_LOGGING;
 			else if (!strcasecmp(opt_string, DM_VERITY_OPT_RESTART))
 				v->mode = DM_VERITY_MODE_RESTART;
-			else {
+			else if (!strcasecmp(opt_string,
+					     DM_VERITY_OPT_AT_MOST_ONCE)) {
+				if (v->validated_blocks)
+					continue;
+				v->validated_blocks =
+					vzalloc(BITS_TO_LONGS(v->data_blocks) *
+						sizeof(unsigned long));
+				if (!v->validated_blocks) {
+					ti->error = "Cannot allocate bitset for check_at_most_once";
+					r = -ENOMEM;
+					goto bad;
+				}
+			} else {
 				ti->error = "Invalid feature arguments";
 				r = -EINVAL;
 				goto bad;
@@ -988,7 +1039,7 @@ bad:
 
 static struct target_type verity_target = {
 	.name		= "verity",
-	.version	= {1, 2, 0},
+	.version	= {1, 3, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
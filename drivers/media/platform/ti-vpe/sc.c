@@ -55,9 +55,10 @@ void sc_dump_regs(struct sc_data *sc)
 
 /*
  * set the horizontal scaler coefficients according to the ratio of output to
- * input widths, after accounting for up to two levels of decimation
+ * input widths, after accounting for up to two levels of decimation. Returns
+ * the index of the coefficient table used.
  */
-void sc_set_hs_coeffs(struct sc_data *sc, void *addr, unsigned int src_w,
+int sc_set_hs_coeffs(struct sc_data *sc, void *addr, unsigned int src_w,
 		unsigned int dst_w)
 {
 	int sixteenths;
@@ -98,14 +99,14 @@ void sc_set_hs_coeffs(struct sc_data *sc, void *addr, unsigned int src_w,
 		coeff_h += SC_NUM_TAPS_MEM_ALIGN - SC_H_NUM_TAPS;
 	}
 
-	sc->load_coeff_h = true;
+	return idx;
 }
 
 /*
  * set the vertical scaler coefficients according to the ratio of output to
- * input heights
+ * input heights. Returns the index of the coefficient table used.
  */
-void sc_set_vs_coeffs(struct sc_data *sc, void *addr, unsigned int src_h,
+int sc_set_vs_coeffs(struct sc_data *sc, void *addr, unsigned int src_h,
 		unsigned int dst_h)
 {
 	int sixteenths;
@@ -138,7 +139,7 @@ void sc_set_vs_coeffs(struct sc_data *sc, void *addr, unsigned int src_h,
 		coeff_v += SC_NUM_TAPS_MEM_ALIGN - SC_V_NUM_TAPS;
 	}
 
-	sc->load_coeff_v = true;
+	return idx;
 }
 
 void sc_config_scaler(struct sc_data *sc, u32 *sc_reg0, u32 *sc_reg8,
@@ -281,6 +282,8 @@ struct sc_data *sc_create(struct platform_device *pdev)
 	}
 
 	sc->pdev = pdev;
+	sc->loaded_hs_idx = -1;
+	sc->loaded_vs_idx = -1;
 
 	sc->res = platform_get_resource_byname(pdev, IORESOURCE_MEM, "sc");
 	if (!sc->res) {
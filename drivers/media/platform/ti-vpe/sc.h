@@ -183,19 +183,21 @@ struct sc_data {
 	void __iomem		*base;
 	struct resource		*res;
 
-	dma_addr_t		loaded_coeff_h; /* loaded h coeffs in SC */
-	dma_addr_t		loaded_coeff_v; /* loaded v coeffs in SC */
-
-	bool			load_coeff_h;	/* have new h SC coeffs */
-	bool			load_coeff_v;	/* have new v SC coeffs */
+	/*
+	 * the coefficient SRAM holds one table of scaler_hs_coeffs and one
+	 * of scaler_vs_coeffs, -1 when unknown.  Contexts that scale by
+	 * the same ratio share the tables and don't upload them again.
+	 */
+	int			loaded_hs_idx;	/* h coeff table in SC */
+	int			loaded_vs_idx;	/* v coeff table in SC */
 
 	struct platform_device *pdev;
 };
 
 void sc_dump_regs(struct sc_data *sc);
-void sc_set_hs_coeffs(struct sc_data *sc, void *addr, unsigned int src_w,
+int sc_set_hs_coeffs(struct sc_data *sc, void *addr, unsigned int src_w,
 		unsigned int dst_w);
-void sc_set_vs_coeffs(struct sc_data *sc, void *addr, unsigned int src_h,
+int sc_set_vs_coeffs(struct sc_data *sc, void *addr, unsigned int src_h,
 		unsigned int dst_h);
 void sc_config_scaler(struct sc_data *sc, u32 *sc_reg0, u32 *sc_reg8,
 		u32 *sc_reg17, unsigned int src_w, unsigned int src_h,
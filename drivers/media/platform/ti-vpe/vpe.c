@@ -414,6 +414,8 @@ struct vpe_ctx {
 	struct vpdma_buf	mmr_adb;		/* shadow reg addr/data block */
 	struct vpdma_buf	sc_coeff_h;		/* h coeff buffer */
 	struct vpdma_buf	sc_coeff_v;		/* v coeff buffer */
+	int			sc_hs_idx;		/* h coeff table idx */
+	int			sc_vs_idx;		/* v coeff table idx */
 	struct vpdma_desc_list	desc_list;		/* DMA descriptor list */
 
 	bool			deinterlacing;		/* using de-interlacer */
@@ -910,8 +912,10 @@ static int set_srcdst_params(struct vpe_ctx *ctx)
 	csc_set_coeff(ctx->dev->csc, &mmr_adb->csc_regs[0],
 		s_q_data->colorspace, d_q_data->colorspace);
 
-	sc_set_hs_coeffs(ctx->dev->sc, ctx->sc_coeff_h.addr, src_w, dst_w);
-	sc_set_vs_coeffs(ctx->dev->sc, ctx->sc_coeff_v.addr, src_h, dst_h);
+	ctx->sc_hs_idx = sc_set_hs_coeffs(ctx->dev->sc, ctx->sc_coeff_h.addr,
+					  src_w, dst_w);
+	ctx->sc_vs_idx = sc_set_vs_coeffs(ctx->dev->sc, ctx->sc_coeff_v.addr,
+					  src_h, dst_h);
 
 	sc_config_scaler(ctx->dev->sc, &mmr_adb->sc_regs0[0],
 		&mmr_adb->sc_regs8[0], &mmr_adb->sc_regs17[0],
@@ -1223,24 +1227,24 @@ static void device_run(void *priv)
 		ctx->load_mmrs = false;
 	}
 
-	if (sc->loaded_coeff_h != ctx->sc_coeff_h.dma_addr ||
-			sc->load_coeff_h) {
+	/*
+	 * the coefficients only depend on the scaling ratios, keep whatever
+	 * the scaler has if another context left the same tables behind
+	 */
+	if (sc->loaded_hs_idx != ctx->sc_hs_idx) {
 		vpdma_map_desc_buf(ctx->dev->vpdma, &ctx->sc_coeff_h);
 		vpdma_add_cfd_block(&ctx->desc_list, CFD_SC_CLIENT,
 			&ctx->sc_coeff_h, 0);
 
-		sc->loaded_coeff_h = ctx->sc_coeff_h.dma_addr;
-		sc->load_coeff_h = false;
+		sc->loaded_hs_idx = ctx->sc_hs_idx;
 	}
 
-	if (sc->loaded_coeff_v != ctx->sc_coeff_v.dma_addr ||
-			sc->load_coeff_v) {
+	if (sc->loaded_vs_idx != ctx->sc_vs_idx) {
 		vpdma_map_desc_buf(ctx->dev->vpdma, &ctx->sc_coeff_v);
 		vpdma_add_cfd_block(&ctx->desc_list, CFD_SC_CLIENT,
 			&ctx->sc_coeff_v, SC_COEF_SRAM_SIZE >> 4);
 
-		sc->loaded_coeff_v = ctx->sc_coeff_v.dma_addr;
-		sc->load_coeff_v = false;
+		sc->loaded_vs_idx = ctx->sc_vs_idx;
 	}
 
 	/* output data descriptors */
@@ -2036,6 +2040,7 @@ static const struct v4l2_ioctl_ops vpe_ioctl_ops = {
 	.vidioc_querybuf		= v4l2_m2m_ioctl_querybuf,
 	.vidioc_qbuf			= v4l2_m2m_ioctl_qbuf,
 	.vidioc_dqbuf			= v4l2_m2m_ioctl_dqbuf,
+	.vidioc_expbuf			= v4l2_m2m_ioctl_expbuf,
 	.vidioc_streamon		= v4l2_m2m_ioctl_streamon,
 	.vidioc_streamoff		= v4l2_m2m_ioctl_streamoff,
 
@@ -2350,6 +2355,8 @@ static int vpe_open(struct file *file)
 	ctx->bufs_per_job = VPE_DEF_BUFS_PER_JOB;
 
 	ctx->load_mmrs = true;
+	ctx->sc_hs_idx = -1;
+	ctx->sc_vs_idx = -1;
 
 	vpe_dbg(dev, "created instance %p, m2m_ctx: %p\n",
 		ctx, ctx->fh.m2m_ctx);
@@ -1349,6 +1349,15 @@ static void uvc_video_complete(struct urb *urb)
 	}
 }
 
+/*
+ * Coherent memory is uncached on non-coherent architectures such as ARM, and
+ * the decode memcpy() out of it then runs at uncached read speed. Use cached
+ * kmalloc() buffers there and let the USB core map them for each transfer.
+ */
+#if !defined(CONFIG_DMA_NONCOHERENT) && !defined(CONFIG_ARM)
+#define UVC_URB_COHERENT
+#endif
+
 /*
  * Free transfer buffers.
  */
@@ -1358,7 +1367,7 @@ static void uvc_free_urb_buffers(struct uvc_streaming *stream)
 
 	for (i = 0; i < UVC_URBS; ++i) {
 		if (stream->urb_buffer[i]) {
-#ifndef CONFIG_DMA_NONCOHERENT
+#ifdef UVC_URB_COHERENT
 			usb_free_coherent(stream->dev->udev, stream->urb_size,
 				stream->urb_buffer[i], stream->urb_dma[i]);
 #else
@@ -1403,7 +1412,7 @@ static int uvc_alloc_urb_buffers(struct uvc_streaming *stream,
 	for (; npackets > 1; npackets /= 2) {
 		for (i = 0; i < UVC_URBS; ++i) {
 			stream->urb_size = psize * npackets;
-#ifndef CONFIG_DMA_NONCOHERENT
+#ifdef UVC_URB_COHERENT
 			stream->urb_buffer[i] = usb_alloc_coherent(
 				stream->dev->udev, stream->urb_size,
 				gfp_flags | __GFP_NOWARN, &stream->urb_dma[i]);
@@ -1509,7 +1518,7 @@ static int uvc_init_video_isoc(struct uvc_streaming *stream,
 		urb->context = stream;
 		urb->pipe = usb_rcvisocpipe(stream->dev->udev,
 				ep->desc.bEndpointAddress);
-#ifndef CONFIG_DMA_NONCOHERENT
+#ifdef UVC_URB_COHERENT
 		urb->transfer_flags = URB_ISO_ASAP | URB_NO_TRANSFER_DMA_MAP;
 		urb->transfer_dma = stream->urb_dma[i];
 #else
@@ -1574,7 +1583,7 @@ static int uvc_init_video_bulk(struct uvc_streaming *stream,
 		usb_fill_bulk_urb(urb, stream->dev->udev, pipe,
 			stream->urb_buffer[i], size, uvc_video_complete,
 			stream);
-#ifndef CONFIG_DMA_NONCOHERENT
+#ifdef UVC_URB_COHERENT
 		urb->transfer_flags = URB_NO_TRANSFER_DMA_MAP;
 		urb->transfer_dma = stream->urb_dma[i];
 #endif
@@ -637,6 +637,8 @@ extern int uvc_queue_buffer(struct uvc_video_queue *queue,
 		struct v4l2_buffer *v4l2_buf);
 extern int uvc_dequeue_buffer(struct uvc_video_queue *queue,
 		struct v4l2_buffer *v4l2_buf, int nonblocking);
+extern int uvc_export_buffer(struct uvc_video_queue *queue,
+		struct v4l2_exportbuffer *exp);
 extern int uvc_queue_streamon(struct uvc_video_queue *queue,
 			      enum v4l2_buf_type type);
 extern int uvc_queue_streamoff(struct uvc_video_queue *queue,
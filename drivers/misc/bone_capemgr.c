@@ -40,6 +40,9 @@
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/nvmem-consumer.h>
+#include <linux/ktime.h>
+#include <linux/notifier.h>
+#include <linux/crc32.h>
 
 /* disabled capes */
 static char *disable_partno;
@@ -53,7 +56,12 @@ module_param(enable_partno, charp, 0444);
 MODULE_PARM_DESC(enable_partno,
 		"Comma delimited list of PART-NUMBER[:REV] of enabled capes");
 
-/* delay to scan on boot until rootfs appears */
+/*
+ * Failed slots are retried whenever something happens that may let them load
+ * (another slot loading or unloading, a driver binding). Nothing signals the
+ * root filesystem showing up though, so while booting they are also retried
+ * at this period.
+ */
 static int boot_scan_period = 1000;
 module_param(boot_scan_period, int, 0444);
 MODULE_PARM_DESC(boot_scan_period,
@@ -116,6 +124,12 @@ struct bone_cape_slot {
 
 	/* load priority */
 	int priority;
+
+	/* load timing, reported in the load_times attribute */
+	ktime_t			load_start;
+	u32			load_time_us;
+	u32			fetch_time_us;
+	u32			apply_time_us;
 };
 
 struct bone_baseboard {
@@ -148,6 +162,19 @@ struct capemgr_info {
 
 	/* wait queue for keeping the priorities straight */
 	wait_queue_head_t	load_wq;
+
+	/* bumped on every event failed slots should be retried on */
+	atomic_t		load_events;
+	struct notifier_block	bus_nb;
+
+	/* phandle resolution and overlay creation go one slot at a time */
+	struct mutex		apply_mutex;
+
+	/* identity record of the last full scan */
+	struct capemgr_id_cache	*id_cache;
+	struct nvmem_cell	*id_cache_cell;
+	size_t			id_cache_cell_size;
+	bool			id_cache_dirty;
 };
 
 static int bone_slot_fill_override(struct bone_cape_slot *slot,
@@ -382,6 +409,212 @@ char *cape_ee_field_get(const void *data,
 	return ee_field_get(&cape_sig_fields[field], data, field, buf, bufsz);
 }
 
+/*
+ * Identity record of the baseboard and the cape slots as found by the last
+ * full EEPROM scan. It's either handed over by the bootloader in the
+ * identity-cache property of the capemgr node, or kept in a reserved EEPROM
+ * area pointed to by the identity-cache nvmem cell. On boot only the header
+ * and serial number of each EEPROM are read and compared against it; the
+ * full contents are read only when they don't match.
+ */
+#define CAPEMGR_ID_CACHE_MAGIC		0x434d4944	/* "CMID" */
+#define CAPEMGR_ID_CACHE_VERSION	1
+
+struct capemgr_id_entry {
+	u8	present;
+	u8	reserved[3];
+	char	signature[256];
+} __packed;
+
+struct capemgr_id_cache {
+	__le32	magic;
+	__le32	crc;		/* crc32 of everything after this field */
+	__le16	version;
+	__le16	nslots;
+	__le32	reserved;
+	struct capemgr_id_entry baseboard;
+	struct capemgr_id_entry slot[0];
+} __packed;
+
+#define CAPEMGR_ID_CACHE_CRC_OFFSET \
+	(offsetof(struct capemgr_id_cache, crc) + sizeof(__le32))
+
+static size_t capemgr_id_cache_size(unsigned int nslots)
+{
+	return sizeof(struct capemgr_id_cache) +
+		nslots * sizeof(struct capemgr_id_entry);
+}
+
+static u32 capemgr_id_cache_crc(const struct capemgr_id_cache *cache,
+		size_t size)
+{
+	return crc32(0, (const u8 *)cache + CAPEMGR_ID_CACHE_CRC_OFFSET,
+			size - CAPEMGR_ID_CACHE_CRC_OFFSET);
+}
+
+static void capemgr_id_cache_load(struct capemgr_info *info)
+{
+	struct device *dev = &info->pdev->dev;
+	const struct capemgr_id_cache *cache;
+	struct nvmem_cell *cell;
+	void *buf = NULL;
+	size_t size;
+	int len;
+
+	/* an EEPROM area is optional, but needed to keep the record fresh */
+	cell = nvmem_cell_get(dev, "identity-cache");
+	if (!IS_ERR(cell))
+		info->id_cache_cell = cell;
+
+	/* a record handed over by the bootloader takes precedence */
+	cache = of_get_property(dev->of_node, "identity-cache", &len);
+	if (cache == NULL && info->id_cache_cell) {
+		buf = nvmem_cell_read(info->id_cache_cell, &size);
+		if (IS_ERR(buf)) {
+			dev_warn(dev, "Cannot read identity cache (ret=%ld)\n",
+					PTR_ERR(buf));
+			nvmem_cell_put(info->id_cache_cell);
+			info->id_cache_cell = NULL;
+			return;
+		}
+		info->id_cache_cell_size = size;
+		cache = buf;
+		len = size;
+	}
+
+	if (cache == NULL)
+		return;
+
+	if (len < sizeof(*cache) ||
+	    le32_to_cpu(cache->magic) != CAPEMGR_ID_CACHE_MAGIC ||
+	    le16_to_cpu(cache->version) != CAPEMGR_ID_CACHE_VERSION)
+		goto out;
+
+	size = capemgr_id_cache_size(le16_to_cpu(cache->nslots));
+	if (len < size ||
+	    le32_to_cpu(cache->crc) != capemgr_id_cache_crc(cache, size)) {
+		dev_warn(dev, "Ignoring corrupted identity cache\n");
+		goto out;
+	}
+
+	info->id_cache = kmemdup(cache, size, GFP_KERNEL);
+out:
+	kfree(buf);
+}
+
+static const struct capemgr_id_entry *
+capemgr_id_cache_slot(struct capemgr_info *info, struct bone_cape_slot *slot)
+{
+	if (info->id_cache == NULL ||
+	    slot->slotno >= le16_to_cpu(info->id_cache->nslots))
+		return NULL;
+
+	return &info->id_cache->slot[slot->slotno];
+}
+
+/*
+ * Check the header and serial number in the EEPROM behind @cell against a
+ * cached entry. An EEPROM that can't be read matches an absent entry.
+ */
+static bool capemgr_id_match(struct nvmem_cell *cell,
+		const struct capemgr_id_entry *entry,
+		const struct ee_field *serial)
+{
+	char buf[16];
+
+	if (nvmem_cell_read_range(cell, 0, buf, 4) != 0)
+		return !entry->present;
+
+	if (!entry->present || memcmp(buf, entry->signature, 4) != 0)
+		return false;
+
+	if (serial->size > sizeof(buf) ||
+	    nvmem_cell_read_range(cell, serial->start, buf, serial->size) != 0)
+		return false;
+
+	return memcmp(buf, entry->signature + serial->start,
+			serial->size) == 0;
+}
+
+/* write back the identity record if any EEPROM had to be scanned in full */
+static void capemgr_id_cache_store(struct capemgr_info *info, int slots_nr)
+{
+	struct device *dev = &info->pdev->dev;
+	struct capemgr_id_cache *cache;
+	struct capemgr_id_entry *entry;
+	struct bone_cape_slot *slot;
+	size_t size;
+	int ret;
+
+	if (!info->id_cache_cell || !info->id_cache_dirty)
+		return;
+
+	/* the cell wasn't read when the record came from the bootloader */
+	if (info->id_cache_cell_size == 0) {
+		cache = nvmem_cell_read(info->id_cache_cell,
+				&info->id_cache_cell_size);
+		if (IS_ERR(cache))
+			return;
+		kfree(cache);
+	}
+
+	size = capemgr_id_cache_size(slots_nr);
+	if (size > info->id_cache_cell_size) {
+		dev_warn(dev, "Identity cache area too small (%zu < %zu)\n",
+				info->id_cache_cell_size, size);
+		return;
+	}
+
+	/* the whole cell has to be written */
+	cache = kzalloc(info->id_cache_cell_size, GFP_KERNEL);
+	if (cache == NULL)
+		return;
+
+	cache->magic = cpu_to_le32(CAPEMGR_ID_CACHE_MAGIC);
+	cache->version = cpu_to_le16(CAPEMGR_ID_CACHE_VERSION);
+	cache->nslots = cpu_to_le16(slots_nr);
+
+	cache->baseboard.present = 1;
+	memcpy(cache->baseboard.signature, info->baseboard.signature,
+			sizeof(cache->baseboard.signature));
+
+	mutex_lock(&info->slots_list_mutex);
+	list_for_each_entry(slot, &info->slot_list, node) {
+		if (slot->override || slot->slotno >= slots_nr)
+			continue;
+
+		entry = &cache->slot[slot->slotno];
+		if (slot->probe_failed)
+			continue;
+
+		entry->present = 1;
+		memcpy(entry->signature, slot->signature,
+				sizeof(entry->signature));
+	}
+	mutex_unlock(&info->slots_list_mutex);
+
+	cache->crc = cpu_to_le32(capemgr_id_cache_crc(cache, size));
+
+	ret = nvmem_cell_write(info->id_cache_cell, cache,
+			info->id_cache_cell_size);
+	if (ret < 0)
+		dev_warn(dev, "Failed to update identity cache (ret=%d)\n",
+				ret);
+	else
+		info->id_cache_dirty = false;
+
+	kfree(cache);
+}
+
+static void capemgr_id_cache_free(struct capemgr_info *info)
+{
+	kfree(info->id_cache);
+	info->id_cache = NULL;
+	if (info->id_cache_cell)
+		nvmem_cell_put(info->id_cache_cell);
+	info->id_cache_cell = NULL;
+}
+
 #ifdef CONFIG_OF
 static const struct of_device_id capemgr_of_match[] = {
 	{
@@ -401,6 +634,15 @@ static int bone_baseboard_scan(struct bone_baseboard *bbrd)
 	int ret;
 	size_t len;
 
+	if (info->id_cache && capemgr_id_match(bbrd->nvmem_cell,
+			&info->id_cache->baseboard,
+			&bbrd_sig_fields[BBRD_EE_FIELD_SERIAL_NUMBER])) {
+		memcpy(bbrd->signature, info->id_cache->baseboard.signature,
+				sizeof(bbrd->signature));
+		goto parse;
+	}
+	info->id_cache_dirty = true;
+
 	p = nvmem_cell_read(bbrd->nvmem_cell, &len);
 	if (IS_ERR(p)) {
 		ret = PTR_ERR(p);
@@ -416,6 +658,7 @@ static int bone_baseboard_scan(struct bone_baseboard *bbrd)
 	}
 	memcpy(bbrd->signature, p, sizeof(bbrd->signature));
 
+parse:
 	p = bbrd->signature;
 	if (EE_FIELD_MAKE_HEADER(p) != EE_FIELD_HEADER_VALID) {
 		dev_err(&info->pdev->dev, "Invalid board signature '%08x'\n",
@@ -447,6 +690,7 @@ static int bone_baseboard_scan(struct bone_baseboard *bbrd)
 static int bone_slot_scan(struct bone_cape_slot *slot)
 {
 	struct capemgr_info *info = slot->info;
+	const struct capemgr_id_entry *entry;
 	const u8 *p;
 	int r;
 	ssize_t len;
@@ -457,7 +701,22 @@ static int bone_slot_scan(struct bone_cape_slot *slot)
 
 	slot->probed = 1;
 
-	if (!slot->override) {
+	entry = capemgr_id_cache_slot(info, slot);
+
+	if (!slot->override && entry && capemgr_id_match(slot->nvmem_cell,
+			entry, &cape_sig_fields[CAPE_EE_FIELD_SERIAL_NUMBER])) {
+
+		/* same cape as last time, or still no cape */
+		if (!entry->present) {
+			slot->probe_failed = 1;
+			return -ENODEV;
+		}
+		memcpy(slot->signature, entry->signature,
+				sizeof(slot->signature));
+
+	} else if (!slot->override) {
+
+		info->id_cache_dirty = true;
 
 		p = nvmem_cell_read(slot->nvmem_cell, &len);
 		if (IS_ERR(p)) {
@@ -871,9 +1130,13 @@ static ssize_t slots_store(struct device *dev, struct device_attribute *attr,
 		 const char *buf, size_t count);
 
 static DEVICE_ATTR(slots, 0644, slots_show, slots_store);
+static ssize_t load_times_show(struct device *dev,
+		struct device_attribute *attr, char *buf);
+static DEVICE_ATTR_RO(load_times);
 
 static struct attribute *root_attrs_flat[] = {
 	&dev_attr_slots.attr,
+	&dev_attr_load_times.attr,
 	NULL,
 };
 
@@ -917,6 +1180,34 @@ static ssize_t slots_show(struct device *dev, struct device_attribute *attr,
 	return sz;
 }
 
+static ssize_t load_times_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct capemgr_info *info = platform_get_drvdata(pdev);
+	struct bone_cape_slot *slot;
+	ssize_t len, sz;
+
+	mutex_lock(&info->slots_list_mutex);
+	sz = 0;
+	list_for_each_entry(slot, &info->slot_list, node) {
+
+		if (!slot->loaded)
+			len = sprintf(buf, "%2d: -\n", slot->slotno);
+		else
+			len = sprintf(buf,
+				"%2d: total %uus fetch %uus apply %uus\n",
+				slot->slotno, slot->load_time_us,
+				slot->fetch_time_us, slot->apply_time_us);
+
+		buf += len;
+		sz += len;
+	}
+	mutex_unlock(&info->slots_list_mutex);
+
+	return sz;
+}
+
 static ssize_t slots_store(struct device *dev, struct device_attribute *attr,
 		 const char *buf, size_t count)
 {
@@ -1121,10 +1412,19 @@ out:
 	return err;
 }
 
-static int capemgr_load_slot(struct bone_cape_slot *slot)
+/* wake up the loaders waiting for something to change */
+static void capemgr_kick(struct capemgr_info *info)
+{
+	atomic_inc(&info->load_events);
+	wake_up_interruptible_all(&info->load_wq);
+}
+
+/* request the dtbo of the slot and unflatten it; safe to run in parallel */
+static int capemgr_fetch_slot(struct bone_cape_slot *slot)
 {
 	struct capemgr_info *info = slot->info;
 	struct device *dev = &info->pdev->dev;
+	ktime_t start = ktime_get();
 	const char *dtbo;
 	int err;
 
@@ -1164,7 +1464,7 @@ static int capemgr_load_slot(struct bone_cape_slot *slot)
 	err = request_firmware_direct(&slot->fw, slot->dtbo, dev);
 	if (err != 0) {
 		dev_dbg(dev, "failed to load firmware '%s'\n", slot->dtbo);
-		goto err_fail_no_fw;
+		return err;
 	}
 
 	dev_dbg(dev, "slot #%d: dtbo '%s' loaded; converting to live tree\n",
@@ -1174,13 +1474,33 @@ static int capemgr_load_slot(struct bone_cape_slot *slot)
 	if (slot->overlay == NULL) {
 		dev_err(dev, "slot #%d: Failed to unflatten\n",
 				slot->slotno);
-		err = -EINVAL;
-		goto err_fail;
+		release_firmware(slot->fw);
+		slot->fw = NULL;
+		return -EINVAL;
 	}
 
 	/* mark it as detached */
 	of_node_set_flag(slot->overlay, OF_DETACHED);
 
+	slot->fetch_time_us = ktime_us_delta(ktime_get(), start);
+
+	return 0;
+}
+
+/*
+ * Resolve and apply a fetched overlay. The phandles of an overlay are
+ * offset past the largest one in the live tree, so resolution and overlay
+ * creation of different slots must not interleave.
+ */
+static int capemgr_apply_slot(struct bone_cape_slot *slot)
+{
+	struct capemgr_info *info = slot->info;
+	struct device *dev = &info->pdev->dev;
+	ktime_t start = ktime_get();
+	int err;
+
+	mutex_lock(&info->apply_mutex);
+
 	/* perform resolution */
 	err = of_resolve_phandles(slot->overlay);
 	if (err != 0) {
@@ -1207,12 +1527,19 @@ static int capemgr_load_slot(struct bone_cape_slot *slot)
 	slot->loading = 0;
 	slot->loaded = 1;
 
+	mutex_unlock(&info->apply_mutex);
+
+	slot->apply_time_us = ktime_us_delta(ktime_get(), start);
+
 	dev_info(dev, "slot #%d: dtbo '%s' loaded; overlay id #%d\n",
 			slot->slotno, slot->dtbo, slot->overlay_id);
 
+	capemgr_kick(info);
+
 	return 0;
 
 err_fail:
+	mutex_unlock(&info->apply_mutex);
 
 	/* TODO: free the overlay, we can't right now cause
 	 * the unflatten method does not track it */
@@ -1221,8 +1548,22 @@ err_fail:
 	release_firmware(slot->fw);
 	slot->fw = NULL;
 
-err_fail_no_fw:
-	slot->loading = 0;
+	return err;
+}
+
+static int capemgr_load_slot(struct bone_cape_slot *slot)
+{
+	int err;
+
+	slot->load_start = ktime_get();
+
+	err = capemgr_fetch_slot(slot);
+	if (err == 0)
+		err = capemgr_apply_slot(slot);
+	if (err == 0)
+		slot->load_time_us = ktime_us_delta(ktime_get(),
+						    slot->load_start);
+
 	return err;
 }
 
@@ -1236,6 +1577,9 @@ static int capemgr_unload_slot(struct bone_cape_slot *slot)
 
 	slot->loaded = 0;
 
+	/* its resources are free again */
+	capemgr_kick(slot->info);
+
 	return 0;
 
 }
@@ -1475,8 +1819,11 @@ static int clear_to_load_condition(struct bone_cape_slot *slot)
 	mutex_lock(&info->slots_list_mutex);
 	ret = 1;
 	list_for_each_entry(slot, &info->slot_list, node) {
-		/* if any slot is loading with lowest priority */
-		if (!slot->loading)
+		/*
+		 * if any slot is loading with lowest priority; slots waiting
+		 * to be retried don't hold up the others
+		 */
+		if (!slot->loading || slot->retry_loading)
 			continue;
 		if (slot->priority < my_prio) {
 			ret = 0;
@@ -1492,83 +1839,92 @@ static int capemgr_loader(void *data)
 	struct bone_cape_slot *slot = data;
 	struct capemgr_info *info = slot->info;
 	struct device *dev = &info->pdev->dev;
-	int ret, done, other_loading, booting;
-
-	done = 0;
+	int ret, events, booting;
+	long timeout;
 
 	slot->retry_loading = 0;
+	slot->load_start = ktime_get();
 
-	dev_dbg(dev, "loader: before slot-%d %s:%s (prio %d)\n", slot->slotno,
-			slot->part_number, slot->version, slot->priority);
-
-	/*
-	 * We have a basic priority based arbitration system
-	 * Slots have priorities, so the lower priority ones
-	 * should start loading first. So each time we end up
-	 * here.
-	 */
-	ret = wait_event_interruptible(info->load_wq,
-			clear_to_load_condition(slot));
-	if (ret < 0) {
-		dev_warn(dev, "loader, Signal pending\n");
-		return ret;
-	}
-
-	dev_dbg(dev, "loader: after slot-%d %s:%s (prio %d)\n", slot->slotno,
-			slot->part_number, slot->version, slot->priority);
-
-	/* using the return value */
-	ret = capemgr_load_slot(slot);
+	for (;;) {
+		/* anything happening from now on is worth another try */
+		events = atomic_read(&info->load_events);
+
+		/* fetching the overlays of all the slots happens in parallel */
+		ret = capemgr_fetch_slot(slot);
+		if (ret == 0) {
+			dev_dbg(dev, "loader: before slot-%d %s:%s (prio %d)\n",
+				slot->slotno, slot->part_number,
+				slot->version, slot->priority);
+
+			/*
+			 * We have a basic priority based arbitration system
+			 * Slots have priorities, so the lower priority ones
+			 * get applied first.
+			 */
+			ret = wait_event_interruptible(info->load_wq,
+					clear_to_load_condition(slot));
+			if (ret < 0) {
+				dev_warn(dev, "loader, Signal pending\n");
+				release_firmware(slot->fw);
+				slot->fw = NULL;
+				slot->overlay = NULL;
+				goto done;
+			}
 
-	/* wake up all just in case */
-	wake_up_interruptible_all(&info->load_wq);
+			dev_dbg(dev, "loader: after slot-%d %s:%s (prio %d)\n",
+				slot->slotno, slot->part_number,
+				slot->version, slot->priority);
 
-	if (ret == 0)
-		goto done;
+			ret = capemgr_apply_slot(slot);
+		}
 
-	dev_dbg(dev, "loader: retrying slot-%d %s:%s (prio %d)\n", slot->slotno,
-			slot->part_number, slot->version, slot->priority);
+		if (ret == 0) {
+			slot->load_time_us = ktime_us_delta(ktime_get(),
+							    slot->load_start);
+			goto done;
+		}
 
-	/* first attempt has failed; now try each time there's any change */
-	slot->retry_loading = 1;
+		if (!slot->retry_loading) {
+			dev_dbg(dev, "loader: retrying slot-%d %s:%s (prio %d)\n",
+				slot->slotno, slot->part_number,
+				slot->version, slot->priority);
+
+			/*
+			 * first attempt has failed; from now on try each time
+			 * there's any change. Moving to the retrying set is a
+			 * change for the other slots as well, a failed retry
+			 * is not.
+			 */
+			slot->retry_loading = 1;
+			capemgr_kick(info);
+		} else {
+			/* wake up slots waiting for their turn */
+			wake_up_interruptible_all(&info->load_wq);
+		}
 
-	for (;;) {
 		booting = (system_state == SYSTEM_BOOTING);
-		other_loading = retry_loading_condition(slot);
-		if (!booting && !other_loading)
+		if (!booting && !retry_loading_condition(slot))
 			break;
 
-		/* simple wait for someone to kick us */
-		if (other_loading) {
-			DEFINE_WAIT(__wait);
-
-			prepare_to_wait(&info->load_wq, &__wait,
-					TASK_INTERRUPTIBLE);
-			finish_wait(&info->load_wq, &__wait);
-		} else {
-			/* always delay when booting */
-			msleep(boot_scan_period);
-		}
-
-		if (signal_pending(current)) {
+		timeout = booting ? msecs_to_jiffies(boot_scan_period) :
+				    MAX_SCHEDULE_TIMEOUT;
+		timeout = wait_event_interruptible_timeout(info->load_wq,
+				atomic_read(&info->load_events) != events,
+				timeout);
+		if (timeout < 0) {
 			dev_warn(dev, "loader, Signal pending\n");
 			ret = -ERESTARTSYS;
 			goto done;
 		}
-
-		/* using the return value */
-		ret = capemgr_load_slot(slot);
-		if (ret == 0)
-			goto done;
-
-		/* wake up all just in case */
-		wake_up_interruptible_all(&info->load_wq);
 	}
 
 done:
 	slot->loading = 0;
 	slot->retry_loading = 0;
 
+	/* the set of loading slots changed */
+	capemgr_kick(info);
+
 	if (ret == 0) {
 		dev_dbg(dev, "loader: done slot-%d %s:%s (prio %d)\n",
 			slot->slotno, slot->part_number, slot->version,
@@ -1586,6 +1942,18 @@ done:
 	return ret;
 }
 
+static int capemgr_bus_notify(struct notifier_block *nb,
+		unsigned long action, void *data)
+{
+	struct capemgr_info *info = container_of(nb, struct capemgr_info,
+			bus_nb);
+
+	if (action == BUS_NOTIFY_BOUND_DRIVER)
+		capemgr_kick(info);
+
+	return NOTIFY_DONE;
+}
+
 static int
 capemgr_probe(struct platform_device *pdev)
 {
@@ -1622,6 +1990,8 @@ capemgr_probe(struct platform_device *pdev)
 	mutex_init(&info->slots_list_mutex);
 
 	init_waitqueue_head(&info->load_wq);
+	atomic_set(&info->load_events, 0);
+	mutex_init(&info->apply_mutex);
 
 	baseboardmaps_node = NULL;
 
@@ -1644,6 +2014,8 @@ capemgr_probe(struct platform_device *pdev)
 		goto err_exit;
 	}
 
+	capemgr_id_cache_load(info);
+
 	ret = bone_baseboard_scan(bbrd);
 	if (ret != 0) {
 		dev_err(&pdev->dev, "Failed to scan baseboard eeprom\n");
@@ -1700,6 +2072,10 @@ capemgr_probe(struct platform_device *pdev)
 		}
 	}
 
+	/* the record is only used for the scans of the boot slots */
+	capemgr_id_cache_store(info, slots_nr);
+	capemgr_id_cache_free(info);
+
 	/* iterate over enable_partno (if there) */
 	if (enable_partno && strlen(enable_partno) > 0) {
 
@@ -1788,6 +2164,10 @@ capemgr_probe(struct platform_device *pdev)
 	/* automatically cleared by driver core now */
 	pdev->dev.groups = attr_groups;
 
+	/* deferred probes finishing may be what a failed slot waits for */
+	info->bus_nb.notifier_call = capemgr_bus_notify;
+	bus_register_notifier(&platform_bus_type, &info->bus_nb);
+
 	/* now load each (take lock to be sure */
 	mutex_lock(&info->slots_list_mutex);
 
@@ -1829,6 +2209,7 @@ capemgr_probe(struct platform_device *pdev)
 	return 0;
 
 err_exit:
+	capemgr_id_cache_free(info);
 	if (bbrd->nvmem_cell)
 		nvmem_cell_put(bbrd->nvmem_cell);
 	of_node_put(baseboardmaps_node);
@@ -1845,6 +2226,8 @@ static int capemgr_remove(struct platform_device *pdev)
 	struct bone_cape_slot *slot, *slotn;
 	int ret;
 
+	bus_unregister_notifier(&platform_bus_type, &info->bus_nb);
+
 	mutex_lock(&info->slots_list_mutex);
 	list_for_each_entry_safe(slot, slotn, &info->slot_list, node)
 		capemgr_remove_slot_no_lock(slot);
@@ -27,9 +27,15 @@
 #include <linux/of_device.h>
 #include <linux/of_gpio.h>
 #include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/uaccess.h>
 #include <linux/pinctrl/pinctrl.h>
 #include <linux/pinctrl/pinmux.h>
 #include <linux/pinctrl/consumer.h>
+#include <linux/bone_pinmux.h>
 
 static const struct of_device_id bone_pinmux_helper_of_match[] = {
 	{
@@ -39,11 +45,81 @@ static const struct of_device_id bone_pinmux_helper_of_match[] = {
 };
 MODULE_DEVICE_TABLE(of, bone_pinmux_helper_of_match);
 
+/* a state of the helper's pinctrl, looked up once at probe time */
+struct pinmux_helper_state {
+	const char *name;
+	struct pinctrl_state *state;
+};
+
 struct pinmux_helper_data {
+	struct list_head node;
+	struct device *dev;
 	struct pinctrl *pinctrl;
 	char *selected_state_name;
+	struct pinmux_helper_state *states;
+	int nstates;
+	struct pinctrl_state *cur;
 };
 
+/* all bound helpers; the lock also serializes every state switch */
+static LIST_HEAD(pinmux_helper_list);
+static DEFINE_MUTEX(pinmux_helper_lock);
+
+static int pinmux_helper_cache_states(struct device *dev,
+		struct pinmux_helper_data *data)
+{
+	struct pinmux_helper_state *hs;
+	int i, n;
+
+	n = of_property_count_strings(dev->of_node, "pinctrl-names");
+	if (n <= 0)
+		return 0;
+
+	data->states = devm_kcalloc(dev, n, sizeof(*data->states),
+			GFP_KERNEL);
+	if (data->states == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < n; i++) {
+		hs = &data->states[data->nstates];
+		if (of_property_read_string_index(dev->of_node,
+				"pinctrl-names", i, &hs->name))
+			continue;
+		hs->state = pinctrl_lookup_state(data->pinctrl, hs->name);
+		if (IS_ERR(hs->state))
+			continue;
+		data->nstates++;
+	}
+
+	return 0;
+}
+
+static struct pinctrl_state *pinmux_helper_find_state(
+		struct pinmux_helper_data *data, const char *name)
+{
+	int i;
+
+	for (i = 0; i < data->nstates; i++)
+		if (strcmp(data->states[i].name, name) == 0)
+			return data->states[i].state;
+
+	return NULL;
+}
+
+/* @name is the helper's node name or device name */
+static struct pinmux_helper_data *pinmux_helper_find(const char *name)
+{
+	struct pinmux_helper_data *data;
+
+	list_for_each_entry(data, &pinmux_helper_list, node) {
+		if (strcmp(data->dev->of_node->name, name) == 0 ||
+		    strcmp(dev_name(data->dev), name) == 0)
+			return data;
+	}
+
+	return NULL;
+}
+
 static ssize_t pinmux_helper_show_state(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -79,8 +155,12 @@ static ssize_t pinmux_helper_store_state(struct device *dev,
 	if (s != NULL)
 		*s = '\0';
 
+	mutex_lock(&pinmux_helper_lock);
+
 	/* try to select default state at first (if it exists) */
-	state = pinctrl_lookup_state(data->pinctrl, state_name);
+	state = pinmux_helper_find_state(data, state_name);
+	if (state == NULL)
+		state = pinctrl_lookup_state(data->pinctrl, state_name);
 	if (!IS_ERR(state)) {
 		err = pinctrl_select_state(data->pinctrl, state);
 		if (err != 0)
@@ -94,7 +174,11 @@ static ssize_t pinmux_helper_store_state(struct device *dev,
 	if (err == 0) {
 		kfree(data->selected_state_name);
 		data->selected_state_name = state_name;
-	}
+		data->cur = state;
+	} else
+		kfree(state_name);
+
+	mutex_unlock(&pinmux_helper_lock);
 
 	return err ? err : count;
 }
@@ -111,6 +195,139 @@ static const struct attribute_group pinmux_helper_attr_group = {
 	.attrs = pinmux_helper_attributes,
 };
 
+struct pinmux_helper_op {
+	struct pinmux_helper_data *data;
+	struct pinctrl_state *state;
+	struct pinctrl_state *prev;
+	char *name;
+};
+
+/*
+ * Switch a set of helpers under one lock hold.  Every helper and state is
+ * resolved before the first pad is touched, the switch itself only selects
+ * the pinctrl states cached at probe time.  If a select fails the helpers
+ * already switched are put back into their previous state.
+ */
+static int pinmux_helper_switch(struct bone_pinmux_switch *sw, u32 count,
+		u32 *failed)
+{
+	struct pinmux_helper_op *ops;
+	struct pinmux_helper_data *data;
+	u32 i;
+	int err = 0;
+
+	ops = kcalloc(count, sizeof(*ops), GFP_KERNEL);
+	if (ops == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		sw[i].helper[BONE_PINMUX_NAME_LEN - 1] = '\0';
+		sw[i].state[BONE_PINMUX_NAME_LEN - 1] = '\0';
+		ops[i].name = kstrdup(sw[i].state, GFP_KERNEL);
+		if (ops[i].name == NULL) {
+			err = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	mutex_lock(&pinmux_helper_lock);
+
+	for (i = 0; i < count; i++) {
+		*failed = i;
+		ops[i].data = pinmux_helper_find(sw[i].helper);
+		if (ops[i].data == NULL) {
+			err = -ENODEV;
+			goto out_unlock;
+		}
+		ops[i].state = pinmux_helper_find_state(ops[i].data,
+				sw[i].state);
+		if (ops[i].state == NULL) {
+			err = -EINVAL;
+			goto out_unlock;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		data = ops[i].data;
+		ops[i].prev = data->cur;
+		err = pinctrl_select_state(data->pinctrl, ops[i].state);
+		if (err != 0) {
+			dev_err(data->dev, "Failed to select state %s\n",
+					ops[i].name);
+			*failed = i;
+			while (i-- > 0) {
+				data = ops[i].data;
+				if (ops[i].prev != NULL)
+					pinctrl_select_state(data->pinctrl,
+							ops[i].prev);
+				data->cur = ops[i].prev;
+			}
+			goto out_unlock;
+		}
+		data->cur = ops[i].state;
+	}
+
+	for (i = 0; i < count; i++) {
+		data = ops[i].data;
+		kfree(data->selected_state_name);
+		data->selected_state_name = ops[i].name;
+		ops[i].name = NULL;
+	}
+	*failed = count;
+
+out_unlock:
+	mutex_unlock(&pinmux_helper_lock);
+out_free:
+	for (i = 0; i < count; i++)
+		kfree(ops[i].name);
+	kfree(ops);
+	return err;
+}
+
+static long pinmux_helper_ioctl(struct file *file, unsigned int cmd,
+		unsigned long arg)
+{
+	struct bone_pinmux_switch_set __user *uset = (void __user *)arg;
+	struct bone_pinmux_switch_set set;
+	struct bone_pinmux_switch *sw;
+	u32 failed = 0;
+	int err;
+
+	if (cmd != BONE_PINMUX_IOC_SWITCH)
+		return -ENOTTY;
+
+	if (copy_from_user(&set, uset, sizeof(set)))
+		return -EFAULT;
+	if (set.count == 0 || set.count > BONE_PINMUX_MAX_SWITCH)
+		return -EINVAL;
+
+	sw = memdup_user((void __user *)(uintptr_t)set.entries,
+			set.count * sizeof(*sw));
+	if (IS_ERR(sw))
+		return PTR_ERR(sw);
+
+	err = pinmux_helper_switch(sw, set.count, &failed);
+	kfree(sw);
+
+	if (put_user(failed, &uset->failed))
+		return -EFAULT;
+
+	return err;
+}
+
+static const struct file_operations pinmux_helper_fops = {
+	.owner		= THIS_MODULE,
+	.unlocked_ioctl	= pinmux_helper_ioctl,
+	.compat_ioctl	= pinmux_helper_ioctl,
+	.llseek		= noop_llseek,
+};
+
+static struct miscdevice pinmux_helper_miscdev = {
+	.minor		= MISC_DYNAMIC_MINOR,
+	.name		= "bone_pinmux",
+	.fops		= &pinmux_helper_fops,
+};
+
 static int bone_pinmux_helper_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -137,6 +354,7 @@ static int bone_pinmux_helper_probe(struct platform_device *pdev)
 	}
 	data->selected_state_name = state_name;
 	strcpy(data->selected_state_name, PINCTRL_STATE_DEFAULT);
+	data->dev = dev;
 
 	platform_set_drvdata(pdev, data);
 
@@ -147,6 +365,12 @@ static int bone_pinmux_helper_probe(struct platform_device *pdev)
 		goto err_no_pinctrl;
 	}
 
+	err = pinmux_helper_cache_states(dev, data);
+	if (err) {
+		dev_err(dev, "Failed to allocate state cache\n");
+		goto err_no_mode_mem;
+	}
+
 	/* See if an initial mode is specified in the device tree */
 	mode_name = of_get_property(dev->of_node, "mode", &mode_len);
 
@@ -170,6 +394,7 @@ static int bone_pinmux_helper_probe(struct platform_device *pdev)
 			} else {
 				kfree(data->selected_state_name);
 				data->selected_state_name = state_name;
+				data->cur = state;
 				dev_notice(dev, "Set initial pinmux mode to %s\n", state_name);
 			}
 		}
@@ -185,6 +410,7 @@ static int bone_pinmux_helper_probe(struct platform_device *pdev)
 				dev_err(dev, "Failed to select default state\n");
 				goto err_no_state;
 			}
+			data->cur = state;
 		} else {
 			data->selected_state_name = '\0';
 		}
@@ -197,6 +423,10 @@ static int bone_pinmux_helper_probe(struct platform_device *pdev)
 		goto err_no_sysfs;
 	}
 
+	mutex_lock(&pinmux_helper_lock);
+	list_add_tail(&data->node, &pinmux_helper_list);
+	mutex_unlock(&pinmux_helper_lock);
+
 	return 0;
 
 err_no_sysfs:
@@ -216,6 +446,10 @@ static int bone_pinmux_helper_remove(struct platform_device *pdev)
 	struct pinmux_helper_data *data = platform_get_drvdata(pdev);
 	struct device *dev = &pdev->dev;
 
+	mutex_lock(&pinmux_helper_lock);
+	list_del(&data->node);
+	mutex_unlock(&pinmux_helper_lock);
+
 	sysfs_remove_group(&dev->kobj, &pinmux_helper_attr_group);
 	kfree(data->selected_state_name);
 	devm_pinctrl_put(data->pinctrl);
@@ -234,7 +468,28 @@ struct platform_driver bone_pinmux_helper_driver = {
 	},
 };
 
-module_platform_driver(bone_pinmux_helper_driver);
+static int __init bone_pinmux_helper_init(void)
+{
+	int err;
+
+	err = misc_register(&pinmux_helper_miscdev);
+	if (err)
+		return err;
+
+	err = platform_driver_register(&bone_pinmux_helper_driver);
+	if (err)
+		misc_deregister(&pinmux_helper_miscdev);
+
+	return err;
+}
+module_init(bone_pinmux_helper_init);
+
+static void __exit bone_pinmux_helper_exit(void)
+{
+	platform_driver_unregister(&bone_pinmux_helper_driver);
+	misc_deregister(&pinmux_helper_miscdev);
+}
+module_exit(bone_pinmux_helper_exit);
 
 MODULE_AUTHOR("Pantelis Antoniou");
 MODULE_DESCRIPTION("Beaglebone pinmux helper driver");
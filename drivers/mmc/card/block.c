@@ -167,6 +167,31 @@ static struct mmc_blk_data *mmc_blk_get(struct gendisk *disk)
 	return md;
 }
 
+/*
+ * Requests of a blk-mq queue are completed through blk_update_request(),
+ * which handles partial completion too, and __blk_mq_end_request().
+ */
+static bool mmc_blk_end_request(struct request *req, int error,
+				unsigned int nr_bytes)
+{
+	if (!req->q->mq_ops)
+		return blk_end_request(req, error, nr_bytes);
+
+	if (blk_update_request(req, error, nr_bytes))
+		return true;
+
+	__blk_mq_end_request(req, error);
+	return false;
+}
+
+static void mmc_blk_end_request_all(struct request *req, int error)
+{
+	if (req->q->mq_ops)
+		blk_mq_end_request(req, error);
+	else
+		blk_end_request_all(req, error);
+}
+
 static inline int mmc_get_devidx(struct gendisk *disk)
 {
 	int devmaj = MAJOR(disk_devt(disk));
@@ -183,7 +208,7 @@ static void mmc_blk_put(struct mmc_blk_data *md)
 	md->usage--;
 	if (md->usage == 0) {
 		int devidx = mmc_get_devidx(md->disk);
-		blk_cleanup_queue(md->queue.queue);
+		mmc_free_queue(&md->queue);
 
 		__clear_bit(devidx, dev_use);
 
@@ -1081,7 +1106,7 @@ out:
 		goto retry;
 	if (!err)
 		mmc_blk_reset_success(md, type);
-	blk_end_request(req, err, blk_rq_bytes(req));
+	mmc_blk_end_request(req, err, blk_rq_bytes(req));
 
 	return err ? 0 : 1;
 }
@@ -1148,7 +1173,7 @@ out_retry:
 	if (!err)
 		mmc_blk_reset_success(md, type);
 out:
-	blk_end_request(req, err, blk_rq_bytes(req));
+	mmc_blk_end_request(req, err, blk_rq_bytes(req));
 
 	return err ? 0 : 1;
 }
@@ -1163,7 +1188,7 @@ static int mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
 	if (ret)
 		ret = -EIO;
 
-	blk_end_request_all(req, ret);
+	mmc_blk_end_request_all(req, ret);
 
 	return ret ? 0 : 1;
 }
@@ -1746,11 +1771,12 @@ static int mmc_blk_cmd_err(struct mmc_blk_data *md, struct mmc_card *card,
 
 		blocks = mmc_sd_num_wr_blocks(card);
 		if (blocks != (u32)-1) {
-			ret = blk_end_request(req, 0, blocks << 9);
+			ret = mmc_blk_end_request(req, 0, blocks << 9);
 		}
 	} else {
 		if (!mmc_packed_cmd(mq_rq->cmd_type))
-			ret = blk_end_request(req, 0, brq->data.bytes_xfered);
+			ret = mmc_blk_end_request(req, 0,
+						  brq->data.bytes_xfered);
 	}
 	return ret;
 }
@@ -1779,7 +1805,7 @@ static int mmc_blk_end_packed_req(struct mmc_queue_req *mq_rq)
 			return ret;
 		}
 		list_del_init(&prq->queuelist);
-		blk_end_request(prq, 0, blk_rq_bytes(prq));
+		mmc_blk_end_request(prq, 0, blk_rq_bytes(prq));
 		i++;
 	}
 
@@ -1797,7 +1823,7 @@ static void mmc_blk_abort_packed_req(struct mmc_queue_req *mq_rq)
 	while (!list_empty(&packed->list)) {
 		prq = list_entry_rq(packed->list.next);
 		list_del_init(&prq->queuelist);
-		blk_end_request(prq, -EIO, blk_rq_bytes(prq));
+		mmc_blk_end_request(prq, -EIO, blk_rq_bytes(prq));
 	}
 
 	mmc_blk_clear_packed(mq_rq);
@@ -1893,7 +1919,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 				ret = mmc_blk_end_packed_req(mq_rq);
 				break;
 			} else {
-				ret = blk_end_request(req, 0,
+				ret = mmc_blk_end_request(req, 0,
 						brq->data.bytes_xfered);
 			}
 
@@ -1949,7 +1975,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			 * time, so we only reach here after trying to
 			 * read a single sector.
 			 */
-			ret = blk_end_request(req, -EIO,
+			ret = mmc_blk_end_request(req, -EIO,
 						brq->data.blksz);
 			if (!ret)
 				goto start_new_req;
@@ -1992,7 +2018,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		if (mmc_card_removed(card))
 			req->cmd_flags |= REQ_QUIET;
 		while (ret)
-			ret = blk_end_request(req, -EIO,
+			ret = mmc_blk_end_request(req, -EIO,
 					blk_rq_cur_bytes(req));
 	}
 
@@ -2000,7 +2026,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	if (rqc) {
 		if (mmc_card_removed(card)) {
 			rqc->cmd_flags |= REQ_QUIET;
-			blk_end_request_all(rqc, -EIO);
+			mmc_blk_end_request_all(rqc, -EIO);
 		} else {
 			/*
 			 * If current request is packed, it needs to put back.
@@ -2033,7 +2059,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	ret = mmc_blk_part_switch(card, md);
 	if (ret) {
 		if (req) {
-			blk_end_request_all(req, -EIO);
+			mmc_blk_end_request_all(req, -EIO);
 		}
 		ret = 0;
 		goto out;
@@ -2188,10 +2214,12 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 		blk_queue_flush(md->queue.queue, REQ_FLUSH | REQ_FUA);
 	}
 
+	/* Packing pulls requests off the legacy queue by itself */
 	if (mmc_card_mmc(card) &&
 	    (area_type == MMC_BLK_DATA_AREA_MAIN) &&
 	    (md->flags & MMC_BLK_CMD23) &&
-	    card->ext_csd.packed_event_en) {
+	    card->ext_csd.packed_event_en &&
+	    !md->queue.queue->mq_ops) {
 		if (!mmc_packed_init(&md->queue, card))
 			md->flags |= MMC_BLK_PACKED_CMD;
 	}
@@ -12,6 +12,8 @@
 #include <linux/slab.h>
 #include <linux/module.h>
 #include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/pm_runtime.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
 #include <linux/scatterlist.h>
@@ -22,6 +24,17 @@
 #include "queue.h"
 
 #define MMC_QUEUE_BOUNCESZ	65536
+#define MMC_QUEUE_DEPTH		64
+
+static bool mmc_use_blk_mq = IS_ENABLED(CONFIG_MMC_BLOCK_MQ_DEFAULT);
+module_param_named(use_blk_mq, mmc_use_blk_mq, bool, S_IRUGO);
+MODULE_PARM_DESC(use_blk_mq, "Queue MMC block requests through blk-mq");
+
+static bool mmc_erase_aligned_wb;
+module_param_named(erase_aligned_writeback, mmc_erase_aligned_wb, bool,
+		   S_IRUGO);
+MODULE_PARM_DESC(erase_aligned_writeback,
+		 "Write back in preferred erase size chunks");
 
 /*
  * Prepare a MMC request. This just filters out odd stuff.
@@ -46,6 +59,41 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 	return BLKPREP_OK;
 }
 
+/*
+ * Issue @req through issue_fn, or complete the request in flight when @req
+ * is NULL.  Returns false if that completion was interrupted by a new
+ * request, which then has to be issued before the previous one completes.
+ */
+static bool mmc_queue_issue(struct mmc_queue *mq, struct request *req)
+{
+	unsigned int cmd_flags = req ? req->cmd_flags : 0;
+	struct mmc_queue_req *tmp;
+
+	mq->issue_fn(mq, req);
+	if (mq->flags & MMC_QUEUE_NEW_REQUEST) {
+		mq->flags &= ~MMC_QUEUE_NEW_REQUEST;
+		return false;
+	}
+
+	/*
+	 * Current request becomes previous request
+	 * and vice versa.
+	 * In case of special requests, current request
+	 * has been finished. Do not assign it to previous
+	 * request.
+	 */
+	if (cmd_flags & MMC_REQ_SPECIAL_MASK)
+		mq->mqrq_cur->req = NULL;
+
+	mq->mqrq_prev->brq.mrq.data = NULL;
+	mq->mqrq_prev->req = NULL;
+	tmp = mq->mqrq_prev;
+	mq->mqrq_prev = mq->mqrq_cur;
+	mq->mqrq_cur = tmp;
+
+	return true;
+}
+
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
@@ -56,8 +104,6 @@ static int mmc_queue_thread(void *d)
 	down(&mq->thread_sem);
 	do {
 		struct request *req = NULL;
-		struct mmc_queue_req *tmp;
-		unsigned int cmd_flags = 0;
 
 		spin_lock_irq(q->queue_lock);
 		set_current_state(TASK_INTERRUPTIBLE);
@@ -67,28 +113,8 @@ static int mmc_queue_thread(void *d)
 
 		if (req || mq->mqrq_prev->req) {
 			set_current_state(TASK_RUNNING);
-			cmd_flags = req ? req->cmd_flags : 0;
-			mq->issue_fn(mq, req);
-			if (mq->flags & MMC_QUEUE_NEW_REQUEST) {
-				mq->flags &= ~MMC_QUEUE_NEW_REQUEST;
+			if (!mmc_queue_issue(mq, req))
 				continue; /* fetch again */
-			}
-
-			/*
-			 * Current request becomes previous request
-			 * and vice versa.
-			 * In case of special requests, current request
-			 * has been finished. Do not assign it to previous
-			 * request.
-			 */
-			if (cmd_flags & MMC_REQ_SPECIAL_MASK)
-				mq->mqrq_cur->req = NULL;
-
-			mq->mqrq_prev->brq.mrq.data = NULL;
-			mq->mqrq_prev->req = NULL;
-			tmp = mq->mqrq_prev;
-			mq->mqrq_prev = mq->mqrq_cur;
-			mq->mqrq_cur = tmp;
 		} else {
 			if (kthread_should_stop()) {
 				set_current_state(TASK_RUNNING);
@@ -142,6 +168,146 @@ static void mmc_request_fn(struct request_queue *q)
 		wake_up_process(mq->thread);
 }
 
+/*
+ * blk-mq path.  ->queue_rq() issues into the host directly, from the
+ * submitting task for sync requests and from kblockd otherwise, and keeps
+ * the two request pipelining of the thread: each call prepares its request
+ * while the previous one is still on the bus.  The request left in flight
+ * when the queue runs dry is completed from complete_work, which gives way
+ * as soon as a new request arrives.
+ *
+ * issue_mutex stands in for the single thread.  Since subsequent requests
+ * are issued from different tasks, the host is claimed through mq->ctx.
+ */
+static bool mmc_mq_issue(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_card *card = mq->card;
+	bool done;
+
+	pm_runtime_get_sync(&card->dev);
+	mmc_claim_host_ctx(card->host, &mq->ctx);
+	mq->mqrq_cur->req = req;
+	done = mmc_queue_issue(mq, req);
+	mmc_release_host(card->host);
+	pm_runtime_mark_last_busy(&card->dev);
+	pm_runtime_put_autosuspend(&card->dev);
+
+	return done;
+}
+
+/* Interrupt a wait for the last request, the new one is pipelined */
+static void mmc_mq_new_request(struct mmc_queue *mq)
+{
+	struct mmc_context_info *cntx = &mq->card->host->context_info;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cntx->lock, flags);
+	if (cntx->is_waiting_last_req) {
+		cntx->is_new_req = true;
+		wake_up_interruptible(&cntx->wait);
+	}
+	spin_unlock_irqrestore(&cntx->lock, flags);
+}
+
+static int mmc_mq_queue_rq(struct blk_mq_hw_ctx *hctx,
+			   const struct blk_mq_queue_data *bd)
+{
+	struct request *req = bd->rq;
+	struct request_queue *q = req->q;
+	struct mmc_queue *mq = q->tag_set->driver_data;
+
+	if (!q->queuedata || mmc_prep_request(q, req) != BLKPREP_OK) {
+		req->cmd_flags |= REQ_QUIET;
+		return BLK_MQ_RQ_QUEUE_ERROR;
+	}
+
+	blk_mq_start_request(req);
+	mmc_mq_new_request(mq);
+
+	mutex_lock(&mq->issue_mutex);
+	if (!q->queuedata) {
+		mutex_unlock(&mq->issue_mutex);
+		blk_mq_end_request(req, -EIO);
+		return BLK_MQ_RQ_QUEUE_OK;
+	}
+	mmc_mq_issue(mq, req);
+	mutex_unlock(&mq->issue_mutex);
+
+	if (bd->last)
+		kblockd_schedule_work(&mq->complete_work);
+
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+/* Called with issue_mutex held */
+static void mmc_mq_complete_prev(struct mmc_queue *mq)
+{
+	if (mq->mqrq_prev->req)
+		mmc_mq_issue(mq, NULL);
+}
+
+static void mmc_mq_complete_work(struct work_struct *work)
+{
+	struct mmc_queue *mq = container_of(work, struct mmc_queue,
+					    complete_work);
+
+	mutex_lock(&mq->issue_mutex);
+	mmc_mq_complete_prev(mq);
+	mutex_unlock(&mq->issue_mutex);
+}
+
+/*
+ * The core has its own command and data timeouts and recovers from them,
+ * a block layer timeout only means the card is slow, e.g. erasing.
+ */
+static enum blk_eh_timer_return mmc_mq_timeout(struct request *req,
+					       bool reserved)
+{
+	struct mmc_queue *mq = req->q->tag_set->driver_data;
+
+	pr_warn_ratelimited("%s: request at sector %llu still pending\n",
+			    mmc_card_name(mq->card),
+			    (unsigned long long)blk_rq_pos(req));
+	return BLK_EH_RESET_TIMER;
+}
+
+static struct blk_mq_ops mmc_mq_ops = {
+	.queue_rq	= mmc_mq_queue_rq,
+	.map_queue	= blk_mq_map_queue,
+	.timeout	= mmc_mq_timeout,
+};
+
+static int mmc_mq_init_queue(struct mmc_queue *mq)
+{
+	struct request_queue *q;
+	int ret;
+
+	memset(&mq->tag_set, 0, sizeof(mq->tag_set));
+	mq->tag_set.ops = &mmc_mq_ops;
+	mq->tag_set.nr_hw_queues = 1;
+	mq->tag_set.queue_depth = MMC_QUEUE_DEPTH;
+	mq->tag_set.numa_node = NUMA_NO_NODE;
+	mq->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_SG_MERGE |
+			    BLK_MQ_F_BLOCKING;
+	mq->tag_set.driver_data = mq;
+
+	ret = blk_mq_alloc_tag_set(&mq->tag_set);
+	if (ret)
+		return ret;
+
+	q = blk_mq_init_queue(&mq->tag_set);
+	if (IS_ERR(q)) {
+		blk_mq_free_tag_set(&mq->tag_set);
+		return PTR_ERR(q);
+	}
+
+	mutex_init(&mq->issue_mutex);
+	INIT_WORK(&mq->complete_work, mmc_mq_complete_work);
+	mq->queue = q;
+
+	return 0;
+}
+
 static struct scatterlist *mmc_alloc_sg(int sg_len, int *err)
 {
 	struct scatterlist *sg;
@@ -200,9 +366,15 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 		limit = (u64)dma_max_pfn(mmc_dev(host)) << PAGE_SHIFT;
 
 	mq->card = card;
-	mq->queue = blk_init_queue(mmc_request_fn, lock);
-	if (!mq->queue)
-		return -ENOMEM;
+	if (mmc_use_blk_mq) {
+		ret = mmc_mq_init_queue(mq);
+		if (ret)
+			return ret;
+	} else {
+		mq->queue = blk_init_queue(mmc_request_fn, lock);
+		if (!mq->queue)
+			return -ENOMEM;
+	}
 
 	mq->mqrq_cur = mqrq_cur;
 	mq->mqrq_prev = mqrq_prev;
@@ -213,6 +385,10 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	queue_flag_clear_unlocked(QUEUE_FLAG_ADD_RANDOM, mq->queue);
 	if (mmc_can_erase(card))
 		mmc_queue_setup_discard(mq->queue, card);
+	/* the bdi erase_block_kb attribute can change it per card later */
+	if (mmc_erase_aligned_wb)
+		mq->queue->backing_dev_info.erase_pages =
+			((unsigned long)card->pref_erase << 9) >> PAGE_SHIFT;
 
 #ifdef CONFIG_MMC_BLOCK_BOUNCE
 	if (host->max_segs == 1) {
@@ -288,6 +464,9 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 			goto cleanup_queue;
 	}
 
+	if (mq->queue->mq_ops)
+		return 0;
+
 	sema_init(&mq->thread_sem, 1);
 
 	mq->thread = kthread_run(mmc_queue_thread, mq, "mmcqd/%d%s",
@@ -316,7 +495,7 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	kfree(mqrq_prev->bounce_buf);
 	mqrq_prev->bounce_buf = NULL;
 
-	blk_cleanup_queue(mq->queue);
+	mmc_free_queue(mq);
 	return ret;
 }
 
@@ -330,14 +509,23 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	/* Make sure the queue isn't suspended, as that will deadlock */
 	mmc_queue_resume(mq);
 
-	/* Then terminate our worker thread */
-	kthread_stop(mq->thread);
-
-	/* Empty the queue */
-	spin_lock_irqsave(q->queue_lock, flags);
-	q->queuedata = NULL;
-	blk_start_queue(q);
-	spin_unlock_irqrestore(q->queue_lock, flags);
+	if (q->mq_ops) {
+		/* Fail everything from now on, finish what's in flight */
+		mutex_lock(&mq->issue_mutex);
+		q->queuedata = NULL;
+		mmc_mq_complete_prev(mq);
+		mutex_unlock(&mq->issue_mutex);
+		cancel_work_sync(&mq->complete_work);
+	} else {
+		/* Then terminate our worker thread */
+		kthread_stop(mq->thread);
+
+		/* Empty the queue */
+		spin_lock_irqsave(q->queue_lock, flags);
+		q->queuedata = NULL;
+		blk_start_queue(q);
+		spin_unlock_irqrestore(q->queue_lock, flags);
+	}
 
 	kfree(mqrq_cur->bounce_sg);
 	mqrq_cur->bounce_sg = NULL;
@@ -361,6 +549,21 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 }
 EXPORT_SYMBOL(mmc_cleanup_queue);
 
+/**
+ * mmc_free_queue - release the request queue
+ * @mq: MMC queue
+ *
+ * Called once the last user of the block device is gone.
+ */
+void mmc_free_queue(struct mmc_queue *mq)
+{
+	bool use_mq = mq->queue->mq_ops != NULL;
+
+	blk_cleanup_queue(mq->queue);
+	if (use_mq)
+		blk_mq_free_tag_set(&mq->tag_set);
+}
+
 int mmc_packed_init(struct mmc_queue *mq, struct mmc_card *card)
 {
 	struct mmc_queue_req *mqrq_cur = &mq->mqrq[0];
@@ -420,6 +623,13 @@ void mmc_queue_suspend(struct mmc_queue *mq)
 	if (!(mq->flags & MMC_QUEUE_SUSPENDED)) {
 		mq->flags |= MMC_QUEUE_SUSPENDED;
 
+		if (q->mq_ops) {
+			blk_mq_stop_hw_queues(q);
+			mutex_lock(&mq->issue_mutex);
+			mmc_mq_complete_prev(mq);
+			return;
+		}
+
 		spin_lock_irqsave(q->queue_lock, flags);
 		blk_stop_queue(q);
 		spin_unlock_irqrestore(q->queue_lock, flags);
@@ -440,6 +650,12 @@ void mmc_queue_resume(struct mmc_queue *mq)
 	if (mq->flags & MMC_QUEUE_SUSPENDED) {
 		mq->flags &= ~MMC_QUEUE_SUSPENDED;
 
+		if (q->mq_ops) {
+			mutex_unlock(&mq->issue_mutex);
+			blk_mq_start_stopped_hw_queues(q, true);
+			return;
+		}
+
 		up(&mq->thread_sem);
 
 		spin_lock_irqsave(q->queue_lock, flags);
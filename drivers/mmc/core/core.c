@@ -884,17 +884,15 @@ unsigned int mmc_align_data_size(struct mmc_card *card, unsigned int sz)
 }
 EXPORT_SYMBOL(mmc_align_data_size);
 
-/**
- *	__mmc_claim_host - exclusively claim a host
- *	@host: mmc host to claim
- *	@abort: whether or not the operation should be aborted
- *
- *	Claim a host for a set of operations.  If @abort is non null and
- *	dereference a non-zero value then this will return prematurely with
- *	that non-zero value without acquiring the lock.  Returns zero
- *	with the lock held otherwise.
- */
-int __mmc_claim_host(struct mmc_host *host, atomic_t *abort)
+static inline bool mmc_ctx_matches(struct mmc_host *host, struct mmc_ctx *ctx)
+{
+	if (ctx)
+		return host->claimer == ctx;
+	return host->claimer->task == current;
+}
+
+static int __mmc_claim_host_ctx(struct mmc_host *host, struct mmc_ctx *ctx,
+				atomic_t *abort)
 {
 	DECLARE_WAITQUEUE(wait, current);
 	unsigned long flags;
@@ -908,7 +906,7 @@ int __mmc_claim_host(struct mmc_host *host, atomic_t *abort)
 	while (1) {
 		set_current_state(TASK_UNINTERRUPTIBLE);
 		stop = abort ? atomic_read(abort) : 0;
-		if (stop || !host->claimed || host->claimer == current)
+		if (stop || !host->claimed || mmc_ctx_matches(host, ctx))
 			break;
 		spin_unlock_irqrestore(&host->lock, flags);
 		schedule();
@@ -917,7 +915,9 @@ int __mmc_claim_host(struct mmc_host *host, atomic_t *abort)
 	set_current_state(TASK_RUNNING);
 	if (!stop) {
 		host->claimed = 1;
-		host->claimer = current;
+		if (!host->claimer)
+			host->claimer = ctx ? ctx : &host->default_ctx;
+		host->claimer->task = current;
 		host->claim_cnt += 1;
 		if (host->claim_cnt == 1)
 			pm = true;
@@ -931,8 +931,38 @@ int __mmc_claim_host(struct mmc_host *host, atomic_t *abort)
 
 	return stop;
 }
+
+/**
+ *	__mmc_claim_host - exclusively claim a host
+ *	@host: mmc host to claim
+ *	@abort: whether or not the operation should be aborted
+ *
+ *	Claim a host for a set of operations.  If @abort is non null and
+ *	dereference a non-zero value then this will return prematurely with
+ *	that non-zero value without acquiring the lock.  Returns zero
+ *	with the lock held otherwise.
+ */
+int __mmc_claim_host(struct mmc_host *host, atomic_t *abort)
+{
+	return __mmc_claim_host_ctx(host, NULL, abort);
+}
 EXPORT_SYMBOL(__mmc_claim_host);
 
+/**
+ *	mmc_claim_host_ctx - exclusively claim a host for a context
+ *	@host: mmc host to claim
+ *	@ctx: claiming context
+ *
+ *	Like mmc_claim_host(), but claims nest on @ctx instead of on the
+ *	calling task, so the claim may be taken, used and released by
+ *	different tasks.  The caller must serialize work done under @ctx.
+ */
+void mmc_claim_host_ctx(struct mmc_host *host, struct mmc_ctx *ctx)
+{
+	__mmc_claim_host_ctx(host, ctx, NULL);
+}
+EXPORT_SYMBOL(mmc_claim_host_ctx);
+
 /**
  *	mmc_release_host - release a host
  *	@host: mmc host to release
@@ -952,6 +982,7 @@ void mmc_release_host(struct mmc_host *host)
 		spin_unlock_irqrestore(&host->lock, flags);
 	} else {
 		host->claimed = 0;
+		host->claimer->task = NULL;
 		host->claimer = NULL;
 		spin_unlock_irqrestore(&host->lock, flags);
 		wake_up(&host->wq);
@@ -26,6 +26,7 @@
 #include <linux/interrupt.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
 #include <linux/platform_device.h>
 #include <linux/timer.h>
 #include <linux/clk.h>
@@ -46,6 +47,7 @@
 #include <linux/pm_runtime.h>
 #include <linux/pm_wakeirq.h>
 #include <linux/platform_data/hsmmc-omap.h>
+#include <asm/unaligned.h>
 
 /* OMAP HSMMC Host Controller Registers */
 #define OMAP_HSMMC_SYSSTATUS	0x0014
@@ -206,6 +208,23 @@ struct omap_hsmmc_next {
 	s32		cookie;
 };
 
+#define OMAP_HSMMC_LAT_BUCKETS	20	/* log2 of the latency in us */
+#define OMAP_HSMMC_BLK_BUCKETS	17	/* log2 of the block count */
+
+/* request statistics, protected by irq_lock */
+struct omap_hsmmc_stats {
+	ktime_t		start;
+	unsigned int	requests;
+	unsigned int	latency[OMAP_HSMMC_LAT_BUCKETS];
+	unsigned int	opcode[64];
+	unsigned int	blocks[OMAP_HSMMC_BLK_BUCKETS];
+	u64		data_bytes;
+	u64		data_us;
+	unsigned int	dma_prep;
+	u64		dma_prep_ns;
+	u64		dma_prep_max_ns;
+};
+
 struct omap_hsmmc_host {
 	struct	device		*dev;
 	struct	mmc_host	*mmc;
@@ -232,6 +251,8 @@ struct omap_hsmmc_host {
 	int			irq;
 	int			wake_irq;
 	int			use_dma, dma_ch;
+	int			data_pio;	/* current data goes by PIO */
+	struct sg_mapping_iter	sg_miter;	/* PIO position in data->sg */
 	struct dma_chan		*tx_chan;
 	struct dma_chan		*rx_chan;
 	int			response_busy;
@@ -269,6 +290,10 @@ struct omap_hsmmc_host {
 	struct pinctrl_state	*hs_pinctrl_state;
 	struct pinctrl_state	*ddr_1_8v_pinctrl_state;
 
+#ifdef CONFIG_DEBUG_FS
+	struct omap_hsmmc_stats	stats;
+#endif
+
 	/* return MMC cover switch state, can be NULL if not supported.
 	 *
 	 * possible return values:
@@ -657,7 +682,7 @@ static void omap_hsmmc_enable_irq(struct omap_hsmmc_host *host,
 		 */
 		irq_mask &= ~DCRC_EN;
 
-	if (host->use_dma)
+	if (host->use_dma && !host->data_pio)
 		irq_mask &= ~(BRR_EN | BWR_EN);
 
 	/* Disable timeout for erases or when using software timeout */
@@ -1027,7 +1052,7 @@ omap_hsmmc_start_command(struct omap_hsmmc_host *host, struct mmc_command *cmd,
 	    (cmd->opcode == MMC_SEND_TUNING_BLOCK_HS200))
 		cmdreg |= DP_SELECT | DDIR;
 
-	if (host->use_dma)
+	if (host->use_dma && !host->data_pio)
 		cmdreg |= DMAE;
 
 	host->req_in_progress = 1;
@@ -1051,6 +1076,63 @@ static struct dma_chan *omap_hsmmc_get_dma_chan(struct omap_hsmmc_host *host,
 	return data->flags & MMC_DATA_WRITE ? host->tx_chan : host->rx_chan;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static void omap_hsmmc_stats_start(struct omap_hsmmc_host *host)
+{
+	host->stats.start = ktime_get();
+}
+
+static void omap_hsmmc_stats_done(struct omap_hsmmc_host *host,
+				  struct mmc_request *mrq)
+{
+	struct omap_hsmmc_stats *st = &host->stats;
+	s64 us = ktime_us_delta(ktime_get(), st->start);
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->irq_lock, flags);
+	st->requests++;
+	st->latency[min_t(unsigned int, fls64(us),
+			  OMAP_HSMMC_LAT_BUCKETS - 1)]++;
+	st->opcode[mrq->cmd->opcode & 63]++;
+	if (mrq->data) {
+		st->blocks[min_t(unsigned int, fls(mrq->data->blocks),
+				 OMAP_HSMMC_BLK_BUCKETS - 1)]++;
+		st->data_bytes += mrq->data->bytes_xfered;
+		st->data_us += us;
+	}
+	spin_unlock_irqrestore(&host->irq_lock, flags);
+}
+
+static void omap_hsmmc_stats_dma_prep(struct omap_hsmmc_host *host,
+				      ktime_t start)
+{
+	struct omap_hsmmc_stats *st = &host->stats;
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->irq_lock, flags);
+	st->dma_prep++;
+	st->dma_prep_ns += ns;
+	if (ns > st->dma_prep_max_ns)
+		st->dma_prep_max_ns = ns;
+	spin_unlock_irqrestore(&host->irq_lock, flags);
+}
+#else
+static inline void omap_hsmmc_stats_start(struct omap_hsmmc_host *host)
+{
+}
+
+static inline void omap_hsmmc_stats_done(struct omap_hsmmc_host *host,
+					 struct mmc_request *mrq)
+{
+}
+
+static inline void omap_hsmmc_stats_dma_prep(struct omap_hsmmc_host *host,
+					     ktime_t start)
+{
+}
+#endif
+
 static void omap_hsmmc_request_done(struct omap_hsmmc_host *host, struct mmc_request *mrq)
 {
 	int dma_ch;
@@ -1065,6 +1147,7 @@ static void omap_hsmmc_request_done(struct omap_hsmmc_host *host, struct mmc_req
 	/* Do not complete the request if DMA is still in progress */
 	if (mrq->data && host->use_dma && dma_ch != -1)
 		return;
+	omap_hsmmc_stats_done(host, mrq);
 	host->mrq = NULL;
 	mmc_request_done(host->mmc, mrq);
 	pm_runtime_mark_last_busy(host->dev);
@@ -1273,6 +1356,36 @@ static void hsmmc_command_incomplete(struct omap_hsmmc_host *host,
 		host->mrq->cmd->error = err;
 }
 
+/*
+ * Move one block between the data buffer and the DATA register. The
+ * controller raises BRR/BWR once per block, so this runs from the irq.
+ */
+static void omap_hsmmc_pio_block(struct omap_hsmmc_host *host,
+				 struct mmc_data *data)
+{
+	struct sg_mapping_iter *sgm = &host->sg_miter;
+	bool read = data->flags & MMC_DATA_READ;
+	unsigned int left = data->blksz;
+	unsigned int len;
+	u8 *buf;
+
+	while (left && sg_miter_next(sgm)) {
+		len = min_t(unsigned int, sgm->length, left);
+		left -= len;
+		sgm->consumed = len;
+
+		for (buf = sgm->addr; len; len -= 4, buf += 4) {
+			if (read)
+				put_unaligned(OMAP_HSMMC_READ(host->base, DATA),
+					      (u32 *)buf);
+			else
+				OMAP_HSMMC_WRITE(host->base, DATA,
+						 get_unaligned((u32 *)buf));
+		}
+	}
+	sg_miter_stop(sgm);
+}
+
 static void omap_hsmmc_do_irq(struct omap_hsmmc_host *host, int status)
 {
 	struct mmc_data *data;
@@ -1314,6 +1427,8 @@ static void omap_hsmmc_do_irq(struct omap_hsmmc_host *host, int status)
 	}
 
 	OMAP_HSMMC_WRITE(host->base, STAT, status);
+	if ((status & (BRR_EN | BWR_EN)) && host->data && host->data_pio)
+		omap_hsmmc_pio_block(host, host->data);
 	if (end_cmd || ((status & CC_EN) && host->cmd))
 		omap_hsmmc_cmd_done(host, host->cmd);
 	if ((end_trans || (status & TC_EN)) && host->mrq)
@@ -1504,9 +1619,11 @@ static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
 
 	/* Check if next job is already prepared */
 	if (next || data->host_cookie != host->next_data.cookie) {
+		ktime_t start = ktime_get();
+
 		dma_len = dma_map_sg(chan->device->dev, data->sg, data->sg_len,
 				     omap_hsmmc_get_dma_dir(host, data));
-
+		omap_hsmmc_stats_dma_prep(host, start);
 	} else {
 		dma_len = host->next_data.dma_len;
 		host->next_data.dma_len = 0;
@@ -1654,8 +1771,10 @@ static void omap_hsmmc_start_dma_transfer(struct omap_hsmmc_host *host)
 				| (req->data->blocks << 16));
 	set_data_timeout(host, req->data->timeout_ns,
 				req->data->timeout_clks);
-	chan = omap_hsmmc_get_dma_chan(host, req->data);
-	dma_async_issue_pending(chan);
+	if (!host->data_pio) {
+		chan = omap_hsmmc_get_dma_chan(host, req->data);
+		dma_async_issue_pending(chan);
+	}
 
 	if (host->need_i834_errata) {
 		unsigned long timeout;
@@ -1665,6 +1784,30 @@ static void omap_hsmmc_start_dma_transfer(struct omap_hsmmc_host *host)
 	}
 }
 
+/*
+ * Short transfers, typically the small CMD53s of SDIO WLAN traffic, cost
+ * more in DMA mapping and descriptor setup than they take on the bus, so
+ * move them by PIO. The layout rules match the DMA path.
+ */
+static bool omap_hsmmc_use_pio(struct omap_hsmmc_host *host,
+			       struct mmc_data *data)
+{
+	struct scatterlist *sg;
+	int i;
+
+	if (data->blksz * data->blocks >= host->pdata->dma_threshold)
+		return false;
+
+	if (data->blksz % 4)
+		return false;
+
+	for_each_sg(data->sg, sg, data->sg_len, i)
+		if (sg->length % data->blksz)
+			return false;
+
+	return true;
+}
+
 /*
  * Configure block length for MMC/SD cards and initiate the transfer.
  */
@@ -1673,6 +1816,7 @@ omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 {
 	int ret;
 	host->data = req->data;
+	host->data_pio = 0;
 
 	if (req->data == NULL) {
 		OMAP_HSMMC_WRITE(host->base, BLK, 0);
@@ -1685,6 +1829,17 @@ omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 		return 0;
 	}
 
+	if (omap_hsmmc_use_pio(host, req->data)) {
+		unsigned int flags = SG_MITER_ATOMIC;
+
+		flags |= req->data->flags & MMC_DATA_READ ?
+			 SG_MITER_TO_SG : SG_MITER_FROM_SG;
+		sg_miter_start(&host->sg_miter, req->data->sg,
+			       req->data->sg_len, flags);
+		host->data_pio = 1;
+		return 0;
+	}
+
 	if (host->use_dma) {
 		ret = omap_hsmmc_setup_dma_transfer(host, req);
 		if (ret != 0) {
@@ -1720,7 +1875,7 @@ static void omap_hsmmc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
 		return ;
 	}
 
-	if (host->use_dma) {
+	if (host->use_dma && !omap_hsmmc_use_pio(host, mrq->data)) {
 		struct dma_chan *c = omap_hsmmc_get_dma_chan(host, mrq->data);
 
 		if (omap_hsmmc_pre_dma_transfer(host, mrq->data,
@@ -1762,6 +1917,7 @@ static void omap_hsmmc_request(struct mmc_host *mmc, struct mmc_request *req)
 	} else if (host->reqs_blocked)
 		host->reqs_blocked = 0;
 	WARN_ON(host->mrq != NULL);
+	omap_hsmmc_stats_start(host);
 	host->mrq = req;
 	host->clk_rate = clk_get_rate(host->fclk);
 	err = omap_hsmmc_prepare_data(host, req);
@@ -2071,6 +2227,16 @@ static int omap_hsmmc_start_signal_voltage_switch(struct mmc_host *mmc,
 		if (!(val & VS18))
 			return -EOPNOTSUPP;
 
+		/*
+		 * eMMC on a fixed 3.3V VccQ rail (e.g. AM335x boards) must
+		 * not be switched to 1.8V signalling, the core then falls
+		 * back to DDR52 at 3.3V.
+		 */
+		if (mmc->supply.vqmmc &&
+		    !regulator_is_supported_voltage(mmc->supply.vqmmc,
+						    VDD_1V8, VDD_1V8))
+			return -EOPNOTSUPP;
+
 		omap_hsmmc_conf_bus_power(host, ios->signal_voltage);
 
 		val = OMAP_HSMMC_READ(host->base, AC12);
@@ -2348,11 +2514,92 @@ static const struct file_operations mmc_regs_fops = {
 	.release        = single_release,
 };
 
+static int omap_hsmmc_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_host *mmc = s->private;
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	struct omap_hsmmc_stats st;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&host->irq_lock, flags);
+	st = host->stats;
+	spin_unlock_irqrestore(&host->irq_lock, flags);
+
+	seq_printf(s, "requests:\t%u\n", st.requests);
+
+	seq_puts(s, "\nlatency (us):\n");
+	for (i = 0; i < OMAP_HSMMC_LAT_BUCKETS; i++)
+		if (st.latency[i])
+			seq_printf(s, "<%lu\t\t%u\n", 1UL << i, st.latency[i]);
+
+	seq_puts(s, "\nopcodes:\n");
+	for (i = 0; i < ARRAY_SIZE(st.opcode); i++)
+		if (st.opcode[i])
+			seq_printf(s, "CMD%d\t\t%u\n", i, st.opcode[i]);
+
+	seq_puts(s, "\nblocks:\n");
+	for (i = 0; i < OMAP_HSMMC_BLK_BUCKETS; i++)
+		if (st.blocks[i])
+			seq_printf(s, "<%lu\t\t%u\n", 1UL << i, st.blocks[i]);
+
+	seq_printf(s, "\ndata:\t\t%llu bytes in %llu us",
+		   st.data_bytes, st.data_us);
+	if (st.data_us)
+		seq_printf(s, " (%llu KiB/s)",
+			   div64_u64(st.data_bytes * USEC_PER_SEC,
+				     st.data_us * SZ_1K));
+	seq_puts(s, "\n");
+
+	seq_printf(s, "dma prep:\t%u, avg %llu ns, max %llu ns\n",
+		   st.dma_prep,
+		   st.dma_prep ? div_u64(st.dma_prep_ns, st.dma_prep) : 0,
+		   st.dma_prep_max_ns);
+
+	return 0;
+}
+
+static int omap_hsmmc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_hsmmc_stats_show, inode->i_private);
+}
+
+/* any write clears the statistics */
+static ssize_t omap_hsmmc_stats_write(struct file *file,
+				      const char __user *buf, size_t count,
+				      loff_t *ppos)
+{
+	struct mmc_host *mmc = file_inode(file)->i_private;
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	unsigned long flags;
+	ktime_t start;
+
+	spin_lock_irqsave(&host->irq_lock, flags);
+	start = host->stats.start;
+	memset(&host->stats, 0, sizeof(host->stats));
+	host->stats.start = start;
+	spin_unlock_irqrestore(&host->irq_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations mmc_stats_fops = {
+	.open           = omap_hsmmc_stats_open,
+	.read           = seq_read,
+	.write          = omap_hsmmc_stats_write,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static void omap_hsmmc_debugfs(struct mmc_host *mmc)
 {
-	if (mmc->debugfs_root)
-		debugfs_create_file("regs", S_IRUSR, mmc->debugfs_root,
-			mmc, &mmc_regs_fops);
+	if (!mmc->debugfs_root)
+		return;
+
+	debugfs_create_file("regs", S_IRUSR, mmc->debugfs_root,
+		mmc, &mmc_regs_fops);
+	debugfs_create_file("stats", S_IRUSR | S_IWUSR, mmc->debugfs_root,
+		mmc, &mmc_stats_fops);
 }
 
 #else
@@ -2437,6 +2684,8 @@ static struct omap_hsmmc_platform_data *of_get_hsmmc_pdata(struct device *dev)
 	if (of_find_property(np, "ti,needs-special-hs-handling", NULL))
 		pdata->features |= HSMMC_HAS_HSPE_SUPPORT;
 
+	of_property_read_u32(np, "ti,dma-threshold", &pdata->dma_threshold);
+
 	return pdata;
 }
 #else
@@ -2465,7 +2714,7 @@ omap_hsmmc_pinctrl_lookup_state(struct omap_hsmmc_host *host, char *mode)
 			host->pinctrl##_pinctrl_state = 		\
 				omap_hsmmc_pinctrl_lookup_state(host, #pinctrl);\
 			if (IS_ERR(host->pinctrl##_pinctrl_state))	\
-				mmc->caps &= ~(capmask);		\
+				mmc->capvar &= ~(capmask);		\
 		}							\
 	} while (0)
 
@@ -2943,6 +3192,7 @@ static struct platform_driver omap_hsmmc_driver = {
 	.remove		= omap_hsmmc_remove,
 	.driver		= {
 		.name = DRIVER_NAME,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.pm = &omap_hsmmc_dev_pm_ops,
 		.of_match_table = of_match_ptr(omap_mmc_of_match),
 	},
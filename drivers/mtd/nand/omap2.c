@@ -148,6 +148,15 @@ static u_char bch8_vector[] = {0xf3, 0xdb, 0x14, 0x16, 0x8b, 0xd2, 0xbe, 0xcc,
 static u_char bch4_vector[] = {0x00, 0x6b, 0x31, 0xdd, 0x41, 0xbc, 0x10};
 
 /* Shared among all NAND instances to synchronize access to the ECC Engine */
+/* transfer lengths at which the prefetch-auto mode switches engines */
+static unsigned int dma_min_len = 512;
+module_param(dma_min_len, uint, 0644);
+MODULE_PARM_DESC(dma_min_len, "prefetch-auto: min bytes to use DMA");
+
+static unsigned int irq_min_len = 128;
+module_param(irq_min_len, uint, 0644);
+MODULE_PARM_DESC(irq_min_len, "prefetch-auto: min bytes to use the IRQ");
+
 static struct nand_hw_control omap_gpmc_controller = {
 	.lock = __SPIN_LOCK_UNLOCKED(omap_gpmc_controller.lock),
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(omap_gpmc_controller.wq),
@@ -187,6 +196,12 @@ struct omap_nand_info {
 	struct device_node		*of_node;
 	/* NAND ready gpio */
 	struct gpio_desc		*ready_gpiod;
+	/* page read ahead while the ELM corrects the current one */
+	void (*cmdfunc)(struct mtd_info *mtd, unsigned command,
+			int column, int page_addr);
+	void (*select_chip)(struct mtd_info *mtd, int chip);
+	int				readahead_next;
+	int				readahead_page;
 };
 
 /**
@@ -631,22 +646,18 @@ done:
 }
 
 /*
- * omap_read_buf_irq_pref - read data from NAND controller into buffer
+ * omap_nand_irq_transfer_read - read through the prefetch engine FIFO irq
  * @mtd: MTD device structure
  * @buf: buffer to store date
- * @len: number of bytes to read
+ * @len: number of bytes to read, multiple of 4
  */
-static void omap_read_buf_irq_pref(struct mtd_info *mtd, u_char *buf, int len)
+static void omap_nand_irq_transfer_read(struct mtd_info *mtd, u_char *buf,
+					int len)
 {
 	struct omap_nand_info *info = container_of(mtd,
 						struct omap_nand_info, mtd);
 	int ret = 0;
 
-	if (len <= mtd->oobsize) {
-		omap_read_buf_pref(mtd, buf, len);
-		return;
-	}
-
 	info->iomode = OMAP_NAND_IO_READ;
 	info->buf = buf;
 	init_completion(&info->comp);
@@ -679,13 +690,27 @@ out_copy:
 }
 
 /*
- * omap_write_buf_irq_pref - write buffer to NAND controller
+ * omap_read_buf_irq_pref - read data from NAND controller into buffer
+ * @mtd: MTD device structure
+ * @buf: buffer to store date
+ * @len: number of bytes to read
+ */
+static void omap_read_buf_irq_pref(struct mtd_info *mtd, u_char *buf, int len)
+{
+	if (len <= mtd->oobsize)
+		omap_read_buf_pref(mtd, buf, len);
+	else
+		omap_nand_irq_transfer_read(mtd, buf, len);
+}
+
+/*
+ * omap_nand_irq_transfer_write - write through the prefetch engine FIFO irq
  * @mtd: MTD device structure
  * @buf: data buffer
- * @len: number of bytes to write
+ * @len: number of bytes to write, multiple of 4
  */
-static void omap_write_buf_irq_pref(struct mtd_info *mtd,
-					const u_char *buf, int len)
+static void omap_nand_irq_transfer_write(struct mtd_info *mtd,
+					 const u_char *buf, int len)
 {
 	struct omap_nand_info *info = container_of(mtd,
 						struct omap_nand_info, mtd);
@@ -693,11 +718,6 @@ static void omap_write_buf_irq_pref(struct mtd_info *mtd,
 	unsigned long tim, limit;
 	u32 val;
 
-	if (len <= mtd->oobsize) {
-		omap_write_buf_pref(mtd, buf, len);
-		return;
-	}
-
 	info->iomode = OMAP_NAND_IO_WRITE;
 	info->buf = (u_char *) buf;
 	init_completion(&info->comp);
@@ -738,6 +758,95 @@ out_copy:
 		omap_write_buf8(mtd, buf, len);
 }
 
+/*
+ * omap_write_buf_irq_pref - write buffer to NAND controller
+ * @mtd: MTD device structure
+ * @buf: data buffer
+ * @len: number of bytes to write
+ */
+static void omap_write_buf_irq_pref(struct mtd_info *mtd,
+					const u_char *buf, int len)
+{
+	if (len <= mtd->oobsize)
+		omap_write_buf_pref(mtd, buf, len);
+	else
+		omap_nand_irq_transfer_write(mtd, buf, len);
+}
+
+/*
+ * omap_nand_xfer_engine - pick the engine for a prefetch-auto transfer
+ * @info: NAND device structure
+ * @buf: buffer to be transferred
+ * @len: number of bytes
+ *
+ * Either engine needs whole 32 bit words, DMA additionally a lowmem buffer
+ * that doesn't share cache lines with anything else.
+ */
+static enum nand_io omap_nand_xfer_engine(struct omap_nand_info *info,
+					  const u_char *buf, int len)
+{
+	if (len % 4)
+		return NAND_OMAP_PREFETCH_POLLED;
+
+	if (info->dma && len >= dma_min_len && virt_addr_valid(buf) &&
+	    IS_ALIGNED((unsigned long)buf | len, dma_get_cache_alignment()))
+		return NAND_OMAP_PREFETCH_DMA;
+
+	if (info->gpmc_irq > 0 && len >= irq_min_len)
+		return NAND_OMAP_PREFETCH_IRQ;
+
+	return NAND_OMAP_PREFETCH_POLLED;
+}
+
+/**
+ * omap_read_buf_auto - read data from NAND controller into buffer
+ * @mtd: MTD device structure
+ * @buf: buffer to store date
+ * @len: number of bytes to read
+ */
+static void omap_read_buf_auto(struct mtd_info *mtd, u_char *buf, int len)
+{
+	struct omap_nand_info *info = container_of(mtd,
+						struct omap_nand_info, mtd);
+
+	switch (omap_nand_xfer_engine(info, buf, len)) {
+	case NAND_OMAP_PREFETCH_DMA:
+		omap_nand_dma_transfer(mtd, buf, len, 0x0);
+		break;
+	case NAND_OMAP_PREFETCH_IRQ:
+		omap_nand_irq_transfer_read(mtd, buf, len);
+		break;
+	default:
+		omap_read_buf_pref(mtd, buf, len);
+		break;
+	}
+}
+
+/**
+ * omap_write_buf_auto - write buffer to NAND controller
+ * @mtd: MTD device structure
+ * @buf: data buffer
+ * @len: number of bytes to write
+ */
+static void omap_write_buf_auto(struct mtd_info *mtd, const u_char *buf,
+				int len)
+{
+	struct omap_nand_info *info = container_of(mtd,
+						struct omap_nand_info, mtd);
+
+	switch (omap_nand_xfer_engine(info, buf, len)) {
+	case NAND_OMAP_PREFETCH_DMA:
+		omap_nand_dma_transfer(mtd, (u_char *)buf, len, 0x1);
+		break;
+	case NAND_OMAP_PREFETCH_IRQ:
+		omap_nand_irq_transfer_write(mtd, buf, len);
+		break;
+	default:
+		omap_write_buf_pref(mtd, buf, len);
+		break;
+	}
+}
+
 /**
  * gen_true_ecc - This function will generate true ECC value
  * @ecc_buf: buffer to store ecc code
@@ -1055,6 +1164,90 @@ static int omap_dev_ready(struct mtd_info *mtd)
 	return gpiod_get_value(info->ready_gpiod);
 }
 
+/**
+ * omap_nand_read_ahead - start the array read of a page
+ * @mtd: MTD device structure
+ * @page: page to be latched into the data register of the chip
+ *
+ * Issues READ0/READSTART like nand_command_lp() but returns without
+ * waiting for tR, so the chip fetches the page in the background.
+ */
+static void omap_nand_read_ahead(struct mtd_info *mtd, int page)
+{
+	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
+							mtd);
+	struct nand_chip *chip = &info->nand;
+	int ctrl = NAND_NCE | NAND_ALE;
+
+	chip->cmd_ctrl(mtd, NAND_CMD_READ0,
+		       NAND_NCE | NAND_CLE | NAND_CTRL_CHANGE);
+	chip->cmd_ctrl(mtd, 0x00, ctrl | NAND_CTRL_CHANGE);
+	chip->cmd_ctrl(mtd, 0x00, ctrl);
+	chip->cmd_ctrl(mtd, page, ctrl);
+	chip->cmd_ctrl(mtd, page >> 8, ctrl);
+	if (chip->chipsize > (128 << 20))
+		chip->cmd_ctrl(mtd, page >> 16, ctrl);
+	chip->cmd_ctrl(mtd, NAND_CMD_NONE, NAND_NCE | NAND_CTRL_CHANGE);
+	chip->cmd_ctrl(mtd, NAND_CMD_READSTART,
+		       NAND_NCE | NAND_CLE | NAND_CTRL_CHANGE);
+	chip->cmd_ctrl(mtd, NAND_CMD_NONE, NAND_NCE | NAND_CTRL_CHANGE);
+
+	/* tWB, before RDY/BSY is valid */
+	ndelay(100);
+	info->readahead_page = page;
+}
+
+/**
+ * omap_nand_read_ahead_wait - wait for a pending read ahead
+ * @mtd: MTD device structure
+ *
+ * Returns the page the chip holds, or -1 if no read ahead was pending.
+ */
+static int omap_nand_read_ahead_wait(struct mtd_info *mtd)
+{
+	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
+							mtd);
+	int page = info->readahead_page;
+
+	if (page >= 0) {
+		info->readahead_page = -1;
+		nand_wait_ready(mtd);
+	}
+
+	return page;
+}
+
+/*
+ * Wrap the command function so a READ0 of the page already fetched by
+ * omap_nand_read_ahead() isn't issued a second time, any other command
+ * waits for the chip and discards the read ahead.
+ */
+static void omap_nand_command(struct mtd_info *mtd, unsigned int command,
+			      int column, int page_addr)
+{
+	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
+							mtd);
+	int page = omap_nand_read_ahead_wait(mtd);
+
+	if (page >= 0 && page == page_addr &&
+	    command == NAND_CMD_READ0 && column == 0)
+		return;
+
+	info->cmdfunc(mtd, command, column, page_addr);
+}
+
+static void omap_nand_select_chip(struct mtd_info *mtd, int chip)
+{
+	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
+							mtd);
+
+	/* don't leave the chip busy behind the back of the next user */
+	if (chip == -1)
+		omap_nand_read_ahead_wait(mtd);
+
+	info->select_chip(mtd, chip);
+}
+
 /**
  * omap_enable_hwecc_bch - Program GPMC to perform BCH ECC calculation
  * @mtd: MTD device structure
@@ -1444,7 +1637,13 @@ static int omap_elm_correct_data(struct mtd_info *mtd, u_char *data,
 		return stat;
 
 	/* Decode BCH error using ELM module */
-	elm_decode_bch_error_page(info->elm_dev, ecc_vec, err_vec);
+	elm_decode_bch_error_page_start(info->elm_dev, ecc_vec, err_vec);
+
+	/* Let the chip fetch the next page while the ELM is busy */
+	if (info->readahead_next >= 0)
+		omap_nand_read_ahead(mtd, info->readahead_next);
+
+	elm_decode_bch_error_page_finish(info->elm_dev, err_vec);
 
 	err = 0;
 	for (i = 0; i < eccsteps; i++) {
@@ -1562,6 +1761,9 @@ static int omap_read_page_bch(struct mtd_info *mtd, struct nand_chip *chip,
 	uint32_t *eccpos = chip->ecc.layout->eccpos;
 	uint8_t *oob = &chip->oob_poi[eccpos[0]];
 	uint32_t oob_pos = mtd->writesize + chip->ecc.layout->eccpos[0];
+	struct omap_nand_info *info = container_of(mtd, struct omap_nand_info,
+							mtd);
+	int ppb = 1 << (chip->phys_erase_shift - chip->page_shift);
 	int stat;
 	unsigned int max_bitflips = 0;
 
@@ -1580,7 +1782,15 @@ static int omap_read_page_bch(struct mtd_info *mtd, struct nand_chip *chip,
 
 	memcpy(ecc_code, &chip->oob_poi[eccpos[0]], chip->ecc.total);
 
+	/*
+	 * Sequential reads continue with the next page of the same block,
+	 * which the chip can fetch while errors are located.
+	 */
+	if (info->cmdfunc && (page + 1) % ppb)
+		info->readahead_next = page + 1;
+
 	stat = chip->ecc.correct(mtd, buf, ecc_code, ecc_calc);
+	info->readahead_next = -1;
 
 	if (stat < 0) {
 		mtd->ecc_stats.failed++;
@@ -1666,6 +1876,7 @@ static const char * const nand_xfer_types[] = {
 	[NAND_OMAP_POLLED] = "polled",
 	[NAND_OMAP_PREFETCH_DMA] = "prefetch-dma",
 	[NAND_OMAP_PREFETCH_IRQ] = "prefetch-irq",
+	[NAND_OMAP_PREFETCH_AUTO] = "prefetch-auto",
 };
 
 static int omap_get_dt_info(struct device *dev, struct omap_nand_info *info)
@@ -1714,6 +1925,7 @@ static int omap_get_dt_info(struct device *dev, struct omap_nand_info *info)
 	}
 
 	/* select data transfer mode */
+	info->xfer_type = NAND_OMAP_PREFETCH_AUTO;
 	if (!of_property_read_string(child, "ti,nand-xfer-type", &s)) {
 		for (i = 0; i < ARRAY_SIZE(nand_xfer_types); i++) {
 			if (!strcasecmp(s, nand_xfer_types[i])) {
@@ -1735,6 +1947,62 @@ next:
 	return 0;
 }
 
+static int omap_nand_request_dma(struct omap_nand_info *info)
+{
+	struct platform_device *pdev = info->pdev;
+	struct dma_slave_config cfg;
+	dma_cap_mask_t mask;
+	unsigned sig;
+	int err;
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_SLAVE, mask);
+	sig = OMAP24XX_DMA_GPMC;
+	info->dma = dma_request_slave_channel_compat(mask,
+		omap_dma_filter_fn, &sig, pdev->dev.parent, "rxtx");
+	if (!info->dma) {
+		dev_err(&pdev->dev, "DMA engine request failed\n");
+		return -ENXIO;
+	}
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.src_addr = info->phys_base;
+	cfg.dst_addr = info->phys_base;
+	cfg.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	cfg.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	cfg.src_maxburst = 16;
+	cfg.dst_maxburst = 16;
+	err = dmaengine_slave_config(info->dma, &cfg);
+	if (err) {
+		dev_err(&pdev->dev, "DMA engine slave config failed: %d\n",
+			err);
+		dma_release_channel(info->dma);
+		info->dma = NULL;
+	}
+
+	return err;
+}
+
+static int omap_nand_request_irq(struct omap_nand_info *info)
+{
+	struct platform_device *pdev = info->pdev;
+	int err;
+
+	info->gpmc_irq = platform_get_irq(pdev, 0);
+	if (info->gpmc_irq <= 0) {
+		dev_err(&pdev->dev, "error getting GPMC irq\n");
+		return -ENODEV;
+	}
+	err = devm_request_irq(&pdev->dev, info->gpmc_irq,
+			       omap_nand_irq, IRQF_SHARED,
+			       DRIVER_NAME, info);
+	if (err)
+		dev_err(&pdev->dev, "requesting irq(%d) error:%d",
+					info->gpmc_irq, err);
+
+	return err;
+}
+
 static int omap_nand_probe(struct platform_device *pdev)
 {
 	struct omap_nand_info		*info;
@@ -1744,8 +2012,6 @@ static int omap_nand_probe(struct platform_device *pdev)
 	struct nand_ecclayout		*ecclayout;
 	int				err;
 	int				i;
-	dma_cap_mask_t			mask;
-	unsigned			sig;
 	unsigned			oob_index;
 	struct resource			*res;
 	struct mtd_part_parser_data	ppdata = {};
@@ -1757,6 +2023,8 @@ static int omap_nand_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	info->pdev = pdev;
+	info->readahead_next = -1;
+	info->readahead_page = -1;
 
 	if (dev->of_node) {
 		if (omap_get_dt_info(dev, info))
@@ -1855,58 +2123,37 @@ static int omap_nand_probe(struct platform_device *pdev)
 		break;
 
 	case NAND_OMAP_PREFETCH_DMA:
-		dma_cap_zero(mask);
-		dma_cap_set(DMA_SLAVE, mask);
-		sig = OMAP24XX_DMA_GPMC;
-		info->dma = dma_request_slave_channel_compat(mask,
-			omap_dma_filter_fn, &sig, pdev->dev.parent, "rxtx");
-
-		if (!info->dma) {
-			dev_err(&pdev->dev, "DMA engine request failed\n");
-			err = -ENXIO;
+		err = omap_nand_request_dma(info);
+		if (err)
 			goto return_error;
-		} else {
-			struct dma_slave_config cfg;
-
-			memset(&cfg, 0, sizeof(cfg));
-			cfg.src_addr = info->phys_base;
-			cfg.dst_addr = info->phys_base;
-			cfg.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-			cfg.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
-			cfg.src_maxburst = 16;
-			cfg.dst_maxburst = 16;
-			err = dmaengine_slave_config(info->dma, &cfg);
-			if (err) {
-				dev_err(&pdev->dev, "DMA engine slave config failed: %d\n",
-					err);
-				goto return_error;
-			}
-			nand_chip->read_buf   = omap_read_buf_dma_pref;
-			nand_chip->write_buf  = omap_write_buf_dma_pref;
-		}
+
+		nand_chip->read_buf   = omap_read_buf_dma_pref;
+		nand_chip->write_buf  = omap_write_buf_dma_pref;
 		break;
 
 	case NAND_OMAP_PREFETCH_IRQ:
-		info->gpmc_irq = platform_get_irq(pdev, 0);
-		if (info->gpmc_irq <= 0) {
-			dev_err(&pdev->dev, "error getting GPMC irq\n");
-			err = -ENODEV;
+		err = omap_nand_request_irq(info);
+		if (err)
 			goto return_error;
-		}
-		err = devm_request_irq(&pdev->dev, info->gpmc_irq,
-				       omap_nand_irq, IRQF_SHARED,
-				       DRIVER_NAME, info);
-		if (err) {
-			dev_err(&pdev->dev, "requesting irq(%d) error:%d",
-						info->gpmc_irq, err);
-			goto return_error;
-		}
 
 		nand_chip->read_buf  = omap_read_buf_irq_pref;
 		nand_chip->write_buf = omap_write_buf_irq_pref;
 
 		break;
 
+	case NAND_OMAP_PREFETCH_AUTO:
+		/* each engine is optional, polling always works */
+		if (omap_nand_request_dma(info))
+			dev_info(&pdev->dev, "prefetch-auto without DMA\n");
+		if (omap_nand_request_irq(info)) {
+			dev_info(&pdev->dev, "prefetch-auto without IRQ\n");
+			info->gpmc_irq = 0;
+		}
+
+		nand_chip->read_buf  = omap_read_buf_auto;
+		nand_chip->write_buf = omap_write_buf_auto;
+		break;
+
 	default:
 		dev_err(&pdev->dev,
 			"xfer_type(%d) not supported!\n", info->xfer_type);
@@ -2129,6 +2376,18 @@ static int omap_nand_probe(struct platform_device *pdev)
 	}
 	nand_chip->ecc.layout = ecclayout;
 
+	/*
+	 * Read ahead needs the large page command set and the RDY/BSY line
+	 * to tell when the background fetch is done.
+	 */
+	if (nand_chip->ecc.read_page == omap_read_page_bch &&
+	    nand_chip->dev_ready && mtd->writesize > 512) {
+		info->cmdfunc = nand_chip->cmdfunc;
+		info->select_chip = nand_chip->select_chip;
+		nand_chip->cmdfunc = omap_nand_command;
+		nand_chip->select_chip = omap_nand_select_chip;
+	}
+
 scan_tail:
 	/* second phase scan */
 	if (nand_scan_tail(mtd)) {
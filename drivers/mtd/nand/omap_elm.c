@@ -335,15 +335,16 @@ static void elm_error_correction(struct elm_info *info,
 }
 
 /**
- * elm_decode_bch_error_page - Locate error position
+ * elm_decode_bch_error_page_start - Start locating error positions
  * @dev:	device pointer
  * @ecc_calc:	calculated ECC bytes from GPMC
  * @err_vec:	elm error vectors
  *
- * Called with one or more error reported vectors & vectors with
- * error reported is updated in err_vec[].error_reported
+ * Loads the syndromes of the error reported vectors and starts the ELM,
+ * elm_decode_bch_error_page_finish() must be called before the next
+ * decode.  The caller is free to do other work in between.
  */
-void elm_decode_bch_error_page(struct device *dev, u8 *ecc_calc,
+void elm_decode_bch_error_page_start(struct device *dev, u8 *ecc_calc,
 		struct elm_errorvec *err_vec)
 {
 	struct elm_info *info = dev_get_drvdata(dev);
@@ -359,6 +360,22 @@ void elm_decode_bch_error_page(struct device *dev, u8 *ecc_calc,
 
 	/* Enable syndrome processing for which syndrome fragment is updated */
 	elm_start_processing(info, err_vec);
+}
+EXPORT_SYMBOL(elm_decode_bch_error_page_start);
+
+/**
+ * elm_decode_bch_error_page_finish - Wait for the error positions
+ * @dev:	device pointer
+ * @err_vec:	elm error vectors
+ *
+ * Waits for the decode started by elm_decode_bch_error_page_start() and
+ * updates err_vec[] with the located errors.
+ */
+void elm_decode_bch_error_page_finish(struct device *dev,
+		struct elm_errorvec *err_vec)
+{
+	struct elm_info *info = dev_get_drvdata(dev);
+	u32 reg_val;
 
 	/* Wait for ELM module to finish locating error correction */
 	wait_for_completion(&info->elm_completion);
@@ -368,6 +385,23 @@ void elm_decode_bch_error_page(struct device *dev, u8 *ecc_calc,
 	elm_write_reg(info, ELM_IRQENABLE, reg_val & ~INTR_EN_PAGE_MASK);
 	elm_error_correction(info, err_vec);
 }
+EXPORT_SYMBOL(elm_decode_bch_error_page_finish);
+
+/**
+ * elm_decode_bch_error_page - Locate error position
+ * @dev:	device pointer
+ * @ecc_calc:	calculated ECC bytes from GPMC
+ * @err_vec:	elm error vectors
+ *
+ * Called with one or more error reported vectors & vectors with
+ * error reported is updated in err_vec[].error_reported
+ */
+void elm_decode_bch_error_page(struct device *dev, u8 *ecc_calc,
+		struct elm_errorvec *err_vec)
+{
+	elm_decode_bch_error_page_start(dev, ecc_calc, err_vec);
+	elm_decode_bch_error_page_finish(dev, err_vec);
+}
 EXPORT_SYMBOL(elm_decode_bch_error_page);
 
 static irqreturn_t elm_isr(int this_irq, void *dev_id)
@@ -171,6 +171,7 @@
 
 /* napi related */
 #define C_CAN_NAPI_WEIGHT	C_CAN_MSG_OBJ_RX_NUM
+#define C_CAN_NAPI_WEIGHT_MAX	NAPI_POLL_WEIGHT
 
 /* c_can lec values */
 enum c_can_lec_type {
@@ -248,12 +249,19 @@ static void c_can_irq_control(struct c_can_priv *priv, bool enable)
 	priv->write_reg(priv, C_CAN_CTRL_REG, ctrl);
 }
 
-static void c_can_obj_update(struct net_device *dev, int iface, u32 cmd, u32 obj)
+static inline void c_can_obj_start(struct net_device *dev, int iface,
+				   u32 cmd, u32 obj)
 {
 	struct c_can_priv *priv = netdev_priv(dev);
-	int cnt, reg = C_CAN_IFACE(COMREQ_REG, iface);
 
-	priv->write_reg32(priv, reg, (cmd << 16) | obj);
+	priv->write_reg32(priv, C_CAN_IFACE(COMREQ_REG, iface),
+			  (cmd << 16) | obj);
+}
+
+static void c_can_obj_wait(struct net_device *dev, int iface)
+{
+	struct c_can_priv *priv = netdev_priv(dev);
+	int cnt, reg = C_CAN_IFACE(COMREQ_REG, iface);
 
 	for (cnt = MIN_TIMEOUT_VALUE; cnt; cnt--) {
 		if (!(priv->read_reg(priv, reg) & IF_COMR_BUSY))
@@ -261,7 +269,12 @@ static void c_can_obj_update(struct net_device *dev, int iface, u32 cmd, u32 obj
 		udelay(1);
 	}
 	netdev_err(dev, "Updating object timed out\n");
+}
 
+static void c_can_obj_update(struct net_device *dev, int iface, u32 cmd, u32 obj)
+{
+	c_can_obj_start(dev, iface, cmd, obj);
+	c_can_obj_wait(dev, iface);
 }
 
 static inline void c_can_object_get(struct net_device *dev, int iface,
@@ -409,6 +422,9 @@ static int c_can_read_msg_object(struct net_device *dev, int iface, u32 ctrl)
 		}
 	}
 
+	/* no timestamps in the message objects, use the time it was seen */
+	skb->tstamp = priv->rx_tstamp;
+
 	stats->rx_packets++;
 	stats->rx_bytes += frame->can_dlc;
 
@@ -450,6 +466,7 @@ static netdev_tx_t c_can_start_xmit(struct sk_buff *skb,
 	/* If this is the last buffer, stop the xmit queue */
 	if (idx == C_CAN_MSG_OBJ_TX_NUM - 1)
 		netif_stop_queue(dev);
+	spin_lock(&priv->tx_if_lock);
 	/*
 	 * Store the message in the interface so we can call
 	 * can_put_echo_skb(). We must do this before we enable
@@ -463,6 +480,7 @@ static netdev_tx_t c_can_start_xmit(struct sk_buff *skb,
 	atomic_add((1 << idx), &priv->tx_active);
 	/* Start transmission */
 	c_can_object_put(dev, IF_TX, obj, IF_COMM_TX);
+	spin_unlock(&priv->tx_if_lock);
 
 	return NETDEV_TX_OK;
 }
@@ -739,53 +757,88 @@ static u32 c_can_adjust_pending(u32 pend)
 	return pend & ~((1 << lasts) - 1);
 }
 
-static inline void c_can_rx_object_get(struct net_device *dev,
-				       struct c_can_priv *priv, u32 obj)
+static inline void c_can_rx_object_start(struct net_device *dev,
+					 struct c_can_priv *priv, int iface,
+					 u32 obj)
 {
-		c_can_object_get(dev, IF_RX, obj, priv->comm_rcv_high);
+	c_can_obj_start(dev, iface, priv->comm_rcv_high, obj);
 }
 
 static inline void c_can_rx_finalize(struct net_device *dev,
-				     struct c_can_priv *priv, u32 obj)
+				     struct c_can_priv *priv, int iface,
+				     u32 obj)
 {
 	if (priv->type != BOSCH_D_CAN)
-		c_can_object_get(dev, IF_RX, obj, IF_COMM_CLR_NEWDAT);
+		c_can_object_get(dev, iface, obj, IF_COMM_CLR_NEWDAT);
 }
 
+/*
+ * Objects are read in a pipeline: while the frame of one object is copied
+ * out of an interface register set, the next object is already being
+ * transferred into the other one.  IF_TX is only borrowed when the xmit
+ * path is not using it, otherwise the next object goes through IF_RX.
+ */
 static int c_can_read_objects(struct net_device *dev, struct c_can_priv *priv,
 			      u32 pend, int quota)
 {
-	u32 pkts = 0, ctrl, obj;
+	u32 pkts = 0, ctrl, obj, next;
+	int iface = IF_RX, next_iface = IF_RX;
+
+	obj = ffs(pend);
+	if (!obj || quota <= 0)
+		return 0;
 
-	while ((obj = ffs(pend)) && quota > 0) {
-		pend &= ~BIT(obj - 1);
+	pend &= ~BIT(obj - 1);
+	c_can_rx_object_start(dev, priv, iface, obj);
+
+	while (obj) {
+		c_can_obj_wait(dev, iface);
+
+		next = quota > 1 ? ffs(pend) : 0;
+		if (next) {
+			pend &= ~BIT(next - 1);
+			next_iface = iface == IF_RX ? IF_TX : IF_RX;
+			if (next_iface == IF_TX &&
+			    !spin_trylock(&priv->tx_if_lock))
+				next_iface = -1;
+			else
+				c_can_rx_object_start(dev, priv, next_iface,
+						      next);
+		}
 
-		c_can_rx_object_get(dev, priv, obj);
-		ctrl = priv->read_reg(priv, C_CAN_IFACE(MSGCTRL_REG, IF_RX));
+		ctrl = priv->read_reg(priv, C_CAN_IFACE(MSGCTRL_REG, iface));
 
 		if (ctrl & IF_MCONT_MSGLST) {
-			int n = c_can_handle_lost_msg_obj(dev, IF_RX, obj, ctrl);
+			int n = c_can_handle_lost_msg_obj(dev, iface, obj, ctrl);
 
 			pkts += n;
 			quota -= n;
-			continue;
-		}
+		} else if (ctrl & IF_MCONT_NEWDAT) {
+			/*
+			 * Objects without NEWDAT really should not happen,
+			 * but this covers some odd HW behaviour. Do not
+			 * remove that unless you want to brick your machine.
+			 */
 
-		/*
-		 * This really should not happen, but this covers some
-		 * odd HW behaviour. Do not remove that unless you
-		 * want to brick your machine.
-		 */
-		if (!(ctrl & IF_MCONT_NEWDAT))
-			continue;
+			/* read the data from the message object */
+			c_can_read_msg_object(dev, iface, ctrl);
 
-		/* read the data from the message object */
-		c_can_read_msg_object(dev, IF_RX, ctrl);
+			c_can_rx_finalize(dev, priv, iface, obj);
 
-		c_can_rx_finalize(dev, priv, obj);
+			pkts++;
+			quota--;
+		}
 
-		pkts++;
-		quota--;
+		if (iface == IF_TX)
+			spin_unlock(&priv->tx_if_lock);
+
+		if (next_iface < 0) {
+			next_iface = IF_RX;
+			c_can_rx_object_start(dev, priv, next_iface, next);
+		}
+
+		obj = next;
+		iface = next_iface;
 	}
 
 	return pkts;
@@ -842,6 +895,9 @@ static int c_can_do_rx_poll(struct net_device *dev, int quota)
 		n = c_can_read_objects(dev, priv, toread, quota);
 		pkts += n;
 		quota -= n;
+
+		/* later batches were seen after the interrupt */
+		priv->rx_tstamp = ktime_get_real();
 	}
 
 	if (pkts)
@@ -1066,6 +1122,8 @@ static irqreturn_t c_can_isr(int irq, void *dev_id)
 	if (!priv->read_reg(priv, C_CAN_INT_REG))
 		return IRQ_NONE;
 
+	priv->rx_tstamp = ktime_get_real();
+
 	/* disable all interrupts and schedule the NAPI */
 	c_can_irq_control(priv, false);
 	napi_schedule(&priv->napi);
@@ -1149,6 +1207,7 @@ struct net_device *alloc_c_can_dev(void)
 
 	priv = netdev_priv(dev);
 	netif_napi_add(dev, &priv->napi, c_can_poll, C_CAN_NAPI_WEIGHT);
+	spin_lock_init(&priv->tx_if_lock);
 
 	priv->dev = dev;
 	priv->can.bittiming_const = &c_can_bittiming_const;
@@ -1247,6 +1306,47 @@ void free_c_can_dev(struct net_device *dev)
 }
 EXPORT_SYMBOL_GPL(free_c_can_dev);
 
+static ssize_t c_can_show_napi_weight(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	struct c_can_priv *priv = netdev_priv(to_net_dev(dev));
+
+	return sprintf(buf, "%d\n", priv->napi.weight);
+}
+
+static ssize_t c_can_set_napi_weight(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	struct c_can_priv *priv = netdev_priv(to_net_dev(dev));
+	unsigned int weight;
+	int err;
+
+	err = kstrtouint(buf, 0, &weight);
+	if (err)
+		return err;
+
+	if (!weight || weight > C_CAN_NAPI_WEIGHT_MAX)
+		return -EINVAL;
+
+	/* picked up by the next poll */
+	priv->napi.weight = weight;
+
+	return count;
+}
+
+static DEVICE_ATTR(napi_weight, S_IWUSR | S_IRUGO,
+		   c_can_show_napi_weight, c_can_set_napi_weight);
+
+static struct attribute *c_can_sysfs_attrs[] = {
+	&dev_attr_napi_weight.attr,
+	NULL,
+};
+
+static struct attribute_group c_can_sysfs_attr_group = {
+	.attrs = c_can_sysfs_attrs,
+};
+
 static const struct net_device_ops c_can_netdev_ops = {
 	.ndo_open = c_can_open,
 	.ndo_stop = c_can_close,
@@ -1270,6 +1370,7 @@ int register_c_can_dev(struct net_device *dev)
 
 	dev->flags |= IFF_ECHO;	/* we support local echo */
 	dev->netdev_ops = &c_can_netdev_ops;
+	dev->sysfs_groups[0] = &c_can_sysfs_attr_group;
 
 	err = register_candev(dev);
 	if (err)
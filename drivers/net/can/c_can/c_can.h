@@ -213,6 +213,8 @@ struct c_can_priv {
 	u32 comm_rcv_high;
 	u32 rxmasked;
 	u32 dlc[C_CAN_MSG_OBJ_TX_NUM];
+	spinlock_t tx_if_lock;	/* IF_TX, borrowed by c_can_read_objects() */
+	ktime_t rx_tstamp;
 };
 
 struct net_device *alloc_c_can_dev(void);
@@ -33,15 +33,25 @@
 #include <linux/of_net.h>
 #include <linux/of_device.h>
 #include <linux/if_vlan.h>
+#include <linux/filter.h>
+#include <linux/if_bridge.h>
+#include <linux/rtnetlink.h>
 #include <linux/net_switch_config.h>
 
 #include <linux/pinctrl/consumer.h>
 
+#include <net/busy_poll.h>
+#include <net/pkt_sched.h>
+#include <net/switchdev.h>
+
 #include "cpsw.h"
 #include "cpsw_ale.h"
 #include "cpts.h"
 #include "davinci_cpdma.h"
 
+#define CREATE_TRACE_POINTS
+#include "cpsw_trace.h"
+
 #define CPSW_DEBUG	(NETIF_MSG_HW		| NETIF_MSG_WOL		| \
 			 NETIF_MSG_DRV		| NETIF_MSG_LINK	| \
 			 NETIF_MSG_IFUP		| NETIF_MSG_INTR	| \
@@ -118,9 +128,16 @@ do {								\
 #define CPDMA_RXCP		0x60
 
 #define CPSW_POLL_WEIGHT	64
+#define CPSW_MAX_QUEUES		8
+#define CPSW_MIN_RING_DESCS	16
 #define CPSW_MIN_PACKET_SIZE	60
 #define CPSW_MAX_PACKET_SIZE	(1500 + 14 + 4 + 4)
 
+/* rx buffers are whole pages recycled through the rx channel page pool */
+#define CPSW_RX_HEADROOM	(NET_SKB_PAD + NET_IP_ALIGN)
+#define CPSW_RX_BUF_MAX		(PAGE_SIZE - CPSW_RX_HEADROOM -		\
+				 SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+
 #define RX_PRIORITY_MAPPING	0x76543210
 #define TX_PRIORITY_MAPPING	0x33221100
 #define CPDMA_TX_PRIORITY_MAP	0x76543210
@@ -139,6 +156,12 @@ do {								\
 #define CPSW_CMINTMAX_INTVL	(1000 / CPSW_CMINTMIN_CNT)
 #define CPSW_CMINTMIN_INTVL	((1000 / CPSW_CMINTMAX_CNT) + 1)
 
+/* dual_emac: frames from port 1 go to rx channel 0, port 2 to channel 1 */
+#define CPSW_DUAL_EMAC_RX_CH_MAP	0x11110000
+
+#define CPSW_ADAPT_SAMPLE	(HZ / 10)
+#define CPSW_ADAPT_BULK_SIZE	1024
+
 #define cpsw_slave_index(priv)				\
 		((priv->data.dual_emac) ? priv->emac_port :	\
 		priv->data.active_slave)
@@ -155,6 +178,18 @@ static int rx_packet_max = CPSW_MAX_PACKET_SIZE;
 module_param(rx_packet_max, int, 0);
 MODULE_PARM_DESC(rx_packet_max, "maximum receive packet size (bytes)");
 
+/*
+ * With the dual_emac slaves bridged, multicast that no port joined through
+ * IGMP/MLD snooping is flooded to the host for the bridge.  Without it the
+ * ALE drops such traffic.  Queries and IGMPv3/MLDv2 reports still reach
+ * the host, but IGMPv2/MLDv1 reports go to the group address, so only
+ * v3/v2 listeners can join then.
+ */
+static bool br_unreg_mcast_host = true;
+module_param(br_unreg_mcast_host, bool, 0444);
+MODULE_PARM_DESC(br_unreg_mcast_host,
+		 "flood unregistered multicast to the host while bridged");
+
 struct cpsw_wr_regs {
 	u32	id_ver;
 	u32	soft_reset;
@@ -362,6 +397,29 @@ static inline void slave_write(struct cpsw_slave *slave, u32 val, u32 offset)
 	__raw_writel(val, slave->regs + offset);
 }
 
+#ifdef CONFIG_TI_CPSW_LATENCY_HIST
+/*
+ * Latency histograms in power of two buckets of about a microsecond
+ * (1024ns): <1, 1-2, 2-4, ... 128-256, >=256.
+ */
+#define CPSW_LAT_BUCKETS	10
+
+struct cpsw_skb_cb {
+	u64	submit_ns;
+};
+
+#define CPSW_SKB_CB(skb)	((struct cpsw_skb_cb *)(skb)->cb)
+#endif
+
+/* a bridge multicast group, by MAC address, and the slaves that joined it */
+struct cpsw_mdb_entry {
+	struct list_head	list;
+	u8			addr[ETH_ALEN];
+	u16			vid;
+	/* snooped groups mapping to addr, per slave */
+	unsigned int		refs[2];
+};
+
 struct cpsw_priv {
 	spinlock_t			lock;
 	struct platform_device		*pdev;
@@ -377,6 +435,18 @@ struct cpsw_priv {
 	u32				msg_enable;
 	u32				version;
 	u32				coal_intvl;
+	/* adaptive interrupt pacing, tracked on the first slave's priv */
+	bool				coal_adaptive;
+	u32				coal_cur_intvl;
+	u32				coal_adapt_changes;
+	unsigned long			coal_stamp;
+	u64				coal_pkts, coal_bytes;
+	/* dual_emac slaves bridged together, switched in the ALE */
+	bool				br_offload;
+	struct notifier_block		br_nb;
+	/* bridge multicast groups switched by the ALE, on the first slave */
+	struct list_head		mdb_list;
+	spinlock_t			mdb_lock;
 	u32				bus_freq_mhz;
 	int				rx_packet_max;
 	int				host_port;
@@ -384,7 +454,25 @@ struct cpsw_priv {
 	u8				mac_addr[ETH_ALEN];
 	struct cpsw_slave		*slaves;
 	struct cpdma_ctlr		*dma;
-	struct cpdma_chan		*txch, *rxch;
+	struct cpdma_chan		*txch[CPSW_MAX_QUEUES], *rxch;
+	/* dual_emac slaves each have an rx channel and rx NAPI */
+	bool				rx_per_slave;
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	/* who is processing the rx channel: NAPI or a busy-polling socket */
+	unsigned int			rx_poll_state;
+	spinlock_t			rx_poll_lock;
+#endif
+	struct bpf_prog __rcu		*rx_filter;
+	u32				rx_filter_pass;
+	u32				rx_filter_drop;
+	u32				rx_filter_redirect;
+	u32				rx_filter_redirect_err;
+#ifdef CONFIG_TI_CPSW_LATENCY_HIST
+	u64				rx_irq_stamp;	/* ns, 0 if polled */
+	u32				rx_irq_lat[CPSW_LAT_BUCKETS];
+	u32				tx_done_lat[CPSW_LAT_BUCKETS];
+#endif
+	int				tx_ch_num;
 	struct cpsw_ale			*ale;
 	bool				rx_pause;
 	bool				tx_pause;
@@ -410,6 +498,8 @@ enum {
 	CPSW_STATS,
 	CPDMA_RX_STATS,
 	CPDMA_TX_STATS,
+	CPSW_PRIV_STATS,
+	CPSW_NDEV_STATS,
 };
 
 #define CPSW_STAT(m)		CPSW_STATS,				\
@@ -421,6 +511,12 @@ enum {
 #define CPDMA_TX_STAT(m)	CPDMA_TX_STATS,				   \
 				sizeof(((struct cpdma_chan_stats *)0)->m), \
 				offsetof(struct cpdma_chan_stats, m)
+#define CPSW_PRIV_STAT(m)	CPSW_PRIV_STATS,			   \
+				sizeof(((struct cpsw_priv *)0)->m),	   \
+				offsetof(struct cpsw_priv, m)
+#define CPSW_NDEV_STAT(m)	CPSW_NDEV_STATS,			   \
+				sizeof(((struct cpsw_priv *)0)->m),	   \
+				offsetof(struct cpsw_priv, m)
 
 static const struct cpsw_stats cpsw_gstrings_stats[] = {
 	{ "Good Rx Frames", CPSW_STAT(rxgoodframes) },
@@ -470,6 +566,8 @@ static const struct cpsw_stats cpsw_gstrings_stats[] = {
 	{ "Rx DMA chan: good_dequeue", CPDMA_RX_STAT(good_dequeue) },
 	{ "Rx DMA chan: requeue", CPDMA_RX_STAT(requeue) },
 	{ "Rx DMA chan: teardown_dequeue", CPDMA_RX_STAT(teardown_dequeue) },
+	{ "Rx DMA chan: rx_pool_hit", CPDMA_RX_STAT(rx_pool_hit) },
+	{ "Rx DMA chan: rx_pool_miss", CPDMA_RX_STAT(rx_pool_miss) },
 	{ "Tx DMA chan: head_enqueue", CPDMA_TX_STAT(head_enqueue) },
 	{ "Tx DMA chan: tail_enqueue", CPDMA_TX_STAT(tail_enqueue) },
 	{ "Tx DMA chan: pad_enqueue", CPDMA_TX_STAT(pad_enqueue) },
@@ -483,10 +581,52 @@ static const struct cpsw_stats cpsw_gstrings_stats[] = {
 	{ "Tx DMA chan: good_dequeue", CPDMA_TX_STAT(good_dequeue) },
 	{ "Tx DMA chan: requeue", CPDMA_TX_STAT(requeue) },
 	{ "Tx DMA chan: teardown_dequeue", CPDMA_TX_STAT(teardown_dequeue) },
+	{ "Tx DMA chan: desc_exhausted", CPDMA_TX_STAT(desc_exhausted) },
+	{ "Interrupt pacing usecs", CPSW_PRIV_STAT(coal_cur_intvl) },
+	{ "Adaptive pacing changes", CPSW_PRIV_STAT(coal_adapt_changes) },
+	{ "Rx filter: pass", CPSW_NDEV_STAT(rx_filter_pass) },
+	{ "Rx filter: drop", CPSW_NDEV_STAT(rx_filter_drop) },
+	{ "Rx filter: redirect", CPSW_NDEV_STAT(rx_filter_redirect) },
+	{ "Rx filter: redirect_err", CPSW_NDEV_STAT(rx_filter_redirect_err) },
+#ifdef CONFIG_TI_CPSW_LATENCY_HIST
+	{ "Rx irq to poll: <1us", CPSW_NDEV_STAT(rx_irq_lat[0]) },
+	{ "Rx irq to poll: 1-2us", CPSW_NDEV_STAT(rx_irq_lat[1]) },
+	{ "Rx irq to poll: 2-4us", CPSW_NDEV_STAT(rx_irq_lat[2]) },
+	{ "Rx irq to poll: 4-8us", CPSW_NDEV_STAT(rx_irq_lat[3]) },
+	{ "Rx irq to poll: 8-16us", CPSW_NDEV_STAT(rx_irq_lat[4]) },
+	{ "Rx irq to poll: 16-32us", CPSW_NDEV_STAT(rx_irq_lat[5]) },
+	{ "Rx irq to poll: 32-64us", CPSW_NDEV_STAT(rx_irq_lat[6]) },
+	{ "Rx irq to poll: 64-128us", CPSW_NDEV_STAT(rx_irq_lat[7]) },
+	{ "Rx irq to poll: 128-256us", CPSW_NDEV_STAT(rx_irq_lat[8]) },
+	{ "Rx irq to poll: >=256us", CPSW_NDEV_STAT(rx_irq_lat[9]) },
+	{ "Tx submit to done: <1us", CPSW_NDEV_STAT(tx_done_lat[0]) },
+	{ "Tx submit to done: 1-2us", CPSW_NDEV_STAT(tx_done_lat[1]) },
+	{ "Tx submit to done: 2-4us", CPSW_NDEV_STAT(tx_done_lat[2]) },
+	{ "Tx submit to done: 4-8us", CPSW_NDEV_STAT(tx_done_lat[3]) },
+	{ "Tx submit to done: 8-16us", CPSW_NDEV_STAT(tx_done_lat[4]) },
+	{ "Tx submit to done: 16-32us", CPSW_NDEV_STAT(tx_done_lat[5]) },
+	{ "Tx submit to done: 32-64us", CPSW_NDEV_STAT(tx_done_lat[6]) },
+	{ "Tx submit to done: 64-128us", CPSW_NDEV_STAT(tx_done_lat[7]) },
+	{ "Tx submit to done: 128-256us", CPSW_NDEV_STAT(tx_done_lat[8]) },
+	{ "Tx submit to done: >=256us", CPSW_NDEV_STAT(tx_done_lat[9]) },
+#endif
 };
 
 #define CPSW_STATS_LEN	ARRAY_SIZE(cpsw_gstrings_stats)
 
+/* per tx queue, one cpdma channel each */
+static const struct cpsw_stats cpsw_gstrings_txq_stats[] = {
+	{ "head_enqueue", CPDMA_TX_STAT(head_enqueue) },
+	{ "tail_enqueue", CPDMA_TX_STAT(tail_enqueue) },
+	{ "misqueued", CPDMA_TX_STAT(misqueued) },
+	{ "desc_alloc_fail", CPDMA_TX_STAT(desc_alloc_fail) },
+	{ "good_dequeue", CPDMA_TX_STAT(good_dequeue) },
+	{ "teardown_dequeue", CPDMA_TX_STAT(teardown_dequeue) },
+	{ "desc_exhausted", CPDMA_TX_STAT(desc_exhausted) },
+};
+
+#define CPSW_TXQ_STATS_LEN	ARRAY_SIZE(cpsw_gstrings_txq_stats)
+
 #define napi_to_priv(napi)	container_of(napi, struct cpsw_priv, napi)
 #define for_each_slave(priv, func, arg...)				\
 	do {								\
@@ -508,18 +648,16 @@ static const struct cpsw_stats cpsw_gstrings_stats[] = {
 		(priv->slaves[__slave_no__].ndev)) ?			\
 		netdev_priv(priv->slaves[__slave_no__].ndev) : NULL)	\
 
-#define cpsw_dual_emac_src_port_detect(status, priv, ndev, skb)		\
+#define cpsw_dual_emac_src_port_detect(status, priv, ndev)		\
 	do {								\
 		if (!priv->data.dual_emac)				\
 			break;						\
 		if (CPDMA_RX_SOURCE_PORT(status) == 1) {		\
 			ndev = cpsw_get_slave_ndev(priv, 0);		\
 			priv = netdev_priv(ndev);			\
-			skb->dev = ndev;				\
 		} else if (CPDMA_RX_SOURCE_PORT(status) == 2) {		\
 			ndev = cpsw_get_slave_ndev(priv, 1);		\
 			priv = netdev_priv(ndev);			\
-			skb->dev = ndev;				\
 		}							\
 	} while (0)
 #define cpsw_add_mcast(priv, addr)					\
@@ -569,13 +707,23 @@ static void cpsw_set_promiscious(struct net_device *ndev, bool enable)
 			dev_err(&ndev->dev, "promiscuity not disabled as the other interface is still in promiscuity mode\n");
 		}
 
-		if (enable) {
+		if (enable && cpsw_get_slave_priv(priv, 0)->br_offload) {
+			/* the bridge needs unknown unicast, but bypass would
+			 * stop the ALE switching between the slaves
+			 */
+			cpsw_ale_control_set(ale, 0, ALE_BYPASS, 0);
+			cpsw_ale_control_set(ale, 0, ALE_P0_UNI_FLOOD, 1);
+
+			dev_dbg(&ndev->dev, "promiscuity enabled\n");
+		} else if (enable) {
 			/* Enable Bypass */
+			cpsw_ale_control_set(ale, 0, ALE_P0_UNI_FLOOD, 0);
 			cpsw_ale_control_set(ale, 0, ALE_BYPASS, 1);
 
 			dev_dbg(&ndev->dev, "promiscuity enabled\n");
 		} else {
 			/* Disable Bypass */
+			cpsw_ale_control_set(ale, 0, ALE_P0_UNI_FLOOD, 0);
 			cpsw_ale_control_set(ale, 0, ALE_BYPASS, 0);
 			dev_dbg(&ndev->dev, "promiscuity disabled\n");
 		}
@@ -623,6 +771,18 @@ static void cpsw_set_promiscious(struct net_device *ndev, bool enable)
 	}
 }
 
+static void cpsw_mdb_restore(struct cpsw_priv *priv);
+
+static void cpsw_set_allmulti(struct cpsw_priv *priv, int allmulti)
+{
+	/* snooped groups have entries of their own, the rest may go */
+	if (priv->data.dual_emac &&
+	    cpsw_get_slave_priv(priv, 0)->br_offload && !br_unreg_mcast_host)
+		allmulti = 0;
+
+	cpsw_ale_set_allmulti(priv->ale, allmulti);
+}
+
 static void cpsw_ndo_set_rx_mode(struct net_device *ndev)
 {
 	struct cpsw_priv *priv = netdev_priv(ndev);
@@ -636,7 +796,7 @@ static void cpsw_ndo_set_rx_mode(struct net_device *ndev)
 	if (ndev->flags & IFF_PROMISC) {
 		/* Enable promiscuous mode */
 		cpsw_set_promiscious(ndev, true);
-		cpsw_ale_set_allmulti(priv->ale, IFF_ALLMULTI);
+		cpsw_set_allmulti(priv, IFF_ALLMULTI);
 		return;
 	} else {
 		/* Disable promiscuous mode */
@@ -644,7 +804,7 @@ static void cpsw_ndo_set_rx_mode(struct net_device *ndev)
 	}
 
 	/* Restore allmulti on vlans if necessary */
-	cpsw_ale_set_allmulti(priv->ale, priv->ndev->flags & IFF_ALLMULTI);
+	cpsw_set_allmulti(priv, priv->ndev->flags & IFF_ALLMULTI);
 
 	/* Clear all mcast from ALE */
 	cpsw_ale_flush_multicast(priv->ale, ALE_ALL_PORTS << priv->host_port,
@@ -658,6 +818,10 @@ static void cpsw_ndo_set_rx_mode(struct net_device *ndev)
 			cpsw_add_mcast(priv, (u8 *)ha->addr);
 		}
 	}
+
+	/* the flush above took the bridge groups as well */
+	if (priv->data.dual_emac)
+		cpsw_mdb_restore(cpsw_get_slave_priv(priv, 0));
 }
 
 static void cpsw_intr_enable(struct cpsw_priv *priv)
@@ -678,32 +842,332 @@ static void cpsw_intr_disable(struct cpsw_priv *priv)
 	return;
 }
 
+/* Program the interrupt pacer, returns the interval actually applied */
+static u32 cpsw_set_pacing(struct cpsw_priv *priv, u32 coal_intvl)
+{
+	struct cpsw_priv *priv_sl0 = cpsw_get_slave_priv(priv, 0);
+	u32 int_ctrl;
+	u32 num_interrupts = 0;
+	u32 prescale = 0;
+	u32 addnl_dvdr = 1;
+
+	int_ctrl =  readl(&priv->wr_regs->int_control);
+	prescale = priv->bus_freq_mhz * 4;
+
+	if (!coal_intvl) {
+		int_ctrl &= ~(CPSW_INTPRESCALE_MASK | CPSW_INTPACEEN);
+		goto update_return;
+	}
+
+	if (coal_intvl < CPSW_CMINTMIN_INTVL)
+		coal_intvl = CPSW_CMINTMIN_INTVL;
+
+	if (coal_intvl > CPSW_CMINTMAX_INTVL) {
+		/* Interrupt pacer works with 4us Pulse, we can
+		 * throttle further by dilating the 4us pulse.
+		 */
+		addnl_dvdr = CPSW_INTPRESCALE_MASK / prescale;
+
+		if (addnl_dvdr > 1) {
+			prescale *= addnl_dvdr;
+			if (coal_intvl > (CPSW_CMINTMAX_INTVL * addnl_dvdr))
+				coal_intvl = (CPSW_CMINTMAX_INTVL
+						* addnl_dvdr);
+		} else {
+			addnl_dvdr = 1;
+			coal_intvl = CPSW_CMINTMAX_INTVL;
+		}
+	}
+
+	num_interrupts = (1000 * addnl_dvdr) / coal_intvl;
+	writel(num_interrupts, &priv->wr_regs->rx_imax);
+	writel(num_interrupts, &priv->wr_regs->tx_imax);
+
+	int_ctrl |= CPSW_INTPACEEN;
+	int_ctrl &= (~CPSW_INTPRESCALE_MASK);
+	int_ctrl |= (prescale & CPSW_INTPRESCALE_MASK);
+
+update_return:
+	writel(int_ctrl, &priv->wr_regs->int_control);
+	priv_sl0->coal_cur_intvl = coal_intvl;
+
+	return coal_intvl;
+}
+
+/* Pacing interval used below each packet rate, in packets per second */
+static const struct {
+	u32	pps;
+	u32	usecs;
+} cpsw_adapt_levels[] = {
+	{ 10000, 0 },		/* an interrupt per event, lowest latency */
+	{ 30000, 50 },
+	{ 60000, 125 },
+	{ U32_MAX, 250 },
+};
+
+/*
+ * Adaptive interrupt moderation: sample the packet and byte rate across
+ * both directions every CPSW_ADAPT_SAMPLE and retune the pacer.  Called from
+ * the NAPI poll handlers.
+ */
+static void cpsw_adapt_coalesce(struct cpsw_priv *priv)
+{
+	struct cpsw_priv *priv_sl0 = cpsw_get_slave_priv(priv, 0);
+	unsigned long now = jiffies;
+	unsigned long elapsed;
+	u64 pkts = 0, bytes = 0;
+	u32 pps, avg = 0, usecs;
+	int i, level;
+
+	if (!priv_sl0->coal_adaptive)
+		return;
+
+	elapsed = now - priv_sl0->coal_stamp;
+	if (elapsed < CPSW_ADAPT_SAMPLE)
+		return;
+
+	for (i = 0; i < priv->data.slaves; i++) {
+		struct net_device *ndev = priv->slaves[i].ndev;
+
+		if (!ndev)
+			continue;
+		pkts += ndev->stats.rx_packets + ndev->stats.tx_packets;
+		bytes += ndev->stats.rx_bytes + ndev->stats.tx_bytes;
+	}
+
+	pps = div_u64((pkts - priv_sl0->coal_pkts) * HZ, elapsed);
+	if (pkts != priv_sl0->coal_pkts)
+		avg = div64_u64(bytes - priv_sl0->coal_bytes,
+				pkts - priv_sl0->coal_pkts);
+
+	for (level = 0; level < ARRAY_SIZE(cpsw_adapt_levels) - 1; level++)
+		if (pps < cpsw_adapt_levels[level].pps)
+			break;
+
+	/* bulk transfers tolerate latency better, batch one level harder */
+	if (level && level < ARRAY_SIZE(cpsw_adapt_levels) - 1 &&
+	    avg >= CPSW_ADAPT_BULK_SIZE)
+		level++;
+
+	usecs = cpsw_adapt_levels[level].usecs;
+	if (usecs != priv_sl0->coal_cur_intvl) {
+		cpsw_set_pacing(priv, usecs);
+		priv_sl0->coal_adapt_changes++;
+	}
+
+	priv_sl0->coal_stamp = now;
+	priv_sl0->coal_pkts = pkts;
+	priv_sl0->coal_bytes = bytes;
+}
+
+#ifdef CONFIG_TI_CPSW_LATENCY_HIST
+static void cpsw_lat_account(u32 *hist, u64 start)
+{
+	u64 delta = ktime_get_ns() - start;
+
+	hist[min_t(int, fls64(delta >> 10), CPSW_LAT_BUCKETS - 1)]++;
+}
+
+static inline void cpsw_tx_stamp(struct sk_buff *skb)
+{
+	CPSW_SKB_CB(skb)->submit_ns = ktime_get_ns();
+}
+
+static inline void cpsw_tx_lat(struct cpsw_priv *priv, struct sk_buff *skb)
+{
+	cpsw_lat_account(priv->tx_done_lat, CPSW_SKB_CB(skb)->submit_ns);
+}
+
+static inline void cpsw_rx_irq_stamp(struct cpsw_priv *priv)
+{
+	priv->rx_irq_stamp = ktime_get_ns();
+}
+
+/* Only the first poll after an interrupt counts */
+static inline void cpsw_rx_irq_lat(struct cpsw_priv *priv)
+{
+	if (priv->rx_irq_stamp) {
+		cpsw_lat_account(priv->rx_irq_lat, priv->rx_irq_stamp);
+		priv->rx_irq_stamp = 0;
+	}
+}
+#else
+static inline void cpsw_tx_stamp(struct sk_buff *skb)
+{
+}
+
+static inline void cpsw_tx_lat(struct cpsw_priv *priv, struct sk_buff *skb)
+{
+}
+
+static inline void cpsw_rx_irq_stamp(struct cpsw_priv *priv)
+{
+}
+
+static inline void cpsw_rx_irq_lat(struct cpsw_priv *priv)
+{
+}
+#endif
+
 static void cpsw_tx_handler(void *token, int len, int status)
 {
 	struct sk_buff		*skb = token;
 	struct net_device	*ndev = skb->dev;
 	struct cpsw_priv	*priv = netdev_priv(ndev);
+	struct netdev_queue	*txq;
+	int			q;
+
+	netdev_tx_completed_queue(netdev_get_tx_queue(ndev,
+						      skb_get_queue_mapping(skb)),
+				  1, skb->len);
 
-	/* Check whether the queue is stopped due to stalled tx dma, if the
-	 * queue is stopped then start the queue as we have free desc for tx
+	/* Check whether a queue is stopped due to stalled tx dma, if so
+	 * start it as we have free desc for tx.  All queues share the
+	 * descriptor pool, so any completion may unblock any queue.
 	 */
-	if (unlikely(netif_queue_stopped(ndev)))
-		netif_wake_queue(ndev);
+	for (q = 0; q < ndev->real_num_tx_queues; q++) {
+		txq = netdev_get_tx_queue(ndev, q);
+		if (unlikely(netif_tx_queue_stopped(txq)))
+			netif_tx_wake_queue(txq);
+	}
 	cpts_tx_timestamp(priv->cpts, skb);
+	trace_cpsw_tx_complete(ndev, skb);
+	if (status >= 0)
+		cpsw_tx_lat(priv, skb);
 	ndev->stats.tx_packets++;
 	ndev->stats.tx_bytes += len;
+	/* teardown completes from process context, keep those off the cache */
+	napi_consume_skb(skb, status >= 0);
+}
+
+static inline int cpsw_rx_submit(struct cpsw_priv *priv, gfp_t gfp)
+{
+	return cpdma_chan_submit_page(priv->rxch, priv->ndev, CPSW_RX_HEADROOM,
+				      priv->rx_packet_max, gfp);
+}
+
+static netdev_tx_t cpsw_ndo_start_xmit(struct sk_buff *skb,
+				       struct net_device *ndev);
+
+/* Send a received frame straight out of the other dual_emac port */
+static void cpsw_rx_redirect(struct cpsw_priv *priv, struct sk_buff *skb)
+{
+	struct net_device *ndev = priv->ndev;
+	struct net_device *out_ndev;
+	struct netdev_queue *txq;
+	netdev_tx_t ret = NETDEV_TX_BUSY;
+
+	out_ndev = cpsw_get_slave_ndev(priv, priv->emac_port ? 0 : 1);
+	if (!priv->data.dual_emac || !out_ndev || out_ndev == ndev ||
+	    !netif_running(out_ndev) || !netif_carrier_ok(out_ndev))
+		goto drop;
+
+	skb->dev = out_ndev;
+	skb_set_queue_mapping(skb, 0);
+	txq = netdev_get_tx_queue(out_ndev, 0);
+
+	__netif_tx_lock(txq, smp_processor_id());
+	if (!netif_xmit_frozen_or_stopped(txq))
+		ret = cpsw_ndo_start_xmit(skb, out_ndev);
+	__netif_tx_unlock(txq);
+
+	if (ret == NETDEV_TX_OK) {
+		priv->rx_filter_redirect++;
+		return;
+	}
+
+drop:
+	priv->rx_filter_redirect_err++;
+	ndev->stats.rx_dropped++;
 	dev_kfree_skb_any(skb);
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+#define CPSW_RX_IDLE		0
+#define CPSW_RX_NAPI		BIT(0)	/* NAPI owns the rx channel */
+#define CPSW_RX_POLL		BIT(1)	/* a busy-polling socket owns it */
+#define CPSW_RX_DISABLED	BIT(2)	/* the interface is going down */
+#define CPSW_RX_LOCKED		(CPSW_RX_NAPI | CPSW_RX_POLL | CPSW_RX_DISABLED)
+
+static void cpsw_rx_poll_init(struct cpsw_priv *priv)
+{
+	spin_lock_init(&priv->rx_poll_lock);
+	priv->rx_poll_state = CPSW_RX_IDLE;
+}
+
+/* NAPI and busy polling take turns, the loser retries later */
+static bool cpsw_rx_lock(struct cpsw_priv *priv, unsigned int owner)
+{
+	bool locked = false;
+
+	spin_lock_bh(&priv->rx_poll_lock);
+	if (!(priv->rx_poll_state & CPSW_RX_LOCKED)) {
+		priv->rx_poll_state = owner;
+		locked = true;
+	}
+	spin_unlock_bh(&priv->rx_poll_lock);
+
+	return locked;
+}
+
+static void cpsw_rx_unlock(struct cpsw_priv *priv)
+{
+	spin_lock_bh(&priv->rx_poll_lock);
+	priv->rx_poll_state = CPSW_RX_IDLE;
+	spin_unlock_bh(&priv->rx_poll_lock);
+}
+
+/* Wait for a busy poller to leave, then keep them all out */
+static void cpsw_rx_poll_disable(struct cpsw_priv *priv)
+{
+	while (!cpsw_rx_lock(priv, CPSW_RX_DISABLED))
+		usleep_range(100, 200);
+}
+
+/* GRO state belongs to NAPI, busy polling hands frames up directly */
+static bool cpsw_rx_busy_polling(struct cpsw_priv *priv)
+{
+	return priv->rx_poll_state & CPSW_RX_POLL;
+}
+#else
+#define CPSW_RX_NAPI		0
+
+static inline void cpsw_rx_poll_init(struct cpsw_priv *priv)
+{
+}
+
+static inline bool cpsw_rx_lock(struct cpsw_priv *priv, unsigned int owner)
+{
+	return true;
+}
+
+static inline void cpsw_rx_unlock(struct cpsw_priv *priv)
+{
+}
+
+static inline void cpsw_rx_poll_disable(struct cpsw_priv *priv)
+{
+}
+
+static inline bool cpsw_rx_busy_polling(struct cpsw_priv *priv)
+{
+	return false;
+}
+#endif
+
 static void cpsw_rx_handler(void *token, int len, int status)
 {
-	struct sk_buff		*skb = token;
-	struct sk_buff		*new_skb;
-	struct net_device	*ndev = skb->dev;
+	struct cpdma_rx_page	*buf = token;
+	struct page		*page = buf->page;
+	struct sk_buff		*skb;
+	struct net_device	*ndev = buf->token;
 	struct cpsw_priv	*priv = netdev_priv(ndev);
+	struct cpsw_priv	*rx_priv = priv;	/* owner of the channel */
+	struct bpf_prog		*prog;
+	u32			verdict = 0;
 	int			ret = 0;
 
-	cpsw_dual_emac_src_port_detect(status, priv, ndev, skb);
+	cpsw_dual_emac_src_port_detect(status, priv, ndev);
 
 	if (unlikely(status < 0) || unlikely(!netif_running(ndev))) {
 		bool ndev_status = false;
@@ -722,35 +1186,110 @@ static void cpsw_rx_handler(void *token, int len, int status)
 			 * is already down and the other interface is up
 			 * and running, instead of freeing which results
 			 * in reducing of the number of rx descriptor in
-			 * DMA engine, requeue skb back to cpdma.
+			 * DMA engine, requeue the page back to cpdma.
 			 */
-			new_skb = skb;
 			goto requeue;
 		}
 
-		/* the interface is going down, skbs are purged */
-		dev_kfree_skb_any(skb);
+		/* the interface is going down, pages go back to the pool */
 		return;
 	}
 
-	new_skb = netdev_alloc_skb_ip_align(ndev, priv->rx_packet_max);
-	if (new_skb) {
-		skb_put(skb, len);
-		cpts_rx_timestamp(priv->cpts, skb);
-		skb->protocol = eth_type_trans(skb, ndev);
-		netif_receive_skb(skb);
-		ndev->stats.rx_bytes += len;
-		ndev->stats.rx_packets++;
-	} else {
+	skb = napi_build_skb(page_address(page), PAGE_SIZE);
+	if (unlikely(!skb)) {
+		ndev->stats.rx_dropped++;
+		goto requeue;
+	}
+
+	skb_reserve(skb, CPSW_RX_HEADROOM);
+	skb_put(skb, len);
+
+	/* The early filter sees the frame from its ethernet header, before
+	 * the buffer is replaced or the stack gets to it.  Dropped frames
+	 * keep their page in the pool.
+	 */
+	rcu_read_lock();
+	prog = rcu_dereference(priv->rx_filter);
+	if (prog)
+		verdict = BPF_PROG_RUN(prog, skb);
+	rcu_read_unlock();
+
+	if (prog && verdict == SWITCH_RX_FILTER_DROP) {
+		priv->rx_filter_drop++;
+		kfree_skb_partial(skb, true);
+		goto requeue;
+	}
+
+	/* Hold the page for the stack before refilling so the pool cannot
+	 * hand it straight back to hardware.
+	 */
+	get_page(page);
+	ret = cpsw_rx_submit(rx_priv, GFP_ATOMIC);
+	if (unlikely(ret < 0)) {
+		/* drops the reference taken above, the page stays pooled */
+		kfree_skb(skb);
 		ndev->stats.rx_dropped++;
-		new_skb = skb;
+		goto requeue;
+	}
+
+	if (prog) {
+		if (verdict == SWITCH_RX_FILTER_REDIRECT) {
+			cpsw_rx_redirect(priv, skb);
+			return;
+		}
+		priv->rx_filter_pass++;
 	}
 
+	cpts_rx_timestamp(priv->cpts, skb);
+	skb->protocol = eth_type_trans(skb, ndev);
+	skb_mark_napi_id(skb, &rx_priv->napi_rx);
+	if (cpsw_rx_busy_polling(rx_priv))
+		netif_receive_skb(skb);
+	else
+		napi_gro_receive(&rx_priv->napi_rx, skb);
+	ndev->stats.rx_bytes += len;
+	ndev->stats.rx_packets++;
+	return;
+
 requeue:
-	ret = cpdma_chan_submit(priv->rxch, new_skb, new_skb->data,
-			skb_tailroom(new_skb), 0);
-	if (WARN_ON(ret < 0))
-		dev_kfree_skb_any(new_skb);
+	ret = cpsw_rx_submit(rx_priv, GFP_ATOMIC);
+	WARN_ON(ret < 0);
+}
+
+/* Prime the rx channels, split evenly between the slaves if they have one
+ * each.
+ */
+static int cpsw_fill_rx_channels(struct cpsw_priv *priv)
+{
+	int num_ch = priv->rx_per_slave ? priv->data.slaves : 1;
+	int descs = priv->data.rx_descs / num_ch;
+	int ch, i, ret;
+
+	for (ch = 0; ch < num_ch; ch++) {
+		struct cpsw_priv *rx_priv = cpsw_get_slave_priv(priv, ch);
+
+		for (i = 0; i < descs; i++) {
+			ret = cpsw_rx_submit(rx_priv, GFP_KERNEL);
+			if (ret < 0)
+				return ret;
+		}
+		cpsw_info(priv, ifup, "submitted %d rx descriptors\n", i);
+	}
+
+	return 0;
+}
+
+static void cpsw_flush_rx_channels(struct cpsw_priv *priv)
+{
+	int i;
+
+	if (!priv->rx_per_slave) {
+		cpdma_chan_page_pool_flush(priv->rxch);
+		return;
+	}
+
+	for (i = 0; i < priv->data.slaves; i++)
+		cpdma_chan_page_pool_flush(cpsw_get_slave_priv(priv, i)->rxch);
 }
 
 static irqreturn_t cpsw_tx_interrupt(int irq, void *dev_id)
@@ -774,6 +1313,27 @@ static irqreturn_t cpsw_rx_interrupt(int irq, void *dev_id)
 	struct cpsw_priv *priv = dev_id;
 
 	cpdma_ctlr_eoi(priv->dma, CPDMA_EOI_RX);
+
+	if (priv->rx_per_slave) {
+		u32 status = readl(&priv->wr_regs->rx_stat);
+		int i;
+
+		/* mask only the channels that fired, at the dma so the line
+		 * drops without the irq quirk; each slave polls its own
+		 */
+		for (i = 0; i < priv->data.slaves; i++) {
+			struct cpsw_priv *slave_priv = cpsw_get_slave_priv(priv,
+									   i);
+
+			if (!(status & BIT(i)))
+				continue;
+			cpsw_rx_irq_stamp(slave_priv);
+			cpdma_chan_int_ctrl(slave_priv->rxch, false);
+			napi_schedule(&slave_priv->napi_rx);
+		}
+		return IRQ_HANDLED;
+	}
+
 	writel(0, &priv->wr_regs->rx_en);
 
 	if (priv->quirk_irq) {
@@ -781,6 +1341,7 @@ static irqreturn_t cpsw_rx_interrupt(int irq, void *dev_id)
 		priv->rx_irq_disabled = true;
 	}
 
+	cpsw_rx_irq_stamp(priv);
 	napi_schedule(&priv->napi_rx);
 	return IRQ_HANDLED;
 }
@@ -788,9 +1349,18 @@ static irqreturn_t cpsw_rx_interrupt(int irq, void *dev_id)
 static int cpsw_tx_poll(struct napi_struct *napi_tx, int budget)
 {
 	struct cpsw_priv	*priv = napi_to_priv(napi_tx);
-	int			num_tx;
+	int			num_tx = 0;
+	int			ch, ret;
+
+	trace_cpsw_napi_poll_start(priv->ndev, false, budget, 0);
+
+	/* reap the highest priority channels first */
+	for (ch = priv->tx_ch_num - 1; ch >= 0 && num_tx < budget; ch--) {
+		ret = cpdma_chan_process(priv->txch[ch], budget - num_tx);
+		if (ret > 0)
+			num_tx += ret;
+	}
 
-	num_tx = cpdma_chan_process(priv->txch, budget);
 	if (num_tx < budget) {
 		napi_complete(napi_tx);
 		writel(0xff, &priv->wr_regs->tx_en);
@@ -803,6 +1373,9 @@ static int cpsw_tx_poll(struct napi_struct *napi_tx, int budget)
 	if (num_tx)
 		cpsw_dbg(priv, intr, "poll %d tx pkts\n", num_tx);
 
+	cpsw_adapt_coalesce(priv);
+	trace_cpsw_napi_poll_end(priv->ndev, false, budget, num_tx);
+
 	return num_tx;
 }
 
@@ -811,22 +1384,63 @@ static int cpsw_rx_poll(struct napi_struct *napi_rx, int budget)
 	struct cpsw_priv	*priv = napi_to_priv(napi_rx);
 	int			num_rx;
 
+	/* a socket is busy polling the channel, come back for the rest */
+	if (!cpsw_rx_lock(priv, CPSW_RX_NAPI))
+		return budget;
+
+	trace_cpsw_napi_poll_start(priv->ndev, true, budget, 0);
+	cpsw_rx_irq_lat(priv);
+
 	num_rx = cpdma_chan_process(priv->rxch, budget);
+	cpsw_rx_unlock(priv);
 	if (num_rx < budget) {
 		napi_complete(napi_rx);
-		writel(0xff, &priv->wr_regs->rx_en);
+		if (priv->rx_per_slave)
+			cpdma_chan_int_ctrl(priv->rxch, true);
+		else
+			writel(0xff, &priv->wr_regs->rx_en);
 		if (priv->quirk_irq && priv->rx_irq_disabled) {
 			priv->rx_irq_disabled = false;
 			enable_irq(priv->irqs_table[0]);
 		}
+	} else {
+		/* budget used up, don't hold merged segments until the
+		 * next poll
+		 */
+		napi_gro_flush(napi_rx, false);
 	}
 
 	if (num_rx)
 		cpsw_dbg(priv, intr, "poll %d rx pkts\n", num_rx);
 
+	cpsw_adapt_coalesce(priv);
+	trace_cpsw_napi_poll_end(priv->ndev, true, budget, num_rx);
+
 	return num_rx;
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+#define CPSW_BUSY_POLL_BUDGET	4
+
+/* Called from a socket spinning for data, with BHs off */
+static int cpsw_busy_poll(struct napi_struct *napi_rx)
+{
+	struct cpsw_priv	*priv = napi_to_priv(napi_rx);
+	int			num_rx;
+
+	if (!netif_running(priv->ndev))
+		return LL_FLUSH_FAILED;
+
+	if (!cpsw_rx_lock(priv, CPSW_RX_POLL))
+		return LL_FLUSH_BUSY;
+
+	num_rx = cpdma_chan_process(priv->rxch, CPSW_BUSY_POLL_BUDGET);
+	cpsw_rx_unlock(priv);
+
+	return num_rx;
+}
+#endif
+
 static inline void soft_reset(const char *module, void __iomem *reg)
 {
 	unsigned long timeout = jiffies + HZ;
@@ -913,10 +1527,10 @@ static void cpsw_adjust_link(struct net_device *ndev)
 	if (link) {
 		netif_carrier_on(ndev);
 		if (netif_running(ndev))
-			netif_wake_queue(ndev);
+			netif_tx_wake_all_queues(ndev);
 	} else {
 		netif_carrier_off(ndev);
-		netif_stop_queue(ndev);
+		netif_tx_stop_all_queues(ndev);
 	}
 }
 
@@ -924,8 +1538,13 @@ static int cpsw_get_coalesce(struct net_device *ndev,
 				struct ethtool_coalesce *coal)
 {
 	struct cpsw_priv *priv = netdev_priv(ndev);
+	struct cpsw_priv *priv_sl0 = cpsw_get_slave_priv(priv, 0);
 
-	coal->rx_coalesce_usecs = priv->coal_intvl;
+	coal->use_adaptive_rx_coalesce = priv_sl0->coal_adaptive;
+	if (priv_sl0->coal_adaptive)
+		coal->rx_coalesce_usecs = priv_sl0->coal_cur_intvl;
+	else
+		coal->rx_coalesce_usecs = priv->coal_intvl;
 	return 0;
 }
 
@@ -933,52 +1552,24 @@ static int cpsw_set_coalesce(struct net_device *ndev,
 				struct ethtool_coalesce *coal)
 {
 	struct cpsw_priv *priv = netdev_priv(ndev);
-	u32 int_ctrl;
-	u32 num_interrupts = 0;
-	u32 prescale = 0;
-	u32 addnl_dvdr = 1;
+	struct cpsw_priv *priv_sl0 = cpsw_get_slave_priv(priv, 0);
 	u32 coal_intvl = 0;
 
-	coal_intvl = coal->rx_coalesce_usecs;
-
-	int_ctrl =  readl(&priv->wr_regs->int_control);
-	prescale = priv->bus_freq_mhz * 4;
-
-	if (!coal->rx_coalesce_usecs) {
-		int_ctrl &= ~(CPSW_INTPRESCALE_MASK | CPSW_INTPACEEN);
-		goto update_return;
-	}
-
-	if (coal_intvl < CPSW_CMINTMIN_INTVL)
-		coal_intvl = CPSW_CMINTMIN_INTVL;
-
-	if (coal_intvl > CPSW_CMINTMAX_INTVL) {
-		/* Interrupt pacer works with 4us Pulse, we can
-		 * throttle further by dilating the 4us pulse.
+	if (coal->use_adaptive_rx_coalesce) {
+		/* start from the low latency end, the poll handlers
+		 * move the pacer as the traffic rate is sampled
 		 */
-		addnl_dvdr = CPSW_INTPRESCALE_MASK / prescale;
-
-		if (addnl_dvdr > 1) {
-			prescale *= addnl_dvdr;
-			if (coal_intvl > (CPSW_CMINTMAX_INTVL * addnl_dvdr))
-				coal_intvl = (CPSW_CMINTMAX_INTVL
-						* addnl_dvdr);
-		} else {
-			addnl_dvdr = 1;
-			coal_intvl = CPSW_CMINTMAX_INTVL;
-		}
+		priv_sl0->coal_stamp = jiffies;
+		priv_sl0->coal_pkts = 0;
+		priv_sl0->coal_bytes = 0;
+		priv_sl0->coal_adaptive = true;
+		cpsw_set_pacing(priv, cpsw_adapt_levels[0].usecs);
+		cpsw_notice(priv, timer, "Set adaptive coalesce.\n");
+		return 0;
 	}
 
-	num_interrupts = (1000 * addnl_dvdr) / coal_intvl;
-	writel(num_interrupts, &priv->wr_regs->rx_imax);
-	writel(num_interrupts, &priv->wr_regs->tx_imax);
-
-	int_ctrl |= CPSW_INTPACEEN;
-	int_ctrl &= (~CPSW_INTPRESCALE_MASK);
-	int_ctrl |= (prescale & CPSW_INTPRESCALE_MASK);
-
-update_return:
-	writel(int_ctrl, &priv->wr_regs->int_control);
+	priv_sl0->coal_adaptive = false;
+	coal_intvl = cpsw_set_pacing(priv, coal->rx_coalesce_usecs);
 
 	cpsw_notice(priv, timer, "Set coalesce to %d usecs.\n", coal_intvl);
 	if (priv->data.dual_emac) {
@@ -997,9 +1588,11 @@ update_return:
 
 static int cpsw_get_sset_count(struct net_device *ndev, int sset)
 {
+	struct cpsw_priv *priv = netdev_priv(ndev);
+
 	switch (sset) {
 	case ETH_SS_STATS:
-		return CPSW_STATS_LEN;
+		return CPSW_STATS_LEN + priv->tx_ch_num * CPSW_TXQ_STATS_LEN;
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -1007,8 +1600,9 @@ static int cpsw_get_sset_count(struct net_device *ndev, int sset)
 
 static void cpsw_get_strings(struct net_device *ndev, u32 stringset, u8 *data)
 {
+	struct cpsw_priv *priv = netdev_priv(ndev);
 	u8 *p = data;
-	int i;
+	int i, ch;
 
 	switch (stringset) {
 	case ETH_SS_STATS:
@@ -1017,6 +1611,13 @@ static void cpsw_get_strings(struct net_device *ndev, u32 stringset, u8 *data)
 			       ETH_GSTRING_LEN);
 			p += ETH_GSTRING_LEN;
 		}
+		for (ch = 0; ch < priv->tx_ch_num; ch++) {
+			for (i = 0; i < CPSW_TXQ_STATS_LEN; i++) {
+				snprintf(p, ETH_GSTRING_LEN, "Tx queue %d: %s",
+					 ch, cpsw_gstrings_txq_stats[i].stat_string);
+				p += ETH_GSTRING_LEN;
+			}
+		}
 		break;
 	}
 }
@@ -1027,13 +1628,21 @@ static void cpsw_get_ethtool_stats(struct net_device *ndev,
 	struct cpsw_priv *priv = netdev_priv(ndev);
 	struct cpdma_chan_stats rx_stats;
 	struct cpdma_chan_stats tx_stats;
+	struct cpdma_chan_stats ch_stats;
 	u32 val;
 	u8 *p;
-	int i;
+	int i, j, ch;
 
-	/* Collect Davinci CPDMA stats for Rx and Tx Channel */
+	/* Collect Davinci CPDMA stats for Rx and Tx Channels, the Tx
+	 * entries of the main table are summed over all tx queues
+	 */
 	cpdma_chan_get_stats(priv->rxch, &rx_stats);
-	cpdma_chan_get_stats(priv->txch, &tx_stats);
+	memset(&tx_stats, 0, sizeof(tx_stats));
+	for (ch = 0; ch < priv->tx_ch_num; ch++) {
+		cpdma_chan_get_stats(priv->txch[ch], &ch_stats);
+		for (j = 0; j < sizeof(ch_stats) / sizeof(u32); j++)
+			((u32 *)&tx_stats)[j] += ((u32 *)&ch_stats)[j];
+	}
 
 	for (i = 0; i < CPSW_STATS_LEN; i++) {
 		switch (cpsw_gstrings_stats[i].type) {
@@ -1054,6 +1663,27 @@ static void cpsw_get_ethtool_stats(struct net_device *ndev,
 				cpsw_gstrings_stats[i].stat_offset;
 			data[i] = *(u32 *)p;
 			break;
+
+		case CPSW_PRIV_STATS:
+			p = (u8 *)cpsw_get_slave_priv(priv, 0) +
+				cpsw_gstrings_stats[i].stat_offset;
+			data[i] = *(u32 *)p;
+			break;
+
+		case CPSW_NDEV_STATS:
+			p = (u8 *)priv + cpsw_gstrings_stats[i].stat_offset;
+			data[i] = *(u32 *)p;
+			break;
+		}
+	}
+
+	data += CPSW_STATS_LEN;
+	for (ch = 0; ch < priv->tx_ch_num; ch++) {
+		cpdma_chan_get_stats(priv->txch[ch], &ch_stats);
+		for (i = 0; i < CPSW_TXQ_STATS_LEN; i++) {
+			p = (u8 *)&ch_stats +
+				cpsw_gstrings_txq_stats[i].stat_offset;
+			*data++ = *(u32 *)p;
 		}
 	}
 }
@@ -1074,36 +1704,244 @@ static int cpsw_common_res_usage_state(struct cpsw_priv *priv)
 }
 
 static inline int cpsw_tx_packet_submit(struct net_device *ndev,
-			struct cpsw_priv *priv, struct sk_buff *skb)
+			struct cpsw_priv *priv, struct cpdma_chan *txch,
+			struct sk_buff *skb)
 {
-	if (!priv->data.dual_emac)
-		return cpdma_chan_submit(priv->txch, skb, skb->data,
-				  skb->len, 0);
+	int port = 0;
+
+	if (priv->data.dual_emac)
+		port = (ndev == cpsw_get_slave_ndev(priv, 0)) ? 1 : 2;
+
+	/* hold the doorbell back while the stack has more frames queued */
+	if (skb->xmit_more)
+		return cpdma_chan_submit_more(txch, skb, skb->data,
+					      skb->len, port);
+
+	return cpdma_chan_submit(txch, skb, skb->data, skb->len, port);
+}
+
+static inline void cpsw_add_dual_emac_def_ale_entries(
+		struct cpsw_priv *priv, struct cpsw_slave *slave,
+		u32 slave_port)
+{
+	u32 port_mask = 1 << slave_port | 1 << priv->host_port;
+
+	if (priv->version == CPSW_VERSION_1)
+		slave_write(slave, slave->port_vlan, CPSW1_PORT_VLAN);
+	else
+		slave_write(slave, slave->port_vlan, CPSW2_PORT_VLAN);
+	cpsw_ale_add_vlan(priv->ale, slave->port_vlan, port_mask,
+			  port_mask, port_mask, 0);
+	cpsw_ale_add_mcast(priv->ale, priv->ndev->broadcast,
+			   port_mask, ALE_VLAN, slave->port_vlan, 0);
+	cpsw_ale_add_ucast(priv->ale, priv->mac_addr,
+		priv->host_port, ALE_VLAN | ALE_SECURE, slave->port_vlan);
+}
+
+static void cpsw_set_slave_port_vlan(struct cpsw_priv *priv,
+				     struct cpsw_slave *slave, u32 vid)
+{
+	if (priv->version == CPSW_VERSION_1)
+		slave_write(slave, vid, CPSW1_PORT_VLAN);
+	else
+		slave_write(slave, vid, CPSW2_PORT_VLAN);
+}
+
+/* Set a slave's ALE port state, applied right away if the link is up */
+static void cpsw_set_br_port_state(struct cpsw_priv *priv, int state)
+{
+	struct cpsw_slave *slave = priv->slaves + priv->emac_port;
+	int slave_port = cpsw_get_slave_port(priv, slave->slave_num);
+
+	priv->port_state[slave_port] = state;
+	if (slave->phy && slave->phy->link)
+		cpsw_ale_control_set(priv->ale, slave_port, ALE_PORT_STATE,
+				     state);
+}
+
+static bool cpsw_slaves_bridged(struct cpsw_priv *priv)
+{
+	struct net_device *ndev0 = cpsw_get_slave_ndev(priv, 0);
+	struct net_device *ndev1 = cpsw_get_slave_ndev(priv, 1);
+	struct net_device *master;
+
+	if (!ndev0 || !ndev1)
+		return false;
+	if (!(ndev0->priv_flags & IFF_BRIDGE_PORT) ||
+	    !(ndev1->priv_flags & IFF_BRIDGE_PORT))
+		return false;
+
+	master = netdev_master_upper_dev_get(ndev0);
+	return master && master == netdev_master_upper_dev_get(ndev1);
+}
+
+/* IGMP/MLD control traffic the bridge must see without flooding */
+static const u8 cpsw_mcast_ctrl_addrs[][ETH_ALEN] = {
+	{ 0x01, 0x00, 0x5e, 0x00, 0x00, 0x01 },	/* IGMP queries */
+	{ 0x01, 0x00, 0x5e, 0x00, 0x00, 0x02 },	/* IGMPv2 leaves */
+	{ 0x01, 0x00, 0x5e, 0x00, 0x00, 0x16 },	/* IGMPv3 reports */
+	{ 0x33, 0x33, 0x00, 0x00, 0x00, 0x01 },	/* MLD queries */
+	{ 0x33, 0x33, 0x00, 0x00, 0x00, 0x02 },	/* MLDv1 dones */
+	{ 0x33, 0x33, 0x00, 0x00, 0x00, 0x16 },	/* MLDv2 reports */
+};
+
+static void cpsw_mcast_ctrl_update(struct cpsw_priv *priv, bool add)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(cpsw_mcast_ctrl_addrs); i++) {
+		u8 *addr = (u8 *)cpsw_mcast_ctrl_addrs[i];
+
+		if (add)
+			cpsw_ale_add_mcast(priv->ale, addr, 1 << priv->host_port,
+					   0, 0, ALE_MCAST_FWD);
+		else
+			cpsw_ale_del_mcast(priv->ale, addr, 0, 0, 0);
+	}
+}
+
+/* Write a group's entry for the slaves that joined it.  Needs mdb_lock. */
+static int cpsw_mdb_program(struct cpsw_priv *priv, struct cpsw_mdb_entry *e)
+{
+	int mask = 0, i;
+
+	/* programmed again from ndo_open */
+	if (!cpsw_common_res_usage_state(priv))
+		return 0;
+
+	for (i = 0; i < ARRAY_SIZE(e->refs); i++)
+		if (e->refs[i])
+			mask |= 1 << cpsw_get_slave_port(priv, i);
+	if (!mask)
+		return cpsw_ale_del_mcast(priv->ale, e->addr, 0, ALE_VLAN,
+					  e->vid);
+
+	/*
+	 * The host stays a member: IGMPv2 and MLDv1 reports are sent to the
+	 * group address, and the bridge must see them to keep the group.
+	 */
+	mask |= 1 << priv->host_port;
+	if (!cpsw_ale_del_mcast(priv->ale, e->addr, mask, ALE_VLAN, e->vid))
+		return 0;
+	return cpsw_ale_add_mcast(priv->ale, e->addr, mask, ALE_VLAN, e->vid,
+				  ALE_MCAST_FWD);
+}
+
+static void cpsw_mdb_restore(struct cpsw_priv *priv_sl0)
+{
+	struct cpsw_mdb_entry *e;
+	unsigned long flags;
+
+	if (!priv_sl0->br_offload)
+		return;
+
+	spin_lock_irqsave(&priv_sl0->mdb_lock, flags);
+	list_for_each_entry(e, &priv_sl0->mdb_list, list)
+		cpsw_mdb_program(priv_sl0, e);
+	spin_unlock_irqrestore(&priv_sl0->mdb_lock, flags);
+}
+
+static void cpsw_mdb_flush(struct cpsw_priv *priv_sl0)
+{
+	struct cpsw_mdb_entry *e, *tmp;
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv_sl0->mdb_lock, flags);
+	list_for_each_entry_safe(e, tmp, &priv_sl0->mdb_list, list) {
+		memset(e->refs, 0, sizeof(e->refs));
+		cpsw_mdb_program(priv_sl0, e);
+		list_del(&e->list);
+		kfree(e);
+	}
+	spin_unlock_irqrestore(&priv_sl0->mdb_lock, flags);
+}
+
+/* Promiscuity and multicast flooding depend on br_offload */
+static void cpsw_br_rx_mode_update(struct cpsw_priv *priv)
+{
+	int i;
+
+	for (i = 0; i < priv->data.slaves; i++) {
+		struct net_device *ndev = priv->slaves[i].ndev;
+
+		netif_addr_lock_bh(ndev);
+		cpsw_ndo_set_rx_mode(ndev);
+		netif_addr_unlock_bh(ndev);
+	}
+}
+
+/*
+ * When both dual_emac slaves are ports of the same bridge, let the ALE
+ * switch unicast between them: untagged frames of the second port are
+ * classified into the first port's vlan and both ports become members of
+ * it.  Broadcast and unregistered multicast only go to the host so
+ * flooding is still done once, by the bridge; groups joined through
+ * snooping are switched by the ALE, see cpsw_swdev_port_mdb_add().  Needs
+ * rtnl, and the hardware powered up.
+ */
+static void cpsw_br_offload_update(struct cpsw_priv *priv, bool force)
+{
+	struct cpsw_priv *priv_sl0 = cpsw_get_slave_priv(priv, 0);
+	struct cpsw_priv *priv_sl1 = cpsw_get_slave_priv(priv, 1);
+	u8 stp_addr[ETH_ALEN] = { 0x01, 0x80, 0xc2, 0x00, 0x00, 0x00 };
+	int port0, port1, host_mask, ports;
+	bool bridged;
+	u16 vid;
+
+	if (!priv->data.dual_emac || !priv_sl0 || !priv_sl1)
+		return;
+
+	bridged = cpsw_slaves_bridged(priv);
+	if (bridged == priv_sl0->br_offload && !force)
+		return;
+	priv_sl0->br_offload = bridged;
+	if (!bridged)
+		cpsw_mdb_flush(priv_sl0);
 
-	if (ndev == cpsw_get_slave_ndev(priv, 0))
-		return cpdma_chan_submit(priv->txch, skb, skb->data,
-				  skb->len, 1);
-	else
-		return cpdma_chan_submit(priv->txch, skb, skb->data,
-				  skb->len, 2);
-}
+	/* programmed again from ndo_open */
+	if (!cpsw_common_res_usage_state(priv) || (force && !bridged))
+		return;
 
-static inline void cpsw_add_dual_emac_def_ale_entries(
-		struct cpsw_priv *priv, struct cpsw_slave *slave,
-		u32 slave_port)
-{
-	u32 port_mask = 1 << slave_port | 1 << priv->host_port;
+	port0 = cpsw_get_slave_port(priv, 0);
+	port1 = cpsw_get_slave_port(priv, 1);
+	host_mask = 1 << priv->host_port;
+	ports = (1 << port0) | (1 << port1);
+	vid = priv->slaves[0].port_vlan;
+
+	if (bridged) {
+		cpsw_set_slave_port_vlan(priv, priv->slaves + 1, vid);
+		cpsw_ale_add_vlan(priv->ale, vid, ports | host_mask,
+				  ports | host_mask, ports | host_mask,
+				  br_unreg_mcast_host ? host_mask : 0);
+		cpsw_ale_del_mcast(priv->ale, priv->ndev->broadcast, host_mask,
+				   ALE_VLAN, vid);
+		cpsw_ale_add_ucast(priv->ale, priv_sl1->mac_addr,
+				   priv->host_port, ALE_VLAN | ALE_SECURE, vid);
+		/* BPDUs must reach the host in the blocking state as well */
+		cpsw_ale_add_mcast(priv->ale, stp_addr, host_mask, ALE_SUPER,
+				   0, ALE_MCAST_BLOCK_LEARN_FWD);
+		if (!br_unreg_mcast_host)
+			cpsw_mcast_ctrl_update(priv, true);
+		cpsw_mdb_restore(priv_sl0);
+		cpsw_br_rx_mode_update(priv);
+		dev_info(priv->dev, "ALE switching between %s and %s\n",
+			 priv_sl0->ndev->name, priv_sl1->ndev->name);
+		return;
+	}
 
-	if (priv->version == CPSW_VERSION_1)
-		slave_write(slave, slave->port_vlan, CPSW1_PORT_VLAN);
-	else
-		slave_write(slave, slave->port_vlan, CPSW2_PORT_VLAN);
-	cpsw_ale_add_vlan(priv->ale, slave->port_vlan, port_mask,
-			  port_mask, port_mask, 0);
-	cpsw_ale_add_mcast(priv->ale, priv->ndev->broadcast,
-			   port_mask, ALE_VLAN, slave->port_vlan, 0);
-	cpsw_ale_add_ucast(priv->ale, priv->mac_addr,
-		priv->host_port, ALE_VLAN | ALE_SECURE, slave->port_vlan);
+	if (!br_unreg_mcast_host)
+		cpsw_mcast_ctrl_update(priv, false);
+	cpsw_ale_del_mcast(priv->ale, stp_addr, 0, 0, 0);
+	cpsw_ale_del_ucast(priv->ale, priv_sl1->mac_addr, priv->host_port,
+			   ALE_VLAN, vid);
+	cpsw_ale_flush_learned(priv->ale, ports);
+	cpsw_add_dual_emac_def_ale_entries(priv_sl0, priv->slaves, port0);
+	cpsw_add_dual_emac_def_ale_entries(priv_sl1, priv->slaves + 1, port1);
+
+	/* the bridge leaves its ports disabled */
+	cpsw_set_br_port_state(priv_sl0, ALE_PORT_STATE_FORWARD);
+	cpsw_set_br_port_state(priv_sl1, ALE_PORT_STATE_FORWARD);
+	cpsw_br_rx_mode_update(priv);
 }
 
 static void soft_reset_slave(struct cpsw_slave *slave)
@@ -1207,6 +2045,10 @@ static void cpsw_init_host_port(struct cpsw_priv *priv)
 	control_reg = readl(&priv->regs->control);
 	control_reg |= CPSW_VLAN_AWARE;
 	writel(control_reg, &priv->regs->control);
+	if (priv->rx_per_slave)
+		writel(CPSW_DUAL_EMAC_RX_CH_MAP,
+		       &priv->host_port_regs->cpdma_rx_chan_map);
+
 	fifo_mode = (priv->data.dual_emac) ? CPSW_FIFO_DUAL_MAC_MODE :
 		     CPSW_FIFO_NORMAL_MODE;
 	writel(fifo_mode, &priv->host_port_regs->tx_in_ctl);
@@ -1289,8 +2131,15 @@ static int cpsw_ndo_open(struct net_device *ndev)
 		/* Enable internal fifo flow control */
 		writel(0x7, &priv->regs->flow_control);
 
+		cpsw_rx_unlock(priv_sl0);
 		napi_enable(&priv_sl0->napi_rx);
 		napi_enable(&priv_sl0->napi_tx);
+		for (i = 1; priv->rx_per_slave && i < priv->data.slaves; i++) {
+			struct cpsw_priv *rx_priv = cpsw_get_slave_priv(priv, i);
+
+			cpsw_rx_unlock(rx_priv);
+			napi_enable(&rx_priv->napi_rx);
+		}
 
 		if (priv_sl0->tx_irq_disabled) {
 			priv_sl0->tx_irq_disabled = false;
@@ -1302,28 +2151,9 @@ static int cpsw_ndo_open(struct net_device *ndev)
 			enable_irq(priv->irqs_table[0]);
 		}
 
-		if (WARN_ON(!priv->data.rx_descs))
-			priv->data.rx_descs = 128;
-
-		for (i = 0; i < priv->data.rx_descs; i++) {
-			struct sk_buff *skb;
-
-			ret = -ENOMEM;
-			skb = __netdev_alloc_skb_ip_align(priv->ndev,
-					priv->rx_packet_max, GFP_KERNEL);
-			if (!skb)
-				goto err_cleanup;
-			ret = cpdma_chan_submit(priv->rxch, skb, skb->data,
-					skb_tailroom(skb), 0);
-			if (ret < 0) {
-				kfree_skb(skb);
-				goto err_cleanup;
-			}
-		}
-		/* continue even if we didn't manage to submit all
-		 * receive descs
-		 */
-		cpsw_info(priv, ifup, "submitted %d rx descriptors\n", i);
+		ret = cpsw_fill_rx_channels(priv);
+		if (ret < 0)
+			goto err_cleanup;
 
 		if (cpts_register(&priv->pdev->dev, priv->cpts,
 				  priv->data.cpts_clock_mult,
@@ -1333,8 +2163,13 @@ static int cpsw_ndo_open(struct net_device *ndev)
 	}
 
 	/* Enable Interrupt pacing if configured */
-	if (priv->coal_intvl != 0) {
-		struct ethtool_coalesce coal;
+	if (cpsw_get_slave_priv(priv, 0)->coal_adaptive) {
+		struct ethtool_coalesce coal = { };
+
+		coal.use_adaptive_rx_coalesce = 1;
+		cpsw_set_coalesce(ndev, &coal);
+	} else if (priv->coal_intvl != 0) {
+		struct ethtool_coalesce coal = { };
 
 		coal.rx_coalesce_usecs = (priv->coal_intvl << 4);
 		cpsw_set_coalesce(ndev, &coal);
@@ -1343,12 +2178,16 @@ static int cpsw_ndo_open(struct net_device *ndev)
 	cpdma_ctlr_start(priv->dma);
 	cpsw_intr_enable(priv);
 
-	if (priv->data.dual_emac)
+	if (priv->data.dual_emac) {
 		priv->slaves[priv->emac_port].open_stat = true;
+		/* slave open reset this port's ALE entries */
+		cpsw_br_offload_update(priv, true);
+	}
 	return 0;
 
 err_cleanup:
 	cpdma_ctlr_stop(priv->dma);
+	cpsw_flush_rx_channels(priv);
 	for_each_slave(priv, cpsw_slave_stop, priv);
 	pm_runtime_put_sync(&priv->pdev->dev);
 	netif_carrier_off(priv->ndev);
@@ -1360,19 +2199,33 @@ static int cpsw_ndo_stop(struct net_device *ndev)
 	struct cpsw_priv *priv = netdev_priv(ndev);
 
 	cpsw_info(priv, ifdown, "shutting down cpsw device\n");
-	netif_stop_queue(priv->ndev);
+	netif_tx_stop_all_queues(priv->ndev);
 	netif_carrier_off(priv->ndev);
 
 	if (cpsw_common_res_usage_state(priv) <= 1) {
 		struct cpsw_priv *priv_sl0 = cpsw_get_slave_priv(priv, 0);
+		int q;
 
 		napi_disable(&priv_sl0->napi_rx);
+		cpsw_rx_poll_disable(priv_sl0);
 		napi_disable(&priv_sl0->napi_tx);
+		for (q = 1; priv->rx_per_slave && q < priv->data.slaves; q++) {
+			struct cpsw_priv *rx_priv = cpsw_get_slave_priv(priv, q);
+
+			napi_disable(&rx_priv->napi_rx);
+			cpsw_rx_poll_disable(rx_priv);
+		}
 		cpts_unregister(priv->cpts);
 		cpsw_intr_disable(priv);
 		cpdma_ctlr_int_ctrl(priv->dma, false);
 		cpdma_ctlr_stop(priv->dma);
+		cpsw_flush_rx_channels(priv);
 		cpsw_ale_stop(priv->ale);
+
+		/* teardown has completed every queued skb, restart BQL */
+		for (q = 0; q < priv->ndev->real_num_tx_queues; q++)
+			netdev_tx_reset_queue(netdev_get_tx_queue(priv->ndev,
+								  q));
 	}
 	for_each_slave(priv, cpsw_slave_stop, priv);
 	pm_runtime_put_sync(&priv->pdev->dev);
@@ -1385,7 +2238,9 @@ static netdev_tx_t cpsw_ndo_start_xmit(struct sk_buff *skb,
 				       struct net_device *ndev)
 {
 	struct cpsw_priv *priv = netdev_priv(ndev);
-	int ret;
+	struct netdev_queue *txq;
+	struct cpdma_chan *txch;
+	int ret, q_idx;
 
 	ndev->trans_start = jiffies;
 
@@ -1401,25 +2256,113 @@ static netdev_tx_t cpsw_ndo_start_xmit(struct sk_buff *skb,
 
 	skb_tx_timestamp(skb);
 
-	ret = cpsw_tx_packet_submit(ndev, priv, skb);
+	q_idx = skb_get_queue_mapping(skb);
+	if (q_idx >= priv->tx_ch_num) {
+		q_idx = q_idx % priv->tx_ch_num;
+		skb_set_queue_mapping(skb, q_idx);
+	}
+	txch = priv->txch[q_idx];
+	txq = netdev_get_tx_queue(ndev, q_idx);
+
+	/* completion may free the skb as soon as it is submitted */
+	trace_cpsw_xmit(ndev, skb);
+	cpsw_tx_stamp(skb);
+	ret = cpsw_tx_packet_submit(ndev, priv, txch, skb);
 	if (unlikely(ret != 0)) {
 		cpsw_err(priv, tx_err, "desc submit failed\n");
 		goto fail;
 	}
+	netdev_tx_sent_queue(txq, skb->len);
 
 	/* If there is no more tx desc left free then we need to
 	 * tell the kernel to stop sending us tx frames.
 	 */
-	if (unlikely(!cpdma_check_free_tx_desc(priv->txch)))
-		netif_stop_queue(ndev);
+	if (unlikely(!cpdma_check_free_tx_desc(txch)))
+		netif_tx_stop_queue(txq);
+
+	/* a stopped queue ends the batch, the stack brings no more */
+	if (skb->xmit_more && netif_xmit_stopped(txq))
+		cpdma_chan_kick(txch);
 
 	return NETDEV_TX_OK;
 fail:
 	ndev->stats.tx_dropped++;
-	netif_stop_queue(ndev);
+	netif_tx_stop_queue(txq);
+	cpdma_chan_kick(txch);
 	return NETDEV_TX_BUSY;
 }
 
+/* Without an mqprio configuration, map skb->priority straight onto the
+ * cpdma channel of the same number.  In fixed priority mode channel 7 is
+ * served first.
+ */
+static u16 cpsw_ndo_select_queue(struct net_device *ndev, struct sk_buff *skb,
+				 void *accel_priv,
+				 select_queue_fallback_t fallback)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+
+	if (netdev_get_num_tc(ndev))
+		return fallback(ndev, skb);
+
+	return min_t(u32, skb->priority & TC_BITMASK, priv->tx_ch_num - 1);
+}
+
+/* mqprio hardware offload: traffic class N is mapped onto queue N */
+static int cpsw_ndo_setup_tc(struct net_device *ndev, u8 num_tc)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+	int tc;
+
+	if (!num_tc) {
+		netdev_reset_tc(ndev);
+		return 0;
+	}
+
+	if (num_tc > priv->tx_ch_num)
+		return -EINVAL;
+
+	netdev_set_num_tc(ndev, num_tc);
+	for (tc = 0; tc < num_tc; tc++)
+		netdev_set_tc_queue(ndev, tc, 1, tc);
+
+	return 0;
+}
+
+static int cpsw_ndo_set_tx_maxrate(struct net_device *ndev, int queue,
+				   u32 maxrate)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+
+	if (queue < 0 || queue >= priv->tx_ch_num)
+		return -EINVAL;
+
+	/* maxrate is in Mbps, cpdma wants kbps */
+	return cpdma_chan_set_rate(priv->txch[queue], maxrate * 1000);
+}
+
+/*
+ * Credit based shaper offload.  The channel rate limiter paces the queue
+ * at idleslope, which is what the shaper amounts to over time; there is
+ * nothing to set hicredit and locredit with.
+ */
+static int cpsw_ndo_setup_cbs(struct net_device *ndev,
+			      struct tc_cbs_qopt_offload *cbs)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+
+	if (cbs->queue < 0 || cbs->queue >= priv->tx_ch_num)
+		return -EINVAL;
+
+	if (!cbs->enable)
+		return cpdma_chan_set_rate(priv->txch[cbs->queue], 0);
+
+	if (cbs->idleslope <= 0)
+		return -EINVAL;
+
+	return cpdma_chan_set_rate(priv->txch[cbs->queue], cbs->idleslope);
+}
+
 #ifdef CONFIG_TI_CPTS
 
 static void cpsw_hwtstamp_v1(struct cpsw_priv *priv)
@@ -1843,6 +2786,41 @@ static int cpsw_switch_config_ioctl(struct net_device *ndev,
 	return ret;
 }
 
+static int cpsw_rx_filter_ioctl(struct net_device *ndev, struct ifreq *ifr)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+	struct bpf_prog *prog = NULL, *old;
+	struct sock_fprog_kern fkern;
+	struct sock_fprog fprog;
+	int ret;
+
+	if (copy_from_user(&fprog, ifr->ifr_data, sizeof(fprog)))
+		return -EFAULT;
+
+	if (fprog.len) {
+		fkern.len = fprog.len;
+		fkern.filter = memdup_user(fprog.filter,
+					   fprog.len * sizeof(*fprog.filter));
+		if (IS_ERR(fkern.filter))
+			return PTR_ERR(fkern.filter);
+
+		ret = bpf_prog_create(&prog, &fkern);
+		kfree(fkern.filter);
+		if (ret)
+			return ret;
+	}
+
+	old = rtnl_dereference(priv->rx_filter);
+	rcu_assign_pointer(priv->rx_filter, prog);
+	if (old) {
+		synchronize_rcu();
+		bpf_prog_destroy(old);
+	}
+
+	cpsw_info(priv, drv, "rx filter %s\n", prog ? "attached" : "detached");
+	return 0;
+}
+
 static int cpsw_ndo_ioctl(struct net_device *dev, struct ifreq *req, int cmd)
 {
 	struct cpsw_priv *priv = netdev_priv(dev);
@@ -1860,6 +2838,8 @@ static int cpsw_ndo_ioctl(struct net_device *dev, struct ifreq *req, int cmd)
 #endif
 	case SIOCSWITCHCONFIG:
 		return cpsw_switch_config_ioctl(dev, req, cmd);
+	case SIOCSWITCHRXFILTER:
+		return cpsw_rx_filter_ioctl(dev, req);
 	}
 
 	if (!priv->slaves[slave_no].phy)
@@ -1870,13 +2850,16 @@ static int cpsw_ndo_ioctl(struct net_device *dev, struct ifreq *req, int cmd)
 static void cpsw_ndo_tx_timeout(struct net_device *ndev)
 {
 	struct cpsw_priv *priv = netdev_priv(ndev);
+	int i;
 
 	cpsw_err(priv, tx_err, "transmit timeout, restarting dma\n");
 	ndev->stats.tx_errors++;
 	cpsw_intr_disable(priv);
 	cpdma_ctlr_int_ctrl(priv->dma, false);
-	cpdma_chan_stop(priv->txch);
-	cpdma_chan_start(priv->txch);
+	for (i = 0; i < priv->tx_ch_num; i++) {
+		cpdma_chan_stop(priv->txch[i]);
+		cpdma_chan_start(priv->txch[i]);
+	}
 	cpdma_ctlr_int_ctrl(priv->dma, true);
 	cpsw_intr_enable(priv);
 }
@@ -1929,7 +2912,20 @@ static inline int cpsw_add_vlan_ale_entry(struct cpsw_priv *priv,
 	int unreg_mcast_mask = 0;
 	u32 port_mask;
 
-	if (priv->data.dual_emac) {
+	if (priv->data.dual_emac &&
+	    cpsw_get_slave_priv(priv, 0)->br_offload) {
+		/* bridge vlans are shared by both ports, flooding stays
+		 * with the host
+		 */
+		port_mask = (1 << (priv->emac_port + 1)) | ALE_PORT_HOST;
+		ret = cpsw_ale_vlan_add_modify(priv->ale, vid, port_mask, 0,
+					       port_mask, br_unreg_mcast_host ?
+					       ALE_PORT_HOST : 0);
+		if (ret != 0)
+			return ret;
+		port_mask = ALE_PORT_HOST;
+		goto add_entries;
+	} else if (priv->data.dual_emac) {
 		port_mask = (1 << (priv->emac_port + 1)) | ALE_PORT_HOST;
 
 		if (priv->ndev->flags & IFF_ALLMULTI)
@@ -1948,6 +2944,7 @@ static inline int cpsw_add_vlan_ale_entry(struct cpsw_priv *priv,
 	if (ret != 0)
 		return ret;
 
+add_entries:
 	ret = cpsw_ale_add_ucast(priv->ale, priv->mac_addr,
 				 priv->host_port, ALE_VLAN, vid);
 	if (ret != 0)
@@ -2011,9 +3008,21 @@ static int cpsw_ndo_vlan_rx_kill_vid(struct net_device *ndev,
 	}
 
 	dev_info(priv->dev, "removing vlanid %d from vlan filter\n", vid);
-	ret = cpsw_ale_del_vlan(priv->ale, vid, 0);
-	if (ret != 0)
-		return ret;
+	if (priv->data.dual_emac &&
+	    cpsw_get_slave_priv(priv, 0)->br_offload) {
+		/* keep the vlan while the other bridge port still uses it */
+		ret = cpsw_ale_vlan_del_modify(priv->ale, vid,
+					       1 << (priv->emac_port + 1));
+		if (ret < 0)
+			return ret;
+		if (ret & ~ALE_PORT_HOST)
+			return 0;
+		cpsw_ale_del_vlan(priv->ale, vid, 0);
+	} else {
+		ret = cpsw_ale_del_vlan(priv->ale, vid, 0);
+		if (ret != 0)
+			return ret;
+	}
 
 	ret = cpsw_ale_del_ucast(priv->ale, priv->mac_addr,
 				 priv->host_port, ALE_VLAN, vid);
@@ -2024,10 +3033,54 @@ static int cpsw_ndo_vlan_rx_kill_vid(struct net_device *ndev,
 				  0, ALE_VLAN, vid);
 }
 
+static int cpsw_ndo_fdb_add(struct ndmsg *ndm, struct nlattr *tb[],
+			    struct net_device *ndev,
+			    const unsigned char *addr, u16 vid, u16 flags)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+	int slave_port;
+
+	if (!priv->data.dual_emac ||
+	    !cpsw_get_slave_priv(priv, 0)->br_offload ||
+	    !is_unicast_ether_addr(addr))
+		return ndo_dflt_fdb_add(ndm, tb, ndev, addr, vid, flags);
+
+	if (!vid)
+		vid = priv->slaves[0].port_vlan;
+	slave_port = cpsw_get_slave_port(priv, priv->emac_port);
+
+	return cpsw_ale_add_ucast(priv->ale, (u8 *)addr, slave_port,
+				  ALE_VLAN, vid);
+}
+
+static int cpsw_ndo_fdb_del(struct ndmsg *ndm, struct nlattr *tb[],
+			    struct net_device *ndev,
+			    const unsigned char *addr, u16 vid)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+	int slave_port;
+
+	if (!priv->data.dual_emac ||
+	    !cpsw_get_slave_priv(priv, 0)->br_offload ||
+	    !is_unicast_ether_addr(addr))
+		return ndo_dflt_fdb_del(ndm, tb, ndev, addr, vid);
+
+	if (!vid)
+		vid = priv->slaves[0].port_vlan;
+	slave_port = cpsw_get_slave_port(priv, priv->emac_port);
+
+	return cpsw_ale_del_ucast(priv->ale, (u8 *)addr, slave_port,
+				  ALE_VLAN, vid);
+}
+
 static const struct net_device_ops cpsw_netdev_ops = {
 	.ndo_open		= cpsw_ndo_open,
 	.ndo_stop		= cpsw_ndo_stop,
 	.ndo_start_xmit		= cpsw_ndo_start_xmit,
+	.ndo_select_queue	= cpsw_ndo_select_queue,
+	.ndo_setup_tc		= cpsw_ndo_setup_tc,
+	.ndo_set_tx_maxrate	= cpsw_ndo_set_tx_maxrate,
+	.ndo_setup_cbs		= cpsw_ndo_setup_cbs,
 	.ndo_set_mac_address	= cpsw_ndo_set_mac_address,
 	.ndo_do_ioctl		= cpsw_ndo_ioctl,
 	.ndo_validate_addr	= eth_validate_addr,
@@ -2036,10 +3089,172 @@ static const struct net_device_ops cpsw_netdev_ops = {
 	.ndo_set_rx_mode	= cpsw_ndo_set_rx_mode,
 #ifdef CONFIG_NET_POLL_CONTROLLER
 	.ndo_poll_controller	= cpsw_ndo_poll_controller,
+#endif
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	.ndo_busy_poll		= cpsw_busy_poll,
 #endif
 	.ndo_vlan_rx_add_vid	= cpsw_ndo_vlan_rx_add_vid,
 	.ndo_vlan_rx_kill_vid	= cpsw_ndo_vlan_rx_kill_vid,
+	.ndo_fdb_add		= cpsw_ndo_fdb_add,
+	.ndo_fdb_del		= cpsw_ndo_fdb_del,
+};
+
+#ifdef CONFIG_NET_SWITCHDEV
+static int cpsw_swdev_parent_id_get(struct net_device *ndev,
+				    struct netdev_phys_item_id *psid)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+	struct cpsw_priv *priv_sl0 = cpsw_get_slave_priv(priv, 0);
+
+	/* both slaves are ports of the one switch */
+	psid->id_len = ETH_ALEN;
+	memcpy(&psid->id, priv_sl0->mac_addr, psid->id_len);
+	return 0;
+}
+
+static int cpsw_swdev_port_stp_update(struct net_device *ndev, u8 state)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+	int port_state;
+
+	/* software bridging filters on its own unless the ALE switches */
+	if (!cpsw_get_slave_priv(priv, 0)->br_offload)
+		return 0;
+
+	switch (state) {
+	case BR_STATE_DISABLED:
+		port_state = ALE_PORT_STATE_DISABLE;
+		break;
+	case BR_STATE_LISTENING:
+	case BR_STATE_BLOCKING:
+		port_state = ALE_PORT_STATE_BLOCK;
+		break;
+	case BR_STATE_LEARNING:
+		port_state = ALE_PORT_STATE_LEARN;
+		break;
+	case BR_STATE_FORWARDING:
+		port_state = ALE_PORT_STATE_FORWARD;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	cpsw_set_br_port_state(priv, port_state);
+	return 0;
+}
+
+static struct cpsw_mdb_entry *cpsw_mdb_find(struct cpsw_priv *priv_sl0,
+					    const u8 *addr, u16 vid)
+{
+	struct cpsw_mdb_entry *e;
+
+	list_for_each_entry(e, &priv_sl0->mdb_list, list)
+		if (e->vid == vid && ether_addr_equal(e->addr, addr))
+			return e;
+
+	return NULL;
+}
+
+static void cpsw_mdb_put(struct cpsw_priv *priv_sl0, struct cpsw_mdb_entry *e,
+			 int slave)
+{
+	e->refs[slave]--;
+	cpsw_mdb_program(priv_sl0, e);
+	if (!e->refs[0] && !e->refs[1]) {
+		list_del(&e->list);
+		kfree(e);
+	}
+}
+
+/*
+ * A group snooped by the bridge on this slave: the ALE forwards it to the
+ * slaves that joined it, so the bridge doesn't have to.  Groups are kept
+ * by MAC address, which IPv4 and IPv6 groups may share.
+ */
+static int cpsw_swdev_port_mdb_add(struct net_device *ndev,
+				   const unsigned char *addr, u16 vid)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+	struct cpsw_priv *priv_sl0 = cpsw_get_slave_priv(priv, 0);
+	struct cpsw_mdb_entry *e;
+	unsigned long flags;
+	int ret;
+
+	if (!priv_sl0->br_offload)
+		return -EOPNOTSUPP;
+
+	if (!vid)
+		vid = priv->slaves[0].port_vlan;
+
+	spin_lock_irqsave(&priv_sl0->mdb_lock, flags);
+	e = cpsw_mdb_find(priv_sl0, addr, vid);
+	if (!e) {
+		e = kzalloc(sizeof(*e), GFP_ATOMIC);
+		if (!e) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		ether_addr_copy(e->addr, addr);
+		e->vid = vid;
+		list_add(&e->list, &priv_sl0->mdb_list);
+	}
+
+	e->refs[priv->emac_port]++;
+	ret = cpsw_mdb_program(priv_sl0, e);
+	if (ret)
+		cpsw_mdb_put(priv_sl0, e, priv->emac_port);
+out:
+	spin_unlock_irqrestore(&priv_sl0->mdb_lock, flags);
+	return ret;
+}
+
+static int cpsw_swdev_port_mdb_del(struct net_device *ndev,
+				   const unsigned char *addr, u16 vid)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+	struct cpsw_priv *priv_sl0 = cpsw_get_slave_priv(priv, 0);
+	struct cpsw_mdb_entry *e;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!vid)
+		vid = priv->slaves[0].port_vlan;
+
+	spin_lock_irqsave(&priv_sl0->mdb_lock, flags);
+	e = cpsw_mdb_find(priv_sl0, addr, vid);
+	if (e && e->refs[priv->emac_port])
+		cpsw_mdb_put(priv_sl0, e, priv->emac_port);
+	else
+		ret = -ENOENT;
+	spin_unlock_irqrestore(&priv_sl0->mdb_lock, flags);
+
+	return ret;
+}
+
+static const struct swdev_ops cpsw_swdev_ops = {
+	.swdev_parent_id_get	= cpsw_swdev_parent_id_get,
+	.swdev_port_stp_update	= cpsw_swdev_port_stp_update,
+	.swdev_port_mdb_add	= cpsw_swdev_port_mdb_add,
+	.swdev_port_mdb_del	= cpsw_swdev_port_mdb_del,
 };
+#endif /* CONFIG_NET_SWITCHDEV */
+
+static int cpsw_netdevice_event(struct notifier_block *nb,
+				unsigned long event, void *ptr)
+{
+	struct net_device *ndev = netdev_notifier_info_to_dev(ptr);
+	struct cpsw_priv *priv = container_of(nb, struct cpsw_priv, br_nb);
+
+	if (event != NETDEV_CHANGEUPPER)
+		return NOTIFY_DONE;
+
+	if (ndev != cpsw_get_slave_ndev(priv, 0) &&
+	    ndev != cpsw_get_slave_ndev(priv, 1))
+		return NOTIFY_DONE;
+
+	cpsw_br_offload_update(priv, false);
+	return NOTIFY_DONE;
+}
 
 static int cpsw_get_regs_len(struct net_device *ndev)
 {
@@ -2185,6 +3400,75 @@ static int cpsw_set_pauseparam(struct net_device *ndev,
 	return 0;
 }
 
+static void cpsw_get_ringparam(struct net_device *ndev,
+			       struct ethtool_ringparam *ering)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+	int descs = cpdma_get_num_rx_descs(priv->dma) +
+		    cpdma_get_num_tx_descs(priv->dma);
+
+	ering->rx_max_pending = descs - CPSW_MIN_RING_DESCS;
+	ering->tx_max_pending = descs - CPSW_MIN_RING_DESCS;
+	ering->rx_pending = priv->data.rx_descs;
+	ering->tx_pending = cpdma_get_num_tx_descs(priv->dma);
+}
+
+static int cpsw_set_ringparam(struct net_device *ndev,
+			      struct ethtool_ringparam *ering)
+{
+	struct cpsw_priv *priv = netdev_priv(ndev);
+	int cur_rx = cpdma_get_num_rx_descs(priv->dma);
+	int cur_tx = cpdma_get_num_tx_descs(priv->dma);
+	int descs = cur_rx + cur_tx;
+	bool running[2] = { false, false };
+	int rx, i, ret;
+
+	if (ering->rx_mini_pending || ering->rx_jumbo_pending)
+		return -EINVAL;
+
+	/* rx and tx share one descriptor pool, so only the split between
+	 * them can change: a new tx size implies the rx size and vice versa
+	 */
+	rx = ering->rx_pending;
+	if (rx == priv->data.rx_descs && ering->tx_pending != cur_tx)
+		rx = descs - ering->tx_pending;
+
+	if (rx < CPSW_MIN_RING_DESCS || rx > descs - CPSW_MIN_RING_DESCS)
+		return -EINVAL;
+
+	if (rx == cur_rx && rx == priv->data.rx_descs)
+		return 0;
+
+	/* descriptors can only be moved while both channels are idle */
+	for (i = 0; i < priv->data.slaves && i < ARRAY_SIZE(running); i++) {
+		struct net_device *sl_ndev = cpsw_get_slave_ndev(priv, i);
+
+		if (sl_ndev && netif_running(sl_ndev)) {
+			running[i] = true;
+			cpsw_ndo_stop(sl_ndev);
+		}
+	}
+
+	ret = cpdma_set_num_rx_descs(priv->dma, rx);
+	if (!ret) {
+		for (i = 0; i < priv->data.slaves; i++) {
+			struct cpsw_priv *sl_priv = cpsw_get_slave_priv(priv, i);
+
+			if (sl_priv)
+				sl_priv->data.rx_descs = rx;
+		}
+		cpsw_info(priv, drv, "rx/tx descriptors set to %d/%d\n",
+			  rx, descs - rx);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(running); i++) {
+		if (running[i])
+			cpsw_ndo_open(cpsw_get_slave_ndev(priv, i));
+	}
+
+	return ret;
+}
+
 static const struct ethtool_ops cpsw_ethtool_ops = {
 	.get_drvinfo	= cpsw_get_drvinfo,
 	.get_msglevel	= cpsw_get_msglevel,
@@ -2204,6 +3488,8 @@ static const struct ethtool_ops cpsw_ethtool_ops = {
 	.set_wol	= cpsw_set_wol,
 	.get_regs_len	= cpsw_get_regs_len,
 	.get_regs	= cpsw_get_regs,
+	.get_ringparam	= cpsw_get_ringparam,
+	.set_ringparam	= cpsw_set_ringparam,
 };
 
 static void cpsw_slave_init(struct cpsw_slave *slave, struct cpsw_priv *priv,
@@ -2278,6 +3564,9 @@ static int cpsw_probe_dt(struct cpsw_platform_data *data,
 	}
 	data->bd_ram_size = prop;
 
+	if (!of_property_read_u32(node, "descs_pool_size", &prop))
+		data->descs_pool_size = prop;
+
 	if (of_property_read_u32(node, "rx_descs", &prop)) {
 		dev_err(&pdev->dev, "Missing rx_descs property in the DT.\n");
 		return -EINVAL;
@@ -2378,7 +3667,7 @@ static int cpsw_probe_dual_emac(struct platform_device *pdev,
 	struct cpsw_priv		*priv_sl2;
 	int ret = 0, i;
 
-	ndev = alloc_etherdev(sizeof(struct cpsw_priv));
+	ndev = alloc_etherdev_mq(sizeof(struct cpsw_priv), CPSW_MAX_QUEUES);
 	if (!ndev) {
 		dev_err(&pdev->dev, "cpsw: error allocating net_device\n");
 		return -ENOMEM;
@@ -2391,7 +3680,7 @@ static int cpsw_probe_dual_emac(struct platform_device *pdev,
 	priv_sl2->ndev = ndev;
 	priv_sl2->dev  = &ndev->dev;
 	priv_sl2->msg_enable = netif_msg_init(debug_level, CPSW_DEBUG);
-	priv_sl2->rx_packet_max = max(rx_packet_max, 128);
+	priv_sl2->rx_packet_max = priv->rx_packet_max;
 
 	if (is_valid_ether_addr(data->slave_data[1].mac_addr)) {
 		memcpy(priv_sl2->mac_addr, data->slave_data[1].mac_addr,
@@ -2415,8 +3704,8 @@ static int cpsw_probe_dual_emac(struct platform_device *pdev,
 	priv_sl2->wr_regs = priv->wr_regs;
 	priv_sl2->hw_stats = priv->hw_stats;
 	priv_sl2->dma = priv->dma;
-	priv_sl2->txch = priv->txch;
-	priv_sl2->rxch = priv->rxch;
+	memcpy(priv_sl2->txch, priv->txch, sizeof(priv->txch));
+	priv_sl2->tx_ch_num = priv->tx_ch_num;
 	priv_sl2->ale = priv->ale;
 	priv_sl2->emac_port = 1;
 	priv->slaves[1].ndev = ndev;
@@ -2428,20 +3717,59 @@ static int cpsw_probe_dual_emac(struct platform_device *pdev,
 		priv_sl2->num_irqs = priv->num_irqs;
 	}
 	ndev->features |= NETIF_F_HW_VLAN_CTAG_FILTER;
+	ndev->features |= NETIF_F_HW_SWITCH_OFFLOAD;
+#ifdef CONFIG_NET_SWITCHDEV
+	ndev->swdev_ops = &cpsw_swdev_ops;
+#endif
 
 	ndev->netdev_ops = &cpsw_netdev_ops;
 	ndev->ethtool_ops = &cpsw_ethtool_ops;
+	netif_set_real_num_tx_queues(ndev, priv->tx_ch_num);
+
+	/* Give the second port an rx channel and NAPI context of its own,
+	 * so one busy port does not hold up the other.  Version 1 has no
+	 * rx channel map, there both ports share the first channel.
+	 */
+	priv_sl2->rxch = priv->rxch;
+	if (priv->version != CPSW_VERSION_1) {
+		struct cpdma_chan *rxch;
+
+		rxch = cpdma_chan_create(priv->dma, rx_chan_num(1),
+					 cpsw_rx_handler);
+		if (IS_ERR_OR_NULL(rxch) ||
+		    cpdma_chan_page_pool_create(rxch,
+				2 * (cpdma_get_num_rx_descs(priv->dma) +
+				     cpdma_get_num_tx_descs(priv->dma)))) {
+			dev_warn(&pdev->dev, "sharing rx channel between ports\n");
+			if (!IS_ERR_OR_NULL(rxch))
+				cpdma_chan_destroy(rxch);
+		} else {
+			priv_sl2->rxch = rxch;
+			priv->rx_per_slave = true;
+			priv_sl2->rx_per_slave = true;
+			netif_napi_add(ndev, &priv_sl2->napi_rx, cpsw_rx_poll,
+				       CPSW_POLL_WEIGHT);
+			cpsw_rx_poll_init(priv_sl2);
+		}
+	}
 
 	/* register the network device */
 	SET_NETDEV_DEV(ndev, &pdev->dev);
 	ret = register_netdev(ndev);
 	if (ret) {
 		dev_err(&pdev->dev, "cpsw: error registering net device\n");
+		if (priv->rx_per_slave) {
+			priv->rx_per_slave = false;
+			cpdma_chan_destroy(priv_sl2->rxch);
+		}
 		free_netdev(ndev);
-		ret = -ENODEV;
+		return -ENODEV;
 	}
 
-	return ret;
+	if (priv->rx_per_slave)
+		napi_hash_add(&priv_sl2->napi_rx);
+
+	return 0;
 }
 
 #define CPSW_QUIRK_IRQ		BIT(0)
@@ -2496,7 +3824,7 @@ static int cpsw_probe(struct platform_device *pdev)
 	int ret = 0, i;
 	int irq;
 
-	ndev = alloc_etherdev(sizeof(struct cpsw_priv));
+	ndev = alloc_etherdev_mq(sizeof(struct cpsw_priv), CPSW_MAX_QUEUES);
 	if (!ndev) {
 		dev_err(&pdev->dev, "error allocating net_device\n");
 		return -ENOMEM;
@@ -2505,11 +3833,18 @@ static int cpsw_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, ndev);
 	priv = netdev_priv(ndev);
 	spin_lock_init(&priv->lock);
+	INIT_LIST_HEAD(&priv->mdb_list);
+	spin_lock_init(&priv->mdb_lock);
 	priv->pdev = pdev;
 	priv->ndev = ndev;
 	priv->dev  = &ndev->dev;
 	priv->msg_enable = netif_msg_init(debug_level, CPSW_DEBUG);
 	priv->rx_packet_max = max(rx_packet_max, 128);
+	if (priv->rx_packet_max > CPSW_RX_BUF_MAX) {
+		dev_warn(&pdev->dev, "rx_packet_max limited to %lu bytes\n",
+			 CPSW_RX_BUF_MAX);
+		priv->rx_packet_max = CPSW_RX_BUF_MAX;
+	}
 	priv->cpts = devm_kzalloc(&pdev->dev, sizeof(struct cpts), GFP_KERNEL);
 	if (!priv->cpts) {
 		dev_err(&pdev->dev, "error allocating cpts\n");
@@ -2641,9 +3976,11 @@ static int cpsw_probe(struct platform_device *pdev)
 	dma_params.has_soft_reset	= true;
 	dma_params.min_packet_size	= CPSW_MIN_PACKET_SIZE;
 	dma_params.desc_mem_size	= data->bd_ram_size;
+	dma_params.descs_pool_size	= data->descs_pool_size;
 	dma_params.desc_align		= 16;
 	dma_params.has_ext_regs		= true;
 	dma_params.desc_hw_addr         = dma_params.desc_mem_phys;
+	dma_params.bus_freq_mhz		= priv->bus_freq_mhz;
 
 	priv->dma = cpdma_ctlr_create(&dma_params);
 	if (!priv->dma) {
@@ -2652,17 +3989,49 @@ static int cpsw_probe(struct platform_device *pdev)
 		goto clean_runtime_disable_ret;
 	}
 
-	priv->txch = cpdma_chan_create(priv->dma, tx_chan_num(0),
-				       cpsw_tx_handler);
+	priv->tx_ch_num = clamp_t(int, data->channels, 1, CPSW_MAX_QUEUES);
+	for (i = 0; i < priv->tx_ch_num; i++) {
+		priv->txch[i] = cpdma_chan_create(priv->dma, tx_chan_num(i),
+						  cpsw_tx_handler);
+		if (IS_ERR(priv->txch[i]))
+			priv->txch[i] = NULL;
+		if (!priv->txch[i])
+			break;
+	}
+	/* run with as many queues as we got channels */
+	if (i && i < priv->tx_ch_num) {
+		dev_warn(priv->dev, "using %d tx channels\n", i);
+		priv->tx_ch_num = i;
+	}
 	priv->rxch = cpdma_chan_create(priv->dma, rx_chan_num(0),
 				       cpsw_rx_handler);
 
-	if (WARN_ON(!priv->txch || !priv->rxch)) {
+	if (WARN_ON(!priv->txch[0] || !priv->rxch)) {
 		dev_err(priv->dev, "error initializing dma channels\n");
 		ret = -ENOMEM;
 		goto clean_dma_ret;
 	}
 
+	if (WARN_ON(!data->rx_descs))
+		data->rx_descs = 128;
+
+	if (data->rx_descs > cpdma_get_num_rx_descs(priv->dma)) {
+		dev_warn(priv->dev, "rx_descs limited to %d\n",
+			 cpdma_get_num_rx_descs(priv->dma));
+		data->rx_descs = cpdma_get_num_rx_descs(priv->dma);
+	}
+
+	/* Twice the largest possible ring leaves room for pages still held
+	 * by the stack, whatever the ringparam split.
+	 */
+	ret = cpdma_chan_page_pool_create(priv->rxch,
+					  2 * (cpdma_get_num_rx_descs(priv->dma) +
+					       cpdma_get_num_tx_descs(priv->dma)));
+	if (ret) {
+		dev_err(priv->dev, "error initializing rx page pool\n");
+		goto clean_dma_ret;
+	}
+
 	ale_params.dev			= &ndev->dev;
 	ale_params.ale_ageout		= ale_ageout;
 	ale_params.ale_entries		= data->ale_entries;
@@ -2725,11 +4094,19 @@ static int cpsw_probe(struct platform_device *pdev)
 	priv->num_irqs = 2;
 
 	ndev->features |= NETIF_F_HW_VLAN_CTAG_FILTER;
+	if (priv->data.dual_emac) {
+		ndev->features |= NETIF_F_HW_SWITCH_OFFLOAD;
+#ifdef CONFIG_NET_SWITCHDEV
+		ndev->swdev_ops = &cpsw_swdev_ops;
+#endif
+	}
 
 	ndev->netdev_ops = &cpsw_netdev_ops;
 	ndev->ethtool_ops = &cpsw_ethtool_ops;
+	netif_set_real_num_tx_queues(ndev, priv->tx_ch_num);
 	netif_napi_add(ndev, &priv->napi_rx, cpsw_rx_poll, CPSW_POLL_WEIGHT);
 	netif_napi_add(ndev, &priv->napi_tx, cpsw_tx_poll, CPSW_POLL_WEIGHT);
+	cpsw_rx_poll_init(priv);
 
 	/* register the network device */
 	SET_NETDEV_DEV(ndev, &pdev->dev);
@@ -2739,6 +4116,7 @@ static int cpsw_probe(struct platform_device *pdev)
 		ret = -ENODEV;
 		goto clean_ale_ret;
 	}
+	napi_hash_add(&priv->napi_rx);
 
 	cpsw_notice(priv, probe, "initialized device (regs %pa, irq %d)\n",
 		    &ss_res->start, ndev->irq);
@@ -2749,6 +4127,14 @@ static int cpsw_probe(struct platform_device *pdev)
 			cpsw_err(priv, probe, "error probe slave 2 emac interface\n");
 			goto clean_ale_ret;
 		}
+
+		priv->br_nb.notifier_call = cpsw_netdevice_event;
+		ret = register_netdevice_notifier(&priv->br_nb);
+		if (ret) {
+			cpsw_err(priv, probe, "no bridge offload (%d)\n", ret);
+			priv->br_nb.notifier_call = NULL;
+		}
+		ret = 0;
 	}
 
 	return 0;
@@ -2756,7 +4142,8 @@ static int cpsw_probe(struct platform_device *pdev)
 clean_ale_ret:
 	cpsw_ale_destroy(priv->ale);
 clean_dma_ret:
-	cpdma_chan_destroy(priv->txch);
+	for (i = 0; i < priv->tx_ch_num; i++)
+		cpdma_chan_destroy(priv->txch[i]);
 	cpdma_chan_destroy(priv->rxch);
 	cpdma_ctlr_destroy(priv->dma);
 clean_runtime_disable_ret:
@@ -2775,23 +4162,45 @@ static int cpsw_remove_child_device(struct device *dev, void *c)
 	return 0;
 }
 
+static void cpsw_rx_filter_release(struct cpsw_priv *priv)
+{
+	struct bpf_prog *prog = rcu_dereference_protected(priv->rx_filter, 1);
+
+	if (prog)
+		bpf_prog_destroy(prog);
+}
+
 static int cpsw_remove(struct platform_device *pdev)
 {
 	struct net_device *ndev = platform_get_drvdata(pdev);
 	struct cpsw_priv *priv = netdev_priv(ndev);
+	int i;
 
-	if (priv->data.dual_emac)
+	if (priv->data.dual_emac) {
+		if (priv->br_nb.notifier_call)
+			unregister_netdevice_notifier(&priv->br_nb);
+		cpsw_mdb_flush(priv);
+		if (priv->rx_per_slave)
+			napi_hash_del(&cpsw_get_slave_priv(priv, 1)->napi_rx);
 		unregister_netdev(cpsw_get_slave_ndev(priv, 1));
+		if (priv->rx_per_slave)
+			cpdma_chan_destroy(cpsw_get_slave_priv(priv, 1)->rxch);
+	}
+	napi_hash_del(&priv->napi_rx);
 	unregister_netdev(ndev);
 
 	cpsw_ale_destroy(priv->ale);
-	cpdma_chan_destroy(priv->txch);
+	for (i = 0; i < priv->tx_ch_num; i++)
+		cpdma_chan_destroy(priv->txch[i]);
 	cpdma_chan_destroy(priv->rxch);
 	cpdma_ctlr_destroy(priv->dma);
 	pm_runtime_disable(&pdev->dev);
 	device_for_each_child(&pdev->dev, NULL, cpsw_remove_child_device);
-	if (priv->data.dual_emac)
+	if (priv->data.dual_emac) {
+		cpsw_rx_filter_release(cpsw_get_slave_priv(priv, 1));
 		free_netdev(cpsw_get_slave_ndev(priv, 1));
+	}
+	cpsw_rx_filter_release(priv);
 	free_netdev(ndev);
 	return 0;
 }
@@ -301,6 +301,32 @@ int cpsw_ale_flush(struct cpsw_ale *ale, int port_mask)
 }
 EXPORT_SYMBOL_GPL(cpsw_ale_flush);
 
+/* Drop unicast entries learned on the given ports, static ones are kept */
+int cpsw_ale_flush_learned(struct cpsw_ale *ale, int port_mask)
+{
+	u32 ale_entry[ALE_ENTRY_WORDS];
+	int type, idx;
+
+	for (idx = 0; idx < ale->params.ale_entries; idx++) {
+		cpsw_ale_read(ale, idx, ale_entry);
+		type = cpsw_ale_get_entry_type(ale_entry);
+		if (type != ALE_TYPE_ADDR && type != ALE_TYPE_VLAN_ADDR)
+			continue;
+		if (cpsw_ale_get_mcast(ale_entry))
+			continue;
+		type = cpsw_ale_get_ucast_type(ale_entry);
+		if (type == ALE_UCAST_PERSISTANT || type == ALE_UCAST_OUI)
+			continue;
+		if ((BIT(cpsw_ale_get_port_num(ale_entry)) & port_mask) == 0)
+			continue;
+
+		cpsw_ale_set_entry_type(ale_entry, ALE_TYPE_FREE);
+		cpsw_ale_write(ale, idx, ale_entry);
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpsw_ale_flush_learned);
+
 static inline void cpsw_ale_set_vlan_entry_type(u32 *ale_entry,
 						int flags, u16 vid)
 {
@@ -368,7 +394,7 @@ int cpsw_ale_add_mcast(struct cpsw_ale *ale, u8 *addr, int port_mask,
 	cpsw_ale_set_vlan_entry_type(ale_entry, flags, vid);
 
 	cpsw_ale_set_addr(ale_entry, addr);
-	cpsw_ale_set_super(ale_entry, (flags & ALE_BLOCKED) ? 1 : 0);
+	cpsw_ale_set_super(ale_entry, (flags & ALE_SUPER) ? 1 : 0);
 	cpsw_ale_set_mcast_state(ale_entry, mcast_state);
 
 	mask = cpsw_ale_get_port_mask(ale_entry);
@@ -460,6 +486,60 @@ int cpsw_ale_del_vlan(struct cpsw_ale *ale, u16 vid, int port_mask)
 }
 EXPORT_SYMBOL_GPL(cpsw_ale_del_vlan);
 
+/* Add ports to a vlan entry, keeping the ports it already holds */
+int cpsw_ale_vlan_add_modify(struct cpsw_ale *ale, u16 vid, int port_mask,
+			     int untag_mask, int reg_mask, int unreg_mask)
+{
+	u32 ale_entry[ALE_ENTRY_WORDS] = {0, 0, 0};
+	int idx;
+
+	idx = cpsw_ale_match_vlan(ale, vid);
+	if (idx >= 0) {
+		cpsw_ale_read(ale, idx, ale_entry);
+		port_mask |= cpsw_ale_get_vlan_member_list(ale_entry);
+		untag_mask |= cpsw_ale_get_vlan_untag_force(ale_entry);
+		reg_mask |= cpsw_ale_get_vlan_reg_mcast(ale_entry);
+		unreg_mask |= cpsw_ale_get_vlan_unreg_mcast(ale_entry);
+	}
+
+	return cpsw_ale_add_vlan(ale, vid, port_mask, untag_mask, reg_mask,
+				 unreg_mask);
+}
+EXPORT_SYMBOL_GPL(cpsw_ale_vlan_add_modify);
+
+/*
+ * Remove ports from a vlan entry.  Returns the remaining member list, the
+ * entry is freed once no member is left.
+ */
+int cpsw_ale_vlan_del_modify(struct cpsw_ale *ale, u16 vid, int port_mask)
+{
+	u32 ale_entry[ALE_ENTRY_WORDS] = {0, 0, 0};
+	int idx, members;
+
+	idx = cpsw_ale_match_vlan(ale, vid);
+	if (idx < 0)
+		return -ENOENT;
+
+	cpsw_ale_read(ale, idx, ale_entry);
+
+	members = cpsw_ale_get_vlan_member_list(ale_entry) & ~port_mask;
+	if (members) {
+		cpsw_ale_set_vlan_member_list(ale_entry, members);
+		cpsw_ale_set_vlan_untag_force(ale_entry,
+			cpsw_ale_get_vlan_untag_force(ale_entry) & members);
+		cpsw_ale_set_vlan_reg_mcast(ale_entry,
+			cpsw_ale_get_vlan_reg_mcast(ale_entry) & members);
+		cpsw_ale_set_vlan_unreg_mcast(ale_entry,
+			cpsw_ale_get_vlan_unreg_mcast(ale_entry) & members);
+	} else {
+		cpsw_ale_set_entry_type(ale_entry, ALE_TYPE_FREE);
+	}
+
+	cpsw_ale_write(ale, idx, ale_entry);
+	return members;
+}
+EXPORT_SYMBOL_GPL(cpsw_ale_vlan_del_modify);
+
 void cpsw_ale_set_allmulti(struct cpsw_ale *ale, int allmulti)
 {
 	u32 ale_entry[ALE_ENTRY_WORDS];
@@ -0,0 +1,89 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpsw
+
+#if !defined(_CPSW_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _CPSW_TRACE_H
+
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(cpsw_napi_poll,
+
+	TP_PROTO(struct net_device *ndev, bool rx, int budget, int work),
+
+	TP_ARGS(ndev, rx, budget, work),
+
+	TP_STRUCT__entry(
+		__string(	name,	ndev->name	)
+		__field(	bool,	rx		)
+		__field(	int,	budget		)
+		__field(	int,	work		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, ndev->name);
+		__entry->rx	= rx;
+		__entry->budget	= budget;
+		__entry->work	= work;
+	),
+
+	TP_printk("dev=%s %s budget=%d work=%d", __get_str(name),
+		  __entry->rx ? "rx" : "tx", __entry->budget, __entry->work)
+);
+
+DEFINE_EVENT(cpsw_napi_poll, cpsw_napi_poll_start,
+	TP_PROTO(struct net_device *ndev, bool rx, int budget, int work),
+	TP_ARGS(ndev, rx, budget, work)
+);
+
+DEFINE_EVENT(cpsw_napi_poll, cpsw_napi_poll_end,
+	TP_PROTO(struct net_device *ndev, bool rx, int budget, int work),
+	TP_ARGS(ndev, rx, budget, work)
+);
+
+DECLARE_EVENT_CLASS(cpsw_tx_skb,
+
+	TP_PROTO(struct net_device *ndev, struct sk_buff *skb),
+
+	TP_ARGS(ndev, skb),
+
+	TP_STRUCT__entry(
+		__string(	name,	ndev->name		)
+		__field(	const void *,	skbaddr		)
+		__field(	unsigned int,	len		)
+		__field(	u16,		queue		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, ndev->name);
+		__entry->skbaddr	= skb;
+		__entry->len		= skb->len;
+		__entry->queue		= skb_get_queue_mapping(skb);
+	),
+
+	TP_printk("dev=%s skbaddr=%p len=%u queue=%u", __get_str(name),
+		  __entry->skbaddr, __entry->len, __entry->queue)
+);
+
+/* About to be handed to the dma */
+DEFINE_EVENT(cpsw_tx_skb, cpsw_xmit,
+	TP_PROTO(struct net_device *ndev, struct sk_buff *skb),
+	TP_ARGS(ndev, skb)
+);
+
+/* Sent, or torn down */
+DEFINE_EVENT(cpsw_tx_skb, cpsw_tx_complete,
+	TP_PROTO(struct net_device *ndev, struct sk_buff *skb),
+	TP_ARGS(ndev, skb)
+);
+
+#endif /* _CPSW_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE cpsw_trace
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -59,6 +59,23 @@ static int cpts_fifo_pop(struct cpts *cpts, u32 *high, u32 *low)
 	return -1;
 }
 
+static void cpts_extts_event(struct cpts *cpts, struct cpts_event *event)
+{
+	struct ptp_clock_event pevent;
+	int index;
+
+	/* Hardware push inputs are reported as ports 1..4. */
+	index = ((event->high >> PORT_NUMBER_SHIFT) & PORT_NUMBER_MASK) - 1;
+	if (index < 0 || index >= CPTS_MAX_EXTTS ||
+	    !(cpts->hw_ts_enable & (HW1_TS_PUSH_EN << index)))
+		return;
+
+	pevent.type = PTP_CLOCK_EXTTS;
+	pevent.index = index;
+	pevent.timestamp = timecounter_cyc2time(&cpts->tc, event->low);
+	ptp_clock_event(cpts->clock, &pevent);
+}
+
 /*
  * Returns zero if matching event type was found.
  */
@@ -87,9 +104,11 @@ static int cpts_fifo_read(struct cpts *cpts, int match)
 			list_del_init(&event->list);
 			list_add_tail(&event->list, &cpts->events);
 			break;
+		case CPTS_EV_HW:
+			cpts_extts_event(cpts, event);
+			break;
 		case CPTS_EV_ROLL:
 		case CPTS_EV_HALF:
-		case CPTS_EV_HW:
 			break;
 		default:
 			pr_err("cpts: unknown event type\n");
@@ -201,6 +220,34 @@ static int cpts_ptp_settime(struct ptp_clock_info *ptp,
 static int cpts_ptp_enable(struct ptp_clock_info *ptp,
 			   struct ptp_clock_request *rq, int on)
 {
+	unsigned long flags;
+	u32 bit;
+	struct cpts *cpts = container_of(ptp, struct cpts, info);
+
+	switch (rq->type) {
+	case PTP_CLK_REQ_EXTTS:
+		if (rq->extts.index >= CPTS_MAX_EXTTS)
+			return -EINVAL;
+		bit = HW1_TS_PUSH_EN << rq->extts.index;
+
+		spin_lock_irqsave(&cpts->lock, flags);
+		if (on)
+			cpts->hw_ts_enable |= bit;
+		else
+			cpts->hw_ts_enable &= ~bit;
+		cpts_write32(cpts, CPTS_EN | cpts->hw_ts_enable, control);
+		spin_unlock_irqrestore(&cpts->lock, flags);
+
+		/*
+		 * The CPTS interrupt is not wired up, hardware push events are
+		 * collected by the overflow work which polls the FIFO faster
+		 * while any input is enabled.
+		 */
+		mod_delayed_work(system_wq, &cpts->overflow_work, 0);
+		return 0;
+	default:
+		break;
+	}
 	return -EOPNOTSUPP;
 }
 
@@ -208,7 +255,7 @@ static struct ptp_clock_info cpts_info = {
 	.owner		= THIS_MODULE,
 	.name		= "CTPS timer",
 	.max_adj	= 1000000,
-	.n_ext_ts	= 0,
+	.n_ext_ts	= CPTS_MAX_EXTTS,
 	.n_pins		= 0,
 	.pps		= 0,
 	.adjfreq	= cpts_ptp_adjfreq,
@@ -222,12 +269,17 @@ static void cpts_overflow_check(struct work_struct *work)
 {
 	struct timespec64 ts;
 	struct cpts *cpts = container_of(work, struct cpts, overflow_work.work);
+	u32 hw_ts_enable = READ_ONCE(cpts->hw_ts_enable);
 
-	cpts_write32(cpts, CPTS_EN, control);
+	cpts_write32(cpts, CPTS_EN | hw_ts_enable, control);
 	cpts_write32(cpts, TS_PEND_EN, int_enable);
+	/* Reading the time also drains hardware push events from the FIFO. */
 	cpts_ptp_gettime(&cpts->info, &ts);
-	pr_debug("cpts overflow check at %lld.%09lu\n", ts.tv_sec, ts.tv_nsec);
-	schedule_delayed_work(&cpts->overflow_work, CPTS_OVERFLOW_PERIOD);
+	if (!hw_ts_enable)
+		pr_debug("cpts overflow check at %lld.%09lu\n",
+			 ts.tv_sec, ts.tv_nsec);
+	schedule_delayed_work(&cpts->overflow_work, hw_ts_enable ?
+			      CPTS_EXTTS_PERIOD : CPTS_OVERFLOW_PERIOD);
 }
 
 static void cpts_clk_init(struct device *dev, struct cpts *cpts)
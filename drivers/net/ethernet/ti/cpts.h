@@ -96,6 +96,10 @@ enum {
 
 /* This covers any input clock up to about 500 MHz. */
 #define CPTS_OVERFLOW_PERIOD (HZ * 8)
+/* FIFO poll period while hardware push inputs are enabled. */
+#define CPTS_EXTTS_PERIOD (HZ / 20)
+
+#define CPTS_MAX_EXTTS 4 /* HW1..HW4 time stamp push inputs */
 
 #define CPTS_FIFO_DEPTH 16
 #define CPTS_MAX_EVENTS 32
@@ -120,6 +124,7 @@ struct cpts {
 	struct timecounter tc;
 	struct delayed_work overflow_work;
 	int phc_index;
+	u32 hw_ts_enable; /* HWn_TS_PUSH_EN bits of the enabled inputs */
 	struct clk *refclk;
 	struct list_head events;
 	struct list_head pool;
@@ -19,11 +19,15 @@
 #include <linux/slab.h>
 #include <linux/err.h>
 #include <linux/dma-mapping.h>
+#include <linux/skbuff.h>
 #include <linux/io.h>
 #include <linux/delay.h>
 
 #include "davinci_cpdma.h"
 
+#define CREATE_TRACE_POINTS
+#include "davinci_cpdma_trace.h"
+
 /* DMA Registers */
 #define CPDMA_TXIDVER		0x00
 #define CPDMA_TXCONTROL		0x04
@@ -53,6 +57,11 @@
 #define CPDMA_DMASTATUS		0x24
 #define CPDMA_RXBUFFOFS		0x28
 #define CPDMA_EM_CONTROL	0x2c
+#define CPDMA_TX_PRI0_RATE	0x30
+
+/* Tx rate limiting */
+#define CPDMA_RLIM_CNT_MASK	0x3fff
+#define CPDMA_RLIM_IDLE_SHIFT	16
 
 /* Descriptor mode bits */
 #define CPDMA_DESC_SOP		BIT(31)
@@ -68,6 +77,10 @@
 
 #define CPDMA_TEARDOWN_VALUE	0xfffffffc
 
+/* Software descriptor flags */
+#define CPDMA_SW_POOL_BUF	BIT(31)
+#define CPDMA_SW_POOL_IDX_MASK	0xffff
+
 struct cpdma_desc {
 	/* hardware fields */
 	u32			hw_next;
@@ -78,6 +91,7 @@ struct cpdma_desc {
 	void			*sw_token;
 	u32			sw_buffer;
 	u32			sw_len;
+	u32			sw_flags;
 };
 
 struct cpdma_desc_pool {
@@ -87,6 +101,7 @@ struct cpdma_desc_pool {
 	void			*cpumap;	/* dma_alloc map */
 	int			desc_size, mem_size;
 	int			num_desc, used_desc;
+	int			num_rx_desc;
 	unsigned long		*bitmap;
 	struct device		*dev;
 	spinlock_t		lock;
@@ -121,6 +136,12 @@ struct cpdma_chan {
 	cpdma_handler_fn		handler;
 	enum dma_data_direction		dir;
 	struct cpdma_chan_stats		stats;
+	/* rx page pool, serialised by the channel's process context */
+	struct cpdma_rx_page		*rx_pages;
+	int				num_rx_pages, rx_pages_next;
+	u32				rate;	/* kbps, 0 for no limit */
+	/* head queued on an idle channel, hdp write held back */
+	bool				kick_pending;
 	/* offsets into dmaregs */
 	int	int_set, int_clear, td;
 };
@@ -145,6 +166,30 @@ struct cpdma_chan {
 				 (directed << CPDMA_TO_PORT_SHIFT));	\
 	} while (0)
 
+struct cpdma_control_info {
+	u32		reg;
+	u32		shift, mask;
+	int		access;
+#define ACCESS_RO	BIT(0)
+#define ACCESS_WO	BIT(1)
+#define ACCESS_RW	(ACCESS_RO | ACCESS_WO)
+};
+
+static struct cpdma_control_info controls[] = {
+	[CPDMA_CMD_IDLE]	  = {CPDMA_DMACONTROL,	3,  1,      ACCESS_WO},
+	[CPDMA_COPY_ERROR_FRAMES] = {CPDMA_DMACONTROL,	4,  1,      ACCESS_RW},
+	[CPDMA_RX_OFF_LEN_UPDATE] = {CPDMA_DMACONTROL,	2,  1,      ACCESS_RW},
+	[CPDMA_RX_OWNERSHIP_FLIP] = {CPDMA_DMACONTROL,	1,  1,      ACCESS_RW},
+	[CPDMA_TX_PRIO_FIXED]	  = {CPDMA_DMACONTROL,	0,  1,      ACCESS_RW},
+	[CPDMA_STAT_IDLE]	  = {CPDMA_DMASTATUS,	31, 1,      ACCESS_RO},
+	[CPDMA_STAT_TX_ERR_CODE]  = {CPDMA_DMASTATUS,	20, 0xf,    ACCESS_RW},
+	[CPDMA_STAT_TX_ERR_CHAN]  = {CPDMA_DMASTATUS,	16, 0x7,    ACCESS_RW},
+	[CPDMA_STAT_RX_ERR_CODE]  = {CPDMA_DMASTATUS,	12, 0xf,    ACCESS_RW},
+	[CPDMA_STAT_RX_ERR_CHAN]  = {CPDMA_DMASTATUS,	8,  0x7,    ACCESS_RW},
+	[CPDMA_RX_BUFFER_OFFSET]  = {CPDMA_RXBUFFOFS,	0,  0xffff, ACCESS_RW},
+	[CPDMA_TX_RLIM]		  = {CPDMA_DMACONTROL,	8,  0xff,   ACCESS_RW},
+};
+
 /*
  * Utility constructs for a cpdma descriptor pool.  Some devices (e.g. davinci
  * emac) have dedicated on-chip memory for these descriptors.  Some other
@@ -168,8 +213,9 @@ cpdma_desc_pool_create(struct device *dev, u32 phys, u32 hw_addr,
 	pool->mem_size	= size;
 	pool->desc_size	= ALIGN(sizeof(struct cpdma_desc), align);
 	pool->num_desc	= size / pool->desc_size;
+	pool->num_rx_desc = pool->num_desc / 2;
 
-	bitmap_size  = (pool->num_desc / BITS_PER_LONG) * sizeof(long);
+	bitmap_size  = BITS_TO_LONGS(pool->num_desc) * sizeof(long);
 	pool->bitmap = devm_kzalloc(dev, bitmap_size, GFP_KERNEL);
 	if (!pool->bitmap)
 		goto fail;
@@ -232,9 +278,9 @@ cpdma_desc_alloc(struct cpdma_desc_pool *pool, int num_desc, bool is_rx)
 
 	if (is_rx) {
 		desc_start = 0;
-		desc_end = pool->num_desc/2;
-	 } else {
-		desc_start = pool->num_desc/2;
+		desc_end = pool->num_rx_desc;
+	} else {
+		desc_start = pool->num_rx_desc;
 		desc_end = pool->num_desc;
 	}
 
@@ -263,9 +309,59 @@ static void cpdma_desc_free(struct cpdma_desc_pool *pool,
 	spin_unlock_irqrestore(&pool->lock, flags);
 }
 
+static u32 cpdma_tx_rlim_mask(struct cpdma_ctlr *ctlr)
+{
+	u32 rlim = 0;
+	int i;
+
+	for (i = 0; i < ctlr->num_chan; i++) {
+		struct cpdma_chan *chan = ctlr->channels[tx_chan_num(i)];
+
+		if (chan && chan->rate)
+			rlim |= BIT(i);
+	}
+	return rlim;
+}
+
+/*
+ * Program the tx rate limiters.  A limited channel sends for send_cnt out
+ * of every (send_cnt + idle_cnt) bus clocks, 32 bits per clock.  Called with
+ * ctlr->lock held.
+ */
+static void cpdma_ctlr_apply_rates(struct cpdma_ctlr *ctlr)
+{
+	struct cpdma_control_info *info = &controls[CPDMA_TX_RLIM];
+	u64 freq = (u64)ctlr->params.bus_freq_mhz * 1000 * 32;
+	u32 val;
+	int i;
+
+	if (!ctlr->params.has_ext_regs)
+		return;
+
+	for (i = 0; i < ctlr->num_chan; i++) {
+		struct cpdma_chan *chan = ctlr->channels[tx_chan_num(i)];
+		u32 send = 0, idle = 0;
+
+		if (chan && chan->rate && freq) {
+			send = DIV_ROUND_UP_ULL((u64)chan->rate *
+						CPDMA_RLIM_CNT_MASK, freq);
+			send = clamp_t(u32, send, 1, CPDMA_RLIM_CNT_MASK);
+			idle = CPDMA_RLIM_CNT_MASK - send;
+		}
+		dma_reg_write(ctlr, CPDMA_TX_PRI0_RATE + 4 * i,
+			      (idle << CPDMA_RLIM_IDLE_SHIFT) | send);
+	}
+
+	val  = dma_reg_read(ctlr, info->reg);
+	val &= ~(info->mask << info->shift);
+	val |= (cpdma_tx_rlim_mask(ctlr) & info->mask) << info->shift;
+	dma_reg_write(ctlr, info->reg, val);
+}
+
 struct cpdma_ctlr *cpdma_ctlr_create(struct cpdma_params *params)
 {
 	struct cpdma_ctlr *ctlr;
+	int desc_size;
 
 	ctlr = devm_kzalloc(params->dev, sizeof(*ctlr), GFP_KERNEL);
 	if (!ctlr)
@@ -276,6 +372,19 @@ struct cpdma_ctlr *cpdma_ctlr_create(struct cpdma_params *params)
 	ctlr->dev = params->dev;
 	spin_lock_init(&ctlr->lock);
 
+	/* fall back to DDR when the on-chip memory is too small */
+	desc_size = ALIGN(sizeof(struct cpdma_desc), ctlr->params.desc_align);
+	if (ctlr->params.descs_pool_size &&
+	    ctlr->params.descs_pool_size * desc_size >
+	    ctlr->params.desc_mem_size) {
+		dev_info(ctlr->dev, "placing %d descriptors in DDR\n",
+			 ctlr->params.descs_pool_size);
+		ctlr->params.desc_mem_phys = 0;
+		ctlr->params.desc_hw_addr = 0;
+		ctlr->params.desc_mem_size =
+			ctlr->params.descs_pool_size * desc_size;
+	}
+
 	ctlr->pool = cpdma_desc_pool_create(ctlr->dev,
 					    ctlr->params.desc_mem_phys,
 					    ctlr->params.desc_hw_addr,
@@ -324,6 +433,8 @@ int cpdma_ctlr_start(struct cpdma_ctlr *ctlr)
 	dma_reg_write(ctlr, CPDMA_RXINTMASKCLEAR, 0xffffffff);
 	dma_reg_write(ctlr, CPDMA_TXINTMASKCLEAR, 0xffffffff);
 
+	cpdma_ctlr_apply_rates(ctlr);
+
 	dma_reg_write(ctlr, CPDMA_TXCONTROL, 1);
 	dma_reg_write(ctlr, CPDMA_RXCONTROL, 1);
 
@@ -555,6 +666,7 @@ int cpdma_chan_destroy(struct cpdma_chan *chan)
 	spin_lock_irqsave(&ctlr->lock, flags);
 	if (chan->state != CPDMA_STATE_IDLE)
 		cpdma_chan_stop(chan);
+	cpdma_chan_page_pool_flush(chan);
 	ctlr->channels[chan->chan_num] = NULL;
 	spin_unlock_irqrestore(&ctlr->lock, flags);
 	return 0;
@@ -617,13 +729,30 @@ int cpdma_chan_dump(struct cpdma_chan *chan)
 		 chan->stats.requeue);
 	dev_info(dev, "\tstats teardown_dequeue: %d\n",
 		 chan->stats.teardown_dequeue);
+	dev_info(dev, "\tstats rx_pool_hit: %d\n",
+		 chan->stats.rx_pool_hit);
+	dev_info(dev, "\tstats rx_pool_miss: %d\n",
+		 chan->stats.rx_pool_miss);
+	dev_info(dev, "\tstats desc_exhausted: %d\n",
+		 chan->stats.desc_exhausted);
 
 	spin_unlock_irqrestore(&chan->lock, flags);
 	return 0;
 }
 
+static void __cpdma_chan_kick(struct cpdma_chan *chan)
+{
+	struct cpdma_desc_pool	*pool = chan->ctlr->pool;
+
+	if (!chan->kick_pending || chan->state != CPDMA_STATE_ACTIVE)
+		return;
+
+	chan_write(chan, hdp, desc_phys(pool, chan->head));
+	chan->kick_pending = false;
+}
+
 static void __cpdma_chan_submit(struct cpdma_chan *chan,
-				struct cpdma_desc __iomem *desc)
+				struct cpdma_desc __iomem *desc, bool more)
 {
 	struct cpdma_ctlr		*ctlr = chan->ctlr;
 	struct cpdma_desc __iomem	*prev = chan->tail;
@@ -638,8 +767,9 @@ static void __cpdma_chan_submit(struct cpdma_chan *chan,
 		chan->stats.head_enqueue++;
 		chan->head = desc;
 		chan->tail = desc;
-		if (chan->state == CPDMA_STATE_ACTIVE)
-			chan_write(chan, hdp, desc_dma);
+		chan->kick_pending = true;
+		if (!more)
+			__cpdma_chan_kick(chan);
 		return;
 	}
 
@@ -648,6 +778,13 @@ static void __cpdma_chan_submit(struct cpdma_chan *chan,
 	chan->tail = desc;
 	chan->stats.tail_enqueue++;
 
+	/* hardware has not been started on this list yet */
+	if (chan->kick_pending) {
+		if (!more)
+			__cpdma_chan_kick(chan);
+		return;
+	}
+
 	/* next check if EOQ has been triggered already */
 	mode = desc_read(prev, hw_mode);
 	if (((mode & (CPDMA_DESC_EOQ | CPDMA_DESC_OWNER)) == CPDMA_DESC_EOQ) &&
@@ -658,14 +795,41 @@ static void __cpdma_chan_submit(struct cpdma_chan *chan,
 	}
 }
 
-int cpdma_chan_submit(struct cpdma_chan *chan, void *token, void *data,
-		      int len, int directed)
+static void __cpdma_chan_queue(struct cpdma_chan *chan,
+			       struct cpdma_desc __iomem *desc, void *token,
+			       dma_addr_t buffer, int len, int directed,
+			       u32 sw_flags, bool more)
+{
+	u32 mode;
+
+	mode = CPDMA_DESC_OWNER | CPDMA_DESC_SOP | CPDMA_DESC_EOP;
+	cpdma_desc_to_port(chan, mode, directed);
+
+	desc_write(desc, hw_next,   0);
+	desc_write(desc, hw_buffer, buffer);
+	desc_write(desc, hw_len,    len);
+	desc_write(desc, hw_mode,   mode | len);
+	desc_write(desc, sw_token,  token);
+	desc_write(desc, sw_buffer, buffer);
+	desc_write(desc, sw_len,    len);
+	desc_write(desc, sw_flags,  sw_flags);
+
+	__cpdma_chan_submit(chan, desc, more);
+
+	if (chan->state == CPDMA_STATE_ACTIVE && chan->rxfree)
+		chan_write(chan, rxfree, 1);
+
+	chan->count++;
+}
+
+static int __cpdma_chan_submit_buf(struct cpdma_chan *chan, void *token,
+				   void *data, int len, int directed,
+				   bool more)
 {
 	struct cpdma_ctlr		*ctlr = chan->ctlr;
 	struct cpdma_desc __iomem	*desc;
 	dma_addr_t			buffer;
 	unsigned long			flags;
-	u32				mode;
 	int				ret = 0;
 
 	spin_lock_irqsave(&chan->lock, flags);
@@ -695,29 +859,204 @@ int cpdma_chan_submit(struct cpdma_chan *chan, void *token, void *data,
 		goto unlock_ret;
 	}
 
-	mode = CPDMA_DESC_OWNER | CPDMA_DESC_SOP | CPDMA_DESC_EOP;
-	cpdma_desc_to_port(chan, mode, directed);
+	__cpdma_chan_queue(chan, desc, token, buffer, len, directed, 0, more);
 
-	desc_write(desc, hw_next,   0);
-	desc_write(desc, hw_buffer, buffer);
-	desc_write(desc, hw_len,    len);
-	desc_write(desc, hw_mode,   mode | len);
-	desc_write(desc, sw_token,  token);
-	desc_write(desc, sw_buffer, buffer);
-	desc_write(desc, sw_len,    len);
+unlock_ret:
+	spin_unlock_irqrestore(&chan->lock, flags);
+	return ret;
+}
 
-	__cpdma_chan_submit(chan, desc);
+int cpdma_chan_submit(struct cpdma_chan *chan, void *token, void *data,
+		      int len, int directed)
+{
+	return __cpdma_chan_submit_buf(chan, token, data, len, directed, false);
+}
+EXPORT_SYMBOL_GPL(cpdma_chan_submit);
 
-	if (chan->state == CPDMA_STATE_ACTIVE && chan->rxfree)
-		chan_write(chan, rxfree, 1);
+/*
+ * Queue a buffer without starting an idle channel, more submissions are
+ * expected shortly.  The batch is handed to hardware by the next
+ * cpdma_chan_submit() or by cpdma_chan_kick().
+ */
+int cpdma_chan_submit_more(struct cpdma_chan *chan, void *token, void *data,
+			   int len, int directed)
+{
+	return __cpdma_chan_submit_buf(chan, token, data, len, directed, true);
+}
+EXPORT_SYMBOL_GPL(cpdma_chan_submit_more);
 
-	chan->count++;
+void cpdma_chan_kick(struct cpdma_chan *chan)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&chan->lock, flags);
+	__cpdma_chan_kick(chan);
+	spin_unlock_irqrestore(&chan->lock, flags);
+}
+EXPORT_SYMBOL_GPL(cpdma_chan_kick);
+
+static void cpdma_rx_page_release(struct cpdma_chan *chan,
+				  struct cpdma_rx_page *slot)
+{
+	struct device *dev = chan->ctlr->dev;
+	DEFINE_DMA_ATTRS(attrs);
+
+	if (!slot->page)
+		return;
+
+	/* the stack may still own a reference and have dirtied the page,
+	 * so only sync on unmap when we are the last user
+	 */
+	if (page_count(slot->page) != 1)
+		dma_set_attr(DMA_ATTR_SKIP_CPU_SYNC, &attrs);
+
+	dma_unmap_single_attrs(dev, slot->dma, PAGE_SIZE, chan->dir, &attrs);
+	put_page(slot->page);
+	slot->page = NULL;
+}
+
+int cpdma_chan_page_pool_create(struct cpdma_chan *chan, int num_pages)
+{
+	struct cpdma_ctlr *ctlr = chan->ctlr;
+
+	if (!is_rx_chan(chan) || chan->rx_pages ||
+	    num_pages <= 0 || num_pages > CPDMA_SW_POOL_IDX_MASK)
+		return -EINVAL;
+
+	chan->rx_pages = devm_kcalloc(ctlr->dev, num_pages, sizeof(*chan->rx_pages),
+				  GFP_KERNEL);
+	if (!chan->rx_pages)
+		return -ENOMEM;
+
+	chan->num_rx_pages = num_pages;
+	chan->rx_pages_next = 0;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpdma_chan_page_pool_create);
+
+void cpdma_chan_page_pool_flush(struct cpdma_chan *chan)
+{
+	int i;
+
+	if (!chan || !chan->rx_pages)
+		return;
+
+	for (i = 0; i < chan->num_rx_pages; i++) {
+		if (WARN_ON(chan->rx_pages[i].busy))
+			continue;
+		cpdma_rx_page_release(chan, &chan->rx_pages[i]);
+	}
+	chan->rx_pages_next = 0;
+}
+EXPORT_SYMBOL_GPL(cpdma_chan_page_pool_flush);
+
+/*
+ * Find a pool page that is neither queued to hardware nor still referenced
+ * by the network stack.  If there is none, replace the first idle slot with
+ * a freshly mapped page.
+ */
+static struct cpdma_rx_page *cpdma_rx_page_get(struct cpdma_chan *chan,
+					       gfp_t gfp)
+{
+	struct device		*dev = chan->ctlr->dev;
+	struct cpdma_rx_page	*slot, *empty = NULL, *held = NULL;
+	struct page		*page;
+	dma_addr_t		dma;
+	int			i, idx;
+
+	for (i = 0; i < chan->num_rx_pages; i++) {
+		idx = (chan->rx_pages_next + i) % chan->num_rx_pages;
+		slot = &chan->rx_pages[idx];
+
+		if (slot->busy)
+			continue;
+
+		if (!slot->page) {
+			if (!empty)
+				empty = slot;
+			continue;
+		}
+
+		if (page_count(slot->page) == 1) {
+			chan->rx_pages_next = (idx + 1) % chan->num_rx_pages;
+			chan->stats.rx_pool_hit++;
+			return slot;
+		}
+
+		if (!held)
+			held = slot;
+	}
+
+	chan->stats.rx_pool_miss++;
+
+	slot = empty ? empty : held;
+	if (!slot)
+		return NULL;
+
+	page = __dev_alloc_page(gfp);
+	if (!page)
+		return NULL;
+
+	dma = dma_map_single(dev, page_address(page), PAGE_SIZE, chan->dir);
+	if (dma_mapping_error(dev, dma)) {
+		put_page(page);
+		return NULL;
+	}
+
+	cpdma_rx_page_release(chan, slot);
+	slot->page = page;
+	slot->dma = dma;
+	chan->rx_pages_next = (slot - chan->rx_pages + 1) % chan->num_rx_pages;
+	return slot;
+}
+
+int cpdma_chan_submit_page(struct cpdma_chan *chan, void *token, int offset,
+			   int len, gfp_t gfp)
+{
+	struct cpdma_ctlr		*ctlr = chan->ctlr;
+	struct cpdma_desc __iomem	*desc;
+	struct cpdma_rx_page		*slot;
+	dma_addr_t			buffer;
+	unsigned long			flags;
+	int				ret = 0;
+
+	if (!chan->rx_pages || offset + len > PAGE_SIZE)
+		return -EINVAL;
+
+	if (chan->state == CPDMA_STATE_TEARDOWN)
+		return -EINVAL;
+
+	slot = cpdma_rx_page_get(chan, gfp);
+	if (!slot)
+		return -ENOMEM;
+
+	buffer = slot->dma + offset;
+	dma_sync_single_for_device(ctlr->dev, buffer, len, chan->dir);
+
+	spin_lock_irqsave(&chan->lock, flags);
+
+	if (chan->state == CPDMA_STATE_TEARDOWN) {
+		ret = -EINVAL;
+		goto unlock_ret;
+	}
+
+	desc = cpdma_desc_alloc(ctlr->pool, 1, true);
+	if (!desc) {
+		chan->stats.desc_alloc_fail++;
+		ret = -ENOMEM;
+		goto unlock_ret;
+	}
+
+	slot->token = token;
+	slot->busy = true;
+	__cpdma_chan_queue(chan, desc, slot, buffer, len, 0,
+			   CPDMA_SW_POOL_BUF | (slot - chan->rx_pages), false);
 
 unlock_ret:
 	spin_unlock_irqrestore(&chan->lock, flags);
 	return ret;
 }
-EXPORT_SYMBOL_GPL(cpdma_chan_submit);
+EXPORT_SYMBOL_GPL(cpdma_chan_submit_page);
 
 bool cpdma_check_free_tx_desc(struct cpdma_chan *chan)
 {
@@ -730,18 +1069,57 @@ bool cpdma_check_free_tx_desc(struct cpdma_chan *chan)
 	spin_lock_irqsave(&pool->lock, flags);
 
 	index = bitmap_find_next_zero_area(pool->bitmap,
-				pool->num_desc, pool->num_desc/2, 1, 0);
+				pool->num_desc, pool->num_rx_desc, 1, 0);
 
-	if (index < pool->num_desc)
+	if (index < pool->num_desc) {
 		ret = true;
-	else
+	} else {
 		ret = false;
+		chan->stats.desc_exhausted++;
+	}
 
 	spin_unlock_irqrestore(&pool->lock, flags);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(cpdma_check_free_tx_desc);
 
+int cpdma_get_num_rx_descs(struct cpdma_ctlr *ctlr)
+{
+	return ctlr->pool->num_rx_desc;
+}
+EXPORT_SYMBOL_GPL(cpdma_get_num_rx_descs);
+
+int cpdma_get_num_tx_descs(struct cpdma_ctlr *ctlr)
+{
+	return ctlr->pool->num_desc - ctlr->pool->num_rx_desc;
+}
+EXPORT_SYMBOL_GPL(cpdma_get_num_tx_descs);
+
+/*
+ * Move the boundary between the rx and tx halves of the descriptor pool.
+ * Only allowed while no descriptor is in use, i.e. with the controller
+ * stopped.
+ */
+int cpdma_set_num_rx_descs(struct cpdma_ctlr *ctlr, int num_rx_desc)
+{
+	struct cpdma_desc_pool	*pool = ctlr->pool;
+	unsigned long		flags;
+	int			ret = 0;
+
+	if (num_rx_desc <= 0 || num_rx_desc >= pool->num_desc)
+		return -EINVAL;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (pool->used_desc)
+		ret = -EBUSY;
+	else
+		pool->num_rx_desc = num_rx_desc;
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(cpdma_set_num_rx_descs);
+
 static void __cpdma_chan_free(struct cpdma_chan *chan,
 			      struct cpdma_desc __iomem *desc,
 			      int outlen, int status)
@@ -750,13 +1128,40 @@ static void __cpdma_chan_free(struct cpdma_chan *chan,
 	struct cpdma_desc_pool		*pool = ctlr->pool;
 	dma_addr_t			buff_dma;
 	int				origlen;
+	u32				sw_flags;
 	void				*token;
 
 	token      = (void *)desc_read(desc, sw_token);
 	buff_dma   = desc_read(desc, sw_buffer);
 	origlen    = desc_read(desc, sw_len);
-
-	dma_unmap_single(ctlr->dev, buff_dma, origlen, chan->dir);
+	sw_flags   = desc_read(desc, sw_flags);
+
+	/*
+	 * On receive, the CPU only gets to look at what the hardware wrote,
+	 * so only that needs to be invalidated, not the whole buffer.
+	 */
+	if (sw_flags & CPDMA_SW_POOL_BUF) {
+		struct cpdma_rx_page *slot;
+
+		slot = &chan->rx_pages[sw_flags & CPDMA_SW_POOL_IDX_MASK];
+		if (outlen > 0)
+			dma_sync_single_for_cpu(ctlr->dev, buff_dma,
+						min(outlen, origlen),
+						chan->dir);
+		slot->busy = false;
+	} else if (is_rx_chan(chan)) {
+		DEFINE_DMA_ATTRS(attrs);
+
+		if (outlen > 0)
+			dma_sync_single_for_cpu(ctlr->dev, buff_dma,
+						min(outlen, origlen),
+						chan->dir);
+		dma_set_attr(DMA_ATTR_SKIP_CPU_SYNC, &attrs);
+		dma_unmap_single_attrs(ctlr->dev, buff_dma, origlen,
+				       chan->dir, &attrs);
+	} else {
+		dma_unmap_single(ctlr->dev, buff_dma, origlen, chan->dir);
+	}
 	cpdma_desc_free(pool, desc, 1);
 	(*chan->handler)(token, outlen, status);
 }
@@ -811,6 +1216,9 @@ static int __cpdma_chan_process(struct cpdma_chan *chan)
 	else
 		cb_status = status;
 
+	trace_cpdma_desc_complete(chan->chan_num, is_rx_chan(chan), desc_dma,
+				  outlen, cb_status);
+
 	__cpdma_chan_free(chan, desc, outlen, cb_status);
 	return status;
 
@@ -836,6 +1244,54 @@ int cpdma_chan_process(struct cpdma_chan *chan, int quota)
 }
 EXPORT_SYMBOL_GPL(cpdma_chan_process);
 
+/*
+ * Limit a tx channel to @rate_kbps, 0 removes the limit.  In fixed priority
+ * mode the hardware only supports limiting the highest priority channels,
+ * so the limited set must be contiguous down from channel 7.
+ */
+int cpdma_chan_set_rate(struct cpdma_chan *chan, u32 rate_kbps)
+{
+	struct cpdma_ctlr	*ctlr = chan->ctlr;
+	unsigned long		flags;
+	u32			old, unlimited;
+	int			ret = 0;
+
+	if (is_rx_chan(chan))
+		return -EINVAL;
+
+	if (!ctlr->params.has_ext_regs)
+		return -ENOTSUPP;
+
+	if (rate_kbps && !ctlr->params.bus_freq_mhz)
+		return -EINVAL;
+
+	spin_lock_irqsave(&ctlr->lock, flags);
+
+	old = chan->rate;
+	chan->rate = rate_kbps;
+
+	unlimited = ~cpdma_tx_rlim_mask(ctlr) & controls[CPDMA_TX_RLIM].mask;
+	if ((unlimited + 1) & unlimited) {
+		chan->rate = old;
+		ret = -EINVAL;
+		goto unlock_ret;
+	}
+
+	if (ctlr->state == CPDMA_STATE_ACTIVE)
+		cpdma_ctlr_apply_rates(ctlr);
+
+unlock_ret:
+	spin_unlock_irqrestore(&ctlr->lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(cpdma_chan_set_rate);
+
+u32 cpdma_chan_get_rate(struct cpdma_chan *chan)
+{
+	return chan->rate;
+}
+EXPORT_SYMBOL_GPL(cpdma_chan_get_rate);
+
 int cpdma_chan_start(struct cpdma_chan *chan)
 {
 	struct cpdma_ctlr	*ctlr = chan->ctlr;
@@ -853,6 +1309,7 @@ int cpdma_chan_start(struct cpdma_chan *chan)
 	}
 	dma_reg_write(ctlr, chan->int_set, chan->mask);
 	chan->state = CPDMA_STATE_ACTIVE;
+	chan->kick_pending = false;
 	if (chan->head) {
 		chan_write(chan, hdp, desc_phys(pool, chan->head));
 		if (chan->rxfree)
@@ -922,6 +1379,7 @@ int cpdma_chan_stop(struct cpdma_chan *chan)
 	}
 
 	chan->state = CPDMA_STATE_IDLE;
+	chan->kick_pending = false;
 	spin_unlock_irqrestore(&chan->lock, flags);
 	return 0;
 }
@@ -944,29 +1402,6 @@ int cpdma_chan_int_ctrl(struct cpdma_chan *chan, bool enable)
 	return 0;
 }
 
-struct cpdma_control_info {
-	u32		reg;
-	u32		shift, mask;
-	int		access;
-#define ACCESS_RO	BIT(0)
-#define ACCESS_WO	BIT(1)
-#define ACCESS_RW	(ACCESS_RO | ACCESS_WO)
-};
-
-static struct cpdma_control_info controls[] = {
-	[CPDMA_CMD_IDLE]	  = {CPDMA_DMACONTROL,	3,  1,      ACCESS_WO},
-	[CPDMA_COPY_ERROR_FRAMES] = {CPDMA_DMACONTROL,	4,  1,      ACCESS_RW},
-	[CPDMA_RX_OFF_LEN_UPDATE] = {CPDMA_DMACONTROL,	2,  1,      ACCESS_RW},
-	[CPDMA_RX_OWNERSHIP_FLIP] = {CPDMA_DMACONTROL,	1,  1,      ACCESS_RW},
-	[CPDMA_TX_PRIO_FIXED]	  = {CPDMA_DMACONTROL,	0,  1,      ACCESS_RW},
-	[CPDMA_STAT_IDLE]	  = {CPDMA_DMASTATUS,	31, 1,      ACCESS_RO},
-	[CPDMA_STAT_TX_ERR_CODE]  = {CPDMA_DMASTATUS,	20, 0xf,    ACCESS_RW},
-	[CPDMA_STAT_TX_ERR_CHAN]  = {CPDMA_DMASTATUS,	16, 0x7,    ACCESS_RW},
-	[CPDMA_STAT_RX_ERR_CODE]  = {CPDMA_DMASTATUS,	12, 0xf,    ACCESS_RW},
-	[CPDMA_STAT_RX_ERR_CHAN]  = {CPDMA_DMASTATUS,	8,  0x7,    ACCESS_RW},
-	[CPDMA_RX_BUFFER_OFFSET]  = {CPDMA_RXBUFFOFS,	0,  0xffff, ACCESS_RW},
-};
-
 int cpdma_control_get(struct cpdma_ctlr *ctlr, int control)
 {
 	unsigned long flags;
@@ -43,6 +43,13 @@ struct cpdma_params {
 	u32			desc_hw_addr;
 	int			desc_mem_size;
 	int			desc_align;
+	/*
+	 * Number of descriptors wanted in the pool, if they do not fit in
+	 * the on-chip descriptor memory the pool is placed in DDR instead.
+	 * Zero sizes the pool from desc_mem_size.
+	 */
+	int			descs_pool_size;
+	u32			bus_freq_mhz;	/* for tx rate limiting */
 
 	/*
 	 * Some instances of embedded cpdma controllers have extra control and
@@ -66,6 +73,21 @@ struct cpdma_chan_stats {
 	u32			good_dequeue;
 	u32			requeue;
 	u32			teardown_dequeue;
+	u32			rx_pool_hit;
+	u32			rx_pool_miss;
+	u32			desc_exhausted;
+};
+
+/*
+ * Receive buffer recycled through a channel page pool.  Buffers submitted
+ * with cpdma_chan_submit_page() complete with a pointer to their pool slot as
+ * the handler token, the caller's own token is available in @token.
+ */
+struct cpdma_rx_page {
+	struct page		*page;
+	dma_addr_t		dma;
+	void			*token;
+	bool			busy;
 };
 
 struct cpdma_ctlr;
@@ -90,12 +112,25 @@ int cpdma_chan_get_stats(struct cpdma_chan *chan,
 			 struct cpdma_chan_stats *stats);
 int cpdma_chan_submit(struct cpdma_chan *chan, void *token, void *data,
 		      int len, int directed);
+int cpdma_chan_submit_more(struct cpdma_chan *chan, void *token, void *data,
+			   int len, int directed);
+void cpdma_chan_kick(struct cpdma_chan *chan);
 int cpdma_chan_process(struct cpdma_chan *chan, int quota);
 
+int cpdma_chan_page_pool_create(struct cpdma_chan *chan, int num_pages);
+void cpdma_chan_page_pool_flush(struct cpdma_chan *chan);
+int cpdma_chan_submit_page(struct cpdma_chan *chan, void *token, int offset,
+			   int len, gfp_t gfp);
+
 int cpdma_ctlr_int_ctrl(struct cpdma_ctlr *ctlr, bool enable);
 void cpdma_ctlr_eoi(struct cpdma_ctlr *ctlr, u32 value);
 int cpdma_chan_int_ctrl(struct cpdma_chan *chan, bool enable);
 bool cpdma_check_free_tx_desc(struct cpdma_chan *chan);
+int cpdma_get_num_rx_descs(struct cpdma_ctlr *ctlr);
+int cpdma_get_num_tx_descs(struct cpdma_ctlr *ctlr);
+int cpdma_set_num_rx_descs(struct cpdma_ctlr *ctlr, int num_rx_desc);
+int cpdma_chan_set_rate(struct cpdma_chan *chan, u32 rate_kbps);
+u32 cpdma_chan_get_rate(struct cpdma_chan *chan);
 
 enum cpdma_control {
 	CPDMA_CMD_IDLE,			/* write-only */
@@ -109,6 +144,7 @@ enum cpdma_control {
 	CPDMA_STAT_RX_ERR_CHAN,		/* read-only */
 	CPDMA_STAT_RX_ERR_CODE,		/* read-only */
 	CPDMA_RX_BUFFER_OFFSET,		/* read-write */
+	CPDMA_TX_RLIM,			/* read-write */
 };
 
 int cpdma_control_get(struct cpdma_ctlr *ctlr, int control);
@@ -0,0 +1,45 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpdma
+
+#if !defined(_DAVINCI_CPDMA_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _DAVINCI_CPDMA_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/* A descriptor handed back by the hardware, before its handler runs */
+TRACE_EVENT(cpdma_desc_complete,
+
+	TP_PROTO(int chan, bool rx, u32 desc, int len, int status),
+
+	TP_ARGS(chan, rx, desc, len, status),
+
+	TP_STRUCT__entry(
+		__field(	int,	chan	)
+		__field(	bool,	rx	)
+		__field(	u32,	desc	)
+		__field(	int,	len	)
+		__field(	int,	status	)
+	),
+
+	TP_fast_assign(
+		__entry->chan	= chan;
+		__entry->rx	= rx;
+		__entry->desc	= desc;
+		__entry->len	= len;
+		__entry->status	= status;
+	),
+
+	TP_printk("%s chan=%d desc=0x%08x len=%d status=0x%x",
+		  __entry->rx ? "rx" : "tx", __entry->chan, __entry->desc,
+		  __entry->len, __entry->status)
+);
+
+#endif /* _DAVINCI_CPDMA_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE davinci_cpdma_trace
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
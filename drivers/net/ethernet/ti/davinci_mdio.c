@@ -28,6 +28,9 @@
 #include <linux/kernel.h>
 #include <linux/platform_device.h>
 #include <linux/delay.h>
+#include <linux/interrupt.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/phy.h>
@@ -53,6 +56,9 @@
 
 #define DEF_OUT_FREQ		2200000		/* 2.2 MHz */
 
+/* USERPHYSEL0/1, each can raise LINKINT for one phy */
+#define MDIO_LINK_MONITORS	2
+
 struct davinci_mdio_regs {
 	u32	version;
 	u32	control;
@@ -66,6 +72,8 @@ struct davinci_mdio_regs {
 	u32	linkintmasked;
 	u32	__reserved_0[2];
 	u32	userintraw;
+#define USERINT_ACCESS0		BIT(0)
+
 	u32	userintmasked;
 	u32	userintmaskset;
 	u32	userintmaskclr;
@@ -80,6 +88,8 @@ struct davinci_mdio_regs {
 #define USERACCESS_DATA		(0xffff)
 
 		u32	physel;
+#define USERPHYSEL_LINKINTENB	BIT(6)
+#define USERPHYSEL_PHYADDR	(0x1f)
 	}	user[0];
 };
 
@@ -90,7 +100,7 @@ static const struct mdio_platform_data default_pdata = {
 struct davinci_mdio_data {
 	struct mdio_platform_data pdata;
 	struct davinci_mdio_regs __iomem *regs;
-	spinlock_t	lock;
+	struct mutex	lock;
 	struct clk	*clk;
 	struct device	*dev;
 	struct mii_bus	*bus;
@@ -100,12 +110,36 @@ struct davinci_mdio_data {
 	 * if MDIO bus is registered from DT.
 	 */
 	bool		skip_scan;
+
+	/* access completion, only when the USERINT line is wired up */
+	int		userint_irq;
+	struct completion access_done;
+
+	/* phys whose link changes raise LINKINT, -1 if unused */
+	int		linkint_irq;
+	int		link_phy[MDIO_LINK_MONITORS];
 };
 
 #if IS_ENABLED(CONFIG_OF)
 static void davinci_mdio_update_dt_from_phymask(u32 phy_mask);
 #endif
 
+static void __davinci_mdio_enable_int(struct davinci_mdio_data *data)
+{
+	int i;
+
+	if (data->userint_irq > 0)
+		__raw_writel(USERINT_ACCESS0, &data->regs->userintmaskset);
+
+	for (i = 0; i < MDIO_LINK_MONITORS; i++) {
+		if (data->link_phy[i] < 0)
+			continue;
+		__raw_writel(USERPHYSEL_LINKINTENB |
+			     (data->link_phy[i] & USERPHYSEL_PHYADDR),
+			     &data->regs->user[i].physel);
+	}
+}
+
 static void __davinci_mdio_reset(struct davinci_mdio_data *data)
 {
 	u32 mdio_in, div, mdio_out_khz, access_time;
@@ -136,6 +170,8 @@ static void __davinci_mdio_reset(struct davinci_mdio_data *data)
 	data->access_time = usecs_to_jiffies(access_time * 4);
 	if (!data->access_time)
 		data->access_time = 1;
+
+	__davinci_mdio_enable_int(data);
 }
 
 static int davinci_mdio_reset(struct mii_bus *bus)
@@ -212,6 +248,64 @@ static inline int wait_for_user_access(struct davinci_mdio_data *data)
 	return -ETIMEDOUT;
 }
 
+/*
+ * wait for the access just started to complete, sleeping until USERINT
+ * instead of spinning when we have it
+ */
+static int wait_for_user_access_done(struct davinci_mdio_data *data)
+{
+	/*
+	 * A missing interrupt means the controller was reset under us,
+	 * the polled wait finds that out and asks for a retry.
+	 */
+	if (data->userint_irq > 0)
+		wait_for_completion_timeout(&data->access_done,
+					    msecs_to_jiffies(MDIO_TIMEOUT));
+
+	return wait_for_user_access(data);
+}
+
+static irqreturn_t davinci_mdio_userint(int irq, void *dev_id)
+{
+	struct davinci_mdio_data *data = dev_id;
+	u32 stat;
+
+	stat = __raw_readl(&data->regs->userintmasked);
+	if (!stat)
+		return IRQ_NONE;
+
+	__raw_writel(stat, &data->regs->userintmasked);
+	complete(&data->access_done);
+
+	return IRQ_HANDLED;
+}
+
+static irqreturn_t davinci_mdio_linkint(int irq, void *dev_id)
+{
+	struct davinci_mdio_data *data = dev_id;
+	struct phy_device *phy;
+	u32 stat;
+	int i;
+
+	stat = __raw_readl(&data->regs->linkintmasked);
+	if (!stat)
+		return IRQ_NONE;
+
+	__raw_writel(stat, &data->regs->linkintmasked);
+
+	for (i = 0; i < MDIO_LINK_MONITORS; i++) {
+		if (!(stat & BIT(i)) || data->link_phy[i] < 0)
+			continue;
+
+		/* don't wait for the next poll to notice */
+		phy = data->bus->phy_map[data->link_phy[i]];
+		if (phy)
+			phy_trigger_link_check(phy);
+	}
+
+	return IRQ_HANDLED;
+}
+
 /* wait until hardware state machine is idle */
 static inline int wait_for_idle(struct davinci_mdio_data *data)
 {
@@ -235,10 +329,10 @@ static int davinci_mdio_read(struct mii_bus *bus, int phy_id, int phy_reg)
 	if (phy_reg & ~PHY_REG_MASK || phy_id & ~PHY_ID_MASK)
 		return -EINVAL;
 
-	spin_lock(&data->lock);
+	mutex_lock(&data->lock);
 
 	if (data->suspended) {
-		spin_unlock(&data->lock);
+		mutex_unlock(&data->lock);
 		return -ENODEV;
 	}
 
@@ -252,9 +346,10 @@ static int davinci_mdio_read(struct mii_bus *bus, int phy_id, int phy_reg)
 		if (ret < 0)
 			break;
 
+		reinit_completion(&data->access_done);
 		__raw_writel(reg, &data->regs->user[0].access);
 
-		ret = wait_for_user_access(data);
+		ret = wait_for_user_access_done(data);
 		if (ret == -EAGAIN)
 			continue;
 		if (ret < 0)
@@ -265,7 +360,7 @@ static int davinci_mdio_read(struct mii_bus *bus, int phy_id, int phy_reg)
 		break;
 	}
 
-	spin_unlock(&data->lock);
+	mutex_unlock(&data->lock);
 
 	return ret;
 }
@@ -280,10 +375,10 @@ static int davinci_mdio_write(struct mii_bus *bus, int phy_id,
 	if (phy_reg & ~PHY_REG_MASK || phy_id & ~PHY_ID_MASK)
 		return -EINVAL;
 
-	spin_lock(&data->lock);
+	mutex_lock(&data->lock);
 
 	if (data->suspended) {
-		spin_unlock(&data->lock);
+		mutex_unlock(&data->lock);
 		return -ENODEV;
 	}
 
@@ -297,15 +392,16 @@ static int davinci_mdio_write(struct mii_bus *bus, int phy_id,
 		if (ret < 0)
 			break;
 
+		reinit_completion(&data->access_done);
 		__raw_writel(reg, &data->regs->user[0].access);
 
-		ret = wait_for_user_access(data);
+		ret = wait_for_user_access_done(data);
 		if (ret == -EAGAIN)
 			continue;
 		break;
 	}
 
-	spin_unlock(&data->lock);
+	mutex_unlock(&data->lock);
 
 	return 0;
 }
@@ -424,7 +520,7 @@ static int davinci_mdio_probe(struct platform_device *pdev)
 	struct davinci_mdio_data *data;
 	struct resource *res;
 	struct phy_device *phy;
-	int ret, addr;
+	int ret, addr, i;
 
 	data = devm_kzalloc(dev, sizeof(*data), GFP_KERNEL);
 	if (!data)
@@ -465,7 +561,10 @@ static int davinci_mdio_probe(struct platform_device *pdev)
 
 	dev_set_drvdata(dev, data);
 	data->dev = dev;
-	spin_lock_init(&data->lock);
+	mutex_init(&data->lock);
+	init_completion(&data->access_done);
+	for (i = 0; i < MDIO_LINK_MONITORS; i++)
+		data->link_phy[i] = -1;
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	data->regs = devm_ioremap_resource(dev, res);
@@ -474,6 +573,18 @@ static int davinci_mdio_probe(struct platform_device *pdev)
 		goto bail_out;
 	}
 
+	/* both interrupts are optional, without them we poll as before */
+	data->userint_irq = platform_get_irq_byname(pdev, "userint");
+	if (data->userint_irq > 0) {
+		ret = devm_request_irq(dev, data->userint_irq,
+				       davinci_mdio_userint, 0,
+				       dev_name(dev), data);
+		if (ret) {
+			dev_warn(dev, "no USERINT, polling for access\n");
+			data->userint_irq = 0;
+		}
+	}
+
 	/* register the mii bus
 	 * Create PHYs from DT only in case if PHY child nodes are explicitly
 	 * defined to support backward compatibility with DTs which assume that
@@ -488,16 +599,41 @@ static int davinci_mdio_probe(struct platform_device *pdev)
 	if (ret)
 		goto bail_out;
 
-	/* scan and dump the bus */
+	/* scan and dump the bus, monitoring the first phys for LINKINT */
+	i = 0;
 	for (addr = 0; addr < PHY_MAX_ADDR; addr++) {
 		phy = data->bus->phy_map[addr];
 		if (phy) {
 			dev_info(dev, "phy[%d]: device %s, driver %s\n",
 				 phy->addr, dev_name(&phy->dev),
 				 phy->drv ? phy->drv->name : "unknown");
+			if (i < MDIO_LINK_MONITORS)
+				data->link_phy[i++] = addr;
 		}
 	}
 
+	data->linkint_irq = platform_get_irq_byname(pdev, "linkint");
+	if (data->linkint_irq > 0 && i) {
+		/* the phy state machine takes mutexes, so threaded */
+		ret = devm_request_threaded_irq(dev, data->linkint_irq, NULL,
+						davinci_mdio_linkint,
+						IRQF_ONESHOT, dev_name(dev),
+						data);
+		if (ret)
+			data->linkint_irq = 0;
+	} else {
+		data->linkint_irq = 0;
+	}
+
+	if (!data->linkint_irq) {
+		for (i = 0; i < MDIO_LINK_MONITORS; i++)
+			data->link_phy[i] = -1;
+	}
+
+	mutex_lock(&data->lock);
+	__davinci_mdio_enable_int(data);
+	mutex_unlock(&data->lock);
+
 	return 0;
 
 bail_out:
@@ -511,6 +647,10 @@ static int davinci_mdio_remove(struct platform_device *pdev)
 {
 	struct davinci_mdio_data *data = platform_get_drvdata(pdev);
 
+	/* the link handler looks phys up on the bus */
+	if (data->linkint_irq)
+		disable_irq(data->linkint_irq);
+
 	if (data->bus)
 		mdiobus_unregister(data->bus);
 
@@ -526,7 +666,7 @@ static int davinci_mdio_suspend(struct device *dev)
 	struct davinci_mdio_data *data = dev_get_drvdata(dev);
 	u32 ctrl;
 
-	spin_lock(&data->lock);
+	mutex_lock(&data->lock);
 
 	/* shutdown the scan state machine */
 	ctrl = __raw_readl(&data->regs->control);
@@ -535,7 +675,7 @@ static int davinci_mdio_suspend(struct device *dev)
 	wait_for_idle(data);
 
 	data->suspended = true;
-	spin_unlock(&data->lock);
+	mutex_unlock(&data->lock);
 	pm_runtime_put_sync(data->dev);
 
 	/* Select sleep pin state */
@@ -553,12 +693,12 @@ static int davinci_mdio_resume(struct device *dev)
 
 	pm_runtime_get_sync(data->dev);
 
-	spin_lock(&data->lock);
+	mutex_lock(&data->lock);
 	/* restart the scan state machine */
 	__davinci_mdio_reset(data);
 
 	data->suspended = false;
-	spin_unlock(&data->lock);
+	mutex_unlock(&data->lock);
 
 	return 0;
 }
@@ -964,6 +964,31 @@ void phy_mac_interrupt(struct phy_device *phydev, int new_link)
 }
 EXPORT_SYMBOL(phy_mac_interrupt);
 
+/**
+ * phy_trigger_link_check - re-read the link status without waiting for a poll
+ * @phydev: target phy_device struct
+ *
+ * Description: for polled PHYs whose link changes are signalled some other
+ * way, e.g. by the MDIO controller.  Moves a running state machine
+ * straight to PHY_CHANGELINK and runs it now.  May sleep.
+ */
+void phy_trigger_link_check(struct phy_device *phydev)
+{
+	bool kick = false;
+
+	mutex_lock(&phydev->lock);
+	if ((PHY_RUNNING == phydev->state) || (PHY_NOLINK == phydev->state)) {
+		phydev->state = PHY_CHANGELINK;
+		kick = true;
+	}
+	mutex_unlock(&phydev->lock);
+
+	if (kick)
+		mod_delayed_work(system_power_efficient_wq,
+				 &phydev->state_queue, 0);
+}
+EXPORT_SYMBOL(phy_trigger_link_check);
+
 static inline void mmd_phy_indirect(struct mii_bus *bus, int prtad, int devad,
 				    int addr)
 {
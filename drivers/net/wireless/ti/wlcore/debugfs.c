@@ -430,6 +430,46 @@ static const struct file_operations split_scan_timeout_ops = {
 	.llseek = default_llseek,
 };
 
+static ssize_t tx_aggr_max_frames_read(struct file *file,
+				       char __user *user_buf,
+				       size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+
+	return wl1271_format_buffer(user_buf, count,
+				    ppos, "%u\n",
+				    wl->tx_aggr_max_frames);
+}
+
+static ssize_t tx_aggr_max_frames_write(struct file *file,
+					const char __user *user_buf,
+					size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+	unsigned long value;
+	int ret;
+
+	ret = kstrtoul_from_user(user_buf, count, 10, &value);
+	if (ret < 0) {
+		wl1271_warning("illegal value in tx_aggr_max_frames");
+		return -EINVAL;
+	}
+
+	mutex_lock(&wl->mutex);
+
+	wl->tx_aggr_max_frames = value;
+
+	mutex_unlock(&wl->mutex);
+	return count;
+}
+
+static const struct file_operations tx_aggr_max_frames_ops = {
+	.read = tx_aggr_max_frames_read,
+	.write = tx_aggr_max_frames_write,
+	.open = simple_open,
+	.llseek = default_llseek,
+};
+
 static ssize_t driver_state_read(struct file *file, char __user *user_buf,
 				 size_t count, loff_t *ppos)
 {
@@ -1255,6 +1295,7 @@ static int wl1271_debugfs_add_files(struct wl1271 *wl,
 	DEBUGFS_ADD(dynamic_ps_timeout, rootdir);
 	DEBUGFS_ADD(forced_ps, rootdir);
 	DEBUGFS_ADD(split_scan_timeout, rootdir);
+	DEBUGFS_ADD(tx_aggr_max_frames, rootdir);
 	DEBUGFS_ADD(irq_pkt_threshold, rootdir);
 	DEBUGFS_ADD(irq_blk_threshold, rootdir);
 	DEBUGFS_ADD(irq_timeout, rootdir);
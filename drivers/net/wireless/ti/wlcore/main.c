@@ -48,6 +48,9 @@ static char *fwlog_param;
 static int fwlog_mem_blocks = -1;
 static int bug_on_recovery = -1;
 static int no_recovery     = -1;
+static int tx_aggr_frames  = -1;
+static int rx_irq_pkt_threshold = -1;
+static int rx_irq_timeout  = -1;
 
 static void __wl1271_op_remove_interface(struct wl1271 *wl,
 					 struct ieee80211_vif *vif,
@@ -338,6 +341,31 @@ static void wlcore_adjust_conf(struct wl1271 *wl)
 
 	if (no_recovery != -1)
 		wl->conf.recovery.no_recovery = (u8) no_recovery;
+
+	/* TX aggregation and RX interrupt coalescing params */
+	if (tx_aggr_frames != -1) {
+		if (tx_aggr_frames >= 0)
+			wl->tx_aggr_max_frames = tx_aggr_frames;
+		else
+			wl1271_error("Illegal tx_aggr_frames=%d",
+				     tx_aggr_frames);
+	}
+
+	if (rx_irq_pkt_threshold != -1) {
+		if (rx_irq_pkt_threshold >= 0 && rx_irq_pkt_threshold <= 0xffff)
+			wl->conf.rx.irq_pkt_threshold = rx_irq_pkt_threshold;
+		else
+			wl1271_error("Illegal rx_irq_pkt_threshold=%d",
+				     rx_irq_pkt_threshold);
+	}
+
+	if (rx_irq_timeout != -1) {
+		if (rx_irq_timeout >= 0 && rx_irq_timeout <= 0xffff)
+			wl->conf.rx.irq_timeout = rx_irq_timeout;
+		else
+			wl1271_error("Illegal rx_irq_timeout=%d",
+				     rx_irq_timeout);
+	}
 }
 
 static void wl12xx_irq_ps_regulate_link(struct wl1271 *wl,
@@ -648,9 +676,19 @@ static int wlcore_irq_locked(struct wl1271 *wl)
 			wl1271_debug(DEBUG_IRQ, "WL1271_ACX_INTR_HW_AVAILABLE");
 	}
 
+	/*
+	 * We already run in the threaded irq handler, so hand the frames
+	 * to mac80211 right here instead of bouncing through netstack_work.
+	 */
+	wl1271_flush_deferred_work(wl);
+
 	wl1271_ps_elp_sleep(wl);
 
 out:
+	/* frames left behind by an error are delivered from the work */
+	if (skb_queue_len(&wl->deferred_rx_queue))
+		queue_work(wl->freezable_wq, &wl->netstack_work);
+
 	return ret;
 }
 
@@ -6645,6 +6683,17 @@ MODULE_PARM_DESC(bug_on_recovery, "BUG() on fw recovery");
 module_param(no_recovery, int, S_IRUSR | S_IWUSR);
 MODULE_PARM_DESC(no_recovery, "Prevent HW recovery. FW will remain stuck.");
 
+module_param(tx_aggr_frames, int, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(tx_aggr_frames,
+		 "Max TX frames per bus transfer (0: fill the aggr buffer)");
+
+module_param(rx_irq_pkt_threshold, int, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(rx_irq_pkt_threshold,
+		 "RX packets to coalesce before raising an interrupt (0: off)");
+
+module_param(rx_irq_timeout, int, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(rx_irq_timeout, "RX interrupt coalescing timeout in usec");
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Luciano Coelho <coelho@ti.com>");
 MODULE_AUTHOR("Juuso Oikarinen <juuso.oikarinen@nokia.com>");
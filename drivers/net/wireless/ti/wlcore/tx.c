@@ -767,6 +767,7 @@ int wlcore_tx_work_locked(struct wl1271 *wl)
 	struct sk_buff *skb;
 	struct wl1271_tx_hw_descr *desc;
 	u32 buf_offset = 0, last_len = 0;
+	u32 aggr_frames = 0;
 	bool sent_packets = false;
 	unsigned long active_hlids[BITS_TO_LONGS(WLCORE_MAX_LINKS)] = {0};
 	int ret = 0;
@@ -805,6 +806,7 @@ int wlcore_tx_work_locked(struct wl1271 *wl)
 
 			sent_packets = true;
 			buf_offset = 0;
+			aggr_frames = 0;
 			continue;
 		} else if (ret == -EBUSY) {
 			/*
@@ -833,6 +835,21 @@ int wlcore_tx_work_locked(struct wl1271 *wl)
 			desc = (struct wl1271_tx_hw_descr *) skb->data;
 			__set_bit(desc->hlid, active_hlids);
 		}
+
+		/* Flush early once the aggregation frame limit is reached */
+		if (wl->tx_aggr_max_frames &&
+		    ++aggr_frames >= wl->tx_aggr_max_frames) {
+			buf_offset = wlcore_hw_pre_pkt_send(wl, buf_offset,
+							    last_len);
+			bus_ret = wlcore_write_data(wl, REG_SLV_MEM_DATA,
+					     wl->aggr_buf, buf_offset, true);
+			if (bus_ret < 0)
+				goto out;
+
+			sent_packets = true;
+			buf_offset = 0;
+			aggr_frames = 0;
+		}
 	}
 
 out_ack:
@@ -292,6 +292,9 @@ struct wl1271 {
 	u8 *aggr_buf;
 	u32 aggr_buf_size;
 
+	/* Max frames per aggregated bus transfer, 0 means no limit */
+	u32 tx_aggr_max_frames;
+
 	/* Reusable dummy packet template */
 	struct sk_buff *dummy_packet;
 
@@ -834,6 +834,39 @@ void *nvmem_cell_read(struct nvmem_cell *cell, size_t *len)
 }
 EXPORT_SYMBOL_GPL(nvmem_cell_read);
 
+/**
+ * nvmem_cell_read_range() - Read part of a given nvmem cell
+ *
+ * @cell: nvmem cell to be read.
+ * @offset: offset of the first byte to read, from the start of the cell.
+ * @buf: buffer to be populated with @len bytes on successful read.
+ * @len: number of bytes to read.
+ *
+ * Lets consumers look at a few bytes of a large cell without reading all of
+ * it. Only cells that start and end on byte boundaries can be read this way.
+ *
+ * Return: 0 on success or a negative error code on failure.
+ */
+int nvmem_cell_read_range(struct nvmem_cell *cell, unsigned int offset,
+			  void *buf, size_t len)
+{
+	struct nvmem_device *nvmem = cell->nvmem;
+	int rc;
+
+	if (!nvmem || !nvmem->regmap || cell->bit_offset || cell->nbits)
+		return -EINVAL;
+
+	if (offset > cell->bytes || len > cell->bytes - offset)
+		return -EINVAL;
+
+	rc = regmap_raw_read(nvmem->regmap, cell->offset + offset, buf, len);
+	if (IS_ERR_VALUE(rc))
+		return rc;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(nvmem_cell_read_range);
+
 static inline void *nvmem_cell_prepare_write_buffer(struct nvmem_cell *cell,
 						    u8 *_buf, int len)
 {
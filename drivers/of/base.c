@@ -20,6 +20,7 @@
 #include <linux/console.h>
 #include <linux/ctype.h>
 #include <linux/cpu.h>
+#include <linux/hashtable.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_graph.h>
@@ -54,6 +55,69 @@ DEFINE_MUTEX(of_mutex);
  */
 DEFINE_RAW_SPINLOCK(devtree_lock);
 
+/*
+ * phandle to node index for of_find_node_by_phandle(), protected by
+ * devtree_lock.  Nodes are added when they get attached to the live tree and
+ * removed when they are detached, so overlays keep it coherent.  Until
+ * of_core_init() has indexed the unflattened tree, lookups fall back to
+ * walking it.
+ */
+#define OF_PHANDLE_HASH_BITS	9
+static DEFINE_HASHTABLE(of_phandle_hash, OF_PHANDLE_HASH_BITS);
+static bool of_phandle_cache_ready;
+static phandle of_phandle_cache_max;
+
+void __of_phandle_cache_add(struct device_node *np)
+{
+	if (!np->phandle || np->phandle == OF_PHANDLE_ILLEGAL ||
+	    !hlist_unhashed(&np->phandle_hash))
+		return;
+
+	hash_add(of_phandle_hash, &np->phandle_hash, np->phandle);
+	if (np->phandle > of_phandle_cache_max)
+		of_phandle_cache_max = np->phandle;
+}
+
+/* removes @np and anything below it, a detached subtree is not reachable */
+void __of_phandle_cache_remove(struct device_node *np)
+{
+	struct device_node *child;
+
+	hash_del(&np->phandle_hash);
+	for (child = np->child; child; child = child->sibling)
+		__of_phandle_cache_remove(child);
+}
+
+/**
+ * of_phandle_max - Upper bound of the phandles used in the live tree
+ *
+ * The bound only grows: phandles of detached nodes are not given back, which
+ * is what of_resolve_phandles() needs to pick a non-conflicting range.
+ * Returns 0 if the phandle index is not available yet.
+ */
+phandle of_phandle_max(void)
+{
+	unsigned long flags;
+	phandle max;
+
+	raw_spin_lock_irqsave(&devtree_lock, flags);
+	max = of_phandle_cache_ready ? of_phandle_cache_max : 0;
+	raw_spin_unlock_irqrestore(&devtree_lock, flags);
+
+	return max;
+}
+
+static struct device_node *__of_phandle_cache_find(phandle handle)
+{
+	struct device_node *np;
+
+	hash_for_each_possible(of_phandle_hash, np, phandle_hash, handle)
+		if (np->phandle == handle)
+			return np;
+
+	return NULL;
+}
+
 int of_n_addr_cells(struct device_node *np)
 {
 	const __be32 *ip;
@@ -192,8 +256,15 @@ int __of_attach_node_sysfs(struct device_node *np)
 void __init of_core_init(void)
 {
 	struct device_node *np;
+	unsigned long flags;
 	int ret;
 
+	raw_spin_lock_irqsave(&devtree_lock, flags);
+	for_each_of_allnodes(np)
+		__of_phandle_cache_add(np);
+	of_phandle_cache_ready = true;
+	raw_spin_unlock_irqrestore(&devtree_lock, flags);
+
 	/* Create the kset, and register existing nodes */
 	mutex_lock(&of_mutex);
 	of_kset = kset_create_and_add("devicetree", NULL, firmware_kobj);
@@ -1078,9 +1149,15 @@ struct device_node *of_find_node_by_phandle(phandle handle)
 		return NULL;
 
 	raw_spin_lock_irqsave(&devtree_lock, flags);
-	for_each_of_allnodes(np)
-		if (np->phandle == handle)
-			break;
+	np = __of_phandle_cache_find(handle);
+	if (!np) {
+		/* early boot, or a phandle changed behind the index's back */
+		for_each_of_allnodes(np)
+			if (np->phandle == handle)
+				break;
+		if (np && of_phandle_cache_ready)
+			__of_phandle_cache_add(np);
+	}
 	of_node_get(np);
 	raw_spin_unlock_irqrestore(&devtree_lock, flags);
 	return np;
@@ -31,6 +31,9 @@ struct alias_prop {
 	char stem[0];
 };
 
+/* illegal phandle value (set when unresolved) */
+#define OF_PHANDLE_ILLEGAL	0xdeadbeef
+
 extern struct mutex of_mutex;
 extern struct list_head aliases_lookup;
 extern struct kset *of_kset;
@@ -76,6 +79,10 @@ extern int __of_update_property(struct device_node *np,
 extern void __of_update_property_sysfs(struct device_node *np,
 		struct property *newprop, struct property *oldprop);
 
+extern void __of_phandle_cache_add(struct device_node *np);
+extern void __of_phandle_cache_remove(struct device_node *np);
+extern phandle of_phandle_max(void);
+
 extern void __of_attach_node(struct device_node *np);
 extern int __of_attach_node_sysfs(struct device_node *np);
 extern void __of_detach_node(struct device_node *np);
@@ -22,6 +22,11 @@
 #include <linux/idr.h>
 #include <linux/sysfs.h>
 #include <linux/atomic.h>
+#include <linux/device.h>
+#include <linux/ktime.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/of.h>
 
 #include "of_private.h"
 
@@ -61,6 +66,12 @@ struct of_overlay {
 /* master enable switch; once set to 0 can't be re-enabled */
 static atomic_t ov_enable = ATOMIC_INIT(1);
 
+/*
+ * Hold off probing while the changeset notifiers create the overlay's
+ * devices, then probe them all in one deferred probe pass.
+ */
+static atomic_t ov_batch_probe = ATOMIC_INIT(1);
+
 static int of_overlay_apply_one(struct of_overlay *ov,
 		struct device_node *target, const struct device_node *overlay);
 static int overlay_removal_is_ok(struct of_overlay *ov);
@@ -478,8 +489,30 @@ static ssize_t enable_store(struct kobject *kobj,
 
 static struct kobj_attribute enable_attr = __ATTR_RW(enable);
 
+static ssize_t batch_probe_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", atomic_read(&ov_batch_probe));
+}
+
+static ssize_t batch_probe_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	bool new_batch;
+
+	ret = strtobool(buf, &new_batch);
+	if (ret != 0)
+		return ret;
+	atomic_set(&ov_batch_probe, (int)new_batch);
+	return count;
+}
+
+static struct kobj_attribute batch_probe_attr = __ATTR_RW(batch_probe);
+
 static const struct attribute *overlay_global_attrs[] = {
 	&enable_attr.attr,
+	&batch_probe_attr.attr,
 	NULL
 };
 
@@ -542,10 +575,22 @@ static struct kobj_type of_overlay_ktype = {
 
 static struct kset *ov_kset;
 
+static int of_changeset_entries(struct of_changeset *ocs)
+{
+	struct of_changeset_entry *ce;
+	int n = 0;
+
+	list_for_each_entry(ce, &ocs->entries, node)
+		n++;
+	return n;
+}
+
 static int __of_overlay_create(struct device_node *tree,
 		const char *indirect_id, struct device_node *target_root)
 {
 	struct of_overlay *ov;
+	ktime_t start = ktime_get();
+	bool batched;
 	int err, id;
 
 	/* administratively disabled */
@@ -601,8 +646,16 @@ static int __of_overlay_create(struct device_node *tree,
 		goto err_abort_trans;
 	}
 
-	/* apply the changeset */
+	/*
+	 * apply the changeset; in batched mode the devices the notifiers
+	 * create are only probed once all of them exist
+	 */
+	batched = atomic_read(&ov_batch_probe);
+	if (batched)
+		device_block_probing();
 	err = of_changeset_apply(&ov->cset);
+	if (batched)
+		device_unblock_probing();
 	if (err) {
 		pr_err("%s: of_changeset_apply() failed for tree@%s\n",
 				__func__, tree->full_name);
@@ -620,6 +673,10 @@ static int __of_overlay_create(struct device_node *tree,
 	/* add to the tail of the overlay list */
 	list_add_tail(&ov->node, &ov_list);
 
+	trace_of_overlay_apply(id, tree->full_name,
+			of_changeset_entries(&ov->cset), batched,
+			ktime_us_delta(ktime_get(), start), 0);
+
 	mutex_unlock(&of_mutex);
 
 	return id;
@@ -627,6 +684,9 @@ static int __of_overlay_create(struct device_node *tree,
 err_cancel_overlay:
 	of_changeset_revert(&ov->cset);
 err_revert_overlay:
+	trace_of_overlay_apply(id, tree->full_name,
+			of_changeset_entries(&ov->cset), batched,
+			ktime_us_delta(ktime_get(), start), err);
 err_abort_trans:
 	of_free_overlay_info(ov);
 err_free_idr:
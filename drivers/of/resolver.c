@@ -19,8 +19,7 @@
 #include <linux/string.h>
 #include <linux/slab.h>
 
-/* illegal phandle value (set when unresolved) */
-#define OF_PHANDLE_ILLEGAL	0xdeadbeef
+#include "of_private.h"
 
 /**
  * Find a node with the give full name by recursively following any of
@@ -56,6 +55,11 @@ static phandle of_get_tree_max_phandle(void)
 	phandle phandle;
 	unsigned long flags;
 
+	/* the phandle index tracks it once the tree is indexed */
+	phandle = of_phandle_max();
+	if (phandle)
+		return phandle;
+
 	/* now search recursively */
 	raw_spin_lock_irqsave(&devtree_lock, flags);
 	phandle = 0;
@@ -42,6 +42,7 @@ struct pm_voltdm_dev {
  * @clk:	clk on which we registered the notifier
  * @reg:	regulator if any which is used for scaling voltage
  * @tol:	voltage tolerance in %
+ * @volt:	voltage last programmed by the notifier, 0 if unknown
  * @nb:		notifier block pointer
  * @list:	list head for the notifier
  * @vdev:	pointer to voltage domain device for this notifier
@@ -52,6 +53,7 @@ struct voltdm_scale_data {
 	struct clk *clk;
 	struct regulator *reg;
 	int tol;
+	int volt;
 	struct notifier_block nb;
 	struct list_head list;
 
@@ -274,6 +276,14 @@ static int clk_voltdm_notifier_handler(struct notifier_block *nb,
 	volt = dev_pm_opp_get_voltage(opp);
 	rcu_read_unlock();
 
+	/*
+	 * OPPs sharing a voltage need no PMIC access, which on a slow bus
+	 * like I2C would dominate the transition. Domains that asked for
+	 * every notification still get them.
+	 */
+	if (volt == vsd->volt && !voltdm_skip_check(vdev))
+		return NOTIFY_OK;
+
 	tol = volt * vsd->tol / 100;
 
 	dev_dbg(vsd->dev, "%s: %lu -> %lu, V=%d, tol=%d, clk_flag=%lu\n",
@@ -284,8 +294,10 @@ static int clk_voltdm_notifier_handler(struct notifier_block *nb,
 		dev_err(vsd->dev,
 			"%s: Failed to scale voltage(%u): %d\n", __func__,
 			volt, ret);
+		vsd->volt = 0;
 		return notifier_from_errno(ret);
 	}
+	vsd->volt = volt;
 
 	return NOTIFY_OK;
 }
@@ -40,6 +40,8 @@ static DEFINE_MUTEX(pwm_lock);
 static LIST_HEAD(pwm_chips);
 static DECLARE_BITMAP(allocated_pwms, MAX_PWMS);
 static RADIX_TREE(pwm_tree, GFP_KERNEL);
+/* one grouped update at a time, controllers hold back a single set */
+static DEFINE_MUTEX(pwm_group_lock);
 
 static struct pwm_device *pwm_to_device(unsigned int pwm)
 {
@@ -421,6 +423,83 @@ int pwm_config(struct pwm_device *pwm, int duty_ns, int period_ns)
 }
 EXPORT_SYMBOL_GPL(pwm_config);
 
+static bool pwm_update_first_of_chip(const struct pwm_update *updates,
+				     unsigned int index)
+{
+	unsigned int i;
+
+	for (i = 0; i < index; i++)
+		if (updates[i].pwm->chip == updates[index].pwm->chip)
+			return false;
+
+	return true;
+}
+
+/**
+ * pwm_config_group() - change the configuration of several PWM devices at once
+ * @updates: new duty cycle and period of each PWM device
+ * @num: number of entries in @updates
+ *
+ * The new settings are held back from the outputs until all of them are
+ * written, then released together so that each controller switches over at
+ * its next period boundary.  Controllers whose counters are synchronized with
+ * each other therefore switch over on the same cycle.  All controllers must
+ * implement the update hooks.
+ *
+ * If an entry fails, the entries before it still take effect.
+ */
+int pwm_config_group(const struct pwm_update *updates, unsigned int num)
+{
+	const struct pwm_ops *ops;
+	unsigned int i, staged;
+	unsigned long flags;
+	int err = 0;
+
+	for (i = 0; i < num; i++) {
+		if (!updates[i].pwm)
+			return -EINVAL;
+
+		ops = updates[i].pwm->chip->ops;
+		if (!ops->update_begin || !ops->update_commit)
+			return -ENOSYS;
+	}
+
+	mutex_lock(&pwm_group_lock);
+
+	for (staged = 0; staged < num; staged++) {
+		struct pwm_chip *chip = updates[staged].pwm->chip;
+
+		if (!pwm_update_first_of_chip(updates, staged))
+			continue;
+
+		err = chip->ops->update_begin(chip);
+		if (err)
+			break;
+	}
+
+	for (i = 0; !err && i < num; i++)
+		err = pwm_config(updates[i].pwm, updates[i].duty_ns,
+				 updates[i].period_ns);
+
+	local_irq_save(flags);
+	for (i = 0; i < staged; i++)
+		if (pwm_update_first_of_chip(updates, i))
+			updates[i].pwm->chip->ops->update_commit(
+						updates[i].pwm->chip);
+	local_irq_restore(flags);
+
+	for (i = 0; i < staged; i++) {
+		ops = updates[i].pwm->chip->ops;
+		if (ops->update_end && pwm_update_first_of_chip(updates, i))
+			ops->update_end(updates[i].pwm->chip);
+	}
+
+	mutex_unlock(&pwm_group_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(pwm_config_group);
+
 /**
  * pwm_set_polarity() - configure the polarity of a PWM signal
  * @pwm: PWM device
@@ -26,6 +26,10 @@
 #include <linux/pm_runtime.h>
 #include <linux/pwm.h>
 #include <linux/of_device.h>
+#include <linux/interrupt.h>
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/kfifo_buf.h>
 
 #include "pwm-tipwmss.h"
 
@@ -34,16 +38,30 @@
 #define CAP2			0x0C
 #define CAP3			0x10
 #define CAP4			0x14
+#define ECCTL1			0x28
+#define ECCTL1_FREE_RUN		BIT(15)
+#define ECCTL1_CAPLDEN		BIT(8)
+#define ECCTL1_CAP4POL_FALL	BIT(6)
+#define ECCTL1_CAP2POL_FALL	BIT(2)
 #define ECCTL2			0x2A
 #define ECCTL2_APWM_POL_LOW	BIT(10)
 #define ECCTL2_APWM_MODE	BIT(9)
 #define ECCTL2_SYNC_SEL_DISA	(BIT(7) | BIT(6))
 #define ECCTL2_TSCTR_FREERUN	BIT(4)
+#define ECCTL2_REARM		BIT(3)
+#define ECCTL2_STOP_WRAP_CEVT4	(BIT(2) | BIT(1))
+#define ECEINT			0x2C
+#define ECFLG			0x2E
+#define ECCLR			0x30
+#define ECINT_CEVT4		BIT(4)
+#define ECINT_ALL		0xFF
 
 struct ecap_context {
 	u32	cap3;
 	u32	cap4;
+	u16	ecctl1;
 	u16	ecctl2;
+	u16	eceint;
 };
 
 struct ecap_pwm_chip {
@@ -51,6 +69,8 @@ struct ecap_pwm_chip {
 	unsigned int	clk_rate;
 	void __iomem	*mmio_base;
 	struct ecap_context ctx;
+	/* set when the module captures instead of driving a PWM */
+	struct iio_dev	*capture;
 };
 
 static inline struct ecap_pwm_chip *to_ecap_pwm_chip(struct pwm_chip *chip)
@@ -194,6 +214,188 @@ static const struct pwm_ops ecap_pwm_ops = {
 	.owner		= THIS_MODULE,
 };
 
+#ifdef CONFIG_PWM_TIECAP_CAPTURE
+/*
+ * In capture mode the time stamp counter runs freely and CAP1-CAP4 latch it
+ * on a rising, falling, rising and falling edge of the input in turn.  The
+ * interrupt on the fourth event pushes the four time stamps as one scan, so
+ * the period and duty cycle of two input periods come with one interrupt:
+ * period = CAP3 - CAP1, high time = CAP2 - CAP1.  The counter wraps through
+ * 32 bits, unsigned differences stay correct across the wrap.
+ */
+struct ecap_capture {
+	struct ecap_pwm_chip *pc;
+	/* CAP1-CAP4 followed by the timestamp */
+	u32 scan[4 + sizeof(s64) / sizeof(u32)] __aligned(8);
+};
+
+#define ECAP_CAPTURE_CHAN(_idx) {				\
+	.type = IIO_COUNT,					\
+	.indexed = 1,						\
+	.channel = (_idx),					\
+	.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE),	\
+	.scan_index = (_idx),					\
+	.scan_type = {						\
+		.sign = 'u',					\
+		.realbits = 32,					\
+		.storagebits = 32,				\
+	},							\
+}
+
+static const struct iio_chan_spec ecap_capture_channels[] = {
+	ECAP_CAPTURE_CHAN(0),
+	ECAP_CAPTURE_CHAN(1),
+	ECAP_CAPTURE_CHAN(2),
+	ECAP_CAPTURE_CHAN(3),
+	IIO_CHAN_SOFT_TIMESTAMP(4),
+};
+
+/* all four time stamps are needed to make sense of any of them */
+static const unsigned long ecap_capture_scan_masks[] = { 0xF, 0 };
+
+static irqreturn_t ecap_capture_irq(int irq, void *private)
+{
+	struct iio_dev *indio_dev = private;
+	struct ecap_capture *cap = iio_priv(indio_dev);
+	void __iomem *base = cap->pc->mmio_base;
+	u16 flags;
+
+	flags = readw(base + ECFLG);
+	if (!(flags & ECINT_CEVT4))
+		return IRQ_NONE;
+
+	/* the next rising edge overwrites CAP1, read them right away */
+	cap->scan[0] = readl(base + CAP1);
+	cap->scan[1] = readl(base + CAP2);
+	cap->scan[2] = readl(base + CAP3);
+	cap->scan[3] = readl(base + CAP4);
+	writew(flags, base + ECCLR);
+
+	/* the kfifo buffer can be filled from hard interrupt context */
+	iio_push_to_buffers_with_timestamp(indio_dev, cap->scan,
+					   iio_get_time_ns());
+
+	return IRQ_HANDLED;
+}
+
+static int ecap_capture_read_raw(struct iio_dev *indio_dev,
+				 struct iio_chan_spec const *chan,
+				 int *val, int *val2, long mask)
+{
+	struct ecap_capture *cap = iio_priv(indio_dev);
+
+	switch (mask) {
+	case IIO_CHAN_INFO_SCALE:
+		/* nanoseconds per count */
+		*val = NSEC_PER_SEC;
+		*val2 = cap->pc->clk_rate;
+		return IIO_VAL_FRACTIONAL;
+	}
+
+	return -EINVAL;
+}
+
+static const struct iio_info ecap_capture_info = {
+	.read_raw = ecap_capture_read_raw,
+	.driver_module = THIS_MODULE,
+};
+
+static int ecap_capture_postenable(struct iio_dev *indio_dev)
+{
+	struct ecap_capture *cap = iio_priv(indio_dev);
+	struct ecap_pwm_chip *pc = cap->pc;
+
+	pm_runtime_get_sync(pc->chip.dev);
+
+	writew(ECCTL1_FREE_RUN | ECCTL1_CAPLDEN | ECCTL1_CAP4POL_FALL |
+	       ECCTL1_CAP2POL_FALL, pc->mmio_base + ECCTL1);
+	/* continuous capture, wrapping after CAP4, starting from CAP1 */
+	writew(ECCTL2_SYNC_SEL_DISA | ECCTL2_STOP_WRAP_CEVT4 | ECCTL2_REARM,
+	       pc->mmio_base + ECCTL2);
+	writew(ECINT_ALL, pc->mmio_base + ECCLR);
+	writew(ECINT_CEVT4, pc->mmio_base + ECEINT);
+	writew(ECCTL2_SYNC_SEL_DISA | ECCTL2_STOP_WRAP_CEVT4 |
+	       ECCTL2_TSCTR_FREERUN, pc->mmio_base + ECCTL2);
+
+	return 0;
+}
+
+static int ecap_capture_predisable(struct iio_dev *indio_dev)
+{
+	struct ecap_capture *cap = iio_priv(indio_dev);
+	struct ecap_pwm_chip *pc = cap->pc;
+
+	writew(0, pc->mmio_base + ECEINT);
+	writew(ECCTL2_SYNC_SEL_DISA | ECCTL2_STOP_WRAP_CEVT4,
+	       pc->mmio_base + ECCTL2);
+	writew(0, pc->mmio_base + ECCTL1);
+	writew(ECINT_ALL, pc->mmio_base + ECCLR);
+
+	pm_runtime_put_sync(pc->chip.dev);
+
+	return 0;
+}
+
+static const struct iio_buffer_setup_ops ecap_capture_buffer_ops = {
+	.postenable = ecap_capture_postenable,
+	.predisable = ecap_capture_predisable,
+};
+
+static int ecap_capture_probe(struct platform_device *pdev,
+			      struct ecap_pwm_chip *pc)
+{
+	struct iio_dev *indio_dev;
+	struct iio_buffer *buffer;
+	struct ecap_capture *cap;
+	int irq, ret;
+
+	irq = platform_get_irq(pdev, 0);
+	if (irq < 0) {
+		dev_err(&pdev->dev, "no irq for capture mode\n");
+		return irq;
+	}
+
+	indio_dev = devm_iio_device_alloc(&pdev->dev, sizeof(*cap));
+	if (!indio_dev)
+		return -ENOMEM;
+
+	cap = iio_priv(indio_dev);
+	cap->pc = pc;
+
+	indio_dev->name = dev_name(&pdev->dev);
+	indio_dev->dev.parent = &pdev->dev;
+	indio_dev->info = &ecap_capture_info;
+	indio_dev->modes = INDIO_BUFFER_SOFTWARE;
+	indio_dev->channels = ecap_capture_channels;
+	indio_dev->num_channels = ARRAY_SIZE(ecap_capture_channels);
+	indio_dev->available_scan_masks = ecap_capture_scan_masks;
+	indio_dev->setup_ops = &ecap_capture_buffer_ops;
+
+	buffer = devm_iio_kfifo_allocate(&pdev->dev);
+	if (!buffer)
+		return -ENOMEM;
+	iio_device_attach_buffer(indio_dev, buffer);
+
+	ret = devm_request_irq(&pdev->dev, irq, ecap_capture_irq, 0,
+			       dev_name(&pdev->dev), indio_dev);
+	if (ret)
+		return ret;
+
+	ret = iio_device_register(indio_dev);
+	if (ret)
+		return ret;
+
+	pc->capture = indio_dev;
+	return 0;
+}
+#else
+static inline int ecap_capture_probe(struct platform_device *pdev,
+				     struct ecap_pwm_chip *pc)
+{
+	return -ENODEV;
+}
+#endif
+
 static const struct of_device_id ecap_of_match[] = {
 	{ .compatible	= "ti,am33xx-ecap" },
 	{},
@@ -236,10 +438,19 @@ static int ecap_pwm_probe(struct platform_device *pdev)
 	if (IS_ERR(pc->mmio_base))
 		return PTR_ERR(pc->mmio_base);
 
-	ret = pwmchip_add(&pc->chip);
-	if (ret < 0) {
-		dev_err(&pdev->dev, "pwmchip_add() failed: %d\n", ret);
-		return ret;
+	if (of_property_read_bool(pdev->dev.of_node, "ti,capture-mode")) {
+		ret = ecap_capture_probe(pdev, pc);
+		if (ret < 0) {
+			dev_err(&pdev->dev, "capture mode setup failed: %d\n",
+				ret);
+			return ret;
+		}
+	} else {
+		ret = pwmchip_add(&pc->chip);
+		if (ret < 0) {
+			dev_err(&pdev->dev, "pwmchip_add() failed: %d\n", ret);
+			return ret;
+		}
 	}
 
 	pm_runtime_enable(&pdev->dev);
@@ -261,7 +472,10 @@ static int ecap_pwm_probe(struct platform_device *pdev)
 pwmss_clk_failure:
 	pm_runtime_put_sync(&pdev->dev);
 	pm_runtime_disable(&pdev->dev);
-	pwmchip_remove(&pc->chip);
+	if (pc->capture)
+		iio_device_unregister(pc->capture);
+	else
+		pwmchip_remove(&pc->chip);
 	return ret;
 }
 
@@ -269,6 +483,10 @@ static int ecap_pwm_remove(struct platform_device *pdev)
 {
 	struct ecap_pwm_chip *pc = platform_get_drvdata(pdev);
 
+	/* stops a running capture while the module is still clocked */
+	if (pc->capture)
+		iio_device_unregister(pc->capture);
+
 	pm_runtime_get_sync(&pdev->dev);
 	/*
 	 * Due to hardware misbehaviour, acknowledge of the stop_req
@@ -278,6 +496,8 @@ static int ecap_pwm_remove(struct platform_device *pdev)
 	pm_runtime_put_sync(&pdev->dev);
 
 	pm_runtime_disable(&pdev->dev);
+	if (pc->capture)
+		return 0;
 	return pwmchip_remove(&pc->chip);
 }
 
@@ -285,7 +505,9 @@ static int ecap_pwm_remove(struct platform_device *pdev)
 static void ecap_pwm_save_context(struct ecap_pwm_chip *pc)
 {
 	pm_runtime_get_sync(pc->chip.dev);
+	pc->ctx.ecctl1 = readw(pc->mmio_base + ECCTL1);
 	pc->ctx.ecctl2 = readw(pc->mmio_base + ECCTL2);
+	pc->ctx.eceint = readw(pc->mmio_base + ECEINT);
 	pc->ctx.cap4 = readl(pc->mmio_base + CAP4);
 	pc->ctx.cap3 = readl(pc->mmio_base + CAP3);
 	pm_runtime_put_sync(pc->chip.dev);
@@ -295,18 +517,29 @@ static void ecap_pwm_restore_context(struct ecap_pwm_chip *pc)
 {
 	writel(pc->ctx.cap3, pc->mmio_base + CAP3);
 	writel(pc->ctx.cap4, pc->mmio_base + CAP4);
+	writew(pc->ctx.ecctl1, pc->mmio_base + ECCTL1);
 	writew(pc->ctx.ecctl2, pc->mmio_base + ECCTL2);
+	writew(pc->ctx.eceint, pc->mmio_base + ECEINT);
+}
+
+/* the module holds a runtime PM reference while it generates or captures */
+static bool ecap_pwm_active(struct ecap_pwm_chip *pc)
+{
+#ifdef CONFIG_PWM_TIECAP_CAPTURE
+	if (pc->capture)
+		return iio_buffer_enabled(pc->capture);
+#endif
+	return test_bit(PWMF_ENABLED, &pc->chip.pwms->flags);
 }
 
 static int ecap_pwm_suspend(struct device *dev)
 {
 	struct ecap_pwm_chip *pc = dev_get_drvdata(dev);
-	struct pwm_device *pwm = pc->chip.pwms;
 
 	ecap_pwm_save_context(pc);
 
 	/* Disable explicitly if PWM is running */
-	if (test_bit(PWMF_ENABLED, &pwm->flags))
+	if (ecap_pwm_active(pc))
 		pm_runtime_put_sync(dev);
 
 	return 0;
@@ -315,10 +548,9 @@ static int ecap_pwm_suspend(struct device *dev)
 static int ecap_pwm_resume(struct device *dev)
 {
 	struct ecap_pwm_chip *pc = dev_get_drvdata(dev);
-	struct pwm_device *pwm = pc->chip.pwms;
 
 	/* Enable explicitly if PWM was running */
-	if (test_bit(PWMF_ENABLED, &pwm->flags))
+	if (ecap_pwm_active(pc))
 		pm_runtime_get_sync(dev);
 
 	ecap_pwm_restore_context(pc);
@@ -58,9 +58,17 @@
 #define PERIOD_MAX		0xFFFF
 
 /* compare module registers */
+#define CMPCTL			0x0E
 #define CMPA			0x12
 #define CMPB			0x14
 
+#define CMPCTL_LOADB_MASK	(BIT(3) | BIT(2))
+#define CMPCTL_LOADB_ZRO	0
+#define CMPCTL_LOADB_FREEZE	(BIT(3) | BIT(2))
+#define CMPCTL_LOADA_MASK	(BIT(1) | BIT(0))
+#define CMPCTL_LOADA_ZRO	0
+#define CMPCTL_LOADA_FREEZE	(BIT(1) | BIT(0))
+
 /* Action qualifier module registers */
 #define AQCTLA			0x16
 #define AQCTLB			0x18
@@ -131,6 +139,10 @@ struct ehrpwm_pwm_chip {
 	enum pwm_polarity polarity[NUM_PWM_CHANNEL];
 	struct	clk	*tbclk;
 	struct ehrpwm_context ctx;
+	/* grouped update in progress, TBPRD is written at commit time */
+	bool		staging;
+	bool		tbprd_pending;
+	u16		staged_tbprd;
 };
 
 static inline struct ehrpwm_pwm_chip *to_ehrpwm_pwm_chip(struct pwm_chip *chip)
@@ -301,7 +313,16 @@ static int ehrpwm_pwm_config(struct pwm_chip *chip, struct pwm_device *pwm,
 	/* Configure shadow loading on Period register */
 	ehrpwm_modify(pc->mmio_base, TBCTL, TBCTL_PRDLD_MASK, TBCTL_PRDLD_SHDW);
 
-	ehrpwm_write(pc->mmio_base, TBPRD, period_cycles);
+	/*
+	 * The period shadow register cannot be frozen like the compare ones,
+	 * hold the new value back until the group is committed.
+	 */
+	if (pc->staging) {
+		pc->staged_tbprd = period_cycles;
+		pc->tbprd_pending = true;
+	} else {
+		ehrpwm_write(pc->mmio_base, TBPRD, period_cycles);
+	}
 
 	/* Configure ehrpwm counter for up-count mode */
 	ehrpwm_modify(pc->mmio_base, TBCTL, TBCTL_CTRMODE_MASK,
@@ -416,12 +437,56 @@ static void ehrpwm_pwm_free(struct pwm_chip *chip, struct pwm_device *pwm)
 	pc->period_cycles[pwm->hwpwm] = 0;
 }
 
+/*
+ * Grouped updates: stop the compare shadow registers from loading while the
+ * new settings are written, then write the period shadow register and let
+ * everything load on the next counter zero.  With the time base counters of
+ * several modules synchronized through the sync chain, all of them switch
+ * over on the same cycle.
+ */
+static int ehrpwm_pwm_update_begin(struct pwm_chip *chip)
+{
+	struct ehrpwm_pwm_chip *pc = to_ehrpwm_pwm_chip(chip);
+
+	pm_runtime_get_sync(chip->dev);
+
+	ehrpwm_modify(pc->mmio_base, CMPCTL,
+		      CMPCTL_LOADA_MASK | CMPCTL_LOADB_MASK,
+		      CMPCTL_LOADA_FREEZE | CMPCTL_LOADB_FREEZE);
+	pc->staging = true;
+	pc->tbprd_pending = false;
+
+	return 0;
+}
+
+static void ehrpwm_pwm_update_commit(struct pwm_chip *chip)
+{
+	struct ehrpwm_pwm_chip *pc = to_ehrpwm_pwm_chip(chip);
+
+	if (pc->tbprd_pending)
+		ehrpwm_write(pc->mmio_base, TBPRD, pc->staged_tbprd);
+
+	ehrpwm_modify(pc->mmio_base, CMPCTL,
+		      CMPCTL_LOADA_MASK | CMPCTL_LOADB_MASK,
+		      CMPCTL_LOADA_ZRO | CMPCTL_LOADB_ZRO);
+	pc->staging = false;
+	pc->tbprd_pending = false;
+}
+
+static void ehrpwm_pwm_update_end(struct pwm_chip *chip)
+{
+	pm_runtime_put_sync(chip->dev);
+}
+
 static const struct pwm_ops ehrpwm_pwm_ops = {
 	.free		= ehrpwm_pwm_free,
 	.config		= ehrpwm_pwm_config,
 	.set_polarity	= ehrpwm_pwm_set_polarity,
 	.enable		= ehrpwm_pwm_enable,
 	.disable	= ehrpwm_pwm_disable,
+	.update_begin	= ehrpwm_pwm_update_begin,
+	.update_commit	= ehrpwm_pwm_update_commit,
+	.update_end	= ehrpwm_pwm_update_end,
 	.owner		= THIS_MODULE,
 };
 
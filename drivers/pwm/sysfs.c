@@ -22,6 +22,11 @@
 #include <linux/slab.h>
 #include <linux/kdev_t.h>
 #include <linux/pwm.h>
+#include <linux/cdev.h>
+#include <linux/fs.h>
+#include <linux/idr.h>
+#include <linux/uaccess.h>
+#include <uapi/linux/pwmchip.h>
 
 struct pwm_export {
 	struct device child;
@@ -306,6 +311,278 @@ static struct class pwm_class = {
 	.dev_groups	= pwm_chip_groups,
 };
 
+/*
+ * /dev/pwmchipN sets the whole state of one or more channels in a single
+ * ioctl() instead of one sysfs write per attribute.  The minor of a chip maps
+ * to the chip in pwm_cdev_idr until the chip is removed, an open file then
+ * only keeps the chip's PWM number range and requests channels by number, so
+ * that a file never refers to a removed chip.
+ */
+#define PWM_CDEV_MINORS		256
+
+static dev_t pwm_cdev_devt;
+static struct cdev pwm_cdev;
+static DEFINE_IDR(pwm_cdev_idr);
+static DEFINE_MUTEX(pwm_cdev_lock);
+
+struct pwm_cdev_file {
+	struct mutex lock;
+	int base;
+	unsigned int npwm;
+	struct pwm_device *pwms[];
+};
+
+static struct pwm_device *pwm_cdev_get(struct pwm_cdev_file *f,
+				       unsigned int hwpwm)
+{
+	struct pwm_device *pwm;
+
+	if (hwpwm >= f->npwm)
+		return ERR_PTR(-EINVAL);
+
+	if (f->pwms[hwpwm])
+		return f->pwms[hwpwm];
+
+	pwm = pwm_request(f->base + hwpwm, "pwm-cdev");
+	if (IS_ERR(pwm))
+		return PTR_ERR(pwm) == -EPROBE_DEFER ? ERR_PTR(-ENODEV) : pwm;
+
+	/* the chip went away and another one now uses its numbers */
+	if (pwm->hwpwm != hwpwm || pwm->chip->base != f->base) {
+		pwm_put(pwm);
+		return ERR_PTR(-ENODEV);
+	}
+
+	f->pwms[hwpwm] = pwm;
+	return pwm;
+}
+
+static int pwm_cdev_check(const struct pwmchip_state *st)
+{
+	if (st->polarity > PWMCHIP_POLARITY_INVERSED || st->enabled > 1 ||
+	    st->reserved || st->period > INT_MAX)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* stop the output if it is to be stopped or its polarity changes */
+static int pwm_cdev_prepare(struct pwm_device *pwm,
+			    const struct pwmchip_state *st)
+{
+	enum pwm_polarity polarity = st->polarity ? PWM_POLARITY_INVERSED :
+						    PWM_POLARITY_NORMAL;
+
+	if (!st->enabled || polarity != pwm->polarity)
+		pwm_disable(pwm);
+
+	if (polarity != pwm->polarity)
+		return pwm_set_polarity(pwm, polarity);
+
+	return 0;
+}
+
+static int pwm_cdev_set_state(struct pwm_cdev_file *f,
+			      const struct pwmchip_state *st)
+{
+	struct pwm_device *pwm;
+	int ret;
+
+	ret = pwm_cdev_check(st);
+	if (ret)
+		return ret;
+
+	pwm = pwm_cdev_get(f, st->hwpwm);
+	if (IS_ERR(pwm))
+		return PTR_ERR(pwm);
+
+	ret = pwm_cdev_prepare(pwm, st);
+	if (ret)
+		return ret;
+
+	ret = pwm_config(pwm, st->duty_cycle, st->period);
+	if (ret)
+		return ret;
+
+	return st->enabled ? pwm_enable(pwm) : 0;
+}
+
+static int pwm_cdev_set_states(struct pwm_cdev_file *f,
+			       const struct pwmchip_state *states,
+			       unsigned int num)
+{
+	struct pwm_update *updates;
+	unsigned int i;
+	int ret;
+
+	updates = kcalloc(num, sizeof(*updates), GFP_KERNEL);
+	if (!updates)
+		return -ENOMEM;
+
+	for (i = 0; i < num; i++) {
+		ret = pwm_cdev_check(&states[i]);
+		if (ret)
+			goto out;
+
+		updates[i].pwm = pwm_cdev_get(f, states[i].hwpwm);
+		if (IS_ERR(updates[i].pwm)) {
+			ret = PTR_ERR(updates[i].pwm);
+			goto out;
+		}
+		updates[i].duty_ns = states[i].duty_cycle;
+		updates[i].period_ns = states[i].period;
+	}
+
+	for (i = 0; i < num; i++) {
+		ret = pwm_cdev_prepare(updates[i].pwm, &states[i]);
+		if (ret)
+			goto out;
+	}
+
+	/* all entries are on the same chip, either all or none can group */
+	if (updates[0].pwm->chip->ops->update_begin) {
+		ret = pwm_config_group(updates, num);
+	} else {
+		for (i = 0, ret = 0; !ret && i < num; i++)
+			ret = pwm_config(updates[i].pwm, updates[i].duty_ns,
+					 updates[i].period_ns);
+	}
+	if (ret)
+		goto out;
+
+	for (i = 0; !ret && i < num; i++)
+		if (states[i].enabled)
+			ret = pwm_enable(updates[i].pwm);
+
+out:
+	kfree(updates);
+	return ret;
+}
+
+static long pwm_cdev_ioctl(struct file *filp, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct pwm_cdev_file *f = filp->private_data;
+	void __user *argp = (void __user *)arg;
+	struct pwmchip_state *states;
+	struct pwmchip_states req;
+	struct pwmchip_state st;
+	int ret;
+
+	switch (cmd) {
+	case PWMCHIP_IOC_SET_STATE:
+		if (copy_from_user(&st, argp, sizeof(st)))
+			return -EFAULT;
+
+		mutex_lock(&f->lock);
+		ret = pwm_cdev_set_state(f, &st);
+		mutex_unlock(&f->lock);
+		return ret;
+
+	case PWMCHIP_IOC_SET_STATES:
+		if (copy_from_user(&req, argp, sizeof(req)))
+			return -EFAULT;
+
+		if (!req.num || req.num > f->npwm || req.reserved)
+			return -EINVAL;
+
+		states = memdup_user((void __user *)(uintptr_t)req.states,
+				     req.num * sizeof(*states));
+		if (IS_ERR(states))
+			return PTR_ERR(states);
+
+		mutex_lock(&f->lock);
+		ret = pwm_cdev_set_states(f, states, req.num);
+		mutex_unlock(&f->lock);
+
+		kfree(states);
+		return ret;
+	}
+
+	return -ENOTTY;
+}
+
+static int pwm_cdev_open(struct inode *inode, struct file *filp)
+{
+	struct pwm_cdev_file *f;
+	struct pwm_chip *chip;
+	int ret = 0;
+
+	mutex_lock(&pwm_cdev_lock);
+
+	chip = idr_find(&pwm_cdev_idr, iminor(inode));
+	if (!chip) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	f = kzalloc(sizeof(*f) + chip->npwm * sizeof(f->pwms[0]), GFP_KERNEL);
+	if (!f) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	mutex_init(&f->lock);
+	f->base = chip->base;
+	f->npwm = chip->npwm;
+	filp->private_data = f;
+
+out:
+	mutex_unlock(&pwm_cdev_lock);
+	return ret ? : nonseekable_open(inode, filp);
+}
+
+static int pwm_cdev_release(struct inode *inode, struct file *filp)
+{
+	struct pwm_cdev_file *f = filp->private_data;
+	unsigned int i;
+
+	for (i = 0; i < f->npwm; i++)
+		if (f->pwms[i])
+			pwm_put(f->pwms[i]);
+
+	mutex_destroy(&f->lock);
+	kfree(f);
+
+	return 0;
+}
+
+static const struct file_operations pwm_cdev_fops = {
+	.owner = THIS_MODULE,
+	.open = pwm_cdev_open,
+	.release = pwm_cdev_release,
+	.unlocked_ioctl = pwm_cdev_ioctl,
+	.compat_ioctl = pwm_cdev_ioctl,
+	.llseek = no_llseek,
+};
+
+static dev_t pwm_cdev_add(struct pwm_chip *chip)
+{
+	int minor;
+
+	if (!pwm_cdev_devt)
+		return MKDEV(0, 0);
+
+	mutex_lock(&pwm_cdev_lock);
+	minor = idr_alloc(&pwm_cdev_idr, chip, 0, PWM_CDEV_MINORS, GFP_KERNEL);
+	mutex_unlock(&pwm_cdev_lock);
+
+	if (minor < 0)
+		return MKDEV(0, 0);
+
+	return MKDEV(MAJOR(pwm_cdev_devt), minor);
+}
+
+static void pwm_cdev_remove(dev_t devt)
+{
+	if (!devt)
+		return;
+
+	mutex_lock(&pwm_cdev_lock);
+	idr_remove(&pwm_cdev_idr, MINOR(devt));
+	mutex_unlock(&pwm_cdev_lock);
+}
+
 static int pwmchip_sysfs_match(struct device *parent, const void *data)
 {
 	return dev_get_drvdata(parent) == data;
@@ -314,14 +591,17 @@ static int pwmchip_sysfs_match(struct device *parent, const void *data)
 void pwmchip_sysfs_export(struct pwm_chip *chip)
 {
 	struct device *parent;
+	dev_t devt;
 
 	/*
 	 * If device_create() fails the pwm_chip is still usable by
 	 * the kernel its just not exported.
 	 */
-	parent = device_create(&pwm_class, chip->dev, MKDEV(0, 0), chip,
+	devt = pwm_cdev_add(chip);
+	parent = device_create(&pwm_class, chip->dev, devt, chip,
 			       "pwmchip%d", chip->base);
 	if (IS_ERR(parent)) {
+		pwm_cdev_remove(devt);
 		dev_warn(chip->dev,
 			 "device_create failed for pwm_chip sysfs export\n");
 	}
@@ -334,6 +614,7 @@ void pwmchip_sysfs_unexport(struct pwm_chip *chip)
 	parent = class_find_device(&pwm_class, NULL, chip,
 				   pwmchip_sysfs_match);
 	if (parent) {
+		pwm_cdev_remove(parent->devt);
 		/* for class_find_device() */
 		put_device(parent);
 		device_unregister(parent);
@@ -342,6 +623,22 @@ void pwmchip_sysfs_unexport(struct pwm_chip *chip)
 
 static int __init pwm_sysfs_init(void)
 {
-	return class_register(&pwm_class);
+	int ret;
+
+	ret = class_register(&pwm_class);
+	if (ret)
+		return ret;
+
+	/* without the character devices the sysfs interface still works */
+	if (alloc_chrdev_region(&pwm_cdev_devt, 0, PWM_CDEV_MINORS, "pwm"))
+		return 0;
+
+	cdev_init(&pwm_cdev, &pwm_cdev_fops);
+	if (cdev_add(&pwm_cdev, pwm_cdev_devt, PWM_CDEV_MINORS)) {
+		unregister_chrdev_region(pwm_cdev_devt, PWM_CDEV_MINORS);
+		pwm_cdev_devt = 0;
+	}
+
+	return 0;
 }
 subsys_initcall(pwm_sysfs_init);
@@ -21,8 +21,12 @@
 #include <linux/module.h>
 #include <linux/bitops.h>
 #include <linux/debugfs.h>
+#include <linux/firmware.h>
+#include <linux/hrtimer.h>
 #include <linux/of_device.h>
 #include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irqdomain.h>
 #include <linux/pm_runtime.h>
 #include <linux/virtio.h>
 #include <linux/dma-mapping.h>
@@ -103,6 +107,12 @@
 /* HIPIR register bit-fields */
 #define INTC_HIPIR_NONE_HINT	0x80000000
 
+/* number of samples kept in the profiler trace ring */
+#define PRU_PROF_RING_SIZE	1024
+
+/* the cycle and stall counters are folded into 64 bits past this value */
+#define PRU_PROF_CTR_FOLD	0x80000000
+
 /**
  * enum pruss_mem - PRUSS memory range identifiers
  */
@@ -169,6 +179,48 @@ struct pruss_match_private_data {
 	struct pruss_private_data *priv_data;
 };
 
+/**
+ * struct pru_prof_sample - a single profiler sample
+ * @pc: program counter (instruction word address)
+ * @cycle: CYCLE register value
+ * @stall: STALL register value
+ */
+struct pru_prof_sample {
+	u32 pc;
+	u32 cycle;
+	u32 stall;
+};
+
+/**
+ * struct pru_profile - PRU sampling profiler state
+ * @timer: sampling timer
+ * @period: sampling period, zero while the profiler is stopped
+ * @mutex: serializes starting and stopping against the debugfs readers
+ * @lock: protects the sample buffers and counters
+ * @hist: per instruction word sample counts
+ * @hist_size: number of entries in @hist
+ * @ring: the last PRU_PROF_RING_SIZE samples
+ * @head: total number of samples stored in @ring
+ * @samples: number of samples taken while the PRU was running
+ * @halted: number of samples taken while the PRU was halted or sleeping
+ * @cycles: cycles counted since the profiler was started
+ * @stalls: stall cycles counted since the profiler was started
+ */
+struct pru_profile {
+	struct hrtimer timer;
+	ktime_t period;
+	struct mutex mutex;
+	spinlock_t lock;
+	u32 *hist;
+	u32 hist_size;
+	struct pru_prof_sample *ring;
+	u32 head;
+	u32 samples;
+	u32 halted;
+	u64 cycles;
+	u64 stalls;
+};
+
 struct pru_rproc;
 
 /**
@@ -181,6 +233,10 @@ struct pru_rproc;
  * @irqs: pointer to an array of interrupts to the host processor
  * @sysev_to_ch: system events to channel mapping information
  * @ch_to_host: interrupt channel to host interrupt information
+ * @vring_pru: PRU cores signalling vrings through a given system event
+ * @vring_pending: system events with vring notifications not yet handled
+ * @domain: irq domain exposing the system events to kernel consumers
+ * @intc_lock: serializes the INTC channel and host map programming
  */
 struct pruss {
 	struct platform_device *pdev;
@@ -191,6 +247,10 @@ struct pruss {
 	int *irqs;
 	int sysev_to_ch[MAX_PRU_SYS_EVENTS];
 	int ch_to_host[MAX_PRU_CHANNELS];
+	struct pru_rproc *vring_pru[MAX_PRU_SYS_EVENTS];
+	DECLARE_BITMAP(vring_pending, MAX_PRU_SYS_EVENTS);
+	struct irq_domain *domain;
+	struct mutex intc_lock;
 };
 
 /**
@@ -200,6 +260,8 @@ struct pruss {
  * @rproc: remoteproc pointer for this PRU core
  * @mbox: mailbox channel handle used for vring signalling with MPU
  * @client: mailbox client to request the mailbox channel
+ * @kick_evt: system event raised to kick the PRU, -1 if using the mailbox
+ * @vring_evt: system event raised by the PRU to signal its vrings
  * @mem_va: kernel virtual addresses for each of the PRU memory regions
  * @mem_pa: physical addresses for each of the PRU memory regions
  * @mem_size: size of each of the PRU memory regions
@@ -210,6 +272,9 @@ struct pruss {
  * @fw_name: name of firmware image used during loading
  * @dbg_single_step: debug flag to set PRU into single step mode
  * @dbg_continuous: debug flag to restore PRU execution mode
+ * @fw_cache: firmware images kept around for fast reloading
+ * @fw_cache_lock: protects @fw_cache
+ * @prof: sampling profiler state
  */
 struct pru_rproc {
 	int id;
@@ -217,6 +282,8 @@ struct pru_rproc {
 	struct rproc *rproc;
 	struct mbox_chan *mbox;
 	struct mbox_client client;
+	int kick_evt;
+	int vring_evt;
 	void __iomem *mem_va[PRU_MEM_MAX];
 	phys_addr_t mem_pa[PRU_MEM_MAX];
 	size_t mem_size[PRU_MEM_MAX];
@@ -227,6 +294,21 @@ struct pru_rproc {
 	const char *fw_name;
 	u32 dbg_single_step;
 	u32 dbg_continuous;
+	struct list_head fw_cache;
+	struct mutex fw_cache_lock;
+	struct pru_profile prof;
+};
+
+/**
+ * struct pru_fw_cache_entry - cached PRU firmware image
+ * @node: entry in the fw_cache list of the PRU
+ * @fw: the firmware image
+ * @name: name the image was requested with
+ */
+struct pru_fw_cache_entry {
+	struct list_head node;
+	const struct firmware *fw;
+	char name[0];
 };
 
 static inline u32 pruss_intc_read_reg(struct pruss *pruss, unsigned int reg)
@@ -440,6 +522,241 @@ static int pru_rproc_debug_ss_get(void *data, u64 *val)
 DEFINE_SIMPLE_ATTRIBUTE(pru_rproc_debug_ss_fops, pru_rproc_debug_ss_get,
 			pru_rproc_debug_ss_set, "%llu\n");
 
+/* move the hardware counters into the 64-bit totals and restart them */
+static void pru_rproc_prof_fold(struct pru_rproc *pru)
+{
+	struct pru_profile *prof = &pru->prof;
+	u32 ctrl = pru_control_read_reg(pru, PRU_CTRL_CTRL);
+
+	/* the counters can only be written while disabled */
+	pru_control_write_reg(pru, PRU_CTRL_CTRL, ctrl & ~CTRL_CTRL_CTR_EN);
+	prof->cycles += pru_control_read_reg(pru, PRU_CTRL_CYCLE);
+	prof->stalls += pru_control_read_reg(pru, PRU_CTRL_STALL);
+	pru_control_write_reg(pru, PRU_CTRL_CYCLE, 0);
+	pru_control_write_reg(pru, PRU_CTRL_STALL, 0);
+	pru_control_write_reg(pru, PRU_CTRL_CTRL, ctrl | CTRL_CTRL_CTR_EN);
+}
+
+static enum hrtimer_restart pru_rproc_prof_sample(struct hrtimer *timer)
+{
+	struct pru_profile *prof = container_of(timer, struct pru_profile,
+						timer);
+	struct pru_rproc *pru = container_of(prof, struct pru_rproc, prof);
+	struct pru_prof_sample *sample;
+	u32 ctrl, pc;
+
+	spin_lock(&prof->lock);
+
+	ctrl = pru_control_read_reg(pru, PRU_CTRL_CTRL);
+	pc = pru_control_read_reg(pru, PRU_CTRL_STS) & 0xffff;
+
+	sample = &prof->ring[prof->head++ % PRU_PROF_RING_SIZE];
+	sample->pc = pc;
+	sample->cycle = pru_control_read_reg(pru, PRU_CTRL_CYCLE);
+	sample->stall = pru_control_read_reg(pru, PRU_CTRL_STALL);
+
+	if (!(ctrl & CTRL_CTRL_RUNSTATE) || (ctrl & CTRL_CTRL_SLEEPING)) {
+		prof->halted++;
+	} else {
+		prof->samples++;
+		if (pc < prof->hist_size)
+			prof->hist[pc]++;
+	}
+
+	if (sample->cycle >= PRU_PROF_CTR_FOLD)
+		pru_rproc_prof_fold(pru);
+
+	spin_unlock(&prof->lock);
+
+	hrtimer_forward_now(timer, prof->period);
+	return HRTIMER_RESTART;
+}
+
+static void pru_rproc_prof_stop(struct pru_rproc *pru)
+{
+	struct pru_profile *prof = &pru->prof;
+
+	if (!prof->period.tv64)
+		return;
+
+	hrtimer_cancel(&prof->timer);
+	prof->period = ktime_set(0, 0);
+}
+
+/*
+ * Start the profiler with a new sampling period, clearing the previous
+ * results and restarting the PRU cycle and stall counters.
+ */
+static int pru_rproc_prof_start(struct pru_rproc *pru, u64 period_us)
+{
+	struct pru_profile *prof = &pru->prof;
+	struct pru_prof_sample *ring;
+	u32 *hist;
+	u32 hist_size = pru->mem_size[PRU_MEM_IRAM] / sizeof(u32);
+
+	pru_rproc_prof_stop(pru);
+
+	hist = kcalloc(hist_size, sizeof(*hist), GFP_KERNEL);
+	ring = kcalloc(PRU_PROF_RING_SIZE, sizeof(*ring), GFP_KERNEL);
+	if (!hist || !ring) {
+		kfree(hist);
+		kfree(ring);
+		return -ENOMEM;
+	}
+
+	spin_lock_irq(&prof->lock);
+	kfree(prof->hist);
+	kfree(prof->ring);
+	prof->hist = hist;
+	prof->hist_size = hist_size;
+	prof->ring = ring;
+	prof->head = 0;
+	prof->samples = 0;
+	prof->halted = 0;
+	pru_rproc_prof_fold(pru);
+	prof->cycles = 0;
+	prof->stalls = 0;
+	spin_unlock_irq(&prof->lock);
+
+	prof->period = ns_to_ktime(period_us * NSEC_PER_USEC);
+	hrtimer_start(&prof->timer, prof->period, HRTIMER_MODE_REL);
+
+	return 0;
+}
+
+/*
+ * Control the PRU sampling profiler
+ *
+ * Writing a sampling period in microseconds (re)starts the profiler, which
+ * snapshots the PRU program counter, CYCLE and STALL registers on every
+ * period. Writing 0 stops it, keeping the results readable in the
+ * profile_pc and profile_trace files.
+ */
+static int pru_rproc_debug_prof_set(void *data, u64 val)
+{
+	struct rproc *rproc = data;
+	struct pru_rproc *pru = rproc->priv;
+	int ret = 0;
+
+	/* don't let the sampling timer hog the MPU */
+	if (val && val < 10)
+		return -EINVAL;
+
+	mutex_lock(&pru->prof.mutex);
+	if (val)
+		ret = pru_rproc_prof_start(pru, val);
+	else
+		pru_rproc_prof_stop(pru);
+	mutex_unlock(&pru->prof.mutex);
+
+	return ret;
+}
+
+static int pru_rproc_debug_prof_get(void *data, u64 *val)
+{
+	struct rproc *rproc = data;
+	struct pru_rproc *pru = rproc->priv;
+
+	*val = ktime_to_us(pru->prof.period);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(pru_rproc_debug_prof_fops, pru_rproc_debug_prof_get,
+			pru_rproc_debug_prof_set, "%llu\n");
+
+/* PC histogram, one line per sampled instruction word address */
+static int pru_rproc_debug_read_prof_pc(struct seq_file *s, void *data)
+{
+	struct rproc *rproc = s->private;
+	struct pru_rproc *pru = rproc->priv;
+	struct pru_profile *prof = &pru->prof;
+	u64 cycles, stalls;
+	u32 i;
+
+	mutex_lock(&prof->mutex);
+	if (!prof->hist)
+		goto unlock;
+
+	spin_lock_irq(&prof->lock);
+	cycles = prof->cycles + pru_control_read_reg(pru, PRU_CTRL_CYCLE);
+	stalls = prof->stalls + pru_control_read_reg(pru, PRU_CTRL_STALL);
+	spin_unlock_irq(&prof->lock);
+
+	seq_printf(s, "cycles: %llu\nstalls: %llu\n", cycles, stalls);
+	seq_printf(s, "samples: %u\nhalted: %u\n", prof->samples,
+		   prof->halted);
+
+	for (i = 0; i < prof->hist_size; i++) {
+		if (prof->hist[i])
+			seq_printf(s, "0x%04x %u\n", i, prof->hist[i]);
+	}
+
+unlock:
+	mutex_unlock(&prof->mutex);
+	return 0;
+}
+
+static int pru_rproc_debug_prof_pc_open(struct inode *inode,
+					struct file *file)
+{
+	return single_open(file, pru_rproc_debug_read_prof_pc,
+			   inode->i_private);
+}
+
+static const struct file_operations pru_rproc_debug_prof_pc_ops = {
+	.open = pru_rproc_debug_prof_pc_open,
+	.read = seq_read,
+	.llseek	= seq_lseek,
+	.release = single_release,
+};
+
+/* the last samples, oldest first */
+static int pru_rproc_debug_read_prof_trace(struct seq_file *s, void *data)
+{
+	struct rproc *rproc = s->private;
+	struct pru_rproc *pru = rproc->priv;
+	struct pru_profile *prof = &pru->prof;
+	struct pru_prof_sample *ring, sample;
+	u32 i, head;
+
+	mutex_lock(&prof->mutex);
+
+	spin_lock_irq(&prof->lock);
+	ring = prof->ring;
+	head = prof->head;
+	spin_unlock_irq(&prof->lock);
+
+	if (!ring)
+		goto unlock;
+
+	seq_puts(s, "pc     cycle      stall\n");
+	i = head > PRU_PROF_RING_SIZE ? head - PRU_PROF_RING_SIZE : 0;
+	for (; i != head; i++) {
+		spin_lock_irq(&prof->lock);
+		sample = ring[i % PRU_PROF_RING_SIZE];
+		spin_unlock_irq(&prof->lock);
+		seq_printf(s, "0x%04x 0x%08x 0x%08x\n", sample.pc,
+			   sample.cycle, sample.stall);
+	}
+
+unlock:
+	mutex_unlock(&prof->mutex);
+	return 0;
+}
+
+static int pru_rproc_debug_prof_trace_open(struct inode *inode,
+					   struct file *file)
+{
+	return single_open(file, pru_rproc_debug_read_prof_trace,
+			   inode->i_private);
+}
+
+static const struct file_operations pru_rproc_debug_prof_trace_ops = {
+	.open = pru_rproc_debug_prof_trace_open,
+	.read = seq_read,
+	.llseek	= seq_lseek,
+	.release = single_release,
+};
+
 /*
  * Create PRU-specific debugfs entries
  *
@@ -455,6 +772,12 @@ static void pru_rproc_create_debug_entries(struct rproc *rproc)
 			    rproc, &pru_rproc_debug_regs_ops);
 	debugfs_create_file("single_step", 0600, rproc->dbg_dir,
 			    rproc, &pru_rproc_debug_ss_fops);
+	debugfs_create_file("profile", 0600, rproc->dbg_dir,
+			    rproc, &pru_rproc_debug_prof_fops);
+	debugfs_create_file("profile_pc", 0400, rproc->dbg_dir,
+			    rproc, &pru_rproc_debug_prof_pc_ops);
+	debugfs_create_file("profile_trace", 0400, rproc->dbg_dir,
+			    rproc, &pru_rproc_debug_prof_trace_ops);
 }
 
 static void pruss_init_intc(struct pruss *pruss)
@@ -575,6 +898,111 @@ static void pru_trigger_interrupt(struct rproc *rproc, int sysint)
 		pruss_intc_write_reg(pruss, PRU_INTC_SRSR1, 1 << (sysint - 32));
 }
 
+/*
+ * Route a system event requested through the irq domain to the first MPU
+ * host interrupt, unless a firmware already mapped it. The channel number
+ * used matches the host interrupt number.
+ */
+static void pruss_intc_route_event(struct pruss *pruss, int sysevt)
+{
+	struct device *dev = &pruss->pdev->dev;
+	int ch, host;
+	u32 val;
+
+	mutex_lock(&pruss->intc_lock);
+
+	ch = pruss->sysev_to_ch[sysevt];
+	if (ch < 0) {
+		ch = MIN_PRU_HOST_INT;
+		val = pruss_intc_read_reg(pruss, PRU_INTC_CMR(sysevt / 4));
+		val &= ~(0xfU << ((sysevt & 3) * 8));
+		val |= (u32)ch << ((sysevt & 3) * 8);
+		pruss_intc_write_reg(pruss, PRU_INTC_CMR(sysevt / 4), val);
+		pruss->sysev_to_ch[sysevt] = ch;
+	}
+
+	host = pruss->ch_to_host[ch];
+	if (host < 0) {
+		host = ch;
+		val = pruss_intc_read_reg(pruss, PRU_INTC_HMR(ch / 4));
+		val &= ~(0xfU << ((ch & 3) * 8));
+		val |= (u32)host << ((ch & 3) * 8);
+		pruss_intc_write_reg(pruss, PRU_INTC_HMR(ch / 4), val);
+		pruss->ch_to_host[ch] = host;
+	}
+
+	if (!(pruss->data->host_events & BIT(host)))
+		dev_warn(dev, "SYSEV%d is routed to HOST%d, not reaching MPU\n",
+			 sysevt, host);
+
+	pruss_intc_write_reg(pruss, PRU_INTC_HIEISR, host);
+	pruss_intc_write_reg(pruss, PRU_INTC_GER, 1);
+
+	dev_dbg(dev, "SYSEV%d -> CH%d -> HOST%d for irq domain\n", sysevt, ch,
+		host);
+
+	mutex_unlock(&pruss->intc_lock);
+}
+
+static void pruss_intc_irq_ack(struct irq_data *data)
+{
+	struct pruss *pruss = irq_data_get_irq_chip_data(data);
+
+	pruss_intc_write_reg(pruss, PRU_INTC_SICR, data->hwirq);
+}
+
+static void pruss_intc_irq_mask(struct irq_data *data)
+{
+	struct pruss *pruss = irq_data_get_irq_chip_data(data);
+
+	pruss_intc_write_reg(pruss, PRU_INTC_EICR, data->hwirq);
+}
+
+static void pruss_intc_irq_unmask(struct irq_data *data)
+{
+	struct pruss *pruss = irq_data_get_irq_chip_data(data);
+
+	pruss_intc_write_reg(pruss, PRU_INTC_EISR, data->hwirq);
+}
+
+static struct irq_chip pruss_intc_irq_chip = {
+	.name		= "pruss-intc",
+	.irq_ack	= pruss_intc_irq_ack,
+	.irq_mask	= pruss_intc_irq_mask,
+	.irq_unmask	= pruss_intc_irq_unmask,
+};
+
+static int pruss_intc_irq_domain_map(struct irq_domain *d, unsigned int virq,
+				     irq_hw_number_t hw)
+{
+	struct pruss *pruss = d->host_data;
+
+	pruss_intc_route_event(pruss, hw);
+
+	irq_set_chip_data(virq, pruss);
+	irq_set_chip_and_handler(virq, &pruss_intc_irq_chip, handle_level_irq);
+#ifdef CONFIG_ARM
+	set_irq_flags(virq, IRQF_VALID);
+#else
+	irq_set_noprobe(virq);
+#endif
+
+	return 0;
+}
+
+static void pruss_intc_irq_domain_unmap(struct irq_domain *d,
+					unsigned int virq)
+{
+	irq_set_chip_and_handler(virq, NULL, NULL);
+	irq_set_chip_data(virq, NULL);
+}
+
+static const struct irq_domain_ops pruss_intc_irq_domain_ops = {
+	.map	= pruss_intc_irq_domain_map,
+	.unmap	= pruss_intc_irq_domain_unmap,
+	.xlate	= irq_domain_xlate_onecell,
+};
+
 /**
  * pru_rproc_mbox_callback() - inbound mailbox message handler
  * @client: mailbox client pointer used for requesting the mailbox channel
@@ -602,6 +1030,19 @@ static void pru_rproc_mbox_callback(struct mbox_client *client, void *data)
 		dev_dbg(dev, "no message was found in vqid %d\n", msg);
 }
 
+/*
+ * A PRU signalling through a system event doesn't tell which vring was
+ * kicked, so check all of them.
+ */
+static void pru_rproc_vring_interrupt(struct pru_rproc *pru)
+{
+	struct rproc *rproc = pru->rproc;
+	int i;
+
+	for (i = 0; i <= rproc->max_notifyid; i++)
+		rproc_vq_interrupt(rproc, i);
+}
+
 /* kick a virtqueue */
 static void pru_rproc_kick(struct rproc *rproc, int vq_id)
 {
@@ -611,6 +1052,12 @@ static void pru_rproc_kick(struct rproc *rproc, int vq_id)
 
 	dev_dbg(dev, "kicking vqid %d on PRU%d\n", vq_id, pru->id);
 
+	/* raise the kick event directly, the PRU checks all its vrings */
+	if (pru->kick_evt >= 0) {
+		pru_trigger_interrupt(rproc, pru->kick_evt);
+		return;
+	}
+
 	/* send the index of the triggered virtqueue in the mailbox payload */
 	ret = mbox_send_message(pru->mbox, (void *)vq_id);
 	if (ret < 0)
@@ -627,6 +1074,12 @@ static int pru_rproc_start(struct rproc *rproc)
 	dev_dbg(dev, "starting PRU%d: entry-point = 0x%x\n",
 		pru->id, (rproc->bootaddr >> 2));
 
+	if (pru->kick_evt >= 0 &&
+	    (pru->pruss->sysev_to_ch[pru->kick_evt] < 0 ||
+	     pru->pruss->sysev_to_ch[pru->vring_evt] < 0))
+		dev_warn(dev, "vring system events %d/%d not mapped by the firmware\n",
+			 pru->kick_evt, pru->vring_evt);
+
 	val = CTRL_CTRL_EN | ((rproc->bootaddr >> 2) << 16);
 	pru_control_write_reg(pru, PRU_CTRL_CTRL, val);
 
@@ -653,8 +1106,8 @@ static int pru_rproc_stop(struct rproc *rproc)
  * parse the custom interrupt map resource and configure the INTC
  * appropriately
  */
-static int pru_handle_custom_intrmap(struct rproc *rproc,
-				     struct fw_rsc_custom_intrmap *intr_rsc)
+static int __pru_handle_custom_intrmap(struct rproc *rproc,
+				       struct fw_rsc_custom_intrmap *intr_rsc)
 {
 	struct device *dev = rproc->dev.parent;
 	struct pru_rproc *pru = rproc->priv;
@@ -743,6 +1196,19 @@ static int pru_handle_custom_intrmap(struct rproc *rproc,
 	return ret;
 }
 
+static int pru_handle_custom_intrmap(struct rproc *rproc,
+				     struct fw_rsc_custom_intrmap *intr_rsc)
+{
+	struct pru_rproc *pru = rproc->priv;
+	int ret;
+
+	mutex_lock(&pru->pruss->intc_lock);
+	ret = __pru_handle_custom_intrmap(rproc, intr_rsc);
+	mutex_unlock(&pru->pruss->intc_lock);
+
+	return ret;
+}
+
 /* PRU-specific post loading custom resource handler */
 static int pru_rproc_handle_custom_rsc(struct rproc *rproc,
 				       struct fw_rsc_custom *rsc)
@@ -790,6 +1256,100 @@ static struct rproc_ops pru_rproc_ops = {
 	.da_to_va		= pru_da_to_va,
 };
 
+/* look up a firmware image in the cache, requesting it on first use */
+static const struct firmware *pru_rproc_get_fw(struct pru_rproc *pru,
+					       const char *name)
+{
+	struct device *dev = pru->rproc->dev.parent;
+	struct pru_fw_cache_entry *entry;
+	const struct firmware *fw = NULL;
+	int ret;
+
+	mutex_lock(&pru->fw_cache_lock);
+
+	list_for_each_entry(entry, &pru->fw_cache, node) {
+		if (!strcmp(entry->name, name)) {
+			fw = entry->fw;
+			goto unlock;
+		}
+	}
+
+	entry = kzalloc(sizeof(*entry) + strlen(name) + 1, GFP_KERNEL);
+	if (!entry) {
+		fw = ERR_PTR(-ENOMEM);
+		goto unlock;
+	}
+
+	ret = request_firmware(&entry->fw, name, dev);
+	if (ret) {
+		dev_err(dev, "request_firmware %s failed: %d\n", name, ret);
+		kfree(entry);
+		fw = ERR_PTR(ret);
+		goto unlock;
+	}
+
+	strcpy(entry->name, name);
+	list_add(&entry->node, &pru->fw_cache);
+	fw = entry->fw;
+
+unlock:
+	mutex_unlock(&pru->fw_cache_lock);
+	return fw;
+}
+
+static void pru_rproc_free_fw_cache(struct pru_rproc *pru)
+{
+	struct pru_fw_cache_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, &pru->fw_cache, node) {
+		list_del(&entry->node);
+		release_firmware(entry->fw);
+		kfree(entry);
+	}
+}
+
+/*
+ * Writing a firmware name to "reload" swaps the program of the running PRU
+ * core, keeping its vrings, rpmsg channels and INTC configuration, see
+ * rproc_reload(). Images are cached after the first use.
+ */
+static ssize_t reload_store(struct device *dev, struct device_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct rproc *rproc = platform_get_drvdata(to_platform_device(dev));
+	struct pru_rproc *pru = rproc->priv;
+	const struct firmware *fw;
+	char *name;
+	int ret;
+
+	name = kstrndup(buf, count, GFP_KERNEL);
+	if (!name)
+		return -ENOMEM;
+
+	fw = pru_rproc_get_fw(pru, strim(name));
+	kfree(name);
+	if (IS_ERR(fw))
+		return PTR_ERR(fw);
+
+	/* the cache is only ever freed on remove, keeping fw valid */
+	ret = rproc_reload(rproc, fw);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_WO(reload);
+
+/* stop routing the PRU's vring event, and wait for a running handler */
+static void pru_rproc_release_vring_evt(struct pru_rproc *pru)
+{
+	struct pruss *pruss = pru->pruss;
+	int i;
+
+	pruss->vring_pru[pru->vring_evt] = NULL;
+	for (i = 0; i < pruss->data->num_irqs; i++)
+		synchronize_irq(pruss->irqs[i]);
+	clear_bit(pru->vring_evt, pruss->vring_pending);
+}
+
 static const struct of_device_id pru_rproc_match[];
 
 static const struct pru_private_data *pru_rproc_get_private_data(
@@ -822,6 +1382,7 @@ static int pru_rproc_probe(struct platform_device *pdev)
 	struct mbox_client *client;
 	struct resource *res;
 	int i, ret;
+	u32 sysevts[2];
 	const char *mem_names[PRU_MEM_MAX] = { "iram", "control", "debug" };
 
 	if (!np) {
@@ -849,6 +1410,12 @@ static int pru_rproc_probe(struct platform_device *pdev)
 	pru->pruss = platform_get_drvdata(ppdev);
 	pru->rproc = rproc;
 	pru->fw_name = pdata->fw_name;
+	INIT_LIST_HEAD(&pru->fw_cache);
+	mutex_init(&pru->fw_cache_lock);
+	mutex_init(&pru->prof.mutex);
+	spin_lock_init(&pru->prof.lock);
+	hrtimer_init(&pru->prof.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	pru->prof.timer.function = pru_rproc_prof_sample;
 
 	/* XXX: get this from match data if different in the future */
 	pru->iram_da = 0;
@@ -875,17 +1442,42 @@ static int pru_rproc_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, rproc);
 
-	client = &pru->client;
-	client->dev = dev;
-	client->tx_done = NULL;
-	client->rx_callback = pru_rproc_mbox_callback;
-	client->tx_block = false;
-	client->knows_txdone = false;
-	pru->mbox = mbox_request_channel(client, 0);
-	if (IS_ERR(pru->mbox)) {
-		ret = PTR_ERR(pru->mbox);
-		dev_err(dev, "mbox_request_channel failed: %d\n", ret);
-		goto free_rproc;
+	/*
+	 * The optional "ti,vring-sysevents" property selects signalling of
+	 * the vrings through a pair of PRUSS system events, <kick vring>,
+	 * instead of the mailbox. The PRU is kicked by raising the first
+	 * event and signals back with the second one, which the firmware
+	 * has to route to a host interrupt of the MPU.
+	 */
+	pru->kick_evt = -1;
+	pru->vring_evt = -1;
+	if (of_find_property(np, "ti,vring-sysevents", NULL)) {
+		ret = of_property_read_u32_array(np, "ti,vring-sysevents",
+						 sysevts, 2);
+		if (ret || sysevts[0] >= MAX_PRU_SYS_EVENTS ||
+		    sysevts[1] >= MAX_PRU_SYS_EVENTS ||
+		    sysevts[0] == sysevts[1] ||
+		    pru->pruss->vring_pru[sysevts[1]]) {
+			dev_err(dev, "invalid ti,vring-sysevents\n");
+			ret = -EINVAL;
+			goto free_rproc;
+		}
+		pru->kick_evt = sysevts[0];
+		pru->vring_evt = sysevts[1];
+		pru->pruss->vring_pru[pru->vring_evt] = pru;
+	} else {
+		client = &pru->client;
+		client->dev = dev;
+		client->tx_done = NULL;
+		client->rx_callback = pru_rproc_mbox_callback;
+		client->tx_block = false;
+		client->knows_txdone = false;
+		pru->mbox = mbox_request_channel(client, 0);
+		if (IS_ERR(pru->mbox)) {
+			ret = PTR_ERR(pru->mbox);
+			dev_err(dev, "mbox_request_channel failed: %d\n", ret);
+			goto free_rproc;
+		}
 	}
 
 	ret = rproc_add(pru->rproc);
@@ -896,6 +1488,10 @@ static int pru_rproc_probe(struct platform_device *pdev)
 
 	pru_rproc_create_debug_entries(rproc);
 
+	ret = device_create_file(dev, &dev_attr_reload);
+	if (ret)
+		dev_warn(dev, "failed to create reload attribute: %d\n", ret);
+
 	/*
 	 * rproc_add will boot the processor if the corresponding PRU
 	 * has a virtio device published in its resource table. If not
@@ -912,17 +1508,18 @@ static int pru_rproc_probe(struct platform_device *pdev)
 		}
 	}
 
-	/* suppress unused function warning */
-	(void)pru_trigger_interrupt;
-
 	dev_info(dev, "PRU rproc node %s probed successfully\n", np->full_name);
 
 	return 0;
 
 del_rproc:
+	device_remove_file(dev, &dev_attr_reload);
 	rproc_del(pru->rproc);
 put_mbox:
-	mbox_free_channel(pru->mbox);
+	if (pru->mbox)
+		mbox_free_channel(pru->mbox);
+	else
+		pru_rproc_release_vring_evt(pru);
 free_rproc:
 	rproc_put(rproc);
 	return ret;
@@ -936,14 +1533,23 @@ static int pru_rproc_remove(struct platform_device *pdev)
 
 	dev_info(dev, "%s: removing rproc %s\n", __func__, rproc->name);
 
+	device_remove_file(dev, &dev_attr_reload);
+	pru_rproc_prof_stop(pru);
+
 	if (list_empty(&pru->rproc->rvdevs)) {
 		dev_info(dev, "stopping the manually booted PRU core\n");
 		rproc_shutdown(pru->rproc);
 	}
 
-	mbox_free_channel(pru->mbox);
+	if (pru->mbox)
+		mbox_free_channel(pru->mbox);
+	else
+		pru_rproc_release_vring_evt(pru);
 
 	rproc_del(rproc);
+	pru_rproc_free_fw_cache(pru);
+	kfree(pru->prof.hist);
+	kfree(pru->prof.ring);
 	rproc_put(rproc);
 
 	return 0;
@@ -951,7 +1557,10 @@ static int pru_rproc_remove(struct platform_device *pdev)
 
 /*
  * Interrupt Handler for all PRUSS MPU interrupts
- * XXX: Enhance with event listener notifications
+ *
+ * System events mapped through the irq domain are dispatched to their own
+ * Linux interrupts, vring events are deferred to the thread and any other
+ * event is simply cleared.
  */
 static irqreturn_t pruss_handler(int irq, void *data)
 {
@@ -960,6 +1569,9 @@ static irqreturn_t pruss_handler(int irq, void *data)
 	int intr_bit = irq - pruss->irqs[0] + MIN_PRU_HOST_INT;
 	int intr_mask = (1 << intr_bit);
 	static int evt_mask = MAX_PRU_SYS_EVENTS - 1;
+	irqreturn_t ret = IRQ_NONE;
+	unsigned int virq;
+	int i;
 
 	/* check whether the interrupt can reach MPU */
 	if (!(intr_mask & pruss->data->host_events))
@@ -970,18 +1582,54 @@ static irqreturn_t pruss_handler(int irq, void *data)
 	if (!(val & intr_mask))
 		return IRQ_NONE;
 
-	/* check non-pending bit of specific host interrupt */
-	val = pruss_intc_read_reg(pruss, PRU_INTC_HIPIR(intr_bit));
-	if (val & INTC_HIPIR_NONE_HINT)
-		return IRQ_NONE;
+	for (i = 0; i < MAX_PRU_SYS_EVENTS; i++) {
+		/* check non-pending bit of specific host interrupt */
+		val = pruss_intc_read_reg(pruss, PRU_INTC_HIPIR(intr_bit));
+		if (val & INTC_HIPIR_NONE_HINT)
+			break;
 
-	/* clear system event */
-	sys_evt = val & evt_mask;
-	if (sys_evt < 32)
-		pruss_intc_write_reg(pruss, PRU_INTC_SECR0, 1 << sys_evt);
-	else
-		pruss_intc_write_reg(pruss, PRU_INTC_SECR1,
-				     1 << (sys_evt - 32));
+		sys_evt = val & evt_mask;
+		if (ret == IRQ_NONE)
+			ret = IRQ_HANDLED;
+
+		virq = irq_find_mapping(pruss->domain, sys_evt);
+		if (virq) {
+			generic_handle_irq(virq);
+			continue;
+		}
+
+		/* clear system event */
+		if (sys_evt < 32)
+			pruss_intc_write_reg(pruss, PRU_INTC_SECR0,
+					     1 << sys_evt);
+		else
+			pruss_intc_write_reg(pruss, PRU_INTC_SECR1,
+					     1 << (sys_evt - 32));
+
+		/* vring notifications need process context, defer them */
+		if (pruss->vring_pru[sys_evt]) {
+			set_bit(sys_evt, pruss->vring_pending);
+			ret = IRQ_WAKE_THREAD;
+		}
+	}
+
+	return ret;
+}
+
+static irqreturn_t pruss_vring_thread(int irq, void *data)
+{
+	struct pruss *pruss = data;
+	struct pru_rproc *pru;
+	int sys_evt;
+
+	for_each_set_bit(sys_evt, pruss->vring_pending, MAX_PRU_SYS_EVENTS) {
+		if (!test_and_clear_bit(sys_evt, pruss->vring_pending))
+			continue;
+
+		pru = pruss->vring_pru[sys_evt];
+		if (pru)
+			pru_rproc_vring_interrupt(pru);
+	}
 
 	return IRQ_HANDLED;
 }
@@ -1117,14 +1765,25 @@ static int pruss_probe(struct platform_device *pdev)
 
 	for (i = 0; i < num_irqs; i++) {
 		irq = pruss->irqs[i];
-		err = devm_request_irq(dev, irq, pruss_handler, 0,
-				       dev_name(dev), pruss);
+		err = devm_request_threaded_irq(dev, irq, pruss_handler,
+						pruss_vring_thread, 0,
+						dev_name(dev), pruss);
 		if (err) {
 			dev_err(dev, "failed to register irq %d\n", irq);
 			goto err_irq_fail;
 		}
 	}
 
+	mutex_init(&pruss->intc_lock);
+	pruss->domain = irq_domain_add_linear(node, MAX_PRU_SYS_EVENTS,
+					      &pruss_intc_irq_domain_ops,
+					      pruss);
+	if (!pruss->domain) {
+		dev_err(dev, "failed to create irq domain\n");
+		err = -ENOMEM;
+		goto err_irq_fail;
+	}
+
 	platform_set_drvdata(pdev, pruss);
 
 	dev_info(&pdev->dev, "creating platform devices for PRU cores\n");
@@ -1150,10 +1809,19 @@ static int pruss_remove(struct platform_device *pdev)
 	struct device *dev = &pdev->dev;
 	struct pruss_platform_data *pdata = dev_get_platdata(dev);
 	struct pruss *pruss = platform_get_drvdata(pdev);
+	int i;
 
 	dev_info(dev, "remove platform devices for PRU cores\n");
 	of_platform_depopulate(dev);
 
+	/* the handler dispatches into the domain, release it first */
+	for (i = 0; i < pruss->data->num_irqs; i++)
+		devm_free_irq(dev, pruss->irqs[i], pruss);
+
+	for (i = 0; i < MAX_PRU_SYS_EVENTS; i++)
+		irq_dispose_mapping(irq_find_mapping(pruss->domain, i));
+	irq_domain_remove(pruss->domain);
+
 	pm_runtime_put_sync(dev);
 	pm_runtime_disable(dev);
 	if (pruss->data->has_reset)
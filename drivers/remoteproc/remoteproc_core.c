@@ -57,6 +57,16 @@ typedef int (*rproc_handle_resource_t)(struct rproc *rproc,
 /* Unique indices for remoteproc devices */
 static DEFINE_IDA(rproc_dev_index);
 
+/*
+ * Keep the firmware image of a remote processor after it booted, so that
+ * restarts (including crash recovery) don't have to request it again. A
+ * cached image is dropped on the next boot once caching is turned off.
+ */
+static bool fw_cache;
+module_param(fw_cache, bool, 0644);
+MODULE_PARM_DESC(fw_cache,
+		 "Keep firmware images in memory across rproc restarts");
+
 static const char * const rproc_crash_names[] = {
 	[RPROC_MMUFAULT]	= "mmufault",
 	[RPROC_WATCHDOG]	= "watchdog",
@@ -1453,15 +1463,24 @@ int rproc_boot(struct rproc *rproc)
 	dev_info(dev, "powering up %s\n", rproc->name);
 
 	/* load firmware */
-	ret = request_firmware(&firmware_p, rproc->firmware, dev);
-	if (ret < 0) {
-		dev_err(dev, "request_firmware failed: %d\n", ret);
-		goto downref_rproc;
+	if (rproc->cached_fw) {
+		firmware_p = rproc->cached_fw;
+	} else {
+		ret = request_firmware(&firmware_p, rproc->firmware, dev);
+		if (ret < 0) {
+			dev_err(dev, "request_firmware failed: %d\n", ret);
+			goto downref_rproc;
+		}
 	}
 
 	ret = rproc_fw_boot(rproc, firmware_p);
 
-	release_firmware(firmware_p);
+	if (!ret && fw_cache) {
+		rproc->cached_fw = firmware_p;
+	} else {
+		rproc->cached_fw = NULL;
+		release_firmware(firmware_p);
+	}
 
 downref_rproc:
 	if (ret) {
@@ -1539,6 +1558,109 @@ out:
 }
 EXPORT_SYMBOL(rproc_shutdown);
 
+/**
+ * rproc_reload() - replace the firmware of a running remote processor
+ * @rproc: the remote processor
+ * @fw: the new firmware image
+ *
+ * Halt @rproc, load the program segments of @fw and restart it, without
+ * tearing down the resources and virtio devices set up at boot. This is
+ * only possible if @fw carries the same resource table as the firmware
+ * @rproc was booted with. The live resource table, including the vring
+ * addresses and virtio status, is carried over into the new image, so
+ * the new firmware must pick up the vrings where the old one left them.
+ *
+ * The post-loading resource handlers are not run again, any configuration
+ * they did for the previous image (e.g. interrupt routing) is kept.
+ *
+ * Returns 0 on success, -EINVAL if the remote processor isn't running or
+ * the resource table changed (a full rproc_shutdown()/rproc_boot() cycle
+ * is required then), or another appropriate error value. If loading fails
+ * after the remote processor was halted, it is left in RPROC_CRASHED state.
+ */
+int rproc_reload(struct rproc *rproc, const struct firmware *fw)
+{
+	struct device *dev = &rproc->dev;
+	struct resource_table *table, *loaded_table, *live_table;
+	const char *version;
+	int ret, tablesz, versz;
+
+	ret = mutex_lock_interruptible(&rproc->lock);
+	if (ret) {
+		dev_err(dev, "can't lock rproc %s: %d\n", rproc->name, ret);
+		return ret;
+	}
+
+	if (rproc->state != RPROC_RUNNING) {
+		ret = -EINVAL;
+		goto unlock_mutex;
+	}
+
+	ret = rproc_fw_sanity_check(rproc, fw);
+	if (ret)
+		goto unlock_mutex;
+
+	table = rproc_find_rsc_table(rproc, fw, &tablesz);
+	if (!table || rproc->table_csum != crc32(0, table, tablesz)) {
+		dev_err(dev, "resource table changed, full restart required\n");
+		ret = -EINVAL;
+		goto unlock_mutex;
+	}
+
+	live_table = kmemdup(rproc->table_ptr, tablesz, GFP_KERNEL);
+	if (!live_table) {
+		ret = -ENOMEM;
+		goto unlock_mutex;
+	}
+
+	dev_info(dev, "reloading fw image, size %zd\n", fw->size);
+
+	ret = rproc->ops->stop(rproc);
+	if (ret) {
+		dev_err(dev, "can't stop rproc: %d\n", ret);
+		goto free_table;
+	}
+
+	ret = rproc_load_segments(rproc, fw);
+	if (ret) {
+		dev_err(dev, "Failed to load program segments: %d\n", ret);
+		goto crashed;
+	}
+
+	loaded_table = rproc_find_loaded_rsc_table(rproc, fw);
+	if (!loaded_table) {
+		ret = -EINVAL;
+		goto crashed;
+	}
+	memcpy(loaded_table, live_table, tablesz);
+	rproc->table_ptr = loaded_table;
+
+	kfree(rproc->fw_version);
+	rproc->fw_version = NULL;
+	version = rproc_find_version_info(rproc, fw, &versz);
+	if (version)
+		rproc_handle_fw_version(rproc, version, versz);
+
+	rproc->bootaddr = rproc_get_boot_addr(rproc, fw);
+	ret = rproc->ops->start(rproc);
+	if (ret) {
+		dev_err(dev, "can't start rproc %s: %d\n", rproc->name, ret);
+		goto crashed;
+	}
+
+	dev_info(dev, "remote processor %s reloaded\n", rproc->name);
+	goto free_table;
+
+crashed:
+	rproc->state = RPROC_CRASHED;
+free_table:
+	kfree(live_table);
+unlock_mutex:
+	mutex_unlock(&rproc->lock);
+	return ret;
+}
+EXPORT_SYMBOL(rproc_reload);
+
 /**
  * rproc_get_by_phandle() - find a remote processor by phandle
  * @phandle: phandle to the rproc
@@ -1653,6 +1775,8 @@ static void rproc_type_release(struct device *dev)
 
 	rproc_delete_debug_dir(rproc);
 
+	release_firmware(rproc->cached_fw);
+
 	idr_destroy(&rproc->notifyids);
 
 	if (rproc->index >= 0)
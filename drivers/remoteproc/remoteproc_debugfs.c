@@ -210,6 +210,29 @@ static const struct file_operations rproc_version_ops = {
 	.llseek = generic_file_llseek,
 };
 
+/* expose the statistics of the last firmware load via debugfs */
+static ssize_t rproc_load_read(struct file *filp, char __user *userbuf,
+			       size_t count, loff_t *ppos)
+{
+	struct rproc *rproc = filp->private_data;
+	struct rproc_load_stats *stats = &rproc->load_stats;
+	char buf[128];
+	int i;
+
+	i = scnprintf(buf, sizeof(buf),
+		      "time: %u us\nimage: %s\ncpu: %zu bytes\ndma: %zu bytes\n",
+		      stats->time_us, stats->cached ? "cached" : "requested",
+		      stats->cpu_bytes, stats->dma_bytes);
+
+	return simple_read_from_buffer(userbuf, count, ppos, buf, i);
+}
+
+static const struct file_operations rproc_load_ops = {
+	.read = rproc_load_read,
+	.open = simple_open,
+	.llseek = generic_file_llseek,
+};
+
 void rproc_remove_trace_file(struct dentry *tfile)
 {
 	debugfs_remove(tfile);
@@ -257,6 +280,8 @@ void rproc_create_debug_dir(struct rproc *rproc)
 			    rproc, &rproc_recovery_ops);
 	debugfs_create_file("version", 0400, rproc->dbg_dir,
 			    rproc, &rproc_version_ops);
+	debugfs_create_file("load", 0400, rproc->dbg_dir,
+			    rproc, &rproc_load_ops);
 }
 
 void __init rproc_init_debugfs(void)
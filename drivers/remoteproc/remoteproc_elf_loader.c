@@ -29,9 +29,23 @@
 #include <linux/firmware.h>
 #include <linux/remoteproc.h>
 #include <linux/elf.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/completion.h>
+#include <linux/slab.h>
+#include <linux/sizes.h>
+#include <linux/vmalloc.h>
 
 #include "remoteproc_internal.h"
 
+/* segments at least this big are copied with a dmaengine memcpy channel */
+#define RPROC_DMA_MIN_SIZE	SZ_64K
+#define RPROC_DMA_TIMEOUT_MS	1000
+
+static bool dma_load = true;
+module_param(dma_load, bool, 0644);
+MODULE_PARM_DESC(dma_load, "Copy large firmware segments using a DMA channel");
+
 /**
  * rproc_elf_sanity_check() - Sanity Check ELF firmware image
  * @rproc: the remote processor handle
@@ -118,6 +132,126 @@ u32 rproc_elf_get_boot_addr(struct rproc *rproc, const struct firmware *fw)
 	return ehdr->e_entry;
 }
 
+/*
+ * Only carveouts have a known bus address, other memory the remote processor
+ * code lives in (e.g. ioremapped internal RAM) is always loaded by the CPU.
+ */
+static bool rproc_va_to_dma(struct rproc *rproc, void *va, size_t len,
+			    dma_addr_t *dma)
+{
+	struct rproc_mem_entry *carveout;
+
+	list_for_each_entry(carveout, &rproc->carveouts, node) {
+		size_t offset = va - carveout->va;
+
+		if (va < carveout->va || offset >= carveout->len)
+			continue;
+
+		if (len > carveout->len - offset)
+			return false;
+
+		*dma = carveout->dma + offset;
+		return true;
+	}
+
+	return false;
+}
+
+static void rproc_dma_done(void *param)
+{
+	complete(param);
+}
+
+/*
+ * Copy @len bytes of the firmware image at @src to the bus address @dst.
+ * The image is usually vmalloc()ed, so it is mapped and copied a page at a
+ * time; all the copies are queued up front and only the last one interrupts.
+ */
+static int rproc_dma_copy(struct dma_chan *chan, dma_addr_t dst,
+			  const u8 *src, size_t len)
+{
+	struct device *dma_dev = chan->device->dev;
+	struct dma_async_tx_descriptor *tx;
+	DECLARE_COMPLETION_ONSTACK(done);
+	dma_cookie_t cookie = 0;
+	dma_addr_t *pages;
+	unsigned int i, mapped = 0;
+	size_t off = 0;
+	int ret = 0;
+
+	pages = kcalloc(DIV_ROUND_UP(offset_in_page(src) + len, PAGE_SIZE),
+			sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	while (off < len) {
+		const u8 *p = src + off;
+		size_t chunk = min_t(size_t, len - off,
+				     PAGE_SIZE - offset_in_page(p));
+		unsigned long flags = DMA_CTRL_ACK;
+		struct page *page;
+
+		if (is_vmalloc_addr(p)) {
+			page = vmalloc_to_page(p);
+		} else if (virt_addr_valid(p)) {
+			page = virt_to_page(p);
+		} else {
+			ret = -EINVAL;
+			break;
+		}
+
+		pages[mapped] = dma_map_page(dma_dev, page, 0, PAGE_SIZE,
+					     DMA_TO_DEVICE);
+		if (dma_mapping_error(dma_dev, pages[mapped])) {
+			ret = -ENOMEM;
+			break;
+		}
+		mapped++;
+
+		if (off + chunk == len)
+			flags |= DMA_PREP_INTERRUPT;
+
+		tx = chan->device->device_prep_dma_memcpy(chan, dst + off,
+				pages[mapped - 1] + offset_in_page(p), chunk,
+				flags);
+		if (!tx) {
+			ret = -EIO;
+			break;
+		}
+
+		if (flags & DMA_PREP_INTERRUPT) {
+			tx->callback = rproc_dma_done;
+			tx->callback_param = &done;
+		}
+
+		cookie = dmaengine_submit(tx);
+		if (dma_submit_error(cookie)) {
+			ret = -EIO;
+			break;
+		}
+
+		off += chunk;
+	}
+
+	if (!ret) {
+		dma_async_issue_pending(chan);
+		if (!wait_for_completion_timeout(&done,
+				msecs_to_jiffies(RPROC_DMA_TIMEOUT_MS)) ||
+		    dma_async_is_tx_complete(chan, cookie, NULL, NULL) !=
+		    DMA_COMPLETE)
+			ret = -ETIMEDOUT;
+	}
+
+	if (ret)
+		dmaengine_terminate_all(chan);
+
+	for (i = 0; i < mapped; i++)
+		dma_unmap_page(dma_dev, pages[i], PAGE_SIZE, DMA_TO_DEVICE);
+	kfree(pages);
+
+	return ret;
+}
+
 /**
  * rproc_elf_load_segments() - load firmware segments to memory
  * @rproc: remote processor which will be booted using these fw segments
@@ -141,6 +275,10 @@ u32 rproc_elf_get_boot_addr(struct rproc *rproc, const struct firmware *fw)
  * might be different: they might not have iommus, and would prefer to
  * directly allocate memory for every segment/resource. This is not yet
  * supported, though.
+ *
+ * Segments of at least RPROC_DMA_MIN_SIZE that land in a carveout are
+ * copied with a dmaengine memcpy channel when one is available, falling
+ * back to the CPU if the transfer fails.
  */
 static int
 rproc_elf_load_segments(struct rproc *rproc, const struct firmware *fw)
@@ -150,6 +288,8 @@ rproc_elf_load_segments(struct rproc *rproc, const struct firmware *fw)
 	struct elf32_phdr *phdr;
 	int i, ret = 0;
 	const u8 *elf_data = fw->data;
+	struct dma_chan *chan = NULL;
+	bool dma_tried = false;
 
 	ehdr = (struct elf32_hdr *)elf_data;
 	phdr = (struct elf32_phdr *)(elf_data + ehdr->e_phoff);
@@ -160,6 +300,8 @@ rproc_elf_load_segments(struct rproc *rproc, const struct firmware *fw)
 		u32 memsz = phdr->p_memsz;
 		u32 filesz = phdr->p_filesz;
 		u32 offset = phdr->p_offset;
+		bool copied = false;
+		dma_addr_t dma;
 		void *ptr;
 
 		if (phdr->p_type != PT_LOAD)
@@ -191,9 +333,27 @@ rproc_elf_load_segments(struct rproc *rproc, const struct firmware *fw)
 			break;
 		}
 
+		if (dma_load && filesz >= RPROC_DMA_MIN_SIZE && !dma_tried) {
+			dma_cap_mask_t mask;
+
+			dma_cap_zero(mask);
+			dma_cap_set(DMA_MEMCPY, mask);
+			chan = dma_request_channel(mask, NULL, NULL);
+			dma_tried = true;
+		}
+
 		/* put the segment where the remote processor expects it */
-		if (phdr->p_filesz)
+		if (chan && filesz >= RPROC_DMA_MIN_SIZE &&
+		    rproc_va_to_dma(rproc, ptr, filesz, &dma) &&
+		    !rproc_dma_copy(chan, dma, elf_data + offset, filesz)) {
+			rproc->load_stats.dma_bytes += filesz;
+			copied = true;
+		}
+
+		if (phdr->p_filesz && !copied) {
 			memcpy(ptr, elf_data + phdr->p_offset, filesz);
+			rproc->load_stats.cpu_bytes += filesz;
+		}
 
 		/*
 		 * Zero out remaining memory for this segment.
@@ -206,6 +366,9 @@ rproc_elf_load_segments(struct rproc *rproc, const struct firmware *fw)
 			memset(ptr + filesz, 0, memsz - filesz);
 	}
 
+	if (chan)
+		dma_release_channel(chan);
+
 	return ret;
 }
 
@@ -22,6 +22,7 @@
 
 #include <linux/irqreturn.h>
 #include <linux/firmware.h>
+#include <linux/ktime.h>
 
 struct rproc;
 
@@ -91,10 +92,22 @@ u32 rproc_get_boot_addr(struct rproc *rproc, const struct firmware *fw)
 static inline
 int rproc_load_segments(struct rproc *rproc, const struct firmware *fw)
 {
-	if (rproc->fw_ops->load)
-		return rproc->fw_ops->load(rproc, fw);
+	struct rproc_load_stats *stats = &rproc->load_stats;
+	ktime_t start;
+	int ret;
 
-	return -EINVAL;
+	if (!rproc->fw_ops->load)
+		return -EINVAL;
+
+	stats->cpu_bytes = 0;
+	stats->dma_bytes = 0;
+	stats->cached = fw == rproc->cached_fw;
+
+	start = ktime_get();
+	ret = rproc->fw_ops->load(rproc, fw);
+	stats->time_us = ktime_us_delta(ktime_get(), start);
+
+	return ret;
 }
 
 static inline
@@ -22,16 +22,29 @@
 #include <linux/init.h>
 #include <linux/cdev.h>
 #include <linux/module.h>
-#include <linux/kfifo.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
 #include <linux/uaccess.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/rpmsg_pru.h>
 
 #define PRU_MAX_DEVICES				(8)
 /* Matches the definition in virtio_rpmsg_bus.c */
 #define RPMSG_BUF_SIZE				(512)
-#define MAX_FIFO_MSG				(32)
-#define FIFO_MSG_SIZE				RPMSG_BUF_SIZE
+#define RPMSG_PRU_SLOT_SIZE			RPMSG_BUF_SIZE
+#define RPMSG_PRU_SLOT_DATA_SIZE		(RPMSG_PRU_SLOT_SIZE - \
+						 sizeof(struct rpmsg_pru_slot))
+#define RPMSG_PRU_SLOT_OFFSET			PAGE_SIZE
+#define RPMSG_PRU_MAX_SLOTS			(16384)
+#define RPMSG_PRU_TX_BATCH			(16)
+#define RPMSG_PRU_TX_BUF_SIZE			(16 * 1024)
+
+static unsigned int ring_slots = 1024;
+module_param(ring_slots, uint, 0444);
+MODULE_PARM_DESC(ring_slots,
+		 "Number of message slots in the receive ring (power of 2)");
 
 /**
  * struct rpmsg_pru_dev - Structure that contains the per-device data
@@ -40,19 +53,23 @@
  * @cdev: character device
  * @locked: boolean used to determine whether or not the device file is in use
  * @devt: dev_t structure for the rpmsg_pru device
- * @rpmsg_pru_msg_fifo: kernel fifo used to buffer the messages between user
- *						space and the PRU
- * @rpmsg_pru_msg_len: array storing the lengths of each message in the kernel
- *					   fifo
- * @rpmsg_pru_msg_idx_rd: kernel fifo read index
- * @rpmsg_pru_msg_idx_wr: kernel fifo write index
+ * @ring: receive ring shared with user space through mmap
+ * @ring_size: size in bytes of the @ring allocation
+ * @slot_count: number of message slots in @ring
+ * @ring_head: kernel copy of the ring producer index
+ * @rx_dropped: messages dropped because the ring was full
+ * @rx_oversize: messages dropped because they did not fit in a slot
+ * @read_lock: serializes consumers using the read() path
  * @rpmsg_pru_wait_list: wait queue used to implement the poll operation of
  *						 the character device
  *
  * Each rpmsg_pru device provides an interface, using an rpmsg channel (rpdev),
- * between a user space character device (cdev) and a PRU core. A kernel fifo
- * (rpmsg_pru_msg_fifo) is used to buffer the messages in the kernel that are
- * being passed between the character device and the PRU.
+ * between a user space character device (cdev) and a PRU core. Messages from
+ * the PRU are stored in a ring of fixed size slots (ring) that user space
+ * either maps and consumes in place, or reads one message at a time.
+ *
+ * The slot count and the indices in @ring are writable by user space, the
+ * kernel only trusts its own copies (@slot_count and @ring_head).
  */
 struct rpmsg_pru_dev {
 	struct rpmsg_channel *rpdev;
@@ -60,10 +77,13 @@ struct rpmsg_pru_dev {
 	struct cdev cdev;
 	bool locked;
 	dev_t devt;
-	struct kfifo rpmsg_pru_msg_fifo;
-	u32 rpmsg_pru_msg_len[MAX_FIFO_MSG];
-	int rpmsg_pru_msg_idx_rd;
-	int rpmsg_pru_msg_idx_wr;
+	struct rpmsg_pru_ring *ring;
+	size_t ring_size;
+	u32 slot_count;
+	u32 ring_head;
+	u32 rx_dropped;
+	u32 rx_oversize;
+	struct mutex read_lock;
 	wait_queue_head_t rpmsg_pru_wait_list;
 };
 
@@ -72,6 +92,20 @@ static dev_t rpmsg_pru_devt;
 static DEFINE_MUTEX(rpmsg_pru_lock);
 static DEFINE_IDR(minors);
 
+static struct rpmsg_pru_slot *rpmsg_pru_slot(struct rpmsg_pru_dev *prudev,
+					     u32 index)
+{
+	index &= prudev->slot_count - 1;
+
+	return (void *)prudev->ring + RPMSG_PRU_SLOT_OFFSET +
+	       index * RPMSG_PRU_SLOT_SIZE;
+}
+
+static bool rpmsg_pru_ring_empty(struct rpmsg_pru_dev *prudev)
+{
+	return READ_ONCE(prudev->ring->tail) == READ_ONCE(prudev->ring_head);
+}
+
 static int rpmsg_pru_open(struct inode *inode, struct file *filp)
 {
 	struct rpmsg_pru_dev *prudev;
@@ -108,25 +142,44 @@ static ssize_t rpmsg_pru_read(struct file *filp, char *buf, size_t count,
 						loff_t *f_pos)
 {
 	int ret;
-	u32 length;
+	u32 length, tail;
 	struct rpmsg_pru_dev *prudev;
+	struct rpmsg_pru_slot *slot;
 
 	prudev = filp->private_data;
 
-	if (kfifo_is_empty(&prudev->rpmsg_pru_msg_fifo) &&
-						(filp->f_flags & O_NONBLOCK))
-			return -EAGAIN;
+	if (rpmsg_pru_ring_empty(prudev) && (filp->f_flags & O_NONBLOCK))
+		return -EAGAIN;
 
 	ret = wait_event_interruptible(prudev->rpmsg_pru_wait_list,
-				!kfifo_is_empty(&prudev->rpmsg_pru_msg_fifo));
+				       !rpmsg_pru_ring_empty(prudev));
 	if (ret)
 		return -EINTR;
 
-	ret = kfifo_to_user(&prudev->rpmsg_pru_msg_fifo, buf,
-		prudev->rpmsg_pru_msg_len[prudev->rpmsg_pru_msg_idx_rd],
-		&length);
-	prudev->rpmsg_pru_msg_idx_rd =
-		(prudev->rpmsg_pru_msg_idx_rd + 1) % MAX_FIFO_MSG;
+	mutex_lock(&prudev->read_lock);
+
+	tail = READ_ONCE(prudev->ring->tail);
+	if (tail == READ_ONCE(prudev->ring_head)) {
+		/* consumed through the mapping in the meantime */
+		mutex_unlock(&prudev->read_lock);
+		return -EAGAIN;
+	}
+	/* pairs with the smp_wmb() in rpmsg_pru_cb() */
+	smp_rmb();
+
+	slot = rpmsg_pru_slot(prudev, tail);
+	length = min_t(u32, READ_ONCE(slot->len), RPMSG_PRU_SLOT_DATA_SIZE);
+	length = min_t(size_t, length, count);
+
+	if (copy_to_user(buf, slot->data, length)) {
+		ret = -EFAULT;
+	} else {
+		/* finish reading the slot before handing it back */
+		smp_mb();
+		WRITE_ONCE(prudev->ring->tail, tail + 1);
+	}
+
+	mutex_unlock(&prudev->read_lock);
 
 	return ret ? ret : length;
 }
@@ -139,7 +192,7 @@ static ssize_t rpmsg_pru_write(struct file *filp, const char *buf, size_t count,
 
 	prudev = filp->private_data;
 
-	if (count > RPMSG_BUF_SIZE - sizeof(struct rpmsg_hdr)) {
+	if (count > rpmsg_get_mtu(prudev->rpdev)) {
 		dev_err(prudev->dev, "Data too large for RPMsg Buffer\n");
 		return -EINVAL;
 	}
@@ -151,6 +204,80 @@ static ssize_t rpmsg_pru_write(struct file *filp, const char *buf, size_t count,
 	return ret ? ret : count;
 }
 
+/*
+ * writev() path: every iovec segment is sent as one message, and up to
+ * RPMSG_PRU_TX_BATCH messages are queued before the PRU is notified.
+ */
+static ssize_t rpmsg_pru_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct rpmsg_pru_dev *prudev = iocb->ki_filp->private_data;
+	struct kvec vec[RPMSG_PRU_TX_BATCH];
+	const struct iovec *iov = from->iov;
+	unsigned long seg = 0;
+	size_t len, used, buf_size;
+	ssize_t done = 0;
+	int i, n, sent, mtu, ret = 0;
+	char *buf;
+
+	if (!iter_is_iovec(from) || from->iov_offset)
+		return -EINVAL;
+
+	mtu = rpmsg_get_mtu(prudev->rpdev);
+	if (mtu < 0)
+		return mtu;
+
+	buf_size = clamp_t(size_t, RPMSG_PRU_TX_BUF_SIZE, mtu,
+			   RPMSG_PRU_TX_BATCH * mtu);
+	buf = kmalloc(buf_size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	while (!ret && seg < from->nr_segs) {
+		for (n = 0, used = 0; seg < from->nr_segs &&
+		     n < RPMSG_PRU_TX_BATCH; seg++) {
+			len = iov[seg].iov_len;
+			if (!len)
+				continue;
+			if (len > mtu) {
+				dev_err(prudev->dev, "Data too large for RPMsg Buffer\n");
+				ret = -EMSGSIZE;
+				break;
+			}
+			if (used + len > buf_size)
+				break;
+			if (copy_from_user(buf + used, iov[seg].iov_base, len)) {
+				ret = -EFAULT;
+				break;
+			}
+			vec[n].iov_base = buf + used;
+			vec[n].iov_len = len;
+			used += len;
+			n++;
+		}
+		if (!n)
+			break;
+
+		sent = rpmsg_sendv(prudev->rpdev, vec, n);
+		if (sent < 0) {
+			dev_err(prudev->dev, "rpmsg_sendv failed: %d\n", sent);
+			ret = sent;
+			break;
+		}
+		for (i = 0; i < sent; i++)
+			done += vec[i].iov_len;
+		if (sent < n)
+			break;
+	}
+
+	kfree(buf);
+
+	if (done) {
+		iov_iter_advance(from, done);
+		return done;
+	}
+	return ret;
+}
+
 static unsigned int rpmsg_pru_poll(struct file *filp,
 						struct poll_table_struct *wait)
 {
@@ -163,48 +290,106 @@ static unsigned int rpmsg_pru_poll(struct file *filp,
 
 	mask = POLLOUT | POLLWRNORM;
 
-	if (!kfifo_is_empty(&prudev->rpmsg_pru_msg_fifo))
+	if (!rpmsg_pru_ring_empty(prudev))
 		mask |= POLLIN | POLLRDNORM;
 
 	return mask;
 }
 
+static int rpmsg_pru_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct rpmsg_pru_dev *prudev;
+
+	prudev = filp->private_data;
+
+	if (vma->vm_pgoff)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, prudev->ring, 0);
+}
+
 static const struct file_operations rpmsg_pru_fops = {
 	.owner = THIS_MODULE,
 	.open = rpmsg_pru_open,
 	.release = rpmsg_pru_release,
 	.read = rpmsg_pru_read,
 	.write = rpmsg_pru_write,
+	.write_iter = rpmsg_pru_write_iter,
 	.poll = rpmsg_pru_poll,
+	.mmap = rpmsg_pru_mmap,
+};
+
+static ssize_t rx_dropped_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct rpmsg_pru_dev *prudev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", prudev->rx_dropped);
+}
+static DEVICE_ATTR_RO(rx_dropped);
+
+static ssize_t rx_oversize_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct rpmsg_pru_dev *prudev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", prudev->rx_oversize);
+}
+static DEVICE_ATTR_RO(rx_oversize);
+
+static ssize_t ring_slots_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct rpmsg_pru_dev *prudev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", prudev->slot_count);
+}
+static DEVICE_ATTR_RO(ring_slots);
+
+static struct attribute *rpmsg_pru_attrs[] = {
+	&dev_attr_rx_dropped.attr,
+	&dev_attr_rx_oversize.attr,
+	&dev_attr_ring_slots.attr,
+	NULL,
 };
+ATTRIBUTE_GROUPS(rpmsg_pru);
 
 static void rpmsg_pru_cb(struct rpmsg_channel *rpdev, void *data, int len,
 					void *priv, u32 src)
 {
-	u32 length;
+	u32 head, tail;
 	struct rpmsg_pru_dev *prudev;
+	struct rpmsg_pru_slot *slot;
 
 	prudev = dev_get_drvdata(&rpdev->dev);
 
-	if (kfifo_avail(&prudev->rpmsg_pru_msg_fifo) < len) {
-		dev_err(&rpdev->dev, "Not enough space on the FIFO\n");
+	if (len > RPMSG_PRU_SLOT_DATA_SIZE) {
+		prudev->rx_oversize++;
+		dev_err_ratelimited(&rpdev->dev, "Message too large for a ring slot\n");
 		return;
 	}
 
-	if ((prudev->rpmsg_pru_msg_idx_wr + 1) % MAX_FIFO_MSG ==
-		prudev->rpmsg_pru_msg_idx_rd) {
-		dev_err(&rpdev->dev, "Message length table is full\n");
+	head = prudev->ring_head;
+	tail = READ_ONCE(prudev->ring->tail);
+	if (head - tail >= prudev->slot_count) {
+		prudev->rx_dropped++;
+		dev_err_ratelimited(&rpdev->dev, "Receive ring is full\n");
 		return;
 	}
+	/* do not touch the slot before the consumer is done with it */
+	smp_mb();
 
-	length = kfifo_in(&prudev->rpmsg_pru_msg_fifo, data, len);
-	prudev->rpmsg_pru_msg_len[prudev->rpmsg_pru_msg_idx_wr] = length;
-	prudev->rpmsg_pru_msg_idx_wr =
-		(prudev->rpmsg_pru_msg_idx_wr + 1) % MAX_FIFO_MSG;
+	slot = rpmsg_pru_slot(prudev, head);
+	memcpy(slot->data, data, len);
+	slot->len = len;
 
-	wake_up_interruptible(&prudev->rpmsg_pru_wait_list);
+	/* publish the slot contents before the new head */
+	smp_wmb();
+	head++;
+	WRITE_ONCE(prudev->ring_head, head);
+	WRITE_ONCE(prudev->ring->head, head);
 
-	return;
+	wake_up_interruptible(&prudev->rpmsg_pru_wait_list);
 }
 
 static int rpmsg_pru_probe(struct rpmsg_channel *rpdev)
@@ -219,6 +404,26 @@ static int rpmsg_pru_probe(struct rpmsg_channel *rpdev)
 		return -ENOMEM;
 	}
 
+	prudev->rpdev = rpdev;
+	mutex_init(&prudev->read_lock);
+	init_waitqueue_head(&prudev->rpmsg_pru_wait_list);
+
+	prudev->slot_count = roundup_pow_of_two(clamp_t(unsigned int,
+				ring_slots, 2, RPMSG_PRU_MAX_SLOTS));
+	prudev->ring_size = PAGE_ALIGN(RPMSG_PRU_SLOT_OFFSET +
+				       prudev->slot_count *
+				       RPMSG_PRU_SLOT_SIZE);
+	prudev->ring = vmalloc_user(prudev->ring_size);
+	if (!prudev->ring) {
+		dev_err(&rpdev->dev, "Unable to allocate ring for the rpmsg_pru device\n");
+		return -ENOMEM;
+	}
+	prudev->ring->slot_count = prudev->slot_count;
+	prudev->ring->slot_size = RPMSG_PRU_SLOT_SIZE;
+	prudev->ring->slot_offset = RPMSG_PRU_SLOT_OFFSET;
+
+	dev_set_drvdata(&rpdev->dev, prudev);
+
 	mutex_lock(&rpmsg_pru_lock);
 	minor_got = idr_alloc(&minors, prudev, 0, PRU_MAX_DEVICES, GFP_KERNEL);
 	mutex_unlock(&rpmsg_pru_lock);
@@ -239,34 +444,21 @@ static int rpmsg_pru_probe(struct rpmsg_channel *rpdev)
 		goto fail_add_cdev;
 	}
 
-	prudev->dev = device_create(rpmsg_pru_class, &rpdev->dev, prudev->devt,
-		NULL, "rpmsg_pru" "%d", rpdev->dst);
+	prudev->dev = device_create_with_groups(rpmsg_pru_class, &rpdev->dev,
+						prudev->devt, prudev,
+						rpmsg_pru_groups,
+						"rpmsg_pru" "%d", rpdev->dst);
 	if (IS_ERR(prudev->dev)) {
 		dev_err(&rpdev->dev, "Unable to create the rpmsg_pru device\n");
 		ret = PTR_ERR(prudev->dev);
 		goto fail_create_device;
 	}
 
-	prudev->rpdev = rpdev;
-
-	ret = kfifo_alloc(&prudev->rpmsg_pru_msg_fifo,
-		MAX_FIFO_MSG * FIFO_MSG_SIZE, GFP_KERNEL);
-	if (ret) {
-		dev_err(&rpdev->dev, "Unable to allocate fifo for the rpmsg_pru device\n");
-		goto fail_alloc_fifo;
-	}
-
-	init_waitqueue_head(&prudev->rpmsg_pru_wait_list);
-
-	dev_set_drvdata(&rpdev->dev, prudev);
-
 	dev_info(&rpdev->dev, "new rpmsg_pru device: /dev/rpmsg_pru%d",
 		 rpdev->dst);
 
 	return 0;
 
-fail_alloc_fifo:
-	device_destroy(rpmsg_pru_class, prudev->devt);
 fail_create_device:
 	cdev_del(&prudev->cdev);
 fail_add_cdev:
@@ -274,6 +466,7 @@ fail_add_cdev:
 	idr_remove(&minors, minor_got);
 	mutex_unlock(&rpmsg_pru_lock);
 fail_alloc_minor:
+	vfree(prudev->ring);
 	return ret;
 }
 
@@ -283,12 +476,12 @@ static void rpmsg_pru_remove(struct rpmsg_channel *rpdev)
 
 	prudev = dev_get_drvdata(&rpdev->dev);
 
-	kfifo_free(&prudev->rpmsg_pru_msg_fifo);
 	device_destroy(rpmsg_pru_class, prudev->devt);
 	cdev_del(&prudev->cdev);
 	mutex_lock(&rpmsg_pru_lock);
 	idr_remove(&minors, MINOR(prudev->devt));
 	mutex_unlock(&rpmsg_pru_lock);
+	vfree(prudev->ring);
 }
 
 /* .name matches on RPMsg Channels and causes a probe */
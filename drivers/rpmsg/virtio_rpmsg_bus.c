@@ -42,6 +42,7 @@
  * @rbufs:	kernel address of rx buffers
  * @sbufs:	kernel address of tx buffers
  * @num_bufs:	total number of buffers for rx and tx
+ * @buf_size:	size of each buffer, including the rpmsg header
  * @last_sbuf:	index of last tx buffer used
  * @bufs_dma:	dma base addr of the buffers
  * @tx_lock:	protects svq, sbufs and sleepers, to allow concurrent senders.
@@ -62,6 +63,7 @@ struct virtproc_info {
 	struct virtqueue *rvq, *svq;
 	void *rbufs, *sbufs;
 	unsigned int num_bufs;
+	unsigned int buf_size;
 	int last_sbuf;
 	dma_addr_t bufs_dma;
 	struct mutex tx_lock;
@@ -90,15 +92,21 @@ struct rpmsg_channel_info {
 #define to_rpmsg_driver(d) container_of(d, struct rpmsg_driver, drv)
 
 /*
- * We're allocating buffers of 512 bytes each for communications. The
- * number of buffers will be computed from the number of buffers supported
- * by the vring, upto a maximum of 512 buffers (256 in each direction).
+ * By default we're allocating buffers of 512 bytes each for communications.
+ * The number of buffers will be computed from the number of buffers
+ * supported by the vring, upto a maximum of 512 buffers (256 in each
+ * direction).
  *
  * Each buffer will have 16 bytes for the msg header and 496 bytes for
  * the payload.
  *
  * This will utilize a maximum total space of 256KB for the buffers.
  *
+ * A remote processor advertising VIRTIO_RPMSG_F_BUFSZ can ask for a
+ * different number and size of buffers through struct virtio_rpmsg_config
+ * in its vdev config space, the number of buffers is still bounded by
+ * the vring size and the buffer size by RPMSG_MAX_BUF_SIZE.
+ *
  * We might also want to add support for user-provided buffers in time.
  * This will allow bigger buffer size flexibility, and can also be used
  * to achieve zero-copy messaging.
@@ -109,6 +117,7 @@ struct rpmsg_channel_info {
  */
 #define MAX_RPMSG_NUM_BUFS	(512)
 #define RPMSG_BUF_SIZE		(512)
+#define RPMSG_MAX_BUF_SIZE	(64 * 1024)
 
 /*
  * Local addresses are dynamically allocated on-demand.
@@ -662,7 +671,7 @@ static void *get_a_tx_buf(struct virtproc_info *vrp)
 	 * (half of our buffers are used for sending messages)
 	 */
 	if (vrp->last_sbuf < vrp->num_bufs / 2)
-		ret = vrp->sbufs + RPMSG_BUF_SIZE * vrp->last_sbuf++;
+		ret = vrp->sbufs + vrp->buf_size * vrp->last_sbuf++;
 	/* or recycle a used one */
 	else
 		ret = virtqueue_get_buf(vrp->svq, &len);
@@ -728,71 +737,43 @@ static void rpmsg_downref_sleepers(struct virtproc_info *vrp)
 	mutex_unlock(&vrp->tx_lock);
 }
 
-/**
- * rpmsg_send_offchannel_raw() - send a message across to the remote processor
- * @rpdev: the rpmsg channel
- * @src: source address
- * @dst: destination address
- * @data: payload of message
- * @len: length of payload
- * @wait: indicates whether caller should block in case no TX buffers available
- *
- * This function is the base implementation for all of the rpmsg sending API.
- *
- * It will send @data of length @len to @dst, and say it's from @src. The
- * message will be sent to the remote processor which the @rpdev channel
- * belongs to.
- *
- * The message is sent using one of the TX buffers that are available for
- * communication with this remote processor.
- *
- * If @wait is true, the caller will be blocked until either a TX buffer is
- * available, or 15 seconds elapses (we don't want callers to
- * sleep indefinitely due to misbehaving remote processors), and in that
- * case -ERESTARTSYS is returned. The number '15' itself was picked
- * arbitrarily; there's little point in asking drivers to provide a timeout
- * value themselves.
- *
- * Otherwise, if @wait is false, and there are no TX buffers available,
- * the function will immediately fail, and -ENOMEM will be returned.
- *
- * Normally drivers shouldn't use this function directly; instead, drivers
- * should use the appropriate rpmsg_{try}send{to, _offchannel} API
- * (see include/linux/rpmsg.h).
- *
- * Returns 0 on success and an appropriate error value on failure.
+/*
+ * Queue a single message on the tx virtqueue. The remote processor is only
+ * notified if @kick is set, otherwise *@pending is set to tell the caller
+ * that a kick is still owed. A pending kick is also issued before sleeping
+ * for a free buffer, since the remote can't return any before seeing the
+ * queued messages.
  */
-int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
-					void *data, int len, bool wait)
+static int rpmsg_queue_msg(struct virtproc_info *vrp, struct device *dev,
+			   u32 src, u32 dst, void *data, int len, bool wait,
+			   bool kick, bool *pending)
 {
-	struct virtproc_info *vrp = rpdev->vrp;
-	struct device *dev = &rpdev->dev;
 	struct scatterlist sg;
 	struct rpmsg_hdr *msg;
 	int err;
 
-	/* bcasting isn't allowed */
-	if (src == RPMSG_ADDR_ANY || dst == RPMSG_ADDR_ANY) {
-		dev_err(dev, "invalid addr (src 0x%x, dst 0x%x)\n", src, dst);
-		return -EINVAL;
-	}
-
 	/*
 	 * We currently use fixed-sized buffers, and therefore the payload
-	 * length is limited.
+	 * length is limited by the buffer size negotiated at probe time.
 	 *
 	 * One of the possible improvements here is either to support
 	 * user-provided buffers (and then we can also support zero-copy
 	 * messaging), or to improve the buffer allocator, to support
 	 * variable-length buffer sizes.
 	 */
-	if (len > RPMSG_BUF_SIZE - sizeof(struct rpmsg_hdr)) {
+	if (len > vrp->buf_size - sizeof(struct rpmsg_hdr)) {
 		dev_err(dev, "message is too big (%d)\n", len);
 		return -EMSGSIZE;
 	}
 
 	/* grab a buffer */
 	msg = get_a_tx_buf(vrp);
+	if (!msg && *pending) {
+		mutex_lock(&vrp->tx_lock);
+		virtqueue_kick(vrp->svq);
+		mutex_unlock(&vrp->tx_lock);
+		*pending = false;
+	}
 	if (!msg && !wait)
 		return -ENOMEM;
 
@@ -853,13 +834,124 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 	}
 
 	/* tell the remote processor it has a pending message to read */
-	virtqueue_kick(vrp->svq);
+	if (kick) {
+		virtqueue_kick(vrp->svq);
+		*pending = false;
+	} else {
+		*pending = true;
+	}
 out:
 	mutex_unlock(&vrp->tx_lock);
 	return err;
 }
+
+/**
+ * rpmsg_send_offchannel_raw() - send a message across to the remote processor
+ * @rpdev: the rpmsg channel
+ * @src: source address
+ * @dst: destination address
+ * @data: payload of message
+ * @len: length of payload
+ * @wait: indicates whether caller should block in case no TX buffers available
+ *
+ * This function is the base implementation for all of the rpmsg sending API.
+ *
+ * It will send @data of length @len to @dst, and say it's from @src. The
+ * message will be sent to the remote processor which the @rpdev channel
+ * belongs to.
+ *
+ * The message is sent using one of the TX buffers that are available for
+ * communication with this remote processor.
+ *
+ * If @wait is true, the caller will be blocked until either a TX buffer is
+ * available, or 15 seconds elapses (we don't want callers to
+ * sleep indefinitely due to misbehaving remote processors), and in that
+ * case -ERESTARTSYS is returned. The number '15' itself was picked
+ * arbitrarily; there's little point in asking drivers to provide a timeout
+ * value themselves.
+ *
+ * Otherwise, if @wait is false, and there are no TX buffers available,
+ * the function will immediately fail, and -ENOMEM will be returned.
+ *
+ * Normally drivers shouldn't use this function directly; instead, drivers
+ * should use the appropriate rpmsg_{try}send{to, _offchannel} API
+ * (see include/linux/rpmsg.h).
+ *
+ * Returns 0 on success and an appropriate error value on failure.
+ */
+int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
+					void *data, int len, bool wait)
+{
+	struct virtproc_info *vrp = rpdev->vrp;
+	struct device *dev = &rpdev->dev;
+	bool pending = false;
+
+	/* bcasting isn't allowed */
+	if (src == RPMSG_ADDR_ANY || dst == RPMSG_ADDR_ANY) {
+		dev_err(dev, "invalid addr (src 0x%x, dst 0x%x)\n", src, dst);
+		return -EINVAL;
+	}
+
+	return rpmsg_queue_msg(vrp, dev, src, dst, data, len, wait, true,
+			       &pending);
+}
 EXPORT_SYMBOL(rpmsg_send_offchannel_raw);
 
+/**
+ * rpmsg_sendv_offchannel_raw() - send a batch of messages to the remote
+ * @rpdev: the rpmsg channel
+ * @src: source address
+ * @dst: destination address
+ * @vec: array of payloads, one message per entry
+ * @count: number of entries in @vec
+ * @wait: indicates whether caller should block in case no TX buffers available
+ *
+ * Like rpmsg_send_offchannel_raw(), but queues up to @count messages and
+ * notifies the remote processor once for the whole batch instead of once
+ * per message. Messages are queued in order; if one of them fails the
+ * messages before it are still sent.
+ *
+ * Returns the number of messages sent, or an appropriate error value if
+ * not even the first one could be sent.
+ */
+int rpmsg_sendv_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
+			       const struct kvec *vec, unsigned int count,
+			       bool wait)
+{
+	struct virtproc_info *vrp = rpdev->vrp;
+	struct device *dev = &rpdev->dev;
+	bool pending = false;
+	unsigned int i;
+	int err = 0;
+
+	/* bcasting isn't allowed */
+	if (src == RPMSG_ADDR_ANY || dst == RPMSG_ADDR_ANY) {
+		dev_err(dev, "invalid addr (src 0x%x, dst 0x%x)\n", src, dst);
+		return -EINVAL;
+	}
+
+	if (!count)
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		err = rpmsg_queue_msg(vrp, dev, src, dst, vec[i].iov_base,
+				      vec[i].iov_len, wait, i == count - 1,
+				      &pending);
+		if (err)
+			break;
+	}
+
+	/* a message in the middle of the batch failed */
+	if (pending) {
+		mutex_lock(&vrp->tx_lock);
+		virtqueue_kick(vrp->svq);
+		mutex_unlock(&vrp->tx_lock);
+	}
+
+	return i ? i : err;
+}
+EXPORT_SYMBOL(rpmsg_sendv_offchannel_raw);
+
 /**
  * rpmsg_get_virtio_dev - Get underlying virtio device
  * @rpdev: the rpmsg channel
@@ -876,6 +968,23 @@ struct virtio_device *rpmsg_get_virtio_dev(struct rpmsg_channel *rpdev)
 }
 EXPORT_SYMBOL(rpmsg_get_virtio_dev);
 
+/**
+ * rpmsg_get_mtu - maximum payload of a single message
+ * @rpdev: the rpmsg channel
+ *
+ * Returns the largest payload, in bytes, that can be passed to the
+ * rpmsg_send() family of functions on @rpdev, or -EINVAL if @rpdev isn't
+ * bound to a virtio remote processor.
+ */
+int rpmsg_get_mtu(struct rpmsg_channel *rpdev)
+{
+	if (!rpdev || !rpdev->vrp)
+		return -EINVAL;
+
+	return rpdev->vrp->buf_size - sizeof(struct rpmsg_hdr);
+}
+EXPORT_SYMBOL(rpmsg_get_mtu);
+
 static int rpmsg_recv_single(struct virtproc_info *vrp, struct device *dev,
 			     struct rpmsg_hdr *msg, unsigned int len)
 {
@@ -895,7 +1004,7 @@ static int rpmsg_recv_single(struct virtproc_info *vrp, struct device *dev,
 	 * We currently use fixed-sized buffers, so trivially sanitize
 	 * the reported payload length.
 	 */
-	if (len > RPMSG_BUF_SIZE ||
+	if (len > vrp->buf_size ||
 		msg->len > (len - sizeof(struct rpmsg_hdr))) {
 		dev_warn(dev, "inbound msg too big: (%d, %d)\n", len, msg->len);
 		return -EINVAL;
@@ -928,7 +1037,7 @@ static int rpmsg_recv_single(struct virtproc_info *vrp, struct device *dev,
 		dev_warn(dev, "msg received with no recipient\n");
 
 	/* publish the real size of the buffer */
-	rpmsg_sg_init_one(vrp, &sg, msg, RPMSG_BUF_SIZE);
+	rpmsg_sg_init_one(vrp, &sg, msg, vrp->buf_size);
 
 	/* add the buffer back to the remote processor's virtqueue */
 	err = virtqueue_add_inbuf_rpmsg(vrp->rvq, &sg, 1, msg, GFP_KERNEL);
@@ -947,23 +1056,29 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 	struct device *dev = &rvq->vdev->dev;
 	struct rpmsg_hdr *msg;
 	unsigned int len, msgs_received = 0;
-	int err;
-
-	msg = virtqueue_get_buf(rvq, &len);
-	if (!msg) {
-		dev_err(dev, "uhm, incoming signal, but no used buffer ?\n");
-		return;
-	}
-
-	while (msg) {
-		err = rpmsg_recv_single(vrp, dev, msg, len);
-		if (err)
-			break;
+	int err = 0;
 
-		msgs_received++;
+	/*
+	 * Poll the used ring with the rx callback disabled, so messages the
+	 * remote processor posts while we are busy don't raise interrupts,
+	 * and only re-enable it once the ring is found empty.
+	 */
+	virtqueue_disable_cb(rvq);
+	do {
+		while ((msg = virtqueue_get_buf(rvq, &len))) {
+			err = rpmsg_recv_single(vrp, dev, msg, len);
+			if (err)
+				goto out;
+
+			msgs_received++;
+		}
+	} while (!virtqueue_enable_cb(rvq));
+out:
+	if (err)
+		virtqueue_enable_cb(rvq);
 
-		msg = virtqueue_get_buf(rvq, &len);
-	};
+	if (!msgs_received)
+		dev_dbg(dev, "incoming signal, but no used buffer\n");
 
 	dev_dbg(dev, "Received %u messages\n", msgs_received);
 
@@ -1045,6 +1160,44 @@ static void rpmsg_ns_cb(struct rpmsg_channel *rpdev, void *data, int len,
 	}
 }
 
+/*
+ * Pick the number and size of the buffers, using the remote processor's
+ * request from the config space if it offered one.
+ */
+static void rpmsg_get_buf_config(struct virtproc_info *vrp)
+{
+	struct virtio_device *vdev = vrp->vdev;
+	unsigned int vring_bufs = virtqueue_get_vring_size(vrp->rvq) * 2;
+	u32 num_bufs = 0, buf_size = 0;
+
+	vrp->num_bufs = MAX_RPMSG_NUM_BUFS;
+	vrp->buf_size = RPMSG_BUF_SIZE;
+
+	if (virtio_has_feature(vdev, VIRTIO_RPMSG_F_BUFSZ)) {
+		virtio_cread(vdev, struct virtio_rpmsg_config, num_bufs,
+			     &num_bufs);
+		virtio_cread(vdev, struct virtio_rpmsg_config, buf_size,
+			     &buf_size);
+
+		if (num_bufs >= 2)
+			vrp->num_bufs = num_bufs & ~1;
+		else if (num_bufs)
+			dev_warn(&vdev->dev, "ignoring buffer count %u\n",
+				 num_bufs);
+
+		if (buf_size > sizeof(struct rpmsg_hdr) &&
+		    buf_size <= RPMSG_MAX_BUF_SIZE)
+			vrp->buf_size = ALIGN(buf_size, sizeof(u32));
+		else if (buf_size)
+			dev_warn(&vdev->dev, "ignoring buffer size %u\n",
+				 buf_size);
+	}
+
+	/* we need less buffers if vrings are small */
+	if (vring_bufs < vrp->num_bufs)
+		vrp->num_bufs = vring_bufs;
+}
+
 static int rpmsg_probe(struct virtio_device *vdev)
 {
 	vq_callback_t *vq_cbs[] = { rpmsg_recv_done, rpmsg_xmit_done };
@@ -1079,13 +1232,12 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	WARN_ON(virtqueue_get_vring_size(vrp->rvq) !=
 		virtqueue_get_vring_size(vrp->svq));
 
-	/* we need less buffers if vrings are small */
-	if (virtqueue_get_vring_size(vrp->rvq) < MAX_RPMSG_NUM_BUFS / 2)
-		vrp->num_bufs = virtqueue_get_vring_size(vrp->rvq) * 2;
-	else
-		vrp->num_bufs = MAX_RPMSG_NUM_BUFS;
+	rpmsg_get_buf_config(vrp);
+
+	dev_dbg(&vdev->dev, "%u buffers of %u bytes\n", vrp->num_bufs,
+		vrp->buf_size);
 
-	total_buf_space = vrp->num_bufs * RPMSG_BUF_SIZE;
+	total_buf_space = vrp->num_bufs * vrp->buf_size;
 
 	/* allocate coherent memory for the buffers */
 	bufs_va = dma_alloc_coherent(vdev->dev.parent->parent,
@@ -1108,9 +1260,9 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	/* set up the receive buffers */
 	for (i = 0; i < vrp->num_bufs / 2; i++) {
 		struct scatterlist sg;
-		void *cpu_addr = vrp->rbufs + i * RPMSG_BUF_SIZE;
+		void *cpu_addr = vrp->rbufs + i * vrp->buf_size;
 
-		rpmsg_sg_init_one(vrp, &sg, cpu_addr, RPMSG_BUF_SIZE);
+		rpmsg_sg_init_one(vrp, &sg, cpu_addr, vrp->buf_size);
 
 		err = virtqueue_add_inbuf_rpmsg(vrp->rvq, &sg, 1, cpu_addr,
 						GFP_KERNEL);
@@ -1175,7 +1327,7 @@ static int rpmsg_remove_device(struct device *dev, void *data)
 static void rpmsg_remove(struct virtio_device *vdev)
 {
 	struct virtproc_info *vrp = vdev->priv;
-	size_t total_buf_space = vrp->num_bufs * RPMSG_BUF_SIZE;
+	size_t total_buf_space = vrp->num_bufs * vrp->buf_size;
 	int ret;
 
 	ret = device_for_each_child(&vdev->dev, NULL, rpmsg_remove_device);
@@ -1203,6 +1355,7 @@ static struct virtio_device_id id_table[] = {
 
 static unsigned int features[] = {
 	VIRTIO_RPMSG_F_NS,
+	VIRTIO_RPMSG_F_BUFSZ,
 };
 
 static struct virtio_driver virtio_ipc_driver = {
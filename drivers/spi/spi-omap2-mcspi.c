@@ -90,6 +90,8 @@
 #define OMAP2_MCSPI_CHSTAT_TXS		BIT(1)
 #define OMAP2_MCSPI_CHSTAT_EOT		BIT(2)
 #define OMAP2_MCSPI_CHSTAT_TXFFE	BIT(3)
+#define OMAP2_MCSPI_CHSTAT_TXFFF	BIT(4)
+#define OMAP2_MCSPI_CHSTAT_RXFFE	BIT(5)
 
 #define OMAP2_MCSPI_CHCTRL_EN		BIT(0)
 #define OMAP2_MCSPI_CHCTRL_EXTCLK_MASK	(0xff << 8)
@@ -113,8 +115,11 @@ struct omap2_mcspi_dma {
 
 /* use PIO for small transfers, avoiding DMA setup/teardown overhead and
  * cache operations; better heuristics consider wordsize and bitrate.
+ * The "ti,dma-min-bytes" property overrides the default per controller.
  */
-#define DMA_MIN_BYTES			160
+static unsigned int dma_min_bytes = 160;
+module_param(dma_min_bytes, uint, 0444);
+MODULE_PARM_DESC(dma_min_bytes, "smallest transfer done by DMA, in bytes");
 
 
 /*
@@ -139,12 +144,16 @@ struct omap2_mcspi {
 	int			fifo_depth;
 	unsigned int		pin_dir:1;
 	unsigned int		pio_mode:1;
+	unsigned int		dma_min_bytes;
+	/* last transfer of the current message handed to the hardware */
+	struct spi_transfer	*last_xfer;
 };
 
 struct omap2_mcspi_cs {
 	void __iomem		*base;
 	unsigned long		phys;
 	int			word_len;
+	u32			speed_hz;
 	u16			mode;
 	struct list_head	node;
 	/* Context save and restore shadow register */
@@ -192,6 +201,10 @@ static inline void mcspi_write_chconf0(const struct spi_device *spi, u32 val)
 {
 	struct omap2_mcspi_cs *cs = spi->controller_state;
 
+	/* the cached value always matches the hardware, see restore_ctx */
+	if (val == cs->chconf0)
+		return;
+
 	cs->chconf0 = val;
 	mcspi_write_cs_reg(spi, OMAP2_MCSPI_CHCONF0, val);
 	mcspi_read_cs_reg(spi, OMAP2_MCSPI_CHCONF0);
@@ -243,19 +256,6 @@ static void omap2_mcspi_set_enable(const struct spi_device *spi, int enable)
 	mcspi_read_cs_reg(spi, OMAP2_MCSPI_CHCTRL0);
 }
 
-static void omap2_mcspi_force_cs(struct spi_device *spi, int cs_active)
-{
-	u32 l;
-
-	l = mcspi_cached_chconf0(spi);
-	if (cs_active)
-		l |= OMAP2_MCSPI_CHCONF_FORCE;
-	else
-		l &= ~OMAP2_MCSPI_CHCONF_FORCE;
-
-	mcspi_write_chconf0(spi, l);
-}
-
 static void omap2_mcspi_set_master_mode(struct spi_master *master)
 {
 	struct omap2_mcspi	*mcspi = spi_master_get_devdata(master);
@@ -323,11 +323,8 @@ static void omap2_mcspi_set_fifo(const struct spi_device *spi,
 	}
 
 disable_fifo:
-	if (t->rx_buf != NULL)
-		chconf &= ~OMAP2_MCSPI_CHCONF_FFER;
-
-	if (t->tx_buf != NULL)
-		chconf &= ~OMAP2_MCSPI_CHCONF_FFET;
+	/* PIO through the FIFO enables both directions for any transfer */
+	chconf &= ~(OMAP2_MCSPI_CHCONF_FFER | OMAP2_MCSPI_CHCONF_FFET);
 
 	mcspi_write_chconf0(spi, chconf);
 	mcspi->fifo_depth = 0;
@@ -828,6 +825,102 @@ out:
 	return count - c;
 }
 
+/*
+ * PIO through the FIFO for transfers below the DMA threshold.  The channel
+ * runs in transmit/receive mode with both FIFOs enabled whatever the
+ * direction of the transfer: zeroes are sent when there is no TX buffer and
+ * words are dropped when there is no RX buffer.  Words are pushed while the
+ * TX FIFO has room and popped while the RX FIFO has data, keeping no more
+ * words in flight than the RX FIFO can hold, instead of waiting for each
+ * word to shift through.
+ */
+static bool omap2_mcspi_fifo_pio_ok(struct spi_device *spi,
+				    struct spi_transfer *t)
+{
+	struct omap2_mcspi_cs *cs = spi->controller_state;
+	int bytes_per_word = mcspi_bytes_per_word(cs->word_len);
+
+	/* a single word gains nothing from the FIFO */
+	return t->len > bytes_per_word && t->len % bytes_per_word == 0;
+}
+
+static void omap2_mcspi_fifo_pio_enable(struct spi_device *spi, int enable)
+{
+	struct spi_master *master = spi->master;
+	struct omap2_mcspi *mcspi = spi_master_get_devdata(master);
+	u32 chconf;
+
+	chconf = mcspi_cached_chconf0(spi);
+	if (enable) {
+		/* levels and word count are unused, CHSTAT is polled */
+		mcspi_write_reg(master, OMAP2_MCSPI_XFERLEVEL, 0);
+		chconf |= OMAP2_MCSPI_CHCONF_FFER | OMAP2_MCSPI_CHCONF_FFET;
+		mcspi->fifo_depth = OMAP2_MCSPI_MAX_FIFODEPTH / 2;
+	} else {
+		chconf &= ~(OMAP2_MCSPI_CHCONF_FFER | OMAP2_MCSPI_CHCONF_FFET);
+		mcspi->fifo_depth = 0;
+	}
+	mcspi_write_chconf0(spi, chconf);
+}
+
+static unsigned
+omap2_mcspi_txrx_pio_fifo(struct spi_device *spi, struct spi_transfer *xfer)
+{
+	struct omap2_mcspi	*mcspi = spi_master_get_devdata(spi->master);
+	struct omap2_mcspi_cs	*cs = spi->controller_state;
+	void __iomem		*tx_reg = cs->base + OMAP2_MCSPI_TX0;
+	void __iomem		*rx_reg = cs->base + OMAP2_MCSPI_RX0;
+	void __iomem		*chstat_reg = cs->base + OMAP2_MCSPI_CHSTAT0;
+	int			bytes_per_word;
+	unsigned int		words, depth;
+	unsigned int		tx_done = 0, rx_done = 0;
+	unsigned long		timeout;
+	u32			chstat, w;
+
+	bytes_per_word = mcspi_bytes_per_word(cs->word_len);
+	words = xfer->len / bytes_per_word;
+	depth = mcspi->fifo_depth / bytes_per_word;
+
+	timeout = jiffies + msecs_to_jiffies(1000);
+	while (rx_done < words) {
+		chstat = readl_relaxed(chstat_reg);
+
+		if (tx_done < words && tx_done - rx_done < depth &&
+		    !(chstat & OMAP2_MCSPI_CHSTAT_TXFFF)) {
+			if (xfer->tx_buf == NULL)
+				w = 0;
+			else if (bytes_per_word == 1)
+				w = ((const u8 *)xfer->tx_buf)[tx_done];
+			else if (bytes_per_word == 2)
+				w = ((const u16 *)xfer->tx_buf)[tx_done];
+			else
+				w = ((const u32 *)xfer->tx_buf)[tx_done];
+			writel_relaxed(w, tx_reg);
+			tx_done++;
+		} else if (!(chstat & OMAP2_MCSPI_CHSTAT_RXFFE)) {
+			w = readl_relaxed(rx_reg);
+			if (xfer->rx_buf && bytes_per_word == 1)
+				((u8 *)xfer->rx_buf)[rx_done] = w;
+			else if (xfer->rx_buf && bytes_per_word == 2)
+				((u16 *)xfer->rx_buf)[rx_done] = w;
+			else if (xfer->rx_buf)
+				((u32 *)xfer->rx_buf)[rx_done] = w;
+			rx_done++;
+		} else if (time_after(jiffies, timeout)) {
+			dev_err(&spi->dev, "FIFO PIO timed out\n");
+			break;
+		} else {
+			cpu_relax();
+			continue;
+		}
+
+		/* only time out on a lack of progress */
+		timeout = jiffies + msecs_to_jiffies(1000);
+	}
+
+	return rx_done * bytes_per_word;
+}
+
 static u32 omap2_mcspi_calc_divisor(u32 speed_hz)
 {
 	u32 div;
@@ -860,6 +953,7 @@ static int omap2_mcspi_setup_transfer(struct spi_device *spi,
 
 	if (t && t->speed_hz)
 		speed_hz = t->speed_hz;
+	cs->speed_hz = speed_hz;
 
 	speed_hz = min_t(u32, speed_hz, OMAP2_MCSPI_MAX_FREQ);
 	if (speed_hz < (OMAP2_MCSPI_MAX_FREQ / OMAP2_MCSPI_MAX_DIVIDER)) {
@@ -906,7 +1000,8 @@ static int omap2_mcspi_setup_transfer(struct spi_device *spi,
 	/* set clock granularity */
 	l &= ~OMAP2_MCSPI_CHCONF_CLKG;
 	l |= clkg;
-	if (clkg) {
+	if (clkg && (cs->chctrl0 & OMAP2_MCSPI_CHCTRL_EXTCLK_MASK) !=
+		    extclk << 8) {
 		cs->chctrl0 &= ~OMAP2_MCSPI_CHCTRL_EXTCLK_MASK;
 		cs->chctrl0 |= extclk << 8;
 		mcspi_write_cs_reg(spi, OMAP2_MCSPI_CHCTRL0, cs->chctrl0);
@@ -1056,223 +1151,272 @@ static void omap2_mcspi_cleanup(struct spi_device *spi)
 	}
 }
 
-static void omap2_mcspi_work(struct omap2_mcspi *mcspi, struct spi_message *m)
+static void omap2_mcspi_set_cs(struct spi_device *spi, bool enable)
 {
+	struct omap2_mcspi *mcspi = spi_master_get_devdata(spi->master);
+	u32 l;
 
-	/* We only enable one channel at a time -- the one whose message is
-	 * -- although this controller would gladly
-	 * arbitrate among multiple channels.  This corresponds to "single
-	 * channel" master mode.  As a side effect, we need to manage the
-	 * chipselect with the FORCE bit ... CS != channel enable.
+	/*
+	 * The controller handles inverted chip selects through the EPOL bit,
+	 * undo the inversion done by the core.
 	 */
+	if (spi->mode & SPI_CS_HIGH)
+		enable = !enable;
 
-	struct spi_device		*spi;
-	struct spi_transfer		*t = NULL;
-	struct spi_master		*master;
-	struct omap2_mcspi_dma		*mcspi_dma;
-	int				cs_active = 0;
-	struct omap2_mcspi_cs		*cs;
-	struct omap2_mcspi_device_config *cd;
-	int				par_override = 0;
-	int				status = 0;
-	u32				chconf;
+	if (!spi->controller_state)
+		return;
 
-	spi = m->spi;
-	master = spi->master;
-	mcspi_dma = mcspi->dma_channels + spi->chip_select;
-	cs = spi->controller_state;
-	cd = spi->controller_data;
+	/* also called by spi_setup(), outside of any message */
+	if (pm_runtime_get_sync(mcspi->dev) < 0) {
+		pm_runtime_put_noidle(mcspi->dev);
+		return;
+	}
 
-	/*
-	 * The slave driver could have changed spi->mode in which case
-	 * it will be different from cs->mode (the current hardware setup).
-	 * If so, set par_override (even though its not a parity issue) so
-	 * omap2_mcspi_setup_transfer will be called to configure the hardware
-	 * with the correct mode on the first iteration of the loop below.
-	 */
-	if (spi->mode != cs->mode)
-		par_override = 1;
+	l = mcspi_cached_chconf0(spi);
+	if (enable)
+		l &= ~OMAP2_MCSPI_CHCONF_FORCE;
+	else
+		l |= OMAP2_MCSPI_CHCONF_FORCE;
+	mcspi_write_chconf0(spi, l);
+
+	pm_runtime_mark_last_busy(mcspi->dev);
+	pm_runtime_put_autosuspend(mcspi->dev);
+}
+
+static bool omap2_mcspi_use_dma(struct omap2_mcspi *mcspi,
+				struct spi_message *m, struct spi_transfer *t)
+{
+	struct omap2_mcspi_dma *mcspi_dma;
+
+	mcspi_dma = &mcspi->dma_channels[m->spi->chip_select];
+
+	return mcspi_dma->dma_rx && mcspi_dma->dma_tx &&
+	       (t->tx_buf || t->rx_buf) &&
+	       (m->is_dma_mapped || t->len >= mcspi->dma_min_bytes);
+}
+
+/* unmap the transfers of @m following @done, up to but excluding @end */
+static void omap2_mcspi_unmap_msg(struct omap2_mcspi *mcspi,
+				  struct spi_message *m,
+				  struct spi_transfer *done,
+				  struct spi_transfer *end)
+{
+	struct spi_transfer *t;
+
+	if (done)
+		t = list_next_entry(done, transfer_list);
+	else
+		t = list_first_entry(&m->transfers, struct spi_transfer,
+				     transfer_list);
+
+	for (; &t->transfer_list != &m->transfers && t != end;
+	     t = list_next_entry(t, transfer_list)) {
+		if (!omap2_mcspi_use_dma(mcspi, m, t))
+			continue;
+
+		if (t->tx_buf != NULL)
+			dma_unmap_single(mcspi->dev, t->tx_dma, t->len,
+					 DMA_TO_DEVICE);
+		if (t->rx_buf != NULL)
+			dma_unmap_single(mcspi->dev, t->rx_dma, t->len,
+					 DMA_FROM_DEVICE);
+	}
+}
+
+/*
+ * Map every DMA transfer of the message before the first one starts, so
+ * that only the descriptor setup is left between two transfers.  Each
+ * transfer is unmapped by omap2_mcspi_txrx_dma() as soon as it completes,
+ * the ones a failing message never reached are unmapped when it ends.
+ */
+static int omap2_mcspi_map_msg(struct omap2_mcspi *mcspi,
+			       struct spi_message *m)
+{
+	struct spi_transfer *t;
 
-	omap2_mcspi_set_enable(spi, 0);
 	list_for_each_entry(t, &m->transfers, transfer_list) {
-		if (t->tx_buf == NULL && t->rx_buf == NULL && t->len) {
-			status = -EINVAL;
-			break;
-		}
-		if (par_override ||
-		    (t->speed_hz != spi->max_speed_hz) ||
-		    (t->bits_per_word != spi->bits_per_word)) {
-			par_override = 1;
-			status = omap2_mcspi_setup_transfer(spi, t);
-			if (status < 0)
-				break;
-			if (t->speed_hz == spi->max_speed_hz &&
-			    t->bits_per_word == spi->bits_per_word)
-				par_override = 0;
+		if (!omap2_mcspi_use_dma(mcspi, m, t))
+			continue;
+
+		if (t->tx_buf != NULL) {
+			t->tx_dma = dma_map_single(mcspi->dev,
+					(void *)t->tx_buf, t->len,
+					DMA_TO_DEVICE);
+			if (dma_mapping_error(mcspi->dev, t->tx_dma)) {
+				dev_dbg(mcspi->dev, "dma %cX %d bytes error\n",
+						'T', t->len);
+				goto err;
+			}
 		}
-		if (cd && cd->cs_per_word) {
-			chconf = mcspi->ctx.modulctrl;
-			chconf &= ~OMAP2_MCSPI_MODULCTRL_SINGLE;
-			mcspi_write_reg(master, OMAP2_MCSPI_MODULCTRL, chconf);
-			mcspi->ctx.modulctrl =
-				mcspi_read_cs_reg(spi, OMAP2_MCSPI_MODULCTRL);
+		if (t->rx_buf != NULL) {
+			t->rx_dma = dma_map_single(mcspi->dev, t->rx_buf,
+					t->len, DMA_FROM_DEVICE);
+			if (dma_mapping_error(mcspi->dev, t->rx_dma)) {
+				dev_dbg(mcspi->dev, "dma %cX %d bytes error\n",
+						'R', t->len);
+				if (t->tx_buf != NULL)
+					dma_unmap_single(mcspi->dev, t->tx_dma,
+							t->len, DMA_TO_DEVICE);
+				goto err;
+			}
 		}
+	}
 
+	return 0;
 
-		if (!cs_active) {
-			omap2_mcspi_force_cs(spi, 1);
-			cs_active = 1;
-		}
+err:
+	omap2_mcspi_unmap_msg(mcspi, m, NULL, t);
+	return -EINVAL;
+}
 
-		chconf = mcspi_cached_chconf0(spi);
-		chconf &= ~OMAP2_MCSPI_CHCONF_TRM_MASK;
-		chconf &= ~OMAP2_MCSPI_CHCONF_TURBO;
+static void omap2_mcspi_set_cs_per_word(struct spi_device *spi, bool enable)
+{
+	struct omap2_mcspi *mcspi = spi_master_get_devdata(spi->master);
+	u32 l;
 
-		if (t->tx_buf == NULL)
-			chconf |= OMAP2_MCSPI_CHCONF_TRM_RX_ONLY;
-		else if (t->rx_buf == NULL)
-			chconf |= OMAP2_MCSPI_CHCONF_TRM_TX_ONLY;
+	l = mcspi->ctx.modulctrl;
+	if (enable)
+		l &= ~OMAP2_MCSPI_MODULCTRL_SINGLE;
+	else
+		l |= OMAP2_MCSPI_MODULCTRL_SINGLE;
 
-		if (cd && cd->turbo_mode && t->tx_buf == NULL) {
-			/* Turbo mode is for more than one word */
-			if (t->len > ((cs->word_len + 7) >> 3))
-				chconf |= OMAP2_MCSPI_CHCONF_TURBO;
-		}
+	if (l == mcspi->ctx.modulctrl)
+		return;
 
-		mcspi_write_chconf0(spi, chconf);
+	mcspi_write_reg(spi->master, OMAP2_MCSPI_MODULCTRL, l);
+	mcspi->ctx.modulctrl = l;
+}
 
-		if (t->len) {
-			unsigned	count;
+static int omap2_mcspi_prepare_message(struct spi_master *master,
+				       struct spi_message *m)
+{
+	struct omap2_mcspi		*mcspi = spi_master_get_devdata(master);
+	struct omap2_mcspi_regs		*ctx = &mcspi->ctx;
+	struct omap2_mcspi_device_config *cd = m->spi->controller_data;
+	struct omap2_mcspi_cs		*cs;
 
-			if ((mcspi_dma->dma_rx && mcspi_dma->dma_tx) &&
-			    (m->is_dma_mapped || t->len >= DMA_MIN_BYTES))
-				omap2_mcspi_set_fifo(spi, t, 1);
+	/*
+	 * Only one channel may have its chip select forced.  One can be left
+	 * asserted by a message ending with cs_change on another device.
+	 */
+	list_for_each_entry(cs, &ctx->cs, node) {
+		if (cs == m->spi->controller_state ||
+		    !(cs->chconf0 & OMAP2_MCSPI_CHCONF_FORCE))
+			continue;
 
-			omap2_mcspi_set_enable(spi, 1);
+		cs->chconf0 &= ~OMAP2_MCSPI_CHCONF_FORCE;
+		writel_relaxed(cs->chconf0, cs->base + OMAP2_MCSPI_CHCONF0);
+		readl_relaxed(cs->base + OMAP2_MCSPI_CHCONF0);
+	}
 
-			/* RX_ONLY mode needs dummy data in TX reg */
-			if (t->tx_buf == NULL)
-				writel_relaxed(0, cs->base
-						+ OMAP2_MCSPI_TX0);
+	if (cd && cd->cs_per_word)
+		omap2_mcspi_set_cs_per_word(m->spi, true);
 
-			if ((mcspi_dma->dma_rx && mcspi_dma->dma_tx) &&
-			    (m->is_dma_mapped || t->len >= DMA_MIN_BYTES))
-				count = omap2_mcspi_txrx_dma(spi, t);
-			else
-				count = omap2_mcspi_txrx_pio(spi, t);
-			m->actual_length += count;
+	mcspi->last_xfer = NULL;
+	if (m->is_dma_mapped)
+		return 0;
 
-			if (count != t->len) {
-				status = -EIO;
-				break;
-			}
-		}
+	return omap2_mcspi_map_msg(mcspi, m);
+}
 
-		if (t->delay_usecs)
-			udelay(t->delay_usecs);
+static int omap2_mcspi_unprepare_message(struct spi_master *master,
+					 struct spi_message *m)
+{
+	struct omap2_mcspi		*mcspi = spi_master_get_devdata(master);
+	struct omap2_mcspi_device_config *cd = m->spi->controller_data;
 
-		/* ignore the "leave it on after last xfer" hint */
-		if (t->cs_change) {
-			omap2_mcspi_force_cs(spi, 0);
-			cs_active = 0;
-		}
+	if (!m->is_dma_mapped)
+		omap2_mcspi_unmap_msg(mcspi, m, mcspi->last_xfer, NULL);
 
-		omap2_mcspi_set_enable(spi, 0);
+	if (cd && cd->cs_per_word)
+		omap2_mcspi_set_cs_per_word(m->spi, false);
 
-		if (mcspi->fifo_depth > 0)
-			omap2_mcspi_set_fifo(spi, t, 0);
-	}
-	/* Restore defaults if they were overriden */
-	if (par_override) {
-		par_override = 0;
-		status = omap2_mcspi_setup_transfer(spi, NULL);
+	return 0;
+}
+
+static int omap2_mcspi_transfer_one(struct spi_master *master,
+		struct spi_device *spi, struct spi_transfer *t)
+{
+
+	/* We only enable one channel at a time -- the one whose message is
+	 * -- although this controller would gladly
+	 * arbitrate among multiple channels.  This corresponds to "single
+	 * channel" master mode.  As a side effect, we need to manage the
+	 * chipselect with the FORCE bit ... CS != channel enable.
+	 */
+
+	struct omap2_mcspi		*mcspi = spi_master_get_devdata(master);
+	struct spi_message		*m = master->cur_msg;
+	struct omap2_mcspi_cs		*cs = spi->controller_state;
+	struct omap2_mcspi_device_config *cd = spi->controller_data;
+	bool				use_dma, fifo_pio;
+	unsigned			count;
+	u32				chconf;
+	int				status;
+
+	/*
+	 * The slave driver could have changed spi->mode, and a transfer can
+	 * override the word length and rate, reprogram the channel only when
+	 * its setup differs from the previous transfer.
+	 */
+	if (spi->mode != cs->mode || t->speed_hz != cs->speed_hz ||
+	    t->bits_per_word != cs->word_len) {
+		status = omap2_mcspi_setup_transfer(spi, t);
+		if (status < 0)
+			return status;
 	}
 
-	if (cs_active)
-		omap2_mcspi_force_cs(spi, 0);
+	use_dma = t->len && omap2_mcspi_use_dma(mcspi, m, t);
+	fifo_pio = t->len && !use_dma && omap2_mcspi_fifo_pio_ok(spi, t);
 
-	if (cd && cd->cs_per_word) {
-		chconf = mcspi->ctx.modulctrl;
-		chconf |= OMAP2_MCSPI_MODULCTRL_SINGLE;
-		mcspi_write_reg(master, OMAP2_MCSPI_MODULCTRL, chconf);
-		mcspi->ctx.modulctrl =
-			mcspi_read_cs_reg(spi, OMAP2_MCSPI_MODULCTRL);
+	chconf = mcspi_cached_chconf0(spi);
+	chconf &= ~OMAP2_MCSPI_CHCONF_TRM_MASK;
+	chconf &= ~OMAP2_MCSPI_CHCONF_TURBO;
+
+	/* FIFO PIO always transmits and receives */
+	if (t->tx_buf == NULL && !fifo_pio)
+		chconf |= OMAP2_MCSPI_CHCONF_TRM_RX_ONLY;
+	else if (t->rx_buf == NULL && !fifo_pio)
+		chconf |= OMAP2_MCSPI_CHCONF_TRM_TX_ONLY;
+
+	if (cd && cd->turbo_mode && t->tx_buf == NULL && !fifo_pio) {
+		/* Turbo mode is for more than one word */
+		if (t->len > ((cs->word_len + 7) >> 3))
+			chconf |= OMAP2_MCSPI_CHCONF_TURBO;
 	}
 
-	omap2_mcspi_set_enable(spi, 0);
+	mcspi_write_chconf0(spi, chconf);
 
-	if (mcspi->fifo_depth > 0 && t)
-		omap2_mcspi_set_fifo(spi, t, 0);
+	if (!t->len)
+		return 0;
 
-	m->status = status;
-}
+	if (use_dma)
+		omap2_mcspi_set_fifo(spi, t, 1);
+	else if (fifo_pio)
+		omap2_mcspi_fifo_pio_enable(spi, 1);
 
-static int omap2_mcspi_transfer_one_message(struct spi_master *master,
-		struct spi_message *m)
-{
-	struct spi_device	*spi;
-	struct omap2_mcspi	*mcspi;
-	struct omap2_mcspi_dma	*mcspi_dma;
-	struct spi_transfer	*t;
-	int status;
+	omap2_mcspi_set_enable(spi, 1);
 
-	spi = m->spi;
-	mcspi = spi_master_get_devdata(master);
-	mcspi_dma = mcspi->dma_channels + spi->chip_select;
-	m->actual_length = 0;
-	m->status = 0;
+	/* RX_ONLY mode needs dummy data in TX reg */
+	if (t->tx_buf == NULL && !fifo_pio)
+		writel_relaxed(0, cs->base + OMAP2_MCSPI_TX0);
 
-	list_for_each_entry(t, &m->transfers, transfer_list) {
-		const void	*tx_buf = t->tx_buf;
-		void		*rx_buf = t->rx_buf;
-		unsigned	len = t->len;
-
-		if ((len && !(rx_buf || tx_buf))) {
-			dev_dbg(mcspi->dev, "transfer: %d Hz, %d %s%s, %d bpw\n",
-					t->speed_hz,
-					len,
-					tx_buf ? "tx" : "",
-					rx_buf ? "rx" : "",
-					t->bits_per_word);
-			status = -EINVAL;
-			goto out;
-		}
+	mcspi->last_xfer = t;
+	if (use_dma)
+		count = omap2_mcspi_txrx_dma(spi, t);
+	else if (fifo_pio)
+		count = omap2_mcspi_txrx_pio_fifo(spi, t);
+	else
+		count = omap2_mcspi_txrx_pio(spi, t);
 
-		if (m->is_dma_mapped || len < DMA_MIN_BYTES)
-			continue;
+	omap2_mcspi_set_enable(spi, 0);
 
-		if (mcspi_dma->dma_tx && tx_buf != NULL) {
-			t->tx_dma = dma_map_single(mcspi->dev, (void *) tx_buf,
-					len, DMA_TO_DEVICE);
-			if (dma_mapping_error(mcspi->dev, t->tx_dma)) {
-				dev_dbg(mcspi->dev, "dma %cX %d bytes error\n",
-						'T', len);
-				status = -EINVAL;
-				goto out;
-			}
-		}
-		if (mcspi_dma->dma_rx && rx_buf != NULL) {
-			t->rx_dma = dma_map_single(mcspi->dev, rx_buf, t->len,
-					DMA_FROM_DEVICE);
-			if (dma_mapping_error(mcspi->dev, t->rx_dma)) {
-				dev_dbg(mcspi->dev, "dma %cX %d bytes error\n",
-						'R', len);
-				if (tx_buf != NULL)
-					dma_unmap_single(mcspi->dev, t->tx_dma,
-							len, DMA_TO_DEVICE);
-				status = -EINVAL;
-				goto out;
-			}
-		}
-	}
+	if (fifo_pio)
+		omap2_mcspi_fifo_pio_enable(spi, 0);
+	else if (mcspi->fifo_depth > 0)
+		omap2_mcspi_set_fifo(spi, t, 0);
 
-	omap2_mcspi_work(mcspi, m);
-	/* spi_finalize_current_message() changes the status inside the
-	 * spi_message, save the status here. */
-	status = m->status;
-out:
-	spi_finalize_current_message(master);
-	return status;
+	return count == t->len ? 0 : -EIO;
 }
 
 static int omap2_mcspi_master_setup(struct omap2_mcspi *mcspi)
@@ -1351,7 +1495,10 @@ static int omap2_mcspi_probe(struct platform_device *pdev)
 	master->bits_per_word_mask = SPI_BPW_RANGE_MASK(4, 32);
 	master->setup = omap2_mcspi_setup;
 	master->auto_runtime_pm = true;
-	master->transfer_one_message = omap2_mcspi_transfer_one_message;
+	master->prepare_message = omap2_mcspi_prepare_message;
+	master->unprepare_message = omap2_mcspi_unprepare_message;
+	master->transfer_one = omap2_mcspi_transfer_one;
+	master->set_cs = omap2_mcspi_set_cs;
 	master->cleanup = omap2_mcspi_cleanup;
 	master->dev.of_node = node;
 	master->max_speed_hz = OMAP2_MCSPI_MAX_FREQ;
@@ -1363,6 +1510,7 @@ static int omap2_mcspi_probe(struct platform_device *pdev)
 	mcspi->master = master;
 
 	mcspi->pio_mode = 0;
+	mcspi->dma_min_bytes = dma_min_bytes;
 
 	match = of_match_device(omap_mcspi_of_match, &pdev->dev);
 	if (match) {
@@ -1376,6 +1524,8 @@ static int omap2_mcspi_probe(struct platform_device *pdev)
 			mcspi->pin_dir = MCSPI_PINDIR_D0_OUT_D1_IN;
 		if (of_get_property(node, "ti,pio-mode", NULL))
 			mcspi->pio_mode = MCSPI_PIO_MODE;
+		of_property_read_u32(node, "ti,dma-min-bytes",
+				     &mcspi->dma_min_bytes);
 	} else {
 		pdata = dev_get_platdata(&pdev->dev);
 		master->num_chipselect = pdata->num_cs;
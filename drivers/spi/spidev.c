@@ -26,6 +26,9 @@
 #include <linux/errno.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
 #include <linux/compat.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
@@ -84,6 +87,17 @@ struct spidev_data {
 	u8			*tx_buffer;
 	u8			*rx_buffer;
 	u32			speed_hz;
+
+	/* asynchronous messages, owned by one open file at a time */
+	struct mutex		async_mutex;
+	struct file		*async_owner;
+	void			*async_buf;
+	size_t			async_buf_size;
+	spinlock_t		async_lock;
+	struct list_head	async_done;
+	unsigned		async_count;	/* submitted, not yet read */
+	unsigned		async_active;	/* submitted, not yet done */
+	wait_queue_head_t	async_wait;
 };
 
 static LIST_HEAD(device_list);
@@ -93,6 +107,15 @@ static unsigned bufsiz = 4096;
 module_param(bufsiz, uint, S_IRUGO);
 MODULE_PARM_DESC(bufsiz, "data bytes in biggest supported SPI message");
 
+static unsigned async_bufsiz = 65536;
+module_param(async_bufsiz, uint, S_IRUGO);
+MODULE_PARM_DESC(async_bufsiz,
+	"data bytes in the buffer area mapped for asynchronous messages");
+
+static unsigned async_depth = 16;
+module_param(async_depth, uint, S_IRUGO);
+MODULE_PARM_DESC(async_depth, "asynchronous messages queued per device");
+
 /*-------------------------------------------------------------------------*/
 
 /*
@@ -161,6 +184,259 @@ spidev_sync_read(struct spidev_data *spidev, size_t len)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Asynchronous messages transfer straight from and to the buffer area the
+ * owning file maps, so neither direction goes through the bounce buffers,
+ * and up to async_depth of them can be queued to the controller at once.
+ */
+struct spidev_async {
+	struct list_head	node;
+	struct spidev_data	*spidev;
+	struct spi_message	msg;
+	u64			user_data;
+	struct spi_transfer	xfers[0];
+};
+
+/* same limit as the size field of SPI_IOC_MESSAGE imposes */
+#define SPIDEV_ASYNC_MAX_XFERS \
+	((1 << _IOC_SIZEBITS) / sizeof(struct spi_ioc_transfer))
+
+static void spidev_async_complete(void *arg)
+{
+	struct spidev_async	*async = arg;
+	struct spidev_data	*spidev = async->spidev;
+	unsigned long		flags;
+
+	/* wake up under the lock, release may free spidev right after */
+	spin_lock_irqsave(&spidev->async_lock, flags);
+	list_add_tail(&async->node, &spidev->async_done);
+	spidev->async_active--;
+	wake_up(&spidev->async_wait);
+	spin_unlock_irqrestore(&spidev->async_lock, flags);
+}
+
+/* called with async_mutex held */
+static int spidev_async_claim(struct spidev_data *spidev, struct file *filp)
+{
+	if (spidev->async_owner && spidev->async_owner != filp)
+		return -EBUSY;
+
+	spidev->async_owner = filp;
+	return 0;
+}
+
+static void *spidev_async_buf(struct spidev_data *spidev, u64 offset,
+		u32 len)
+{
+	if (offset == SPI_IOC_ASYNC_NO_BUF)
+		return NULL;
+
+	if (offset > spidev->async_buf_size ||
+			len > spidev->async_buf_size - offset)
+		return ERR_PTR(-EINVAL);
+
+	return spidev->async_buf + offset;
+}
+
+static int spidev_async_submit(struct spidev_data *spidev, struct file *filp,
+		struct spi_ioc_async __user *u_async)
+{
+	struct spi_ioc_async	req;
+	struct spi_ioc_transfer	*u_xfers;
+	struct spi_ioc_transfer	*u_tmp;
+	struct spi_transfer	*k_tmp;
+	struct spidev_async	*async = NULL;
+	unsigned		n, total = 0;
+	void			*buf;
+	int			status;
+
+	if (copy_from_user(&req, u_async, sizeof(req)))
+		return -EFAULT;
+
+	if (!req.n_transfers || req.pad)
+		return -EINVAL;
+	if (req.n_transfers > SPIDEV_ASYNC_MAX_XFERS)
+		return -EMSGSIZE;
+
+	u_xfers = memdup_user((void __user *)(uintptr_t)req.transfers,
+			req.n_transfers * sizeof(*u_xfers));
+	if (IS_ERR(u_xfers))
+		return PTR_ERR(u_xfers);
+
+	mutex_lock(&spidev->async_mutex);
+	status = spidev_async_claim(spidev, filp);
+	mutex_unlock(&spidev->async_mutex);
+	if (status)
+		goto done;
+
+	async = kzalloc(sizeof(*async) +
+			req.n_transfers * sizeof(async->xfers[0]), GFP_KERNEL);
+	if (!async) {
+		status = -ENOMEM;
+		goto done;
+	}
+	async->spidev = spidev;
+	async->user_data = req.user_data;
+	spi_message_init(&async->msg);
+	async->msg.complete = spidev_async_complete;
+	async->msg.context = async;
+
+	/* The buffer area only goes away when the owner, which is the
+	 * caller, is released; no need to lock it around the checks.
+	 */
+	for (n = 0; n < req.n_transfers; n++) {
+		u_tmp = &u_xfers[n];
+		k_tmp = &async->xfers[n];
+
+		total += u_tmp->len;
+		if (total > INT_MAX || u_tmp->len > INT_MAX) {
+			status = -EMSGSIZE;
+			goto done;
+		}
+
+		buf = spidev_async_buf(spidev, u_tmp->tx_buf, u_tmp->len);
+		if (IS_ERR(buf)) {
+			status = PTR_ERR(buf);
+			goto done;
+		}
+		k_tmp->tx_buf = buf;
+
+		buf = spidev_async_buf(spidev, u_tmp->rx_buf, u_tmp->len);
+		if (IS_ERR(buf)) {
+			status = PTR_ERR(buf);
+			goto done;
+		}
+		k_tmp->rx_buf = buf;
+
+		k_tmp->len = u_tmp->len;
+		k_tmp->cs_change = !!u_tmp->cs_change;
+		k_tmp->tx_nbits = u_tmp->tx_nbits;
+		k_tmp->rx_nbits = u_tmp->rx_nbits;
+		k_tmp->bits_per_word = u_tmp->bits_per_word;
+		k_tmp->delay_usecs = u_tmp->delay_usecs;
+		k_tmp->speed_hz = u_tmp->speed_hz;
+		if (!k_tmp->speed_hz)
+			k_tmp->speed_hz = spidev->speed_hz;
+		spi_message_add_tail(k_tmp, &async->msg);
+	}
+
+	spin_lock_irq(&spidev->async_lock);
+	if (spidev->async_count >= async_depth) {
+		status = -EAGAIN;
+	} else {
+		spidev->async_count++;
+		spidev->async_active++;
+	}
+	spin_unlock_irq(&spidev->async_lock);
+	if (status)
+		goto done;
+
+	spin_lock_irq(&spidev->spi_lock);
+	if (spidev->spi == NULL)
+		status = -ESHUTDOWN;
+	else
+		status = spi_async(spidev->spi, &async->msg);
+	spin_unlock_irq(&spidev->spi_lock);
+
+	if (status) {
+		spin_lock_irq(&spidev->async_lock);
+		spidev->async_count--;
+		spidev->async_active--;
+		spin_unlock_irq(&spidev->async_lock);
+		goto done;
+	}
+
+	/* spidev_async_complete() owns it now */
+	async = NULL;
+
+done:
+	kfree(async);
+	kfree(u_xfers);
+	return status;
+}
+
+static ssize_t spidev_async_read(struct spidev_data *spidev,
+		struct file *filp, char __user *buf, size_t count)
+{
+	struct spi_ioc_async_completion	comp;
+	struct spidev_async		*async;
+	size_t				copied = 0;
+	int				status;
+
+	if (count < sizeof(comp))
+		return -EINVAL;
+
+	while (count - copied >= sizeof(comp)) {
+		spin_lock_irq(&spidev->async_lock);
+		async = list_first_entry_or_null(&spidev->async_done,
+				struct spidev_async, node);
+		if (async)
+			list_del(&async->node);
+		spin_unlock_irq(&spidev->async_lock);
+
+		if (!async) {
+			if (copied)
+				break;
+			if (filp->f_flags & O_NONBLOCK)
+				return -EAGAIN;
+			status = wait_event_interruptible(spidev->async_wait,
+					!list_empty(&spidev->async_done));
+			if (status)
+				return status;
+			continue;
+		}
+
+		comp.user_data = async->user_data;
+		comp.status = async->msg.status;
+		comp.actual_length = async->msg.actual_length;
+
+		if (copy_to_user(buf + copied, &comp, sizeof(comp))) {
+			spin_lock_irq(&spidev->async_lock);
+			list_add(&async->node, &spidev->async_done);
+			spin_unlock_irq(&spidev->async_lock);
+			return copied ? copied : -EFAULT;
+		}
+		copied += sizeof(comp);
+		kfree(async);
+
+		/* a slot for one more message is free, see spidev_poll() */
+		spin_lock_irq(&spidev->async_lock);
+		spidev->async_count--;
+		wake_up(&spidev->async_wait);
+		spin_unlock_irq(&spidev->async_lock);
+	}
+
+	return copied;
+}
+
+/* called by the owner on release, when the buffer area is unmapped */
+static void spidev_async_release(struct spidev_data *spidev)
+{
+	struct spidev_async	*async, *tmp;
+	LIST_HEAD(done);
+
+	/* messages already handed to the controller cannot be recalled */
+	wait_event(spidev->async_wait, !ACCESS_ONCE(spidev->async_active));
+
+	spin_lock_irq(&spidev->async_lock);
+	list_splice_init(&spidev->async_done, &done);
+	spidev->async_count = 0;
+	spin_unlock_irq(&spidev->async_lock);
+
+	list_for_each_entry_safe(async, tmp, &done, node)
+		kfree(async);
+
+	mutex_lock(&spidev->async_mutex);
+	if (spidev->async_buf)
+		free_pages_exact(spidev->async_buf, spidev->async_buf_size);
+	spidev->async_buf = NULL;
+	spidev->async_buf_size = 0;
+	spidev->async_owner = NULL;
+	mutex_unlock(&spidev->async_mutex);
+}
+
+/*-------------------------------------------------------------------------*/
+
 /* Read-only message with current device setup */
 static ssize_t
 spidev_read(struct file *filp, char __user *buf, size_t count, loff_t *f_pos)
@@ -168,12 +444,16 @@ spidev_read(struct file *filp, char __user *buf, size_t count, loff_t *f_pos)
 	struct spidev_data	*spidev;
 	ssize_t			status = 0;
 
+	spidev = filp->private_data;
+
+	/* the owner of asynchronous messages reads their completions */
+	if (filp == ACCESS_ONCE(spidev->async_owner))
+		return spidev_async_read(spidev, filp, buf, count);
+
 	/* chipselect only toggles at start or end of operation */
 	if (count > bufsiz)
 		return -EMSGSIZE;
 
-	spidev = filp->private_data;
-
 	mutex_lock(&spidev->buf_lock);
 	status = spidev_sync_read(spidev, count);
 	if (status > 0) {
@@ -500,6 +780,11 @@ spidev_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		}
 		break;
 
+	case SPI_IOC_ASYNC_SUBMIT:
+		retval = spidev_async_submit(spidev, filp,
+				(struct spi_ioc_async __user *)arg);
+		break;
+
 	default:
 		/* segmented and/or full-duplex I/O request */
 		/* Check message and copy into scratch area */
@@ -592,6 +877,68 @@ spidev_compat_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 #define spidev_compat_ioctl NULL
 #endif /* CONFIG_COMPAT */
 
+static unsigned int spidev_poll(struct file *filp, poll_table *wait)
+{
+	struct spidev_data	*spidev = filp->private_data;
+	unsigned int		mask = 0;
+
+	/* plain read() and write() are always ready */
+	if (filp != ACCESS_ONCE(spidev->async_owner))
+		return DEFAULT_POLLMASK;
+
+	poll_wait(filp, &spidev->async_wait, wait);
+
+	spin_lock_irq(&spidev->async_lock);
+	if (!list_empty(&spidev->async_done))
+		mask |= POLLIN | POLLRDNORM;
+	if (spidev->async_count < async_depth)
+		mask |= POLLOUT | POLLWRNORM;
+	spin_unlock_irq(&spidev->async_lock);
+
+	return mask;
+}
+
+static int spidev_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct spidev_data	*spidev = filp->private_data;
+	unsigned long		size = vma->vm_end - vma->vm_start;
+	int			status;
+
+	if (vma->vm_pgoff || !async_bufsiz)
+		return -EINVAL;
+
+	mutex_lock(&spidev->async_mutex);
+	status = spidev_async_claim(spidev, filp);
+	if (status)
+		goto done;
+
+	/* physically contiguous, so controllers can DMA straight to it */
+	if (!spidev->async_buf) {
+		size_t	len = PAGE_ALIGN(async_bufsiz);
+
+		spidev->async_buf = alloc_pages_exact(len,
+				GFP_KERNEL | __GFP_ZERO);
+		if (!spidev->async_buf) {
+			status = -ENOMEM;
+			goto done;
+		}
+		spidev->async_buf_size = len;
+	}
+
+	if (size > spidev->async_buf_size) {
+		status = -EINVAL;
+		goto done;
+	}
+
+	status = remap_pfn_range(vma, vma->vm_start,
+			virt_to_phys(spidev->async_buf) >> PAGE_SHIFT,
+			size, vma->vm_page_prot);
+
+done:
+	mutex_unlock(&spidev->async_mutex);
+	return status;
+}
+
 static int spidev_open(struct inode *inode, struct file *filp)
 {
 	struct spidev_data	*spidev;
@@ -649,8 +996,12 @@ static int spidev_release(struct inode *inode, struct file *filp)
 	struct spidev_data	*spidev;
 	int			status = 0;
 
-	mutex_lock(&device_list_lock);
+	/* a mapping holds a reference on its file, so it is gone by now */
 	spidev = filp->private_data;
+	if (filp == spidev->async_owner)
+		spidev_async_release(spidev);
+
+	mutex_lock(&device_list_lock);
 	filp->private_data = NULL;
 
 	/* last close? */
@@ -688,6 +1039,8 @@ static const struct file_operations spidev_fops = {
 	 */
 	.write =	spidev_write,
 	.read =		spidev_read,
+	.poll =		spidev_poll,
+	.mmap =		spidev_mmap,
 	.unlocked_ioctl = spidev_ioctl,
 	.compat_ioctl = spidev_compat_ioctl,
 	.open =		spidev_open,
@@ -740,6 +1093,10 @@ static int spidev_probe(struct spi_device *spi)
 	spidev->spi = spi;
 	spin_lock_init(&spidev->spi_lock);
 	mutex_init(&spidev->buf_lock);
+	mutex_init(&spidev->async_mutex);
+	spin_lock_init(&spidev->async_lock);
+	INIT_LIST_HEAD(&spidev->async_done);
+	init_waitqueue_head(&spidev->async_wait);
 
 	INIT_LIST_HEAD(&spidev->device_entry);
 
@@ -204,6 +204,7 @@ static struct fbtft_display display = {
 	.height = HEIGHT,
 	.gamma_num = 2,
 	.gamma_len = 14,
+	.rect_update = true,
 	.fbtftops = {
 		.init_display = init_display,
 		.set_addr_win = set_addr_win,
@@ -104,6 +104,7 @@ static struct fbtft_display display = {
 	.width = WIDTH,
 	.height = HEIGHT,
 	.init_sequence = default_init_sequence,
+	.rect_update = true,
 	.fbtftops = {
 		.set_addr_win = set_addr_win,
 		.set_var = set_var,
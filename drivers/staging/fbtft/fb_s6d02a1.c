@@ -151,6 +151,7 @@ static struct fbtft_display display = {
 	.width = 128,
 	.height = 160,
 	.init_sequence = default_init_sequence,
+	.rect_update = true,
 	.fbtftops = {
 		.set_addr_win = set_addr_win,
 		.set_var = set_var,
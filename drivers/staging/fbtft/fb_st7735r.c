@@ -177,6 +177,7 @@ static struct fbtft_display display = {
 	.gamma_num = 2,
 	.gamma_len = 16,
 	.gamma = DEFAULT_GAMMA,
+	.rect_update = true,
 	.fbtftops = {
 		.set_addr_win = set_addr_win,
 		.set_var = set_var,
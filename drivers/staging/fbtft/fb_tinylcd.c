@@ -108,6 +108,7 @@ static struct fbtft_display display = {
 	.regwidth = 8,
 	.width = WIDTH,
 	.height = HEIGHT,
+	.rect_update = true,
 	.fbtftops = {
 		.init_display = init_display,
 		.set_addr_win = set_addr_win,
@@ -1,5 +1,7 @@
 #include <linux/export.h>
 #include <linux/errno.h>
+#include <linux/completion.h>
+#include <linux/kernel.h>
 #include <linux/gpio.h>
 #include <linux/spi/spi.h>
 #include "fbtft.h"
@@ -127,6 +129,118 @@ EXPORT_SYMBOL(fbtft_write_reg8_bus9);
  *****************************************************************************/
 
 /* 16 bit pixel over 8-bit databus */
+/*
+ * Convert RGB565 pixels to big endian bus order.  With both buffers word
+ * aligned, two pixels are swapped per 32-bit load/store.
+ */
+static void fbtft_swab16_pixels(u16 *dst, const u16 *src, size_t count)
+{
+#ifdef __LITTLE_ENDIAN
+	size_t i = 0;
+
+	if (!(((unsigned long)dst | (unsigned long)src) & 3)) {
+		const u32 *s32 = (const u32 *)src;
+		u32 *d32 = (u32 *)dst;
+		u32 v;
+
+		for (; i < count / 2; i++) {
+			v = s32[i];
+			d32[i] = ((v & 0x00ff00ff) << 8) |
+				 ((v >> 8) & 0x00ff00ff);
+		}
+		i *= 2;
+	}
+
+	for (; i < count; i++)
+		dst[i] = cpu_to_be16(src[i]);
+#else
+	memcpy(dst, src, count * 2);
+#endif
+}
+
+struct fbtft_async_xfer {
+	struct spi_message m;
+	struct spi_transfer t;
+	struct completion done;
+	bool busy;
+};
+
+static void fbtft_async_complete(void *context)
+{
+	complete(context);
+}
+
+static int fbtft_async_wait(struct fbtft_async_xfer *x)
+{
+	if (!x->busy)
+		return 0;
+
+	wait_for_completion(&x->done);
+	x->busy = false;
+
+	return x->m.status;
+}
+
+/*
+ * Plain SPI with a large enough txbuf: use the two halves of txbuf in
+ * turn, converting the next chunk while the previous one is on the wire.
+ */
+static int fbtft_write_vmem16_bus8_async(struct fbtft_par *par, u16 *vmem16,
+					 size_t remain)
+{
+	struct fbtft_async_xfer xfer[2] = { };
+	size_t half = (par->txbuf.len / 2) & ~3;
+	size_t startbyte_size = par->startbyte ? 1 : 0;
+	size_t tx_array_size = (half - startbyte_size) / 2;
+	size_t to_copy;
+	int ret = 0, i = 0, err;
+
+	while (remain) {
+		struct fbtft_async_xfer *x = &xfer[i];
+		u8 *buf = par->txbuf.buf + i * half;
+
+		ret = fbtft_async_wait(x);
+		if (ret < 0)
+			break;
+
+		to_copy = min(remain, tx_array_size);
+		if (par->startbyte)
+			*buf = par->startbyte | 0x2;
+		fbtft_swab16_pixels((u16 *)(buf + startbyte_size), vmem16,
+				    to_copy);
+
+		spi_message_init(&x->m);
+		memset(&x->t, 0, sizeof(x->t));
+		x->t.tx_buf = buf;
+		x->t.len = startbyte_size + to_copy * 2;
+		if (par->txbuf.dma) {
+			x->t.tx_dma = par->txbuf.dma + i * half;
+			x->m.is_dma_mapped = 1;
+		}
+		spi_message_add_tail(&x->t, &x->m);
+		init_completion(&x->done);
+		x->m.complete = fbtft_async_complete;
+		x->m.context = &x->done;
+
+		ret = spi_async(par->spi, &x->m);
+		if (ret < 0)
+			break;
+		x->busy = true;
+
+		vmem16 += to_copy;
+		remain -= to_copy;
+		i ^= 1;
+	}
+
+	for (i = 0; i < 2; i++) {
+		err = fbtft_async_wait(&xfer[i]);
+		if (err < 0 && !ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
 int fbtft_write_vmem16_bus8(struct fbtft_par *par, size_t offset, size_t len)
 {
 	u16 *vmem16;
@@ -134,7 +248,6 @@ int fbtft_write_vmem16_bus8(struct fbtft_par *par, size_t offset, size_t len)
 	size_t remain;
 	size_t to_copy;
 	size_t tx_array_size;
-	int i;
 	int ret = 0;
 	size_t startbyte_size = 0;
 
@@ -151,6 +264,12 @@ int fbtft_write_vmem16_bus8(struct fbtft_par *par, size_t offset, size_t len)
 	if (!par->txbuf.buf)
 		return par->fbtftops.write(par, vmem16, len);
 
+	/* double buffered write, overlapping conversion and transfer */
+	if (par->spi && par->fbtftops.write == fbtft_write_spi &&
+	    par->txbuf.len >= 2 * FBTFT_ASYNC_MIN_CHUNK &&
+	    len > par->txbuf.len / 2)
+		return fbtft_write_vmem16_bus8_async(par, vmem16, remain);
+
 	/* buffered write */
 	tx_array_size = par->txbuf.len / 2;
 
@@ -166,8 +285,7 @@ int fbtft_write_vmem16_bus8(struct fbtft_par *par, size_t offset, size_t len)
 		dev_dbg(par->info->device, "    to_copy=%zu, remain=%zu\n",
 						to_copy, remain - to_copy);
 
-		for (i = 0; i < to_copy; i++)
-			txbuf16[i] = cpu_to_be16(vmem16[i]);
+		fbtft_swab16_pixels(txbuf16, vmem16, to_copy);
 
 		vmem16 = vmem16 + to_copy;
 		ret = par->fbtftops.write(par, par->txbuf.buf,
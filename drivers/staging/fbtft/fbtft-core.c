@@ -463,6 +463,167 @@ static void fbtft_mkdirty(struct fb_info *info, int y, int height)
 	schedule_delayed_work(&info->deferred_work, fbdefio->delay);
 }
 
+static unsigned fbtft_rect_area(const struct fbtft_rect *r)
+{
+	return (r->x2 - r->x1 + 1) * (r->y2 - r->y1 + 1);
+}
+
+static void fbtft_rect_union(struct fbtft_rect *dst,
+			     const struct fbtft_rect *r)
+{
+	dst->x1 = min(dst->x1, r->x1);
+	dst->y1 = min(dst->y1, r->y1);
+	dst->x2 = max(dst->x2, r->x2);
+	dst->y2 = max(dst->y2, r->y2);
+}
+
+/*
+ * Add @r to the dirty rectangle list.  It is merged with an entry when
+ * the bounding box costs at most two extra display lines of pixels, and
+ * into the entry that grows least when the list is full.
+ */
+static void fbtft_add_rect(struct fbtft_par *par, struct fbtft_rect *rects,
+			   unsigned *num, const struct fbtft_rect *r)
+{
+	long slack = 2 * par->info->var.xres;
+	struct fbtft_rect new = *r, u;
+	long cost, best_cost;
+	unsigned i, best;
+
+again:
+	best = 0;
+	best_cost = LONG_MAX;
+	for (i = 0; i < *num; i++) {
+		u = rects[i];
+		fbtft_rect_union(&u, &new);
+		cost = (long)fbtft_rect_area(&u) -
+		       fbtft_rect_area(&rects[i]) - fbtft_rect_area(&new);
+		if (cost <= slack) {
+			/* the union may now overlap other entries */
+			rects[i] = rects[--(*num)];
+			new = u;
+			goto again;
+		}
+		if (cost < best_cost) {
+			best = i;
+			best_cost = cost;
+		}
+	}
+
+	if (*num < FBTFT_MAX_DIRTY_RECTS)
+		rects[(*num)++] = new;
+	else
+		fbtft_rect_union(&rects[best], &new);
+}
+
+static void fbtft_mkdirty_rect(struct fb_info *info, u32 x, u32 y,
+			       u32 width, u32 height)
+{
+	struct fbtft_par *par = info->par;
+	struct fbtft_rect r;
+
+	if (!par->rect_update) {
+		par->fbtftops.mkdirty(info, y, height);
+		return;
+	}
+
+	if (!width || !height ||
+	    x >= info->var.xres || y >= info->var.yres)
+		return;
+
+	r.x1 = x;
+	r.y1 = y;
+	r.x2 = min(x + width - 1, info->var.xres - 1);
+	r.y2 = min(y + height - 1, info->var.yres - 1);
+
+	spin_lock(&par->dirty_lock);
+	fbtft_add_rect(par, par->dirty_rects, &par->num_dirty_rects, &r);
+	spin_unlock(&par->dirty_lock);
+
+	schedule_delayed_work(&info->deferred_work, info->fbdefio->delay);
+}
+
+/*
+ * Narrow areas are sent one line at a time into a matching address
+ * window, wide ones go out as a single band of full lines.
+ */
+static void fbtft_update_rect(struct fbtft_par *par,
+			      const struct fbtft_rect *r)
+{
+	struct fb_info *info = par->info;
+	unsigned width = r->x2 - r->x1 + 1;
+	unsigned bytes = info->var.bits_per_pixel / 8;
+	unsigned y;
+	int ret;
+
+	if (width * 2 > info->var.xres) {
+		par->fbtftops.update_display(par, r->y1, r->y2);
+		return;
+	}
+
+	fbtft_par_dbg(DEBUG_UPDATE_DISPLAY, par, "%s(%u,%u - %u,%u)\n",
+		__func__, r->x1, r->y1, r->x2, r->y2);
+
+	par->fbtftops.set_addr_win(par, r->x1, r->y1, r->x2, r->y2);
+
+	for (y = r->y1; y <= r->y2; y++) {
+		ret = par->fbtftops.write_vmem(par,
+				y * info->fix.line_length + r->x1 * bytes,
+				width * bytes);
+		if (ret < 0) {
+			dev_err(info->device,
+				"%s: write_vmem failed to update display buffer\n",
+				__func__);
+			return;
+		}
+	}
+}
+
+static void fbtft_deferred_io_rects(struct fb_info *info,
+				    struct list_head *pagelist)
+{
+	struct fbtft_par *par = info->par;
+	struct fbtft_rect rects[FBTFT_MAX_DIRTY_RECTS], r;
+	unsigned dirty_lines_start, dirty_lines_end;
+	unsigned num, i;
+	struct page *page;
+	unsigned long index;
+
+	spin_lock(&par->dirty_lock);
+	dirty_lines_start = par->dirty_lines_start;
+	dirty_lines_end = par->dirty_lines_end;
+	num = par->num_dirty_rects;
+	memcpy(rects, par->dirty_rects, num * sizeof(*rects));
+	/* set display line markers and rectangles as clean */
+	par->dirty_lines_start = par->info->var.yres - 1;
+	par->dirty_lines_end = 0;
+	par->num_dirty_rects = 0;
+	spin_unlock(&par->dirty_lock);
+
+	/* whole lines from mkdirty() and mmap writes */
+	r.x1 = 0;
+	r.x2 = info->var.xres - 1;
+	if (dirty_lines_start <= dirty_lines_end) {
+		r.y1 = dirty_lines_start;
+		r.y2 = dirty_lines_end;
+		fbtft_add_rect(par, rects, &num, &r);
+	}
+
+	list_for_each_entry(page, pagelist, lru) {
+		index = page->index << PAGE_SHIFT;
+		r.y1 = index / info->fix.line_length;
+		r.y2 = (index + PAGE_SIZE - 1) / info->fix.line_length;
+		if (r.y1 > info->var.yres - 1)
+			continue;
+		if (r.y2 > info->var.yres - 1)
+			r.y2 = info->var.yres - 1;
+		fbtft_add_rect(par, rects, &num, &r);
+	}
+
+	for (i = 0; i < num; i++)
+		fbtft_update_rect(par, &rects[i]);
+}
+
 static void fbtft_deferred_io(struct fb_info *info, struct list_head *pagelist)
 {
 	struct fbtft_par *par = info->par;
@@ -472,6 +633,11 @@ static void fbtft_deferred_io(struct fb_info *info, struct list_head *pagelist)
 	unsigned y_low = 0, y_high = 0;
 	int count = 0;
 
+	if (par->rect_update) {
+		fbtft_deferred_io_rects(info, pagelist);
+		return;
+	}
+
 	spin_lock(&par->dirty_lock);
 	dirty_lines_start = par->dirty_lines_start;
 	dirty_lines_end = par->dirty_lines_end;
@@ -512,7 +678,7 @@ static void fbtft_fb_fillrect(struct fb_info *info,
 		__func__, rect->dx, rect->dy, rect->width, rect->height);
 	sys_fillrect(info, rect);
 
-	par->fbtftops.mkdirty(info, rect->dy, rect->height);
+	fbtft_mkdirty_rect(info, rect->dx, rect->dy, rect->width, rect->height);
 }
 
 static void fbtft_fb_copyarea(struct fb_info *info,
@@ -525,7 +691,7 @@ static void fbtft_fb_copyarea(struct fb_info *info,
 		__func__,  area->dx, area->dy, area->width, area->height);
 	sys_copyarea(info, area);
 
-	par->fbtftops.mkdirty(info, area->dy, area->height);
+	fbtft_mkdirty_rect(info, area->dx, area->dy, area->width, area->height);
 }
 
 static void fbtft_fb_imageblit(struct fb_info *info,
@@ -538,7 +704,8 @@ static void fbtft_fb_imageblit(struct fb_info *info,
 		__func__,  image->dx, image->dy, image->width, image->height);
 	sys_imageblit(info, image);
 
-	par->fbtftops.mkdirty(info, image->dy, image->height);
+	fbtft_mkdirty_rect(info, image->dx, image->dy,
+			   image->width, image->height);
 }
 
 static ssize_t fbtft_fb_write(struct fb_info *info, const char __user *buf,
@@ -832,6 +999,7 @@ struct fb_info *fbtft_framebuffer_alloc(struct fbtft_display *display,
 	par->debug = display->debug;
 	par->buf = buf;
 	spin_lock_init(&par->dirty_lock);
+	par->rect_update = display->rect_update;
 	par->bgr = pdata->bgr;
 	par->startbyte = pdata->startbyte;
 	par->init_sequence = init_sequence;
@@ -951,6 +1119,19 @@ int fbtft_register_framebuffer(struct fb_info *fb_info)
 		return -EINVAL;
 	}
 
+	/*
+	 * Rectangle updates need a column-aware address window and one of
+	 * the generic 16 bpp write_vmem() functions, which can start at any
+	 * pixel of a line.
+	 */
+	if (par->fbtftops.set_addr_win == fbtft_set_addr_win)
+		par->rect_update = true;
+	if (fb_info->var.bits_per_pixel != 16 ||
+	    (par->fbtftops.write_vmem != fbtft_write_vmem16_bus8 &&
+	     par->fbtftops.write_vmem != fbtft_write_vmem16_bus9 &&
+	     par->fbtftops.write_vmem != fbtft_write_vmem16_bus16))
+		par->rect_update = false;
+
 	if (spi)
 		spi_set_drvdata(spi, fb_info);
 	if (par->pdev)
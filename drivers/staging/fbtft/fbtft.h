@@ -36,6 +36,9 @@
 #define FBTFT_ONBOARD_BACKLIGHT 2
 
 #define FBTFT_GPIO_NO_MATCH		0xFFFF
+
+#define FBTFT_MAX_DIRTY_RECTS	8
+#define FBTFT_ASYNC_MIN_CHUNK	1024
 #define FBTFT_GPIO_NAME_SIZE	32
 #define FBTFT_MAX_INIT_SEQUENCE      512
 #define FBTFT_GAMMA_MAX_VALUES_TOTAL 128
@@ -124,6 +127,8 @@ struct fbtft_ops {
  * @gamma_num: Number of Gamma curves
  * @gamma_len: Number of values per Gamma curve
  * @debug: Initial debug value
+ * @rect_update: set_addr_win() honours the column range, so changed
+ *               rectangles can be sent instead of full-width lines
  *
  * This structure is not stored by FBTFT except for init_sequence.
  */
@@ -142,6 +147,15 @@ struct fbtft_display {
 	int gamma_num;
 	int gamma_len;
 	unsigned long debug;
+	bool rect_update;
+};
+
+/**
+ * struct fbtft_rect - Inclusive display area, in pixels
+ */
+struct fbtft_rect {
+	unsigned x1, y1;
+	unsigned x2, y2;
 };
 
 /**
@@ -192,6 +206,9 @@ struct fbtft_platform_data {
  * @dirty_lock: Protects dirty_lines_start and dirty_lines_end
  * @dirty_lines_start: Where to begin updating display
  * @dirty_lines_end: Where to end updating display
+ * @dirty_rects: Changed areas reported by the drawing ops
+ * @num_dirty_rects: Number of entries in @dirty_rects
+ * @rect_update: Send dirty rectangles rather than full-width lines
  * @gpio.reset: GPIO used to reset display
  * @gpio.dc: Data/Command signal, also known as RS
  * @gpio.rd: Read latching signal
@@ -231,6 +248,9 @@ struct fbtft_par {
 	spinlock_t dirty_lock;
 	unsigned dirty_lines_start;
 	unsigned dirty_lines_end;
+	struct fbtft_rect dirty_rects[FBTFT_MAX_DIRTY_RECTS];
+	unsigned num_dirty_rects;
+	bool rect_update;
 	struct {
 		int reset;
 		int dc;
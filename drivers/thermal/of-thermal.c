@@ -222,6 +222,7 @@ static int of_thermal_bind(struct thermal_zone_device *thermal,
 		struct __thermal_bind_params *tbp = data->tbps + i;
 
 		if (tbp->cooling_device == cdev->np) {
+			struct thermal_instance *instance;
 			int ret;
 
 			ret = thermal_zone_bind_cooling_device(thermal,
@@ -230,6 +231,12 @@ static int of_thermal_bind(struct thermal_zone_device *thermal,
 						tbp->min);
 			if (ret)
 				return ret;
+
+			/* the power allocator splits the budget by this */
+			instance = get_thermal_instance(thermal, cdev,
+							tbp->trip_id);
+			if (instance)
+				instance->weight = tbp->usage;
 		}
 	}
 
@@ -855,6 +862,7 @@ int __init of_parse_thermal_zones(void)
 	struct device_node *np, *child;
 	struct __thermal_zone *tz;
 	struct thermal_zone_device_ops *ops;
+	u32 prop;
 
 	np = of_find_node_by_name(NULL, "thermal-zones");
 	if (!np) {
@@ -891,6 +899,9 @@ int __init of_parse_thermal_zones(void)
 		/* No hwmon because there might be hwmon drivers registering */
 		tzp->no_hwmon = true;
 
+		if (!of_property_read_u32(child, "sustainable-power", &prop))
+			tzp->sustainable_power = prop;
+
 		zone = thermal_zone_device_register(child->name, tz->ntrips,
 						    0, tz,
 						    ops, tzp,
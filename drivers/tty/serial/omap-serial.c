@@ -29,7 +29,11 @@
 #include <linux/console.h>
 #include <linux/serial_reg.h>
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
 #include <linux/slab.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
 #include <linux/tty.h>
 #include <linux/tty_flip.h>
 #include <linux/platform_device.h>
@@ -70,6 +74,11 @@
 #define OMAP_UART_SCR_RX_TRIG_GRANU1_MASK		(1 << 7)
 #define OMAP_UART_SCR_TX_TRIG_GRANU1_MASK		(1 << 6)
 #define OMAP_UART_SCR_TX_EMPTY			(1 << 3)
+#define OMAP_UART_SCR_DMAMODE_1			(1 << 1)
+#define OMAP_UART_SCR_DMAMODE_CTL		(1 << 0)
+
+/* TLR register: RX trigger in units of 4 characters */
+#define OMAP_UART_TLR_RX_TRIG_SHIFT		4
 
 /* FCR register bitmasks */
 #define OMAP_UART_FCR_RX_FIFO_TRIG_MASK			(0x3 << 6)
@@ -86,7 +95,14 @@
 #define OMAP_UART_MVR_MAJ_SHIFT		8
 #define OMAP_UART_MVR_MIN_MASK		0x3f
 
-#define OMAP_UART_DMA_CH_FREE	-1
+/*
+ * RX DMA moves OMAP_UART_RX_DMA_BURST characters per request into a cyclic
+ * buffer whose period completions push the data to the tty.  Whatever stays
+ * below the trigger level is flushed from the RX timeout interrupt.
+ */
+#define OMAP_UART_RX_DMA_BURST		16
+#define OMAP_UART_RX_DMA_BUF_SIZE	4096
+#define OMAP_UART_RX_DMA_PERIODS	4
 
 #define MSR_SAVE_FLAGS		UART_MSR_ANY_DELTA
 #define OMAP_MODE13X_SPEED	230400
@@ -106,30 +122,26 @@
 
 #define OMAP_UART_TCR_TRIG	0x0F
 
+/* RS-485 direction switch waiting for its rts delay */
+#define OMAP_RS485_START_PENDING	1
+#define OMAP_RS485_STOP_PENDING		2
+
 struct uart_omap_dma {
-	u8			uart_dma_tx;
-	u8			uart_dma_rx;
-	int			rx_dma_channel;
-	int			tx_dma_channel;
-	dma_addr_t		rx_buf_dma_phys;
-	dma_addr_t		tx_buf_dma_phys;
-	unsigned int		uart_base;
+	struct dma_chan		*rx_chan;
+	struct dma_chan		*tx_chan;
 	/*
-	 * Buffer for rx dma. It is not required for tx because the buffer
-	 * comes from port structure.
+	 * Buffer for rx dma, drained up to rx_tail. It is not required for
+	 * tx because the buffer comes from port structure.
 	 */
 	unsigned char		*rx_buf;
-	unsigned int		prev_rx_dma_pos;
-	int			tx_buf_size;
-	int			tx_dma_used;
-	int			rx_dma_used;
-	spinlock_t		tx_lock;
-	spinlock_t		rx_lock;
-	/* timer to poll activity on rx dma */
-	struct timer_list	rx_timer;
-	unsigned int		rx_buf_size;
-	unsigned int		rx_poll_rate;
-	unsigned int		rx_timeout;
+	dma_addr_t		rx_buf_dma;
+	unsigned int		rx_tail;
+	dma_cookie_t		rx_cookie;
+	bool			rx_running;
+	dma_addr_t		tx_buf_dma;
+	unsigned int		tx_size;
+	bool			tx_running;
+	struct scatterlist	tx_sg[2];
 };
 
 struct uart_omap_port {
@@ -164,6 +176,8 @@ struct uart_omap_port {
 	u32			features;
 
 	int			rts_gpio;
+	struct hrtimer		rs485_timer;
+	int			rs485_pending;
 
 	struct pm_qos_request	pm_qos_request;
 	u32			latency;
@@ -290,34 +304,358 @@ static void serial_omap_enable_ms(struct uart_port *port)
 	pm_runtime_put_autosuspend(up->dev);
 }
 
+/*
+ * The DMA helpers below are called with the port lock held, except for the
+ * startup and shutdown ones.
+ */
+
+/* hand what the cyclic RX transfer wrote since the last call to the tty */
+static void serial_omap_rx_dma_push(struct uart_omap_port *up)
+{
+	struct uart_omap_dma *dma = &up->uart_dma;
+	struct tty_port *tport = &up->port.state->port;
+	struct dma_tx_state state;
+	unsigned int head, count;
+	int copied;
+
+	dmaengine_tx_status(dma->rx_chan, dma->rx_cookie, &state);
+	head = OMAP_UART_RX_DMA_BUF_SIZE - state.residue;
+	if (head == OMAP_UART_RX_DMA_BUF_SIZE)
+		head = 0;
+
+	while (dma->rx_tail != head) {
+		if (head < dma->rx_tail)
+			count = OMAP_UART_RX_DMA_BUF_SIZE - dma->rx_tail;
+		else
+			count = head - dma->rx_tail;
+
+		copied = tty_insert_flip_string(tport,
+				dma->rx_buf + dma->rx_tail, count);
+		up->port.icount.rx += count;
+		if (copied < count)
+			up->port.icount.buf_overrun += count - copied;
+
+		dma->rx_tail += count;
+		if (dma->rx_tail == OMAP_UART_RX_DMA_BUF_SIZE)
+			dma->rx_tail = 0;
+	}
+}
+
+static void serial_omap_rx_dma_callback(void *data)
+{
+	struct uart_omap_port *up = data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (!up->uart_dma.rx_running) {
+		spin_unlock_irqrestore(&up->port.lock, flags);
+		return;
+	}
+	serial_omap_rx_dma_push(up);
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	tty_flip_buffer_push(&up->port.state->port);
+}
+
+static int serial_omap_tx_dma_start(struct uart_omap_port *up);
+
+static void serial_omap_tx_dma_callback(void *data)
+{
+	struct uart_omap_port *up = data;
+	struct uart_omap_dma *dma = &up->uart_dma;
+	struct circ_buf *xmit = &up->port.state->xmit;
+	unsigned long flags;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+
+	/* flushed while the completion was on its way */
+	if (!dma->tx_running)
+		goto out;
+
+	dma->tx_running = false;
+	xmit->tail = (xmit->tail + dma->tx_size) & (UART_XMIT_SIZE - 1);
+	up->port.icount.tx += dma->tx_size;
+
+	if (uart_circ_chars_pending(xmit) < WAKEUP_CHARS)
+		uart_write_wakeup(&up->port);
+
+	/*
+	 * Unless the next transfer can go right away, leave it to the THR
+	 * interrupt: transmit_chars() sends x_char, restarts DMA or stops
+	 * the transmitter, RS-485 direction switching included.
+	 */
+	if (uart_circ_empty(xmit) || uart_tx_stopped(&up->port) ||
+	    up->port.x_char || serial_omap_tx_dma_start(up)) {
+		up->ier |= UART_IER_THRI;
+		serial_out(up, UART_IER, up->ier);
+	}
+out:
+	spin_unlock_irqrestore(&up->port.lock, flags);
+}
+
+/*
+ * Queue everything pending in the xmit ring, as two segments when it wraps.
+ * The first character goes through THR: the AM33xx UART only raises TX DMA
+ * requests once the FIFO level changes.  Returns 0 when a transfer is in
+ * flight, with the THR interrupt disabled.
+ */
+static int serial_omap_tx_dma_start(struct uart_omap_port *up)
+{
+	struct uart_omap_dma *dma = &up->uart_dma;
+	struct circ_buf *xmit = &up->port.state->xmit;
+	struct dma_async_tx_descriptor *desc;
+	unsigned int count, first, len;
+	int nents = 1;
+
+	if (dma->tx_running)
+		goto out;
+
+	count = uart_circ_chars_pending(xmit);
+	if (count < 2 || uart_tx_stopped(&up->port) ||
+	    serial_in(up, UART_OMAP_TX_LVL) >= up->port.fifosize)
+		return -EBUSY;
+
+	first = (xmit->tail + 1) & (UART_XMIT_SIZE - 1);
+	len = min_t(unsigned int, count - 1, UART_XMIT_SIZE - first);
+
+	sg_init_table(dma->tx_sg, 2);
+	sg_dma_address(&dma->tx_sg[0]) = dma->tx_buf_dma + first;
+	sg_dma_len(&dma->tx_sg[0]) = len;
+	if (len < count - 1) {
+		sg_dma_address(&dma->tx_sg[1]) = dma->tx_buf_dma;
+		sg_dma_len(&dma->tx_sg[1]) = count - 1 - len;
+		nents = 2;
+	}
+
+	dma_sync_single_for_device(dma->tx_chan->device->dev, dma->tx_buf_dma,
+				   UART_XMIT_SIZE, DMA_TO_DEVICE);
+
+	desc = dmaengine_prep_slave_sg(dma->tx_chan, dma->tx_sg, nents,
+				       DMA_MEM_TO_DEV,
+				       DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc)
+		return -EBUSY;
+
+	desc->callback = serial_omap_tx_dma_callback;
+	desc->callback_param = up;
+	dmaengine_submit(desc);
+	dma_async_issue_pending(dma->tx_chan);
+
+	dma->tx_size = count;
+	dma->tx_running = true;
+	serial_out(up, UART_TX, xmit->buf[xmit->tail]);
+out:
+	if (up->ier & UART_IER_THRI) {
+		up->ier &= ~UART_IER_THRI;
+		serial_out(up, UART_IER, up->ier);
+	}
+	return 0;
+}
+
+static int serial_omap_rx_dma_start(struct uart_omap_port *up)
+{
+	struct uart_omap_dma *dma = &up->uart_dma;
+	struct dma_async_tx_descriptor *desc;
+
+	desc = dmaengine_prep_dma_cyclic(dma->rx_chan, dma->rx_buf_dma,
+			OMAP_UART_RX_DMA_BUF_SIZE,
+			OMAP_UART_RX_DMA_BUF_SIZE / OMAP_UART_RX_DMA_PERIODS,
+			DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	if (!desc)
+		return -EBUSY;
+
+	desc->callback = serial_omap_rx_dma_callback;
+	desc->callback_param = up;
+	dma->rx_tail = 0;
+	dma->rx_cookie = dmaengine_submit(desc);
+	dma_async_issue_pending(dma->rx_chan);
+	dma->rx_running = true;
+
+	return 0;
+}
+
+static void serial_omap_rx_dma_pause(struct uart_omap_port *up, bool pause)
+{
+	struct uart_omap_dma *dma = &up->uart_dma;
+
+	if (!dma->rx_running)
+		return;
+
+	if (pause) {
+		dmaengine_pause(dma->rx_chan);
+		serial_omap_rx_dma_push(up);
+	} else {
+		dmaengine_resume(dma->rx_chan);
+	}
+}
+
+static void serial_omap_dma_shutdown(struct uart_omap_port *up);
+
+/*
+ * Use the "rx" and "tx" channels of the device tree node when both are
+ * there.  The console keeps programmed I/O, its writes go straight to THR.
+ * A port moving data by DMA stays runtime active while it is open.
+ */
+static void serial_omap_dma_startup(struct uart_omap_port *up)
+{
+	struct uart_omap_dma *dma = &up->uart_dma;
+	struct dma_slave_config cfg = {
+		.src_addr = up->port.mapbase + (UART_RX << up->port.regshift),
+		.dst_addr = up->port.mapbase + (UART_TX << up->port.regshift),
+		.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE,
+		.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE,
+		.src_maxburst = OMAP_UART_RX_DMA_BURST,
+		.dst_maxburst = 1,
+	};
+	unsigned long flags;
+
+	if (!up->dev->of_node || uart_console(&up->port))
+		return;
+
+	dma->rx_chan = dma_request_slave_channel(up->dev, "rx");
+	dma->tx_chan = dma_request_slave_channel(up->dev, "tx");
+	if (!dma->rx_chan || !dma->tx_chan)
+		goto err;
+
+	cfg.direction = DMA_DEV_TO_MEM;
+	if (dmaengine_slave_config(dma->rx_chan, &cfg))
+		goto err;
+	cfg.direction = DMA_MEM_TO_DEV;
+	if (dmaengine_slave_config(dma->tx_chan, &cfg))
+		goto err;
+
+	dma->rx_buf = dma_alloc_coherent(dma->rx_chan->device->dev,
+					 OMAP_UART_RX_DMA_BUF_SIZE,
+					 &dma->rx_buf_dma, GFP_KERNEL);
+	if (!dma->rx_buf)
+		goto err;
+
+	dma->tx_buf_dma = dma_map_single(dma->tx_chan->device->dev,
+					 up->port.state->xmit.buf,
+					 UART_XMIT_SIZE, DMA_TO_DEVICE);
+	if (dma_mapping_error(dma->tx_chan->device->dev, dma->tx_buf_dma)) {
+		dma->tx_buf_dma = 0;
+		goto err;
+	}
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (serial_omap_rx_dma_start(up)) {
+		spin_unlock_irqrestore(&up->port.lock, flags);
+		goto err;
+	}
+	up->use_dma = 1;
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	pm_runtime_get_sync(up->dev);
+	dev_dbg(up->dev, "using DMA\n");
+	return;
+
+err:
+	dev_info(up->dev, "no DMA, using programmed I/O\n");
+	serial_omap_dma_shutdown(up);
+}
+
+static void serial_omap_dma_shutdown(struct uart_omap_port *up)
+{
+	struct uart_omap_dma *dma = &up->uart_dma;
+	unsigned long flags;
+	bool used = up->use_dma;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	up->use_dma = 0;
+	dma->rx_running = false;
+	dma->tx_running = false;
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	if (dma->rx_chan) {
+		dmaengine_terminate_all(dma->rx_chan);
+		if (dma->rx_buf)
+			dma_free_coherent(dma->rx_chan->device->dev,
+					  OMAP_UART_RX_DMA_BUF_SIZE,
+					  dma->rx_buf, dma->rx_buf_dma);
+		dma_release_channel(dma->rx_chan);
+	}
+	if (dma->tx_chan) {
+		dmaengine_terminate_all(dma->tx_chan);
+		if (dma->tx_buf_dma)
+			dma_unmap_single(dma->tx_chan->device->dev,
+					 dma->tx_buf_dma, UART_XMIT_SIZE,
+					 DMA_TO_DEVICE);
+		dma_release_channel(dma->tx_chan);
+	}
+	memset(dma, 0, sizeof(*dma));
+
+	if (used) {
+		pm_runtime_mark_last_busy(up->dev);
+		pm_runtime_put_autosuspend(up->dev);
+	}
+}
+
+/* Drive the RS-485 transmit enable GPIO, returns true if it changed */
+static bool serial_omap_rs485_set_rts(struct uart_omap_port *up, bool send)
+{
+	u32 flag = send ? SER_RS485_RTS_ON_SEND : SER_RS485_RTS_AFTER_SEND;
+	int val = (up->port.rs485.flags & flag) ? 1 : 0;
+
+	if (gpio_get_value(up->rts_gpio) == val)
+		return false;
+	gpio_set_value(up->rts_gpio, val);
+	return true;
+}
+
+/* The transmitter is drained and the after send delay has elapsed */
+static void serial_omap_rs485_stop_tx(struct uart_omap_port *up)
+{
+	struct uart_port *port = &up->port;
+
+	serial_omap_rs485_set_rts(up, false);
+
+	if (!(port->rs485.flags & SER_RS485_RX_DURING_TX)) {
+		/*
+		 * Empty the RX FIFO, we are not interested in anything
+		 * received during the half-duplex transmission.
+		 */
+		serial_out(up, UART_FCR, up->fcr | UART_FCR_CLEAR_RCVR);
+		/* Re-enable RX interrupts */
+		up->ier |= UART_IER_RLSI | UART_IER_RDI;
+		up->port.read_status_mask |= UART_LSR_DR;
+		serial_out(up, UART_IER, up->ier);
+		serial_omap_rx_dma_pause(up, false);
+	}
+}
+
+static void serial_omap_rs485_delay(struct uart_omap_port *up, int pending,
+				    unsigned int msecs)
+{
+	up->rs485_pending = pending;
+	hrtimer_start(&up->rs485_timer, ms_to_ktime(msecs), HRTIMER_MODE_REL);
+}
+
+/* Called with the port lock held, the timer may still be running after */
+static void serial_omap_rs485_cancel(struct uart_omap_port *up)
+{
+	if (up->rs485_pending) {
+		up->rs485_pending = 0;
+		hrtimer_try_to_cancel(&up->rs485_timer);
+	}
+}
+
 static void serial_omap_stop_tx(struct uart_port *port)
 {
 	struct uart_omap_port *up = to_uart_omap_port(port);
-	int res;
 
 	pm_runtime_get_sync(up->dev);
 
 	/* Handle RS-485 */
 	if (port->rs485.flags & SER_RS485_ENABLED) {
-		if (up->scr & OMAP_UART_SCR_TX_EMPTY) {
-			/* THR interrupt is fired when both TX FIFO and TX
-			 * shift register are empty. This means there's nothing
-			 * left to transmit now, so make sure the THR interrupt
-			 * is fired when TX FIFO is below the trigger level,
-			 * disable THR interrupts and toggle the RS-485 GPIO
-			 * data direction pin if needed.
-			 */
-			up->scr &= ~OMAP_UART_SCR_TX_EMPTY;
-			serial_out(up, UART_OMAP_SCR, up->scr);
-			res = (port->rs485.flags & SER_RS485_RTS_AFTER_SEND) ?
-				1 : 0;
-			if (gpio_get_value(up->rts_gpio) != res) {
-				if (port->rs485.delay_rts_after_send > 0)
-					mdelay(
-					port->rs485.delay_rts_after_send);
-				gpio_set_value(up->rts_gpio, res);
-			}
-		} else {
+		if (up->rs485_pending == OMAP_RS485_START_PENDING) {
+			/* Nothing was sent yet, release the bus right away */
+			serial_omap_rs485_cancel(up);
+			serial_omap_rs485_stop_tx(up);
+			goto out;
+		}
+
+		if (!(up->scr & OMAP_UART_SCR_TX_EMPTY)) {
 			/* We're asked to stop, but there's still stuff in the
 			 * UART FIFO, so make sure the THR interrupt is fired
 			 * when both TX FIFO and TX shift register are empty.
@@ -328,8 +666,17 @@ static void serial_omap_stop_tx(struct uart_port *port)
 			 */
 			up->scr |= OMAP_UART_SCR_TX_EMPTY;
 			serial_out(up, UART_OMAP_SCR, up->scr);
-			return;
+			goto out;
 		}
+
+		/* THR interrupt is fired when both TX FIFO and TX
+		 * shift register are empty. This means there's nothing
+		 * left to transmit now, so make sure the THR interrupt
+		 * is fired when TX FIFO is below the trigger level and
+		 * disable THR interrupts below.
+		 */
+		up->scr &= ~OMAP_UART_SCR_TX_EMPTY;
+		serial_out(up, UART_OMAP_SCR, up->scr);
 	}
 
 	if (up->ier & UART_IER_THRI) {
@@ -337,19 +684,19 @@ static void serial_omap_stop_tx(struct uart_port *port)
 		serial_out(up, UART_IER, up->ier);
 	}
 
-	if ((port->rs485.flags & SER_RS485_ENABLED) &&
-	    !(port->rs485.flags & SER_RS485_RX_DURING_TX)) {
-		/*
-		 * Empty the RX FIFO, we are not interested in anything
-		 * received during the half-duplex transmission.
-		 */
-		serial_out(up, UART_FCR, up->fcr | UART_FCR_CLEAR_RCVR);
-		/* Re-enable RX interrupts */
-		up->ier |= UART_IER_RLSI | UART_IER_RDI;
-		up->port.read_status_mask |= UART_LSR_DR;
-		serial_out(up, UART_IER, up->ier);
+	/*
+	 * Toggle the RS-485 data direction pin, the after send delay is
+	 * timed by an hrtimer rather than by spinning in the interrupt.
+	 */
+	if (port->rs485.flags & SER_RS485_ENABLED) {
+		if (port->rs485.delay_rts_after_send > 0)
+			serial_omap_rs485_delay(up, OMAP_RS485_STOP_PENDING,
+					port->rs485.delay_rts_after_send);
+		else
+			serial_omap_rs485_stop_tx(up);
 	}
 
+out:
 	pm_runtime_mark_last_busy(up->dev);
 	pm_runtime_put_autosuspend(up->dev);
 }
@@ -362,6 +709,7 @@ static void serial_omap_stop_rx(struct uart_port *port)
 	up->ier &= ~(UART_IER_RLSI | UART_IER_RDI);
 	up->port.read_status_mask &= ~UART_LSR_DR;
 	serial_out(up, UART_IER, up->ier);
+	serial_omap_rx_dma_pause(up, true);
 	pm_runtime_mark_last_busy(up->dev);
 	pm_runtime_put_autosuspend(up->dev);
 }
@@ -381,6 +729,8 @@ static void transmit_chars(struct uart_omap_port *up, unsigned int lsr)
 		serial_omap_stop_tx(&up->port);
 		return;
 	}
+	if (up->use_dma && !serial_omap_tx_dma_start(up))
+		return;
 	count = up->port.fifosize / 4;
 	do {
 		serial_out(up, UART_TX, xmit->buf[xmit->tail]);
@@ -405,35 +755,72 @@ static inline void serial_omap_enable_ier_thri(struct uart_omap_port *up)
 	}
 }
 
+static void serial_omap_tx_kick(struct uart_omap_port *up)
+{
+	if (!up->use_dma || up->port.x_char || serial_omap_tx_dma_start(up))
+		serial_omap_enable_ier_thri(up);
+}
+
 static void serial_omap_start_tx(struct uart_port *port)
 {
 	struct uart_omap_port *up = to_uart_omap_port(port);
-	int res;
 
 	pm_runtime_get_sync(up->dev);
 
 	/* Handle RS-485 */
 	if (port->rs485.flags & SER_RS485_ENABLED) {
+		/* Still waiting for the before send delay */
+		if (up->rs485_pending == OMAP_RS485_START_PENDING)
+			goto out;
+
+		/* Back to back frames keep the bus, rts is still asserted */
+		serial_omap_rs485_cancel(up);
+
 		/* Fire THR interrupts when FIFO is below trigger level */
 		up->scr &= ~OMAP_UART_SCR_TX_EMPTY;
 		serial_out(up, UART_OMAP_SCR, up->scr);
 
+		if (!(port->rs485.flags & SER_RS485_RX_DURING_TX))
+			serial_omap_stop_rx(port);
+
 		/* if rts not already enabled */
-		res = (port->rs485.flags & SER_RS485_RTS_ON_SEND) ? 1 : 0;
-		if (gpio_get_value(up->rts_gpio) != res) {
-			gpio_set_value(up->rts_gpio, res);
-			if (port->rs485.delay_rts_before_send > 0)
-				mdelay(port->rs485.delay_rts_before_send);
+		if (serial_omap_rs485_set_rts(up, true) &&
+		    port->rs485.delay_rts_before_send > 0) {
+			serial_omap_rs485_delay(up, OMAP_RS485_START_PENDING,
+					port->rs485.delay_rts_before_send);
+			goto out;
 		}
 	}
 
-	if ((port->rs485.flags & SER_RS485_ENABLED) &&
-	    !(port->rs485.flags & SER_RS485_RX_DURING_TX))
-		serial_omap_stop_rx(port);
+	serial_omap_tx_kick(up);
+out:
+	pm_runtime_mark_last_busy(up->dev);
+	pm_runtime_put_autosuspend(up->dev);
+}
+
+static enum hrtimer_restart serial_omap_rs485_timer(struct hrtimer *t)
+{
+	struct uart_omap_port *up = container_of(t, struct uart_omap_port,
+						 rs485_timer);
+	unsigned long flags;
 
-	serial_omap_enable_ier_thri(up);
+	pm_runtime_get_sync(up->dev);
+	spin_lock_irqsave(&up->port.lock, flags);
+	switch (up->rs485_pending) {
+	case OMAP_RS485_START_PENDING:
+		up->rs485_pending = 0;
+		serial_omap_tx_kick(up);
+		break;
+	case OMAP_RS485_STOP_PENDING:
+		up->rs485_pending = 0;
+		serial_omap_rs485_stop_tx(up);
+		break;
+	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
 	pm_runtime_mark_last_busy(up->dev);
 	pm_runtime_put_autosuspend(up->dev);
+
+	return HRTIMER_NORESTART;
 }
 
 static void serial_omap_throttle(struct uart_port *port)
@@ -445,6 +832,7 @@ static void serial_omap_throttle(struct uart_port *port)
 	spin_lock_irqsave(&up->port.lock, flags);
 	up->ier &= ~(UART_IER_RLSI | UART_IER_RDI);
 	serial_out(up, UART_IER, up->ier);
+	serial_omap_rx_dma_pause(up, true);
 	spin_unlock_irqrestore(&up->port.lock, flags);
 	pm_runtime_mark_last_busy(up->dev);
 	pm_runtime_put_autosuspend(up->dev);
@@ -459,6 +847,7 @@ static void serial_omap_unthrottle(struct uart_port *port)
 	spin_lock_irqsave(&up->port.lock, flags);
 	up->ier |= UART_IER_RLSI | UART_IER_RDI;
 	serial_out(up, UART_IER, up->ier);
+	serial_omap_rx_dma_pause(up, false);
 	spin_unlock_irqrestore(&up->port.lock, flags);
 	pm_runtime_mark_last_busy(up->dev);
 	pm_runtime_put_autosuspend(up->dev);
@@ -595,9 +984,18 @@ static irqreturn_t serial_omap_irq(int irq, void *dev_id)
 		case UART_IIR_RX_TIMEOUT:
 			/* FALLTHROUGH */
 		case UART_IIR_RDI:
+			/*
+			 * With DMA this is the tail below the trigger level,
+			 * or a FIFO the DMA missed: pass on what the DMA got
+			 * first, then drain the FIFO by hand.
+			 */
+			if (up->uart_dma.rx_running)
+				serial_omap_rx_dma_push(up);
 			serial_omap_rdi(up, lsr);
 			break;
 		case UART_IIR_RLSI:
+			if (up->uart_dma.rx_running)
+				serial_omap_rx_dma_push(up);
 			serial_omap_rlsi(up, lsr);
 			break;
 		case UART_IIR_CTS_RTS_DSR:
@@ -786,6 +1184,8 @@ static int serial_omap_startup(struct uart_port *port)
 
 	serial_out(up, UART_OMAP_WER, up->wer);
 
+	serial_omap_dma_startup(up);
+
 	pm_runtime_mark_last_busy(up->dev);
 	pm_runtime_put_autosuspend(up->dev);
 	up->port_activity = jiffies;
@@ -800,12 +1200,18 @@ static void serial_omap_shutdown(struct uart_port *port)
 	dev_dbg(up->port.dev, "serial_omap_shutdown+%d\n", up->port.line);
 
 	pm_runtime_get_sync(up->dev);
+
+	hrtimer_cancel(&up->rs485_timer);
+	up->rs485_pending = 0;
+
 	/*
 	 * Disable interrupts from this port
 	 */
 	up->ier = 0;
 	serial_out(up, UART_IER, 0);
 
+	serial_omap_dma_shutdown(up);
+
 	spin_lock_irqsave(&up->port.lock, flags);
 	up->port.mctrl &= ~TIOCM_OUT2;
 	serial_omap_set_mctrl(&up->port, up->port.mctrl);
@@ -964,6 +1370,8 @@ serial_omap_set_termios(struct uart_port *port, struct ktermios *termios,
 	/* FIFO ENABLE, DMA MODE */
 
 	up->scr |= OMAP_UART_SCR_RX_TRIG_GRANU1_MASK;
+	if (up->use_dma)
+		up->scr |= OMAP_UART_SCR_DMAMODE_CTL | OMAP_UART_SCR_DMAMODE_1;
 	/*
 	 * NOTE: Setting OMAP_UART_SCR_RX_TRIG_GRANU1_MASK
 	 * sets Enables the granularity of 1 for TRIGGER RX
@@ -982,6 +1390,13 @@ serial_omap_set_termios(struct uart_port *port, struct ktermios *termios,
 	up->fcr |= UART_FCR6_R_TRIGGER_16 | UART_FCR6_T_TRIGGER_24 |
 		UART_FCR_ENABLE_FIFO;
 
+	/*
+	 * With DMA the RX trigger is one burst, set through TLR below and
+	 * FCR[7:6] = 0; the RX timeout interrupt flushes the rest.
+	 */
+	if (up->use_dma)
+		up->fcr &= ~OMAP_UART_FCR_RX_FIFO_TRIG_MASK;
+
 	serial_out(up, UART_FCR, up->fcr);
 	serial_out(up, UART_LCR, UART_LCR_CONF_MODE_B);
 
@@ -1041,6 +1456,9 @@ serial_omap_set_termios(struct uart_port *port, struct ktermios *termios,
 	serial_out(up, UART_MCR, up->mcr | UART_MCR_TCRTLR);
 
 	serial_out(up, UART_TI752_TCR, OMAP_UART_TCR_TRIG);
+	serial_out(up, UART_TI752_TLR, up->use_dma ?
+		   (OMAP_UART_RX_DMA_BURST / 4) << OMAP_UART_TLR_RX_TRIG_SHIFT :
+		   0);
 
 	up->port.status &= ~(UPSTAT_AUTOCTS | UPSTAT_AUTORTS | UPSTAT_AUTOXOFF);
 
@@ -1123,6 +1541,18 @@ serial_omap_pm(struct uart_port *port, unsigned int state,
 	pm_runtime_put_autosuspend(up->dev);
 }
 
+static void serial_omap_flush_buffer(struct uart_port *port)
+{
+	struct uart_omap_port *up = to_uart_omap_port(port);
+	struct uart_omap_dma *dma = &up->uart_dma;
+
+	/* the core emptied the xmit ring, drop the transfer reading it */
+	if (dma->tx_running) {
+		dmaengine_terminate_all(dma->tx_chan);
+		dma->tx_running = false;
+	}
+}
+
 static void serial_omap_release_port(struct uart_port *port)
 {
 	dev_dbg(port->dev, "serial_omap_release_port+\n");
@@ -1354,6 +1784,8 @@ serial_omap_config_rs485(struct uart_port *port, struct serial_rs485 *rs485conf)
 	up->ier = 0;
 	serial_out(up, UART_IER, 0);
 
+	serial_omap_rs485_cancel(up);
+
 	/* store new config */
 	port->rs485 = *rs485conf;
 
@@ -1398,6 +1830,7 @@ static struct uart_ops serial_omap_pops = {
 	.throttle	= serial_omap_throttle,
 	.unthrottle	= serial_omap_unthrottle,
 	.stop_rx	= serial_omap_stop_rx,
+	.flush_buffer	= serial_omap_flush_buffer,
 	.enable_ms	= serial_omap_enable_ms,
 	.break_ctl	= serial_omap_break_ctl,
 	.startup	= serial_omap_startup,
@@ -1705,6 +2138,8 @@ static int serial_omap_probe(struct platform_device *pdev)
 	pm_qos_add_request(&up->pm_qos_request,
 		PM_QOS_CPU_DMA_LATENCY, up->latency);
 	INIT_WORK(&up->qos_work, serial_omap_uart_qos_work);
+	hrtimer_init(&up->rs485_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	up->rs485_timer.function = serial_omap_rs485_timer;
 
 	platform_set_drvdata(pdev, up);
 	if (omap_up_info->autosuspend_timeout == 0)
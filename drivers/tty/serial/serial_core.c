@@ -2609,6 +2609,25 @@ static ssize_t uart_get_attr_iomem_reg_shift(struct device *dev,
 	return snprintf(buf, PAGE_SIZE, "%d\n", tmp.iomem_reg_shift);
 }
 
+#ifdef CONFIG_TTY_FLIP_LATENCY
+static ssize_t uart_get_attr_rx_latency(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tty_port *port = dev_get_drvdata(dev);
+
+	return tty_buffer_latency_show(port, buf);
+}
+
+static ssize_t uart_set_attr_rx_latency(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct tty_port *port = dev_get_drvdata(dev);
+
+	tty_buffer_latency_reset(port);
+	return count;
+}
+#endif
+
 static DEVICE_ATTR(type, S_IRUSR | S_IRGRP, uart_get_attr_type, NULL);
 static DEVICE_ATTR(line, S_IRUSR | S_IRGRP, uart_get_attr_line, NULL);
 static DEVICE_ATTR(port, S_IRUSR | S_IRGRP, uart_get_attr_port, NULL);
@@ -2622,6 +2641,10 @@ static DEVICE_ATTR(custom_divisor, S_IRUSR | S_IRGRP, uart_get_attr_custom_divis
 static DEVICE_ATTR(io_type, S_IRUSR | S_IRGRP, uart_get_attr_io_type, NULL);
 static DEVICE_ATTR(iomem_base, S_IRUSR | S_IRGRP, uart_get_attr_iomem_base, NULL);
 static DEVICE_ATTR(iomem_reg_shift, S_IRUSR | S_IRGRP, uart_get_attr_iomem_reg_shift, NULL);
+#ifdef CONFIG_TTY_FLIP_LATENCY
+static DEVICE_ATTR(rx_latency, S_IRUSR | S_IWUSR | S_IRGRP,
+		   uart_get_attr_rx_latency, uart_set_attr_rx_latency);
+#endif
 
 static struct attribute *tty_dev_attrs[] = {
 	&dev_attr_type.attr,
@@ -2637,6 +2660,9 @@ static struct attribute *tty_dev_attrs[] = {
 	&dev_attr_io_type.attr,
 	&dev_attr_iomem_base.attr,
 	&dev_attr_iomem_reg_shift.attr,
+#ifdef CONFIG_TTY_FLIP_LATENCY
+	&dev_attr_rx_latency.attr,
+#endif
 	NULL,
 	};
 
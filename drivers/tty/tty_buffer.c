@@ -16,11 +16,19 @@
 #include <linux/delay.h>
 #include <linux/module.h>
 #include <linux/ratelimit.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
 
 
 #define MIN_TTYB_SIZE	256
 #define TTYB_ALIGN_MASK	255
 
+/*
+ * Flip buffers of ports marked low_latency are processed by high priority
+ * workers, so a busy system_wq or CPU bound tasks don't delay them.
+ */
+static struct workqueue_struct *tty_low_latency_wq;
+
 /*
  * Byte threshold to limit memory consumption for flip buffers.
  * The actual memory limit is > 2x this amount.
@@ -84,6 +92,73 @@ void tty_buffer_lock_exclusive(struct tty_port *port)
 }
 EXPORT_SYMBOL_GPL(tty_buffer_lock_exclusive);
 
+static void tty_buffer_queue_work(struct tty_port *port,
+				  struct workqueue_struct *wq)
+{
+	if (port->low_latency && tty_low_latency_wq)
+		wq = tty_low_latency_wq;
+	queue_work(wq, &port->buf.work);
+}
+
+#ifdef CONFIG_TTY_FLIP_LATENCY
+static unsigned long tty_buffer_now_us(void)
+{
+	/* 0 means nothing pending, so never hand it out as a stamp */
+	return (unsigned long)ktime_to_us(ktime_get()) | 1;
+}
+
+static void tty_buffer_stamp_push(struct tty_bufhead *buf)
+{
+	if (!ACCESS_ONCE(buf->push_us))
+		ACCESS_ONCE(buf->push_us) = tty_buffer_now_us();
+}
+
+static void tty_buffer_account_latency(struct tty_bufhead *buf)
+{
+	unsigned long pushed = xchg(&buf->push_us, 0);
+	int bucket;
+
+	if (!pushed)
+		return;
+
+	bucket = fls_long(tty_buffer_now_us() - pushed);
+	if (bucket >= TTY_FLIP_LATENCY_BUCKETS)
+		bucket = TTY_FLIP_LATENCY_BUCKETS - 1;
+	buf->latency[bucket]++;
+}
+
+/**
+ *	tty_buffer_latency_show	-	format the push latency histogram
+ *	@port: tty port
+ *	@buf: PAGE_SIZE output buffer
+ *
+ *	Print one "<limit_us> <count>" line per bucket, counting the delays
+ *	between a flip buffer push and the start of its processing that
+ *	were below limit_us.  The last bucket also counts everything above.
+ */
+
+ssize_t tty_buffer_latency_show(struct tty_port *port, char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < TTY_FLIP_LATENCY_BUCKETS; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%lu %u\n",
+				 1UL << i, port->buf.latency[i]);
+	return len;
+}
+EXPORT_SYMBOL_GPL(tty_buffer_latency_show);
+
+void tty_buffer_latency_reset(struct tty_port *port)
+{
+	memset(port->buf.latency, 0, sizeof(port->buf.latency));
+}
+EXPORT_SYMBOL_GPL(tty_buffer_latency_reset);
+#else
+static inline void tty_buffer_stamp_push(struct tty_bufhead *buf) { }
+static inline void tty_buffer_account_latency(struct tty_bufhead *buf) { }
+#endif
+
 void tty_buffer_unlock_exclusive(struct tty_port *port)
 {
 	struct tty_bufhead *buf = &port->buf;
@@ -94,7 +169,7 @@ void tty_buffer_unlock_exclusive(struct tty_port *port)
 	atomic_dec(&buf->priority);
 	mutex_unlock(&buf->lock);
 	if (restart)
-		queue_work(system_unbound_wq, &buf->work);
+		tty_buffer_queue_work(port, system_unbound_wq);
 }
 EXPORT_SYMBOL_GPL(tty_buffer_unlock_exclusive);
 
@@ -386,7 +461,8 @@ EXPORT_SYMBOL(tty_insert_flip_string_flags);
  *
  *	Takes any pending buffers and transfers their ownership to the
  *	ldisc side of the queue. It then schedules those characters for
- *	processing by the line discipline.
+ *	processing by the line discipline, on a high priority worker if
+ *	the port is marked low_latency.
  */
 
 void tty_schedule_flip(struct tty_port *port)
@@ -394,7 +470,8 @@ void tty_schedule_flip(struct tty_port *port)
 	struct tty_bufhead *buf = &port->buf;
 
 	buf->tail->commit = buf->tail->used;
-	schedule_work(&buf->work);
+	tty_buffer_stamp_push(buf);
+	tty_buffer_queue_work(port, system_wq);
 }
 EXPORT_SYMBOL(tty_schedule_flip);
 
@@ -476,6 +553,7 @@ static void flush_to_ldisc(struct work_struct *work)
 	if (disc == NULL)
 		return;
 
+	tty_buffer_account_latency(buf);
 	mutex_lock(&buf->lock);
 
 	while (1) {
@@ -554,6 +632,14 @@ void tty_buffer_init(struct tty_port *port)
 	buf->mem_limit = TTYB_DEFAULT_MEM_LIMIT;
 }
 
+static int __init tty_buffer_wq_init(void)
+{
+	tty_low_latency_wq = alloc_workqueue("tty_low_latency",
+					     WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	return tty_low_latency_wq ? 0 : -ENOMEM;
+}
+core_initcall(tty_buffer_wq_init);
+
 /**
  *	tty_buffer_set_limit	-	change the tty buffer memory limit
  *	@port: tty port to change
@@ -32,6 +32,12 @@
 #include <linux/pinctrl/consumer.h>
 #include <linux/err.h>
 #include <linux/pm_runtime.h>
+#include <linux/dma-buf.h>
+#include <linux/highmem.h>
+#include <linux/kref.h>
+#include <linux/miscdevice.h>
+#include <linux/uaccess.h>
+#include <linux/uio_pruss.h>
 
 #define DRV_NAME "pruss_uio"
 #define DRV_VERSION "1.0"
@@ -44,6 +50,11 @@ static int extram_pool_sz = SZ_256K;
 module_param(extram_pool_sz, int, 0);
 MODULE_PARM_DESC(extram_pool_sz, "external ram pool size to allocate");
 
+static bool extram_cached;
+module_param(extram_cached, bool, 0);
+MODULE_PARM_DESC(extram_cached,
+		 "map the external ram pool cacheable, user space must sync it");
+
 /*
  * Host event IRQ numbers from PRUSS - PRUSS can generate up to 8 interrupt
  * events to AINTC of ARM host processor - which can be used for IPC b/w PRUSS
@@ -65,17 +76,41 @@ MODULE_PARM_DESC(extram_pool_sz, "external ram pool size to allocate");
 #define HIPIR_NOPEND	0x80000000
 #define PINTC_HIER	0x1500
 
+/* Index of the external ram pool in the memory maps of each UIO device */
+#ifdef CONFIG_ARCH_DAVINCI_DA850
+#define PRUSS_DDR_MAP	2
+#else
+#define PRUSS_DDR_MAP	1
+#endif
+
+/*
+ * External ram pool shared with the PRUs.  It is reference counted as
+ * dma-bufs exported from it and open /dev/pruss_ddr files may outlive the
+ * device.
+ */
+struct uio_pruss_ddr {
+	struct kref kref;
+	struct device *dev;
+	size_t size;
+	bool cached;
+	void *vaddr;		/* coherent pools only */
+	struct page *page;	/* cached pools only */
+	dma_addr_t alloc_addr;
+	dma_addr_t paddr;
+	struct dma_attrs attrs;
+};
+
 struct uio_pruss_dev {
 	struct uio_info *info;
 	struct clk *pruss_clk;
 	dma_addr_t sram_paddr;
-	dma_addr_t ddr_paddr;
 	void __iomem *prussio_vaddr;
 	unsigned long sram_vaddr;
-	void *ddr_vaddr;
+	struct uio_pruss_ddr *ddr;
 	unsigned int hostirq_start;
 	unsigned int pintc_base;
 	struct gen_pool *sram_pool;
+	struct miscdevice misc;
 };
 
 static irqreturn_t pruss_handler(int irq, struct uio_info *info)
@@ -97,6 +132,381 @@ static irqreturn_t pruss_handler(int irq, struct uio_info *info)
 	return IRQ_HANDLED;
 }
 
+static struct uio_pruss_ddr *pruss_ddr_alloc(struct device *dev, size_t size,
+					     bool cached)
+{
+	struct uio_pruss_ddr *ddr;
+	void *cookie;
+
+	ddr = kzalloc(sizeof(*ddr), GFP_KERNEL);
+	if (!ddr)
+		return NULL;
+
+	kref_init(&ddr->kref);
+	ddr->size = size;
+	ddr->cached = cached;
+
+	if (!cached) {
+		ddr->vaddr = dma_alloc_coherent(dev, size, &ddr->paddr,
+						GFP_KERNEL | GFP_DMA);
+		if (!ddr->vaddr)
+			goto free_ddr;
+		goto out;
+	}
+
+	/*
+	 * Without a kernel mapping the ARM DMA code hands out the pages (from
+	 * CMA when available) untouched, still covered by the cacheable linear
+	 * mapping, and returns the first page as the cookie.  A streaming
+	 * mapping on top of them provides the cache maintenance.
+	 */
+	init_dma_attrs(&ddr->attrs);
+	dma_set_attr(DMA_ATTR_NO_KERNEL_MAPPING, &ddr->attrs);
+	cookie = dma_alloc_attrs(dev, size, &ddr->alloc_addr, GFP_KERNEL,
+				 &ddr->attrs);
+	if (!cookie)
+		goto free_ddr;
+
+	ddr->page = cookie;
+	ddr->paddr = dma_map_page(dev, ddr->page, 0, size, DMA_BIDIRECTIONAL);
+	if (dma_mapping_error(dev, ddr->paddr)) {
+		dma_free_attrs(dev, size, cookie, ddr->alloc_addr, &ddr->attrs);
+		goto free_ddr;
+	}
+
+out:
+	ddr->dev = get_device(dev);
+	return ddr;
+
+free_ddr:
+	kfree(ddr);
+	return NULL;
+}
+
+static void pruss_ddr_release(struct kref *kref)
+{
+	struct uio_pruss_ddr *ddr = container_of(kref, struct uio_pruss_ddr,
+						 kref);
+
+	if (ddr->cached) {
+		dma_unmap_page(ddr->dev, ddr->paddr, ddr->size,
+			       DMA_BIDIRECTIONAL);
+		dma_free_attrs(ddr->dev, ddr->size, ddr->page, ddr->alloc_addr,
+			       &ddr->attrs);
+	} else {
+		dma_free_coherent(ddr->dev, ddr->size, ddr->vaddr, ddr->paddr);
+	}
+	put_device(ddr->dev);
+	kfree(ddr);
+}
+
+static void pruss_ddr_put(struct uio_pruss_ddr *ddr)
+{
+	kref_put(&ddr->kref, pruss_ddr_release);
+}
+
+static int pruss_ddr_sync(struct uio_pruss_ddr *ddr, size_t offset,
+			  size_t size, enum dma_data_direction dir, bool for_cpu)
+{
+	if (offset > ddr->size || size > ddr->size - offset)
+		return -EINVAL;
+
+	if (!ddr->cached)
+		return 0;
+
+	if (for_cpu)
+		dma_sync_single_range_for_cpu(ddr->dev, ddr->paddr, offset,
+					      size, dir);
+	else
+		dma_sync_single_range_for_device(ddr->dev, ddr->paddr, offset,
+						 size, dir);
+	return 0;
+}
+
+static int pruss_ddr_mmap(struct uio_pruss_ddr *ddr, struct vm_area_struct *vma)
+{
+	unsigned long pages = ddr->size >> PAGE_SHIFT;
+
+	if (vma->vm_pgoff >= pages || vma_pages(vma) > pages - vma->vm_pgoff)
+		return -EINVAL;
+
+	if (!ddr->cached)
+		return dma_mmap_coherent(ddr->dev, vma, ddr->vaddr, ddr->paddr,
+					 ddr->size);
+
+	return remap_pfn_range(vma, vma->vm_start,
+			       page_to_pfn(ddr->page) + vma->vm_pgoff,
+			       vma->vm_end - vma->vm_start,
+			       vma->vm_page_prot);
+}
+
+/*
+ * Only installed for a cached external ram pool, the other memory maps keep
+ * the uncached mapping the UIO core would give them.
+ */
+static int pruss_uio_mmap(struct uio_info *info, struct vm_area_struct *vma)
+{
+	struct uio_pruss_dev *gdev = info->priv;
+	struct uio_mem *mem = info->mem + vma->vm_pgoff;
+
+	if (vma->vm_pgoff == PRUSS_DDR_MAP) {
+		/* vm_pgoff selects the map, the pool is mapped from its start */
+		vma->vm_pgoff = 0;
+		return pruss_ddr_mmap(gdev->ddr, vma);
+	}
+
+	if (mem->addr & ~PAGE_MASK)
+		return -ENODEV;
+
+	vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+	return remap_pfn_range(vma, vma->vm_start, mem->addr >> PAGE_SHIFT,
+			       vma->vm_end - vma->vm_start,
+			       vma->vm_page_prot);
+}
+
+static struct sg_table *pruss_ddr_map_dma_buf(struct dma_buf_attachment *attach,
+					      enum dma_data_direction dir)
+{
+	struct uio_pruss_ddr *ddr = attach->dmabuf->priv;
+	struct sg_table *sgt;
+	int ret;
+
+	sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+	if (!sgt)
+		return ERR_PTR(-ENOMEM);
+
+	if (ddr->cached) {
+		ret = sg_alloc_table(sgt, 1, GFP_KERNEL);
+		if (!ret)
+			sg_set_page(sgt->sgl, ddr->page, ddr->size, 0);
+	} else {
+		ret = dma_get_sgtable(ddr->dev, sgt, ddr->vaddr, ddr->paddr,
+				      ddr->size);
+	}
+	if (ret)
+		goto free_sgt;
+
+	if (!dma_map_sg(attach->dev, sgt->sgl, sgt->orig_nents, dir)) {
+		ret = -ENOMEM;
+		goto free_table;
+	}
+
+	return sgt;
+
+free_table:
+	sg_free_table(sgt);
+free_sgt:
+	kfree(sgt);
+	return ERR_PTR(ret);
+}
+
+static void pruss_ddr_unmap_dma_buf(struct dma_buf_attachment *attach,
+				    struct sg_table *sgt,
+				    enum dma_data_direction dir)
+{
+	dma_unmap_sg(attach->dev, sgt->sgl, sgt->orig_nents, dir);
+	sg_free_table(sgt);
+	kfree(sgt);
+}
+
+static void pruss_ddr_dmabuf_release(struct dma_buf *dmabuf)
+{
+	pruss_ddr_put(dmabuf->priv);
+	module_put(THIS_MODULE);
+}
+
+static int pruss_ddr_begin_cpu_access(struct dma_buf *dmabuf, size_t start,
+				      size_t len,
+				      enum dma_data_direction dir)
+{
+	return pruss_ddr_sync(dmabuf->priv, start, len, dir, true);
+}
+
+static void pruss_ddr_end_cpu_access(struct dma_buf *dmabuf, size_t start,
+				     size_t len, enum dma_data_direction dir)
+{
+	pruss_ddr_sync(dmabuf->priv, start, len, dir, false);
+}
+
+static void *pruss_ddr_kmap_atomic(struct dma_buf *dmabuf,
+				   unsigned long pgnum)
+{
+	struct uio_pruss_ddr *ddr = dmabuf->priv;
+
+	if (pgnum >= ddr->size >> PAGE_SHIFT)
+		return NULL;
+
+	if (!ddr->cached)
+		return ddr->vaddr + (pgnum << PAGE_SHIFT);
+
+	return kmap_atomic(ddr->page + pgnum);
+}
+
+static void pruss_ddr_kunmap_atomic(struct dma_buf *dmabuf,
+				    unsigned long pgnum, void *vaddr)
+{
+	struct uio_pruss_ddr *ddr = dmabuf->priv;
+
+	if (ddr->cached)
+		kunmap_atomic(vaddr);
+}
+
+static void *pruss_ddr_kmap(struct dma_buf *dmabuf, unsigned long pgnum)
+{
+	struct uio_pruss_ddr *ddr = dmabuf->priv;
+
+	if (pgnum >= ddr->size >> PAGE_SHIFT)
+		return NULL;
+
+	if (!ddr->cached)
+		return ddr->vaddr + (pgnum << PAGE_SHIFT);
+
+	return kmap(ddr->page + pgnum);
+}
+
+static void pruss_ddr_kunmap(struct dma_buf *dmabuf, unsigned long pgnum,
+			     void *vaddr)
+{
+	struct uio_pruss_ddr *ddr = dmabuf->priv;
+
+	if (ddr->cached)
+		kunmap(ddr->page + pgnum);
+}
+
+static void *pruss_ddr_vmap(struct dma_buf *dmabuf)
+{
+	struct uio_pruss_ddr *ddr = dmabuf->priv;
+
+	if (!ddr->cached)
+		return ddr->vaddr;
+
+	/* the pool is physically contiguous, lowmem is already mapped */
+	return PageHighMem(ddr->page) ? NULL : page_address(ddr->page);
+}
+
+static int pruss_ddr_dmabuf_mmap(struct dma_buf *dmabuf,
+				 struct vm_area_struct *vma)
+{
+	return pruss_ddr_mmap(dmabuf->priv, vma);
+}
+
+static const struct dma_buf_ops pruss_ddr_dmabuf_ops = {
+	.map_dma_buf = pruss_ddr_map_dma_buf,
+	.unmap_dma_buf = pruss_ddr_unmap_dma_buf,
+	.release = pruss_ddr_dmabuf_release,
+	.begin_cpu_access = pruss_ddr_begin_cpu_access,
+	.end_cpu_access = pruss_ddr_end_cpu_access,
+	.kmap_atomic = pruss_ddr_kmap_atomic,
+	.kunmap_atomic = pruss_ddr_kunmap_atomic,
+	.kmap = pruss_ddr_kmap,
+	.kunmap = pruss_ddr_kunmap,
+	.vmap = pruss_ddr_vmap,
+	.mmap = pruss_ddr_dmabuf_mmap,
+};
+
+static struct dma_buf *pruss_ddr_export(struct uio_pruss_ddr *ddr)
+{
+	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+	struct dma_buf *dmabuf;
+
+	/* the dma-buf ops must stay around as long as the dma-buf does */
+	if (!try_module_get(THIS_MODULE))
+		return ERR_PTR(-ENODEV);
+
+	exp_info.ops = &pruss_ddr_dmabuf_ops;
+	exp_info.size = ddr->size;
+	exp_info.flags = O_RDWR;
+	exp_info.priv = ddr;
+
+	kref_get(&ddr->kref);
+	dmabuf = dma_buf_export(&exp_info);
+	if (IS_ERR(dmabuf)) {
+		pruss_ddr_put(ddr);
+		module_put(THIS_MODULE);
+	}
+
+	return dmabuf;
+}
+
+static int pruss_ddr_open(struct inode *inode, struct file *file)
+{
+	struct uio_pruss_dev *gdev = container_of(file->private_data,
+						  struct uio_pruss_dev, misc);
+
+	/* misc_open() holds misc_mtx, so the device cannot go away here */
+	kref_get(&gdev->ddr->kref);
+	file->private_data = gdev->ddr;
+	return 0;
+}
+
+static int pruss_ddr_file_release(struct inode *inode, struct file *file)
+{
+	pruss_ddr_put(file->private_data);
+	return 0;
+}
+
+static long pruss_ddr_ioctl(struct file *file, unsigned int cmd,
+			    unsigned long arg)
+{
+	struct uio_pruss_ddr *ddr = file->private_data;
+	void __user *argp = (void __user *)arg;
+	struct uio_pruss_ddr_info info;
+	struct uio_pruss_ddr_sync sync;
+	struct uio_pruss_ddr_export exp;
+	struct dma_buf *dmabuf;
+
+	switch (cmd) {
+	case UIO_PRUSS_IOC_DDR_INFO:
+		memset(&info, 0, sizeof(info));
+		info.paddr = ddr->paddr;
+		info.size = ddr->size;
+		info.flags = ddr->cached ? UIO_PRUSS_DDR_CACHED : 0;
+		if (copy_to_user(argp, &info, sizeof(info)))
+			return -EFAULT;
+		return 0;
+
+	case UIO_PRUSS_IOC_DDR_SYNC:
+		if (copy_from_user(&sync, argp, sizeof(sync)))
+			return -EFAULT;
+		if (sync.dir == UIO_PRUSS_SYNC_FOR_CPU)
+			return pruss_ddr_sync(ddr, sync.offset, sync.size,
+					      DMA_FROM_DEVICE, true);
+		if (sync.dir == UIO_PRUSS_SYNC_FOR_DEVICE)
+			return pruss_ddr_sync(ddr, sync.offset, sync.size,
+					      DMA_TO_DEVICE, false);
+		return -EINVAL;
+
+	case UIO_PRUSS_IOC_DDR_EXPORT:
+		if (copy_from_user(&exp, argp, sizeof(exp)))
+			return -EFAULT;
+		if (exp.flags & ~O_CLOEXEC)
+			return -EINVAL;
+
+		dmabuf = pruss_ddr_export(ddr);
+		if (IS_ERR(dmabuf))
+			return PTR_ERR(dmabuf);
+
+		exp.fd = dma_buf_fd(dmabuf, exp.flags);
+		if (exp.fd < 0) {
+			dma_buf_put(dmabuf);
+			return exp.fd;
+		}
+		if (copy_to_user(argp, &exp, sizeof(exp)))
+			return -EFAULT;
+		return 0;
+	}
+
+	return -ENOTTY;
+}
+
+static const struct file_operations pruss_ddr_fops = {
+	.owner = THIS_MODULE,
+	.open = pruss_ddr_open,
+	.release = pruss_ddr_file_release,
+	.unlocked_ioctl = pruss_ddr_ioctl,
+	.llseek = noop_llseek,
+};
+
 static void pruss_cleanup(struct device *dev, struct uio_pruss_dev *gdev)
 {
 	int cnt;
@@ -107,10 +517,8 @@ static void pruss_cleanup(struct device *dev, struct uio_pruss_dev *gdev)
 		kfree(p->name);
 	}
 	iounmap(gdev->prussio_vaddr);
-	if (gdev->ddr_vaddr) {
-		dma_free_coherent(dev, extram_pool_sz, gdev->ddr_vaddr,
-			gdev->ddr_paddr);
-	}
+	if (gdev->ddr)
+		pruss_ddr_put(gdev->ddr);
 #ifdef CONFIG_ARCH_DAVINCI_DA850
 	if (gdev->sram_vaddr)
 		gen_pool_free(gdev->sram_pool,
@@ -241,10 +649,18 @@ static int pruss_probe(struct platform_device *pdev)
 		}
 	}
 
-	gdev->ddr_vaddr = dma_alloc_coherent(dev, extram_pool_sz,
-				&(gdev->ddr_paddr), GFP_KERNEL | GFP_DMA);
-	if (!gdev->ddr_vaddr) {
+	if (extram_pool_sz <= 0) {
+		dev_err(dev, "Invalid external memory size %d\n",
+			extram_pool_sz);
+		ret = -EINVAL;
+		goto out_free;
+	}
+
+	gdev->ddr = pruss_ddr_alloc(dev, PAGE_ALIGN(extram_pool_sz),
+				    extram_cached);
+	if (!gdev->ddr) {
 		dev_err(dev, "Could not allocate external memory\n");
+		ret = -ENOMEM;
 		goto out_free;
 	}
 
@@ -278,14 +694,13 @@ static int pruss_probe(struct platform_device *pdev)
 		p->mem[1].size = sram_pool_sz;
 		p->mem[1].memtype = UIO_MEM_PHYS;
 
-		p->mem[2].addr = gdev->ddr_paddr;
-		p->mem[2].size = extram_pool_sz;
-		p->mem[2].memtype = UIO_MEM_PHYS;
-#else
-		p->mem[1].addr = gdev->ddr_paddr;
-		p->mem[1].size = extram_pool_sz;
-		p->mem[1].memtype = UIO_MEM_PHYS;
 #endif
+		p->mem[PRUSS_DDR_MAP].addr = gdev->ddr->paddr;
+		p->mem[PRUSS_DDR_MAP].size = gdev->ddr->size;
+		p->mem[PRUSS_DDR_MAP].memtype = UIO_MEM_PHYS;
+		if (gdev->ddr->cached)
+			p->mmap = pruss_uio_mmap;
+
 		p->name = kasprintf(GFP_KERNEL, "pruss_evt%d", cnt);
 		p->version = DRV_VERSION;
 
@@ -299,6 +714,16 @@ static int pruss_probe(struct platform_device *pdev)
 			goto out_free;
 	}
 
+	gdev->misc.minor = MISC_DYNAMIC_MINOR;
+	gdev->misc.name = "pruss_ddr";
+	gdev->misc.fops = &pruss_ddr_fops;
+	gdev->misc.parent = dev;
+	ret = misc_register(&gdev->misc);
+	if (ret) {
+		dev_err(dev, "Can't register pruss_ddr device\n");
+		goto out_free;
+	}
+
 	platform_set_drvdata(pdev, gdev);
 	return 0;
 
@@ -311,6 +736,7 @@ static int pruss_remove(struct platform_device *dev)
 {
 	struct uio_pruss_dev *gdev = platform_get_drvdata(dev);
 
+	misc_deregister(&gdev->misc);
 	pruss_cleanup(&dev->dev, gdev);
 	return 0;
 }
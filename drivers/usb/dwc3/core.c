@@ -30,6 +30,7 @@
 #include <linux/ioport.h>
 #include <linux/io.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
 #include <linux/of.h>
@@ -1176,6 +1177,7 @@ static int dwc3_probe(struct platform_device *pdev)
 	u8			lpm_nyet_threshold;
 	u8			tx_de_emphasis;
 	u8			hird_threshold;
+	u32			num_trbs;
 
 	int			ret;
 
@@ -1251,6 +1253,8 @@ static int dwc3_probe(struct platform_device *pdev)
 	 */
 	hird_threshold = 12;
 
+	num_trbs = DWC3_TRB_NUM;
+
 	if (node) {
 		if (of_property_read_bool(node, "extcon"))
 			dwc->edev = extcon_get_edev_by_phandle(dev, 0);
@@ -1298,6 +1302,9 @@ static int dwc3_probe(struct platform_device *pdev)
 				"snps,dis_u3_susphy_quirk");
 		dwc->dis_u2_susphy_quirk = of_property_read_bool(node,
 				"snps,dis_u2_susphy_quirk");
+		dwc->bulk_continuous = of_property_read_bool(node,
+				"snps,bulk-continuous");
+		of_property_read_u32(node, "snps,num-trbs", &num_trbs);
 
 		dwc->tx_de_emphasis_quirk = of_property_read_bool(node,
 				"snps,tx_de_emphasis_quirk");
@@ -1333,6 +1340,9 @@ static int dwc3_probe(struct platform_device *pdev)
 		dwc->rx_detect_poll_quirk = pdata->rx_detect_poll_quirk;
 		dwc->dis_u3_susphy_quirk = pdata->dis_u3_susphy_quirk;
 		dwc->dis_u2_susphy_quirk = pdata->dis_u2_susphy_quirk;
+		dwc->bulk_continuous = pdata->bulk_continuous;
+		if (pdata->num_trbs)
+			num_trbs = pdata->num_trbs;
 
 		dwc->tx_de_emphasis_quirk = pdata->tx_de_emphasis_quirk;
 		if (pdata->tx_de_emphasis)
@@ -1344,6 +1354,14 @@ static int dwc3_probe(struct platform_device *pdev)
 		dwc->maximum_speed = USB_SPEED_SUPER;
 
 	dwc->lpm_nyet_threshold = lpm_nyet_threshold;
+
+	if (num_trbs < DWC3_TRB_NUM || num_trbs > DWC3_TRB_NUM_MAX ||
+	    !is_power_of_2(num_trbs)) {
+		dev_warn(dev, "invalid num-trbs %u, using %u\n", num_trbs,
+				DWC3_TRB_NUM);
+		num_trbs = DWC3_TRB_NUM;
+	}
+	dwc->num_trbs = num_trbs;
 	dwc->tx_de_emphasis = tx_de_emphasis;
 
 	dwc->hird_threshold = hird_threshold
@@ -234,6 +234,27 @@ int dwc3_gadget_resize_tx_fifos(struct dwc3 *dwc)
 	return 0;
 }
 
+/*
+ * Isochronous endpoints and bulk endpoints in continuous mode never see the
+ * end of their TRB ring: the last TRB links back to the first one and the
+ * transfer wraps around it for as long as it runs.
+ */
+static bool dwc3_ep_uses_link_trb(struct dwc3_ep *dep)
+{
+	return usb_endpoint_xfer_isoc(dep->endpoint.desc) || dep->continuous;
+}
+
+static unsigned int dwc3_trb_slot(struct dwc3_ep *dep, u32 n)
+{
+	return n & (dep->num_trbs - 1);
+}
+
+/* TRBs one request takes, one per mapped sg entry */
+static unsigned int dwc3_req_trbs(struct dwc3_request *req)
+{
+	return max_t(unsigned int, req->request.num_mapped_sgs, 1);
+}
+
 void dwc3_gadget_giveback(struct dwc3_ep *dep, struct dwc3_request *req,
 		int status)
 {
@@ -249,9 +270,9 @@ void dwc3_gadget_giveback(struct dwc3_ep *dep, struct dwc3_request *req,
 			 * DWC3_TRBCTL_LINK_TRB because it points the TRB we
 			 * just completed (not the LINK TRB).
 			 */
-			if (((dep->busy_slot & DWC3_TRB_MASK) ==
-				DWC3_TRB_NUM- 1) &&
-				usb_endpoint_xfer_isoc(dep->endpoint.desc))
+			if ((dwc3_trb_slot(dep, dep->busy_slot) ==
+				dep->num_trbs - 1) &&
+				dwc3_ep_uses_link_trb(dep))
 				dep->busy_slot++;
 		} while(++i < req->request.num_mapped_sgs);
 		req->queued = false;
@@ -369,7 +390,7 @@ static int dwc3_alloc_trb_pool(struct dwc3_ep *dep)
 		return 0;
 
 	dep->trb_pool = dma_alloc_coherent(dwc->dev,
-			sizeof(struct dwc3_trb) * DWC3_TRB_NUM,
+			sizeof(struct dwc3_trb) * dep->num_trbs,
 			&dep->trb_pool_dma, GFP_KERNEL);
 	if (!dep->trb_pool) {
 		dev_err(dep->dwc->dev, "failed to allocate trb pool for %s\n",
@@ -384,7 +405,7 @@ static void dwc3_free_trb_pool(struct dwc3_ep *dep)
 {
 	struct dwc3		*dwc = dep->dwc;
 
-	dma_free_coherent(dwc->dev, sizeof(struct dwc3_trb) * DWC3_TRB_NUM,
+	dma_free_coherent(dwc->dev, sizeof(struct dwc3_trb) * dep->num_trbs,
 			dep->trb_pool, dep->trb_pool_dma);
 
 	dep->trb_pool = NULL;
@@ -535,13 +556,16 @@ static int __dwc3_gadget_ep_enable(struct dwc3_ep *dep,
 		reg |= DWC3_DALEPENA_EP(dep->number);
 		dwc3_writel(dwc->regs, DWC3_DALEPENA, reg);
 
-		if (!usb_endpoint_xfer_isoc(desc))
+		dep->continuous = dwc->bulk_continuous &&
+			usb_endpoint_xfer_bulk(desc) && !dep->stream_capable;
+
+		if (!dwc3_ep_uses_link_trb(dep))
 			return 0;
 
-		/* Link TRB for ISOC. The HWO bit is never reset */
+		/* Link TRB for ISOC and continuous BULK. HWO is never reset */
 		trb_st_hw = &dep->trb_pool[0];
 
-		trb_link = &dep->trb_pool[DWC3_TRB_NUM - 1];
+		trb_link = &dep->trb_pool[dep->num_trbs - 1];
 		memset(trb_link, 0, sizeof(*trb_link));
 
 		trb_link->bpl = lower_32_bits(dwc3_trb_dma_offset(dep, trb_st_hw));
@@ -600,6 +624,7 @@ static int __dwc3_gadget_ep_disable(struct dwc3_ep *dep)
 	dwc3_writel(dwc->regs, DWC3_DALEPENA, reg);
 
 	dep->stream_capable = false;
+	dep->continuous = false;
 	dep->endpoint.desc = NULL;
 	dep->comp_desc = NULL;
 	dep->type = 0;
@@ -750,19 +775,19 @@ static void dwc3_prepare_one_trb(struct dwc3_ep *dep,
 			chain ? " chain" : "");
 
 
-	trb = &dep->trb_pool[dep->free_slot & DWC3_TRB_MASK];
+	trb = &dep->trb_pool[dwc3_trb_slot(dep, dep->free_slot)];
 
 	if (!req->trb) {
 		dwc3_gadget_move_request_queued(req);
 		req->trb = trb;
 		req->trb_dma = dwc3_trb_dma_offset(dep, trb);
-		req->start_slot = dep->free_slot & DWC3_TRB_MASK;
+		req->start_slot = dwc3_trb_slot(dep, dep->free_slot);
 	}
 
 	dep->free_slot++;
-	/* Skip the LINK-TRB on ISOC */
-	if (((dep->free_slot & DWC3_TRB_MASK) == DWC3_TRB_NUM - 1) &&
-			usb_endpoint_xfer_isoc(dep->endpoint.desc))
+	/* Skip the LINK-TRB */
+	if ((dwc3_trb_slot(dep, dep->free_slot) == dep->num_trbs - 1) &&
+			dwc3_ep_uses_link_trb(dep))
 		dep->free_slot++;
 
 	trb->size = DWC3_TRB_SIZE_LENGTH(length);
@@ -793,10 +818,15 @@ static void dwc3_prepare_one_trb(struct dwc3_ep *dep,
 		BUG();
 	}
 
-	if (!req->request.no_interrupt && !chain)
+	/*
+	 * A continuous transfer has no LST TRB to end on, the last TRB
+	 * queued must interrupt or its requests are never given back.
+	 */
+	if ((!req->request.no_interrupt && !chain) ||
+			(dep->continuous && last))
 		trb->ctrl |= DWC3_TRB_CTRL_IOC;
 
-	if (usb_endpoint_xfer_isoc(dep->endpoint.desc)) {
+	if (dwc3_ep_uses_link_trb(dep)) {
 		trb->ctrl |= DWC3_TRB_CTRL_ISP_IMI;
 		trb->ctrl |= DWC3_TRB_CTRL_CSP;
 	} else if (last) {
@@ -821,7 +851,8 @@ static void dwc3_prepare_one_trb(struct dwc3_ep *dep,
  *
  * The function goes through the requests list and sets up TRBs for the
  * transfers. The function returns once there are no more TRBs available or
- * it runs out of requests.
+ * it runs out of requests. A request is only ever queued as a whole, so
+ * an sg request does not start unless all of its entries fit.
  */
 static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 {
@@ -832,53 +863,73 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 
 	BUILD_BUG_ON_NOT_POWER_OF_2(DWC3_TRB_NUM);
 
-	/* the first request must not be queued */
-	trbs_left = (dep->busy_slot - dep->free_slot) & DWC3_TRB_MASK;
+	if (dwc3_ep_uses_link_trb(dep)) {
+		/*
+		 * One slot holds the link TRB. free_slot and busy_slot both
+		 * step over it, so their distance may count it as used;
+		 * that only ever leaves a slot idle.
+		 */
+		if (list_empty(&dep->req_queued)) {
+			/*
+			 * In case we start from scratch, we queue the ISOC
+			 * requests starting from slot 1. This is done
+			 * because we use ring buffer and have no LST bit to
+			 * stop us. Instead, we place IOC bit every
+			 * TRB_NUM/4. We try to avoid having an interrupt
+			 * after the first request so we start at slot 1 and
+			 * have 7 requests proceed before we hit the first
+			 * IOC. A continuous transfer that is still running
+			 * carries on wherever the core is.
+			 */
+			if (starting) {
+				if (usb_endpoint_xfer_isoc(dep->endpoint.desc))
+					dep->busy_slot = 1;
+				else
+					dep->busy_slot = 0;
+				dep->free_slot = dep->busy_slot;
+			}
+			trbs_left = dep->num_trbs - 1;
+		} else {
+			max = dep->free_slot - dep->busy_slot;
+			if (max >= dep->num_trbs - 1)
+				return;
+			trbs_left = dep->num_trbs - 1 - max;
+		}
+	} else {
+		/* the first request must not be queued */
+		trbs_left = dwc3_trb_slot(dep, dep->busy_slot - dep->free_slot);
 
-	/* Can't wrap around on a non-isoc EP since there's no link TRB */
-	if (!usb_endpoint_xfer_isoc(dep->endpoint.desc)) {
-		max = DWC3_TRB_NUM - (dep->free_slot & DWC3_TRB_MASK);
+		/* Can't wrap around since there's no link TRB */
+		max = dep->num_trbs - dwc3_trb_slot(dep, dep->free_slot);
 		if (trbs_left > max)
 			trbs_left = max;
-	}
 
-	/*
-	 * If busy & slot are equal than it is either full or empty. If we are
-	 * starting to process requests then we are empty. Otherwise we are
-	 * full and don't do anything
-	 */
-	if (!trbs_left) {
-		if (!starting)
-			return;
-		trbs_left = DWC3_TRB_NUM;
 		/*
-		 * In case we start from scratch, we queue the ISOC requests
-		 * starting from slot 1. This is done because we use ring
-		 * buffer and have no LST bit to stop us. Instead, we place
-		 * IOC bit every TRB_NUM/4. We try to avoid having an interrupt
-		 * after the first request so we start at slot 1 and have
-		 * 7 requests proceed before we hit the first IOC.
-		 * Other transfer types don't use the ring buffer and are
-		 * processed from the first TRB until the last one. Since we
+		 * If busy & slot are equal than it is either full or empty.
+		 * If we are starting to process requests then we are empty.
+		 * Otherwise we are full and don't do anything. Since we
 		 * don't wrap around we have to start at the beginning.
 		 */
-		if (usb_endpoint_xfer_isoc(dep->endpoint.desc)) {
-			dep->busy_slot = 1;
-			dep->free_slot = 1;
-		} else {
+		if (!trbs_left) {
+			if (!starting)
+				return;
+			trbs_left = dep->num_trbs;
 			dep->busy_slot = 0;
 			dep->free_slot = 0;
 		}
 	}
 
-	/* The last TRB is a link TRB, not used for xfer */
-	if ((trbs_left <= 1) && usb_endpoint_xfer_isoc(dep->endpoint.desc))
-		return;
-
 	list_for_each_entry_safe(req, n, &dep->request_list, list) {
 		unsigned	length;
 		dma_addr_t	dma;
-		last_one = false;
+
+		if (dwc3_req_trbs(req) > trbs_left)
+			break;
+		trbs_left -= dwc3_req_trbs(req);
+
+		/* the last request that fits this time around */
+		last_one = list_is_last(&req->list, &dep->request_list) ||
+			dwc3_req_trbs(n) > trbs_left;
 
 		if (req->request.num_mapped_sgs > 0) {
 			struct usb_request *request = &req->request;
@@ -893,46 +944,25 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 				dma = sg_dma_address(s);
 
 				if (i == (request->num_mapped_sgs - 1) ||
-						sg_is_last(s)) {
-					if (list_empty(&dep->request_list))
-						last_one = true;
-					chain = false;
-				}
-
-				trbs_left--;
-				if (!trbs_left)
-					last_one = true;
-
-				if (last_one)
+						sg_is_last(s))
 					chain = false;
 
 				dwc3_prepare_one_trb(dep, req, dma, length,
-						last_one, chain, i);
+						last_one && !chain, chain, i);
 
-				if (last_one)
+				if (!chain)
 					break;
 			}
-
-			if (last_one)
-				break;
 		} else {
 			dma = req->request.dma;
 			length = req->request.length;
-			trbs_left--;
-
-			if (!trbs_left)
-				last_one = 1;
-
-			/* Is this the last request? */
-			if (list_is_last(&req->list, &dep->request_list))
-				last_one = 1;
 
 			dwc3_prepare_one_trb(dep, req, dma, length,
 					last_one, false, 0);
-
-			if (last_one)
-				break;
 		}
+
+		if (last_one)
+			break;
 	}
 }
 
@@ -1069,6 +1099,16 @@ static int __dwc3_gadget_ep_queue(struct dwc3_ep *dep, struct dwc3_request *req)
 	if (ret)
 		return ret;
 
+	/* a request is never split, it has to fit the ring in one piece */
+	if (dwc3_req_trbs(req) > dep->num_trbs - 1) {
+		dev_err(dwc->dev, "%s: %u sg entries do not fit %u TRBs\n",
+				dep->name, req->request.num_mapped_sgs,
+				dep->num_trbs);
+		usb_gadget_unmap_request(&dwc->gadget, &req->request,
+				dep->direction);
+		return -EINVAL;
+	}
+
 	list_add_tail(&req->list, &dep->request_list);
 
 	/*
@@ -1084,6 +1124,18 @@ static int __dwc3_gadget_ep_queue(struct dwc3_ep *dep, struct dwc3_request *req)
 		goto out;
 	}
 
+	/*
+	 * A continuous BULK transfer is never restarted: append the new
+	 * TRBs behind the ones the core is working on and tell it about
+	 * them with UPDATE TRANSFER, so it never runs dry between requests.
+	 */
+	if (dep->continuous && (dep->flags & DWC3_EP_BUSY)) {
+		dep->flags &= ~DWC3_EP_PENDING_REQUEST;
+		ret = __dwc3_gadget_kick_transfer(dep, dep->resource_index,
+				false);
+		goto out;
+	}
+
 	/*
 	 * There are a few special cases:
 	 *
@@ -1804,6 +1856,7 @@ static int dwc3_gadget_init_hw_endpoints(struct dwc3 *dwc,
 		dep->dwc = dwc;
 		dep->number = epnum;
 		dep->direction = !!direction;
+		dep->num_trbs = dwc->num_trbs;
 		dwc->eps[epnum] = dep;
 
 		snprintf(dep->name, sizeof(dep->name), "ep%d%s", epnum >> 1,
@@ -1988,10 +2041,10 @@ static int dwc3_cleanup_done_reqs(struct dwc3 *dwc, struct dwc3_ep *dep,
 		i = 0;
 		do {
 			slot = req->start_slot + i;
-			if ((slot == DWC3_TRB_NUM - 1) &&
-				usb_endpoint_xfer_isoc(dep->endpoint.desc))
+			if ((slot >= dep->num_trbs - 1) &&
+				dwc3_ep_uses_link_trb(dep))
 				slot++;
-			slot %= DWC3_TRB_NUM;
+			slot = dwc3_trb_slot(dep, slot);
 			trb = &dep->trb_pool[slot];
 
 			ret = __dwc3_cleanup_done_trbs(dwc, dep, req, trb,
@@ -2071,7 +2124,8 @@ static void dwc3_endpoint_transfer_complete(struct dwc3 *dwc,
 	if (!usb_endpoint_xfer_isoc(dep->endpoint.desc)) {
 		int ret;
 
-		ret = __dwc3_gadget_kick_transfer(dep, 0, is_xfer_complete);
+		ret = __dwc3_gadget_kick_transfer(dep, dep->resource_index,
+				is_xfer_complete);
 		if (!ret || ret == -EBUSY)
 			return;
 	}
@@ -2121,7 +2175,9 @@ static void dwc3_endpoint_interrupt(struct dwc3 *dwc,
 					dep->name, active ? "Transfer Active"
 					: "Transfer Not Active");
 
-			ret = __dwc3_gadget_kick_transfer(dep, 0, !active);
+			ret = __dwc3_gadget_kick_transfer(dep,
+					active ? dep->resource_index : 0,
+					!active);
 			if (!ret || ret == -EBUSY)
 				return;
 
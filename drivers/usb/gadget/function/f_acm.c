@@ -792,6 +792,20 @@ static ssize_t f_acm_attr_show(struct config_item *item,
 	return ret;
 }
 
+static ssize_t f_acm_attr_store(struct config_item *item,
+				struct configfs_attribute *attr,
+				const char *page, size_t len)
+{
+	struct f_serial_opts *opts = to_f_serial_opts(item);
+	struct f_serial_opts_attribute *f_serial_opts_attr =
+		container_of(attr, struct f_serial_opts_attribute, attr);
+	ssize_t ret = 0;
+
+	if (f_serial_opts_attr->store)
+		ret = f_serial_opts_attr->store(opts, page, len);
+	return ret;
+}
+
 static void acm_attr_release(struct config_item *item)
 {
 	struct f_serial_opts *opts = to_f_serial_opts(item);
@@ -802,6 +816,7 @@ static void acm_attr_release(struct config_item *item)
 static struct configfs_item_operations acm_item_ops = {
 	.release                = acm_attr_release,
 	.show_attribute		= f_acm_attr_show,
+	.store_attribute	= f_acm_attr_store,
 };
 
 static ssize_t f_acm_port_num_show(struct f_serial_opts *opts, char *page)
@@ -812,9 +827,55 @@ static ssize_t f_acm_port_num_show(struct f_serial_opts *opts, char *page)
 static struct f_serial_opts_attribute f_acm_port_num =
 	__CONFIGFS_ATTR_RO(port_num, f_acm_port_num_show);
 
+#define F_ACM_IO_SIZE_ATTR(name)					\
+static ssize_t f_acm_##name##_show(struct f_serial_opts *opts,		\
+				   char *page)				\
+{									\
+	int result;							\
+									\
+	mutex_lock(&opts->lock);					\
+	result = sprintf(page, "%u\n", opts->name);			\
+	mutex_unlock(&opts->lock);					\
+									\
+	return result;							\
+}									\
+									\
+static ssize_t f_acm_##name##_store(struct f_serial_opts *opts,	\
+				    const char *page, size_t len)	\
+{									\
+	unsigned old, num;						\
+	int ret;							\
+									\
+	ret = kstrtouint(page, 0, &num);				\
+	if (ret)							\
+		return ret;						\
+									\
+	mutex_lock(&opts->lock);					\
+	old = opts->name;						\
+	opts->name = num;						\
+	ret = gserial_set_io_size(opts->port_num, opts->queue_size,	\
+				  opts->req_size, opts->write_buf_size); \
+	if (ret)							\
+		opts->name = old;					\
+	mutex_unlock(&opts->lock);					\
+									\
+	return ret ?: len;						\
+}									\
+									\
+static struct f_serial_opts_attribute f_acm_##name =			\
+	__CONFIGFS_ATTR(name, S_IRUGO | S_IWUSR, f_acm_##name##_show,	\
+			f_acm_##name##_store)
+
+F_ACM_IO_SIZE_ATTR(queue_size);
+F_ACM_IO_SIZE_ATTR(req_size);
+F_ACM_IO_SIZE_ATTR(write_buf_size);
+
 
 static struct configfs_attribute *acm_attrs[] = {
 	&f_acm_port_num.attr,
+	&f_acm_queue_size.attr,
+	&f_acm_req_size.attr,
+	&f_acm_write_buf_size.attr,
 	NULL,
 };
 
@@ -841,6 +902,7 @@ static struct usb_function_instance *acm_alloc_instance(void)
 	opts = kzalloc(sizeof(*opts), GFP_KERNEL);
 	if (!opts)
 		return ERR_PTR(-ENOMEM);
+	mutex_init(&opts->lock);
 	opts->func_inst.free_func_inst = acm_free_instance;
 	ret = gserial_alloc_line(&opts->port_num);
 	if (ret) {
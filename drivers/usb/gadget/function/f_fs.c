@@ -130,6 +130,14 @@ struct ffs_epfile {
 
 	struct dentry			*dentry;
 
+	/*
+	 * Physically contiguous buffer user space may mmap() and then
+	 * hand to read()/write() to have the request use it in place.
+	 * Set once, P: mutex; freed together with the epfile.
+	 */
+	void				*mmap_buf;
+	size_t				mmap_len;
+
 	char				name[5];
 
 	unsigned char			in;	/* P: ffs->eps_lock */
@@ -143,6 +151,7 @@ struct ffs_epfile {
 struct ffs_io_data {
 	bool aio;
 	bool read;
+	bool mapped;	/* buf lies in epfile's mmap_buf */
 
 	struct kiocb *kiocb;
 	struct iov_iter data;
@@ -647,7 +656,7 @@ static void ffs_user_copy_worker(struct work_struct *work)
 	int ret = io_data->req->status ? io_data->req->status :
 					 io_data->req->actual;
 
-	if (io_data->read && ret > 0) {
+	if (io_data->read && ret > 0 && !io_data->mapped) {
 		use_mm(io_data->mm);
 		ret = copy_to_iter(io_data->buf, ret, &io_data->data);
 		if (iov_iter_count(&io_data->data))
@@ -666,7 +675,8 @@ static void ffs_user_copy_worker(struct work_struct *work)
 	io_data->kiocb->private = NULL;
 	if (io_data->read)
 		kfree(io_data->to_free);
-	kfree(io_data->buf);
+	if (!io_data->mapped)
+		kfree(io_data->buf);
 	kfree(io_data);
 }
 
@@ -681,6 +691,39 @@ static void ffs_epfile_async_io_complete(struct usb_ep *_ep,
 	schedule_work(&io_data->work);
 }
 
+static const struct vm_operations_struct ffs_epfile_vm_ops = {
+};
+
+/*
+ * If the user buffer of @iter lies within a mapping of the epfile's
+ * mmap_buf, return the kernel address of it so that the request can
+ * be queued on it directly.  Otherwise return NULL.
+ */
+static void *ffs_epfile_mapped_buf(struct ffs_epfile *epfile,
+				   struct iov_iter *iter, size_t len)
+{
+	struct vm_area_struct *vma;
+	unsigned long addr, off;
+	void *buf = NULL;
+
+	if (!epfile->mmap_buf || !iter_is_iovec(iter) || iter->nr_segs != 1)
+		return NULL;
+	addr = (unsigned long)iter->iov->iov_base + iter->iov_offset;
+
+	down_read(&current->mm->mmap_sem);
+	vma = find_vma(current->mm, addr);
+	if (vma && vma->vm_ops == &ffs_epfile_vm_ops &&
+	    vma->vm_private_data == epfile && addr >= vma->vm_start &&
+	    len <= vma->vm_end - addr) {
+		off = addr - vma->vm_start + (vma->vm_pgoff << PAGE_SHIFT);
+		if (len <= epfile->mmap_len - off)
+			buf = epfile->mmap_buf + off;
+	}
+	up_read(&current->mm->mmap_sem);
+
+	return buf;
+}
+
 static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 {
 	struct ffs_epfile *epfile = file->private_data;
@@ -689,6 +732,8 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 	ssize_t ret, data_len = -EINVAL;
 	int halt;
 
+	io_data->mapped = false;
+
 	/* Are we still active? */
 	if (WARN_ON(epfile->ffs->state != FFS_ACTIVE)) {
 		ret = -ENODEV;
@@ -741,10 +786,18 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 			data_len = usb_ep_align_maybe(gadget, ep->ep, data_len);
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 
-		data = kmalloc(data_len, GFP_KERNEL);
-		if (unlikely(!data))
-			return -ENOMEM;
-		if (!io_data->read) {
+		data = ffs_epfile_mapped_buf(epfile, &io_data->data, data_len);
+		if (data) {
+			/* Zero copy, the data is already where it belongs */
+			io_data->mapped = true;
+			if (!io_data->read)
+				iov_iter_advance(&io_data->data, data_len);
+		} else {
+			data = kmalloc(data_len, GFP_KERNEL);
+			if (unlikely(!data))
+				return -ENOMEM;
+		}
+		if (!io_data->read && !io_data->mapped) {
 			copied = copy_from_iter(data, data_len, &io_data->data);
 			if (copied != data_len) {
 				ret = -EFAULT;
@@ -844,13 +897,19 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 				 * data then user space has space for.
 				 */
 				ret = ep->status;
-				if (io_data->read && ret > 0) {
+				if (io_data->read && ret > 0 &&
+				    io_data->mapped) {
+					ret = min_t(size_t, ret,
+						iov_iter_count(&io_data->data));
+					iov_iter_advance(&io_data->data, ret);
+				} else if (io_data->read && ret > 0) {
 					ret = copy_to_iter(data, ret, &io_data->data);
 					if (!ret)
 						ret = -EFAULT;
 				}
 			}
-			kfree(data);
+			if (!io_data->mapped)
+				kfree(data);
 		}
 	}
 
@@ -861,7 +920,8 @@ error_lock:
 	spin_unlock_irq(&epfile->ffs->eps_lock);
 	mutex_unlock(&epfile->mutex);
 error:
-	kfree(data);
+	if (!io_data->mapped)
+		kfree(data);
 	return ret;
 }
 
@@ -997,6 +1057,50 @@ ffs_epfile_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+/*
+ * The endpoint buffer is allocated by the first mmap() and is then
+ * shared by all later mappings of the same endpoint file.
+ */
+static int ffs_epfile_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct ffs_epfile *epfile = file->private_data;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long off = vma->vm_pgoff << PAGE_SHIFT;
+	int ret;
+
+	ENTER();
+
+	ret = ffs_mutex_lock(&epfile->mutex, file->f_flags & O_NONBLOCK);
+	if (unlikely(ret))
+		return ret;
+
+	if (!epfile->mmap_buf) {
+		if (off) {
+			ret = -EINVAL;
+			goto done;
+		}
+		epfile->mmap_buf = alloc_pages_exact(size, GFP_KERNEL |
+						     __GFP_ZERO | __GFP_NOWARN);
+		if (!epfile->mmap_buf) {
+			ret = -ENOMEM;
+			goto done;
+		}
+		epfile->mmap_len = size;
+	} else if (off > epfile->mmap_len || size > epfile->mmap_len - off) {
+		ret = -EINVAL;
+		goto done;
+	}
+
+	vma->vm_ops = &ffs_epfile_vm_ops;
+	vma->vm_private_data = epfile;
+	ret = remap_pfn_range(vma, vma->vm_start,
+			      virt_to_phys(epfile->mmap_buf + off) >> PAGE_SHIFT,
+			      size, vma->vm_page_prot);
+done:
+	mutex_unlock(&epfile->mutex);
+	return ret;
+}
+
 static long ffs_epfile_ioctl(struct file *file, unsigned code,
 			     unsigned long value)
 {
@@ -1065,6 +1169,7 @@ static const struct file_operations ffs_epfile_operations = {
 	.write_iter =	ffs_epfile_write_iter,
 	.read_iter =	ffs_epfile_read_iter,
 	.release =	ffs_epfile_release,
+	.mmap =		ffs_epfile_mmap,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
 };
 
@@ -1605,6 +1710,8 @@ static void ffs_epfiles_destroy(struct ffs_epfile *epfiles, unsigned count)
 			dput(epfile->dentry);
 			epfile->dentry = NULL;
 		}
+		if (epfile->mmap_buf)
+			free_pages_exact(epfile->mmap_buf, epfile->mmap_len);
 	}
 
 	kfree(epfiles);
@@ -74,6 +74,11 @@
  *				being a CD-ROM.
  *	->nofua		Flag specifying that FUA flag in SCSI WRITE(10,12)
  *				commands for this LUN shall be ignored.
+ *	->directio	Flag specifying that the backing file shall be
+ *				opened with O_DIRECT.  READ and WRITE
+ *				commands then keep up to num_buffers
+ *				asynchronous requests in flight; the
+ *				logical block size must suit the file.
  *
  *	vendor_name
  *	product_name
@@ -212,6 +217,7 @@
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
+#include <linux/uio.h>
 #include <linux/freezer.h>
 #include <linux/module.h>
 
@@ -307,6 +313,10 @@ struct fsg_common {
 	struct completion	thread_notifier;
 	struct task_struct	*thread_task;
 
+	/* Direct I/O requests on the backing file not yet completed */
+	atomic_t		io_inflight;
+	wait_queue_head_t	io_wait;
+
 	/* Callback functions. */
 	const struct fsg_operations	*ops;
 	/* Gadget's private data. */
@@ -626,6 +636,213 @@ static int sleep_thread(struct fsg_common *common, bool can_freeze)
 }
 
 
+/*-------------------------------------------------------------------------*/
+
+/*
+ * With a backing file opened for direct I/O, READ and WRITE commands
+ * keep a file request in flight on every buffer that is not busy on
+ * the bus, rather than alternating between the two.
+ */
+static bool fsg_lun_is_direct(struct fsg_lun *curlun)
+{
+	struct file	*filp = curlun->filp;
+
+	return (filp->f_flags & O_DIRECT) && filp->f_op->read_iter &&
+	       filp->f_op->write_iter;
+}
+
+/* May run in_irq */
+static void fsg_io_complete(struct kiocb *iocb, long res, long res2)
+{
+	struct fsg_buffhd	*bh;
+	struct fsg_common	*common;
+	unsigned long		flags;
+
+	bh = container_of(iocb, struct fsg_buffhd, iocb);
+	common = bh->common;
+
+	spin_lock_irqsave(&common->lock, flags);
+	bh->io_result = res;
+	bh->state = BUF_STATE_IO_DONE;
+	wakeup_thread(common);
+	spin_unlock_irqrestore(&common->lock, flags);
+
+	if (atomic_dec_and_test(&common->io_inflight))
+		wake_up(&common->io_wait);
+}
+
+static void fsg_start_io(struct fsg_common *common, struct fsg_buffhd *bh,
+			 int rw, loff_t offset, unsigned int amount)
+{
+	struct file	*filp = common->curlun->filp;
+	struct iov_iter	iter;
+	void		*p = bh->buf;
+	unsigned int	len, i;
+	ssize_t		rc;
+
+	/* The buffers are kmalloc()ed, hence physically contiguous */
+	for (i = 0, len = amount; len; ++i) {
+		bh->bvec[i].bv_page = virt_to_page(p);
+		bh->bvec[i].bv_offset = offset_in_page(p);
+		bh->bvec[i].bv_len = min_t(unsigned int, len,
+					   PAGE_SIZE - offset_in_page(p));
+		p += bh->bvec[i].bv_len;
+		len -= bh->bvec[i].bv_len;
+	}
+	iov_iter_bvec(&iter, ITER_BVEC | rw, bh->bvec, i, amount);
+
+	init_sync_kiocb(&bh->iocb, filp);
+	bh->iocb.ki_pos = offset;
+	bh->iocb.ki_complete = fsg_io_complete;
+	bh->common = common;
+	bh->io_amount = amount;
+	bh->state = BUF_STATE_IO_BUSY;
+	atomic_inc(&common->io_inflight);
+
+	if (rw == WRITE) {
+		file_start_write(filp);
+		rc = filp->f_op->write_iter(&bh->iocb, &iter);
+		file_end_write(filp);
+	} else {
+		rc = filp->f_op->read_iter(&bh->iocb, &iter);
+	}
+	VLDBG(common->curlun, "file %s %u @ %llu -> %d\n",
+	      rw == WRITE ? "write" : "read", amount,
+	      (unsigned long long)offset, (int)rc);
+
+	/* Requests the file served synchronously complete right here */
+	if (rc != -EIOCBQUEUED)
+		fsg_io_complete(&bh->iocb, rc, 0);
+}
+
+/*
+ * Wait for all file requests to complete, then drop the data of the
+ * finished ones other than @keep.
+ */
+static void fsg_drain_io(struct fsg_common *common, struct fsg_buffhd *keep)
+{
+	struct fsg_buffhd	*bh;
+	unsigned int		i;
+
+	wait_event(common->io_wait, !atomic_read(&common->io_inflight));
+	smp_rmb();
+	for (i = 0; i < common->fsg_num_buffers; ++i) {
+		bh = &common->buffhds[i];
+		if (bh != keep && bh->state == BUF_STATE_IO_DONE)
+			bh->state = BUF_STATE_EMPTY;
+	}
+}
+
+static int do_read_aio(struct fsg_common *common, loff_t file_offset)
+{
+	struct fsg_lun		*curlun = common->curlun;
+	struct fsg_buffhd	*bh, *io_bh;
+	u32			amount_left, amount_to_read;
+	loff_t			read_offset = file_offset;
+	unsigned int		amount;
+	ssize_t			nread;
+	int			rc = 0;
+
+	amount_left = amount_to_read = common->data_size_from_cmnd;
+
+	/* Oldest buffer whose data hasn't been sent yet */
+	io_bh = common->next_buffhd_to_fill;
+
+	for (;;) {
+		/* Read ahead into every free buffer */
+		bh = common->next_buffhd_to_fill;
+		while (amount_to_read && bh->state == BUF_STATE_EMPTY) {
+			amount = min(amount_to_read, FSG_BUFLEN);
+			amount = min((loff_t)amount,
+				     curlun->file_length - read_offset);
+			if (amount == 0) {
+				/* Past the end of file, see below */
+				bh->io_amount = 0;
+				bh->io_result = 0;
+				bh->state = BUF_STATE_IO_DONE;
+				amount_to_read = 0;
+			} else {
+				fsg_start_io(common, bh, READ, read_offset,
+					     amount);
+				read_offset += amount;
+				amount_to_read -= amount;
+			}
+			bh = bh->next;
+			common->next_buffhd_to_fill = bh;
+		}
+
+		/* Wait for the oldest read to complete */
+		bh = io_bh;
+		if (bh->state != BUF_STATE_IO_DONE) {
+			rc = sleep_thread(common, false);
+			if (rc)
+				break;
+			continue;
+		}
+		amount = bh->io_amount;
+		nread = bh->io_result;
+
+		/*
+		 * If we were asked to read past the end of file,
+		 * end with an empty buffer.
+		 */
+		if (amount == 0) {
+			curlun->sense_data =
+					SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+			curlun->sense_data_info =
+					file_offset >> curlun->blkbits;
+			curlun->info_valid = 1;
+			bh->inreq->length = 0;
+			bh->state = BUF_STATE_FULL;
+			break;
+		}
+
+		if (nread < 0) {
+			LDBG(curlun, "error in file read: %d\n", (int)nread);
+			nread = 0;
+		} else if (nread < amount) {
+			LDBG(curlun, "partial file read: %d/%u\n",
+			     (int)nread, amount);
+			nread = round_down(nread, curlun->blksize);
+		}
+		file_offset  += nread;
+		amount_left  -= nread;
+		common->residue -= nread;
+
+		bh->inreq->length = nread;
+		bh->state = BUF_STATE_FULL;
+
+		/* If an error occurred, report it and its position */
+		if (nread < amount) {
+			curlun->sense_data = SS_UNRECOVERED_READ_ERROR;
+			curlun->sense_data_info =
+					file_offset >> curlun->blkbits;
+			curlun->info_valid = 1;
+			break;
+		}
+
+		if (amount_left == 0)
+			break;		/* No more left to read */
+
+		/* Send this buffer and go read some more */
+		bh->inreq->zero = 0;
+		if (!start_in_transfer(common, bh)) {
+			/* Don't know what to do if common->fsg is NULL */
+			rc = -EIO;
+			break;
+		}
+		io_bh = bh->next;
+	}
+
+	/* The last buffer is left for finish_reply() to send */
+	fsg_drain_io(common, rc ? NULL : io_bh);
+	if (rc)
+		return rc;
+	common->next_buffhd_to_fill = io_bh;
+	return -EIO;		/* No default reply */
+}
+
+
 /*-------------------------------------------------------------------------*/
 
 static int do_read(struct fsg_common *common)
@@ -669,6 +886,9 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	if (fsg_lun_is_direct(curlun))
+		return do_read_aio(common, file_offset);
+
 	for (;;) {
 		/*
 		 * Figure out how much we need to read:
@@ -759,6 +979,174 @@ static int do_read(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+static int do_write_aio(struct fsg_common *common, loff_t file_offset)
+{
+	struct fsg_lun		*curlun = common->curlun;
+	struct fsg_buffhd	*bh, *io_bh;
+	int			get_some_more = 1;
+	bool			stopped = false, failed = false;
+	u32			amount_left_to_req, amount_left_to_write;
+	loff_t			usb_offset, write_offset;
+	unsigned int		amount;
+	ssize_t			nwritten;
+	int			rc = 0;
+
+	usb_offset = write_offset = file_offset;
+	amount_left_to_req = common->data_size_from_cmnd;
+	amount_left_to_write = common->data_size_from_cmnd;
+
+	/* Oldest buffer whose write hasn't been accounted for yet */
+	io_bh = common->next_buffhd_to_drain;
+
+	while (amount_left_to_write > 0) {
+
+		/* Account for completed writes in order */
+		bh = io_bh;
+		if (bh->state == BUF_STATE_IO_DONE) {
+			amount = bh->io_amount;
+			nwritten = bh->io_result;
+			bh->state = BUF_STATE_EMPTY;
+			io_bh = bh->next;
+			if (failed)
+				continue;
+
+			/* Nothing written, or the transfer itself failed */
+			if (amount == 0) {
+				if (nwritten < 0) {
+					curlun->sense_data =
+						SS_COMMUNICATION_FAILURE;
+					curlun->sense_data_info =
+						file_offset >> curlun->blkbits;
+					curlun->info_valid = 1;
+					failed = true;
+				}
+				continue;
+			}
+
+			if (nwritten < 0) {
+				LDBG(curlun, "error in file write: %d\n",
+				     (int)nwritten);
+				nwritten = 0;
+			} else if (nwritten < amount) {
+				LDBG(curlun, "partial file write: %d/%u\n",
+				     (int)nwritten, amount);
+				nwritten = round_down(nwritten, curlun->blksize);
+			}
+			file_offset += nwritten;
+			amount_left_to_write -= nwritten;
+			common->residue -= nwritten;
+
+			/* If an error occurred, report it and its position */
+			if (nwritten < amount) {
+				curlun->sense_data = SS_WRITE_ERROR;
+				curlun->sense_data_info =
+					file_offset >> curlun->blkbits;
+				curlun->info_valid = 1;
+				failed = true;
+			}
+			continue;
+		}
+		if (failed)
+			stopped = true;
+		if (stopped && io_bh == common->next_buffhd_to_drain)
+			break;			/* Nothing left in flight */
+
+		/* Queue a request for more data from the host */
+		bh = common->next_buffhd_to_fill;
+		if (!stopped && bh->state == BUF_STATE_EMPTY && get_some_more) {
+			amount = min(amount_left_to_req, FSG_BUFLEN);
+
+			/* Beyond the end of the backing file? */
+			if (usb_offset >= curlun->file_length) {
+				get_some_more = 0;
+				curlun->sense_data =
+					SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+				curlun->sense_data_info =
+					usb_offset >> curlun->blkbits;
+				curlun->info_valid = 1;
+				continue;
+			}
+
+			/* Get the next buffer */
+			usb_offset += amount;
+			common->usb_amount_left -= amount;
+			amount_left_to_req -= amount;
+			if (amount_left_to_req == 0)
+				get_some_more = 0;
+
+			set_bulk_out_req_length(common, bh, amount);
+			if (!start_out_transfer(common, bh)) {
+				/* Dunno what to do if common->fsg is NULL */
+				rc = -EIO;
+				break;
+			}
+			common->next_buffhd_to_fill = bh->next;
+			continue;
+		}
+
+		/* Start writing the received data to the backing file */
+		bh = common->next_buffhd_to_drain;
+		if (!stopped && bh->state == BUF_STATE_EMPTY &&
+		    !get_some_more) {
+			stopped = true;		/* We stopped early */
+			continue;
+		}
+		if (!stopped && bh->state == BUF_STATE_FULL) {
+			smp_rmb();
+			common->next_buffhd_to_drain = bh->next;
+
+			/*
+			 * Did something go wrong with the transfer?  Report
+			 * it once the writes ahead of it have completed.
+			 */
+			if (bh->outreq->status != 0) {
+				bh->io_amount = 0;
+				bh->io_result = bh->outreq->status;
+				bh->state = BUF_STATE_IO_DONE;
+				stopped = true;
+				continue;
+			}
+
+			amount = bh->outreq->actual;
+			if (curlun->file_length - write_offset < amount) {
+				LERROR(curlun,
+				       "write %u @ %llu beyond end %llu\n",
+				       amount, (unsigned long long)write_offset,
+				       (unsigned long long)curlun->file_length);
+				amount = curlun->file_length - write_offset;
+			}
+
+			/* Don't accept excess data, nor a partial block */
+			amount = min(amount, bh->bulk_out_intended_length);
+			amount = round_down(amount, curlun->blksize);
+
+			/* Did the host decide to stop early? */
+			if (bh->outreq->actual < bh->bulk_out_intended_length) {
+				common->short_packet_received = 1;
+				stopped = true;
+			}
+
+			if (amount == 0) {
+				bh->io_amount = 0;
+				bh->io_result = 0;
+				bh->state = BUF_STATE_IO_DONE;
+				continue;
+			}
+			fsg_start_io(common, bh, WRITE, write_offset, amount);
+			write_offset += amount;
+			continue;
+		}
+
+		/* Wait for something to happen */
+		rc = sleep_thread(common, false);
+		if (rc)
+			break;
+	}
+
+	fsg_drain_io(common, NULL);
+	return rc ? rc : -EIO;		/* No default reply */
+}
+
 static int do_write(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -809,6 +1197,9 @@ static int do_write(struct fsg_common *common)
 		return -EINVAL;
 	}
 
+	if (fsg_lun_is_direct(curlun))
+		return do_write_aio(common, ((loff_t) lba) << curlun->blkbits);
+
 	/* Carry out the file writes */
 	get_some_more = 1;
 	file_offset = usb_offset = ((loff_t) lba) << curlun->blkbits;
@@ -2589,6 +2980,14 @@ static ssize_t nofua_show(struct device *dev, struct device_attribute *attr,
 	return fsg_show_nofua(curlun, buf);
 }
 
+static ssize_t directio_show(struct device *dev, struct device_attribute *attr,
+			     char *buf)
+{
+	struct fsg_lun		*curlun = fsg_lun_from_dev(dev);
+
+	return fsg_show_directio(curlun, buf);
+}
+
 static ssize_t file_show(struct device *dev, struct device_attribute *attr,
 			 char *buf)
 {
@@ -2615,6 +3014,16 @@ static ssize_t nofua_store(struct device *dev, struct device_attribute *attr,
 	return fsg_store_nofua(curlun, buf, count);
 }
 
+static ssize_t directio_store(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct fsg_lun		*curlun = fsg_lun_from_dev(dev);
+	struct rw_semaphore	*filesem = dev_get_drvdata(dev);
+
+	return fsg_store_directio(curlun, filesem, buf, count);
+}
+
 static ssize_t file_store(struct device *dev, struct device_attribute *attr,
 			  const char *buf, size_t count)
 {
@@ -2625,6 +3034,7 @@ static ssize_t file_store(struct device *dev, struct device_attribute *attr,
 }
 
 static DEVICE_ATTR_RW(nofua);
+static DEVICE_ATTR_RW(directio);
 /* mode wil be set in fsg_lun_attr_is_visible() */
 static DEVICE_ATTR(ro, 0, ro_show, ro_store);
 static DEVICE_ATTR(file, 0, file_show, file_store);
@@ -2677,6 +3087,8 @@ static struct fsg_common *fsg_common_setup(struct fsg_common *common)
 	kref_init(&common->ref);
 	init_completion(&common->thread_notifier);
 	init_waitqueue_head(&common->fsg_wait);
+	atomic_set(&common->io_inflight, 0);
+	init_waitqueue_head(&common->io_wait);
 	common->state = FSG_STATE_TERMINATED;
 
 	return common;
@@ -2848,6 +3260,7 @@ static struct attribute *fsg_lun_dev_attrs[] = {
 	&dev_attr_ro.attr,
 	&dev_attr_file.attr,
 	&dev_attr_nofua.attr,
+	&dev_attr_directio.attr,
 	NULL
 };
 
@@ -2903,6 +3316,7 @@ int fsg_common_create_lun(struct fsg_common *common, struct fsg_lun_config *cfg,
 	lun->ro = cfg->cdrom || cfg->ro;
 	lun->initially_ro = lun->ro;
 	lun->removable = !!cfg->removable;
+	lun->directio = !!cfg->directio;
 
 	if (!common->sysfs) {
 		/* we DON'T own the name!*/
@@ -3268,12 +3682,35 @@ static struct fsg_lun_opts_attribute fsg_lun_opts_nofua =
 	__CONFIGFS_ATTR(nofua, S_IRUGO | S_IWUSR, fsg_lun_opts_nofua_show,
 			fsg_lun_opts_nofua_store);
 
+static ssize_t fsg_lun_opts_directio_show(struct fsg_lun_opts *opts,
+					  char *page)
+{
+	return fsg_show_directio(opts->lun, page);
+}
+
+static ssize_t fsg_lun_opts_directio_store(struct fsg_lun_opts *opts,
+					   const char *page, size_t len)
+{
+	struct fsg_opts *fsg_opts;
+
+	fsg_opts = to_fsg_opts(opts->group.cg_item.ci_parent);
+
+	return fsg_store_directio(opts->lun, &fsg_opts->common->filesem, page,
+				  len);
+}
+
+static struct fsg_lun_opts_attribute fsg_lun_opts_directio =
+	__CONFIGFS_ATTR(directio, S_IRUGO | S_IWUSR,
+			fsg_lun_opts_directio_show,
+			fsg_lun_opts_directio_store);
+
 static struct configfs_attribute *fsg_lun_attrs[] = {
 	&fsg_lun_opts_file.attr,
 	&fsg_lun_opts_ro.attr,
 	&fsg_lun_opts_removable.attr,
 	&fsg_lun_opts_cdrom.attr,
 	&fsg_lun_opts_nofua.attr,
+	&fsg_lun_opts_directio.attr,
 	NULL,
 };
 
@@ -3618,6 +4055,7 @@ void fsg_config_from_params(struct fsg_config *cfg,
 		lun->ro = !!params->ro[i];
 		lun->cdrom = !!params->cdrom[i];
 		lun->removable = !!params->removable[i];
+		lun->directio = !!params->directio[i];
 		lun->filename =
 			params->file_count > i && params->file[i][0]
 			? params->file[i]
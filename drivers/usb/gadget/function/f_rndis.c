@@ -20,6 +20,8 @@
 #include <linux/module.h>
 #include <linux/device.h>
 #include <linux/etherdevice.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 
 #include <linux/atomic.h>
 
@@ -81,6 +83,17 @@ struct f_rndis {
 	struct usb_ep			*notify;
 	struct usb_request		*notify_req;
 	atomic_t			notify_count;
+
+	struct net_device		*netdev;
+
+	/* For multi-packet IN transfers */
+	struct sk_buff			*skb_tx_data;
+	unsigned			tx_pkt_count;
+	bool				timer_force_tx;
+	struct tasklet_struct		tx_tasklet;
+	struct hrtimer			task_timer;
+
+	bool				timer_stopping;
 };
 
 static inline struct f_rndis *func_to_rndis(struct usb_function *f)
@@ -107,6 +120,32 @@ static unsigned int bitrate(struct usb_gadget *g)
 #define RNDIS_STATUS_INTERVAL_MS	32
 #define STATUS_BYTECOUNT		8	/* 8 bytes data */
 
+/*
+ * Several packet messages may share one bulk transfer.  IN transfers are
+ * also capped by the MaxTransferSize the host sends in its initialize
+ * message; for most Linux hosts that leaves room for one full frame only.
+ * Each OUT request buffer grows to hold ul_max_pkts_per_xfer frames.
+ */
+#define RNDIS_UL_MAX_PKTS_LIMIT		16
+
+static unsigned int dl_max_pkts_per_xfer = 10;
+module_param(dl_max_pkts_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dl_max_pkts_per_xfer,
+		"max packets per IN transfer, 1 to disable batching");
+
+static unsigned int dl_max_xfer_size = 16384;
+module_param(dl_max_xfer_size, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dl_max_xfer_size, "max bytes per IN transfer");
+
+static unsigned int dl_aggr_timeout_us = 300;
+module_param(dl_aggr_timeout_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dl_aggr_timeout_us,
+		"usecs to hold back a partly filled IN transfer, 0 to disable");
+
+static unsigned int ul_max_pkts_per_xfer = 3;
+module_param(ul_max_pkts_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(ul_max_pkts_per_xfer, "max packets per OUT transfer");
+
 
 /* interface descriptor: */
 
@@ -369,18 +408,123 @@ static struct usb_gadget_strings *rndis_strings[] = {
 
 /*-------------------------------------------------------------------------*/
 
+static struct sk_buff *rndis_package_for_tx(struct f_rndis *rndis)
+{
+	struct sk_buff *skb = rndis->skb_tx_data;
+
+	hrtimer_try_to_cancel(&rndis->task_timer);
+	rndis->skb_tx_data = NULL;
+	rndis->tx_pkt_count = 0;
+
+	return skb;
+}
+
 static struct sk_buff *rndis_add_header(struct gether *port,
 					struct sk_buff *skb)
 {
-	struct sk_buff *skb2;
+	struct f_rndis *rndis = func_to_rndis(&port->func);
+	struct rndis_packet_msg_type *header;
+	struct sk_buff *skb2 = NULL;
+	unsigned max_size, len;
+
+	/* rndis_tx_tasklet() wants whatever is pending sent now */
+	if (!skb) {
+		if (rndis->skb_tx_data && rndis->timer_force_tx)
+			skb2 = rndis_package_for_tx(rndis);
+		return skb2;
+	}
+
+	len = skb->len + sizeof(*header);
+	max_size = min(dl_max_xfer_size,
+		       rndis_get_dl_max_xfer_size(rndis->config));
+
+	if (rndis->skb_tx_data &&
+	    (rndis->tx_pkt_count >= dl_max_pkts_per_xfer ||
+	     rndis->skb_tx_data->len + len > max_size))
+		skb2 = rndis_package_for_tx(rndis);
 
-	skb2 = skb_realloc_headroom(skb, sizeof(struct rndis_packet_msg_type));
-	rndis_add_hdr(skb2);
+	/* Don't bother copying a packet nothing could be batched with */
+	if (!rndis->skb_tx_data && !skb2 &&
+	    (dl_max_pkts_per_xfer < 2 || !dl_aggr_timeout_us ||
+	     2 * len > max_size)) {
+		skb2 = skb_realloc_headroom(skb, sizeof(*header));
+		rndis_add_hdr(skb2);
+
+		dev_kfree_skb(skb);
+		return skb2;
+	}
+
+	if (!rndis->skb_tx_data) {
+		rndis->skb_tx_data = alloc_skb(max(max_size, len), GFP_ATOMIC);
+		if (!rndis->skb_tx_data) {
+			rndis->netdev->stats.tx_dropped++;
+			dev_kfree_skb_any(skb);
+			return skb2;
+		}
+
+		/* Bound the latency of the first packet in the batch */
+		hrtimer_start(&rndis->task_timer,
+			      ktime_set(0, dl_aggr_timeout_us * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
+
+	header = (void *) skb_put(rndis->skb_tx_data, sizeof(*header));
+	memset(header, 0, sizeof(*header));
+	header->MessageType = cpu_to_le32(RNDIS_MSG_PACKET);
+	header->MessageLength = cpu_to_le32(len);
+	header->DataOffset = cpu_to_le32(36);
+	header->DataLength = cpu_to_le32(skb->len);
+	memcpy(skb_put(rndis->skb_tx_data, skb->len), skb->data, skb->len);
+	rndis->tx_pkt_count++;
+	dev_kfree_skb_any(skb);
+
+	if (!skb2 && rndis->tx_pkt_count >= dl_max_pkts_per_xfer)
+		skb2 = rndis_package_for_tx(rndis);
 
-	dev_kfree_skb(skb);
 	return skb2;
 }
 
+/*
+ * This transmits the pending batch, if any, once the timer expires.
+ */
+static void rndis_tx_tasklet(unsigned long data)
+{
+	struct f_rndis *rndis = (void *)data;
+
+	if (rndis->timer_stopping)
+		return;
+
+	if (rndis->skb_tx_data) {
+		rndis->timer_force_tx = true;
+		rndis->netdev->netdev_ops->ndo_start_xmit(NULL, rndis->netdev);
+		rndis->timer_force_tx = false;
+
+		/* no free IN request; try again rather than strand it */
+		if (rndis->skb_tx_data)
+			hrtimer_start(&rndis->task_timer,
+				      ktime_set(0, dl_aggr_timeout_us *
+						NSEC_PER_USEC),
+				      HRTIMER_MODE_REL);
+	}
+}
+
+static enum hrtimer_restart rndis_tx_timeout(struct hrtimer *data)
+{
+	struct f_rndis *rndis = container_of(data, struct f_rndis, task_timer);
+
+	tasklet_schedule(&rndis->tx_tasklet);
+	return HRTIMER_NORESTART;
+}
+
+/* called once gether_disconnect() has stopped any further wrap() calls */
+static void rndis_tx_reset(struct f_rndis *rndis)
+{
+	hrtimer_cancel(&rndis->task_timer);
+	dev_kfree_skb_any(rndis->skb_tx_data);
+	rndis->skb_tx_data = NULL;
+	rndis->tx_pkt_count = 0;
+}
+
 static void rndis_response_available(void *_rndis)
 {
 	struct f_rndis			*rndis = _rndis;
@@ -560,7 +704,9 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 
 		if (rndis->port.in_ep->driver_data) {
 			DBG(cdev, "reset rndis\n");
+			rndis->timer_stopping = true;
 			gether_disconnect(&rndis->port);
+			rndis_tx_reset(rndis);
 		}
 
 		if (!rndis->port.in_ep->desc || !rndis->port.out_ep->desc) {
@@ -592,10 +738,18 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		 */
 		rndis->port.cdc_filter = 0;
 
+		rndis->port.ul_max_pkts_per_xfer = clamp_t(unsigned,
+				ul_max_pkts_per_xfer, 1,
+				RNDIS_UL_MAX_PKTS_LIMIT);
+		rndis_set_max_pkt_xfer(rndis->config,
+				rndis->port.ul_max_pkts_per_xfer);
+
 		DBG(cdev, "RNDIS RX/TX early activation ... \n");
 		net = gether_connect(&rndis->port);
 		if (IS_ERR(net))
 			return PTR_ERR(net);
+		rndis->netdev = net;
+		rndis->timer_stopping = false;
 
 		rndis_set_param_dev(rndis->config, net,
 				&rndis->port.cdc_filter);
@@ -618,7 +772,9 @@ static void rndis_disable(struct usb_function *f)
 	DBG(cdev, "rndis deactivated\n");
 
 	rndis_uninit(rndis->config);
+	rndis->timer_stopping = true;
 	gether_disconnect(&rndis->port);
+	rndis_tx_reset(rndis);
 
 	usb_ep_disable(rndis->notify);
 	rndis->notify->driver_data = NULL;
@@ -796,6 +952,11 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 	rndis->port.open = rndis_open;
 	rndis->port.close = rndis_close;
 
+	tasklet_init(&rndis->tx_tasklet, rndis_tx_tasklet,
+		     (unsigned long) rndis);
+	hrtimer_init(&rndis->task_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	rndis->task_timer.function = rndis_tx_timeout;
+
 	rndis_set_param_medium(rndis->config, RNDIS_MEDIUM_802_3, 0);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
 
@@ -956,6 +1117,9 @@ static void rndis_unbind(struct usb_configuration *c, struct usb_function *f)
 {
 	struct f_rndis		*rndis = func_to_rndis(f);
 
+	hrtimer_cancel(&rndis->task_timer);
+	tasklet_kill(&rndis->tx_tasklet);
+
 	kfree(f->os_desc_table);
 	f->os_desc_n = 0;
 	usb_free_all_descriptors(f);
@@ -992,6 +1156,7 @@ static struct usb_function *rndis_alloc(struct usb_function_instance *fi)
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.supports_multi_frame = true;
 
 	rndis->port.func.name = "rndis";
 	/* descriptors are per-instance copies */
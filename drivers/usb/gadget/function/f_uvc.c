@@ -610,6 +610,11 @@ uvc_function_bind(struct usb_configuration *c, struct usb_function *f)
 	opts->streaming_interval = clamp(opts->streaming_interval, 1U, 16U);
 	opts->streaming_maxpacket = clamp(opts->streaming_maxpacket, 1U, 3072U);
 	opts->streaming_maxburst = min(opts->streaming_maxburst, 15U);
+	opts->streaming_requests = clamp(opts->streaming_requests, 1U,
+					 (unsigned int)UVC_MAX_NUM_REQUESTS);
+
+	uvc->video.num_requests = opts->streaming_requests;
+	uvc->video.use_sg = cdev->gadget->sg_supported;
 
 	/* Fill in the FS/HS/SS Video Streaming specific descriptors from the
 	 * module parameters.
@@ -869,6 +874,7 @@ static struct usb_function_instance *uvc_alloc_inst(void)
 
 	opts->streaming_interval = 1;
 	opts->streaming_maxpacket = 1024;
+	opts->streaming_requests = UVC_NUM_REQUESTS;
 
 	uvcg_attach_configfs(opts);
 	return &opts->func_inst;
@@ -585,16 +585,19 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32(RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32(RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32(RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32(1);
-	resp->MaxTransferSize = cpu_to_le32(
-		  params->dev->mtu
+	resp->MaxPacketsPerTransfer = cpu_to_le32(params->max_pkt_per_xfer);
+	resp->MaxTransferSize = cpu_to_le32(params->max_pkt_per_xfer *
+		(params->dev->mtu
 		+ sizeof(struct ethhdr)
 		+ sizeof(struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32(0);
 	resp->AFListOffset = cpu_to_le32(0);
 	resp->AFListSize = cpu_to_le32(0);
 
+	/* the most the host will take from us in one bulk IN transfer */
+	params->dl_max_xfer_size = le32_to_cpu(buf->MaxTransferSize);
+
 	params->resp_avail(params->v);
 	return 0;
 }
@@ -780,6 +783,7 @@ void rndis_uninit(int configNr)
 	if (configNr >= RNDIS_MAX_CONFIGS)
 		return;
 	rndis_per_dev_params[configNr].state = RNDIS_UNINITIALIZED;
+	rndis_per_dev_params[configNr].dl_max_xfer_size = 0;
 
 	/* drain the response queue */
 	while ((buf = rndis_get_next_response(configNr, &length)))
@@ -886,6 +890,7 @@ int rndis_register(void (*resp_avail)(void *v), void *v)
 	for (i = 0; i < RNDIS_MAX_CONFIGS; i++) {
 		if (!rndis_per_dev_params[i].used) {
 			rndis_per_dev_params[i].used = 1;
+			rndis_per_dev_params[i].max_pkt_per_xfer = 1;
 			rndis_per_dev_params[i].resp_avail = resp_avail;
 			rndis_per_dev_params[i].v = v;
 			pr_debug("%s: configNr = %d\n", __func__, i);
@@ -946,6 +951,28 @@ int rndis_set_param_medium(u8 configNr, u32 medium, u32 speed)
 }
 EXPORT_SYMBOL_GPL(rndis_set_param_medium);
 
+/* how many packets the host may concatenate into one OUT transfer */
+int rndis_set_max_pkt_xfer(u8 configNr, u32 max_pkt_per_xfer)
+{
+	pr_debug("%s: %u\n", __func__, max_pkt_per_xfer);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params[configNr].max_pkt_per_xfer =
+		max_t(u32, max_pkt_per_xfer, 1);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(rndis_set_max_pkt_xfer);
+
+/* largest IN transfer the host asked for, or 0 before it initialized us */
+u32 rndis_get_dl_max_xfer_size(u8 configNr)
+{
+	if (configNr >= RNDIS_MAX_CONFIGS) return 0;
+
+	return rndis_per_dev_params[configNr].dl_max_xfer_size;
+}
+EXPORT_SYMBOL_GPL(rndis_get_dl_max_xfer_size);
+
 void rndis_add_hdr(struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type *header;
@@ -1017,30 +1044,65 @@ static rndis_resp_t *rndis_add_response(int configNr, u32 length)
 	return r;
 }
 
+/*
+ * The host may concatenate up to max_pkt_per_xfer packet messages into
+ * one transfer.  Every message but the last is cloned off the transfer
+ * skb; the last one, or one whose MessageLength can't be trusted, gets
+ * the skb itself.  Anything after the last message is padding.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32 *tmp = (void *)skb->data;
+	bool first = true;
+
+	while (skb->len >= sizeof(struct rndis_packet_msg_type)) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		__le32 *tmp = (void *)skb->data;
+		u32 msg_len, data_offset, data_len;
+		struct sk_buff *skb2;
+
+		/* MessageType, MessageLength */
+		if (cpu_to_le32(RNDIS_MSG_PACKET)
+				!= get_unaligned(tmp++)) {
+			if (!first)
+				break;
+			dev_kfree_skb_any(skb);
+			return -EINVAL;
+		}
+		msg_len = get_unaligned_le32(tmp++);
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(RNDIS_MSG_PACKET)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++);
+		data_len = get_unaligned_le32(tmp++);
+
+		if (msg_len >= skb->len ||
+		    msg_len < data_offset + 8 + data_len) {
+			if (!skb_pull(skb, data_offset + 8)) {
+				dev_kfree_skb_any(skb);
+				return -EOVERFLOW;
+			}
+			skb_trim(skb, data_len);
+
+			skb_queue_tail(list, skb);
+			return 0;
+		}
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			dev_kfree_skb_any(skb);
+			return -ENOMEM;
+		}
+		skb_pull(skb2, data_offset + 8);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
+
+		skb_pull(skb, msg_len);
+		first = false;
 	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
 
-	skb_queue_tail(list, skb);
-	return 0;
+	dev_kfree_skb_any(skb);
+	return first ? -EINVAL : 0;
 }
 EXPORT_SYMBOL_GPL(rndis_rm_hdr);
 
@@ -192,16 +192,27 @@ int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 	loff_t				min_sectors;
 	unsigned int			blkbits;
 	unsigned int			blksize;
+	int				flags = O_LARGEFILE;
 
+	/* Bypass the page cache if asked to and the file allows it */
+	if (curlun->directio)
+		flags |= O_DIRECT;
+again:
 	/* R/W if we can, R/O if we must */
 	ro = curlun->initially_ro;
 	if (!ro) {
-		filp = filp_open(filename, O_RDWR | O_LARGEFILE, 0);
+		filp = filp_open(filename, O_RDWR | flags, 0);
 		if (PTR_ERR(filp) == -EROFS || PTR_ERR(filp) == -EACCES)
 			ro = 1;
 	}
 	if (ro)
-		filp = filp_open(filename, O_RDONLY | O_LARGEFILE, 0);
+		filp = filp_open(filename, O_RDONLY | flags, 0);
+	if (PTR_ERR(filp) == -EINVAL && (flags & O_DIRECT)) {
+		LINFO(curlun, "no direct I/O on %s, using page cache\n",
+		      filename);
+		flags &= ~O_DIRECT;
+		goto again;
+	}
 	if (IS_ERR(filp)) {
 		LINFO(curlun, "unable to open backing file: %s\n", filename);
 		return PTR_ERR(filp);
@@ -333,6 +344,12 @@ ssize_t fsg_show_nofua(struct fsg_lun *curlun, char *buf)
 }
 EXPORT_SYMBOL_GPL(fsg_show_nofua);
 
+ssize_t fsg_show_directio(struct fsg_lun *curlun, char *buf)
+{
+	return sprintf(buf, "%u\n", curlun->directio);
+}
+EXPORT_SYMBOL_GPL(fsg_show_directio);
+
 ssize_t fsg_show_file(struct fsg_lun *curlun, struct rw_semaphore *filesem,
 		      char *buf)
 {
@@ -431,6 +448,31 @@ ssize_t fsg_store_nofua(struct fsg_lun *curlun, const char *buf, size_t count)
 }
 EXPORT_SYMBOL_GPL(fsg_store_nofua);
 
+ssize_t fsg_store_directio(struct fsg_lun *curlun, struct rw_semaphore *filesem,
+			   const char *buf, size_t count)
+{
+	ssize_t		rc;
+	bool		directio;
+
+	rc = strtobool(buf, &directio);
+	if (rc)
+		return rc;
+
+	/* The open mode of the backing file follows this flag */
+	down_read(filesem);
+	if (fsg_lun_is_open(curlun)) {
+		LDBG(curlun, "direct I/O change prevented\n");
+		rc = -EBUSY;
+	} else {
+		curlun->directio = directio;
+		rc = count;
+	}
+	up_read(filesem);
+
+	return rc;
+}
+EXPORT_SYMBOL_GPL(fsg_store_directio);
+
 ssize_t fsg_store_file(struct fsg_lun *curlun, struct rw_semaphore *filesem,
 		       const char *buf, size_t count)
 {
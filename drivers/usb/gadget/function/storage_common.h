@@ -2,6 +2,8 @@
 #define USB_STORAGE_COMMON_H
 
 #include <linux/device.h>
+#include <linux/blk_types.h>
+#include <linux/fs.h>
 #include <linux/usb/storage.h>
 #include <scsi/scsi.h>
 #include <asm/unaligned.h>
@@ -101,6 +103,7 @@ struct fsg_lun {
 	unsigned int	registered:1;
 	unsigned int	info_valid:1;
 	unsigned int	nofua:1;
+	unsigned int	directio:1;
 
 	u32		sense_data;
 	u32		sense_data_info;
@@ -122,13 +125,18 @@ static inline bool fsg_lun_is_open(struct fsg_lun *curlun)
 /* Default size of buffer length. */
 #define FSG_BUFLEN	((u32)16384)
 
+/* Pages a buffer may span, for building direct I/O bio_vecs */
+#define FSG_BUF_NR_PAGES	(DIV_ROUND_UP(FSG_BUFLEN, PAGE_SIZE) + 1)
+
 /* Maximal number of LUNs supported in mass storage function */
 #define FSG_MAX_LUNS	8
 
 enum fsg_buffer_state {
 	BUF_STATE_EMPTY = 0,
 	BUF_STATE_FULL,
-	BUF_STATE_BUSY
+	BUF_STATE_BUSY,
+	BUF_STATE_IO_BUSY,	/* backing file I/O in flight */
+	BUF_STATE_IO_DONE	/* ... and completed */
 };
 
 struct fsg_buffhd {
@@ -147,6 +155,13 @@ struct fsg_buffhd {
 	int				inreq_busy;
 	struct usb_request		*outreq;
 	int				outreq_busy;
+
+	/* Asynchronous backing file I/O, see fsg_start_io() */
+	struct kiocb			iocb;
+	struct fsg_common		*common;
+	struct bio_vec			bvec[FSG_BUF_NR_PAGES];
+	unsigned int			io_amount;
+	ssize_t				io_result;
 };
 
 enum fsg_state {
@@ -208,6 +223,7 @@ int fsg_lun_fsync_sub(struct fsg_lun *curlun);
 void store_cdrom_address(u8 *dest, int msf, u32 addr);
 ssize_t fsg_show_ro(struct fsg_lun *curlun, char *buf);
 ssize_t fsg_show_nofua(struct fsg_lun *curlun, char *buf);
+ssize_t fsg_show_directio(struct fsg_lun *curlun, char *buf);
 ssize_t fsg_show_file(struct fsg_lun *curlun, struct rw_semaphore *filesem,
 		      char *buf);
 ssize_t fsg_show_cdrom(struct fsg_lun *curlun, char *buf);
@@ -215,6 +231,8 @@ ssize_t fsg_show_removable(struct fsg_lun *curlun, char *buf);
 ssize_t fsg_store_ro(struct fsg_lun *curlun, struct rw_semaphore *filesem,
 		     const char *buf, size_t count);
 ssize_t fsg_store_nofua(struct fsg_lun *curlun, const char *buf, size_t count);
+ssize_t fsg_store_directio(struct fsg_lun *curlun, struct rw_semaphore *filesem,
+			   const char *buf, size_t count);
 ssize_t fsg_store_file(struct fsg_lun *curlun, struct rw_semaphore *filesem,
 		       const char *buf, size_t count);
 ssize_t fsg_store_cdrom(struct fsg_lun *curlun, struct rw_semaphore *filesem,
@@ -76,6 +76,8 @@ struct gether {
 	u32				fixed_out_len;
 	u32				fixed_in_len;
 	bool				supports_multi_frame;
+	/* RNDIS hosts may concatenate packets into one OUT transfer */
+	unsigned			ul_max_pkts_per_xfer;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
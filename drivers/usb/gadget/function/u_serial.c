@@ -73,13 +73,20 @@
  *	tty_struct->driver_data ... gserial
  */
 
-/* RX and TX queues can buffer QUEUE_SIZE packets before they hit the
- * next layer of buffering.  For TX that's a circular buffer; for RX
- * consider it a NOP.  A third layer is provided by the TTY code.
+/* RX and TX queues can buffer QUEUE_SIZE requests of REQ_BUF_SIZE bytes
+ * (rounded to whole packets) before they hit the next layer of
+ * buffering.  For TX that's a circular buffer; for RX consider it a NOP.
+ * A third layer is provided by the TTY code.  Each port may override
+ * these defaults with gserial_set_io_size().
  */
 #define QUEUE_SIZE		16
+#define REQ_BUF_SIZE		2048
 #define WRITE_BUF_SIZE		8192		/* TX only */
 
+#define MAX_QUEUE_SIZE		64
+#define MAX_REQ_BUF_SIZE	16384
+#define MAX_WRITE_BUF_SIZE	(256 * 1024)
+
 /* circular buffer */
 struct gs_buf {
 	unsigned		buf_size;
@@ -115,6 +122,13 @@ struct gs_port {
 	wait_queue_head_t	drain_wait;	/* wait while writes drain */
 	bool                    write_busy;
 
+	/* I/O sizing; rx/tx_len are fixed while requests are allocated */
+	unsigned		queue_size;
+	unsigned		req_size;
+	unsigned		write_buf_size;
+	unsigned		rx_len;
+	unsigned		tx_len;
+
 	/* REVISIT this state ... */
 	struct usb_cdc_line_coding port_line_coding;	/* 8-N-1 etc */
 };
@@ -368,11 +382,11 @@ __acquires(&port->port_lock)
 		struct usb_request	*req;
 		int			len;
 
-		if (port->write_started >= QUEUE_SIZE)
+		if (port->write_started >= port->queue_size)
 			break;
 
 		req = list_entry(pool->next, struct usb_request, list);
-		len = gs_send_packet(port, req->buf, in->maxpacket);
+		len = gs_send_packet(port, req->buf, port->tx_len);
 		if (len == 0) {
 			wake_up_interruptible(&port->drain_wait);
 			break;
@@ -441,12 +455,12 @@ __acquires(&port->port_lock)
 		if (!tty)
 			break;
 
-		if (port->read_started >= QUEUE_SIZE)
+		if (port->read_started >= port->queue_size)
 			break;
 
 		req = list_entry(pool->next, struct usb_request, list);
 		list_del(&req->list);
-		req->length = out->maxpacket;
+		req->length = port->rx_len;
 
 		/* drop lock while we call out; the controller driver
 		 * may need to call us back (e.g. for disconnect)
@@ -477,7 +491,7 @@ __acquires(&port->port_lock)
  *
  * If the RX queue becomes full enough that no usb_request is queued,
  * the OUT endpoint may begin NAKing as soon as its FIFO fills up.
- * So QUEUE_SIZE packets plus however many the FIFO holds (usually two)
+ * So queue_size requests plus however many the FIFO holds (usually two)
  * can be buffered before the TTY layer's buffers (currently 64 KB).
  */
 static void gs_rx_push(unsigned long _port)
@@ -635,18 +649,18 @@ static void gs_free_requests(struct usb_ep *ep, struct list_head *head,
 
 static int gs_alloc_requests(struct usb_ep *ep, struct list_head *head,
 		void (*fn)(struct usb_ep *, struct usb_request *),
-		int *allocated)
+		int *allocated, int queue_size, unsigned len)
 {
 	int			i;
 	struct usb_request	*req;
-	int n = allocated ? QUEUE_SIZE - *allocated : QUEUE_SIZE;
+	int n = allocated ? queue_size - *allocated : queue_size;
 
-	/* Pre-allocate up to QUEUE_SIZE transfers, but if we can't
+	/* Pre-allocate up to queue_size transfers, but if we can't
 	 * do quite that many this time, don't fail ... we just won't
 	 * be as speedy as we might otherwise be.
 	 */
 	for (i = 0; i < n; i++) {
-		req = gs_alloc_req(ep, ep->maxpacket, GFP_ATOMIC);
+		req = gs_alloc_req(ep, len, GFP_ATOMIC);
 		if (!req)
 			return list_empty(head) ? -ENOMEM : 0;
 		req->complete = fn;
@@ -657,6 +671,14 @@ static int gs_alloc_requests(struct usb_ep *ep, struct list_head *head,
 	return 0;
 }
 
+/* Request length for @ep: req_size in whole packets, at least one */
+static unsigned gs_req_len(struct gs_port *port, struct usb_ep *ep)
+{
+	if (port->req_size <= ep->maxpacket)
+		return ep->maxpacket;
+	return rounddown(port->req_size, ep->maxpacket);
+}
+
 /**
  * gs_start_io - start USB I/O streams
  * @dev: encapsulates endpoints to use
@@ -679,13 +701,18 @@ static int gs_start_io(struct gs_port *port)
 	 * configurations may use different endpoints with a given port;
 	 * and high speed vs full speed changes packet sizes too.
 	 */
+	if (!port->read_allocated)
+		port->rx_len = gs_req_len(port, ep);
 	status = gs_alloc_requests(ep, head, gs_read_complete,
-		&port->read_allocated);
+		&port->read_allocated, port->queue_size, port->rx_len);
 	if (status)
 		return status;
 
+	if (!port->write_allocated)
+		port->tx_len = gs_req_len(port, port->port_usb->in);
 	status = gs_alloc_requests(port->port_usb->in, &port->write_pool,
-			gs_write_complete, &port->write_allocated);
+			gs_write_complete, &port->write_allocated,
+			port->queue_size, port->tx_len);
 	if (status) {
 		gs_free_requests(ep, head, &port->read_allocated);
 		return status;
@@ -773,7 +800,8 @@ static int gs_open(struct tty_struct *tty, struct file *file)
 	if (port->port_write_buf.buf_buf == NULL) {
 
 		spin_unlock_irq(&port->port_lock);
-		status = gs_buf_alloc(&port->port_write_buf, WRITE_BUF_SIZE);
+		status = gs_buf_alloc(&port->port_write_buf,
+				      port->write_buf_size);
 		spin_lock_irq(&port->port_lock);
 
 		if (status) {
@@ -1054,6 +1082,10 @@ gs_port_alloc(unsigned port_num, struct usb_cdc_line_coding *coding)
 	port->port_num = port_num;
 	port->port_line_coding = *coding;
 
+	port->queue_size = QUEUE_SIZE;
+	port->req_size = REQ_BUF_SIZE;
+	port->write_buf_size = WRITE_BUF_SIZE;
+
 	ports[port_num].port = port;
 out:
 	mutex_unlock(&ports[port_num].lock);
@@ -1142,6 +1174,47 @@ err:
 }
 EXPORT_SYMBOL_GPL(gserial_alloc_line);
 
+/**
+ * gserial_set_io_size - size the I/O queues of a TTY port
+ * @port_num: line allocated with gserial_alloc_line()
+ * @queue_size: requests kept in flight per direction
+ * @req_size: bytes per request, rounded down to whole packets
+ * @buf_size: bytes of the TX circular buffer
+ * Context: may sleep
+ *
+ * Zero selects the default for any of the sizes.  Request sizes apply
+ * from the next connection, the buffer size from the next time it is
+ * allocated, i.e. when the TTY is opened with no buffer left over.
+ *
+ * Returns negative errno or zero.
+ */
+int gserial_set_io_size(unsigned char port_num, unsigned queue_size,
+			unsigned req_size, unsigned buf_size)
+{
+	struct gs_port	*port;
+	int		ret = 0;
+
+	if (queue_size > MAX_QUEUE_SIZE || req_size > MAX_REQ_BUF_SIZE ||
+	    buf_size > MAX_WRITE_BUF_SIZE)
+		return -EINVAL;
+
+	mutex_lock(&ports[port_num].lock);
+	port = ports[port_num].port;
+	if (port) {
+		spin_lock_irq(&port->port_lock);
+		port->queue_size = queue_size ?: QUEUE_SIZE;
+		port->req_size = req_size ?: REQ_BUF_SIZE;
+		port->write_buf_size = buf_size ?: WRITE_BUF_SIZE;
+		spin_unlock_irq(&port->port_lock);
+	} else {
+		ret = -ENODEV;
+	}
+	mutex_unlock(&ports[port_num].lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(gserial_set_io_size);
+
 /**
  * gserial_connect - notify TTY I/O glue that USB link is active
  * @gser: the function, set up with endpoints and descriptors
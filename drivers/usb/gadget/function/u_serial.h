@@ -20,6 +20,12 @@
 struct f_serial_opts {
 	struct usb_function_instance func_inst;
 	u8 port_num;
+
+	/* see gserial_set_io_size(), 0 is the default; P: lock */
+	struct mutex lock;
+	unsigned queue_size;
+	unsigned req_size;
+	unsigned write_buf_size;
 };
 
 /*
@@ -59,6 +65,8 @@ void gs_free_req(struct usb_ep *, struct usb_request *req);
 /* management of individual TTY ports */
 int gserial_alloc_line(unsigned char *port_line);
 void gserial_free_line(unsigned char port_line);
+int gserial_set_io_size(unsigned char port_line, unsigned queue_size,
+			unsigned req_size, unsigned buf_size);
 
 /* connect/disconnect is handled by individual functions */
 int gserial_connect(struct gserial *, u8 port_num);
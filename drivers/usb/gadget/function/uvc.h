@@ -52,6 +52,7 @@ struct uvc_event
 
 #ifdef __KERNEL__
 
+#include <linux/scatterlist.h>
 #include <linux/usb.h>	/* For usb_endpoint_* */
 #include <linux/usb/composite.h>
 #include <linux/usb/gadget.h>
@@ -97,7 +98,8 @@ extern unsigned int uvc_gadget_trace_param;
  * Driver specific constants
  */
 
-#define UVC_NUM_REQUESTS			4
+#define UVC_NUM_REQUESTS			8
+#define UVC_MAX_NUM_REQUESTS			64
 #define UVC_MAX_REQUEST_SIZE			64
 #define UVC_MAX_EVENTS				4
 
@@ -105,6 +107,17 @@ extern unsigned int uvc_gadget_trace_param;
  * Structures
  */
 
+struct uvc_video;
+
+struct uvc_request
+{
+	struct usb_request *req;
+	__u8 *req_buffer;		/* payload, or just the header with sg */
+	struct uvc_video *video;
+	struct sg_table sgt;
+	struct uvc_buffer *last_buf;	/* to complete when req is done */
+};
+
 struct uvc_video
 {
 	struct usb_ep *ep;
@@ -119,8 +132,9 @@ struct uvc_video
 
 	/* Requests */
 	unsigned int req_size;
-	struct usb_request *req[UVC_NUM_REQUESTS];
-	__u8 *req_buffer[UVC_NUM_REQUESTS];
+	unsigned int num_requests;
+	struct uvc_request *ureq;
+	bool use_sg;			/* point requests into the buffers */
 	struct list_head req_free;
 	spinlock_t req_lock;
 
@@ -2356,6 +2356,8 @@ UVCG_OPTS_ATTR(streaming_maxpacket, le16_to_cpu, kstrtou16, u16, le16_to_cpu,
 	       3072);
 UVCG_OPTS_ATTR(streaming_maxburst, identity_conv, kstrtou8, u8, identity_conv,
 	       15);
+UVCG_OPTS_ATTR(streaming_requests, identity_conv, kstrtou8, u8, identity_conv,
+	       64);
 
 #undef identity_conv
 
@@ -2365,6 +2367,7 @@ static struct configfs_attribute *uvc_attrs[] = {
 	&f_uvc_opts_attribute_streaming_interval.attr,
 	&f_uvc_opts_attribute_streaming_maxpacket.attr,
 	&f_uvc_opts_attribute_streaming_maxburst.attr,
+	&f_uvc_opts_attribute_streaming_requests.attr,
 	NULL,
 };
 
@@ -305,32 +305,55 @@ int uvcg_queue_enable(struct uvc_video_queue *queue, int enable)
 	return ret;
 }
 
-/* called with &queue_irqlock held.. */
-struct uvc_buffer *uvcg_queue_next_buffer(struct uvc_video_queue *queue,
-					  struct uvc_buffer *buf)
+/*
+ * Take a fully sent buffer off the irqqueue without giving it back to
+ * userspace yet, for requests that still point into it.  Returns false
+ * if the buffer is to be sent again instead.
+ *
+ * called with &queue_irqlock held..
+ */
+bool uvcg_queue_detach_buffer(struct uvc_video_queue *queue,
+			      struct uvc_buffer *buf)
 {
-	struct uvc_buffer *nextbuf;
-
 	if ((queue->flags & UVC_QUEUE_DROP_INCOMPLETE) &&
 	     buf->length != buf->bytesused) {
 		buf->state = UVC_BUF_STATE_QUEUED;
 		vb2_set_plane_payload(&buf->buf, 0, 0);
-		return buf;
+		return false;
 	}
 
 	list_del(&buf->queue);
-	if (!list_empty(&queue->irqqueue))
-		nextbuf = list_first_entry(&queue->irqqueue, struct uvc_buffer,
-					   queue);
-	else
-		nextbuf = NULL;
+	return true;
+}
 
+/* Give a detached buffer back to userspace; called with &queue_irqlock held */
+void uvcg_complete_buffer(struct uvc_video_queue *queue,
+			  struct uvc_buffer *buf)
+{
 	buf->buf.v4l2_buf.field = V4L2_FIELD_NONE;
 	buf->buf.v4l2_buf.sequence = queue->sequence++;
 	v4l2_get_timestamp(&buf->buf.v4l2_buf.timestamp);
 
 	vb2_set_plane_payload(&buf->buf, 0, buf->bytesused);
 	vb2_buffer_done(&buf->buf, VB2_BUF_STATE_DONE);
+}
+
+/* called with &queue_irqlock held.. */
+struct uvc_buffer *uvcg_queue_next_buffer(struct uvc_video_queue *queue,
+					  struct uvc_buffer *buf)
+{
+	struct uvc_buffer *nextbuf;
+
+	if (!uvcg_queue_detach_buffer(queue, buf))
+		return buf;
+
+	if (!list_empty(&queue->irqqueue))
+		nextbuf = list_first_entry(&queue->irqqueue, struct uvc_buffer,
+					   queue);
+	else
+		nextbuf = NULL;
+
+	uvcg_complete_buffer(queue, buf);
 
 	return nextbuf;
 }
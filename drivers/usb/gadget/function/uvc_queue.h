@@ -88,6 +88,12 @@ int uvcg_queue_enable(struct uvc_video_queue *queue, int enable);
 struct uvc_buffer *uvcg_queue_next_buffer(struct uvc_video_queue *queue,
 					  struct uvc_buffer *buf);
 
+bool uvcg_queue_detach_buffer(struct uvc_video_queue *queue,
+			      struct uvc_buffer *buf);
+
+void uvcg_complete_buffer(struct uvc_video_queue *queue,
+			  struct uvc_buffer *buf);
+
 struct uvc_buffer *uvcg_queue_head(struct uvc_video_queue *queue);
 
 #endif /* __KERNEL__ */
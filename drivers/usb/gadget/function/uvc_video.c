@@ -13,6 +13,8 @@
 #include <linux/kernel.h>
 #include <linux/device.h>
 #include <linux/errno.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
 #include <linux/usb/ch9.h>
 #include <linux/usb/gadget.h>
 #include <linux/usb/video.h>
@@ -40,28 +42,81 @@ uvc_video_encode_header(struct uvc_video *video, struct uvc_buffer *buf,
 	return 2;
 }
 
+/*
+ * Point the request at @len bytes of video data at @mem, preceded by the
+ * first @header_len bytes of its own buffer.
+ */
+static void
+uvc_video_map_data(struct uvc_request *ureq, unsigned int header_len,
+		void *mem, unsigned int len)
+{
+	struct scatterlist *sg = ureq->sgt.sgl;
+	unsigned int nents = 0;
+	unsigned int part;
+
+	sg_init_table(sg, ureq->sgt.nents);
+
+	if (header_len)
+		sg_set_buf(&sg[nents++], ureq->req_buffer, header_len);
+
+	while (len) {
+		part = min_t(unsigned int, len, PAGE_SIZE - offset_in_page(mem));
+		sg_set_page(&sg[nents++], is_vmalloc_addr(mem) ?
+			    vmalloc_to_page(mem) : virt_to_page(mem),
+			    part, offset_in_page(mem));
+		mem += part;
+		len -= part;
+	}
+
+	if (nents)
+		sg_mark_end(&sg[nents - 1]);
+	ureq->req->sg = sg;
+	ureq->req->num_sgs = nents;
+}
+
 static int
 uvc_video_encode_data(struct uvc_video *video, struct uvc_buffer *buf,
-		u8 *data, int len)
+		struct uvc_request *ureq, unsigned int offset, int len)
 {
 	struct uvc_video_queue *queue = &video->queue;
 	unsigned int nbytes;
 	void *mem;
 
-	/* Copy video data to the USB buffer. */
 	mem = buf->mem + queue->buf_used;
 	nbytes = min((unsigned int)len, buf->bytesused - queue->buf_used);
 
-	memcpy(data, mem, nbytes);
+	/* Send the video data in place, or copy it to the USB buffer. */
+	if (video->use_sg)
+		uvc_video_map_data(ureq, offset, mem, nbytes);
+	else
+		memcpy(ureq->req_buffer + offset, mem, nbytes);
 	queue->buf_used += nbytes;
 
 	return nbytes;
 }
 
+/*
+ * The whole buffer has been encoded. With sg requests it is given back to
+ * userspace from the completion of the last request pointing into it.
+ */
+static void
+uvc_video_buffer_sent(struct uvc_video *video, struct uvc_request *ureq,
+		struct uvc_buffer *buf)
+{
+	video->queue.buf_used = 0;
+	buf->state = UVC_BUF_STATE_DONE;
+	if (!video->use_sg)
+		uvcg_queue_next_buffer(&video->queue, buf);
+	else if (uvcg_queue_detach_buffer(&video->queue, buf))
+		ureq->last_buf = buf;
+	video->fid ^= UVC_STREAM_FID;
+}
+
 static void
 uvc_video_encode_bulk(struct usb_request *req, struct uvc_video *video,
 		struct uvc_buffer *buf)
 {
+	struct uvc_request *ureq = req->context;
 	void *mem = req->buf;
 	int len = video->req_size;
 	int ret;
@@ -76,20 +131,16 @@ uvc_video_encode_bulk(struct usb_request *req, struct uvc_video *video,
 
 	/* Process video data. */
 	len = min((int)(video->max_payload_size - video->payload_size), len);
-	ret = uvc_video_encode_data(video, buf, mem, len);
+	ret = uvc_video_encode_data(video, buf, ureq, mem - req->buf, len);
 
 	video->payload_size += ret;
-	len -= ret;
+	len = video->req_size - (mem - req->buf) - ret;
 
 	req->length = video->req_size - len;
 	req->zero = video->payload_size == video->max_payload_size;
 
 	if (buf->bytesused == video->queue.buf_used) {
-		video->queue.buf_used = 0;
-		buf->state = UVC_BUF_STATE_DONE;
-		uvcg_queue_next_buffer(&video->queue, buf);
-		video->fid ^= UVC_STREAM_FID;
-
+		uvc_video_buffer_sent(video, ureq, buf);
 		video->payload_size = 0;
 	}
 
@@ -102,6 +153,7 @@ static void
 uvc_video_encode_isoc(struct usb_request *req, struct uvc_video *video,
 		struct uvc_buffer *buf)
 {
+	struct uvc_request *ureq = req->context;
 	void *mem = req->buf;
 	int len = video->req_size;
 	int ret;
@@ -112,17 +164,13 @@ uvc_video_encode_isoc(struct usb_request *req, struct uvc_video *video,
 	len -= ret;
 
 	/* Process video data. */
-	ret = uvc_video_encode_data(video, buf, mem, len);
+	ret = uvc_video_encode_data(video, buf, ureq, mem - req->buf, len);
 	len -= ret;
 
 	req->length = video->req_size - len;
 
-	if (buf->bytesused == video->queue.buf_used) {
-		video->queue.buf_used = 0;
-		buf->state = UVC_BUF_STATE_DONE;
-		uvcg_queue_next_buffer(&video->queue, buf);
-		video->fid ^= UVC_STREAM_FID;
-	}
+	if (buf->bytesused == video->queue.buf_used)
+		uvc_video_buffer_sent(video, ureq, buf);
 }
 
 /* --------------------------------------------------------------------------
@@ -162,12 +210,27 @@ uvc_video_encode_isoc(struct usb_request *req, struct uvc_video *video,
 static void
 uvc_video_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct uvc_video *video = req->context;
+	struct uvc_request *ureq = req->context;
+	struct uvc_video *video = ureq->video;
 	struct uvc_video_queue *queue = &video->queue;
 	struct uvc_buffer *buf;
 	unsigned long flags;
 	int ret;
 
+	/* The last request pointing into a buffer hands it back. */
+	if (ureq->last_buf) {
+		spin_lock_irqsave(&queue->irqlock, flags);
+		if (req->status == 0) {
+			uvcg_complete_buffer(queue, ureq->last_buf);
+		} else {
+			ureq->last_buf->state = UVC_BUF_STATE_ERROR;
+			vb2_buffer_done(&ureq->last_buf->buf,
+					VB2_BUF_STATE_ERROR);
+		}
+		ureq->last_buf = NULL;
+		spin_unlock_irqrestore(&queue->irqlock, flags);
+	}
+
 	switch (req->status) {
 	case 0:
 		break;
@@ -213,18 +276,21 @@ requeue:
 static int
 uvc_video_free_requests(struct uvc_video *video)
 {
+	struct uvc_request *ureq;
 	unsigned int i;
 
-	for (i = 0; i < UVC_NUM_REQUESTS; ++i) {
-		if (video->req[i]) {
-			usb_ep_free_request(video->ep, video->req[i]);
-			video->req[i] = NULL;
-		}
+	if (video->ureq) {
+		for (i = 0; i < video->num_requests; ++i) {
+			ureq = &video->ureq[i];
 
-		if (video->req_buffer[i]) {
-			kfree(video->req_buffer[i]);
-			video->req_buffer[i] = NULL;
+			if (ureq->req)
+				usb_ep_free_request(video->ep, ureq->req);
+			sg_free_table(&ureq->sgt);
+			kfree(ureq->req_buffer);
 		}
+
+		kfree(video->ureq);
+		video->ureq = NULL;
 	}
 
 	INIT_LIST_HEAD(&video->req_free);
@@ -235,6 +301,7 @@ uvc_video_free_requests(struct uvc_video *video)
 static int
 uvc_video_alloc_requests(struct uvc_video *video)
 {
+	struct uvc_request *ureq;
 	unsigned int req_size;
 	unsigned int i;
 	int ret = -ENOMEM;
@@ -245,21 +312,37 @@ uvc_video_alloc_requests(struct uvc_video *video)
 		 * max_t(unsigned int, video->ep->maxburst, 1)
 		 * (video->ep->mult + 1);
 
-	for (i = 0; i < UVC_NUM_REQUESTS; ++i) {
-		video->req_buffer[i] = kmalloc(req_size, GFP_KERNEL);
-		if (video->req_buffer[i] == NULL)
+	video->ureq = kcalloc(video->num_requests, sizeof(*video->ureq),
+			      GFP_KERNEL);
+	if (video->ureq == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < video->num_requests; ++i) {
+		ureq = &video->ureq[i];
+
+		/* With sg only the payload header goes through this buffer. */
+		ureq->req_buffer = kmalloc(req_size, GFP_KERNEL);
+		if (ureq->req_buffer == NULL)
+			goto error;
+
+		/* A header and the pages a request's data may straddle. */
+		if (video->use_sg &&
+		    sg_alloc_table(&ureq->sgt,
+				   DIV_ROUND_UP(req_size, PAGE_SIZE) + 2,
+				   GFP_KERNEL))
 			goto error;
 
-		video->req[i] = usb_ep_alloc_request(video->ep, GFP_KERNEL);
-		if (video->req[i] == NULL)
+		ureq->req = usb_ep_alloc_request(video->ep, GFP_KERNEL);
+		if (ureq->req == NULL)
 			goto error;
 
-		video->req[i]->buf = video->req_buffer[i];
-		video->req[i]->length = 0;
-		video->req[i]->complete = uvc_video_complete;
-		video->req[i]->context = video;
+		ureq->video = video;
+		ureq->req->buf = ureq->req_buffer;
+		ureq->req->length = 0;
+		ureq->req->complete = uvc_video_complete;
+		ureq->req->context = ureq;
 
-		list_add_tail(&video->req[i]->list, &video->req_free);
+		list_add_tail(&ureq->req->list, &video->req_free);
 	}
 
 	video->req_size = req_size;
@@ -352,9 +435,9 @@ int uvcg_video_enable(struct uvc_video *video, int enable)
 	}
 
 	if (!enable) {
-		for (i = 0; i < UVC_NUM_REQUESTS; ++i)
-			if (video->req[i])
-				usb_ep_dequeue(video->ep, video->req[i]);
+		for (i = 0; video->ureq && i < video->num_requests; ++i)
+			if (video->ureq[i].req)
+				usb_ep_dequeue(video->ep, video->ureq[i].req);
 
 		uvc_video_free_requests(video);
 		uvcg_queue_enable(&video->queue, 0);
@@ -384,6 +467,9 @@ int uvcg_video_init(struct uvc_video *video)
 	INIT_LIST_HEAD(&video->req_free);
 	spin_lock_init(&video->req_lock);
 
+	if (!video->num_requests)
+		video->num_requests = UVC_NUM_REQUESTS;
+
 	video->fcc = V4L2_PIX_FMT_YUYV;
 	video->bpp = 16;
 	video->width = 320;
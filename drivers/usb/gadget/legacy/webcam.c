@@ -34,6 +34,10 @@ static unsigned int streaming_maxburst;
 module_param(streaming_maxburst, uint, S_IRUGO|S_IWUSR);
 MODULE_PARM_DESC(streaming_maxburst, "0 - 15 (ss only)");
 
+static unsigned int streaming_requests = 8;
+module_param(streaming_requests, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(streaming_requests, "1 - 64 requests in flight");
+
 static unsigned int trace;
 module_param(trace, uint, S_IRUGO|S_IWUSR);
 MODULE_PARM_DESC(trace, "Trace level bitmask");
@@ -383,6 +387,7 @@ webcam_bind(struct usb_composite_dev *cdev)
 	uvc_opts->streaming_interval = streaming_interval;
 	uvc_opts->streaming_maxpacket = streaming_maxpacket;
 	uvc_opts->streaming_maxburst = streaming_maxburst;
+	uvc_opts->streaming_requests = streaming_requests;
 	uvc_set_trace_param(trace);
 
 	uvc_opts->fs_control = uvc_fs_control_cls;
@@ -1,6 +1,7 @@
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
 #include <linux/dmaengine.h>
+#include <linux/module.h>
 #include <linux/sizes.h>
 #include <linux/platform_device.h>
 #include <linux/of.h>
@@ -22,6 +23,9 @@
 #define USB_CTRL_AUTOREQ	0xd0
 #define USB_TDOWN		0xd8
 
+#define CPPI41_TX_POLL_MIN_US	20
+#define CPPI41_TX_POLL_MAX_US	2000
+
 struct cppi41_dma_channel {
 	struct dma_channel channel;
 	struct cppi41_dma_controller *controller;
@@ -32,6 +36,7 @@ struct cppi41_dma_channel {
 	u8 is_tx;
 	u8 is_allocated;
 	u8 usb_toggle;
+	u8 rx_gen_rndis;
 
 	dma_addr_t buf_addr;
 	u32 total_len;
@@ -51,11 +56,16 @@ struct cppi41_dma_controller {
 	struct musb *musb;
 	struct hrtimer early_tx;
 	struct list_head early_tx_list;
+	unsigned int tx_poll_us;
 	u32 rx_mode;
 	u32 tx_mode;
 	u32 auto_req;
 };
 
+static bool host_rx_multipkt = true;
+module_param(host_rx_multipkt, bool, 0644);
+MODULE_PARM_DESC(host_rx_multipkt, "use multi-packet host bulk RX DMA");
+
 static void save_rx_toggle(struct cppi41_dma_channel *cppi41_channel)
 {
 	u16 csr;
@@ -91,9 +101,12 @@ static void update_rx_toggle(struct cppi41_dma_channel *cppi41_channel)
 	/*
 	 * AM335x Advisory 1.0.13: Due to internal synchronisation error the
 	 * data toggle may reset from DATA1 to DATA0 during receiving data from
-	 * more than one endpoint.
+	 * more than one endpoint.  A multi-packet transfer may legitimately
+	 * end on the toggle it started with, and is only ever used while no
+	 * other RX endpoint is busy, so it is left alone.
 	 */
-	if (!toggle && toggle == cppi41_channel->usb_toggle) {
+	if (!cppi41_channel->rx_gen_rndis &&
+	    !toggle && toggle == cppi41_channel->usb_toggle) {
 		csr |= MUSB_RXCSR_H_DATATOGGLE | MUSB_RXCSR_H_WR_DATATOGGLE;
 		musb_writew(cppi41_channel->hw_ep->regs, MUSB_RXCSR, csr);
 		dev_dbg(cppi41_channel->controller->musb->controller,
@@ -118,6 +131,10 @@ static bool musb_is_tx_fifo_empty(struct musb_hw_ep *hw_ep)
 }
 
 static void cppi41_dma_callback(void *private_data);
+static void cppi41_set_dma_mode(struct cppi41_dma_channel *cppi41_channel,
+		unsigned mode);
+static void cppi41_set_autoreq_mode(struct cppi41_dma_channel *cppi41_channel,
+		unsigned mode);
 
 static void cppi41_trans_done(struct cppi41_dma_channel *cppi41_channel)
 {
@@ -153,7 +170,18 @@ static void cppi41_trans_done(struct cppi41_dma_channel *cppi41_channel)
 		enum dma_transfer_direction direction;
 		u32 remain_bytes;
 
-		cppi41_channel->buf_addr += cppi41_channel->packet_sz;
+		cppi41_channel->buf_addr += cppi41_channel->prog_len;
+
+		/* the tail of a multi-packet RX goes one packet at a time */
+		if (cppi41_channel->rx_gen_rndis) {
+			musb_writel(musb->ctrl_base,
+				RNDIS_REG(cppi41_channel->port_num), 0);
+			cppi41_set_dma_mode(cppi41_channel,
+					EP_MODE_DMA_TRANSPARENT);
+			cppi41_set_autoreq_mode(cppi41_channel,
+					EP_MODE_AUTOREQ_NONE);
+			cppi41_channel->rx_gen_rndis = 0;
+		}
 
 		remain_bytes = cppi41_channel->total_len;
 		remain_bytes -= cppi41_channel->transferred;
@@ -209,11 +237,19 @@ static enum hrtimer_restart cppi41_recheck_tx_req(struct hrtimer *timer)
 		}
 	}
 
+	/*
+	 * The TX interrupt normally beats us to it, so back off each time
+	 * round rather than polling at a fixed short interval.
+	 */
 	if (!list_empty(&controller->early_tx_list) &&
 	    !hrtimer_is_queued(&controller->early_tx)) {
 		ret = HRTIMER_RESTART;
+		controller->tx_poll_us = min_t(unsigned int,
+				controller->tx_poll_us * 2,
+				CPPI41_TX_POLL_MAX_US);
 		hrtimer_forward_now(&controller->early_tx,
-				ktime_set(0, 20 * NSEC_PER_USEC));
+				ktime_set(0, controller->tx_poll_us *
+					NSEC_PER_USEC));
 	}
 
 	spin_unlock_irqrestore(&musb->lock, flags);
@@ -246,8 +282,12 @@ static void cppi41_dma_callback(void *private_data)
 
 	update_rx_toggle(cppi41_channel);
 
+	/*
+	 * A short (or zero length) packet ends the transfer early, both for
+	 * a single packet and for a generic RNDIS multi-packet descriptor.
+	 */
 	if (cppi41_channel->transferred == cppi41_channel->total_len ||
-			transferred < cppi41_channel->packet_sz)
+			transferred < cppi41_channel->prog_len)
 		cppi41_channel->prog_len = 0;
 
 	if (cppi41_channel->is_tx)
@@ -265,8 +305,11 @@ static void cppi41_dma_callback(void *private_data)
 	 * receive a FIFO empty interrupt so the only thing we can do is
 	 * to poll for the bit. On HS it usually takes 2us, on FS around
 	 * 110us - 150us depending on the transfer size.
-	 * We spin on HS (no longer than than 25us and setup a timer on
-	 * FS to check for the bit and complete the transfer.
+	 * We spin on HS (no longer than than 25us) and otherwise leave
+	 * the channel on early_tx_list: the TX endpoint interrupt raised
+	 * when the last packet leaves the FIFO completes it through
+	 * cppi41_dma_channel_tx_irq().  A timer that backs off from the
+	 * wire time of one packet covers a missed interrupt.
 	 */
 	controller = cppi41_channel->controller;
 
@@ -295,10 +338,19 @@ static void cppi41_dma_callback(void *private_data)
 	list_add_tail(&cppi41_channel->tx_check,
 			&controller->early_tx_list);
 	if (!hrtimer_is_queued(&controller->early_tx)) {
-		unsigned long usecs = cppi41_channel->total_len / 10;
+		unsigned int usecs;
+
+		/* 60 bytes/us at high speed, 1.5 bytes/us at full speed */
+		if (is_hs)
+			usecs = DIV_ROUND_UP(cppi41_channel->packet_sz, 60);
+		else
+			usecs = DIV_ROUND_UP(cppi41_channel->packet_sz * 2, 3);
+		controller->tx_poll_us = max_t(unsigned int, usecs,
+				CPPI41_TX_POLL_MIN_US);
 
 		hrtimer_start_range_ns(&controller->early_tx,
-				ktime_set(0, usecs * NSEC_PER_USEC),
+				ktime_set(0, controller->tx_poll_us *
+					NSEC_PER_USEC),
 				20 * NSEC_PER_USEC,
 				HRTIMER_MODE_REL);
 	}
@@ -363,6 +415,33 @@ static void cppi41_set_autoreq_mode(struct cppi41_dma_channel *cppi41_channel,
 	musb_writel(controller->musb->ctrl_base, USB_CTRL_AUTOREQ, new_mode);
 }
 
+/*
+ * AM335x Advisory 1.0.13 only bites when more than one endpoint is
+ * receiving, so a host bulk IN transfer may use generic RNDIS mode with
+ * auto-request as long as no other RX channel is busy.
+ */
+static bool cppi41_rx_multipkt_ok(struct cppi41_dma_channel *cppi41_channel)
+{
+	struct cppi41_dma_controller *controller = cppi41_channel->controller;
+	struct musb_qh *qh = cppi41_channel->hw_ep->in_qh;
+	int i;
+
+	if (!host_rx_multipkt || !is_host_active(controller->musb))
+		return false;
+	if (!qh || qh->type != USB_ENDPOINT_XFER_BULK || qh->hb_mult > 1)
+		return false;
+
+	for (i = 0; i < MUSB_DMA_NUM_CHANNELS; i++) {
+		struct cppi41_dma_channel *other = &controller->rx_channel[i];
+
+		if (other == cppi41_channel || !other->is_allocated)
+			continue;
+		if (other->channel.status == MUSB_DMA_STATUS_BUSY)
+			return false;
+	}
+	return true;
+}
+
 static bool cppi41_configure_channel(struct dma_channel *channel,
 				u16 packet_sz, u8 mode,
 				dma_addr_t dma_addr, u32 len)
@@ -385,13 +464,21 @@ static bool cppi41_configure_channel(struct dma_channel *channel,
 	cppi41_channel->transferred = 0;
 	cppi41_channel->packet_sz = packet_sz;
 	cppi41_channel->tx_zlp = (cppi41_channel->is_tx && mode) ? 1 : 0;
+	cppi41_channel->rx_gen_rndis = 0;
 
 	/*
 	 * Due to AM335x' Advisory 1.0.13 we are not allowed to transfer more
-	 * than max packet size at a time.
+	 * than max packet size at a time, unless this is the only endpoint
+	 * receiving.  A multi-packet RX covers whole packets only, so that a
+	 * full packet can never overrun the buffer; the tail, if any, is
+	 * reloaded one packet at a time from cppi41_trans_done().
 	 */
-	if (cppi41_channel->is_tx)
+	if (cppi41_channel->is_tx) {
+		use_gen_rndis = 1;
+	} else if (len > packet_sz && cppi41_rx_multipkt_ok(cppi41_channel)) {
+		len = rounddown(len, packet_sz);
 		use_gen_rndis = 1;
+	}
 
 	if (use_gen_rndis) {
 		/* RNDIS mode */
@@ -405,6 +492,7 @@ static bool cppi41_configure_channel(struct dma_channel *channel,
 			/* auto req */
 			cppi41_set_autoreq_mode(cppi41_channel,
 					EP_MODE_AUTOREQ_ALL_NEOP);
+			cppi41_channel->rx_gen_rndis = !cppi41_channel->is_tx;
 		} else {
 			musb_writel(musb->ctrl_base,
 					RNDIS_REG(cppi41_channel->port_num), 0);
@@ -525,6 +613,28 @@ static int cppi41_is_compatible(struct dma_channel *channel, u16 maxpacket,
 	return 0;
 }
 
+/*
+ * A TX endpoint interrupt while the channel is still busy: if the DMA
+ * part of the transfer has already completed and we were only waiting
+ * for the FIFO to drain, this is the interrupt for its last packet.
+ * Called with musb->lock held.
+ */
+static void cppi41_dma_channel_tx_irq(struct dma_channel *channel)
+{
+	struct cppi41_dma_channel *cppi41_channel = channel->private_data;
+	struct cppi41_dma_controller *controller = cppi41_channel->controller;
+
+	if (list_empty(&cppi41_channel->tx_check))
+		return;
+	if (!musb_is_tx_fifo_empty(cppi41_channel->hw_ep))
+		return;
+
+	list_del_init(&cppi41_channel->tx_check);
+	if (list_empty(&controller->early_tx_list))
+		hrtimer_try_to_cancel(&controller->early_tx);
+	cppi41_trans_done(cppi41_channel);
+}
+
 static int cppi41_dma_channel_abort(struct dma_channel *channel)
 {
 	struct cppi41_dma_channel *cppi41_channel = channel->private_data;
@@ -550,6 +660,13 @@ static int cppi41_dma_channel_abort(struct dma_channel *channel)
 		musb_writew(epio, MUSB_TXCSR, csr);
 	} else {
 		cppi41_set_autoreq_mode(cppi41_channel, EP_MODE_AUTOREQ_NONE);
+		if (cppi41_channel->rx_gen_rndis) {
+			musb_writel(musb->ctrl_base,
+				RNDIS_REG(cppi41_channel->port_num), 0);
+			cppi41_set_dma_mode(cppi41_channel,
+					EP_MODE_DMA_TRANSPARENT);
+			cppi41_channel->rx_gen_rndis = 0;
+		}
 
 		csr = musb_readw(epio, MUSB_RXCSR);
 		csr &= ~(MUSB_RXCSR_H_REQPKT | MUSB_RXCSR_DMAENAB);
@@ -713,6 +830,7 @@ struct dma_controller *dma_controller_create(struct musb *musb,
 	controller->controller.channel_program = cppi41_dma_channel_program;
 	controller->controller.channel_abort = cppi41_dma_channel_abort;
 	controller->controller.is_compatible = cppi41_is_compatible;
+	controller->controller.channel_tx_irq = cppi41_dma_channel_tx_irq;
 
 	ret = cppi41_dma_controller_start(controller);
 	if (ret)
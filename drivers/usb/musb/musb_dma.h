@@ -156,6 +156,8 @@ dma_channel_status(struct dma_channel *c)
  * @channel_release: call this to release a DMA channel
  * @channel_abort: call this to abort a pending DMA transaction,
  *	returning it to FREE (but allocated) state
+ * @channel_tx_irq: optional; called for a TX endpoint interrupt that
+ *	arrives while the channel is still BUSY
  *
  * Controllers manage dma channels.
  */
@@ -171,6 +173,7 @@ struct dma_controller {
 	int			(*is_compatible)(struct dma_channel *channel,
 							u16 maxpacket,
 							void *buf, u32 length);
+	void			(*channel_tx_irq)(struct dma_channel *channel);
 };
 
 /* called after channel_program(), may indicate a fault */
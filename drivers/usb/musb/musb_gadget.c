@@ -484,6 +484,8 @@ void musb_g_tx(struct musb *musb, u8 epnum)
 		 * changing SENDSTALL (and other cases); harmless?
 		 */
 		dev_dbg(musb->controller, "%s dma still busy?\n", musb_ep->end_point.name);
+		if (musb->dma_controller->channel_tx_irq)
+			musb->dma_controller->channel_tx_irq(dma);
 		return;
 	}
 
@@ -1321,6 +1321,8 @@ done:
 	/* second cppi case */
 	if (dma_channel_status(dma) == MUSB_DMA_STATUS_BUSY) {
 		dev_dbg(musb->controller, "extra TX%d ready, csr %04x\n", epnum, tx_csr);
+		if (musb->dma_controller->channel_tx_irq)
+			musb->dma_controller->channel_tx_irq(dma);
 		return;
 	}
 
@@ -0,0 +1,359 @@
+/*
+ * w1-pru - 1-Wire bus master with the slot timing done by a PRU core
+ *
+ * The PRU firmware owns the bus pin and generates the reset, presence and
+ * read/write slots itself, so the ARM side only sends whole transactions
+ * (a reset, a block of bytes, a search triplet) over rpmsg and sleeps
+ * until the answer comes back.  No interrupts are disabled and no time is
+ * spent in udelay() for the bit timing.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ */
+
+#include <linux/completion.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/rpmsg.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include "../w1.h"
+#include "../w1_int.h"
+
+/*
+ * Messages exchanged with the firmware.  Every request gets exactly one
+ * reply carrying the same op and seq.
+ *
+ * W1_PRU_RESET		reset pulse, reply arg: 0 device present, 1 none
+ * W1_PRU_TOUCH_BIT	one slot with bit arg, reply arg: the bit read
+ * W1_PRU_WRITE		write len bytes of data, LSB first; if pullup_ms is
+ *			set, drive the line high for that long afterwards
+ * W1_PRU_READ		read len bytes, reply data: the bytes read
+ * W1_PRU_TRIPLET	search triplet with direction arg, reply arg: the
+ *			triplet result as for w1_bus_master.triplet
+ *
+ * status is 0 when the firmware carried out the request, and non zero
+ * for a malformed request or a bus stuck low.
+ */
+enum w1_pru_op {
+	W1_PRU_RESET = 1,
+	W1_PRU_TOUCH_BIT,
+	W1_PRU_WRITE,
+	W1_PRU_READ,
+	W1_PRU_TRIPLET,
+};
+
+struct w1_pru_msg {
+	u8	op;
+	u8	seq;
+	u8	arg;
+	u8	status;
+	__le16	len;
+	__le16	pullup_ms;
+	u8	data[0];
+} __packed;
+
+/* fits an rpmsg buffer with room to spare */
+#define W1_PRU_MAX_DATA		256
+#define W1_PRU_MSG_SIZE		(sizeof(struct w1_pru_msg) + W1_PRU_MAX_DATA)
+
+/* a byte takes about 0.6 ms on the wire, allow for twice that */
+#define W1_PRU_TIMEOUT_MS(len, pullup)	(50 + 2 * (len) + (pullup))
+
+struct w1_pru {
+	struct rpmsg_channel	*rpdev;
+	struct w1_bus_master	bus_master;
+
+	/* one request at a time, the w1 core holds the bus mutex anyway */
+	struct mutex		lock;
+	struct completion	done;
+	spinlock_t		reply_lock;
+	u8			seq;
+	bool			waiting;
+	u16			pullup_ms;
+
+	/* reply of the request in flight */
+	u8			reply_arg;
+	u8			reply_status;
+	int			reply_len;
+	u8			*reply_buf;
+	int			reply_max;
+
+	/* request buffer */
+	u8			msg[W1_PRU_MSG_SIZE];
+};
+
+static int w1_pru_xfer(struct w1_pru *w1p, u8 op, u8 arg, const u8 *out,
+		       int len, u16 pullup_ms, u8 *in, u8 *reply_arg)
+{
+	struct w1_pru_msg *msg = (struct w1_pru_msg *)w1p->msg;
+	unsigned long timeout;
+	unsigned long flags;
+	int size = sizeof(*msg);
+	int ret;
+
+	mutex_lock(&w1p->lock);
+
+	msg->op = op;
+	msg->seq = ++w1p->seq;
+	msg->arg = arg;
+	msg->status = 0;
+	msg->len = cpu_to_le16(len);
+	msg->pullup_ms = cpu_to_le16(pullup_ms);
+	if (out) {
+		memcpy(msg->data, out, len);
+		size += len;
+	}
+
+	spin_lock_irqsave(&w1p->reply_lock, flags);
+	w1p->reply_buf = in;
+	w1p->reply_max = in ? len : 0;
+	w1p->reply_len = -1;
+	w1p->waiting = true;
+	reinit_completion(&w1p->done);
+	spin_unlock_irqrestore(&w1p->reply_lock, flags);
+
+	ret = rpmsg_send(w1p->rpdev, msg, size);
+	if (ret) {
+		dev_err(&w1p->rpdev->dev, "rpmsg_send failed: %d\n", ret);
+		goto out;
+	}
+
+	timeout = msecs_to_jiffies(W1_PRU_TIMEOUT_MS(len, pullup_ms));
+	if (!wait_for_completion_timeout(&w1p->done, timeout)) {
+		dev_err(&w1p->rpdev->dev, "op %u timed out\n", op);
+		ret = -ETIMEDOUT;
+		goto out;
+	}
+
+	if (w1p->reply_status) {
+		dev_dbg(&w1p->rpdev->dev, "op %u failed: %u\n", op,
+			w1p->reply_status);
+		ret = -EIO;
+	} else if (in && w1p->reply_len != len) {
+		ret = -EIO;
+	} else if (reply_arg) {
+		*reply_arg = w1p->reply_arg;
+	}
+
+out:
+	spin_lock_irqsave(&w1p->reply_lock, flags);
+	w1p->waiting = false;
+	spin_unlock_irqrestore(&w1p->reply_lock, flags);
+
+	mutex_unlock(&w1p->lock);
+
+	return ret;
+}
+
+static void w1_pru_cb(struct rpmsg_channel *rpdev, void *data, int len,
+		      void *priv, u32 src)
+{
+	struct w1_pru *w1p = dev_get_drvdata(&rpdev->dev);
+	struct w1_pru_msg *msg = data;
+	unsigned long flags;
+	int dlen;
+
+	if (len < sizeof(*msg)) {
+		dev_err_ratelimited(&rpdev->dev, "short message\n");
+		return;
+	}
+	dlen = min_t(int, le16_to_cpu(msg->len), len - sizeof(*msg));
+
+	spin_lock_irqsave(&w1p->reply_lock, flags);
+	/* late reply to a request that already timed out */
+	if (!w1p->waiting || msg->seq != w1p->seq) {
+		spin_unlock_irqrestore(&w1p->reply_lock, flags);
+		return;
+	}
+
+	w1p->reply_arg = msg->arg;
+	w1p->reply_status = msg->status;
+	if (w1p->reply_buf) {
+		w1p->reply_len = min(dlen, w1p->reply_max);
+		memcpy(w1p->reply_buf, msg->data, w1p->reply_len);
+	}
+	w1p->waiting = false;
+	complete(&w1p->done);
+	spin_unlock_irqrestore(&w1p->reply_lock, flags);
+}
+
+static u8 w1_pru_reset_bus(void *data)
+{
+	struct w1_pru *w1p = data;
+	u8 presence;
+
+	if (w1_pru_xfer(w1p, W1_PRU_RESET, 0, NULL, 0, 0, NULL, &presence))
+		return 1;
+
+	return presence;
+}
+
+static u8 w1_pru_touch_bit(void *data, u8 bit)
+{
+	struct w1_pru *w1p = data;
+	u8 val;
+
+	/* an idle bus reads as ones */
+	if (w1_pru_xfer(w1p, W1_PRU_TOUCH_BIT, bit, NULL, 0, 0, NULL, &val))
+		return 1;
+
+	return val & 1;
+}
+
+static u8 w1_pru_triplet(void *data, u8 bdir)
+{
+	struct w1_pru *w1p = data;
+	u8 val;
+
+	/* id and comp_id both set: no device answered */
+	if (w1_pru_xfer(w1p, W1_PRU_TRIPLET, bdir, NULL, 0, 0, NULL, &val))
+		return 0x3;
+
+	return val;
+}
+
+static void w1_pru_write_block(void *data, const u8 *buf, int len)
+{
+	struct w1_pru *w1p = data;
+
+	while (len > 0) {
+		int n = min(len, W1_PRU_MAX_DATA);
+		/* the strong pullup follows the last byte only */
+		u16 pullup = n == len ? w1p->pullup_ms : 0;
+
+		if (w1_pru_xfer(w1p, W1_PRU_WRITE, 0, buf, n, pullup,
+				NULL, NULL))
+			break;
+		buf += n;
+		len -= n;
+	}
+	w1p->pullup_ms = 0;
+}
+
+static void w1_pru_write_byte(void *data, u8 byte)
+{
+	w1_pru_write_block(data, &byte, 1);
+}
+
+static u8 w1_pru_read_block(void *data, u8 *buf, int len)
+{
+	struct w1_pru *w1p = data;
+	int done = 0;
+
+	while (done < len) {
+		int n = min(len - done, W1_PRU_MAX_DATA);
+
+		if (w1_pru_xfer(w1p, W1_PRU_READ, 0, NULL, n, 0,
+				buf + done, NULL))
+			break;
+		done += n;
+	}
+
+	return done;
+}
+
+static u8 w1_pru_read_byte(void *data)
+{
+	u8 byte;
+
+	if (w1_pru_read_block(data, &byte, 1) != 1)
+		return 0xff;
+
+	return byte;
+}
+
+/*
+ * Called with the duration before a write that wants a strong pullup and
+ * with 0 after it.  The firmware holds the line high itself at the end of
+ * the write, the 0 call has nothing left to do.
+ */
+static u8 w1_pru_set_pullup(void *data, int delay)
+{
+	struct w1_pru *w1p = data;
+
+	if (delay)
+		w1p->pullup_ms = min(delay, 0xffff);
+
+	return 0;
+}
+
+static int w1_pru_probe(struct rpmsg_channel *rpdev)
+{
+	struct w1_pru *w1p;
+	int err;
+
+	w1p = devm_kzalloc(&rpdev->dev, sizeof(*w1p), GFP_KERNEL);
+	if (!w1p)
+		return -ENOMEM;
+
+	w1p->rpdev = rpdev;
+	mutex_init(&w1p->lock);
+	init_completion(&w1p->done);
+	spin_lock_init(&w1p->reply_lock);
+
+	w1p->bus_master.data = w1p;
+	w1p->bus_master.reset_bus = w1_pru_reset_bus;
+	w1p->bus_master.touch_bit = w1_pru_touch_bit;
+	w1p->bus_master.read_byte = w1_pru_read_byte;
+	w1p->bus_master.write_byte = w1_pru_write_byte;
+	w1p->bus_master.read_block = w1_pru_read_block;
+	w1p->bus_master.write_block = w1_pru_write_block;
+	w1p->bus_master.triplet = w1_pru_triplet;
+	w1p->bus_master.set_pullup = w1_pru_set_pullup;
+
+	dev_set_drvdata(&rpdev->dev, w1p);
+
+	err = w1_add_master_device(&w1p->bus_master);
+	if (err) {
+		dev_err(&rpdev->dev, "w1_add_master device failed\n");
+		return err;
+	}
+
+	dev_info(&rpdev->dev, "1-Wire master on PRU channel 0x%x\n",
+		 rpdev->dst);
+
+	return 0;
+}
+
+static void w1_pru_remove(struct rpmsg_channel *rpdev)
+{
+	struct w1_pru *w1p = dev_get_drvdata(&rpdev->dev);
+
+	w1_remove_master_device(&w1p->bus_master);
+}
+
+static const struct rpmsg_device_id w1_pru_id_table[] = {
+	{ .name	= "w1-pru" },
+	{ },
+};
+MODULE_DEVICE_TABLE(rpmsg, w1_pru_id_table);
+
+static struct rpmsg_driver w1_pru_driver = {
+	.drv.name	= KBUILD_MODNAME,
+	.drv.owner	= THIS_MODULE,
+	.id_table	= w1_pru_id_table,
+	.probe		= w1_pru_probe,
+	.callback	= w1_pru_cb,
+	.remove		= w1_pru_remove,
+};
+
+static int __init w1_pru_init(void)
+{
+	return register_rpmsg_driver(&w1_pru_driver);
+}
+
+static void __exit w1_pru_exit(void)
+{
+	unregister_rpmsg_driver(&w1_pru_driver);
+}
+
+module_init(w1_pru_init);
+module_exit(w1_pru_exit);
+
+MODULE_DESCRIPTION("PRU timed 1-Wire bus master");
+MODULE_LICENSE("GPL");
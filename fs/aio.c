@@ -40,6 +40,8 @@
 #include <linux/ramfs.h>
 #include <linux/percpu-refcount.h>
 #include <linux/mount.h>
+#include <linux/moduleparam.h>
+#include <linux/pagemap.h>
 
 #include <asm/kmap_types.h>
 #include <asm/uaccess.h>
@@ -186,6 +188,12 @@ struct aio_kiocb {
 	 * this is the underlying eventfd context to deliver events to.
 	 */
 	struct eventfd_ctx	*ki_eventfd;
+
+	/* buffered read handed to aio_read_wq, see aio_punt_read() */
+	struct work_struct	ki_work;
+	struct iov_iter		ki_iter;
+	struct iovec		*ki_iovec;
+	struct mm_struct	*ki_mm;
 };
 
 /*------ sysctl variables----*/
@@ -194,6 +202,18 @@ unsigned long aio_nr;		/* current system wide number of aio requests */
 unsigned long aio_max_nr = 0x10000; /* system wide maximum number of aio requests */
 /*----end sysctl variables---*/
 
+/*
+ * Buffered reads that miss the page cache would block io_submit() in
+ * ->read_iter, so they run on a small pool of workers instead.  The
+ * number of workers bounds the reads in flight; 0 keeps them inline.
+ */
+static unsigned int aio_read_workers = 8;
+module_param_named(read_workers, aio_read_workers, uint, 0444);
+MODULE_PARM_DESC(read_workers,
+		 "Workers servicing uncached buffered AIO reads (0: read in io_submit)");
+
+static struct workqueue_struct *aio_read_wq;
+
 static struct kmem_cache	*kiocb_cachep;
 static struct kmem_cache	*kioctx_cachep;
 
@@ -260,6 +280,13 @@ static int __init aio_setup(void)
 	kiocb_cachep = KMEM_CACHE(aio_kiocb, SLAB_HWCACHE_ALIGN|SLAB_PANIC);
 	kioctx_cachep = KMEM_CACHE(kioctx,SLAB_HWCACHE_ALIGN|SLAB_PANIC);
 
+	if (aio_read_workers) {
+		aio_read_wq = alloc_workqueue("aio_read", WQ_UNBOUND,
+					      aio_read_workers);
+		if (!aio_read_wq)
+			pr_warn("aio: buffered reads will block io_submit\n");
+	}
+
 	pr_debug("sizeof(struct page) = %zu\n", sizeof(struct page));
 
 	return 0;
@@ -1387,6 +1414,99 @@ static int aio_setup_vectored_rw(int rw, char __user *buf, size_t len,
 				len, UIO_FASTIOV, iovec, iter);
 }
 
+static void aio_complete_rw(struct kiocb *req, ssize_t ret)
+{
+	/*
+	 * There's no easy way to restart the syscall since other AIO's
+	 * may be already running. Just fail this IO with EINTR.
+	 */
+	if (unlikely(ret == -ERESTARTSYS || ret == -ERESTARTNOINTR ||
+		     ret == -ERESTARTNOHAND ||
+		     ret == -ERESTART_RESTARTBLOCK))
+		ret = -EINTR;
+	aio_complete(req, ret, 0);
+}
+
+/* Don't look up more pages than this, a read that long is punted anyway */
+#define AIO_CACHED_CHECK_PAGES	16
+
+static bool aio_read_cached(struct file *file, loff_t pos, size_t count)
+{
+	pgoff_t index, last;
+
+	if (!count)
+		return true;
+
+	index = pos >> PAGE_CACHE_SHIFT;
+	last = (pos + count - 1) >> PAGE_CACHE_SHIFT;
+	if (last - index >= AIO_CACHED_CHECK_PAGES)
+		return false;
+
+	for (; index <= last; index++) {
+		struct page *page = find_get_page(file->f_mapping, index);
+		bool uptodate = page && PageUptodate(page);
+
+		if (page)
+			page_cache_release(page);
+		if (!uptodate)
+			return false;
+	}
+
+	return true;
+}
+
+static void aio_read_work(struct work_struct *work)
+{
+	struct aio_kiocb *iocb = container_of(work, struct aio_kiocb, ki_work);
+	struct kiocb *req = &iocb->common;
+	struct mm_struct *mm = iocb->ki_mm;
+	ssize_t ret;
+
+	use_mm(mm);
+	ret = req->ki_filp->f_op->read_iter(req, &iocb->ki_iter);
+	unuse_mm(mm);
+	mmput(mm);
+	kfree(iocb->ki_iovec);
+
+	if (ret != -EIOCBQUEUED)
+		aio_complete_rw(req, ret);
+}
+
+/*
+ * Hand a buffered read of a regular file that isn't fully cached to
+ * aio_read_wq.  The worker reads into the submitter's address space, so
+ * that stays pinned, and the iovec must outlive the caller's stack.
+ * Returns false if the read should be done inline.
+ */
+static bool aio_punt_read(struct kiocb *req, struct iov_iter *iter,
+			  struct iovec *iovec)
+{
+	struct aio_kiocb *iocb = container_of(req, struct aio_kiocb, common);
+	struct file *file = req->ki_filp;
+
+	if (!aio_read_wq || (req->ki_flags & IOCB_DIRECT) ||
+	    !S_ISREG(file_inode(file)->i_mode) ||
+	    aio_read_cached(file, req->ki_pos, iov_iter_count(iter)))
+		return false;
+
+	if (!iovec) {
+		iovec = kmemdup(iter->iov, iter->nr_segs * sizeof(*iovec),
+				GFP_KERNEL);
+		if (!iovec)
+			return false;
+		iter->iov = iovec;
+	}
+
+	iocb->ki_iter = *iter;
+	iocb->ki_iovec = iovec;
+	iocb->ki_mm = current->mm;
+	atomic_inc(&current->mm->mm_users);
+
+	INIT_WORK(&iocb->ki_work, aio_read_work);
+	queue_work(aio_read_wq, &iocb->ki_work);
+	return true;
+}
+
 /*
  * aio_run_iocb:
  *	Performs the initial checks and io submission.
@@ -1440,6 +1560,9 @@ rw_common:
 
 		len = ret;
 
+		if (rw == READ && aio_punt_read(req, &iter, iovec))
+			return 0;
+
 		if (rw == WRITE)
 			file_start_write(file);
 
@@ -1469,17 +1592,8 @@ rw_common:
 		return -EINVAL;
 	}
 
-	if (ret != -EIOCBQUEUED) {
-		/*
-		 * There's no easy way to restart the syscall since other AIO's
-		 * may be already running. Just fail this IO with EINTR.
-		 */
-		if (unlikely(ret == -ERESTARTSYS || ret == -ERESTARTNOINTR ||
-			     ret == -ERESTARTNOHAND ||
-			     ret == -ERESTART_RESTARTBLOCK))
-			ret = -EINTR;
-		aio_complete(req, ret, 0);
-	}
+	if (ret != -EIOCBQUEUED)
+		aio_complete_rw(req, ret);
 
 	return 0;
 }
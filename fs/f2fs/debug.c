@@ -65,6 +65,17 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->dirty_sits = SIT_I(sbi)->dirty_sentries;
 	si->fnids = NM_I(sbi)->fcnt;
 	si->bg_gc = sbi->bg_gc;
+	if (SM_I(sbi)->dcc_info) {
+		struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+		spin_lock(&dcc->lock);
+		si->discard_pending = dcc->nr_pending;
+		si->discard_pending_blks = dcc->pending_blocks;
+		si->discard_merged = dcc->merged_ranges;
+		si->discard_cmds = dcc->issued_cmds;
+		si->discard_blks = dcc->issued_blocks;
+		spin_unlock(&dcc->lock);
+	}
 	si->util_free = (int)(free_user_blocks(sbi) >> sbi->log_blocks_per_seg)
 		* 100 / (int)(sbi->user_block_count >> sbi->log_blocks_per_seg)
 		/ 2;
@@ -178,6 +189,13 @@ get_cache:
 	if (SM_I(sbi)->cmd_control_info)
 		si->cache_mem += sizeof(struct flush_cmd_control);
 
+	/* build discard thread */
+	if (SM_I(sbi)->dcc_info) {
+		si->cache_mem += sizeof(struct discard_cmd_control);
+		si->cache_mem += SM_I(sbi)->dcc_info->nr_pending *
+					sizeof(struct discard_entry);
+	}
+
 	/* free nids */
 	si->cache_mem += NM_I(sbi)->fcnt * sizeof(struct free_nid);
 	si->cache_mem += NM_I(sbi)->nat_cnt * sizeof(struct nat_entry);
@@ -279,6 +297,11 @@ static int stat_show(struct seq_file *s, void *v)
 			   si->hit_ext, si->total_ext);
 		seq_printf(s, "\nExtent Tree Count: %d\n", si->ext_tree);
 		seq_printf(s, "\nExtent Node Count: %d\n", si->ext_node);
+		seq_printf(s, "\nDiscard: %u ranges, %llu blocks queued\n",
+			   si->discard_pending, si->discard_pending_blks);
+		seq_printf(s, "  - issued: %llu cmds, %llu blocks, "
+			   "merged: %llu\n", si->discard_cmds,
+			   si->discard_blks, si->discard_merged);
 		seq_puts(s, "\nBalancing F2FS Async:\n");
 		seq_printf(s, "  - inmem: %4d, wb: %4d\n",
 			   si->inmem_pages, si->wb_pages);
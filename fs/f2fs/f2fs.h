@@ -491,6 +491,22 @@ struct flush_cmd_control {
 	struct llist_node *dispatch_list;	/* list for command dispatch */
 };
 
+/* for the background discard thread */
+struct discard_cmd_control {
+	struct task_struct *f2fs_issue_discard;	/* discard thread */
+	struct list_head discard_cmd_list;	/* queued ranges by blkaddr */
+	spinlock_t lock;			/* protects the list and stats */
+	struct mutex issue_lock;		/* held while issuing a range */
+	wait_queue_head_t discard_wait_queue;	/* waiting for ranges */
+	block_t issue_blkaddr;			/* start of range in flight */
+	int issue_len;				/* length of range in flight */
+	unsigned int nr_pending;		/* # of queued ranges */
+	unsigned long long pending_blocks;	/* # of queued blocks */
+	unsigned long long merged_ranges;	/* # of ranges merged */
+	unsigned long long issued_cmds;		/* # of discards issued */
+	unsigned long long issued_blocks;	/* # of blocks discarded */
+};
+
 struct f2fs_sm_info {
 	struct sit_info *sit_info;		/* whole segment information */
 	struct free_segmap_info *free_info;	/* free segment information */
@@ -526,6 +542,9 @@ struct f2fs_sm_info {
 	/* for flush command control */
 	struct flush_cmd_control *cmd_control_info;
 
+	/* for discard command control */
+	struct discard_cmd_control *dcc_info;
+
 };
 
 /*
@@ -645,6 +664,11 @@ struct f2fs_sb_info {
 	int total_ext_tree;			/* extent tree count */
 	atomic_t total_ext_node;		/* extent info count */
 
+	/* for the shrinker */
+	struct list_head s_list;		/* node in the shrinker list */
+	struct mutex umount_mutex;		/* shrinker vs umount */
+	unsigned int shrinker_run_no;		/* last shrinker pass */
+
 	/* basic filesystem units */
 	unsigned int log_sectors_per_block;	/* log2 sectors per block */
 	unsigned int log_blocksize;		/* log2 block size */
@@ -1546,9 +1570,11 @@ void f2fs_balance_fs_bg(struct f2fs_sb_info *);
 int f2fs_issue_flush(struct f2fs_sb_info *);
 int create_flush_cmd_control(struct f2fs_sb_info *);
 void destroy_flush_cmd_control(struct f2fs_sb_info *);
+int create_discard_cmd_control(struct f2fs_sb_info *);
+void destroy_discard_cmd_control(struct f2fs_sb_info *);
 void invalidate_blocks(struct f2fs_sb_info *, block_t);
 void refresh_sit_entry(struct f2fs_sb_info *, block_t, block_t);
-void clear_prefree_segments(struct f2fs_sb_info *);
+void clear_prefree_segments(struct f2fs_sb_info *, struct cp_control *);
 void release_discard_addrs(struct f2fs_sb_info *);
 void discard_next_dnode(struct f2fs_sb_info *, block_t);
 int npages_for_summary_flush(struct f2fs_sb_info *, bool);
@@ -1614,7 +1640,7 @@ void f2fs_submit_page_mbio(struct f2fs_sb_info *, struct page *,
 void set_data_blkaddr(struct dnode_of_data *);
 int reserve_new_block(struct dnode_of_data *);
 int f2fs_reserve_block(struct dnode_of_data *, pgoff_t);
-void f2fs_shrink_extent_tree(struct f2fs_sb_info *, int);
+unsigned int f2fs_shrink_extent_tree(struct f2fs_sb_info *, int);
 void f2fs_destroy_extent_tree(struct inode *);
 void f2fs_init_extent_cache(struct inode *, struct f2fs_extent *);
 void f2fs_update_extent_cache(struct dnode_of_data *);
@@ -1645,6 +1671,15 @@ void build_gc_manager(struct f2fs_sb_info *);
 int recover_fsync_data(struct f2fs_sb_info *);
 bool space_for_roll_forward(struct f2fs_sb_info *);
 
+/*
+ * shrinker.c
+ */
+bool f2fs_extent_cache_over_limit(void);
+void f2fs_join_shrinker(struct f2fs_sb_info *);
+void f2fs_leave_shrinker(struct f2fs_sb_info *);
+int __init f2fs_init_shrinker(void);
+void f2fs_exit_shrinker(void);
+
 /*
  * debug.c
  */
@@ -1665,6 +1700,9 @@ struct f2fs_stat_info {
 	int rsvd_segs, overp_segs;
 	int dirty_count, node_pages, meta_pages;
 	int prefree_count, call_count, cp_count;
+	unsigned int discard_pending;
+	unsigned long long discard_pending_blks, discard_merged;
+	unsigned long long discard_cmds, discard_blks;
 	int tot_segs, node_segs, data_segs, free_segs, free_secs;
 	int bg_node_segs, bg_data_segs;
 	int tot_blks, data_blks, node_blks;
@@ -68,7 +68,8 @@ bool available_free_memory(struct f2fs_sb_info *sbi, int type)
 		mem_size = (sbi->total_ext_tree * sizeof(struct extent_tree) +
 				atomic_read(&sbi->total_ext_node) *
 				sizeof(struct extent_node)) >> PAGE_CACHE_SHIFT;
-		res = mem_size < ((avail_ram * nm_i->ram_thresh / 100) >> 1);
+		res = mem_size < ((avail_ram * nm_i->ram_thresh / 100) >> 1) &&
+				!f2fs_extent_cache_over_limit();
 	} else {
 		if (sbi->sb->s_bdi->dirty_exceeded)
 			return false;
@@ -20,6 +20,7 @@
 #include "f2fs.h"
 #include "segment.h"
 #include "node.h"
+#include "gc.h"
 #include "trace.h"
 #include <trace/events/f2fs.h>
 
@@ -282,7 +283,8 @@ void f2fs_balance_fs(struct f2fs_sb_info *sbi)
 void f2fs_balance_fs_bg(struct f2fs_sb_info *sbi)
 {
 	/* try to shrink extent cache when there is no enough memory */
-	f2fs_shrink_extent_tree(sbi, EXTENT_CACHE_SHRINK_NUMBER);
+	if (!available_free_memory(sbi, EXTENT_CACHE))
+		f2fs_shrink_extent_tree(sbi, EXTENT_CACHE_SHRINK_NUMBER);
 
 	/* check the # of cached NAT entries and prefree segments */
 	if (try_to_free_nats(sbi, NAT_ENTRY_PER_BLOCK) ||
@@ -470,6 +472,232 @@ static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
 	return blkdev_issue_discard(sbi->sb->s_bdev, start, len, GFP_NOFS, 0);
 }
 
+static void __issue_discard_entry(struct f2fs_sb_info *sbi,
+				struct discard_entry *entry)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+
+	spin_lock(&dcc->lock);
+	dcc->issued_cmds++;
+	dcc->issued_blocks += entry->len;
+	spin_unlock(&dcc->lock);
+
+	kmem_cache_free(discard_entry_slab, entry);
+}
+
+static int issue_discard_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	wait_queue_head_t *q = &dcc->discard_wait_queue;
+	struct discard_entry *entry;
+repeat:
+	if (kthread_should_stop())
+		return 0;
+
+	/* foreground I/O goes first unless the queue grows too long */
+	if (!list_empty(&dcc->discard_cmd_list) && !is_idle(sbi) &&
+			dcc->nr_pending < DEF_MAX_DISCARD_PENDING) {
+		wait_event_interruptible_timeout(*q, kthread_should_stop(),
+			msecs_to_jiffies(DEF_DISCARD_IDLE_INTERVAL));
+		goto repeat;
+	}
+
+	mutex_lock(&dcc->issue_lock);
+	spin_lock(&dcc->lock);
+	entry = list_first_entry_or_null(&dcc->discard_cmd_list,
+					struct discard_entry, list);
+	if (entry) {
+		list_del(&entry->list);
+		dcc->nr_pending--;
+		dcc->pending_blocks -= entry->len;
+		dcc->issue_blkaddr = entry->blkaddr;
+		dcc->issue_len = entry->len;
+	}
+	spin_unlock(&dcc->lock);
+
+	if (entry) {
+		__issue_discard_entry(sbi, entry);
+
+		spin_lock(&dcc->lock);
+		dcc->issue_len = 0;
+		spin_unlock(&dcc->lock);
+	}
+	mutex_unlock(&dcc->issue_lock);
+
+	if (entry)
+		goto repeat;
+
+	wait_event_interruptible(*q, kthread_should_stop() ||
+				!list_empty(&dcc->discard_cmd_list));
+	goto repeat;
+}
+
+/*
+ * Queue a range for the discard thread, merging it with the queued ranges
+ * it touches so the device gets few, large discards.
+ */
+static void f2fs_queue_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct list_head *head, *pos;
+	struct discard_entry *new, *entry = NULL, *next;
+	block_t end;
+
+	if (!dcc) {
+		f2fs_issue_discard(sbi, blkstart, blklen);
+		return;
+	}
+
+	new = f2fs_kmem_cache_alloc(discard_entry_slab, GFP_NOFS);
+	head = &dcc->discard_cmd_list;
+
+	spin_lock(&dcc->lock);
+
+	/* ranges mostly come in ascending order, search from the tail */
+	list_for_each_prev(pos, head) {
+		entry = list_entry(pos, struct discard_entry, list);
+		if (entry->blkaddr <= blkstart)
+			break;
+	}
+
+	if (pos != head && entry->blkaddr + entry->len >= blkstart) {
+		end = max(entry->blkaddr + entry->len, blkstart + blklen);
+		dcc->pending_blocks -= entry->len;
+		entry->len = end - entry->blkaddr;
+		dcc->merged_ranges++;
+	} else {
+		entry = new;
+		new = NULL;
+		INIT_LIST_HEAD(&entry->list);
+		entry->blkaddr = blkstart;
+		entry->len = blklen;
+		list_add(&entry->list, pos);
+		dcc->nr_pending++;
+	}
+
+	/* swallow the following ranges the new one reaches */
+	while (entry->list.next != head) {
+		next = list_next_entry(entry, list);
+		if (next->blkaddr > entry->blkaddr + entry->len)
+			break;
+
+		end = max(entry->blkaddr + entry->len,
+				next->blkaddr + next->len);
+		entry->len = end - entry->blkaddr;
+		list_del(&next->list);
+		dcc->nr_pending--;
+		dcc->pending_blocks -= next->len;
+		dcc->merged_ranges++;
+		kmem_cache_free(discard_entry_slab, next);
+	}
+	dcc->pending_blocks += entry->len;
+
+	spin_unlock(&dcc->lock);
+
+	if (new)
+		kmem_cache_free(discard_entry_slab, new);
+
+	wake_up(&dcc->discard_wait_queue);
+}
+
+/*
+ * @segno is about to be written again, so the discards still queued for it
+ * are issued here, and one in flight is waited for, before new data can
+ * reach the device.
+ */
+static void f2fs_wait_discard_segment(struct f2fs_sb_info *sbi,
+					unsigned int segno)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_entry *entry, *this;
+	block_t start, end;
+	LIST_HEAD(issue_list);
+	bool busy;
+
+	if (!dcc)
+		return;
+
+	start = START_BLOCK(sbi, segno);
+	end = start + sbi->blocks_per_seg;
+
+	spin_lock(&dcc->lock);
+	busy = dcc->issue_len && dcc->issue_blkaddr < end &&
+			dcc->issue_blkaddr + dcc->issue_len > start;
+
+	list_for_each_entry_safe(entry, this, &dcc->discard_cmd_list, list) {
+		if (entry->blkaddr >= end)
+			break;
+		if (entry->blkaddr + entry->len <= start)
+			continue;
+
+		list_move_tail(&entry->list, &issue_list);
+		dcc->nr_pending--;
+		dcc->pending_blocks -= entry->len;
+	}
+	spin_unlock(&dcc->lock);
+
+	if (busy) {
+		mutex_lock(&dcc->issue_lock);
+		mutex_unlock(&dcc->issue_lock);
+	}
+
+	list_for_each_entry_safe(entry, this, &issue_list, list) {
+		list_del(&entry->list);
+		__issue_discard_entry(sbi, entry);
+	}
+}
+
+int create_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	dev_t dev = sbi->sb->s_bdev->bd_dev;
+	struct discard_cmd_control *dcc;
+	int err = 0;
+
+	dcc = kzalloc(sizeof(struct discard_cmd_control), GFP_KERNEL);
+	if (!dcc)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&dcc->discard_cmd_list);
+	spin_lock_init(&dcc->lock);
+	mutex_init(&dcc->issue_lock);
+	init_waitqueue_head(&dcc->discard_wait_queue);
+	SM_I(sbi)->dcc_info = dcc;
+	dcc->f2fs_issue_discard = kthread_run(issue_discard_thread, sbi,
+				"f2fs_discard-%u:%u", MAJOR(dev), MINOR(dev));
+	if (IS_ERR(dcc->f2fs_issue_discard)) {
+		err = PTR_ERR(dcc->f2fs_issue_discard);
+		kfree(dcc);
+		SM_I(sbi)->dcc_info = NULL;
+		return err;
+	}
+
+	return err;
+}
+
+void destroy_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_entry *entry, *this;
+
+	if (!dcc)
+		return;
+
+	if (dcc->f2fs_issue_discard)
+		kthread_stop(dcc->f2fs_issue_discard);
+
+	/* the thread is gone, nobody else touches the list */
+	list_for_each_entry_safe(entry, this, &dcc->discard_cmd_list, list) {
+		list_del(&entry->list);
+		__issue_discard_entry(sbi, entry);
+	}
+
+	kfree(dcc);
+	SM_I(sbi)->dcc_info = NULL;
+}
+
 void discard_next_dnode(struct f2fs_sb_info *sbi, block_t blkaddr)
 {
 	if (f2fs_issue_discard(sbi, blkaddr, 1)) {
@@ -589,13 +817,27 @@ static void set_prefree_as_free_segments(struct f2fs_sb_info *sbi)
 	mutex_unlock(&dirty_i->seglist_lock);
 }
 
-void clear_prefree_segments(struct f2fs_sb_info *sbi)
+/* a current segment may be written at any time, it can't wait for discard */
+static bool __discard_in_curseg(struct f2fs_sb_info *sbi,
+				block_t blkaddr, int len)
+{
+	unsigned int segno = GET_SEGNO(sbi, blkaddr);
+	unsigned int end_segno = GET_SEGNO(sbi, blkaddr + len - 1);
+
+	for (; segno <= end_segno; segno++)
+		if (IS_CURSEG(sbi, segno))
+			return true;
+	return false;
+}
+
+void clear_prefree_segments(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 {
 	struct list_head *head = &(SM_I(sbi)->discard_list);
 	struct discard_entry *entry, *this;
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
 	unsigned long *prefree_map = dirty_i->dirty_segmap[PRE];
 	unsigned int start = 0, end = -1;
+	bool force = (cpc->reason == CP_DISCARD);
 
 	mutex_lock(&dirty_i->seglist_lock);
 
@@ -615,14 +857,22 @@ void clear_prefree_segments(struct f2fs_sb_info *sbi)
 		if (!test_opt(sbi, DISCARD))
 			continue;
 
-		f2fs_issue_discard(sbi, START_BLOCK(sbi, start),
+		if (force)
+			f2fs_issue_discard(sbi, START_BLOCK(sbi, start),
+				(end - start) << sbi->log_blocks_per_seg);
+		else
+			f2fs_queue_discard(sbi, START_BLOCK(sbi, start),
 				(end - start) << sbi->log_blocks_per_seg);
 	}
 	mutex_unlock(&dirty_i->seglist_lock);
 
 	/* send small discards */
 	list_for_each_entry_safe(entry, this, head, list) {
-		f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		if (force || __discard_in_curseg(sbi, entry->blkaddr,
+							entry->len))
+			f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		else
+			f2fs_queue_discard(sbi, entry->blkaddr, entry->len);
 		list_del(&entry->list);
 		SM_I(sbi)->nr_discards -= entry->len;
 		kmem_cache_free(discard_entry_slab, entry);
@@ -893,6 +1143,8 @@ static void reset_curseg(struct f2fs_sb_info *sbi, int type, int modified)
 	curseg->next_blkoff = 0;
 	curseg->next_segno = NULL_SEGNO;
 
+	f2fs_wait_discard_segment(sbi, curseg->segno);
+
 	sum_footer = &(curseg->sum_blk->footer);
 	memset(sum_footer, 0, sizeof(struct summary_footer));
 	if (IS_DATASEG(type))
@@ -2153,6 +2405,12 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 			return err;
 	}
 
+	if (test_opt(sbi, DISCARD) && !f2fs_readonly(sbi->sb)) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			return err;
+	}
+
 	err = build_sit_info(sbi);
 	if (err)
 		return err;
@@ -2265,6 +2523,7 @@ void destroy_segment_manager(struct f2fs_sb_info *sbi)
 	if (!sm_info)
 		return;
 	destroy_flush_cmd_control(sbi);
+	destroy_discard_cmd_control(sbi);
 	destroy_dirty_segmap(sbi);
 	destroy_curseg(sbi);
 	destroy_free_segmap(sbi);
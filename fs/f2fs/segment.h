@@ -16,6 +16,10 @@
 
 #define DEF_RECLAIM_PREFREE_SEGMENTS	5	/* 5% over total segments */
 
+/* the discard thread waits for idle unless this many ranges are queued */
+#define DEF_MAX_DISCARD_PENDING		512
+#define DEF_DISCARD_IDLE_INTERVAL	100	/* ms */
+
 /* L: Logical segment # in volume, R: Relative segment # in main area */
 #define GET_L2R_SEGNO(free_i, segno)	(segno - free_i->start_segno)
 #define GET_R2L_SEGNO(free_i, segno)	(segno + free_i->start_segno)
@@ -0,0 +1,142 @@
+/*
+ * fs/f2fs/shrinker.c
+ *
+ * f2fs shrinker support, reclaims the in-memory extent trees of all
+ * mounted filesystems under memory pressure.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/fs.h>
+#include <linux/f2fs_fs.h>
+#include <linux/module.h>
+
+#include "f2fs.h"
+
+static LIST_HEAD(f2fs_list);
+static DEFINE_SPINLOCK(f2fs_list_lock);
+static unsigned int shrinker_run_no;
+
+/* memory of the extent caches of all filesystems together, 0 for no cap */
+static unsigned int extent_cache_max_kb;
+module_param(extent_cache_max_kb, uint, 0644);
+MODULE_PARM_DESC(extent_cache_max_kb,
+		"Cap in KB on the extent cache of all mounted filesystems");
+
+static unsigned long __count_extent_cache(struct f2fs_sb_info *sbi)
+{
+	return atomic_read(&sbi->total_ext_node);
+}
+
+bool f2fs_extent_cache_over_limit(void)
+{
+	struct f2fs_sb_info *sbi;
+	unsigned long mem_size = 0;
+	unsigned int limit = ACCESS_ONCE(extent_cache_max_kb);
+
+	if (!limit)
+		return false;
+
+	spin_lock(&f2fs_list_lock);
+	list_for_each_entry(sbi, &f2fs_list, s_list)
+		mem_size += sbi->total_ext_tree * sizeof(struct extent_tree) +
+				__count_extent_cache(sbi) *
+				sizeof(struct extent_node);
+	spin_unlock(&f2fs_list_lock);
+
+	return (mem_size >> 10) >= limit;
+}
+
+static unsigned long f2fs_shrink_count(struct shrinker *shrink,
+				struct shrink_control *sc)
+{
+	struct f2fs_sb_info *sbi;
+	unsigned long count = 0;
+
+	spin_lock(&f2fs_list_lock);
+	list_for_each_entry(sbi, &f2fs_list, s_list)
+		count += __count_extent_cache(sbi);
+	spin_unlock(&f2fs_list_lock);
+
+	return count;
+}
+
+static unsigned long f2fs_shrink_scan(struct shrinker *shrink,
+				struct shrink_control *sc)
+{
+	unsigned long nr = sc->nr_to_scan;
+	struct f2fs_sb_info *sbi;
+	struct list_head *p;
+	unsigned int run_no;
+	unsigned long freed = 0;
+
+	/* the extent trees are allocated with their locks held */
+	if (!(sc->gfp_mask & __GFP_FS))
+		return SHRINK_STOP;
+
+	spin_lock(&f2fs_list_lock);
+	do {
+		run_no = ++shrinker_run_no;
+	} while (run_no == 0);
+	p = f2fs_list.next;
+	while (p != &f2fs_list) {
+		sbi = list_entry(p, struct f2fs_sb_info, s_list);
+
+		if (sbi->shrinker_run_no == run_no)
+			break;
+
+		/* stop f2fs_put_super */
+		if (!mutex_trylock(&sbi->umount_mutex)) {
+			p = p->next;
+			continue;
+		}
+		spin_unlock(&f2fs_list_lock);
+
+		sbi->shrinker_run_no = run_no;
+		freed += f2fs_shrink_extent_tree(sbi, nr - freed);
+
+		spin_lock(&f2fs_list_lock);
+		p = p->next;
+		list_move_tail(&sbi->s_list, &f2fs_list);
+		mutex_unlock(&sbi->umount_mutex);
+		if (freed >= nr)
+			break;
+	}
+	spin_unlock(&f2fs_list_lock);
+
+	return freed;
+}
+
+static struct shrinker f2fs_shrinker_info = {
+	.scan_objects = f2fs_shrink_scan,
+	.count_objects = f2fs_shrink_count,
+	.seeks = DEFAULT_SEEKS,
+};
+
+void f2fs_join_shrinker(struct f2fs_sb_info *sbi)
+{
+	spin_lock(&f2fs_list_lock);
+	list_add_tail(&sbi->s_list, &f2fs_list);
+	spin_unlock(&f2fs_list_lock);
+}
+
+void f2fs_leave_shrinker(struct f2fs_sb_info *sbi)
+{
+	/* waits for a scan of this filesystem to finish */
+	mutex_lock(&sbi->umount_mutex);
+	spin_lock(&f2fs_list_lock);
+	list_del(&sbi->s_list);
+	spin_unlock(&f2fs_list_lock);
+	mutex_unlock(&sbi->umount_mutex);
+}
+
+int __init f2fs_init_shrinker(void)
+{
+	return register_shrinker(&f2fs_shrinker_info);
+}
+
+void f2fs_exit_shrinker(void)
+{
+	unregister_shrinker(&f2fs_shrinker_info);
+}
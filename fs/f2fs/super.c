@@ -458,6 +458,8 @@ static void f2fs_put_super(struct super_block *sb)
 {
 	struct f2fs_sb_info *sbi = F2FS_SB(sb);
 
+	f2fs_leave_shrinker(sbi);
+
 	if (sbi->s_proc) {
 		remove_proc_entry("segment_info", sbi->s_proc);
 		remove_proc_entry(sb->s_id, f2fs_proc_root);
@@ -719,6 +721,15 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 		if (err)
 			goto restore_gc;
 	}
+
+	/* likewise for the discard thread and the discard option */
+	if ((*flags & MS_RDONLY) || !test_opt(sbi, DISCARD)) {
+		destroy_discard_cmd_control(sbi);
+	} else if (!SM_I(sbi)->dcc_info) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			goto restore_gc;
+	}
 skip:
 	/* Update the POSIXACL Flag */
 	 sb->s_flags = (sb->s_flags & ~MS_POSIXACL) |
@@ -1088,6 +1099,8 @@ try_onemore:
 	spin_lock_init(&sbi->dir_inode_lock);
 
 	init_extent_cache_info(sbi);
+	INIT_LIST_HEAD(&sbi->s_list);
+	mutex_init(&sbi->umount_mutex);
 
 	init_ino_entry_info(sbi);
 
@@ -1197,6 +1210,7 @@ try_onemore:
 		if (err)
 			goto free_kobj;
 	}
+	f2fs_join_shrinker(sbi);
 	kfree(options);
 	return 0;
 
@@ -1305,13 +1319,18 @@ static int __init init_f2fs_fs(void)
 		err = -ENOMEM;
 		goto free_extent_cache;
 	}
-	err = register_filesystem(&f2fs_fs_type);
+	err = f2fs_init_shrinker();
 	if (err)
 		goto free_kset;
+	err = register_filesystem(&f2fs_fs_type);
+	if (err)
+		goto free_shrinker;
 	f2fs_create_root_stats();
 	f2fs_proc_root = proc_mkdir("fs/f2fs", NULL);
 	return 0;
 
+free_shrinker:
+	f2fs_exit_shrinker();
 free_kset:
 	kset_unregister(f2fs_kset);
 free_extent_cache:
@@ -1333,6 +1352,7 @@ static void __exit exit_f2fs_fs(void)
 	remove_proc_entry("fs/f2fs", NULL);
 	f2fs_destroy_root_stats();
 	unregister_filesystem(&f2fs_fs_type);
+	f2fs_exit_shrinker();
 	destroy_extent_cache();
 	destroy_checkpoint_caches();
 	destroy_segment_manager_caches();
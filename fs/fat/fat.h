@@ -5,6 +5,7 @@
 #include <linux/nls.h>
 #include <linux/hash.h>
 #include <linux/ratelimit.h>
+#include <linux/workqueue.h>
 #include <linux/msdos_fs.h>
 
 /*
@@ -78,6 +79,11 @@ struct msdos_sb_info {
 	unsigned int prev_free;      /* previously allocated cluster number */
 	unsigned int free_clusters;  /* -1 if undefined */
 	unsigned int free_clus_valid; /* is free_clusters valid? */
+	unsigned long *free_map;      /* free cluster bitmap, NULL if none */
+	unsigned long free_map_scanned; /* free_map is valid below this */
+	unsigned int free_map_count;  /* free clusters below that */
+	struct work_struct free_map_work; /* fills free_map after mount */
+	struct super_block *free_map_sb;
 	struct fat_mount_options options;
 	struct nls_table *nls_disk;   /* Codepage used on disk */
 	struct nls_table *nls_io;     /* Charset used for input and display */
@@ -353,6 +359,8 @@ extern int fat_alloc_clusters(struct inode *inode, int *cluster,
 			      int nr_cluster);
 extern int fat_free_clusters(struct inode *inode, int cluster);
 extern int fat_count_free_clusters(struct super_block *sb);
+extern void fat_free_map_init(struct super_block *sb);
+extern void fat_free_map_destroy(struct super_block *sb);
 
 /* fat/file.c */
 extern long fat_generic_ioctl(struct file *filp, unsigned int cmd,
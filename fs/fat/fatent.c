@@ -4,6 +4,7 @@
  */
 
 #include <linux/blkdev.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -459,6 +460,52 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+/*
+ * The free cluster bitmap is filled in from the FAT by a work item after
+ * mount, one FAT block per fat_lock hold so that allocations go on
+ * meanwhile.  Alloc and free keep the part already scanned up to date.
+ * Once the whole FAT is scanned it gives free_clusters, and
+ * fat_alloc_clusters() finds free clusters in it instead of reading the
+ * FAT.  All of it is protected by fat_lock.
+ */
+static inline int fat_free_map_ready(struct msdos_sb_info *sbi)
+{
+	return sbi->free_map && sbi->free_map_scanned >= sbi->max_cluster;
+}
+
+static void fat_free_map_set(struct msdos_sb_info *sbi, int entry, int free)
+{
+	if (!sbi->free_map || entry >= sbi->free_map_scanned)
+		return;
+
+	if (free) {
+		if (!__test_and_set_bit(entry, sbi->free_map))
+			sbi->free_map_count++;
+	} else {
+		if (__test_and_clear_bit(entry, sbi->free_map))
+			sbi->free_map_count--;
+	}
+}
+
+/* first free cluster from @entry on, wrapping around; -1 if none */
+static int fat_free_map_next(struct msdos_sb_info *sbi, int entry)
+{
+	unsigned long bit;
+
+	if (entry >= sbi->max_cluster)
+		entry = FAT_START_ENT;
+
+	bit = find_next_bit(sbi->free_map, sbi->max_cluster, entry);
+	if (bit < sbi->max_cluster)
+		return bit;
+
+	bit = find_next_bit(sbi->free_map, entry, FAT_START_ENT);
+	if (bit < entry)
+		return bit;
+
+	return -1;
+}
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -481,6 +528,42 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	count = FAT_START_ENT;
 	fatent_init(&prev_ent);
 	fatent_init(&fatent);
+
+	if (fat_free_map_ready(sbi)) {
+		while (idx_clus < nr_cluster) {
+			int entry = fat_free_map_next(sbi, sbi->prev_free + 1);
+
+			if (entry < 0)
+				goto nospc;
+
+			err = fat_ent_read(inode, &fatent, entry);
+			if (err < 0)
+				goto out;
+			fat_free_map_set(sbi, entry, 0);
+			if (err != FAT_ENT_FREE) {
+				/* only a corrupted map gets here */
+				err = 0;
+				continue;
+			}
+			err = 0;
+
+			ops->ent_put(&fatent, FAT_ENT_EOF);
+			if (prev_ent.nr_bhs)
+				ops->ent_put(&prev_ent, entry);
+
+			fat_collect_bhs(bhs, &nr_bhs, &fatent);
+
+			sbi->prev_free = entry;
+			if (sbi->free_clusters != -1)
+				sbi->free_clusters--;
+
+			cluster[idx_clus] = entry;
+			idx_clus++;
+			prev_ent = fatent;
+		}
+		goto out;
+	}
+
 	fatent_set_entry(&fatent, sbi->prev_free + 1);
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
@@ -501,6 +584,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 					ops->ent_put(&prev_ent, entry);
 
 				fat_collect_bhs(bhs, &nr_bhs, &fatent);
+				fat_free_map_set(sbi, entry, 0);
 
 				sbi->prev_free = entry;
 				if (sbi->free_clusters != -1)
@@ -523,6 +607,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 		} while (fat_ent_next(sbi, &fatent));
 	}
 
+nospc:
 	/* Couldn't allocate the free entries */
 	sbi->free_clusters = 0;
 	sbi->free_clus_valid = 1;
@@ -591,6 +676,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		fat_free_map_set(sbi, fatent.entry, 1);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			dirty_fsinfo = 1;
@@ -654,6 +740,10 @@ int fat_count_free_clusters(struct super_block *sb)
 	unsigned long reada_blocks, reada_mask, cur_block;
 	int err = 0, free;
 
+	/* the map scan counts them anyway, no point in a second pass */
+	if (sbi->free_map)
+		flush_work(&sbi->free_map_work);
+
 	lock_fat(sbi);
 	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
 		goto out;
@@ -690,3 +780,101 @@ out:
 	unlock_fat(sbi);
 	return err;
 }
+
+static void fat_free_map_fill(struct work_struct *work)
+{
+	struct msdos_sb_info *sbi =
+		container_of(work, struct msdos_sb_info, free_map_work);
+	struct super_block *sb = sbi->free_map_sb;
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks, reada_mask, cur_block;
+	unsigned long *map;
+	int err;
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+	reada_mask = reada_blocks - 1;
+	cur_block = 0;
+
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, FAT_START_ENT);
+	while (fatent.entry < sbi->max_cluster) {
+		if ((cur_block & reada_mask) == 0) {
+			unsigned long rest = sbi->fat_length - cur_block;
+			fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+		}
+		cur_block++;
+
+		lock_fat(sbi);
+		/* unmounting */
+		if (!sbi->free_map) {
+			unlock_fat(sbi);
+			break;
+		}
+
+		err = fat_ent_read_block(sb, &fatent);
+		if (err) {
+			map = sbi->free_map;
+			sbi->free_map = NULL;
+			unlock_fat(sbi);
+			vfree(map);
+			fat_msg(sb, KERN_WARNING,
+				"can't read FAT, no free cluster map (%d)",
+				err);
+			break;
+		}
+
+		do {
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE) {
+				__set_bit(fatent.entry, sbi->free_map);
+				sbi->free_map_count++;
+			}
+		} while (fat_ent_next(sbi, &fatent));
+		sbi->free_map_scanned = fatent.entry;
+
+		if (fat_free_map_ready(sbi)) {
+			sbi->free_clusters = sbi->free_map_count;
+			sbi->free_clus_valid = 1;
+			mark_fsinfo_dirty(sb);
+		}
+		unlock_fat(sbi);
+
+		cond_resched();
+	}
+	fatent_brelse(&fatent);
+}
+
+/*
+ * Start filling the free cluster map in the background.  Without the
+ * memory for it the filesystem works as before, only slower.
+ */
+void fat_free_map_init(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	INIT_WORK(&sbi->free_map_work, fat_free_map_fill);
+	sbi->free_map = vzalloc(BITS_TO_LONGS(sbi->max_cluster) *
+				sizeof(unsigned long));
+	if (!sbi->free_map)
+		return;
+
+	sbi->free_map_sb = sb;
+	sbi->free_map_scanned = FAT_START_ENT;
+	sbi->free_map_count = 0;
+	queue_work(system_long_wq, &sbi->free_map_work);
+}
+
+void fat_free_map_destroy(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	unsigned long *map;
+
+	lock_fat(sbi);
+	map = sbi->free_map;
+	sbi->free_map = NULL;
+	unlock_fat(sbi);
+
+	/* the fill work sees the NULL map and stops at the next block */
+	cancel_work_sync(&sbi->free_map_work);
+	vfree(map);
+}
@@ -627,6 +627,7 @@ static void fat_put_super(struct super_block *sb)
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
 
 	fat_set_state(sb, 0, 0);
+	fat_free_map_destroy(sb);
 
 	iput(sbi->fsinfo_inode);
 	iput(sbi->fat_inode);
@@ -1750,6 +1751,7 @@ int fat_fill_super(struct super_block *sb, void *data, int silent, int isvfat,
 	}
 
 	fat_set_state(sb, 1, 0);
+	fat_free_map_init(sb);
 	return 0;
 
 out_invalid:
@@ -650,6 +650,9 @@ static long writeback_chunk_size(struct backing_dev_info *bdi,
 		pages = min(pages, work->nr_pages);
 		pages = round_down(pages + MIN_WRITEBACK_PAGES,
 				   MIN_WRITEBACK_PAGES);
+		/* flash that wants whole erase blocks gets whole ones */
+		if (bdi->erase_pages)
+			pages = roundup(pages, bdi->erase_pages);
 	}
 
 	return pages;
@@ -459,24 +459,8 @@ static int jffs2_scan_eraseblock (struct jffs2_sb_info *c, struct jffs2_eraseblo
 	jffs2_dbg(1, "%s(): Scanning block at 0x%x\n", __func__, ofs);
 
 #ifdef CONFIG_JFFS2_FS_WRITEBUFFER
-	if (jffs2_cleanmarker_oob(c)) {
-		int ret;
-
-		if (mtd_block_isbad(c->mtd, jeb->offset))
-			return BLK_STATE_BADBLOCK;
-
-		ret = jffs2_check_nand_cleanmarker(c, jeb);
-		jffs2_dbg(2, "jffs_check_nand_cleanmarker returned %d\n", ret);
-
-		/* Even if it's not found, we still scan to see
-		   if the block is empty. We use this information
-		   to decide whether to erase it or not. */
-		switch (ret) {
-		case 0:		cleanmarkerfound = 1; break;
-		case 1: 	break;
-		default: 	return ret;
-		}
-	}
+	if (jffs2_cleanmarker_oob(c) && mtd_block_isbad(c->mtd, jeb->offset))
+		return BLK_STATE_BADBLOCK;
 #endif
 
 	if (jffs2_sum_active()) {
@@ -549,6 +533,26 @@ static int jffs2_scan_eraseblock (struct jffs2_sb_info *c, struct jffs2_eraseblo
 	}
 
 full_scan:
+#ifdef CONFIG_JFFS2_FS_WRITEBUFFER
+	/* Only needed without a summary, which saves an OOB read
+	   per block at mount time */
+	if (jffs2_cleanmarker_oob(c)) {
+		int ret;
+
+		ret = jffs2_check_nand_cleanmarker(c, jeb);
+		jffs2_dbg(2, "jffs_check_nand_cleanmarker returned %d\n", ret);
+
+		/* Even if it's not found, we still scan to see
+		   if the block is empty. We use this information
+		   to decide whether to erase it or not. */
+		switch (ret) {
+		case 0:		cleanmarkerfound = 1; break;
+		case 1: 	break;
+		default: 	return ret;
+		}
+	}
+#endif
+
 	buf_ofs = jeb->offset;
 
 	if (!buf_size) {
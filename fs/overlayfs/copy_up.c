@@ -196,7 +196,7 @@ int ovl_set_attr(struct dentry *upperdentry, struct kstat *stat)
 static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 			      struct dentry *dentry, struct path *lowerpath,
 			      struct kstat *stat, struct iattr *attr,
-			      const char *link)
+			      const char *link, bool metacopy)
 {
 	struct inode *wdir = workdir->d_inode;
 	struct inode *udir = upperdir->d_inode;
@@ -223,7 +223,7 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out2;
 
-	if (S_ISREG(stat->mode)) {
+	if (S_ISREG(stat->mode) && !metacopy) {
 		struct path upperpath;
 		ovl_path_upper(dentry, &upperpath);
 		BUG_ON(upperpath.dentry != NULL);
@@ -238,8 +238,23 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out_cleanup;
 
+	if (metacopy) {
+		err = ovl_do_setxattr(newdentry, OVL_XATTR_METACOPY, "y", 1, 0);
+		if (err)
+			goto out_cleanup;
+	}
+
 	mutex_lock(&newdentry->d_inode->i_mutex);
-	err = ovl_set_attr(newdentry, stat);
+	if (metacopy) {
+		/* a sparse file of the right size, the data stays below */
+		struct iattr sattr = {
+			.ia_valid = ATTR_SIZE,
+			.ia_size = stat->size,
+		};
+		err = notify_change(newdentry, &sattr, NULL);
+	}
+	if (!err)
+		err = ovl_set_attr(newdentry, stat);
 	if (!err && attr)
 		err = notify_change(newdentry, attr, NULL);
 	mutex_unlock(&newdentry->d_inode->i_mutex);
@@ -250,6 +265,8 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out_cleanup;
 
+	if (metacopy)
+		ovl_dentry_set_metacopy(dentry, true);
 	ovl_dentry_update(dentry, newdentry);
 	newdentry = NULL;
 
@@ -298,6 +315,7 @@ int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 	const struct cred *old_cred;
 	struct cred *override_cred;
 	char *link = NULL;
+	bool metacopy;
 
 	if (WARN_ON(!workdir))
 		return -EROFS;
@@ -356,8 +374,15 @@ int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 		goto out_put_cred;
 	}
 
+	/*
+	 * A change of attributes other than the size doesn't need the data,
+	 * leave it in the lower layer until the file is opened for write.
+	 */
+	metacopy = S_ISREG(stat->mode) && attr &&
+		   !(attr->ia_valid & ATTR_SIZE) && ovl_metacopy_enabled(dentry);
+
 	err = ovl_copy_up_locked(workdir, upperdir, dentry, lowerpath,
-				 stat, attr, link);
+				 stat, attr, link, metacopy);
 	if (!err) {
 		/* Restore timestamps on parent (best effort) */
 		ovl_set_timestamps(upperdir, &pstat);
@@ -414,3 +439,106 @@ int ovl_copy_up(struct dentry *dentry)
 
 	return err;
 }
+
+/*
+ * Copy the data of a metacopy upper from the lower file, or just drop it
+ * when @no_data is set because the file is about to be truncated.
+ */
+static int ovl_copy_up_meta_data(struct dentry *dentry, bool no_data)
+{
+	struct dentry *workdir = ovl_workdir(dentry);
+	struct dentry *parent, *upperdir, *upperdentry;
+	struct path lowerpath, upperpath;
+	const struct cred *old_cred;
+	struct cred *override_cred;
+	struct kstat stat;
+	int err;
+
+	if (WARN_ON(!workdir))
+		return -EROFS;
+
+	err = -ENOMEM;
+	override_cred = prepare_creds();
+	if (!override_cred)
+		return err;
+
+	/*
+	 * CAP_SYS_ADMIN for removing the metacopy xattr
+	 * CAP_DAC_OVERRIDE for writing the data
+	 * CAP_FOWNER for restoring the timestamps
+	 * CAP_FSETID for keeping the suid/sgid bits while writing
+	 */
+	cap_raise(override_cred->cap_effective, CAP_SYS_ADMIN);
+	cap_raise(override_cred->cap_effective, CAP_DAC_OVERRIDE);
+	cap_raise(override_cred->cap_effective, CAP_FOWNER);
+	cap_raise(override_cred->cap_effective, CAP_FSETID);
+	old_cred = override_creds(override_cred);
+
+	/* same exclusion against other copy ups as ovl_copy_up_one() */
+	parent = dget_parent(dentry);
+	upperdir = ovl_dentry_upper(parent);
+	err = -EIO;
+	if (lock_rename(workdir, upperdir) != NULL) {
+		pr_err("overlayfs: failed to lock workdir+upperdir\n");
+		goto out_unlock;
+	}
+
+	err = 0;
+	if (!ovl_dentry_is_metacopy(dentry))
+		goto out_unlock;
+
+	ovl_path_upper(dentry, &upperpath);
+	upperdentry = upperpath.dentry;
+	err = vfs_getattr(&upperpath, &stat);
+	if (err)
+		goto out_unlock;
+
+	if (no_data) {
+		struct iattr attr = {
+			.ia_valid = ATTR_SIZE,
+			.ia_size = 0,
+		};
+
+		mutex_lock(&upperdentry->d_inode->i_mutex);
+		err = notify_change(upperdentry, &attr, NULL);
+		mutex_unlock(&upperdentry->d_inode->i_mutex);
+	} else {
+		ovl_path_lower(dentry, &lowerpath);
+		err = ovl_copy_up_data(&lowerpath, &upperpath, stat.size);
+	}
+	if (err)
+		goto out_unlock;
+
+	err = ovl_do_removexattr(upperdentry, OVL_XATTR_METACOPY);
+	if (err)
+		goto out_unlock;
+
+	mutex_lock(&upperdentry->d_inode->i_mutex);
+	ovl_set_timestamps(upperdentry, &stat);
+	mutex_unlock(&upperdentry->d_inode->i_mutex);
+
+	ovl_dentry_set_metacopy(dentry, false);
+out_unlock:
+	unlock_rename(workdir, upperdir);
+	dput(parent);
+	revert_creds(old_cred);
+	put_cred(override_cred);
+
+	return err;
+}
+
+/*
+ * Like ovl_copy_up(), but also brings the data of a metacopy upper into the
+ * upper layer.  Needed before writing, and before link and rename which
+ * would lose track of the lower file.
+ */
+int ovl_copy_up_with_data(struct dentry *dentry, bool no_data)
+{
+	int err;
+
+	err = ovl_copy_up(dentry);
+	if (!err && ovl_dentry_is_metacopy(dentry))
+		err = ovl_copy_up_meta_data(dentry, no_data);
+
+	return err;
+}
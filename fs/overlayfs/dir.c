@@ -488,7 +488,7 @@ static int ovl_link(struct dentry *old, struct inode *newdir,
 	if (err)
 		goto out;
 
-	err = ovl_copy_up(old);
+	err = ovl_copy_up_with_data(old, false);
 	if (err)
 		goto out_drop_write;
 
@@ -773,7 +773,7 @@ static int ovl_rename2(struct inode *olddir, struct dentry *old,
 	if (err)
 		goto out;
 
-	err = ovl_copy_up(old);
+	err = ovl_copy_up_with_data(old, false);
 	if (err)
 		goto out_drop_write;
 
@@ -781,7 +781,7 @@ static int ovl_rename2(struct inode *olddir, struct dentry *old,
 	if (err)
 		goto out_drop_write;
 	if (!overwrite) {
-		err = ovl_copy_up(new);
+		err = ovl_copy_up_with_data(new, false);
 		if (err)
 			goto out_drop_write;
 	}
@@ -51,12 +51,19 @@ int ovl_setattr(struct dentry *dentry, struct iattr *attr)
 
 	upperdentry = ovl_dentry_upper(dentry);
 	if (upperdentry) {
+		/* resizing a metacopy file needs its data first */
+		if (attr->ia_valid & ATTR_SIZE) {
+			err = ovl_copy_up_with_data(dentry, !attr->ia_size);
+			if (err)
+				goto out_drop_write;
+		}
 		mutex_lock(&upperdentry->d_inode->i_mutex);
 		err = notify_change(upperdentry, attr, NULL);
 		mutex_unlock(&upperdentry->d_inode->i_mutex);
 	} else {
 		err = ovl_copy_up_last(dentry, attr, false);
 	}
+out_drop_write:
 	ovl_drop_write(dentry);
 out:
 	return err;
@@ -66,9 +73,20 @@ static int ovl_getattr(struct vfsmount *mnt, struct dentry *dentry,
 			 struct kstat *stat)
 {
 	struct path realpath;
+	struct kstat lowerstat;
+	int err;
 
 	ovl_path_real(dentry, &realpath);
-	return vfs_getattr(&realpath, stat);
+	err = vfs_getattr(&realpath, stat);
+	if (err || !ovl_dentry_is_metacopy(dentry))
+		return err;
+
+	/* the sparse upper of a metacopy file has no blocks of its own */
+	ovl_path_lower(dentry, &realpath);
+	if (!vfs_getattr(&realpath, &lowerstat))
+		stat->blocks = lowerstat.blocks;
+
+	return 0;
 }
 
 int ovl_permission(struct inode *inode, int mask)
@@ -239,7 +257,8 @@ static bool ovl_need_xattr_filter(struct dentry *dentry,
 				  enum ovl_path_type type)
 {
 	if ((type & (__OVL_PATH_PURE | __OVL_PATH_UPPER)) == __OVL_PATH_UPPER)
-		return S_ISDIR(dentry->d_inode->i_mode);
+		return S_ISDIR(dentry->d_inode->i_mode) ||
+		       ovl_dentry_is_metacopy(dentry);
 	else
 		return false;
 }
@@ -322,9 +341,9 @@ out:
 }
 
 static bool ovl_open_need_copy_up(int flags, enum ovl_path_type type,
-				  struct dentry *realdentry)
+				  struct dentry *realdentry, bool metacopy)
 {
-	if (OVL_TYPE_UPPER(type))
+	if (OVL_TYPE_UPPER(type) && !metacopy)
 		return false;
 
 	if (special_file(realdentry->d_inode->i_mode))
@@ -341,17 +360,26 @@ struct inode *ovl_d_select_inode(struct dentry *dentry, unsigned file_flags)
 	int err;
 	struct path realpath;
 	enum ovl_path_type type;
+	bool metacopy;
 
 	if (d_is_dir(dentry))
 		return d_backing_inode(dentry);
 
 	type = ovl_path_real(dentry, &realpath);
-	if (ovl_open_need_copy_up(file_flags, type, realpath.dentry)) {
+	metacopy = ovl_dentry_is_metacopy(dentry);
+	if (metacopy)
+		ovl_path_lower(dentry, &realpath);
+
+	if (ovl_open_need_copy_up(file_flags, type, realpath.dentry,
+				  metacopy)) {
 		err = ovl_want_write(dentry);
 		if (err)
 			return ERR_PTR(err);
 
-		if (file_flags & O_TRUNC)
+		if (metacopy)
+			err = ovl_copy_up_with_data(dentry,
+						    file_flags & O_TRUNC);
+		else if (file_flags & O_TRUNC)
 			err = ovl_copy_up_last(dentry, NULL, true);
 		else
 			err = ovl_copy_up(dentry);
@@ -30,6 +30,7 @@ struct ovl_config {
 	char *lowerdir;
 	char *upperdir;
 	char *workdir;
+	bool metacopy;
 };
 
 /* private information held for overlayfs's superblock */
@@ -53,6 +54,7 @@ struct ovl_entry {
 		struct {
 			u64 version;
 			bool opaque;
+			bool metacopy;
 		};
 		struct rcu_head rcu;
 	};
@@ -205,6 +207,33 @@ void ovl_dentry_set_opaque(struct dentry *dentry, bool opaque)
 	oe->opaque = opaque;
 }
 
+bool ovl_metacopy_enabled(struct dentry *dentry)
+{
+	struct ovl_fs *ofs = dentry->d_sb->s_fs_info;
+	return ofs->config.metacopy;
+}
+
+/*
+ * A metacopy upper carries the attributes while the data is still read from
+ * the lower file.  The flag is set before the upper dentry is published by
+ * ovl_dentry_update(), the barrier pairs with the smp_wmb() there.
+ */
+bool ovl_dentry_is_metacopy(struct dentry *dentry)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+
+	smp_rmb();
+	return oe->metacopy;
+}
+
+void ovl_dentry_set_metacopy(struct dentry *dentry, bool metacopy)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+
+	smp_wmb();
+	oe->metacopy = metacopy;
+}
+
 void ovl_dentry_update(struct dentry *dentry, struct dentry *upperdentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -259,6 +288,22 @@ static bool ovl_is_opaquedir(struct dentry *dentry)
 	return false;
 }
 
+static bool ovl_is_metacopy(struct dentry *dentry)
+{
+	int res;
+	char val;
+	struct inode *inode = dentry->d_inode;
+
+	if (!S_ISREG(inode->i_mode) || !inode->i_op->getxattr)
+		return false;
+
+	res = inode->i_op->getxattr(dentry, OVL_XATTR_METACOPY, &val, 1);
+	if (res == 1 && val == 'y')
+		return true;
+
+	return false;
+}
+
 static void ovl_dentry_release(struct dentry *dentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -339,6 +384,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	unsigned int ctr = 0;
 	struct inode *inode = NULL;
 	bool upperopaque = false;
+	bool metacopy = false;
 	struct dentry *this, *prev = NULL;
 	unsigned int i;
 	int err;
@@ -357,6 +403,8 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 				upperopaque = true;
 			} else if (poe->numlower && ovl_is_opaquedir(this)) {
 				upperopaque = true;
+			} else if (poe->numlower && ovl_is_metacopy(this)) {
+				metacopy = true;
 			}
 		}
 		upperdentry = prev = this;
@@ -396,6 +444,15 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 		if (i < poe->numlower - 1 && ovl_is_opaquedir(this))
 			opaque = true;
 
+		/* The data of a metacopy upper comes from this file */
+		if (metacopy && S_ISREG(this->d_inode->i_mode)) {
+			stack[ctr].dentry = this;
+			stack[ctr].mnt = lowerpath.mnt;
+			ctr++;
+			upperopaque = true;
+			break;
+		}
+
 		if (prev && (!S_ISDIR(prev->d_inode->i_mode) ||
 			     !S_ISDIR(this->d_inode->i_mode))) {
 			/*
@@ -421,6 +478,13 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 			break;
 	}
 
+	err = -EIO;
+	if (metacopy && !ctr) {
+		pr_warn_ratelimited("overlayfs: no lower data for metacopy %pd2\n",
+				    upperdentry);
+		goto out_put;
+	}
+
 	oe = ovl_alloc_entry(ctr);
 	err = -ENOMEM;
 	if (!oe)
@@ -440,6 +504,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	}
 
 	oe->opaque = upperopaque;
+	oe->metacopy = ctr && metacopy;
 	oe->__upperdentry = upperdentry;
 	memcpy(oe->lowerstack, stack, sizeof(struct path) * ctr);
 	kfree(stack);
@@ -522,6 +587,8 @@ static int ovl_show_options(struct seq_file *m, struct dentry *dentry)
 	if (ufs->config.upperdir) {
 		seq_show_option(m, "upperdir", ufs->config.upperdir);
 		seq_show_option(m, "workdir", ufs->config.workdir);
+		if (ufs->config.metacopy)
+			seq_puts(m, ",metacopy");
 	}
 	return 0;
 }
@@ -547,6 +614,7 @@ enum {
 	OPT_LOWERDIR,
 	OPT_UPPERDIR,
 	OPT_WORKDIR,
+	OPT_METACOPY,
 	OPT_ERR,
 };
 
@@ -554,6 +622,7 @@ static const match_table_t ovl_tokens = {
 	{OPT_LOWERDIR,			"lowerdir=%s"},
 	{OPT_UPPERDIR,			"upperdir=%s"},
 	{OPT_WORKDIR,			"workdir=%s"},
+	{OPT_METACOPY,			"metacopy"},
 	{OPT_ERR,			NULL}
 };
 
@@ -614,6 +683,10 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 				return -ENOMEM;
 			break;
 
+		case OPT_METACOPY:
+			config->metacopy = true;
+			break;
+
 		default:
 			pr_err("overlayfs: unrecognized mount option \"%s\" or missing value\n", p);
 			return -EINVAL;
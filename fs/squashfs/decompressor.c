@@ -25,6 +25,8 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/buffer_head.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -132,6 +134,17 @@ out:
 }
 
 
+void squashfs_stream_stats_show(struct seq_file *m, int n,
+	struct squashfs_stream_stats *stats)
+{
+	seq_printf(m, "stream %d: decompressions %llu wait_us %llu "
+		"max_wait_us %llu busy_us %llu\n", n, stats->decompressions,
+		div_u64(stats->wait_ns, 1000),
+		div_u64(stats->max_wait_ns, 1000),
+		div_u64(stats->busy_ns, 1000));
+}
+
+
 void *squashfs_decompressor_setup(struct super_block *sb, unsigned short flags)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
@@ -140,7 +153,7 @@ void *squashfs_decompressor_setup(struct super_block *sb, unsigned short flags)
 	if (IS_ERR(comp_opts))
 		return comp_opts;
 
-	stream = squashfs_decompressor_create(msblk, comp_opts);
+	stream = msblk->thread_ops->create(msblk, comp_opts);
 	if (IS_ERR(stream))
 		kfree(comp_opts);
 
@@ -23,6 +23,8 @@
  * decompressor.h
  */
 
+struct seq_file;
+
 struct squashfs_decompressor {
 	void	*(*init)(struct squashfs_sb_info *, void *);
 	void	*(*comp_opts)(struct squashfs_sb_info *, void *, int);
@@ -35,6 +37,61 @@ struct squashfs_decompressor {
 	int	supported;
 };
 
+/*
+ * Threading model of the decompressor, how concurrent readers share the
+ * decompressor streams of a filesystem.
+ */
+struct squashfs_decompressor_thread_ops {
+	void	*(*create)(struct squashfs_sb_info *, void *);
+	int	(*decompress)(struct squashfs_sb_info *, struct buffer_head **,
+		int, int, int, struct squashfs_page_actor *);
+	void	(*destroy)(struct squashfs_sb_info *);
+	int	(*max_decompressors)(void);
+	void	(*show_stats)(struct seq_file *, struct squashfs_sb_info *);
+	char	*name;
+};
+
+/* Use of one decompressor stream, updated by the reader owning it */
+struct squashfs_stream_stats {
+	u64	decompressions;
+	u64	wait_ns;	/* waiting for the stream */
+	u64	max_wait_ns;
+	u64	busy_ns;	/* decompressing */
+};
+
+static inline void squashfs_stream_stats_add(
+	struct squashfs_stream_stats *stats, u64 start, u64 acquired, u64 done)
+{
+	u64 wait = acquired - start;
+
+	stats->decompressions++;
+	stats->wait_ns += wait;
+	if (wait > stats->max_wait_ns)
+		stats->max_wait_ns = wait;
+	stats->busy_ns += done - acquired;
+}
+
+extern void squashfs_stream_stats_show(struct seq_file *, int,
+	struct squashfs_stream_stats *);
+
+#if defined(CONFIG_SQUASHFS_DECOMP_SINGLE) || \
+	defined(CONFIG_SQUASHFS_DECOMP_BY_MOUNT)
+extern const struct squashfs_decompressor_thread_ops
+	squashfs_decompressor_single;
+#endif
+
+#if defined(CONFIG_SQUASHFS_DECOMP_MULTI) || \
+	defined(CONFIG_SQUASHFS_DECOMP_BY_MOUNT)
+extern const struct squashfs_decompressor_thread_ops
+	squashfs_decompressor_multi;
+#endif
+
+#if defined(CONFIG_SQUASHFS_DECOMP_MULTI_PERCPU) || \
+	defined(CONFIG_SQUASHFS_DECOMP_BY_MOUNT)
+extern const struct squashfs_decompressor_thread_ops
+	squashfs_decompressor_percpu;
+#endif
+
 static inline void *squashfs_comp_opts(struct squashfs_sb_info *msblk,
 							void *buff, int length)
 {
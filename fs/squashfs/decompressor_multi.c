@@ -12,6 +12,8 @@
 #include <linux/sched.h>
 #include <linux/wait.h>
 #include <linux/cpumask.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -31,7 +33,7 @@
 #define MAX_DECOMPRESSOR	(num_online_cpus() * 2)
 
 
-int squashfs_max_decompressors(void)
+static int squashfs_max_decompressors(void)
 {
 	return MAX_DECOMPRESSOR;
 }
@@ -40,6 +42,7 @@ int squashfs_max_decompressors(void)
 struct squashfs_stream {
 	void			*comp_opts;
 	struct list_head	strm_list;
+	struct list_head	all_list;
 	struct mutex		mutex;
 	int			avail_decomp;
 	wait_queue_head_t	wait;
@@ -49,19 +52,25 @@ struct squashfs_stream {
 struct decomp_stream {
 	void *stream;
 	struct list_head list;
+	struct list_head all;
+	struct squashfs_stream_stats stats;
 };
 
 
 static void put_decomp_stream(struct decomp_stream *decomp_strm,
-				struct squashfs_stream *stream)
+				struct squashfs_stream *stream,
+				u64 start, u64 acquired)
 {
+	u64 done = ktime_get_ns();
+
 	mutex_lock(&stream->mutex);
+	squashfs_stream_stats_add(&decomp_strm->stats, start, acquired, done);
 	list_add(&decomp_strm->list, &stream->strm_list);
 	mutex_unlock(&stream->mutex);
 	wake_up(&stream->wait);
 }
 
-void *squashfs_decompressor_create(struct squashfs_sb_info *msblk,
+static void *squashfs_decompressor_create(struct squashfs_sb_info *msblk,
 				void *comp_opts)
 {
 	struct squashfs_stream *stream;
@@ -75,6 +84,7 @@ void *squashfs_decompressor_create(struct squashfs_sb_info *msblk,
 	stream->comp_opts = comp_opts;
 	mutex_init(&stream->mutex);
 	INIT_LIST_HEAD(&stream->strm_list);
+	INIT_LIST_HEAD(&stream->all_list);
 	init_waitqueue_head(&stream->wait);
 
 	/*
@@ -83,7 +93,7 @@ void *squashfs_decompressor_create(struct squashfs_sb_info *msblk,
 	 * we could always fall back to default decompressor and
 	 * file system works.
 	 */
-	decomp_strm = kmalloc(sizeof(*decomp_strm), GFP_KERNEL);
+	decomp_strm = kzalloc(sizeof(*decomp_strm), GFP_KERNEL);
 	if (!decomp_strm)
 		goto out;
 
@@ -95,6 +105,7 @@ void *squashfs_decompressor_create(struct squashfs_sb_info *msblk,
 	}
 
 	list_add(&decomp_strm->list, &stream->strm_list);
+	list_add_tail(&decomp_strm->all, &stream->all_list);
 	stream->avail_decomp = 1;
 	return stream;
 
@@ -105,7 +116,7 @@ out:
 }
 
 
-void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
+static void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
 {
 	struct squashfs_stream *stream = msblk->stream;
 	if (stream) {
@@ -115,6 +126,7 @@ void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
 			decomp_strm = list_entry(stream->strm_list.prev,
 						struct decomp_stream, list);
 			list_del(&decomp_strm->list);
+			list_del(&decomp_strm->all);
 			msblk->decompressor->free(decomp_strm->stream);
 			kfree(decomp_strm);
 			stream->avail_decomp--;
@@ -151,7 +163,7 @@ static struct decomp_stream *get_decomp_stream(struct squashfs_sb_info *msblk,
 			goto wait;
 
 		/* Let's allocate new decomp */
-		decomp_strm = kmalloc(sizeof(*decomp_strm), GFP_KERNEL);
+		decomp_strm = kzalloc(sizeof(*decomp_strm), GFP_KERNEL);
 		if (!decomp_strm)
 			goto wait;
 
@@ -162,6 +174,7 @@ static struct decomp_stream *get_decomp_stream(struct squashfs_sb_info *msblk,
 			goto wait;
 		}
 
+		list_add_tail(&decomp_strm->all, &stream->all_list);
 		stream->avail_decomp++;
 		WARN_ON(stream->avail_decomp > MAX_DECOMPRESSOR);
 
@@ -182,17 +195,45 @@ wait:
 }
 
 
-int squashfs_decompress(struct squashfs_sb_info *msblk, struct buffer_head **bh,
-	int b, int offset, int length, struct squashfs_page_actor *output)
+static int squashfs_decompress(struct squashfs_sb_info *msblk,
+	struct buffer_head **bh, int b, int offset, int length,
+	struct squashfs_page_actor *output)
 {
 	int res;
 	struct squashfs_stream *stream = msblk->stream;
+	u64 start = ktime_get_ns(), acquired;
 	struct decomp_stream *decomp_stream = get_decomp_stream(msblk, stream);
+
+	acquired = ktime_get_ns();
 	res = msblk->decompressor->decompress(msblk, decomp_stream->stream,
 		bh, b, offset, length, output);
-	put_decomp_stream(decomp_stream, stream);
+	put_decomp_stream(decomp_stream, stream, start, acquired);
 	if (res < 0)
 		ERROR("%s decompression failed, data probably corrupt\n",
 			msblk->decompressor->name);
 	return res;
 }
+
+
+static void squashfs_decompressor_stats(struct seq_file *m,
+	struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *stream = msblk->stream;
+	struct decomp_stream *decomp_strm;
+	int n = 0;
+
+	mutex_lock(&stream->mutex);
+	list_for_each_entry(decomp_strm, &stream->all_list, all)
+		squashfs_stream_stats_show(m, n++, &decomp_strm->stats);
+	mutex_unlock(&stream->mutex);
+}
+
+
+const struct squashfs_decompressor_thread_ops squashfs_decompressor_multi = {
+	.create = squashfs_decompressor_create,
+	.decompress = squashfs_decompress,
+	.destroy = squashfs_decompressor_destroy,
+	.max_decompressors = squashfs_max_decompressors,
+	.show_stats = squashfs_decompressor_stats,
+	.name = "multi"
+};
@@ -10,6 +10,8 @@
 #include <linux/slab.h>
 #include <linux/percpu.h>
 #include <linux/buffer_head.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -23,15 +25,17 @@
 
 struct squashfs_stream {
 	void		*stream;
+	struct squashfs_stream_stats stats;
 };
 
-void *squashfs_decompressor_create(struct squashfs_sb_info *msblk,
+static void *squashfs_decompressor_create(struct squashfs_sb_info *msblk,
 						void *comp_opts)
 {
 	struct squashfs_stream *stream;
 	struct squashfs_stream __percpu *percpu;
 	int err, cpu;
 
+	/* alloc_percpu() hands out zeroed memory, stats included */
 	percpu = alloc_percpu(struct squashfs_stream);
 	if (percpu == NULL)
 		return ERR_PTR(-ENOMEM);
@@ -58,7 +62,7 @@ out:
 	return ERR_PTR(err);
 }
 
-void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
+static void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
 {
 	struct squashfs_stream __percpu *percpu =
 			(struct squashfs_stream __percpu *) msblk->stream;
@@ -74,14 +78,19 @@ void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
 	}
 }
 
-int squashfs_decompress(struct squashfs_sb_info *msblk, struct buffer_head **bh,
-	int b, int offset, int length, struct squashfs_page_actor *output)
+static int squashfs_decompress(struct squashfs_sb_info *msblk,
+	struct buffer_head **bh, int b, int offset, int length,
+	struct squashfs_page_actor *output)
 {
 	struct squashfs_stream __percpu *percpu =
 			(struct squashfs_stream __percpu *) msblk->stream;
+	u64 start = ktime_get_ns();
 	struct squashfs_stream *stream = get_cpu_ptr(percpu);
+	u64 acquired = ktime_get_ns();
 	int res = msblk->decompressor->decompress(msblk, stream->stream, bh, b,
 		offset, length, output);
+	squashfs_stream_stats_add(&stream->stats, start, acquired,
+		ktime_get_ns());
 	put_cpu_ptr(stream);
 
 	if (res < 0)
@@ -91,7 +100,31 @@ int squashfs_decompress(struct squashfs_sb_info *msblk, struct buffer_head **bh,
 	return res;
 }
 
-int squashfs_max_decompressors(void)
+static int squashfs_max_decompressors(void)
 {
 	return num_possible_cpus();
 }
+
+/* Remote counters are read unlocked, a snapshot may be slightly torn */
+static void squashfs_decompressor_stats(struct seq_file *m,
+	struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream __percpu *percpu =
+			(struct squashfs_stream __percpu *) msblk->stream;
+	struct squashfs_stream_stats stats;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		stats = per_cpu_ptr(percpu, cpu)->stats;
+		squashfs_stream_stats_show(m, cpu, &stats);
+	}
+}
+
+const struct squashfs_decompressor_thread_ops squashfs_decompressor_percpu = {
+	.create = squashfs_decompressor_create,
+	.decompress = squashfs_decompress,
+	.destroy = squashfs_decompressor_destroy,
+	.max_decompressors = squashfs_max_decompressors,
+	.show_stats = squashfs_decompressor_stats,
+	.name = "percpu"
+};
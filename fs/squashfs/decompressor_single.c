@@ -10,6 +10,8 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/buffer_head.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -24,9 +26,10 @@
 struct squashfs_stream {
 	void		*stream;
 	struct mutex	mutex;
+	struct squashfs_stream_stats stats;
 };
 
-void *squashfs_decompressor_create(struct squashfs_sb_info *msblk,
+static void *squashfs_decompressor_create(struct squashfs_sb_info *msblk,
 						void *comp_opts)
 {
 	struct squashfs_stream *stream;
@@ -44,6 +47,7 @@ void *squashfs_decompressor_create(struct squashfs_sb_info *msblk,
 
 	kfree(comp_opts);
 	mutex_init(&stream->mutex);
+	memset(&stream->stats, 0, sizeof(stream->stats));
 	return stream;
 
 out:
@@ -51,7 +55,7 @@ out:
 	return ERR_PTR(err);
 }
 
-void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
+static void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
 {
 	struct squashfs_stream *stream = msblk->stream;
 
@@ -61,15 +65,20 @@ void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
 	}
 }
 
-int squashfs_decompress(struct squashfs_sb_info *msblk, struct buffer_head **bh,
-	int b, int offset, int length, struct squashfs_page_actor *output)
+static int squashfs_decompress(struct squashfs_sb_info *msblk,
+	struct buffer_head **bh, int b, int offset, int length,
+	struct squashfs_page_actor *output)
 {
 	int res;
 	struct squashfs_stream *stream = msblk->stream;
+	u64 start = ktime_get_ns(), acquired;
 
 	mutex_lock(&stream->mutex);
+	acquired = ktime_get_ns();
 	res = msblk->decompressor->decompress(msblk, stream->stream, bh, b,
 		offset, length, output);
+	squashfs_stream_stats_add(&stream->stats, start, acquired,
+		ktime_get_ns());
 	mutex_unlock(&stream->mutex);
 
 	if (res < 0)
@@ -79,7 +88,26 @@ int squashfs_decompress(struct squashfs_sb_info *msblk, struct buffer_head **bh,
 	return res;
 }
 
-int squashfs_max_decompressors(void)
+static int squashfs_max_decompressors(void)
 {
 	return 1;
 }
+
+static void squashfs_decompressor_stats(struct seq_file *m,
+	struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *stream = msblk->stream;
+
+	mutex_lock(&stream->mutex);
+	squashfs_stream_stats_show(m, 0, &stream->stats);
+	mutex_unlock(&stream->mutex);
+}
+
+const struct squashfs_decompressor_thread_ops squashfs_decompressor_single = {
+	.create = squashfs_decompressor_create,
+	.decompress = squashfs_decompress,
+	.destroy = squashfs_decompressor_destroy,
+	.max_decompressors = squashfs_max_decompressors,
+	.show_stats = squashfs_decompressor_stats,
+	.name = "single"
+};
@@ -415,6 +415,38 @@ skip_page:
 	}
 }
 
+/*
+ * Copy @bytes of @buffer starting at @offset into the readahead pages of a
+ * block, zero filling the rest, or just zero them for a hole if @buffer is
+ * NULL.  NULL entries are pages readahead didn't ask for.  The pages are
+ * unlocked and released, and left !uptodate if @buffer has an error.
+ */
+void squashfs_fill_pages(struct page **page, int pages,
+	struct squashfs_cache_entry *buffer, int bytes, int offset)
+{
+	int i, res = buffer ? buffer->error : 0;
+	void *pageaddr;
+
+	for (i = 0; i < pages; i++, bytes -= PAGE_CACHE_SIZE,
+			offset += PAGE_CACHE_SIZE) {
+		int avail = buffer ? clamp_t(int, bytes, 0, PAGE_CACHE_SIZE) : 0;
+
+		if (page[i] == NULL)
+			continue;
+
+		if (!res) {
+			pageaddr = kmap_atomic(page[i]);
+			squashfs_copy_data(pageaddr, buffer, offset, avail);
+			memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
+			kunmap_atomic(pageaddr);
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		}
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+}
+
 /* Read datablock stored packed inside a fragment (tail-end packed block) */
 static int squashfs_readpage_fragment(struct page *page)
 {
@@ -498,6 +530,104 @@ out:
 }
 
 
+/*
+ * Readahead walks the window one Squashfs block at a time, moving the pages
+ * of each block into the page cache together so the block is decompressed
+ * once, straight into them where possible, instead of once per page.
+ */
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int mask = (1 << shift) - 1;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	pgoff_t last_page = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	struct page **page;
+	int res = 0;
+
+	if (i_size_read(inode) == 0)
+		return 0;
+
+	page = kmalloc_array(mask + 1, sizeof(void *), GFP_KERNEL);
+	if (page == NULL)
+		return -ENOMEM;
+
+	while (!list_empty(pages)) {
+		struct page *p = list_entry(pages->prev, struct page, lru);
+		pgoff_t start_index = p->index & ~mask;
+		pgoff_t end_index = min_t(pgoff_t, start_index | mask,
+					  last_page);
+		int index = p->index >> shift;
+		int i, nr = end_index - start_index + 1;
+
+		if (p->index > last_page)
+			break;
+
+		memset(page, 0, nr * sizeof(void *));
+		while (!list_empty(pages)) {
+			p = list_entry(pages->prev, struct page, lru);
+			if (p->index > end_index)
+				break;
+
+			list_del(&p->lru);
+			if (add_to_page_cache_lru(p, mapping, p->index,
+						  GFP_KERNEL)) {
+				page_cache_release(p);
+				continue;
+			}
+			page[p->index - start_index] = p;
+		}
+
+		if (index < file_end || squashfs_i(inode)->fragment_block ==
+						SQUASHFS_INVALID_BLK) {
+			u64 block = 0;
+			int bsize = read_blocklist(inode, index, &block);
+
+			if (bsize < 0) {
+				res = bsize;
+				for (i = 0; i < nr; i++) {
+					if (page[i] == NULL)
+						continue;
+					unlock_page(page[i]);
+					page_cache_release(page[i]);
+				}
+				break;
+			}
+
+			if (bsize == 0)
+				squashfs_fill_pages(page, nr, NULL, 0, 0);
+			else
+				res = squashfs_readahead_block(inode, block,
+					bsize, page, nr, start_index);
+		} else {
+			struct squashfs_cache_entry *buffer =
+				squashfs_get_fragment(inode->i_sb,
+					squashfs_i(inode)->fragment_block,
+					squashfs_i(inode)->fragment_size);
+			int bytes = i_size_read(inode) & (msblk->block_size - 1);
+
+			res = buffer->error;
+			if (res)
+				ERROR("Unable to read page, block %llx, size %x\n",
+					squashfs_i(inode)->fragment_block,
+					squashfs_i(inode)->fragment_size);
+			squashfs_fill_pages(page, nr, buffer, bytes,
+				squashfs_i(inode)->fragment_offset);
+			squashfs_cache_put(buffer);
+		}
+
+		if (res)
+			break;
+	}
+
+	kfree(page);
+	return res;
+}
+
+
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+	.readpages = squashfs_readpages
 };
@@ -36,3 +36,21 @@ int squashfs_readpage_block(struct page *page, u64 block, int bsize)
 	squashfs_cache_put(buffer);
 	return res;
 }
+
+/* Readahead of a separately compressed datablock into the given pages */
+int squashfs_readahead_block(struct inode *inode, u64 block, int bsize,
+	struct page **page, int pages, pgoff_t start_index)
+{
+	struct squashfs_cache_entry *buffer = squashfs_get_datablock(
+		inode->i_sb, block, bsize);
+	int res = buffer->error;
+
+	if (res)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+
+	squashfs_fill_pages(page, pages, buffer, buffer->length, 0);
+
+	squashfs_cache_put(buffer);
+	return res;
+}
@@ -20,53 +20,34 @@
 #include "squashfs.h"
 #include "page_actor.h"
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page);
-
-/* Read separately compressed datablock directly into page cache */
-int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+static int squashfs_read_cache(struct inode *inode, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page);
 
+/*
+ * Decompress a datablock into the pages covering it, @start_index being
+ * the index of page[0].  Entries left NULL by the caller are grabbed from
+ * the page cache.  On failure @target_page is left locked for the caller.
+ */
+static int squashfs_read_block_pages(struct inode *inode, u64 block,
+	int bsize, struct page **page, int pages, pgoff_t start_index,
+	struct page *target_page)
 {
-	struct inode *inode = target_page->mapping->host;
-	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
-
-	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
-	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
-	int start_index = target_page->index & ~mask;
-	int end_index = start_index | mask;
-	int i, n, pages, missing_pages, bytes, res = -ENOMEM;
-	struct page **page;
+	int i, missing_pages, bytes, res = -ENOMEM;
 	struct squashfs_page_actor *actor;
 	void *pageaddr;
 
-	if (end_index > file_end)
-		end_index = file_end;
-
-	pages = end_index - start_index + 1;
-
-	page = kmalloc_array(pages, sizeof(void *), GFP_KERNEL);
-	if (page == NULL)
-		return res;
-
-	/*
-	 * Create a "page actor" which will kmap and kunmap the
-	 * page cache pages appropriately within the decompressor
-	 */
-	actor = squashfs_page_actor_init_special(page, pages, 0);
-	if (actor == NULL)
-		goto out;
-
 	/* Try to grab all the pages covered by the Squashfs block */
-	for (missing_pages = 0, i = 0, n = start_index; i < pages; i++, n++) {
-		page[i] = (n == target_page->index) ? target_page :
-			grab_cache_page_nowait(target_page->mapping, n);
+	for (missing_pages = 0, i = 0; i < pages; i++) {
+		if (page[i] == NULL)
+			page[i] = grab_cache_page_nowait(inode->i_mapping,
+							 start_index + i);
 
 		if (page[i] == NULL) {
 			missing_pages++;
 			continue;
 		}
 
-		if (PageUptodate(page[i])) {
+		if (page[i] != target_page && PageUptodate(page[i])) {
 			unlock_page(page[i]);
 			page_cache_release(page[i]);
 			page[i] = NULL;
@@ -82,16 +63,25 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 		 * squashfs_readpage also trying to grab them.  Fall back to
 		 * using an intermediate buffer.
 		 */
-		res = squashfs_read_cache(target_page, block, bsize, pages,
-								page);
+		res = squashfs_read_cache(inode, target_page, block, bsize,
+								pages, page);
 		if (res < 0)
 			goto mark_errored;
 
-		goto out;
+		return res;
 	}
 
+	/*
+	 * Create a "page actor" which will kmap and kunmap the
+	 * page cache pages appropriately within the decompressor
+	 */
+	actor = squashfs_page_actor_init_special(page, pages, 0);
+	if (actor == NULL)
+		goto mark_errored;
+
 	/* Decompress directly into the page cache buffers */
 	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
+	kfree(actor);
 	if (res < 0)
 		goto mark_errored;
 
@@ -112,9 +102,6 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 			page_cache_release(page[i]);
 	}
 
-	kfree(actor);
-	kfree(page);
-
 	return 0;
 
 mark_errored:
@@ -130,17 +117,54 @@ mark_errored:
 		page_cache_release(page[i]);
 	}
 
-out:
-	kfree(actor);
+	return res;
+}
+
+/* Read separately compressed datablock directly into page cache */
+int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int pages, res;
+	struct page **page;
+
+	if (end_index > file_end)
+		end_index = file_end;
+
+	pages = end_index - start_index + 1;
+
+	page = kcalloc(pages, sizeof(void *), GFP_KERNEL);
+	if (page == NULL)
+		return -ENOMEM;
+
+	page[target_page->index - start_index] = target_page;
+	res = squashfs_read_block_pages(inode, block, bsize, page, pages,
+					start_index, target_page);
+
 	kfree(page);
 	return res;
 }
 
+/*
+ * Readahead of a separately compressed datablock, @page holds the locked
+ * readahead pages of the block already added to the page cache.
+ */
+int squashfs_readahead_block(struct inode *inode, u64 block, int bsize,
+	struct page **page, int pages, pgoff_t start_index)
+{
+	return squashfs_read_block_pages(inode, block, bsize, page, pages,
+					 start_index, NULL);
+}
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page)
+static int squashfs_read_cache(struct inode *i, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page)
 {
-	struct inode *i = target_page->mapping->host;
 	struct squashfs_cache_entry *buffer = squashfs_get_datablock(i->i_sb,
 						 block, bsize);
 	int bytes = buffer->length, res = buffer->error, n, offset = 0;
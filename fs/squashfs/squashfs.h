@@ -50,13 +50,6 @@ extern void *squashfs_read_table(struct super_block *, u64, int);
 extern const struct squashfs_decompressor *squashfs_lookup_decompressor(int);
 extern void *squashfs_decompressor_setup(struct super_block *, unsigned short);
 
-/* decompressor_xxx.c */
-extern void *squashfs_decompressor_create(struct squashfs_sb_info *, void *);
-extern void squashfs_decompressor_destroy(struct squashfs_sb_info *);
-extern int squashfs_decompress(struct squashfs_sb_info *, struct buffer_head **,
-	int, int, int, struct squashfs_page_actor *);
-extern int squashfs_max_decompressors(void);
-
 /* export.c */
 extern __le64 *squashfs_read_inode_lookup_table(struct super_block *, u64, u64,
 				unsigned int);
@@ -69,9 +62,13 @@ extern __le64 *squashfs_read_fragment_index_table(struct super_block *,
 /* file.c */
 void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 				int);
+void squashfs_fill_pages(struct page **, int, struct squashfs_cache_entry *,
+				int, int);
 
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int);
+extern int squashfs_readahead_block(struct inode *, u64, int, struct page **,
+				int, pgoff_t);
 
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
@@ -66,7 +66,9 @@ struct squashfs_sb_info {
 	__le64					*xattr_id_table;
 	struct mutex				meta_index_mutex;
 	struct meta_index			*meta_index;
+	const struct squashfs_decompressor_thread_ops	*thread_ops;
 	struct squashfs_stream			*stream;
+	struct dentry				*debugfs;
 	__le64					*inode_lookup_table;
 	u64					inode_table;
 	u64					directory_table;
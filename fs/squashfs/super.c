@@ -38,6 +38,9 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/xattr.h>
+#include <linux/parser.h>
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -49,6 +52,95 @@
 static struct file_system_type squashfs_fs_type;
 static const struct super_operations squashfs_super_ops;
 
+static unsigned int fragment_cache_size = SQUASHFS_CACHED_FRAGMENTS;
+module_param(fragment_cache_size, uint, 0644);
+MODULE_PARM_DESC(fragment_cache_size,
+	"Number of fragment blocks cached, read at mount time");
+
+/* Decompressor threading models built in, the first one is the default */
+static const struct squashfs_decompressor_thread_ops *const
+squashfs_thread_models[] = {
+#if defined(CONFIG_SQUASHFS_DECOMP_SINGLE) || \
+	defined(CONFIG_SQUASHFS_DECOMP_BY_MOUNT)
+	&squashfs_decompressor_single,
+#endif
+#if defined(CONFIG_SQUASHFS_DECOMP_MULTI) || \
+	defined(CONFIG_SQUASHFS_DECOMP_BY_MOUNT)
+	&squashfs_decompressor_multi,
+#endif
+#if defined(CONFIG_SQUASHFS_DECOMP_MULTI_PERCPU) || \
+	defined(CONFIG_SQUASHFS_DECOMP_BY_MOUNT)
+	&squashfs_decompressor_percpu,
+#endif
+};
+
+static struct dentry *squashfs_debugfs_root;
+
+enum {
+	Opt_threads, Opt_err
+};
+
+static const match_table_t squashfs_tokens = {
+	{Opt_threads, "threads=%s"},
+	{Opt_err, NULL}
+};
+
+static int squashfs_parse_options(struct squashfs_sb_info *msblk,
+	char *options)
+{
+	substring_t args[MAX_OPT_ARGS];
+	char *p;
+	int i;
+
+	msblk->thread_ops = squashfs_thread_models[0];
+
+	while (options && (p = strsep(&options, ",")) != NULL) {
+		if (!*p)
+			continue;
+
+		switch (match_token(p, squashfs_tokens, args)) {
+		case Opt_threads:
+			for (i = 0; i < ARRAY_SIZE(squashfs_thread_models); i++)
+				if (!match_strlcmp(&args[0],
+					squashfs_thread_models[i]->name))
+					break;
+			if (i == ARRAY_SIZE(squashfs_thread_models)) {
+				ERROR("Decompressor model \"%s\" is not "
+					"supported\n", args[0].from);
+				return -EINVAL;
+			}
+			msblk->thread_ops = squashfs_thread_models[i];
+			break;
+		default:
+			ERROR("Unrecognized mount option \"%s\"\n", p);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int squashfs_stats_show(struct seq_file *m, void *v)
+{
+	struct squashfs_sb_info *msblk = m->private;
+
+	seq_printf(m, "model: %s\n", msblk->thread_ops->name);
+	msblk->thread_ops->show_stats(m, msblk);
+	return 0;
+}
+
+static int squashfs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, squashfs_stats_show, inode->i_private);
+}
+
+static const struct file_operations squashfs_stats_fops = {
+	.open = squashfs_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static const struct squashfs_decompressor *supported_squashfs_filesystem(short
 	major, short minor, short id)
 {
@@ -102,6 +194,10 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 
 	mutex_init(&msblk->meta_index_mutex);
 
+	err = squashfs_parse_options(msblk, data);
+	if (err)
+		goto failed_mount;
+
 	/*
 	 * msblk->bytes_used is checked in squashfs_read_table to ensure reads
 	 * are not beyond filesystem end.  But as we're using
@@ -208,7 +304,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 
 	/* Allocate read_page block */
 	msblk->read_page = squashfs_cache_init("data",
-		squashfs_max_decompressors(), msblk->block_size);
+		msblk->thread_ops->max_decompressors(), msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -221,6 +317,10 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto failed_mount;
 	}
 
+	if (!IS_ERR_OR_NULL(squashfs_debugfs_root))
+		msblk->debugfs = debugfs_create_file(sb->s_id, S_IRUGO,
+			squashfs_debugfs_root, msblk, &squashfs_stats_fops);
+
 	/* Handle xattrs */
 	sb->s_xattr = squashfs_xattr_handlers;
 	xattr_id_table_start = le64_to_cpu(sblk->xattr_id_table_start);
@@ -278,7 +378,8 @@ handle_fragments:
 		goto check_directory_table;
 
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		max_t(unsigned int, ACCESS_ONCE(fragment_cache_size), 1),
+		msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
@@ -335,10 +436,12 @@ check_directory_table:
 	return 0;
 
 failed_mount:
+	debugfs_remove(msblk->debugfs);
 	squashfs_cache_delete(msblk->block_cache);
 	squashfs_cache_delete(msblk->fragment_cache);
 	squashfs_cache_delete(msblk->read_page);
-	squashfs_decompressor_destroy(msblk);
+	if (msblk->stream)
+		msblk->thread_ops->destroy(msblk);
 	kfree(msblk->inode_lookup_table);
 	kfree(msblk->fragment_index);
 	kfree(msblk->id_table);
@@ -371,6 +474,18 @@ static int squashfs_statfs(struct dentry *dentry, struct kstatfs *buf)
 }
 
 
+static int squashfs_show_options(struct seq_file *seq, struct dentry *root)
+{
+	struct squashfs_sb_info *msblk = root->d_sb->s_fs_info;
+
+	if (ARRAY_SIZE(squashfs_thread_models) > 1)
+		seq_printf(seq, ",threads=%s", msblk->thread_ops->name);
+
+	return 0;
+}
+
+
+/* The decompressor model is only chosen at mount, threads= is ignored */
 static int squashfs_remount(struct super_block *sb, int *flags, char *data)
 {
 	sync_filesystem(sb);
@@ -383,10 +498,11 @@ static void squashfs_put_super(struct super_block *sb)
 {
 	if (sb->s_fs_info) {
 		struct squashfs_sb_info *sbi = sb->s_fs_info;
+		debugfs_remove(sbi->debugfs);
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
-		squashfs_decompressor_destroy(sbi);
+		sbi->thread_ops->destroy(sbi);
 		kfree(sbi->id_table);
 		kfree(sbi->fragment_index);
 		kfree(sbi->meta_index);
@@ -450,6 +566,9 @@ static int __init init_squashfs_fs(void)
 		return err;
 	}
 
+	/* per mount decompressor statistics, best effort */
+	squashfs_debugfs_root = debugfs_create_dir("squashfs", NULL);
+
 	pr_info("version 4.0 (2009/01/31) Phillip Lougher\n");
 
 	return 0;
@@ -458,6 +577,7 @@ static int __init init_squashfs_fs(void)
 
 static void __exit exit_squashfs_fs(void)
 {
+	debugfs_remove_recursive(squashfs_debugfs_root);
 	unregister_filesystem(&squashfs_fs_type);
 	destroy_inodecache();
 }
@@ -497,6 +617,7 @@ static const struct super_operations squashfs_super_ops = {
 	.alloc_inode = squashfs_alloc_inode,
 	.destroy_inode = squashfs_destroy_inode,
 	.statfs = squashfs_statfs,
+	.show_options = squashfs_show_options,
 	.put_super = squashfs_put_super,
 	.remount_fs = squashfs_remount
 };
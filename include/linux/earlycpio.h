@@ -3,7 +3,7 @@
 
 #include <linux/types.h>
 
-#define MAX_CPIO_FILE_NAME 18
+#define MAX_CPIO_FILE_NAME 64
 
 struct cpio_data {
 	void *data;
@@ -71,6 +71,8 @@ int of_hwspin_lock_get_id(struct device_node *np, int index);
 int hwspin_lock_get_id(struct hwspinlock *hwlock);
 int __hwspin_lock_timeout(struct hwspinlock *, unsigned int, int,
 							unsigned long *);
+int __hwspin_lock_timeout_sleep(struct hwspinlock *, unsigned int, int,
+							unsigned long *);
 int __hwspin_trylock(struct hwspinlock *, int, unsigned long *);
 void __hwspin_unlock(struct hwspinlock *, int, unsigned long *);
 
@@ -111,6 +113,13 @@ int __hwspin_lock_timeout(struct hwspinlock *hwlock, unsigned int to,
 	return 0;
 }
 
+static inline
+int __hwspin_lock_timeout_sleep(struct hwspinlock *hwlock, unsigned int to,
+					int mode, unsigned long *flags)
+{
+	return 0;
+}
+
 static inline
 int __hwspin_trylock(struct hwspinlock *hwlock, int mode, unsigned long *flags)
 {
@@ -267,6 +276,30 @@ int hwspin_lock_timeout(struct hwspinlock *hwlock, unsigned int to)
 	return __hwspin_lock_timeout(hwlock, to, 0, NULL);
 }
 
+/**
+ * hwspin_lock_timeout_sleep() - lock an hwspinlock, sleeping while waiting
+ * @hwlock: the hwspinlock to be locked
+ * @to: timeout value in msecs
+ *
+ * Like hwspin_lock_timeout(), but for callers that may sleep. A taken
+ * @hwlock is polled for a few microseconds, after that the caller sleeps
+ * between attempts, for longer and longer, so that a lock held for long
+ * by a remote core doesn't keep a local CPU busy.
+ *
+ * Upon a successful return from this function, preemption is disabled
+ * so the caller must not sleep, and is advised to release the hwspinlock
+ * as soon as possible.
+ *
+ * Returns 0 when the @hwlock was successfully taken, and an appropriate
+ * error code otherwise (most notably an -ETIMEDOUT if the @hwlock is still
+ * busy after @timeout msecs). The function may sleep.
+ */
+static inline
+int hwspin_lock_timeout_sleep(struct hwspinlock *hwlock, unsigned int to)
+{
+	return __hwspin_lock_timeout_sleep(hwlock, to, 0, NULL);
+}
+
 /**
  * hwspin_unlock_irqrestore() - unlock hwspinlock, restore irq state
  * @hwlock: a previously-acquired hwspinlock which we want to unlock
@@ -0,0 +1,51 @@
+#ifndef __LINUX_IIO_BLOCK_BUF_H__
+#define __LINUX_IIO_BLOCK_BUF_H__
+
+#include <linux/list.h>
+#include <linux/types.h>
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+
+enum iio_block_state {
+	IIO_BLOCK_STATE_DEQUEUED,	/* owned by user space */
+	IIO_BLOCK_STATE_QUEUED,		/* waiting to be filled */
+	IIO_BLOCK_STATE_ACTIVE,		/* being filled */
+	IIO_BLOCK_STATE_DONE,		/* waiting to be dequeued or read */
+};
+
+/**
+ * struct iio_block - a block of a block based buffer
+ * @head:	entry in the buffer's incoming or outgoing queue
+ * @block:	descriptor as reported to user space
+ * @vaddr:	kernel address of the block memory
+ * @phys_addr:	DMA address of the block memory, for the DMA device the
+ *		buffer was allocated for
+ * @state:	enum iio_block_state
+ */
+struct iio_block {
+	struct list_head head;
+	struct iio_buffer_block block;
+	void *vaddr;
+	dma_addr_t phys_addr;
+	enum iio_block_state state;
+};
+
+/**
+ * struct iio_block_buffer_ops - driver hooks of a block based buffer
+ * @block_queued:	a block became available after
+ *			iio_block_buffer_get_block() found none; may be
+ *			called in atomic context.
+ */
+struct iio_block_buffer_ops {
+	void (*block_queued)(struct iio_buffer *buffer, void *priv);
+};
+
+struct iio_buffer *iio_block_buffer_allocate(struct device *dma_dev,
+		const struct iio_block_buffer_ops *ops, void *priv);
+void iio_block_buffer_free(struct iio_buffer *buffer);
+
+struct iio_block *iio_block_buffer_get_block(struct iio_buffer *buffer);
+void iio_block_buffer_block_done(struct iio_buffer *buffer,
+		struct iio_block *block, size_t bytes_used);
+
+#endif
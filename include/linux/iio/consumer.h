@@ -135,6 +135,21 @@ int iio_read_channel_raw(struct iio_channel *chan,
  */
 int iio_read_channel_average_raw(struct iio_channel *chan, int *val);
 
+/**
+ * iio_read_channels_raw() - read several channels at once
+ * @chans:		The channels being queried, e.g. from
+ *			iio_channel_get_all().
+ * @num:		Number of channels in @chans.
+ * @vals:		Values read back, vals[i] for chans[i].
+ *
+ * Returns an error code or 0.
+ *
+ * The channels of a device that can sample a set of channels in one sequence
+ * are converted together, the others one at a time as with
+ * iio_read_channel_raw().
+ */
+int iio_read_channels_raw(struct iio_channel *chans, int num, int *vals);
+
 /**
  * iio_read_channel_processed() - read processed value from a given channel
  * @chan:		The channel being queried.
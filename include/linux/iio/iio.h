@@ -43,6 +43,7 @@ enum iio_chan_info_enum {
 	IIO_CHAN_INFO_CALIBWEIGHT,
 	IIO_CHAN_INFO_DEBOUNCE_COUNT,
 	IIO_CHAN_INFO_DEBOUNCE_TIME,
+	IIO_CHAN_INFO_OVERSAMPLING_RATIO,
 };
 
 enum iio_shared_by {
@@ -319,6 +320,10 @@ struct iio_dev;
  *			max_len specifies maximum number of elements
  *			vals pointer can contain. val_len is used to return
  *			length of valid elements in vals.
+ * @read_raw_channels:	optional, read the raw values of @num channels of the
+ *			device in one conversion sequence, vals[i] receiving
+ *			the value of chans[i].  Returns 0 or a negative error
+ *			code.  Used by iio_read_channels_raw().
  * @write_raw:		function to write a value to the device.
  *			Parameters are the same as for read_raw.
  * @write_raw_get_fmt:	callback function to query the expected
@@ -367,6 +372,10 @@ struct iio_info {
 			int *val_len,
 			long mask);
 
+	int (*read_raw_channels)(struct iio_dev *indio_dev,
+				 struct iio_chan_spec const * const *chans,
+				 int num, int *vals);
+
 	int (*write_raw)(struct iio_dev *indio_dev,
 			 struct iio_chan_spec const *chan,
 			 int val,
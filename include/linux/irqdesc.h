@@ -38,6 +38,9 @@ struct pt_regs;
  * @threads_oneshot:	bitfield to handle shared oneshot threads
  * @threads_active:	number of irqaction threads currently running
  * @wait_for_threads:	wait queue for sync_irq to wait for threaded handlers
+ * @thread_policy:	scheduling policy of the handler threads, or -1 for
+ *			the irqthread_sched= or built-in default
+ * @thread_prio:	real time priority of the handler threads
  * @nr_actions:		number of installed actions on this descriptor
  * @no_suspend_depth:	number of irqactions on a irq descriptor with
  *			IRQF_NO_SUSPEND set
@@ -75,6 +78,8 @@ struct irq_desc {
 	unsigned long		threads_oneshot;
 	atomic_t		threads_active;
 	wait_queue_head_t       wait_for_threads;
+	int			thread_policy;
+	int			thread_prio;
 #ifdef CONFIG_PM_SLEEP
 	unsigned int		nr_actions;
 	unsigned int		no_suspend_depth;
@@ -0,0 +1,17 @@
+#ifndef __LINUX_MEMPRESSURE_H
+#define __LINUX_MEMPRESSURE_H
+
+#include <linux/types.h>
+
+struct zone;
+
+#ifdef CONFIG_MEMPRESSURE
+extern void mempressure_kswapd_wake(struct zone *zone);
+extern void mempressure_stall(struct zone *zone, u64 stall_ns, bool progress);
+#else
+static inline void mempressure_kswapd_wake(struct zone *zone) { }
+static inline void mempressure_stall(struct zone *zone, u64 stall_ns,
+				     bool progress) { }
+#endif
+
+#endif /* __LINUX_MEMPRESSURE_H */
@@ -127,6 +127,16 @@ struct mmc_data {
 };
 
 struct mmc_host;
+
+/*
+ * A host claimed through a context, rather than by the current task, stays
+ * claimed by that context no matter which task issues requests under it or
+ * releases it.  @task is the task currently working under the claim, plain
+ * task claims from it nest.
+ */
+struct mmc_ctx {
+	struct task_struct *task;
+};
 struct mmc_request {
 	struct mmc_command	*sbc;		/* SET_BLOCK_COUNT for multiblock */
 	struct mmc_command	*cmd;
@@ -189,6 +199,7 @@ extern void mmc_set_data_timeout(struct mmc_data *, const struct mmc_card *);
 extern unsigned int mmc_align_data_size(struct mmc_card *, unsigned int);
 
 extern int __mmc_claim_host(struct mmc_host *host, atomic_t *abort);
+extern void mmc_claim_host_ctx(struct mmc_host *host, struct mmc_ctx *ctx);
 extern void mmc_release_host(struct mmc_host *host);
 
 extern void mmc_get_card(struct mmc_card *card);
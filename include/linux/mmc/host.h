@@ -330,7 +330,8 @@ struct mmc_host {
 	struct mmc_card		*card;		/* device attached to this host */
 
 	wait_queue_head_t	wq;
-	struct task_struct	*claimer;	/* task that has host claimed */
+	struct mmc_ctx		*claimer;	/* context holding the host */
+	struct mmc_ctx		default_ctx;	/* claimer for task claims */
 	int			claim_cnt;	/* "claim" nesting count */
 
 	struct delayed_work	detect;
@@ -34,6 +34,8 @@ struct nvmem_cell *devm_nvmem_cell_get(struct device *dev, const char *name);
 void nvmem_cell_put(struct nvmem_cell *cell);
 void devm_nvmem_cell_put(struct device *dev, struct nvmem_cell *cell);
 void *nvmem_cell_read(struct nvmem_cell *cell, size_t *len);
+int nvmem_cell_read_range(struct nvmem_cell *cell, unsigned int offset,
+			  void *buf, size_t len);
 int nvmem_cell_write(struct nvmem_cell *cell, void *buf, size_t len);
 
 /* direct nvmem device read/write interface */
@@ -79,6 +81,13 @@ static inline char *nvmem_cell_read(struct nvmem_cell *cell, size_t *len)
 	return ERR_PTR(-ENOSYS);
 }
 
+static inline int nvmem_cell_read_range(struct nvmem_cell *cell,
+					unsigned int offset, void *buf,
+					size_t len)
+{
+	return -ENOSYS;
+}
+
 static inline int nvmem_cell_write(struct nvmem_cell *cell,
 				    const char *buf, size_t len)
 {
@@ -50,6 +50,7 @@ struct device_node {
 	const char *name;
 	const char *type;
 	phandle phandle;
+	struct hlist_node phandle_hash;	/* phandle cache, under devtree_lock */
 	const char *full_name;
 	struct fwnode_handle fwnode;
 
@@ -86,6 +87,7 @@ extern struct kobj_type of_node_ktype;
 static inline void of_node_init(struct device_node *node)
 {
 	kobject_init(&node->kobj, &of_node_ktype);
+	INIT_HLIST_NODE(&node->phandle_hash);
 	node->fwnode.type = FWNODE_OF;
 }
 
@@ -131,6 +131,8 @@ void edma_set_src(unsigned slot, dma_addr_t src_port,
 void edma_set_dest(unsigned slot, dma_addr_t dest_port,
 				 enum address_mode mode, enum fifo_width);
 dma_addr_t edma_get_position(unsigned slot, bool dst);
+size_t edma_get_cyclic_residue(unsigned slot, bool dst, dma_addr_t buf,
+			       size_t len);
 void edma_set_src_index(unsigned slot, s16 src_bidx, s16 src_cidx);
 void edma_set_dest_index(unsigned slot, s16 dest_bidx, s16 dest_cidx);
 void edma_set_transfer_params(unsigned slot, u16 acnt, u16 bcnt, u16 ccnt,
@@ -152,6 +154,9 @@ void edma_resume(unsigned channel);
 
 void edma_assign_channel_eventq(unsigned channel, enum dma_event_q eventq_no);
 
+/* memory to memory copy through a pool of event-less channels */
+int edma_memcpy(dma_addr_t dst, dma_addr_t src, size_t len);
+
 struct edma_rsv_info {
 
 	const s16	(*rsv_chans)[2];
@@ -172,6 +177,9 @@ struct edma_soc_info {
 
 	s8	(*queue_priority_mapping)[2];
 	const s16	(*xbar_chans)[2];
+
+	/* Link slots cached for reuse; 0 selects the default */
+	unsigned int	slot_cache;
 };
 
 int edma_trigger_channel(unsigned);
@@ -45,6 +45,10 @@ struct elm_errorvec {
 #if IS_ENABLED(CONFIG_MTD_NAND_OMAP_BCH)
 void elm_decode_bch_error_page(struct device *dev, u8 *ecc_calc,
 		struct elm_errorvec *err_vec);
+void elm_decode_bch_error_page_start(struct device *dev, u8 *ecc_calc,
+		struct elm_errorvec *err_vec);
+void elm_decode_bch_error_page_finish(struct device *dev,
+		struct elm_errorvec *err_vec);
 int elm_config(struct device *dev, enum bch_ecc bch_type,
 	int ecc_steps, int ecc_step_size, int ecc_syndrome_size);
 #else
@@ -54,6 +58,18 @@ elm_decode_bch_error_page(struct device *dev, u8 *ecc_calc,
 {
 }
 
+static inline void
+elm_decode_bch_error_page_start(struct device *dev, u8 *ecc_calc,
+				struct elm_errorvec *err_vec)
+{
+}
+
+static inline void
+elm_decode_bch_error_page_finish(struct device *dev,
+				 struct elm_errorvec *err_vec)
+{
+}
+
 static inline int elm_config(struct device *dev, enum bch_ecc bch_type,
 			     int ecc_steps, int ecc_step_size,
 			     int ecc_syndrome_size)
@@ -86,4 +86,7 @@ struct omap_hsmmc_platform_data {
 
 	const char *name;
 	u32 ocr_mask;
+
+	/* data transfers shorter than this many bytes use PIO, not DMA */
+	u32 dma_threshold;
 };
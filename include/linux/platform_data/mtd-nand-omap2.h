@@ -17,7 +17,8 @@ enum nand_io {
 	NAND_OMAP_PREFETCH_POLLED = 0,	/* prefetch polled mode, default */
 	NAND_OMAP_POLLED,		/* polled mode, without prefetch */
 	NAND_OMAP_PREFETCH_DMA,		/* prefetch enabled sDMA mode */
-	NAND_OMAP_PREFETCH_IRQ		/* prefetch enabled irq mode */
+	NAND_OMAP_PREFETCH_IRQ,		/* prefetch enabled irq mode */
+	NAND_OMAP_PREFETCH_AUTO		/* dma, irq or polled by length */
 };
 
 enum omap_ecc {
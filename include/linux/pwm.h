@@ -119,6 +119,18 @@ static inline unsigned int pwm_get_duty_cycle(struct pwm_device *pwm)
  */
 int pwm_set_polarity(struct pwm_device *pwm, enum pwm_polarity polarity);
 
+/**
+ * struct pwm_update - one entry of a grouped PWM configuration
+ * @pwm: PWM device
+ * @duty_ns: "on" time (in nanoseconds)
+ * @period_ns: duration (in nanoseconds) of one cycle
+ */
+struct pwm_update {
+	struct pwm_device	*pwm;
+	int			duty_ns;
+	int			period_ns;
+};
+
 /**
  * struct pwm_ops - PWM controller operations
  * @request: optional hook for requesting a PWM
@@ -127,6 +139,12 @@ int pwm_set_polarity(struct pwm_device *pwm, enum pwm_polarity polarity);
  * @set_polarity: configure the polarity of this PWM
  * @enable: enable PWM output toggling
  * @disable: disable PWM output toggling
+ * @update_begin: optional hook to hold back new settings from the outputs
+ *                until @update_commit, see pwm_config_group()
+ * @update_commit: let the settings held back since @update_begin reach the
+ *                 outputs at the next period boundary; called with
+ *                 interrupts disabled
+ * @update_end: optional hook called after @update_commit, may sleep
  * @dbg_show: optional routine to show contents in debugfs
  * @owner: helps prevent removal of modules exporting active PWMs
  */
@@ -145,6 +163,9 @@ struct pwm_ops {
 					  struct pwm_device *pwm);
 	void			(*disable)(struct pwm_chip *chip,
 					   struct pwm_device *pwm);
+	int			(*update_begin)(struct pwm_chip *chip);
+	void			(*update_commit)(struct pwm_chip *chip);
+	void			(*update_end)(struct pwm_chip *chip);
 #ifdef CONFIG_DEBUG_FS
 	void			(*dbg_show)(struct pwm_chip *chip,
 					    struct seq_file *s);
@@ -201,6 +222,8 @@ struct pwm_device *devm_of_pwm_get(struct device *dev, struct device_node *np,
 void devm_pwm_put(struct device *dev, struct pwm_device *pwm);
 
 bool pwm_can_sleep(struct pwm_device *pwm);
+
+int pwm_config_group(const struct pwm_update *updates, unsigned int num);
 #else
 static inline int pwm_set_chip_data(struct pwm_device *pwm, void *data)
 {
@@ -266,6 +289,12 @@ static inline bool pwm_can_sleep(struct pwm_device *pwm)
 {
 	return false;
 }
+
+static inline int pwm_config_group(const struct pwm_update *updates,
+				   unsigned int num)
+{
+	return -EINVAL;
+}
 #endif
 
 struct pwm_lookup {
@@ -453,6 +453,20 @@ enum rproc_crash_type {
 	RPROC_EXCEPTION,
 };
 
+/**
+ * struct rproc_load_stats - statistics of the last firmware load
+ * @time_us: time spent putting the segments in place, in microseconds
+ * @cpu_bytes: number of bytes copied by the CPU
+ * @dma_bytes: number of bytes copied by a dmaengine memcpy channel
+ * @cached: the image was taken from the firmware cache
+ */
+struct rproc_load_stats {
+	u32 time_us;
+	size_t cpu_bytes;
+	size_t dma_bytes;
+	bool cached;
+};
+
 /**
  * struct rproc - represents a physical remote processor device
  * @node: list node of this rproc object
@@ -488,6 +502,8 @@ enum rproc_crash_type {
  * @table_csum: checksum of the resource table
  * @fw_version: human readable version information extracted from f/w
  * @has_iommu: flag to indicate if remote processor is behind an MMU
+ * @cached_fw: firmware image kept across restarts, if caching is enabled
+ * @load_stats: statistics of the last firmware load
  */
 struct rproc {
 	struct list_head node;
@@ -523,6 +539,8 @@ struct rproc {
 	u32 table_csum;
 	char *fw_version;
 	bool has_iommu;
+	const struct firmware *cached_fw;
+	struct rproc_load_stats load_stats;
 };
 
 /* we currently support only two vrings per rvdev */
@@ -567,6 +585,8 @@ struct rproc_vdev {
 	u32 rsc_offset;
 };
 
+struct firmware;
+
 struct rproc *rproc_get_by_phandle(phandle phandle);
 struct rproc *rproc_alloc(struct device *dev, const char *name,
 			  const struct rproc_ops *ops,
@@ -577,6 +597,7 @@ int rproc_del(struct rproc *rproc);
 
 int rproc_boot(struct rproc *rproc);
 void rproc_shutdown(struct rproc *rproc);
+int rproc_reload(struct rproc *rproc, const struct firmware *fw);
 void rproc_report_crash(struct rproc *rproc, enum rproc_crash_type type);
 struct rproc *rproc_vdev_to_rproc_safe(struct virtio_device *vdev);
 int rproc_get_alias_id(struct rproc *rproc);
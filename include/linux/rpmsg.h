@@ -40,9 +40,24 @@
 #include <linux/mod_devicetable.h>
 #include <linux/kref.h>
 #include <linux/mutex.h>
+#include <linux/uio.h>
 
 /* The feature bitmap for virtio rpmsg */
 #define VIRTIO_RPMSG_F_NS	0 /* RP supports name service notifications */
+#define VIRTIO_RPMSG_F_BUFSZ	1 /* RP provides buffer geometry in config */
+
+/**
+ * struct virtio_rpmsg_config - config space of a virtio rpmsg device
+ * @num_bufs: total number of buffers, half of them used for each direction
+ * @buf_size: size of a single buffer, including the rpmsg header
+ *
+ * Only read when VIRTIO_RPMSG_F_BUFSZ is negotiated. A zero field keeps
+ * the default of the bus driver.
+ */
+struct virtio_rpmsg_config {
+	u32 num_bufs;
+	u32 buf_size;
+} __packed;
 
 /**
  * struct rpmsg_hdr - common header for all rpmsg messages
@@ -180,7 +195,10 @@ struct rpmsg_endpoint *rpmsg_create_ept(struct rpmsg_channel *,
 				rpmsg_rx_cb_t cb, void *priv, u32 addr);
 int
 rpmsg_send_offchannel_raw(struct rpmsg_channel *, u32, u32, void *, int, bool);
+int rpmsg_sendv_offchannel_raw(struct rpmsg_channel *, u32, u32,
+			       const struct kvec *, unsigned int, bool);
 struct virtio_device *rpmsg_get_virtio_dev(struct rpmsg_channel *rpdev);
+int rpmsg_get_mtu(struct rpmsg_channel *rpdev);
 struct rpmsg_channel *rpmsg_create_channel(struct virtproc_info *vrp,
 					   const char *name, const char *desc,
 					   int src, int dst);
@@ -263,6 +281,33 @@ int rpmsg_send_offchannel(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 	return rpmsg_send_offchannel_raw(rpdev, src, dst, data, len, true);
 }
 
+/**
+ * rpmsg_sendv() - send a batch of messages across to the remote processor
+ * @rpdev: the rpmsg channel
+ * @vec: array of payloads, each entry is sent as a separate message
+ * @count: number of entries in @vec
+ *
+ * This function sends the @count messages described by @vec on the @rpdev
+ * channel, using @rpdev's source and destination addresses, and notifies
+ * the remote processor once for the whole batch.
+ * In case there are no TX buffers available, the function will block until
+ * one becomes available, or a timeout of 15 seconds elapses. When the latter
+ * happens, -ERESTARTSYS is returned.
+ *
+ * Can only be called from process context (for now).
+ *
+ * Returns the number of messages sent on success and an appropriate error
+ * value if none could be sent.
+ */
+static inline
+int rpmsg_sendv(struct rpmsg_channel *rpdev, const struct kvec *vec,
+		unsigned int count)
+{
+	u32 src = rpdev->src, dst = rpdev->dst;
+
+	return rpmsg_sendv_offchannel_raw(rpdev, src, dst, vec, count, true);
+}
+
 /**
  * rpmsg_send() - send a message across to the remote processor
  * @rpdev: the rpmsg channel
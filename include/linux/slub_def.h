@@ -44,6 +44,7 @@ struct kmem_cache_cpu {
 	struct page *partial;	/* Partially allocated frozen slabs */
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
+	u64 slowpath_ns;	/* Time spent in the allocation slowpath */
 #endif
 };
 
@@ -80,6 +80,9 @@ static inline char *flag_buf_ptr(struct tty_buffer *b, int ofs)
 	return (char *)char_buf_ptr(b, ofs) + b->size;
 }
 
+/* Push to ldisc delay histogram, bucket n counts delays below 2^n us */
+#define TTY_FLIP_LATENCY_BUCKETS	20
+
 struct tty_bufhead {
 	struct tty_buffer *head;	/* Queue head */
 	struct work_struct work;
@@ -90,6 +93,10 @@ struct tty_bufhead {
 	atomic_t	   mem_used;    /* In-use buffers excluding free list */
 	int		   mem_limit;
 	struct tty_buffer *tail;	/* Active buffer */
+#ifdef CONFIG_TTY_FLIP_LATENCY
+	unsigned long	   push_us;	/* Oldest unprocessed push, 0 if none */
+	unsigned int	   latency[TTY_FLIP_LATENCY_BUCKETS];
+#endif
 };
 /*
  * When a break, frame error, or parity error happens, these codes are
@@ -467,6 +474,10 @@ extern void tty_buffer_free_all(struct tty_port *port);
 extern void tty_buffer_flush(struct tty_struct *tty, struct tty_ldisc *ld);
 extern void tty_buffer_init(struct tty_port *port);
 extern void tty_buffer_set_lock_subclass(struct tty_port *port);
+#ifdef CONFIG_TTY_FLIP_LATENCY
+extern ssize_t tty_buffer_latency_show(struct tty_port *port, char *buf);
+extern void tty_buffer_latency_reset(struct tty_port *port);
+#endif
 extern speed_t tty_termios_baud_rate(struct ktermios *termios);
 extern speed_t tty_termios_input_baud_rate(struct ktermios *termios);
 extern void tty_termios_encode_baud_rate(struct ktermios *termios,
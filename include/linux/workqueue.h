@@ -129,6 +129,7 @@ struct delayed_work {
  */
 struct workqueue_attrs {
 	int			nice;		/* nice level */
+	int			rtprio;		/* SCHED_FIFO priority or 0 */
 	cpumask_var_t		cpumask;	/* allowed CPUs */
 	bool			no_numa;	/* disable NUMA affinity */
 };
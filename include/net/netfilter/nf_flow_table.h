@@ -0,0 +1,65 @@
+#ifndef _NF_FLOW_TABLE_H
+#define _NF_FLOW_TABLE_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/rcupdate.h>
+#include <net/dst.h>
+
+struct nf_conn;
+
+/* Same numbering as enum ip_conntrack_dir */
+enum flow_offload_dir {
+	FLOW_OFFLOAD_DIR_ORIGINAL,
+	FLOW_OFFLOAD_DIR_REPLY,
+	FLOW_OFFLOAD_DIR_MAX,
+};
+
+/* A direction of a flow, as its packets look when they come in */
+struct flow_offload_tuple {
+	__be32			src_v4;
+	__be32			dst_v4;
+	__be16			src_port;
+	__be16			dst_port;
+	int			iifidx;
+	u8			l4proto;
+	/* lookup key ends here */
+	u8			dir;
+	struct dst_entry	*dst_cache;
+};
+
+#define FLOW_OFFLOAD_KEY_LEN	offsetof(struct flow_offload_tuple, dir)
+
+struct flow_offload_tuple_rhash {
+	struct hlist_node		node;
+	struct flow_offload_tuple	tuple;
+};
+
+/* flags */
+#define FLOW_OFFLOAD_TEARDOWN	0
+
+struct flow_offload {
+	struct flow_offload_tuple_rhash	tuplehash[FLOW_OFFLOAD_DIR_MAX];
+	struct list_head		list;
+	struct nf_conn			*ct;
+	unsigned long			flags;
+	/* jiffies, the flow goes back to conntrack when idle past this */
+	unsigned long			timeout;
+	/* what conntrack gets refreshed with for each packet */
+	unsigned long			ct_timeout;
+	struct rcu_head			rcu_head;
+};
+
+/* Idle time after which a flow is handed back to conntrack */
+#define FLOW_OFFLOAD_TIMEOUT	(30 * HZ)
+
+int flow_offload_add(struct nf_conn *ct,
+		     struct dst_entry *dst[FLOW_OFFLOAD_DIR_MAX]);
+struct flow_offload_tuple_rhash *
+flow_offload_lookup(const struct flow_offload_tuple *tuple);
+void flow_offload_teardown(struct flow_offload *flow);
+
+int nf_flow_table_ip_init(void);
+void nf_flow_table_ip_fini(void);
+
+#endif /* _NF_FLOW_TABLE_H */
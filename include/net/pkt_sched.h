@@ -134,4 +134,14 @@ static inline unsigned int psched_mtu(const struct net_device *dev)
 	return dev->mtu + dev->hard_header_len;
 }
 
+/* Credit based shaper parameters handed to ndo_setup_cbs() */
+struct tc_cbs_qopt_offload {
+	u8	enable;
+	s32	queue;
+	s32	hicredit;	/* bytes */
+	s32	locredit;	/* bytes */
+	s32	idleslope;	/* kbit/s */
+	s32	sendslope;	/* kbit/s, negative */
+};
+
 #endif
@@ -29,6 +29,12 @@ struct fib_info;
  * @swdev_fib_ipv4_add: Called to add/modify IPv4 route to switch device.
  *
  * @swdev_fib_ipv4_del: Called to delete IPv4 route from switch device.
+ *
+ * @swdev_port_mdb_add: Called when a multicast group, given by its MAC
+ *   address, is joined on this bridge port.  Called in atomic context.
+ *
+ * @swdev_port_mdb_del: Called when the port leaves a group again.  Called
+ *   in atomic context.
  */
 struct swdev_ops {
 	int	(*swdev_parent_id_get)(struct net_device *dev,
@@ -41,6 +47,10 @@ struct swdev_ops {
 	int	(*swdev_fib_ipv4_del)(struct net_device *dev, __be32 dst,
 				      int dst_len, struct fib_info *fi,
 				      u8 tos, u8 type, u32 tb_id);
+	int	(*swdev_port_mdb_add)(struct net_device *dev,
+				      const unsigned char *addr, u16 vid);
+	int	(*swdev_port_mdb_del)(struct net_device *dev,
+				      const unsigned char *addr, u16 vid);
 };
 
 enum netdev_switch_notifier_type {
@@ -86,6 +96,10 @@ int netdev_switch_fib_ipv4_add(u32 dst, int dst_len, struct fib_info *fi,
 int netdev_switch_fib_ipv4_del(u32 dst, int dst_len, struct fib_info *fi,
 			       u8 tos, u8 type, u32 tb_id);
 void netdev_switch_fib_ipv4_abort(struct fib_info *fi);
+int netdev_switch_port_mdb_add(struct net_device *dev,
+			       const unsigned char *addr, u16 vid);
+int netdev_switch_port_mdb_del(struct net_device *dev,
+			       const unsigned char *addr, u16 vid);
 
 #else
 
@@ -164,6 +178,20 @@ static inline void netdev_switch_fib_ipv4_abort(struct fib_info *fi)
 {
 }
 
+static inline int netdev_switch_port_mdb_add(struct net_device *dev,
+					     const unsigned char *addr,
+					     u16 vid)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int netdev_switch_port_mdb_del(struct net_device *dev,
+					     const unsigned char *addr,
+					     u16 vid)
+{
+	return -EOPNOTSUPP;
+}
+
 #endif
 
 #endif /* _LINUX_SWITCHDEV_H_ */
@@ -104,6 +104,11 @@ void snd_dmaengine_pcm_set_config_from_dai_data(
  * The PCM streams have custom channel names specified.
  */
 #define SND_DMAENGINE_PCM_FLAG_CUSTOM_CHANNEL_NAME BIT(4)
+/*
+ * Preallocate the buffers from the on-chip RAM pool referenced by the "iram"
+ * property of the PCM device node rather than of the DMA controller node.
+ */
+#define SND_DMAENGINE_PCM_FLAG_IRAM BIT(5)
 
 /**
  * struct snd_dmaengine_pcm_config - Configuration data for dmaengine based PCM
@@ -35,6 +35,59 @@ TRACE_EVENT(cma_alloc,
 		  __entry->align)
 );
 
+TRACE_EVENT(cma_alloc_start,
+
+	TP_PROTO(unsigned long base_pfn, unsigned int count,
+		 unsigned int align),
+
+	TP_ARGS(base_pfn, count, align),
+
+	TP_STRUCT__entry(
+		__field(unsigned long, base_pfn)
+		__field(unsigned int, count)
+		__field(unsigned int, align)
+	),
+
+	TP_fast_assign(
+		__entry->base_pfn = base_pfn;
+		__entry->count = count;
+		__entry->align = align;
+	),
+
+	TP_printk("base_pfn=%lx count=%u align=%u",
+		  __entry->base_pfn,
+		  __entry->count,
+		  __entry->align)
+);
+
+TRACE_EVENT(cma_alloc_busy_retry,
+
+	TP_PROTO(unsigned long pfn, const struct page *page,
+		 unsigned int count, unsigned int align),
+
+	TP_ARGS(pfn, page, count, align),
+
+	TP_STRUCT__entry(
+		__field(unsigned long, pfn)
+		__field(const struct page *, page)
+		__field(unsigned int, count)
+		__field(unsigned int, align)
+	),
+
+	TP_fast_assign(
+		__entry->pfn = pfn;
+		__entry->page = page;
+		__entry->count = count;
+		__entry->align = align;
+	),
+
+	TP_printk("pfn=%lx page=%p count=%u align=%u",
+		  __entry->pfn,
+		  __entry->page,
+		  __entry->count,
+		  __entry->align)
+);
+
 TRACE_EVENT(cma_release,
 
 	TP_PROTO(unsigned long pfn, const struct page *page,
@@ -0,0 +1,43 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM of
+
+#if !defined(_TRACE_OF_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_OF_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(of_overlay_apply,
+
+	TP_PROTO(int id, const char *tree, int entries, bool batched,
+		 u64 apply_us, int err),
+
+	TP_ARGS(id, tree, entries, batched, apply_us, err),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__string(tree, tree)
+		__field(int, entries)
+		__field(bool, batched)
+		__field(u64, apply_us)
+		__field(int, err)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__assign_str(tree, tree);
+		__entry->entries = entries;
+		__entry->batched = batched;
+		__entry->apply_us = apply_us;
+		__entry->err = err;
+	),
+
+	TP_printk("overlay %d tree=%s entries=%d%s %lluus (%d)",
+		__entry->id, __get_str(tree), __entry->entries,
+		__entry->batched ? " batched" : "",
+		(unsigned long long)__entry->apply_us, __entry->err)
+);
+
+#endif /* if !defined(_TRACE_OF_H) || defined(TRACE_HEADER_MULTI_READ) */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
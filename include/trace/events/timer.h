@@ -342,6 +342,31 @@ TRACE_EVENT(tick_stop,
 
 	TP_printk("success=%s msg=%s",  __entry->success ? "yes" : "no", __get_str(msg))
 );
+
+/**
+ * tick_nohz_full_irq - called when an interrupt hits a full dynticks CPU
+ * @tickless_ns:	time since the tick was stopped on this CPU
+ *
+ * Fires only while the tick is stopped and the CPU is not idle, so with
+ * the irq and ipi events it accounts for every remaining disturbance of
+ * an isolated CPU.
+ */
+TRACE_EVENT(tick_nohz_full_irq,
+
+	TP_PROTO(s64 tickless_ns),
+
+	TP_ARGS(tickless_ns),
+
+	TP_STRUCT__entry(
+		__field( s64,		tickless_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->tickless_ns	= tickless_ns;
+	),
+
+	TP_printk("tickless_ns=%lld", (long long)__entry->tickless_ns)
+);
 #endif
 
 #endif /*  _TRACE_TIMER_H */
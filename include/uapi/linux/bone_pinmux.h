@@ -0,0 +1,52 @@
+/*
+ * Beaglebone pinmux helper user space interface
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _UAPI_LINUX_BONE_PINMUX_H_
+#define _UAPI_LINUX_BONE_PINMUX_H_
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define BONE_PINMUX_NAME_LEN	32
+#define BONE_PINMUX_MAX_SWITCH	128
+
+/*
+ * One helper to switch: @helper is the name of the helper's device tree
+ * node (for example "P9_12_pinmux") or of its device, @state one of the
+ * names in its pinctrl-names property.
+ */
+struct bone_pinmux_switch {
+	char helper[BONE_PINMUX_NAME_LEN];
+	char state[BONE_PINMUX_NAME_LEN];
+};
+
+/*
+ * Argument of BONE_PINMUX_IOC_SWITCH on /dev/bone_pinmux.  @entries points
+ * to @count struct bone_pinmux_switch.  Either all helpers end up in their
+ * new state or, on error, all of them are left in the state they were in and
+ * @failed holds the index of the entry that could not be resolved or
+ * selected.
+ */
+struct bone_pinmux_switch_set {
+	__u64 entries;
+	__u32 count;
+	__u32 failed;
+};
+
+#define BONE_PINMUX_IOC_MAGIC	0xB8
+
+#define BONE_PINMUX_IOC_SWITCH	_IOWR(BONE_PINMUX_IOC_MAGIC, 0, \
+				      struct bone_pinmux_switch_set)
+
+#endif /* _UAPI_LINUX_BONE_PINMUX_H_ */
@@ -78,6 +78,9 @@ enum {
 	CGW_FILTER,	/* specify struct can_filter on source CAN device */
 	CGW_DELETED,	/* number of deleted CAN frames (see max_hops param) */
 	CGW_LIM_HOPS,	/* limit the number of hops of this specific rule */
+	CGW_HITS,	/* number of CAN frames matching the filter */
+	CGW_LAT_AVG,	/* average rx to tx latency in usecs */
+	CGW_LAT_MAX,	/* maximum rx to tx latency in usecs */
 	__CGW_MAX
 };
 
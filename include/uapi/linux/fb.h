@@ -34,6 +34,7 @@
 #define FBIOPUT_MODEINFO        0x4617
 #define FBIOGET_DISPINFO        0x4618
 #define FBIO_WAITFORVSYNC	_IOW('F', 0x20, __u32)
+#define FBIO_DAMAGE		_IOW('F', 0x21, struct fb_damage)
 
 #define FB_TYPE_PACKED_PIXELS		0	/* Packed Pixels	*/
 #define FB_TYPE_PLANES			1	/* Non interleaved planes */
@@ -333,6 +334,17 @@ struct fb_vblank {
 	__u32 reserved[4];		/* reserved for future compatibility */
 };
 
+/*
+ * Area of the virtual framebuffer that was modified by the application,
+ * in virtual (xres_virtual x yres_virtual) coordinates.
+ */
+struct fb_damage {
+	__u32 x;
+	__u32 y;
+	__u32 width;
+	__u32 height;
+};
+
 /* Internal HW accel */
 #define ROP_COPY 0
 #define ROP_XOR  1
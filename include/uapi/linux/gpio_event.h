@@ -0,0 +1,57 @@
+/*
+ * GPIO edge event capture interface
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+#ifndef _UAPI_LINUX_GPIO_EVENT_H
+#define _UAPI_LINUX_GPIO_EVENT_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* edges of the physical line, regardless of its active low setting */
+#define GPIO_EVENT_RISING_EDGE		(1 << 0)
+#define GPIO_EVENT_FALLING_EDGE		(1 << 1)
+#define GPIO_EVENT_BOTH_EDGES		(GPIO_EVENT_RISING_EDGE | \
+					 GPIO_EVENT_FALLING_EDGE)
+/* set in the first record queued after records were dropped */
+#define GPIO_EVENT_OVERFLOW		(1 << 8)
+
+#define GPIO_EVENT_DEFAULT_QUEUE	256
+#define GPIO_EVENT_MAX_QUEUE		16384
+
+/**
+ * struct gpio_event_request - line to capture on a /dev/gpio-event file
+ * @gpio:	global GPIO number
+ * @flags:	edges to capture, GPIO_EVENT_*_EDGE
+ * @queue_size:	records kept by the kernel, 0 for GPIO_EVENT_DEFAULT_QUEUE,
+ *		rounded up to a power of two
+ * @reserved:	must be zero
+ */
+struct gpio_event_request {
+	__u32 gpio;
+	__u32 flags;
+	__u32 queue_size;
+	__u32 reserved;
+};
+
+/**
+ * struct gpio_event_record - an edge, as returned by read()
+ * @timestamp:	CLOCK_MONOTONIC time of the interrupt in nanoseconds
+ * @gpio:	global GPIO number
+ * @flags:	the edge, GPIO_EVENT_RISING_EDGE or GPIO_EVENT_FALLING_EDGE,
+ *		plus GPIO_EVENT_OVERFLOW if records were lost before this one
+ */
+struct gpio_event_record {
+	__u64 timestamp;
+	__u32 gpio;
+	__u32 flags;
+};
+
+#define GPIO_EVENT_IOC_MAGIC		0xB4
+#define GPIO_EVENT_IOC_REQUEST		_IOW(GPIO_EVENT_IOC_MAGIC, 0x01, \
+					     struct gpio_event_request)
+
+#endif /* _UAPI_LINUX_GPIO_EVENT_H */
@@ -0,0 +1,65 @@
+/* The industrial I/O - block buffer user space interface
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+#ifndef _UAPI_IIO_BUFFER_H_
+#define _UAPI_IIO_BUFFER_H_
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/**
+ * struct iio_buffer_block_alloc_req - Descriptor for allocating IIO blocks
+ * @type:	type of block(s) to allocate (currently unused, reserved)
+ * @size:	size of each block in bytes
+ * @count:	number of blocks to allocate
+ * @id:		returned, identifier of the first allocated block
+ */
+struct iio_buffer_block_alloc_req {
+	__u32 type;
+	__u32 size;
+	__u32 count;
+	__u32 id;
+};
+
+/* @timestamp of the block holds the time it was completed */
+#define IIO_BUFFER_BLOCK_FLAG_TIMESTAMP_VALID	(1 << 0)
+
+/**
+ * struct iio_buffer_block - Descriptor for a single IIO block
+ * @id:		identifier of the block
+ * @size:	size of the block in bytes
+ * @bytes_used:	number of bytes filled with whole scans
+ * @flags:	IIO_BUFFER_BLOCK_FLAG_*
+ * @data.offset: offset to pass to mmap() to map the block
+ * @timestamp:	time the block was completed, if flagged valid
+ *
+ * Blocks cycle between user space and the buffer: ENQUEUE hands a block
+ * to be filled, DEQUEUE returns the next filled one (blocking unless the
+ * file is O_NONBLOCK), QUERY reports a block without changing its owner.
+ */
+struct iio_buffer_block {
+	__u32 id;
+	__u32 size;
+	__u32 bytes_used;
+	__u32 flags;
+	union {
+		__u32 offset;
+	} data;
+	__u32 reserved;
+	__u64 timestamp;
+};
+
+#define IIO_BUFFER_BLOCK_ALLOC_IOCTL	_IOWR('i', 0xa0, \
+					      struct iio_buffer_block_alloc_req)
+#define IIO_BUFFER_BLOCK_FREE_IOCTL	_IO('i', 0xa1)
+#define IIO_BUFFER_BLOCK_QUERY_IOCTL	_IOWR('i', 0xa2, \
+					      struct iio_buffer_block)
+#define IIO_BUFFER_BLOCK_ENQUEUE_IOCTL	_IOWR('i', 0xa3, \
+					      struct iio_buffer_block)
+#define IIO_BUFFER_BLOCK_DEQUEUE_IOCTL	_IOWR('i', 0xa4, \
+					      struct iio_buffer_block)
+
+#endif /* _UAPI_IIO_BUFFER_H_ */
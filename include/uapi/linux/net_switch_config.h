@@ -71,4 +71,16 @@ struct net_switch_config {
 	unsigned int ret_type;   /* Return  Success/Failure */
 };
 
+/*
+ * Early rx filter: SIOCSWITCHRXFILTER with ifr_data pointing to a struct
+ * sock_fprog attaches a classic BPF program to the port, run on every
+ * received frame from its ethernet header on.  A zero length program
+ * detaches.  The program returns one of the verdicts below, any other
+ * value passes the frame up the stack.
+ */
+#define SIOCSWITCHRXFILTER	(SIOCDEVPRIVATE + 0)
+
+#define SWITCH_RX_FILTER_DROP		0
+#define SWITCH_RX_FILTER_REDIRECT	0xfffffffe	/* out the other port */
+
 #endif /* __NET_CONFIG_SWITCH_H__*/
@@ -0,0 +1,62 @@
+/*
+ * PWM character device interface, /dev/pwmchipN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#ifndef _UAPI_LINUX_PWMCHIP_H
+#define _UAPI_LINUX_PWMCHIP_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define PWMCHIP_POLARITY_NORMAL		0
+#define PWMCHIP_POLARITY_INVERSED	1
+
+/**
+ * struct pwmchip_state - complete state of one PWM channel
+ * @hwpwm: channel index within the chip
+ * @period: period in nanoseconds
+ * @duty_cycle: "on" time in nanoseconds
+ * @polarity: PWMCHIP_POLARITY_NORMAL or PWMCHIP_POLARITY_INVERSED
+ * @enabled: 1 to run the output, 0 to stop it
+ * @reserved: must be zero
+ *
+ * A channel is requested by the file the first time it is set and stays
+ * owned by it until the file is closed, so it can be neither exported
+ * through sysfs nor used by a kernel consumer meanwhile.
+ */
+struct pwmchip_state {
+	__u32 hwpwm;
+	__u32 period;
+	__u32 duty_cycle;
+	__u32 polarity;
+	__u32 enabled;
+	__u32 reserved;
+};
+
+/**
+ * struct pwmchip_states - states of several channels of the chip
+ * @num: number of entries at @states, at most the number of channels
+ * @reserved: must be zero
+ * @states: user pointer to an array of struct pwmchip_state
+ *
+ * When the chip supports grouped updates the new periods and duty cycles of
+ * all entries reach the outputs on the same period boundary.
+ */
+struct pwmchip_states {
+	__u32 num;
+	__u32 reserved;
+	__u64 states;
+};
+
+#define PWMCHIP_IOC_MAGIC	0xB5
+
+#define PWMCHIP_IOC_SET_STATE	_IOW(PWMCHIP_IOC_MAGIC, 0x01, \
+				     struct pwmchip_state)
+#define PWMCHIP_IOC_SET_STATES	_IOW(PWMCHIP_IOC_MAGIC, 0x02, \
+				     struct pwmchip_states)
+
+#endif /* _UAPI_LINUX_PWMCHIP_H */
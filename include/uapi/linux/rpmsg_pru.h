@@ -0,0 +1,50 @@
+/*
+ * PRU Remote Processor Messaging Driver
+ *
+ * Copyright (C) 2015 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _UAPI_LINUX_RPMSG_PRU_H_
+#define _UAPI_LINUX_RPMSG_PRU_H_
+
+#include <linux/types.h>
+
+/*
+ * Layout of the receive ring exported through mmap() of /dev/rpmsg_pruN.
+ *
+ * The first page holds struct rpmsg_pru_ring, the message slots follow at
+ * offset @slot_offset, each @slot_size bytes long and starting with a
+ * struct rpmsg_pru_slot.  @head and @tail are free running counters, the
+ * slot of a counter value is (value & (@slot_count - 1)).
+ *
+ * The kernel is the only writer of @head and advances it after the slot
+ * contents are visible.  User space is the only writer of @tail and
+ * advances it once it is done with a slot.  The ring is empty when
+ * @head == @tail, messages arriving while it is full are dropped and
+ * counted in the rx_dropped sysfs attribute of the device.  read() consumes
+ * from the same ring, so a reader should use either read() or the mapping.
+ */
+struct rpmsg_pru_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 slot_count;
+	__u32 slot_size;
+	__u32 slot_offset;
+	__u32 reserved[3];
+};
+
+struct rpmsg_pru_slot {
+	__u32 len;
+	__u8 data[0];
+};
+
+#endif /* _UAPI_LINUX_RPMSG_PRU_H_ */
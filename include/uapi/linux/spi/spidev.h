@@ -136,6 +136,60 @@ struct spi_ioc_transfer {
 #define SPI_IOC_RD_MODE32		_IOR(SPI_IOC_MAGIC, 5, __u32)
 #define SPI_IOC_WR_MODE32		_IOW(SPI_IOC_MAGIC, 5, __u32)
 
+/**
+ * struct spi_ioc_async - queues one message without waiting for it
+ * @user_data: Returned unchanged in the completion of this message.
+ * @transfers: Pointer to an array of @n_transfers struct spi_ioc_transfer.
+ * @n_transfers: Number of transfers in the message.
+ * @pad: Must be zero.
+ *
+ * SPI_IOC_ASYNC_SUBMIT gives userspace the equivalent of kernel spi_async().
+ * The data is not copied: the tx_buf and rx_buf fields of each transfer are
+ * byte offsets into the buffer area obtained by mmap() of the device node,
+ * or SPI_IOC_ASYNC_NO_BUF when the transfer has no data in that direction.
+ * The buffers of a message belong to the controller until its completion
+ * has been read.
+ *
+ * The first file descriptor to map the buffer area or to submit a message
+ * owns the asynchronous interface until it is closed; other descriptors get
+ * -EBUSY.  On the owner read() no longer clocks data in, it returns one
+ * struct spi_ioc_async_completion per finished message, and poll() reports
+ * POLLIN while completions are pending and POLLOUT while more messages can
+ * be queued.  Messages complete in submission order.
+ *
+ *	struct spi_ioc_transfer xfer[2];
+ *	struct spi_ioc_async async = {
+ *		.user_data = 1,
+ *		.transfers = (uintptr_t)xfer,
+ *		.n_transfers = 2,
+ *	};
+ *	...
+ *	status = ioctl(fd, SPI_IOC_ASYNC_SUBMIT, &async);
+ */
+struct spi_ioc_async {
+	__u64		user_data;
+	__u64		transfers;
+	__u32		n_transfers;
+	__u32		pad;
+};
+
+/**
+ * struct spi_ioc_async_completion - result of an asynchronous message
+ * @user_data: Copied from the submitted struct spi_ioc_async.
+ * @status: Zero on success, else a negative errno.
+ * @actual_length: Number of bytes transferred.
+ */
+struct spi_ioc_async_completion {
+	__u64		user_data;
+	__s32		status;
+	__u32		actual_length;
+};
+
+#define SPI_IOC_ASYNC_NO_BUF		(~(__u64)0)
+
+#define SPI_IOC_ASYNC_SUBMIT \
+	_IOW(SPI_IOC_MAGIC, 6, struct spi_ioc_async)
+
 
 
 #endif /* SPIDEV_H */
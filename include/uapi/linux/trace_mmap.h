@@ -0,0 +1,50 @@
+#ifndef _UAPI_TRACE_MMAP_H_
+#define _UAPI_TRACE_MMAP_H_
+
+#include <linux/types.h>
+
+/**
+ * struct trace_buffer_meta - Ring-buffer meta-page description
+ * @meta_page_size:	Size of this meta-page.
+ * @meta_struct_len:	Size of this structure.
+ * @subbuf_size:	Size of each sub-buffer, header included.
+ * @nr_subbufs:		Number of sub-buffers in the ring-buffer, including
+ *			the reader one.
+ * @reader.lost_events:	Events lost before the reader sub-buffer.
+ * @reader.id:		ID of the sub-buffer handed to the reader.
+ * @reader.read:	Bytes of the reader sub-buffer handed to the reader.
+ * @entries:		Number of entries written to the ring-buffer.
+ * @overrun:		Number of entries lost in the ring-buffer.
+ * @read:		Number of entries that have been consumed.
+ *
+ * The meta-page is the first page of the mapping and sub-buffer @id
+ * follows at page offset 1 + @id. A sub-buffer has the layout given by
+ * events/header_page.
+ *
+ * After mmap(), the reader owns the bytes of @reader.id before
+ * @reader.read. Once it has consumed them it calls
+ * TRACE_MMAP_IOCTL_GET_READER, which hands over whatever the writer
+ * added since, or swaps in the next sub-buffer full of events. On a new
+ * @reader.id, data starts at offset 0.
+ */
+struct trace_buffer_meta {
+	__u32		meta_page_size;
+	__u32		meta_struct_len;
+
+	__u32		subbuf_size;
+	__u32		nr_subbufs;
+
+	struct {
+		__u64	lost_events;
+		__u32	id;
+		__u32	read;
+	} reader;
+
+	__u64		entries;
+	__u64		overrun;
+	__u64		read;
+};
+
+#define TRACE_MMAP_IOCTL_GET_READER		_IO('T', 0x1)
+
+#endif /* _UAPI_TRACE_MMAP_H_ */
@@ -0,0 +1,66 @@
+/*
+ * PRUSS UIO driver user space interface
+ *
+ * Copyright (C) 2015 Texas Instruments Incorporated - http://www.ti.com/
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation version 2.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _UAPI_LINUX_UIO_PRUSS_H_
+#define _UAPI_LINUX_UIO_PRUSS_H_
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * The DDR region shared with the PRUs is the last memory map of every
+ * pruss_evtN UIO device.  When uio_pruss is loaded with extram_cached=1 the
+ * region is mapped cacheable and user space has to bracket its accesses with
+ * UIO_PRUSS_IOC_DDR_SYNC on /dev/pruss_ddr: UIO_PRUSS_SYNC_FOR_CPU before
+ * reading data the PRUs wrote, UIO_PRUSS_SYNC_FOR_DEVICE after writing data
+ * the PRUs are going to read.  For an uncached region the sync is a no-op.
+ */
+#define UIO_PRUSS_DDR_CACHED	(1 << 0)
+
+struct uio_pruss_ddr_info {
+	__u64 paddr;		/* address of the region as seen by the PRUs */
+	__u32 size;
+	__u32 flags;		/* UIO_PRUSS_DDR_* */
+};
+
+#define UIO_PRUSS_SYNC_FOR_CPU		0
+#define UIO_PRUSS_SYNC_FOR_DEVICE	1
+
+struct uio_pruss_ddr_sync {
+	__u32 offset;
+	__u32 size;
+	__u32 dir;		/* UIO_PRUSS_SYNC_* */
+	__u32 reserved;
+};
+
+/*
+ * Exports the whole region as a dma-buf so that other drivers can import
+ * it.  @flags accepts O_CLOEXEC, the new file descriptor is returned in @fd.
+ */
+struct uio_pruss_ddr_export {
+	__u32 flags;
+	__s32 fd;
+};
+
+#define UIO_PRUSS_IOC_MAGIC	0xB7
+
+#define UIO_PRUSS_IOC_DDR_INFO	_IOR(UIO_PRUSS_IOC_MAGIC, 0, \
+				     struct uio_pruss_ddr_info)
+#define UIO_PRUSS_IOC_DDR_SYNC	_IOW(UIO_PRUSS_IOC_MAGIC, 1, \
+				     struct uio_pruss_ddr_sync)
+#define UIO_PRUSS_IOC_DDR_EXPORT _IOWR(UIO_PRUSS_IOC_MAGIC, 2, \
+				      struct uio_pruss_ddr_export)
+
+#endif /* _UAPI_LINUX_UIO_PRUSS_H_ */
@@ -18,6 +18,7 @@
 #include <linux/dirent.h>
 #include <linux/syscalls.h>
 #include <linux/utime.h>
+#include <linux/async.h>
 
 static ssize_t __init xwrite(int fd, const char *p, size_t count)
 {
@@ -605,7 +606,46 @@ static void __init clean_rootfs(void)
 }
 #endif
 
-static int __init populate_rootfs(void)
+/*
+ * Unpacking a large compressed initramfs takes long enough to hold up
+ * driver probing, so by default it runs asynchronously and whatever
+ * needs rootfs content waits for it with wait_for_initramfs().
+ */
+static bool initramfs_async = true;
+
+static int __init initramfs_async_setup(char *str)
+{
+	strtobool(str, &initramfs_async);
+	return 1;
+}
+__setup("initramfs_async=", initramfs_async_setup);
+
+static ASYNC_DOMAIN(initramfs_domain);
+static async_cookie_t initramfs_cookie;
+static bool initramfs_scheduled;
+static bool initramfs_load_modules __initdata;
+
+/**
+ * wait_for_initramfs - wait until rootfs holds the initramfs content
+ *
+ * To be called before looking up files on rootfs during boot: the
+ * firmware loader, usermode helpers and the exec of init do.
+ */
+void wait_for_initramfs(void)
+{
+	/*
+	 * Before rootfs_initcall there is nothing to wait for; let the
+	 * lookup fail as it always did.
+	 */
+	if (!initramfs_scheduled)
+		return;
+
+	async_synchronize_cookie_domain(initramfs_cookie + 1,
+					&initramfs_domain);
+}
+EXPORT_SYMBOL_GPL(wait_for_initramfs);
+
+static void __init do_populate_rootfs(void *unused, async_cookie_t cookie)
 {
 	char *err = unpack_to_rootfs(__initramfs_start, __initramfs_size);
 	if (err)
@@ -647,12 +687,47 @@ static int __init populate_rootfs(void)
 			printk(KERN_EMERG "Initramfs unpacking failed: %s\n", err);
 		free_initrd();
 #endif
-		/*
-		 * Try loading default modules from initramfs.  This gives
-		 * us a chance to load before device_initcalls.
-		 */
+		initramfs_load_modules = true;
+	}
+}
+
+static void __init initramfs_load_default_modules(void)
+{
+	/*
+	 * Try loading default modules from initramfs.  This gives
+	 * us a chance to load before device_initcalls.
+	 */
+	if (initramfs_load_modules)
 		load_default_modules();
+}
+
+static int __init populate_rootfs(void)
+{
+	if (!initramfs_async) {
+		do_populate_rootfs(NULL, 0);
+		initramfs_scheduled = true;
+		initramfs_load_default_modules();
+		return 0;
 	}
+
+	initramfs_cookie = async_schedule_domain(do_populate_rootfs, NULL,
+						 &initramfs_domain);
+	initramfs_scheduled = true;
 	return 0;
 }
 rootfs_initcall(populate_rootfs);
+
+/*
+ * request_module() must not wait from async context, so the default
+ * modules of an asynchronously unpacked initramfs are loaded once the
+ * device initcalls are done with.
+ */
+static int __init initramfs_async_done(void)
+{
+	if (initramfs_async) {
+		wait_for_initramfs();
+		initramfs_load_default_modules();
+	}
+	return 0;
+}
+late_initcall(initramfs_async_done);
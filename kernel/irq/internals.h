@@ -114,6 +114,12 @@ extern int irq_select_affinity_usr(unsigned int irq, struct cpumask *mask);
 
 extern void irq_set_thread_affinity(struct irq_desc *desc);
 
+extern int irq_thread_policy_parse(const char *str);
+extern const char *irq_thread_policy_name(int policy);
+extern void irq_get_thread_sched(struct irq_desc *desc, int *policy,
+				 int *prio);
+extern int irq_set_thread_sched(struct irq_desc *desc, int policy, int prio);
+
 extern int irq_do_set_affinity(struct irq_data *data,
 			       const struct cpumask *dest, bool force);
 
@@ -32,6 +32,202 @@ static int __init setup_forced_irqthreads(char *arg)
 early_param("threadirqs", setup_forced_irqthreads);
 #endif
 
+/*
+ * Handler threads run SCHED_FIFO at MAX_USER_RT_PRIO/2, unless
+ * irqthread_sched= or /proc/irq/<irq>/thread_{policy,priority} say
+ * otherwise:
+ *
+ *	irqthread_sched=<irq|name>:<fifo|rr|other>:<priority>[,...]
+ *
+ * where name is the name the driver requested the interrupt with, which
+ * unlike the irq number does not depend on probe order.  Settings made
+ * through /proc take precedence and survive the handler being freed and
+ * requested again.
+ */
+#define IRQ_THREAD_SCHED_MAX	16
+
+struct irq_thread_sched {
+	const char	*match;
+	int		policy;
+	int		prio;
+};
+
+static char irq_thread_sched_buf[256];
+static struct irq_thread_sched irq_thread_sched_cmdline[IRQ_THREAD_SCHED_MAX];
+static int irq_thread_sched_count;
+
+int irq_thread_policy_parse(const char *str)
+{
+	if (sysfs_streq(str, "fifo"))
+		return SCHED_FIFO;
+	if (sysfs_streq(str, "rr"))
+		return SCHED_RR;
+	if (sysfs_streq(str, "other"))
+		return SCHED_NORMAL;
+	return -EINVAL;
+}
+
+const char *irq_thread_policy_name(int policy)
+{
+	switch (policy) {
+	case SCHED_FIFO:
+		return "fifo";
+	case SCHED_RR:
+		return "rr";
+	default:
+		return "other";
+	}
+}
+
+/* Real time policies need a priority, SCHED_NORMAL takes none */
+static bool irq_thread_sched_valid(int policy, int prio)
+{
+	if (policy == SCHED_NORMAL)
+		return prio == 0;
+	return prio > 0 && prio < MAX_USER_RT_PRIO;
+}
+
+static bool __init irq_thread_sched_parse(char *entry,
+					  struct irq_thread_sched *s)
+{
+	char *policy;
+
+	s->match = strsep(&entry, ":");
+	policy = strsep(&entry, ":");
+	if (!*s->match || !policy || !entry)
+		return false;
+
+	s->policy = irq_thread_policy_parse(policy);
+	if (s->policy < 0 || kstrtoint(entry, 0, &s->prio))
+		return false;
+
+	return irq_thread_sched_valid(s->policy, s->prio);
+}
+
+static int __init setup_irq_thread_sched(char *str)
+{
+	char *entry, *p = irq_thread_sched_buf;
+
+	strlcpy(irq_thread_sched_buf, str, sizeof(irq_thread_sched_buf));
+
+	while ((entry = strsep(&p, ",")) != NULL) {
+		struct irq_thread_sched *s;
+
+		if (irq_thread_sched_count == IRQ_THREAD_SCHED_MAX) {
+			pr_warn("irqthread_sched: too many entries\n");
+			break;
+		}
+
+		s = &irq_thread_sched_cmdline[irq_thread_sched_count];
+		if (irq_thread_sched_parse(entry, s))
+			irq_thread_sched_count++;
+		else
+			pr_warn("irqthread_sched: ignoring bad entry\n");
+	}
+
+	return 1;
+}
+__setup("irqthread_sched=", setup_irq_thread_sched);
+
+/* The scheduling of @action's thread; @action may be NULL */
+static void irq_thread_sched_get(struct irq_desc *desc,
+				 struct irqaction *action,
+				 int *policy, int *prio)
+{
+	unsigned int irq;
+	int i;
+
+	if (desc->thread_policy >= 0) {
+		*policy = desc->thread_policy;
+		*prio = desc->thread_prio;
+		return;
+	}
+
+	for (i = 0; action && i < irq_thread_sched_count; i++) {
+		const struct irq_thread_sched *s = &irq_thread_sched_cmdline[i];
+
+		if ((action->name && !strcmp(s->match, action->name)) ||
+		    (!kstrtouint(s->match, 10, &irq) && irq == action->irq)) {
+			*policy = s->policy;
+			*prio = s->prio;
+			return;
+		}
+	}
+
+	*policy = SCHED_FIFO;
+	*prio = MAX_USER_RT_PRIO/2;
+}
+
+/**
+ * irq_get_thread_sched - get the scheduling of an interrupt's threads
+ * @desc:	the interrupt descriptor
+ * @policy:	returns the scheduling policy
+ * @prio:	returns the real time priority, 0 for SCHED_NORMAL
+ *
+ * Returns what an explicit setting or irqthread_sched= gives the first
+ * handler; shared handlers matched by name may differ.
+ */
+void irq_get_thread_sched(struct irq_desc *desc, int *policy, int *prio)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&desc->lock, flags);
+	irq_thread_sched_get(desc, desc->action, policy, prio);
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+}
+
+/**
+ * irq_set_thread_sched - set the scheduling of an interrupt's threads
+ * @desc:	the interrupt descriptor
+ * @policy:	SCHED_FIFO, SCHED_RR or SCHED_NORMAL
+ * @prio:	real time priority, 0 for SCHED_NORMAL
+ *
+ * Applies to the running handler threads of the interrupt, and to the
+ * ones created later.
+ */
+int irq_set_thread_sched(struct irq_desc *desc, int policy, int prio)
+{
+	struct sched_param param = { .sched_priority = prio };
+	struct irqaction *action;
+	struct task_struct *t;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!irq_thread_sched_valid(policy, prio))
+		return -EINVAL;
+
+	raw_spin_lock_irqsave(&desc->lock, flags);
+	desc->thread_policy = policy;
+	desc->thread_prio = prio;
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+
+	/*
+	 * sched_setscheduler() cannot be called under desc->lock, so pick
+	 * the threads not yet updated one at a time.
+	 */
+	do {
+		t = NULL;
+		raw_spin_lock_irqsave(&desc->lock, flags);
+		for (action = desc->action; action; action = action->next) {
+			if (action->thread &&
+			    (action->thread->policy != policy ||
+			     action->thread->rt_priority != prio)) {
+				t = action->thread;
+				get_task_struct(t);
+				break;
+			}
+		}
+		raw_spin_unlock_irqrestore(&desc->lock, flags);
+
+		if (t) {
+			ret = sched_setscheduler_nocheck(t, policy, &param);
+			put_task_struct(t);
+		}
+	} while (t && !ret);
+
+	return ret;
+}
+
 static void __synchronize_hardirq(struct irq_desc *desc)
 {
 	bool inprogress;
@@ -1032,9 +1228,8 @@ __setup_irq(unsigned int irq, struct irq_desc *desc, struct irqaction *new)
 	 */
 	if (new->thread_fn && !nested) {
 		struct task_struct *t;
-		static const struct sched_param param = {
-			.sched_priority = MAX_USER_RT_PRIO/2,
-		};
+		struct sched_param param;
+		int policy;
 
 		t = kthread_create(irq_thread, new, "irq/%d-%s", irq,
 				   new->name);
@@ -1043,7 +1238,9 @@ __setup_irq(unsigned int irq, struct irq_desc *desc, struct irqaction *new)
 			goto out_mput;
 		}
 
-		sched_setscheduler_nocheck(t, SCHED_FIFO, &param);
+		irq_thread_sched_get(desc, new, &policy,
+				     &param.sched_priority);
+		sched_setscheduler_nocheck(t, policy, &param);
 
 		/*
 		 * We keep the reference to the task struct even if
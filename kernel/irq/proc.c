@@ -13,6 +13,7 @@
 #include <linux/interrupt.h>
 #include <linux/kernel_stat.h>
 #include <linux/mutex.h>
+#include <linux/uaccess.h>
 
 #include "internals.h"
 
@@ -281,6 +282,97 @@ static const struct file_operations irq_spurious_proc_fops = {
 	.release	= single_release,
 };
 
+static int irq_thread_policy_proc_show(struct seq_file *m, void *v)
+{
+	struct irq_desc *desc = irq_to_desc((long) m->private);
+	int policy, prio;
+
+	irq_get_thread_sched(desc, &policy, &prio);
+	seq_printf(m, "%s\n", irq_thread_policy_name(policy));
+	return 0;
+}
+
+static ssize_t irq_thread_policy_proc_write(struct file *file,
+		const char __user *buffer, size_t count, loff_t *pos)
+{
+	struct irq_desc *desc = irq_to_desc((long)PDE_DATA(file_inode(file)));
+	int policy, old_policy, prio, err;
+	char buf[8];
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, buffer, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	policy = irq_thread_policy_parse(buf);
+	if (policy < 0)
+		return policy;
+
+	/* keep the priority when switching between real time policies */
+	irq_get_thread_sched(desc, &old_policy, &prio);
+	if (policy == SCHED_NORMAL)
+		prio = 0;
+	else if (!prio)
+		prio = MAX_USER_RT_PRIO/2;
+
+	err = irq_set_thread_sched(desc, policy, prio);
+	return err ? err : count;
+}
+
+static int irq_thread_policy_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, irq_thread_policy_proc_show, PDE_DATA(inode));
+}
+
+static const struct file_operations irq_thread_policy_proc_fops = {
+	.open		= irq_thread_policy_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+	.write		= irq_thread_policy_proc_write,
+};
+
+static int irq_thread_priority_proc_show(struct seq_file *m, void *v)
+{
+	struct irq_desc *desc = irq_to_desc((long) m->private);
+	int policy, prio;
+
+	irq_get_thread_sched(desc, &policy, &prio);
+	seq_printf(m, "%d\n", prio);
+	return 0;
+}
+
+static ssize_t irq_thread_priority_proc_write(struct file *file,
+		const char __user *buffer, size_t count, loff_t *pos)
+{
+	struct irq_desc *desc = irq_to_desc((long)PDE_DATA(file_inode(file)));
+	int policy, old_prio, prio, err;
+
+	err = kstrtoint_from_user(buffer, count, 0, &prio);
+	if (err)
+		return err;
+
+	irq_get_thread_sched(desc, &policy, &old_prio);
+	err = irq_set_thread_sched(desc, policy, prio);
+	return err ? err : count;
+}
+
+static int irq_thread_priority_proc_open(struct inode *inode,
+					 struct file *file)
+{
+	return single_open(file, irq_thread_priority_proc_show,
+			   PDE_DATA(inode));
+}
+
+static const struct file_operations irq_thread_priority_proc_fops = {
+	.open		= irq_thread_priority_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+	.write		= irq_thread_priority_proc_write,
+};
+
 #define MAX_NAMELEN 128
 
 static int name_unique(unsigned int irq, struct irqaction *new_action)
@@ -368,6 +460,12 @@ void register_irq_proc(unsigned int irq, struct irq_desc *desc)
 	proc_create_data("spurious", 0444, desc->dir,
 			 &irq_spurious_proc_fops, (void *)(long)irq);
 
+	/* create /proc/irq/<irq>/thread_{policy,priority} */
+	proc_create_data("thread_policy", 0644, desc->dir,
+			 &irq_thread_policy_proc_fops, (void *)(long)irq);
+	proc_create_data("thread_priority", 0644, desc->dir,
+			 &irq_thread_priority_proc_fops, (void *)(long)irq);
+
 out_unlock:
 	mutex_unlock(&register_lock);
 }
@@ -385,6 +483,8 @@ void unregister_irq_proc(unsigned int irq, struct irq_desc *desc)
 	remove_proc_entry("node", desc->dir);
 #endif
 	remove_proc_entry("spurious", desc->dir);
+	remove_proc_entry("thread_policy", desc->dir);
+	remove_proc_entry("thread_priority", desc->dir);
 
 	memset(name, 0, MAX_NAMELEN);
 	sprintf(name, "%u", irq);
@@ -39,6 +39,7 @@
 #include <linux/rwsem.h>
 #include <linux/ptrace.h>
 #include <linux/async.h>
+#include <linux/initrd.h>
 #include <asm/uaccess.h>
 
 #include <trace/events/module.h>
@@ -253,6 +254,9 @@ static int ____call_usermodehelper(void *data)
 
 	commit_creds(new);
 
+	/* Helpers run early in boot may live in the initramfs */
+	wait_for_initramfs();
+
 	retval = do_execve(getname_kernel(sub_info->path),
 			   (const char __user *const __user *)sub_info->argv,
 			   (const char __user *const __user *)sub_info->envp);
@@ -10,3 +10,14 @@
  */
 
 extern int mod_verify_sig(const void *mod, unsigned long *_modlen);
+
+#ifdef CONFIG_MODULE_DECOMPRESS
+extern int module_decompress(const void *in, unsigned long in_len,
+			     void **out, unsigned long *out_len);
+#else
+static inline int module_decompress(const void *in, unsigned long in_len,
+				    void **out, unsigned long *out_len)
+{
+	return -EOPNOTSUPP;
+}
+#endif
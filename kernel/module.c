@@ -2586,6 +2586,23 @@ static void free_copy(struct load_info *info)
 	vfree(info->hdr);
 }
 
+/* Replaces info->hdr and info->len, or frees the copy on error. */
+static int module_decompress_copy(struct load_info *info)
+{
+	void *hdr;
+	unsigned long len;
+	int err;
+
+	err = module_decompress(info->hdr, info->len, &hdr, &len);
+	free_copy(info);
+	if (err)
+		return err;
+
+	info->hdr = hdr;
+	info->len = len;
+	return 0;
+}
+
 static int rewrite_section_headers(struct load_info *info, int flags)
 {
 	unsigned int i;
@@ -3255,6 +3272,11 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	long err;
 	char *after_dashes;
 
+	/*
+	 * The signature check is the costly part of the checks; like
+	 * decompression it runs before add_unformed_module() takes
+	 * module_mutex, so different modules are verified in parallel.
+	 */
 	err = module_sig_check(info);
 	if (err)
 		goto free_copy;
@@ -3437,13 +3459,20 @@ SYSCALL_DEFINE3(finit_module, int, fd, const char __user *, uargs, int, flags)
 	pr_debug("finit_module: fd=%d, uargs=%p, flags=%i\n", fd, uargs, flags);
 
 	if (flags & ~(MODULE_INIT_IGNORE_MODVERSIONS
-		      |MODULE_INIT_IGNORE_VERMAGIC))
+		      |MODULE_INIT_IGNORE_VERMAGIC
+		      |MODULE_INIT_COMPRESSED_FILE))
 		return -EINVAL;
 
 	err = copy_module_from_fd(fd, &info);
 	if (err)
 		return err;
 
+	if (flags & MODULE_INIT_COMPRESSED_FILE) {
+		err = module_decompress_copy(&info);
+		if (err)
+			return err;
+	}
+
 	return load_module(&info, uargs, flags);
 }
 
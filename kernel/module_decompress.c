@@ -0,0 +1,255 @@
+/* In-kernel decompression of compressed modules
+ *
+ * finit_module(MODULE_INIT_COMPRESSED_FILE) hands over the module file as
+ * it is stored, compressed with xz or with lz4 in its legacy format
+ * ("lz4 -l"). It is inflated here, before the signature check and before
+ * module_mutex is taken, so that parallel loads stay parallel.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public Licence
+ * as published by the Free Software Foundation; either version
+ * 2 of the Licence, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/sysfs.h>
+#include <linux/init.h>
+#include <linux/lz4.h>
+#include <linux/xz.h>
+#include <asm/unaligned.h>
+#include "module-internal.h"
+
+/* Largest module we agree to inflate */
+#define MODULE_DECOMPRESS_MAX	(64 << 20)
+
+/* Largest xz dictionary, as used by "xz --lzma2=dict=8MiB" or -6 */
+#define MODULE_XZ_DICT_MAX	(8 << 20)
+
+static const u8 xz_magic[] = { 0xfd, '7', 'z', 'X', 'Z', 0x00 };
+
+#define LZ4_LEGACY_MAGIC	0x184c2102
+/* Blocks of the legacy format inflate to at most this */
+#define LZ4_LEGACY_BLOCK_SIZE	(8 << 20)
+
+/*
+ * Double the output buffer. On failure the old buffer is left to the
+ * caller to free.
+ */
+static void *module_decompress_grow(void *buf, size_t used, size_t *size)
+{
+	size_t new_size = *size * 2;
+	void *new;
+
+	if (new_size > MODULE_DECOMPRESS_MAX)
+		return NULL;
+
+	new = vmalloc(new_size);
+	if (!new)
+		return NULL;
+
+	memcpy(new, buf, used);
+	vfree(buf);
+	*size = new_size;
+	return new;
+}
+
+#ifdef CONFIG_XZ_DEC
+static int module_unxz(const void *in, size_t in_len,
+		       void **out, unsigned long *out_len)
+{
+	struct xz_dec *s;
+	struct xz_buf b;
+	enum xz_ret ret;
+	size_t size = max_t(size_t, in_len * 4, PAGE_SIZE);
+	void *buf, *new;
+	int err;
+
+	buf = vmalloc(size);
+	if (!buf)
+		return -ENOMEM;
+
+	s = xz_dec_init(XZ_DYNALLOC, MODULE_XZ_DICT_MAX);
+	if (!s) {
+		vfree(buf);
+		return -ENOMEM;
+	}
+
+	b.in = in;
+	b.in_pos = 0;
+	b.in_size = in_len;
+	b.out = buf;
+	b.out_pos = 0;
+	b.out_size = size;
+
+	do {
+		ret = xz_dec_run(s, &b);
+		if (ret == XZ_OK && b.out_pos == b.out_size) {
+			new = module_decompress_grow(buf, b.out_pos, &size);
+			if (!new) {
+				ret = XZ_MEM_ERROR;
+				break;
+			}
+			buf = new;
+			b.out = buf;
+			b.out_size = size;
+		}
+	} while (ret == XZ_OK);
+
+	xz_dec_end(s);
+
+	switch (ret) {
+	case XZ_STREAM_END:
+		*out = buf;
+		*out_len = b.out_pos;
+		return 0;
+	case XZ_MEM_ERROR:
+		err = -ENOMEM;
+		break;
+	case XZ_MEMLIMIT_ERROR:
+		pr_err("module: xz dictionary larger than %u bytes\n",
+		       MODULE_XZ_DICT_MAX);
+		err = -E2BIG;
+		break;
+	case XZ_OPTIONS_ERROR:
+		pr_err("module: unsupported xz options, use --check=crc32\n");
+		err = -EOPNOTSUPP;
+		break;
+	default:
+		err = -ENOEXEC;
+		break;
+	}
+
+	vfree(buf);
+	return err;
+}
+#else
+static int module_unxz(const void *in, size_t in_len,
+		       void **out, unsigned long *out_len)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+#ifdef CONFIG_LZ4_DECOMPRESS
+static int module_unlz4(const void *in, size_t in_len,
+			void **out, unsigned long *out_len)
+{
+	const u8 *p = in + 4, *end = in + in_len;
+	size_t size = max_t(size_t, in_len * 4, PAGE_SIZE);
+	size_t pos = 0, dest_len;
+	void *buf, *new;
+	u32 chunk;
+
+	buf = vmalloc(size);
+	if (!buf)
+		return -ENOMEM;
+
+	while (end - p >= 4) {
+		chunk = get_unaligned_le32(p);
+		p += 4;
+
+		/* Concatenated streams start over with the magic */
+		if (chunk == LZ4_LEGACY_MAGIC)
+			continue;
+
+		if (chunk > (size_t)(end - p))
+			goto corrupt;
+
+		for (;;) {
+			dest_len = size - pos;
+			if (!lz4_decompress_unknownoutputsize(p, chunk,
+							      buf + pos,
+							      &dest_len))
+				break;
+
+			/* A block that does not fit this is corrupt */
+			if (size - pos >= LZ4_LEGACY_BLOCK_SIZE)
+				goto corrupt;
+
+			new = module_decompress_grow(buf, pos, &size);
+			if (!new) {
+				vfree(buf);
+				return -ENOMEM;
+			}
+			buf = new;
+		}
+
+		pos += dest_len;
+		p += chunk;
+	}
+
+	if (p != end)
+		goto corrupt;
+
+	*out = buf;
+	*out_len = pos;
+	return 0;
+
+ corrupt:
+	vfree(buf);
+	return -ENOEXEC;
+}
+#else
+static int module_unlz4(const void *in, size_t in_len,
+			void **out, unsigned long *out_len)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+/**
+ * module_decompress - inflate a compressed module image
+ * @in: the compressed image
+ * @in_len: its length
+ * @out: set to a vmalloc()ed buffer holding the module
+ * @out_len: set to the length of the module
+ *
+ * The format is told by its magic. Returns 0 or a negative errno, in
+ * which case nothing is allocated.
+ */
+int module_decompress(const void *in, unsigned long in_len,
+		      void **out, unsigned long *out_len)
+{
+	if (in_len >= sizeof(xz_magic) &&
+	    !memcmp(in, xz_magic, sizeof(xz_magic)))
+		return module_unxz(in, in_len, out, out_len);
+
+	if (in_len >= 4 && get_unaligned_le32(in) == LZ4_LEGACY_MAGIC)
+		return module_unlz4(in, in_len, out, out_len);
+
+	return -ENOEXEC;
+}
+
+/* Lets kmod know which formats it may hand to the kernel */
+static ssize_t compression_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len = 0;
+
+	if (IS_ENABLED(CONFIG_XZ_DEC))
+		len += sprintf(buf + len, "xz ");
+	if (IS_ENABLED(CONFIG_LZ4_DECOMPRESS))
+		len += sprintf(buf + len, "lz4 ");
+	if (len)
+		buf[len - 1] = '\n';
+
+	return len;
+}
+
+static struct kobj_attribute module_compression_attr = __ATTR_RO(compression);
+
+static int __init module_decompress_sysfs_init(void)
+{
+	int err;
+
+	err = sysfs_create_file(&module_kset->kobj,
+				&module_compression_attr.attr);
+	if (err)
+		pr_warn("Failed to create 'compression' attribute\n");
+
+	return 0;
+}
+late_initcall(module_decompress_sysfs_init);
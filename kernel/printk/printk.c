@@ -43,6 +43,8 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
+#include <linux/reboot.h>
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
@@ -1390,11 +1392,13 @@ SYSCALL_DEFINE3(syslog, int, type, char __user *, buf, int, len)
  * log_buf[start] to log_buf[end - 1].
  * The console_lock must be held.
  */
-static void call_console_drivers(int level, const char *text, size_t len)
+static void call_console_drivers(int level, const char *text, size_t len,
+				 bool async)
 {
 	struct console *con;
 
-	trace_console(text, len);
+	if (!async)
+		trace_console(text, len);
 
 	if (level >= console_loglevel && !ignore_loglevel)
 		return;
@@ -1402,7 +1406,9 @@ static void call_console_drivers(int level, const char *text, size_t len)
 		return;
 
 	for_each_console(con) {
-		if (exclusive_console && con != exclusive_console)
+		if (!(con->flags & CON_ASYNC) != !async)
+			continue;
+		if (!async && exclusive_console && con != exclusive_console)
 			continue;
 		if (!(con->flags & CON_ENABLED))
 			continue;
@@ -1415,6 +1421,195 @@ static void call_console_drivers(int level, const char *text, size_t len)
 	}
 }
 
+/*
+ * Consoles flagged CON_ASYNC, by their driver or with console_async=, are
+ * written from the "printk" kthread rather than from the printk() caller,
+ * so a slow serial console does not stall softirqs and irq threads for
+ * tens of milliseconds.  They keep their own position in the log buffer.
+ * While oopsing, before the kthread runs and once the system is going
+ * down they are written synchronously again.  All accesses to the
+ * async_* positions are under logbuf_lock, and writing to the consoles
+ * needs console_sem.
+ */
+static struct task_struct *printk_kthread;
+static bool printk_async_consoles;
+static bool printk_sync_forced;
+static u64 async_seq;
+static u32 async_idx;
+static enum log_flags async_prev;
+static char console_async_names[64];
+
+static int __init console_async_setup(char *str)
+{
+	strlcpy(console_async_names, str, sizeof(console_async_names));
+	return 1;
+}
+__setup("console_async=", console_async_setup);
+
+/* console_async=<name>[<index>][,...], "ttyO" matches all ttyO ports */
+static bool console_async_match(struct console *con)
+{
+	size_t len = strlen(con->name);
+	const char *p = console_async_names;
+	const char *end;
+	char *idx_end;
+
+	for (; *p; p = *end ? end + 1 : end) {
+		end = strchrnul(p, ',');
+		if (p + len > end || strncmp(p, con->name, len))
+			continue;
+		if (p + len == end)
+			return true;
+		if (simple_strtol(p + len, &idx_end, 10) == con->index &&
+		    idx_end == end)
+			return true;
+	}
+
+	return false;
+}
+
+static bool printk_async_sync_now(void)
+{
+	return oops_in_progress || printk_sync_forced || !printk_kthread;
+}
+
+/* Called with logbuf_lock held */
+static bool printk_async_pending(void)
+{
+	return printk_async_consoles && async_seq != log_next_seq;
+}
+
+/*
+ * Start the position of a new async console: the first one replays the
+ * log buffer if it asks for it, later ones join where the others are.
+ */
+static void console_async_register(struct console *newcon)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&logbuf_lock, flags);
+	if (!printk_async_consoles) {
+		if (newcon->flags & CON_PRINTBUFFER) {
+			async_seq = syslog_seq;
+			async_idx = syslog_idx;
+			async_prev = syslog_prev;
+		} else {
+			async_seq = log_next_seq;
+			async_idx = log_next_idx;
+			async_prev = 0;
+		}
+		printk_async_consoles = true;
+	}
+	raw_spin_unlock_irqrestore(&logbuf_lock, flags);
+}
+
+/*
+ * Write the records the async consoles have not seen yet.  Must be called
+ * with console_sem held; @may_sleep says whether we may reschedule
+ * between records.
+ */
+static void console_flush_async(bool may_sleep)
+{
+	static char text[LOG_LINE_MAX + PREFIX_MAX];
+	unsigned long flags;
+
+	if (!printk_async_consoles)
+		return;
+
+	for (;;) {
+		struct printk_log *msg;
+		size_t len = 0;
+		int level;
+
+		raw_spin_lock_irqsave(&logbuf_lock, flags);
+		if (async_seq < log_first_seq) {
+			len = sprintf(text, "** %u printk messages dropped ** ",
+				      (unsigned)(log_first_seq - async_seq));
+			async_seq = log_first_seq;
+			async_idx = log_first_idx;
+			async_prev = 0;
+		}
+		if (async_seq == log_next_seq) {
+			raw_spin_unlock_irqrestore(&logbuf_lock, flags);
+			break;
+		}
+
+		/*
+		 * Unlike console_unlock(), print LOG_NOCONS records too: their
+		 * fragments only went to the synchronous consoles.
+		 */
+		msg = log_from_idx(async_idx);
+		level = msg->level;
+		len += msg_print_text(msg, async_prev, false,
+				      text + len, sizeof(text) - len);
+		async_idx = log_next(async_idx);
+		async_seq++;
+		async_prev = msg->flags;
+		raw_spin_unlock(&logbuf_lock);
+
+		stop_critical_timings();	/* don't trace print latency */
+		call_console_drivers(level, text, len, true);
+		start_critical_timings();
+		local_irq_restore(flags);
+
+		if (may_sleep)
+			cond_resched();
+	}
+}
+
+static int printk_kthread_func(void *data)
+{
+	unsigned long flags;
+	bool pending;
+
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		raw_spin_lock_irqsave(&logbuf_lock, flags);
+		pending = printk_async_pending();
+		raw_spin_unlock_irqrestore(&logbuf_lock, flags);
+		if (!pending)
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		console_lock();
+		console_flush_async(true);
+		console_unlock();
+	}
+
+	return 0;
+}
+
+/* Make sure the async consoles have everything before a reboot */
+static int printk_reboot_notify(struct notifier_block *nb,
+				unsigned long code, void *unused)
+{
+	printk_sync_forced = true;
+	console_lock();
+	console_flush_async(true);
+	console_unlock();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block printk_reboot_nb = {
+	.notifier_call = printk_reboot_notify,
+};
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *t;
+
+	t = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(t)) {
+		pr_warn("printk: cannot start kthread, consoles stay synchronous\n");
+		return PTR_ERR(t);
+	}
+
+	register_reboot_notifier(&printk_reboot_nb);
+	printk_kthread = t;
+	return 0;
+}
+early_initcall(printk_kthread_init);
+
 /*
  * Zap console related locks when oopsing.
  * To leave time for slow consoles to print a full oops,
@@ -1892,7 +2087,14 @@ static struct cont {
 } cont;
 static struct printk_log *log_from_idx(u32 idx) { return NULL; }
 static u32 log_next(u32 idx) { return 0; }
-static void call_console_drivers(int level, const char *text, size_t len) {}
+static void call_console_drivers(int level, const char *text, size_t len,
+				 bool async) {}
+static bool console_async_match(struct console *con) { return false; }
+static bool printk_async_sync_now(void) { return false; }
+static bool printk_async_pending(void) { return false; }
+static void console_async_register(struct console *newcon) {}
+static void console_flush_async(bool may_sleep) {}
+static struct task_struct *printk_kthread;
 static size_t msg_print_text(const struct printk_log *msg, enum log_flags prev,
 			     bool syslog, char *buf, size_t size) { return 0; }
 static size_t cont_print_text(char *text, size_t size) { return 0; }
@@ -2145,7 +2347,7 @@ static void console_cont_flush(char *text, size_t size)
 	len = cont_print_text(text, size);
 	raw_spin_unlock(&logbuf_lock);
 	stop_critical_timings();
-	call_console_drivers(cont.level, text, len);
+	call_console_drivers(cont.level, text, len, false);
 	start_critical_timings();
 	local_irq_restore(flags);
 	return;
@@ -2173,7 +2375,7 @@ void console_unlock(void)
 	static u64 seen_seq;
 	unsigned long flags;
 	bool wake_klogd = false;
-	bool retry;
+	bool retry, async;
 
 	if (console_suspended) {
 		up_console_sem();
@@ -2185,6 +2387,9 @@ void console_unlock(void)
 	/* flush buffered message fragment immediately to console */
 	console_cont_flush(text, sizeof(text));
 again:
+	if (printk_async_sync_now())
+		console_flush_async(false);
+
 	for (;;) {
 		struct printk_log *msg;
 		size_t len;
@@ -2238,7 +2443,7 @@ skip:
 		raw_spin_unlock(&logbuf_lock);
 
 		stop_critical_timings();	/* don't trace print latency */
-		call_console_drivers(level, text, len);
+		call_console_drivers(level, text, len, false);
 		start_critical_timings();
 		local_irq_restore(flags);
 	}
@@ -2260,11 +2465,16 @@ skip:
 	 */
 	raw_spin_lock(&logbuf_lock);
 	retry = console_seq != log_next_seq;
+	async = printk_async_pending();
 	raw_spin_unlock_irqrestore(&logbuf_lock, flags);
 
 	if (retry && console_trylock())
 		goto again;
 
+	/* the kthread is woken here rather than from printk() itself */
+	if (async && printk_kthread)
+		wake_up_process(printk_kthread);
+
 	if (wake_klogd)
 		wake_up_klogd();
 }
@@ -2480,6 +2690,11 @@ void register_console(struct console *newcon)
 	if (bcon && ((newcon->flags & (CON_CONSDEV | CON_BOOT)) == CON_CONSDEV))
 		newcon->flags &= ~CON_PRINTBUFFER;
 
+	if (!(newcon->flags & CON_BOOT) && console_async_match(newcon))
+		newcon->flags |= CON_ASYNC;
+	if (newcon->flags & CON_ASYNC)
+		console_async_register(newcon);
+
 	/*
 	 *	Put this console in the list - keep the
 	 *	preferred driver at the head of the list.
@@ -2494,7 +2709,7 @@ void register_console(struct console *newcon)
 		newcon->next = console_drivers->next;
 		console_drivers->next = newcon;
 	}
-	if (newcon->flags & CON_PRINTBUFFER) {
+	if ((newcon->flags & (CON_PRINTBUFFER | CON_ASYNC)) == CON_PRINTBUFFER) {
 		/*
 		 * console_unlock(); will print out the buffered messages
 		 * for us.
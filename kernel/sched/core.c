@@ -2516,6 +2516,72 @@ void scheduler_tick(void)
 }
 
 #ifdef CONFIG_NO_HZ_FULL
+struct tick_work {
+	int			cpu;
+	struct delayed_work	work;
+};
+
+static struct tick_work __percpu *tick_work_cpu;
+
+/*
+ * Run the 1Hz residual scheduler tick of a full dynticks CPU from a
+ * housekeeping CPU, so that the current task's vruntime and load keep
+ * moving without interrupting the isolated CPU itself.
+ */
+static void sched_tick_remote(struct work_struct *work)
+{
+	struct delayed_work *dwork = to_delayed_work(work);
+	struct tick_work *twork = container_of(dwork, struct tick_work, work);
+	int cpu = twork->cpu;
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+
+	/*
+	 * Racy by nature: a tick too many or too few once in a while does
+	 * not matter at this rate.
+	 */
+	if (!idle_cpu(cpu) && tick_nohz_tick_stopped_cpu(cpu)) {
+		struct task_struct *curr;
+
+		raw_spin_lock_irqsave(&rq->lock, flags);
+		curr = rq->curr;
+		if (cpu_online(cpu) && !is_idle_task(curr)) {
+			update_rq_clock(rq);
+			curr->sched_class->task_tick(rq, curr, 0);
+			rq_last_tick_reset(rq);
+		}
+		raw_spin_unlock_irqrestore(&rq->lock, flags);
+	}
+
+	/* unbound work is kept to the housekeeping CPUs */
+	queue_delayed_work(system_unbound_wq, dwork, HZ);
+}
+
+static int __init sched_tick_offload_init(void)
+{
+	struct tick_work *twork;
+	int cpu;
+
+	if (!tick_nohz_full_enabled())
+		return 0;
+
+	tick_work_cpu = alloc_percpu(struct tick_work);
+	if (!tick_work_cpu) {
+		pr_warn("sched: no remote tick, nohz_full CPUs keep a 1Hz tick\n");
+		return -ENOMEM;
+	}
+
+	for_each_cpu(cpu, tick_nohz_full_mask) {
+		twork = per_cpu_ptr(tick_work_cpu, cpu);
+		twork->cpu = cpu;
+		INIT_DELAYED_WORK(&twork->work, sched_tick_remote);
+		queue_delayed_work(system_unbound_wq, &twork->work, HZ);
+	}
+
+	return 0;
+}
+core_initcall(sched_tick_offload_init);
+
 /**
  * scheduler_tick_max_deferment
  *
@@ -2527,6 +2593,9 @@ void scheduler_tick(void)
  * balancing, etc... continue to move forward, even
  * with a very low granularity.
  *
+ * Full dynticks CPUs get that tick from a housekeeping
+ * CPU instead, see sched_tick_remote(), and have no limit.
+ *
  * Return: Maximum deferment in nanoseconds.
  */
 u64 scheduler_tick_max_deferment(void)
@@ -2534,6 +2603,9 @@ u64 scheduler_tick_max_deferment(void)
 	struct rq *rq = this_rq();
 	unsigned long next, now = ACCESS_ONCE(jiffies);
 
+	if (tick_work_cpu && tick_nohz_full_cpu(cpu_of(rq)))
+		return KTIME_MAX;
+
 	next = rq->last_sched_tick + HZ;
 
 	if (time_before_eq(next, now))
@@ -0,0 +1,462 @@
+/*
+ * CPUFreq governor based on scheduler-provided CPU utilization data.
+ *
+ * Instead of sampling load from a timer, the scheduler hands over the
+ * CFS utilization of a CPU at enqueue, dequeue and tick time, and asks
+ * for the top frequency whenever an RT or deadline task runs. A new
+ * frequency is picked directly from that, at most once per
+ * rate_limit_us, and applied from a kthread as the driver may sleep.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/cpufreq.h>
+#include <linux/irq_work.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+
+#include "sched.h"
+
+/* lower bound of the default rate limit, and its multiple of latency */
+#define SUGOV_MIN_RATE_LIMIT_US		1000
+#define SUGOV_LATENCY_MULTIPLIER	10
+
+struct sugov_tunables {
+	struct kobject		kobj;
+	unsigned int		rate_limit_us;
+	int			usage_count;
+};
+
+struct sugov_policy {
+	struct cpufreq_policy	*policy;
+	struct sugov_tunables	*tunables;
+
+	/* serializes the hooks of the CPUs sharing the policy */
+	raw_spinlock_t		update_lock;
+	u64			last_freq_update_time;
+	unsigned int		next_freq;
+
+	/* the frequency is changed from process context */
+	struct irq_work		irq_work;
+	struct kthread_work	work;
+	struct mutex		work_lock;
+	struct kthread_worker	worker;
+	struct task_struct	*thread;
+	bool			work_in_progress;
+};
+
+struct sugov_cpu {
+	struct update_util_data	update_util;
+	struct sugov_policy	*sg_policy;
+
+	unsigned long		util;
+	unsigned long		max;
+	u64			last_update;
+};
+
+static DEFINE_PER_CPU(struct sugov_cpu, sugov_cpu);
+
+static struct sugov_tunables *global_tunables;
+static DEFINE_MUTEX(global_tunables_lock);
+
+/*---------------------------- Governor logic ----------------------------*/
+
+static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
+{
+	struct sugov_tunables *tunables = sg_policy->tunables;
+	s64 delta_ns;
+
+	if (sg_policy->work_in_progress)
+		return false;
+
+	delta_ns = time - sg_policy->last_freq_update_time;
+	return delta_ns >= (s64)ACCESS_ONCE(tunables->rate_limit_us) *
+			   NSEC_PER_USEC;
+}
+
+static void sugov_update_commit(struct sugov_policy *sg_policy, u64 time,
+				unsigned int next_freq)
+{
+	sg_policy->last_freq_update_time = time;
+
+	if (sg_policy->next_freq == next_freq)
+		return;
+
+	sg_policy->next_freq = next_freq;
+	sg_policy->work_in_progress = true;
+	irq_work_queue(&sg_policy->irq_work);
+}
+
+/*
+ * CFS utilization is not frequency invariant here: it is relative to
+ * the frequency the CPU ran at. Aim for the current frequency scaled by
+ * util/max, with 25% headroom so that a fully busy CPU keeps stepping
+ * up rather than settling just below what it needs.
+ */
+static unsigned int sugov_next_freq(struct sugov_policy *sg_policy,
+				    unsigned long util, unsigned long max)
+{
+	struct cpufreq_policy *policy = sg_policy->policy;
+	unsigned int freq = policy->cur;
+
+	if (util == ULONG_MAX || !max)
+		return policy->cpuinfo.max_freq;
+
+	return div_u64((u64)(freq + (freq >> 2)) * util, max);
+}
+
+static unsigned int sugov_next_freq_shared(struct sugov_policy *sg_policy,
+					   u64 time)
+{
+	struct cpufreq_policy *policy = sg_policy->policy;
+	unsigned long util = 0, max = 1;
+	unsigned int j;
+
+	for_each_cpu(j, policy->cpus) {
+		struct sugov_cpu *j_sg_cpu = &per_cpu(sugov_cpu, j);
+		unsigned long j_util, j_max;
+
+		/* A CPU that has not reported for a tick is idle */
+		if ((s64)(time - j_sg_cpu->last_update) > TICK_NSEC)
+			continue;
+
+		j_util = j_sg_cpu->util;
+		if (j_util == ULONG_MAX)
+			return policy->cpuinfo.max_freq;
+
+		j_max = j_sg_cpu->max;
+		if (j_util * max > j_max * util) {
+			util = j_util;
+			max = j_max;
+		}
+	}
+
+	return sugov_next_freq(sg_policy, util, max);
+}
+
+static void sugov_update(struct update_util_data *hook, u64 time,
+			 unsigned long util, unsigned long max)
+{
+	struct sugov_cpu *sg_cpu = container_of(hook, struct sugov_cpu,
+						update_util);
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	unsigned int next_f;
+
+	raw_spin_lock(&sg_policy->update_lock);
+
+	sg_cpu->util = util;
+	sg_cpu->max = max;
+	sg_cpu->last_update = time;
+
+	if (util == ULONG_MAX) {
+		/* RT and deadline tasks skip the rate limit */
+		if (!sg_policy->work_in_progress)
+			sugov_update_commit(sg_policy, time,
+					sg_policy->policy->cpuinfo.max_freq);
+	} else if (sugov_should_update_freq(sg_policy, time)) {
+		next_f = sugov_next_freq_shared(sg_policy, time);
+		sugov_update_commit(sg_policy, time, next_f);
+	}
+
+	raw_spin_unlock(&sg_policy->update_lock);
+}
+
+static void sugov_work(struct kthread_work *work)
+{
+	struct sugov_policy *sg_policy = container_of(work, struct sugov_policy,
+						      work);
+
+	mutex_lock(&sg_policy->work_lock);
+	__cpufreq_driver_target(sg_policy->policy, sg_policy->next_freq,
+				CPUFREQ_RELATION_L);
+	mutex_unlock(&sg_policy->work_lock);
+
+	sg_policy->work_in_progress = false;
+}
+
+static void sugov_irq_work(struct irq_work *irq_work)
+{
+	struct sugov_policy *sg_policy = container_of(irq_work,
+						      struct sugov_policy,
+						      irq_work);
+
+	queue_kthread_work(&sg_policy->worker, &sg_policy->work);
+}
+
+/************************** sysfs interface ************************/
+
+struct sugov_attr {
+	struct attribute attr;
+	ssize_t (*show)(struct sugov_tunables *tunables, char *buf);
+	ssize_t (*store)(struct sugov_tunables *tunables, const char *buf,
+			 size_t count);
+};
+
+static ssize_t rate_limit_us_show(struct sugov_tunables *tunables, char *buf)
+{
+	return sprintf(buf, "%u\n", tunables->rate_limit_us);
+}
+
+static ssize_t rate_limit_us_store(struct sugov_tunables *tunables,
+				   const char *buf, size_t count)
+{
+	unsigned int rate_limit_us;
+
+	if (kstrtouint(buf, 10, &rate_limit_us))
+		return -EINVAL;
+
+	tunables->rate_limit_us = rate_limit_us;
+	return count;
+}
+
+static struct sugov_attr rate_limit_us = __ATTR_RW(rate_limit_us);
+
+static struct attribute *sugov_attributes[] = {
+	&rate_limit_us.attr,
+	NULL
+};
+
+static ssize_t sugov_attr_show(struct kobject *kobj, struct attribute *attr,
+			       char *buf)
+{
+	struct sugov_attr *sg_attr = container_of(attr, struct sugov_attr,
+						  attr);
+
+	return sg_attr->show(container_of(kobj, struct sugov_tunables, kobj),
+			     buf);
+}
+
+static ssize_t sugov_attr_store(struct kobject *kobj, struct attribute *attr,
+				const char *buf, size_t count)
+{
+	struct sugov_attr *sg_attr = container_of(attr, struct sugov_attr,
+						  attr);
+
+	return sg_attr->store(container_of(kobj, struct sugov_tunables, kobj),
+			      buf, count);
+}
+
+static const struct sysfs_ops sugov_sysfs_ops = {
+	.show	= sugov_attr_show,
+	.store	= sugov_attr_store,
+};
+
+static void sugov_tunables_release(struct kobject *kobj)
+{
+	kfree(container_of(kobj, struct sugov_tunables, kobj));
+}
+
+static struct kobj_type sugov_tunables_ktype = {
+	.default_attrs	= sugov_attributes,
+	.sysfs_ops	= &sugov_sysfs_ops,
+	.release	= sugov_tunables_release,
+};
+
+/********************** cpufreq governor interface *********************/
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHEDUTIL
+static
+#endif
+struct cpufreq_governor cpufreq_gov_schedutil;
+
+static int sugov_init(struct cpufreq_policy *policy)
+{
+	struct sched_param param = { .sched_priority = MAX_USER_RT_PRIO / 2 };
+	struct sugov_policy *sg_policy;
+	struct sugov_tunables *tunables;
+	unsigned int lat;
+	int ret = 0;
+
+	if (policy->governor_data)
+		return -EBUSY;
+
+	sg_policy = kzalloc(sizeof(*sg_policy), GFP_KERNEL);
+	if (!sg_policy)
+		return -ENOMEM;
+
+	sg_policy->policy = policy;
+	raw_spin_lock_init(&sg_policy->update_lock);
+	init_irq_work(&sg_policy->irq_work, sugov_irq_work);
+	init_kthread_work(&sg_policy->work, sugov_work);
+	init_kthread_worker(&sg_policy->worker);
+	mutex_init(&sg_policy->work_lock);
+
+	sg_policy->thread = kthread_create(kthread_worker_fn,
+					   &sg_policy->worker, "sugov:%d",
+					   cpumask_first(policy->related_cpus));
+	if (IS_ERR(sg_policy->thread)) {
+		ret = PTR_ERR(sg_policy->thread);
+		pr_err("failed to create kthread: %d\n", ret);
+		goto free_sg_policy;
+	}
+	sched_setscheduler_nocheck(sg_policy->thread, SCHED_FIFO, &param);
+	wake_up_process(sg_policy->thread);
+
+	mutex_lock(&global_tunables_lock);
+
+	if (global_tunables) {
+		if (WARN_ON(have_governor_per_policy())) {
+			ret = -EINVAL;
+			goto stop_kthread;
+		}
+		sg_policy->tunables = global_tunables;
+		global_tunables->usage_count++;
+		goto out;
+	}
+
+	tunables = kzalloc(sizeof(*tunables), GFP_KERNEL);
+	if (!tunables) {
+		ret = -ENOMEM;
+		goto stop_kthread;
+	}
+
+	lat = policy->cpuinfo.transition_latency / NSEC_PER_USEC;
+	tunables->rate_limit_us = max_t(unsigned int, SUGOV_MIN_RATE_LIMIT_US,
+					lat * SUGOV_LATENCY_MULTIPLIER);
+	tunables->usage_count = 1;
+
+	ret = kobject_init_and_add(&tunables->kobj, &sugov_tunables_ktype,
+				   get_governor_parent_kobj(policy), "%s",
+				   cpufreq_gov_schedutil.name);
+	if (ret) {
+		kobject_put(&tunables->kobj);
+		goto stop_kthread;
+	}
+
+	if (!have_governor_per_policy())
+		global_tunables = tunables;
+	sg_policy->tunables = tunables;
+
+out:
+	policy->governor_data = sg_policy;
+	mutex_unlock(&global_tunables_lock);
+	return 0;
+
+stop_kthread:
+	mutex_unlock(&global_tunables_lock);
+	kthread_stop(sg_policy->thread);
+free_sg_policy:
+	kfree(sg_policy);
+	return ret;
+}
+
+static int sugov_exit(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	struct sugov_tunables *tunables = sg_policy->tunables;
+
+	mutex_lock(&global_tunables_lock);
+
+	if (!--tunables->usage_count) {
+		if (tunables == global_tunables)
+			global_tunables = NULL;
+		kobject_put(&tunables->kobj);
+	}
+	policy->governor_data = NULL;
+
+	mutex_unlock(&global_tunables_lock);
+
+	flush_kthread_worker(&sg_policy->worker);
+	kthread_stop(sg_policy->thread);
+	kfree(sg_policy);
+	return 0;
+}
+
+static int sugov_start(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int cpu;
+
+	sg_policy->last_freq_update_time = 0;
+	sg_policy->next_freq = UINT_MAX;
+	sg_policy->work_in_progress = false;
+
+	for_each_cpu(cpu, policy->cpus) {
+		struct sugov_cpu *sg_cpu = &per_cpu(sugov_cpu, cpu);
+
+		sg_cpu->sg_policy = sg_policy;
+		sg_cpu->util = 0;
+		sg_cpu->max = 0;
+		sg_cpu->last_update = 0;
+		sg_cpu->update_util.func = sugov_update;
+		cpufreq_set_update_util_data(cpu, &sg_cpu->update_util);
+	}
+	return 0;
+}
+
+static int sugov_stop(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int cpu;
+
+	for_each_cpu(cpu, policy->cpus)
+		cpufreq_set_update_util_data(cpu, NULL);
+
+	synchronize_sched();
+
+	irq_work_sync(&sg_policy->irq_work);
+	flush_kthread_work(&sg_policy->work);
+	return 0;
+}
+
+static int sugov_limits(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned long flags;
+
+	mutex_lock(&sg_policy->work_lock);
+
+	if (policy->max < policy->cur)
+		__cpufreq_driver_target(policy, policy->max,
+					CPUFREQ_RELATION_H);
+	else if (policy->min > policy->cur)
+		__cpufreq_driver_target(policy, policy->min,
+					CPUFREQ_RELATION_L);
+
+	mutex_unlock(&sg_policy->work_lock);
+
+	/* make the next update reevaluate against the new limits */
+	raw_spin_lock_irqsave(&sg_policy->update_lock, flags);
+	sg_policy->next_freq = UINT_MAX;
+	raw_spin_unlock_irqrestore(&sg_policy->update_lock, flags);
+	return 0;
+}
+
+static int cpufreq_schedutil_cb(struct cpufreq_policy *policy,
+				unsigned int event)
+{
+	switch (event) {
+	case CPUFREQ_GOV_POLICY_INIT:
+		return sugov_init(policy);
+	case CPUFREQ_GOV_POLICY_EXIT:
+		return sugov_exit(policy);
+	case CPUFREQ_GOV_START:
+		return sugov_start(policy);
+	case CPUFREQ_GOV_STOP:
+		return sugov_stop(policy);
+	case CPUFREQ_GOV_LIMITS:
+		return sugov_limits(policy);
+	default:
+		return -EINVAL;
+	}
+}
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHEDUTIL
+static
+#endif
+struct cpufreq_governor cpufreq_gov_schedutil = {
+	.name		= "schedutil",
+	.governor	= cpufreq_schedutil_cb,
+	.owner		= THIS_MODULE,
+};
+
+static int __init sugov_register(void)
+{
+	return cpufreq_register_governor(&cpufreq_gov_schedutil);
+}
+fs_initcall(sugov_register);
@@ -4213,6 +4213,15 @@ static inline void hrtick_update(struct rq *rq)
 }
 #endif
 
+static inline void cfs_rq_util_change(struct rq *rq)
+{
+#ifdef CONFIG_SMP
+	cpufreq_update_util(rq, min_t(unsigned long,
+				      rq->cfs.utilization_load_avg,
+				      SCHED_LOAD_SCALE), SCHED_LOAD_SCALE);
+#endif
+}
+
 /*
  * The enqueue_task method is called before nr_running is
  * increased. Here we update the fair scheduling stats and
@@ -4258,6 +4267,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		update_rq_runnable_avg(rq, rq->nr_running);
 		add_nr_running(rq, 1);
 	}
+	cfs_rq_util_change(rq);
 	hrtick_update(rq);
 }
 
@@ -4319,6 +4329,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		sub_nr_running(rq, 1);
 		update_rq_runnable_avg(rq, 1);
 	}
+	cfs_rq_util_change(rq);
 	hrtick_update(rq);
 }
 
@@ -7825,6 +7836,7 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		task_tick_numa(rq, curr);
 
 	update_rq_runnable_avg(rq, 1);
+	cfs_rq_util_change(rq);
 }
 
 /*
@@ -956,6 +956,7 @@ static void update_curr_rt(struct rq *rq)
 	cpuacct_charge(curr, delta_exec);
 
 	sched_rt_avg_update(rq, delta_exec);
+	cpufreq_trigger_update(rq);
 
 	if (!rt_bandwidth_enabled())
 		return;
@@ -1261,6 +1262,8 @@ enqueue_task_rt(struct rq *rq, struct task_struct *p, int flags)
 
 	if (!task_current(rq, p) && p->nr_cpus_allowed > 1)
 		enqueue_pushable_task(rq, p);
+
+	cpufreq_trigger_update(rq);
 }
 
 static void dequeue_task_rt(struct rq *rq, struct task_struct *p, int flags)
@@ -716,6 +716,43 @@ static inline u64 rq_clock(struct rq *rq)
 	return rq->clock;
 }
 
+#ifdef CONFIG_CPU_FREQ
+DECLARE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
+
+/**
+ * cpufreq_update_util - take a note about CPU utilization changes
+ * @rq: runqueue whose utilization changed
+ * @util: current utilization, or ULONG_MAX to ask for the top frequency
+ * @max: utilization ceiling
+ *
+ * Called with @rq->lock held, from the scheduler paths where the data
+ * to derive a frequency from changes. Only updates for the local CPU
+ * are passed on, as the governor hook is strictly per-CPU.
+ */
+static inline void cpufreq_update_util(struct rq *rq, unsigned long util,
+				       unsigned long max)
+{
+	struct update_util_data *data;
+
+	if (cpu_of(rq) != smp_processor_id())
+		return;
+
+	data = rcu_dereference_sched(*this_cpu_ptr(&cpufreq_update_util_data));
+	if (data)
+		data->func(data, rq_clock(rq), util, max);
+}
+
+/* RT and deadline tasks have no usable utilization: ask for the maximum */
+static inline void cpufreq_trigger_update(struct rq *rq)
+{
+	cpufreq_update_util(rq, ULONG_MAX, 0);
+}
+#else
+static inline void cpufreq_update_util(struct rq *rq, unsigned long util,
+				       unsigned long max) {}
+static inline void cpufreq_trigger_update(struct rq *rq) {}
+#endif /* CONFIG_CPU_FREQ */
+
 static inline u64 rq_clock_task(struct rq *rq)
 {
 	lockdep_assert_held(&rq->lock);
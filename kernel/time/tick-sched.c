@@ -421,6 +421,11 @@ int tick_nohz_tick_stopped(void)
 	return __this_cpu_read(tick_cpu_sched.tick_stopped);
 }
 
+int tick_nohz_tick_stopped_cpu(int cpu)
+{
+	return per_cpu(tick_cpu_sched, cpu).tick_stopped;
+}
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -1078,6 +1083,10 @@ static inline void tick_nohz_irq_enter(void)
 	if (ts->idle_active)
 		tick_nohz_stop_idle(ts, now);
 	if (ts->tick_stopped) {
+		/* anything but an idle wakeup disturbs a full dynticks CPU */
+		if (!ts->inidle && tick_nohz_full_cpu(smp_processor_id()))
+			trace_tick_nohz_full_irq(ktime_to_ns(ktime_sub(now,
+							ts->last_tick)));
 		tick_nohz_update_jiffies(now);
 		tick_nohz_kick_tick(ts, now);
 	}
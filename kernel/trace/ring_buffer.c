@@ -6,6 +6,7 @@
 #include <linux/ftrace_event.h>
 #include <linux/ring_buffer.h>
 #include <linux/trace_clock.h>
+#include <linux/trace_mmap.h>
 #include <linux/trace_seq.h>
 #include <linux/spinlock.h>
 #include <linux/irq_work.h>
@@ -352,6 +353,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 id;		/* sub-buffer id when mapped */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -487,6 +489,12 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mapping, see ring_buffer_map() */
+	int				mapped;
+	struct trace_buffer_meta	*meta_page;
+	struct buffer_page		**subbuf_ids;
+	unsigned long			map_read_entries;
 };
 
 struct ring_buffer {
@@ -1708,6 +1716,12 @@ int ring_buffer_resize(struct ring_buffer *buffer, unsigned long size,
 	/* prevent another thread from changing buffer sizes */
 	mutex_lock(&buffer->mutex);
 
+	/* A buffer mapped meanwhile must keep its pages */
+	if (atomic_read(&buffer->resize_disabled)) {
+		mutex_unlock(&buffer->mutex);
+		return -EBUSY;
+	}
+
 	if (cpu_id == RING_BUFFER_ALL_CPUS) {
 		/* calculate the pages to update */
 		for_each_buffer_cpu(buffer, cpu) {
@@ -4200,6 +4214,7 @@ rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 
 	cpu_buffer->lost_events = 0;
 	cpu_buffer->last_overrun = 0;
+	cpu_buffer->map_read_entries = 0;
 
 	rb_head_page_activate(cpu_buffer);
 }
@@ -4347,6 +4362,11 @@ int ring_buffer_swap_cpu(struct ring_buffer *buffer_a,
 	if (cpu_buffer_a->nr_pages != cpu_buffer_b->nr_pages)
 		goto out;
 
+	/* User space holds the pages of a mapped buffer */
+	ret = -EBUSY;
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped)
+		goto out;
+
 	ret = -EAGAIN;
 
 	if (ring_buffer_flags != RB_BUFFERS_ON)
@@ -4526,12 +4546,14 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 	/*
 	 * If this page has been partially read or
 	 * if len is not big enough to read the rest of the page or
-	 * a writer is still on the page, then
+	 * a writer is still on the page, or
+	 * the buffer is mapped to user space, then
 	 * we must copy the data from the page to the buffer.
 	 * Otherwise, we can simply swap the page with the one passed in.
 	 */
 	if (read || (len < (commit - read)) ||
-	    cpu_buffer->reader_page == cpu_buffer->commit_page) {
+	    cpu_buffer->reader_page == cpu_buffer->commit_page ||
+	    cpu_buffer->mapped) {
 		struct buffer_data_page *rpage = cpu_buffer->reader_page->page;
 		unsigned int rpos = read;
 		unsigned int pos = 0;
@@ -4640,6 +4662,229 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	meta->reader.lost_events = cpu_buffer->lost_events;
+	meta->reader.id = cpu_buffer->reader_page->id;
+	meta->reader.read = cpu_buffer->reader_page->read;
+
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+}
+
+/**
+ * ring_buffer_map - prepare a per cpu buffer to be mapped to user space
+ * @buffer: the buffer to map
+ * @cpu: the cpu buffer to map
+ *
+ * Allocates the meta page and numbers the sub-buffers: the reader page
+ * is sub-buffer 0 and the ring follows from the head page. While
+ * mapped, the buffer can not be resized or swapped and read_page()
+ * always copies, so that the pages user space sees stay in the ring.
+ *
+ * Mappings nest; each call must be paired with ring_buffer_unmap().
+ */
+int ring_buffer_map(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta;
+	struct buffer_page **subbuf_ids;
+	struct buffer_page *bpage;
+	unsigned long flags;
+	int i;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&buffer->mutex);
+
+	if (cpu_buffer->mapped) {
+		cpu_buffer->mapped++;
+		mutex_unlock(&buffer->mutex);
+		return 0;
+	}
+
+	meta = (void *)get_zeroed_page(GFP_KERNEL);
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	if (!meta || !subbuf_ids) {
+		free_page((unsigned long)meta);
+		kfree(subbuf_ids);
+		mutex_unlock(&buffer->mutex);
+		return -ENOMEM;
+	}
+
+	atomic_inc(&buffer->resize_disabled);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	bpage = cpu_buffer->reader_page;
+	bpage->id = 0;
+	subbuf_ids[0] = bpage;
+
+	/* Writers only move the head flags, the ring itself is stable */
+	bpage = cpu_buffer->head_page;
+	for (i = 1; i <= cpu_buffer->nr_pages; i++) {
+		bpage->id = i;
+		subbuf_ids[i] = bpage;
+		rb_inc_page(cpu_buffer, &bpage);
+	}
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->subbuf_size = PAGE_SIZE;
+	meta->nr_subbufs = cpu_buffer->nr_pages + 1;
+
+	cpu_buffer->meta_page = meta;
+	cpu_buffer->subbuf_ids = subbuf_ids;
+	cpu_buffer->map_read_entries = 0;
+	cpu_buffer->mapped = 1;
+	rb_update_meta_page(cpu_buffer);
+
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	mutex_unlock(&buffer->mutex);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_unmap - drop a user space mapping of a per cpu buffer
+ * @buffer: the buffer that was mapped
+ * @cpu: the cpu buffer that was mapped
+ */
+int ring_buffer_unmap(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta = NULL;
+	struct buffer_page **subbuf_ids = NULL;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&buffer->mutex);
+
+	if (!cpu_buffer->mapped) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	if (!--cpu_buffer->mapped) {
+		meta = cpu_buffer->meta_page;
+		subbuf_ids = cpu_buffer->subbuf_ids;
+		cpu_buffer->meta_page = NULL;
+		cpu_buffer->subbuf_ids = NULL;
+	}
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	if (meta) {
+		atomic_dec(&buffer->resize_disabled);
+		free_page((unsigned long)meta);
+		kfree(subbuf_ids);
+	}
+ out:
+	mutex_unlock(&buffer->mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_fault - find the page backing a mapped buffer offset
+ * @buffer: the mapped buffer
+ * @cpu: the mapped cpu buffer
+ * @pgoff: page offset in the mapping
+ *
+ * Page 0 is the meta page, page 1 + id is sub-buffer id.
+ * Returns NULL if @pgoff is out of range or the buffer is not mapped.
+ */
+struct page *ring_buffer_map_fault(struct ring_buffer *buffer, int cpu,
+				   unsigned long pgoff)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return NULL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	if (!cpu_buffer->mapped)
+		return NULL;
+
+	if (!pgoff)
+		return virt_to_page(cpu_buffer->meta_page);
+
+	if (--pgoff > cpu_buffer->nr_pages)
+		return NULL;
+
+	return virt_to_page(cpu_buffer->subbuf_ids[pgoff]->page);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_fault);
+
+/**
+ * ring_buffer_map_get_reader - hand the next events to a mapped reader
+ * @buffer: the mapped buffer
+ * @cpu: the mapped cpu buffer
+ *
+ * The caller is done with the bytes of the reader sub-buffer the meta
+ * page handed out. If the writer added events to that sub-buffer since,
+ * they are handed out next; otherwise the reader page is swapped with
+ * the head of the ring, which is the one step user space can not do
+ * without racing the writer. The meta page is updated either way.
+ */
+int ring_buffer_map_get_reader(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct buffer_page *reader, *prev;
+	unsigned long entries;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	if (!cpu_buffer->mapped) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	prev = cpu_buffer->reader_page;
+	reader = rb_get_reader_page(cpu_buffer);
+	if (reader) {
+		if (reader != prev)
+			cpu_buffer->map_read_entries = 0;
+
+		/* Everything committed so far goes to user space */
+		entries = rb_page_entries(reader);
+		cpu_buffer->read += entries - cpu_buffer->map_read_entries;
+		cpu_buffer->map_read_entries = entries;
+		reader->read = rb_page_size(reader);
+	}
+
+	rb_update_meta_page(cpu_buffer);
+	cpu_buffer->lost_events = 0;
+ out:
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 #ifdef CONFIG_HOTPLUG_CPU
 static int rb_cpu_notify(struct notifier_block *self,
 			 unsigned long action, void *hcpu)
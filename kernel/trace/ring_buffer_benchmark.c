@@ -4,6 +4,7 @@
  * Copyright (C) 2009 Steven Rostedt <srostedt@redhat.com>
  */
 #include <linux/ring_buffer.h>
+#include <linux/trace_mmap.h>
 #include <linux/completion.h>
 #include <linux/kthread.h>
 #include <linux/module.h>
@@ -58,7 +59,29 @@ MODULE_PARM_DESC(producer_fifo, "fifo prio for producer");
 module_param(consumer_fifo, uint, 0644);
 MODULE_PARM_DESC(consumer_fifo, "fifo prio for consumer");
 
-static int read_events;
+enum read_mode {
+	READ_EVENTS,
+	READ_PAGES,
+	READ_MAPPED,
+	NR_READ_MODES,
+};
+
+static const char *read_mode_names[NR_READ_MODES] = {
+	[READ_EVENTS]	= "events",
+	[READ_PAGES]	= "pages",
+	[READ_MAPPED]	= "mapped pages",
+};
+
+/* the first run reads events */
+static int read_mode = -1;
+
+/* where the mapped reader is at, per cpu */
+struct map_pos {
+	u32		id;
+	u32		pos;
+};
+
+static DEFINE_PER_CPU(struct map_pos, map_pos);
 
 static int kill_test;
 
@@ -95,76 +118,83 @@ static enum event_status read_event(int cpu)
 	return EVENT_FOUND;
 }
 
-static enum event_status read_page(int cpu)
+static void read_page_data(int cpu, struct rb_page *rpage,
+			   unsigned long start, unsigned long commit)
 {
 	struct ring_buffer_event *event;
-	struct rb_page *rpage;
-	unsigned long commit;
-	void *bpage;
 	int *entry;
-	int ret;
 	int inc;
 	int i;
 
-	bpage = ring_buffer_alloc_read_page(buffer, cpu);
-	if (!bpage)
-		return EVENT_DROPPED;
+	for (i = start; i < commit && !kill_test; i += inc) {
 
-	ret = ring_buffer_read_page(buffer, &bpage, PAGE_SIZE, cpu, 1);
-	if (ret >= 0) {
-		rpage = bpage;
-		/* The commit may have missed event flags set, clear them */
-		commit = local_read(&rpage->commit) & 0xfffff;
-		for (i = 0; i < commit && !kill_test; i += inc) {
+		if (i >= (PAGE_SIZE - offsetof(struct rb_page, data))) {
+			KILL_TEST();
+			break;
+		}
 
-			if (i >= (PAGE_SIZE - offsetof(struct rb_page, data))) {
+		inc = -1;
+		event = (void *)&rpage->data[i];
+		switch (event->type_len) {
+		case RINGBUF_TYPE_PADDING:
+			/* failed writes may be discarded events */
+			if (!event->time_delta)
+				KILL_TEST();
+			inc = event->array[0] + 4;
+			break;
+		case RINGBUF_TYPE_TIME_EXTEND:
+			inc = 8;
+			break;
+		case 0:
+			entry = ring_buffer_event_data(event);
+			if (*entry != cpu) {
 				KILL_TEST();
 				break;
 			}
-
-			inc = -1;
-			event = (void *)&rpage->data[i];
-			switch (event->type_len) {
-			case RINGBUF_TYPE_PADDING:
-				/* failed writes may be discarded events */
-				if (!event->time_delta)
-					KILL_TEST();
-				inc = event->array[0] + 4;
-				break;
-			case RINGBUF_TYPE_TIME_EXTEND:
-				inc = 8;
-				break;
-			case 0:
-				entry = ring_buffer_event_data(event);
-				if (*entry != cpu) {
-					KILL_TEST();
-					break;
-				}
-				read++;
-				if (!event->array[0]) {
-					KILL_TEST();
-					break;
-				}
-				inc = event->array[0] + 4;
+			read++;
+			if (!event->array[0]) {
+				KILL_TEST();
 				break;
-			default:
-				entry = ring_buffer_event_data(event);
-				if (*entry != cpu) {
-					KILL_TEST();
-					break;
-				}
-				read++;
-				inc = ((event->type_len + 1) * 4);
 			}
-			if (kill_test)
-				break;
-
-			if (inc <= 0) {
+			inc = event->array[0] + 4;
+			break;
+		default:
+			entry = ring_buffer_event_data(event);
+			if (*entry != cpu) {
 				KILL_TEST();
 				break;
 			}
+			read++;
+			inc = ((event->type_len + 1) * 4);
+		}
+		if (kill_test)
+			break;
+
+		if (inc <= 0) {
+			KILL_TEST();
+			break;
 		}
 	}
+}
+
+static enum event_status read_page(int cpu)
+{
+	struct rb_page *rpage;
+	unsigned long commit;
+	void *bpage;
+	int ret;
+
+	bpage = ring_buffer_alloc_read_page(buffer, cpu);
+	if (!bpage)
+		return EVENT_DROPPED;
+
+	ret = ring_buffer_read_page(buffer, &bpage, PAGE_SIZE, cpu, 1);
+	if (ret >= 0) {
+		rpage = bpage;
+		/* The commit may have missed event flags set, clear them */
+		commit = local_read(&rpage->commit) & 0xfffff;
+		read_page_data(cpu, rpage, 0, commit);
+	}
 	ring_buffer_free_read_page(buffer, bpage);
 
 	if (ret < 0)
@@ -172,10 +202,71 @@ static enum event_status read_page(int cpu)
 	return EVENT_FOUND;
 }
 
+/*
+ * Read the sub-buffers in place, as a user space reader of the
+ * mapped trace_pipe_raw would: one get_reader call per batch of events
+ * and no copy.
+ */
+static enum event_status read_mapped(int cpu)
+{
+	struct map_pos *mpos = per_cpu_ptr(&map_pos, cpu);
+	struct trace_buffer_meta *meta;
+	struct rb_page *rpage;
+
+	if (ring_buffer_map_get_reader(buffer, cpu) < 0)
+		return EVENT_DROPPED;
+
+	meta = page_address(ring_buffer_map_fault(buffer, cpu, 0));
+	if (meta->reader.id != mpos->id) {
+		mpos->id = meta->reader.id;
+		mpos->pos = 0;
+	}
+	if (mpos->pos >= meta->reader.read)
+		return EVENT_DROPPED;
+
+	rpage = page_address(ring_buffer_map_fault(buffer, cpu,
+						   1 + meta->reader.id));
+	read_page_data(cpu, rpage, mpos->pos, meta->reader.read);
+	mpos->pos = meta->reader.read;
+
+	return EVENT_FOUND;
+}
+
+static void unmap_buffers(void)
+{
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		ring_buffer_unmap(buffer, cpu);
+}
+
+static int map_buffers(void)
+{
+	struct trace_buffer_meta *meta;
+	struct map_pos *mpos;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		if (ring_buffer_map(buffer, cpu) < 0) {
+			unmap_buffers();
+			return -1;
+		}
+		meta = page_address(ring_buffer_map_fault(buffer, cpu, 0));
+		mpos = per_cpu_ptr(&map_pos, cpu);
+		mpos->id = meta->reader.id;
+		mpos->pos = meta->reader.read;
+	}
+	return 0;
+}
+
 static void ring_buffer_consumer(void)
 {
-	/* toggle between reading pages and events */
-	read_events ^= 1;
+	/* cycle between reading events, pages and mapped pages */
+	read_mode = (read_mode + 1) % NR_READ_MODES;
+	if (read_mode == READ_MAPPED && map_buffers() < 0) {
+		trace_printk("Could not map the buffer, reading events\n");
+		read_mode = READ_EVENTS;
+	}
 
 	read = 0;
 	while (!reader_finish && !kill_test) {
@@ -188,10 +279,12 @@ static void ring_buffer_consumer(void)
 			for_each_online_cpu(cpu) {
 				enum event_status stat;
 
-				if (read_events)
+				if (read_mode == READ_EVENTS)
 					stat = read_event(cpu);
-				else
+				else if (read_mode == READ_PAGES)
 					stat = read_page(cpu);
+				else
+					stat = read_mapped(cpu);
 
 				if (kill_test)
 					break;
@@ -206,6 +299,8 @@ static void ring_buffer_consumer(void)
 
 		schedule();
 	}
+	if (read_mode == READ_MAPPED)
+		unmap_buffers();
 	reader_finish = 0;
 	complete(&read_done);
 }
@@ -314,7 +409,7 @@ static void ring_buffer_producer(void)
 		trace_printk("Read:     (reader disabled)\n");
 	else
 		trace_printk("Read:     %ld  (by %s)\n", read,
-			read_events ? "events" : "pages");
+			read_mode_names[read_mode]);
 	trace_printk("Entries:  %lld\n", entries);
 	trace_printk("Total:    %lld\n", entries + overruns + read);
 	trace_printk("Missed:   %ld\n", missed);
@@ -21,6 +21,7 @@
 #include <linux/irqflags.h>
 #include <linux/debugfs.h>
 #include <linux/tracefs.h>
+#include <linux/trace_mmap.h>
 #include <linux/pagemap.h>
 #include <linux/hardirq.h>
 #include <linux/linkage.h>
@@ -5815,12 +5816,90 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	return ret;
 }
 
+static long tracing_buffers_ioctl(struct file *file, unsigned int cmd,
+				  unsigned long arg)
+{
+	struct ftrace_buffer_info *info = file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	if (cmd != TRACE_MMAP_IOCTL_GET_READER)
+		return -ENOTTY;
+
+	return ring_buffer_map_get_reader(iter->trace_buffer->buffer,
+					  iter->cpu_file);
+}
+
+/*
+ * The mapping keeps the ring buffer it was made on in vm_private_data,
+ * as a snapshot may swap iter->trace_buffer->buffer under it.
+ */
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+
+	WARN_ON(ring_buffer_map(vma->vm_private_data, info->iter.cpu_file));
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+
+	WARN_ON(ring_buffer_unmap(vma->vm_private_data, info->iter.cpu_file));
+}
+
+static int tracing_buffers_mmap_fault(struct vm_area_struct *vma,
+				      struct vm_fault *vmf)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct page *page;
+
+	page = ring_buffer_map_fault(vma->vm_private_data, info->iter.cpu_file,
+				     vmf->pgoff);
+	if (!page)
+		return VM_FAULT_SIGBUS;
+
+	get_page(page);
+	vmf->page = page;
+	return 0;
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+	.fault		= tracing_buffers_mmap_fault,
+};
+
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	struct ring_buffer *buffer = iter->trace_buffer->buffer;
+	int ret;
+
+	/* The buffer is only readable, the writer is the kernel */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	ret = ring_buffer_map(buffer, iter->cpu_file);
+	if (ret)
+		return ret;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_private_data = buffer;
+	vma->vm_ops = &tracing_buffers_vmops;
+
+	return 0;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
 	.poll		= tracing_buffers_poll,
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
+	.unlocked_ioctl	= tracing_buffers_ioctl,
+	.mmap		= tracing_buffers_mmap,
 	.llseek		= no_llseek,
 };
 
@@ -1318,4 +1318,20 @@ static inline void trace_event_enum_update(struct trace_enum_map **map, int len)
 
 extern struct trace_iterator *tracepoint_print_iter;
 
+#ifdef CONFIG_LATENCY_HIST
+void latency_hist_irqs_off(void);
+void latency_hist_irqs_on(void);
+void latency_hist_preempt_off(void);
+void latency_hist_preempt_on(void);
+void latency_hist_stop_timings(void);
+void latency_hist_start_timings(void);
+#else
+static inline void latency_hist_irqs_off(void) { }
+static inline void latency_hist_irqs_on(void) { }
+static inline void latency_hist_preempt_off(void) { }
+static inline void latency_hist_preempt_on(void) { }
+static inline void latency_hist_stop_timings(void) { }
+static inline void latency_hist_start_timings(void) { }
+#endif
+
 #endif /* _LINUX_KERNEL_TRACE_H */
@@ -0,0 +1,418 @@
+/*
+ * Latency histograms for irqs-off, preempt-off and wakeup latencies
+ *
+ * The latency tracers keep the single worst case and its trace. These
+ * histograms keep the distribution instead, per CPU and in log2 buckets
+ * of nanoseconds, at the cost of two clock reads and a few per cpu
+ * increments per section, so that they can be left on for days.
+ *
+ * tracing/latency_hist/<type>/enable	switch the histogram on or off
+ * tracing/latency_hist/<type>/reset	clear all CPUs on any write
+ * tracing/latency_hist/<type>/cpuN	the histogram of CPU N
+ *
+ * Bucket 0 counts zero latencies, bucket n > 0 the latencies of
+ * 2^(n-1) up to 2^n - 1 ns, and the last bucket everything above.
+ */
+#include <trace/events/sched.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/tracefs.h>
+#include <linux/percpu.h>
+#include <linux/mutex.h>
+#include <linux/init.h>
+
+#include "trace.h"
+
+#define LAT_HIST_BUCKETS	40
+
+struct lat_hist {
+	unsigned long	samples[LAT_HIST_BUCKETS];
+	unsigned long	count;
+	u64		total;
+	u64		min;
+	u64		max;
+};
+
+enum {
+	LAT_HIST_IRQSOFF,
+	LAT_HIST_PREEMPTOFF,
+	LAT_HIST_WAKEUP,
+	NR_LAT_HISTS,
+};
+
+static const char *lat_hist_names[NR_LAT_HISTS] = {
+	[LAT_HIST_IRQSOFF]	= "irqsoff",
+	[LAT_HIST_PREEMPTOFF]	= "preemptoff",
+	[LAT_HIST_WAKEUP]	= "wakeup",
+};
+
+static int lat_hist_enabled[NR_LAT_HISTS] __read_mostly;
+static DEFINE_MUTEX(lat_hist_mutex);
+
+static DEFINE_PER_CPU(struct lat_hist [NR_LAT_HISTS], lat_hists);
+
+static DEFINE_PER_CPU(u64, irqsoff_start);
+static DEFINE_PER_CPU(u64, preemptoff_start);
+
+/* The highest priority task woken on a CPU and not yet running */
+struct wakeup_task {
+	raw_spinlock_t		lock;
+	struct task_struct	*task;
+	pid_t			pid;
+	int			prio;
+	u64			ts;
+};
+
+static DEFINE_PER_CPU(struct wakeup_task, wakeup_task);
+
+static void lat_hist_record(int type, int cpu, u64 delta)
+{
+	struct lat_hist *hist = &per_cpu(lat_hists, cpu)[type];
+	int bucket = fls64(delta);
+
+	if (bucket >= LAT_HIST_BUCKETS)
+		bucket = LAT_HIST_BUCKETS - 1;
+
+	hist->samples[bucket]++;
+	hist->total += delta;
+	if (!hist->count++ || delta < hist->min)
+		hist->min = delta;
+	if (delta > hist->max)
+		hist->max = delta;
+}
+
+static void lat_hist_start(int type, u64 __percpu *start)
+{
+	if (!lat_hist_enabled[type] || __this_cpu_read(*start))
+		return;
+
+	__this_cpu_write(*start, trace_clock_local());
+}
+
+static void lat_hist_stop(int type, u64 __percpu *start)
+{
+	u64 t0 = __this_cpu_read(*start);
+
+	if (!t0)
+		return;
+
+	__this_cpu_write(*start, 0);
+	lat_hist_record(type, raw_smp_processor_id(),
+			trace_clock_local() - t0);
+}
+
+/* Called from trace_hardirqs_off/on() with irqs disabled */
+void latency_hist_irqs_off(void)
+{
+	lat_hist_start(LAT_HIST_IRQSOFF, &irqsoff_start);
+}
+
+void latency_hist_irqs_on(void)
+{
+	lat_hist_stop(LAT_HIST_IRQSOFF, &irqsoff_start);
+}
+
+/* Called from trace_preempt_off/on() with preemption disabled */
+void latency_hist_preempt_off(void)
+{
+	lat_hist_start(LAT_HIST_PREEMPTOFF, &preemptoff_start);
+}
+
+void latency_hist_preempt_on(void)
+{
+	lat_hist_stop(LAT_HIST_PREEMPTOFF, &preemptoff_start);
+}
+
+/* Idle does not count as a critical section, see stop_critical_timings() */
+void latency_hist_stop_timings(void)
+{
+	__this_cpu_write(irqsoff_start, 0);
+	__this_cpu_write(preemptoff_start, 0);
+}
+
+void latency_hist_start_timings(void)
+{
+	if (irqs_disabled())
+		latency_hist_irqs_off();
+	if (preempt_count())
+		latency_hist_preempt_off();
+}
+
+static void lat_hist_wakeup_set(int cpu, struct task_struct *p, u64 ts)
+{
+	struct wakeup_task *w = &per_cpu(wakeup_task, cpu);
+
+	raw_spin_lock(&w->lock);
+	if (!w->task || p->prio < w->prio) {
+		w->task = p;
+		w->pid = p->pid;
+		w->prio = p->prio;
+		w->ts = ts;
+	}
+	raw_spin_unlock(&w->lock);
+}
+
+static void notrace
+probe_lat_hist_wakeup(void *ignore, struct task_struct *p, int success)
+{
+	lat_hist_wakeup_set(task_cpu(p), p, trace_clock_local());
+}
+
+static void notrace
+probe_lat_hist_migrate(void *ignore, struct task_struct *p, int cpu)
+{
+	struct wakeup_task *w = &per_cpu(wakeup_task, task_cpu(p));
+	bool moved = false;
+	u64 ts = 0;
+
+	raw_spin_lock(&w->lock);
+	if (w->task == p && w->pid == p->pid) {
+		ts = w->ts;
+		w->task = NULL;
+		moved = true;
+	}
+	raw_spin_unlock(&w->lock);
+
+	if (moved)
+		lat_hist_wakeup_set(cpu, p, ts);
+}
+
+static void notrace
+probe_lat_hist_switch(void *ignore,
+		      struct task_struct *prev, struct task_struct *next)
+{
+	int cpu = raw_smp_processor_id();
+	struct wakeup_task *w = &per_cpu(wakeup_task, cpu);
+	u64 ts = 0;
+
+	raw_spin_lock(&w->lock);
+	if (w->task == next && w->pid == next->pid) {
+		ts = w->ts;
+		w->task = NULL;
+	}
+	raw_spin_unlock(&w->lock);
+
+	if (ts)
+		lat_hist_record(LAT_HIST_WAKEUP, cpu, trace_clock_local() - ts);
+}
+
+static int lat_hist_wakeup_register(void)
+{
+	int ret;
+
+	ret = register_trace_sched_wakeup(probe_lat_hist_wakeup, NULL);
+	if (ret)
+		return ret;
+
+	ret = register_trace_sched_wakeup_new(probe_lat_hist_wakeup, NULL);
+	if (ret)
+		goto fail_wakeup;
+
+	ret = register_trace_sched_migrate_task(probe_lat_hist_migrate, NULL);
+	if (ret)
+		goto fail_wakeup_new;
+
+	ret = register_trace_sched_switch(probe_lat_hist_switch, NULL);
+	if (ret)
+		goto fail_migrate;
+
+	return 0;
+
+fail_migrate:
+	unregister_trace_sched_migrate_task(probe_lat_hist_migrate, NULL);
+fail_wakeup_new:
+	unregister_trace_sched_wakeup_new(probe_lat_hist_wakeup, NULL);
+fail_wakeup:
+	unregister_trace_sched_wakeup(probe_lat_hist_wakeup, NULL);
+	return ret;
+}
+
+static void lat_hist_wakeup_unregister(void)
+{
+	int cpu;
+
+	unregister_trace_sched_switch(probe_lat_hist_switch, NULL);
+	unregister_trace_sched_migrate_task(probe_lat_hist_migrate, NULL);
+	unregister_trace_sched_wakeup_new(probe_lat_hist_wakeup, NULL);
+	unregister_trace_sched_wakeup(probe_lat_hist_wakeup, NULL);
+	tracepoint_synchronize_unregister();
+
+	for_each_possible_cpu(cpu)
+		per_cpu(wakeup_task, cpu).task = NULL;
+}
+
+static int lat_hist_show(struct seq_file *m, void *v)
+{
+	struct lat_hist *hist = m->private;
+	unsigned long count = hist->count;
+	int i, last = 0;
+
+	seq_printf(m, "#Samples: %lu\n", count);
+	if (count) {
+		seq_printf(m, "#Minimum: %llu ns\n", hist->min);
+		seq_printf(m, "#Average: %llu ns\n",
+			   div64_u64(hist->total, count));
+		seq_printf(m, "#Maximum: %llu ns\n", hist->max);
+	}
+
+	for (i = 0; i < LAT_HIST_BUCKETS; i++)
+		if (hist->samples[i])
+			last = i;
+
+	seq_puts(m, "#ns >=\tsamples\n");
+	for (i = 0; i <= last; i++)
+		seq_printf(m, "%llu\t%lu\n", i ? 1ULL << (i - 1) : 0ULL,
+			   hist->samples[i]);
+
+	return 0;
+}
+
+static int lat_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lat_hist_show, inode->i_private);
+}
+
+static const struct file_operations lat_hist_fops = {
+	.open		= lat_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static ssize_t
+lat_hist_enable_read(struct file *filp, char __user *ubuf,
+		     size_t cnt, loff_t *ppos)
+{
+	int *enabled = filp->private_data;
+	char buf[4];
+	int r;
+
+	r = snprintf(buf, sizeof(buf), "%d\n", *enabled);
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static ssize_t
+lat_hist_enable_write(struct file *filp, const char __user *ubuf,
+		      size_t cnt, loff_t *ppos)
+{
+	int *enabled = filp->private_data;
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul_from_user(ubuf, cnt, 10, &val);
+	if (ret)
+		return ret;
+
+	val = !!val;
+
+	mutex_lock(&lat_hist_mutex);
+	if (val == *enabled)
+		goto out;
+
+	if (enabled == &lat_hist_enabled[LAT_HIST_WAKEUP]) {
+		if (val)
+			ret = lat_hist_wakeup_register();
+		else
+			lat_hist_wakeup_unregister();
+	}
+	if (!ret)
+		*enabled = val;
+ out:
+	mutex_unlock(&lat_hist_mutex);
+
+	if (ret)
+		return ret;
+
+	*ppos += cnt;
+	return cnt;
+}
+
+static const struct file_operations lat_hist_enable_fops = {
+	.open		= tracing_open_generic,
+	.read		= lat_hist_enable_read,
+	.write		= lat_hist_enable_write,
+	.llseek		= generic_file_llseek,
+};
+
+/*
+ * Counters being updated meanwhile on other CPUs may survive the
+ * reset by one sample; a histogram is not worth an IPI.
+ */
+static ssize_t
+lat_hist_reset_write(struct file *filp, const char __user *ubuf,
+		     size_t cnt, loff_t *ppos)
+{
+	int type = (int *)filp->private_data - lat_hist_enabled;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(lat_hists, cpu)[type], 0,
+		       sizeof(struct lat_hist));
+
+	*ppos += cnt;
+	return cnt;
+}
+
+static const struct file_operations lat_hist_reset_fops = {
+	.open		= tracing_open_generic,
+	.write		= lat_hist_reset_write,
+	.llseek		= generic_file_llseek,
+};
+
+static bool __init lat_hist_supported(int type)
+{
+	switch (type) {
+	case LAT_HIST_IRQSOFF:
+		return IS_ENABLED(CONFIG_IRQSOFF_TRACER);
+	case LAT_HIST_PREEMPTOFF:
+		return IS_ENABLED(CONFIG_PREEMPT_TRACER);
+	default:
+		return true;
+	}
+}
+
+static __init int latency_hist_init(void)
+{
+	struct dentry *d_tracer, *d_hist, *d_type;
+	char name[16];
+	int type, cpu;
+
+	for_each_possible_cpu(cpu)
+		raw_spin_lock_init(&per_cpu(wakeup_task, cpu).lock);
+
+	d_tracer = tracing_init_dentry();
+	if (IS_ERR(d_tracer))
+		return 0;
+
+	d_hist = tracefs_create_dir("latency_hist", d_tracer);
+	if (!d_hist) {
+		pr_warn("Could not create tracefs 'latency_hist' directory\n");
+		return 0;
+	}
+
+	for (type = 0; type < NR_LAT_HISTS; type++) {
+		if (!lat_hist_supported(type))
+			continue;
+
+		d_type = tracefs_create_dir(lat_hist_names[type], d_hist);
+		if (!d_type)
+			continue;
+
+		trace_create_file("enable", 0644, d_type,
+				  &lat_hist_enabled[type],
+				  &lat_hist_enable_fops);
+		trace_create_file("reset", 0200, d_type,
+				  &lat_hist_enabled[type],
+				  &lat_hist_reset_fops);
+
+		for_each_possible_cpu(cpu) {
+			snprintf(name, sizeof(name), "cpu%d", cpu);
+			trace_create_file(name, 0444, d_type,
+					  &per_cpu(lat_hists, cpu)[type],
+					  &lat_hist_fops);
+		}
+	}
+
+	return 0;
+}
+device_initcall(latency_hist_init);
@@ -92,6 +92,7 @@ static int lz4_uncompress(const char *source, char *dest, int osize)
 			ip += length;
 			break; /* EOF */
 		}
+		LZ4_LONGCOPY(ip, op, cpy);
 		LZ4_WILDCOPY(ip, op, cpy);
 		ip -= (op - cpy);
 		op = cpy;
@@ -155,6 +156,8 @@ static int lz4_uncompress(const char *source, char *dest, int osize)
 				goto _output_error;
 			continue;
 		}
+		if (op - ref >= 16)
+			LZ4_LONGCOPY(ref, op, cpy);
 		LZ4_SECURECOPY(ref, op, cpy);
 		op = cpy; /* correction */
 	}
@@ -214,6 +217,7 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 			op += length;
 			break;/* Necessarily EOF, due to parsing restrictions */
 		}
+		LZ4_LONGCOPY(ip, op, cpy);
 		LZ4_WILDCOPY(ip, op, cpy);
 		ip -= (op - cpy);
 		op = cpy;
@@ -279,6 +283,8 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 				goto _output_error;
 			continue;
 		}
+		if (op - ref >= 16)
+			LZ4_LONGCOPY(ref, op, cpy);
 		LZ4_SECURECOPY(ref, op, cpy);
 		op = cpy; /* correction */
 	}
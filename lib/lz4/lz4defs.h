@@ -35,6 +35,31 @@ typedef struct _U64_S { u64 v; } U64_S;
 
 #define PUT4(s, d) (A32(d) = A32(s))
 #define PUT8(s, d) (A64(d) = A64(s))
+#define LZ4_WRITE_LITTLEENDIAN_16(p, v)	\
+	do {	\
+		A16(p) = v; \
+		p += 2; \
+	} while (0)
+#elif defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6 && defined(CONFIG_MMU)
+/*
+ * ARMv6 and later run both the kernel and the zImage decompressor with
+ * unaligned ldr/str allowed. The packed structs keep the compiler from
+ * pairing these into ldrd/ldm, which still fault on unaligned addresses.
+ */
+#define LZ4_ARM_UNALIGNED 1
+
+typedef struct { u16 v; } __packed U16_P;
+typedef struct { u32 v; } __packed U32_P;
+
+#define A16(x) (((U16_P *)(x))->v)
+#define A32(x) (((U32_P *)(x))->v)
+
+#define PUT4(s, d) (A32(d) = A32(s))
+#define PUT8(s, d)	\
+	do {	\
+		PUT4(s, d); \
+		PUT4((const u8 *)(s) + 4, (u8 *)(d) + 4); \
+	} while (0)
 #define LZ4_WRITE_LITTLEENDIAN_16(p, v)	\
 	do {	\
 		A16(p) = v; \
@@ -148,6 +173,30 @@ typedef struct _U64_S { u64 v; } U64_S;
 		LZ4_COPYPACKET(s, d);	\
 	} while (d < e)
 
+#ifdef LZ4_ARM_UNALIGNED
+/*
+ * Long runs go 16 bytes at a time, with all four loads issued before the
+ * stores. The source must therefore lie at least 16 bytes behind the
+ * destination, which always holds for literals and is checked for matches.
+ * Stops short of e, so that LZ4_WILDCOPY still does the tail.
+ */
+#define LZ4_LONGCOPY(s, d, e)				\
+	do {						\
+		while ((e) - (d) >= 16) {		\
+			u32 w0 = A32(s), w1 = A32(s + 4);	\
+			u32 w2 = A32(s + 8), w3 = A32(s + 12);	\
+			A32(d) = w0;			\
+			A32(d + 4) = w1;		\
+			A32(d + 8) = w2;		\
+			A32(d + 12) = w3;		\
+			d += 16;			\
+			s += 16;			\
+		}					\
+	} while (0)
+#else
+#define LZ4_LONGCOPY(s, d, e)	do { } while (0)
+#endif
+
 #define LZ4_BLINDCOPY(s, d, l)	\
 	do {	\
 		u8 *e = (d) + l;	\
@@ -0,0 +1,104 @@
+/*
+ * linux/lib/raid6/recov_neon_inner.c - RAID6 recovery NEON inner loops
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <arm_neon.h>
+
+#ifndef __aarch64__
+/*
+ * AArch32 has no 128-bit table lookup, only the 64-bit wide vtbl.8, so
+ * build vqtbl1q_u8() from two of those.
+ */
+static uint8x16_t vqtbl1q_u8(uint8x16_t a, uint8x16_t b)
+{
+	union {
+		uint8x16_t	val;
+		uint8x8x2_t	pair;
+	} __a = { a };
+
+	return vcombine_u8(vtbl2_u8(__a.pair, vget_low_u8(b)),
+			   vtbl2_u8(__a.pair, vget_high_u8(b)));
+}
+#endif
+
+/*
+ * The raid6_vgfmul[] tables hold the products of a constant with each
+ * low nibble in their first 16 bytes and with each high nibble in the
+ * next 16, so a byte is multiplied with two table lookups and an XOR.
+ */
+static inline uint8x16_t gfmul(uint8x16_t x, uint8x16_t m0, uint8x16_t m1)
+{
+	uint8x16_t lo = vqtbl1q_u8(m0, vandq_u8(x, vdupq_n_u8(0x0f)));
+	uint8x16_t hi = vqtbl1q_u8(m1, vshrq_n_u8(x, 4));
+
+	return veorq_u8(lo, hi);
+}
+
+void __raid6_2data_recov_neon(int bytes, uint8_t *p, uint8_t *q, uint8_t *dp,
+			      uint8_t *dq, const uint8_t *pbmul,
+			      const uint8_t *qmul)
+{
+	uint8x16_t pm0 = vld1q_u8(pbmul);
+	uint8x16_t pm1 = vld1q_u8(pbmul + 16);
+	uint8x16_t qm0 = vld1q_u8(qmul);
+	uint8x16_t qm1 = vld1q_u8(qmul + 16);
+
+	/*
+	 * while ( bytes-- ) {
+	 *	uint8_t px, qx, db;
+	 *
+	 *	px    = *p ^ *dp;
+	 *	qx    = qmul[*q ^ *dq];
+	 *	*dq++ = db = pbmul[px] ^ qx;
+	 *	*dp++ = db ^ px;
+	 *	p++; q++;
+	 * }
+	 */
+	while (bytes) {
+		uint8x16_t px, qx, db;
+
+		px = veorq_u8(vld1q_u8(p), vld1q_u8(dp));
+		qx = gfmul(veorq_u8(vld1q_u8(q), vld1q_u8(dq)), qm0, qm1);
+		db = veorq_u8(gfmul(px, pm0, pm1), qx);
+
+		vst1q_u8(dq, db);
+		vst1q_u8(dp, veorq_u8(db, px));
+
+		bytes -= 16;
+		p += 16;
+		q += 16;
+		dp += 16;
+		dq += 16;
+	}
+}
+
+void __raid6_datap_recov_neon(int bytes, uint8_t *p, uint8_t *q, uint8_t *dq,
+			      const uint8_t *qmul)
+{
+	uint8x16_t qm0 = vld1q_u8(qmul);
+	uint8x16_t qm1 = vld1q_u8(qmul + 16);
+
+	/*
+	 * while (bytes--) {
+	 *	*p++ ^= *dq = qmul[*q ^ *dq];
+	 *	q++; dq++;
+	 * }
+	 */
+	while (bytes) {
+		uint8x16_t vx;
+
+		vx = gfmul(veorq_u8(vld1q_u8(q), vld1q_u8(dq)), qm0, qm1);
+
+		vst1q_u8(dq, vx);
+		vst1q_u8(p, veorq_u8(vx, vld1q_u8(p)));
+
+		bytes -= 16;
+		p += 16;
+		q += 16;
+		dq += 16;
+	}
+}
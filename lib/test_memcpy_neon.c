@@ -0,0 +1,164 @@
+/*
+ * Kernel module for testing and timing the ARM NEON memcpy.
+ *
+ * Checks memcpy_neon() and copy_page() against memcpy() over a range of
+ * sizes and alignments, then reports the throughput of each for large
+ * copies.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <asm/neon.h>
+
+#define BUF_SIZE	(64 * 1024)
+#define GUARD		64
+#define BENCH_BYTES	(32 * 1024 * 1024)
+
+static const size_t sizes[] = {
+	1, 63, 64, 65, 1023, 1024, 1025, 1087, 4096, 8191, 16384, BUF_SIZE,
+};
+
+static const size_t bench_sizes[] = { 1024, 4096, 16384, BUF_SIZE };
+
+static u8 *src, *dst;
+
+static int __init check_copy(size_t size, unsigned int soff,
+			     unsigned int doff)
+{
+	size_t i;
+
+	memset(dst, 0xa5, BUF_SIZE + 2 * GUARD);
+	memcpy_neon(dst + GUARD + doff, src + soff, size);
+
+	for (i = 0; i < GUARD + doff; i++)
+		if (dst[i] != 0xa5)
+			goto fail;
+	for (i = 0; i < size; i++)
+		if (dst[GUARD + doff + i] != src[soff + i])
+			goto fail;
+	for (i += GUARD + doff; i < BUF_SIZE + 2 * GUARD; i++)
+		if (dst[i] != 0xa5)
+			goto fail;
+
+	return 0;
+fail:
+	pr_warn("memcpy_neon(%zu) with offsets %u/%u is wrong at %zu\n",
+		size, soff, doff, i);
+	return -EINVAL;
+}
+
+static u64 __init time_copy(void *(*copy)(void *, const void *, size_t),
+			    size_t size)
+{
+	unsigned int i, loops = BENCH_BYTES / size;
+	ktime_t start;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++)
+		copy(dst, src, size);
+
+	return ktime_to_ns(ktime_sub(ktime_get(), start)) ?: 1;
+}
+
+static void __init bench(void)
+{
+	const u64 bytes = BENCH_BYTES * 1000ULL;
+	unsigned int i;
+	u64 ns_arm, ns_neon;
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		ns_arm = time_copy(memcpy, bench_sizes[i]);
+		ns_neon = time_copy(memcpy_neon, bench_sizes[i]);
+
+		pr_info("%6zu byte copies: memcpy %llu MB/s, neon %llu MB/s\n",
+			bench_sizes[i], div64_u64(bytes, ns_arm),
+			div64_u64(bytes, ns_neon));
+	}
+}
+
+static int __init test_page(void)
+{
+	void *from, *to;
+	int ret = 0;
+
+	from = (void *)__get_free_page(GFP_KERNEL);
+	to = (void *)__get_free_page(GFP_KERNEL);
+	if (!from || !to) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	memcpy(from, src, PAGE_SIZE);
+	copy_page(to, from);
+	if (memcmp(to, from, PAGE_SIZE)) {
+		pr_warn("copy_page() is wrong\n");
+		ret = -EINVAL;
+	}
+out:
+	free_page((unsigned long)to);
+	free_page((unsigned long)from);
+	return ret;
+}
+
+static int __init test_memcpy_neon_init(void)
+{
+	unsigned int i, soff, doff;
+	int ret = -ENOMEM;
+
+	if (!cpu_has_neon()) {
+		pr_info("no NEON, memcpy_neon() is plain memcpy()\n");
+		return -ENODEV;
+	}
+
+	src = vmalloc(BUF_SIZE + GUARD);
+	dst = vmalloc(BUF_SIZE + 2 * GUARD);
+	if (!src || !dst)
+		goto out;
+
+	for (i = 0; i < BUF_SIZE + GUARD; i++)
+		src[i] = i * 7 + (i >> 8);
+
+	ret = 0;
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		for (soff = 0; soff < 8; soff += 3)
+			for (doff = 0; doff < 8; doff += 5)
+				ret |= check_copy(sizes[i], soff, doff);
+	ret |= test_page();
+
+	if (ret) {
+		pr_warn("failed\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	pr_info("all tests passed\n");
+	bench();
+
+	/* the module has nothing to do once loaded */
+	ret = -EAGAIN;
+out:
+	vfree(dst);
+	vfree(src);
+	return ret;
+}
+
+module_init(test_memcpy_neon_init);
+
+MODULE_DESCRIPTION("NEON memcpy test and benchmark");
+MODULE_LICENSE("GPL");
@@ -208,6 +208,24 @@ static ssize_t max_ratio_store(struct device *dev,
 }
 BDI_SHOW(max_ratio, bdi->max_ratio)
 
+static ssize_t erase_block_kb_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+	unsigned long erase_block_kb;
+	ssize_t ret;
+
+	ret = kstrtoul(buf, 10, &erase_block_kb);
+	if (ret < 0)
+		return ret;
+
+	bdi->erase_pages = erase_block_kb >> (PAGE_SHIFT - 10);
+
+	return count;
+}
+BDI_SHOW(erase_block_kb, K(bdi->erase_pages))
+
 static ssize_t stable_pages_required_show(struct device *dev,
 					  struct device_attribute *attr,
 					  char *page)
@@ -223,6 +241,7 @@ static struct attribute *bdi_dev_attrs[] = {
 	&dev_attr_read_ahead_kb.attr,
 	&dev_attr_min_ratio.attr,
 	&dev_attr_max_ratio.attr,
+	&dev_attr_erase_block_kb.attr,
 	&dev_attr_stable_pages_required.attr,
 	NULL,
 };
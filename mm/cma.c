@@ -35,6 +35,8 @@
 #include <linux/cma.h>
 #include <linux/highmem.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 #include <trace/events/cma.h>
 
 #include "cma.h"
@@ -43,6 +45,16 @@ struct cma cma_areas[MAX_CMA_AREAS];
 unsigned cma_area_count;
 static DEFINE_MUTEX(cma_mutex);
 
+/* Bytes of each area to keep compacted, from "cma_ready=" */
+static phys_addr_t cma_ready_bytes __initdata;
+
+static int __init early_cma_ready(char *p)
+{
+	cma_ready_bytes = memparse(p, &p);
+	return 0;
+}
+early_param("cma_ready", early_cma_ready);
+
 phys_addr_t cma_get_base(const struct cma *cma)
 {
 	return PFN_PHYS(cma->base_pfn);
@@ -94,6 +106,154 @@ static void cma_clear_bitmap(struct cma *cma, unsigned long pfn,
 	mutex_unlock(&cma->lock);
 }
 
+/* The ready pool is filled in blocks of this many pages */
+static unsigned long cma_ready_chunk(const struct cma *cma)
+{
+	return max_t(unsigned long, pageblock_nr_pages,
+		     1UL << cma->order_per_bit);
+}
+
+static void cma_ready_kick(struct cma *cma)
+{
+	if (READ_ONCE(cma->ready_count) < READ_ONCE(cma->ready_target))
+		queue_work(system_unbound_wq, &cma->ready_work);
+}
+
+/*
+ * Migrate the movable pages out of free blocks of the area and hold the
+ * blocks until ready_target pages are ready, so that cma_alloc() can hand
+ * them out without migrating anything.
+ */
+static void cma_ready_work(struct work_struct *work)
+{
+	struct cma *cma = container_of(work, struct cma, ready_work);
+	unsigned long chunk_pages = cma_ready_chunk(cma);
+	unsigned long chunk = cma_bitmap_pages_to_bits(cma, chunk_pages);
+	unsigned long bitmap_maxno = cma_bitmap_maxno(cma);
+	unsigned long bitmap_no, pfn, start = 0;
+	int ret;
+
+	for (;;) {
+		mutex_lock(&cma->lock);
+		if (cma->ready_count >= cma->ready_target) {
+			mutex_unlock(&cma->lock);
+			break;
+		}
+		bitmap_no = bitmap_find_next_zero_area(cma->bitmap,
+				bitmap_maxno, start, chunk, chunk - 1);
+		if (bitmap_no >= bitmap_maxno) {
+			mutex_unlock(&cma->lock);
+			break;
+		}
+		bitmap_set(cma->bitmap, bitmap_no, chunk);
+		mutex_unlock(&cma->lock);
+
+		pfn = cma->base_pfn + (bitmap_no << cma->order_per_bit);
+		mutex_lock(&cma_mutex);
+		ret = alloc_contig_range(pfn, pfn + chunk_pages, MIGRATE_CMA);
+		mutex_unlock(&cma_mutex);
+		start = bitmap_no + chunk;
+
+		if (ret) {
+			cma_clear_bitmap(cma, pfn, chunk_pages);
+			if (ret != -EBUSY)
+				break;
+			continue;
+		}
+
+		mutex_lock(&cma->lock);
+		bitmap_clear(cma->prep_bitmap, bitmap_no, chunk);
+		cma->ready_count += chunk_pages;
+		mutex_unlock(&cma->lock);
+		cond_resched();
+	}
+}
+
+/*
+ * Hand a range of the ready pool to cma_alloc(). Pages past @count that
+ * only belong to the range because of order_per_bit go back to the buddy
+ * allocator, which leaves the range just as alloc_contig_range() would.
+ */
+static struct page *cma_alloc_ready(struct cma *cma, unsigned int count,
+				    unsigned long mask, unsigned long offset)
+{
+	unsigned long bitmap_count = cma_bitmap_pages_to_bits(cma, count);
+	unsigned long bitmap_no, pfn, pages;
+
+	if (!READ_ONCE(cma->ready_count))
+		return NULL;
+
+	mutex_lock(&cma->lock);
+	bitmap_no = bitmap_find_next_zero_area_off(cma->prep_bitmap,
+			cma_bitmap_maxno(cma), 0, bitmap_count, mask, offset);
+	if (bitmap_no >= cma_bitmap_maxno(cma)) {
+		mutex_unlock(&cma->lock);
+		return NULL;
+	}
+	bitmap_set(cma->prep_bitmap, bitmap_no, bitmap_count);
+	pages = bitmap_count << cma->order_per_bit;
+	cma->ready_count -= pages;
+	mutex_unlock(&cma->lock);
+
+	pfn = cma->base_pfn + (bitmap_no << cma->order_per_bit);
+	if (pages > count)
+		free_contig_range(pfn + count, pages - count);
+
+	return pfn_to_page(pfn);
+}
+
+/* Give the whole ready pool back. Returns false if it was empty. */
+static bool cma_drain_ready(struct cma *cma)
+{
+	unsigned long bitmap_maxno = cma_bitmap_maxno(cma);
+	unsigned long start, end = 0;
+	bool drained = false;
+
+	mutex_lock(&cma->lock);
+	for (;;) {
+		start = find_next_zero_bit(cma->prep_bitmap, bitmap_maxno, end);
+		if (start >= bitmap_maxno)
+			break;
+		end = find_next_bit(cma->prep_bitmap, bitmap_maxno, start);
+
+		free_contig_range(cma->base_pfn + (start << cma->order_per_bit),
+				  (end - start) << cma->order_per_bit);
+		bitmap_set(cma->prep_bitmap, start, end - start);
+		bitmap_clear(cma->bitmap, start, end - start);
+		drained = true;
+	}
+	cma->ready_count = 0;
+	mutex_unlock(&cma->lock);
+
+	return drained;
+}
+
+/**
+ * cma_set_ready_target() - set how much of an area to keep compacted
+ * @cma:   Contiguous memory area.
+ * @pages: Number of pages, rounded up to whole pageblocks.
+ *
+ * Lowering the target gives the ready pool back before it is refilled.
+ */
+int cma_set_ready_target(struct cma *cma, unsigned long pages)
+{
+	unsigned long chunk = cma_ready_chunk(cma);
+
+	if (pages > cma->count)
+		return -EINVAL;
+
+	pages = ALIGN(pages, chunk);
+	mutex_lock(&cma->lock);
+	cma->ready_target = pages;
+	mutex_unlock(&cma->lock);
+
+	if (READ_ONCE(cma->ready_count) > pages)
+		cma_drain_ready(cma);
+	cma_ready_kick(cma);
+
+	return 0;
+}
+
 static int __init cma_activate_area(struct cma *cma)
 {
 	int bitmap_size = BITS_TO_LONGS(cma_bitmap_maxno(cma)) * sizeof(long);
@@ -106,6 +266,13 @@ static int __init cma_activate_area(struct cma *cma)
 	if (!cma->bitmap)
 		return -ENOMEM;
 
+	cma->prep_bitmap = kmalloc(bitmap_size, GFP_KERNEL);
+	if (!cma->prep_bitmap) {
+		kfree(cma->bitmap);
+		return -ENOMEM;
+	}
+	memset(cma->prep_bitmap, 0xff, bitmap_size);
+
 	WARN_ON_ONCE(!pfn_valid(pfn));
 	zone = page_zone(pfn_to_page(pfn));
 
@@ -128,6 +295,7 @@ static int __init cma_activate_area(struct cma *cma)
 	} while (--i);
 
 	mutex_init(&cma->lock);
+	INIT_WORK(&cma->ready_work, cma_ready_work);
 
 #ifdef CONFIG_CMA_DEBUGFS
 	INIT_HLIST_HEAD(&cma->mem_head);
@@ -137,6 +305,7 @@ static int __init cma_activate_area(struct cma *cma)
 	return 0;
 
 err:
+	kfree(cma->prep_bitmap);
 	kfree(cma->bitmap);
 	cma->count = 0;
 	return -EINVAL;
@@ -144,6 +313,7 @@ err:
 
 static int __init cma_init_reserved_areas(void)
 {
+	unsigned long ready = cma_ready_bytes >> PAGE_SHIFT;
 	int i;
 
 	for (i = 0; i < cma_area_count; i++) {
@@ -151,6 +321,10 @@ static int __init cma_init_reserved_areas(void)
 
 		if (ret)
 			return ret;
+
+		if (ready)
+			cma_set_ready_target(&cma_areas[i],
+				min(ready, cma_areas[i].count));
 	}
 
 	return 0;
@@ -350,6 +524,31 @@ err:
 	return ret;
 }
 
+static void cma_account(struct cma *cma, struct page *page, int ret,
+			bool ready, unsigned long retries, ktime_t begin)
+{
+	struct cma_stat *stat = &cma->stat;
+	u64 us = ktime_us_delta(ktime_get(), begin);
+
+	mutex_lock(&cma->lock);
+	stat->nr_retry += retries;
+	if (page) {
+		stat->nr_alloc++;
+		if (ready)
+			stat->nr_alloc_ready++;
+	} else if (ret == -ENOSPC) {
+		stat->nr_fail_nospace++;
+	} else if (ret == -EBUSY) {
+		stat->nr_fail_busy++;
+	} else {
+		stat->nr_fail_other++;
+	}
+	stat->lat_total_us += us;
+	if (us > stat->lat_max_us)
+		stat->lat_max_us = us;
+	mutex_unlock(&cma->lock);
+}
+
 /**
  * cma_alloc() - allocate pages from contiguous area
  * @cma:   Contiguous memory region for which the allocation is performed.
@@ -363,8 +562,11 @@ struct page *cma_alloc(struct cma *cma, unsigned int count, unsigned int align)
 {
 	unsigned long mask, offset, pfn, start = 0;
 	unsigned long bitmap_maxno, bitmap_no, bitmap_count;
+	unsigned long retries = 0;
 	struct page *page = NULL;
-	int ret;
+	bool drained = false, ready = false;
+	ktime_t begin;
+	int ret = -ENOSPC;
 
 	if (!cma || !cma->count)
 		return NULL;
@@ -380,13 +582,33 @@ struct page *cma_alloc(struct cma *cma, unsigned int count, unsigned int align)
 	bitmap_maxno = cma_bitmap_maxno(cma);
 	bitmap_count = cma_bitmap_pages_to_bits(cma, count);
 
-	for (;;) {
+	begin = ktime_get();
+	trace_cma_alloc_start(cma->base_pfn, count, align);
+
+	page = cma_alloc_ready(cma, count, mask, offset);
+	if (page) {
+		pfn = page_to_pfn(page);
+		ready = true;
+		ret = 0;
+	}
+
+	while (!page) {
 		mutex_lock(&cma->lock);
 		bitmap_no = bitmap_find_next_zero_area_off(cma->bitmap,
 				bitmap_maxno, start, bitmap_count, mask,
 				offset);
 		if (bitmap_no >= bitmap_maxno) {
 			mutex_unlock(&cma->lock);
+			/*
+			 * The ready pool could not serve the request in
+			 * one piece, but may be in the way of a range
+			 * that can. Give it back and look once more.
+			 */
+			if (!drained && cma_drain_ready(cma)) {
+				drained = true;
+				start = 0;
+				continue;
+			}
 			break;
 		}
 		bitmap_set(cma->bitmap, bitmap_no, bitmap_count);
@@ -412,10 +634,15 @@ struct page *cma_alloc(struct cma *cma, unsigned int count, unsigned int align)
 
 		pr_debug("%s(): memory range at %p is busy, retrying\n",
 			 __func__, pfn_to_page(pfn));
+		trace_cma_alloc_busy_retry(pfn, pfn_to_page(pfn), count,
+					   align);
+		retries++;
 		/* try again with a bit different memory target */
 		start = bitmap_no + mask + 1;
 	}
 
+	cma_account(cma, page, ret, ready, retries, begin);
+	cma_ready_kick(cma);
 	trace_cma_alloc(page ? pfn : -1UL, page, count, align);
 
 	pr_debug("%s(): returned %p\n", __func__, page);
@@ -450,6 +677,7 @@ bool cma_release(struct cma *cma, const struct page *pages, unsigned int count)
 
 	free_contig_range(pfn, count);
 	cma_clear_bitmap(cma, pfn, count);
+	cma_ready_kick(cma);
 	trace_cma_release(pfn, pages, count);
 
 	return true;
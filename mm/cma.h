@@ -1,12 +1,36 @@
 #ifndef __MM_CMA_H__
 #define __MM_CMA_H__
 
+#include <linux/workqueue.h>
+
+/* Updated under cma->lock at the end of each cma_alloc() */
+struct cma_stat {
+	unsigned long nr_alloc;		/* successful allocations */
+	unsigned long nr_alloc_ready;	/* of those, served from ready pool */
+	unsigned long nr_retry;		/* busy ranges skipped */
+	unsigned long nr_fail_nospace;	/* no free range large enough */
+	unsigned long nr_fail_busy;	/* every free range was pinned */
+	unsigned long nr_fail_other;	/* -ENOMEM, -EINTR, ... */
+	u64 lat_total_us;
+	u64 lat_max_us;
+};
+
 struct cma {
 	unsigned long   base_pfn;
 	unsigned long   count;
 	unsigned long   *bitmap;
 	unsigned int order_per_bit; /* Order of pages represented by one bit */
 	struct mutex    lock;
+	/*
+	 * Blocks compacted ahead of time by ready_work and held for the
+	 * next cma_alloc(). A clear bit in prep_bitmap is such a block;
+	 * its bit in bitmap is set, so it is not allocated twice.
+	 */
+	unsigned long   *prep_bitmap;
+	unsigned long   ready_count;	/* pages */
+	unsigned long   ready_target;	/* pages */
+	struct work_struct ready_work;
+	struct cma_stat stat;
 #ifdef CONFIG_CMA_DEBUGFS
 	struct hlist_head mem_head;
 	spinlock_t mem_head_lock;
@@ -21,4 +45,6 @@ static unsigned long cma_bitmap_maxno(struct cma *cma)
 	return cma->count >> cma->order_per_bit;
 }
 
+int cma_set_ready_target(struct cma *cma, unsigned long pages);
+
 #endif
@@ -6,6 +6,7 @@
 
 
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/cma.h>
 #include <linux/list.h>
 #include <linux/kernel.h>
@@ -68,6 +69,55 @@ static int cma_maxchunk_get(void *data, u64 *val)
 }
 DEFINE_SIMPLE_ATTRIBUTE(cma_maxchunk_fops, cma_maxchunk_get, NULL, "%llu\n");
 
+static int cma_ready_target_set(void *data, u64 val)
+{
+	return cma_set_ready_target(data, val);
+}
+
+static int cma_ready_target_get(void *data, u64 *val)
+{
+	struct cma *cma = data;
+
+	*val = READ_ONCE(cma->ready_target);
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(cma_ready_target_fops, cma_ready_target_get,
+			cma_ready_target_set, "%llu\n");
+
+static int cma_stats_show(struct seq_file *m, void *v)
+{
+	struct cma *cma = m->private;
+	struct cma_stat stat;
+
+	mutex_lock(&cma->lock);
+	stat = cma->stat;
+	mutex_unlock(&cma->lock);
+
+	seq_printf(m, "alloc %lu\n", stat.nr_alloc);
+	seq_printf(m, "alloc_ready %lu\n", stat.nr_alloc_ready);
+	seq_printf(m, "retry_busy %lu\n", stat.nr_retry);
+	seq_printf(m, "fail_nospace %lu\n", stat.nr_fail_nospace);
+	seq_printf(m, "fail_busy %lu\n", stat.nr_fail_busy);
+	seq_printf(m, "fail_other %lu\n", stat.nr_fail_other);
+	seq_printf(m, "latency_total_us %llu\n", stat.lat_total_us);
+	seq_printf(m, "latency_max_us %llu\n", stat.lat_max_us);
+
+	return 0;
+}
+
+static int cma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cma_stats_show, inode->i_private);
+}
+
+static const struct file_operations cma_stats_fops = {
+	.open		= cma_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void cma_add_to_cma_mem_list(struct cma *cma, struct cma_mem *mem)
 {
 	spin_lock(&cma->mem_head_lock);
@@ -184,6 +234,11 @@ static void cma_debugfs_add_one(struct cma *cma, int idx)
 				&cma->order_per_bit, &cma_debugfs_fops);
 	debugfs_create_file("used", S_IRUGO, tmp, cma, &cma_used_fops);
 	debugfs_create_file("maxchunk", S_IRUGO, tmp, cma, &cma_maxchunk_fops);
+	debugfs_create_file("ready", S_IRUGO, tmp,
+				&cma->ready_count, &cma_debugfs_fops);
+	debugfs_create_file("ready_target", S_IRUGO | S_IWUSR, tmp, cma,
+				&cma_ready_target_fops);
+	debugfs_create_file("stats", S_IRUGO, tmp, cma, &cma_stats_fops);
 
 	u32s = DIV_ROUND_UP(cma_bitmap_maxno(cma), BITS_PER_BYTE * sizeof(u32));
 	debugfs_create_u32_array("bitmap", S_IRUGO, tmp, (u32*)cma->bitmap, u32s);
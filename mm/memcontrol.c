@@ -2052,6 +2052,13 @@ void mem_cgroup_update_page_stat(struct mem_cgroup *memcg,
  * TODO: maybe necessary to use big numbers in big irons.
  */
 #define CHARGE_BATCH	32U
+/*
+ * Groups far from their limit charge this much at once, and the stock
+ * may hold up to MEMCG_STOCK_MAX pages, most of them handed back by
+ * uncharges on this cpu.
+ */
+#define CHARGE_BATCH_MAX	128U
+#define MEMCG_STOCK_MAX		(2 * CHARGE_BATCH_MAX)
 struct memcg_stock_pcp {
 	struct mem_cgroup *cached; /* this never be root cgroup */
 	unsigned int nr_pages;
@@ -2072,21 +2079,26 @@ static DEFINE_MUTEX(percpu_charge_mutex);
  * service an allocation will refill the stock.
  *
  * returns true if successful, false otherwise.
+ *
+ * The stock is also refilled by uncharges, which may come from interrupt
+ * context, hence interrupts are disabled around all stock updates.
  */
 static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 {
 	struct memcg_stock_pcp *stock;
+	unsigned long flags;
 	bool ret = false;
 
-	if (nr_pages > CHARGE_BATCH)
+	if (nr_pages > MEMCG_STOCK_MAX)
 		return ret;
 
-	stock = &get_cpu_var(memcg_stock);
+	local_irq_save(flags);
+	stock = this_cpu_ptr(&memcg_stock);
 	if (memcg == stock->cached && stock->nr_pages >= nr_pages) {
 		stock->nr_pages -= nr_pages;
 		ret = true;
 	}
-	put_cpu_var(memcg_stock);
+	local_irq_restore(flags);
 	return ret;
 }
 
@@ -2113,9 +2125,14 @@ static void drain_stock(struct memcg_stock_pcp *stock)
  */
 static void drain_local_stock(struct work_struct *dummy)
 {
-	struct memcg_stock_pcp *stock = this_cpu_ptr(&memcg_stock);
+	struct memcg_stock_pcp *stock;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	stock = this_cpu_ptr(&memcg_stock);
 	drain_stock(stock);
 	clear_bit(FLUSHING_CACHED_CHARGE, &stock->flags);
+	local_irq_restore(flags);
 }
 
 /*
@@ -2124,14 +2141,31 @@ static void drain_local_stock(struct work_struct *dummy)
  */
 static void refill_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 {
-	struct memcg_stock_pcp *stock = &get_cpu_var(memcg_stock);
+	struct memcg_stock_pcp *stock;
+	unsigned long flags;
 
+	local_irq_save(flags);
+	stock = this_cpu_ptr(&memcg_stock);
 	if (stock->cached != memcg) { /* reset if necessary */
 		drain_stock(stock);
 		stock->cached = memcg;
 	}
 	stock->nr_pages += nr_pages;
-	put_cpu_var(memcg_stock);
+	if (stock->nr_pages > MEMCG_STOCK_MAX)
+		drain_stock(stock);
+	local_irq_restore(flags);
+}
+
+/*
+ * Size of the charge taken on a stock miss. Large batches are only used
+ * while the stocks of all cpus together could not push @memcg over its
+ * limit, so they never cause reclaim that a small batch would not.
+ */
+static unsigned int memcg_charge_batch(struct mem_cgroup *memcg)
+{
+	if (mem_cgroup_margin(memcg) >= MEMCG_STOCK_MAX * num_online_cpus())
+		return CHARGE_BATCH_MAX;
+	return CHARGE_BATCH;
 }
 
 /*
@@ -2218,11 +2252,11 @@ static int memcg_cpu_hotplug_callback(struct notifier_block *nb,
 static int try_charge(struct mem_cgroup *memcg, gfp_t gfp_mask,
 		      unsigned int nr_pages)
 {
-	unsigned int batch = max(CHARGE_BATCH, nr_pages);
 	int nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
 	struct mem_cgroup *mem_over_limit;
 	struct page_counter *counter;
 	unsigned long nr_reclaimed;
+	unsigned int batch;
 	bool may_swap = true;
 	bool drained = false;
 	int ret = 0;
@@ -2233,6 +2267,8 @@ retry:
 	if (consume_stock(memcg, nr_pages))
 		goto done;
 
+	batch = max(memcg_charge_batch(memcg), nr_pages);
+
 	if (!do_swap_account ||
 	    !page_counter_try_charge(&memcg->memsw, batch, &counter)) {
 		if (!page_counter_try_charge(&memcg->memory, batch, &counter))
@@ -4547,6 +4583,9 @@ static void mem_cgroup_css_offline(struct cgroup_subsys_state *css)
 	vmpressure_cleanup(&memcg->vmpressure);
 
 	memcg_deactivate_kmem(memcg);
+
+	/* Stocked charges hold css references */
+	drain_all_stock(memcg);
 }
 
 static void mem_cgroup_css_free(struct cgroup_subsys_state *css)
@@ -5595,12 +5634,26 @@ static void uncharge_batch(struct mem_cgroup *memcg, unsigned long pgpgout,
 {
 	unsigned long nr_pages = nr_anon + nr_file;
 	unsigned long flags;
+	bool stocked = false;
 
+	/*
+	 * Hand the charge to the local stock rather than to the page
+	 * counters, where the next charge on this cpu will find it. An
+	 * OOM waiter needs to see the margin, so skip this under OOM, and
+	 * do not let stocks pin groups that are going away.
+	 */
 	if (!mem_cgroup_is_root(memcg)) {
-		page_counter_uncharge(&memcg->memory, nr_pages);
-		if (do_swap_account)
-			page_counter_uncharge(&memcg->memsw, nr_pages);
-		memcg_oom_recover(memcg);
+		if (nr_pages <= CHARGE_BATCH_MAX &&
+		    (memcg->css.flags & CSS_ONLINE) &&
+		    !atomic_read(&memcg->under_oom)) {
+			refill_stock(memcg, nr_pages);
+			stocked = true;
+		} else {
+			page_counter_uncharge(&memcg->memory, nr_pages);
+			if (do_swap_account)
+				page_counter_uncharge(&memcg->memsw, nr_pages);
+			memcg_oom_recover(memcg);
+		}
 	}
 
 	local_irq_save(flags);
@@ -5612,7 +5665,8 @@ static void uncharge_batch(struct mem_cgroup *memcg, unsigned long pgpgout,
 	memcg_check_events(memcg, dummy_page);
 	local_irq_restore(flags);
 
-	if (!mem_cgroup_is_root(memcg))
+	/* The stock keeps the css references along with the charge */
+	if (!mem_cgroup_is_root(memcg) && !stocked)
 		css_put_many(&memcg->css, nr_pages);
 }
 
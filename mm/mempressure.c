@@ -0,0 +1,244 @@
+/*
+ * System-wide memory pressure notification
+ *
+ * The memcg vmpressure interface needs a memory cgroup to listen on and
+ * only looks at reclaim efficiency. This reports the two things that come
+ * well before the OOM killer on small machines: a zone dropping below its
+ * low watermark, so that kswapd has to be woken, and allocations stalling
+ * in direct reclaim. /sys/kernel/mm/mempressure/level reads as one of
+ * "none", "low", "medium" or "critical", and can be poll()ed for changes.
+ *
+ * An event holds its level for hold_ms; the level then decays by itself.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/jiffies.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/kernfs.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/workqueue.h>
+#include <linux/mempressure.h>
+
+enum mempressure_levels {
+	MEMPRESSURE_NONE = 0,
+	MEMPRESSURE_LOW,
+	MEMPRESSURE_MEDIUM,
+	MEMPRESSURE_CRITICAL,
+	MEMPRESSURE_NUM_LEVELS,
+};
+
+static const char * const mempressure_str_levels[] = {
+	[MEMPRESSURE_NONE] = "none",
+	[MEMPRESSURE_LOW] = "low",
+	[MEMPRESSURE_MEDIUM] = "medium",
+	[MEMPRESSURE_CRITICAL] = "critical",
+};
+
+/*
+ * Updated locklessly from the allocator, possibly from interrupts. A lost
+ * update only costs an event count or shortens a hold by one event.
+ */
+struct mempressure_zone {
+	unsigned long last[MEMPRESSURE_NUM_LEVELS];	/* jiffies */
+	unsigned long kswapd_wakes;
+	unsigned long stalls;
+	unsigned long stalls_critical;
+};
+
+static struct mempressure_zone mempressure_zones[MAX_NUMNODES][MAX_NR_ZONES];
+
+/* Tunables */
+static unsigned int mempressure_stall_medium_us = 10000;
+static unsigned int mempressure_stall_critical_us = 200000;
+static unsigned int mempressure_hold_ms = 5000;
+
+static int mempressure_reported;
+static struct kernfs_node *mempressure_level_kn;
+static void mempressure_decay(struct work_struct *work);
+static DECLARE_DELAYED_WORK(mempressure_decay_work, mempressure_decay);
+
+static struct mempressure_zone *zone_to_mempressure(struct zone *zone)
+{
+	return &mempressure_zones[zone_to_nid(zone)][zone_idx(zone)];
+}
+
+static int mempressure_zone_level(struct mempressure_zone *mpz,
+				  unsigned long hold)
+{
+	int level;
+
+	for (level = MEMPRESSURE_CRITICAL; level > MEMPRESSURE_NONE; level--) {
+		unsigned long last = READ_ONCE(mpz->last[level]);
+
+		if (last && time_before(jiffies, last + hold))
+			return level;
+	}
+	return MEMPRESSURE_NONE;
+}
+
+static int mempressure_level(void)
+{
+	unsigned long hold = msecs_to_jiffies(mempressure_hold_ms);
+	int nid, zid, level = MEMPRESSURE_NONE;
+
+	for_each_online_node(nid)
+		for (zid = 0; zid < MAX_NR_ZONES; zid++)
+			level = max(level, mempressure_zone_level(
+				&mempressure_zones[nid][zid], hold));
+
+	return level;
+}
+
+static void mempressure_notify(int level)
+{
+	/* Nothing to notify, nor a workqueue, before the file exists */
+	if (!mempressure_level_kn)
+		return;
+
+	if (level == READ_ONCE(mempressure_reported))
+		return;
+
+	WRITE_ONCE(mempressure_reported, level);
+	kernfs_notify(mempressure_level_kn);
+	if (level != MEMPRESSURE_NONE)
+		mod_delayed_work(system_wq, &mempressure_decay_work,
+				 msecs_to_jiffies(mempressure_hold_ms) + 1);
+}
+
+static void mempressure_decay(struct work_struct *work)
+{
+	mempressure_notify(mempressure_level());
+}
+
+static void mempressure_raise(struct mempressure_zone *mpz, int level)
+{
+	/* 0 is "never", keep the stamp off it */
+	WRITE_ONCE(mpz->last[level], jiffies | 1);
+
+	if (level > READ_ONCE(mempressure_reported))
+		mempressure_notify(level);
+}
+
+/* A zone went below its low watermark and kswapd needs to run */
+void mempressure_kswapd_wake(struct zone *zone)
+{
+	struct mempressure_zone *mpz = zone_to_mempressure(zone);
+
+	mpz->kswapd_wakes++;
+	mempressure_raise(mpz, MEMPRESSURE_LOW);
+}
+
+/* An allocation spent @stall_ns in direct reclaim */
+void mempressure_stall(struct zone *zone, u64 stall_ns, bool progress)
+{
+	struct mempressure_zone *mpz = zone_to_mempressure(zone);
+	u64 stall_us = div_u64(stall_ns, NSEC_PER_USEC);
+
+	if (!progress || stall_us >= mempressure_stall_critical_us) {
+		mpz->stalls_critical++;
+		mempressure_raise(mpz, MEMPRESSURE_CRITICAL);
+	} else if (stall_us >= mempressure_stall_medium_us) {
+		mpz->stalls++;
+		mempressure_raise(mpz, MEMPRESSURE_MEDIUM);
+	}
+}
+
+static ssize_t level_show(struct kobject *kobj,
+			  struct kobj_attribute *attr, char *buf)
+{
+	int level = mempressure_level();
+
+	return sprintf(buf, "%s\n", mempressure_str_levels[level]);
+}
+static struct kobj_attribute level_attr = __ATTR_RO(level);
+
+static ssize_t zones_show(struct kobject *kobj,
+			  struct kobj_attribute *attr, char *buf)
+{
+	unsigned long hold = msecs_to_jiffies(mempressure_hold_ms);
+	struct mempressure_zone *mpz;
+	struct zone *zone;
+	ssize_t len = 0;
+
+	for_each_populated_zone(zone) {
+		mpz = zone_to_mempressure(zone);
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%d %-8s %-8s %lu %lu %lu\n",
+				 zone_to_nid(zone), zone->name,
+				 mempressure_str_levels[
+					mempressure_zone_level(mpz, hold)],
+				 mpz->kswapd_wakes, mpz->stalls,
+				 mpz->stalls_critical);
+	}
+
+	return len;
+}
+static struct kobj_attribute zones_attr = __ATTR_RO(zones);
+
+#define MEMPRESSURE_ATTR(_name)						\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", mempressure_##_name);		\
+}									\
+static ssize_t _name##_store(struct kobject *kobj,			\
+			     struct kobj_attribute *attr,		\
+			     const char *buf, size_t count)		\
+{									\
+	unsigned int val;						\
+	int err;							\
+									\
+	err = kstrtouint(buf, 10, &val);				\
+	if (err)							\
+		return err;						\
+	mempressure_##_name = val;					\
+	return count;							\
+}									\
+static struct kobj_attribute _name##_attr =				\
+	__ATTR(_name, 0644, _name##_show, _name##_store)
+
+MEMPRESSURE_ATTR(stall_medium_us);
+MEMPRESSURE_ATTR(stall_critical_us);
+MEMPRESSURE_ATTR(hold_ms);
+
+static struct attribute *mempressure_attrs[] = {
+	&level_attr.attr,
+	&zones_attr.attr,
+	&stall_medium_us_attr.attr,
+	&stall_critical_us_attr.attr,
+	&hold_ms_attr.attr,
+	NULL,
+};
+
+static struct attribute_group mempressure_attr_group = {
+	.attrs = mempressure_attrs,
+	.name = "mempressure",
+};
+
+static int __init mempressure_init(void)
+{
+	struct kernfs_node *dir;
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &mempressure_attr_group);
+	if (err) {
+		pr_err("mempressure: failed to register sysfs group\n");
+		return err;
+	}
+
+	/* Kept for notifying from atomic context, never put */
+	dir = sysfs_get_dirent(mm_kobj->sd, "mempressure");
+	if (dir) {
+		mempressure_level_kn = sysfs_get_dirent(dir, "level");
+		sysfs_put(dir);
+	}
+	return 0;
+}
+subsys_initcall(mempressure_init);
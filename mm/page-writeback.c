@@ -1846,10 +1846,22 @@ int write_cache_pages(struct address_space *mapping,
 	int cycled;
 	int range_whole = 0;
 	int tag;
+	unsigned long erase_pages = 0;
+	pgoff_t erase_stop = -1;
 
 	pagevec_init(&pvec, 0);
 	if (wbc->range_cyclic) {
 		writeback_index = mapping->writeback_index; /* prev offset */
+		/*
+		 * Flash without a smart FTL does a read-modify-write for
+		 * anything short of an erase block, so background writeout
+		 * starts on an erase block boundary and, below, runs on to
+		 * the end of the block it stopped in.
+		 */
+		if (wbc->sync_mode == WB_SYNC_NONE)
+			erase_pages = inode_to_bdi(mapping->host)->erase_pages;
+		if (erase_pages)
+			writeback_index -= writeback_index % erase_pages;
 		index = writeback_index;
 		if (index == 0)
 			cycled = 1;
@@ -1900,6 +1912,11 @@ retry:
 
 			done_index = page->index;
 
+			if (page->index >= erase_stop) {
+				done = 1;
+				break;
+			}
+
 			lock_page(page);
 
 			/*
@@ -1962,8 +1979,17 @@ continue_unlock:
 			 */
 			if (--wbc->nr_to_write <= 0 &&
 			    wbc->sync_mode == WB_SYNC_NONE) {
-				done = 1;
-				break;
+				if (!erase_pages) {
+					done = 1;
+					break;
+				}
+				erase_stop = min(erase_stop,
+						 roundup(page->index + 1,
+							 erase_pages));
+				if (page->index + 1 >= erase_stop) {
+					done = 1;
+					break;
+				}
 			}
 		}
 		pagevec_release(&pvec);
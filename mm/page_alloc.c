@@ -61,6 +61,7 @@
 #include <linux/hugetlb.h>
 #include <linux/sched/rt.h>
 #include <linux/page_owner.h>
+#include <linux/mempressure.h>
 
 #include <asm/sections.h>
 #include <asm/tlbflush.h>
@@ -2502,6 +2503,7 @@ __perform_reclaim(gfp_t gfp_mask, unsigned int order,
 					const struct alloc_context *ac)
 {
 	struct reclaim_state reclaim_state;
+	u64 start;
 	int progress;
 
 	cond_resched();
@@ -2513,8 +2515,10 @@ __perform_reclaim(gfp_t gfp_mask, unsigned int order,
 	reclaim_state.reclaimed_slab = 0;
 	current->reclaim_state = &reclaim_state;
 
+	start = local_clock();
 	progress = try_to_free_pages(ac->zonelist, order, gfp_mask,
 								ac->nodemask);
+	mempressure_stall(ac->preferred_zone, local_clock() - start, progress);
 
 	current->reclaim_state = NULL;
 	lockdep_clear_current_reclaim_state();
@@ -34,6 +34,8 @@
 #include <linux/stacktrace.h>
 #include <linux/prefetch.h>
 #include <linux/memcontrol.h>
+#include <linux/jump_label.h>
+#include <linux/sched.h>
 
 #include <trace/events/kmem.h>
 
@@ -177,6 +179,7 @@ static inline bool kmem_cache_has_cpu_partial(struct kmem_cache *s)
 /* Internal SLUB flags */
 #define __OBJECT_POISON		0x80000000UL /* Poison object */
 #define __CMPXCHG_DOUBLE	0x40000000UL /* Use cmpxchg_double */
+#define __SLUB_STATS		0x20000000UL /* Count statistics */
 
 #ifdef CONFIG_SMP
 static struct notifier_block slab_notifier;
@@ -209,6 +212,49 @@ static inline int sysfs_slab_alias(struct kmem_cache *s, const char *p)
 static inline void memcg_propagate_slab_attrs(struct kmem_cache *s) { }
 #endif
 
+#ifdef CONFIG_SLUB_STATS
+/*
+ * Statistics are only counted for caches that have them switched on,
+ * through the "stats" attribute or for every cache with "slub_stats" on
+ * the command line. The key is held once for each such cache, so while
+ * none counts, the only cost is a patched-out branch.
+ */
+static struct static_key slub_stats_key = STATIC_KEY_INIT_FALSE;
+static DEFINE_MUTEX(slub_stats_mutex);
+static bool slub_stats_default;
+
+static int __init setup_slub_stats(char *str)
+{
+	slub_stats_default = true;
+	return 1;
+}
+__setup("slub_stats", setup_slub_stats);
+
+static void slub_stats_set(struct kmem_cache *s, bool on)
+{
+	mutex_lock(&slub_stats_mutex);
+	if (on && !(s->flags & __SLUB_STATS)) {
+		static_key_slow_inc(&slub_stats_key);
+		s->flags |= __SLUB_STATS;
+	} else if (!on && (s->flags & __SLUB_STATS)) {
+		s->flags &= ~__SLUB_STATS;
+		static_key_slow_dec(&slub_stats_key);
+	}
+	mutex_unlock(&slub_stats_mutex);
+}
+#else
+static inline void slub_stats_set(struct kmem_cache *s, bool on) { }
+#endif
+
+static inline bool slub_stats_on(const struct kmem_cache *s)
+{
+#ifdef CONFIG_SLUB_STATS
+	return static_key_false(&slub_stats_key) && (s->flags & __SLUB_STATS);
+#else
+	return false;
+#endif
+}
+
 static inline void stat(const struct kmem_cache *s, enum stat_item si)
 {
 #ifdef CONFIG_SLUB_STATS
@@ -216,7 +262,22 @@ static inline void stat(const struct kmem_cache *s, enum stat_item si)
 	 * The rmw is racy on a preemptible kernel but this is acceptable, so
 	 * avoid this_cpu_add()'s irq-disable overhead.
 	 */
-	raw_cpu_inc(s->cpu_slab->stat[si]);
+	if (slub_stats_on(s))
+		raw_cpu_inc(s->cpu_slab->stat[si]);
+#endif
+}
+
+/* Start timing a slowpath allocation, if statistics are on */
+static inline u64 stat_clock(const struct kmem_cache *s)
+{
+	return slub_stats_on(s) ? local_clock() : 0;
+}
+
+static inline void stat_time(const struct kmem_cache *s, u64 start)
+{
+#ifdef CONFIG_SLUB_STATS
+	if (start)
+		raw_cpu_add(s->cpu_slab->slowpath_ns, local_clock() - start);
 #endif
 }
 
@@ -2470,8 +2531,11 @@ redo:
 	object = c->freelist;
 	page = c->page;
 	if (unlikely(!object || !node_match(page, node))) {
+		u64 start = stat_clock(s);
+
 		object = __slab_alloc(s, gfpflags, node, addr, c);
 		stat(s, ALLOC_SLOWPATH);
+		stat_time(s, start);
 	} else {
 		void *next_object = get_freepointer_safe(s, object);
 
@@ -3118,6 +3182,8 @@ static int calculate_sizes(struct kmem_cache *s, int forced_order)
 
 static int kmem_cache_open(struct kmem_cache *s, unsigned long flags)
 {
+	/* Taken over from the root cache of memcg caches, but not counted */
+	flags &= ~__SLUB_STATS;
 	s->flags = kmem_cache_flags(s->size, flags, s->name, s->ctor);
 	s->reserved = 0;
 
@@ -3186,8 +3252,14 @@ static int kmem_cache_open(struct kmem_cache *s, unsigned long flags)
 	if (!init_kmem_cache_nodes(s))
 		goto error;
 
-	if (alloc_kmem_cache_cpus(s))
+	if (alloc_kmem_cache_cpus(s)) {
+#ifdef CONFIG_SLUB_STATS
+		/* Boot caches are switched on by slub_stats_boot_caches() */
+		if (slub_stats_default && slab_state == FULL)
+			slub_stats_set(s, true);
+#endif
 		return 0;
+	}
 
 	free_kmem_cache_nodes(s);
 error:
@@ -3267,7 +3339,11 @@ static inline int kmem_cache_close(struct kmem_cache *s)
 
 int __kmem_cache_shutdown(struct kmem_cache *s)
 {
-	return kmem_cache_close(s);
+	int rc = kmem_cache_close(s);
+
+	if (!rc)
+		slub_stats_set(s, false);
+	return rc;
 }
 
 /********************************************************************
@@ -4836,6 +4912,49 @@ static void clear_stat(struct kmem_cache *s, enum stat_item si)
 		per_cpu_ptr(s->cpu_slab, cpu)->stat[si] = 0;
 }
 
+static ssize_t stats_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%d\n", !!(s->flags & __SLUB_STATS));
+}
+
+static ssize_t stats_store(struct kmem_cache *s, const char *buf,
+			   size_t length)
+{
+	bool on;
+
+	if (strtobool(buf, &on))
+		return -EINVAL;
+
+	slub_stats_set(s, on);
+	return length;
+}
+SLAB_ATTR(stats);
+
+static ssize_t alloc_slowpath_ns_show(struct kmem_cache *s, char *buf)
+{
+	u64 sum = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		sum += per_cpu_ptr(s->cpu_slab, cpu)->slowpath_ns;
+
+	return sprintf(buf, "%llu\n", sum);
+}
+
+static ssize_t alloc_slowpath_ns_store(struct kmem_cache *s,
+				       const char *buf, size_t length)
+{
+	int cpu;
+
+	if (buf[0] != '0')
+		return -EINVAL;
+
+	for_each_online_cpu(cpu)
+		per_cpu_ptr(s->cpu_slab, cpu)->slowpath_ns = 0;
+	return length;
+}
+SLAB_ATTR(alloc_slowpath_ns);
+
 #define STAT_ATTR(si, text) 					\
 static ssize_t text##_show(struct kmem_cache *s, char *buf)	\
 {								\
@@ -4918,6 +5037,8 @@ static struct attribute *slab_attrs[] = {
 	&remote_node_defrag_ratio_attr.attr,
 #endif
 #ifdef CONFIG_SLUB_STATS
+	&stats_attr.attr,
+	&alloc_slowpath_ns_attr.attr,
 	&alloc_fastpath_attr.attr,
 	&alloc_slowpath_attr.attr,
 	&free_fastpath_attr.attr,
@@ -5264,6 +5385,24 @@ static int sysfs_slab_alias(struct kmem_cache *s, const char *name)
 	return 0;
 }
 
+/* Apply "slub_stats" to the caches created before sysfs came up */
+static void __init slub_stats_boot_caches(void)
+{
+#ifdef CONFIG_SLUB_STATS
+	struct kmem_cache *s;
+
+	if (!slub_stats_default)
+		return;
+
+	get_online_cpus();
+	mutex_lock(&slab_mutex);
+	list_for_each_entry(s, &slab_caches, list)
+		slub_stats_set(s, true);
+	mutex_unlock(&slab_mutex);
+	put_online_cpus();
+#endif
+}
+
 static int __init slab_sysfs_init(void)
 {
 	struct kmem_cache *s;
@@ -5299,6 +5438,7 @@ static int __init slab_sysfs_init(void)
 	}
 
 	mutex_unlock(&slab_mutex);
+	slub_stats_boot_caches();
 	resiliency_test();
 	return 0;
 }
@@ -229,6 +229,22 @@ void br_flood_forward(struct net_bridge *br, struct sk_buff *skb,
 
 #ifdef CONFIG_BRIDGE_IGMP_SNOOPING
 /* called with rcu_read_lock */
+/*
+ * A frame coming in on a port of the switch that forwards the group to
+ * port group @pg has already been sent there by the hardware.
+ */
+static bool br_multicast_hw_forwarded(const struct net_bridge_port_group *pg,
+				      const struct sk_buff *skb)
+{
+	const struct net_bridge_port *in;
+
+	if (!pg->offloaded || !br_port_exists(skb->dev))
+		return false;
+
+	in = br_port_get_rcu(skb->dev);
+	return in && br_port_same_switch(in, pg->port);
+}
+
 static void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 			       struct sk_buff *skb, struct sk_buff *skb0,
 			       void (*__packet_hook)(
@@ -253,9 +269,11 @@ static void br_multicast_flood(struct net_bridge_mdb_entry *mdst,
 		port = (unsigned long)lport > (unsigned long)rport ?
 		       lport : rport;
 
-		prev = maybe_deliver(prev, port, skb, __packet_hook);
-		if (IS_ERR(prev))
-			goto out;
+		if (port != lport || !br_multicast_hw_forwarded(p, skb)) {
+			prev = maybe_deliver(prev, port, skb, __packet_hook);
+			if (IS_ERR(prev))
+				goto out;
+		}
 
 		if ((unsigned long)lport >= (unsigned long)port)
 			p = rcu_dereference(p->next);
@@ -450,6 +450,7 @@ static int __br_mdb_del(struct net_bridge *br, struct br_mdb_entry *entry)
 			goto unlock;
 
 		rcu_assign_pointer(*pp, p->next);
+		br_multicast_pg_offload(p, false);
 		hlist_del_init(&p->mglist);
 		del_timer(&p->timer);
 		call_rcu_bh(&p->rcu, br_multicast_free_pg);
@@ -26,6 +26,7 @@
 #include <linux/timer.h>
 #include <linux/inetdevice.h>
 #include <net/ip.h>
+#include <net/switchdev.h>
 #if IS_ENABLED(CONFIG_IPV6)
 #include <net/ipv6.h>
 #include <net/mld.h>
@@ -248,6 +249,40 @@ out:
 	spin_unlock(&br->multicast_lock);
 }
 
+/*
+ * Let the switch behind the port forward the group to it, so that frames
+ * from other ports of the same switch don't have to be forwarded by the
+ * bridge.  Switches key their multicast entries by MAC address.
+ */
+void br_multicast_pg_offload(struct net_bridge_port_group *pg, bool add)
+{
+	unsigned char mac[ETH_ALEN];
+
+	if (!pg->port->sw_id.id_len || add == pg->offloaded)
+		return;
+
+	switch (pg->addr.proto) {
+	case htons(ETH_P_IP):
+		ip_eth_mc_map(pg->addr.u.ip4, mac);
+		break;
+#if IS_ENABLED(CONFIG_IPV6)
+	case htons(ETH_P_IPV6):
+		ipv6_eth_mc_map(&pg->addr.u.ip6, mac);
+		break;
+#endif
+	default:
+		return;
+	}
+
+	if (add)
+		pg->offloaded = !netdev_switch_port_mdb_add(pg->port->dev, mac,
+							    pg->addr.vid);
+	else {
+		netdev_switch_port_mdb_del(pg->port->dev, mac, pg->addr.vid);
+		pg->offloaded = false;
+	}
+}
+
 static void br_multicast_del_pg(struct net_bridge *br,
 				struct net_bridge_port_group *pg)
 {
@@ -269,6 +304,7 @@ static void br_multicast_del_pg(struct net_bridge *br,
 			continue;
 
 		rcu_assign_pointer(*pp, p->next);
+		br_multicast_pg_offload(p, false);
 		hlist_del_init(&p->mglist);
 		del_timer(&p->timer);
 		call_rcu_bh(&p->rcu, br_multicast_free_pg);
@@ -650,6 +686,7 @@ struct net_bridge_port_group *br_multicast_new_port_group(
 	hlist_add_head(&p->mglist, &port->mglist);
 	setup_timer(&p->timer, br_multicast_port_group_expired,
 		    (unsigned long)p);
+	br_multicast_pg_offload(p, true);
 	return p;
 }
 
@@ -900,6 +937,9 @@ void br_multicast_add_port(struct net_bridge_port *port)
 {
 	port->multicast_router = 1;
 
+	if (netdev_switch_parent_id_get(port->dev, &port->sw_id))
+		port->sw_id.id_len = 0;
+
 	setup_timer(&port->multicast_router_timer, br_multicast_router_expired,
 		    (unsigned long)port);
 	setup_timer(&port->ip4_own_query.timer,
@@ -1461,6 +1501,7 @@ br_multicast_leave_group(struct net_bridge *br,
 				continue;
 
 			rcu_assign_pointer(*pp, p->next);
+			br_multicast_pg_offload(p, false);
 			hlist_del_init(&p->mglist);
 			del_timer(&p->timer);
 			call_rcu_bh(&p->rcu, br_multicast_free_pg);
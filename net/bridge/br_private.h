@@ -113,6 +113,8 @@ struct net_bridge_port_group {
 	struct timer_list		timer;
 	struct br_ip			addr;
 	unsigned char			state;
+	/* the switch forwards the group to this port itself */
+	bool				offloaded;
 };
 
 struct net_bridge_mdb_entry
@@ -174,6 +176,8 @@ struct net_bridge_port
 	struct timer_list		multicast_router_timer;
 	struct hlist_head		mglist;
 	struct hlist_node		rlist;
+	/* switch chip of the port, id_len 0 if none */
+	struct netdev_phys_item_id	sw_id;
 #endif
 
 #ifdef CONFIG_SYSFS
@@ -486,6 +490,14 @@ void br_mdb_init(void);
 void br_mdb_uninit(void);
 void br_mdb_notify(struct net_device *dev, struct net_bridge_port *port,
 		   struct br_ip *group, int type);
+void br_multicast_pg_offload(struct net_bridge_port_group *pg, bool add);
+
+static inline bool br_port_same_switch(const struct net_bridge_port *a,
+				       const struct net_bridge_port *b)
+{
+	return a->sw_id.id_len && a->sw_id.id_len == b->sw_id.id_len &&
+	       !memcmp(a->sw_id.id, b->sw_id.id, a->sw_id.id_len);
+}
 
 #define mlock_dereference(X, br) \
 	rcu_dereference_protected(X, lockdep_is_held(&br->multicast_lock))
@@ -46,6 +46,7 @@
 #include <linux/kmod.h>
 #include <linux/slab.h>
 #include <linux/list.h>
+#include <linux/hash.h>
 #include <linux/spinlock.h>
 #include <linux/rcupdate.h>
 #include <linux/uaccess.h>
@@ -437,6 +438,24 @@ static struct hlist_head *find_rcv_list(canid_t *can_id, canid_t *mask,
 	return &d->rx[RX_FIL];
 }
 
+static inline unsigned int filhash(canid_t can_id)
+{
+	return hash_32(can_id, CAN_FIL_RCV_HASH_BITS);
+}
+
+static struct rcv_mask_group *find_mask_group(struct dev_rcv_lists *d,
+					      canid_t mask)
+{
+	struct rcv_mask_group *g;
+
+	hlist_for_each_entry(g, &d->rx_fil_groups, list) {
+		if (g->mask == mask)
+			return g;
+	}
+
+	return NULL;
+}
+
 /**
  * can_rx_register - subscribe CAN frames from a specific interface
  * @dev: pointer to netdevice (NULL => subcribe from 'all' CAN devices list)
@@ -473,6 +492,7 @@ int can_rx_register(struct net_device *dev, canid_t can_id, canid_t mask,
 	struct receiver *r;
 	struct hlist_head *rl;
 	struct dev_rcv_lists *d;
+	struct rcv_mask_group *g;
 	int err = 0;
 
 	/* insert new receiver  (dev,canid,mask) -> (func,data) */
@@ -490,6 +510,24 @@ int can_rx_register(struct net_device *dev, canid_t can_id, canid_t mask,
 	if (d) {
 		rl = find_rcv_list(&can_id, &mask, d);
 
+		/* can_id/mask filters go to the hash of their mask group */
+		if (rl == &d->rx[RX_FIL]) {
+			g = find_mask_group(d, mask);
+			if (!g) {
+				g = kzalloc(sizeof(*g), GFP_ATOMIC);
+				if (!g) {
+					kmem_cache_free(rcv_cache, r);
+					err = -ENOMEM;
+					goto out;
+				}
+				g->mask = mask;
+				hlist_add_head_rcu(&g->list, &d->rx_fil_groups);
+				can_pstats.rcv_mask_groups++;
+			}
+			g->entries++;
+			rl = &g->rx[filhash(can_id)];
+		}
+
 		r->can_id  = can_id;
 		r->mask    = mask;
 		r->matches = 0;
@@ -508,6 +546,7 @@ int can_rx_register(struct net_device *dev, canid_t can_id, canid_t mask,
 		err = -ENODEV;
 	}
 
+ out:
 	spin_unlock(&can_rcvlists_lock);
 
 	return err;
@@ -539,6 +578,7 @@ void can_rx_unregister(struct net_device *dev, canid_t can_id, canid_t mask,
 		       void (*func)(struct sk_buff *, void *), void *data)
 {
 	struct receiver *r = NULL;
+	struct rcv_mask_group *g = NULL;
 	struct hlist_head *rl;
 	struct dev_rcv_lists *d;
 
@@ -557,16 +597,23 @@ void can_rx_unregister(struct net_device *dev, canid_t can_id, canid_t mask,
 
 	rl = find_rcv_list(&can_id, &mask, d);
 
+	if (rl == &d->rx[RX_FIL]) {
+		g = find_mask_group(d, mask);
+		rl = g ? &g->rx[filhash(can_id)] : NULL;
+	}
+
 	/*
 	 * Search the receiver list for the item to delete.  This should
 	 * exist, since no receiver may be unregistered that hasn't
 	 * been registered before.
 	 */
 
-	hlist_for_each_entry_rcu(r, rl, list) {
-		if (r->can_id == can_id && r->mask == mask &&
-		    r->func == func && r->data == data)
-			break;
+	if (rl) {
+		hlist_for_each_entry_rcu(r, rl, list) {
+			if (r->can_id == can_id && r->mask == mask &&
+			    r->func == func && r->data == data)
+				break;
+		}
 	}
 
 	/*
@@ -583,6 +630,12 @@ void can_rx_unregister(struct net_device *dev, canid_t can_id, canid_t mask,
 	hlist_del_rcu(&r->list);
 	d->entries--;
 
+	if (g && !--g->entries) {
+		hlist_del_rcu(&g->list);
+		kfree_rcu(g, rcu);
+		can_pstats.rcv_mask_groups--;
+	}
+
 	if (can_pstats.rcv_entries > 0)
 		can_pstats.rcv_entries--;
 
@@ -609,7 +662,10 @@ static inline void deliver(struct sk_buff *skb, struct receiver *r)
 
 static int can_rcv_filter(struct dev_rcv_lists *d, struct sk_buff *skb)
 {
+	struct rcv_mask_group *g;
 	struct receiver *r;
+	unsigned long checks = 0;
+	canid_t key;
 	int matches = 0;
 	struct can_frame *cf = (struct can_frame *)skb->data;
 	canid_t can_id = cf->can_id;
@@ -634,28 +690,36 @@ static int can_rcv_filter(struct dev_rcv_lists *d, struct sk_buff *skb)
 		matches++;
 	}
 
-	/* check for can_id/mask entries */
-	hlist_for_each_entry_rcu(r, &d->rx[RX_FIL], list) {
-		if ((can_id & r->mask) == r->can_id) {
-			deliver(skb, r);
-			matches++;
+	/* check for can_id/mask entries, one hash lookup per mask */
+	hlist_for_each_entry_rcu(g, &d->rx_fil_groups, list) {
+		key = can_id & g->mask;
+		hlist_for_each_entry_rcu(r, &g->rx[filhash(key)], list) {
+			checks++;
+			if (r->can_id == key) {
+				deliver(skb, r);
+				matches++;
+			}
 		}
 	}
 
 	/* check for inverted can_id/mask entries */
 	hlist_for_each_entry_rcu(r, &d->rx[RX_INV], list) {
+		checks++;
 		if ((can_id & r->mask) != r->can_id) {
 			deliver(skb, r);
 			matches++;
 		}
 	}
 
+	can_stats.rx_filter_checks += checks;
+
 	/* check filterlists for single non-RTR can_ids */
 	if (can_id & CAN_RTR_FLAG)
 		return matches;
 
 	if (can_id & CAN_EFF_FLAG) {
 		hlist_for_each_entry_rcu(r, &d->rx_eff[effhash(can_id)], list) {
+			can_stats.rx_filter_checks++;
 			if (r->can_id == can_id) {
 				deliver(skb, r);
 				matches++;
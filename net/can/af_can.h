@@ -62,14 +62,30 @@ struct receiver {
 #define CAN_SFF_RCV_ARRAY_SZ (1 << CAN_SFF_ID_BITS)
 #define CAN_EFF_RCV_HASH_BITS 10
 #define CAN_EFF_RCV_ARRAY_SZ (1 << CAN_EFF_RCV_HASH_BITS)
+#define CAN_FIL_RCV_HASH_BITS 6
+#define CAN_FIL_RCV_ARRAY_SZ (1 << CAN_FIL_RCV_HASH_BITS)
 
 enum { RX_ERR, RX_ALL, RX_FIL, RX_INV, RX_MAX };
 
+/*
+ * can_id/mask filters sharing the same mask, hashed by their can_id.
+ * These replace the linear RX_FIL list: a received frame costs one hash
+ * lookup per distinct mask instead of one compare per filter.
+ */
+struct rcv_mask_group {
+	struct hlist_node list;
+	struct rcu_head rcu;
+	canid_t mask;
+	int entries;
+	struct hlist_head rx[CAN_FIL_RCV_ARRAY_SZ];
+};
+
 /* per device receive filters linked at dev->ml_priv */
 struct dev_rcv_lists {
 	struct hlist_head rx[RX_MAX];
 	struct hlist_head rx_sff[CAN_SFF_RCV_ARRAY_SZ];
 	struct hlist_head rx_eff[CAN_EFF_RCV_ARRAY_SZ];
+	struct hlist_head rx_fil_groups;
 	int remove_on_zero_entries;
 	int entries;
 };
@@ -99,6 +115,8 @@ struct s_stats {
 	unsigned long rx_frames_delta;
 	unsigned long tx_frames_delta;
 	unsigned long matches_delta;
+
+	unsigned long rx_filter_checks;
 };
 
 /* persistent statistics */
@@ -107,6 +125,7 @@ struct s_pstats {
 	unsigned long user_reset;
 	unsigned long rcv_entries;
 	unsigned long rcv_entries_max;
+	unsigned long rcv_mask_groups;
 };
 
 /* receive filters subscribed for 'all' CAN devices */
@@ -43,6 +43,7 @@
 #include <linux/init.h>
 #include <linux/types.h>
 #include <linux/kernel.h>
+#include <linux/math64.h>
 #include <linux/list.h>
 #include <linux/spinlock.h>
 #include <linux/rcupdate.h>
@@ -132,6 +133,11 @@ struct cgw_job {
 	u32 handled_frames;
 	u32 dropped_frames;
 	u32 deleted_frames;
+	u32 hit_frames;
+	/* rx timestamp to can_send() return, for timestamped frames */
+	u32 lat_max;
+	u32 lat_cnt;
+	u64 lat_sum;
 	struct cf_mod mod;
 	union {
 		/* CAN frame data source */
@@ -346,6 +352,26 @@ static void cgw_csum_crc8_neg(struct can_frame *cf, struct cgw_csum_crc8 *crc8)
 }
 
 /* the receive & process & send function */
+static void cgw_account_latency(struct cgw_job *gwj, ktime_t rx_tstamp)
+{
+	s64 lat;
+
+	if (!rx_tstamp.tv64)
+		return;
+
+	lat = ktime_us_delta(ktime_get_real(), rx_tstamp);
+	if (lat < 0)
+		return;
+
+	if (lat > U32_MAX)
+		lat = U32_MAX;
+
+	gwj->lat_sum += lat;
+	gwj->lat_cnt++;
+	if (lat > gwj->lat_max)
+		gwj->lat_max = lat;
+}
+
 static void can_can_gw_rcv(struct sk_buff *skb, void *data)
 {
 	struct cgw_job *gwj = (struct cgw_job *)data;
@@ -353,6 +379,8 @@ static void can_can_gw_rcv(struct sk_buff *skb, void *data)
 	struct sk_buff *nskb;
 	int modidx = 0;
 
+	gwj->hit_frames++;
+
 	/*
 	 * Do not handle CAN frames routed more than 'max_hops' times.
 	 * In general we should never catch this delimiter which is intended
@@ -431,10 +459,12 @@ static void can_can_gw_rcv(struct sk_buff *skb, void *data)
 		nskb->tstamp.tv64 = 0;
 
 	/* send to netdevice */
-	if (can_send(nskb, gwj->flags & CGW_FLAGS_CAN_ECHO))
+	if (can_send(nskb, gwj->flags & CGW_FLAGS_CAN_ECHO)) {
 		gwj->dropped_frames++;
-	else
+	} else {
 		gwj->handled_frames++;
+		cgw_account_latency(gwj, skb->tstamp);
+	}
 }
 
 static inline int cgw_register_filter(struct cgw_job *gwj)
@@ -513,6 +543,20 @@ static int cgw_put_job(struct sk_buff *skb, struct cgw_job *gwj, int type,
 			goto cancel;
 	}
 
+	if (gwj->hit_frames) {
+		if (nla_put_u32(skb, CGW_HITS, gwj->hit_frames) < 0)
+			goto cancel;
+	}
+
+	if (gwj->lat_cnt) {
+		if (nla_put_u32(skb, CGW_LAT_AVG,
+				div_u64(gwj->lat_sum, gwj->lat_cnt)) < 0)
+			goto cancel;
+
+		if (nla_put_u32(skb, CGW_LAT_MAX, gwj->lat_max) < 0)
+			goto cancel;
+	}
+
 	/* check non default settings of attributes */
 
 	if (gwj->limit_hops) {
@@ -826,6 +870,10 @@ static int cgw_create_job(struct sk_buff *skb,  struct nlmsghdr *nlh)
 	gwj->handled_frames = 0;
 	gwj->dropped_frames = 0;
 	gwj->deleted_frames = 0;
+	gwj->hit_frames = 0;
+	gwj->lat_max = 0;
+	gwj->lat_cnt = 0;
+	gwj->lat_sum = 0;
 	gwj->flags = r->flags;
 	gwj->gwtype = r->gwtype;
 
@@ -221,6 +221,12 @@ static int can_stats_proc_show(struct seq_file *m, void *v)
 	seq_printf(m, " %8ld transmitted frames (TXF)\n", can_stats.tx_frames);
 	seq_printf(m, " %8ld received frames (RXF)\n", can_stats.rx_frames);
 	seq_printf(m, " %8ld matched frames (RXMF)\n", can_stats.matches);
+	seq_printf(m, " %8ld filter compares (RXFC)\n",
+			can_stats.rx_filter_checks);
+	if (can_stats.rx_frames)
+		seq_printf(m, " %8ld filter compares/frame (RXFCF)\n",
+				can_stats.rx_filter_checks /
+				can_stats.rx_frames);
 
 	seq_putc(m, '\n');
 
@@ -260,6 +266,8 @@ static int can_stats_proc_show(struct seq_file *m, void *v)
 			can_pstats.rcv_entries);
 	seq_printf(m, " %8ld maximum receive list entries (MRCV)\n",
 			can_pstats.rcv_entries_max);
+	seq_printf(m, " %8ld current filter mask groups (CMGR)\n",
+			can_pstats.rcv_mask_groups);
 
 	if (can_pstats.stats_reset)
 		seq_printf(m, "\n %8ld statistic resets (STR)\n",
@@ -336,11 +344,32 @@ static const struct file_operations can_version_proc_fops = {
 	.release	= single_release,
 };
 
+static void can_rcvlist_proc_show_fil(struct seq_file *m,
+				      struct net_device *dev,
+				      struct dev_rcv_lists *d)
+{
+	struct rcv_mask_group *g;
+	unsigned int i;
+
+	if (hlist_empty(&d->rx_fil_groups)) {
+		seq_printf(m, "  (%s: no entry)\n", DNAME(dev));
+		return;
+	}
+
+	can_print_recv_banner(m);
+	hlist_for_each_entry_rcu(g, &d->rx_fil_groups, list) {
+		for (i = 0; i < ARRAY_SIZE(g->rx); i++)
+			can_print_rcvlist(m, &g->rx[i], dev);
+	}
+}
+
 static inline void can_rcvlist_proc_show_one(struct seq_file *m, int idx,
 					     struct net_device *dev,
 					     struct dev_rcv_lists *d)
 {
-	if (!hlist_empty(&d->rx[idx])) {
+	if (idx == RX_FIL) {
+		can_rcvlist_proc_show_fil(m, dev, d);
+	} else if (!hlist_empty(&d->rx[idx])) {
 		can_print_recv_banner(m);
 		can_print_rcvlist(m, &d->rx[idx], dev);
 	} else
@@ -158,6 +158,8 @@
 #include <linux/etherdevice.h>
 #include <linux/kthread.h>
 #include <linux/prefetch.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
 #include <net/net_namespace.h>
 #include <net/checksum.h>
 #include <net/ipv6.h>
@@ -218,6 +220,7 @@
 #define PKTGEN_MAGIC 0xbe9be955
 #define PG_PROC_DIR "pktgen"
 #define PGCTRL	    "pgctrl"
+#define PGRX	    "pgrx"
 
 #define MAX_CFLOWS  65536
 
@@ -410,11 +413,34 @@ struct pktgen_hdr {
 
 static int pg_net_id __read_mostly;
 
+/* Receive side, per cpu: what arrived carrying a pktgen header */
+struct pktgen_rx_stats {
+	u64			pkts;
+	u64			bytes;
+	u64			reordered;	/* seq below one already seen */
+	u32			min_seq;
+	u32			max_seq;
+	u64			first_ns;	/* arrival times, realtime */
+	u64			last_ns;
+	s64			last_transit;
+	u64			jitter_ns;	/* RFC 3550 interarrival */
+	bool			timed;		/* last_transit is valid */
+	struct u64_stats_sync	syncp;
+};
+
+struct pktgen_rx {
+	struct net_device	*dev;
+	struct packet_type	pt_ip;
+	struct packet_type	pt_ipv6;
+	struct pktgen_rx_stats __percpu *stats;
+};
+
 struct pktgen_net {
 	struct net		*net;
 	struct proc_dir_entry	*proc_dir;
 	struct list_head	pktgen_threads;
 	bool			pktgen_exiting;
+	struct pktgen_rx	*rx;		/* protected by rtnl */
 };
 
 struct pktgen_thread {
@@ -526,6 +552,279 @@ static const struct file_operations pktgen_fops = {
 	.release = single_release,
 };
 
+/*
+ * Receive mode: count the pktgen frames a device receives, for measuring
+ * a driver's rx path with the same tool that benchmarks its tx path.
+ * Frames are only looked at, the stack still gets them. Loss and
+ * reordering are computed from the sequence numbers and assume a single
+ * pktgen sender.
+ */
+
+static void pktgen_rx_account(struct pktgen_rx *rx, const struct sk_buff *skb,
+			      const struct pktgen_hdr *pgh)
+{
+	struct pktgen_rx_stats *stats = this_cpu_ptr(rx->stats);
+	u32 seq = ntohl(pgh->seq_num);
+	u64 now = ktime_get_real_ns();
+
+	u64_stats_update_begin(&stats->syncp);
+	if (!stats->pkts) {
+		stats->min_seq = seq;
+		stats->max_seq = seq;
+		stats->first_ns = now;
+	} else if ((s32)(seq - stats->max_seq) > 0) {
+		stats->max_seq = seq;
+	} else {
+		stats->reordered++;
+		if ((s32)(seq - stats->min_seq) < 0)
+			stats->min_seq = seq;
+	}
+	stats->pkts++;
+	stats->bytes += skb->len + skb->mac_len;
+	stats->last_ns = now;
+
+	/* the sender's clock offset cancels out between two frames */
+	if (pgh->tv_sec || pgh->tv_usec) {
+		s64 transit = now - ((u64)ntohl(pgh->tv_sec) * NSEC_PER_SEC +
+				     (u64)ntohl(pgh->tv_usec) * NSEC_PER_USEC);
+
+		if (stats->timed) {
+			s64 d = abs64(transit - stats->last_transit);
+
+			stats->jitter_ns += div_s64(d - (s64)stats->jitter_ns,
+						    16);
+		}
+		stats->last_transit = transit;
+		stats->timed = true;
+	}
+	u64_stats_update_end(&stats->syncp);
+}
+
+static int pktgen_rx_rcv(struct sk_buff *skb, struct net_device *dev,
+			 struct packet_type *pt, struct net_device *orig_dev)
+{
+	struct pktgen_rx *rx;
+	struct pktgen_hdr _pgh;
+	const struct pktgen_hdr *pgh;
+	unsigned int off;
+
+	if (pt->type == htons(ETH_P_IP)) {
+		const struct iphdr *iph;
+		struct iphdr _iph;
+
+		rx = container_of(pt, struct pktgen_rx, pt_ip);
+		iph = skb_header_pointer(skb, 0, sizeof(_iph), &_iph);
+		if (!iph || iph->protocol != IPPROTO_UDP ||
+		    ip_is_fragment(iph))
+			goto out;
+		off = iph->ihl * 4;
+	} else {
+		const struct ipv6hdr *ip6h;
+		struct ipv6hdr _ip6h;
+
+		rx = container_of(pt, struct pktgen_rx, pt_ipv6);
+		ip6h = skb_header_pointer(skb, 0, sizeof(_ip6h), &_ip6h);
+		if (!ip6h || ip6h->nexthdr != IPPROTO_UDP)
+			goto out;
+		off = sizeof(*ip6h);
+	}
+
+	pgh = skb_header_pointer(skb, off + sizeof(struct udphdr),
+				 sizeof(_pgh), &_pgh);
+	if (pgh && pgh->pgh_magic == htonl(PKTGEN_MAGIC))
+		pktgen_rx_account(rx, skb, pgh);
+out:
+	consume_skb(skb);
+	return NET_RX_SUCCESS;
+}
+
+/* Called with rtnl held */
+static void pktgen_rx_stop(struct pktgen_net *pn)
+{
+	struct pktgen_rx *rx = pn->rx;
+
+	if (!rx)
+		return;
+
+	__dev_remove_pack(&rx->pt_ip);
+	__dev_remove_pack(&rx->pt_ipv6);
+	pn->rx = NULL;
+	synchronize_net();
+
+	dev_put(rx->dev);
+	free_percpu(rx->stats);
+	kfree(rx);
+}
+
+/* Called with rtnl held; any previous measurement is dropped */
+static int pktgen_rx_start(struct pktgen_net *pn, struct net_device *dev)
+{
+	struct pktgen_rx *rx;
+	int cpu;
+
+	rx = kzalloc(sizeof(*rx), GFP_KERNEL);
+	if (!rx)
+		return -ENOMEM;
+
+	rx->stats = alloc_percpu(struct pktgen_rx_stats);
+	if (!rx->stats) {
+		kfree(rx);
+		return -ENOMEM;
+	}
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(rx->stats, cpu)->syncp);
+
+	dev_hold(dev);
+	pktgen_rx_stop(pn);
+
+	rx->dev = dev;
+	rx->pt_ip.type = htons(ETH_P_IP);
+	rx->pt_ip.dev = dev;
+	rx->pt_ip.func = pktgen_rx_rcv;
+	rx->pt_ipv6 = rx->pt_ip;
+	rx->pt_ipv6.type = htons(ETH_P_IPV6);
+
+	pn->rx = rx;
+	dev_add_pack(&rx->pt_ip);
+	dev_add_pack(&rx->pt_ipv6);
+
+	return 0;
+}
+
+static int pgrx_show(struct seq_file *seq, void *v)
+{
+	struct pktgen_net *pn = seq->private;
+	struct pktgen_rx_stats sum = { 0 };
+	u64 span = 0, pps = 0, bps = 0, lost = 0;
+	bool seen = false;
+	int cpu;
+
+	rtnl_lock();
+	if (!pn->rx) {
+		rtnl_unlock();
+		seq_puts(seq, "RX: off\n");
+		return 0;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct pktgen_rx_stats *stats = per_cpu_ptr(pn->rx->stats, cpu);
+		struct pktgen_rx_stats s;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_irq(&stats->syncp);
+			s = *stats;
+		} while (u64_stats_fetch_retry_irq(&stats->syncp, start));
+
+		if (!s.pkts)
+			continue;
+
+		if (!seen || (s32)(s.min_seq - sum.min_seq) < 0)
+			sum.min_seq = s.min_seq;
+		if (!seen || (s32)(s.max_seq - sum.max_seq) > 0)
+			sum.max_seq = s.max_seq;
+		if (!seen || s.first_ns < sum.first_ns)
+			sum.first_ns = s.first_ns;
+		if (s.last_ns > sum.last_ns)
+			sum.last_ns = s.last_ns;
+		sum.jitter_ns = max(sum.jitter_ns, s.jitter_ns);
+		sum.pkts += s.pkts;
+		sum.bytes += s.bytes;
+		sum.reordered += s.reordered;
+		seen = true;
+	}
+
+	seq_printf(seq, "RX: %s\n", pn->rx->dev->name);
+	rtnl_unlock();
+
+	if (seen) {
+		span = (u64)(sum.max_seq - sum.min_seq) + 1;
+		if (span > sum.pkts)
+			lost = span - sum.pkts;
+	}
+	if (sum.last_ns > sum.first_ns) {
+		u64 elapsed = sum.last_ns - sum.first_ns;
+
+		pps = div64_u64((sum.pkts - 1) * NSEC_PER_SEC, elapsed);
+		bps = div64_u64(sum.bytes * 8 * NSEC_PER_SEC, elapsed);
+	}
+
+	seq_printf(seq, "  pkts: %llu  bytes: %llu  usec: %llu\n",
+		   (unsigned long long)sum.pkts,
+		   (unsigned long long)sum.bytes,
+		   (unsigned long long)div_u64(sum.last_ns - sum.first_ns,
+					       NSEC_PER_USEC));
+	seq_printf(seq, "  seq: %u..%u  lost: %llu  reordered: %llu\n",
+		   sum.min_seq, sum.max_seq,
+		   (unsigned long long)lost,
+		   (unsigned long long)sum.reordered);
+	seq_printf(seq, "  %llupps %lluMb/sec (%llubps)  jitter: %lluns\n",
+		   (unsigned long long)pps,
+		   (unsigned long long)div_u64(bps, 1000000),
+		   (unsigned long long)bps,
+		   (unsigned long long)sum.jitter_ns);
+
+	return 0;
+}
+
+static ssize_t pgrx_write(struct file *file, const char __user *buf,
+			  size_t count, loff_t *ppos)
+{
+	struct seq_file *seq = file->private_data;
+	struct pktgen_net *pn = seq->private;
+	struct net_device *dev;
+	char data[IFNAMSIZ + 8];
+	int ret = 0;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (count == 0)
+		return -EINVAL;
+
+	if (count > sizeof(data))
+		count = sizeof(data);
+
+	if (copy_from_user(data, buf, count))
+		return -EFAULT;
+
+	data[count - 1] = 0;	/* Strip trailing '\n' and terminate string */
+
+	rtnl_lock();
+	if (!strncmp(data, "rx ", 3)) {
+		dev = __dev_get_by_name(pn->net, strim(data + 3));
+		if (dev)
+			ret = pktgen_rx_start(pn, dev);
+		else
+			ret = -ENODEV;
+	} else if (!strcmp(data, "rx_reset")) {
+		if (pn->rx)
+			ret = pktgen_rx_start(pn, pn->rx->dev);
+	} else if (!strcmp(data, "rx_disable")) {
+		pktgen_rx_stop(pn);
+	} else {
+		pr_warn("Unknown command: %s\n", data);
+		ret = -EINVAL;
+	}
+	rtnl_unlock();
+
+	return ret ? ret : count;
+}
+
+static int pgrx_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pgrx_show, PDE_DATA(inode));
+}
+
+static const struct file_operations pktgen_rx_fops = {
+	.owner   = THIS_MODULE,
+	.open    = pgrx_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.write   = pgrx_write,
+	.release = single_release,
+};
+
 static int pktgen_if_show(struct seq_file *seq, void *v)
 {
 	const struct pktgen_dev *pkt_dev = seq->private;
@@ -1995,6 +2294,8 @@ static int pktgen_device_event(struct notifier_block *unused,
 
 	case NETDEV_UNREGISTER:
 		pktgen_mark_device(pn, dev->name);
+		if (pn->rx && pn->rx->dev == dev)
+			pktgen_rx_stop(pn);
 		break;
 	}
 
@@ -3768,6 +4069,12 @@ static int __net_init pg_net_init(struct net *net)
 		ret = -EINVAL;
 		goto remove;
 	}
+	pe = proc_create_data(PGRX, 0600, pn->proc_dir, &pktgen_rx_fops, pn);
+	if (pe == NULL) {
+		pr_err("cannot create %s procfs entry\n", PGRX);
+		ret = -EINVAL;
+		goto remove_entry;
+	}
 
 	for_each_online_cpu(cpu) {
 		int err;
@@ -3781,11 +4088,13 @@ static int __net_init pg_net_init(struct net *net)
 	if (list_empty(&pn->pktgen_threads)) {
 		pr_err("Initialization failed for all threads\n");
 		ret = -ENODEV;
-		goto remove_entry;
+		goto remove_rx_entry;
 	}
 
 	return 0;
 
+remove_rx_entry:
+	remove_proc_entry(PGRX, pn->proc_dir);
 remove_entry:
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 remove:
@@ -3814,6 +4123,11 @@ static void __net_exit pg_net_exit(struct net *net)
 		kfree(t);
 	}
 
+	rtnl_lock();
+	pktgen_rx_stop(pn);
+	rtnl_unlock();
+
+	remove_proc_entry(PGRX, pn->proc_dir);
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 	remove_proc_entry(PG_PROC_DIR, pn->net->proc_net);
 }
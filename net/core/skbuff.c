@@ -279,6 +279,32 @@ nodata:
 }
 EXPORT_SYMBOL(__alloc_skb);
 
+/* Initialise a freshly allocated sk_buff head around @data */
+static void __build_skb_around(struct sk_buff *skb, void *data,
+			       unsigned int frag_size)
+{
+	struct skb_shared_info *shinfo;
+	unsigned int size = frag_size ? : ksize(data);
+
+	size -= SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+
+	memset(skb, 0, offsetof(struct sk_buff, tail));
+	skb->truesize = SKB_TRUESIZE(size);
+	atomic_set(&skb->users, 1);
+	skb->head = data;
+	skb->data = data;
+	skb_reset_tail_pointer(skb);
+	skb->end = skb->tail + size;
+	skb->mac_header = (typeof(skb->mac_header))~0U;
+	skb->transport_header = (typeof(skb->transport_header))~0U;
+
+	/* make sure we initialize shinfo sequentially */
+	shinfo = skb_shinfo(skb);
+	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
+	atomic_set(&shinfo->dataref, 1);
+	kmemcheck_annotate_variable(shinfo->destructor_arg);
+}
+
 /**
  * __build_skb - build a network buffer
  * @data: data buffer provided by caller
@@ -300,32 +326,13 @@ EXPORT_SYMBOL(__alloc_skb);
  */
 struct sk_buff *__build_skb(void *data, unsigned int frag_size)
 {
-	struct skb_shared_info *shinfo;
 	struct sk_buff *skb;
-	unsigned int size = frag_size ? : ksize(data);
 
 	skb = kmem_cache_alloc(skbuff_head_cache, GFP_ATOMIC);
 	if (!skb)
 		return NULL;
 
-	size -= SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
-
-	memset(skb, 0, offsetof(struct sk_buff, tail));
-	skb->truesize = SKB_TRUESIZE(size);
-	atomic_set(&skb->users, 1);
-	skb->head = data;
-	skb->data = data;
-	skb_reset_tail_pointer(skb);
-	skb->end = skb->tail + size;
-	skb->mac_header = (typeof(skb->mac_header))~0U;
-	skb->transport_header = (typeof(skb->transport_header))~0U;
-
-	/* make sure we initialize shinfo sequentially */
-	shinfo = skb_shinfo(skb);
-	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
-	atomic_set(&shinfo->dataref, 1);
-	kmemcheck_annotate_variable(shinfo->destructor_arg);
-
+	__build_skb_around(skb, data, frag_size);
 	return skb;
 }
 
@@ -347,6 +354,82 @@ struct sk_buff *build_skb(void *data, unsigned int frag_size)
 }
 EXPORT_SYMBOL(build_skb);
 
+/* sk_buff heads freed by napi_consume_skb(), for the NAPI rx allocators to
+ * pick up again before going to the slab. Only touched from NAPI context.
+ */
+#define NAPI_SKB_CACHE_SIZE	64
+#define NAPI_SKB_CACHE_HALF	(NAPI_SKB_CACHE_SIZE / 2)
+
+struct napi_skb_cache {
+	unsigned int	count;
+	void		*heads[NAPI_SKB_CACHE_SIZE];
+};
+static DEFINE_PER_CPU(struct napi_skb_cache, napi_skb_cache);
+
+static struct sk_buff *napi_skb_cache_get(void)
+{
+	struct napi_skb_cache *nc = this_cpu_ptr(&napi_skb_cache);
+
+	if (likely(nc->count))
+		return nc->heads[--nc->count];
+
+	return kmem_cache_alloc(skbuff_head_cache, GFP_ATOMIC);
+}
+
+static void napi_skb_cache_put(struct sk_buff *skb)
+{
+	struct napi_skb_cache *nc = this_cpu_ptr(&napi_skb_cache);
+
+	if (unlikely(nc->count == NAPI_SKB_CACHE_SIZE)) {
+		kmem_cache_free(skbuff_head_cache, skb);
+		return;
+	}
+
+	nc->heads[nc->count++] = skb;
+}
+
+/**
+ * __kfree_skb_flush - trim the per-cpu cache of sk_buff heads
+ *
+ * Called by net_rx_action() once a round of polling is done. Heads the rx
+ * side did not take go back to the slab, but for half a cache kept for
+ * the next round.
+ */
+void __kfree_skb_flush(void)
+{
+	struct napi_skb_cache *nc = this_cpu_ptr(&napi_skb_cache);
+
+	while (nc->count > NAPI_SKB_CACHE_HALF)
+		kmem_cache_free(skbuff_head_cache, nc->heads[--nc->count]);
+}
+
+/**
+ * napi_build_skb - build a network buffer from NAPI context
+ * @data: data buffer provided by caller
+ * @frag_size: size of data, or 0 if head was kmalloced
+ *
+ * Same as build_skb(), but the sk_buff head comes from the per-cpu cache
+ * filled by napi_consume_skb(). Must be called from a NAPI poll routine.
+ */
+struct sk_buff *napi_build_skb(void *data, unsigned int frag_size)
+{
+	struct sk_buff *skb;
+
+	skb = napi_skb_cache_get();
+	if (unlikely(!skb))
+		return NULL;
+
+	__build_skb_around(skb, data, frag_size);
+
+	if (frag_size) {
+		skb->head_frag = 1;
+		if (page_is_pfmemalloc(virt_to_head_page(data)))
+			skb->pfmemalloc = 1;
+	}
+	return skb;
+}
+EXPORT_SYMBOL(napi_build_skb);
+
 struct netdev_alloc_cache {
 	struct page_frag	frag;
 	/* we maintain a pagecount bias, so that we dont dirty cache line
@@ -492,12 +575,17 @@ static struct sk_buff *__alloc_rx_skb(unsigned int length, gfp_t gfp_mask,
 		if (sk_memalloc_socks())
 			gfp_mask |= __GFP_MEMALLOC;
 
-		data = (flags & SKB_ALLOC_NAPI) ?
-			__napi_alloc_frag(fragsz, gfp_mask) :
-			__netdev_alloc_frag(fragsz, gfp_mask);
+		if (flags & SKB_ALLOC_NAPI) {
+			data = __napi_alloc_frag(fragsz, gfp_mask);
+			if (likely(data))
+				skb = napi_build_skb(data, fragsz);
+		} else {
+			data = __netdev_alloc_frag(fragsz, gfp_mask);
+			if (likely(data))
+				skb = build_skb(data, fragsz);
+		}
 
 		if (likely(data)) {
-			skb = build_skb(data, fragsz);
 			if (unlikely(!skb))
 				put_page(virt_to_head_page(data));
 		}
@@ -795,6 +883,59 @@ void consume_skb(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(consume_skb);
 
+/**
+ *	napi_consume_skb - free an skbuff from a NAPI poll routine
+ *	@skb: buffer to free
+ *	@budget: budget of the poll routine, 0 if not called from one
+ *
+ *	Like consume_skb(), but the sk_buff head is kept in a per-cpu cache
+ *	for napi_build_skb() and __napi_alloc_skb() to reuse. Meant for tx
+ *	completion done from NAPI; any other context, netpoll included,
+ *	falls back to dev_consume_skb_any().
+ */
+void napi_consume_skb(struct sk_buff *skb, int budget)
+{
+	if (unlikely(!skb))
+		return;
+
+	/* netpoll polls with irqs off, maybe nested in a softirq that is
+	 * using the cache right now
+	 */
+	if (unlikely(!budget || !in_softirq() || irqs_disabled())) {
+		dev_consume_skb_any(skb);
+		return;
+	}
+
+	if (likely(atomic_read(&skb->users) == 1))
+		smp_rmb();
+	else if (likely(!atomic_dec_and_test(&skb->users)))
+		return;
+	trace_consume_skb(skb);
+
+	/* fclones go back to their own cache */
+	if (skb->fclone != SKB_FCLONE_UNAVAILABLE) {
+		__kfree_skb(skb);
+		return;
+	}
+
+	skb_release_all(skb);
+	napi_skb_cache_put(skb);
+}
+EXPORT_SYMBOL(napi_consume_skb);
+
+/**
+ *	napi_skb_free_stolen_head - free the head of a merged skbuff
+ *	@skb: buffer whose data was stolen by GRO
+ *
+ *	The head goes to the per-cpu cache, as with napi_consume_skb().
+ *	NAPI context only.
+ */
+void napi_skb_free_stolen_head(struct sk_buff *skb)
+{
+	skb_dst_drop(skb);
+	napi_skb_cache_put(skb);
+}
+
 /* Make sure a field is enclosed inside headers_start/headers_end section */
 #define CHECK_SKB_FIELD(field) \
 	BUILD_BUG_ON(offsetof(struct sk_buff, field) <		\
@@ -4184,6 +4325,8 @@ unsigned int skb_gso_transport_seglen(const struct sk_buff *skb)
 			thlen += inner_tcp_hdrlen(skb);
 	} else if (likely(shinfo->gso_type & (SKB_GSO_TCPV4 | SKB_GSO_TCPV6))) {
 		thlen = tcp_hdrlen(skb);
+	} else if (shinfo->gso_type & SKB_GSO_UDP_L4) {
+		thlen = sizeof(struct udphdr);
 	}
 	/* UFO sets gso_size to the size of the fragmentation
 	 * payload, i.e. the size of the L4 (UDP) header is already
@@ -739,6 +739,7 @@ static int ping_v4_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 	ipc.oif = sk->sk_bound_dev_if;
 	ipc.tx_flags = 0;
 	ipc.ttl = 0;
+	ipc.gso_size = 0;
 	ipc.tos = -1;
 
 	sock_tx_timestamp(sk, &ipc.tx_flags);
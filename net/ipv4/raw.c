@@ -538,6 +538,7 @@ static int raw_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 	ipc.opt = NULL;
 	ipc.tx_flags = 0;
 	ipc.ttl = 0;
+	ipc.gso_size = 0;
 	ipc.tos = -1;
 	ipc.oif = sk->sk_bound_dev_if;
 
@@ -793,7 +793,11 @@ void udp_set_csum(bool nocheck, struct sk_buff *skb,
 }
 EXPORT_SYMBOL(udp_set_csum);
 
-static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4)
+/* A GSO datagram is split into at most this many segments */
+#define UDP_MAX_SEGMENTS	64
+
+static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4,
+			unsigned int gso_size)
 {
 	struct sock *sk = skb->sk;
 	struct inet_sock *inet = inet_sk(sk);
@@ -813,6 +817,34 @@ static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4)
 	uh->len = htons(len);
 	uh->check = 0;
 
+	if (gso_size) {
+		unsigned int hlen = skb_network_header_len(skb) + sizeof(*uh);
+		unsigned int datalen = len - sizeof(*uh);
+
+		if (hlen + gso_size > ip_skb_dst_mtu(skb) ||
+		    datalen > gso_size * UDP_MAX_SEGMENTS) {
+			kfree_skb(skb);
+			return -EINVAL;
+		}
+		/* the segments are checksummed one by one */
+		if (sk->sk_no_check_tx || is_udplite ||
+		    skb->ip_summed != CHECKSUM_PARTIAL ||
+		    dst_xfrm(skb_dst(skb))) {
+			kfree_skb(skb);
+			return -EIO;
+		}
+
+		if (datalen > gso_size) {
+			struct skb_shared_info *shinfo = skb_shinfo(skb);
+
+			shinfo->gso_size = gso_size;
+			shinfo->gso_type = SKB_GSO_UDP_L4;
+			shinfo->gso_segs = DIV_ROUND_UP(datalen, gso_size);
+		}
+		udp4_hwcsum(skb, fl4->saddr, fl4->daddr);
+		goto send;
+	}
+
 	if (is_udplite)  				 /*     UDP-Lite      */
 		csum = udplite_csum(skb);
 
@@ -864,7 +896,7 @@ int udp_push_pending_frames(struct sock *sk)
 	if (!skb)
 		goto out;
 
-	err = udp_send_skb(skb, fl4);
+	err = udp_send_skb(skb, fl4, inet->cork.base.gso_size);
 
 out:
 	up->len = 0;
@@ -873,6 +905,31 @@ out:
 }
 EXPORT_SYMBOL(udp_push_pending_frames);
 
+static int udp_cmsg_send(struct msghdr *msg, u16 *gso_size)
+{
+	struct cmsghdr *cmsg;
+
+	for_each_cmsghdr(cmsg, msg) {
+		if (!CMSG_OK(msg, cmsg))
+			return -EINVAL;
+
+		if (cmsg->cmsg_level != SOL_UDP)
+			continue;
+
+		switch (cmsg->cmsg_type) {
+		case UDP_SEGMENT:
+			if (cmsg->cmsg_len != CMSG_LEN(sizeof(__u16)))
+				return -EINVAL;
+			*gso_size = *(__u16 *)CMSG_DATA(cmsg);
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
 int udp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 {
 	struct inet_sock *inet = inet_sk(sk);
@@ -907,6 +964,7 @@ int udp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 	ipc.tx_flags = 0;
 	ipc.ttl = 0;
 	ipc.tos = -1;
+	ipc.gso_size = up->gso_size;
 
 	getfrag = is_udplite ? udplite_getfrag : ip_generic_getfrag;
 
@@ -961,6 +1019,9 @@ int udp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 	sock_tx_timestamp(sk, &ipc.tx_flags);
 
 	if (msg->msg_controllen) {
+		err = udp_cmsg_send(msg, &ipc.gso_size);
+		if (err)
+			return err;
 		err = ip_cmsg_send(sock_net(sk), msg, &ipc,
 				   sk->sk_family == AF_INET6);
 		if (err)
@@ -1053,7 +1114,7 @@ back_from_confirm:
 				  msg->msg_flags);
 		err = PTR_ERR(skb);
 		if (!IS_ERR_OR_NULL(skb))
-			err = udp_send_skb(skb, fl4);
+			err = udp_send_skb(skb, fl4, ipc.gso_size);
 		goto out;
 	}
 
@@ -1326,6 +1387,9 @@ try_again:
 		memset(sin->sin_zero, 0, sizeof(sin->sin_zero));
 		*addr_len = sizeof(*sin);
 	}
+	if (udp_sk(sk)->gro_enabled)
+		udp_cmsg_recv(msg, sk, skb);
+
 	if (inet->cmsg_flags)
 		ip_cmsg_recv_offset(msg, skb, sizeof(struct udphdr));
 
@@ -1481,6 +1545,14 @@ void udp_encap_enable(void)
 }
 EXPORT_SYMBOL(udp_encap_enable);
 
+/* GRO only looks sockets up once some socket asked for UDP_GRO */
+struct static_key udp_gro_needed __read_mostly;
+void udp_gro_enable(void)
+{
+	if (!static_key_enabled(&udp_gro_needed))
+		static_key_slow_inc(&udp_gro_needed);
+}
+
 /* returns:
  *  -1: error
  *   0: success
@@ -1489,7 +1561,7 @@ EXPORT_SYMBOL(udp_encap_enable);
  * Note that in the success and error cases, the skb is assumed to
  * have either been requeued or freed.
  */
-int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
+static int udp_queue_rcv_one_skb(struct sock *sk, struct sk_buff *skb)
 {
 	struct udp_sock *up = udp_sk(sk);
 	int rc;
@@ -1604,6 +1676,55 @@ drop:
 	return -1;
 }
 
+/*
+ * Cut a datagram coalesced by GRO back into the datagrams it was made of.
+ * GRO verified their checksums, the segments are left CHECKSUM_PARTIAL
+ * and nothing gets summed again.
+ */
+static struct sk_buff *udp_rcv_segment(struct sock *sk, struct sk_buff *skb)
+{
+	/* the GSO control block overlays ours */
+	struct udp_skb_cb cb = *UDP_SKB_CB(skb);
+	struct sk_buff *segs, *seg;
+
+	__skb_push(skb, -skb_mac_offset(skb));
+	segs = __skb_gso_segment(skb, NETIF_F_SG | NETIF_F_IP_CSUM, false);
+	if (IS_ERR_OR_NULL(segs)) {
+		UDP_INC_STATS_BH(sock_net(sk), UDP_MIB_INERRORS,
+				 IS_UDPLITE(sk));
+		atomic_inc(&sk->sk_drops);
+		kfree_skb(skb);
+		return NULL;
+	}
+	consume_skb(skb);
+
+	for (seg = segs; seg; seg = seg->next) {
+		__skb_pull(seg, skb_transport_offset(seg));
+		*UDP_SKB_CB(seg) = cb;
+		UDP_SKB_CB(seg)->cscov = seg->len;
+	}
+
+	return segs;
+}
+
+int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
+{
+	struct sk_buff *next;
+
+	if (likely(!udp_unexpected_gso(sk, skb)))
+		return udp_queue_rcv_one_skb(sk, skb);
+
+	for (skb = udp_rcv_segment(sk, skb); skb; skb = next) {
+		next = skb->next;
+		skb->next = NULL;
+		/* resubmission is for whole datagrams only */
+		if (udp_queue_rcv_one_skb(sk, skb) > 0)
+			kfree_skb(skb);
+	}
+
+	return 0;
+}
+
 static void flush_stack(struct sock **stack, unsigned int count,
 			struct sk_buff *skb, unsigned int final)
 {
@@ -2086,6 +2207,18 @@ int udp_lib_setsockopt(struct sock *sk, int level, int optname,
 		up->no_check6_rx = valbool;
 		break;
 
+	case UDP_SEGMENT:
+		if (val < 0 || val > USHRT_MAX)
+			return -EINVAL;
+		up->gso_size = val;
+		break;
+
+	case UDP_GRO:
+		if (valbool)
+			udp_gro_enable();
+		up->gro_enabled = valbool;
+		break;
+
 	/*
 	 * 	UDP-Lite's partial checksum coverage (RFC 3828).
 	 */
@@ -2176,6 +2309,14 @@ int udp_lib_getsockopt(struct sock *sk, int level, int optname,
 		val = up->no_check6_rx;
 		break;
 
+	case UDP_SEGMENT:
+		val = up->gso_size;
+		break;
+
+	case UDP_GRO:
+		val = up->gro_enabled;
+		break;
+
 	/* The following two cannot be changed on UDP sockets, the return is
 	 * always 0 (which corresponds to the full checksum coverage of UDP). */
 	case UDPLITE_SEND_CSCOV:
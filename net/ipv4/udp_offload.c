@@ -175,6 +175,76 @@ out_unlock:
 	return segs;
 }
 
+/*
+ * Cut a UDP_SEGMENT datagram into gso_size datagrams of their own, the
+ * last one possibly shorter. uh->check holds the pseudo header sum for the
+ * whole length on entry.
+ */
+static struct sk_buff *__udp_gso_segment(struct sk_buff *gso_skb,
+					 netdev_features_t features)
+{
+	struct sock *sk = gso_skb->sk;
+	unsigned int sum_truesize = 0;
+	struct sk_buff *segs, *seg;
+	unsigned int mss;
+	struct udphdr *uh;
+	bool copy_dtor;
+	__sum16 check;
+	__be16 newlen;
+
+	mss = skb_shinfo(gso_skb)->gso_size;
+	if (gso_skb->len <= sizeof(*uh) + mss)
+		return ERR_PTR(-EINVAL);
+
+	skb_pull(gso_skb, sizeof(*uh));
+
+	/* the segments carry the socket memory until they are sent */
+	copy_dtor = gso_skb->destructor == sock_wfree;
+	if (copy_dtor)
+		gso_skb->destructor = NULL;
+
+	segs = skb_segment(gso_skb, features);
+	if (IS_ERR_OR_NULL(segs)) {
+		if (copy_dtor)
+			gso_skb->destructor = sock_wfree;
+		return segs;
+	}
+
+	uh = udp_hdr(segs);
+	newlen = htons(sizeof(*uh) + mss);
+	check = csum16_add(csum16_sub(uh->check, uh->len), newlen);
+
+	for (seg = segs; seg; seg = seg->next) {
+		uh = udp_hdr(seg);
+
+		if (!seg->next) {
+			newlen = htons(skb_tail_pointer(seg) -
+				       skb_transport_header(seg) +
+				       seg->data_len);
+			check = csum16_add(csum16_sub(uh->check, uh->len),
+					   newlen);
+		}
+
+		uh->len = newlen;
+		uh->check = check;
+		if (seg->ip_summed != CHECKSUM_PARTIAL)
+			uh->check = gso_make_checksum(seg, ~check) ? :
+				    CSUM_MANGLED_0;
+
+		if (copy_dtor) {
+			seg->destructor = sock_wfree;
+			seg->sk = sk;
+			sum_truesize += seg->truesize;
+		}
+	}
+
+	if (copy_dtor)
+		atomic_add(sum_truesize - gso_skb->truesize,
+			   &sk->sk_wmem_alloc);
+
+	return segs;
+}
+
 static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 					 netdev_features_t features)
 {
@@ -194,6 +264,11 @@ static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 	if (!pskb_may_pull(skb, sizeof(struct udphdr)))
 		goto out;
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) {
+		segs = __udp_gso_segment(skb, features);
+		goto out;
+	}
+
 	mss = skb_shinfo(skb)->gso_size;
 	if (unlikely(skb->len <= mss))
 		goto out;
@@ -349,6 +424,80 @@ out:
 	return pp;
 }
 
+/* keeps the truesize of a batch of small datagrams in check */
+#define UDP_GRO_CNT_MAX 64
+
+/*
+ * Coalesce a datagram for a UDP_GRO socket with the ones before it in the
+ * flow.  All datagrams of a batch have the size of the first one, which
+ * becomes gso_size, except for the last one, which may be shorter.
+ */
+static struct sk_buff **udp_gro_receive_segment(struct sk_buff **head,
+						struct sk_buff *skb,
+						struct udphdr *uh)
+{
+	unsigned int off = skb_gro_offset(skb);
+	unsigned int ulen = ntohs(uh->len);
+	struct sk_buff *p, **pp = NULL;
+	struct udphdr *uh2;
+
+	/* as on output, a datagram without a checksum stays alone */
+	if (!uh->check || ulen <= sizeof(*uh) || ulen != skb_gro_len(skb)) {
+		NAPI_GRO_CB(skb)->flush = 1;
+		return NULL;
+	}
+
+	NAPI_GRO_CB(skb)->udp_gro = 1;
+	skb_gro_pull(skb, sizeof(struct udphdr));
+	skb_gro_postpull_rcsum(skb, uh, sizeof(struct udphdr));
+
+	for (; (p = *head); head = &p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = (struct udphdr *)(p->data + off);
+		if (*(u32 *)&uh->source != *(u32 *)&uh2->source) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+
+		/* A longer datagram starts a batch of its own, a shorter
+		 * one is the last of this batch.
+		 */
+		if (NAPI_GRO_CB(p)->flush || ulen > ntohs(uh2->len) ||
+		    skb_gro_receive(head, skb) ||
+		    NAPI_GRO_CB(*head)->count >= UDP_GRO_CNT_MAX ||
+		    ulen != ntohs(uh2->len))
+			pp = head;
+
+		return pp;
+	}
+
+	return NULL;
+}
+
+/* Coalesce only for a socket that asked for it with UDP_GRO */
+static bool udp4_gro_wanted(struct sk_buff *skb, struct udphdr *uh)
+{
+	const struct iphdr *iph = skb_gro_network_header(skb);
+	struct sock *sk;
+	bool ret;
+
+	if (!static_key_false(&udp_gro_needed) || NAPI_GRO_CB(skb)->udp_mark)
+		return false;
+
+	sk = __udp4_lib_lookup(dev_net(skb->dev), iph->saddr, uh->source,
+			       iph->daddr, uh->dest, skb->dev->ifindex,
+			       &udp_table);
+	if (!sk)
+		return false;
+
+	ret = udp_sk(sk)->gro_enabled;
+	sock_put(sk);
+
+	return ret;
+}
+
 static struct sk_buff **udp4_gro_receive(struct sk_buff **head,
 					 struct sk_buff *skb)
 {
@@ -369,6 +518,8 @@ static struct sk_buff **udp4_gro_receive(struct sk_buff **head,
 					     inet_gro_compute_pseudo);
 skip:
 	NAPI_GRO_CB(skb)->is_ipv6 = 0;
+	if (udp4_gro_wanted(skb, uh))
+		return udp_gro_receive_segment(head, skb, uh);
 	return udp_gro_receive(head, skb, uh);
 
 flush:
@@ -412,11 +563,37 @@ int udp_gro_complete(struct sk_buff *skb, int nhoff)
 	return err;
 }
 
+/*
+ * A batch of datagrams leaves GRO like a UDP_SEGMENT datagram leaves the
+ * socket layer, and is cut up again the same way if it is forwarded or
+ * goes to a socket that did not ask for it.
+ */
+static int udp4_gro_complete_segment(struct sk_buff *skb, int nhoff)
+{
+	const struct iphdr *iph = ip_hdr(skb);
+	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
+
+	uh->len = htons(skb->len - nhoff);
+	uh->check = ~udp_v4_check(skb->len - nhoff, iph->saddr, iph->daddr, 0);
+
+	skb->csum_start = (unsigned char *)uh - skb->head;
+	skb->csum_offset = offsetof(struct udphdr, check);
+	skb->ip_summed = CHECKSUM_PARTIAL;
+
+	skb_shinfo(skb)->gso_segs = NAPI_GRO_CB(skb)->count;
+	skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_L4;
+
+	return 0;
+}
+
 static int udp4_gro_complete(struct sk_buff *skb, int nhoff)
 {
 	const struct iphdr *iph = ip_hdr(skb);
 	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
 
+	if (NAPI_GRO_CB(skb)->udp_gro)
+		return udp4_gro_complete_segment(skb, nhoff);
+
 	if (uh->check) {
 		skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_TUNNEL_CSUM;
 		uh->check = ~udp_v4_check(skb->len - nhoff, iph->saddr,
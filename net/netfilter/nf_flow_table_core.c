@@ -0,0 +1,263 @@
+/*
+ * Flow table: established conntrack flows that are forwarded without
+ * going through the netfilter hooks and the routing code again.
+ *
+ * Flows are promoted by the nf_tables "flow_offload" expression, and
+ * looked up very early at ingress by the hook in nf_flow_table_ip.c.
+ * A flow goes back to conntrack when it has been idle for a while, when
+ * a TCP FIN or RST is seen, when its conntrack dies or when one of its
+ * devices goes down.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/netdevice.h>
+#include <linux/workqueue.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_core.h>
+#include <net/netfilter/nf_flow_table.h>
+
+#define NF_FLOW_TABLE_HSIZE	1024
+
+static unsigned int nf_flow_max __read_mostly = 8192;
+module_param_named(max_flows, nf_flow_max, uint, 0644);
+MODULE_PARM_DESC(max_flows, "maximum number of offloaded flows");
+
+static struct hlist_head nf_flow_hash[NF_FLOW_TABLE_HSIZE];
+static LIST_HEAD(nf_flow_list);
+static DEFINE_SPINLOCK(nf_flow_lock);
+static unsigned int nf_flow_count;
+static u32 nf_flow_hash_rnd __read_mostly;
+
+static void nf_flow_gc_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(nf_flow_gc, nf_flow_gc_work);
+
+static u32 flow_offload_hash(const struct flow_offload_tuple *tuple)
+{
+	return jhash(tuple, FLOW_OFFLOAD_KEY_LEN, nf_flow_hash_rnd) &
+	       (NF_FLOW_TABLE_HSIZE - 1);
+}
+
+static void flow_offload_fill_dir(struct flow_offload *flow,
+				  struct nf_conn *ct, struct dst_entry *dst,
+				  int iifidx, enum flow_offload_dir dir)
+{
+	struct flow_offload_tuple *ft = &flow->tuplehash[dir].tuple;
+	struct nf_conntrack_tuple *ctt = &ct->tuplehash[dir].tuple;
+
+	ft->src_v4 = ctt->src.u3.ip;
+	ft->dst_v4 = ctt->dst.u3.ip;
+	ft->src_port = ctt->src.u.tcp.port;
+	ft->dst_port = ctt->dst.u.tcp.port;
+	ft->iifidx = iifidx;
+	ft->l4proto = ctt->dst.protonum;
+	ft->dir = dir;
+	ft->dst_cache = dst;
+}
+
+/**
+ * flow_offload_add - move a conntrack flow to the fast path
+ * @ct: the conntrack, with IPS_OFFLOAD_BIT set by the caller
+ * @dst: the route of either direction
+ *
+ * The packets of a direction come in on the output device of the route of
+ * the other one. A reference is taken on @ct and on both routes. Softirq
+ * context.
+ */
+int flow_offload_add(struct nf_conn *ct,
+		     struct dst_entry *dst[FLOW_OFFLOAD_DIR_MAX])
+{
+	struct flow_offload *flow;
+	unsigned long expires;
+	int i;
+
+	if (nf_flow_count >= nf_flow_max)
+		return -ENOSPC;
+
+	flow = kzalloc(sizeof(*flow), GFP_ATOMIC);
+	if (!flow)
+		return -ENOMEM;
+
+	flow_offload_fill_dir(flow, ct, dst[FLOW_OFFLOAD_DIR_ORIGINAL],
+			      dst[FLOW_OFFLOAD_DIR_REPLY]->dev->ifindex,
+			      FLOW_OFFLOAD_DIR_ORIGINAL);
+	flow_offload_fill_dir(flow, ct, dst[FLOW_OFFLOAD_DIR_REPLY],
+			      dst[FLOW_OFFLOAD_DIR_ORIGINAL]->dev->ifindex,
+			      FLOW_OFFLOAD_DIR_REPLY);
+
+	/* keep conntrack alive for as long as its l4 tracker last set */
+	expires = ct->timeout.expires;
+	flow->ct_timeout = time_after(expires, jiffies + HZ) ?
+			   expires - jiffies : HZ;
+	flow->timeout = jiffies + FLOW_OFFLOAD_TIMEOUT;
+
+	nf_conntrack_get(&ct->ct_general);
+	flow->ct = ct;
+	for (i = 0; i < FLOW_OFFLOAD_DIR_MAX; i++)
+		dst_hold(dst[i]);
+
+	spin_lock_bh(&nf_flow_lock);
+	for (i = 0; i < FLOW_OFFLOAD_DIR_MAX; i++) {
+		struct flow_offload_tuple_rhash *th = &flow->tuplehash[i];
+		u32 hash = flow_offload_hash(&th->tuple);
+
+		hlist_add_head_rcu(&th->node, &nf_flow_hash[hash]);
+	}
+	list_add_tail(&flow->list, &nf_flow_list);
+	nf_flow_count++;
+	spin_unlock_bh(&nf_flow_lock);
+
+	queue_delayed_work(system_power_efficient_wq, &nf_flow_gc, HZ);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(flow_offload_add);
+
+/* Called under rcu_read_lock() */
+struct flow_offload_tuple_rhash *
+flow_offload_lookup(const struct flow_offload_tuple *tuple)
+{
+	struct flow_offload_tuple_rhash *th;
+
+	hlist_for_each_entry_rcu(th, &nf_flow_hash[flow_offload_hash(tuple)],
+				 node) {
+		if (!memcmp(&th->tuple, tuple, FLOW_OFFLOAD_KEY_LEN))
+			return th;
+	}
+
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(flow_offload_lookup);
+
+/* Hand the flow back to conntrack at the next garbage collection run */
+void flow_offload_teardown(struct flow_offload *flow)
+{
+	if (!test_and_set_bit(FLOW_OFFLOAD_TEARDOWN, &flow->flags))
+		mod_delayed_work(system_power_efficient_wq, &nf_flow_gc, 0);
+}
+EXPORT_SYMBOL_GPL(flow_offload_teardown);
+
+static void flow_offload_free_rcu(struct rcu_head *head)
+{
+	struct flow_offload *flow = container_of(head, struct flow_offload,
+						 rcu_head);
+	int i;
+
+	for (i = 0; i < FLOW_OFFLOAD_DIR_MAX; i++)
+		dst_release(flow->tuplehash[i].tuple.dst_cache);
+	nf_ct_put(flow->ct);
+	kfree(flow);
+}
+
+/* Called with nf_flow_lock held */
+static void flow_offload_del(struct flow_offload *flow)
+{
+	int i;
+
+	for (i = 0; i < FLOW_OFFLOAD_DIR_MAX; i++)
+		hlist_del_rcu(&flow->tuplehash[i].node);
+	list_del(&flow->list);
+	nf_flow_count--;
+
+	/* conntrack sees the packets again and may offload them anew */
+	clear_bit(IPS_OFFLOAD_BIT, &flow->ct->status);
+	call_rcu(&flow->rcu_head, flow_offload_free_rcu);
+}
+
+static bool flow_offload_expired(const struct flow_offload *flow)
+{
+	return test_bit(FLOW_OFFLOAD_TEARDOWN, &flow->flags) ||
+	       time_after(jiffies, flow->timeout) ||
+	       nf_ct_is_dying(flow->ct);
+}
+
+static void nf_flow_gc_work(struct work_struct *work)
+{
+	struct flow_offload *flow, *next;
+
+	spin_lock_bh(&nf_flow_lock);
+	list_for_each_entry_safe(flow, next, &nf_flow_list, list) {
+		if (flow_offload_expired(flow))
+			flow_offload_del(flow);
+	}
+	if (nf_flow_count)
+		queue_delayed_work(system_power_efficient_wq, &nf_flow_gc, HZ);
+	spin_unlock_bh(&nf_flow_lock);
+}
+
+static int nf_flow_netdev_event(struct notifier_block *this,
+				unsigned long event, void *ptr)
+{
+	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+	struct flow_offload *flow;
+	int i;
+
+	if (event != NETDEV_DOWN)
+		return NOTIFY_DONE;
+
+	spin_lock_bh(&nf_flow_lock);
+	list_for_each_entry(flow, &nf_flow_list, list) {
+		for (i = 0; i < FLOW_OFFLOAD_DIR_MAX; i++) {
+			if (flow->tuplehash[i].tuple.dst_cache->dev == dev)
+				set_bit(FLOW_OFFLOAD_TEARDOWN, &flow->flags);
+		}
+	}
+	spin_unlock_bh(&nf_flow_lock);
+
+	/* drop the routes before the device waits for its references */
+	flush_delayed_work(&nf_flow_gc);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block nf_flow_netdev_notifier = {
+	.notifier_call	= nf_flow_netdev_event,
+};
+
+static int __init nf_flow_table_init(void)
+{
+	int i, err;
+
+	for (i = 0; i < NF_FLOW_TABLE_HSIZE; i++)
+		INIT_HLIST_HEAD(&nf_flow_hash[i]);
+	get_random_bytes(&nf_flow_hash_rnd, sizeof(nf_flow_hash_rnd));
+
+	err = register_netdevice_notifier(&nf_flow_netdev_notifier);
+	if (err < 0)
+		return err;
+
+	err = nf_flow_table_ip_init();
+	if (err < 0)
+		unregister_netdevice_notifier(&nf_flow_netdev_notifier);
+
+	return err;
+}
+
+static void __exit nf_flow_table_fini(void)
+{
+	struct flow_offload *flow, *next;
+
+	nf_flow_table_ip_fini();
+	unregister_netdevice_notifier(&nf_flow_netdev_notifier);
+
+	cancel_delayed_work_sync(&nf_flow_gc);
+	spin_lock_bh(&nf_flow_lock);
+	list_for_each_entry_safe(flow, next, &nf_flow_list, list)
+		flow_offload_del(flow);
+	spin_unlock_bh(&nf_flow_lock);
+	rcu_barrier();
+}
+
+module_init(nf_flow_table_init);
+module_exit(nf_flow_table_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Netfilter flow table fast path");
@@ -0,0 +1,230 @@
+/*
+ * IPv4 fast path of the flow table: packets of offloaded flows are
+ * NATed and sent to the next hop right from PREROUTING, ahead of
+ * defragmentation and conntrack.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter_ipv4.h>
+#include <net/ip.h>
+#include <net/route.h>
+#include <net/neighbour.h>
+#include <net/checksum.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_flow_table.h>
+
+struct flow_ports {
+	__be16 source, dest;
+};
+
+/* Fill @tuple from @skb; fragments, IP options and TTL expiry go the slow
+ * way.
+ */
+static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
+			    struct flow_offload_tuple *tuple)
+{
+	struct flow_ports *ports;
+	unsigned int thoff, thlen;
+	struct iphdr *iph;
+
+	if (skb->pkt_type != PACKET_HOST)
+		return -1;
+
+	iph = ip_hdr(skb);
+	if (iph->ihl != 5 || ip_is_fragment(iph) || iph->ttl <= 1)
+		return -1;
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		thlen = sizeof(struct tcphdr);
+		break;
+	case IPPROTO_UDP:
+		thlen = sizeof(struct udphdr);
+		break;
+	default:
+		return -1;
+	}
+
+	thoff = iph->ihl * 4;
+	if (!pskb_may_pull(skb, thoff + thlen))
+		return -1;
+
+	iph = ip_hdr(skb);
+	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
+
+	tuple->src_v4 = iph->saddr;
+	tuple->dst_v4 = iph->daddr;
+	tuple->src_port = ports->source;
+	tuple->dst_port = ports->dest;
+	tuple->iifidx = dev->ifindex;
+	tuple->l4proto = iph->protocol;
+
+	return 0;
+}
+
+static bool nf_flow_exceeds_mtu(const struct sk_buff *skb, unsigned int mtu)
+{
+	if (skb->len <= mtu)
+		return false;
+
+	if (skb_is_gso(skb) && skb_gso_network_seglen(skb) <= mtu)
+		return false;
+
+	return true;
+}
+
+static void nf_flow_nat_addr(struct sk_buff *skb, struct iphdr *iph,
+			     __sum16 *check, __be32 *addr, __be32 new)
+{
+	if (*addr == new)
+		return;
+
+	csum_replace4(&iph->check, *addr, new);
+	if (check)
+		inet_proto_csum_replace4(check, skb, *addr, new, 1);
+	*addr = new;
+}
+
+static void nf_flow_nat_port(struct sk_buff *skb, __sum16 *check,
+			     __be16 *port, __be16 new)
+{
+	if (*port == new)
+		return;
+
+	if (check)
+		inet_proto_csum_replace2(check, skb, *port, new, 0);
+	*port = new;
+}
+
+/*
+ * A packet leaves as the other direction would come in, reversed: that
+ * covers SNAT, DNAT and both at once, and nothing when there is no NAT.
+ */
+static void nf_flow_nat_ip(const struct flow_offload *flow,
+			   struct sk_buff *skb, unsigned int thoff,
+			   enum flow_offload_dir dir)
+{
+	const struct flow_offload_tuple *other = &flow->tuplehash[!dir].tuple;
+	struct iphdr *iph = ip_hdr(skb);
+	struct flow_ports *ports = (void *)iph + thoff;
+	__sum16 *check = NULL;
+	struct udphdr *udph;
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		check = &((struct tcphdr *)ports)->check;
+		break;
+	case IPPROTO_UDP:
+		udph = (struct udphdr *)ports;
+		if (udph->check || skb->ip_summed == CHECKSUM_PARTIAL)
+			check = &udph->check;
+		break;
+	}
+
+	nf_flow_nat_addr(skb, iph, check, &iph->saddr, other->dst_v4);
+	nf_flow_nat_addr(skb, iph, check, &iph->daddr, other->src_v4);
+	nf_flow_nat_port(skb, check, &ports->source, other->dst_port);
+	nf_flow_nat_port(skb, check, &ports->dest, other->src_port);
+
+	if (iph->protocol == IPPROTO_UDP && check && !*check)
+		*check = CSUM_MANGLED_0;
+}
+
+static unsigned int nf_flow_offload_ip_hook(const struct nf_hook_ops *ops,
+					    struct sk_buff *skb,
+					    const struct nf_hook_state *state)
+{
+	struct flow_offload_tuple_rhash *tuplehash;
+	struct flow_offload_tuple tuple;
+	enum flow_offload_dir dir;
+	struct flow_offload *flow;
+	struct net_device *outdev;
+	struct dst_entry *dst;
+	unsigned int thoff;
+	struct iphdr *iph;
+	__be32 nexthop;
+
+	if (nf_flow_tuple_ip(skb, state->in, &tuple) < 0)
+		return NF_ACCEPT;
+
+	tuplehash = flow_offload_lookup(&tuple);
+	if (!tuplehash)
+		return NF_ACCEPT;
+
+	dir = tuplehash->tuple.dir;
+	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
+	if (test_bit(FLOW_OFFLOAD_TEARDOWN, &flow->flags))
+		return NF_ACCEPT;
+
+	dst = tuplehash->tuple.dst_cache;
+	if (!dst_check(dst, 0)) {
+		flow_offload_teardown(flow);
+		return NF_ACCEPT;
+	}
+
+	/* too big for the way out, let ip_forward() fragment or complain */
+	if (nf_flow_exceeds_mtu(skb, dst_mtu(dst)))
+		return NF_ACCEPT;
+
+	thoff = ip_hdrlen(skb);
+	if (tuple.l4proto == IPPROTO_TCP) {
+		struct tcphdr *tcph = (void *)skb_network_header(skb) + thoff;
+
+		/* conntrack has to see the end of the connection */
+		if (unlikely(tcph->fin || tcph->rst)) {
+			flow_offload_teardown(flow);
+			return NF_ACCEPT;
+		}
+	}
+
+	if (!skb_make_writable(skb, thoff + (tuple.l4proto == IPPROTO_TCP ?
+					     sizeof(struct tcphdr) :
+					     sizeof(struct udphdr))))
+		return NF_DROP;
+	if (skb_cow_head(skb, LL_RESERVED_SPACE(dst->dev)))
+		return NF_DROP;
+
+	flow->timeout = jiffies + FLOW_OFFLOAD_TIMEOUT;
+	nf_ct_refresh_acct(flow->ct, dir == FLOW_OFFLOAD_DIR_ORIGINAL ?
+			   IP_CT_ESTABLISHED : IP_CT_ESTABLISHED_REPLY,
+			   skb, flow->ct_timeout);
+
+	nf_flow_nat_ip(flow, skb, thoff, dir);
+
+	iph = ip_hdr(skb);
+	ip_decrease_ttl(iph);
+
+	outdev = dst->dev;
+	skb->dev = outdev;
+	nexthop = rt_nexthop((struct rtable *)dst, iph->daddr);
+	neigh_xmit(NEIGH_ARP_TABLE, outdev, &nexthop, skb);
+
+	return NF_STOLEN;
+}
+
+static struct nf_hook_ops nf_flow_offload_ip_ops __read_mostly = {
+	.hook		= nf_flow_offload_ip_hook,
+	.owner		= THIS_MODULE,
+	.pf		= NFPROTO_IPV4,
+	.hooknum	= NF_INET_PRE_ROUTING,
+	.priority	= NF_IP_PRI_CONNTRACK_DEFRAG - 1,
+};
+
+int __init nf_flow_table_ip_init(void)
+{
+	return nf_register_hook(&nf_flow_offload_ip_ops);
+}
+
+void nf_flow_table_ip_fini(void)
+{
+	nf_unregister_hook(&nf_flow_offload_ip_ops);
+}
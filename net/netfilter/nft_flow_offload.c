@@ -0,0 +1,184 @@
+/*
+ * "flow_offload" expression: moves established TCP and UDP flows to the
+ * flow table fast path, see nf_flow_table_core.c.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/ip.h>
+#include <linux/netlink.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <net/route.h>
+#include <net/netfilter/nf_tables.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+#include <net/netfilter/nf_flow_table.h>
+
+/* Route back to the originator of @dir, out of the device @pkt came in */
+static struct dst_entry *nft_flow_route_other(const struct nft_pktinfo *pkt,
+					      const struct nf_conn *ct,
+					      enum ip_conntrack_dir dir)
+{
+	struct flowi4 fl4 = {
+		.daddr		= ct->tuplehash[dir].tuple.src.u3.ip,
+		.flowi4_tos	= RT_TOS(ip_hdr(pkt->skb)->tos),
+	};
+	struct rtable *rt;
+
+	rt = ip_route_output_key(dev_net(pkt->in), &fl4);
+	if (IS_ERR(rt))
+		return NULL;
+
+	/* asymmetric routing, leave it to the slow path */
+	if (rt->dst.dev != pkt->in) {
+		ip_rt_put(rt);
+		return NULL;
+	}
+
+	return &rt->dst;
+}
+
+static bool nft_flow_offload_ok(const struct nf_conn *ct)
+{
+	switch (nf_ct_protonum(ct)) {
+	case IPPROTO_TCP:
+		if (ct->proto.tcp.state != TCP_CONNTRACK_ESTABLISHED)
+			return false;
+		break;
+	case IPPROTO_UDP:
+		break;
+	default:
+		return false;
+	}
+
+	/* helpers and sequence adjustment need to see every packet */
+	if (nfct_help(ct) || test_bit(IPS_SEQ_ADJUST_BIT, &ct->status))
+		return false;
+
+	return true;
+}
+
+/*
+ * conntrack does not see the window move while the flow is offloaded, let
+ * it pick the connection up again wherever it is.
+ */
+static void nft_flow_offload_fixup_tcp(struct nf_conn *ct)
+{
+	spin_lock_bh(&ct->lock);
+	ct->proto.tcp.seen[0].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
+	ct->proto.tcp.seen[1].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
+	spin_unlock_bh(&ct->lock);
+}
+
+static void nft_flow_offload_eval(const struct nft_expr *expr,
+				  struct nft_regs *regs,
+				  const struct nft_pktinfo *pkt)
+{
+	struct dst_entry *dst[FLOW_OFFLOAD_DIR_MAX];
+	enum ip_conntrack_info ctinfo;
+	enum ip_conntrack_dir dir;
+	struct dst_entry *other;
+	struct nf_conn *ct;
+	int err;
+
+	ct = nf_ct_get(pkt->skb, &ctinfo);
+	if (!ct || nf_ct_is_untracked(ct))
+		return;
+
+	if (ctinfo != IP_CT_ESTABLISHED && ctinfo != IP_CT_ESTABLISHED_REPLY)
+		return;
+
+	if (!nft_flow_offload_ok(ct))
+		return;
+
+	dir = CTINFO2DIR(ctinfo);
+	dst[dir] = skb_dst(pkt->skb);
+	if (!dst[dir] || dst[dir]->dev != pkt->out)
+		return;
+
+	if (test_and_set_bit(IPS_OFFLOAD_BIT, &ct->status))
+		return;
+
+	other = nft_flow_route_other(pkt, ct, dir);
+	if (!other)
+		goto err;
+	dst[!dir] = other;
+
+	if (nf_ct_protonum(ct) == IPPROTO_TCP)
+		nft_flow_offload_fixup_tcp(ct);
+
+	/* the flow takes its own references */
+	err = flow_offload_add(ct, dst);
+	dst_release(other);
+	if (err < 0)
+		goto err;
+	return;
+
+err:
+	clear_bit(IPS_OFFLOAD_BIT, &ct->status);
+}
+
+static int nft_flow_offload_validate(const struct nft_ctx *ctx,
+				     const struct nft_expr *expr,
+				     const struct nft_data **data)
+{
+	return nft_chain_validate_hooks(ctx->chain, 1 << NF_INET_FORWARD);
+}
+
+static int nft_flow_offload_init(const struct nft_ctx *ctx,
+				 const struct nft_expr *expr,
+				 const struct nlattr * const tb[])
+{
+	int err;
+
+	err = nft_flow_offload_validate(ctx, expr, NULL);
+	if (err < 0)
+		return err;
+
+	return nf_ct_l3proto_try_module_get(NFPROTO_IPV4);
+}
+
+static void nft_flow_offload_destroy(const struct nft_ctx *ctx,
+				     const struct nft_expr *expr)
+{
+	nf_ct_l3proto_module_put(NFPROTO_IPV4);
+}
+
+static struct nft_expr_type nft_flow_offload_type;
+static const struct nft_expr_ops nft_flow_offload_ops = {
+	.type		= &nft_flow_offload_type,
+	.size		= NFT_EXPR_SIZE(0),
+	.eval		= nft_flow_offload_eval,
+	.init		= nft_flow_offload_init,
+	.destroy	= nft_flow_offload_destroy,
+	.validate	= nft_flow_offload_validate,
+};
+
+static struct nft_expr_type nft_flow_offload_type __read_mostly = {
+	.family		= NFPROTO_IPV4,
+	.name		= "flow_offload",
+	.ops		= &nft_flow_offload_ops,
+	.owner		= THIS_MODULE,
+};
+
+static int __init nft_flow_offload_module_init(void)
+{
+	return nft_register_expr(&nft_flow_offload_type);
+}
+
+static void __exit nft_flow_offload_module_exit(void)
+{
+	nft_unregister_expr(&nft_flow_offload_type);
+}
+
+module_init(nft_flow_offload_module_init);
+module_exit(nft_flow_offload_module_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_ALIAS_NFT_AF_EXPR(AF_INET, "flow_offload");
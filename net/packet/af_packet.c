@@ -243,7 +243,10 @@ struct packet_skb_cb {
 static void __fanout_unlink(struct sock *sk, struct packet_sock *po);
 static void __fanout_link(struct sock *sk, struct packet_sock *po);
 
-static int packet_direct_xmit(struct sk_buff *skb)
+/* @more: another frame follows right away, the driver may hold back its
+ * doorbell until then
+ */
+static int __packet_direct_xmit(struct sk_buff *skb, bool more)
 {
 	struct net_device *dev = skb->dev;
 	netdev_features_t features;
@@ -265,7 +268,7 @@ static int packet_direct_xmit(struct sk_buff *skb)
 
 	HARD_TX_LOCK(dev, txq, smp_processor_id());
 	if (!netif_xmit_frozen_or_drv_stopped(txq))
-		ret = netdev_start_xmit(skb, dev, txq, false);
+		ret = netdev_start_xmit(skb, dev, txq, more);
 	HARD_TX_UNLOCK(dev, txq);
 
 	local_bh_enable();
@@ -280,6 +283,11 @@ drop:
 	return NET_XMIT_DROP;
 }
 
+static int packet_direct_xmit(struct sk_buff *skb)
+{
+	return __packet_direct_xmit(skb, false);
+}
+
 static struct net_device *packet_cached_dev_get(struct packet_sock *po)
 {
 	struct net_device *dev;
@@ -406,6 +414,9 @@ static void __packet_set_status(struct packet_sock *po, void *frame, int status)
 		flush_dcache_page(pgv_to_page(&h.h2->tp_status));
 		break;
 	case TPACKET_V3:
+		h.h3->tp_status = status;
+		flush_dcache_page(pgv_to_page(&h.h3->tp_status));
+		break;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -429,6 +440,8 @@ static int __packet_get_status(struct packet_sock *po, void *frame)
 		flush_dcache_page(pgv_to_page(&h.h2->tp_status));
 		return h.h2->tp_status;
 	case TPACKET_V3:
+		flush_dcache_page(pgv_to_page(&h.h3->tp_status));
+		return h.h3->tp_status;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -473,6 +486,9 @@ static __u32 __packet_set_timestamp(struct packet_sock *po, void *frame,
 		h.h2->tp_nsec = ts.tv_nsec;
 		break;
 	case TPACKET_V3:
+		h.h3->tp_sec = ts.tv_sec;
+		h.h3->tp_nsec = ts.tv_nsec;
+		break;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -2136,6 +2152,14 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 	skb_shinfo(skb)->destructor_arg = ph.raw;
 
 	switch (po->tp_version) {
+	case TPACKET_V3:
+		/* frames sit at fixed tp_frame_size strides */
+		if (ph.h3->tp_next_offset != 0) {
+			pr_warn_once("variable sized slot not supported");
+			return -EINVAL;
+		}
+		tp_len = ph.h3->tp_len;
+		break;
 	case TPACKET_V2:
 		tp_len = ph.h2->tp_len;
 		break;
@@ -2159,6 +2183,9 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 		off_max = po->tx_ring.frame_size - tp_len;
 		if (sock->type == SOCK_DGRAM) {
 			switch (po->tp_version) {
+			case TPACKET_V3:
+				off = ph.h3->tp_net;
+				break;
 			case TPACKET_V2:
 				off = ph.h2->tp_net;
 				break;
@@ -2168,6 +2195,9 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 			}
 		} else {
 			switch (po->tp_version) {
+			case TPACKET_V3:
+				off = ph.h3->tp_mac;
+				break;
 			case TPACKET_V2:
 				off = ph.h2->tp_mac;
 				break;
@@ -2235,20 +2265,57 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 	return tp_len;
 }
 
+/*
+ * Send a frame built by tpacket_snd(); it sits at the ring head. On error
+ * the frame is handed back to user space as a send request and the head
+ * stays on it.
+ */
+static int tpacket_xmit(struct packet_sock *po, struct sk_buff *skb,
+			void *ph, bool more)
+{
+	int err;
+
+	skb->destructor = tpacket_destruct_skb;
+	__packet_set_status(po, ph, TP_STATUS_SENDING);
+	packet_inc_pending(&po->tx_ring);
+
+	if (packet_use_direct_xmit(po))
+		err = __packet_direct_xmit(skb, more);
+	else
+		err = po->xmit(skb);
+	if (unlikely(err > 0)) {
+		err = net_xmit_errno(err);
+		if (err && __packet_get_status(po, ph) == TP_STATUS_AVAILABLE) {
+			/* skb was destructed already */
+			__packet_set_status(po, ph, TP_STATUS_SEND_REQUEST);
+			return err;
+		}
+		/*
+		 * skb was dropped but not destructed yet;
+		 * let's treat it like congestion or err < 0
+		 */
+	}
+
+	packet_increment_head(&po->tx_ring);
+	return 0;
+}
+
 static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 {
-	struct sk_buff *skb;
+	struct sk_buff *skb, *held = NULL;
 	struct net_device *dev;
 	__be16 proto;
 	int err, reserve = 0;
 	void *ph;
 	DECLARE_SOCKADDR(struct sockaddr_ll *, saddr, msg->msg_name);
 	bool need_wait = !(msg->msg_flags & MSG_DONTWAIT);
-	int tp_len, size_max;
+	int tp_len, size_max, held_len = 0;
 	unsigned char *addr;
 	int len_sum = 0;
 	int status = TP_STATUS_AVAILABLE;
 	int hlen, tlen;
+	unsigned int pos;
+	void *held_ph = NULL;
 
 	mutex_lock(&po->pg_vec_lock);
 
@@ -2283,10 +2350,26 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 	if (size_max > dev->mtu + reserve)
 		size_max = dev->mtu + reserve;
 
+	/*
+	 * With the qdisc bypassed, each frame is held back until the next one
+	 * is built, so that the driver is told with xmit_more whether it can
+	 * wait with the doorbell: a run of queued frames goes out as a batch.
+	 * The held frame is at the ring head, the one being built right after.
+	 */
 	do {
-		ph = packet_current_frame(po, &po->tx_ring,
-					  TP_STATUS_SEND_REQUEST);
+		pos = po->tx_ring.head;
+		if (held)
+			pos = pos != po->tx_ring.frame_max ? pos + 1 : 0;
+		ph = packet_lookup_frame(po, &po->tx_ring, pos,
+					 TP_STATUS_SEND_REQUEST);
 		if (unlikely(ph == NULL)) {
+			if (held) {
+				err = tpacket_xmit(po, held, held_ph, false);
+				held = NULL;
+				if (unlikely(err))
+					goto out_put;
+				len_sum += held_len;
+			}
 			if (need_wait && need_resched())
 				schedule();
 			continue;
@@ -2295,15 +2378,20 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 		status = TP_STATUS_SEND_REQUEST;
 		hlen = LL_RESERVED_SPACE(dev);
 		tlen = dev->needed_tailroom;
+		/* never sleep for memory with a frame held back */
 		skb = sock_alloc_send_skb(&po->sk,
 				hlen + tlen + sizeof(struct sockaddr_ll),
-				!need_wait, &err);
+				!need_wait || held, &err);
 
 		if (unlikely(skb == NULL)) {
-			/* we assume the socket was initially writeable ... */
-			if (likely(len_sum > 0))
-				err = len_sum;
-			goto out_status;
+			if (!held || !need_wait)
+				goto out_held;
+			err = tpacket_xmit(po, held, held_ph, false);
+			held = NULL;
+			if (unlikely(err))
+				goto out_put;
+			len_sum += held_len;
+			continue;
 		}
 		tp_len = tpacket_fill_skb(po, skb, ph, dev, size_max, proto,
 					  addr, hlen);
@@ -2320,6 +2408,16 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 			if (ehdr->h_proto != htons(ETH_P_8021Q))
 				tp_len = -EMSGSIZE;
 		}
+		if (unlikely(tp_len < 0) && held) {
+			/* flush first, the bad frame becomes the head */
+			err = tpacket_xmit(po, held, held_ph, false);
+			held = NULL;
+			if (unlikely(err)) {
+				kfree_skb(skb);
+				goto out_put;
+			}
+			len_sum += held_len;
+		}
 		if (unlikely(tp_len < 0)) {
 			if (po->tp_loss) {
 				__packet_set_status(po, ph,
@@ -2336,27 +2434,26 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 
 		packet_pick_tx_queue(dev, skb);
 
-		skb->destructor = tpacket_destruct_skb;
-		__packet_set_status(po, ph, TP_STATUS_SENDING);
-		packet_inc_pending(&po->tx_ring);
-
-		status = TP_STATUS_SEND_REQUEST;
-		err = po->xmit(skb);
-		if (unlikely(err > 0)) {
-			err = net_xmit_errno(err);
-			if (err && __packet_get_status(po, ph) ==
-				   TP_STATUS_AVAILABLE) {
-				/* skb was destructed already */
-				skb = NULL;
-				goto out_status;
+		if (held) {
+			err = tpacket_xmit(po, held, held_ph, true);
+			held = NULL;
+			if (unlikely(err)) {
+				kfree_skb(skb);
+				goto out_put;
 			}
-			/*
-			 * skb was dropped but not destructed yet;
-			 * let's treat it like congestion or err < 0
-			 */
-			err = 0;
+			len_sum += held_len;
 		}
-		packet_increment_head(&po->tx_ring);
+
+		if (packet_use_direct_xmit(po) && po->tx_ring.frame_max) {
+			held = skb;
+			held_ph = ph;
+			held_len = tp_len;
+			continue;
+		}
+
+		err = tpacket_xmit(po, skb, ph, false);
+		if (unlikely(err))
+			goto out_put;
 		len_sum += tp_len;
 	} while (likely((ph != NULL) ||
 		/* Note: packet_read_pending() might be slow if we have
@@ -2370,6 +2467,16 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 	err = len_sum;
 	goto out_put;
 
+out_held:
+	if (held) {
+		err = tpacket_xmit(po, held, held_ph, false);
+		if (unlikely(err))
+			goto out_put;
+		len_sum += held_len;
+	}
+	/* we assume the socket was initially writeable ... */
+	if (likely(len_sum > 0))
+		err = len_sum;
 out_status:
 	__packet_set_status(po, ph, status);
 	kfree_skb(skb);
@@ -3803,12 +3910,6 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 	/* Added to avoid minimal code churn */
 	struct tpacket_req *req = &req_u->req;
 
-	/* Opening a Tx-ring is NOT supported in TPACKET_V3 */
-	if (!closing && tx_ring && (po->tp_version > TPACKET_V2)) {
-		WARN(1, "Tx-ring is not supported.\n");
-		goto out;
-	}
-
 	rb = tx_ring ? &po->tx_ring : &po->rx_ring;
 	rb_queue = tx_ring ? &sk->sk_write_queue : &sk->sk_receive_queue;
 
@@ -3867,9 +3968,7 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 			goto out;
 		switch (po->tp_version) {
 		case TPACKET_V3:
-		/* Transmit path is not supported. We checked
-		 * it above but just being paranoid
-		 */
+			/* the tx ring has no block descriptors */
 			if (!tx_ring)
 				init_prb_bdqc(po, rb, pg_vec, req_u, tx_ring);
 			break;
@@ -0,0 +1,356 @@
+/*
+ * net/sched/sch_cbs.c	Credit Based Shaper (802.1Qav)
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ *
+ * A queue gains credit at idleslope while it waits and loses it at
+ * sendslope while it sends; it may only start a packet with non-negative
+ * credit. Credit is kept between locredit and hicredit, and a queue that
+ * runs empty does not hoard any.
+ *
+ * Meant as the child of mqprio or mq, one per tx queue. With "offload"
+ * the device shapes the queue itself through ndo_setup_cbs() and this
+ * qdisc is a plain fifo.
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/skbuff.h>
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/rtnetlink.h>
+#include <linux/ethtool.h>
+#include <linux/math64.h>
+#include <net/netlink.h>
+#include <net/pkt_sched.h>
+#include <net/sch_generic.h>
+
+#define BYTES_PER_KBIT (1000LL / 8)
+
+struct cbs_sched_data {
+	bool			offload;
+	int			queue;
+	s64			port_rate;	/* bytes/s, 0 if unknown */
+	s64			last;		/* ns */
+	s64			credits;	/* bytes */
+	s32			locredit;	/* bytes */
+	s32			hicredit;	/* bytes */
+	s64			sendslope;	/* bytes/s */
+	s64			idleslope;	/* bytes/s */
+	struct qdisc_watchdog	watchdog;
+	struct Qdisc		*sch;
+	struct list_head	cbs_list;
+};
+
+/* All cbs qdiscs, to follow link speed changes; protected by rtnl */
+static LIST_HEAD(cbs_list);
+
+static int cbs_enqueue(struct sk_buff *skb, struct Qdisc *sch)
+{
+	struct cbs_sched_data *q = qdisc_priv(sch);
+
+	if (unlikely(skb_queue_len(&sch->q) >= sch->limit))
+		return qdisc_drop(skb, sch);
+
+	/* an idle queue does not collect credit */
+	if (!q->offload && !sch->q.qlen && q->credits > 0) {
+		q->credits = 0;
+		q->last = ktime_get_ns();
+	}
+
+	return qdisc_enqueue_tail(skb, sch);
+}
+
+/* Time to wait for @credits, which are negative, to come back to zero */
+static s64 delay_from_credits(s64 credits, s64 slope)
+{
+	if (unlikely(!slope))
+		return S64_MAX;
+
+	return div64_s64(-credits * NSEC_PER_SEC, slope);
+}
+
+static s64 timediff_to_credits(s64 timediff, s64 slope)
+{
+	return div64_s64(timediff * slope, NSEC_PER_SEC);
+}
+
+static s64 credits_from_len(unsigned int len, s64 slope, s64 port_rate)
+{
+	if (unlikely(!port_rate))
+		return S64_MIN;
+
+	return div64_s64(len * slope, port_rate);
+}
+
+static struct sk_buff *cbs_dequeue_soft(struct Qdisc *sch)
+{
+	struct cbs_sched_data *q = qdisc_priv(sch);
+	s64 now = ktime_get_ns();
+	struct sk_buff *skb;
+	s64 credits;
+	int len;
+
+	if (q->credits < 0) {
+		credits = timediff_to_credits(now - q->last, q->idleslope);
+		q->credits = min_t(s64, q->credits + credits, q->hicredit);
+
+		if (q->credits < 0) {
+			qdisc_watchdog_schedule_ns(&q->watchdog, now +
+				delay_from_credits(q->credits, q->idleslope),
+				true);
+			q->last = now;
+			return NULL;
+		}
+	}
+
+	skb = qdisc_dequeue_head(sch);
+	if (!skb)
+		return NULL;
+
+	len = qdisc_pkt_len(skb);
+
+	/* sendslope is negative, this takes credit away */
+	credits = credits_from_len(len, q->sendslope, q->port_rate);
+	q->credits = max_t(s64, q->credits + credits, q->locredit);
+
+	/* when the last byte leaves */
+	if (unlikely(!q->port_rate))
+		q->last = now;
+	else
+		q->last = now + div64_s64((s64)len * NSEC_PER_SEC,
+					  q->port_rate);
+
+	return skb;
+}
+
+static struct sk_buff *cbs_dequeue(struct Qdisc *sch)
+{
+	struct cbs_sched_data *q = qdisc_priv(sch);
+
+	if (q->offload)
+		return qdisc_dequeue_head(sch);
+
+	return cbs_dequeue_soft(sch);
+}
+
+static void cbs_reset(struct Qdisc *sch)
+{
+	struct cbs_sched_data *q = qdisc_priv(sch);
+
+	qdisc_reset_queue(sch);
+	q->credits = 0;
+	q->last = ktime_get_ns();
+	qdisc_watchdog_cancel(&q->watchdog);
+}
+
+static const struct nla_policy cbs_policy[TCA_CBS_MAX + 1] = {
+	[TCA_CBS_PARMS]	= { .len = sizeof(struct tc_cbs_qopt) },
+};
+
+/* Called with rtnl held */
+static void cbs_set_port_rate(struct net_device *dev,
+			      struct cbs_sched_data *q)
+{
+	struct ethtool_cmd ecmd;
+	u32 speed = 0;
+
+	if (!__ethtool_get_settings(dev, &ecmd))
+		speed = ethtool_cmd_speed(&ecmd);
+	if (speed == SPEED_UNKNOWN)
+		speed = 0;
+
+	q->port_rate = speed * 1000 * BYTES_PER_KBIT;
+}
+
+static int cbs_dev_notifier(struct notifier_block *nb, unsigned long event,
+			    void *ptr)
+{
+	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+	struct cbs_sched_data *q;
+
+	if (event != NETDEV_UP && event != NETDEV_CHANGE)
+		return NOTIFY_DONE;
+
+	list_for_each_entry(q, &cbs_list, cbs_list) {
+		if (qdisc_dev(q->sch) == dev)
+			cbs_set_port_rate(dev, q);
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block cbs_device_notifier = {
+	.notifier_call	= cbs_dev_notifier,
+};
+
+static int cbs_offload(struct Qdisc *sch, const struct tc_cbs_qopt *qopt,
+		       bool enable)
+{
+	struct cbs_sched_data *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	struct tc_cbs_qopt_offload cbs = {
+		.enable		= enable,
+		.queue		= q->queue,
+	};
+
+	if (!dev->netdev_ops->ndo_setup_cbs)
+		return -EOPNOTSUPP;
+
+	if (enable) {
+		cbs.hicredit = qopt->hicredit;
+		cbs.locredit = qopt->locredit;
+		cbs.idleslope = qopt->idleslope;
+		cbs.sendslope = qopt->sendslope;
+	}
+
+	return dev->netdev_ops->ndo_setup_cbs(dev, &cbs);
+}
+
+static int cbs_change(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct cbs_sched_data *q = qdisc_priv(sch);
+	struct nlattr *tb[TCA_CBS_MAX + 1];
+	struct tc_cbs_qopt *qopt;
+	int err;
+
+	if (!opt)
+		return -EINVAL;
+
+	err = nla_parse_nested(tb, TCA_CBS_MAX, opt, cbs_policy);
+	if (err < 0)
+		return err;
+
+	if (!tb[TCA_CBS_PARMS])
+		return -EINVAL;
+
+	qopt = nla_data(tb[TCA_CBS_PARMS]);
+	if (qopt->idleslope <= 0 || qopt->sendslope >= 0 ||
+	    qopt->locredit > 0 || qopt->hicredit < 0)
+		return -EINVAL;
+
+	if (qopt->offload) {
+		err = cbs_offload(sch, qopt, true);
+		if (err < 0)
+			return err;
+	} else if (q->offload) {
+		cbs_offload(sch, NULL, false);
+	}
+
+	sch_tree_lock(sch);
+	q->offload = qopt->offload;
+	q->hicredit = qopt->hicredit;
+	q->locredit = qopt->locredit;
+	q->idleslope = qopt->idleslope * BYTES_PER_KBIT;
+	q->sendslope = qopt->sendslope * BYTES_PER_KBIT;
+	q->credits = min_t(s64, q->credits, q->hicredit);
+	sch_tree_unlock(sch);
+
+	return 0;
+}
+
+static int cbs_init(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct cbs_sched_data *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	int err;
+
+	q->sch = sch;
+	q->queue = sch->dev_queue - netdev_get_tx_queue(dev, 0);
+	sch->limit = max_t(u32, dev->tx_queue_len, 1);
+	q->last = ktime_get_ns();
+	qdisc_watchdog_init(&q->watchdog, sch);
+	cbs_set_port_rate(dev, q);
+
+	err = cbs_change(sch, opt);
+	if (err < 0)
+		return err;
+
+	ASSERT_RTNL();
+	list_add(&q->cbs_list, &cbs_list);
+
+	return 0;
+}
+
+static void cbs_destroy(struct Qdisc *sch)
+{
+	struct cbs_sched_data *q = qdisc_priv(sch);
+
+	ASSERT_RTNL();
+	list_del(&q->cbs_list);
+
+	qdisc_watchdog_cancel(&q->watchdog);
+	if (q->offload)
+		cbs_offload(sch, NULL, false);
+}
+
+static int cbs_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct cbs_sched_data *q = qdisc_priv(sch);
+	struct tc_cbs_qopt opt;
+	struct nlattr *nest;
+
+	memset(&opt, 0, sizeof(opt));
+	opt.offload = q->offload;
+	opt.hicredit = q->hicredit;
+	opt.locredit = q->locredit;
+	opt.idleslope = div64_s64(q->idleslope, BYTES_PER_KBIT);
+	opt.sendslope = div64_s64(q->sendslope, BYTES_PER_KBIT);
+
+	nest = nla_nest_start(skb, TCA_OPTIONS);
+	if (!nest)
+		goto nla_put_failure;
+
+	if (nla_put(skb, TCA_CBS_PARMS, sizeof(opt), &opt))
+		goto nla_put_failure;
+
+	return nla_nest_end(skb, nest);
+
+nla_put_failure:
+	nla_nest_cancel(skb, nest);
+	return -1;
+}
+
+static struct Qdisc_ops cbs_qdisc_ops __read_mostly = {
+	.id		=	"cbs",
+	.priv_size	=	sizeof(struct cbs_sched_data),
+	.enqueue	=	cbs_enqueue,
+	.dequeue	=	cbs_dequeue,
+	.peek		=	qdisc_peek_dequeued,
+	.init		=	cbs_init,
+	.reset		=	cbs_reset,
+	.destroy	=	cbs_destroy,
+	.change		=	cbs_change,
+	.dump		=	cbs_dump,
+	.owner		=	THIS_MODULE,
+};
+
+static int __init cbs_module_init(void)
+{
+	int err;
+
+	err = register_netdevice_notifier(&cbs_device_notifier);
+	if (err)
+		return err;
+
+	err = register_qdisc(&cbs_qdisc_ops);
+	if (err)
+		unregister_netdevice_notifier(&cbs_device_notifier);
+
+	return err;
+}
+
+static void __exit cbs_module_exit(void)
+{
+	unregister_qdisc(&cbs_qdisc_ops);
+	unregister_netdevice_notifier(&cbs_device_notifier);
+}
+
+module_init(cbs_module_init);
+module_exit(cbs_module_exit);
+MODULE_LICENSE("GPL");
@@ -0,0 +1,628 @@
+/*
+ * net/sched/sch_taprio.c	Time-aware priority scheduler (802.1Qbv)
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ *
+ * Traffic classes are set up as with mqprio, each one feeding its own
+ * range of tx queues. A cyclic list of gate control entries says which
+ * classes may send and for how long; the cycle starts at base-time, as
+ * seen by the chosen clock. A class whose gate is open only hands out a
+ * packet that is done on the wire before the gate closes again.
+ *
+ * Gates are switched in software from an hrtimer. To follow a PTP
+ * hardware clock the system clock has to be disciplined to it (phc2sys)
+ * and the schedule run on CLOCK_TAI.
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/seqlock.h>
+#include <linux/ethtool.h>
+#include <linux/math64.h>
+#include <net/netlink.h>
+#include <net/pkt_sched.h>
+#include <net/sch_generic.h>
+
+struct taprio_entry {
+	u32 gate_mask;
+	u32 interval;		/* ns */
+};
+
+struct taprio_sched {
+	struct Qdisc		*qdiscs[TC_MAX_QUEUE];
+	struct Qdisc		*sch;
+	u8			num_tc;
+
+	struct taprio_entry	*entries;
+	int			num_entries;
+	s64			base_time;
+	s64			cycle_time;
+	clockid_t		clockid;
+	ktime_t			(*get_time)(void);
+	u32			picos_per_byte;	/* 0 if the speed is unknown */
+
+	/* Gates open now and when they close, written by the timer */
+	seqlock_t		gate_lock;
+	u32			gate_mask;
+	s64			gate_close;
+
+	struct hrtimer		timer;
+	int			cur;
+	s64			next_switch;
+};
+
+static const struct nla_policy taprio_policy[TCA_TAPRIO_ATTR_MAX + 1] = {
+	[TCA_TAPRIO_ATTR_PRIOMAP]	= {
+		.len = sizeof(struct tc_mqprio_qopt)
+	},
+	[TCA_TAPRIO_ATTR_SCHED_ENTRY_LIST]	= { .type = NLA_NESTED },
+	[TCA_TAPRIO_ATTR_SCHED_BASE_TIME]	= { .type = NLA_S64 },
+	[TCA_TAPRIO_ATTR_SCHED_CLOCKID]		= { .type = NLA_S32 },
+};
+
+static const struct nla_policy entry_policy[TCA_TAPRIO_SCHED_ENTRY_MAX + 1] = {
+	[TCA_TAPRIO_SCHED_ENTRY_INDEX]		= { .type = NLA_U32 },
+	[TCA_TAPRIO_SCHED_ENTRY_CMD]		= { .type = NLA_U8 },
+	[TCA_TAPRIO_SCHED_ENTRY_GATE_MASK]	= { .type = NLA_U32 },
+	[TCA_TAPRIO_SCHED_ENTRY_INTERVAL]	= { .type = NLA_U32 },
+};
+
+/* Time @skb takes on the wire */
+static s64 taprio_tx_ns(const struct taprio_sched *q,
+			const struct sk_buff *skb)
+{
+	return div_u64((u64)qdisc_pkt_len(skb) * q->picos_per_byte, 1000);
+}
+
+/* The class whose head packet is next to go, if its gate allows */
+static struct Qdisc *taprio_select(struct Qdisc *sch)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct sk_buff *skb;
+	unsigned int seq;
+	s64 close, now;
+	u32 gates;
+	int tc;
+
+	do {
+		seq = read_seqbegin(&q->gate_lock);
+		gates = q->gate_mask;
+		close = q->gate_close;
+	} while (read_seqretry(&q->gate_lock, seq));
+
+	if (!gates)
+		return NULL;
+
+	now = q->picos_per_byte ? ktime_to_ns(q->get_time()) : 0;
+
+	/* higher classes first */
+	for (tc = q->num_tc - 1; tc >= 0; tc--) {
+		struct Qdisc *child = q->qdiscs[tc];
+
+		if (!(gates & BIT(tc)))
+			continue;
+
+		skb = child->ops->peek(child);
+		if (!skb)
+			continue;
+
+		/* guard band: never overrun the next gate event */
+		if (q->picos_per_byte && now + taprio_tx_ns(q, skb) > close)
+			continue;
+
+		return child;
+	}
+
+	return NULL;
+}
+
+static int taprio_enqueue(struct sk_buff *skb, struct Qdisc *sch)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct Qdisc *child;
+	int ret;
+
+	child = q->qdiscs[netdev_get_prio_tc_map(qdisc_dev(sch),
+						 skb->priority)];
+
+	ret = qdisc_enqueue(skb, child);
+	if (ret == NET_XMIT_SUCCESS) {
+		sch->q.qlen++;
+		return NET_XMIT_SUCCESS;
+	}
+
+	if (net_xmit_drop_count(ret))
+		qdisc_qstats_drop(sch);
+	return ret;
+}
+
+static struct sk_buff *taprio_peek(struct Qdisc *sch)
+{
+	struct Qdisc *child = taprio_select(sch);
+
+	return child ? child->ops->peek(child) : NULL;
+}
+
+static struct sk_buff *taprio_dequeue(struct Qdisc *sch)
+{
+	struct Qdisc *child = taprio_select(sch);
+	struct sk_buff *skb;
+
+	if (!child)
+		return NULL;
+
+	skb = qdisc_dequeue_peeked(child);
+	if (skb) {
+		qdisc_bstats_update(sch, skb);
+		sch->q.qlen--;
+	}
+	return skb;
+}
+
+static void taprio_reset(struct Qdisc *sch)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	int tc;
+
+	for (tc = 0; tc < q->num_tc; tc++)
+		qdisc_reset(q->qdiscs[tc]);
+	sch->q.qlen = 0;
+}
+
+/* Start of the first cycle that has not begun yet at @now */
+static s64 taprio_first_start(const struct taprio_sched *q, s64 now)
+{
+	s64 n;
+
+	if (q->base_time > now)
+		return q->base_time;
+
+	n = div64_s64(now - q->base_time, q->cycle_time);
+	return q->base_time + (n + 1) * q->cycle_time;
+}
+
+static enum hrtimer_restart taprio_advance(struct hrtimer *timer)
+{
+	struct taprio_sched *q = container_of(timer, struct taprio_sched,
+					      timer);
+	s64 start = q->next_switch, now = ktime_to_ns(q->get_time());
+	const struct taprio_entry *entry;
+
+	if (now - start >= q->cycle_time) {
+		/* the clock stepped or we slept: close and wait for a cycle */
+		q->cur = q->num_entries - 1;
+		write_seqlock(&q->gate_lock);
+		q->gate_mask = 0;
+		write_sequnlock(&q->gate_lock);
+		q->next_switch = taprio_first_start(q, now);
+	} else {
+		if (++q->cur == q->num_entries)
+			q->cur = 0;
+		entry = &q->entries[q->cur];
+
+		write_seqlock(&q->gate_lock);
+		q->gate_mask = entry->gate_mask;
+		q->gate_close = start + entry->interval;
+		write_sequnlock(&q->gate_lock);
+		q->next_switch = start + entry->interval;
+	}
+
+	hrtimer_set_expires(timer, ns_to_ktime(q->next_switch));
+
+	rcu_read_lock();
+	__netif_schedule(qdisc_root(q->sch));
+	rcu_read_unlock();
+
+	return HRTIMER_RESTART;
+}
+
+static int taprio_parse_mqprio_opt(struct net_device *dev,
+				   const struct tc_mqprio_qopt *qopt)
+{
+	int i, j;
+
+	if (!qopt->num_tc || qopt->num_tc > TC_MAX_QUEUE)
+		return -EINVAL;
+
+	/* the gates are ours, there is no offload yet */
+	if (qopt->hw)
+		return -EOPNOTSUPP;
+
+	for (i = 0; i < TC_BITMASK + 1; i++) {
+		if (qopt->prio_tc_map[i] >= qopt->num_tc)
+			return -EINVAL;
+	}
+
+	for (i = 0; i < qopt->num_tc; i++) {
+		unsigned int last = qopt->offset[i] + qopt->count[i];
+
+		if (qopt->offset[i] >= dev->real_num_tx_queues ||
+		    !qopt->count[i] ||
+		    last > dev->real_num_tx_queues)
+			return -EINVAL;
+
+		for (j = i + 1; j < qopt->num_tc; j++) {
+			if (last > qopt->offset[j])
+				return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int taprio_parse_entry(struct taprio_sched *q, struct nlattr *n,
+			      struct taprio_entry *entry)
+{
+	struct nlattr *tb[TCA_TAPRIO_SCHED_ENTRY_MAX + 1];
+	int err;
+
+	err = nla_parse_nested(tb, TCA_TAPRIO_SCHED_ENTRY_MAX, n,
+			       entry_policy);
+	if (err < 0)
+		return err;
+
+	if (tb[TCA_TAPRIO_SCHED_ENTRY_CMD] &&
+	    nla_get_u8(tb[TCA_TAPRIO_SCHED_ENTRY_CMD]) !=
+	    TC_TAPRIO_CMD_SET_GATES)
+		return -EOPNOTSUPP;
+
+	if (!tb[TCA_TAPRIO_SCHED_ENTRY_GATE_MASK] ||
+	    !tb[TCA_TAPRIO_SCHED_ENTRY_INTERVAL])
+		return -EINVAL;
+
+	entry->gate_mask = nla_get_u32(tb[TCA_TAPRIO_SCHED_ENTRY_GATE_MASK]);
+	entry->interval = nla_get_u32(tb[TCA_TAPRIO_SCHED_ENTRY_INTERVAL]);
+
+	if (entry->gate_mask & ~(BIT(q->num_tc) - 1) || !entry->interval)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int taprio_parse_entries(struct taprio_sched *q, struct nlattr *list)
+{
+	struct nlattr *n;
+	int rem, i = 0, err;
+
+	nla_for_each_nested(n, list, rem) {
+		if (nla_type(n) == TCA_TAPRIO_SCHED_ENTRY)
+			i++;
+	}
+	if (!i)
+		return -EINVAL;
+
+	q->entries = kcalloc(i, sizeof(*q->entries), GFP_KERNEL);
+	if (!q->entries)
+		return -ENOMEM;
+
+	q->cycle_time = 0;
+	nla_for_each_nested(n, list, rem) {
+		if (nla_type(n) != TCA_TAPRIO_SCHED_ENTRY)
+			continue;
+
+		err = taprio_parse_entry(q, n, &q->entries[q->num_entries]);
+		if (err < 0) {
+			kfree(q->entries);
+			return err;
+		}
+		q->cycle_time += q->entries[q->num_entries++].interval;
+	}
+
+	return 0;
+}
+
+static int taprio_set_clock(struct taprio_sched *q, clockid_t clockid)
+{
+	switch (clockid) {
+	case CLOCK_REALTIME:
+		q->get_time = ktime_get_real;
+		break;
+	case CLOCK_MONOTONIC:
+		q->get_time = ktime_get;
+		break;
+	case CLOCK_BOOTTIME:
+		q->get_time = ktime_get_boottime;
+		break;
+	case CLOCK_TAI:
+		q->get_time = ktime_get_clocktai;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	q->clockid = clockid;
+	return 0;
+}
+
+static u32 taprio_picos_per_byte(struct net_device *dev)
+{
+	struct ethtool_cmd ecmd;
+	u32 speed;
+
+	if (__ethtool_get_settings(dev, &ecmd))
+		return 0;
+
+	speed = ethtool_cmd_speed(&ecmd);
+	if (!speed || speed == SPEED_UNKNOWN)
+		return 0;
+
+	/* speed is in Mbit/s */
+	return 8 * USEC_PER_SEC / speed;
+}
+
+static int taprio_init(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	struct nlattr *tb[TCA_TAPRIO_ATTR_MAX + 1];
+	struct tc_mqprio_qopt *qopt;
+	clockid_t clockid = CLOCK_TAI;
+	int i, err;
+
+	if (sch->parent != TC_H_ROOT)
+		return -EOPNOTSUPP;
+
+	if (!netif_is_multiqueue(dev))
+		return -EOPNOTSUPP;
+
+	if (!opt)
+		return -EINVAL;
+
+	err = nla_parse_nested(tb, TCA_TAPRIO_ATTR_MAX, opt, taprio_policy);
+	if (err < 0)
+		return err;
+
+	if (!tb[TCA_TAPRIO_ATTR_PRIOMAP] ||
+	    !tb[TCA_TAPRIO_ATTR_SCHED_ENTRY_LIST])
+		return -EINVAL;
+
+	qopt = nla_data(tb[TCA_TAPRIO_ATTR_PRIOMAP]);
+	err = taprio_parse_mqprio_opt(dev, qopt);
+	if (err < 0)
+		return err;
+	q->num_tc = qopt->num_tc;
+
+	if (tb[TCA_TAPRIO_ATTR_SCHED_CLOCKID])
+		clockid = nla_get_s32(tb[TCA_TAPRIO_ATTR_SCHED_CLOCKID]);
+	err = taprio_set_clock(q, clockid);
+	if (err < 0)
+		return err;
+
+	if (tb[TCA_TAPRIO_ATTR_SCHED_BASE_TIME])
+		q->base_time = nla_get_s64(tb[TCA_TAPRIO_ATTR_SCHED_BASE_TIME]);
+
+	err = taprio_parse_entries(q, tb[TCA_TAPRIO_ATTR_SCHED_ENTRY_LIST]);
+	if (err < 0)
+		return err;
+
+	for (i = 0; i < q->num_tc; i++) {
+		q->qdiscs[i] = qdisc_create_dflt(sch->dev_queue,
+						 &pfifo_qdisc_ops,
+						 TC_H_MAKE(sch->handle, i + 1));
+		if (!q->qdiscs[i]) {
+			while (--i >= 0)
+				qdisc_destroy(q->qdiscs[i]);
+			kfree(q->entries);
+			return -ENOMEM;
+		}
+	}
+
+	netdev_set_num_tc(dev, q->num_tc);
+	for (i = 0; i < q->num_tc; i++)
+		netdev_set_tc_queue(dev, i, qopt->count[i], qopt->offset[i]);
+	for (i = 0; i < TC_BITMASK + 1; i++)
+		netdev_set_prio_tc_map(dev, i, qopt->prio_tc_map[i]);
+
+	q->picos_per_byte = taprio_picos_per_byte(dev);
+	q->sch = sch;
+
+	/* all gates stay closed until the first cycle starts */
+	seqlock_init(&q->gate_lock);
+	q->gate_mask = 0;
+	q->cur = q->num_entries - 1;
+	q->next_switch = taprio_first_start(q, ktime_to_ns(q->get_time()));
+
+	hrtimer_init(&q->timer, q->clockid, HRTIMER_MODE_ABS);
+	q->timer.function = taprio_advance;
+	hrtimer_start(&q->timer, ns_to_ktime(q->next_switch),
+		      HRTIMER_MODE_ABS);
+
+	return 0;
+}
+
+static void taprio_destroy(struct Qdisc *sch)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	int tc;
+
+	hrtimer_cancel(&q->timer);
+
+	for (tc = 0; tc < q->num_tc; tc++)
+		qdisc_destroy(q->qdiscs[tc]);
+
+	netdev_set_num_tc(qdisc_dev(sch), 0);
+	kfree(q->entries);
+}
+
+static int taprio_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	struct nlattr *nest, *list, *n;
+	struct tc_mqprio_qopt opt;
+	int i;
+
+	memset(&opt, 0, sizeof(opt));
+	opt.num_tc = q->num_tc;
+	memcpy(opt.prio_tc_map, dev->prio_tc_map, sizeof(opt.prio_tc_map));
+	for (i = 0; i < q->num_tc; i++) {
+		opt.count[i] = dev->tc_to_txq[i].count;
+		opt.offset[i] = dev->tc_to_txq[i].offset;
+	}
+
+	nest = nla_nest_start(skb, TCA_OPTIONS);
+	if (!nest)
+		goto nla_put_failure;
+
+	if (nla_put(skb, TCA_TAPRIO_ATTR_PRIOMAP, sizeof(opt), &opt) ||
+	    nla_put_s64(skb, TCA_TAPRIO_ATTR_SCHED_BASE_TIME, q->base_time) ||
+	    nla_put_s32(skb, TCA_TAPRIO_ATTR_SCHED_CLOCKID, q->clockid))
+		goto nla_put_failure;
+
+	list = nla_nest_start(skb, TCA_TAPRIO_ATTR_SCHED_ENTRY_LIST);
+	if (!list)
+		goto nla_put_failure;
+
+	for (i = 0; i < q->num_entries; i++) {
+		n = nla_nest_start(skb, TCA_TAPRIO_SCHED_ENTRY);
+		if (!n ||
+		    nla_put_u32(skb, TCA_TAPRIO_SCHED_ENTRY_INDEX, i) ||
+		    nla_put_u8(skb, TCA_TAPRIO_SCHED_ENTRY_CMD,
+			       TC_TAPRIO_CMD_SET_GATES) ||
+		    nla_put_u32(skb, TCA_TAPRIO_SCHED_ENTRY_GATE_MASK,
+				q->entries[i].gate_mask) ||
+		    nla_put_u32(skb, TCA_TAPRIO_SCHED_ENTRY_INTERVAL,
+				q->entries[i].interval))
+			goto nla_put_failure;
+		nla_nest_end(skb, n);
+	}
+	nla_nest_end(skb, list);
+
+	return nla_nest_end(skb, nest);
+
+nla_put_failure:
+	nla_nest_cancel(skb, nest);
+	return -1;
+}
+
+static int taprio_graft(struct Qdisc *sch, unsigned long arg,
+			struct Qdisc *new, struct Qdisc **old)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	unsigned long tc = arg - 1;
+
+	if (new == NULL)
+		new = &noop_qdisc;
+
+	sch_tree_lock(sch);
+	*old = q->qdiscs[tc];
+	q->qdiscs[tc] = new;
+	qdisc_tree_decrease_qlen(*old, (*old)->q.qlen);
+	qdisc_reset(*old);
+	sch_tree_unlock(sch);
+
+	return 0;
+}
+
+static struct Qdisc *taprio_leaf(struct Qdisc *sch, unsigned long arg)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+
+	return q->qdiscs[arg - 1];
+}
+
+static unsigned long taprio_get(struct Qdisc *sch, u32 classid)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	unsigned long tc = TC_H_MIN(classid);
+
+	if (tc - 1 >= q->num_tc)
+		return 0;
+	return tc;
+}
+
+static void taprio_put(struct Qdisc *sch, unsigned long cl)
+{
+}
+
+static int taprio_dump_class(struct Qdisc *sch, unsigned long cl,
+			     struct sk_buff *skb, struct tcmsg *tcm)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+
+	tcm->tcm_handle |= TC_H_MIN(cl);
+	tcm->tcm_info = q->qdiscs[cl - 1]->handle;
+	return 0;
+}
+
+static int taprio_dump_class_stats(struct Qdisc *sch, unsigned long cl,
+				   struct gnet_dump *d)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct Qdisc *cl_q = q->qdiscs[cl - 1];
+
+	if (gnet_stats_copy_basic(d, NULL, &cl_q->bstats) < 0 ||
+	    gnet_stats_copy_queue(d, NULL, &cl_q->qstats, cl_q->q.qlen) < 0)
+		return -1;
+
+	return 0;
+}
+
+static void taprio_walk(struct Qdisc *sch, struct qdisc_walker *arg)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	int tc;
+
+	if (arg->stop)
+		return;
+
+	for (tc = 0; tc < q->num_tc; tc++) {
+		if (arg->count < arg->skip) {
+			arg->count++;
+			continue;
+		}
+		if (arg->fn(sch, tc + 1, arg) < 0) {
+			arg->stop = 1;
+			break;
+		}
+		arg->count++;
+	}
+}
+
+static const struct Qdisc_class_ops taprio_class_ops = {
+	.graft		=	taprio_graft,
+	.leaf		=	taprio_leaf,
+	.get		=	taprio_get,
+	.put		=	taprio_put,
+	.walk		=	taprio_walk,
+	.dump		=	taprio_dump_class,
+	.dump_stats	=	taprio_dump_class_stats,
+};
+
+static struct Qdisc_ops taprio_qdisc_ops __read_mostly = {
+	.cl_ops		=	&taprio_class_ops,
+	.id		=	"taprio",
+	.priv_size	=	sizeof(struct taprio_sched),
+	.enqueue	=	taprio_enqueue,
+	.dequeue	=	taprio_dequeue,
+	.peek		=	taprio_peek,
+	.init		=	taprio_init,
+	.reset		=	taprio_reset,
+	.destroy	=	taprio_destroy,
+	.dump		=	taprio_dump,
+	.owner		=	THIS_MODULE,
+};
+
+static int __init taprio_module_init(void)
+{
+	return register_qdisc(&taprio_qdisc_ops);
+}
+
+static void __exit taprio_module_exit(void)
+{
+	unregister_qdisc(&taprio_qdisc_ops);
+}
+
+module_init(taprio_module_init);
+module_exit(taprio_module_exit);
+MODULE_LICENSE("GPL");
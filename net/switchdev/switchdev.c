@@ -64,6 +64,48 @@ int netdev_switch_port_stp_update(struct net_device *dev, u8 state)
 }
 EXPORT_SYMBOL_GPL(netdev_switch_port_stp_update);
 
+/**
+ *	netdev_switch_port_mdb_add - Add multicast group to switch port
+ *	@dev: port device
+ *	@addr: MAC address of the group
+ *	@vid: vlan the group was joined in
+ *
+ *	Notify switch device port that a bridge multicast group was joined
+ *	on it, so the switch may forward the group to the port itself.
+ *	Called in atomic context.
+ */
+int netdev_switch_port_mdb_add(struct net_device *dev,
+			       const unsigned char *addr, u16 vid)
+{
+	const struct swdev_ops *ops = dev->swdev_ops;
+
+	if (ops && ops->swdev_port_mdb_add)
+		return ops->swdev_port_mdb_add(dev, addr, vid);
+
+	return -EOPNOTSUPP;
+}
+EXPORT_SYMBOL_GPL(netdev_switch_port_mdb_add);
+
+/**
+ *	netdev_switch_port_mdb_del - Delete multicast group from switch port
+ *	@dev: port device
+ *	@addr: MAC address of the group
+ *	@vid: vlan the group was joined in
+ *
+ *	Undo netdev_switch_port_mdb_add().  Called in atomic context.
+ */
+int netdev_switch_port_mdb_del(struct net_device *dev,
+			       const unsigned char *addr, u16 vid)
+{
+	const struct swdev_ops *ops = dev->swdev_ops;
+
+	if (ops && ops->swdev_port_mdb_del)
+		return ops->swdev_port_mdb_del(dev, addr, vid);
+
+	return -EOPNOTSUPP;
+}
+EXPORT_SYMBOL_GPL(netdev_switch_port_mdb_del);
+
 static DEFINE_MUTEX(netdev_switch_mutex);
 static RAW_NOTIFIER_HEAD(netdev_switch_notif_chain);
 
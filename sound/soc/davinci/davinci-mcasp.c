@@ -43,6 +43,9 @@
 
 #define MCASP_MAX_AFIFO_DEPTH	64
 
+/* Worst case delay for the DMA to service an AFIFO event */
+#define MCASP_AFIFO_DMA_LATENCY_US	20
+
 static u32 context_regs[] = {
 	DAVINCI_MCASP_TXFMCTL_REG,
 	DAVINCI_MCASP_RXFMCTL_REG,
@@ -99,6 +102,9 @@ struct davinci_mcasp {
 	/* McASP FIFO related */
 	u8	txnumevt;
 	u8	rxnumevt;
+	u8	afifo_depth;
+	u8	afifo_thresh[2];	/* user override, 0: computed */
+	u8	afifo_numevt[2];	/* currently programmed */
 
 	bool	dat_port;
 
@@ -747,8 +753,31 @@ static int davinci_config_channel_size(struct davinci_mcasp *mcasp,
 	return 0;
 }
 
+/*
+ * Pick the AFIFO event threshold for a stream: as large as possible to keep
+ * the DMA event rate down, while leaving enough words in the FIFO to ride
+ * out the DMA service latency at the stream's word rate.
+ */
+static int mcasp_afifo_numevt(struct davinci_mcasp *mcasp, int stream,
+			      int period_words, int channels, int rate,
+			      int active_serializers)
+{
+	int headroom, numevt;
+
+	if (mcasp->afifo_thresh[stream])
+		return min_t(int, mcasp->afifo_thresh[stream], period_words);
+
+	headroom = DIV_ROUND_UP_ULL((u64)rate * channels *
+				    MCASP_AFIFO_DMA_LATENCY_US, USEC_PER_SEC);
+	numevt = mcasp->afifo_depth - headroom;
+	if (numevt < active_serializers)
+		numevt = active_serializers;
+
+	return min(numevt, period_words);
+}
+
 static int mcasp_common_hw_param(struct davinci_mcasp *mcasp, int stream,
-				 int period_words, int channels)
+				 int period_words, int channels, int rate)
 {
 	struct snd_dmaengine_dai_dma_data *dma_data = &mcasp->dma_data[stream];
 	int i;
@@ -833,6 +862,9 @@ static int mcasp_common_hw_param(struct davinci_mcasp *mcasp, int stream,
 		return -EINVAL;
 	}
 
+	numevt = mcasp_afifo_numevt(mcasp, stream, period_words, channels,
+				    rate, active_serializers);
+
 	/*
 	 * Calculate the optimal AFIFO depth for platform side:
 	 * The number of words for numevt need to be in steps of active
@@ -840,13 +872,14 @@ static int mcasp_common_hw_param(struct davinci_mcasp *mcasp, int stream,
 	 */
 	numevt = (numevt / active_serializers) * active_serializers;
 
-	while (period_words % numevt && numevt > 0)
+	while (numevt > 0 && period_words % numevt)
 		numevt -= active_serializers;
 	if (numevt <= 0)
 		numevt = active_serializers;
 
 	mcasp_mod_bits(mcasp, reg, active_serializers, NUMDMA_MASK);
 	mcasp_mod_bits(mcasp, reg, NUMEVT(numevt), NUMEVT_MASK);
+	mcasp->afifo_numevt[stream] = numevt;
 
 	/* Configure the burst size for platform drivers */
 	if (numevt == 1)
@@ -1045,7 +1078,8 @@ static int davinci_mcasp_hw_params(struct snd_pcm_substream *substream,
 	}
 
 	ret = mcasp_common_hw_param(mcasp, substream->stream,
-				    period_size * channels, channels);
+				    period_size * channels, channels,
+				    params_rate(params));
 	if (ret)
 		return ret;
 
@@ -1321,13 +1355,105 @@ static const struct snd_soc_dai_ops davinci_mcasp_dai_ops = {
 	.set_tdm_slot	= davinci_mcasp_set_tdm_slot,
 };
 
+static int davinci_mcasp_afifo_thresh_get(struct snd_kcontrol *kcontrol,
+					  struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_dai *dai = snd_kcontrol_chip(kcontrol);
+	struct davinci_mcasp *mcasp = snd_soc_dai_get_drvdata(dai);
+	struct soc_mixer_control *mc =
+		(struct soc_mixer_control *)kcontrol->private_value;
+
+	ucontrol->value.integer.value[0] = mcasp->afifo_thresh[mc->reg];
+
+	return 0;
+}
+
+static int davinci_mcasp_afifo_thresh_put(struct snd_kcontrol *kcontrol,
+					  struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_dai *dai = snd_kcontrol_chip(kcontrol);
+	struct davinci_mcasp *mcasp = snd_soc_dai_get_drvdata(dai);
+	struct soc_mixer_control *mc =
+		(struct soc_mixer_control *)kcontrol->private_value;
+	long val = ucontrol->value.integer.value[0];
+
+	if (val < 0 || val > mcasp->afifo_depth)
+		return -EINVAL;
+
+	if (mcasp->afifo_thresh[mc->reg] == val)
+		return 0;
+
+	/* takes effect on the next hw_params */
+	mcasp->afifo_thresh[mc->reg] = val;
+
+	return 1;
+}
+
+static int davinci_mcasp_afifo_numevt_get(struct snd_kcontrol *kcontrol,
+					  struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_dai *dai = snd_kcontrol_chip(kcontrol);
+	struct davinci_mcasp *mcasp = snd_soc_dai_get_drvdata(dai);
+	struct soc_mixer_control *mc =
+		(struct soc_mixer_control *)kcontrol->private_value;
+
+	ucontrol->value.integer.value[0] = mcasp->afifo_numevt[mc->reg];
+
+	return 0;
+}
+
+#define MCASP_AFIFO_CONTROLS(xname, stream)				\
+	SOC_SINGLE_EXT(xname " AFIFO Threshold", stream, 0,		\
+		       MCASP_MAX_AFIFO_DEPTH, 0,			\
+		       davinci_mcasp_afifo_thresh_get,			\
+		       davinci_mcasp_afifo_thresh_put),			\
+	{								\
+		.iface = SNDRV_CTL_ELEM_IFACE_MIXER,			\
+		.name = xname " AFIFO Events",				\
+		.access = SNDRV_CTL_ELEM_ACCESS_READ |			\
+			  SNDRV_CTL_ELEM_ACCESS_VOLATILE,		\
+		.info = snd_soc_info_volsw,				\
+		.get = davinci_mcasp_afifo_numevt_get,			\
+		.private_value = SOC_SINGLE_VALUE(stream, 0,		\
+					MCASP_MAX_AFIFO_DEPTH, 0, 0),	\
+	}
+
+/*
+ * "AFIFO Threshold" overrides the computed event threshold when non-zero,
+ * "AFIFO Events" reports the value programmed by the last hw_params.
+ */
+static const struct snd_kcontrol_new davinci_mcasp_tx_afifo_controls[] = {
+	MCASP_AFIFO_CONTROLS("Playback", SNDRV_PCM_STREAM_PLAYBACK),
+};
+
+static const struct snd_kcontrol_new davinci_mcasp_rx_afifo_controls[] = {
+	MCASP_AFIFO_CONTROLS("Capture", SNDRV_PCM_STREAM_CAPTURE),
+};
+
 static int davinci_mcasp_dai_probe(struct snd_soc_dai *dai)
 {
 	struct davinci_mcasp *mcasp = snd_soc_dai_get_drvdata(dai);
+	int ret;
 
 	dai->playback_dma_data = &mcasp->dma_data[SNDRV_PCM_STREAM_PLAYBACK];
 	dai->capture_dma_data = &mcasp->dma_data[SNDRV_PCM_STREAM_CAPTURE];
 
+	if (mcasp->txnumevt) {
+		ret = snd_soc_add_dai_controls(dai,
+				davinci_mcasp_tx_afifo_controls,
+				ARRAY_SIZE(davinci_mcasp_tx_afifo_controls));
+		if (ret)
+			return ret;
+	}
+
+	if (mcasp->rxnumevt) {
+		ret = snd_soc_add_dai_controls(dai,
+				davinci_mcasp_rx_afifo_controls,
+				ARRAY_SIZE(davinci_mcasp_rx_afifo_controls));
+		if (ret)
+			return ret;
+	}
+
 	return 0;
 }
 
@@ -1870,6 +1996,7 @@ static int davinci_mcasp_probe(struct platform_device *pdev)
 	mcasp->version = pdata->version;
 	mcasp->txnumevt = pdata->txnumevt;
 	mcasp->rxnumevt = pdata->rxnumevt;
+	mcasp->afifo_depth = MCASP_MAX_AFIFO_DEPTH;
 
 	mcasp->dev = &pdev->dev;
 
@@ -2020,6 +2147,7 @@ static int davinci_mcasp_probe(struct platform_device *pdev)
 				mcasp->txnumevt = 32;
 			if (mcasp->rxnumevt)
 				mcasp->rxnumevt = 32;
+			mcasp->afifo_depth = 32;
 
 			if (mcasp->txnumevt || mcasp->rxnumevt)
 				dev_info(&pdev->dev,
@@ -18,6 +18,7 @@
  */
 
 #include <linux/module.h>
+#include <linux/of.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
@@ -40,6 +41,23 @@ static const struct snd_pcm_hardware edma_pcm_hardware = {
 	.periods_max		= 19, /* Limit by edma dmaengine driver */
 };
 
+/*
+ * Buffers in on-chip SRAM are not exposed to DDR contention, so much shorter
+ * periods can be sustained: down to 32 frames of a 16-bit mono stream.
+ */
+static const struct snd_pcm_hardware edma_pcm_hardware_sram = {
+	.info			= SNDRV_PCM_INFO_MMAP |
+				  SNDRV_PCM_INFO_MMAP_VALID |
+				  SNDRV_PCM_INFO_PAUSE | SNDRV_PCM_INFO_RESUME |
+				  SNDRV_PCM_INFO_NO_PERIOD_WAKEUP |
+				  SNDRV_PCM_INFO_INTERLEAVED,
+	.buffer_bytes_max	= 16 * 1024,
+	.period_bytes_min	= 32 * 2,
+	.period_bytes_max	= 8 * 1024,
+	.periods_min		= 2,
+	.periods_max		= 19, /* Limit by edma dmaengine driver */
+};
+
 static const struct snd_dmaengine_pcm_config edma_dmaengine_pcm_config = {
 	.pcm_hardware = &edma_pcm_hardware,
 	.prepare_slave_config = snd_dmaengine_pcm_prepare_slave_config,
@@ -47,8 +65,22 @@ static const struct snd_dmaengine_pcm_config edma_dmaengine_pcm_config = {
 	.prealloc_buffer_size = 128 * 1024,
 };
 
+static const struct snd_dmaengine_pcm_config edma_dmaengine_pcm_config_sram = {
+	.pcm_hardware = &edma_pcm_hardware_sram,
+	.prepare_slave_config = snd_dmaengine_pcm_prepare_slave_config,
+	.compat_filter_fn = edma_filter_fn,
+	.prealloc_buffer_size = 16 * 1024,
+};
+
 int edma_pcm_platform_register(struct device *dev)
 {
+	/* Low latency mode: buffers from the SRAM pool given by "iram" */
+	if (dev->of_node && of_find_property(dev->of_node, "iram", NULL))
+		return devm_snd_dmaengine_pcm_register(dev,
+					&edma_dmaengine_pcm_config_sram,
+					SND_DMAENGINE_PCM_FLAG_COMPAT |
+					SND_DMAENGINE_PCM_FLAG_IRAM);
+
 	return devm_snd_dmaengine_pcm_register(dev, &edma_dmaengine_pcm_config,
 					SND_DMAENGINE_PCM_FLAG_COMPAT);
 }
@@ -283,7 +283,8 @@ static int dmaengine_pcm_new(struct snd_soc_pcm_runtime *rtd)
 
 		ret = snd_pcm_lib_preallocate_pages(substream,
 				SNDRV_DMA_TYPE_DEV_IRAM,
-				dmaengine_dma_dev(pcm, substream),
+				(pcm->flags & SND_DMAENGINE_PCM_FLAG_IRAM) ?
+				dev : dmaengine_dma_dev(pcm, substream),
 				prealloc_buffer_size,
 				max_buffer_size);
 		if (ret)
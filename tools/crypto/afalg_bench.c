@@ -0,0 +1,258 @@
+/*
+ * afalg_bench: compare AF_ALG throughput when feeding the kernel with
+ * sendmsg() against vmsplice()+splice()
+ *
+ * With sendmsg() algif_skcipher copies the input into its own pages,
+ * while spliced pages are handed to the cipher as they are, which is
+ * what matters in front of a DMA engine such as omap-aes.  algif_hash
+ * maps the user pages in both cases, but only batches them for splice
+ * when they arrive one page per sendpage() call.
+ *
+ * Examples:
+ *
+ *	afalg_bench -t skcipher -a 'cbc(aes)' -k 16 -s 65536
+ *	afalg_bench -t hash -a sha256 -s 1048576 -m splice
+ *
+ * Compile with:
+ *
+ * gcc -O2 -o afalg_bench afalg_bench.c -lrt
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/if_alg.h>
+
+#ifndef AF_ALG
+#define AF_ALG		38
+#endif
+#ifndef SOL_ALG
+#define SOL_ALG		279
+#endif
+
+/* one pipe's worth, which is also what algif accepts in one go */
+#define CHUNK		65536
+
+static const char *type = "skcipher";
+static const char *alg = "cbc(aes)";
+static int keylen = -1;
+static unsigned int ivlen = 16;
+static size_t size = 65536;
+static unsigned int seconds = 3;
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static int alg_open(void)
+{
+	struct sockaddr_alg sa = { .salg_family = AF_ALG };
+	unsigned char key[64] = { 0 };
+	int tfm, op;
+
+	strncpy((char *)sa.salg_type, type, sizeof(sa.salg_type) - 1);
+	strncpy((char *)sa.salg_name, alg, sizeof(sa.salg_name) - 1);
+
+	tfm = socket(AF_ALG, SOCK_SEQPACKET, 0);
+	if (tfm < 0)
+		die("socket");
+	if (bind(tfm, (struct sockaddr *)&sa, sizeof(sa)))
+		die("bind");
+	if (keylen > 0 && setsockopt(tfm, SOL_ALG, ALG_SET_KEY, key, keylen))
+		die("setkey");
+
+	op = accept(tfm, NULL, 0);
+	if (op < 0)
+		die("accept");
+	close(tfm);
+
+	return op;
+}
+
+/* set the operation and IV, with data or as an empty message */
+static void skcipher_send(int op, void *buf, size_t len, int flags)
+{
+	char cbuf[CMSG_SPACE(sizeof(__u32)) +
+		  CMSG_SPACE(sizeof(struct af_alg_iv) + 64)] = { 0 };
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+	struct msghdr msg = {
+		.msg_control = cbuf,
+		.msg_controllen = sizeof(cbuf),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	struct af_alg_iv *iv;
+	struct cmsghdr *cmsg;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_OP;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(__u32));
+	*(__u32 *)CMSG_DATA(cmsg) = ALG_OP_ENCRYPT;
+
+	cmsg = CMSG_NXTHDR(&msg, cmsg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_IV;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(*iv) + ivlen);
+	iv = (struct af_alg_iv *)CMSG_DATA(cmsg);
+	iv->ivlen = ivlen;
+
+	msg.msg_controllen = CMSG_SPACE(sizeof(__u32)) +
+			     CMSG_SPACE(sizeof(*iv) + ivlen);
+
+	if (sendmsg(op, &msg, flags) != (ssize_t)len)
+		die("sendmsg");
+}
+
+static void do_splice(int op, int *pfd, void *buf, size_t len,
+		      unsigned int flags)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+
+	if (vmsplice(pfd[1], &iov, 1, 0) != (ssize_t)len)
+		die("vmsplice");
+	if (splice(pfd[0], NULL, op, NULL, len, flags) != (ssize_t)len)
+		die("splice");
+}
+
+/* push size bytes through the transform once */
+static void run_once(int op, int *pfd, unsigned char *in,
+		     unsigned char *out, int use_splice)
+{
+	size_t done, len;
+	int skcipher = !strcmp(type, "skcipher");
+
+	for (done = 0; done < size; done += len) {
+		len = size - done < CHUNK ? size - done : CHUNK;
+
+		if (skcipher) {
+			if (use_splice) {
+				skcipher_send(op, NULL, 0, MSG_MORE);
+				do_splice(op, pfd, in + done, len, 0);
+			} else {
+				skcipher_send(op, in + done, len, 0);
+			}
+			if (read(op, out + done, len) != (ssize_t)len)
+				die("read");
+			continue;
+		}
+
+		if (use_splice)
+			do_splice(op, pfd, in + done, len, SPLICE_F_MORE);
+		else if (send(op, in + done, len, MSG_MORE) != (ssize_t)len)
+			die("send");
+	}
+
+	if (!skcipher && read(op, out, 64) <= 0)
+		die("read digest");
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(int use_splice)
+{
+	unsigned char *in, *out;
+	unsigned long iter = 0;
+	double start, t;
+	int pfd[2];
+	int op;
+
+	if (posix_memalign((void **)&in, 4096, size) ||
+	    posix_memalign((void **)&out, 4096, size))
+		die("posix_memalign");
+	memset(in, 0x5a, size);
+
+	if (pipe(pfd))
+		die("pipe");
+	op = alg_open();
+
+	start = now();
+	do {
+		run_once(op, pfd, in, out, use_splice);
+		iter++;
+		t = now() - start;
+	} while (t < seconds);
+
+	printf("%-8s %-16s %-6s %8zu bytes: %10.2f MB/s\n", type, alg,
+	       use_splice ? "splice" : "copy", size,
+	       (double)iter * size / t / 1e6);
+
+	close(op);
+	close(pfd[0]);
+	close(pfd[1]);
+	free(in);
+	free(out);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-t skcipher|hash] [-a alg] [-k keylen] [-i ivlen]\n"
+		"          [-s size] [-d seconds] [-m copy|splice|both]\n",
+		prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *mode = "both";
+	int c;
+
+	while ((c = getopt(argc, argv, "t:a:k:i:s:d:m:h")) != -1) {
+		switch (c) {
+		case 't':
+			type = optarg;
+			break;
+		case 'a':
+			alg = optarg;
+			break;
+		case 'k':
+			keylen = atoi(optarg);
+			break;
+		case 'i':
+			ivlen = atoi(optarg);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			seconds = atoi(optarg);
+			break;
+		case 'm':
+			mode = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (strcmp(type, "skcipher") && strcmp(type, "hash"))
+		usage(argv[0]);
+	/* no key for plain hashes, AES-128 for ciphers */
+	if (keylen < 0)
+		keylen = strcmp(type, "hash") ? 16 : 0;
+	if (!size || keylen > 64 || ivlen > 64)
+		usage(argv[0]);
+
+	if (strcmp(mode, "splice"))
+		bench(0);
+	if (strcmp(mode, "copy"))
+		bench(1);
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Reference echo firmware for pru_echo_bench.
+ *
+ * Built with the TI PRU code generation tools and the PRU software
+ * support package, see the Makefile.  The default build echoes every
+ * rpmsg message back to its sender, for loading through remoteproc.
+ * With -DPRU_ECHO_SHM it echoes through the uio_pruss shared memory
+ * mailbox of pru_echo.h instead, for loading through uio_pruss.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <stdint.h>
+#include <pru_cfg.h>
+#include "../pru_echo.h"
+
+#ifdef PRU_ECHO_SHM
+
+void main(void)
+{
+	volatile struct pru_echo_boot *boot =
+		(volatile struct pru_echo_boot *)PRU_ECHO_BOOT_OFFSET;
+	volatile struct pru_echo_mbox *mbox;
+	uint32_t seq, len, i;
+
+	/* the OCP master port reaches the external ram */
+	CT_CFG.SYSCFG_bit.STANDBY_INIT = 0;
+
+	while (boot->magic != PRU_ECHO_MAGIC)
+		;
+	mbox = (volatile struct pru_echo_mbox *)boot->mbox_addr;
+	seq = mbox->rsp_seq;
+
+	for (;;) {
+		if (mbox->req_seq == seq)
+			continue;
+		seq = mbox->req_seq;
+		len = mbox->len;
+		if (len > PRU_ECHO_MAX_LEN)
+			len = PRU_ECHO_MAX_LEN;
+		for (i = 0; i < len; i++)
+			mbox->rsp[i] = mbox->req[i];
+		mbox->rsp_seq = seq;
+	}
+}
+
+#else
+
+#include <pru_intc.h>
+#include <rsc_types.h>
+#include <pru_rpmsg.h>
+#include "resource_table_0.h"
+
+volatile register uint32_t __R31;
+
+/* host interrupt 0 on R31 bit 30, system events of the PRU0 lab setup */
+#define HOST_INT		((uint32_t)1 << 30)
+#define TO_ARM_HOST		16
+#define FROM_ARM_HOST		17
+
+#define VIRTIO_CONFIG_S_DRIVER_OK	4
+
+static uint8_t payload[RPMSG_BUF_SIZE];
+
+void main(void)
+{
+	struct pru_rpmsg_transport transport;
+	volatile uint8_t *status;
+	uint16_t src, dst, len;
+
+	CT_CFG.SYSCFG_bit.STANDBY_INIT = 0;
+	CT_INTC.SICR_bit.STS_CLR_IDX = FROM_ARM_HOST;
+
+	/* wait for virtio_rpmsg_bus to set up the vrings */
+	status = &resourceTable.rpmsg_vdev.status;
+	while (!(*status & VIRTIO_CONFIG_S_DRIVER_OK))
+		;
+
+	pru_rpmsg_init(&transport, &resourceTable.rpmsg_vring0,
+		       &resourceTable.rpmsg_vring1, TO_ARM_HOST, FROM_ARM_HOST);
+	while (pru_rpmsg_channel(RPMSG_NS_CREATE, &transport,
+				 PRU_ECHO_CHAN_NAME, "echo",
+				 PRU_ECHO_CHAN_PORT) != PRU_RPMSG_SUCCESS)
+		;
+
+	for (;;) {
+		if (!(__R31 & HOST_INT))
+			continue;
+		CT_INTC.SICR_bit.STS_CLR_IDX = FROM_ARM_HOST;
+		while (pru_rpmsg_receive(&transport, &src, &dst, payload,
+					 &len) == PRU_RPMSG_SUCCESS)
+			pru_rpmsg_send(&transport, dst, src, payload, len);
+	}
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * Shared between pru_echo_bench and the echo firmware.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _PRU_ECHO_H
+#define _PRU_ECHO_H
+
+#include <stdint.h>
+
+/* rpmsg channel announced by the firmware, /dev/rpmsg_pru30 on the host */
+#define PRU_ECHO_CHAN_NAME	"rpmsg-pru"
+#define PRU_ECHO_CHAN_PORT	30
+
+/* Largest payload: a 512 byte rpmsg buffer less its 16 byte header */
+#define PRU_ECHO_MAX_LEN	496
+
+/*
+ * Shared memory mode: the host puts a struct pru_echo_boot at this offset
+ * of the PRU shared RAM, the same in the PRUSS map of uio_pruss and in
+ * the local address space of the PRU, and the mailbox in the external
+ * ram pool of uio_pruss.  The host writes the magic last.
+ */
+#define PRU_ECHO_BOOT_OFFSET	0x10000
+#define PRU_ECHO_MAGIC		0x70726563	/* "prec" */
+
+struct pru_echo_boot {
+	uint32_t magic;
+	uint32_t mbox_addr;	/* physical address of the mailbox */
+};
+
+/*
+ * The host fills req and len, then bumps req_seq; the firmware copies req
+ * to rsp and sets rsp_seq to req_seq.
+ */
+struct pru_echo_mbox {
+	uint32_t req_seq;
+	uint32_t rsp_seq;
+	uint32_t len;
+	uint32_t reserved;
+	uint8_t req[PRU_ECHO_MAX_LEN];
+	uint8_t rsp[PRU_ECHO_MAX_LEN];
+};
+
+#endif /* _PRU_ECHO_H */
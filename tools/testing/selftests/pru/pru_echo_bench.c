@@ -0,0 +1,423 @@
+/*
+ * ARM <-> PRU round trip benchmark
+ *
+ * Bounces messages off the echo firmware in firmware/, through rpmsg
+ * (virtio_rpmsg_bus and rpmsg_pru, /dev/rpmsg_pruN) or through the
+ * external ram pool of uio_pruss, and reports the round trip latency
+ * distribution and the throughput for each message size.  One line per
+ * path and size, in the same format from release to release:
+ *
+ *   path=rpmsg size=64 samples=10000 min_ns=... p50_ns=... p90_ns=...
+ *   p99_ns=... p999_ns=... max_ns=... msgs_per_s=... kB_per_s=...
+ *
+ * Latency is measured with one message in flight.  Throughput is measured
+ * with up to "window" messages in flight over rpmsg, and with the single
+ * message of the mailbox over shared memory.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+#include <linux/uio_pruss.h>
+
+#include "pru_echo.h"
+
+#define DEFAULT_RPMSG_DEV	"/dev/rpmsg_pru30"
+#define DDR_DEV			"/dev/pruss_ddr"
+#define DEFAULT_SIZES		"4,16,64,256,496"
+#define MAX_SIZES		16
+#define SHM_TIMEOUT_NS		1000000000ULL
+
+static unsigned int samples = 10000;
+static unsigned int window = 16;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *path, unsigned int size,
+		   unsigned long long *lat, unsigned long long elapsed_ns)
+{
+	double rate = elapsed_ns ? samples * 1e9 / elapsed_ns : 0;
+	unsigned int n = samples;
+
+	qsort(lat, n, sizeof(*lat), cmp_ull);
+	printf("path=%s size=%u samples=%u min_ns=%llu p50_ns=%llu "
+	       "p90_ns=%llu p99_ns=%llu p999_ns=%llu max_ns=%llu "
+	       "msgs_per_s=%.0f kB_per_s=%.1f\n",
+	       path, size, n, lat[0], lat[n / 2], lat[n * 90ULL / 100],
+	       lat[n * 99ULL / 100], lat[n * 999ULL / 1000], lat[n - 1],
+	       rate, rate * size / 1000);
+	fflush(stdout);
+}
+
+static void fill(unsigned char *buf, unsigned int size, uint32_t seq)
+{
+	unsigned int i;
+
+	memcpy(buf, &seq, sizeof(seq));
+	for (i = sizeof(seq); i < size; i++)
+		buf[i] = seq + i;
+}
+
+static int check(const unsigned char *buf, ssize_t len, unsigned int size,
+		 uint32_t seq)
+{
+	unsigned char want[PRU_ECHO_MAX_LEN];
+
+	if (len != size) {
+		fprintf(stderr, "echo %u: got %zd bytes, sent %u\n",
+			seq, len, size);
+		return -1;
+	}
+	fill(want, size, seq);
+	if (memcmp(buf, want, size)) {
+		fprintf(stderr, "echo %u: payload differs\n", seq);
+		return -1;
+	}
+	return 0;
+}
+
+static int rpmsg_send(int fd, unsigned int size, uint32_t seq)
+{
+	unsigned char tx[PRU_ECHO_MAX_LEN];
+
+	fill(tx, size, seq);
+	if (write(fd, tx, size) != size) {
+		perror("rpmsg write");
+		return -1;
+	}
+	return 0;
+}
+
+/* rpmsg_pru takes one message per write() and hands one out per read() */
+static int rpmsg_recv(int fd, unsigned int size, uint32_t seq)
+{
+	unsigned char rx[PRU_ECHO_MAX_LEN];
+	ssize_t len;
+
+	len = read(fd, rx, sizeof(rx));
+	if (len < 0) {
+		perror("rpmsg read");
+		return -1;
+	}
+	return check(rx, len, size, seq);
+}
+
+static int rpmsg_bench(int fd, unsigned int size, unsigned long long *lat)
+{
+	unsigned long long start, t;
+	unsigned int i, sent, done;
+	uint32_t seq = 0;
+
+	for (i = 0; i < samples; i++, seq++) {
+		t = now_ns();
+		if (rpmsg_send(fd, size, seq) || rpmsg_recv(fd, size, seq))
+			return -1;
+		lat[i] = now_ns() - t;
+	}
+
+	/* echoes come back in order, keep up to window of them pending */
+	start = now_ns();
+	for (sent = done = 0; done < samples; done++) {
+		for (; sent < samples && sent - done < window; sent++)
+			if (rpmsg_send(fd, size, seq + sent))
+				return -1;
+		if (rpmsg_recv(fd, size, seq + done))
+			return -1;
+	}
+	t = now_ns() - start;
+
+	report("rpmsg", size, lat, t);
+	return 0;
+}
+
+struct shm {
+	volatile struct pru_echo_mbox *mbox;
+	int ddr_fd;
+	bool cached;
+};
+
+/* Only a cacheable pool needs the syncs, skip the syscalls otherwise */
+static int shm_sync(struct shm *shm, size_t offset, size_t size,
+		    unsigned int dir)
+{
+	struct uio_pruss_ddr_sync sync = {
+		.offset	= offset,
+		.size	= size,
+		.dir	= dir,
+	};
+
+	if (!shm->cached)
+		return 0;
+	if (ioctl(shm->ddr_fd, UIO_PRUSS_IOC_DDR_SYNC, &sync)) {
+		perror("UIO_PRUSS_IOC_DDR_SYNC");
+		return -1;
+	}
+	return 0;
+}
+
+static long uio_map_size(const char *uio, int map)
+{
+	char path[128];
+	long size = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/class/uio/%s/maps/map%d/size",
+		 uio, map);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%li", &size) != 1)
+		size = -1;
+	fclose(f);
+	return size;
+}
+
+static void *uio_map(int fd, const char *uio, int map, long *size)
+{
+	void *p;
+
+	*size = uio_map_size(uio, map);
+	if (*size < 0)
+		return NULL;
+	p = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		 (off_t)map * getpagesize());
+	return p == MAP_FAILED ? NULL : p;
+}
+
+/*
+ * Point the firmware at a mailbox at the start of the external ram pool,
+ * which is the last memory map of the uio_pruss device.
+ */
+static int shm_setup(struct shm *shm, const char *dev)
+{
+	volatile struct pru_echo_boot *boot;
+	struct uio_pruss_ddr_info info;
+	const char *uio = strrchr(dev, '/') ? strrchr(dev, '/') + 1 : dev;
+	long pruss_size, ddr_size;
+	void *pruss, *ddr;
+	int fd, map;
+
+	fd = open(dev, O_RDWR | O_SYNC);
+	if (fd < 0) {
+		perror(dev);
+		return -1;
+	}
+
+	shm->ddr_fd = open(DDR_DEV, O_RDWR);
+	if (shm->ddr_fd < 0 ||
+	    ioctl(shm->ddr_fd, UIO_PRUSS_IOC_DDR_INFO, &info)) {
+		perror(DDR_DEV);
+		return -1;
+	}
+	shm->cached = info.flags & UIO_PRUSS_DDR_CACHED;
+
+	for (map = 1; uio_map_size(uio, map + 1) >= 0; map++)
+		;
+
+	pruss = uio_map(fd, uio, 0, &pruss_size);
+	ddr = uio_map(fd, uio, map, &ddr_size);
+	if (!pruss || !ddr || pruss_size < PRU_ECHO_BOOT_OFFSET +
+	    (long)sizeof(*boot) || ddr_size < (long)sizeof(*shm->mbox)) {
+		fprintf(stderr, "%s: cannot map the PRUSS and its ram pool\n",
+			dev);
+		return -1;
+	}
+
+	shm->mbox = ddr;
+	memset((void *)shm->mbox, 0, sizeof(*shm->mbox));
+	if (shm_sync(shm, 0, sizeof(*shm->mbox), UIO_PRUSS_SYNC_FOR_DEVICE))
+		return -1;
+
+	boot = (volatile struct pru_echo_boot *)((char *)pruss +
+						 PRU_ECHO_BOOT_OFFSET);
+	boot->mbox_addr = info.paddr;
+	__sync_synchronize();
+	boot->magic = PRU_ECHO_MAGIC;
+	return 0;
+}
+
+static int shm_bench(struct shm *shm, unsigned int size,
+		     unsigned long long *lat)
+{
+	volatile struct pru_echo_mbox *mbox = shm->mbox;
+	size_t rsp = offsetof(struct pru_echo_mbox, rsp);
+	size_t req = offsetof(struct pru_echo_mbox, req);
+	unsigned char buf[PRU_ECHO_MAX_LEN];
+	unsigned long long t, total = 0;
+	uint32_t seq = mbox->req_seq;
+	unsigned int i;
+
+	for (i = 0; i < samples; i++) {
+		fill(buf, size, ++seq);
+		t = now_ns();
+
+		/* the payload has to be visible before the new seq */
+		memcpy((void *)mbox->req, buf, size);
+		mbox->len = size;
+		if (shm_sync(shm, 0, req + size, UIO_PRUSS_SYNC_FOR_DEVICE))
+			return -1;
+		__sync_synchronize();
+		mbox->req_seq = seq;
+		if (shm_sync(shm, 0, req, UIO_PRUSS_SYNC_FOR_DEVICE))
+			return -1;
+
+		for (;;) {
+			if (shm_sync(shm, 0, req, UIO_PRUSS_SYNC_FOR_CPU))
+				return -1;
+			if (mbox->rsp_seq == seq)
+				break;
+			if (now_ns() - t > SHM_TIMEOUT_NS) {
+				fprintf(stderr, "shm: no echo for %u, is "
+					"pru_echo_shm running?\n", seq);
+				return -1;
+			}
+		}
+		__sync_synchronize();
+		if (shm_sync(shm, rsp, size, UIO_PRUSS_SYNC_FOR_CPU))
+			return -1;
+		memcpy(buf, (void *)mbox->rsp, size);
+
+		lat[i] = now_ns() - t;
+		total += lat[i];
+		if (check(buf, size, size, seq))
+			return -1;
+	}
+
+	report("shm", size, lat, total);
+	return 0;
+}
+
+static int parse_sizes(const char *arg, unsigned int *sizes)
+{
+	char *s = strdup(arg), *tok, *save;
+	int n = 0;
+
+	for (tok = strtok_r(s, ",", &save); tok && n < MAX_SIZES;
+	     tok = strtok_r(NULL, ",", &save)) {
+		sizes[n] = strtoul(tok, NULL, 0);
+		if (sizes[n] < sizeof(uint32_t) ||
+		    sizes[n] > PRU_ECHO_MAX_LEN) {
+			fprintf(stderr, "size %s not in 4..%d\n", tok,
+				PRU_ECHO_MAX_LEN);
+			n = -1;
+			break;
+		}
+		n++;
+	}
+	free(s);
+	return n;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-d rpmsg_dev] [-u uio_dev] [-p rpmsg|shm|all]\n"
+		"       [-n samples] [-s size,...] [-w window]\n"
+		"  -d  rpmsg_pru device of the echo firmware (%s)\n"
+		"  -u  pruss_evtN UIO device, needed for the shm path\n"
+		"  -p  paths to measure (rpmsg)\n"
+		"  -n  round trips per size (%u)\n"
+		"  -s  message sizes in bytes (%s)\n"
+		"  -w  rpmsg messages in flight for throughput (%u)\n",
+		prog, DEFAULT_RPMSG_DEV, samples, DEFAULT_SIZES, window);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *rpmsg_dev = DEFAULT_RPMSG_DEV, *uio_dev = NULL;
+	const char *sizes_arg = DEFAULT_SIZES, *paths = "rpmsg";
+	unsigned int sizes[MAX_SIZES];
+	bool do_rpmsg, do_shm;
+	unsigned long long *lat;
+	struct utsname uts;
+	struct shm shm = { .ddr_fd = -1 };
+	int nsizes, fd = -1, i, opt;
+
+	while ((opt = getopt(argc, argv, "d:u:p:n:s:w:")) != -1) {
+		switch (opt) {
+		case 'd':
+			rpmsg_dev = optarg;
+			break;
+		case 'u':
+			uio_dev = optarg;
+			break;
+		case 'p':
+			paths = optarg;
+			break;
+		case 'n':
+			samples = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			sizes_arg = optarg;
+			break;
+		case 'w':
+			window = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	do_rpmsg = !strcmp(paths, "rpmsg") || !strcmp(paths, "all");
+	do_shm = !strcmp(paths, "shm") || !strcmp(paths, "all");
+	nsizes = parse_sizes(sizes_arg, sizes);
+	if ((!do_rpmsg && !do_shm) || (do_shm && !uio_dev) || !samples ||
+	    !window || nsizes <= 0)
+		usage(argv[0]);
+
+	lat = calloc(samples, sizeof(*lat));
+	if (!lat)
+		return 1;
+
+	if (do_rpmsg) {
+		fd = open(rpmsg_dev, O_RDWR);
+		if (fd < 0) {
+			perror(rpmsg_dev);
+			return 1;
+		}
+	}
+	if (do_shm && shm_setup(&shm, uio_dev))
+		return 1;
+
+	uname(&uts);
+	printf("# pru_echo_bench kernel=%s samples=%u window=%u\n",
+	       uts.release, samples, window);
+
+	for (i = 0; i < nsizes; i++) {
+		if (do_rpmsg && rpmsg_bench(fd, sizes[i], lat))
+			return 1;
+		if (do_shm && shm_bench(&shm, sizes[i], lat))
+			return 1;
+	}
+
+	return 0;
+}
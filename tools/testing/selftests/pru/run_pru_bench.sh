@@ -0,0 +1,22 @@
+#!/bin/sh
+# Round trip benchmark against the rpmsg echo firmware (firmware/pru_echo.out
+# loaded on PRU0).  Only reports numbers, it fails if an echo goes missing
+# or comes back wrong.
+
+dev=/dev/rpmsg_pru30
+
+if [ ! -c $dev ]; then
+	echo "no $dev, load firmware/pru_echo.out on PRU0 to run this test"
+	exit 0
+fi
+
+echo "--------------------"
+echo "running pru_echo_bench"
+echo "--------------------"
+./pru_echo_bench -d $dev -n 1000
+if [ $? -ne 0 ]; then
+	echo "[FAIL]"
+	exit 1
+else
+	echo "[PASS]"
+fi
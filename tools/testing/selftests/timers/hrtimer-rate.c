@@ -0,0 +1,145 @@
+/* Measure the cost of running a high rate periodic hrtimer
+ *
+ *  A thread sleeps to absolute deadlines a fixed period apart (50us,
+ *  20 kHz, by default) for a few seconds.  Every wakeup reprograms the
+ *  clockevent device once, so the system time spent per wakeup is a fair
+ *  measure of the per event overhead of the timer code and the driver.
+ *  Wakeup latency and missed periods are reported alongside.
+ *
+ *  To build:
+ *	$ gcc hrtimer-rate.c -o hrtimer-rate -lrt
+ *
+ *  Usage: hrtimer-rate [-p period_ns] [-t seconds]
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#ifdef KTEST
+#include "../kselftest.h"
+#else
+static inline int ksft_exit_pass(void)
+{
+	exit(0);
+}
+static inline int ksft_exit_fail(void)
+{
+	exit(1);
+}
+#endif
+
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_USEC 1000LL
+
+static long long ts_to_ns(struct timespec ts)
+{
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static struct timespec ns_to_ts(long long ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / NSEC_PER_SEC;
+	ts.tv_nsec = ns % NSEC_PER_SEC;
+	return ts;
+}
+
+static long long tv_to_ns(struct timeval tv)
+{
+	return tv.tv_sec * NSEC_PER_SEC + tv.tv_usec * NSEC_PER_USEC;
+}
+
+int main(int argc, char **argv)
+{
+	long long period = 50000, duration = 5;
+	long long next, now, stop, lat, lat_sum = 0, lat_max = 0;
+	long long events = 0, missed = 0, stime;
+	struct sched_param sp;
+	struct rusage start, end;
+	struct timespec ts;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:t:")) != -1) {
+		switch (opt) {
+		case 'p':
+			period = atoll(optarg);
+			break;
+		case 't':
+			duration = atoll(optarg);
+			break;
+		default:
+			printf("Usage: %s [-p period_ns] [-t seconds]\n",
+			       argv[0]);
+			return ksft_exit_fail();
+		}
+	}
+	if (period <= 0 || duration <= 0) {
+		printf("period and duration must be positive\n");
+		return ksft_exit_fail();
+	}
+
+	/* Without it other tasks add to the latency, not to the overhead */
+	memset(&sp, 0, sizeof(sp));
+	sp.sched_priority = sched_get_priority_max(SCHED_FIFO);
+	if (sched_setscheduler(0, SCHED_FIFO, &sp))
+		printf("Not running SCHED_FIFO, latencies will be noisy\n");
+
+	printf("hrtimer at %lld ns for %lld s: ", period, duration);
+	fflush(stdout);
+
+	getrusage(RUSAGE_SELF, &start);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	next = ts_to_ns(ts) + period;
+	stop = next + duration * NSEC_PER_SEC;
+
+	while (next < stop) {
+		ts = ns_to_ts(next);
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+				    NULL)) {
+			printf("[FAILED]\n");
+			return ksft_exit_fail();
+		}
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		now = ts_to_ns(ts);
+
+		lat = now - next;
+		lat_sum += lat;
+		if (lat > lat_max)
+			lat_max = lat;
+		events++;
+
+		next += period;
+		/* Don't try to catch up, that would only measure the loop */
+		while (next <= now) {
+			next += period;
+			missed++;
+		}
+	}
+	getrusage(RUSAGE_SELF, &end);
+
+	stime = tv_to_ns(end.ru_stime) - tv_to_ns(start.ru_stime);
+
+	printf("[OK]\n");
+	printf("  wakeups %lld, missed periods %lld\n", events, missed);
+	printf("  latency avg %lld ns, max %lld ns\n", lat_sum / events,
+	       lat_max);
+	printf("  system time per wakeup %lld ns\n", stime / events);
+
+	return ksft_exit_pass();
+}